@@ -27,6 +27,7 @@ using namespace mega;
 
 @property MegaNode *megaNode;
 @property BOOL cMemoryOwn;
+@property (strong) id owner;
 
 @end
 
@@ -43,6 +44,16 @@ using namespace mega;
     return self;
 }
 
+- (instancetype)initWithMegaNode:(MegaNode *)megaNode owner:(id)owner {
+    self = [self initWithMegaNode:megaNode cMemoryOwn:NO];
+    
+    if (self != nil) {
+        _owner = owner;
+    }
+    
+    return self;
+}
+
 - (void)dealloc {
     if (self.cMemoryOwn) {
         delete _megaNode;
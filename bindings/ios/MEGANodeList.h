@@ -42,6 +42,10 @@
  * it contains a copy of all internal attributes, so it will be valid after
  * the original object is deleted.
  *
+ * As MEGANodeList objects are immutable, lists returned by MEGASdk are not
+ * copied: the same object is returned. Only lists received in delegate
+ * callbacks are copied.
+ *
  * You are the owner of the returned object.
  *
  * @return Copy of the MEGANodeList object.
@@ -54,9 +58,25 @@
  *
  * If the index is >= the size of the list, this function returns nil.
  *
+ * The MEGANode isn't copied: it refers to the node in the list, and keeps
+ * the list alive as long as it's used. Asking for the same position again
+ * returns the same object while it's in use, so table views over large
+ * folders only create the objects of the visible rows.
+ *
  * @param index Position of the MEGANode that we want to get for the list.
  * @return MEGANode at the position index in the list.
  */
 - (MEGANode *)nodeAtIndex:(NSInteger)index;
 
+/**
+ * @brief Returns the MEGANode objects of a range of positions.
+ *
+ * The objects are created as by [MEGANodeList nodeAtIndex:]. Positions
+ * beyond the end of the list are ignored.
+ *
+ * @param range Positions of the MEGANode objects.
+ * @return Array with the MEGANode objects in the range.
+ */
+- (NSArray *)nodesInRange:(NSRange)range;
+
 @end
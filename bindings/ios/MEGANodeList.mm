@@ -28,6 +28,9 @@ using namespace mega;
 @property MegaNodeList *nodeList;
 @property BOOL cMemoryOwn;
 
+// wrappers handed out by nodeAtIndex: (weak, as they retain the list)
+@property NSMapTable *wrappers;
+
 @end
 
 @implementation MEGANodeList
@@ -38,6 +41,7 @@ using namespace mega;
     if (self != nil) {
         _nodeList = nodelist;
         _cMemoryOwn = cMemoryOwn;
+        _wrappers = [NSMapTable strongToWeakObjectsMapTable];
     }
     
     return self;
@@ -50,6 +54,12 @@ using namespace mega;
 }
 
 - (instancetype)clone {
+    // the list is immutable: only lists owned by the SDK (e.g. in delegate
+    // callbacks) need a copy to outlive it
+    if (self.cMemoryOwn) {
+        return self;
+    }
+    
     return self.nodeList ? [[MEGANodeList alloc] initWithNodeList:self.nodeList->copy() cMemoryOwn:YES] : nil;
 }
 
@@ -58,7 +68,39 @@ using namespace mega;
 }
 
 - (MEGANode *)nodeAtIndex:(NSInteger)index {
-    return  self.nodeList ? [[MEGANode alloc] initWithMegaNode:self.nodeList->get((int)index)->copy() cMemoryOwn:YES] : nil;
+    if (!self.nodeList || index < 0 || index >= self.nodeList->size()) return nil;
+    
+    NSNumber *key = [NSNumber numberWithInteger:index];
+    MEGANode *node = [self.wrappers objectForKey:key];
+    
+    if (node == nil) {
+        // lists owned by the SDK are only valid during the callback
+        if (self.cMemoryOwn) {
+            node = [[MEGANode alloc] initWithMegaNode:self.nodeList->get((int)index) owner:self];
+        } else {
+            node = [[MEGANode alloc] initWithMegaNode:self.nodeList->get((int)index)->copy() cMemoryOwn:YES];
+        }
+        
+        [self.wrappers setObject:node forKey:key];
+    }
+    
+    return node;
+}
+
+- (NSArray *)nodesInRange:(NSRange)range {
+    NSInteger size = self.nodeList ? self.nodeList->size() : 0;
+    NSInteger end = (NSInteger)(range.location + range.length);
+    
+    if ((NSInteger)range.location >= size) return [NSArray array];
+    if (end > size) end = size;
+    
+    NSMutableArray *nodes = [NSMutableArray arrayWithCapacity:end - range.location];
+    
+    for (NSInteger i = range.location; i < end; i++) {
+        [nodes addObject:[self nodeAtIndex:i]];
+    }
+    
+    return nodes;
 }
 
 - (NSNumber *)size {
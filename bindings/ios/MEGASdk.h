@@ -2326,6 +2326,25 @@ typedef NS_ENUM(NSInteger, MEGAPaymentMethod) {
  */
 - (MEGANodeList *)childrenForParent:(MEGANode *)parent order:(NSInteger)order;
 
+/**
+ * @brief Get a page of the children of a MEGANode.
+ *
+ * The children are sorted as by [MEGASdk childrenForParent:order:] and only
+ * the positions in the range are returned, so large folders can be listed
+ * as the user scrolls. Use [MEGASdk numberChildrenForParent:] to get the
+ * total number of children.
+ *
+ * If the parent node doesn't exist or it isn't a folder, this function
+ * returns nil.
+ *
+ * @param parent Parent node.
+ * @param order Order for the returned list (see [MEGASdk childrenForParent:order:]).
+ * @param range Positions of the children to return.
+ *
+ * @return List with the child MEGANode objects in the range.
+ */
+- (MEGANodeList *)childrenForParent:(MEGANode *)parent order:(NSInteger)order range:(NSRange)range;
+
 /**
  * @brief Get all children of a MEGANode.
  *
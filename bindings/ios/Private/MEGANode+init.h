@@ -24,6 +24,11 @@
 @interface MEGANode (init)
 
 - (instancetype)initWithMegaNode:(mega::MegaNode *)megaNode cMemoryOwn:(BOOL)cMemoryOwn;
+
+// wraps a node owned by another object without copying it, keeping the
+// owner alive as long as the wrapper
+- (instancetype)initWithMegaNode:(mega::MegaNode *)megaNode owner:(id)owner;
+
 - (mega::MegaNode *)getCPtr;
 
 @end
@@ -1,5 +1,7 @@
 package nz.mega.sdk;
 
+import java.nio.ByteBuffer;
+
 /**
  * Interface to receive information about transfers.
  * <p>
@@ -140,14 +142,21 @@ class DelegateMegaTransferListener extends MegaTransferListener {
      * @param transfer
      *          Information about the transfer
      * @param buffer
-     *          Buffer with the last read bytes
+     *          Buffer with the last read bytes, only valid until this function returns
      * @return
-     *          Size of the buffer
+     *          true to continue the transfer, false to cancel it
      */
-    public boolean onTransferData(MegaApi api, MegaTransfer transfer, byte[] buffer) {
+    public boolean onTransferData(MegaApi api, MegaTransfer transfer, ByteBuffer buffer) {
         if (listener != null) {
             final MegaTransfer megaTransfer = transfer.copy();
-            return listener.onTransferData(megaApi, megaTransfer, buffer);
+            if (listener instanceof MegaTransferBufferListenerInterface) {
+                return ((MegaTransferBufferListenerInterface) listener).onTransferData(megaApi, megaTransfer, buffer);
+            }
+
+            // listeners taking an array get a copy of the data
+            byte[] data = new byte[buffer.remaining()];
+            buffer.get(data);
+            return listener.onTransferData(megaApi, megaTransfer, data);
         }
         return false;
     }
@@ -2,6 +2,7 @@ package nz.mega.sdk;
 
 import java.io.IOException;
 import java.io.OutputStream;
+import java.nio.ByteBuffer;
 
 /**
  * The listener interface for receiving delegateOutputMegaTransfer events.
@@ -14,6 +15,9 @@ import java.io.OutputStream;
 public class DelegateOutputMegaTransferListener extends DelegateMegaTransferListener {
     OutputStream outputStream;
 
+    // reused for every chunk, the data is only valid during the callback
+    byte[] scratch = new byte[0];
+
     /**
      * Instantiates a new delegate output mega transfer listener.
      *
@@ -44,10 +48,15 @@ public class DelegateOutputMegaTransferListener extends DelegateMegaTransferList
      * @return
      *              true, if successful
      */
-    public boolean onTransferData(MegaApi api, MegaTransfer transfer, byte[] buffer) {
+    public boolean onTransferData(MegaApi api, MegaTransfer transfer, ByteBuffer buffer) {
         if (outputStream != null) {
             try {
-                outputStream.write(buffer);
+                int size = buffer.remaining();
+                if (scratch.length < size) {
+                    scratch = new byte[size];
+                }
+                buffer.get(scratch, 0, size);
+                outputStream.write(scratch, 0, size);
                 return true;
             } catch (IOException e) {
             }
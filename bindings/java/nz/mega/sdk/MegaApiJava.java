@@ -2711,6 +2711,9 @@ public class MegaApiJava {
      * compatibility with other programming languages. Only the MegaTransferListener passed to this function
      * will receive MegaTransferListener.onTransferData() callbacks. MegaTransferListener objects registered
      * with MegaApiJava.addTransferListener() will not receive them for performance reasons.
+     * <p>
+     * Listeners implementing MegaTransferBufferListenerInterface receive the data in a ByteBuffer
+     * over the memory of the SDK instead of a copy in a byte array.
      * 
      * @param node
      *            MegaNode that identifies the file (public nodes are not supported yet)
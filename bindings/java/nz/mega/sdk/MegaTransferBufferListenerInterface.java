@@ -0,0 +1,30 @@
+package nz.mega.sdk;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Interface to receive the data of streaming downloads without copying it.
+ * <p>
+ * Listeners implementing this interface receive the data of streaming downloads in
+ * MegaTransferBufferListenerInterface.onTransferData(MegaApiJava, MegaTransfer, ByteBuffer)
+ * instead of MegaTransferListenerInterface.onTransferData(MegaApiJava, MegaTransfer, byte[]).
+ */
+public interface MegaTransferBufferListenerInterface extends MegaTransferListenerInterface {
+    /**
+     * This function is called to provide the last read bytes of streaming downloads.
+     * <p>
+     * The buffer is a read-only direct ByteBuffer over the memory of the SDK, the data is not copied.
+     * It is only valid until this function returns: copy the data to keep it. This function
+     * is called from the SDK thread, unlike other callbacks.
+     *
+     * @param api
+     *          MegaApi object that started the transfer
+     * @param transfer
+     *          Information about the transfer
+     * @param buffer
+     *          Buffer with the last read bytes
+     * @return
+     *          true to continue the transfer, false to cancel it
+     */
+    public boolean onTransferData(MegaApiJava api, MegaTransfer transfer, ByteBuffer buffer);
+}
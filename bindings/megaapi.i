@@ -2,7 +2,9 @@
 #define __ANDROID__
 #endif
 
-%module(directors="1") mega
+//threads: the Python wrappers release the GIL during the calls to the SDK
+//and directors take it to call back into Python, whatever the SWIG flags
+%module(directors="1", threads="1") mega
 %{
 #include "megaapi.h"
 %}
@@ -81,11 +83,72 @@
 %}
 #endif
 
-%apply (char *STRING, size_t LENGTH) {(char *buffer, size_t size)};
+//Streamed data is passed as a read-only direct ByteBuffer over the buffer
+//of the SDK, without copying it. It's only valid during the callback.
+%typemap(jni) (char *buffer, size_t size) "jobject"
+%typemap(jtype) (char *buffer, size_t size) "java.nio.ByteBuffer"
+%typemap(jstype) (char *buffer, size_t size) "java.nio.ByteBuffer"
+%typemap(javain) (char *buffer, size_t size) "$javainput"
+%typemap(javadirectorin) (char *buffer, size_t size) "$jniinput.asReadOnlyBuffer()"
+%typemap(in) (char *buffer, size_t size)
+%{
+	$1 = (char *)jenv->GetDirectBufferAddress($input);
+	$2 = $1 ? (size_t)jenv->GetDirectBufferCapacity($input) : 0;
+%}
+%typemap(directorin, descriptor="Ljava/nio/ByteBuffer;") (char *buffer, size_t size)
+%{
+	$input = jenv->NewDirectByteBuffer($1, (jlong)$2);
+%}
 %typemap(directorargout) (char *buffer, size_t size)
 %{ jenv->DeleteLocalRef($input); %}
 #endif
 
+#ifdef SWIGPYTHON
+//Streamed data is passed as a read-only memoryview over the buffer of the
+//SDK, without copying it. It's only valid during the callback: use
+//bytes(buffer) to keep the data.
+%typemap(directorin) (char *buffer, size_t size)
+%{
+#if PY_VERSION_HEX >= 0x03030000
+	$input = PyMemoryView_FromMemory($1, (Py_ssize_t)$2, PyBUF_READ);
+#else
+	$input = PyBuffer_FromMemory($1, (Py_ssize_t)$2);
+#endif
+%}
+%typemap(in) (char *buffer, size_t size) (Py_buffer view)
+%{
+	if (PyObject_GetBuffer($input, &view, PyBUF_SIMPLE) < 0)
+	{
+		SWIG_fail;
+	}
+	$1 = (char *)view.buf;
+	$2 = (size_t)view.len;
+	PyBuffer_Release(&view);
+%}
+%typemap(typecheck, precedence=SWIG_TYPECHECK_STRING) (char *buffer, size_t size)
+%{ $1 = PyObject_CheckBuffer($input); %}
+
+//Accessors of value objects don't block nor call back into Python: keep the
+//GIL, releasing it costs more than the call when iterating large listings
+%nothread mega::MegaNodeList::get;
+%nothread mega::MegaNodeList::size;
+%nothread mega::MegaNode::getType;
+%nothread mega::MegaNode::getName;
+%nothread mega::MegaNode::getHandle;
+%nothread mega::MegaNode::getParentHandle;
+%nothread mega::MegaNode::getSize;
+%nothread mega::MegaNode::getCreationTime;
+%nothread mega::MegaNode::getModificationTime;
+%nothread mega::MegaNode::isFile;
+%nothread mega::MegaNode::isFolder;
+%nothread mega::MegaError::getErrorCode;
+%nothread mega::MegaRequest::getType;
+%nothread mega::MegaRequest::getNodeHandle;
+%nothread mega::MegaTransfer::getType;
+%nothread mega::MegaTransfer::getTransferredBytes;
+%nothread mega::MegaTransfer::getTotalBytes;
+#endif
+
 
 %feature("director") mega::MegaGlobalListener;
 %feature("director") mega::MegaListener;
@@ -142,6 +205,7 @@
 %ignore mega::MegaTransfer::getListener;
 %ignore mega::MegaRequest::getListener;
 %ignore mega::MegaHashSignature;
+%ignore mega::MegaApi::getNodeHandlesByPath;
 
 %newobject mega::MegaError::copy;
 %newobject mega::MegaRequest::copy;
@@ -149,6 +213,17 @@
 %newobject mega::MegaTransferList::copy;
 %newobject mega::MegaNode::copy;
 %newobject mega::MegaNodeList::copy;
+%newobject mega::MegaChildrenCursor::copy;
+%newobject mega::MegaTransferBatch::createInstance;
+%newobject mega::MegaTransferStats::copy;
+%newobject mega::MegaApi::getTransferStats;
+%newobject mega::MegaMemoryUsage::copy;
+%newobject mega::MegaApi::getMemoryUsage;
+%newobject mega::MegaEngineMetrics::copy;
+%newobject mega::MegaApi::getEngineMetrics;
+%newobject mega::MegaStartupTimeline::copy;
+%newobject mega::MegaApi::getStartupTimeline;
+%newobject mega::MegaSearchFilter::copy;
 %newobject mega::MegaShare::copy;
 %newobject mega::MegaShareList::copy;
 %newobject mega::MegaUser::copy;
@@ -159,6 +234,8 @@
 %newobject mega::MegaTransfer::getPublicMegaNode;
 %newobject mega::MegaNode::getBase64Handle;
 %newobject mega::MegaApi::getChildren;
+%newobject mega::MegaApi::getChildrenCursor;
+%newobject mega::MegaApi::getNextChildren;
 %newobject mega::MegaApi::getChildNode;
 %newobject mega::MegaApi::getContacts;
 %newobject mega::MegaApi::getTransfers;
@@ -194,6 +271,7 @@
 %newobject mega::MegaRequest::getMegaAccountDetails;
 %newobject mega::MegaApi::escapeFsIncompatible;
 %newobject mega::MegaApi::unescapeFsIncompatible;
+%newobject mega::MegaApi::httpServerGetLocalLink;
 %newobject mega::MegaRequest::getPricing;
 %newobject mega::MegaAccountDetails::getSubscriptionMethod;
 %newobject mega::MegaAccountDetails::getSubscriptionCycle;
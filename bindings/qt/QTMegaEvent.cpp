@@ -118,3 +118,79 @@ void QTMegaEvent::setNewState(int newState)
     this->newState = newState;
 }
 #endif
+
+QTMegaUpdateQueue::QTMegaUpdateQueue()
+{
+    interval = 0;
+}
+
+QTMegaUpdateQueue::~QTMegaUpdateQueue()
+{
+    qDeleteAll(pending);
+}
+
+int QTMegaUpdateQueue::tagOf(QTMegaEvent *event)
+{
+    if (event->getTransfer())
+    {
+        return event->getTransfer()->getTag();
+    }
+
+    return event->getRequest() ? event->getRequest()->getTag() : 0;
+}
+
+bool QTMegaUpdateQueue::add(QTMegaEvent *event)
+{
+    QPair<int, int> key((int)event->type(), tagOf(event));
+
+    mutex.lock();
+    bool wake = pending.isEmpty();
+    QTMegaEvent *&slot = pending[key];
+    delete slot;
+    slot = event;
+    mutex.unlock();
+
+    return wake;
+}
+
+void QTMegaUpdateQueue::remove(QEvent::Type type, int tag)
+{
+    mutex.lock();
+    delete pending.take(QPair<int, int>((int)type, tag));
+    mutex.unlock();
+}
+
+int QTMegaUpdateQueue::due()
+{
+    mutex.lock();
+    int wait = 0;
+    if (interval && lastDelivery.isValid())
+    {
+        qint64 elapsed = lastDelivery.elapsed();
+        if (elapsed < interval)
+        {
+            wait = interval - (int)elapsed;
+        }
+    }
+    mutex.unlock();
+
+    return wait;
+}
+
+QList<QTMegaEvent *> QTMegaUpdateQueue::take()
+{
+    mutex.lock();
+    QList<QTMegaEvent *> events = pending.values();
+    pending.clear();
+    lastDelivery.start();
+    mutex.unlock();
+
+    return events;
+}
+
+void QTMegaUpdateQueue::setInterval(int ms)
+{
+    mutex.lock();
+    interval = ms > 0 ? ms : 0;
+    mutex.unlock();
+}
@@ -3,6 +3,11 @@
 
 #include <megaapi.h>
 #include <QEvent>
+#include <QMutex>
+#include <QMap>
+#include <QPair>
+#include <QList>
+#include <QElapsedTimer>
 
 namespace mega
 {
@@ -23,7 +28,8 @@ public:
         OnUsersUpdate,
         OnNodesUpdate,
         OnAccountUpdate,
-        OnReloadNeeded
+        OnReloadNeeded,
+        OnUpdatesPending
 #if ENABLE_SYNC
         ,
         OnSyncStateChanged,
@@ -72,6 +78,40 @@ private:
 #endif
 };
 
+// pending update events of a listener (OnRequestUpdate, OnTransferUpdate): an
+// update replaces the pending one of the same request or transfer, and a
+// single OnUpdatesPending event is queued to deliver them all - with an update
+// interval, no more often than that
+class QTMegaUpdateQueue
+{
+public:
+    QTMegaUpdateQueue();
+    ~QTMegaUpdateQueue();
+
+    // takes the event, returns true if OnUpdatesPending has to be posted
+    bool add(QTMegaEvent *event);
+
+    // drop the pending update of a finished request or transfer
+    void remove(QEvent::Type type, int tag);
+
+    // milliseconds until the updates can be delivered (0: now)
+    int due();
+
+    // hand over the pending updates, to be delivered and deleted by the caller
+    QList<QTMegaEvent *> take();
+
+    // minimum time between deliveries in milliseconds (0: none)
+    void setInterval(int ms);
+
+private:
+    static int tagOf(QTMegaEvent *event);
+
+    QMutex mutex;
+    QMap<QPair<int, int>, QTMegaEvent *> pending;
+    QElapsedTimer lastDelivery;
+    int interval;
+};
+
 }
 
 #endif // QTMEGAEVENT_H
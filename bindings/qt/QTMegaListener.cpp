@@ -2,6 +2,7 @@
 #include "QTMegaEvent.h"
 
 #include <QCoreApplication>
+#include <QTimer>
 
 using namespace mega;
 
@@ -26,6 +27,9 @@ void QTMegaListener::onRequestStart(MegaApi *api, MegaRequest *request)
 
 void QTMegaListener::onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *e)
 {
+    // its last update would arrive after the finish
+    updates.remove((QEvent::Type)QTMegaEvent::OnRequestUpdate, request->getTag());
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnRequestFinish);
     event->setRequest(request->copy());
     event->setError(e->copy());
@@ -36,7 +40,10 @@ void QTMegaListener::onRequestUpdate(MegaApi *api, MegaRequest *request)
 {
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnRequestUpdate);
     event->setRequest(request->copy());
-    QCoreApplication::postEvent(this, event, INT_MIN);
+    if (updates.add(event))
+    {
+        QCoreApplication::postEvent(this, new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnUpdatesPending), INT_MIN);
+    }
 }
 
 void QTMegaListener::onRequestTemporaryError(MegaApi *api, MegaRequest *request, MegaError *e)
@@ -56,6 +63,9 @@ void QTMegaListener::onTransferStart(MegaApi *api, MegaTransfer *transfer)
 
 void QTMegaListener::onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e)
 {
+    // its last update would arrive after the finish
+    updates.remove((QEvent::Type)QTMegaEvent::OnTransferUpdate, transfer->getTag());
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnTransferFinish);
     event->setTransfer(transfer->copy());
     event->setError(e->copy());
@@ -66,7 +76,10 @@ void QTMegaListener::onTransferUpdate(MegaApi *api, MegaTransfer *transfer)
 {
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnTransferUpdate);
     event->setTransfer(transfer->copy());
-    QCoreApplication::postEvent(this, event, INT_MIN);
+    if (updates.add(event))
+    {
+        QCoreApplication::postEvent(this, new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnUpdatesPending), INT_MIN);
+    }
 }
 
 void QTMegaListener::onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError *e)
@@ -179,7 +192,35 @@ void QTMegaListener::customEvent(QEvent *e)
             if(listener) listener->onGlobalSyncStateChanged(event->getMegaApi());
             break;
 #endif
+        case QTMegaEvent::OnUpdatesPending:
+        {
+            int wait = updates.due();
+            if (wait)
+            {
+                QTimer::singleShot(wait, this, SLOT(deliverUpdates()));
+            }
+            else
+            {
+                deliverUpdates();
+            }
+            break;
+        }
         default:
             break;
     }
 }
+
+void QTMegaListener::setUpdateInterval(int ms)
+{
+    updates.setInterval(ms);
+}
+
+void QTMegaListener::deliverUpdates()
+{
+    QList<QTMegaEvent *> events = updates.take();
+    for (int i = 0; i < events.size(); i++)
+    {
+        customEvent(events[i]);
+        delete events[i];
+    }
+}
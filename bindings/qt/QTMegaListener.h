@@ -2,6 +2,7 @@
 #define QTMEGALISTENER_H
 
 #include <QObject>
+#include "QTMegaEvent.h"
 #include "megaapi.h"
 
 namespace mega
@@ -33,9 +34,18 @@ public:
     virtual void onGlobalSyncStateChanged(MegaApi* api);
 #endif
 
+    // coalesced updates are delivered at most once per this many
+    // milliseconds (0, the default: as soon as possible)
+    void setUpdateInterval(int ms);
+
+protected slots:
+    void deliverUpdates();
+
 protected:
     virtual void customEvent(QEvent * event);
 
+    QTMegaUpdateQueue updates;
+
     MegaApi *megaApi;
 	MegaListener *listener;
 };
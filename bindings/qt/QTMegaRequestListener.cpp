@@ -1,6 +1,7 @@
 #include "QTMegaRequestListener.h"
 #include "QTMegaEvent.h"
 #include <QCoreApplication>
+#include <QTimer>
 
 using namespace mega;
 
@@ -25,6 +26,9 @@ void QTMegaRequestListener::onRequestStart(MegaApi *api, MegaRequest *request)
 
 void QTMegaRequestListener::onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *e)
 {
+    // its last update would arrive after the finish
+    updates.remove((QEvent::Type)QTMegaEvent::OnRequestUpdate, request->getTag());
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnRequestFinish);
     event->setRequest(request->copy());
     event->setError(e->copy());
@@ -35,7 +39,10 @@ void QTMegaRequestListener::onRequestUpdate(MegaApi *api, MegaRequest *request)
 {
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnRequestUpdate);
     event->setRequest(request->copy());
-    QCoreApplication::postEvent(this, event, INT_MIN);
+    if (updates.add(event))
+    {
+        QCoreApplication::postEvent(this, new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnUpdatesPending), INT_MIN);
+    }
 }
 
 void QTMegaRequestListener::onRequestTemporaryError(MegaApi *api, MegaRequest *request, MegaError *e)
@@ -63,7 +70,35 @@ void QTMegaRequestListener::customEvent(QEvent *e)
         case QTMegaEvent::OnRequestTemporaryError:
             if(listener) listener->onRequestTemporaryError(event->getMegaApi(), event->getRequest(), event->getError());
             break;
+        case QTMegaEvent::OnUpdatesPending:
+        {
+            int wait = updates.due();
+            if (wait)
+            {
+                QTimer::singleShot(wait, this, SLOT(deliverUpdates()));
+            }
+            else
+            {
+                deliverUpdates();
+            }
+            break;
+        }
         default:
             break;
     }
 }
+
+void QTMegaRequestListener::setUpdateInterval(int ms)
+{
+    updates.setInterval(ms);
+}
+
+void QTMegaRequestListener::deliverUpdates()
+{
+    QList<QTMegaEvent *> events = updates.take();
+    for (int i = 0; i < events.size(); i++)
+    {
+        customEvent(events[i]);
+        delete events[i];
+    }
+}
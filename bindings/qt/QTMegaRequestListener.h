@@ -2,6 +2,7 @@
 #define QTMEGAREQUESTLISTENER_H
 
 #include <QObject>
+#include "QTMegaEvent.h"
 #include "megaapi.h"
 
 namespace mega
@@ -20,9 +21,18 @@ public:
     virtual void onRequestUpdate(MegaApi* api, MegaRequest *request);
 	virtual void onRequestTemporaryError(MegaApi *api, MegaRequest *request, MegaError* e);
 
+    // coalesced updates are delivered at most once per this many
+    // milliseconds (0, the default: as soon as possible)
+    void setUpdateInterval(int ms);
+
+protected slots:
+    void deliverUpdates();
+
 protected:
     virtual void customEvent(QEvent * event);
 
+    QTMegaUpdateQueue updates;
+
 	MegaRequestListener *listener;
     MegaApi *megaApi;
 };
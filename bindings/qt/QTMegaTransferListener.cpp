@@ -1,5 +1,6 @@
 #include "QTMegaTransferListener.h"
 #include <QCoreApplication>
+#include <QTimer>
 #include "QTMegaEvent.h"
 
 using namespace mega;
@@ -26,6 +27,9 @@ void QTMegaTransferListener::onTransferStart(MegaApi *api, MegaTransfer *transfe
 
 void QTMegaTransferListener::onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e)
 {
+    // its last update would arrive after the finish
+    updates.remove((QEvent::Type)QTMegaEvent::OnTransferUpdate, transfer->getTag());
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnTransferFinish);
     event->setTransfer(transfer->copy());
     event->setError(e->copy());
@@ -36,7 +40,10 @@ void QTMegaTransferListener::onTransferUpdate(MegaApi *api, MegaTransfer *transf
 {
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnTransferUpdate);
     event->setTransfer(transfer->copy());
-    QCoreApplication::postEvent(this, event, INT_MIN);
+    if (updates.add(event))
+    {
+        QCoreApplication::postEvent(this, new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnUpdatesPending), INT_MIN);
+    }
 }
 
 void QTMegaTransferListener::onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError *e)
@@ -64,7 +71,35 @@ void QTMegaTransferListener::customEvent(QEvent *e)
         case QTMegaEvent::OnTransferFinish:
             if(listener) listener->onTransferFinish(event->getMegaApi(), event->getTransfer(), event->getError());
             break;
+        case QTMegaEvent::OnUpdatesPending:
+        {
+            int wait = updates.due();
+            if (wait)
+            {
+                QTimer::singleShot(wait, this, SLOT(deliverUpdates()));
+            }
+            else
+            {
+                deliverUpdates();
+            }
+            break;
+        }
         default:
             break;
     }
 }
+
+void QTMegaTransferListener::setUpdateInterval(int ms)
+{
+    updates.setInterval(ms);
+}
+
+void QTMegaTransferListener::deliverUpdates()
+{
+    QList<QTMegaEvent *> events = updates.take();
+    for (int i = 0; i < events.size(); i++)
+    {
+        customEvent(events[i]);
+        delete events[i];
+    }
+}
@@ -32,6 +32,14 @@ SOURCES += src/attrmap.cpp \
     src/waiterbase.cpp  \
     src/proxy.cpp \
     src/pendingcontactrequest.cpp \
+    src/gfxcache.cpp \
+    src/aesbatch.cpp \
+    src/crc32.cpp \
+    src/nodemap.cpp \
+    src/transferstats.cpp \
+    src/bandwidth.cpp \
+    src/bufferpool.cpp \
+    src/transferscheduler.cpp \
     src/crypto/cryptopp.cpp  \
     src/db/sqlite.cpp  \
     src/gfx/qt.cpp \
@@ -93,6 +101,15 @@ HEADERS  += include/mega.h \
             include/mega/waiter.h \
             include/mega/proxy.h \
             include/mega/pendingcontactrequest.h \
+            include/mega/gfxcache.h \
+            include/mega/aesbatch.h \
+            include/mega/crc32.h \
+            include/mega/nodemap.h \
+            include/mega/transferstats.h \
+            include/mega/bandwidth.h \
+            include/mega/bufferpool.h \
+            include/mega/workerpool.h \
+            include/mega/transferscheduler.h \
             include/mega/crypto/cryptopp.h  \
             include/mega/db/sqlite.h  \
             include/mega/gfx/qt.h \
@@ -202,6 +219,7 @@ macx {
    INCLUDEPATH += $$MEGASDK_BASE_PATH/bindings/qt/3rdparty/include/cryptopp
    SOURCES += $$MEGASDK_BASE_PATH/bindings/qt/3rdparty/qt/libs/sqlite3.c
    INCLUDEPATH += $$MEGASDK_BASE_PATH/bindings/qt/3rdparty/include/curl
-   DEFINES += PCRE_STATIC _DARWIN_FEATURE_64_BIT_INODE
+   DEFINES += PCRE_STATIC _DARWIN_FEATURE_64_BIT_INODE USE_FSEVENTSTREAM
+   LIBS += -framework CoreServices
    LIBS += -L$$MEGASDK_BASE_PATH/bindings/qt/3rdparty/libs/ $$MEGASDK_BASE_PATH/bindings/qt/3rdparty/libs/libcares.a $$MEGASDK_BASE_PATH/bindings/qt/3rdparty/libs/libcurl.a -lz -lssl -lcrypto
 }
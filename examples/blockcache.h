@@ -0,0 +1,278 @@
+/**
+ * @file examples/blockcache.h
+ * @brief Block cache and read-ahead shared by the filesystem examples
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// File data is streamed in blocks of BLOCKSIZE bytes that are kept in a
+// shared LRU cache of CAPACITY blocks. Each block is fetched with its own
+// streaming request, so reads from several threads and the read-ahead of
+// sequential readers proceed concurrently.
+
+#ifndef MEGA_EXAMPLES_BLOCKCACHE_H
+#define MEGA_EXAMPLES_BLOCKCACHE_H
+
+#include <megaapi.h>
+#include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class BlockCache
+{
+	public:
+		// size of the cached blocks of file data
+		static const int64_t BLOCKSIZE = 1 << 20;
+
+		// capacity of the cache (in blocks)
+		static const size_t CAPACITY = 64;
+
+		BlockCache(mega::MegaApi *api) : api(api)
+		{
+		}
+
+		// read [offset, offset + size) of the file (the caller clips the
+		// range to the file size), after starting the fetch of the following
+		// readahead blocks - returns the bytes read or -1 on error
+		int read(mega::MegaNode *node, char *buf, size_t size, int64_t offset, int readahead)
+		{
+			int64_t first = offset / BLOCKSIZE;
+			int64_t last = (offset + size - 1) / BLOCKSIZE;
+			int64_t end = (node->getSize() - 1) / BLOCKSIZE;
+			std::vector<int64_t> fetch;
+
+			{
+				std::unique_lock<std::mutex> lock(m);
+				for (int64_t i = first; i <= last + readahead && i <= end; i++)
+				{
+					if (request(node->getHandle(), i))
+					{
+						fetch.push_back(i);
+					}
+
+					if (i <= last)
+					{
+						blocks[BlockKey(node->getHandle(), i)].readers++;
+					}
+				}
+				evict();
+			}
+
+			// the streaming requests are queued outside the lock, the SDK
+			// thread takes it to complete them
+			for (size_t i = 0; i < fetch.size(); i++)
+			{
+				start(node, fetch[i]);
+			}
+
+			std::unique_lock<std::mutex> lock(m);
+			size_t done = 0;
+			bool failed = false;
+			for (int64_t i = first; i <= last; i++)
+			{
+				// pinned above, so the block can't be evicted
+				Block &b = blocks[BlockKey(node->getHandle(), i)];
+				cv.wait(lock, [&b]{ return b.ready; });
+
+				size_t skip = i == first ? (size_t)(offset - first * BLOCKSIZE) : 0;
+				if (b.failed || b.data.size() <= skip)
+				{
+					b.failed = true;
+					failed = true;
+				}
+				else if (!failed)
+				{
+					size_t len = std::min(b.data.size() - skip, size - done);
+					memcpy(buf + done, b.data.data() + skip, len);
+					done += len;
+				}
+
+				lru.splice(lru.begin(), lru, b.lru);
+
+				// failed blocks are dropped (and fetched again by the next read)
+				if (!--b.readers && b.failed)
+				{
+					lru.erase(b.lru);
+					blocks.erase(BlockKey(node->getHandle(), i));
+				}
+			}
+
+			return failed ? -1 : (int)done;
+		}
+
+	private:
+		typedef std::pair<mega::MegaHandle, int64_t> BlockKey;
+
+		struct Block
+		{
+			std::string data;
+			bool ready;
+			bool failed;
+
+			// reads waiting for or copying the block
+			int readers;
+			std::list<BlockKey>::iterator lru;
+		};
+
+		// receives the data of a block, deletes itself once the block is complete
+		class Listener : public mega::MegaTransferListener
+		{
+			public:
+				Listener(BlockCache *cache, mega::MegaHandle h, int64_t index, std::string *data)
+					: cache(cache), h(h), index(index), data(data)
+				{
+				}
+
+				bool onTransferData(mega::MegaApi *api, mega::MegaTransfer *transfer, char *buffer, size_t s)
+				{
+					// the block isn't accessed by readers until it's ready
+					data->append(buffer, s);
+					return true;
+				}
+
+				void onTransferFinish(mega::MegaApi *api, mega::MegaTransfer *transfer, mega::MegaError *error)
+				{
+					cache->completed(h, index, error->getErrorCode() == mega::MegaError::API_OK);
+					delete this;
+				}
+
+			private:
+				BlockCache *cache;
+				mega::MegaHandle h;
+				int64_t index;
+				std::string *data;
+		};
+
+		// add the block if not present, true if it has to be fetched
+		bool request(mega::MegaHandle h, int64_t index)
+		{
+			BlockKey key(h, index);
+			if (blocks.find(key) != blocks.end())
+			{
+				return false;
+			}
+
+			Block &b = blocks[key];
+			b.ready = false;
+			b.failed = false;
+			b.readers = 0;
+			b.lru = lru.insert(lru.begin(), key);
+			return true;
+		}
+
+		void start(mega::MegaNode *node, int64_t index)
+		{
+			int64_t offset = index * BLOCKSIZE;
+			int64_t size = std::min(BLOCKSIZE, node->getSize() - offset);
+			std::string *data;
+
+			{
+				// pending blocks aren't evicted, so the buffer remains valid
+				std::unique_lock<std::mutex> lock(m);
+				Block &b = blocks[BlockKey(node->getHandle(), index)];
+				b.data.reserve((size_t)size);
+				data = &b.data;
+			}
+
+			api->startStreaming(node, offset, size, new Listener(this, node->getHandle(), index, data));
+		}
+
+		// called from the SDK thread once a block has been fetched
+		void completed(mega::MegaHandle h, int64_t index, bool ok)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m);
+				std::map<BlockKey, Block>::iterator it = blocks.find(BlockKey(h, index));
+				if (it != blocks.end())
+				{
+					it->second.ready = true;
+					it->second.failed = !ok;
+				}
+				evict();
+			}
+			cv.notify_all();
+		}
+
+		// drop the least recently used blocks that are neither pending nor
+		// being read
+		void evict()
+		{
+			std::list<BlockKey>::iterator it = lru.end();
+			while (blocks.size() > CAPACITY && it != lru.begin())
+			{
+				--it;
+				std::map<BlockKey, Block>::iterator bit = blocks.find(*it);
+				if (bit->second.ready && !bit->second.readers)
+				{
+					blocks.erase(bit);
+					it = lru.erase(it);
+				}
+			}
+		}
+
+		mega::MegaApi *api;
+
+		std::map<BlockKey, Block> blocks;
+
+		// most recently used first
+		std::list<BlockKey> lru;
+
+		std::condition_variable cv;
+		std::mutex m;
+};
+
+// sequential access detection of an open file: the read-ahead window
+// doubles with each sequential read (up to MAXBLOCKS) and is dropped by a
+// seek
+class ReadAhead
+{
+	public:
+		static const int MAXBLOCKS = 8;
+
+		ReadAhead() : nextoffset(0), window(0)
+		{
+		}
+
+		// register a read, returns the number of blocks to read ahead
+		int next(int64_t offset, size_t size)
+		{
+			std::unique_lock<std::mutex> lock(m);
+			if (offset == nextoffset)
+			{
+				window = window ? std::min(window * 2, (int)MAXBLOCKS) : 1;
+			}
+			else
+			{
+				window = 0;
+			}
+			nextoffset = offset + size;
+			return window;
+		}
+
+	private:
+		// end of the last read
+		int64_t nextoffset;
+		int window;
+		std::mutex m;
+};
+
+#endif
@@ -20,10 +20,14 @@
  */
 
 // This example implements the following operations: getattr, readdir,
-// open, read, mkdir, rmdir, unlink and rename.
+// open, release, read, mkdir, rmdir, unlink and rename.
 // File writes are NOT supported yet.
-// There isn't any caching nor the implementation does any prefetching
-// to improve read performance.
+//
+// File data is read through the block cache and read-ahead shared with the
+// other filesystem examples (see examples/blockcache.h), FUSE serves the
+// requests from several threads.
+// The attributes and the listings of folders are cached for ATTRTTL
+// seconds, until a node changes.
 
 #define FUSE_USE_VERSION 30
 #include <fuse.h>
@@ -32,11 +36,15 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <megaapi.h>
+#include "../blockcache.h"
 #include <unistd.h>
 #include <termios.h>
+#include <time.h>
 #include <mutex>
 #include <condition_variable>
 #include <iostream>
+#include <map>
+#include <vector>
 
 using namespace mega;
 using namespace std;
@@ -105,83 +113,54 @@ class SynchronousRequestListener : public MegaRequestListener
 		mutex m;
 };
 
-class SynchronousTransferListener : public MegaTransferListener
+// lifetime of cached attributes and folder listings (in seconds)
+static const time_t ATTRTTL = 30;
+
+BlockCache *blockCache;
+
+// state of each open file (fuse_file_info::fh)
+struct OpenFile
+{
+	MegaNode *node;
+	ReadAhead readahead;
+};
+
+struct CachedAttr
+{
+	// false: the path doesn't exist
+	bool exists;
+	struct stat st;
+	time_t expires;
+};
+
+struct CachedListing
+{
+	vector<string> names;
+	time_t expires;
+};
+
+// attributes and folder listings by path
+map<string, CachedAttr> attrCache;
+map<string, CachedListing> listingCache;
+mutex metaMutex;
+
+static void invalidateMetadata()
+{
+	unique_lock<mutex> lock(metaMutex);
+	attrCache.clear();
+	listingCache.clear();
+}
+
+// any change of the tree drops the cached attributes and listings - file
+// contents don't change under a node handle, so cached blocks remain valid
+class MetadataListener : public MegaGlobalListener
 {
 	public:
-		SynchronousTransferListener()
-		{
-			transfer = NULL;
-			error = NULL;
-			notified = false;
-		}
-		
-		~SynchronousTransferListener()
-		{
-			delete transfer;
-			delete error;
-		}
-		
-		void onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *error) 
-		{
-			this->error = error->copy();
-			this->transfer = transfer->copy();
-		
-			{
-				unique_lock<mutex> lock(m);
-				notified = true;
-			}
-			cv.notify_all();
-		}
-				
-		bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t s)
-		{
-			data.append(buffer, s);
-			return true;
-		}
-		
-		void wait() 
-		{
-			unique_lock<mutex> lock(m);
-			cv.wait(lock, [this]{return notified;});
-		}
-		
-		void reset()
-		{
-			delete transfer;
-			delete error;
-			transfer = NULL;
-			error = NULL;
-			notified = false;
-		}
-		
-		MegaTransfer *getTransfer()
-		{
-			return transfer;
-		}
-		
-		MegaError *getError()
-		{
-			return error;
-		}
-		
-		const char *getData()
-		{
-			return data.data();
-		}
-		
-		long long getDataSize()
+		void onNodesUpdate(MegaApi *api, MegaNodeList *nodes)
 		{
-			return data.size();
+			invalidateMetadata();
 		}
-		
-	private:
-		bool notified;
-		MegaError *error;
-		MegaTransfer *transfer;
-		string data;
-		condition_variable cv;
-		mutex m;
-};
+} metadataListener;
 
 static int MEGAgetattr(const char *p, struct stat *stbuf)
 {
@@ -189,13 +168,35 @@ static int MEGAgetattr(const char *p, struct stat *stbuf)
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Getting attributes:");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
 
+	time_t now = time(NULL);
+	{
+		unique_lock<mutex> lock(metaMutex);
+		map<string, CachedAttr>::iterator it = attrCache.find(path);
+		if (it != attrCache.end() && it->second.expires > now)
+		{
+			if (!it->second.exists)
+			{
+				return -ENOENT;
+			}
+
+			*stbuf = it->second.st;
+			return 0;
+		}
+	}
+
 	MegaNode *n = megaApi->getNodeByPath(path.c_str());
 	if (!n)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Node not found");
+
+		unique_lock<mutex> lock(metaMutex);
+		CachedAttr &attr = attrCache[path];
+		attr.exists = false;
+		attr.expires = now + ATTRTTL;
 		return -ENOENT;
 	}
 	
+	memset(stbuf, 0, sizeof *stbuf);
 	stbuf->st_uid = getuid();
 	stbuf->st_gid = getgid();
 	stbuf->st_mode = n->isFile() ? S_IFREG | 0444 : S_IFDIR | 0755;
@@ -204,6 +205,15 @@ static int MEGAgetattr(const char *p, struct stat *stbuf)
 	stbuf->st_mtime = n->isFile() ? n->getModificationTime() : n->getCreationTime();
 		
 	delete n;
+
+	{
+		unique_lock<mutex> lock(metaMutex);
+		CachedAttr &attr = attrCache[path];
+		attr.exists = true;
+		attr.st = *stbuf;
+		attr.expires = now + ATTRTTL;
+	}
+
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Attributes read OK");
 	return 0;
 }
@@ -244,6 +254,7 @@ static int MEGAmkdir(const char *p, mode_t mode)
 	megaApi->createFolder(path.c_str() + index + 1, n, &listener);
 	listener.wait();
 	delete n;
+	invalidateMetadata();
 	
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -286,6 +297,7 @@ static int MEGArmdir(const char *p)
 	megaApi->remove(n, &listener);
 	listener.wait();
 	delete n;
+	invalidateMetadata();
 	
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -322,6 +334,7 @@ static int MEGAunlink(const char *p)
 	megaApi->remove(n, &listener);
 	listener.wait();
 	delete n;
+	invalidateMetadata();
 	
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -367,6 +380,7 @@ static int MEGArename(const char *f, const char *t)
 			listener.wait();
 			delete source;
 			delete dest;
+			invalidateMetadata();
 			
 			if (listener.getError()->getErrorCode() != MegaError::API_OK)
 			{
@@ -420,6 +434,7 @@ static int MEGArename(const char *f, const char *t)
 	megaApi->moveNode(source, dest, &listener);
 	listener.wait();
 	delete dest;
+	invalidateMetadata();
 	
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -434,6 +449,7 @@ static int MEGArename(const char *f, const char *t)
 		listener.reset();
 		megaApi->renameNode(source, destname.c_str(), &listener);
 		listener.wait();
+		invalidateMetadata();
 		
 		if(listener.getError()->getErrorCode() != MegaError::API_OK)
 		{
@@ -456,52 +472,96 @@ static int MEGAreaddir(const char *p, void *buf, fuse_fill_dir_t filler,
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Listing folder:");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
 
-	MegaNode *node = megaApi->getNodeByPath(path.c_str());
-	if (!node)
+	time_t now = time(NULL);
+	vector<string> names;
+	bool cached = false;
 	{
-		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Folder not found");
-		return -ENOENT;
+		unique_lock<mutex> lock(metaMutex);
+		map<string, CachedListing>::iterator it = listingCache.find(path);
+		if (it != listingCache.end() && it->second.expires > now)
+		{
+			names = it->second.names;
+			cached = true;
+		}
+	}
+
+	if (!cached)
+	{
+		MegaNode *node = megaApi->getNodeByPath(path.c_str());
+		if (!node)
+		{
+			MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Folder not found");
+			return -ENOENT;
+		}
+
+		MegaNodeList *children = megaApi->getChildren(node);
+		for (int i=0; i<children->size(); i++)
+		{
+			names.push_back(children->get(i)->getName());
+		}
+
+		delete node;
+		delete children;
+
+		unique_lock<mutex> lock(metaMutex);
+		CachedListing &listing = listingCache[path];
+		listing.names = names;
+		listing.expires = now + ATTRTTL;
 	}
 	
 	filler(buf, ".", NULL, 0);
 	filler(buf, "..", NULL, 0);
-	MegaNodeList *children = megaApi->getChildren(node);
-	for (int i=0; i<children->size(); i++)
+	for (size_t i=0; i<names.size(); i++)
 	{
-		MegaNode *n = children->get(i);
-		filler(buf, n->getName(), NULL, 0);
-		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, n->getName());
+		filler(buf, names[i].c_str(), NULL, 0);
+		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, names[i].c_str());
 	}
-	
-	delete node;
-	delete children;
 
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Folder listed OK");	
 	return 0;
 }
 
-static int MEGAopen(const char *path, struct fuse_file_info *fi)
-{
-    return 0;
-}
-
-static int MEGAread(const char *p, char *buf, size_t size, off_t offset,
-                      struct fuse_file_info *fi)
+static int MEGAopen(const char *p, struct fuse_file_info *fi)
 {
 	string path = megaBasePath + p;
-	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Reading file:");
-	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
-        	
+
 	MegaNode *node = megaApi->getNodeByPath(path.c_str());
 	if (!node)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File not found");
 		return -ENOENT;
-	}	
-	
-	if (offset >= node->getSize())
+	}
+
+	if (!node->isFile())
 	{
 		delete node;
+		return -EISDIR;
+	}
+
+	OpenFile *file = new OpenFile;
+	file->node = node;
+	fi->fh = (uint64_t)file;
+	return 0;
+}
+
+static int MEGArelease(const char *p, struct fuse_file_info *fi)
+{
+	OpenFile *file = (OpenFile *)fi->fh;
+	delete file->node;
+	delete file;
+	return 0;
+}
+
+static int MEGAread(const char *p, char *buf, size_t size, off_t offset,
+                      struct fuse_file_info *fi)
+{
+	OpenFile *file = (OpenFile *)fi->fh;
+	MegaNode *node = file->node;
+	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Reading file:");
+	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, p);
+
+	if (offset >= node->getSize() || !size)
+	{
 		return 0;
 	}
 	
@@ -509,26 +569,16 @@ static int MEGAread(const char *p, char *buf, size_t size, off_t offset,
 	{
 		size = node->getSize() - offset;
 	}
-	
-	SynchronousTransferListener listener;
-	megaApi->startStreaming(node, offset, size, &listener);
-	listener.wait();
-	delete node;
-	if (listener.getError()->getErrorCode() != MegaError::API_OK)
+
+	int result = blockCache->read(node, buf, size, offset, file->readahead.next(offset, size));
+	if (result < 0)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Transfer error");
 		return -EIO;
 	}
-	
-	if (listener.getDataSize() != size)
-	{
-		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Internal error");
-		return -EIO;
-	}
-	
-	memcpy(buf, listener.getData(), size);
+
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File read OK");
-    return size;
+    return result;
 }
 
 int main(int argc, char *argv[])
@@ -616,6 +666,8 @@ int main(int argc, char *argv[])
 	}
 		
 	MegaApi::log(MegaApi::LOG_LEVEL_INFO, "MEGA initialization complete!");	
+	megaApi->addGlobalListener(&metadataListener);
+	blockCache = new BlockCache(megaApi);
 	megaApi->setLogLevel(MegaApi::LOG_LEVEL_WARNING);
 
 	//Start FUSE
@@ -623,12 +675,14 @@ int main(int argc, char *argv[])
     ops.getattr     = MEGAgetattr;
     ops.readdir     = MEGAreaddir;
     ops.open        = MEGAopen;
+    ops.release     = MEGArelease;
     ops.read		= MEGAread;
     ops.mkdir		= MEGAmkdir;
     ops.rmdir		= MEGArmdir;
     ops.unlink		= MEGAunlink;
 	ops.rename		= MEGArename;
     
+	// no "-s": FUSE serves the requests from several threads
 	char *fuseargv[3] = { argv[0], (char *)"-f", (char *)mountpoint.c_str()};
     return fuse_main(3, fuseargv, &ops, NULL);
 }
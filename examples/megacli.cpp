@@ -28,6 +28,10 @@
 #include <readline/history.h>
 #include <iomanip>
 
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
 using namespace mega;
 
 MegaClient* client;
@@ -108,11 +112,163 @@ const char* errorstring(error e)
     }
 }
 
+// running benchmark (bench command): synthetic transfers measured through
+// the engine's chunk timings and counters
+static struct BenchRun
+{
+    // "put", "get", "stream" or NULL if idle
+    const char* type;
+
+    int pending;
+    int total;
+    int failed;
+
+    // transfer failures (retried or not)
+    unsigned retries;
+
+    m_off_t bytes;
+    int64_t start;
+    int64_t cpustart;
+    m_off_t chunkfailures;
+
+    // local scratch files to remove once done
+    vector<string> scratch;
+} bench;
+
+// process CPU time in microseconds (-1: not available)
+static int64_t cpuus()
+{
+#ifndef _WIN32
+    struct rusage ru;
+
+    if (!getrusage(RUSAGE_SELF, &ru))
+    {
+        return (int64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000
+             + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+    }
+#endif
+
+    return -1;
+}
+
+// upper bound in ms of the bucket holding the fraction p of the samples of
+// a ChunkTimingStats histogram (0: < 1 ms)
+static m_off_t histpercentile(const m_off_t* histogram, m_off_t samples, double p)
+{
+    m_off_t seen = 0;
+
+    for (int i = 0; i < ChunkTimingStats::NUMBUCKETS; i++)
+    {
+        seen += histogram[i];
+
+        if (seen >= samples * p)
+        {
+            return i ? (m_off_t)1 << i : 0;
+        }
+    }
+
+    return (m_off_t)1 << ChunkTimingStats::NUMBUCKETS;
+}
+
+static void benchstart(const char* type, int total)
+{
+    bench.type = type;
+    bench.pending = total;
+    bench.total = total;
+    bench.failed = 0;
+    bench.retries = 0;
+    bench.bytes = 0;
+    bench.chunkfailures = client->enginestats.chunkfailures;
+    bench.cpustart = cpuus();
+
+    client->chunktimings[GET].reset();
+    client->chunktimings[PUT].reset();
+
+    bench.start = Waiter::us();
+}
+
+static void benchreport()
+{
+    double secs = (Waiter::us() - bench.start) / 1000000.0;
+    int64_t cpu = cpuus();
+    ChunkTimingStats* timings = client->chunktimings + (strcmp(bench.type, "put") ? GET : PUT);
+    m_off_t samples = timings->samples[TIMING_TOTAL];
+
+    cout << fixed << setprecision(2);
+    cout << "bench " << bench.type << ": " << bench.total << " transfer(s), " << bench.failed << " failed, "
+         << bench.bytes << " byte(s) in " << secs << " s, "
+         << (secs > 0 ? bench.bytes / secs / 1048576 : 0) << " MB/s" << endl;
+
+    if (samples)
+    {
+        cout << "  chunk latency (ms): p50 <= " << histpercentile(timings->histogram[TIMING_TOTAL], samples, 0.5)
+             << ", p90 <= " << histpercentile(timings->histogram[TIMING_TOTAL], samples, 0.9)
+             << ", p99 <= " << histpercentile(timings->histogram[TIMING_TOTAL], samples, 0.99)
+             << ", max " << timings->max[TIMING_TOTAL] / 1000 << " (" << samples << " chunks)" << endl;
+    }
+
+    if (cpu >= 0 && bench.cpustart >= 0)
+    {
+        double cpusecs = (cpu - bench.cpustart) / 1000000.0;
+
+        cout << "  CPU: " << cpusecs << " s";
+
+        if (bench.bytes)
+        {
+            cout << " (" << cpusecs * 1073741824 / bench.bytes << " s/GB)";
+        }
+
+        cout << endl;
+    }
+
+    cout << "  retries: " << bench.retries << " transfer, "
+         << client->enginestats.chunkfailures - bench.chunkfailures << " chunk" << endl;
+    cout.unsetf(ios::floatfield);
+
+    for (unsigned i = 0; i < bench.scratch.size(); i++)
+    {
+        client->fsaccess->unlinklocal(&bench.scratch[i]);
+    }
+
+    bench.scratch.clear();
+    bench.type = NULL;
+}
+
+// a benchmark transfer or read is done
+static void benchfinished(bool ok, m_off_t bytes)
+{
+    if (!bench.type)
+    {
+        return;
+    }
+
+    if (ok)
+    {
+        bench.bytes += bytes;
+    }
+    else
+    {
+        bench.failed++;
+    }
+
+    if (!--bench.pending)
+    {
+        benchreport();
+    }
+}
+
+// parallel ranged read of a file (bench stream)
+struct BenchRead
+{
+    m_off_t remaining;
+};
+
 AppFile::AppFile()
 {
     static int nextseqno;
 
     seqno = ++nextseqno;
+    bench = false;
 }
 
 // transfer start
@@ -131,9 +287,14 @@ bool AppFile::failed(error e)
 }
 
 // transfer completion
-void AppFileGet::completed(Transfer*, LocalNode*)
+void AppFileGet::completed(Transfer* t, LocalNode*)
 {
     // (at this time, the file has already been placed in the final location)
+    if (bench)
+    {
+        benchfinished(true, t->size);
+    }
+
     delete this;
 }
 
@@ -142,9 +303,23 @@ void AppFilePut::completed(Transfer* t, LocalNode*)
     // perform standard completion (place node in user filesystem etc.)
     File::completed(t, NULL);
 
+    if (bench)
+    {
+        benchfinished(true, t->size);
+    }
+
     delete this;
 }
 
+// transfer failed permanently
+void AppFile::terminated()
+{
+    if (bench)
+    {
+        benchfinished(false, 0);
+    }
+}
+
 AppFileGet::~AppFileGet()
 {
     appxferq[GET].erase(appxfer_it);
@@ -202,6 +377,11 @@ void DemoApp::transfer_update(Transfer* t)
 
 void DemoApp::transfer_failed(Transfer* t, error e)
 {
+    if (bench.type)
+    {
+        bench.retries++;
+    }
+
     displaytransferdetails(t, "failed (");
     cout << errorstring(e) << ")" << endl;
 }
@@ -1085,7 +1265,7 @@ static void dumptree(Node* n, int recurse, int depth = 0, const char* title = NU
 
     if (n->type != FILENODE)
     {
-        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        for (node_vector::iterator it = n->children.begin(); it != n->children.end(); it++)
         {
             dumptree(*it, recurse, depth + 1);
         }
@@ -1524,6 +1704,9 @@ static void process_line(char* l)
                 cout << "      pause [get|put] [hard] [status]" << endl;
                 cout << "      getfa type [path] [cancel]" << endl;
                 cout << "      mkdir remotepath" << endl;
+                cout << "      bench put count size [dstremotepath]" << endl;
+                cout << "      bench get [remotepath [count]]" << endl;
+                cout << "      bench stream remotepath [count]" << endl;
                 cout << "      rm remotepath" << endl;
                 cout << "      mv srcremotepath dstremotepath" << endl;
                 cout << "      cp srcremotepath dstremotepath|dstemail:" << endl;
@@ -1896,8 +2079,6 @@ static void process_line(char* l)
                     }
                     else if (words[0] == "du")
                     {
-                        TreeProcDU du;
-
                         if (words.size() > 1)
                         {
                             if (!(n = nodebypath(words[1].c_str())))
@@ -1914,11 +2095,9 @@ static void process_line(char* l)
 
                         if (n)
                         {
-                            client->proctree(n, &du);
-
-                            cout << "Total storage used: " << (du.numbytes / 1048576) << " MB" << endl;
-                            cout << "Total # of files: " << du.numfiles << endl;
-                            cout << "Total # of folders: " << du.numfolders << endl;
+                            cout << "Total storage used: " << (n->treebytes / 1048576) << " MB" << endl;
+                            cout << "Total # of files: " << n->treefiles << endl;
+                            cout << "Total # of folders: " << n->treefolders << endl;
                         }
 
                         return;
@@ -1959,7 +2138,7 @@ static void process_line(char* l)
                                     else
                                     {
                                         // ...or all files in the specified folder (non-recursive)
-                                        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+                                        for (node_vector::iterator it = n->children.begin(); it != n->children.end(); it++)
                                         {
                                             if ((*it)->type == FILENODE)
                                             {
@@ -2555,7 +2734,7 @@ static void process_line(char* l)
                                 }
                                 else
                                 {
-                                    for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+                                    for (node_vector::iterator it = n->children.begin(); it != n->children.end(); it++)
                                     {
                                         if ((*it)->type == FILENODE && (*it)->hasfileattribute(type))
                                         {
@@ -2779,6 +2958,195 @@ static void process_line(char* l)
 
                         return;
                     }
+                    else if (words[0] == "bench")
+                    {
+                        if (bench.type)
+                        {
+                            cout << "bench " << bench.type << ": " << bench.pending << " of " << bench.total
+                                 << " transfer(s) pending, " << bench.bytes << " byte(s) so far" << endl;
+
+                            return;
+                        }
+
+                        if (words.size() > 3 && words[1] == "put")
+                        {
+                            // count synthetic files of size random bytes,
+                            // written to the local folder and uploaded in
+                            // parallel
+                            int count = atoi(words[2].c_str());
+                            m_off_t size = atoll(words[3].c_str());
+                            handle target = cwd;
+
+                            if (words.size() > 4)
+                            {
+                                if (!(n = nodebypath(words[4].c_str())) || n->type == FILENODE)
+                                {
+                                    cout << words[4] << ": No such folder" << endl;
+
+                                    return;
+                                }
+
+                                target = n->nodehandle;
+                            }
+
+                            if (count <= 0 || size < 0 || ISUNDEF(target))
+                            {
+                                cout << "      bench put count size [dstremotepath]" << endl;
+
+                                return;
+                            }
+
+                            byte* buf = new byte[1048576];
+                            vector<string> names;
+
+                            for (int i = 0; i < count; i++)
+                            {
+                                ostringstream oss;
+                                string name, localname;
+
+                                oss << "bench_" << i << "_" << size;
+                                name = oss.str();
+                                localname = name;
+                                client->fsaccess->name2local(&localname);
+
+                                FileAccess* fa = client->fsaccess->newfileaccess();
+                                bool ok = fa->fopen(&localname, false, true);
+
+                                for (m_off_t pos = 0; ok && pos < size; pos += 1048576)
+                                {
+                                    unsigned len = (unsigned)min((m_off_t)1048576, size - pos);
+
+                                    PrnGen::genblock(buf, len);
+                                    ok = fa->fwrite(buf, len, pos);
+                                }
+
+                                delete fa;
+
+                                if (!ok)
+                                {
+                                    cout << name << ": Can't write the local scratch file" << endl;
+                                    client->fsaccess->unlinklocal(&localname);
+                                    break;
+                                }
+
+                                names.push_back(localname);
+                            }
+
+                            delete[] buf;
+
+                            if ((int)names.size() < count)
+                            {
+                                for (unsigned i = 0; i < names.size(); i++)
+                                {
+                                    client->fsaccess->unlinklocal(&names[i]);
+                                }
+
+                                return;
+                            }
+
+                            benchstart("put", count);
+                            bench.scratch = names;
+
+                            for (int i = 0; i < count; i++)
+                            {
+                                AppFile* f = new AppFilePut(&names[i], target, "");
+
+                                f->bench = true;
+                                f->appxfer_it = appxferq[PUT].insert(appxferq[PUT].end(), f);
+                                client->startxfer(PUT, f);
+                            }
+
+                            cout << "Uploading " << count << " file(s) of " << size << " byte(s)..." << endl;
+
+                            return;
+                        }
+                        else if (words.size() > 1 && words[1] == "get")
+                        {
+                            // download the files of the folder (up to count)
+                            // to local scratch files in parallel
+                            n = words.size() > 2 ? nodebypath(words[2].c_str()) : client->nodebyhandle(cwd);
+                            int count = words.size() > 3 ? atoi(words[3].c_str()) : 0;
+                            vector<Node*> files;
+
+                            if (!n || n->type == FILENODE)
+                            {
+                                cout << "      bench get [remotepath [count]]" << endl;
+
+                                return;
+                            }
+
+                            for (node_vector::iterator it = n->children.begin(); it != n->children.end(); it++)
+                            {
+                                if ((*it)->type == FILENODE && (count <= 0 || (int)files.size() < count))
+                                {
+                                    files.push_back(*it);
+                                }
+                            }
+
+                            if (!files.size())
+                            {
+                                cout << "No files to download" << endl;
+
+                                return;
+                            }
+
+                            benchstart("get", files.size());
+
+                            for (unsigned i = 0; i < files.size(); i++)
+                            {
+                                AppFile* f = new AppFileGet(files[i]);
+
+                                client->fsaccess->tmpnamelocal(&f->localname);
+                                bench.scratch.push_back(f->localname);
+
+                                f->bench = true;
+                                f->appxfer_it = appxferq[GET].insert(appxferq[GET].end(), f);
+                                client->startxfer(GET, f);
+                            }
+
+                            cout << "Downloading " << files.size() << " file(s)..." << endl;
+
+                            return;
+                        }
+                        else if (words.size() > 2 && words[1] == "stream")
+                        {
+                            // read the file in count parallel ranges
+                            // without storing it
+                            int count = words.size() > 3 ? atoi(words[3].c_str()) : 1;
+
+                            n = nodebypath(words[2].c_str());
+
+                            if (!n || n->type != FILENODE || n->size <= 0 || count <= 0)
+                            {
+                                cout << "      bench stream remotepath [count]" << endl;
+
+                                return;
+                            }
+
+                            m_off_t range = (n->size + count - 1) / count;
+                            int ranges = (int)((n->size + range - 1) / range);
+
+                            benchstart("stream", ranges);
+
+                            for (m_off_t pos = 0; pos < n->size; pos += range)
+                            {
+                                BenchRead* r = new BenchRead;
+
+                                r->remaining = min(range, n->size - pos);
+                                client->pread(n, pos, r->remaining, r);
+                            }
+
+                            cout << "Streaming " << n->size << " byte(s) in " << ranges << " range(s)..." << endl;
+
+                            return;
+                        }
+
+                        cout << "      bench put count size [dstremotepath]" << endl
+                             << "      bench get [remotepath [count]]" << endl
+                             << "      bench stream remotepath [count]" << endl;
+
+                        return;
+                    }
                     break;
 
                 case 6:
@@ -3458,6 +3826,21 @@ void DemoApp::checkfile_result(handle h, error e, byte* filekey, m_off_t size, m
 
 bool DemoApp::pread_data(byte* data, m_off_t len, m_off_t pos, void* appdata)
 {
+    if (appdata)
+    {
+        BenchRead* r = (BenchRead*)appdata;
+
+        bench.bytes += len;
+
+        if ((r->remaining -= len) <= 0)
+        {
+            delete r;
+            benchfinished(true, 0);
+        }
+
+        return true;
+    }
+
     cout << "Received " << len << " partial read byte(s) at position " << pos << ": ";
     fwrite(data, 1, len, stdout);
     cout << endl;
@@ -3467,6 +3850,22 @@ bool DemoApp::pread_data(byte* data, m_off_t len, m_off_t pos, void* appdata)
 
 dstime DemoApp::pread_failure(error e, int retry, void* appdata)
 {
+    if (appdata)
+    {
+        bench.retries++;
+
+        if (retry < 5)
+        {
+            return (dstime)(retry*10);
+        }
+
+        // (the data received so far remains accounted for)
+        delete (BenchRead*)appdata;
+        benchfinished(false, 0);
+
+        return ~(dstime)0;
+    }
+
     if (retry < 5)
     {
         cout << "Retrying read (" << errorstring(e) << ", attempt #" << retry << ")" << endl;
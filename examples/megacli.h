@@ -38,8 +38,12 @@ struct AppFile : public File
     // app-internal sequence number for queue management
     int seqno;
 
+    // part of a bench run
+    bool bench;
+
     bool failed(error);
     void progress();
+    void terminated();
 
     appfile_list::iterator appxfer_it;
 
@@ -21,14 +21,20 @@
 
 // This isn't a final product, please use it for testing/development purposes only.
 // File writes are NOT supported yet.
-// There isn't any caching nor the implementation does any prefetching
-// to improve read performance so the performance will be poor for many operations.
+// File data is read through the block cache and read-ahead shared with the
+// other filesystem examples (see examples/blockcache.h), Dokan serves the
+// requests from several threads. Folder listings are cached until a node
+// changes.
 
 #include <windows.h>
 #include <iostream>
 #include <string>
+#include <map>
+#include <mutex>
+#include <vector>
 #include <megaapi.h>
 #include <dokan.h>
+#include "../../blockcache.h"
 
 using namespace mega;
 using namespace std;
@@ -55,6 +61,24 @@ const wchar_t DRIVE_LABEL[] = L"MEGA";
 //Global variables
 MegaApi* megaApi;
 string megaBasePath;
+BlockCache* blockCache;
+
+//State of each open file or folder (DOKAN_FILE_INFO::Context)
+struct OpenFile
+{
+	MegaNode *node;
+	ReadAhead readahead;
+};
+
+//Results of MEGAFindFiles by path
+map<string, vector<WIN32_FIND_DATAW> > findCache;
+mutex findMutex;
+
+static void invalidateFindCache()
+{
+	unique_lock<mutex> lock(findMutex);
+	findCache.clear();
+}
 
 //Helper objects
 class SynchronousRequestListener : public MegaRequestListener
@@ -119,83 +143,14 @@ private:
 	HANDLE finished;
 };
 
-class SynchronousTransferListener : public MegaTransferListener
+//Any change of the tree drops the cached listings
+class NodesListener : public MegaGlobalListener
 {
 public:
-	SynchronousTransferListener()
-	{
-		transfer = NULL;
-		error = NULL;
-		notified = false;
-		finished = CreateEvent(NULL, FALSE, FALSE, NULL);;
-	}
-
-	~SynchronousTransferListener()
-	{
-		delete transfer;
-		delete error;
-		CloseHandle(finished);
-	}
-
-	void onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *error)
-	{
-		this->error = error->copy();
-		this->transfer = transfer->copy();
-
-		notified = true;
-		SetEvent(finished);
-	}
-
-	bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t s)
-	{
-		data.append(buffer, s);
-		return true;
-	}
-
-	void wait()
-	{
-		while (!notified)
-		{
-			WaitForSingleObject(finished, INFINITE);
-		}
-	}
-
-	void reset()
-	{
-		delete transfer;
-		delete error;
-		transfer = NULL;
-		error = NULL;
-		notified = false;
-		ResetEvent(finished);
-	}
-
-	MegaTransfer *getTransfer()
-	{
-		return transfer;
-	}
-
-	MegaError *getError()
+	void onNodesUpdate(MegaApi *api, MegaNodeList *nodes)
 	{
-		return error;
-	}
-
-	const char *getData()
-	{
-		return data.data();
-	}
-
-	long long getDataSize()
-	{
-		return data.size();
+		invalidateFindCache();
 	}
-
-private:
-	bool notified;
-	MegaError *error;
-	MegaTransfer *transfer;
-	string data;
-	HANDLE finished;
 };
 ////
 
@@ -240,9 +195,9 @@ static int __stdcall MEGACreateFile(
 		return -ERROR_FILE_NOT_FOUND;
 	}
 
-	DokanFileInfo->Context = (ULONG64)node->getHandle();
-	
-	delete node;
+	OpenFile *file = new OpenFile;
+	file->node = node;
+	DokanFileInfo->Context = (ULONG64)file;
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGACreateFile OK");
 	return 0;
 }
@@ -287,6 +242,7 @@ static int __stdcall MEGACreateDirectory(
 	megaApi->createFolder(path.c_str() + index + 1, n, &listener);
 	listener.wait();
 	delete n;
+	invalidateFindCache();
 
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -316,9 +272,9 @@ static int __stdcall MEGAOpenDirectory(
 		return -ERROR_PATH_NOT_FOUND;
 	}
 
-	DokanFileInfo->Context = node->getHandle();
-	
-	delete node;
+	OpenFile *file = new OpenFile;
+	file->node = node;
+	DokanFileInfo->Context = (ULONG64)file;
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGAOpenDirectory OK");
 	return 0;
 }
@@ -332,6 +288,14 @@ static int __stdcall MEGACloseFile(
 	MEGAGetFilePath(&path, FileName);
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGACloseFile");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
+
+	OpenFile *file = (OpenFile *)DokanFileInfo->Context;
+	if (file)
+	{
+		delete file->node;
+		delete file;
+		DokanFileInfo->Context = 0;
+	}
 	return 0;
 }
 
@@ -361,22 +325,21 @@ static int __stdcall MEGAReadFile(
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGAReadFile");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
 
-	MegaNode *node = megaApi->getNodeByPath(path.c_str());
-	if (!node)
+	OpenFile *file = (OpenFile *)DokanFileInfo->Context;
+	if (!file)
 	{
-		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File not found");
+		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File not open");
 		return -ERROR_INVALID_HANDLE;
 	}
 
+	MegaNode *node = file->node;
 	if (!node->isFile())
 	{
-		delete node;
 		return -ERROR_INVALID_HANDLE;
 	}
 
 	if (offset >= node->getSize())
 	{
-		delete node;
 		return -ERROR_HANDLE_EOF;
 	}
 
@@ -389,19 +352,19 @@ static int __stdcall MEGAReadFile(
 		*ReadLength = size;
 	}
 
-	DokanResetTimeout(60000, DokanFileInfo);
-	SynchronousTransferListener listener;
-	megaApi->startStreaming(node, offset, *ReadLength, &listener);
-	listener.wait();
-	delete node;
+	if (!*ReadLength)
+	{
+		return 0;
+	}
 
-	if (listener.getError()->getErrorCode() != MegaError::API_OK || listener.getDataSize() != *ReadLength)
+	DokanResetTimeout(60000, DokanFileInfo);
+	int result = blockCache->read(node, (char *)Buffer, *ReadLength, offset, file->readahead.next(offset, *ReadLength));
+	if (result != (int)*ReadLength)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Transfer error");
 		return -ERROR_IO_DEVICE;
 	}
 
-	memcpy(Buffer, listener.getData(), *ReadLength);
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File read OK");
 	return 0;
 }
@@ -491,6 +454,29 @@ static int __stdcall MEGAFindFiles(
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGAFindFiles");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
 
+	vector<WIN32_FIND_DATAW> entries;
+	bool cached = false;
+	{
+		unique_lock<mutex> lock(findMutex);
+		map<string, vector<WIN32_FIND_DATAW> >::iterator it = findCache.find(path);
+		if (it != findCache.end())
+		{
+			entries = it->second;
+			cached = true;
+		}
+	}
+
+	if (cached)
+	{
+		for (size_t i = 0; i < entries.size(); i++)
+		{
+			FillFindData(&entries[i], DokanFileInfo);
+		}
+
+		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGAFindFiles OK (cached)");
+		return 0;
+	}
+
 	MegaNode *node = megaApi->getNodeByPath(path.c_str());
 	if (!node || node->isFile())
 	{
@@ -529,9 +515,15 @@ static int __stdcall MEGAFindFiles(
 
 		findData.cAlternateFileName[0] = 0;
 		FillFindData(&findData, DokanFileInfo);
+		entries.push_back(findData);
 	}
 
 	delete list;
+
+	{
+		unique_lock<mutex> lock(findMutex);
+		findCache[path] = entries;
+	}
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "MEGAFindFiles OK");
 	return 0;
 }
@@ -564,6 +556,7 @@ static int __stdcall MEGADeleteFile(
 	megaApi->remove(n, &listener);
 	listener.wait();
 	delete n;
+	invalidateFindCache();
 
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -610,6 +603,7 @@ static int __stdcall MEGADeleteDirectory(
 	megaApi->remove(n, &listener);
 	listener.wait();
 	delete n;
+	invalidateFindCache();
 
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -659,6 +653,7 @@ static int __stdcall MEGAMoveFile(
 			listener.wait();
 			delete source;
 			delete dest;
+			invalidateFindCache();
 
 			if (listener.getError()->getErrorCode() != MegaError::API_OK)
 			{
@@ -712,6 +707,7 @@ static int __stdcall MEGAMoveFile(
 	megaApi->moveNode(source, dest, &listener);
 	listener.wait();
 	delete dest;
+	invalidateFindCache();
 
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -726,6 +722,7 @@ static int __stdcall MEGAMoveFile(
 		listener.reset();
 		megaApi->renameNode(source, destname.c_str(), &listener);
 		listener.wait();
+		invalidateFindCache();
 
 		if (listener.getError()->getErrorCode() != MegaError::API_OK)
 		{
@@ -990,6 +987,10 @@ int main(int argc, char *argv[])
 	}
 	MegaApi::log(MegaApi::LOG_LEVEL_INFO, "Fetchnodes OK");
 
+	NodesListener nodesListener;
+	megaApi->addGlobalListener(&nodesListener);
+	blockCache = new BlockCache(megaApi);
+
 	//Start Dokan
 	MegaApi::log(MegaApi::LOG_LEVEL_INFO, "Starting Dokan!");
 	if(!ENABLE_DEBUG)
@@ -1068,6 +1069,8 @@ int main(int argc, char *argv[])
 
 	free(dokanOptions);
 	free(dokanOperations);
+	megaApi->removeGlobalListener(&nodesListener);
 	delete megaApi;
+	delete blockCache;
 	return 0;
 }
@@ -36,6 +36,7 @@
 #include "mega/attrmap.h"
 #include "mega/backofftimer.h"
 #include "mega/base64.h"
+#include "mega/nodemap.h"
 #include "mega/command.h"
 #include "mega/console.h"
 #include "mega/fileattributefetch.h"
@@ -60,6 +61,14 @@
 #include "mega/sync.h"
 #include "mega/transfer.h"
 #include "mega/transferslot.h"
+#include "mega/transferscheduler.h"
+#include "mega/workerpool.h"
+#include "mega/bufferpool.h"
+#include "mega/bandwidth.h"
+#include "mega/crc32.h"
+#include "mega/aesbatch.h"
+#include "mega/gfxcache.h"
+#include "mega/transferstats.h"
 #include "mega/megaapp.h"
 #include "mega/megaclient.h"
 
@@ -70,6 +79,7 @@
 #include "megaconsole.h"
 #include "megaconsolewaiter.h"
 
+#include "mega/db/lmdb.h"
 #include "mega/db/sqlite.h"
 #include "mega/db/bdb.h"
 
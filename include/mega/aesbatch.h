@@ -0,0 +1,66 @@
+/**
+ * @file mega/aesbatch.h
+ * @brief Batched AES-128 under independent keys
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+
+#ifndef MEGA_AESBATCH_H
+#define MEGA_AESBATCH_H 1
+
+#include "types.h"
+
+namespace mega {
+// a batch of short AES-128 operations, each under its own key (node key
+// unwrapping, attribute and cache record decryption) - every job costs a
+// single key expansion, and with AES-NI the rounds of several jobs are
+// interleaved (multi-buffer), otherwise the jobs are run through the
+// installed CryptoBackend or Crypto++ one at a time
+class MEGA_API AesBatch
+{
+public:
+    enum op_t { ECB_ENCRYPT, ECB_DECRYPT, CBC_DECRYPT };
+
+    // in place, len is a multiple of the block size, CBC with the zero IV -
+    // the key is copied, the data must remain valid until run()
+    void add(const byte*, byte*, unsigned, op_t);
+
+    // process and clear the batch
+    void run();
+
+    size_t size() const { return jobs.size(); }
+
+    // are the AES-NI lanes in use?
+    static bool accelerated();
+
+protected:
+    struct Job
+    {
+        byte key[SymmCipher::KEYLENGTH];
+        byte* data;
+        unsigned len;
+        op_t op;
+    };
+
+    vector<Job> jobs;
+
+    void runsoftware(Job*, void**);
+};
+} // namespace
+
+#endif
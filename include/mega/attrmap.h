@@ -26,8 +26,56 @@
 
 namespace mega {
 
-// maps attribute names to attribute values
-typedef map<nameid, string> attr_map;
+// maps attribute names to attribute values - a compact replacement for
+// std::map<nameid, string>: nodes and users carry only a handful of
+// attributes, so the entries are kept sorted by name in a single array
+// (iteration order is the same as with std::map)
+//
+// provides the subset of the std::map interface used by the client;
+// insertions and erasures invalidate iterators and references
+class MEGA_API attr_map
+{
+public:
+    typedef pair<nameid, string> value_type;
+    typedef value_type* iterator;
+    typedef const value_type* const_iterator;
+
+    iterator begin() { return entries; }
+    iterator end() { return entries + count; }
+    const_iterator begin() const { return entries; }
+    const_iterator end() const { return entries + count; }
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+    // number of allocated entries
+    size_t allocated() const { return capacity; }
+
+    iterator find(nameid);
+    const_iterator find(nameid) const;
+
+    // lookup with insertion of an empty value if not present
+    string& operator[](nameid);
+
+    void erase(iterator);
+    size_t erase(nameid);
+
+    void clear();
+
+    attr_map& operator=(const attr_map&);
+
+    // allocate room for n entries
+    void reserve(unsigned);
+
+    attr_map() : entries(NULL), count(0), capacity(0) { }
+    attr_map(const attr_map&);
+    ~attr_map();
+
+protected:
+    value_type* entries;
+    unsigned short count;
+    unsigned short capacity;
+};
 
 struct MEGA_API AttrMap
 {
@@ -45,8 +93,9 @@ struct MEGA_API AttrMap
     // export as raw binary serialize
     void serialize(string*) const;
 
-    // import raw binary serialize
-    const char* unserialize(const char*);
+    // import raw binary serialize (bounded by end unless NULL), returns
+    // NULL if the data is truncated
+    const char* unserialize(const char*, const char* = NULL);
 };
 } // namespace
 
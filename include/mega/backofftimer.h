@@ -42,6 +42,10 @@ public:
     // set absolute backoff
     void backoff(dstime);
 
+    // set absolute backoff plus a random share of up to jitter (so that
+    // clients failing at the same time do not retry in lockstep)
+    void backoff(dstime, dstime jitter);
+
     // set absolute trigger time
     void set(dstime);
 
@@ -0,0 +1,130 @@
+/**
+ * @file mega/bandwidth.h
+ * @brief Client-side transfer bandwidth shaping
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_BANDWIDTH_H
+#define MEGA_BANDWIDTH_H 1
+
+#include "types.h"
+
+namespace mega {
+// token bucket refilled at rate bytes/s, holding up to capacity bytes
+struct MEGA_API TokenBucket
+{
+    m_off_t rate;
+    m_off_t capacity;
+
+    // available tokens (negative: debt)
+    m_off_t tokens;
+
+    dstime lastrefill;
+
+    void refill(dstime);
+
+    // reconfigure, keeping the accumulated tokens within the new capacity
+    void set(m_off_t, m_off_t);
+
+    TokenBucket();
+};
+
+// time-of-day bandwidth limit override
+struct MEGA_API BandwidthScheduleEntry
+{
+    // bitmask of weekdays (bit 0: Sunday)
+    int weekdays;
+
+    // [start, end) in minutes since local midnight (end < start wraps around)
+    int start;
+    int end;
+
+    // bytes per second, 0: unlimited
+    m_off_t rate;
+
+    bool active(struct tm*) const;
+};
+
+// client-side bandwidth limits per direction: a sustained rate with burst
+// allowance shared by all transfers, an optional per-transfer rate and
+// time-of-day schedules overriding the sustained rate
+//
+// the limits are enforced per chunk request: a request that can be covered
+// by the accumulated burst allowance runs at full speed, otherwise it is
+// capped to its share of the sustained rate (and of its transfer's rate)
+struct MEGA_API BandwidthShaper
+{
+    // sustained rate in bytes per second (0: unlimited)
+    m_off_t rate[2];
+
+    // per-transfer rate in bytes per second (0: unlimited)
+    m_off_t transferrate[2];
+
+    vector<BandwidthScheduleEntry> schedule[2];
+
+    TokenBucket buckets[2];
+
+    // configure the sustained rate and burst allowance
+    void setlimit(direction_t, m_off_t, m_off_t);
+
+    // add/remove time-of-day overrides (the first matching entry applies)
+    void addschedule(direction_t, BandwidthScheduleEntry*);
+    void clearschedule(direction_t);
+
+    // effective sustained rate at this time
+    m_off_t currentrate(direction_t);
+
+    // speed cap in bytes per second (0: none) for a request of the given size,
+    // given the number of requests in flight in its direction and transfer
+    m_off_t requestspeed(direction_t, m_off_t, int, int);
+
+    // QoS of streaming reads: rate in bytes per second guaranteed to each
+    // read that isn't paused, i.e. whose consumer is waiting for data (0:
+    // none) - while one receives less, bulk downloads back off
+    m_off_t streamingrate;
+
+    // streaming reads that received less than streamingrate in their last
+    // window (DirectReadSlot::qoscheck())
+    int starvedstreams;
+
+    // combined rate cap of bulk downloads (0: none), halved with each window
+    // in which a stream starved and raised by a quarter with each one in which
+    // it didn't - dropped once no streaming read reports for STREAMIDLE
+    m_off_t bulkcap;
+    dstime laststream;
+
+    static const m_off_t MINBULKRATE = 16384;
+    static const dstime STREAMIDLE = 50;
+
+    // a streaming read's window has ended, given the measured throughput of
+    // bulk downloads
+    void streamwindow(bool, m_off_t);
+
+    // bulk downloads don't start and use a single connection while set
+    bool bulkbackoff() const { return starvedstreams > 0; }
+
+    BandwidthShaper();
+
+protected:
+    // minutes since midnight and weekday of the last schedule evaluation
+    int schedulecheck;
+    m_off_t scheduledrate[2];
+};
+} // namespace
+
+#endif
@@ -34,6 +34,11 @@ class MEGA_API Base64
 public:
     static int btoa(const byte*, int, char*);
     static int atob(const char*, byte*, int);
+
+    // encode/decode a whole string straight into the result string (which is
+    // sized to fit) - returns the resulting length
+    static int btoa(const string&, string*);
+    static int atob(const string&, string*);
 };
 
 // lowercase base32 encoding
@@ -0,0 +1,180 @@
+/**
+ * @file mega/bufferpool.h
+ * @brief Pools of aligned transfer chunk buffers and of fixed-size objects
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_BUFFERPOOL_H
+#define MEGA_BUFFERPOOL_H 1
+
+#include "types.h"
+
+namespace mega {
+// size-classed pool of page-aligned chunk buffers shared by all transfer
+// requests of a MegaClient - buffers are obtained and returned on the
+// engine thread only (worker jobs just use the memory)
+struct MEGA_API ChunkBufferPool
+{
+    // buffer sizes are rounded up to multiples of this (one segment)
+    static const unsigned GRANULARITY = 131072;
+
+    // buffer alignment (suitable for unbuffered I/O)
+    static const unsigned ALIGNMENT = 4096;
+
+    // default ceiling for idle pooled memory
+    static const m_off_t DEFAULTLIMIT = 33554432;
+
+    // get a buffer of at least len bytes - its actual size is stored in *size
+    byte* get(unsigned len, unsigned* size);
+
+    // return a buffer obtained from get() - it is freed if keeping it would
+    // exceed the ceiling
+    void release(byte*, unsigned);
+
+    // set the ceiling for idle pooled memory (excess buffers are freed)
+    void setlimit(m_off_t);
+
+    // free all idle buffers
+    void clear();
+
+    // idle bytes currently pooled
+    m_off_t idle;
+
+    // bytes of the buffers handed out and not released yet
+    m_off_t inuse;
+
+    // ceiling for idle pooled memory
+    m_off_t limit;
+
+    static byte* allocaligned(unsigned);
+    static void freealigned(byte*);
+
+    ChunkBufferPool();
+    ~ChunkBufferPool();
+
+protected:
+    typedef map<unsigned, vector<byte*> > sizeclass_map;
+
+    sizeclass_map freebuffers;
+
+    // free idle buffers, largest first, until the ceiling is respected
+    void trim();
+};
+
+// SDK-wide ceiling for the data held in flight: transfer chunks, streaming
+// read pieces and file attribute uploads reserve their buffers before they
+// are started, and are held back while the budget is exhausted - engine
+// thread only
+struct MEGA_API MemoryBudget
+{
+    // bytes that may be reserved (0: unlimited)
+    m_off_t limit;
+
+    // bytes reserved
+    m_off_t used;
+
+    // reservations refused so far
+    unsigned denied;
+
+    // granted if it fits or nothing is reserved (so that a single request
+    // larger than the budget still proceeds)
+    bool reserve(m_off_t);
+    void release(m_off_t);
+
+    MemoryBudget();
+};
+
+// the share of a MemoryBudget held by one request, returned on destruction
+struct MEGA_API MemoryReservation
+{
+    MemoryBudget* budget;
+    m_off_t bytes;
+
+    // replace the share (false: refused, nothing held)
+    bool reserve(MemoryBudget*, m_off_t);
+
+    // take over another holder's share
+    void take(MemoryReservation*);
+
+    void release();
+
+    MemoryReservation();
+    ~MemoryReservation();
+
+private:
+    MemoryReservation(const MemoryReservation&);
+    MemoryReservation& operator=(const MemoryReservation&);
+};
+
+// allocator for the millions of Node/LocalNode objects of large accounts:
+// objects are carved sequentially from large slabs (a bulk load is a series
+// of appends) and recycled through a free list, and the slabs are freed in
+// bulk once all objects are gone - engine thread only
+//
+// each object is preceded by a pointer to its slab, so that it can be
+// released by a class operator delete without further context
+struct MEGA_API ObjectSlab
+{
+    // bytes per slab
+    static const size_t SLABSIZE = 262144;
+
+    // requests larger than the object size go to the heap
+    void* alloc(size_t);
+    static void release(void*);
+
+    // free the slabs if no object is alive
+    void trim();
+
+    // live objects
+    size_t live;
+
+    // bytes of the slabs
+    size_t footprint() const;
+
+    ObjectSlab(size_t);
+    ~ObjectSlab();
+
+protected:
+    union Header
+    {
+        ObjectSlab* slab;
+
+        // keep the objects 8-byte aligned on 32-bit platforms
+        int64_t align;
+        double aligndouble;
+    };
+
+    size_t objsize;
+    size_t blocksize;
+
+    vector<byte*> slabs;
+
+    // unused tail of the last slab
+    byte* next;
+    byte* end;
+
+    // released blocks, linked through their first bytes
+    void* freelist;
+
+private:
+    ObjectSlab(const ObjectSlab&);
+    ObjectSlab& operator=(const ObjectSlab&);
+};
+} // namespace
+
+#endif
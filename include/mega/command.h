@@ -43,6 +43,9 @@ protected:
 
     string json;
 
+    // base64-encode binary data straight into json
+    void appendbase64(const byte*, int);
+
 public:
     MegaClient* client;
 
@@ -77,7 +80,20 @@ public:
 
     virtual void procresult();
 
-    const char* getstring() const;
+    // can the response be processed while it is being received?
+    virtual bool incremental() const { return false; }
+
+    // can the command be executed out of order with respect to other
+    // commands (pure lookups that don't depend on or alter account state)?
+    virtual bool independent() const { return false; }
+
+    // scheduling class - independent commands are interactive, bulk
+    // commands (tree changes issued in large numbers by uploads and syncs)
+    // are spread over several requests
+    enum { PRIORITY_INTERACTIVE, PRIORITY_NORMAL, PRIORITY_BULK };
+    virtual int priority() const { return independent() ? PRIORITY_INTERACTIVE : PRIORITY_NORMAL; }
+
+    const string& getstring() const;
 
     Command();
     virtual ~Command() { }
@@ -91,6 +107,9 @@ struct MEGA_API HttpReqCommandPutFA : public HttpReq, public Command
     fatype type;
     string* data;
 
+    // in-flight budget share, acquired when dispatched
+    MemoryReservation reservation;
+
     void procresult();
 
     HttpReqCommandPutFA(MegaClient*, handle, fatype, string*);
@@ -103,6 +122,7 @@ class MEGA_API CommandGetFA : public Command
 
 public:
     void procresult();
+    bool independent() const { return true; }
 
     CommandGetFA(int, handle, bool);
 };
@@ -214,10 +234,24 @@ public:
 // reload nodes/shares/contacts
 class MEGA_API CommandFetchNodes : public Command
 {
+public:
+    void procresult();
+    bool incremental() const { return true; }
+
+    CommandFetchNodes(MegaClient*, bool = true);
+};
+
+// fetch the children (or the whole subtree) of a folder of a partially
+// fetched tree
+class MEGA_API CommandFetchChildren : public Command
+{
+    handle h;
+    bool recursive;
+
 public:
     void procresult();
 
-    CommandFetchNodes(MegaClient*);
+    CommandFetchChildren(MegaClient*, handle, bool);
 };
 
 // update own node keys
@@ -240,6 +274,24 @@ public:
     CommandKeyCR(MegaClient*, node_vector*, node_vector*, const char*);
 };
 
+// node keys of a fresh share beyond the batch sent with it, one batch per
+// request: each batch queues the next one when its response arrives
+class MEGA_API CommandShareKeyBatch : public Command
+{
+    TreeProcShareKeys* sharekeys;
+    unsigned next;
+
+public:
+    // items per batch
+    static const unsigned BATCHSIZE = 10000;
+
+    void procresult();
+
+    // takes ownership of the (encrypted) share keys
+    CommandShareKeyBatch(TreeProcShareKeys*, unsigned);
+    ~CommandShareKeyBatch();
+};
+
 class MEGA_API CommandMoveNode : public Command
 {
     handle h;
@@ -248,7 +300,14 @@ class MEGA_API CommandMoveNode : public Command
     syncdel_t syncdel;
 
 public:
+#ifdef ENABLE_SYNC
+    // batch and position of this move, if sync-originated
+    MoveBatch* batch;
+    unsigned batchindex;
+#endif
+
     void procresult();
+    int priority() const { return PRIORITY_BULK; }
 
     CommandMoveNode(MegaClient*, Node*, Node*, syncdel_t, handle = UNDEF);
 };
@@ -265,6 +324,7 @@ class MEGA_API CommandDelNode : public Command
 
 public:
     void procresult();
+    int priority() const { return PRIORITY_BULK; }
 
     CommandDelNode(MegaClient*, handle);
 };
@@ -305,6 +365,7 @@ class MEGA_API CommandDirectRead : public Command
 public:
     void cancel();
     void procresult();
+    bool independent() const { return true; }
 
     CommandDirectRead(DirectReadNode*);
 };
@@ -315,22 +376,42 @@ class MEGA_API CommandGetFile : public Command
     handle ph;
     byte filekey[FILENODEKEYLENGTH];
 
+    // URL prefetch for a queued transfer (until it gets a slot)
+    Transfer* transfer;
+    bool prefetch;
+
+    void args(handle, bool, const char*);
+    void procprefetch();
+
 public:
     void cancel();
     void procresult();
+    bool independent() const { return true; }
+
+    // deliver the result to the slot the transfer got in the meantime
+    void attach(TransferSlot*);
 
     CommandGetFile(TransferSlot*, byte*, handle, bool, const char* = NULL);
+    CommandGetFile(Transfer*, handle, bool, const char* = NULL);
 };
 
 class MEGA_API CommandPutFile : public Command
 {
     TransferSlot* tslot;
 
+    // URL prefetch for a queued transfer (until it gets a slot)
+    Transfer* transfer;
+
 public:
     void cancel(void);
     void procresult();
+    bool independent() const { return true; }
+
+    // deliver the result to the slot the transfer got in the meantime
+    void attach(TransferSlot*);
 
     CommandPutFile(TransferSlot*, int);
+    CommandPutFile(Transfer*, int);
 };
 
 class MEGA_API CommandAttachFA : public Command
@@ -353,7 +434,15 @@ class MEGA_API CommandPutNodes : public Command
     putsource_t source;
 
 public:
+    // batched small uploads: tag of the transfer of each record
+    vector<int> batchtags;
+
+    // batch of a bulk node tree creation
+    PutNodesTree* tree;
+    int treebatch;
+
     void procresult();
+    int priority() const { return PRIORITY_BULK; }
 
     CommandPutNodes(MegaClient*, handle, const char*, NewNode*, int, int, putsource_t = PUTNODES_APP);
 };
@@ -366,6 +455,7 @@ class MEGA_API CommandSetAttr : public Command
 
 public:
     void procresult();
+    int priority() const { return PRIORITY_BULK; }
 
     CommandSetAttr(MegaClient*, Node*, SymmCipher*, const char* = NULL);
 };
@@ -378,12 +468,16 @@ class MEGA_API CommandSetShare : public Command
     string msg;
     string personal_representation;
 
+    // node keys beyond the first batch, sent once the share exists
+    TreeProcShareKeys* sharekeys;
+
     bool procuserresult(MegaClient*);
 
 public:
     void procresult();
 
     CommandSetShare(MegaClient*, Node*, User*, accesslevel_t, int, const char*, const char* = NULL);
+    ~CommandSetShare();
 };
 
 class MEGA_API CommandGetUserData : public Command
@@ -420,6 +514,7 @@ class MEGA_API CommandGetUserQuota : public Command
 
 public:
     void procresult();
+    bool independent() const { return true; }
 
     CommandGetUserQuota(MegaClient*, AccountDetails*, bool, bool, bool);
 };
@@ -0,0 +1,41 @@
+/**
+ * @file mega/crc32.h
+ * @brief CRC-32 (IEEE) with runtime CPU dispatch
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_CRC32_H
+#define MEGA_CRC32_H 1
+
+#include "types.h"
+
+namespace mega {
+// the IEEE CRC-32 of the file fingerprints: carry-less multiplication
+// folding (PCLMULQDQ) on x86 or the ARMv8 CRC32 instructions, selected at
+// runtime, with a table-driven (slicing-by-4) fallback
+struct MEGA_API FastCRC32
+{
+    // is a hardware implementation in use?
+    static bool accelerated();
+
+    // update a CRC-32 (zlib semantics, starting at 0)
+    static uint32_t update(uint32_t, const byte*, unsigned);
+};
+} // namespace
+
+#endif
@@ -68,6 +68,48 @@ public:
     static uint32_t genuint32(uint64_t max);
 };
 
+// alternate implementations of the bulk primitives (e.g. OpenSSL, the
+// platform's AES or ARMv8-CE), selected at runtime with install() before any
+// cipher is keyed (and never uninstalled) - every primitive the backend
+// does not provide (returns NULL/false) is served by Crypto++
+struct MEGA_API CryptoBackend
+{
+    virtual const char* name() = 0;
+
+    // AES-128 key schedule: (re)key ctx, NULL: allocate a new context -
+    // returns NULL if AES is not provided
+    virtual void* aeskey(void* ctx, const byte*) { return NULL; }
+    virtual void aesfree(void*) { }
+
+    // len is a multiple of the block size, in and out may be the same
+    virtual bool ecb_encrypt(void*, const byte*, byte*, unsigned) { return false; }
+    virtual bool ecb_decrypt(void*, const byte*, byte*, unsigned) { return false; }
+
+    // in-place, with a one-block IV
+    virtual bool cbc_encrypt(void*, const byte*, byte*, unsigned) { return false; }
+    virtual bool cbc_decrypt(void*, const byte*, byte*, unsigned) { return false; }
+
+    // in-place, with a 128-bit big-endian counter block
+    virtual bool ctr_crypt(void*, const byte*, byte*, unsigned) { return false; }
+
+    // update a CRC-32 (zlib semantics, starting at 0 - probed with len 0)
+    virtual bool crc32(uint32_t*, const byte*, unsigned) { return false; }
+
+    // RSA private key operation on a big-endian number of outlen bytes with
+    // the big-endian key components p, q, d and u
+    virtual bool rsa_decrypt(const byte* const*, const unsigned*, const byte*, unsigned, byte*, unsigned) { return false; }
+
+    virtual ~CryptoBackend() { }
+
+    // compare every provided primitive byte for byte with Crypto++
+    static bool selftest(CryptoBackend*);
+
+    // the backend is only installed if it passes the self-test
+    static bool install(CryptoBackend*);
+
+    static CryptoBackend* active;
+};
+
 // symmetric cryptography: AES-128
 class MEGA_API SymmCipher
 {
@@ -91,6 +133,14 @@ private:
     CryptoPP::GCM<CryptoPP::AES>::Encryption aesgcm_e;
     CryptoPP::GCM<CryptoPP::AES>::Decryption aesgcm_d;
 
+    // multi-block CTR keystream (Crypto++ pipelines several counter blocks
+    // and dispatches to AES-NI/ARMv8 at runtime where available)
+    CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption aesctr_e;
+
+    // key schedule of the CryptoBackend active when the key was set
+    CryptoBackend* backend;
+    void* accel;
+
 public:
     static byte zeroiv[CryptoPP::AES::BLOCKSIZE];
 
@@ -262,6 +312,23 @@ public:
 
     void ctr_crypt(byte *, unsigned, m_off_t, ctr_iv, byte *, bool);
 
+    /**
+     * @brief Chain n independent buffers into their CBC-MACs.
+     *
+     * Up to MACSTREAMS chains are advanced per multi-block ECB operation, so
+     * that the AES rounds of different chains overlap in the pipeline.
+     * A trailing partial block is zero-padded.
+     *
+     * @param data Start of each buffer.
+     * @param len Length of each buffer in bytes.
+     * @param macs n consecutive BLOCKSIZE MACs, updated in place.
+     * @param n Number of buffers.
+     * @return Void.
+     */
+    void cbc_macs(const byte* const*, const unsigned*, byte*, unsigned);
+
+    static const unsigned MACSTREAMS = 8;
+
     static void setint64(int64_t, byte*);
 
     static void xorblock(const byte*, byte*);
@@ -269,7 +336,8 @@ public:
 
     static void incblock(byte*, unsigned = BLOCKSIZE);
 
-    SymmCipher() { }
+    SymmCipher() : backend(NULL), accel(NULL) { }
+    ~SymmCipher();
     SymmCipher(const SymmCipher& ref);
     SymmCipher& operator=(const SymmCipher& ref);
     SymmCipher(const byte*);
@@ -399,11 +467,15 @@ public:
 
 class MEGA_API HashCRC32
 {
-    CryptoPP::CRC32 hash;
+    // running CRC, computed by FastCRC32 or the CryptoBackend
+    uint32_t crc;
+    bool backend;
 
 public:
     void add(const byte*, unsigned);
     void get(byte*);
+
+    HashCRC32();
 };
 
 /**
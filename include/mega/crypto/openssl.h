@@ -0,0 +1,49 @@
+/**
+ * @file openssl.h
+ * @brief AES through OpenSSL as an alternate crypto backend.
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#if defined(USE_CRYPTOPP) && defined(USE_OPENSSL) && USE_OPENSSL
+#ifndef CRYPTOOPENSSL_H
+#define CRYPTOOPENSSL_H 1
+
+namespace mega {
+// AES-128 ECB/CBC/CTR through OpenSSL's EVP interface, which uses AES-NI or
+// the ARMv8 crypto extensions where available - install with
+// CryptoBackend::install(new OpenSSLCryptoBackend)
+class MEGA_API OpenSSLCryptoBackend : public CryptoBackend
+{
+public:
+    const char* name();
+
+    void* aeskey(void*, const byte*);
+    void aesfree(void*);
+
+    bool ecb_encrypt(void*, const byte*, byte*, unsigned);
+    bool ecb_decrypt(void*, const byte*, byte*, unsigned);
+
+    bool cbc_encrypt(void*, const byte*, byte*, unsigned);
+    bool cbc_decrypt(void*, const byte*, byte*, unsigned);
+
+    bool ctr_crypt(void*, const byte*, byte*, unsigned);
+};
+} // namespace
+
+#endif
+#endif
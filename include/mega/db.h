@@ -23,6 +23,7 @@
 #define MEGA_DB_H 1
 
 #include "filesystem.h"
+#include "workerpool.h"
 
 namespace mega {
 // generic host transactional database access interface
@@ -38,6 +39,9 @@ public:
     virtual bool next(uint32_t*, string*) = 0;
     bool next(uint32_t*, string*, SymmCipher*);
 
+    // keep nextid above the ids of records read with next(uint32_t*, string*)
+    void trackid(uint32_t);
+
     // get specific record by key
     virtual bool get(uint32_t, string*) = 0;
 
@@ -46,9 +50,30 @@ public:
     bool put(uint32_t, string*);
     bool put(uint32_t, Cachable *, SymmCipher*);
 
+    // serialize, pad and encrypt a record for put() and assign its dbid
+    // (returns false if the record could not be serialized)
+    bool encode(uint32_t, Cachable*, SymmCipher*, string*);
+
+    // update or add several records (index[i] -> data[i])
+    virtual bool putmany(const uint32_t*, string*, unsigned);
+
+    // versioned envelope for compressed record payloads - only for
+    // payloads that never start with four zero bytes, which are left
+    // unwrapped if compression does not pay off (or zlib is unavailable)
+    static const byte RECORDDEFLATE = 1;
+
+    static void compress(string*);
+
+    // unwrap an envelope, leaving other payloads untouched (false: corrupt
+    // or unsupported version)
+    static bool decompress(string*);
+
     // delete specific record
     virtual bool del(uint32_t) = 0;
 
+    // delete several records
+    virtual bool delmany(const uint32_t*, unsigned);
+
     // delete all records
     virtual void truncate() = 0;
 
@@ -64,17 +89,114 @@ public:
     // permanantly remove all database info
     virtual void remove() = 0;
 
+    // optional secondary index of node records, one entry per node pointing
+    // at the record that holds it (its own record or a snapshot pack) -
+    // maintained by put() for records with DbNodeKeys while indexnodes is set
+    bool indexnodes;
+
+    // add/update or remove a node's entry (no-ops without index support)
+    virtual bool indexnode(const DbNodeKeys*, uint32_t) { return true; }
+    virtual bool unindexnode(handle) { return true; }
+    virtual bool unindexnodes(const handle*, unsigned);
+
+    // handles and records of the nodes matching an index key (false: no
+    // index available)
+    virtual bool findnodes(dbindex_t, int64_t, handle_vector*, vector<uint32_t>*) { return false; }
+
     // autoincrement
     uint32_t nextid;
 
+    // allocate a record id of this type
+    uint32_t newid(uint32_t type)
+    {
+        return (nextid += IDSPACING) | type;
+    }
+
     DbTable();
     virtual ~DbTable() { }
 };
 
+// a transaction of record updates committed on a worker thread - the
+// engine must not access the table until the job has finished
+struct MEGA_API DbWriteJob : public WorkerJob
+{
+    DbTable* table;
+
+    // records to write in this order, then the records to delete (record
+    // ids are never reused, so a deletion can only follow a write)
+    vector<uint32_t> ids;
+    vector<string> data;
+    vector<uint32_t> dels;
+
+    // record written last in the same transaction (typically the sequence
+    // number the other records are consistent with)
+    uint32_t lastid;
+    string last;
+
+    void add(uint32_t, string*);
+    void del(uint32_t);
+
+    // node index updates applied in this order (record 0: remove the node,
+    // consecutive removals are applied together)
+    vector<DbNodeKeys> keys;
+    vector<uint32_t> keyrecords;
+
+    void index(const DbNodeKeys*, uint32_t);
+    void unindex(handle);
+
+    // results of the transaction
+    bool complete;
+    bool finished;
+
+    // duration of the transaction in microseconds
+    int64_t duration;
+
+    void run();
+
+    DbWriteJob(DbTable*, uint32_t);
+};
+
+// decrypt and unpad a batch of records read with DbTable::next() on a
+// worker thread
+struct MEGA_API DbReadJob : public WorkerJob
+{
+    // a batch is closed at BATCHSIZE records or BATCHBYTES bytes (so that
+    // large records such as snapshot packs are spread over the workers)
+    static const unsigned BATCHSIZE = 1024;
+    static const size_t BATCHBYTES = 1 << 20;
+
+    size_t bytes;
+
+    byte key[SymmCipher::KEYLENGTH];
+
+    vector<uint32_t> ids;
+    vector<string> data;
+
+    // per record: successfully decrypted
+    vector<char> ok;
+
+    // record type whose payloads are also decompressed (-1: none)
+    int compressedtype;
+
+    // the record data is taken over
+    void add(uint32_t, string*);
+
+    // set at the end of run() (a job withdrawn by WorkerPool::waitfor()
+    // must be run by the engine)
+    bool finished;
+
+    void run();
+
+    DbReadJob(SymmCipher*);
+};
+
 struct MEGA_API DbAccess
 {
     virtual DbTable* open(FileSystemAccess*, string*) = 0;
 
+    // heap memory of the database engine (page caches, prepared statements)
+    virtual size_t memoryused() { return 0; }
+
     virtual ~DbAccess() { }
 };
 } // namespace
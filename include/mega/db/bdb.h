@@ -45,11 +45,18 @@ class MEGA_API BdbTable : public DbTable
     DbEnv* dbenv;
     Dbc* dbcursor;
 
+    // the next cursor read restarts at the first record (rewind() reuses an
+    // open cursor)
+    bool cursorfirst;
+
+    void closecursor();
+
 public:
     void rewind();
     bool next(uint32_t*, string*);
     bool get(uint32_t, string*);
     bool put(uint32_t, char*, unsigned);
+    bool putmany(const uint32_t*, string*, unsigned);
     bool del(uint32_t);
     void truncate();
     void begin();
@@ -57,8 +64,6 @@ public:
     void abort();
     void remove();
 
-    uint32_t nextid;
-
     BdbTable(DbEnv*);
     ~BdbTable();
 };
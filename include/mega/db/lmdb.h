@@ -0,0 +1,103 @@
+/**
+ * @file lmdb.h
+ * @brief LMDB access layer
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifdef USE_LMDB
+#ifndef DBACCESS_CLASS
+#define DBACCESS_CLASS LmdbDbAccess
+
+#include <lmdb.h>
+
+namespace mega {
+class MEGA_API LmdbDbAccess : public DbAccess
+{
+    string dbpath;
+
+public:
+    DbTable* open(FileSystemAccess*, string*);
+
+    LmdbDbAccess(string* = NULL);
+    ~LmdbDbAccess();
+};
+
+// one memory-mapped environment (file) per table - records are read
+// straight from the map, readers do not block the writer
+class MEGA_API LmdbDbTable : public DbTable
+{
+    MDB_env* env;
+    MDB_dbi dbi;
+    string dbfile;
+    FileSystemAccess* fsaccess;
+
+    // write transaction between begin() and commit()/abort() (writes
+    // outside of it commit themselves)
+    MDB_txn* txn;
+
+    // read snapshot of a sequential read or a get() outside of a write
+    // transaction, reset (but kept allocated) while not in use
+    MDB_txn* rtxn;
+    bool reading;
+
+    MDB_cursor* cursor;
+    bool cursorfirst;
+
+    // double the map ahead of a write once it is more than half used
+    void growmap();
+
+    MDB_txn* readtxn();
+    void endread();
+    void closecursor();
+
+    // transaction for a single write (the active one, if any)
+    MDB_txn* writetxn();
+    bool endwrite(MDB_txn*, int);
+
+    void close();
+
+public:
+    // initial size of the map: a transaction fails once it exceeds the
+    // map, so 64-bit platforms reserve a large sparse one up front (only
+    // the pages in use take memory and disk space), 32-bit ones start
+    // small and grow with the data
+    static const m_off_t MAPSIZE64 = (m_off_t)64 << 30;
+    static const size_t MAPSIZE32 = 64 << 20;
+
+    static size_t mapsize();
+
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool putmany(const uint32_t*, string*, unsigned);
+    bool del(uint32_t);
+    bool delmany(const uint32_t*, unsigned);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+
+    LmdbDbTable(MDB_env*, MDB_dbi, FileSystemAccess*, string*);
+    ~LmdbDbTable();
+};
+} // namespace
+
+#endif
+#endif
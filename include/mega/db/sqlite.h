@@ -33,6 +33,9 @@ class MEGA_API SqliteDbAccess : public DbAccess
 public:
     DbTable* open(FileSystemAccess*, string*);
 
+    // (process-wide)
+    size_t memoryused();
+
     SqliteDbAccess(string* = NULL);
     ~SqliteDbAccess();
 };
@@ -44,18 +47,44 @@ class MEGA_API SqliteDbTable : public DbTable
     string dbfile;
     FileSystemAccess *fsaccess;
 
+    // prepared once, reset and rebound for each call
+    sqlite3_stmt* getStmt;
+    sqlite3_stmt* putStmt;
+    sqlite3_stmt* delStmt;
+    sqlite3_stmt* indexPutStmt;
+    sqlite3_stmt* indexDelStmt;
+
+    // the node index table is created on first use
+    bool indexready;
+    bool createindex();
+
+    bool prepare(sqlite3_stmt**, const char*);
+    void finalize();
+
+    // delete the rows of a table whose column holds one of the values, with
+    // up to DELBATCH values per statement
+    static const unsigned DELBATCH = 256;
+    bool delwhere(const char*, const char*, const sqlite3_int64*, unsigned);
+
 public:
     void rewind();
     bool next(uint32_t*, string*);
     bool get(uint32_t, string*);
     bool put(uint32_t, char*, unsigned);
+    bool putmany(const uint32_t*, string*, unsigned);
     bool del(uint32_t);
+    bool delmany(const uint32_t*, unsigned);
     void truncate();
     void begin();
     void commit();
     void abort();
     void remove();
 
+    bool indexnode(const DbNodeKeys*, uint32_t);
+    bool unindexnode(handle);
+    bool unindexnodes(const handle*, unsigned);
+    bool findnodes(dbindex_t, int64_t, handle_vector*, vector<uint32_t>*);
+
     SqliteDbTable(sqlite3*, FileSystemAccess *fs, string *filepath);
     ~SqliteDbTable();
 };
@@ -77,6 +77,19 @@ struct MEGA_API File: public FileFingerprint
     // for remote file drops: uid or e-mail address of recipient
     string targetuser;
 
+    // dispatch priority class (higher first, see PriorityTransferPolicy)
+    int priority;
+
+    // fair share group, e.g. the originating sync (see FairShareTransferPolicy)
+    int owner;
+
+    // record in the persistent download queue (0: none, see MegaClient::queuefile())
+    int32_t queuedbid;
+
+    // uploads of data that isn't in a local file: the source (not owned,
+    // must outlive the transfer) - localname then only names the upload
+    InputStreamAccess* stream;
+
     // transfer linkage
     Transfer* transfer;
     file_list::iterator file_it;
@@ -85,6 +98,23 @@ struct MEGA_API File: public FileFingerprint
     virtual ~File();
 };
 
+// download of the persistent queue, as restored from the transfer cache
+struct MEGA_API QueuedFile : public Cachable
+{
+    // source node
+    handle h;
+
+    // target path
+    string localname;
+
+    int priority;
+
+    bool serialize(string*);
+    static QueuedFile* unserialize(string*);
+
+    QueuedFile(File* = NULL);
+};
+
 struct MEGA_API SyncFileGet: public File
 {
     Sync* sync;
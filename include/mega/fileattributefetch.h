@@ -44,7 +44,12 @@ struct MEGA_API FileAttributeFetchChannel
     faf_map fafs[2];
     error e;
 
+    // prefetches sent per POST - the others wait for the next one, so that
+    // attributes requested for display meanwhile are not queued behind them
+    static const unsigned PREFETCHBATCH = 32;
+
     // dispatch new and retrying attributes by POSTing to existing URL
+    // (visible ones first, then up to PREFETCHBATCH prefetches)
     void dispatch(MegaClient*);
 
     // parse fetch result and remove completed attributes from pending
@@ -59,12 +64,17 @@ struct MEGA_API FileAttributeFetchChannel
 // pending individual attribute fetch
 struct MEGA_API FileAttributeFetch
 {
+    // requested for display or ahead of it (upgraded if requested again
+    // for display)
+    enum { VISIBLE, PREFETCH };
+
     handle nodehandle;
     fatype type;
     int retries;
     int tag;
+    int priority;
 
-    FileAttributeFetch(handle, fatype, int);
+    FileAttributeFetch(handle, fatype, int, int = VISIBLE);
 };
 } // namespace
 
@@ -49,6 +49,62 @@ struct MEGA_API FileFingerprint
     FileFingerprint();
 };
 
+// FileFingerprint of data that is only read once, in ascending order (e.g.
+// uploads from streams): the sampled blocks are collected as the data goes
+// by, so the result matches FileFingerprint::genfingerprint() on the same
+// content
+struct MEGA_API StreamFingerprint
+{
+    void init(m_off_t, m_time_t);
+
+    // data at [pos, pos + len)
+    void add(const byte*, unsigned, m_off_t);
+
+    // false if the data hasn't been added completely
+    bool get(FileFingerprint*);
+
+    StreamFingerprint();
+
+private:
+    static const unsigned BLOCKSIZE = 4 * sizeof(int32_t) * 4;
+    static const unsigned BLOCKS = FileFingerprint::MAXFULL / (BLOCKSIZE * 4) * 4;
+
+    m_off_t size;
+    m_time_t mtime;
+    m_off_t added;
+
+    // small files: the whole content, large files: the sampled blocks
+    byte buf[FileFingerprint::MAXFULL];
+
+    // start of the sampled block k
+    m_off_t blockoffset(unsigned) const;
+};
+
+// read-only FileAccess over a stream, for uploads of data that isn't in a
+// local file: the data is read once, in ascending order (a read of data
+// that was already consumed fails for good), and fingerprinted on the way
+struct MEGA_API StreamFileAccess : public FileAccess
+{
+    // not owned
+    InputStreamAccess* is;
+
+    // bytes read from the stream so far
+    m_off_t consumed;
+
+    StreamFingerprint fingerprint;
+
+    bool fopen(string*, bool, bool);
+    void updatelocalname(string*) { }
+    bool fwrite(const byte*, unsigned, m_off_t) { return false; }
+
+    bool sysread(byte*, unsigned, m_off_t);
+    bool sysstat(m_time_t*, m_off_t*);
+    bool sysopen() { return true; }
+    void sysclose() { }
+
+    StreamFileAccess(InputStreamAccess*, m_time_t);
+};
+
 // orders transfers by file fingerprints, ordered by size / mtime / sparse CRC
 struct MEGA_API FileFingerprintCmp
 {
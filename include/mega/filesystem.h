@@ -32,6 +32,23 @@ struct MEGA_API FsNodeId
     virtual bool isequalto(FsNodeId*) = 0;
 };
 
+// asynchronous absolute position read/write on an open file
+struct MEGA_API AsyncIOContext
+{
+    enum { READ, WRITE } op;
+
+    byte* buffer;
+    unsigned len;
+    m_off_t pos;
+
+    // set upon completion
+    bool finished;
+    bool failed;
+
+    AsyncIOContext() : op(READ), buffer(NULL), len(0), pos(0), finished(false), failed(false) { }
+    virtual ~AsyncIOContext() { }
+};
+
 // generic host file/directory access interface
 struct MEGA_API FileAccess
 {
@@ -41,6 +58,9 @@ struct MEGA_API FileAccess
     // mtime of a file opened for reading
     m_time_t mtime;
 
+    // status change time of a file opened for reading (0: not available)
+    m_time_t ctime;
+
     // local filesystem record id (survives renames & moves)
     handle fsid;
     bool fsidvalid;
@@ -60,6 +80,10 @@ struct MEGA_API FileAccess
     // open by name only
     bool fopen(string*);
 
+    // open by name only, with the metadata of a directory listing (no
+    // system calls)
+    bool fopen(string*, const DirEntryStat*);
+
     // update localname (only has an effect if operating in by-name mode)
     virtual void updatelocalname(string*) = 0;
 
@@ -69,19 +93,72 @@ struct MEGA_API FileAccess
     // absolute position read to byte buffer
     bool frawread(byte *, unsigned, m_off_t);
 
-    // non-locking ops: open/close temporary hFile
+    // read count blocks of len bytes at ascending positions into consecutive
+    // buffer space - the file is opened once, and blocks less than
+    // COALESCEGAP apart are fetched with a single read
+    bool frawreadv(byte *, unsigned, const m_off_t*, unsigned);
+    static const m_off_t COALESCEGAP = 4096;
+
+    // non-locking ops: open/close temporary hFile (nested openf()/closef()
+    // pairs share the open file)
     bool openf();
     void closef();
 
+    // nesting depth of openf() in by-name mode
+    unsigned opencount;
+
+    // the whole content, read by ingest() - fread(), frawread() and
+    // frawreadv() are served from it
+    string ingested;
+
+    // read files of up to INGESTMAX bytes with a single sequential read, so
+    // that the gfx decoder, the upload chunks and the fingerprint share it
+    bool ingest();
+    static const m_off_t INGESTMAX = 16 << 20;
+
+    // copy [pos, pos + len) from the ingested content - false if not
+    // available
+    bool readingested(byte*, unsigned, m_off_t);
+
     // absolute position write
     virtual bool fwrite(const byte *, unsigned, m_off_t) = 0;
 
+    // reserve disk space for the full file size (file open for writing)
+    virtual bool fpreallocate(m_off_t) { return false; }
+
+    // bypass the OS cache for writes (file open for writing) - writes whose
+    // buffer, offset and length are not DIRECTIOALIGNed remain buffered
+    virtual bool setdirectio() { return false; }
+
+    // alignment required by unbuffered writes
+    static const unsigned DIRECTIOALIGN = 4096;
+
+    // true if asyncfread()/asyncfwrite() complete in the background - the
+    // completion wakes up the engine through FileSystemAccess::checkevents()
+    virtual bool asyncavailable() { return false; }
+
+    // start an absolute position read/write on the open file (the buffer must
+    // remain valid until the context has finished) - the default
+    // implementation completes synchronously
+    virtual AsyncIOContext* asyncfread(byte*, unsigned, m_off_t);
+    virtual AsyncIOContext* asyncfwrite(const byte*, unsigned, m_off_t);
+
+    // block until an unfinished context has completed (required before
+    // deleting it or the FileAccess)
+    virtual void asyncwait(AsyncIOContext*) { }
+
+    // true if sysread()/fwrite() on the open file may run on several threads
+    // at once (positional I/O without shared state) - openf()/closef() must
+    // still be serialised
+    virtual bool concurrentio() { return false; }
+
     // system-specific raw read/open/close
     virtual bool sysread(byte *, unsigned, m_off_t) = 0;
     virtual bool sysstat(m_time_t*, m_off_t*) = 0;
     virtual bool sysopen() = 0;
     virtual void sysclose() = 0;
 
+    FileAccess() : opencount(0) { }
     virtual ~FileAccess() { }
 };
 
@@ -101,6 +178,10 @@ struct MEGA_API DirAccess
     // get next record
     virtual bool dnext(string*, string*, bool = true, nodetype_t* = NULL) = 0;
 
+    // metadata of the record last returned by dnext(), false if the
+    // listing doesn't provide it
+    virtual bool dstat(DirEntryStat*) { return false; }
+
     virtual ~DirAccess() { }
 };
 
@@ -126,8 +207,51 @@ struct MEGA_API DirNotify
     virtual void addnotify(LocalNode*, string*) { }
     virtual void delnotify(LocalNode*) { }
 
+    // notification backends with a persistent change journal (event IDs,
+    // USNs) start delivering events on start(), replaying the changes since
+    // the saved position if it is still valid (returns true if they are
+    // replayed instead of rescanning), and stop on stop()
+    virtual bool start(const string*) { return false; }
+    virtual void stop() { }
+
+    // opaque position of the last delivered event (false: no journal)
+    virtual bool journalpos(string*) { return false; }
+
+    // set while replayed changes are still being delivered asynchronously
+    bool replaying;
+
     void notify(notifyqueue, LocalNode *, const char*, size_t, bool = false);
 
+    // filesystem events (DIREVENTS, not immediate) are coalesced: only the
+    // most recent entry of a path is processed, and once a folder has
+    // BURSTCHILDREN distinct pending entries they are replaced by a single
+    // recheck of the folder (requires localseparator to be set)
+    static const size_t BURSTCHILDREN = 128;
+
+    string localseparator;
+
+    // false if a more recent entry supersedes the queue's front entry
+    bool current(notifyqueue);
+
+    // the queue's front entry has been handled (call before popping it)
+    void processed(notifyqueue);
+
+    // discard the coalescing state (after queued entries were deactivated)
+    void resetcoalescing();
+
+    // settle delay for filesystem events: MINSETTLEDS, doubled (up to
+    // MAXSETTLEDS) for every second with at least BURSTEVENTS events
+    static const dstime MINSETTLEDS = 3;
+    static const dstime MAXSETTLEDS = 24;
+    static const unsigned BURSTEVENTS = 500;
+
+    dstime settledelay();
+
+    // filesystem events received, and those skipped because a more recent
+    // entry superseded them
+    m_off_t notified;
+    m_off_t superseded;
+
     // filesystem fingerprint
     virtual fsfp_t fsfingerprint();
 
@@ -135,6 +259,41 @@ struct MEGA_API DirNotify
     string ignore;
 
     DirNotify(string*, string*);
+
+protected:
+    // path key -> sequence number and timestamp of its latest entry
+    typedef map<string, pair<uint32_t, dstime> > notifykey_map;
+    notifykey_map latest;
+
+    // folder key -> number of distinct pending entries
+    map<string, size_t> burstfolders;
+
+    // folders with a pending recheck
+    set<string> collapsed;
+
+    uint32_t notifyseq;
+
+    dstime settleds;
+    dstime burstwindow;
+    unsigned burstcount;
+
+    static void notifykey(LocalNode*, const string*, string*);
+    size_t parentlen(const string*);
+    void collapse(LocalNode*, const string*);
+    void pushrescan(LocalNode*, const string*, const string*);
+};
+
+// progress and cancellation of a recursive local deletion (emptydirlocal())
+// running on a worker thread
+struct MEGA_API LocalRemoval
+{
+    // files and folders removed so far (written by the worker)
+    volatile m_off_t removed;
+
+    // set to stop the deletion at the next entry
+    volatile bool cancelled;
+
+    LocalRemoval();
 };
 
 // generic host filesystem access interface
@@ -22,6 +22,9 @@
 #ifndef GFX_H
 #define GFX_H 1
 
+#include "workerpool.h"
+#include "filefingerprint.h"
+
 namespace mega {
 using namespace std;
 
@@ -37,10 +40,38 @@ class MEGA_API GfxProc
     // free stored bitmap
     virtual void freebitmap() = 0;
 
+    // read and store an in-memory JPEG (an embedded EXIF thumbnail) with
+    // this EXIF orientation (1, 3, 6 or 8) - false if not supported
+    virtual bool readbitmapdata(const string*, int);
+
+    // decode the file once and encode the missing dimensions (NULL: not
+    // generated) - the bitmap state is serialized by the mutex
+    int genimages(FileAccess*, string*, int, string**);
+
+    friend struct GfxJob;
+
 protected:
     // coordinate transformation
     static void transform(int&, int&, int&, int&, int&, int&);
 
+    // embedded EXIF thumbnail of a JPEG file and the main image's EXIF
+    // orientation, if the thumbnail can stand in for the main image at this
+    // size (large enough, same aspect ratio, not mirrored)
+    bool exifthumbnail(string*, int, string*, int*);
+
+    // read up to this many bytes from the start of the file, returns its
+    // size (-1: not readable)
+    m_off_t readhead(string*, unsigned, string*);
+
+    // file processed by genimages(), if its content is in memory
+    // (FileAccess::ingested) - readhead() is served from it
+    FileAccess* source;
+
+    // estimated memory needed by readbitmap() at this size, from the image
+    // header (JPEG, PNG, GIF, BMP, TIFF) or the file size as a lower bound -
+    // backends decoding in tiles or at a reduced scale override this
+    virtual m_off_t decodesize(string*, int);
+
     // list of supported extensions (NULL if no pre-filtering is needed)
     virtual const char* supportedformats();
 
@@ -52,11 +83,18 @@ public:
     // handle is uploadhandle or nodehandle
     // - must respect JPEG EXIF rotation tag
     // - must save at 85% quality (120*120 pixel result: ~4 KB)
-    int gendimensionsputfa(FileAccess*, string*, handle, SymmCipher*, int = -1);
+    // - returns the number of attributes stored, or, with a gfx worker
+    // pool, the number queued (MegaClient::gfxfailed() withdraws the ones
+    // that could not be generated)
+    // - images cached under the file's fingerprint are reused, new ones are
+    // added to the cache
+    int gendimensionsputfa(FileAccess*, string*, handle, SymmCipher*, int = -1, FileFingerprint* = NULL);
 
     // FIXME: read dynamically from API server
     typedef enum { THUMBNAIL120X120, PREVIEW1000x1000 } meta_t;
 
+    static const int NUMDIMENSIONS = PREVIEW1000x1000 + 1;
+
     // generate and save a fa to a file
     bool savefa(string*, meta_t, string*);
 
@@ -66,8 +104,51 @@ public:
     
     MegaClient* client;
 
+    // serializes the bitmap state if jobs run on the gfx worker pool
+    Mutex* mutex;
+
+    // images whose decoded bitmap would exceed this many bytes are not
+    // processed (0: no limit) - decoding is serialized, so this bounds the
+    // memory used by each GfxProc
+    static const m_off_t DEFAULTDECODELIMIT = 256 << 20;
+    m_off_t decodelimit;
+
     GfxProc();
-    virtual ~GfxProc() { }
+    virtual ~GfxProc();
+};
+
+// thumbnail/preview generation for one file on the gfx worker pool - the
+// engine attaches the results through putfa() once the job has finished
+struct MEGA_API GfxJob : public WorkerJob
+{
+    GfxProc* gfx;
+    string localname;
+
+    // holds a copy of the ingested content of the file, if available (the
+    // file is reopened by name otherwise)
+    FileAccess* fa;
+
+    // upload or node handle
+    handle th;
+
+    // private copy (the caller's cipher may be temporary)
+    SymmCipher key;
+
+    int missing;
+
+    // cache key of the results
+    FileFingerprint fingerprint;
+
+    // encoded images per dimension (NULL: not generated)
+    string* images[GfxProc::NUMDIMENSIONS];
+
+    // number of dimensions requested
+    int requested() const;
+
+    void run();
+
+    GfxJob(GfxProc*, string*, handle, SymmCipher*, int, FileFingerprint*, FileAccess* = NULL);
+    ~GfxJob();
 };
 } // namespace
 
@@ -24,6 +24,7 @@ class MEGA_API GfxProcCG : public mega::GfxProc
 private: // mega::GfxProc implementations
     const char* supportedformats();
     bool readbitmap(mega::FileAccess*, mega::string*, int);
+    mega::m_off_t decodesize(mega::string*, int);
     bool resizebitmap(int, int, mega::string*);
     void freebitmap();
 public:
@@ -33,9 +33,23 @@ class MEGA_API GfxProcFreeImage : public GfxProc
     int w, h;
 
     bool readbitmap(FileAccess*, string*, int);
+    bool readbitmapdata(const string*, int);
+
+    bool decodebitmap(FIMEMORY*, string*, int);
+    static FIBITMAP* loadbitmap(FREE_IMAGE_FORMAT, FIMEMORY*, string*, int);
     bool resizebitmap(int, int, string*);
     void freebitmap();
 
+#ifdef USE_FFMPEG
+    // video files are handled by FFmpeg: one keyframe is decoded and scaled
+    // down to the requested size
+    static const char* videoformats();
+    bool isvideo(string*);
+    bool readbitmapffmpeg(string*, int);
+
+    m_off_t decodesize(string*, int);
+#endif
+
 public:
 	GfxProcFreeImage();
 
@@ -51,7 +51,11 @@ class MEGA_API GfxProcQT : public GfxProc
     int orientation;
     int w, h;
 
+    // source of an in-memory image
+    QBuffer imagedata;
+
     bool readbitmap(FileAccess*, string*, int);
+    bool readbitmapdata(const string*, int);
     bool resizebitmap(int, int, string*);
     void freebitmap();
 
@@ -0,0 +1,141 @@
+/**
+ * @file mega/gfxcache.h
+ * @brief Local cache of thumbnails and previews by file fingerprint
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+
+#ifndef MEGA_GFXCACHE_H
+#define MEGA_GFXCACHE_H 1
+
+#include "db.h"
+#include "filefingerprint.h"
+
+namespace mega {
+// generated and fetched thumbnails/previews by file fingerprint and
+// attribute type, so that the same image is neither decoded nor downloaded
+// again - the records are encrypted with the account's master key, the
+// index is kept in memory (and stored in its own record), and the least
+// recently used entries are evicted beyond the size limit
+//
+// the most recently used blobs are also kept in memory (up to memlimit
+// bytes, also without a table), so that views showing the same thumbnails
+// repeatedly are served without touching the disk
+class MEGA_API GfxCache
+{
+public:
+    static const m_off_t DEFAULTLIMIT = 32 << 20;
+    static const m_off_t DEFAULTMEMLIMIT = 4 << 20;
+
+    // takes ownership of the table (NULL: caching disabled)
+    void open(DbTable*, SymmCipher*);
+
+    // store the index and close the table
+    void close();
+
+    bool isopen() const { return table != NULL; }
+
+    // the attribute data as stored (false: not cached)
+    bool get(const FileFingerprint*, fatype, string*);
+
+    // add the plain attribute data (existing entries are kept)
+    void put(const FileFingerprint*, fatype, const char*, unsigned);
+
+    // is the attribute cached? (without reading it)
+    bool has(const FileFingerprint*, fatype) const;
+
+    // can attributes be kept at all?
+    bool enabled() const { return (table && limit) || memlimit; }
+
+    // total size of the cached data in bytes (0: disable the cache)
+    void setlimit(m_off_t);
+
+    // size of the in-memory blobs in bytes (0: none)
+    void setmemlimit(m_off_t);
+
+    m_off_t size() const { return bytes; }
+    size_t count() const { return entries.size(); }
+    m_off_t memsize() const { return membytes; }
+
+    GfxCache();
+    ~GfxCache();
+
+protected:
+    // record holding the index (data records are allocated with newid())
+    static const uint32_t INDEXRECORD = 1;
+    static const uint32_t DATARECORD = 2;
+
+    struct Entry
+    {
+        uint32_t id;
+        uint32_t size;
+
+        // recency sequence number
+        uint64_t lastuse;
+    };
+
+    // fingerprint (size, mtime, sparse CRC) and type
+    typedef map<string, Entry> entry_map;
+    entry_map entries;
+
+    struct Blob
+    {
+        string data;
+        uint64_t lastuse;
+    };
+
+    typedef map<string, Blob> blob_map;
+    blob_map blobs;
+
+    DbTable* table;
+    SymmCipher* key;
+
+    m_off_t limit;
+    m_off_t bytes;
+    m_off_t memlimit;
+    m_off_t membytes;
+    uint64_t usecounter;
+
+    // the index differs from the stored one
+    bool dirty;
+
+    static bool cachekey(const FileFingerprint*, fatype, string*);
+
+    void readindex();
+    void writeindex();
+
+    // drop least recently used entries until the given number of bytes fits
+    void evict(m_off_t);
+
+    void remove(entry_map::iterator);
+
+    // add to the in-memory blobs, evicting the least recently used ones
+    void memput(const string*, const string*);
+};
+
+// a cache hit for getfa(), delivered to the application by the engine
+struct MEGA_API GfxCacheHit
+{
+    handle nodehandle;
+    fatype type;
+    int tag;
+    string data;
+};
+} // namespace
+
+#endif
@@ -24,6 +24,10 @@
 
 #include "types.h"
 #include "waiter.h"
+#include "workerpool.h"
+#include "bufferpool.h"
+#include "bandwidth.h"
+#include "transferstats.h"
 
 namespace mega {
 // SSL public key pinning - active key
@@ -83,6 +87,10 @@ struct MEGA_API HttpIO : public EventTrigger
     // send queued chunked data
     virtual void sendchunked(HttpReq*) = 0;
 
+    // continue receiving into a request that stopped at its maxbuffered
+    // limit (implementations without receive flow control ignore the limit)
+    virtual void resumereceive(HttpReq*) { }
+
     // real-time POST progress information
     virtual m_off_t postpos(void*) = 0;
 
@@ -93,8 +101,31 @@ struct MEGA_API HttpIO : public EventTrigger
     virtual void lock() { }
     virtual void unlock() { }
 
+    // drive the network I/O from a dedicated thread, with a recursive mutex
+    // serialising it against the engine's calls (both must outlive
+    // stopiothread()) - returns false if not supported
+    virtual bool startiothread(Thread*, Mutex*) { return false; }
+    virtual void stopiothread() { }
+
     virtual void disconnect() { }
 
+    // start resolving the host of a URL that is about to be used
+    virtual void prefetchdns(const string*) { }
+
+    // opaque TLS session resumption data, for reuse after a restart - export
+    // returns false if unsupported or if no new sessions were established
+    // since the last export
+    virtual bool exporttlssessions(string*) { return false; }
+    virtual void importtlssessions(string*) { }
+
+    // share connections between concurrent requests to the same host
+    // (HTTP/2 multiplexing) - returns false if not supported
+    virtual bool setmultiplexing(bool enable) { return !enable; }
+
+    // gzip-compress JSON request bodies of at least this many bytes
+    // (0: never)
+    unsigned compressthreshold;
+
     // track Internet connectivity issues
     dstime noinetds;
     bool inetback;
@@ -108,6 +139,15 @@ struct MEGA_API HttpIO : public EventTrigger
     // timestamp of last data received (across all connections)
     dstime lastdata;
 
+    // requests change state only within doio() and report all received
+    // data through HttpReq::put() - allows the client to skip idle transfer
+    // slots (see TransferSlot::ready())
+    bool reportsactivity;
+
+    // completed requests and their traffic by hostname (if the backend
+    // tracks them)
+    std::map<string, HttpHostStats> hoststats;
+
     // data receive timeout
     static const int NETWORKTIMEOUT = 6000;
     
@@ -139,12 +179,31 @@ struct MEGA_API HttpReq
     string outbuf;
     string chunkedout;
 
+    // gzip-compressed copy of out, sent instead of it if deflated is set
+    string deflatedout;
+    bool deflated;
+
     byte* buf;
     m_off_t buflen, bufpos;
 
     // we assume that API responses are smaller than 4 GB
     m_off_t contentlength;
 
+    // transfer speed cap in bytes per second (0: none), applied when posted
+    m_off_t maxspeed;
+
+    // local interface or address the connection is bound to (empty: the
+    // default route), applied when posted
+    string netif;
+
+    // stop receiving while this much data is buffered in "in" (0: no limit),
+    // see HttpIO::resumereceive()
+    m_off_t maxbuffered;
+    bool recvpaused;
+
+    // network timeline of the current request
+    HttpReqTimeline timeline;
+
     // HttpIO implementation-specific identifier for this connection
     void* httpiohandle;
 
@@ -175,6 +234,12 @@ struct MEGA_API HttpReq
     // reserve space for incoming data
     byte* reserveput(unsigned* len);
 
+    // drop purged data before appending len bytes, if worthwhile
+    size_t compactin(size_t len);
+
+    // gzip-compress out into deflatedout - returns false if not worthwhile
+    bool deflateout();
+
     // disconnect open HTTP connection
     void disconnect();
 
@@ -184,6 +249,9 @@ struct MEGA_API HttpReq
     // timestamp of last data received
     dstime lastdata;
 
+    // if set, raised whenever data is received
+    bool* activity;
+
     // prevent raw data from being dumped in debug mode
     bool binary;
 
@@ -196,10 +264,45 @@ struct MEGA_API HttpReqXfer : public HttpReq
 {
     unsigned size;
 
+    // time at which the current chunk was posted
+    dstime postds;
+
+    // time spent en/decrypting and reading/writing the chunk data (us)
+    int64_t cryptous;
+    int64_t diskus;
+
+    // the chunk is requested from a LAN peer instead of the storage server
+    bool frompeer;
+
+    // MegaClient::netifs entry the chunk was posted through (-1: none)
+    int netifindex;
+
     virtual bool prepare(FileAccess*, const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t) = 0;
+
+    // en/decrypt a request spanning one or more chunks, MACing each chunk
+    static void cryptchunks(SymmCipher*, byte*, unsigned, m_off_t, uint64_t, chunkmac_map*, bool);
     virtual void finalize(FileAccess*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t) { }
 
-    HttpReqXfer() : HttpReq(true), size(0) { }
+    // send the prepared request
+    virtual void postchunk(MegaClient* client) { post(client); }
+
+    // chunk data buffer, drawn from the client's pool
+    ChunkBufferPool* bufferpool;
+    byte* chunkbuf;
+    unsigned chunkbufsize;
+
+    // ensure that chunkbuf holds at least len bytes
+    byte* getchunkbuf(unsigned len);
+
+    // hand chunkbuf back to the pool
+    void releasechunkbuf();
+
+    // share of the client's in-flight budget held for the chunk
+    MemoryReservation reservation;
+
+    HttpReqXfer(ChunkBufferPool* pool) : HttpReq(true), size(0), postds(0), cryptous(0), diskus(0),
+                                         frompeer(false), netifindex(-1), bufferpool(pool), chunkbuf(NULL), chunkbufsize(0) { }
+    ~HttpReqXfer();
 };
 
 // file chunk upload
@@ -207,8 +310,15 @@ struct MEGA_API HttpReqUL : public HttpReqXfer
 {
     bool prepare(FileAccess*, const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
 
+    // take over chunk(s) read and encrypted ahead by a worker
+    void prepare(const char*, struct HttpReqULJob*, chunkmac_map*);
+
     m_off_t transferred(MegaClient*);
 
+    // POST the encrypted chunk(s) straight from chunkbuf
+    void postchunk(MegaClient*);
+
+    HttpReqUL(ChunkBufferPool* pool) : HttpReqXfer(pool) { }
     ~HttpReqUL() { }
 };
 
@@ -217,12 +327,78 @@ struct MEGA_API HttpReqDL : public HttpReqXfer
 {
     m_off_t dlpos;
 
+    // pending background finalization (status REQ_ASYNCIO)
+    struct HttpReqDLJob* job;
+
+    // pending asynchronous write, if no worker pool is available (status
+    // REQ_ASYNCIO) - the chunk MACs are recorded once the data is on disk
+    struct AsyncIOContext* asyncio;
+    chunkmac_map asyncmacs;
+
     bool prepare(FileAccess*, const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
     void finalize(FileAccess*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
 
+    // request the prepared range from another source URL
+    void seturl(const char*);
+
+    HttpReqDL(ChunkBufferPool* pool) : HttpReqXfer(pool), job(NULL), asyncio(NULL) { }
     ~HttpReqDL() { }
 };
 
+// decrypt, MAC and write a completed download request on a worker thread -
+// uses its own cipher instance and MAC map, and serialises the write to the
+// shared FileAccess through famutex unless it supports concurrent I/O
+struct MEGA_API HttpReqDLJob : public WorkerJob
+{
+    HttpReqDL* req;
+    FileAccess* fa;
+    Mutex* famutex;
+    SymmCipher key;
+    uint64_t ctriv;
+    chunkmac_map macs;
+
+    // time spent decrypting and writing (us)
+    int64_t cryptous;
+    int64_t diskus;
+
+    void run();
+
+    HttpReqDLJob(HttpReqDL*, FileAccess*, Mutex*, SymmCipher*, uint64_t);
+};
+
+// read, MAC and encrypt upload chunk(s) [pos, npos) on a worker thread ahead
+// of the connection that will send them
+struct MEGA_API HttpReqULJob : public WorkerJob
+{
+    FileAccess* fa;
+    Mutex* famutex;
+    SymmCipher key;
+    uint64_t ctriv;
+    m_off_t pos, npos;
+    chunkmac_map macs;
+
+    // encrypted chunk data (padded), drawn from the pool at construction
+    ChunkBufferPool* bufferpool;
+    byte* data;
+    unsigned datasize;
+
+    // in-flight budget share, passed on with the data
+    MemoryReservation reservation;
+
+    // read result and FileAccess::retry after a failed read
+    bool ok;
+    bool retry;
+
+    // time spent reading and encrypting (us)
+    int64_t cryptous;
+    int64_t diskus;
+
+    void run();
+
+    HttpReqULJob(FileAccess*, Mutex*, SymmCipher*, uint64_t, m_off_t, m_off_t, ChunkBufferPool*);
+    ~HttpReqULJob();
+};
+
 // file attribute get
 struct MEGA_API HttpReqGetFA : public HttpReq
 {
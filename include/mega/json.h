@@ -62,6 +62,10 @@ struct MEGA_API JSON
 
     static void unescape(string*);
 
+    // end of the object or array starting at ptr within [ptr, end) - NULL if
+    // it is incomplete
+    static const char* objectend(const char* ptr, const char* end);
+
     /**
      * @brief Extract a string value for a name in a JSON string
      * @param json JSON string to check
@@ -109,6 +109,12 @@ struct OutputSettings {
 class MEGA_API Logger {
 public:
     virtual void log(const char *time, int loglevel, const char *source, const char *message) = 0;
+
+    // loggers returning true receive logdeferred() instead of log(): the time
+    // and the source come unformatted and the message can be taken over
+    // (swapped out), so that the formatting can be done by another thread
+    virtual bool deferring() { return false; }
+    virtual void logdeferred(time_t, int, const char *, int, string *) { }
 };
 
 class MEGA_API SimpleLogger {
@@ -116,15 +122,8 @@ class MEGA_API SimpleLogger {
     bool lineBreak;
     std::ostringstream ostr;
     typedef vector<std::ostream *> OutputStreams;
-    std::string t;
-    std::string fname;
-
-    OutputStreams getOutput(enum LogLevel ll)
-    {
-        return outputs[ll];
-    }
-
-    string getTime();
+    char const* filename;
+    int line;
 
 public:
     typedef std::map<enum LogLevel, OutputStreams> OutputMap;
@@ -136,6 +135,9 @@ public:
 
     static enum LogLevel logCurrentLevel;
 
+    // time as displayed in the logs (UTC, HH:MM:SS)
+    static std::string getTime(time_t);
+
     SimpleLogger(enum LogLevel ll, char const* filename, int line, bool lBreak = true);
     ~SimpleLogger();
 
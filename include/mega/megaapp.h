@@ -96,6 +96,9 @@ struct MEGA_API MegaApp
     // node fetch result
     virtual void fetchnodes_result(error) { }
 
+    // children of a partially fetched folder
+    virtual void fetchchildren_result(handle, error) { }
+
     // nodes now (nearly) current
     virtual void nodes_current() { }
 
@@ -158,6 +161,14 @@ struct MEGA_API MegaApp
     virtual dstime pread_failure(error, int, void*) { return ~(dstime)0; }
     virtual bool pread_data(byte*, m_off_t, m_off_t, void*) { return false; }
 
+    // zero-copy variant of pread_data(): the app may take over the buffer
+    // (setting it to NULL) and hand it back later through
+    // MegaClient::releasereadbuffer() - its data can be padded beyond len
+    virtual bool pread_buffer(string** buffer, m_off_t len, m_off_t pos, void* appdata)
+    {
+        return pread_data((byte*)(*buffer)->data(), len, pos, appdata);
+    }
+
     // event reporting result
     virtual void reportevent_result(error) { }
 
@@ -171,10 +182,15 @@ struct MEGA_API MegaApp
     virtual void transfer_failed(Transfer*, error) { }
     virtual void transfer_update(Transfer*) { }
     virtual void transfer_limit(Transfer*) { }
+
+    // ask LAN peers for the content of a file node being downloaded (a peer
+    // holding it is recorded with MegaClient::setpeerurl())
+    virtual void peer_lookup(handle) { }
     virtual void transfer_complete(Transfer*) { }
 
     // sync status updates and events
     virtual void syncupdate_state(Sync*, syncstate_t) { }
+    virtual void syncupdate_stats(Sync*) { }
     virtual void syncupdate_scanning(bool) { }
     virtual void syncupdate_local_folder_addition(Sync*, LocalNode*, const char*) { }
     virtual void syncupdate_local_folder_deletion(Sync*, LocalNode*) { }
@@ -214,6 +230,9 @@ struct MEGA_API MegaApp
     // failed request retry notification
     virtual void notify_retry(dstime) { }
 
+    // periodic engine statistics report (MegaClient::enginestatsds)
+    virtual void enginestats_updated() { }
+
     virtual void loadbalancing_result(string*, error) { }
 
     virtual ~MegaApp() { }
@@ -25,6 +25,7 @@
 #include "json.h"
 #include "db.h"
 #include "gfx.h"
+#include "gfxcache.h"
 #include "filefingerprint.h"
 #include "request.h"
 #include "treeproc.h"
@@ -34,9 +35,59 @@
 #include "http.h"
 #include "pubkeyaction.h"
 #include "pendingcontactrequest.h"
+#include "transferscheduler.h"
+#include "workerpool.h"
+#include "nodemap.h"
 
 namespace mega {
 
+// node records read from the state cache, restored once all records are in
+// (a snapshot pack entry is superseded by a later record for the same node)
+struct MEGA_API CachedNodes
+{
+    vector<string> packs;
+
+    vector<uint32_t> ids;
+    vector<string> records;
+
+    handle_set superseded;
+    unsigned tombstones;
+
+    CachedNodes() : tombstones(0) { }
+};
+
+// circuit breaker of a storage server: after MegaClient::CIRCUITFAILURES
+// consecutive failed chunk requests, no new requests are sent to it until
+// the jittered exponential backoff of bt expires - the requests sent then
+// probe it, and another failure reopens the circuit for longer
+struct MEGA_API StorageHostHealth
+{
+    unsigned failures;
+    bool open;
+    BackoffTimer bt;
+
+    StorageHostHealth() : failures(0), open(false) { }
+};
+
+// estimated heap memory by subsystem, in bytes (MegaClient::memoryusage())
+struct MEGA_API MemoryUsage
+{
+    enum
+    {
+        NODES,              // nodes, their keys, attributes, shares and children
+        NODEINDEXES,        // handle, fingerprint and name search indexes
+        SYNCS,              // LocalNode trees
+        TRANSFERS,          // transfer queues, their files and chunk MACs
+        TRANSFERBUFFERS,    // chunk buffers (in use and pooled)
+        NETWORK,            // request and response buffers of the API and storage connections
+        THUMBNAILS,         // in-memory thumbnail/preview cache
+        DATABASE,           // database engine (page caches)
+        NUMSUBSYSTEMS
+    };
+
+    size_t bytes[NUMSUBSYSTEMS];
+};
+
 class MEGA_API MegaClient
 {
 public:
@@ -49,6 +100,37 @@ public:
     // all nodes
     node_map nodes;
 
+    // lazy attribute decryption: node attributes are decrypted on first
+    // access (Node::resolveattrs()) rather than when the node key becomes
+    // available - not while syncs are active, as they compare all nodes
+    bool lazyattrs;
+    unsigned pendingattrnodes;
+
+    bool deferattrs();
+
+    // decrypt all deferred node attributes
+    void resolveattrs();
+
+    // next time the app needs exec() to run without other events (NEVER:
+    // none) - set and cleared by the app
+    dstime appwakeupds;
+
+    // log the estimated memory footprint of the node tree by category
+    void reportnodememory();
+
+    // estimated footprint of the node tree and of its indexes (logged by
+    // category if requested)
+    void nodememory(size_t*, size_t*, bool = false);
+
+    // estimated memory use of all subsystems
+    void memoryusage(MemoryUsage*);
+
+#ifdef ENABLE_SYNC
+    // estimated memory footprint of the LocalNode trees of all syncs
+    // (logged by category if requested)
+    size_t syncmemory(bool = false);
+#endif
+
     // all users
     user_map users;
 
@@ -131,6 +213,14 @@ public:
     // load all trees: nodes, shares, contacts
     void fetchnodes();
 
+    // partial tree fetch for folder links: fetchnodes() only loads the top
+    // level, the children of the other folders are fetched on demand
+    bool partialfetch;
+
+    // fetch the children (recursive: the whole subtree) of a folder that
+    // hasn't been fetched yet - the nodes are added as through action packets
+    error fetchchildren(handle, bool recursive = false);
+
     // retrieve user details
     void getaccountdetails(AccountDetails*, bool, bool, bool, bool, bool, bool);
 
@@ -163,9 +253,17 @@ public:
     void preadabort(Node*, m_off_t = -1, m_off_t = -1);
     void preadabort(handle, m_off_t = -1, m_off_t = -1);
 
+    // stop/resume delivering the direct read started with this appdata,
+    // returns false if there is none
+    bool preadpause(void*, bool);
+
     // pause flags
     bool xferpaused[2];
 
+    // the last HttpIO::doio() reported request state changes - transfer
+    // slots are otherwise only serviced if ready()
+    bool httpstatechange;
+
 #ifdef ENABLE_SYNC
     // active syncs
     sync_list syncs;
@@ -179,9 +277,78 @@ public:
     // (give the user ample warning about possible sync repercussions)
     bool followsymlinks;
 
+#ifdef ENABLE_SYNC
+    // number of sync folder listings read ahead by the worker pool during
+    // scans, shared by all syncs (0: scan inline)
+    unsigned syncscanahead;
+
+    // bumped whenever a LocalNode's name or parent changes, invalidating the
+    // cached folder paths
+    unsigned localpathgen;
+
+    // interval between full rescans that do not trust the cached file
+    // fingerprints (0: never)
+    dstime syncverifyinterval;
+
+    // full rescans skip folders whose mtime is unchanged since their last
+    // complete listing, including their subtrees (verification rescans
+    // still visit them)
+    bool syncskipunchanged;
+#endif
+
     // number of parallel connections per transfer (PUT/GET)
     unsigned char connections[2];
 
+    // bounds for the adaptive per-transfer connection count (PUT/GET)
+    unsigned char minconnections[2];
+    unsigned char maxconnections[2];
+
+    // hard upper limit for parallel connections per transfer
+    static const int MAXCONNECTIONS = 16;
+
+    // local interfaces the chunk requests are spread over (none: the default
+    // route) - each chunk goes out through the least loaded one relative to
+    // its weight, or to its measured chunk throughput if no weights are set,
+    // and a failing one is avoided for a while
+    struct NetInterface
+    {
+        // interface name, host name or local address
+        string name;
+
+        int weight;
+
+        // moving average of the chunk throughput (bytes per second, 0: not
+        // measured yet)
+        m_off_t throughput;
+
+        unsigned failures;
+        dstime retryds;
+    };
+
+    vector<NetInterface> netifs;
+
+    // "name[=weight],..."
+    void setnetifs(const char*);
+
+    // interface for the next chunk request (-1: none configured)
+    int picknetif();
+
+    // outcome of a chunk request posted through an interface
+    void netifdone(int, m_off_t, dstime, bool);
+
+    // maximum size of a request spanning multiple contiguous chunks (PUT/GET)
+    // - 0 means one chunk per request
+    m_off_t maxrequestsize[2];
+
+    // upper limit for maxrequestsize
+    static const int MAXREQUESTSIZE = 16777216;
+
+    // set the bounds for the adaptive per-transfer connection count
+    void setconnectionlimits(direction_t, int, int);
+
+    // number of chunk requests in flight in the given direction
+    int inflightrequests(direction_t);
+
     // generate & return next upload handle
     handle uploadhandle(int);
 
@@ -195,12 +362,20 @@ public:
     // attach file attribute to upload or node handle
     void putfa(handle, fatype, SymmCipher*, string*);
 
-    // queue file attribute retrieval
-    error getfa(Node*, fatype, int = 0);
+    // queue file attribute retrieval (prefetch: ahead of display, sent
+    // after the attributes requested for display)
+    error getfa(Node*, fatype, int = 0, bool = false);
+
+    // prefetch the missing thumbnails of these nodes into gfxcache, not tied
+    // to any request (all go out with the next dispatch of their clusters)
+    void prefetchthumbnails(const handle_vector*);
     
     // notify delayed upload completion subsystem about new file attribute
     void checkfacompletion(handle, Transfer* = NULL);
 
+    // an upload no longer waits for file attributes that could not be generated
+    void gfxfailed(handle, int);
+
     /**
      * @brief Attach/update/delete a user attribute.
      *
@@ -307,6 +482,26 @@ public:
     // use an alternative port for downloads (8080)
     bool usealtdownport;
 
+    // reserve the full size of download targets up front
+    bool dlpreallocate;
+
+    // write download targets bypassing the OS cache
+    bool dldirectio;
+
+    // per-node ceiling of the direct read block cache and read-ahead window
+    m_off_t drcachelimit;
+    m_off_t drreadahead;
+
+    // configure the direct read block cache (applies to open nodes, too)
+    void setdirectreadcache(m_off_t, m_off_t);
+
+    // recycled receive buffers of direct reads
+    vector<string*> drbuffers;
+    static const unsigned MAXDRBUFFERS = 32;
+
+    string* getreadbuffer();
+    void releasereadbuffer(string*);
+
     // select the download port automatically
     bool autodownport;
 
@@ -332,10 +527,50 @@ private:
     HttpReq* pendingcs;
     BackoffTimer btcs;
 
+    // while pendingcs is in flight, queued independent commands are sent
+    // ahead in a second request, with its own request ID sequence
+    Request pipelinereq;
+    HttpReq* pipelinedcs;
+    BackoffTimer btpipelinecs;
+    char pipelinereqid[10];
+
+    void execpipelinedcs();
+
+    // adaptive batching: while multi-command requests follow each other
+    // closely, queued commands are held back for up to CSBATCHWINDOW to
+    // coalesce (or until MAXCSBATCH commands are queued) - isolated commands
+    // and chains of single commands are sent right away
+    static const dstime CSBATCHWINDOW = 1;
+    static const dstime CSBURSTINTERVAL = 10;
+    static const int MAXCSBATCH = 50;
+
+    // bulk commands per request, so that interactive commands queued
+    // behind thousands of them go out with the next request
+    static const int MAXBULKPERBATCH = 200;
+    dstime csbatchstart;
+    dstime lastcssent;
+    int lastcsbatch;
+
+    bool csbatchready();
+
+    static void nextreqid(char*, int);
+
     // server-client command trigger connection
     HttpReq* pendingsc;
     BackoffTimer btsc;
 
+    // action packet bursts: while sc responses arrive without a wait URL
+    // (more packets are queued server-side), notifications are accumulated
+    // so that the whole burst is committed to the state cache and reported
+    // to the app at once - for at most SCBURSTMAXDS, and only if no syncs
+    // are active (they process packets one by one)
+    static const dstime SCBURSTMAXDS = 30;
+    bool scburst;
+    bool scwaitseen;
+    dstime scburststart;
+
+    bool scburstdeferred();
+
     // badhost report
     HttpReq* badhostcs;
     HttpReq* loadbalancingcs;
@@ -358,22 +593,23 @@ private:
     // next local user record identifier to use
     int userid;
 
+    // file attribute writes in flight - their upload URLs are requested in
+    // the same API request, then the POSTs run concurrently
+    static const unsigned MAXPUTFA = 8;
+
     // pending file attribute writes
     putfa_list newfa;
 
-    // current attribute being sent
-    putfa_list::iterator curfa;
+    // attributes being sent (upload URL requested or POST in flight)
+    putfa_list activefa;
     BackoffTimer btpfa;
 
+    // dispatch pending file attribute writes up to MAXPUTFA
+    void dispatchputfa();
+
     // next internal upload handle
     handle nextuh;
 
-    // maximum number of concurrent transfers
-    static const unsigned MAXTRANSFERS = 12;
-
-    // determine if more transfers fit in the pipeline
-    bool moretransfers(direction_t);
-
     // update time at which next deferred transfer retry kicks in
     void nexttransferretry(direction_t d, dstime*);
 
@@ -463,6 +699,59 @@ public:
     // state cache table for logged in user
     DbTable* sctable;
 
+    // resumable download state for logged in user
+    DbTable* tctable;
+
+    // TLS sessions of the network layer kept across restarts (encrypted with
+    // the session key, only if persisttls is set before the session is resumed)
+    bool persisttls;
+    DbTable* tlstable;
+    dstime nexttlssave;
+    static const dstime TLSSAVEINTERVAL = 600;
+    static const uint32_t TLSSESSIONSRECORD = 1;
+
+    void savetlssessions();
+
+    // downloads restored from tctable, not yet requested again by the app
+    transfer_map cachedtransfers[2];
+
+    // load/close the resumable transfer table
+    void readtransfercache();
+    void closetctable();
+
+    // checkpoint the resumable state of a download
+    void cachetransfer(Transfer*);
+
+    // downloads of the app kept in tctable across restarts (only if
+    // persistqueue is set before the session is resumed) - the restored ones
+    // wait in queuedfiles until the app starts them again
+    bool persistqueue;
+    vector<QueuedFile*> queuedfiles;
+
+    // add/remove a download to/from the persistent queue - the changes are
+    // written in batches by flushqueuedfiles(), called from exec()
+    void queuefile(File*);
+    void unqueuefile(File*);
+    void flushqueuedfiles();
+
+    // discard the restored downloads that were not started again
+    void clearqueuedfiles();
+
+    vector<uint32_t> queuedfileputids;
+    vector<string> queuedfileputs;
+    vector<uint32_t> queuedfiledels;
+
+    // completed downloads, as candidates for satisfying further downloads of
+    // the same content locally
+    fingerprint_localpath_map localcopies;
+    static const unsigned MAXLOCALCOPIES = 1024;
+
+    void addlocalcopy(FileFingerprint*, string*);
+    void clearlocalcopies();
+
+    // satisfy a download by copying an identical local file, if any
+    bool localcopy(Transfer*);
+
     // scsn as read from sctable
     handle cachedscsn;
 
@@ -470,13 +759,102 @@ public:
     bool statecurrent;
 
     // record type indicator for sctable
-    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR } sctablerectype;
+    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER,
+           CACHEDNODEPACK, CACHEDNODEGONE, CACHEDQUEUEDFILE, CACHEDJOURNAL } sctablerectype;
+
+    // initsc() writes a snapshot of the node tree as packs of up to
+    // SNAPSHOTPACKNODES nodes (one record, decrypted in one go), updatesc()
+    // adds the changes as node records and tombstones for removed snapshot
+    // nodes - the snapshot is rewritten once scdelta exceeds
+    // SNAPSHOTMINDELTA records and half the number of nodes
+    static const unsigned SNAPSHOTPACKNODES = 2048;
+    static const unsigned SNAPSHOTMINDELTA = 10000;
+
+    // node records and tombstones written since the snapshot
+    unsigned scdelta;
+
+    // maintain the state cache's secondary node index (DbTable::findnodes())
+    // - to be set before the session is opened
+    bool sctableindex;
+
+    bool putnodepack(string*, uint32_t);
+    void encodetombstone(Node*, string*);
+
+    // change journal of the nodes: one entry per notified node, numbered
+    // consecutively, with its changes (the bits of MegaNode::CHANGE_TYPE_*,
+    // none for new nodes) - the last MAXJOURNAL entries are kept, stored in
+    // sctable in records of the entries of JOURNALBLOCK numbers each
+    struct NodeChange
+    {
+        uint64_t seq;
+        handle h;
+        int changes;
+    };
+
+    static const unsigned MAXJOURNAL = 65536;
+    static const unsigned JOURNALBLOCK = 256;
+
+    deque<NodeChange> journal;
+
+    // number of the next entry (0: none yet - a new journal starts at a
+    // number derived from the time, so that the numbers of a discarded
+    // journal are not reused), journalseq when the records were written
+    uint64_t journalseq;
+    uint64_t journalwritten;
+
+    // record ids of the stored blocks (by seq / JOURNALBLOCK)
+    map<uint64_t, uint32_t> journalblocks;
+
+    // number of the next entry, starting a journal if needed
+    uint64_t journalnext();
+
+    // add the entries of nodenotify
+    void journalnodes();
+
+    // records of the blocks changed since the last write (all for a
+    // rewrite) and of the blocks trimmed off
+    void journalrecords(bool, vector<uint32_t>*, vector<string>*, vector<uint32_t>*);
+    bool putjournal(bool);
+
+    // restore the entries read by fetchscrecord()
+    void fetchjournal(uint32_t, string*);
+    void restorejournal();
+    void clearjournal();
 
     // initialize/update state cache referenced sctable
     void initsc();
     void updatesc();
     void finalizesc(bool);
 
+    // write-behind state cache updates (with a worker pool): updatesc()
+    // serializes the changes into scpending, which is committed on a worker
+    // once it is SCFLUSHDS old or holds SCFLUSHRECORDS records - one
+    // transaction at a time, each recording the scsn its records are
+    // consistent with
+    static const dstime SCFLUSHDS = 10;
+    static const unsigned SCFLUSHRECORDS = 4096;
+
+    DbWriteJob* scpending;
+    dstime scpendingsince;
+
+    // transaction in progress on a worker
+    DbWriteJob* scwriting;
+
+    void queuesc();
+    void execscwrites();
+    void scwritten();
+
+    // complete all state cache writes (must precede any other sctable access)
+    void waitsc();
+
+    // load the state cache
+    bool fetchscrecord(uint32_t, string*, CachedNodes*);
+    bool fetchscparallel(DbTable*, CachedNodes*);
+    bool fetchscnodes(CachedNodes*, node_vector*);
+
+    // batches decrypted in parallel while loading the state cache
+    static const unsigned FETCHSCJOBS = 8;
+
     // MegaClient-Server response JSON
     JSON json;
 
@@ -484,6 +862,17 @@ public:
     JSON jsonsc;
     bool insca;
 
+    // large responses (streamed nodes, command results, action packets)
+    // are processed in slices of at most SLICEUS microseconds, each
+    // followed by a pass over the network and the transfers
+    static const int64_t SLICEUS = 20000;
+
+    // the response of pendingcs is being processed (across slices)
+    bool csresume;
+
+    // procsc() stopped at the end of a slice
+    bool scsliced;
+
     // no two interrelated client instances should ever have the same sessionid
     char sessionid[10];
 
@@ -534,11 +923,140 @@ public:
     // transfer tslots
     transferslot_list tslots;
 
+    // maximum number of concurrent transfers
+    static const unsigned MAXTRANSFERS = 12;
+
+    // small-file upload lane: uploads of up to SMALLFILESIZE bytes run in up
+    // to MAXSMALLUPLOADS additional slots that are not subject to the active
+    // transfer limit, and their nodes are committed with batched putnodes
+    static const m_off_t SMALLFILESIZE = 131072;
+    static const unsigned MAXSMALLUPLOADS = 32;
+
+    // number of slots in use by the small-file lane
+    unsigned smalluploads;
+
+    // does the transfer qualify for the small-file lane?
+    static bool smallupload(const Transfer*);
+
+    // maximum number of nodes per batched putnodes
+    static const unsigned MAXPUTNODESBATCH = 100;
+
+    // completed small uploads awaiting their putnodes: target folder ->
+    // (transfer tag, single-record NewNode array)
+    map<handle, vector<pair<int, NewNode*> > > batchedputnodes;
+
+    // queue a completed small upload's node for the next batched putnodes
+    void queueputnodes(handle, NewNode*, int);
+
+    // issue the batched putnodes for all queued nodes
+    void execputnodes();
+
+    // report a batched putnodes result for each of its uploads
+    void putnodes_batch_result(error, targettype_t, NewNode*, int, vector<int>*);
+
+    // bulk node tree creation: records reference earlier records by their
+    // (temporary) nodehandle in parenthandle (UNDEF: the target) and are
+    // sent in batches of up to PUTNODESTREEBATCH records - all batches below
+    // existing nodes are pipelined, the others follow as soon as the node
+    // they are created in has been added; putnodes_result() reports the
+    // whole tree
+    static const unsigned PUTNODESTREEBATCH = 1000;
+
+    void putnodestree(handle, NewNode*, int);
+
+    // trees with putnodes pending
+    set<PutNodesTree*> putnodestrees;
+
+    void sendputnodesbatch(PutNodesTree*, int);
+    void putnodes_tree_result(error, PutNodesTree*, int, NewNode*, int);
+
+    // transfer dispatch ordering and pipeline admission
+    TransferScheduler scheduler;
+
+    // optional background workers for chunk en/decryption, MAC and file I/O
+    // (supplied by the application, NULL: inline processing)
+    WorkerPool* workerpool;
+
+    // optional dedicated workers for thumbnail/preview generation (supplied
+    // by the application together with GfxProc::mutex, NULL: inline)
+    WorkerPool* gfxpool;
+
+    // jobs handed to gfxpool (at most MAXGFXQUEUE) and jobs waiting for room
+    deque<GfxJob*> gfxrunning;
+    deque<GfxJob*> gfxwaiting;
+    static const unsigned MAXGFXQUEUE = 4;
+
+    void queuegfx(GfxJob*);
+
+    // attach the generated images and feed the pool
+    void execgfx();
+
+    // drop all pending gfx jobs (waits for the running ones)
+    void abortgfx();
+
+    // generated and fetched thumbnails/previews by fingerprint (opened with
+    // the session's local cache)
+    GfxCache gfxcache;
+
+    // getfa() requests served from gfxcache, delivered by exec()
+    deque<GfxCacheHit> gfxcachehits;
+    void deliverfacachehits();
+
+    // pooled chunk buffers for all transfer requests
+    ChunkBufferPool bufferpool;
+
+    // memory budget of the data in flight (MemoryBudget)
+    MemoryBudget inflight;
+
+    // storage of the Node and LocalNode objects
+    ObjectSlab nodeslab;
+#ifdef ENABLE_SYNC
+    ObjectSlab localnodeslab;
+#endif
+
+    // all nodes are being deleted
+    bool purgingnodes;
+
+    // expanded key schedules of recently used nodes (Node::nodecipher())
+    NodeCipherCache nodeciphers;
+
+    // client-side bandwidth limits
+    BandwidthShaper bandwidth;
+
+    // timings of all chunk requests per direction
+    ChunkTimingStats chunktimings[2];
+
+    // engine-wide counters (the HTTP ones are in httpio->hoststats)
+    EngineStats enginestats;
+
+    // API batches waiting for a response
+    int csinflight() const
+    {
+        return (pendingcs ? 1 : 0) + (pipelinedcs ? 1 : 0);
+    }
+
+    // timeline of the last login and fetchnodes
+    StartupTrace startup;
+
+    // the fetchnodes response (in pendingcs) is being processed
+    void tracefetchnodes();
+
+    // interval of the enginestats_updated() reports (0: none)
+    dstime enginestatsds;
+    dstime enginestatslastds;
+
     // next TransferSlot to doio() on
     transferslot_list::iterator slotit;
 
     // FileFingerprint to node mapping
-    fingerprint_set fingerprints;
+    FingerprintIndex fingerprints;
+
+    // node name substring search (built by the first search)
+    NameSearchIndex namesearch;
+
+    // append the nodes below a node whose name contains a string
+    // (case-insensitive, all levels or children only)
+    void searchnodes(Node*, const char*, bool, node_vector*);
 
     // asymmetric to symmetric key rewriting
     handle_vector nodekeyrewrite;
@@ -552,6 +1070,33 @@ public:
     // initial state load in progress?
     bool fetchingnodes;
 
+    // the last fetchnodes() was partial
+    bool partialfetching;
+
+    // folders whose children are being fetched
+    handle_set childfetches;
+
+    // flag the folders without loaded children after a partial fetch
+    void markpartial();
+
+    // a CommandFetchChildren has completed
+    void childrenfetched(handle, bool);
+
+    // the node array of a fetchnodes response that leads its request batch
+    // is processed while it is being received: nodes are created as their
+    // records become complete, and the consumed data is released
+    enum { FNSTREAM_OFF, FNSTREAM_PREFIX, FNSTREAM_NODES, FNSTREAM_DONE };
+    int fnstream;
+    node_vector fnstreamdp;
+    static const char FNSTREAMPREFIX[];
+
+    // consume the complete node records received so far (true if stopped
+    // at the end of a slice)
+    bool streamfetchnodes();
+
+    // link streamed nodes that arrived before their parents
+    void endfetchnodesstream();
+
     // server-client request sequence number
     char scsn[12];
 
@@ -644,12 +1189,49 @@ public:
     // create missing folders, copy/start uploading missing files
     void syncup(LocalNode*, dstime*);
 
+    // move the node of a file that disappeared from a sync (pending
+    // deletion) to a new file with the same fingerprint, false if there is
+    // none or the move isn't permitted
+    bool syncmove(LocalNode*);
+
     // sync putnodes() completion
     void putnodes_sync_result(error, NewNode*, int);
 
     // start downloading/copy missing files, create missing directories
     bool syncdown(LocalNode*, string*, bool);
 
+    // syncup() and syncdown() only descend into folders flagged by
+    // LocalNode::setdirty() - passes started from exec() are additionally
+    // limited to SYNCPASSDS, the dirty subtrees left behind are resumed in
+    // the next iteration
+    static const dstime SYNCPASSDS = 2;
+    dstime syncpassend;
+    unsigned syncpassvisits;
+
+    // the current pass ran out of time
+    bool syncpasscut;
+
+    void startsyncpass();
+    void endsyncpass();
+    bool syncpassexpired();
+
+    // interval of the per-sync statistics reports (Sync::updatestats())
+    static const dstime SYNCSTATSDS = 50;
+    dstime syncstatsds;
+
+    // number of syncs in SYNC_ACTIVE or SYNC_INITIALSCAN state (updated by exec())
+    unsigned syncsactive;
+
+    // the worker pool is shared by all syncs: the fingerprint jobs (at most
+    // SYNCFINGERPRINTJOBS) and the folder listings read ahead (at most
+    // syncscanahead) are divided evenly between the active syncs
+    static const unsigned SYNCFINGERPRINTJOBS = 32;
+    unsigned syncjobshare(unsigned);
+
+    // interval of the filesystem fingerprint verification of the syncs
+    static const dstime FSFPCHECKDS = 10;
+    dstime fsfpcheckds;
+
     // move nodes to //bin/SyncDebris/yyyy-mm-dd/ or unlink directly
     void movetosyncdebris(Node*, bool);
 
@@ -664,6 +1246,23 @@ public:
     // commit all queueud deletions
     void execsyncdeletions();
 
+    // sync-originated moves (renames/moves of synced items and moves to
+    // SyncDebris) share MoveBatches of up to MAXMOVEBATCH moves until the
+    // next API request is sent - a batch's results are processed together
+    // once all of them have arrived, with a single pass over todebris
+    static const unsigned MAXMOVEBATCH = 200;
+
+    // batch open for further moves (NULL: none)
+    MoveBatch* movebatch;
+
+    // batches with results pending
+    set<MoveBatch*> movebatches;
+
+    void movebatch_result(MoveBatch*);
+
+    // active sync with this tag or NULL
+    Sync* syncbytag(int);
+
     // process localnode subtree
     void proclocaltree(LocalNode*, LocalTreeProc*);
 #endif
@@ -674,14 +1273,28 @@ public:
     // update paths of all PUT transfers
     void updateputs();
 
-    // determine if all transfer slots are full
+    // determine if all regular transfer slots are full
     bool slotavail() const;
 
+    // determine if the small-file lane has a free slot
+    bool smallslotavail() const;
+
     // dispatch as many queued transfers as possible
     void dispatchmore(direction_t);
 
-    // transfer queue dispatch/retry handling
-    bool dispatch(direction_t);
+    // request the temporary URLs of the next TEMPURLPREFETCH queued
+    // transfers ahead of their dispatch (at most once per decisecond)
+    void prefetchurls(direction_t);
+    dstime lastprefetch[2];
+    static const unsigned TEMPURLPREFETCH = 16;
+
+    // node handle, privacy and authentication of the file a download
+    // is requested from (false if none of its files is available)
+    bool downloadsource(Transfer*, handle*, bool*, const char**);
+
+    // transfer queue dispatch/retry handling (restricted to the given
+    // TransferScheduler lanes)
+    bool dispatch(direction_t, int = TransferScheduler::LANE_ALL);
 
     void defer(direction_t, int td, int = 0);
     void freeq(direction_t);
@@ -700,12 +1313,40 @@ public:
     // transfer chunk failed
     void setchunkfailed(string*);
     string badhosts;
+
+    // storage hosts for which racing the default and the alternative port
+    // found the alternative one (true) or the default one (false) faster
+    map<string, bool> altports;
+
+    // port preference for the host of a storage URL (-1: unknown / forget)
+    int altportpreference(const string*);
+    void setaltportpreference(const string*, int);
+
+    // storage hosts with failed chunk requests since their last success
+    map<string, StorageHostHealth> storagehosts;
+    static const unsigned CIRCUITFAILURES = 3;
+
+    void storagehostfailed(const string*);
+    void storagehostok(const string*);
+
+    // false while the circuit of the host of a storage URL is open (retry:
+    // time until it can be probed again)
+    bool storagehostavailable(const string*, dstime* retry = NULL);
+
+    // LAN peers holding the content of file nodes: node handle -> chunk URL
+    // base, requested as <url>/<start>-<end> like a storage server (the
+    // chunk and meta MACs verify what peers send)
+    map<handle, string> peerurls;
+
+    void setpeerurl(handle, const char*);
+    void droppeer(handle);
     
     // queue for load balancing requests
     std::queue<CommandLoadBalancing*> loadbalancingreqs;
 
     // process object arrays by the API server
     int readnodes(JSON*, int, putsource_t = PUTNODES_APP, NewNode* = NULL, int = 0, int = 0);
+    int readnode(JSON*, int, putsource_t, NewNode*, int, int, node_vector*);
 
     void readok(JSON*);
     void readokelement(JSON*);
@@ -723,6 +1364,7 @@ public:
 
     void setkey(SymmCipher*, const char*);
     bool decryptkey(const char*, byte*, int, SymmCipher*, int, handle);
+    static int encodedkeylength(const char*);
 
     void handleauth(handle, byte*);
 
@@ -732,7 +1374,7 @@ public:
     void warn(const char*);
     bool warnlevel();
 
-    Node* childnodebyname(Node*, const char*);
+    Node* childnodebyname(Node*, const char*, bool = true);
 
     // purge account state and abort server-client connection
     void purgenodesusersabortsc();
@@ -765,6 +1407,21 @@ public:
     // apply keys
     int applykeys();
 
+    // with a worker pool, keys of at least this many nodes are decrypted in
+    // parallel
+    static const unsigned PARALLELKEYSMIN = 2048;
+    int applykeysparallel();
+
+    // RSA-decrypt a Base64-encoded key (the cipher must not be shared
+    // between threads)
+    static bool rsadecryptkey(AsymmCipher*, const char*, byte*, int);
+
+    // run key batches on the worker pool (the last one on the engine)
+    void runrsakeyjobs(vector<RsaKeyJob*>*);
+
+    // decrypt the RSA-encrypted keys of the queued new shares in parallel
+    void decryptsharekeys();
+
     // symmetric password challenge
     int checktsid(byte* sidbuf, unsigned len);
 
@@ -793,8 +1450,18 @@ public:
     // process node subtree
     void proctree(Node*, TreeProc*, bool skipinshares = false);
 
-    // hash password
-    error pw_key(const char*, byte*) const;
+    // post-order traversal with an explicit stack (deep trees must not
+    // exhaust the call stack)
+    static void walktree(MegaClient*, Node*, TreeProc*, bool);
+
+    // with a worker pool, forkable processors run over trees of at least
+    // this many nodes in up to PARALLELTREEJOBS batches of subtrees
+    static const unsigned PARALLELTREEMIN = 4096;
+    static const unsigned PARALLELTREEJOBS = 16;
+    bool proctreeparallel(Node*, TreeProc*, bool);
+
+    // hash password (no client state involved - also run by worker threads)
+    static error pw_key(const char*, byte*);
 
     // load balancing request
     void loadbalancing(const char *);
@@ -802,8 +1469,6 @@ public:
     // convert hex digit to number
     static int hexval(char);
 
-    SymmCipher tmpcipher;
-
     MegaClient(MegaApp*, Waiter*, HttpIO*, FileSystemAccess*, DbAccess*, GfxProc*, const char*, const char*);
     ~MegaClient();
 };
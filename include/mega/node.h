@@ -25,8 +25,48 @@
 #include "filefingerprint.h"
 #include "file.h"
 #include "attrmap.h"
+#include "workerpool.h"
 
 namespace mega {
+// bounded cache of expanded node key schedules, so that repeated attribute
+// operations on the same nodes skip the AES key setup - direct-mapped by
+// node handle, an entry is reused when another node maps to its slot or the
+// node's key changes (engine thread only)
+class MEGA_API NodeCipherCache
+{
+public:
+    static const int SLOTBITS = 6;
+    static const unsigned SLOTS = 1 << SLOTBITS;
+
+    // NULL if the node has no valid key
+    SymmCipher* get(Node*);
+
+    // discard all schedules (and their key material)
+    void clear();
+
+    NodeCipherCache();
+    ~NodeCipherCache();
+
+protected:
+    struct Slot
+    {
+        handle h;
+
+        // nodekey the schedule was set up from
+        byte key[FILENODEKEYLENGTH];
+        unsigned keylength;
+
+        // allocated on first use
+        SymmCipher* cipher;
+    };
+
+    Slot slots[SLOTS];
+
+private:
+    NodeCipherCache(const NodeCipherCache&);
+    NodeCipherCache& operator=(const NodeCipherCache&);
+};
+
 struct MEGA_API NodeCore
 {
     NodeCore();
@@ -65,42 +105,186 @@ struct MEGA_API NewNode : public NodeCore
 
     bool added;
 
+    // handle of the node created from this record (if added)
+    handle addedhandle;
+
     NewNode()
     {
         syncid = UNDEF;
         added = false;
+        addedhandle = UNDEF;
         source = NEW_NODE;
         uploadhandle = UNDEF;
         localnode = NULL;
     }
 };
 
+// bulk creation of a node tree in several putnodes (see
+// MegaClient::putnodestree())
+struct MEGA_API PutNodesTree
+{
+    // records in parent-before-child order
+    NewNode* nn;
+    int nnsize;
+
+    handle target;
+    int tag;
+
+    // index of each record's parent record (-1: the target)
+    vector<int> parents;
+
+    // batch of each record
+    vector<int> batchof;
+
+    struct Batch
+    {
+        // record whose node is the target of this batch (-1: the tree's
+        // target)
+        int parent;
+
+        vector<int> records;
+    };
+
+    vector<Batch> batches;
+
+    // batches not yet completed
+    unsigned pending;
+
+    // first error reported for a batch
+    error e;
+};
+
+#ifdef ENABLE_SYNC
+// sync-originated moves sent together (see MegaClient::movebatch)
+struct MEGA_API MoveBatch
+{
+    struct Move
+    {
+        handle h;
+
+        // previous parent (UNDEF: not a sync operation)
+        handle pp;
+
+        syncdel_t syncdel;
+        int tag;
+        error e;
+    };
+
+    vector<Move> moves;
+
+    // results not yet received
+    unsigned pending;
+};
+#endif
+
 // filesystem node
 struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
 {
+    // the small fields come first so that they fill the tail padding of
+    // FileFingerprint (see MegaClient::reportnodememory() for the footprint)
+    bool foreignkey : 1;
+
+#ifdef ENABLE_SYNC
+    // queued in client->todebris / client->tounlink
+    // FIXME: merge todebris / tounlink
+    bool intodebris : 1;
+    bool intounlink : 1;
+#endif
+
+    // stored in a state cache snapshot pack (its removal requires a tombstone)
+    bool inpack : 1;
+
+    // folder whose children have not been fetched yet (partial tree fetch)
+    bool partial : 1;
+
+    struct
+    {
+        bool removed : 1;
+        bool attrs : 1;
+        bool owner : 1;
+        bool ctime : 1;
+        bool fileattrstring : 1;
+        bool inshare : 1;
+        bool outshares : 1;
+        bool pendingshares : 1;
+        bool parent : 1;
+    } changed;
+
+    // source tag
+    int tag;
+
+    // own position in parent's children
+    unsigned childindex;
+
+    // hash of the name under which this node is indexed in its parent's
+    // childnames
+    uint32_t namehash;
+
+    // position in client->namesearch
+    uint32_t searchslot;
+
+#ifdef ENABLE_SYNC
+    // state of removal to //bin / SyncDebris
+    syncdel_t syncdeleted;
+#endif
+
     MegaClient* client;
 
     // change parent node association
     bool setparent(Node*);
 
+    // remove from the current parent's children
+    void unlinkparent();
+
     // copy JSON-delimited string
     static void copystring(string*, const char*);
 
     // try to resolve node key string
     bool applykey();
 
-    // set up nodekey in a static SymmCipher
+    // encrypted subkey to use and its cipher (NULL if none)
+    const char* locatekey(SymmCipher**);
+
+    // length of the decrypted node key
+    int keylength() const;
+
+    // cipher of nodekey from the client's NodeCipherCache (valid until the
+    // next nodecipher() call of another node)
     SymmCipher* nodecipher();
 
     // decrypt attribute string and set fileattrs
     void setattr();
 
+    // setattr() in two steps: parse the decrypted attributes (thread-safe),
+    // then update the client state
+    void loadattrs(byte*);
+    void finishattrs();
+
+    // setattr() without deferral
+    void decryptattrs();
+
     // display name (UTF-8)
     const char* displayname() const;
 
-    // node attributes
+    // node attributes (call resolveattrs() before accessing them)
     AttrMap attrs;
 
+    // decryptable attribute string whose decryption is deferred until the
+    // attributes are first needed (see MegaClient::lazyattrs)
+    string* pendingattrs;
+
+    // decrypt deferred attributes - nodes are only accessed with the client
+    // locked, so the memoization needs no further synchronisation
+    void resolveattrs()
+    {
+        if (pendingattrs)
+        {
+            decryptpendingattrs();
+        }
+    }
+
+    void decryptpendingattrs();
+
     // owner
     handle owner;
 
@@ -131,21 +315,6 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     // app-private pointer
     void* appdata;
 
-    bool foreignkey;
-
-    struct
-    {
-        bool removed : 1;
-        bool attrs : 1;
-        bool owner : 1;
-        bool ctime : 1;
-        bool fileattrstring : 1;
-        bool inshare : 1;
-        bool outshares : 1;
-        bool pendingshares : 1;
-        bool parent : 1;
-    } changed;
-    
     void setkey(const byte* = NULL);
 
     void setfingerprint();
@@ -155,14 +324,36 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     // parent
     Node* parent;
 
-    // children
-    node_list children;
+    // children (unordered - removal moves the last child into the gap)
+    node_vector children;
 
-    // own position in parent's children
-    node_list::iterator child_it;
+    // totals of the subtree rooted at this node, including the node itself
+    // (files: bytes and count, folders: everything but files), maintained
+    // along the parent chain by setparent() and unlinkparent()
+    m_off_t treebytes;
+    unsigned treefiles;
+    unsigned treefolders;
+
+    // add (1) or subtract (-1) the subtree totals to/from all ancestors
+    void propagatetotals(int);
+
+    // children by name, built by MegaClient::childnodebyname() for folders
+    // with many children and then kept up to date (NULL if none)
+    NodeNameIndex* childnames;
 
-    // own position in fingerprint set (only valid for file nodes)
-    fingerprint_set::iterator fingerprint_it;
+    // build childnames
+    void indexchildnames();
+
+    // update the parent's childnames after a name change
+    void nameupdated();
+
+    // sorted orderings of the children, built on demand by the caller and
+    // dropped whenever a child is added, removed or its attributes change
+    // (NULL if none)
+    sortedchildren_map* sortedchildren;
+
+    // drop sortedchildren
+    void childrenchanged();
 
 #ifdef ENABLE_SYNC
     // related synced item or NULL
@@ -171,31 +362,139 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     // active sync get
     struct SyncFileGet* syncget;
 
-    // state of removal to //bin / SyncDebris
-    syncdel_t syncdeleted;
-
-    // location in the todebris node_set
-    node_set::iterator todebris_it;
-
-    // location in the tounlink node_set
-    // FIXME: merge todebris / tounlink
-    node_set::iterator tounlink_it;
 #endif
 
-    // source tag
-    int tag;
-
     // check if node is below this node
     bool isbelow(Node*) const;
 
     bool serialize(string*);
+    bool dbkeys(DbNodeKeys*);
     static Node* unserialize(MegaClient*, string*, node_vector*);
 
+    // unserialize a record in place (e.g. within a node pack) - the node
+    // only copies the fields it keeps
+    static Node* unserialize(MegaClient*, const char*, size_t, node_vector*);
+
     Node(MegaClient*, vector<Node*>*, handle, handle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
+
+    // allocated from the client's nodeslab: new (client) Node(client, ...)
+    static void* operator new(size_t, MegaClient*);
+    static void operator delete(void*, MegaClient*);
+    static void operator delete(void*);
+};
+
+// decrypt symmetrically encrypted node keys and the attributes of a batch of
+// nodes on a worker thread - the engine must not touch the nodes until the
+// job has finished, and then applies the results through merge()
+struct MEGA_API NodeKeyJob : public WorkerJob
+{
+    // nodes per job
+    static const unsigned BATCHSIZE = 1024;
+
+    struct Item
+    {
+        Node* node;
+        const char* k;
+        SymmCipher* sc;
+        bool ok;
+        bool attrs;
+    };
+
+    vector<Item> items;
+
+    // only decrypt the keys (the attributes are decrypted lazily)
+    bool keysonly;
+
+    // set at the end of run() (a job withdrawn by WorkerPool::waitfor()
+    // must be run by the engine)
+    bool finished;
+
+    void add(Node*, const char*, SymmCipher*);
+
+    void run();
+    void merge();
+
+    NodeKeyJob(bool);
+};
+
+// decrypt a batch of RSA-encrypted node and share keys on a worker thread
+// with a private copy of the account's RSA key - the engine applies the
+// results once the job has finished
+struct MEGA_API RsaKeyJob : public WorkerJob
+{
+    // keys per job (each takes a private key operation)
+    static const unsigned BATCHSIZE = 16;
+
+    struct Item
+    {
+        // the key belongs to either
+        Node* node;
+        NewShare* share;
+
+        const char* k;
+        byte key[FILENODEKEYLENGTH];
+        int keylength;
+        bool ok;
+    };
+
+    vector<Item> items;
+
+    AsymmCipher asymkey;
+
+    // set at the end of run()
+    bool finished;
+
+    void add(Node*, NewShare*, const char*, int);
+
+    void run();
+
+    RsaKeyJob(const AsymmCipher*);
 };
 
 #ifdef ENABLE_SYNC
+// LocalNode children by name - the map is only allocated once the first
+// child is added (most LocalNodes are files), and then kept until the
+// LocalNode is deleted, so iterators stay valid as with a plain map
+class MEGA_API LocalNodeChildren
+{
+    localnode_map* m;
+
+    // begin()/end() of an unallocated map
+    static localnode_map none;
+
+    // not copyable
+    LocalNodeChildren(const LocalNodeChildren&);
+    LocalNodeChildren& operator=(const LocalNodeChildren&);
+
+public:
+    typedef localnode_map::iterator iterator;
+
+    iterator begin() { return m ? m->begin() : none.begin(); }
+    iterator end() { return m ? m->end() : none.end(); }
+
+    iterator find(const string* name) { return m ? m->find(name) : none.end(); }
+
+    size_t erase(const string* name) { return m ? m->erase(name) : 0; }
+
+    LocalNode*& operator[](const string* name)
+    {
+        if (!m)
+        {
+            m = new localnode_map;
+        }
+
+        return (*m)[name];
+    }
+
+    size_t size() const { return m ? m->size() : 0; }
+
+    bool allocated() const { return m != NULL; }
+
+    LocalNodeChildren() : m(NULL) { }
+    ~LocalNodeChildren() { delete m; }
+};
+
 struct MEGA_API LocalNode : public File, Cachable
 {
     class Sync* sync;
@@ -207,11 +506,11 @@ struct MEGA_API LocalNode : public File, Cachable
     int32_t parent_dbid;
 
     // children by name
-    localnode_map children;
+    LocalNodeChildren children;
 
     // for botched filesystems with legacy secondary ("short") names
     string slocalname;
-    localnode_map schildren;
+    LocalNodeChildren schildren;
 
     // local filesystem node ID (inode...) for rename/move detection
     handle fsid;
@@ -248,18 +547,55 @@ struct MEGA_API LocalNode : public File, Cachable
 
         // checked for missing attributes
         bool checked : 1;
+
+        // folders: this folder or one below needs another syncup() /
+        // syncdown() pass
+        bool syncupdirty : 1;
+        bool syncdowndirty : 1;
+
+        // ts is included in the parent's counts (as cts)
+        bool tscounted : 1;
     };
 
     // current subtree sync state: current and displayed
     treestate_t ts, dts;
 
+    // state as counted in the parent
+    treestate_t cts;
+
+    // folders: number of children in TREESTATE_PENDING resp.
+    // TREESTATE_SYNCING, so that the folder's state is known without a
+    // scan of its children
+    unsigned pendingchildren;
+    unsigned syncingchildren;
+
     // update sync state all the way to the root node
     void treestate(treestate_t = TREESTATE_NONE);
 
+    // add (1) or remove (-1) cts to/from the parent's counts
+    void counttreestate(int);
+
     // timer to delay upload start
     dstime nagleds;
     void bumpnagleds();
 
+    // flag the containing folder (and the folder itself) all the way up to
+    // the sync root for the next syncup() / syncdown() passes
+    void setdirty();
+
+    // status change time of the file when it was last fingerprinted
+    // (0: unknown)
+    m_time_t ctime;
+
+    // folders: mtime as of the last listing whose entries have all been
+    // processed (0: unknown), and as of the last listing
+    m_time_t dirmtime;
+    m_time_t listedmtime;
+
+    // pending fingerprint computation, if any (size/mtime/CRCs are not
+    // current until it completes)
+    struct SyncFingerprintJob* fingerprintjob;
+
     // if delage > 0, own iterator inside MegaClient::localsyncnotseen
     localnode_set::iterator notseen_it;
 
@@ -267,6 +603,14 @@ struct MEGA_API LocalNode : public File, Cachable
     void getlocalpath(string*, bool sdisable = false) const;
     void getlocalsubpath(string*) const;
 
+    // full local path of this folder (short names where available), cached
+    // until any LocalNode is renamed or moved (MegaClient::localpathgen)
+    const string* folderpath() const;
+
+    // (allocated on first use)
+    mutable string* cachedpath;
+    mutable unsigned cachedpathgen;
+
     // return child node by name
     LocalNode* childbyname(string*);
 
@@ -290,6 +634,11 @@ struct MEGA_API LocalNode : public File, Cachable
     static LocalNode* unserialize( Sync* sync, string* sData );
 
     ~LocalNode();
+
+    // allocated from the client's localnodeslab: new (client) LocalNode
+    static void* operator new(size_t, MegaClient*);
+    static void operator delete(void*, MegaClient*);
+    static void operator delete(void*);
 };
 #endif
 } // namespace
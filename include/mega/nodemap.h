@@ -0,0 +1,346 @@
+/**
+ * @file mega/nodemap.h
+ * @brief Indexes of nodes by node handle and by name
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_NODEMAP_H
+#define MEGA_NODEMAP_H 1
+
+#include "types.h"
+
+namespace mega {
+// open-addressing (linear probing) hash table mapping node handles to Node
+// pointers - node handles are 48 bits wide, so UNDEF marks empty slots
+//
+// iteration order is unspecified; iterators remain valid (and the order
+// stable) as long as no handles are added or erased
+class MEGA_API NodeMap
+{
+public:
+    struct Slot
+    {
+        handle first;
+        Node* second;
+    };
+
+    class iterator
+    {
+        Slot* p;
+        Slot* last;
+
+        void skip()
+        {
+            while (p != last && p->first == UNDEF)
+            {
+                p++;
+            }
+        }
+
+    public:
+        Slot& operator*() const { return *p; }
+        Slot* operator->() const { return p; }
+
+        iterator& operator++() { p++; skip(); return *this; }
+        iterator operator++(int) { iterator t = *this; ++*this; return t; }
+
+        bool operator==(const iterator& o) const { return p == o.p; }
+        bool operator!=(const iterator& o) const { return p != o.p; }
+
+        iterator(Slot* cp = NULL, Slot* clast = NULL, bool cskip = false) : p(cp), last(clast)
+        {
+            if (cskip)
+            {
+                skip();
+            }
+        }
+    };
+
+    iterator begin() { return iterator(slots, slots + capacity, true); }
+    iterator end() { return iterator(slots + capacity, slots + capacity); }
+
+    iterator find(handle h)
+    {
+        // (UNDEF marks empty slots and is never stored)
+        if (count && h != UNDEF)
+        {
+            for (size_t i = slot(h); ; i = (i + 1) & (capacity - 1))
+            {
+                if (slots[i].first == h)
+                {
+                    return iterator(slots + i, slots + capacity);
+                }
+
+                if (slots[i].first == UNDEF)
+                {
+                    break;
+                }
+            }
+        }
+
+        return end();
+    }
+
+    // lookup with insertion of a NULL entry if not present - UNDEF is
+    // rejected (a detached NULL entry is returned, not stored)
+    Node*& operator[](handle);
+
+    // returns the number of entries removed (0 or 1)
+    size_t erase(handle);
+
+    size_t size() const { return count; }
+
+    // number of allocated slots
+    size_t allocated() const { return capacity; }
+
+    void clear();
+
+    // grow the table to hold at least this many entries without rehashing
+    void reserve(size_t);
+
+    NodeMap();
+    ~NodeMap();
+
+protected:
+    // the table grows once it is 3/4 full and shrinks below 1/8 (power-of-two
+    // capacities, 16 bytes per slot)
+    static const size_t MINCAPACITY = 64;
+
+    Slot* slots;
+    size_t capacity;
+    size_t count;
+
+    // log2(capacity)
+    int bits;
+
+    // the detached entry returned for UNDEF
+    Node* undefentry;
+
+    // Fibonacci hashing: node handles are random, but the multiplication
+    // also spreads sequential handles
+    size_t slot(handle h) const
+    {
+        return (size_t)((h * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+    }
+
+    void rehash(size_t);
+
+private:
+    // not copyable
+    NodeMap(const NodeMap&);
+    NodeMap& operator=(const NodeMap&);
+};
+
+// maps node handles to Node pointers
+typedef NodeMap node_map;
+
+// open-addressing (linear probing) multiset of pointers under precomputed
+// 32-bit hashes - the base of the name and fingerprint indexes
+class MEGA_API HashedPointerSet
+{
+public:
+    size_t size() const { return count; }
+
+    // number of allocated slots
+    size_t allocated() const { return capacity; }
+
+    void reserve(size_t);
+
+    void clear();
+
+    HashedPointerSet();
+    ~HashedPointerSet();
+
+protected:
+    static const size_t MINCAPACITY = 16;
+
+    struct Slot
+    {
+        uint32_t hash;
+
+        // NULL: empty
+        void* item;
+    };
+
+    Slot* slots;
+    size_t capacity;
+    size_t count;
+
+    // log2(capacity)
+    int bits;
+
+    size_t slot(uint32_t h) const
+    {
+        return (size_t)((h * 0x9e3779b9U) >> (32 - bits));
+    }
+
+    size_t next(size_t i) const
+    {
+        return (i + 1) & (capacity - 1);
+    }
+
+    void rehash(size_t);
+
+    void insert(uint32_t, void*);
+
+    // remove the item stored under this hash, returns false if not present
+    bool erase(uint32_t, void*);
+
+private:
+    // not copyable
+    HashedPointerSet(const HashedPointerSet&);
+    HashedPointerSet& operator=(const HashedPointerSet&);
+};
+
+// hash index of a folder's children by name (names can clash)
+//
+// entries are located through the hash of the name they were added under,
+// which the caller stores in Node::namehash, so a node must be removed
+// before its name changes
+class MEGA_API NodeNameIndex : public HashedPointerSet
+{
+public:
+    // folders are indexed once they have at least this many children
+    static const size_t MINCHILDREN = 32;
+
+    static uint32_t hash(const char*);
+
+    // add node (under its namehash)
+    void add(Node*);
+
+    // returns false if the node was not present
+    bool remove(Node*);
+
+    // returns a node with this (normalized) name or NULL
+    Node* find(const char*) const;
+};
+
+// refcounted pool of interned names: equal names share a single buffer, so
+// two names of the same pool are equal iff their pointers are - not
+// thread-safe (callers sharing a pool across threads serialize access)
+class MEGA_API NamePool : public HashedPointerSet
+{
+public:
+    // returns the interned copy of the name and takes a reference to it
+    const char* acquire(const char*);
+
+    // drop a reference to an interned name (freed with the last one)
+    void release(const char*);
+
+    // bytes of the interned names
+    size_t footprint() const { return bytes; }
+
+    NamePool();
+
+protected:
+    // header of each interned name, which follows it
+    struct Entry
+    {
+        uint32_t refs;
+        uint32_t hash;
+    };
+
+    static Entry* entry(const char* name)
+    {
+        return (Entry*)name - 1;
+    }
+
+    size_t bytes;
+};
+
+// hash index of file fingerprints by size, mtime and sparse CRC (several
+// files can share a fingerprint)
+//
+// entries are located through their current fingerprint, so they must be
+// removed before it changes
+class MEGA_API FingerprintIndex : public HashedPointerSet
+{
+public:
+    static uint32_t hash(const FileFingerprint*);
+
+    void add(FileFingerprint* f)
+    {
+        insert(hash(f), f);
+    }
+
+    // returns false if not present
+    bool remove(FileFingerprint* f)
+    {
+        return erase(hash(f), f);
+    }
+
+    // returns an entry with the same size, mtime and sparse CRC or NULL
+    FileFingerprint* find(const FileFingerprint*) const;
+
+    // append all matching entries
+    void findall(const FileFingerprint*, vector<FileFingerprint*>*) const;
+
+protected:
+    static bool matches(const FileFingerprint*, const FileFingerprint*);
+};
+
+// substring search over all node names: the names are kept case-folded
+// (ASCII, as strcasestr()) in one contiguous pool, which a search scans in
+// a single pass instead of walking the tree
+//
+// built on first use, then maintained through Node::nameupdated() and the
+// Node destructor (Node::searchslot: 1-based slot, 0: not indexed)
+class MEGA_API NameSearchIndex
+{
+public:
+    bool active() const { return built; }
+
+    // index all nodes
+    void build(node_map*);
+
+    // deactivate and release
+    void clear();
+
+    // add node or replace its name
+    void update(Node*);
+    void remove(Node*);
+
+    // append all nodes whose name contains the string (case-insensitive)
+    void find(const char*, node_vector*) const;
+
+    // bytes allocated
+    size_t footprint() const;
+
+    NameSearchIndex();
+
+protected:
+    bool built;
+
+    // names, each terminated by a NUL
+    string pool;
+
+    // parallel: start of each slot's name, node (NULL: free)
+    vector<uint32_t> offsets;
+    vector<Node*> slots;
+
+    // bytes of freed names in the pool
+    size_t garbage;
+
+    static void fold(const char*, string*);
+
+    // drop the freed names once they make up most of the pool
+    void compact();
+};
+} // namespace
+
+#endif
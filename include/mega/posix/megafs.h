@@ -34,6 +34,18 @@
 
 #include "mega.h"
 
+#ifdef USE_IOURING
+#include <liburing.h>
+#endif
+
+#ifdef USE_FANOTIFY
+#include <sys/fanotify.h>
+#endif
+
+#ifdef USE_FSEVENTSTREAM
+#include <pthread.h>
+#endif
+
 #define DEBRISFOLDER ".debris"
 
 namespace mega {
@@ -66,6 +78,47 @@ public:
     string lastname;
 #endif
 
+#ifdef USE_FANOTIFY
+    // filesystem-wide notification (one mark per filesystem) - directories
+    // are identified by fsid and file handle, directories on filesystems
+    // that cannot be marked fall back to inotify
+    int fanotifyfd;
+
+    typedef map<string, LocalNode*> fhlocalnode_map;
+    fhlocalnode_map fhnodes;
+    map<LocalNode*, string> nodefhs;
+
+    // fsids of the marked filesystems
+    set<string> fanotifyfs;
+
+    bool fanotifyadd(LocalNode*, string*);
+    bool fanotifydel(LocalNode*);
+#endif
+
+    // event read buffer
+    static const unsigned NOTIFYBUFSIZE = 65536;
+    vector<char> notifybuf;
+
+#ifdef USE_FSEVENTSTREAM
+    // FSEvents API (macOS): the streams of all syncs run on one serial
+    // dispatch queue (dispatch_queue_t), whose callbacks queue the events
+    // for the engine and signal fseventspipe
+    void* fseventsqueue;
+    int fseventspipe[2];
+
+    struct FSEventRecord
+    {
+        class PosixDirNotify* dirnotify;
+        string path;
+        uint32_t flags;
+        uint64_t id;
+    };
+
+    // guarded by fseventsmutex
+    pthread_mutex_t fseventsmutex;
+    vector<FSEventRecord> fseventsq;
+#endif
+
     bool notifyerr;
 
     FileAccess* newfileaccess();
@@ -95,7 +148,22 @@ public:
 
     void osversion(string*) const;
 
-    static void emptydirlocal(string*, dev_t = 0);
+    // (progress is reported to/cancelled through the optional LocalRemoval)
+    static void emptydirlocal(string*, dev_t = 0, LocalRemoval* = NULL);
+
+#ifdef USE_IOURING
+    // asynchronous file I/O submission ring - completions are signalled
+    // through the eventfd ringfd (engine thread only)
+    struct io_uring ring;
+    int ringfd;
+    unsigned ringpending;
+
+    static const unsigned RINGENTRIES = 64;
+
+    bool asyncsubmit(int, AsyncIOContext*);
+    void asynccomplete(struct io_uring_cqe*);
+    void asyncwait(AsyncIOContext*);
+#endif
 
     PosixFileSystemAccess(int = -1);
     ~PosixFileSystemAccess();
@@ -115,6 +183,21 @@ public:
     bool fread(string *, unsigned, unsigned, m_off_t);
     bool frawread(byte *, unsigned, m_off_t);
     bool fwrite(const byte *, unsigned, m_off_t);
+    bool fpreallocate(m_off_t);
+    bool setdirectio();
+    bool concurrentio();
+
+    // fd is in O_DIRECT mode
+    bool directio;
+
+    PosixFileSystemAccess* fsaccess;
+
+#ifdef USE_IOURING
+    bool asyncavailable();
+    AsyncIOContext* asyncfread(byte*, unsigned, m_off_t);
+    AsyncIOContext* asyncfwrite(const byte*, unsigned, m_off_t);
+    void asyncwait(AsyncIOContext*);
+#endif
 
     bool sysread(byte *, unsigned, m_off_t);
     bool sysstat(m_time_t*, m_off_t*);
@@ -135,6 +218,20 @@ public:
 
     fsfp_t fsfingerprint();
 
+#ifdef USE_FSEVENTSTREAM
+    // stream of the sync's tree (FSEventStreamRef), rooted at the real path
+    void* stream;
+    string streamroot;
+
+    // journal position: last delivered event ID and volume UUID
+    uint64_t lastid;
+    string volumeuuid;
+
+    bool start(const string*);
+    void stop();
+    bool journalpos(string*);
+#endif
+
     PosixDirNotify(string*, string*);
 };
 } // namespace
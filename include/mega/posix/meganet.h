@@ -31,9 +31,15 @@
 #include <curl/curl.h>
 #include <ares.h>
 
+// TLS session export/import
+#if LIBCURL_VERSION_NUM >= 0x080c00
+#define HAVE_CURL_SSLS 1
+#endif
+
 namespace mega {
 
 struct MEGA_API CurlDNSEntry;
+struct MEGA_API CurlDNSPrefetch;
 struct MEGA_API CurlHttpContext;
 class CurlHttpIO: public HttpIO
 {
@@ -41,6 +47,12 @@ protected:
     string useragent;
     CURLM* curlm;
     CURLSH* curlsh;
+
+    // curlsh was created by this instance (not set through setshare())
+    bool ownshare;
+
+    static void share_lock(CURL*, curl_lock_data, curl_lock_access, void*);
+    static void share_unlock(CURL*, curl_lock_data, void*);
     ares_channel ares;
     string proxyurl;
     string proxyscheme;
@@ -57,6 +69,16 @@ protected:
     std::queue<CurlHttpContext *> pendingrequests;
     std::map<string, CurlDNSEntry> dnscache;
 
+    // DNS lookups started ahead of the first request to a host, by hostname
+    std::map<string, CurlDNSPrefetch*> dnsprefetches;
+
+    static void dnsprefetch_a_callback(void*, int, int, unsigned char*, int);
+    static void dnsprefetch_aaaa_callback(void*, int, int, unsigned char*, int);
+    static void dnsprefetch_result(CurlDNSPrefetch*, int, unsigned char*, int, bool);
+
+    // look up a request's host in the cache, in a pending prefetch or via c-ares
+    void resolve(CurlHttpContext*);
+
     void send_pending_requests();
     void drop_pending_requests();
 
@@ -73,7 +95,6 @@ protected:
     static void ares_completed_callback(void*, int, int, struct hostent*);
     static void send_request(CurlHttpContext*);
     void request_proxy_ip();
-    static struct curl_slist* clone_curl_slist(struct curl_slist*);
     static bool crackurl(string*, string*, string*, int*);
     static int debug_callback(CURL*, curl_infotype, char*, size_t, void*);
     bool ipv6available();
@@ -82,14 +103,94 @@ protected:
     bool reset;
     bool statechange;
     string dnsservers;
-    curl_slist* contenttypejson;
-    curl_slist* contenttypebinary;
     WAIT_CLASS* waiter;
 
+    // HTTP/2 multiplexing enabled
+    bool multiplex;
+
+    // idle connections kept open by the multi handle
+    static const int CONNECTIONCACHESIZE = 64;
+
+    // TCP keep-alive probe interval in seconds
+    static const int KEEPALIVEIDLE = 60;
+
+    void setupmulti();
+
+#ifdef USE_EVENTPOLL
+    // socket-callback mode: curl's sockets are watched by the waiter's event
+    // poller instead of being added to the select() set each cycle
+    std::map<curl_socket_t, int> curlsockets;
+    // (milliseconds, on the clock of Waiter::dsms - -1: none)
+    int64_t curltimeoutms;
+
+    static int socket_callback(CURL*, curl_socket_t, int, void*, void*);
+    static int timer_callback(CURLM*, long, void*);
+#endif
+
+    // recycled easy handles
+    static const unsigned MAXCURLPOOL = 64;
+    std::vector<CURL*> curlpool;
+
+    CURL* getcurl();
+    void releasecurl(CURL*);
+    void clearcurlpool();
+    void setupcurl(CURL*);
+
+#ifdef HAVE_CURL_SSLS
+    // a request opened a new connection since the last TLS session export
+    bool tlssessionschanged;
+
+    static CURLcode ssls_export_callback(CURL*, void*, const char*, const unsigned char*, size_t,
+                                         const unsigned char*, size_t, curl_off_t, int, const char*, size_t);
+#endif
+
+    // shared request header lists (CurlHttpContext::headers points into these)
+    std::map<string, curl_slist*> headerlists;
+    curl_slist* getheaders(HttpReq*, const string*);
+
+    // socket I/O (c-ares and the multi handle)
+    void pump();
+
+    // process the completed requests
+    bool harvest();
+
+    // running transfers after the last pump()
+    int runninghandles;
+
+    // dedicated I/O thread: pump() runs on it, with a waiter of its own,
+    // while harvest() and all other entry points run on the engine's thread
+    // under iomutex
+    Thread* iothread;
+    Mutex* iomutex;
+    WAIT_CLASS* iowaiter;
+    bool iostop;
+
+    // the engine's waiter, woken up by the I/O thread
+    WAIT_CLASS* enginewaiter;
+
+    // state at the last engine wakeup
+    int iorunning;
+    dstime iolastdata;
+
+    static void* iothreadentry(void*);
+    void ioloop();
+
+    // holds iomutex for its scope and wakes up the I/O thread on release
+    // (no-op without one)
+    struct IOLock
+    {
+        Mutex* mutex;
+        WAIT_CLASS* waiter;
+
+        IOLock(Mutex*, WAIT_CLASS*);
+        ~IOLock();
+    };
+
 public:
     void post(HttpReq*, const char* = 0, unsigned = 0);
     void cancel(HttpReq*);
     void sendchunked(HttpReq*);
+    void resumereceive(HttpReq*);
 
     m_off_t postpos(void*);
 
@@ -101,7 +202,27 @@ public:
     void setproxy(Proxy*);
     Proxy* getautoproxy();
     void setdnsservers(const char*);
+    void prefetchdns(const string*);
+    bool exporttlssessions(string*);
+    void importtlssessions(string*);
     void disconnect();
+    bool setmultiplexing(bool);
+
+    void lock();
+    void unlock();
+
+    bool startiothread(Thread*, Mutex*);
+    void stopiothread();
+
+    // use a share handle from newshare() instead of this instance's own
+    // (before the first request)
+    void setshare(CURLSH*);
+
+    // share handle with the DNS and TLS session caches for instances running
+    // on different threads - locks holds one mutex per curl_lock_data
+    // (CURL_LOCK_DATA_LAST) and must outlive the handle
+    static CURLSH* newshare(Mutex** locks);
+    static void deleteshare(CURLSH*);
 
     CurlHttpIO();
     ~CurlHttpIO();
@@ -133,8 +254,26 @@ struct MEGA_API CurlDNSEntry
 
     string ipv4;
     dstime ipv4timestamp;
+    dstime ipv4ttl;
     string ipv6;
     dstime ipv6timestamp;
+    dstime ipv6ttl;
+
+    // cached address present and not expired
+    bool ipv4valid() const;
+    bool ipv6valid() const;
+};
+
+struct MEGA_API CurlDNSPrefetch
+{
+    CurlHttpIO* httpio;
+    string hostname;
+
+    // outstanding A/AAAA queries
+    int pending;
+
+    // requests to the host posted before the lookup completed
+    std::vector<CurlHttpContext*> waiting;
 };
 
 } // namespace
@@ -24,10 +24,15 @@
 
 #include "mega/waiter.h"
 
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+#define USE_EVENTPOLL 1
+#endif
+
 namespace mega {
 struct PosixWaiter : public Waiter
 {
     PosixWaiter();
+    ~PosixWaiter();
 
     int maxfd;
     fd_set rfds, wfds, efds;
@@ -41,8 +46,28 @@ struct PosixWaiter : public Waiter
 
     void notify();
 
+    // persistent interest in descriptors that are too many for select()
+    // (epoll on Linux, kqueue on BSD/macOS) - only the poll descriptor itself
+    // joins the select() set, ready descriptors are collected after wakeup
+    static const int WATCH_READ = 1;
+    static const int WATCH_WRITE = 2;
+    static const int WATCH_ERROR = 4;
+
+    // is an event poller available?
+    bool canwatch() const;
+
+    // register, update or (no events) remove a descriptor
+    bool watch(int, int);
+
+    // watched descriptors reported ready by wait(), with their WATCH_* events
+    // (to be consumed by the watching component)
+    vector<pair<int, int> > readyfds;
+
 protected:
     int m_pipe[2];
+    int pollfd;
+
+    void collectready();
 };
 } // namespace
 
@@ -30,16 +30,39 @@ class MEGA_API Request
 {
     vector<Command*> cmds;
 
+    // next command whose result is to be processed
+    int next;
+
 public:
     void add(Command*);
 
     int cmdspending() const;
 
+    // first queued command (NULL if none)
+    Command* first() const;
+
+    // move the independent commands to another request, keeping their order
+    void extractindependent(Request*);
+
+    // keep at most maxbulk bulk commands: the dependent commands from the
+    // first excess one on are moved to the front of the given request
+    // (independent commands always stay, so neither class starves)
+    void limitbulk(Request*, int maxbulk);
+
     void get(string*) const;
 
-    void procresult(MegaClient*);
+    // process the results of the commands - with a nonzero deadline
+    // (Waiter::us()), processing stops at the first command boundary past
+    // it and false is returned: the next call continues with the following
+    // result from the client's JSON position
+    bool procresult(MegaClient*, int64_t = 0);
+
+    // results have been processed partially
+    bool started() const;
 
     void clear();
+
+    Request();
 };
 } // namespace
 
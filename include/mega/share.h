@@ -61,6 +61,10 @@ struct MEGA_API NewShare
     byte key[SymmCipher::BLOCKSIZE];
     byte auth[SymmCipher::BLOCKSIZE];
 
+    // RSA-encrypted share key (Base64) to be decrypted together with the
+    // others before the share is merged (MegaClient::decryptsharekeys())
+    string rsakey;
+
     NewShare(handle, int, handle, accesslevel_t, m_time_t, const byte*, const byte* = NULL, handle = UNDEF, bool = false);
 };
 } // namespace
@@ -29,17 +29,48 @@ namespace mega {
 class MEGA_API ShareNodeKeys
 {
     node_vector shares;
+
+    // (the share nodes may be gone by the time a later batch is emitted)
+    handle_vector sharehandles;
+
     vector<string> items;
 
-    string keys;
+    // node keys to be encrypted to their shares (in item order)
+    struct PendingKey
+    {
+        int share;
+        int item;
+        byte key[FILENODEKEYLENGTH];
+        int keylength;
+    };
+
+    vector<PendingKey> pending;
+
+    // number of pending keys already encrypted
+    unsigned encrypted;
 
     int addshare(Node*);
 
 public:
+    // keys per encryption job
+    static const unsigned ENCRYPTBATCH = 4096;
+
     void add(Node*, Node*, int);
     void add(NodeCore*, Node*, int, const byte* = NULL, int = 0);
 
-    void get(Command*);
+    // append the keys queued by another instance (before encrypt())
+    void merge(ShareNodeKeys*);
+
+    // number of items
+    unsigned size() const { return items.size(); }
+
+    // encrypt the queued keys - with a worker pool, in parallel batches
+    void encrypt(WorkerPool* = NULL);
+
+    // emit the cr element for count items from first on
+    void get(Command*, unsigned first = 0, unsigned count = ~0U);
+
+    ShareNodeKeys();
 };
 } // namespace
 
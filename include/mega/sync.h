@@ -26,11 +26,106 @@
 #include "megaclient.h"
 
 namespace mega {
+// directory listing read ahead on a worker thread
+struct MEGA_API DirScanJob : public WorkerJob
+{
+    // created by the engine
+    DirAccess* da;
+
+    // absolute path of the folder
+    string localpath;
+
+    bool followsymlinks;
+
+    // results, valid once finished is set
+    bool success;
+    vector<string> names;
+    vector<nodetype_t> types;
+
+    // metadata from the listing (type TYPE_UNKNOWN: not provided)
+    vector<DirEntryStat> stats;
+
+    bool finished;
+
+    void list(FileAccess*);
+    void run();
+
+    DirScanJob(DirAccess*, string*, bool);
+    ~DirScanJob();
+};
+
+typedef map<string, DirScanJob*> dirscanjob_map;
+
+// fingerprint of a new or changed local file computed on a worker thread
+struct MEGA_API SyncFingerprintJob : public WorkerJob
+{
+    // NULL if the LocalNode was deleted or rechecked in the meantime
+    LocalNode* localnode;
+
+    // open file, owned
+    FileAccess* fa;
+
+    // starts out as the LocalNode's current fingerprint
+    FileFingerprint fingerprint;
+    bool changed;
+
+    // new LocalNode (addition rather than change)
+    bool newnode;
+
+    // the change was already reported to the app
+    bool reported;
+
+    void run();
+
+    SyncFingerprintJob(LocalNode*, FileAccess*, bool, bool);
+    ~SyncFingerprintJob();
+};
+
+typedef list<SyncFingerprintJob*> syncfingerprintjob_list;
+
+// performance counters, reported every MegaClient::SYNCSTATSDS
+// (MegaApp::syncupdate_stats())
+struct MEGA_API SyncStats
+{
+    // pending filesystem notifications and retries
+    unsigned direvents;
+    unsigned retries;
+
+    // files fingerprinted, in total and per second since the last report
+    m_off_t fingerprinted;
+    m_off_t fingerprintrate;
+
+    // bytes still to be transferred by this sync's uploads / downloads
+    m_off_t pendingup;
+    m_off_t pendingdown;
+
+    // duration of the last syncdown() / syncup() pass over this sync and of
+    // the last state cache flush
+    dstime syncdownds;
+    dstime syncupds;
+    dstime cacheflushds;
+
+    // filesystem events received / skipped by the coalescing
+    m_off_t notifications;
+    m_off_t superseded;
+
+    SyncStats();
+};
+
 class MEGA_API Sync
 {
 public:
     MegaClient* client;
 
+    SyncStats stats;
+
+    // refresh the counters sampled at report time and report them
+    void updatestats();
+
+    // fingerprinted count and time of the previous report
+    m_off_t statsfingerprinted;
+    dstime statsds;
+
     // root of local filesystem tree, holding the sync's root folder
     LocalNode localroot;
 
@@ -56,11 +151,33 @@ public:
     void statecacheadd(LocalNode*);
 
     // recursively add children
-    void addstatecachechildren(uint32_t, idlocalnode_map*, string*, LocalNode*, int);
+    void addstatecachechildren(uint32_t, idlocalnode_vector*, string*, LocalNode*, int);
     
     // Caches all synchronized LocalNode
     void cachenodes();
 
+    // during the initial scan, the queues are also saved every
+    // CACHECHECKPOINTDS
+    static const dstime CACHECHECKPOINTDS = 300;
+    dstime cachecheckpoint;
+
+    // an interrupted initial scan is resumed: the folders completed before a
+    // checkpoint keep their dirmtime, which lets the next start skip them
+    // as unchanged - the record SCANRECORD (below the first allocated dbid)
+    // is present while the initial scan is incomplete
+    static const uint32_t SCANRECORD = 1;
+    bool scanrecord;
+    bool resumescan;
+
+    // commit the dirmtimes of the folders whose subtrees have been scanned
+    // completely (queued notifications and fingerprints mark their folder as
+    // incomplete) - returns true if l is complete
+    bool checkpointscan(LocalNode*, const localnode_set*);
+    void checkpointscan();
+
+    // drop the dirmtimes of a previous scan
+    void cleardirmtimes(LocalNode*);
+
     // change state, signal to application
     void changestate(syncstate_t);
 
@@ -68,13 +185,18 @@ public:
     DirNotify* dirnotify;
 
     // process and remove one directory notification queue item from *notify
+    // (for at most SCANSLICEUS per call, so that the other syncs get their turn)
+    static const int SCANSLICEUS = 20000;
     dstime procscanq(int);
 
     // recursively look for vanished child nodes and delete them
     void deletemissing(LocalNode*);
 
     // scan specific path
-    LocalNode* checkpath(LocalNode*, string*, string* = NULL);
+    LocalNode* checkpath(LocalNode*, string*, string* = NULL, const DirEntryStat* = NULL);
+
+    // recheck all entries of a folder (collapsed burst of notifications)
+    LocalNode* rescanfolder(LocalNode*, string*);
 
     m_off_t localbytes;
     unsigned localnodes[2];
@@ -83,8 +205,48 @@ public:
     LocalNode* localnodebypath(LocalNode*, string*, LocalNode** = NULL, string* = NULL);
 
     // scan items in specified path and add as children of the specified
-    // LocalNode
-    bool scan(string*, FileAccess*);
+    // LocalNode (whose listedmtime is updated, if given)
+    bool scan(string*, FileAccess*, LocalNode* = NULL);
+
+    // full scans: take a folder's cached subtree as present
+    // (MegaClient::syncskipunchanged)
+    void skipsubtree(LocalNode*);
+
+    // promote the folder mtimes of the processed listings (the entries of
+    // all queued scan results must be in the LocalNode tree)
+    void commitdirmtimes(LocalNode*);
+
+    // listings of subfolders read ahead by the worker pool while the scan
+    // proceeds (up to MegaClient::syncscanahead in flight)
+    dirscanjob_map scanjobs;
+
+    // queue a read-ahead listing of the folder
+    void prefetchscan(string*);
+
+    // wait for and discard unused read-ahead listings
+    void dropscanjobs();
+
+    // files being fingerprinted by the worker pool (at most FINGERPRINTJOBS
+    // and the sync's share of MegaClient::SYNCFINGERPRINTJOBS, further files
+    // are fingerprinted inline)
+    static const unsigned FINGERPRINTJOBS = 8;
+    syncfingerprintjob_list fingerprintjobs;
+
+    // fingerprint l on the worker pool, taking over fa - returns false if
+    // the engine has to do it inline
+    bool queuefingerprint(LocalNode*, FileAccess*, bool, bool);
+
+    // apply completed fingerprints to their LocalNodes
+    void procfingerprints();
+
+    // can l's fingerprint be trusted for the file opened in fa? (fsid, size,
+    // mtime and ctime unchanged - without a ctime, only if trustmtime)
+    bool fingerprintcurrent(LocalNode*, FileAccess*, bool);
+
+    // the current full scan refingerprints all files
+    // (MegaClient::syncverifyinterval)
+    bool verifyscan;
+    dstime lastverify;
 
     // own position in session sync list
     sync_list::iterator sync_it;
@@ -105,6 +267,12 @@ public:
     // state cache table
     DbTable* statecachetable;
 
+    // change journal position saved with the state cache (record 0, kept
+    // below JOURNALMAXSIZE, the minimum size of a LocalNode record, so that
+    // older versions skip it)
+    static const size_t JOURNALMAXSIZE = 28;
+    string journal;
+
     // move file or folder to localdebris
     bool movetolocaldebris(string* localpath);
 
@@ -28,6 +28,7 @@ class Thread
 public:
     virtual void start(void *(*start_routine)(void*), void *parameter) = 0;
     virtual void join() = 0;
+    virtual ~Thread() { }
 };
 
 class Mutex
@@ -36,6 +37,15 @@ public:
     virtual void init(bool recursive) = 0;
     virtual void lock() = 0;
     virtual void unlock() = 0;
+    virtual ~Mutex() { }
+};
+
+class Semaphore
+{
+public:
+    virtual void release() = 0;
+    virtual void wait() = 0;
+    virtual ~Semaphore() { }
 };
 
 } // namespace
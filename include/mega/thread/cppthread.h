@@ -28,6 +28,7 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 
 namespace mega {
 
@@ -37,6 +38,9 @@ public:
 	CppThread();
     virtual void start(void *(*start_routine)(void*), void *parameter);
     virtual void join();
+
+    // identifier of the calling thread
+    static unsigned long long currentid();
 	virtual ~CppThread();
 
 protected:
@@ -58,6 +62,20 @@ protected:
 	std::recursive_mutex *rmutex;
 };
 
+class CppSemaphore : public Semaphore
+{
+public:
+	CppSemaphore();
+    virtual void release();
+    virtual void wait();
+	virtual ~CppSemaphore();
+
+protected:
+	unsigned count;
+	std::mutex mtx;
+	std::condition_variable cv;
+};
+
 } // namespace
 
 #endif
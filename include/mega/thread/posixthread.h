@@ -34,6 +34,9 @@ public:
     PosixThread();
     void start(void *(*start_routine)(void*), void *parameter);
     void join();
+
+    // identifier of the calling thread
+    static unsigned long long currentid();
     virtual ~PosixThread();
 
 protected:
@@ -54,6 +57,20 @@ protected:
     pthread_mutexattr_t *attr;
 };
 
+class PosixSemaphore : public Semaphore
+{
+public:
+    PosixSemaphore();
+    virtual void release();
+    virtual void wait();
+    virtual ~PosixSemaphore();
+
+protected:
+    unsigned count;
+    pthread_mutex_t mtx;
+    pthread_cond_t cv;
+};
+
 } // namespace
 
 #endif
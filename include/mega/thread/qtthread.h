@@ -27,6 +27,7 @@
 #include "mega/thread.h"
 #include <QThread>
 #include <QMutex>
+#include <QSemaphore>
 
 namespace mega {
 class QtThread : public QThread, public Thread
@@ -35,6 +36,9 @@ public:
     QtThread();
     virtual void start(void *(*start_routine)(void*), void *parameter);
     virtual void join();
+
+    // identifier of the calling thread
+    static unsigned long long currentid();
     virtual ~QtThread();
 
 protected:
@@ -57,6 +61,18 @@ protected:
     QMutex *mutex;
 };
 
+class QtSemaphore : public Semaphore
+{
+public:
+    QtSemaphore();
+    virtual void release();
+    virtual void wait();
+    virtual ~QtSemaphore();
+
+protected:
+    QSemaphore *semaphore;
+};
+
 } // namespace
 
 #endif
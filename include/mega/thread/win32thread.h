@@ -33,6 +33,9 @@ public:
     Win32Thread();
     virtual void start(void *(*start_routine)(void*), void *parameter);
     virtual void join();
+
+    // identifier of the calling thread
+    static unsigned long long currentid();
     virtual ~Win32Thread();
 
 	void *(*start_routine)(void*);
@@ -56,6 +59,18 @@ protected:
     CRITICAL_SECTION mutex;
 };
 
+class Win32Semaphore : public Semaphore
+{
+public:
+    Win32Semaphore();
+    virtual void release();
+    virtual void wait();
+    virtual ~Win32Semaphore();
+
+protected:
+    HANDLE semaphore;
+};
+
 } // namespace
 
 #endif
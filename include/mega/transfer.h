@@ -25,10 +25,11 @@
 #include "node.h"
 #include "backofftimer.h"
 #include "command.h"
+#include "transferstats.h"
 
 namespace mega {
 // pending/active up/download ordered by file fingerprint (size - mtime - sparse CRC)
-struct MEGA_API Transfer : public FileFingerprint
+struct MEGA_API Transfer : public FileFingerprint, Cachable
 {
     // PUT or GET
     direction_t type;
@@ -44,6 +45,9 @@ struct MEGA_API Transfer : public FileFingerprint
     unsigned failcount;
     BackoffTimer bt;
 
+    // creation time (for the aging transfer policy)
+    dstime queuedds;
+
     // representative local filename for this transfer
     string localfilename;
 
@@ -57,11 +61,28 @@ struct MEGA_API Transfer : public FileFingerprint
     // meta MAC
     int64_t metamac;
 
+    // don't fetch chunks from LAN peers (a peer may have served bad data)
+    bool nopeers;
+
+    // upload source that isn't a local file (see File::stream)
+    InputStreamAccess* stream;
+
     // file crypto key
     SymmCipher key;
 
+    // MACs of completed chunks not yet folded into filemac
     chunkmac_map chunkmacs;
 
+    // running file MAC over the contiguous chunks [0, macpos)
+    byte filemac[SymmCipher::BLOCKSIZE];
+    m_off_t macpos;
+
+    // macpos as of the last checkpoint to MegaClient::tctable
+    m_off_t cachedpos;
+
+    // timings of the chunk requests of this transfer (not persisted)
+    ChunkTimingStats timings;
+
     // upload handle for file attribute attachment (only set if file attribute queued)
     handle uploadhandle;
 
@@ -77,6 +98,23 @@ struct MEGA_API Transfer : public FileFingerprint
     // upload result
     byte ultoken[NewNode::UPLOADTOKENLEN + 1];
 
+    // temporary URL obtained ahead of the dispatch (MegaClient::prefetchurls)
+    // with the file attributes that came with it, the upload size it was
+    // requested for and the time of its arrival - or the command still
+    // waiting for it
+    string tempurl;
+    string fileattrstring;
+    int fileattrsmutable;
+    m_off_t tempurlsize;
+    dstime tempurlds;
+    Command* tempurlcmd;
+
+    // prefetched URLs are only used within TEMPURLTTL of their arrival
+    static const dstime TEMPURLTTL = 6000;
+
+    // is a usable prefetched URL available?
+    bool tempurlvalid() const;
+
     // backlink to base
     MegaClient* client;
     int tag;
@@ -92,20 +130,131 @@ struct MEGA_API Transfer : public FileFingerprint
 
     // previous wrong fingerprint
     FileFingerprint badfp;
-   
+
+    // resumable download state (fingerprint, partial file, key, folded MACs)
+    bool serialize(string*);
+    static Transfer* unserialize(MegaClient*, string*);
+
     Transfer(MegaClient*, direction_t);
     virtual ~Transfer();
 };
 
+// LRU cache of decrypted blocks of a node read through DirectRead
+struct MEGA_API DirectReadCache
+{
+    // blocks start at multiples of this
+    static const unsigned BLOCKSIZE = 131072;
+
+    // default ceiling per node and read-ahead window
+    static const m_off_t DEFAULTLIMIT = 16777216;
+    static const m_off_t DEFAULTREADAHEAD = 4194304;
+
+    // cached bytes and their ceiling (0 disables the cache)
+    m_off_t cached;
+    m_off_t limit;
+
+    // add the complete block starting at pos (taking over the data)
+    void store(m_off_t, string*);
+
+    // cached data at pos up to the end of its block (NULL if not cached)
+    const byte* lookup(m_off_t, unsigned*);
+
+    void setlimit(m_off_t);
+    void clear();
+
+    DirectReadCache();
+
+protected:
+    struct Block
+    {
+        string data;
+        list<m_off_t>::iterator lru_it;
+    };
+
+    typedef map<m_off_t, Block> block_map;
+
+    block_map blocks;
+
+    // block start positions, most recently used first
+    list<m_off_t> lru;
+
+    // drop least recently used blocks until the ceiling is respected
+    void evict();
+};
+
 struct MEGA_API DirectReadSlot
 {
+    // delivery position
     m_off_t pos;
 
     DirectRead* dr;
+
+    // request delivering at pos
     HttpReq* req;
 
+    // requests for the following pieces of a large read, in order - their
+    // data is kept until they become the delivering request
+    deque<HttpReq*> ahead;
+
+    // end of the requested data and of the read (-1: up to the end of the node)
+    m_off_t reqend;
+    m_off_t rangeend;
+
+    // reads larger than SPLITSIZE are fetched in PIECESIZE ranges over up to
+    // fanout concurrent requests
+    static const m_off_t PIECESIZE = 4194304;
+    static const m_off_t SPLITSIZE = 8388608;
+    static const int MINFANOUT = 2;
+    static const int MAXFANOUT = 8;
+
+    int fanout;
+
+    // fan-out adaptation (same scheme as TransferSlot::adaptconnections)
+    static const dstime ADAPTWINDOW = 20;
+    dstime windowstart;
+    m_off_t windowbytes;
+    m_off_t lastthroughput;
+    int lastadjust;
+
     drs_list::iterator drs_it;
 
+    // request the range [start, end) (end -1: open-ended)
+    HttpReq* request(m_off_t, m_off_t);
+
+    // keep fanout requests in flight
+    void topup();
+
+    // adjust the fan-out to the measured throughput
+    void adaptfanout();
+
+    // block being assembled for the node's cache
+    string block;
+    m_off_t blockpos;
+
+    // feed decrypted data at pos into the cache
+    void cachedata(const byte*, unsigned);
+
+    // data buffered per request while the read is paused
+    static const m_off_t PAUSEBUFFER = 1048576;
+
+    // QoS window (BandwidthShaper::streamingrate): start and data delivered
+    // since, and whether the read fell short in the last one
+    dstime qosstart;
+    m_off_t qosbytes;
+    bool starved;
+
+    // evaluate the QoS window once it's complete
+    void qoscheck();
+    void setstarved(bool);
+
+    // apply DirectRead::paused to the requests in flight
+    void setpaused();
+
+    // bytes of MegaClient::inflight held: PAUSEBUFFER for the delivering
+    // request (reserved by MegaClient::execdirectreads()) and PIECESIZE per
+    // piece ahead
+    m_off_t reserved;
+
     bool doio();
 
     DirectReadSlot(DirectRead*);
@@ -127,8 +276,14 @@ struct MEGA_API DirectRead
 
     int reqtag;
 
+    // the app doesn't take data: the received data is held (up to
+    // DirectReadSlot::PAUSEBUFFER per request) and the reception stopped
+    bool paused;
+
     void abort();
 
+    void pause(bool);
+
     DirectRead(DirectReadNode*, m_off_t, m_off_t, int, void*);
     ~DirectRead();
 };
@@ -151,6 +306,12 @@ struct MEGA_API DirectReadNode
 
     dr_list reads;
 
+    // decrypted blocks of recent reads and read-ahead
+    DirectReadCache cache;
+
+    // read-ahead in progress (no app data, feeds the cache only)
+    DirectRead* prefetch;
+
     MegaClient* client;
 
     handledrn_map::iterator hdrn_it;
@@ -171,6 +332,16 @@ struct MEGA_API DirectReadNode
     // report failure to app and abort or retry all reads
     void retry(error);
 
+    // pass the cached part of a read to the app - returns false if this
+    // completed (or aborted) and deleted the read
+    bool servecached(DirectRead*);
+
+    // true if the start of a read is about to be cached by the read-ahead
+    bool awaitprefetch(DirectRead*);
+
+    // start reading ahead of the range of an app read
+    void readahead(DirectRead*);
+
     DirectReadNode(MegaClient*, handle, bool, SymmCipher*, int64_t);
     ~DirectReadNode();
 };
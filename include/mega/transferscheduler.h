@@ -0,0 +1,179 @@
+/**
+ * @file mega/transferscheduler.h
+ * @brief Transfer queue dispatch policies and pipeline admission control
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_TRANSFERSCHEDULER_H
+#define MEGA_TRANSFERSCHEDULER_H 1
+
+#include "types.h"
+
+namespace mega {
+// ordering of queued transfers - the scheduler dispatches the queued transfer
+// that precedes all others
+struct MEGA_API TransferPolicy
+{
+    // called once per dispatch decision before any precedes()
+    virtual void prepare(MegaClient*, direction_t) { }
+
+    // return true if a should be dispatched before b (the default keeps the
+    // transfer queue order: by fingerprint, i.e. smallest size first)
+    virtual bool precedes(Transfer*, Transfer*) { return false; }
+
+    virtual ~TransferPolicy() { }
+};
+
+// strictly smallest remaining amount of data first
+struct MEGA_API ShortestFirstTransferPolicy : public TransferPolicy
+{
+    bool precedes(Transfer*, Transfer*);
+};
+
+// highest File::priority first
+struct MEGA_API PriorityTransferPolicy : public TransferPolicy
+{
+    bool precedes(Transfer*, Transfer*);
+};
+
+// transfers of the File::owner group with the fewest active transfers first
+struct MEGA_API FairShareTransferPolicy : public TransferPolicy
+{
+    map<int, int> active;
+
+    void prepare(MegaClient*, direction_t);
+    bool precedes(Transfer*, Transfer*);
+};
+
+// most recently modified files first
+struct MEGA_API RecentFirstTransferPolicy : public TransferPolicy
+{
+    bool precedes(Transfer*, Transfer*);
+};
+
+// smallest remaining amount of data first, divided by the number of
+// AGINGDS periods the transfer has been queued for (plus one), so that
+// large transfers are not postponed indefinitely
+struct MEGA_API AgingTransferPolicy : public TransferPolicy
+{
+    static const dstime AGINGDS = 600;
+
+    dstime now;
+
+    void prepare(MegaClient*, direction_t);
+    bool precedes(Transfer*, Transfer*);
+
+    m_off_t weight(Transfer*) const;
+};
+
+struct MEGA_API TransferScheduler
+{
+    typedef enum { POLICY_DEFAULT, POLICY_SHORTESTFIRST, POLICY_PRIORITY, POLICY_FAIRSHARE,
+                   POLICY_RECENTFIRST, POLICY_AGING } policy_t;
+
+    // regular slots vs. small-file upload lane (see MegaClient::SMALLFILESIZE)
+    enum { LANE_REGULAR = 1, LANE_SMALL = 2, LANE_ALL = 3 };
+
+    MegaClient* client;
+
+    // select one of the built-in policies
+    void setpolicy(policy_t);
+
+    // install an application-supplied policy (not owned, NULL reverts to default)
+    void setpolicy(TransferPolicy*);
+
+    // pick the next queued transfer for the given direction and lanes (or NULL)
+    Transfer* next(direction_t, int = LANE_ALL);
+
+    // the first n queued transfers of a direction in dispatch order
+    void upcoming(direction_t, unsigned, transfer_vector*);
+
+    // returns true if another transfer should be dispatched to keep the link
+    // saturated
+    bool more(direction_t);
+
+    // account transferred bytes (called by TransferSlot progress reporting)
+    void addbytes(direction_t, m_off_t);
+
+    // queued (not yet active) transfers
+    unsigned queued(direction_t) const;
+
+    // number of active transfers
+    unsigned active(direction_t) const;
+
+    // percentage of busy transfer slots and of busy connections in them
+    int slotutilisation() const;
+    int connectionutilisation() const;
+
+    // measured throughput in bytes per second (0 if not yet known)
+    m_off_t rate(direction_t) const;
+
+    // current active transfer limit
+    unsigned maxactive[2];
+
+    // transfers of at least largesize bytes are confined to largeslots
+    // concurrent slots (0: no limit), so that they can't hold up the
+    // smaller ones
+    unsigned largeslots[2];
+    m_off_t largesize[2];
+
+    void setlargeslots(direction_t, unsigned, m_off_t);
+
+    // transfer priority/fair share group: maxima resp. first of its files
+    static int priority(Transfer*);
+    static int owner(Transfer*);
+
+    // duration of a throughput sampling window
+    static const dstime SAMPLEWINDOW = 20;
+
+    // allow overlap with active transfers that finish within this time
+    static const dstime LOOKAHEAD = 20;
+
+    // active transfer limit at startup and lower bound of its adaptation
+    static const unsigned MINACTIVE = 2;
+
+    TransferScheduler();
+
+protected:
+    TransferPolicy defaultpolicy;
+    ShortestFirstTransferPolicy shortestfirstpolicy;
+    PriorityTransferPolicy prioritypolicy;
+    FairShareTransferPolicy fairsharepolicy;
+    RecentFirstTransferPolicy recentfirstpolicy;
+    AgingTransferPolicy agingpolicy;
+
+    TransferPolicy* policy;
+
+    // per-direction throughput sampling
+    m_off_t windowbytes[2];
+    dstime windowstart[2];
+    m_off_t lastrate[2];
+    m_off_t currentrate[2];
+
+    // was the active transfer limit the bottleneck during the current
+    // sampling window?
+    bool limited[2];
+
+    // direction of the last maxactive adjustment
+    int lastadjust[2];
+
+    void sample(direction_t);
+};
+} // namespace
+
+#endif
@@ -36,9 +36,21 @@ struct MEGA_API TransferSlot
     // associated source/destination file
     FileAccess* fa;
 
+    // serialises background writes to fa and counts the downloaded requests
+    // still being finalized by MegaClient::workerpool
+    Mutex* famutex;
+    int asyncjobs;
+
+    // uploads: requests being read and encrypted ahead by the worker pool,
+    // in file order (at most targetconnections)
+    deque<HttpReqULJob*> readahead;
+
     // command in flight to obtain temporary URL
     Command* pendingcmd;
 
+    // slot belongs to the small-file upload lane
+    bool smallfile;
+
     // transfer attempts are considered failed after XFERTIMEOUT seconds
     // without data flow
     static const dstime XFERTIMEOUT = 600;
@@ -50,6 +62,19 @@ struct MEGA_API TransferSlot
     // number of consecutive errors
     unsigned errorcount;
 
+    // for storage hosts without a known port preference, the first two
+    // chunks race the default [0] and the alternative [1] port (connection
+    // indexes) - the faster one is remembered for the host
+    int raceconn[2];
+    int racereqs;
+    bool raceover;
+
+    // is connection i one of the racing requests?
+    bool racing(int);
+
+    // settle the race after connection i completed or failed
+    void finishrace(MegaClient*, int, bool);
+
     // file attribute string
     string fileattrstring;
 
@@ -59,10 +84,56 @@ struct MEGA_API TransferSlot
     // storage server access URL
     string tempurl;
 
-    // maximum number of parallel connections and connection aray
+    // downloads: node handle under which LAN peers are asked for the chunks
+    // (UNDEF: storage server only), chunks were received from a peer
+    handle peerhandle;
+    bool peerused;
+
+    // the meta MAC didn't match: a peer could have sent bad data, so the
+    // download is retried without peers rather than failed
+    error badmac(MegaClient*);
+
+    // number of allocated connections and connection array
     int connections;
     HttpReqXfer** reqs;
 
+    // number of connections allowed to start new chunks (surplus connections
+    // are released as soon as they become idle)
+    int targetconnections;
+
+    // adaptive connection count: bytes and chunks completed and summed chunk
+    // latency in the current sampling window, throughput of the previous
+    // window (bytes/s) and direction of the last adjustment
+    m_off_t windowbytes;
+    int windowchunks;
+    dstime windowstart;
+    dstime windowlatency;
+    int windowfailures;
+    m_off_t lastthroughput;
+    dstime lastlatency;
+    int lastadjust;
+
+    // minimum duration of a sampling window
+    static const dstime ADAPTWINDOW = 50;
+
+    // re-evaluate the number of connections at the end of a sampling window
+    void adaptconnections(MegaClient*);
+
+    // grow/shrink the connection array (busy connections are never dropped)
+    void setconnections(int);
+
+protected:
+    // release idle connections beyond targetconnections
+    void trimconnections();
+
+    // end of the request starting at pos (coalescing up to maxrequestsize)
+    m_off_t requestend(MegaClient*, m_off_t);
+
+    // top up the upload read-ahead pipeline / discard it
+    void prefetch(MegaClient*);
+    void flushreadahead();
+
+public:
     // handle I/O for this slot
     void doio(MegaClient*);
 
@@ -72,8 +143,21 @@ struct MEGA_API TransferSlot
     // indicate progress
     void progress();
 
-    // compute the meta MAC based on the chunk MACs
-    int64_t macsmac(chunkmac_map*);
+    // number of chunk requests of this slot in flight
+    int inflightrequests();
+
+    // add the timings of a chunk request that is done to the transfer and
+    // client statistics
+    void recordtimings(MegaClient*, HttpReqXfer*);
+
+    // fold the chunk MACs contiguous with transfer->macpos into transfer->filemac
+    void foldmacs();
+
+    // download progress between resumption checkpoints
+    static const int CACHEINTERVAL = 16777216;
+
+    // compute the meta MAC based on the chunk MACs (resets the MAC state)
+    int64_t macsmac();
 
     // tslots list position
     transferslot_list::iterator slots_it;
@@ -82,6 +166,16 @@ struct MEGA_API TransferSlot
     bool retrying;
     BackoffTimer retrybt;
 
+    // raised when the slot's requests receive data or the slot is
+    // reconfigured - cleared by doio()
+    bool dirty;
+
+    // time of the last doio() pass
+    dstime lastio;
+
+    // does the slot need a doio() pass? (idle slots are skipped)
+    bool ready(MegaClient*);
+
     // transfer failure flag
     bool failure;
     
@@ -0,0 +1,170 @@
+/**
+ * @file mega/transferstats.h
+ * @brief Transfer chunk timing and engine instrumentation
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_TRANSFERSTATS_H
+#define MEGA_TRANSFERSTATS_H 1
+
+#include "types.h"
+
+namespace mega {
+// phases of a chunk request
+typedef enum { TIMING_RESOLVE, TIMING_CONNECT, TIMING_FIRSTBYTE, TIMING_TRANSFER,
+               TIMING_CRYPTO, TIMING_DISK, TIMING_TOTAL } timingphase_t;
+
+// network timeline of an HTTP request in Waiter::us() microseconds - fields
+// the HttpIO backend cannot observe remain 0
+struct MEGA_API HttpReqTimeline
+{
+    int64_t posted;
+    int64_t resolved;
+    int64_t connected;
+    int64_t firstbyte;
+    int64_t completed;
+
+    void reset();
+
+    HttpReqTimeline();
+};
+
+// per-phase histograms of chunk request timings
+struct MEGA_API ChunkTimingStats
+{
+    static const int NUMPHASES = TIMING_TOTAL + 1;
+
+    // log2 buckets: 0 is < 1 ms (1 KB/s), i is [2^(i-1), 2^i) ms (KB/s),
+    // the last one is open-ended
+    static const int NUMBUCKETS = 20;
+
+    // recorded chunk requests and their payload
+    m_off_t chunks;
+    m_off_t bytes;
+
+    // duration histogram, number of samples, sum and maximum in microseconds
+    m_off_t histogram[NUMPHASES][NUMBUCKETS];
+    m_off_t samples[NUMPHASES];
+    m_off_t total[NUMPHASES];
+    m_off_t max[NUMPHASES];
+
+    // histogram of the network throughput of each request
+    m_off_t throughput[NUMBUCKETS];
+
+    // add a duration sample
+    void add(timingphase_t, int64_t);
+
+    // record a request of size bytes, its crypto and disk durations and the
+    // time it was done with
+    void record(direction_t, unsigned, const HttpReqTimeline*, int64_t, int64_t, int64_t);
+
+    void reset();
+
+    static int bucket(int64_t);
+
+    ChunkTimingStats();
+};
+
+// number, sum and maximum of durations in microseconds
+struct MEGA_API DurationStats
+{
+    m_off_t count;
+    m_off_t total;
+    m_off_t max;
+
+    void add(int64_t);
+    void reset();
+
+    DurationStats();
+};
+
+// requests to one host (HttpIO::hoststats)
+struct MEGA_API HttpHostStats
+{
+    m_off_t requests;
+    m_off_t failures;
+    m_off_t bytesout;
+    m_off_t bytesin;
+
+    HttpHostStats();
+};
+
+// engine-wide counters (MegaClient::enginestats)
+struct MEGA_API EngineStats
+{
+    // client-server API batches sent, failed (retried) and their latency
+    m_off_t csbatches;
+    m_off_t csretries;
+    DurationStats cslatency;
+
+    // server-client responses, the action packets in them and failed requests
+    m_off_t scresponses;
+    m_off_t actionpackets;
+    m_off_t scretries;
+
+    // transfer chunk requests failed (MegaClient::setchunkfailed())
+    m_off_t chunkfailures;
+
+    // local state cache transactions
+    DurationStats dbcommits;
+
+    // event loop: exec() passes and time blocked in the waiter
+    DurationStats execs;
+    DurationStats waits;
+
+    void reset();
+
+    EngineStats();
+};
+
+// phases of the startup of a session (values of MegaStartupTimeline::PHASE_*)
+typedef enum { STARTUP_LOGIN, STARTUP_DBOPEN, STARTUP_CACHELOAD, STARTUP_FETCHNODES,
+               STARTUP_CONNECT, STARTUP_RESPONSE, STARTUP_READNODES, STARTUP_SHARES,
+               STARTUP_KEYS, STARTUP_CURRENT, STARTUP_NUMPHASES } startupphase_t;
+
+// timeline of the startup of a session (MegaClient::startup): when each phase
+// began and ended, in microseconds since the login (or since the fetchnodes
+// of a session that wasn't traced from its login) - -1 if it didn't happen
+//
+// the trace ends with STARTUP_CURRENT, later calls are ignored
+struct MEGA_API StartupTrace
+{
+    int64_t origin;
+    bool active;
+
+    int64_t started[STARTUP_NUMPHASES];
+    int64_t finished[STARTUP_NUMPHASES];
+
+    // resources used by each phase: bytes received and items (nodes) processed
+    m_off_t bytes[STARTUP_NUMPHASES];
+    m_off_t items[STARTUP_NUMPHASES];
+
+    // start a new trace
+    void reset();
+
+    void begin(startupphase_t);
+    void end(startupphase_t, m_off_t = 0, m_off_t = 0);
+
+    // phase taken from absolute timestamps (Waiter::us(), 0: unknown)
+    void record(startupphase_t, int64_t, int64_t, m_off_t = 0);
+
+    StartupTrace();
+};
+} // namespace
+
+#endif
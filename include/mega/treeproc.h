@@ -34,9 +34,37 @@ class MEGA_API TreeProc
 public:
     virtual void proc(MegaClient*, Node*) = 0;
 
+    // processors that only read the tree and whose results do not depend on
+    // the processing order can be run over subtrees on the worker pool:
+    // fork() returns an empty instance for a worker (NULL: sequential only),
+    // whose proc() then gets a NULL client, and merge() adds its results
+    virtual TreeProc* fork() { return NULL; }
+    virtual void merge(TreeProc*) { }
+
     virtual ~TreeProc() { }
 };
 
+// runs a forked TreeProc over a batch of subtrees on a worker thread
+struct MEGA_API TreeProcJob : public WorkerJob
+{
+    node_vector roots;
+    TreeProc* tp;
+    bool skipinshares;
+
+    // number of nodes in the batch
+    unsigned size;
+
+    // set at the end of run() (a job withdrawn by WorkerPool::waitfor()
+    // before it started is run by the engine)
+    bool finished;
+
+    void run();
+
+    // takes ownership of the forked processor
+    TreeProcJob(TreeProc*, bool);
+    ~TreeProcJob();
+};
+
 class MEGA_API TreeProcDel : public TreeProc
 {
 public:
@@ -76,6 +104,8 @@ public:
     int numfolders;
 
     void proc(MegaClient*, Node*);
+    TreeProc* fork();
+    void merge(TreeProc*);
     TreeProcDU();
 };
 
@@ -86,7 +116,12 @@ class MEGA_API TreeProcShareKeys : public TreeProc
 
 public:
     void proc(MegaClient*, Node*);
-    void get(Command*);
+    TreeProc* fork();
+    void merge(TreeProc*);
+
+    unsigned size() const { return snk.size(); }
+    void encrypt(WorkerPool*);
+    void get(Command*, unsigned = 0, unsigned = ~0U);
 
     TreeProcShareKeys(Node* = NULL);
 };
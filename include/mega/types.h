@@ -45,6 +45,7 @@ typedef uint64_t fsfp_t;
 
 #ifdef USE_CRYPTOPP
 #include "mega/crypto/cryptopp.h"
+#include "mega/crypto/openssl.h"
 #else
 #include "megacrypto.h"
 #endif
@@ -76,13 +77,16 @@ class MegaClient;
 struct NewNode;
 struct Node;
 struct NodeCore;
+class NodeNameIndex;
 class PubKeyAction;
 class Request;
 struct Transfer;
 class TreeProc;
+class TreeProcShareKeys;
 class LocalTreeProc;
 struct User;
 struct Waiter;
+struct WorkerPool;
 struct Proxy;
 struct PendingContactRequest;
 
@@ -100,7 +104,7 @@ typedef uint32_t dstime;
 #define TOSTRING(x) STRINGIFY(x)
 
 // HttpReq states
-typedef enum { REQ_READY, REQ_PREPARED, REQ_INFLIGHT, REQ_SUCCESS, REQ_FAILURE, REQ_DONE } reqstatus_t;
+typedef enum { REQ_READY, REQ_PREPARED, REQ_INFLIGHT, REQ_SUCCESS, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO } reqstatus_t;
 
 typedef enum { USER_HANDLE, NODE_HANDLE } targettype_t;
 
@@ -115,8 +119,59 @@ struct ChunkMAC
     byte mac[SymmCipher::BLOCKSIZE];
 };
 
-// file chunk macs
-typedef map<m_off_t, ChunkMAC> chunkmac_map;
+// file chunk macs by chunk start offset - stored contiguously by chunk
+// index (chunk boundaries are fixed, see ChunkedHash), iterated in offset
+// order; erase() invalidates other iterators
+struct MEGA_API ChunkMACMap
+{
+    struct value_type
+    {
+        // chunk start offset (-1: slot unused)
+        m_off_t first;
+        ChunkMAC second;
+    };
+
+    struct iterator
+    {
+        vector<value_type>* entries;
+        size_t i;
+
+        value_type& operator*() { return (*entries)[i]; }
+        value_type* operator->() { return &(*entries)[i]; }
+
+        iterator& operator++();
+        iterator operator++(int);
+
+        bool operator==(const iterator& o) const { return i == o.i; }
+        bool operator!=(const iterator& o) const { return i != o.i; }
+
+        iterator() : entries(NULL), i(0) { }
+        iterator(vector<value_type>* centries, size_t ci) : entries(centries), i(ci) { }
+    };
+
+    iterator begin();
+    iterator end();
+    iterator find(m_off_t);
+    void erase(iterator);
+    void clear();
+    size_t size() const { return count; }
+
+    // number of allocated entries
+    size_t allocated() const { return entries.capacity(); }
+
+    // MAC of the chunk starting at the given offset (created if absent)
+    ChunkMAC& operator[](m_off_t);
+
+    ChunkMACMap() : base(0), count(0) { }
+
+protected:
+    // chunk index of entries[0]
+    m_off_t base;
+    size_t count;
+    vector<value_type> entries;
+};
+
+typedef ChunkMACMap chunkmac_map;
 
 /**
  * @brief Declaration of API error codes.
@@ -181,11 +236,28 @@ const int FOLDERNODEKEYLENGTH = 16;
 
 typedef list<class Sync*> sync_list;
 
+// secondary index keys of a cached node (see DbTable::indexnode())
+struct DbNodeKeys
+{
+    handle h;
+    handle parent;
+    int type;
+
+    // FingerprintIndex::hash() (0: none) and NodeNameIndex::hash() of the name
+    uint32_t fingerprint;
+    uint32_t name;
+};
+
+typedef enum { DBINDEX_PARENT, DBINDEX_TYPE, DBINDEX_FINGERPRINT, DBINDEX_NAME } dbindex_t;
+
 // persistent resource cache storage
 struct Cachable
 {
     virtual bool serialize(string*) = 0;
 
+    // secondary index keys (false: not indexed)
+    virtual bool dbkeys(DbNodeKeys*) { return false; }
+
     int32_t dbid;
 
     bool notified;
@@ -212,6 +284,9 @@ typedef enum { IPCA_ACCEPT = 0, IPCA_DENY, IPCA_IGNORE} ipcactions_t;
 
 typedef vector<struct Node*> node_vector;
 
+// sorted copies of a folder's children by (caller-defined) sort order
+typedef map<int, node_vector> sortedchildren_map;
+
 // contact visibility:
 // HIDDEN - not shown
 // VISIBLE - shown
@@ -235,14 +310,11 @@ typedef list<LocalNode*> localnode_list;
 
 typedef set<LocalNode*> localnode_set;
 
-typedef multimap<int32_t, LocalNode*> idlocalnode_map;
+// cached LocalNodes by parent dbid (sorted for range lookups)
+typedef vector<pair<int32_t, LocalNode*> > idlocalnode_vector;
 
 typedef set<Node*> node_set;
 
-// enumerates a node's children
-// FIXME: switch to forward_list once C++11 becomes more widely available
-typedef list<Node*> node_list;
-
 // undefined node handle
 const handle UNDEF = ~(handle)0;
 
@@ -256,11 +328,12 @@ typedef list<HttpReqCommandPutFA*> putfa_list;
 // map a FileFingerprint to the transfer for that FileFingerprint
 typedef map<FileFingerprint*, Transfer*, FileFingerprintCmp> transfer_map;
 
+// map a FileFingerprint to the local path of a file with that content
+typedef map<FileFingerprint*, string, FileFingerprintCmp> fingerprint_localpath_map;
+
 // map an upload handle to the corresponding transer
 typedef map<handle, Transfer*> handletransfer_map;
-
-// maps node handles to Node pointers
-typedef map<handle, Node*> node_map;
+typedef vector<Transfer*> transfer_vector;
 
 // maps node handles to Share pointers
 typedef map<handle, struct Share*> share_map;
@@ -335,16 +408,32 @@ typedef map<handle, NewNode*> handlenewnode_map;
 
 typedef map<handle, char> handlecount_map;
 
-// maps FileFingerprints to node
-typedef multiset<FileFingerprint*, FileFingerprintCmp> fingerprint_set;
-
 typedef enum { TREESTATE_NONE = 0, TREESTATE_SYNCED, TREESTATE_PENDING, TREESTATE_SYNCING } treestate_t;
 
+// metadata of a directory entry, where the listing provides it along with
+// the name (type TYPE_UNKNOWN: not provided) - the fsid is always valid
+struct DirEntryStat
+{
+    nodetype_t type;
+    m_off_t size;
+    m_time_t mtime;
+    handle fsid;
+};
+
 struct Notification
 {
     dstime timestamp;
     string path;
     LocalNode* localnode;
+
+    // scan results: the entry's metadata from the folder listing
+    DirEntryStat stat;
+
+    // coalescing sequence number (0: not coalesced)
+    uint32_t seq;
+
+    // collapsed burst: recheck all entries of the folder at path
+    bool rescan;
 };
 
 typedef deque<Notification> notify_deque;
@@ -57,6 +57,21 @@ struct MEGA_API User : public Cachable
     // actions to take after arrival of the public key
     deque<class PubKeyAction*> pkrs;
 
+    // user attributes as last received, by name with the "+"/"*" prefix
+    // (UAFOUND followed by the value, or UANOTFOUND if the user doesn't have
+    // the attribute) - stored with the user in the local cache and dropped
+    // when sc_userattr reports a change
+    map<string, string> uacache;
+
+    static const char UAFOUND = '1';
+    static const char UANOTFOUND = '0';
+
+    // larger values are fetched every time
+    static const unsigned MAXCACHEDUA = 16384;
+
+    // NULL value: API_ENOENT - returns false if not cached
+    bool cacheua(const string*, const byte*, unsigned);
+
     void set(visibility_t, m_time_t);
 
     bool serialize(string*);
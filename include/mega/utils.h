@@ -40,6 +40,10 @@ struct MEGA_API ChunkedHash
 
     static m_off_t chunkfloor(m_off_t);
     static m_off_t chunkceil(m_off_t);
+
+    // index of the chunk containing the offset / start of a chunk by index
+    static m_off_t chunkindex(m_off_t);
+    static m_off_t chunkstart(m_off_t);
 };
 
 /**
@@ -75,6 +79,14 @@ struct MEGA_API PaddedCBC
      * @return Void.
      */
     static bool decrypt(string* data, SymmCipher* key, string* iv = NULL);
+
+    /**
+     * @brief Strips the padding of decrypted data.
+     *
+     * @param data Decrypted data buffer.
+     * @return false if no padding was found.
+     */
+    static bool unpad(string* data);
 };
 
 class MEGA_API HashSignature
@@ -45,15 +45,29 @@ struct MEGA_API Waiter
     // current time (processwide)
     static dstime ds;
 
+    // time of the last bumpds() in milliseconds (on the clock of ds)
+    static int64_t dsms;
+
     // set ds to current time
     static void bumpds();
 
+    // monotonic timestamp in microseconds (instrumentation, thread-safe)
+    static int64_t us();
+
     // wait ceiling
     dstime maxds;
 
+    // the same ceiling in milliseconds after dsms (-1: none) - the
+    // decisecond deadlines are met exactly rather than up to one decisecond
+    // late, and finer ones can be added through wakeupms()
+    int64_t maxms;
+
     // begin waiting cycle with timeout
     virtual void init(dstime);
 
+    // lower the wait ceiling to this many milliseconds after dsms
+    void wakeupms(int64_t);
+
     // add wakeup events
     void wakeupby(EventTrigger*, int);
 
@@ -32,9 +32,24 @@ struct MEGA_API WinDirAccess : public DirAccess
     HANDLE hFind;
     string globbase;
 
+#ifndef WINDOWS_PHONE
+    // listing through the folder handle in batches of entries that carry
+    // their metadata (needs Vista or later, hFind is used otherwise)
+    HANDLE hDir;
+    int64_t* listing;
+    char* entry;
+    bool listingdone;
+
+    bool nextbatch();
+#endif
+
+    DirEntryStat entrystat;
+    bool entrystatvalid;
+
 public:
     bool dopen(string*, FileAccess*, bool);
     bool dnext(string*, string*, bool, nodetype_t*);
+    bool dstat(DirEntryStat*);
 
     WinDirAccess();
     virtual ~WinDirAccess();
@@ -77,7 +92,8 @@ public:
 
     void osversion(string*) const;
 
-    static void emptydirlocal(string*, dev_t = 0);
+    // (progress is reported to/cancelled through the optional LocalRemoval)
+    static void emptydirlocal(string*, dev_t = 0, LocalRemoval* = NULL);
 
     WinFileSystemAccess();
 };
@@ -105,14 +121,65 @@ struct MEGA_API WinDirNotify : public DirNotify
 
     fsfp_t fsfingerprint();
 
+#ifndef WINDOWS_PHONE
+    // NTFS change journal of the sync's volume
+    HANDLE hVolume;
+    DWORDLONG usnjournalid;
+
+    // normalized path of the sync root (UTF-16, no trailing separator)
+    string journalroot;
+
+    // the position handed out is the USN sampled at the previous checkpoint,
+    // by which time all changes before it have been notified
+    static const dstime USNSAMPLEDS = 100;
+
+    USN usncommitted;
+    USN usnsampled;
+    dstime usnsampletime;
+
+    bool queryjournal(USN_JOURNAL_DATA_V0*);
+    int journalparent(DWORDLONG, map<DWORDLONG, pair<int, string> >*, string*);
+    bool replayjournal(USN, USN, set<string>*);
+
+    bool start(const string*);
+    void stop();
+    bool journalpos(string*);
+#endif
+
     WinDirNotify(string*, string*);
     ~WinDirNotify();
 };
 
+#ifndef WINDOWS_PHONE
+// overlapped read/write - completed by an APC while the engine thread waits
+// alertably
+struct MEGA_API WinAsyncIOContext : public AsyncIOContext
+{
+    OVERLAPPED overlapped;
+};
+#endif
+
 class MEGA_API WinFileAccess : public FileAccess
 {
     HANDLE hFile;
 
+    // unbuffered handle for aligned writes
+    HANDLE hDirect;
+
+    // access mode of hFile
+    DWORD access;
+
+#ifndef WINDOWS_PHONE
+    // overlapped handle for asynchronous reads/writes (opened on first use,
+    // unbuffered if hDirect was set up before)
+    HANDLE hAsync;
+    bool asyncdirect;
+    bool asyncfailed;
+
+    bool asyncsubmit(WinAsyncIOContext*);
+    static VOID CALLBACK asynccompletion(DWORD, DWORD, LPOVERLAPPED);
+#endif
+
 public:
     HANDLE hFind;
     WIN32_FIND_DATAW ffd;
@@ -122,6 +189,16 @@ public:
     bool fread(string *, unsigned, unsigned, m_off_t);
     bool frawread(byte *, unsigned, m_off_t);
     bool fwrite(const byte *, unsigned, m_off_t);
+    bool fpreallocate(m_off_t);
+    bool setdirectio();
+    bool concurrentio() { return true; }
+
+#ifndef WINDOWS_PHONE
+    bool asyncavailable();
+    AsyncIOContext* asyncfread(byte*, unsigned, m_off_t);
+    AsyncIOContext* asyncfwrite(const byte*, unsigned, m_off_t);
+    void asyncwait(AsyncIOContext*);
+#endif
 
     bool sysread(byte *, unsigned, m_off_t);
     bool sysstat(m_time_t*, m_off_t*);
@@ -52,6 +52,12 @@ protected:
 public:
     static const unsigned HTTP_POST_CHUNK_SIZE = 16384;
 
+    // maximum size of a single read straight into a chunk buffer
+    static const unsigned DIRECT_READ_SIZE = 1048576;
+
+    // read the response body straight into the request's chunk buffer
+    static bool readdirect(struct WinHttpContext*);
+
     static VOID CALLBACK asynccallback(HINTERNET, DWORD_PTR, DWORD,
                                        LPVOID lpvStatusInformation,
                                        DWORD dwStatusInformationLength);
@@ -97,6 +103,9 @@ struct MEGA_API WinHttpContext
     bool gzip;
     z_stream z;
     string zin;
+
+    // a read into the request's chunk buffer is pending
+    bool directread;
 };
 } // namespace
 
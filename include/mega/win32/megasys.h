@@ -71,6 +71,7 @@
 #include <shellapi.h>
 
 #define atoll _atoi64
+#define strtoll _strtoi64
 #define snprintf mega_snprintf
 #define strcasecmp _stricmp
 #define strncasecmp _strnicmp
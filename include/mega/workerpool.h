@@ -0,0 +1,59 @@
+/**
+ * @file mega/workerpool.h
+ * @brief Background execution of CPU/disk-bound transfer work
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_WORKERPOOL_H
+#define MEGA_WORKERPOOL_H 1
+
+#include "types.h"
+#include "thread.h"
+
+namespace mega {
+// a unit of work that must not touch any MegaClient state
+struct MEGA_API WorkerJob
+{
+    // executed on a worker thread
+    virtual void run() = 0;
+
+    virtual ~WorkerJob() { }
+};
+
+// pool of worker threads supplied by the application (MegaClient::workerpool)
+// - if none is supplied, the engine performs all work inline
+struct MEGA_API WorkerPool
+{
+    // queue job for execution - the pool wakes up the engine's Waiter
+    // whenever a job has finished
+    virtual void push(WorkerJob*) = 0;
+
+    // has the job finished running? (true is reported only once)
+    virtual bool isdone(WorkerJob*) = 0;
+
+    // block until the job has finished (drops it if it has not started yet)
+    virtual void waitfor(WorkerJob*) = 0;
+
+    // new non-recursive mutex for serialising job side effects
+    virtual Mutex* newmutex() = 0;
+
+    virtual ~WorkerPool() { }
+};
+} // namespace
+
+#endif
@@ -62,12 +62,22 @@ class MegaShare;
 class MegaError;
 class MegaRequest;
 class MegaTransfer;
+class MegaTransferTimings;
+class MegaEngineMetrics;
+class MegaStartupTimeline;
+class MegaTransferBuffer;
 class MegaSync;
 class MegaNodeList;
+class MegaChildrenCursor;
 class MegaUserList;
 class MegaContactRequestList;
+class MegaNodeDeltaList;
 class MegaShareList;
 class MegaTransferList;
+class MegaTransferBatch;
+class MegaTransferStats;
+class MegaMemoryUsage;
+class MegaSearchFilter;
 class MegaApi;
 
 /**
@@ -882,6 +892,77 @@ class MegaShare
         virtual int64_t getTimestamp();
 };
 
+/**
+ * @brief Conditions for the results of MegaApi::searchAsync
+ *
+ * All the conditions that are set have to be met. By default, there are none.
+ */
+class MegaSearchFilter
+{
+public:
+    MegaSearchFilter();
+    virtual ~MegaSearchFilter();
+
+    /**
+     * @brief Creates a copy of this MegaSearchFilter object
+     *
+     * You take the ownership of the returned value
+     *
+     * @return Copy of the MegaSearchFilter object
+     */
+    MegaSearchFilter *copy();
+
+    /**
+     * @brief Only accept nodes of a type
+     * @param type MegaNode::TYPE_FILE or MegaNode::TYPE_FOLDER (-1: any type)
+     */
+    void setNodeType(int type);
+
+    /**
+     * @brief Only accept files with a size in a range
+     *
+     * Folders don't match this condition.
+     *
+     * @param minSize Minimum size in bytes (-1: no minimum)
+     * @param maxSize Maximum size in bytes (-1: no maximum)
+     */
+    void setSizeRange(int64_t minSize, int64_t maxSize);
+
+    /**
+     * @brief Only accept files with a modification time in a range
+     *
+     * Folders don't match this condition.
+     *
+     * @param minTime Minimum modification time, in seconds since the epoch (-1: no minimum)
+     * @param maxTime Maximum modification time, in seconds since the epoch (-1: no maximum)
+     */
+    void setModificationTimeRange(int64_t minTime, int64_t maxTime);
+
+    /**
+     * @brief Only accept nodes whose name ends with an extension
+     *
+     * The comparison isn't case sensitive. Use NULL to accept any name.
+     *
+     * @param extension Extension, with or without the leading dot (i.e. "jpg")
+     */
+    void setExtension(const char *extension);
+
+    int getNodeType();
+    int64_t getMinSize();
+    int64_t getMaxSize();
+    int64_t getMinModificationTime();
+    int64_t getMaxModificationTime();
+    const char *getExtension();
+
+private:
+    int nodeType;
+    int64_t minSize;
+    int64_t maxSize;
+    int64_t minTime;
+    int64_t maxTime;
+    const char *extension;
+};
+
 /**
  * @brief List of MegaNode objects
  *
@@ -920,6 +1001,54 @@ class MegaNodeList
         virtual int size();
 };
 
+/**
+ * @brief Position in a sorted listing of the children of a folder
+ *
+ * Cursors are created by MegaApi::getChildrenCursor and advanced by
+ * MegaApi::getNextChildren, which returns the listing one page at a time.
+ *
+ * A cursor resumes after the last node that it returned, so nodes added
+ * or removed while the listing is paged through don't make it skip or
+ * repeat other nodes. If that node is moved or deleted, the listing
+ * continues at the same position.
+ *
+ * @see MegaApi::getChildrenCursor, MegaApi::getNextChildren
+ */
+class MegaChildrenCursor
+{
+    public:
+        virtual ~MegaChildrenCursor();
+
+        virtual MegaChildrenCursor *copy();
+
+        /**
+         * @brief Returns the handle of the folder that is listed
+         * @return Handle of the parent folder
+         */
+        virtual MegaHandle getParentHandle();
+
+        /**
+         * @brief Returns the sorting order of the listing
+         * @return Sorting order (MegaApi::ORDER_*)
+         */
+        virtual int getOrder();
+
+        /**
+         * @brief Returns the number of nodes returned so far
+         * @return Position of the next page in the listing
+         */
+        virtual int getPosition();
+
+        /**
+         * @brief Returns whether the last page didn't reach the end of the listing
+         *
+         * This is true for a new cursor.
+         *
+         * @return True if there may be more nodes to return
+         */
+        virtual bool hasMore();
+};
+
 /**
  * @brief List of MegaUser objects
  *
@@ -1031,6 +1160,268 @@ class MegaTransferList
         virtual int size();
 };
 
+/**
+ * @brief Aggregate statistics of the transfers
+ *
+ * Returned by MegaApi::getTransferStats. The values are kept up to date by the SDK as
+ * transfers progress, so getting them doesn't depend on the number of transfers.
+ *
+ * All the getters take the direction of the transfers as parameter:
+ * - MegaTransfer::TYPE_DOWNLOAD = 0
+ * - MegaTransfer::TYPE_UPLOAD = 1
+ *
+ * Objects of this class are immutable.
+ */
+class MegaTransferStats
+{
+    public:
+        virtual ~MegaTransferStats();
+
+        /**
+         * @brief Creates a copy of this MegaTransferStats object
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Copy of the MegaTransferStats object
+         */
+        virtual MegaTransferStats *copy();
+
+        /**
+         * @brief Returns the number of transfers started and not finished yet
+         * @param direction Direction of the transfers
+         * @return Number of pending transfers
+         */
+        virtual int getNumPending(int direction);
+
+        /**
+         * @brief Returns the number of pending transfers that are transferring data right now
+         * @param direction Direction of the transfers
+         * @return Number of active transfers
+         */
+        virtual int getNumActive(int direction);
+
+        /**
+         * @brief Returns the number of transfers finished without error since the login
+         * @param direction Direction of the transfers
+         * @return Number of completed transfers
+         */
+        virtual int getNumCompleted(int direction);
+
+        /**
+         * @brief Returns the number of transfers finished with an error (or cancelled) since the login
+         * @param direction Direction of the transfers
+         * @return Number of failed transfers
+         */
+        virtual int getNumFailed(int direction);
+
+        /**
+         * @brief Returns the total size of the pending transfers
+         * @param direction Direction of the transfers
+         * @return Size of the pending transfers in bytes
+         */
+        virtual long long getPendingBytes(int direction);
+
+        /**
+         * @brief Returns the bytes already transferred by the pending transfers
+         * @param direction Direction of the transfers
+         * @return Transferred bytes of the pending transfers
+         */
+        virtual long long getTransferredBytes(int direction);
+
+        /**
+         * @brief Returns the bytes transferred by the completed transfers
+         * @param direction Direction of the transfers
+         * @return Bytes of the completed transfers
+         */
+        virtual long long getCompletedBytes(int direction);
+
+        /**
+         * @brief Returns the current speed of the transfers
+         * @param direction Direction of the transfers
+         * @return Speed in bytes per second
+         */
+        virtual long long getSpeed(int direction);
+
+        /**
+         * @brief Returns the estimated time to finish the pending transfers at the current speed
+         * @param direction Direction of the transfers
+         * @return Estimated time in seconds, or -1 if it's unknown (no speed)
+         */
+        virtual long long getEta(int direction);
+};
+
+/**
+ * @brief Memory used by the SDK, by subsystem
+ *
+ * Returned by MegaApi::getMemoryUsage. The values are estimates: they add up the sizes
+ * of the objects of each subsystem and their buffers, but not the overhead of the
+ * memory allocator. Only the transfer buffers are accounted exactly.
+ *
+ * Objects of this class are immutable.
+ */
+class MegaMemoryUsage
+{
+    public:
+        enum
+        {
+            MEMORY_NODES = 0,           // nodes, their keys, attributes, shares and children
+            MEMORY_NODE_INDEXES,        // handle, fingerprint and name search indexes
+            MEMORY_SYNCS,               // local trees of the synced folders
+            MEMORY_TRANSFERS,           // transfer queues and their chunk MACs
+            MEMORY_TRANSFER_BUFFERS,    // chunk buffers, in use and pooled
+            MEMORY_NETWORK,             // request and response buffers
+            MEMORY_THUMBNAILS,          // in-memory cache of thumbnails and previews
+            MEMORY_DATABASE             // database engine
+        };
+
+        virtual ~MegaMemoryUsage();
+
+        /**
+         * @brief Creates a copy of this MegaMemoryUsage object
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Copy of the MegaMemoryUsage object
+         */
+        virtual MegaMemoryUsage *copy();
+
+        /**
+         * @brief Returns the memory used by a subsystem
+         *
+         * MEMORY_DATABASE is the memory of the database engine, which is shared by all
+         * the MegaApi objects of the process.
+         *
+         * @param subsystem One of the MEMORY_* values
+         * @return Memory in bytes, or 0 for an unknown subsystem
+         */
+        virtual long long getBytes(int subsystem);
+
+        /**
+         * @brief Returns the memory used by all the subsystems
+         * @return Memory in bytes
+         */
+        virtual long long getTotalBytes();
+};
+
+/**
+ * @brief List of uploads and downloads to start at once
+ *
+ * Create it with MegaTransferBatch::createInstance, add the transfers and pass it to
+ * MegaApi::startTransfers. Queuing many transfers this way is much faster than calling
+ * MegaApi::startUpload or MegaApi::startDownload for each one.
+ *
+ * @see MegaApi::startTransfers
+ */
+class MegaTransferBatch
+{
+    public:
+        /**
+         * @brief Creates an empty batch
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Empty batch
+         */
+        static MegaTransferBatch *createInstance();
+
+        virtual ~MegaTransferBatch();
+
+        /**
+         * @brief Add an upload to the batch
+         *
+         * The parameters are the same as in MegaApi::startUpload
+         *
+         * @param localPath Local path of the file
+         * @param parent Parent node for the file in the MEGA account
+         * @param fileName Custom file name for the file in MEGA (NULL: the local name)
+         * @param mtime Custom modification time for the file in MEGA (-1: the local one)
+         */
+        virtual void addUpload(const char* localPath, MegaNode *parent, const char *fileName = NULL, int64_t mtime = -1);
+
+        /**
+         * @brief Add a download to the batch
+         *
+         * The parameters are the same as in MegaApi::startDownload
+         *
+         * @param node MegaNode that identifies the file
+         * @param localPath Destination path for the file (a folder if it ends with '\' or '/')
+         */
+        virtual void addDownload(MegaNode *node, const char* localPath);
+
+        /**
+         * @brief Returns the number of transfers in the batch
+         * @return Number of transfers in the batch
+         */
+        virtual int size();
+};
+
+/**
+ * @brief List of changed nodes, by handle
+ *
+ * Returned by MegaApi::getNodeDeltas and MegaApi::getNodeChanges. Each node appears once,
+ * with the changes since it was last reported (MegaNode::CHANGE_TYPE_* flags combined).
+ *
+ * Objects of this class are immutable.
+ *
+ * @see MegaApi::enableNodeDeltas, MegaApi::getNodeDeltas, MegaApi::getNodeChanges
+ */
+class MegaNodeDeltaList
+{
+    public:
+        virtual ~MegaNodeDeltaList();
+
+        virtual MegaNodeDeltaList *copy();
+
+        /**
+         * @brief Returns the handle of the node at the position i in the list
+         *
+         * If the index is >= the size of the list, this function returns INVALID_HANDLE.
+         *
+         * @param i Position in the list
+         * @return Handle of the changed node
+         */
+        virtual MegaHandle getHandle(int i);
+
+        /**
+         * @brief Returns the changes of the node at the position i in the list
+         *
+         * The value is a combination of MegaNode::CHANGE_TYPE_* flags. New nodes are reported
+         * without flags (unless they changed again before they were reported). Use
+         * MegaApi::getNodeByHandle to get the current state of the node.
+         *
+         * @param i Position in the list
+         * @return Changes of the node
+         */
+        virtual int getChanges(int i);
+
+        /**
+         * @brief Returns the number of nodes in the list
+         * @return Number of nodes in the list
+         */
+        virtual int size();
+
+        /**
+         * @brief Returns whether changes were lost
+         *
+         * This is true when the account was reloaded, or when more changes accumulated than
+         * the limit set in MegaApi::enableNodeDeltas. The application has to read again all
+         * the nodes it displays. The list itself may still contain changes after that point.
+         *
+         * @return True if the application has to reload its view of the nodes
+         */
+        virtual bool isReloadNeeded();
+
+        /**
+         * @brief Returns the sequence number of the change journal following the changes in the list
+         *
+         * Pass it to the next call to MegaApi::getNodeChanges. Lists returned by
+         * MegaApi::getNodeDeltas return 0.
+         *
+         * @return Sequence number to continue from
+         */
+        virtual long long getSequence();
+};
+
 /**
  * @brief List of MegaContactRequest objects
  *
@@ -1108,7 +1499,9 @@ class MegaRequest
             TYPE_CREDIT_CARD_STORE, TYPE_UPGRADE_ACCOUNT, TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS,
             TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS, TYPE_GET_SESSION_TRANSFER_URL,
             TYPE_GET_PAYMENT_METHODS, TYPE_INVITE_CONTACT, TYPE_REPLY_CONTACT_REQUEST,
-            TYPE_SUBMIT_FEEDBACK, TYPE_SEND_EVENT, TYPE_CLEAN_RUBBISH_BIN
+            TYPE_SUBMIT_FEEDBACK, TYPE_SEND_EVENT, TYPE_CLEAN_RUBBISH_BIN,
+            TYPE_REMOVE_LOCAL_FOLDER, TYPE_GET_PW_KEY, TYPE_SEARCH,
+            TYPE_FETCH_FOLDER, TYPE_SET_NODES_ATTRIBUTE, TYPE_EXPORT_NODES
         };
 
         virtual ~MegaRequest();
@@ -1556,6 +1949,50 @@ class MegaRequest
          */
         virtual MegaPricing *getPricing() const;
 
+        /**
+         * @brief Returns a list of nodes related to the request
+         *
+         * The MegaRequest object retains the ownership of the returned value. It will be valid
+         * until the callback finishes.
+         *
+         * This value is valid for these requests in onRequestUpdate:
+         * - MegaApi::searchAsync - Returns the nodes found since the previous update
+         *
+         * This value is valid for these requests:
+         * - MegaApi::setNodesAttribute - Returns the nodes to modify
+         * - MegaApi::exportNodes - Returns the nodes to export
+         *
+         * @return List of nodes related to the request
+         */
+        virtual MegaNodeList *getMegaNodeList() const;
+
+        /**
+         * @brief Returns the result for a node of the list of the request
+         *
+         * This value is valid for these requests in onRequestFinish:
+         * - MegaApi::setNodesAttribute - Returns the result of the change of the node
+         * - MegaApi::exportNodes - Returns the result of the export of the node
+         *
+         * @param index Position of the node in MegaRequest::getMegaNodeList
+         * @return Error code for the node (MegaError::API_OK if it succeeded)
+         */
+        virtual int getNodeErrorCode(int index) const;
+
+        /**
+         * @brief Returns the public link of a node of the list of the request
+         *
+         * This value is valid for these requests in onRequestFinish:
+         * - MegaApi::exportNodes - Returns the public link of the node, or NULL
+         * if its export failed (see MegaRequest::getNodeErrorCode)
+         *
+         * The SDK retains the ownership of the returned value. It will be valid until
+         * the MegaRequest object is deleted.
+         *
+         * @param index Position of the node in MegaRequest::getMegaNodeList
+         * @return Public link of the node
+         */
+        virtual const char *getNodeLink(int index) const;
+
 
         /**
          * @brief Returns the tag of a transfer related to the request
@@ -1848,42 +2285,475 @@ class MegaTransfer
          * @return Received bytes since the last callback
          */
         virtual char *getLastBytes() const;
+
+        /**
+         * @brief Returns the timing statistics of the chunk requests of the transfer
+         *
+         * The statistics are a snapshot taken at the time of the last callback. They are
+         * not kept if the transfer is resumed in a later session.
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Timing statistics of the chunk requests
+         */
+        virtual MegaTransferTimings *getTimings() const;
+
+        /**
+         * @brief Returns the tag of the folder download this transfer belongs to
+         *
+         * The files of a folder download (MegaApi::startDownload with a folder node) are
+         * downloaded by transfers of their own, that are reported to the global listeners
+         * of MegaApi too. Their progress is also included in the transfer of the folder.
+         *
+         * @return Tag of the transfer of the folder, or 0 if the transfer isn't part of a
+         * folder download
+         */
+        virtual int getFolderTransferTag() const;
 };
 
 /**
- * @brief Provides information about a contact request
+ * @brief Timing statistics of transfer chunk requests
  *
- * Developers can use listeners (MegaListener, MegaGlobalListener)
- * to track the progress of each contact. MegaContactRequest objects are provided in callbacks sent
- * to these listeners and allow developers to know the state of the contact requests, their parameters
- * and their results.
+ * Each chunk request is split into phases, and the duration of each phase is
+ * recorded in a histogram with logarithmic buckets:
+ * - Bucket 0: less than 1 millisecond
+ * - Bucket i: from 2^(i-1) (included) to 2^i (excluded) milliseconds
+ * - Bucket NUM_BUCKETS - 1: from 2^(NUM_BUCKETS - 2) milliseconds on
  *
- * Objects of this class aren't live, they are snapshots of the state of the contact request
- * when the object is created, they are immutable.
+ * The phases of a request are consecutive. The ones the network layer can't
+ * observe are not recorded (name resolution and connection setup are only
+ * available with the cURL backend, the connection setup also with WinHTTP).
  *
+ * Objects of this class are snapshots, they are immutable.
  */
-class MegaContactRequest
+class MegaTransferTimings
 {
 public:
-    enum {
-        STATUS_UNRESOLVED = 0,
-        STATUS_ACCEPTED,
-        STATUS_DENIED,
-        STATUS_IGNORED,
-        STATUS_DELETED,
-        STATUS_REMINDED
-    };
+    enum
+    {
+        // name resolution (including the wait for the IP of a proxy)
+        PHASE_RESOLVE = 0,
 
-    enum {
-        REPLY_ACTION_ACCEPT = 0,
-        REPLY_ACTION_DENY,
-        REPLY_ACTION_IGNORE
-    };
+        // TCP connection and TLS handshake (0 on a reused connection)
+        PHASE_CONNECT = 1,
 
-    enum {
-        INVITE_ACTION_ADD = 0,
-        INVITE_ACTION_DELETE,
-        INVITE_ACTION_REMIND
+        // until the first byte of the response (downloads only)
+        PHASE_FIRST_BYTE = 2,
+
+        // data transfer, until the request completes
+        PHASE_TRANSFER = 3,
+
+        // encryption (uploads) or decryption (downloads) and MAC computation
+        PHASE_CRYPTO = 4,
+
+        // read from (uploads) or write to (downloads) the local file
+        PHASE_DISK = 5,
+
+        // from the request being sent until the chunk is done with (excluding the
+        // preparation of uploads)
+        PHASE_TOTAL = 6,
+
+        NUM_PHASES = 7
+    };
+
+    enum
+    {
+        NUM_BUCKETS = 20
+    };
+
+    virtual ~MegaTransferTimings();
+
+    /**
+     * @brief Creates a copy of this MegaTransferTimings object
+     *
+     * You are the owner of the returned object
+     *
+     * @return Copy of the MegaTransferTimings object
+     */
+    virtual MegaTransferTimings *copy() const;
+
+    /**
+     * @brief Returns the number of chunk requests recorded
+     * @return Number of chunk requests
+     */
+    virtual long long getNumChunks() const;
+
+    /**
+     * @brief Returns the number of bytes transferred by the recorded requests
+     * @return Number of bytes
+     */
+    virtual long long getBytes() const;
+
+    /**
+     * @brief Returns the number of requests that fall in a bucket of a phase histogram
+     * @param phase Phase (MegaTransferTimings::PHASE_*)
+     * @param bucket Bucket (0 to MegaTransferTimings::NUM_BUCKETS - 1)
+     * @return Number of requests
+     */
+    virtual long long getPhaseCount(int phase, int bucket) const;
+
+    /**
+     * @brief Returns the number of requests for which a phase was recorded
+     * @param phase Phase (MegaTransferTimings::PHASE_*)
+     * @return Number of requests
+     */
+    virtual long long getPhaseSamples(int phase) const;
+
+    /**
+     * @brief Returns the sum of the durations of a phase
+     * @param phase Phase (MegaTransferTimings::PHASE_*)
+     * @return Total duration in microseconds
+     */
+    virtual long long getPhaseTotalTime(int phase) const;
+
+    /**
+     * @brief Returns the longest duration of a phase
+     * @param phase Phase (MegaTransferTimings::PHASE_*)
+     * @return Maximum duration in microseconds
+     */
+    virtual long long getPhaseMaxTime(int phase) const;
+
+    /**
+     * @brief Returns the number of requests that fall in a bucket of the throughput histogram
+     *
+     * The throughput of a request is its size divided by its network time (from
+     * being sent until completion). The buckets are the same as for the phases,
+     * in KB/s (1 KB = 1000 bytes) instead of milliseconds.
+     *
+     * @param bucket Bucket (0 to MegaTransferTimings::NUM_BUCKETS - 1)
+     * @return Number of requests
+     */
+    virtual long long getThroughputCount(int bucket) const;
+};
+
+/**
+ * @brief Counters of the SDK engine
+ *
+ * Returned by MegaApi::getEngineMetrics and passed to MegaListener::onEngineMetrics.
+ * The values are totals since the MegaApi object was created or since the last call
+ * to MegaApi::resetEngineMetrics (except MegaEngineMetrics::COUNTER_API_IN_FLIGHT).
+ *
+ * Durations are reported as the number of samples, their sum and the longest one,
+ * in microseconds. The HTTP statistics by host are only available with the cURL
+ * backend.
+ *
+ * Objects of this class are snapshots, they are immutable.
+ */
+class MegaEngineMetrics
+{
+public:
+    enum
+    {
+        // client-server API batches sent
+        COUNTER_API_BATCHES = 0,
+
+        // API batches that failed and will be sent again after a backoff
+        COUNTER_API_RETRIES = 1,
+
+        // API batches waiting for a response right now
+        COUNTER_API_IN_FLIGHT = 2,
+
+        // server-client responses (packets of account updates) received
+        COUNTER_SC_RESPONSES = 3,
+
+        // account updates (action packets) received
+        COUNTER_ACTION_PACKETS = 4,
+
+        // server-client requests that failed and will be sent again after a backoff
+        COUNTER_SC_RETRIES = 5,
+
+        // transfer chunk requests that failed
+        COUNTER_CHUNK_FAILURES = 6,
+
+        NUM_COUNTERS = 7
+    };
+
+    enum
+    {
+        // from an API batch being sent until its response
+        DURATION_API_LATENCY = 0,
+
+        // transactions of the local cache
+        DURATION_DB_COMMIT = 1,
+
+        // iterations of the SDK event loop (processing)
+        DURATION_EXEC = 2,
+
+        // time the SDK thread has been waiting for events
+        DURATION_WAIT = 3,
+
+        NUM_DURATIONS = 4
+    };
+
+    virtual ~MegaEngineMetrics();
+
+    /**
+     * @brief Creates a copy of this MegaEngineMetrics object
+     *
+     * You are the owner of the returned object
+     *
+     * @return Copy of the MegaEngineMetrics object
+     */
+    virtual MegaEngineMetrics *copy() const;
+
+    /**
+     * @brief Returns the value of a counter
+     * @param counter Counter (MegaEngineMetrics::COUNTER_*)
+     * @return Value of the counter
+     */
+    virtual long long getCounter(int counter) const;
+
+    /**
+     * @brief Returns the number of samples of a duration
+     * @param duration Duration (MegaEngineMetrics::DURATION_*)
+     * @return Number of samples
+     */
+    virtual long long getDurationCount(int duration) const;
+
+    /**
+     * @brief Returns the sum of the samples of a duration
+     * @param duration Duration (MegaEngineMetrics::DURATION_*)
+     * @return Total duration in microseconds
+     */
+    virtual long long getDurationTotal(int duration) const;
+
+    /**
+     * @brief Returns the longest sample of a duration
+     * @param duration Duration (MegaEngineMetrics::DURATION_*)
+     * @return Maximum duration in microseconds
+     */
+    virtual long long getDurationMax(int duration) const;
+
+    /**
+     * @brief Returns the number of hosts with HTTP statistics
+     * @return Number of hosts
+     */
+    virtual int getNumHosts() const;
+
+    /**
+     * @brief Returns the name of a host
+     *
+     * The MegaEngineMetrics object retains the ownership of the returned string.
+     *
+     * @param i Index of the host (0 to MegaEngineMetrics::getNumHosts - 1)
+     * @return Hostname, or NULL if the index is not valid
+     */
+    virtual const char *getHostName(int i) const;
+
+    /**
+     * @brief Returns the number of HTTP requests completed to a host
+     * @param i Index of the host (0 to MegaEngineMetrics::getNumHosts - 1)
+     * @return Number of requests
+     */
+    virtual long long getHostRequests(int i) const;
+
+    /**
+     * @brief Returns the number of HTTP requests to a host that failed
+     * @param i Index of the host (0 to MegaEngineMetrics::getNumHosts - 1)
+     * @return Number of failed requests
+     */
+    virtual long long getHostFailures(int i) const;
+
+    /**
+     * @brief Returns the bytes sent to a host
+     * @param i Index of the host (0 to MegaEngineMetrics::getNumHosts - 1)
+     * @return Bytes sent
+     */
+    virtual long long getHostBytesSent(int i) const;
+
+    /**
+     * @brief Returns the bytes received from a host
+     * @param i Index of the host (0 to MegaEngineMetrics::getNumHosts - 1)
+     * @return Bytes received
+     */
+    virtual long long getHostBytesReceived(int i) const;
+};
+
+/**
+ * @brief Timeline of the startup of a session
+ *
+ * Returned by MegaApi::getStartupTimeline. It covers the last login and the loading
+ * of the nodes that followed it (from the local cache or from the server), until the
+ * account is up to date (MegaListener::onNodesCurrent), which completes it.
+ *
+ * Times are in microseconds since the login started, or since MegaApi::fetchNodes
+ * was called if it wasn't preceded by a login. Phases that didn't take place (for example,
+ * MegaStartupTimeline::PHASE_CACHE_LOAD without a local cache) start and end at -1.
+ * Phases can overlap: the transfer of the response of the server is part of
+ * MegaStartupTimeline::PHASE_FETCH_NODES.
+ *
+ * Objects of this class are snapshots, they are immutable.
+ */
+class MegaStartupTimeline
+{
+public:
+    enum
+    {
+        // login request, until its response
+        PHASE_LOGIN = 0,
+
+        // opening of the local cache databases
+        PHASE_DB_OPEN = 1,
+
+        // loading of the nodes from the local cache
+        PHASE_CACHE_LOAD = 2,
+
+        // request of the nodes to the server, until its response is complete
+        PHASE_FETCH_NODES = 3,
+
+        // connection and TLS handshake of that request (empty if a connection was reused)
+        PHASE_CONNECT = 4,
+
+        // transfer of the response, from its first byte
+        PHASE_RESPONSE = 5,
+
+        // processing of the nodes of the response
+        PHASE_READ_NODES = 6,
+
+        // processing of the shares
+        PHASE_MERGE_SHARES = 7,
+
+        // application of the share keys to the nodes
+        PHASE_APPLY_KEYS = 8,
+
+        // from the nodes being loaded until the account is up to date
+        PHASE_CURRENT = 9,
+
+        NUM_PHASES = 10
+    };
+
+    virtual ~MegaStartupTimeline();
+
+    /**
+     * @brief Creates a copy of this MegaStartupTimeline object
+     *
+     * You are the owner of the returned object
+     *
+     * @return Copy of the MegaStartupTimeline object
+     */
+    virtual MegaStartupTimeline *copy() const;
+
+    /**
+     * @brief Returns true if the account was up to date when the timeline was taken
+     * @return True if the timeline is complete
+     */
+    virtual bool isComplete() const;
+
+    /**
+     * @brief Returns when a phase started
+     * @param phase Phase (MegaStartupTimeline::PHASE_*)
+     * @return Microseconds since the beginning of the timeline, or -1
+     */
+    virtual long long getPhaseStart(int phase) const;
+
+    /**
+     * @brief Returns when a phase ended
+     * @param phase Phase (MegaStartupTimeline::PHASE_*)
+     * @return Microseconds since the beginning of the timeline, or -1 if it hasn't
+     */
+    virtual long long getPhaseEnd(int phase) const;
+
+    /**
+     * @brief Returns the bytes received during a phase
+     *
+     * Only MegaStartupTimeline::PHASE_FETCH_NODES and MegaStartupTimeline::PHASE_RESPONSE
+     * report them (the size of the response).
+     *
+     * @param phase Phase (MegaStartupTimeline::PHASE_*)
+     * @return Bytes received
+     */
+    virtual long long getPhaseBytes(int phase) const;
+
+    /**
+     * @brief Returns the number of items processed by a phase
+     *
+     * MegaStartupTimeline::PHASE_CACHE_LOAD, MegaStartupTimeline::PHASE_READ_NODES and
+     * MegaStartupTimeline::PHASE_CURRENT report the number of nodes of the account when
+     * they ended.
+     *
+     * @param phase Phase (MegaStartupTimeline::PHASE_*)
+     * @return Number of items
+     */
+    virtual long long getPhaseItems(int phase) const;
+};
+
+/**
+ * @brief Decrypted data of a streaming transfer
+ *
+ * Provided by MegaTransferListener::onTransferBuffer. The data is not copied: the
+ * object refers to the buffer the SDK received it into. The application owns it
+ * and must call MegaTransferBuffer::release exactly once when done with the data,
+ * before deleting the MegaApi object.
+ *
+ * @see MegaApi::startStreaming
+ */
+class MegaTransferBuffer
+{
+public:
+    virtual ~MegaTransferBuffer();
+
+    /**
+     * @brief Returns the data
+     *
+     * The MegaTransferBuffer object retains the ownership of the returned pointer. It
+     * is valid until MegaTransferBuffer::release is called.
+     *
+     * @return Pointer to the data
+     */
+    virtual const char *getData() const;
+
+    /**
+     * @brief Returns the size of the data
+     * @return Size of the data in bytes
+     */
+    virtual size_t getSize() const;
+
+    /**
+     * @brief Returns the position of the data in the file
+     * @return Offset of the first byte in the file
+     */
+    virtual long long getOffset() const;
+
+    /**
+     * @brief Return the buffer to the SDK for reuse and delete this object
+     */
+    virtual void release();
+};
+
+/**
+ * @brief Provides information about a contact request
+ *
+ * Developers can use listeners (MegaListener, MegaGlobalListener)
+ * to track the progress of each contact. MegaContactRequest objects are provided in callbacks sent
+ * to these listeners and allow developers to know the state of the contact requests, their parameters
+ * and their results.
+ *
+ * Objects of this class aren't live, they are snapshots of the state of the contact request
+ * when the object is created, they are immutable.
+ *
+ */
+class MegaContactRequest
+{
+public:
+    enum {
+        STATUS_UNRESOLVED = 0,
+        STATUS_ACCEPTED,
+        STATUS_DENIED,
+        STATUS_IGNORED,
+        STATUS_DELETED,
+        STATUS_REMINDED
+    };
+
+    enum {
+        REPLY_ACTION_ACCEPT = 0,
+        REPLY_ACTION_DENY,
+        REPLY_ACTION_IGNORE
+    };
+
+    enum {
+        INVITE_ACTION_ADD = 0,
+        INVITE_ACTION_DELETE,
+        INVITE_ACTION_REMIND
     };
 
     virtual ~MegaContactRequest();
@@ -2127,6 +2997,19 @@ public:
      * MegaSyncEvent::copy
      */
     virtual void onSyncEvent(MegaApi *api, MegaSync *sync,  MegaSyncEvent *event);
+
+    /**
+     * @brief This function is called periodically with updated performance counters
+     *
+     * The SDK calls this function every five seconds for each active synchronization.
+     * You can use MegaSync::getNotificationQueueDepth, MegaSync::getFingerprintRate,
+     * MegaSync::getPendingUploadBytes and the other statistics getters of MegaSync
+     * to get the new values.
+     *
+     * @param api MegaApi object that is synchronizing files
+     * @param sync MegaSync object with the updated statistics
+     */
+    virtual void onSyncStatsUpdated(MegaApi *api, MegaSync *sync);
 };
 
 /**
@@ -2208,45 +3091,124 @@ public:
      * @return State of the synchronization
      */
     virtual int getState() const;
-};
-
-#endif
 
-/**
- * @brief Provides information about an error
- */
-class MegaError
-{
-public:
     /**
-     * @brief Declaration of API error codes.
+     * @brief Get the number of filesystem notifications waiting to be processed
+     *
+     * The statistics of a synchronization are updated every five seconds,
+     * see MegaSyncListener::onSyncStatsUpdated
+     *
+     * @return Number of queued filesystem notifications
      */
-    enum
-    {
-        API_OK = 0,             ///< Everything OK
-        API_EINTERNAL = -1,     ///< Internal error.
-        API_EARGS = -2,         ///< Bad arguments.
-        API_EAGAIN = -3,        ///< Request failed, retry with exponential back-off.
-        API_ERATELIMIT = -4,    ///< Too many requests, slow down.
-        API_EFAILED = -5,       ///< Request failed permanently.
-        API_ETOOMANY = -6,      ///< Too many requests for this resource.
-        API_ERANGE = -7,        ///< Resource access out of rage.
-        API_EEXPIRED = -8,      ///< Resource expired.
-        API_ENOENT = -9,        ///< Resource does not exist.
-        API_ECIRCULAR = -10,    ///< Circular linkage.
-        API_EACCESS = -11,      ///< Access denied.
-        API_EEXIST = -12,       ///< Resource already exists.
-        API_EINCOMPLETE = -13,  ///< Request incomplete.
-        API_EKEY = -14,         ///< Cryptographic error.
-        API_ESID = -15,         ///< Bad session ID.
-        API_EBLOCKED = -16,     ///< Resource administratively blocked.
-        API_EOVERQUOTA = -17,   ///< Quota exceeded.
-        API_ETEMPUNAVAIL = -18, ///< Resource temporarily not available.
-        API_ETOOMANYCONNECTIONS = -19, ///< Too many connections on this resource.
-        API_EWRITE = -20,       ///< File could not be written to (or failed post-write integrity check).
-        API_EREAD = -21,        ///< File could not be read from (or changed unexpectedly during reading).
-        API_EAPPKEY = -22,      ///< Invalid or missing application key.
-        API_ESSL = -23,         ///< SSL verification failed
+    virtual int getNotificationQueueDepth() const;
+
+    /**
+     * @brief Get the number of local items waiting for a retry because they were locked
+     * @return Number of queued retries
+     */
+    virtual int getRetryQueueDepth() const;
+
+    /**
+     * @brief Get the number of local files fingerprinted since the synchronization started
+     * @return Number of fingerprinted files
+     */
+    virtual long long getNumFingerprinted() const;
+
+    /**
+     * @brief Get the number of local files fingerprinted per second during the last period
+     * @return Fingerprints per second
+     */
+    virtual long long getFingerprintRate() const;
+
+    /**
+     * @brief Get the number of bytes that remain to be uploaded for this synchronization
+     * @return Pending upload bytes
+     */
+    virtual long long getPendingUploadBytes() const;
+
+    /**
+     * @brief Get the number of bytes that remain to be downloaded for this synchronization
+     * @return Pending download bytes
+     */
+    virtual long long getPendingDownloadBytes() const;
+
+    /**
+     * @brief Get the duration of the last pass applying remote changes to the local folder
+     * @return Duration in milliseconds
+     */
+    virtual long long getSyncDownTime() const;
+
+    /**
+     * @brief Get the duration of the last pass applying local changes to the MEGA folder
+     * @return Duration in milliseconds
+     */
+    virtual long long getSyncUpTime() const;
+
+    /**
+     * @brief Get the duration of the last write of the local state cache
+     * @return Duration in milliseconds
+     */
+    virtual long long getCacheFlushTime() const;
+
+    /**
+     * @brief Get the number of filesystem notifications received
+     *
+     * Notifications for a path that is already queued are coalesced, so this value
+     * is smaller than the number of notifications issued by the operating system.
+     *
+     * @return Number of filesystem notifications
+     */
+    virtual long long getNumNotifications() const;
+
+    /**
+     * @brief Get the number of queued notifications that were dropped because a later
+     * one for the same path superseded them
+     *
+     * Together with MegaSync::getNumNotifications, this gives the effectiveness
+     * of the notification coalescing.
+     *
+     * @return Number of superseded notifications
+     */
+    virtual long long getNumSupersededNotifications() const;
+};
+
+#endif
+
+/**
+ * @brief Provides information about an error
+ */
+class MegaError
+{
+public:
+    /**
+     * @brief Declaration of API error codes.
+     */
+    enum
+    {
+        API_OK = 0,             ///< Everything OK
+        API_EINTERNAL = -1,     ///< Internal error.
+        API_EARGS = -2,         ///< Bad arguments.
+        API_EAGAIN = -3,        ///< Request failed, retry with exponential back-off.
+        API_ERATELIMIT = -4,    ///< Too many requests, slow down.
+        API_EFAILED = -5,       ///< Request failed permanently.
+        API_ETOOMANY = -6,      ///< Too many requests for this resource.
+        API_ERANGE = -7,        ///< Resource access out of rage.
+        API_EEXPIRED = -8,      ///< Resource expired.
+        API_ENOENT = -9,        ///< Resource does not exist.
+        API_ECIRCULAR = -10,    ///< Circular linkage.
+        API_EACCESS = -11,      ///< Access denied.
+        API_EEXIST = -12,       ///< Resource already exists.
+        API_EINCOMPLETE = -13,  ///< Request incomplete.
+        API_EKEY = -14,         ///< Cryptographic error.
+        API_ESID = -15,         ///< Bad session ID.
+        API_EBLOCKED = -16,     ///< Resource administratively blocked.
+        API_EOVERQUOTA = -17,   ///< Quota exceeded.
+        API_ETEMPUNAVAIL = -18, ///< Resource temporarily not available.
+        API_ETOOMANYCONNECTIONS = -19, ///< Too many connections on this resource.
+        API_EWRITE = -20,       ///< File could not be written to (or failed post-write integrity check).
+        API_EREAD = -21,        ///< File could not be read from (or changed unexpectedly during reading).
+        API_EAPPKEY = -22,      ///< Invalid or missing application key.
+        API_ESSL = -23,         ///< SSL verification failed
 
         PAYMENT_ECARD = -101,
         PAYMENT_EBILLING = -102,
@@ -2371,6 +3333,17 @@ class MegaTreeProcessor
          * @return true to continue processing nodes, false to stop
          */
         virtual bool processMegaNode(MegaNode* node);
+
+        /**
+         * @brief Tell if MegaTreeProcessor::processMegaNode can be called by several threads at once
+         *
+         * Only MegaApi::processMegaTreeSnapshot uses several threads, and only if this
+         * function returns true. The default implementation returns false.
+         *
+         * @return True if the processor is thread-safe
+         */
+        virtual bool isThreadSafe();
+
         virtual ~MegaTreeProcessor();
 };
 
@@ -2564,6 +3537,28 @@ class MegaTransferListener
          * @see MegaApi::startStreaming
          */
         virtual bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size);
+
+        /**
+         * @brief This function is called to hand over the last read bytes of streaming downloads
+         *
+         * Unlike MegaTransferListener::onTransferData, the data is not copied and remains
+         * valid after this function returns: you take the ownership of the buffer parameter
+         * and must call MegaTransferBuffer::release when you are done with it.
+         *
+         * The default implementation calls MegaTransferListener::onTransferData and then
+         * releases the buffer.
+         *
+         * The SDK retains the ownership of the transfer parameter.
+         * Don't use it after this functions returns.
+         *
+         * @param api MegaApi object that started the transfer
+         * @param transfer Information about the transfer
+         * @param buffer Decrypted data
+         * @return true to continue the transfer, false to cancel it
+         *
+         * @see MegaApi::startStreaming
+         */
+        virtual bool onTransferBuffer(MegaApi *api, MegaTransfer *transfer, MegaTransferBuffer *buffer);
 };
 
 /**
@@ -2607,12 +3602,36 @@ class MegaGlobalListener
          */
         virtual void onNodesUpdate(MegaApi* api, MegaNodeList *nodes);
 
+        /**
+         * @brief This function is called when there are node changes to get with MegaApi::getNodeDeltas
+         *
+         * It's only called if MegaApi::enableNodeDeltas was used. After that, it's called once per
+         * coalescing window at most, and not again until MegaApi::getNodeDeltas has returned all
+         * the pending changes.
+         *
+         * @param api MegaApi object connected to the account
+         */
+        virtual void onNodeDeltasAvailable(MegaApi* api);
+
         /**
          * @brief This function is called when the account has been updated (upgraded/downgraded)
          * @param api MegaApi object connected to the account
          */
         virtual void onAccountUpdate(MegaApi *api);
 
+        /**
+         * @brief This function is called periodically with the counters of the SDK engine
+         *
+         * It's only called if MegaApi::setEngineMetricsInterval was used.
+         *
+         * The SDK retains the ownership of the MegaEngineMetrics object. It will be valid
+         * until this function returns. Use MegaEngineMetrics::copy to save it.
+         *
+         * @param api MegaApi object connected to the account
+         * @param metrics Counters of the engine
+         */
+        virtual void onEngineMetrics(MegaApi *api, MegaEngineMetrics *metrics);
+
         /**
          * @brief This function is called when there are new or updated contact requests in the account
          *
@@ -2830,12 +3849,36 @@ class MegaListener
          */
         virtual void onNodesUpdate(MegaApi* api, MegaNodeList *nodes);
 
+        /**
+         * @brief This function is called when there are node changes to get with MegaApi::getNodeDeltas
+         *
+         * It's only called if MegaApi::enableNodeDeltas was used. After that, it's called once per
+         * coalescing window at most, and not again until MegaApi::getNodeDeltas has returned all
+         * the pending changes.
+         *
+         * @param api MegaApi object connected to the account
+         */
+        virtual void onNodeDeltasAvailable(MegaApi* api);
+
         /**
          * @brief This function is called when the account has been updated (upgraded/downgraded)
          * @param api MegaApi object connected to the account
          */
         virtual void onAccountUpdate(MegaApi *api);
 
+        /**
+         * @brief This function is called periodically with the counters of the SDK engine
+         *
+         * It's only called if MegaApi::setEngineMetricsInterval was used.
+         *
+         * The SDK retains the ownership of the MegaEngineMetrics object. It will be valid
+         * until this function returns. Use MegaEngineMetrics::copy to save it.
+         *
+         * @param api MegaApi object connected to the account
+         * @param metrics Counters of the engine
+         */
+        virtual void onEngineMetrics(MegaApi *api, MegaEngineMetrics *metrics);
+
         /**
          * @brief This function is called when there are new or updated contact requests in the account
          *
@@ -2908,6 +3951,17 @@ class MegaListener
      */
     virtual void onSyncStateChanged(MegaApi *api,  MegaSync *sync);
 
+    /**
+     * @brief This function is called periodically with updated performance counters
+     * of a synchronization
+     *
+     * See MegaSyncListener::onSyncStatsUpdated
+     *
+     * @param api MegaApi object that is synchronizing files
+     * @param sync MegaSync object with the updated statistics
+     */
+    virtual void onSyncStatsUpdated(MegaApi *api,  MegaSync *sync);
+
     /**
      * @brief This function is called with the state of the synchronization engine has changed
      *
@@ -3002,6 +4056,15 @@ class MegaApi
             TRANSFER_METHOD_AUTO = 2
         };
 
+        enum {
+            TRANSFER_POLICY_DEFAULT = 0,
+            TRANSFER_POLICY_SHORTEST_FIRST = 1,
+            TRANSFER_POLICY_PRIORITY = 2,
+            TRANSFER_POLICY_FAIR_SHARE = 3,
+            TRANSFER_POLICY_RECENT_FIRST = 4,
+            TRANSFER_POLICY_AGING = 5
+        };
+
         /**
          * @brief Constructor suitable for most applications
          * @param appKey AppKey of your application
@@ -3170,6 +4233,31 @@ class MegaApi
          */
         void removeGlobalListener(MegaGlobalListener* listener);
 
+        /**
+         * @brief Deliver the callbacks of the listeners in their own threads
+         *
+         * By default, all callbacks are called synchronously by the SDK thread, so a slow
+         * listener delays the processing of every request, transfer and update. After this
+         * call, the callbacks are queued and called by numThreads dispatcher threads instead.
+         *
+         * Each listener is always served by the same thread, so it receives its callbacks
+         * in the same order as before. The objects received by the callbacks are copies,
+         * owned by the SDK until the callback returns. MegaTransferListener::onTransferData
+         * is still called synchronously, because its return value controls the transfer.
+         *
+         * Functions like MegaApi::getCurrentRequest or MegaApi::getCurrentTransfer don't
+         * work inside callbacks delivered by these threads.
+         *
+         * Once a listener is removed, it won't receive more callbacks. If one of them is
+         * running in another thread, the removal waits until it finishes.
+         *
+         * This setting can only be enabled once and can't be disabled. Only the first call
+         * with a positive value has an effect.
+         *
+         * @param numThreads Number of dispatcher threads (up to 8)
+         */
+        void setCallbackThreads(int numThreads);
+
         /**
          * @brief Get the current request
          *
@@ -3249,6 +4337,25 @@ class MegaApi
          */
         char* getBase64PwKey(const char *password);
 
+        /**
+         * @brief Generates a private key based on the access password in the background
+         *
+         * The key is derived on a worker thread, so neither the caller nor the SDK are
+         * blocked meanwhile. The resulting key can be used in MegaApi::fastLogin
+         *
+         * The associated request type with this request is MegaRequest::TYPE_GET_PW_KEY
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getPassword - Returns the access password
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish when the error code
+         * is MegaError::API_OK:
+         * - MegaRequest::getPrivateKey - Returns the Base64-encoded private key
+         *
+         * @param password Access password
+         * @param listener MegaRequestListener to track this request
+         */
+        void getBase64PwKey(const char *password, MegaRequestListener *listener);
+
         /**
          * @brief Generates a hash based in the provided private key and email
          *
@@ -3396,6 +4503,25 @@ class MegaApi
          */
         void loginToFolder(const char* megaFolderLink, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Fetch the tree of public folders incrementally
+         *
+         * By default, MegaApi::fetchNodes downloads the whole tree of a public folder before
+         * it can be browsed, which takes long and needs a lot of memory for folders with
+         * millions of files.
+         *
+         * When enabled, MegaApi::fetchNodes only loads the root of a public folder and its
+         * children. The children of the other folders are fetched the first time they are
+         * listed with MegaApi::getChildren (the new nodes are reported with onNodesUpdate)
+         * or explicitly with MegaApi::fetchFolder. The fetched levels are kept until logout.
+         *
+         * The setting takes effect with the next call to MegaApi::fetchNodes and doesn't
+         * affect the full accounts. It is disabled by default.
+         *
+         * @param enable true to fetch public folders incrementally
+         */
+        void setPartialFolderFetch(bool enable);
+
         /**
          * @brief Log in to a MEGA account using precomputed keys
          *
@@ -3635,6 +4761,164 @@ class MegaApi
          */
         MegaProxy *getAutoProxySettings();
 
+        /**
+         * @brief Enable or disable HTTP/2 multiplexing
+         *
+         * When enabled, concurrent requests to the same server (API commands as well as
+         * the chunk requests to a storage server) share one HTTPS connection as separate
+         * HTTP/2 streams, instead of each of them opening its own connection. This saves
+         * TLS handshakes and reduces the number of open connections. Servers that do not
+         * support HTTP/2 keep being used over HTTP/1.1.
+         *
+         * Multiplexing is disabled by default.
+         *
+         * @param enable true to enable HTTP/2 multiplexing, false to disable it
+         * @return false if it can't be enabled because the network layer doesn't support it
+         */
+        bool setHttpMultiplexing(bool enable);
+
+        /**
+         * @brief Run the network I/O on a dedicated thread
+         *
+         * By default, the thread of the SDK services the network connections between
+         * processing API responses, updating the node tree and synchronizing folders,
+         * so that a long processing step also delays the transfers (and the reverse).
+         *
+         * When enabled, a dedicated thread waits for and handles the socket I/O of all
+         * connections (including the data of file transfers), and passes the completed
+         * requests to the thread of the SDK.
+         *
+         * The change is applied asynchronously. It is not supported by all network
+         * layers (currently only by the cURL-based one); in that case, this function
+         * has no effect.
+         *
+         * The dedicated thread is disabled by default.
+         *
+         * @param enable true to use a dedicated network thread, false to go back to
+         * the thread of the SDK
+         */
+        void setNetworkThread(bool enable);
+
+        /**
+         * @brief Keep TLS sessions across restarts
+         *
+         * When enabled, the TLS sessions established with the MEGA servers are stored in the
+         * local cache of the session, encrypted with the session key. After a restart,
+         * MegaApi::fastLogin with the same session restores them, so that the first
+         * requests resume those sessions instead of doing full TLS handshakes.
+         *
+         * The stored sessions are removed by MegaApi::logout. This option is disabled by
+         * default and must be enabled before the login. It requires a local cache (see the
+         * basePath parameter of the MegaApi constructor) and support from the network layer.
+         *
+         * @param enable true to store TLS sessions, false to stop storing them
+         */
+        void enableTlsSessionCache(bool enable);
+
+        /**
+         * @brief Keep the pending downloads across restarts
+         *
+         * When enabled, the downloads of nodes of the account are stored in the local cache
+         * of the session (the node handle, the local path and the priority) until they
+         * finish. After a restart, they are started again in bulk when MegaApi::fetchNodes
+         * finishes, right before the request is reported as finished, so the app doesn't
+         * have to request them again. Downloads of nodes that don't exist anymore are
+         * discarded.
+         *
+         * Downloads of public nodes and streaming downloads are not stored. The stored
+         * downloads are removed by MegaApi::logout. This option is disabled by default and
+         * must be enabled before the login. It requires a local cache (see the basePath
+         * parameter of the MegaApi constructor).
+         *
+         * @param enable true to store the pending downloads, false to stop storing them
+         */
+        void enablePersistentTransferQueue(bool enable);
+
+        /**
+         * @brief Compress large API requests
+         *
+         * When enabled, the bodies of API requests of at least the given size (for example,
+         * large batches of new nodes or share keys) are sent gzip-compressed. Requests that
+         * don't get at least 10% smaller are sent uncompressed.
+         *
+         * This option is disabled by default.
+         *
+         * @param threshold Minimum size of the request body to compress it, in bytes.
+         * Use 0 to disable the compression.
+         */
+        void setApiRequestCompression(unsigned int threshold);
+
+        /**
+         * @brief Decrypt node attributes on demand
+         *
+         * When enabled, the attributes of the nodes (name, fingerprint, modification time...)
+         * are kept encrypted until they are first needed, instead of being decrypted when the
+         * nodes are loaded. This reduces the CPU time and the memory used to load large
+         * accounts when most nodes are never displayed.
+         *
+         * The option has no effect while synchronizations are active, and it has less effect
+         * if the nodes are loaded from the local cache, which stores them decrypted.
+         * It is disabled by default and should be enabled before MegaApi::fetchNodes.
+         *
+         * @param enable true to decrypt node attributes on demand, false to decrypt them
+         * when the nodes are loaded (pending attributes are decrypted immediately)
+         */
+        void enableLazyNodeAttributes(bool enable);
+
+#ifdef ENABLE_SYNC
+        /**
+         * @brief Set the number of folders listed ahead during sync scans
+         *
+         * When a worker pool is available, the SDK lists the subfolders of a synced folder
+         * in parallel while the folder itself is processed, which speeds up the scan of
+         * large local trees, especially on network filesystems.
+         *
+         * The limit applies to all synchronizations together, each active synchronization
+         * gets an equal share of it.
+         *
+         * The default value is 16.
+         *
+         * @param folders Maximum number of folders listed ahead. Use 0 to scan the
+         * folders one at a time.
+         */
+        void setSyncScanParallelism(unsigned int folders);
+
+        /**
+         * @brief Set the interval of the sync fingerprint verification
+         *
+         * Files whose inode, size, modification time and status change time have not changed
+         * since they were last fingerprinted keep their cached fingerprint, also across
+         * restarts, so rescanning a sync only needs to read the file metadata.
+         *
+         * With a verification interval, each active sync is periodically rescanned in full,
+         * fingerprinting every file again to detect changes that left the metadata intact.
+         *
+         * It is disabled by default.
+         *
+         * @param seconds Minimum time between two verification rescans of a sync, in seconds.
+         * Use 0 to disable the verification.
+         */
+        void setSyncVerificationInterval(unsigned int seconds);
+
+        /**
+         * @brief Skip unchanged folders during sync rescans
+         *
+         * When enabled, a rescan of a sync (at startup or after a notification failure) does not
+         * visit the folders whose modification time has not changed since they were last listed,
+         * nor anything below them, so rescanning mostly static trees only costs as much as the
+         * changes.
+         *
+         * A folder's modification time reflects the creation, deletion and renaming of its entries,
+         * but not changes to the content of the files in it (or in its subfolders), which are then
+         * only detected by the verification rescans (see MegaApi::setSyncVerificationInterval).
+         *
+         * It is disabled by default.
+         *
+         * @param enable true to skip unchanged folders, false to visit every folder
+         */
+        void setSyncSkipUnchangedFolders(bool enable);
+#endif
+
         /**
          * @brief Check if the MegaApi object is logged in
          * @return 0 if not logged in, Otherwise, a number >= 0
@@ -3684,6 +4968,43 @@ class MegaApi
          */
         static void setLogLevel(int logLevel);
 
+        /**
+         * @brief Share engine resources between the MegaApi objects of this process
+         *
+         * When enabled, the MegaApi objects created afterwards share the worker threads
+         * (encryption, hashing, local database work), the threads that generate
+         * thumbnails and previews, and the DNS and TLS session caches of the network
+         * layer, instead of creating their own. This reduces the cost of each instance
+         * when many accounts are used in the same process.
+         *
+         * The shared resources are created with the first MegaApi object that uses them
+         * and released with the last one. Objects created before this call are not
+         * affected. Each MegaApi object still has its own SDK thread and connections.
+         *
+         * It's disabled by default.
+         *
+         * @param enable True to share the resources with the MegaApi objects created later
+         */
+        static void setSharedRuntime(bool enable);
+
+        /**
+         * @brief Share the buffers of equal node names between MegaNode objects
+         *
+         * When enabled, the names of the MegaNode objects created afterwards (by listings,
+         * searches, callbacks or MegaNode::copy) are kept in a pool shared by the whole
+         * process, with a single buffer for each distinct name. This reduces the memory of
+         * large listings, especially of trees where many nodes have the same names
+         * (photos, web sites, .DS_Store or Thumbs.db files...). The pool needs a lock, so
+         * creating and deleting MegaNode objects is slightly slower.
+         *
+         * MegaNode objects created before this call keep their own copies of the names.
+         *
+         * It's disabled by default.
+         *
+         * @param enable True to share the buffers of the names
+         */
+        static void enableNameInterning(bool enable);
+
         /**
          * @brief Set a MegaLogger implementation to receive SDK logs
          *
@@ -3695,6 +5016,25 @@ class MegaApi
          */
         static void setLoggerObject(MegaLogger *megaLogger);
 
+        /**
+         * @brief Deliver the logs to the MegaLogger from a background thread
+         *
+         * When enabled, logging a message only queues it: the time and the source are
+         * formatted, and MegaLogger::log is called, by a dedicated thread, in the order
+         * in which the messages were generated. This keeps the cost of verbose logging
+         * off the SDK thread and the threads of the application.
+         *
+         * Up to 4096 messages can be waiting. If more are generated, they are dropped and
+         * the number of dropped messages is logged with MegaApi::LOG_LEVEL_WARNING.
+         * Logs with MegaApi::LOG_LEVEL_FATAL are delivered before the function that
+         * generated them returns, together with all the messages queued before them.
+         *
+         * It's disabled by default. Disabling it delivers the messages still queued.
+         *
+         * @param enable True to deliver the logs from a background thread
+         */
+        static void setAsyncLogging(bool enable);
+
         /**
          * @brief Send a log to the logging system
          *
@@ -3983,26 +5323,66 @@ class MegaApi
         void getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 
         /**
-         * @brief Get the avatar of a MegaUser
+         * @brief Get the thumbnail of a node ahead of displaying it
          *
-         * The associated request type with this request is MegaRequest::TYPE_GET_ATTR_USER
+         * Like MegaApi::getThumbnail, but the request is sent after the thumbnails and previews
+         * requested for display, in small batches, so that prefetching the next screens of a list
+         * doesn't delay the visible ones. A later MegaApi::getThumbnail for the same node
+         * (e.g. when it is scrolled into view) raises its priority, MegaApi::cancelGetThumbnail
+         * drops it (e.g. when it is scrolled out of range).
+         *
+         * The associated request type with this request is MegaRequest::TYPE_GET_ATTR_FILE
          * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNodeHandle - Returns the handle of the node
          * - MegaRequest::getFile - Returns the destination path
-         * - MegaRequest::getEmail - Returns the email of the user
-         *
-         * @param user MegaUser to get the avatar. If this parameter is set to NULL, the avatar is obtained
-         * for the active account
-         * @param dstFilePath Destination path for the avatar. It has to be a path to a file, not to a folder.
-         * If this path is a local folder, it must end with a '\' or '/' character and (email + "0.jpg")
-         * will be used as the file name inside that folder. If the path doesn't finish with
-         * one of these characters, the file will be downloaded to a file in that path.
+         * - MegaRequest::getParamType - Returns MegaApi::ATTR_TYPE_THUMBNAIL
+         * - MegaRequest::getFlag - Returns true
          *
+         * @param node Node to get the thumbnail
+         * @param dstFilePath Destination path for the thumbnail (see MegaApi::getThumbnail)
          * @param listener MegaRequestListener to track this request
          */
-        void getUserAvatar(MegaUser* user, const char *dstFilePath, MegaRequestListener *listener = NULL);
+        void prefetchThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 
         /**
-         * @brief Get the avatar of the active account
+         * @brief Get the preview of a node ahead of displaying it
+         *
+         * Like MegaApi::getPreview, with the priority rules of MegaApi::prefetchThumbnail.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_GET_ATTR_FILE
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNodeHandle - Returns the handle of the node
+         * - MegaRequest::getFile - Returns the destination path
+         * - MegaRequest::getParamType - Returns MegaApi::ATTR_TYPE_PREVIEW
+         * - MegaRequest::getFlag - Returns true
+         *
+         * @param node Node to get the preview
+         * @param dstFilePath Destination path for the preview (see MegaApi::getPreview)
+         * @param listener MegaRequestListener to track this request
+         */
+        void prefetchPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Get the avatar of a MegaUser
+         *
+         * The associated request type with this request is MegaRequest::TYPE_GET_ATTR_USER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getFile - Returns the destination path
+         * - MegaRequest::getEmail - Returns the email of the user
+         *
+         * @param user MegaUser to get the avatar. If this parameter is set to NULL, the avatar is obtained
+         * for the active account
+         * @param dstFilePath Destination path for the avatar. It has to be a path to a file, not to a folder.
+         * If this path is a local folder, it must end with a '\' or '/' character and (email + "0.jpg")
+         * will be used as the file name inside that folder. If the path doesn't finish with
+         * one of these characters, the file will be downloaded to a file in that path.
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void getUserAvatar(MegaUser* user, const char *dstFilePath, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Get the avatar of the active account
          *
          * The associated request type with this request is MegaRequest::TYPE_GET_ATTR_USER
          * Valid data in the MegaRequest object received on callbacks:
@@ -4192,6 +5572,56 @@ class MegaApi
          */
         void disableExport(MegaNode *node, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Generate the public links of several files/folders in MEGA
+         *
+         * This is equivalent to calling MegaApi::exportNode for each node, but the commands
+         * are sent to MEGA in large batches and the request finishes once, when all of them
+         * have been processed - use it to export many nodes (e.g. a whole gallery).
+         *
+         * The associated request type with this request is MegaRequest::TYPE_EXPORT_NODES
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getMegaNodeList - Returns the nodes to export
+         * - MegaRequest::getAccess - Returns true
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish:
+         * - MegaRequest::getNodeErrorCode - Returns the result of each node
+         * - MegaRequest::getNodeLink - Returns the public link of each node
+         *
+         * The error code of the request is MegaError::API_OK if all the nodes were exported,
+         * otherwise it's the error of the first node that failed.
+         *
+         * @param nodes Nodes to get the public links
+         * @param listener MegaRequestListener to track this request
+         */
+        void exportNodes(MegaNodeList *nodes, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Set a custom attribute of several nodes in MEGA
+         *
+         * The attribute is stored (with the prefix '_') with the rest of attributes of the node,
+         * encrypted. All the changes are sent to MEGA in large batches and the request finishes
+         * once, when all of them have been processed.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_SET_NODES_ATTRIBUTE
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getMegaNodeList - Returns the nodes to modify
+         * - MegaRequest::getName - Returns the name of the attribute
+         * - MegaRequest::getText - Returns the value of the attribute
+         *
+         * Valid data in the MegaRequest object received in onRequestFinish:
+         * - MegaRequest::getNodeErrorCode - Returns the result of each node
+         *
+         * The error code of the request is MegaError::API_OK if all the nodes were modified,
+         * otherwise it's the error of the first node that failed.
+         *
+         * @param nodes Nodes to modify
+         * @param attrName Name of the attribute (up to 7 characters)
+         * @param value Value for the attribute, NULL to remove it
+         * @param listener MegaRequestListener to track this request
+         */
+        void setNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Fetch the filesystem in MEGA
          *
@@ -4204,6 +5634,25 @@ class MegaApi
          */
         void fetchNodes(MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Fetch the contents of a folder of an incrementally fetched public folder
+         *
+         * See MegaApi::setPartialFolderFetch. The request finishes once the nodes have been
+         * added to the tree, or right away if they were already there (in particular, always
+         * for full accounts).
+         *
+         * The associated request type with this request is MegaRequest::TYPE_FETCH_FOLDER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNodeHandle - Returns the handle of the folder
+         * - MegaRequest::getFlag - Returns true if the whole subtree was requested
+         *
+         * @param node Folder to fetch
+         * @param recursive true to fetch the whole subtree (i.e. before downloading all its
+         * files), false for the children only
+         * @param listener MegaRequestListener to track this request
+         */
+        void fetchFolder(MegaNode *node, bool recursive, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Get details about the MEGA account
          *
@@ -4598,9 +6047,42 @@ class MegaApi
         void startUpload(const char* localPath, MegaNode* parent, const char* fileName, int64_t mtime, MegaTransferListener *listener = NULL);
 
         /**
-         * @brief Download a file from MEGA
-         * @param node MegaNode that identifies the file
-         * @param localPath Destination path for the file
+         * @brief Upload data provided by a stream
+         *
+         * The data doesn't need to be in a local file: it's read once, sequentially, with
+         * MegaInputStream::read and encrypted chunk by chunk as it's uploaded. The fingerprint
+         * of the file is computed in the same pass, and nothing is written to disk.
+         *
+         * The size of the data (MegaInputStream::getSize) must be known when the upload starts.
+         * MegaInputStream::read is called from the thread of the SDK, so it shouldn't block for
+         * long. As the data can't be read again, the upload fails if the connection with MEGA is
+         * lost for good after the first chunk has been read - interruptions of single chunk
+         * requests are retried with the data kept in memory.
+         *
+         * The stream must remain valid until MegaTransferListener::onTransferFinish is called.
+         *
+         * @param inputStream Source of the data
+         * @param parent Parent node for the file in the MEGA account
+         * @param fileName Name of the file in MEGA
+         * @param mtime Modification time for the file in MEGA (in seconds since the epoch, -1
+         * for the current time)
+         * @param listener MegaTransferListener to track this transfer
+         */
+        void startStreamUpload(MegaInputStream *inputStream, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener = NULL);
+
+        /**
+         * @brief Download a file or a folder from MEGA
+         *
+         * When the node is a folder, the whole subtree is downloaded: the local folders are
+         * created first, then every file is downloaded by a transfer of its own (see
+         * MegaTransfer::getFolderTransferTag), the largest files first. The transfer of the
+         * folder reports the aggregated progress of the files and finishes when all of them
+         * have finished, with the error of the first one that failed (if any). Cancelling it
+         * cancels the downloads of the files. The children of all the folders must have been
+         * loaded, otherwise the transfer fails with API_EINCOMPLETE.
+         *
+         * @param node MegaNode that identifies the file or folder
+         * @param localPath Destination path for the file or folder
          * If this path is a local folder, it must end with a '\' or '/' character and the file name
          * in MEGA will be used to store a file inside that folder. If the path doesn't finish with
          * one of these characters, the file will be downloaded to a file in that path.
@@ -4609,6 +6091,21 @@ class MegaApi
          */
         void startDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
 
+        /**
+         * @brief Start all the uploads and downloads of a batch
+         *
+         * The transfers are queued at once and processed as if they were started one by one
+         * with MegaApi::startUpload and MegaApi::startDownload. The listener receives the
+         * callbacks of each one of them, including MegaTransferListener::onTransferFinish
+         * with an error for the ones that can't be started.
+         *
+         * After this call, the batch is empty and can be reused.
+         *
+         * @param batch Transfers to start
+         * @param listener MegaTransferListener to track all these transfers
+         */
+        void startTransfers(MegaTransferBatch *batch, MegaTransferListener *listener = NULL);
+
         /**
          * @brief Start an streaming download
          *
@@ -4635,171 +6132,675 @@ class MegaApi
          * MegaError::API_EINCOMPLETE in MegaTransferListener::onTransferFinish and
          * MegaListener::onTransferFinish
          *
-         * The associated request type with this request is MegaRequest::TYPE_CANCEL_TRANSFER
-         * Valid data in the MegaRequest object received on callbacks:
-         * - MegaRequest::getTransferTag - Returns the tag of the cancelled transfer (MegaTransfer::getTag)
+         * The associated request type with this request is MegaRequest::TYPE_CANCEL_TRANSFER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTransferTag - Returns the tag of the cancelled transfer (MegaTransfer::getTag)
+         *
+         * @param transfer MegaTransfer object that identifies the transfer
+         * You can get this object in any MegaTransferListener callback or any MegaListener callback
+         * related to transfers.
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Cancel the transfer with a specific tag
+         *
+         * When a transfer is cancelled, it will finish and will provide the error code
+         * MegaError::API_EINCOMPLETE in MegaTransferListener::onTransferFinish and
+         * MegaListener::onTransferFinish
+         *
+         * The associated request type with this request is MegaRequest::TYPE_CANCEL_TRANSFER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTransferTag - Returns the tag of the cancelled transfer (MegaTransfer::getTag)
+         *
+         * @param transferTag tag that identifies the transfer
+         * You can get this tag using MegaTransfer::getTag
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void cancelTransferByTag(int transferTag, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Cancel all transfers of the same type
+         *
+         * The associated request type with this request is MegaRequest::TYPE_CANCEL_TRANSFERS
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getParamType - Returns the first parameter
+         *
+         * @param type Type of transfers to cancel.
+         * Valid values are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void cancelTransfers(int type, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Pause/resume all transfers
+         *
+         * The associated request type with this request is MegaRequest::TYPE_PAUSE_TRANSFERS
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getFlag - Returns the first parameter
+         *
+         * @param pause true to pause all transfers / false to resume all transfers
+         * @param listener MegaRequestListener to track this request
+         */
+        void pauseTransfers(bool pause, MegaRequestListener* listener = NULL);
+
+        /**
+         * @brief  Pause/resume all transfers in one direction (uploads or downloads)
+         *
+         * The associated request type with this request is MegaRequest::TYPE_PAUSE_TRANSFERS
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getFlag - Returns the first parameter
+         * - MegaRequest::getNumber - Returns the direction of the transfers to pause/resume
+         *
+         * @param pause true to pause transfers / false to resume transfers
+         * @param direction Direction of transfers to pause/resume
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void pauseTransfers(bool pause, int direction, MegaRequestListener* listener = NULL);
+
+        /**
+         * @brief Returns the state (paused/unpaused) of transfers
+         * @param direction Direction of transfers to check
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @return true if transfers on that direction are paused, false otherwise
+         */
+        bool areTransfersPaused(int direction);
+
+        /**
+         * @brief Set the upload speed limit
+         *
+         * The limit will be applied on the server side when starting a transfer. Thus the limit won't be
+         * applied for already started uploads and it's applied per storage server.
+         *
+         * @param bpslimit -1 to automatically select the limit, 0 for no limit, otherwise the speed limit
+         * in bytes per second
+         */
+        void setUploadLimit(int bpslimit);
+
+        /**
+         * @brief Set the transfer method for downloads
+         *
+         * Valid methods are:
+         * - TRANSFER_METHOD_NORMAL = 0
+         * HTTP transfers using port 80. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
+         * HTTP transfers using port 8080. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_AUTO = 2
+         * The SDK selects the transfer method automatically
+         *
+         * @param method Selected transfer method for downloads
+         */
+        void setDownloadMethod(int method);
+
+        /**
+         * @brief Set the transfer method for uploads
+         *
+         * Valid methods are:
+         * - TRANSFER_METHOD_NORMAL = 0
+         * HTTP transfers using port 80. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
+         * HTTP transfers using port 8080. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_AUTO = 2
+         * The SDK selects the transfer method automatically
+         *
+         * @param method Selected transfer method for uploads
+         */
+        void setUploadMethod(int method);
+
+        /**
+         * @brief Get the active transfer method for downloads
+         *
+         * Valid values for the return parameter are:
+         * - TRANSFER_METHOD_NORMAL = 0
+         * HTTP transfers using port 80. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
+         * HTTP transfers using port 8080. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_AUTO = 2
+         * The SDK selects the transfer method automatically
+         *
+         * @return Active transfer method for downloads
+         */
+        int getDownloadMethod();
+
+        /**
+         * @brief Get the active transfer method for uploads
+         *
+         * Valid values for the return parameter are:
+         * - TRANSFER_METHOD_NORMAL = 0
+         * HTTP transfers using port 80. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
+         * HTTP transfers using port 8080. Data is already encrypted.
+         *
+         * - TRANSFER_METHOD_AUTO = 2
+         * The SDK selects the transfer method automatically
+         *
+         * @return Active transfer method for uploads
+         */
+        int getUploadMethod();
+
+        /**
+         * @brief Set the bounds for the number of parallel connections per transfer
+         *
+         * Transfers bigger than 128 KB adjust the number of parallel connections at
+         * runtime, based on the measured throughput and chunk latency. This function
+         * sets the range inside which that number can move. Setting both limits to
+         * the same value disables the adaptation.
+         *
+         * @param direction Direction of transfers to configure
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param minConnections Minimum number of connections (at least 1)
+         * @param maxConnections Maximum number of connections (at most 16)
+         */
+        void setConnectionLimits(int direction, int minConnections, int maxConnections);
+
+        /**
+         * @brief Allow each transfer request to span several contiguous chunks
+         *
+         * Files are transferred in chunks of up to 1 MB, each one requested separately.
+         * For big files on high bandwidth-delay links, coalescing contiguous chunks into
+         * a single request avoids per-request round trips. Integrity is still verified
+         * on the original chunk boundaries.
+         *
+         * @param direction Direction of transfers to configure
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param maxSize Maximum size of a request in bytes (up to 16 MB). 0 (default)
+         * sends one request per chunk.
+         */
+        void setMaxRequestSize(int direction, long long maxSize);
+
+        /**
+         * @brief Set the maximum amount of memory kept for reuse by transfer buffers
+         *
+         * Chunk buffers of finished transfer requests are pooled and reused by the
+         * following ones, instead of being freed and allocated again. This function
+         * sets how much idle buffer memory the pool may keep. Buffers in use by
+         * active requests are not affected.
+         *
+         * @param limit Maximum size of the idle buffers in bytes (default: 32 MB).
+         * 0 disables the pooling.
+         */
+        void setTransferBufferPoolLimit(long long limit);
+
+        /**
+         * @brief Limit the memory held by data in flight
+         *
+         * Transfer chunk requests, the read-ahead of uploads, streaming reads (and the
+         * pieces they fetch ahead) and file attribute uploads reserve their buffers from
+         * a single budget. New ones are only started while it has room, so the memory used
+         * by the SDK under load stays predictable. One request is always admitted, even
+         * if it is larger than the budget.
+         *
+         * @param bytes Maximum size of the data in flight in bytes (default: 0, unlimited)
+         */
+        void setInflightMemoryBudget(long long bytes);
+
+        /**
+         * @brief Spread the transfer chunk connections over several local network interfaces
+         *
+         * Each chunk request is bound to one of the interfaces: the least loaded one relative
+         * to its weight, so equal weights distribute the requests round-robin. Without weights,
+         * they are distributed according to the throughput measured on each interface.
+         * An interface whose connections fail is avoided for a while, and every transfer
+         * keeps at least one connection per interface.
+         *
+         * API requests and streaming reads use the default route. Binding to an interface
+         * is only supported by the cURL network layer.
+         *
+         * @param interfaces Comma-separated list of interface names, host names or local IP
+         * addresses, each optionally followed by "=weight" (for example "eth0=3,eth1=1",
+         * or "192.168.1.10,10.0.0.2"). NULL or an empty string uses the default route again.
+         */
+        void setNetworkInterfaces(const char *interfaces);
+
+        /**
+         * @brief Set the size of the local thumbnail/preview cache
+         *
+         * Thumbnails and previews generated for uploads or downloaded with
+         * MegaApi::getThumbnail and MegaApi::getPreview are kept in an encrypted local
+         * cache by file fingerprint, so the same image is neither processed nor downloaded
+         * again. The least recently used entries are evicted beyond this size.
+         *
+         * @param limit Maximum size of the cached images in bytes (default: 32 MB).
+         * 0 disables the cache.
+         */
+        void setThumbnailCacheLimit(long long limit);
+
+        /**
+         * @brief Set the size of the in-memory thumbnail/preview cache
+         *
+         * The most recently used thumbnails and previews are also kept in memory, so that
+         * views showing them repeatedly don't read the local cache or download them again.
+         *
+         * @param limit Maximum size of the images kept in memory in bytes (default: 4 MB).
+         * 0 disables it.
+         */
+        void setThumbnailMemoryCacheLimit(long long limit);
+
+        /**
+         * @brief Prefetch the thumbnails of listed folders
+         *
+         * When enabled, MegaApi::getChildren queues the download of the thumbnails of up to
+         * this many of the returned files (in the order of the list) that aren't in the
+         * thumbnail cache yet. They are fetched together, with the priority of
+         * MegaApi::prefetchThumbnail, and kept in the cache, so the following calls to
+         * MegaApi::getThumbnail for them are served locally (or take over the pending
+         * download). Nothing is prefetched if both thumbnail caches are disabled.
+         *
+         * Prefetching is disabled by default.
+         *
+         * @param budget Maximum number of thumbnails prefetched per listing (0: disabled)
+         */
+        void setThumbnailPrefetch(int budget);
+
+        /**
+         * @brief Set the memory budget for decoding images
+         *
+         * Images whose decoded bitmap would need more memory than this (estimated from the
+         * image header, taking reduced-scale JPEG decoding into account) get no thumbnail
+         * or preview, so that processing them can't exhaust the memory of the app.
+         * Images are decoded one at a time.
+         *
+         * @param limit Maximum memory for one decoded image in bytes (default: 256 MB).
+         * 0 removes the limit.
+         */
+        void setImageDecodeLimit(long long limit);
+
+        /**
+         * @brief Set how downloaded data is written to disk
+         *
+         * Chunks of a download complete out of order. Preallocating the full size of
+         * the target file avoids fragmenting it. Unbuffered (direct) writes keep big
+         * downloads from evicting the OS page cache. Both are disabled by default and
+         * are ignored where the filesystem does not support them.
+         *
+         * @param preallocate true to reserve the disk space of each download up front
+         * @param directIO true to write download data bypassing the OS cache
+         */
+        void setDownloadWriteMode(bool preallocate, bool directIO);
+
+        /**
+         * @brief Complete uploads of files already in the account by copying the existing node
+         *
+         * When enabled, queued uploads are fingerprinted in the background. Files whose
+         * fingerprint matches an existing file node are not transferred: a copy of that
+         * node is created in the target folder with the requested name, in batches of up
+         * to 1000 nodes per folder. Only the remaining files are uploaded.
+         *
+         * The MegaTransfer callbacks are the same as for a regular upload.
+         *
+         * @param enable true to enable the server-side copies (default: false)
+         */
+        void enableUploadCopies(bool enable);
+
+        /**
+         * @brief Limit the bandwidth used by transfers in one direction
+         *
+         * The limit is shared by all transfers in the direction and enforced on the
+         * client, per chunk request. Unused bandwidth accumulates up to burstBytes, so
+         * short transfers after an idle period run at full speed.
+         *
+         * This limit is independent of MegaApi::setUploadLimit, which is enforced by the
+         * server.
+         *
+         * @param direction Direction of transfers to limit
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param bytesPerSecond Sustained rate in bytes per second. 0 (default) removes the limit.
+         * @param burstBytes Maximum amount of unused bandwidth that can be accumulated, in bytes
+         */
+        void setBandwidthLimit(int direction, long long bytesPerSecond, long long burstBytes);
+
+        /**
+         * @brief Limit the bandwidth used by each single transfer in one direction
+         *
+         * @param direction Direction of transfers to limit
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param bytesPerSecond Rate in bytes per second. 0 (default) removes the limit.
+         */
+        void setTransferBandwidthLimit(int direction, long long bytesPerSecond);
+
+        /**
+         * @brief Override the bandwidth limit of a direction during a time window
+         *
+         * While the window is active (local time), its rate replaces the one set with
+         * MegaApi::setBandwidthLimit. If several windows overlap, the first one added applies.
+         *
+         * @param direction Direction of transfers to limit
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @param weekdays Bitmask of the days the window starts on (bit 0: Sunday ... bit 6: Saturday)
+         * @param startMinute Start of the window, in minutes since midnight (0 - 1439)
+         * @param endMinute End of the window, in minutes since midnight (0 - 1440). If it is
+         * lower than startMinute, the window ends on the next day.
+         * @param bytesPerSecond Rate in bytes per second during the window. 0 means unlimited.
+         */
+        void addBandwidthSchedule(int direction, int weekdays, int startMinute, int endMinute, long long bytesPerSecond);
+
+        /**
+         * @brief Remove all the time windows added with MegaApi::addBandwidthSchedule
+         *
+         * @param direction Direction of transfers
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         */
+        void clearBandwidthSchedule(int direction);
+
+        /**
+         * @brief Guarantee bandwidth to streaming reads
+         *
+         * Reads started with MegaApi::startStreaming that aren't paused (MegaApi::pauseStreaming)
+         * are taken to be waiting for data. If one of them receives less than this rate over a
+         * couple of seconds, downloads back off until it's back at the rate: no new ones start,
+         * the active ones use a single connection and their combined rate is halved with each
+         * period in which a read still receives less. Uploads aren't affected.
+         *
+         * @param bytesPerSecond Rate guaranteed to each streaming read in bytes per second. 0
+         * (default) disables the guarantee.
+         */
+        void setStreamingBandwidth(long long bytesPerSecond);
+
+        /**
+         * @brief Configure the cache used by streaming transfers
+         *
+         * Data read with MegaApi::startStreaming is kept decrypted in memory, per node,
+         * so that seeking back into recently read ranges doesn't download it again.
+         * When a read of a limited range starts, the following window of the file is
+         * read ahead into the cache, so that the next sequential read can be served
+         * from memory.
+         *
+         * @param cacheSize Maximum size of the cached data per node in bytes (default: 16 MB).
+         * 0 disables the cache and the read-ahead.
+         * @param readAhead Size of the read-ahead window in bytes (default: 4 MB).
+         * 0 disables the read-ahead.
+         */
+        void setStreamingCache(long long cacheSize, long long readAhead);
+
+        /**
+         * @brief Pause or resume the delivery of the data of a streaming transfer
+         *
+         * While a streaming transfer is paused, MegaTransferListener::onTransferData and
+         * MegaTransferListener::onTransferBuffer aren't called for it. The data already received
+         * is kept (up to 1 MB per connection of the transfer) and the SDK stops reading from its
+         * connections until it's resumed, so a slow consumer doesn't need to block the
+         * SDK thread nor to cancel the transfer. Other transfers are not affected.
+         *
+         * This function can be called from MegaTransferListener::onTransferData, and takes effect
+         * after it returns.
+         *
+         * @param transfer Streaming transfer (MegaApi::startStreaming)
+         * @param pause True to pause the transfer, false to resume it
+         * @return False if the transfer isn't an active streaming transfer
+         */
+        bool pauseStreaming(MegaTransfer *transfer, bool pause);
+
+        /**
+         * @brief Start the local HTTP server for media playback
+         *
+         * The server gives platform players access to the content of file nodes through
+         * plain HTTP URLs (see MegaApi::httpServerGetLocalLink). It supports GET and HEAD
+         * requests with a Range header, concurrent connections and keep-alive. The data is
+         * read through streaming transfers in windows of 4 MB, so that the streaming cache
+         * (MegaApi::setStreamingCache) reads the following window ahead during sequential
+         * playback. When a player drops a connection (for example, to seek), the read in
+         * progress is cancelled immediately.
+         *
+         * If the server is already running, it's restarted with the new parameters.
+         *
+         * This feature isn't available on Windows Phone.
+         *
+         * @param localOnly True to accept connections from this device only (the server
+         * listens on 127.0.0.1), false to accept them from any address
+         * @param port TCP port to listen on (default: 4443)
+         * @return True if the server is running
+         */
+        bool httpServerStart(bool localOnly = true, int port = 4443);
+
+        /**
+         * @brief Stop the local HTTP server
+         *
+         * The requests in progress are aborted and their transfers are cancelled. This
+         * function waits until all connections have been closed, so it must not be called
+         * from a callback of the SDK.
+         */
+        void httpServerStop();
+
+        /**
+         * @brief Check if the local HTTP server is running
+         * @return The port of the server, or 0 if it isn't running
+         */
+        int httpServerIsRunning();
+
+        /**
+         * @brief Get the URL of the content of a file node on the local HTTP server
+         *
+         * The URL has the form http://127.0.0.1:<port>/<base64 handle>/<name>. It remains
+         * valid while the server runs and the node is available.
          *
-         * @param transfer MegaTransfer object that identifies the transfer
-         * You can get this object in any MegaTransferListener callback or any MegaListener callback
-         * related to transfers.
+         * You take the ownership of the returned value.
          *
-         * @param listener MegaRequestListener to track this request
+         * @param node File node
+         * @return URL of the node, or NULL if the server isn't running or the node isn't a file
          */
-        void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener = NULL);
+        char *httpServerGetLocalLink(MegaNode *node);
 
         /**
-         * @brief Cancel the transfer with a specific tag
+         * @brief Start sharing file chunks with other clients in the local network
          *
-         * When a transfer is cancelled, it will finish and will provide the error code
-         * MegaError::API_EINCOMPLETE in MegaTransferListener::onTransferFinish and
-         * MegaListener::onTransferFinish
+         * Clients with the LAN peer cache enabled ask the local network (UDP broadcast)
+         * for each file they start to download. A peer that holds an up-to-date synced
+         * copy of the file answers, and the chunks of the download are then requested
+         * from it instead of the storage servers. If the peer fails, the download
+         * continues from the storage servers.
          *
-         * The associated request type with this request is MegaRequest::TYPE_CANCEL_TRANSFER
-         * Valid data in the MegaRequest object received on callbacks:
-         * - MegaRequest::getTransferTag - Returns the tag of the cancelled transfer (MegaTransfer::getTag)
+         * Peers send the encrypted content, exactly as the storage servers do, and the
+         * downloads verify it with the MAC of the file. A download with data from a peer
+         * that doesn't match the MAC is restarted without peers.
          *
-         * @param transferTag tag that identifies the transfer
-         * You can get this tag using MegaTransfer::getTag
+         * All clients of the network must use the same port. Only files in synced folders
+         * are shared (the SDK must be built with ENABLE_SYNC to serve chunks), and only
+         * with clients that know the handle of the node.
          *
-         * @param listener MegaRequestListener to track this request
+         * If the peer cache is already running, it's restarted with the new port.
+         *
+         * This feature isn't available on Windows Phone.
+         *
+         * @param port TCP and UDP port of the peer cache (default: 4444)
+         * @return True if the peer cache is running
          */
-        void cancelTransferByTag(int transferTag, MegaRequestListener *listener = NULL);
+        bool peerCacheStart(int port = 4444);
 
         /**
-         * @brief Cancel all transfers of the same type
+         * @brief Stop sharing file chunks with other clients in the local network
          *
-         * The associated request type with this request is MegaRequest::TYPE_CANCEL_TRANSFERS
-         * Valid data in the MegaRequest object received on callbacks:
-         * - MegaRequest::getParamType - Returns the first parameter
+         * This function waits until all peer connections have been closed, so it must not
+         * be called from a callback of the SDK.
+         */
+        void peerCacheStop();
+
+        /**
+         * @brief Check if the LAN peer cache is running
+         * @return The port of the peer cache, or 0 if it isn't running
+         */
+        int peerCacheIsRunning();
+
+        /**
+         * @brief Set the order in which queued transfers are started
          *
-         * @param type Type of transfers to cancel.
-         * Valid values are:
-         * - MegaTransfer::TYPE_DOWNLOAD = 0
-         * - MegaTransfer::TYPE_UPLOAD = 1
+         * Valid policies are:
+         * - TRANSFER_POLICY_DEFAULT = 0
+         * Transfers are started in queue order (smaller files first)
          *
-         * @param listener MegaRequestListener to track this request
+         * - TRANSFER_POLICY_SHORTEST_FIRST = 1
+         * Transfers with the smallest amount of pending data are started first
+         *
+         * - TRANSFER_POLICY_PRIORITY = 2
+         * Transfers with a higher priority class are started first (see MegaApi::setTransferPriority)
+         *
+         * - TRANSFER_POLICY_FAIR_SHARE = 3
+         * Transfers are balanced between their originators (e.g. each sync)
+         *
+         * - TRANSFER_POLICY_RECENT_FIRST = 4
+         * Transfers of the most recently modified files are started first
+         *
+         * - TRANSFER_POLICY_AGING = 5
+         * Transfers with the smallest amount of pending data are started first, but
+         * the longer a transfer has been waiting, the earlier it is started
+         *
+         * Regardless of the policy, the SDK starts as many transfers in parallel
+         * as needed to keep the connection saturated.
+         *
+         * @param policy Selected transfer policy
+         *
+         * @see MegaApi::setLargeTransferSlots
          */
-        void cancelTransfers(int type, MegaRequestListener *listener = NULL);
+        void setTransferPolicy(int policy);
 
         /**
-         * @brief Pause/resume all transfers
+         * @brief Set the priority class of a transfer
          *
-         * The associated request type with this request is MegaRequest::TYPE_PAUSE_TRANSFERS
-         * Valid data in the MegaRequest object received on callbacks:
-         * - MegaRequest::getFlag - Returns the first parameter
+         * With the policy TRANSFER_POLICY_PRIORITY, queued transfers with a higher
+         * priority class are started before the ones with a lower class. All transfers
+         * start with the class 0. Transfers that are already running are not affected.
          *
-         * @param pause true to pause all transfers / false to resume all transfers
-         * @param listener MegaRequestListener to track this request
+         * @param transferTag Tag of the transfer (MegaTransfer::getTag)
+         * @param priority Priority class (higher values are started first)
+         * @return false if there isn't a transfer with this tag
+         *
+         * @see MegaApi::setTransferPolicy
          */
-        void pauseTransfers(bool pause, MegaRequestListener* listener = NULL);
+        bool setTransferPriority(int transferTag, int priority);
 
         /**
-         * @brief  Pause/resume all transfers in one direction (uploads or downloads)
+         * @brief Limit the number of large transfers running in parallel
          *
-         * The associated request type with this request is MegaRequest::TYPE_PAUSE_TRANSFERS
-         * Valid data in the MegaRequest object received on callbacks:
-         * - MegaRequest::getFlag - Returns the first parameter
-         * - MegaRequest::getNumber - Returns the direction of the transfers to pause/resume
+         * Large transfers (e.g. a multi-gigabyte disk image in a synced folder) are
+         * confined to a number of transfer slots, so that the remaining slots stay
+         * available to smaller files, which are started even while the large ones
+         * are running. Queued large transfers wait until one of these slots is free.
          *
-         * @param pause true to pause transfers / false to resume transfers
-         * @param direction Direction of transfers to pause/resume
+         * @param direction Direction of transfers to limit
          * Valid values for this parameter are:
          * - MegaTransfer::TYPE_DOWNLOAD = 0
          * - MegaTransfer::TYPE_UPLOAD = 1
          *
-         * @param listener MegaRequestListener to track this request
+         * @param slots Maximum number of large transfers in parallel. 0 (default) removes the limit.
+         * @param minSize Size in bytes from which a transfer is considered large
          */
-        void pauseTransfers(bool pause, int direction, MegaRequestListener* listener = NULL);
+        void setLargeTransferSlots(int direction, int slots, long long minSize);
 
         /**
-         * @brief Returns the state (paused/unpaused) of transfers
+         * @brief Get the number of queued transfers that haven't started yet
          * @param direction Direction of transfers to check
          * Valid values for this parameter are:
          * - MegaTransfer::TYPE_DOWNLOAD = 0
          * - MegaTransfer::TYPE_UPLOAD = 1
          *
-         * @return true if transfers on that direction are paused, false otherwise
+         * @return Number of queued transfers
          */
-        bool areTransfersPaused(int direction);
+        int getTransferQueueDepth(int direction);
 
         /**
-         * @brief Set the upload speed limit
-         *
-         * The limit will be applied on the server side when starting a transfer. Thus the limit won't be
-         * applied for already started uploads and it's applied per storage server.
-         *
-         * @param bpslimit -1 to automatically select the limit, 0 for no limit, otherwise the speed limit
-         * in bytes per second
+         * @brief Get the utilization of the transfer slots
+         * @return Percentage of the available transfer slots that are currently in use
          */
-        void setUploadLimit(int bpslimit);
+        int getTransferSlotUtilization();
 
         /**
-         * @brief Set the transfer method for downloads
-         *
-         * Valid methods are:
-         * - TRANSFER_METHOD_NORMAL = 0
-         * HTTP transfers using port 80. Data is already encrypted.
+         * @brief Get the timing statistics of all chunk requests since the start or the last reset
          *
-         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
-         * HTTP transfers using port 8080. Data is already encrypted.
+         * You take the ownership of the returned value
          *
-         * - TRANSFER_METHOD_AUTO = 2
-         * The SDK selects the transfer method automatically
+         * @param direction Direction of transfers
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
          *
-         * @param method Selected transfer method for downloads
+         * @return Timing statistics, or NULL if the direction is not valid
+         * @see MegaTransferTimings
          */
-        void setDownloadMethod(int method);
+        MegaTransferTimings *getTransferTimings(int direction);
 
         /**
-         * @brief Set the transfer method for uploads
-         *
-         * Valid methods are:
-         * - TRANSFER_METHOD_NORMAL = 0
-         * HTTP transfers using port 80. Data is already encrypted.
-         *
-         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
-         * HTTP transfers using port 8080. Data is already encrypted.
+         * @brief Reset the statistics returned by MegaApi::getTransferTimings
          *
-         * - TRANSFER_METHOD_AUTO = 2
-         * The SDK selects the transfer method automatically
-         *
-         * @param method Selected transfer method for uploads
+         * @param direction Direction of transfers
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
          */
-        void setUploadMethod(int method);
+        void resetTransferTimings(int direction);
 
         /**
-         * @brief Get the active transfer method for downloads
+         * @brief Get the counters of the SDK engine
          *
-         * Valid values for the return parameter are:
-         * - TRANSFER_METHOD_NORMAL = 0
-         * HTTP transfers using port 80. Data is already encrypted.
+         * You take the ownership of the returned value
          *
-         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
-         * HTTP transfers using port 8080. Data is already encrypted.
+         * @return Counters of the engine
+         * @see MegaEngineMetrics
+         */
+        MegaEngineMetrics *getEngineMetrics();
+
+        /**
+         * @brief Reset the counters returned by MegaApi::getEngineMetrics
+         */
+        void resetEngineMetrics();
+
+        /**
+         * @brief Report the counters of the SDK engine periodically
          *
-         * - TRANSFER_METHOD_AUTO = 2
-         * The SDK selects the transfer method automatically
+         * MegaListener::onEngineMetrics and MegaGlobalListener::onEngineMetrics are called
+         * with the counters at this interval.
          *
-         * @return Active transfer method for downloads
+         * @param seconds Interval of the reports in seconds (0 to stop them)
          */
-        int getDownloadMethod();
+        void setEngineMetricsInterval(int seconds);
 
         /**
-         * @brief Get the active transfer method for uploads
-         *
-         * Valid values for the return parameter are:
-         * - TRANSFER_METHOD_NORMAL = 0
-         * HTTP transfers using port 80. Data is already encrypted.
+         * @brief Get the timeline of the startup of the current session
          *
-         * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
-         * HTTP transfers using port 8080. Data is already encrypted.
+         * It records when each phase of the last login and load of the nodes started and
+         * ended, to measure cold (from the server) and warm (from the local cache) startups.
          *
-         * - TRANSFER_METHOD_AUTO = 2
-         * The SDK selects the transfer method automatically
+         * You take the ownership of the returned value
          *
-         * @return Active transfer method for uploads
+         * @return Timeline of the startup
+         * @see MegaStartupTimeline
          */
-        int getUploadMethod();
+        MegaStartupTimeline *getStartupTimeline();
 
         /**
          * @brief Get all active transfers
@@ -4837,6 +6838,46 @@ class MegaApi
          */
         MegaTransferList *getTransfers(int type);
 
+        /**
+         * @brief Get a page of the active transfers
+         *
+         * The transfers are ordered by tag (MegaTransfer::getTag). To get all of them, start
+         * with fromTag = 0 and then use the tag of the last transfer of each page. Unlike
+         * MegaApi::getTransfers, only one page of transfers is copied on each call.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param type MegaTransfer::TYPE_DOWNLOAD, MegaTransfer::TYPE_UPLOAD or -1 for both
+         * @param fromTag Only transfers with a tag higher than this one are returned
+         * @param limit Maximum number of transfers to return
+         * @return List with the transfers of the page
+         */
+        MegaTransferList *getTransfers(int type, int fromTag, int limit);
+
+        /**
+         * @brief Get the aggregate statistics of the transfers
+         *
+         * The values are maintained by the SDK as transfers progress, so this function is
+         * cheap regardless of the number of transfers.
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Statistics of the transfers
+         */
+        MegaTransferStats *getTransferStats();
+
+        /**
+         * @brief Get an estimate of the memory used by the SDK, by subsystem
+         *
+         * The cost of this function grows with the number of nodes, so it isn't meant to
+         * be called continuously.
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Memory used by the SDK
+         */
+        MegaMemoryUsage *getMemoryUsage();
+
 #ifdef ENABLE_SYNC
 
         ///////////////////   SYNCHRONIZATION   ///////////////////
@@ -5018,6 +7059,17 @@ class MegaApi
          */
         int getNumActiveSyncs();
 
+        /**
+         * @brief Get the memory used by the synchronization engine
+         *
+         * The value is an estimate of the heap memory held by the local trees of all
+         * active synced folders (allocator overhead is not included), and it is
+         * proportional to the number of local files and folders.
+         *
+         * @return Estimated memory used by the local trees of the syncs, in bytes
+         */
+        long long getSyncMemoryUsage();
+
         /**
          * @brief Check if the synchronization engine is scanning files
          * @return true if it is scanning, otherwise false
@@ -5037,6 +7089,10 @@ class MegaApi
          *
          * Wildcards (* and ?) are allowed
          *
+         * Patterns that contain a path separator are matched against the full local path
+         * of folders (for example "/home/user/MEGA/tmp?"). Files and folders inside an excluded
+         * folder aren't scanned.
+         *
          * @param List of excluded file names
          * @deprecated A more powerful exclusion system based on regular expresions is being developed. This
          * function will be removed in future updates
@@ -5306,6 +7362,116 @@ class MegaApi
          */
         int getIndex(MegaNode* node, int order = 1);
 
+        /**
+         * @brief Get a range of the children of a MegaNode
+         *
+         * This returns the same nodes as MegaApi::getChildren for positions offset to
+         * offset + limit - 1, building only those - use it to display large folders
+         * a page at a time. The sorted listings of every folder are kept in memory
+         * until its children change, so getting the next pages is fast.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the listing (see MegaApi::getChildren)
+         * @param offset Position of the first node to return
+         * @param limit Maximum number of nodes to return (0: all the remaining ones)
+         * @return List with the child MegaNode objects in the range
+         */
+        MegaNodeList* getChildren(MegaNode *parent, int order, int offset, int limit);
+
+        /**
+         * @brief Create a cursor to page through the children of a MegaNode
+         *
+         * Use MegaApi::getNextChildren to get the pages.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the listing (see MegaApi::getChildren)
+         * @return Cursor at the beginning of the listing, or NULL if parent is NULL
+         */
+        MegaChildrenCursor* getChildrenCursor(MegaNode *parent, int order = 1);
+
+        /**
+         * @brief Get the next page of a listing and advance the cursor
+         *
+         * If the parent folder doesn't exist anymore, this function returns an empty list
+         * and MegaChildrenCursor::hasMore becomes false.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param cursor Cursor returned by MegaApi::getChildrenCursor
+         * @param limit Maximum number of nodes to return (0: all the remaining ones)
+         * @return List with the next child MegaNode objects
+         */
+        MegaNodeList* getNextChildren(MegaChildrenCursor *cursor, int limit);
+
+        /**
+         * @brief Report node changes by handle instead of MegaListener::onNodesUpdate
+         *
+         * While enabled, the SDK doesn't build a MegaNodeList for every batch of changes.
+         * It records the handles and change flags of the changed nodes instead, merging
+         * repeated changes of the same node, and calls MegaListener::onNodeDeltasAvailable
+         * once the changes have accumulated for coalesceMs milliseconds. The application then
+         * gets them with MegaApi::getNodeDeltas, in its own thread and pace.
+         *
+         * At most maxPending nodes are kept. If more nodes change before the application gets
+         * them, they are dropped and the next list reports MegaNodeDeltaList::isReloadNeeded.
+         *
+         * @param enable True to report node changes this way, false to use MegaListener::onNodesUpdate
+         * @param coalesceMs Time to accumulate changes before notifying them
+         * @param maxPending Maximum number of changed nodes to keep
+         */
+        void enableNodeDeltas(bool enable, int coalesceMs = 200, int maxPending = 100000);
+
+        /**
+         * @brief Get the pending node changes
+         *
+         * Call this function until it returns an empty list after MegaListener::onNodeDeltasAvailable,
+         * which isn't called again until then.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param max Maximum number of changes to return (0: all)
+         * @return List of changed nodes
+         */
+        MegaNodeDeltaList* getNodeDeltas(int max = 0);
+
+        /**
+         * @brief Get the sequence number of the next entry of the node change journal
+         *
+         * The SDK numbers the node changes consecutively and keeps the last 65536 of them
+         * in the local cache, so they survive restarts of the application. An application
+         * that keeps its own index of the nodes saves this number before it indexes the whole
+         * tree, and then applies the changes returned by MegaApi::getNodeChanges instead of
+         * indexing the tree again.
+         *
+         * @return Sequence number of the next change
+         */
+        long long getNodeChangeSequence();
+
+        /**
+         * @brief Get the node changes recorded in the node change journal since a sequence number
+         *
+         * Repeated changes of a node are merged. Continue with MegaNodeDeltaList::getSequence
+         * to get the following changes.
+         *
+         * If the changes since that number are not available anymore (they were more than the
+         * journal keeps, the local cache was discarded or the account was reloaded), the list
+         * is empty and MegaNodeDeltaList::isReloadNeeded returns true. The application
+         * then has to index the whole tree again, continuing with MegaNodeDeltaList::getSequence
+         * afterwards.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param sequence Sequence number returned by MegaApi::getNodeChangeSequence or
+         * MegaNodeDeltaList::getSequence
+         * @param max Maximum number of journal entries to read (0: all)
+         * @return List of changed nodes
+         */
+        MegaNodeDeltaList* getNodeChanges(long long sequence, int max = 0);
+
         /**
          * @brief Get the child node with the provided name
          *
@@ -5368,6 +7534,20 @@ class MegaApi
          */
         MegaNode *getNodeByPath(const char *path, MegaNode *n = NULL);
 
+        /**
+         * @brief Get the handles of the nodes in many paths at once
+         *
+         * The paths are resolved as in MegaApi::getNodeByPath, but the SDK is locked only
+         * once for all of them and no MegaNode objects are created.
+         *
+         * @param paths Paths to check
+         * @param numPaths Number of paths
+         * @param handles Array of numPaths elements that receives the handle of the node in
+         * each path, or INVALID_HANDLE if there isn't any
+         * @param n Base node if the paths are relative
+         */
+        void getNodeHandlesByPath(const char **paths, int numPaths, MegaHandle *handles, MegaNode *n = NULL);
+
         /**
          * @brief Get the MegaNode that has a specific handle
          *
@@ -5784,6 +7964,69 @@ class MegaApi
          */
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
 
+        /**
+         * @brief Search nodes in the background, reporting the results in batches
+         *
+         * Unlike MegaApi::search, this function returns immediately. The SDK checks the nodes
+         * a batch at a time between its other work, and reports the matches found in each batch
+         * with onRequestUpdate, so large result sets are never held in one list.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_SEARCH
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNodeHandle - Returns the handle of the node where the search starts
+         * - MegaRequest::getText - Returns the search string
+         * - MegaRequest::getNumber - Returns the maximum number of results
+         *
+         * Valid data in the MegaRequest object received in onRequestUpdate:
+         * - MegaRequest::getMegaNodeList - Returns the nodes found since the previous update
+         * - MegaRequest::getTransferredBytes - Returns the number of nodes found so far
+         *
+         * The request finishes once all the nodes have been checked or the limit is reached.
+         * If the search is cancelled with MegaApi::cancelSearch, it finishes with the error
+         * code MegaError::API_EINCOMPLETE.
+         *
+         * @param node The parent node of the tree to explore (it's searched recursively)
+         * @param searchString Search string, not case sensitive (NULL or empty: all nodes)
+         * @param filter Additional conditions for the results (NULL: none)
+         * @param limit Maximum number of results (0: no limit)
+         * @param listener MegaRequestListener to track this request
+         */
+        void searchAsync(MegaNode* node, const char* searchString, MegaSearchFilter* filter = NULL, int limit = 0, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Stop a search started with MegaApi::searchAsync
+         *
+         * The results already reported are not affected.
+         *
+         * @param searchTag Tag of the request (MegaRequest::getTag)
+         */
+        void cancelSearch(int searchTag);
+
+        /**
+         * @brief Process a copy of a node tree using a MegaTreeProcessor implementation
+         *
+         * Unlike MegaApi::processMegaTree, the SDK is only blocked while the nodes are copied,
+         * not while they are processed, so the function is suitable for walks of the whole
+         * account. The processor receives the nodes as they were when the function was called.
+         *
+         * If the processor is thread-safe (MegaTreeProcessor::isThreadSafe), the nodes are
+         * processed by up to numThreads threads at once and in no particular order. Otherwise,
+         * they are processed in the same order as by MegaApi::processMegaTree. In both cases,
+         * the node passed in the first parameter is processed the last.
+         *
+         * The MegaNode objects received by the processor are only valid during the callback.
+         *
+         * @param node The parent node of the tree to explore
+         * @param processor MegaTreeProcessor that will receive callbacks for every node in the tree
+         * @param recursive True if you want to recursively process the whole node tree.
+         * False if you want to process the children of the node only
+         * @param numThreads Maximum number of threads to use (up to 16)
+         *
+         * @return True if all nodes were processed. False otherwise (the operation can be
+         * cancelled by MegaTreeProcessor::processMegaNode())
+         */
+        bool processMegaTreeSnapshot(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1, int numThreads = 1);
+
         /**
          * @brief Create a MegaNode that represents a file of a different account
          *
@@ -5970,6 +8213,38 @@ class MegaApi
          */
         static void removeRecursively(const char *path);
 
+        /**
+         * @brief Recursively remove all local files/folders inside a local path in the background
+         *
+         * Unlike MegaApi::removeRecursively, this function returns immediately. The deletion
+         * runs on a worker thread, so large folders don't block the caller or the SDK.
+         * The folder itself is not deleted.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_REMOVE_LOCAL_FOLDER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getFile - Returns the local path of the folder
+         *
+         * Valid data in the MegaRequest object received in onRequestUpdate:
+         * - MegaRequest::getTransferredBytes - Returns the number of files and folders removed so far
+         *
+         * If the deletion is cancelled with MegaApi::cancelRemoveRecursively, the request
+         * finishes with the error code MegaError::API_EINCOMPLETE.
+         *
+         * @param path Local path of a folder to start the recursive deletion
+         * @param listener MegaRequestListener to track this request
+         */
+        void removeRecursivelyAsync(const char *path, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Stop the background deletions of a local path
+         *
+         * The files and folders already removed are not restored.
+         *
+         * @param path Local path passed to MegaApi::removeRecursivelyAsync
+         * @see MegaApi::removeRecursivelyAsync
+         */
+        void cancelRemoveRecursively(const char *path);
+
         /**
          * @brief Check if the connection with MEGA servers is OK
          *
@@ -69,15 +69,19 @@ namespace mega
 #ifdef USE_QT
 typedef QtThread MegaThread;
 typedef QtMutex MegaMutex;
+typedef QtSemaphore MegaSemaphore;
 #elif USE_PTHREAD
 typedef PosixThread MegaThread;
 typedef PosixMutex MegaMutex;
+typedef PosixSemaphore MegaSemaphore;
 #elif defined(_WIN32) && !defined(WINDOWS_PHONE)
 typedef Win32Thread MegaThread;
 typedef Win32Mutex MegaMutex;
+typedef Win32Semaphore MegaSemaphore;
 #else
 typedef CppThread MegaThread;
 typedef CppMutex MegaMutex;
+typedef CppSemaphore MegaSemaphore;
 #endif
 
 #ifdef USE_QT
@@ -96,11 +100,13 @@ class MegaGfxProc : public GfxProcExternal {};
     class MegaFileSystemAccess : public WinFileSystemAccess {};
     class MegaWaiter : public WinWaiter {};
     #else
+    #define MEGA_CURL_HTTPIO 1
     class MegaHttpIO : public CurlHttpIO {};
     class MegaFileSystemAccess : public WinFileSystemAccess {};
     class MegaWaiter : public WinPhoneWaiter {};
     #endif
 #else
+    #define MEGA_CURL_HTTPIO 1
     #ifdef __APPLE__
     typedef CurlHttpIO MegaHttpIO;
     typedef PosixFileSystemAccess MegaFileSystemAccess;
@@ -118,18 +124,145 @@ class MegaDbAccess : public SqliteDbAccess
 		MegaDbAccess(string *basePath = NULL) : SqliteDbAccess(basePath){}
 };
 
+// shared/exclusive lock, recursive in both modes: readers don't block each
+// other, the exclusive owner may also take it shared - waiting writers
+// block new readers (but not nested ones), so the SDK thread isn't starved
+// by a stream of queries
+//
+// upgrading from shared to exclusive works for one thread at a time only
+class MegaSharedMutex
+{
+public:
+    void lock();
+    void unlock();
+
+    void lockShared();
+    void unlockShared();
+
+    MegaSharedMutex();
+
+protected:
+    MegaMutex guard;
+    MegaSemaphore readgate;
+    MegaSemaphore writegate;
+
+    // exclusive owner (0: none) and its recursion depth
+    unsigned long long writer;
+    int writerdepth;
+
+    // shared owners and their recursion depths
+    vector<pair<unsigned long long, int> > readers;
+    int activereaders;
+
+    int waitingreaders;
+    int waitingwriters;
+
+    // depth of the calling thread's shared locks
+    int sharedby(unsigned long long);
+};
+
+class ExternalLogger;
+
+// log messages waiting for the logging thread (MegaApi::setAsyncLogging): a
+// fixed ring of entries whose strings are swapped in and out, so queueing a
+// message copies nothing but the file name and holds the lock briefly
+//
+// the thread runs for the lifetime of the process, like the logger
+class MegaLogQueue
+{
+public:
+    MegaLogQueue(ExternalLogger *output);
+
+    // takes over the message, drops it if the ring is full
+    void push(time_t time, int loglevel, const char *filename, int line, string *message);
+
+    // deliver what is queued from the calling thread
+    void flush();
+
+protected:
+    static const unsigned SIZE = 4096;
+
+    struct Entry
+    {
+        time_t time;
+        int loglevel;
+        int line;
+        string filename;
+        string message;
+    };
+
+    Entry *ring;
+    unsigned head;
+    unsigned count;
+    unsigned dropped;
+    MegaMutex mutex;
+
+    // taken by the thread delivering a batch, which keeps the order
+    MegaMutex delivermutex;
+    Entry *batch;
+    time_t lasttime;
+    string lasttimestr;
+
+    MegaSemaphore queued;
+    MegaThread thread;
+    ExternalLogger *output;
+
+    static void *threadEntryPoint(void *param);
+    void loop();
+
+    // returns false if there was nothing to deliver
+    bool deliver();
+};
+
 class ExternalLogger : public Logger
 {
 public:
     ExternalLogger();
     void setMegaLogger(MegaLogger *logger);
     void setLogLevel(int logLevel);
+    void setAsync(bool enable);
     void postLog(int logLevel, const char *message, const char *filename, int line);
     virtual void log(const char *time, int loglevel, const char *source, const char *message);
+    virtual bool deferring();
+    virtual void logdeferred(time_t time, int loglevel, const char *filename, int line, string *message);
 
 private:
     MegaMutex mutex;
     MegaLogger *megaLogger;
+
+    // created on first use, kept afterwards
+    MegaLogQueue *queue;
+    bool async;
+};
+
+// compact copy of a Node, with its strings in a pool shared with other
+// records (see MegaNodeListPrivate)
+struct MegaNodeRecord
+{
+    int type;
+    int64_t size;
+    int64_t ctime;
+    int64_t mtime;
+    MegaHandle nodehandle;
+    MegaHandle parenthandle;
+    int tag;
+    int changed;
+    bool thumbnailAvailable;
+    bool previewAvailable;
+#ifdef ENABLE_SYNC
+    bool syncdeleted;
+#endif
+
+    // strings in the pool: field i spans offsets[i] to offsets[i + 1]
+    // (the name includes its terminating NUL)
+    enum { NAME, NODEKEY, ATTRSTRING, LOCALPATH, NUMFIELDS };
+    size_t offsets[NUMFIELDS + 1];
+
+    // copy the node, appending its strings to the pool
+    void fill(Node*, string*);
+
+    // MegaNode::CHANGE_TYPE_* flags of the node
+    static int changesof(Node*);
 };
 
 class MegaNodePrivate : public MegaNode
@@ -171,9 +304,20 @@ class MegaNodePrivate : public MegaNode
         virtual MegaNode *copy();
 
     protected:
+        friend class MegaNodeListPrivate;
+        friend class MegaTreeViewProcessor;
+        friend class MegaTreeSnapshot;
+
         MegaNodePrivate(Node *node);
+        MegaNodePrivate(const MegaNodeRecord *record, const string *pool);
+        void init(const MegaNodeRecord *record, const string *pool);
+
+        // turn the object into another node (reusable views)
+        void reset(const MegaNodeRecord *record, const string *pool);
+
         int type;
         const char *name;
+        bool internedName;
         int64_t size;
         int64_t ctime;
         int64_t mtime;
@@ -252,6 +396,11 @@ class MegaTransferPrivate : public MegaTransfer
 		void setParentPath(const char* path);
         void setNodeHandle(MegaHandle nodeHandle);
         void setParentHandle(MegaHandle parentHandle);
+        void setListener(MegaTransferListener *listener);
+
+        // contribution to the transfer statistics (statsTotal < 0: none)
+        long long statsTotal;
+        long long statsTransferred;
 		void setNumConnections(int connections);
 		void setStartPos(long long startPos);
 		void setEndPos(long long endPos);
@@ -268,6 +417,15 @@ class MegaTransferPrivate : public MegaTransfer
         void setSyncTransfer(bool syncTransfer);
         void setLastBytes(char *lastBytes);
         void setLastErrorCode(error errorCode);
+        void setTimings(const ChunkTimingStats *timings);
+
+        // MegaApi::startStreamUpload (not owned)
+        void setInputStream(MegaInputStream *inputStream);
+        MegaInputStream *getInputStream() const;
+
+        // file of a folder download (0: none)
+        void setFolderTransferTag(int tag);
+        virtual int getFolderTransferTag() const;
 
 		virtual int getType() const;
 		virtual const char * getTransferString() const;
@@ -298,6 +456,7 @@ class MegaTransferPrivate : public MegaTransfer
         virtual bool isStreamingTransfer() const;
         virtual char *getLastBytes() const;
         virtual error getLastErrorCode() const;
+        virtual MegaTransferTimings *getTimings() const;
 
 	protected:		
 		int type;
@@ -325,6 +484,88 @@ class MegaTransferPrivate : public MegaTransfer
 		MegaTransferListener *listener;
         Transfer *transfer;
         error lastError;
+        ChunkTimingStats *timings;
+        MegaInputStream *inputStream;
+        int folderTransferTag;
+};
+
+class MegaTransferTimingsPrivate : public MegaTransferTimings
+{
+public:
+    MegaTransferTimingsPrivate(const ChunkTimingStats *stats);
+    virtual ~MegaTransferTimingsPrivate();
+    virtual MegaTransferTimings *copy() const;
+
+    virtual long long getNumChunks() const;
+    virtual long long getBytes() const;
+    virtual long long getPhaseCount(int phase, int bucket) const;
+    virtual long long getPhaseSamples(int phase) const;
+    virtual long long getPhaseTotalTime(int phase) const;
+    virtual long long getPhaseMaxTime(int phase) const;
+    virtual long long getThroughputCount(int bucket) const;
+
+protected:
+    ChunkTimingStats stats;
+};
+
+class MegaEngineMetricsPrivate : public MegaEngineMetrics
+{
+public:
+    MegaEngineMetricsPrivate(const EngineStats *stats, const std::map<string, HttpHostStats> *hoststats, int inflight);
+    virtual MegaEngineMetrics *copy() const;
+
+    virtual long long getCounter(int counter) const;
+    virtual long long getDurationCount(int duration) const;
+    virtual long long getDurationTotal(int duration) const;
+    virtual long long getDurationMax(int duration) const;
+    virtual int getNumHosts() const;
+    virtual const char *getHostName(int i) const;
+    virtual long long getHostRequests(int i) const;
+    virtual long long getHostFailures(int i) const;
+    virtual long long getHostBytesSent(int i) const;
+    virtual long long getHostBytesReceived(int i) const;
+
+protected:
+    const DurationStats *duration(int duration) const;
+
+    EngineStats stats;
+    int inflight;
+    vector<string> hostnames;
+    vector<HttpHostStats> hosts;
+};
+
+class MegaStartupTimelinePrivate : public MegaStartupTimeline
+{
+public:
+    MegaStartupTimelinePrivate(const StartupTrace *trace);
+    virtual MegaStartupTimeline *copy() const;
+
+    virtual bool isComplete() const;
+    virtual long long getPhaseStart(int phase) const;
+    virtual long long getPhaseEnd(int phase) const;
+    virtual long long getPhaseBytes(int phase) const;
+    virtual long long getPhaseItems(int phase) const;
+
+protected:
+    StartupTrace trace;
+};
+
+class MegaTransferBufferPrivate : public MegaTransferBuffer
+{
+public:
+    MegaTransferBufferPrivate(MegaApiImpl *api, string *buffer, size_t size, long long offset);
+    virtual ~MegaTransferBufferPrivate();
+
+    virtual const char *getData() const;
+    virtual size_t getSize() const;
+    virtual long long getOffset() const;
+    virtual void release();
+
+protected:
+    MegaApiImpl *api;
+    string *buffer;
+    size_t size;
+    long long offset;
 };
 
 class MegaContactRequestPrivate : public MegaContactRequest
@@ -412,6 +653,19 @@ public:
     virtual int getState() const;
     void setState(int state);
 
+    virtual int getNotificationQueueDepth() const;
+    virtual int getRetryQueueDepth() const;
+    virtual long long getNumFingerprinted() const;
+    virtual long long getFingerprintRate() const;
+    virtual long long getPendingUploadBytes() const;
+    virtual long long getPendingDownloadBytes() const;
+    virtual long long getSyncDownTime() const;
+    virtual long long getSyncUpTime() const;
+    virtual long long getCacheFlushTime() const;
+    virtual long long getNumNotifications() const;
+    virtual long long getNumSupersededNotifications() const;
+    void setStats(const SyncStats *stats);
+
 protected:
     MegaHandle megaHandle;
     string localFolder;
@@ -419,6 +673,33 @@ protected:
     long long fingerprint;
     MegaSyncListener *listener;
     int state;
+    SyncStats stats;
+};
+
+// exclusion patterns (wildcards * and ?) compiled by kind: exact names and
+// names with a fixed prefix ("abc*") or suffix ("*.tmp") are looked up by
+// length, only the remaining patterns are matched one by one
+//
+// patterns containing a path separator are matched against the full local
+// path of folders, so that excluded subtrees are never scanned
+class ExclusionRules
+{
+public:
+    void set(vector<string> *patterns);
+    void clear();
+
+    bool excludesName(const char *name) const;
+    bool excludesPath(const char *path) const;
+    bool hasPathRules() const;
+
+protected:
+    std::set<string> names;
+    map<size_t, std::set<string> > prefixes;
+    map<size_t, std::set<string> > suffixes;
+    vector<string> wildcards;
+    vector<string> paths;
+
+    static bool lookup(const map<size_t, std::set<string> > *buckets, const char *name, size_t len, bool suffix);
 };
 
 #endif
@@ -492,6 +773,23 @@ class MegaRequestPrivate : public MegaRequest
         virtual MegaPricing *getPricing() const;
 	    AccountDetails * getAccountDetails() const;
 
+        // takes the ownership
+        void setMegaNodeList(MegaNodeList *nodeList);
+        virtual MegaNodeList *getMegaNodeList() const;
+
+        // MegaApi::searchAsync (takes the ownership)
+        void setSearchFilter(MegaSearchFilter *searchFilter);
+        MegaSearchFilter *getSearchFilter() const;
+
+        // bulk node requests: results by position in the node list, and the
+        // positions waiting for a response (answered in the order issued)
+        void setNodeResult(int index, int errorCode, const char *link = NULL);
+        virtual int getNodeErrorCode(int index) const;
+        virtual const char *getNodeLink(int index) const;
+        void addPendingNode(int index);
+        int nextPendingNode();
+        int getNumPendingNodes() const;
+
 #ifdef ENABLE_SYNC
         void setSyncListener(MegaSyncListener *syncListener);
         MegaSyncListener *getSyncListener() const;
@@ -527,6 +825,11 @@ class MegaRequestPrivate : public MegaRequest
         MegaNode* publicNode;
 		int numRetry;
         int tag;
+        MegaNodeList *nodeList;
+        MegaSearchFilter *searchFilter;
+        std::vector<int> nodeErrors;
+        std::vector<std::string> nodeLinks;
+        std::deque<int> pendingNodes;
 };
 
 class MegaAccountBalancePrivate : public MegaAccountBalance
@@ -686,10 +989,51 @@ class MegaNodeListPrivate : public MegaNodeList
 	
 	protected:
         MegaNodeListPrivate(MegaNodeListPrivate *nodeList);
+
+        // lists of nodes copy each node into a compact record (all strings
+        // in one pool) - the MegaNode objects are only built on access
+        vector<MegaNodeRecord> records;
+        string pool;
+
 		MegaNode** list;
 		int s;
 };
 
+class MegaChildrenCursorPrivate : public MegaChildrenCursor
+{
+    public:
+        MegaChildrenCursorPrivate(MegaHandle parenthandle, int order);
+        virtual MegaChildrenCursor *copy();
+        virtual MegaHandle getParentHandle();
+        virtual int getOrder();
+        virtual int getPosition();
+        virtual bool hasMore();
+
+        MegaHandle parenthandle;
+        int order;
+        int position;
+
+        // last node returned (UNDEF: none)
+        MegaHandle last;
+        bool more;
+};
+
+class MegaNodeDeltaListPrivate : public MegaNodeDeltaList
+{
+    public:
+        MegaNodeDeltaListPrivate(bool reload);
+        virtual MegaNodeDeltaList *copy();
+        virtual MegaHandle getHandle(int i);
+        virtual int getChanges(int i);
+        virtual int size();
+        virtual bool isReloadNeeded();
+        virtual long long getSequence();
+
+        vector<pair<MegaHandle, int> > deltas;
+        bool reload;
+        long long sequence;
+};
+
 class MegaUserListPrivate : public MegaUserList
 {
 	public:
@@ -734,6 +1078,61 @@ class MegaTransferListPrivate : public MegaTransferList
 		int s;
 };
 
+class MegaTransferStatsPrivate : public MegaTransferStats
+{
+    public:
+        MegaTransferStatsPrivate();
+        virtual MegaTransferStats *copy();
+        virtual int getNumPending(int direction);
+        virtual int getNumActive(int direction);
+        virtual int getNumCompleted(int direction);
+        virtual int getNumFailed(int direction);
+        virtual long long getPendingBytes(int direction);
+        virtual long long getTransferredBytes(int direction);
+        virtual long long getCompletedBytes(int direction);
+        virtual long long getSpeed(int direction);
+        virtual long long getEta(int direction);
+
+        // by direction (MegaTransfer::TYPE_DOWNLOAD, MegaTransfer::TYPE_UPLOAD)
+        int pending[2];
+        int active[2];
+        int completed[2];
+        int failed[2];
+        long long pendingBytes[2];
+        long long transferredBytes[2];
+        long long completedBytes[2];
+        long long speed[2];
+
+    protected:
+        static bool valid(int direction);
+};
+
+class MegaMemoryUsagePrivate : public MegaMemoryUsage
+{
+    public:
+        MegaMemoryUsagePrivate(MemoryUsage *usage);
+        virtual MegaMemoryUsage *copy();
+        virtual long long getBytes(int subsystem);
+        virtual long long getTotalBytes();
+
+    protected:
+        // by MEMORY_* value
+        long long bytes[MemoryUsage::NUMSUBSYSTEMS];
+};
+
+class MegaTransferBatchPrivate : public MegaTransferBatch
+{
+    public:
+        MegaTransferBatchPrivate();
+        virtual ~MegaTransferBatchPrivate();
+        virtual void addUpload(const char* localPath, MegaNode *parent, const char *fileName, int64_t mtime);
+        virtual void addDownload(MegaNode *node, const char* localPath);
+        virtual int size();
+
+        // transfers without listener, handed over by MegaApi::startTransfers
+        vector<MegaTransferPrivate *> transfers;
+};
+
 class MegaContactRequestListPrivate : public MegaContactRequestList
 {
     public:
@@ -768,7 +1167,10 @@ struct MegaFileGet : public MegaFile
     void terminated();
 	MegaFileGet(MegaClient *client, Node* n, string dstPath);
     MegaFileGet(MegaClient *client, MegaNode* n, string dstPath);
-	~MegaFileGet() {}
+    ~MegaFileGet();
+
+protected:
+    MegaClient *client;
 };
 
 struct MegaFilePut : public MegaFile
@@ -776,7 +1178,9 @@ struct MegaFilePut : public MegaFile
     void completed(Transfer* t, LocalNode*);
     void terminated();
     MegaFilePut(MegaClient *client, string* clocalname, string *filename, handle ch, const char* ctargetuser, int64_t mtime = -1);
-    ~MegaFilePut() {}
+
+    // (the adapter of the stream of MegaApi::startStreamUpload is owned)
+    ~MegaFilePut() { delete stream; }
 
 protected:
     int64_t customMtime;
@@ -830,6 +1234,51 @@ class PendingOutShareProcessor : public TreeProcessor
         vector<handle> handles;
 };
 
+// passes the nodes to a MegaTreeProcessor through one reused view instead
+// of allocating a MegaNode for each of them
+class MegaTreeViewProcessor : public TreeProcessor
+{
+    public:
+        MegaTreeViewProcessor(MegaTreeProcessor *processor);
+        virtual bool processNode(Node* node);
+        virtual ~MegaTreeViewProcessor();
+
+    protected:
+        MegaTreeProcessor *processor;
+        MegaNodeRecord record;
+        string pool;
+        MegaNodePrivate *view;
+};
+
+// copy of a node tree (MegaApi::processMegaTreeSnapshot), processed without
+// the SDK lock - by several threads if the processor is thread-safe
+class MegaTreeSnapshot : public TreeProcessor
+{
+    public:
+        MegaTreeSnapshot(MegaTreeProcessor *processor);
+
+        // add node to the copy
+        virtual bool processNode(Node* node);
+        virtual ~MegaTreeSnapshot() {}
+
+        // false if the processor stopped the processing
+        bool process(int numthreads);
+
+    protected:
+        MegaTreeProcessor *processor;
+        vector<MegaNodeRecord> records;
+        string pool;
+
+        // next record to hand out, in chunks
+        static const size_t CHUNK = 256;
+        MegaMutex mutex;
+        size_t next;
+        bool stopped;
+
+        void run();
+        static void *threadEntryPoint(void *param);
+};
+
 class SizeProcessor : public TreeProcessor
 {
     protected:
@@ -845,12 +1294,18 @@ class SizeProcessor : public TreeProcessor
 class RequestQueue
 {
     protected:
+        // filled by the app threads and taken in one go by the SDK thread,
+        // which pops from its batch without contending with them
         std::deque<MegaRequestPrivate *> requests;
+        std::deque<MegaRequestPrivate *> batch;
         MegaMutex mutex;
+        MegaMutex batchmutex;
 
     public:
         RequestQueue();
-        void push(MegaRequestPrivate *request);
+
+        // returns true if the queue was empty (the SDK thread has to be woken up)
+        bool push(MegaRequestPrivate *request);
         void push_front(MegaRequestPrivate *request);
         MegaRequestPrivate * pop();
         void removeListener(MegaRequestListener *listener);
@@ -864,16 +1319,569 @@ class RequestQueue
 class TransferQueue
 {
     protected:
+        // filled by the app threads and taken in one go by the SDK thread,
+        // which pops from its batch without contending with them
         std::deque<MegaTransferPrivate *> transfers;
+        std::deque<MegaTransferPrivate *> batch;
         MegaMutex mutex;
+        MegaMutex batchmutex;
 
     public:
         TransferQueue();
-        void push(MegaTransferPrivate *transfer);
+
+        // returns true if the queue was empty (the SDK thread has to be woken up)
+        bool push(MegaTransferPrivate *transfer);
+        bool push(vector<MegaTransferPrivate *> *transfers);
         void push_front(MegaTransferPrivate *transfer);
         MegaTransferPrivate * pop();
 };
 
+//Worker threads for CPU/disk-bound transfer work (MegaClient::workerpool)
+class MegaWorkerPool;
+
+// worker threads running the jobs of one or more MegaWorkerPools
+class MegaWorkerQueue
+{
+    public:
+        MegaWorkerQueue(int numthreads);
+        ~MegaWorkerQueue();
+
+        void push(WorkerJob *job, MegaWorkerPool *pool);
+
+        // drop the job if it hasn't started yet
+        bool withdraw(WorkerJob *job);
+
+    protected:
+        static void *threadEntryPoint(void *param);
+        void loop();
+
+        MegaThread *threads;
+        int numthreads;
+        MegaMutex mutex;
+        MegaSemaphore queued;
+        std::deque<std::pair<WorkerJob *, MegaWorkerPool *> > jobs;
+        bool exiting;
+};
+
+// the jobs of one MegaClient, run on a queue of its own or on a queue shared
+// with other instances (MegaApi::setSharedRuntime) - all of them must have
+// finished (waitfor()) when the pool is deleted
+class MegaWorkerPool : public WorkerPool
+{
+    public:
+        MegaWorkerPool(MegaWaiter *waiter, int numthreads = NUMTHREADS);
+        MegaWorkerPool(MegaWaiter *waiter, MegaWorkerQueue *queue);
+        virtual ~MegaWorkerPool();
+
+        virtual void push(WorkerJob *job);
+        virtual bool isdone(WorkerJob *job);
+        virtual void waitfor(WorkerJob *job);
+        virtual Mutex *newmutex();
+
+        // called by the queue once the job has run
+        void finish(WorkerJob *job);
+
+        static const int NUMTHREADS = 3;
+
+        // thumbnail/preview generation (the GfxProc decodes one bitmap at a time)
+        static const int GFXTHREADS = 1;
+
+    protected:
+        MegaWaiter *waiter;
+        MegaWorkerQueue *queue;
+        bool ownqueue;
+        MegaMutex mutex;
+        MegaSemaphore finished;
+        std::set<WorkerJob *> done;
+};
+
+// engine resources shared by the MegaApi instances of the process
+// (MegaApi::setSharedRuntime): the worker threads, the thumbnail/preview
+// threads and the DNS and TLS session caches - created by the first instance
+// that uses them and released by the last one
+class MegaSharedRuntime
+{
+    public:
+        static void setEnabled(bool enable);
+
+        // NULL if disabled - each acquire() must be paired with a release()
+        static MegaSharedRuntime *acquire();
+        void release();
+
+        MegaWorkerQueue *workers;
+        MegaWorkerQueue *gfxWorkers;
+
+#ifdef MEGA_CURL_HTTPIO
+        CURLSH *curlsh;
+#endif
+
+        // sized for many instances, most of them idle
+        static const int NUMTHREADS = 8;
+        static const int GFXTHREADS = 2;
+
+    protected:
+        MegaSharedRuntime();
+        ~MegaSharedRuntime();
+
+        int users;
+
+#ifdef MEGA_CURL_HTTPIO
+        MegaMutex curllocks[CURL_LOCK_DATA_LAST];
+        Mutex *curllockptrs[CURL_LOCK_DATA_LAST];
+#endif
+
+        static bool enabled;
+        static MegaSharedRuntime *instance;
+};
+
+// names of the MegaNodePrivate objects, which any thread can create and
+// delete - interned in a process-wide pool if enabled
+// (MegaApi::enableNameInterning), so that listings of large or duplicated
+// trees and their copies share one buffer per distinct name
+class MegaNodeNames
+{
+    public:
+        static void setEnabled(bool enable);
+
+        // copy of a name (NULL for NULL), *interned tells how to free it
+        static const char *copy(const char *name, bool *interned);
+        static void free(const char *name, bool interned);
+
+    protected:
+        static bool enabled;
+};
+
+// delivers listener callbacks on its own threads (MegaApi::setCallbackThreads)
+// so that slow listeners don't hold up the SDK thread - events are queued
+// with copies of their objects, and each listener is always served by the
+// same thread, so it gets its callbacks in order
+class MegaCallbackDispatcher
+{
+    public:
+        enum
+        {
+            REQUEST_START, REQUEST_FINISH, REQUEST_UPDATE, REQUEST_TEMPORARY_ERROR,
+            TRANSFER_START, TRANSFER_FINISH, TRANSFER_UPDATE, TRANSFER_TEMPORARY_ERROR,
+            USERS_UPDATE, NODES_UPDATE, NODE_DELTAS_AVAILABLE, ACCOUNT_UPDATE,
+            CONTACT_REQUESTS_UPDATE, RELOAD_NEEDED,
+            SYNC_STATE_CHANGED, SYNC_STATS_UPDATED, SYNC_EVENT, GLOBAL_SYNC_STATE_CHANGED,
+            SYNC_FILE_STATE_CHANGED, ENGINE_METRICS
+        };
+
+        // listener classes
+        enum { LISTENER, REQUEST_LISTENER, TRANSFER_LISTENER, GLOBAL_LISTENER, SYNC_LISTENER };
+
+        // arguments of an event, shared by all the listeners it is queued for
+        // (created with one reference, dropped with release())
+        struct Payload
+        {
+            int refs;
+            MegaRequest *request;
+            MegaTransfer *transfer;
+            MegaError *error;
+            MegaUserList *users;
+            MegaNodeList *nodes;
+            MegaContactRequestList *contactRequests;
+            MegaEngineMetrics *metrics;
+#ifdef ENABLE_SYNC
+            MegaSync *sync;
+            MegaSyncEvent *syncEvent;
+#endif
+            string path;
+            int state;
+
+            Payload();
+            ~Payload();
+        };
+
+        void post(int type, int kind, void *listener, Payload *payload);
+        void release(Payload *payload);
+
+        // drop the events queued for the listener and wait for its callback
+        // in progress, unless called from that callback
+        void removeListener(void *listener);
+
+        MegaCallbackDispatcher(MegaApi *api, int numthreads);
+
+        // delivers the events still queued
+        ~MegaCallbackDispatcher();
+
+        static const int MAXTHREADS = 8;
+
+    protected:
+        struct Event
+        {
+            int type;
+            int kind;
+            void *listener;
+            Payload *payload;
+        };
+
+        struct Queue
+        {
+            MegaCallbackDispatcher *dispatcher;
+            MegaThread thread;
+            unsigned long long threadid;
+            MegaSemaphore queued;
+            std::deque<Event> events;
+
+            // listener of the callback in progress (NULL: none)
+            void *current;
+        };
+
+        static void *threadEntryPoint(void *param);
+        void loop(Queue *queue);
+        void deliver(Event *event);
+
+        MegaApi *api;
+        MegaMutex mutex;
+
+        // removeListener() calls waiting for a callback to return
+        MegaSemaphore idle;
+        int idlewaiters;
+
+        Queue *queues;
+        int numqueues;
+        bool exiting;
+};
+
+// fingerprint a file queued for upload on a worker thread, so that uploads
+// of content already in the account can become server-side copies
+class MegaUploadFingerprintJob : public WorkerJob
+{
+    public:
+        MegaUploadFingerprintJob(MegaTransferPrivate *transfer, FileAccess *fa, string *localname);
+        virtual ~MegaUploadFingerprintJob();
+
+        virtual void run();
+
+        MegaTransferPrivate *transfer;
+        FileAccess *fa;
+        string localname;
+        FileFingerprint fingerprint;
+};
+
+// recursive deletion of the contents of a local folder on a worker thread
+// (MegaApi::removeRecursivelyAsync)
+class MegaRemoveRecursivelyJob : public WorkerJob
+{
+    public:
+        MegaRemoveRecursivelyJob(MegaRequestPrivate *request);
+
+        virtual void run();
+
+        MegaRequestPrivate *request;
+
+        // path in the format of the platform's emptydirlocal()
+        string localPath;
+
+        LocalRemoval progress;
+        m_off_t reported;
+};
+
+// recursive download of a folder (MegaApi::startDownload with a folder node):
+// the SDK thread copies the subtree, the local folders are created on a
+// worker thread and the files are then downloaded by regular transfers,
+// whose progress is aggregated into the folder transfer
+class MegaFolderDownload : public WorkerJob
+{
+    public:
+        MegaFolderDownload(MegaTransferPrivate *transfer);
+
+        // add the subtree of node, to be stored at path (without trailing
+        // separator) - false if the children of a folder haven't been fetched
+        bool snapshot(MegaClient *client, Node *node, string *path);
+
+        // create the local folders
+        virtual void run();
+
+        // new sub-transfers, keeping at most MAXACTIVE of them queued or in
+        // progress
+        void feed(int maxRetries, vector<MegaTransferPrivate *> *transfers);
+
+        // account the progress of a sub-transfer
+        void update(MegaTransferPrivate *subtransfer);
+
+        // account a finished sub-transfer, true if it was the last one
+        bool finish(MegaTransferPrivate *subtransfer, error e);
+
+        MegaTransferPrivate *transfer;
+
+        struct FolderFile
+        {
+            handle h;
+            m_off_t size;
+
+            // index in paths
+            unsigned folder;
+
+            static bool larger(const FolderFile &a, const FolderFile &b) { return a.size > b.size; }
+        };
+
+        // local folders in the platform's encoding (parents first) and the
+        // same paths in UTF-8 with a trailing separator
+        vector<string> folders;
+        vector<string> paths;
+
+        // files in download order, the first nextfile have been started
+        vector<FolderFile> files;
+        size_t nextfile;
+        m_off_t totalbytes;
+
+        struct Active
+        {
+            long long bytes;
+            long long size;
+        };
+        map<MegaTransferPrivate *, Active> active;
+        long long activebytes;
+        long long donebytes;
+
+        // first error of the sub-transfers
+        error lasterror;
+
+        // result of run()
+        error e;
+
+        bool started;
+        bool cancelled;
+
+        static const unsigned MAXACTIVE = 64;
+};
+
+// password key derivation on a worker thread (login, password change and
+// MegaApi::getBase64PwKey with a listener) - the request is looked up by tag
+// once the keys are ready, as it may have been finished in the meantime
+class MegaPwKeyJob : public WorkerJob
+{
+    public:
+        MegaPwKeyJob(int tag, const char *password, const char *newPassword = NULL);
+
+        virtual void run();
+
+        int tag;
+
+        // the new password, if any, is derived into pwkey[1]
+        string password[2];
+        unsigned count;
+
+        byte pwkey[2][SymmCipher::KEYLENGTH];
+        error e;
+
+        // trimmed login email
+        string email;
+};
+
+// bounded LRU cache of resolved paths (MegaApi::getNodeByPath) - keys are
+// the handle of the node where the resolution starts followed by the path
+// components, so that the prefixes of a path can be looked up too
+//
+// cleared whenever nodes are renamed, moved or removed
+class MegaPathCache
+{
+    public:
+        MegaPathCache();
+
+        // UNDEF: not cached
+        handle get(const string *key);
+        void put(const string *key, handle h);
+        void clear();
+
+        static const size_t MAXENTRIES = 10000;
+
+    protected:
+        typedef std::list<pair<string, handle> > entry_list;
+        entry_list entries;
+        map<string, entry_list::iterator> index;
+        MegaMutex mutex;
+};
+
+// MegaApi::searchAsync in progress: the SDK thread checks the candidates
+// in batches between client->exec() calls (by handle, as nodes can go away
+// in the meantime)
+class MegaSearchJob : public TreeProcessor
+{
+    public:
+        MegaSearchJob(MegaRequestPrivate *request);
+
+        // collects the candidates of a search without search string
+        virtual bool processNode(Node* node);
+        virtual ~MegaSearchJob() {}
+
+        bool matches(Node *node) const;
+
+        MegaRequestPrivate *request;
+        MegaSearchFilter *filter;
+        size_t limit;
+
+        vector<handle> candidates;
+        size_t next;
+        size_t found;
+        bool cancelled;
+
+        // candidates checked per update
+        static const size_t BATCH = 1000;
+};
+
+#ifndef WINDOWS_PHONE
+#ifdef _WIN32
+typedef SOCKET MegaSocket;
+#else
+typedef int MegaSocket;
+#endif
+
+class MegaHTTPServer;
+
+// client connection of the local HTTP server (MegaApi::httpServerStart):
+// requests are served one after another (keep-alive) on the connection's own
+// thread, which sends the node data the SDK thread delivers for the
+// streaming transfer of the current window
+class MegaHTTPConnection : public MegaTransferListener
+{
+    public:
+        MegaHTTPConnection(MegaHTTPServer *server, MegaSocket fd);
+        virtual ~MegaHTTPConnection();
+
+        void start();
+
+        // abort the request in progress and drop the connection (the thread
+        // ends soon after)
+        void close();
+
+        // the thread has ended and can be joined
+        volatile bool finished;
+
+        MegaThread thread;
+
+        virtual void onTransferStart(MegaApi *api, MegaTransfer *transfer);
+        virtual bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size);
+        virtual void onTransferFinish(MegaApi* api, MegaTransfer *transfer, MegaError* e);
+
+    protected:
+        MegaHTTPServer *server;
+        MegaSocket fd;
+        volatile bool closing;
+
+        // received bytes not processed yet
+        string input;
+
+        // state of the window being streamed, shared with the SDK thread
+        MegaMutex mutex;
+        string data;
+        int transfertag;
+        MegaTransfer *paused;
+        bool windowactive;
+        bool windowfailed;
+        bool cancelled;
+
+        static void *threadEntryPoint(void *param);
+        void loop();
+
+        // receive into input, waiting up to ms milliseconds - false if the
+        // connection was closed
+        bool receive(int ms);
+
+        // read the next request header, false if the connection was closed
+        // or stayed idle for too long
+        bool readrequest(string *header);
+
+        // serve a request, false if the connection has to be closed
+        bool serve(const string *header);
+
+        // peer cache: send the encrypted bytes of a chunk request
+        // (/<base64 handle>/<start>-<end>)
+        bool servechunk(const string *target, bool keepalive);
+
+        bool sendall(const char *buf, size_t len);
+
+        // send the status line and headers (with the Connection header of
+        // keepalive), false if sending failed
+        bool respond(int status, const char *reason, const string *headers, bool keepalive);
+
+        // send bytes [start, end] of the node, window by window
+        bool stream(MegaNode *node, m_off_t start, m_off_t end);
+
+        // cancel the transfer of the current window and wait for its end
+        void abortwindow();
+};
+
+// embedded HTTP server for media players: GET and HEAD of
+// http://127.0.0.1:<port>/<base64 handle>/<name> serve the content of the
+// node, with Range requests, concurrent connections and keep-alive
+//
+// the data is read through startStreaming() in windows of WINDOWSIZE bytes,
+// so that the streaming cache reads the next window ahead while one is sent,
+// and a client dropping the connection (seeking) cancels the read at once
+//
+// in peer mode (MegaApi::peerCacheStart), the server answers the UDP
+// broadcast queries of other clients for nodes it holds a synced copy of, and
+// serves their encrypted chunks in the format of the storage servers
+class MegaHTTPServer
+{
+    public:
+        MegaHTTPServer(MegaApiImpl *api, bool peer = false);
+
+        // stops the server
+        ~MegaHTTPServer();
+
+        bool start(int port, bool localOnly);
+
+        // must not be called from the SDK thread or under the SDK lock
+        void stop();
+
+        int getPort();
+        bool isLocalOnly();
+
+        // URL of the node's content (the name is added for the players'
+        // benefit only)
+        char *getLink(MegaNode *node);
+
+        // ask the local network for peers holding the node (peer mode)
+        void query(MegaHandle h);
+
+        MegaApiImpl *api;
+        volatile bool stopping;
+        bool peer;
+
+        static const m_off_t WINDOWSIZE = 4 << 20;
+
+        // a window's transfer is paused while this much data waits to be sent
+        static const size_t MAXBUFFERED = 2 << 20;
+
+        // seconds an idle keep-alive connection is kept open
+        static const int IDLETIMEOUT = 60;
+
+        // largest chunk request served to peers
+        static const unsigned MAXPEERCHUNK = 16 << 20;
+
+        // concurrent connections (one thread each) - further ones are
+        // refused with 503
+        static const size_t MAXCONNECTIONS = 32;
+
+    protected:
+        MegaSocket listenfd;
+
+        // peer mode: discovery socket, random tag of this client's queries
+        MegaSocket udpfd;
+        unsigned nonce;
+        int port;
+        bool localOnly;
+
+        MegaThread thread;
+        MegaMutex mutex;
+        list<MegaHTTPConnection *> connections;
+
+        static void *threadEntryPoint(void *param);
+        void loop();
+
+        // join and delete the connections whose thread has ended
+        void reap();
+
+        // process a datagram received on udpfd
+        void discovery();
+};
+#endif
+
 class MegaApiImpl : public MegaApp
 {
     public:
@@ -904,6 +1912,7 @@ class MegaApiImpl : public MegaApp
 
         //Utils
         char *getBase64PwKey(const char *password);
+        void getBase64PwKey(const char *password, MegaRequestListener *listener);
         char *getStringHash(const char* base64pwkey, const char* inBuf);
         void getSessionTransferURL(const char *path, MegaRequestListener *listener);
         static MegaHandle base32ToHandle(const char* base32Handle);
@@ -932,11 +1941,25 @@ class MegaApiImpl : public MegaApp
         void fastConfirmAccount(const char* link, const char *base64pwkey, MegaRequestListener *listener = NULL);
         void setProxySettings(MegaProxy *proxySettings);
         MegaProxy *getAutoProxySettings();
+        bool setHttpMultiplexing(bool enable);
+        void setNetworkThread(bool enable);
+        void enableTlsSessionCache(bool enable);
+        void enablePersistentTransferQueue(bool enable);
+        void setApiRequestCompression(unsigned int threshold);
+        void enableLazyNodeAttributes(bool enable);
+#ifdef ENABLE_SYNC
+        void setSyncScanParallelism(unsigned int folders);
+        void setSyncVerificationInterval(unsigned int seconds);
+        void setSyncSkipUnchangedFolders(bool enable);
+#endif
         int isLoggedIn();
         char* getMyEmail();
         char* getMyUserHandle();
         static void setLogLevel(int logLevel);
+        static void setSharedRuntime(bool enable);
+        static void enableNameInterning(bool enable);
         static void setLoggerClass(MegaLogger *megaLogger);
+        static void setAsyncLogging(bool enable);
         static void log(int logLevel, const char* message, const char *filename = NULL, int line = -1);
 
         void createFolder(const char* name, MegaNode *parent, MegaRequestListener *listener = NULL);
@@ -951,12 +1974,15 @@ class MegaApiImpl : public MegaApp
         void share(MegaNode *node, MegaUser* user, int level, MegaRequestListener *listener = NULL);
         void share(MegaNode* node, const char* email, int level, MegaRequestListener *listener = NULL);
         void loginToFolder(const char* megaFolderLink, MegaRequestListener *listener = NULL);
+        void setPartialFolderFetch(bool enable);
         void importFileLink(const char* megaFileLink, MegaNode* parent, MegaRequestListener *listener = NULL);
         void getPublicNode(const char* megaFileLink, MegaRequestListener *listener = NULL);
         void getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
+        void prefetchThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener = NULL);
         void setThumbnail(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
+        void prefetchPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
         void setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void getUserAvatar(MegaUser* user, const char *dstFilePath, MegaRequestListener *listener = NULL);
@@ -965,7 +1991,10 @@ class MegaApiImpl : public MegaApp
         void setUserAttribute(int type, const char* value, MegaRequestListener *listener = NULL);
         void exportNode(MegaNode *node, MegaRequestListener *listener = NULL);
         void disableExport(MegaNode *node, MegaRequestListener *listener = NULL);
+        void exportNodes(MegaNodeList *nodes, MegaRequestListener *listener = NULL);
+        void setNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
         void fetchNodes(MegaRequestListener *listener = NULL);
+        void fetchFolder(MegaNode *node, bool recursive, MegaRequestListener *listener = NULL);
         void getPricing(MegaRequestListener *listener = NULL);
         void getPaymentId(handle productHandle, MegaRequestListener *listener = NULL);
         void upgradeAccount(MegaHandle productHandle, int paymentMethod, MegaRequestListener *listener = NULL);
@@ -1000,8 +2029,12 @@ class MegaApiImpl : public MegaApp
         void startUpload(const char* localPath, MegaNode *parent, int64_t mtime, MegaTransferListener *listener=NULL);
         void startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener = NULL);
         void startUpload(const char* localPath, MegaNode* parent, const char* fileName,  int64_t mtime, MegaTransferListener *listener = NULL);
+        void startStreamUpload(MegaInputStream *inputStream, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener = NULL);
         void startDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
         void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener);
+        void startTransfers(MegaTransferBatch *batch, MegaTransferListener *listener = NULL);
+        static MegaTransferPrivate *newUploadTransfer(const char* localPath, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener);
+        static MegaTransferPrivate *newDownloadTransfer(MegaNode *node, const char* localPath, long startPos, long endPos, MegaTransferListener *listener);
         void startPublicDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
         void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener=NULL);
         void cancelTransferByTag(int transferTag, MegaRequestListener *listener = NULL);
@@ -1013,9 +2046,56 @@ class MegaApiImpl : public MegaApp
         void setUploadMethod(int method);
         int getDownloadMethod();
         int getUploadMethod();
+        void setConnectionLimits(int direction, int minConnections, int maxConnections);
+        void setMaxRequestSize(int direction, long long maxSize);
+        void setTransferBufferPoolLimit(long long limit);
+        void setInflightMemoryBudget(long long bytes);
+        void setNetworkInterfaces(const char *interfaces);
+        void setThumbnailCacheLimit(long long limit);
+        void setThumbnailMemoryCacheLimit(long long limit);
+        void setThumbnailPrefetch(int budget);
+        void setImageDecodeLimit(long long limit);
+        void setDownloadWriteMode(bool preallocate, bool directIO);
+        void enableUploadCopies(bool enable);
+        void setBandwidthLimit(int direction, long long bytesPerSecond, long long burstBytes);
+        void setTransferBandwidthLimit(int direction, long long bytesPerSecond);
+        void setStreamingBandwidth(long long bytesPerSecond);
+        void addBandwidthSchedule(int direction, int weekdays, int startMinute, int endMinute, long long bytesPerSecond);
+        void clearBandwidthSchedule(int direction);
+        void setStreamingCache(long long cacheSize, long long readAhead);
+        bool pauseStreaming(MegaTransfer *transfer, bool pause);
+        bool httpServerStart(bool localOnly, int port);
+        void httpServerStop();
+        int httpServerIsRunning();
+        char *httpServerGetLocalLink(MegaNode *node);
+
+        bool peerCacheStart(int port);
+        void peerCacheStop();
+        int peerCacheIsRunning();
+
+        // for the peer cache threads (take the SDK lock): open the synced
+        // copy of a file node and get its key (NULL if there is no up-to-date
+        // copy), record a peer holding a node
+        FileAccess *openPeerSource(MegaHandle h, string *nodekey);
+        void setPeerUrl(MegaHandle h, const char *url);
+        void setTransferPolicy(int policy);
+        bool setTransferPriority(int transferTag, int priority);
+        void setLargeTransferSlots(int direction, int slots, long long minSize);
+        int getTransferQueueDepth(int direction);
+        int getTransferSlotUtilization();
+        MegaTransferTimings *getTransferTimings(int direction);
+        void resetTransferTimings(int direction);
+        MegaEngineMetrics *getEngineMetrics();
+        void resetEngineMetrics();
+        void setEngineMetricsInterval(int seconds);
+        MegaStartupTimeline *getStartupTimeline();
+        void releaseTransferBuffer(string *buffer);
         MegaTransferList *getTransfers();
         MegaTransfer* getTransferByTag(int transferTag);
         MegaTransferList *getTransfers(int type);
+        MegaTransferList *getTransfers(int type, int fromTag, int limit);
+        MegaTransferStats *getTransferStats();
+        MegaMemoryUsage *getMemoryUsage();
 
 #ifdef ENABLE_SYNC
         //Sync
@@ -1026,6 +2106,7 @@ class MegaApiImpl : public MegaApp
         void removeSync(handle nodehandle, MegaRequestListener *listener=NULL);
         void disableSync(handle nodehandle, MegaRequestListener *listener=NULL);
         int getNumActiveSyncs();
+        long long getSyncMemoryUsage();
         void stopSyncs(MegaRequestListener *listener=NULL);
         bool isSynced(MegaNode *n);
         void setExcludedNames(vector<string> *excludedNames);
@@ -1057,10 +2138,19 @@ class MegaApiImpl : public MegaApp
 		int getNumChildFolders(MegaNode* parent);
         MegaNodeList* getChildren(MegaNode *parent, int order=1);
         int getIndex(MegaNode* node, int order=1);
+        MegaNodeList* getChildren(MegaNode *parent, int order, int offset, int limit);
+        MegaChildrenCursor* getChildrenCursor(MegaNode *parent, int order=1);
+        MegaNodeList* getNextChildren(MegaChildrenCursor *cursor, int limit);
+        void enableNodeDeltas(bool enable, int coalesceMs, int maxPending);
+        void setCallbackThreads(int numThreads);
+        MegaNodeDeltaList* getNodeDeltas(int max);
+        long long getNodeChangeSequence();
+        MegaNodeDeltaList* getNodeChanges(long long sequence, int max);
         MegaNode *getChildNode(MegaNode *parent, const char* name);
         MegaNode *getParentNode(MegaNode *node);
         char *getNodePath(MegaNode *node);
         MegaNode *getNodeByPath(const char *path, MegaNode *n = NULL);
+        void getNodeHandlesByPath(const char **paths, int numPaths, MegaHandle *handles, MegaNode *n = NULL);
         MegaNode *getNodeByHandle(handle handler);
         MegaContactRequest *getContactRequestByHandle(MegaHandle handle);
         MegaUserList* getContacts();
@@ -1081,6 +2171,8 @@ class MegaApiImpl : public MegaApp
         int getAccess(MegaNode* node);
         long long getSize(MegaNode *node);
         static void removeRecursively(const char *path);
+        void removeRecursivelyAsync(const char *path, MegaRequestListener *listener = NULL);
+        void cancelRemoveRecursively(const char *path);
 
         //Fingerprint
         char *getFingerprint(const char *filePath);
@@ -1104,6 +2196,10 @@ class MegaApiImpl : public MegaApp
         MegaNode *getRubbishNode();
         MegaNodeList* search(MegaNode* node, const char* searchString, bool recursive = 1);
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
+        void searchAsync(MegaNode* node, const char* searchString, MegaSearchFilter* filter, int limit, MegaRequestListener *listener = NULL);
+        void cancelSearch(int searchTag);
+        bool processMegaTreeSnapshot(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1, int numThreads = 1);
+        static const int MAX_TREE_THREADS = 16;
 
         MegaNode *createPublicFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime, MegaHandle parentHandle, const char *auth);
         MegaNode *createPublicFolderNode(MegaHandle handle, const char *name, MegaHandle parentHandle, const char *auth);
@@ -1127,6 +2223,10 @@ class MegaApiImpl : public MegaApp
         static bool nodeComparatorAlphabeticalDESC  (Node *i, Node *j);
         static bool userComparatorDefaultASC (User *i, User *j);
 
+        // node comparator for a MegaApi::ORDER_* value (NULL: unsorted)
+        typedef bool (*NodeComparator)(Node*, Node*);
+        static NodeComparator getNodeComparator(int order);
+
         char* escapeFsIncompatible(const char *filename);
         char* unescapeFsIncompatible(const char* name);
 
@@ -1150,17 +2250,20 @@ protected:
         void fireOnTransferStart(MegaTransferPrivate *transfer);
         void fireOnTransferFinish(MegaTransferPrivate *transfer, MegaError e);
         void fireOnTransferUpdate(MegaTransferPrivate *transfer);
-        bool fireOnTransferData(MegaTransferPrivate *transfer);
+        bool fireOnTransferData(MegaTransferPrivate *transfer, MegaTransferBuffer *buffer);
         void fireOnTransferTemporaryError(MegaTransferPrivate *transfer, MegaError e);
         void fireOnUsersUpdate(MegaUserList *users);
         void fireOnNodesUpdate(MegaNodeList *nodes);
+        void fireOnNodeDeltasAvailable();
         void fireOnAccountUpdate();
+        void fireOnEngineMetrics(MegaEngineMetrics *metrics);
         void fireOnContactRequestsUpdate(MegaContactRequestList *requests);
         void fireOnReloadNeeded();
 
 #ifdef ENABLE_SYNC
         void fireOnGlobalSyncStateChanged();
         void fireOnSyncStateChanged(MegaSyncPrivate *sync);
+        void fireOnSyncStatsUpdated(MegaSyncPrivate *sync);
         void fireOnSyncEvent(MegaSyncPrivate *sync, MegaSyncEvent *event);
         void fireOnFileSyncStateChanged(MegaSyncPrivate *sync, const char *filePath, int newState);
 #endif
@@ -1169,7 +2272,38 @@ protected:
         MegaThread thread;
         MegaClient *client;
         MegaHttpIO *httpio;
+
+        // dedicated network I/O thread (see setNetworkThread()), started and
+        // stopped by the SDK thread (-1: no change requested)
+        MegaThread networkThread;
+        MegaMutex networkMutex;
+        int networkThreadRequest;
+        bool networkThreadRunning;
+        void applyNetworkThread();
+
+        // thumbnails to prefetch, queued by listings (see setThumbnailPrefetch())
+        // and handed to the client by the SDK thread
+        MegaMutex prefetchMutex;
+        int thumbnailPrefetchBudget;
+        handle_vector thumbnailPrefetches;
+        void queueThumbnailPrefetch(MegaNodeList *children);
+
+#ifndef WINDOWS_PHONE
+        // local HTTP server (MegaApi::httpServerStart), not guarded by
+        // sdkMutex as stopping it waits for transfers to end
+        MegaMutex httpServerMutex;
+        MegaHTTPServer *httpServer;
+
+        // LAN peer cache (MegaApi::peerCacheStart), under httpServerMutex
+        MegaHTTPServer *peerCache;
+#endif
+
         MegaWaiter *waiter;
+        MegaWorkerPool *workerPool;
+        MegaWorkerPool *gfxWorkerPool;
+
+        // NULL: this instance has its own threads and caches
+        MegaSharedRuntime *sharedRuntime;
         MegaFileSystemAccess *fsAccess;
         MegaDbAccess *dbAccess;
         GfxProc *gfxAccess;
@@ -1179,6 +2313,25 @@ protected:
         map<int, MegaRequestPrivate *> requestMap;
         map<int, MegaTransferPrivate *> transferMap;
 
+        // uploads waiting for their fingerprint, and server-side copies of
+        // existing nodes in flight (by putnodes tag)
+        bool uploadCopies;
+        std::list<MegaUploadFingerprintJob *> fingerprintJobs;
+
+        // local folders being emptied by the worker pool
+        std::list<MegaRemoveRecursivelyJob *> removeJobs;
+
+        // password keys being derived by the worker pool
+        std::list<MegaPwKeyJob *> pwKeyJobs;
+
+        // searches in progress (MegaApi::searchAsync)
+        std::list<MegaSearchJob *> searchJobs;
+
+        // folder downloads in progress (by tag of the folder transfer)
+        map<int, MegaFolderDownload *> folderDownloads;
+        map<int, vector<MegaTransferPrivate *> > uploadCopyBatches;
+        static const unsigned MAXCOPYBATCH = 1000;
+
         vector<m_time_t> downloadTimes;
         vector<int64_t> downloadBytes;
         int64_t downloadPartialBytes;
@@ -1191,6 +2344,17 @@ protected:
 
 #ifdef ENABLE_SYNC
         map<int, MegaSyncPrivate *> syncMap;
+
+        // states of the local paths queried by syncPathState() (overlay
+        // icons), kept current by the sync callbacks so that repeated
+        // queries don't wait for sdkMutex - filled and updated with sdkMutex
+        // locked, read with pathStateMutex only
+        MegaMutex pathStateMutex;
+        map<string, int> pathStates;
+        static const size_t MAXPATHSTATES = 100000;
+
+        // forget the state of the path (and of the paths below it)
+        void dropPathStates(string *localpath, bool folder);
 #endif
 
         int pendingUploads;
@@ -1199,6 +2363,12 @@ protected:
         int totalDownloads;
         long long totalDownloadedBytes;
         long long totalUploadedBytes;
+
+        // aggregates of MegaApi::getTransferStats (the active transfers and
+        // the speeds are taken when asked)
+        MegaTransferStatsPrivate transferStats;
+        void updateTransferStats(MegaTransferPrivate *transfer, int finish = 0);
+
         set<MegaRequestListener *> requestListeners;
         set<MegaTransferListener *> transferListeners;
 
@@ -1210,10 +2380,40 @@ protected:
         set<MegaListener *> listeners;
         bool waiting;
         bool waitingRequest;
-        vector<string> excludedNames;
+#ifdef ENABLE_SYNC
+        ExclusionRules excludedNames;
+#endif
         long long syncLowerSizeLimit;
         long long syncUpperSizeLimit;
-        MegaMutex sdkMutex;
+        MegaSharedMutex sdkMutex;
+
+        // node changes pending MegaApi::getNodeDeltas (enableNodeDeltas()):
+        // changed handles in order of first change and their merged flags
+        MegaMutex deltaMutex;
+        bool deltasEnabled;
+        dstime deltaWindow;
+        size_t deltaLimit;
+        deque<handle> deltaOrder;
+        map<handle, int> deltaChanges;
+        bool deltaReload;
+
+        // start of the coalescing window (NEVER: nothing to announce) and
+        // whether onNodeDeltasAvailable() awaits getNodeDeltas()
+        dstime deltaSince;
+        bool deltaAnnounced;
+
+        // called by the SDK thread after each exec()
+        void announceNodeDeltas();
+
+        // listener callbacks run here instead of on the SDK thread (NULL:
+        // synchronous, see setCallbackThreads())
+        MegaCallbackDispatcher *callbackDispatcher;
+        void postRequestEvent(int type, MegaRequestPrivate *request, MegaError *e);
+        void postTransferEvent(int type, MegaTransferPrivate *transfer, MegaError *e);
+        void postGlobalEvent(int type, MegaCallbackDispatcher::Payload *payload);
+#ifdef ENABLE_SYNC
+        void postSyncEvent(int type, MegaSyncPrivate *sync, MegaCallbackDispatcher::Payload *payload);
+#endif
         MegaTransferPrivate *currentTransfer;
         MegaRequestPrivate *activeRequest;
         MegaTransferPrivate *activeTransfer;
@@ -1268,6 +2468,7 @@ protected:
 
 
         virtual void fetchnodes_result(error);
+        virtual void fetchchildren_result(handle, error);
         virtual void putnodes_result(error, targettype_t, NewNode*);
 
         // share update result
@@ -1315,6 +2516,13 @@ protected:
         virtual void exportnode_result(error);
         virtual void exportnode_result(handle, handle);
 
+        // public link of an exported node (false if the node key isn't available)
+        static bool exportlink(Node*, handle, string*);
+
+        // record the result of the next node of a bulk request and finish
+        // the request with its last response
+        void bulknode_result(MegaRequestPrivate*, error, const char* = NULL);
+
         // exported link access result
         virtual void openfilelink_result(error);
         virtual void openfilelink_result(handle, const byte*, m_off_t, string*, string*, int);
@@ -1326,10 +2534,12 @@ protected:
         virtual void transfer_failed(Transfer*, error error);
         virtual void transfer_update(Transfer*);
         virtual void transfer_limit(Transfer*);
+        virtual void peer_lookup(handle);
         virtual void transfer_complete(Transfer*);
 
         virtual dstime pread_failure(error, int, void*);
         virtual bool pread_data(byte*, m_off_t, m_off_t, void*);
+        virtual bool pread_buffer(string**, m_off_t, m_off_t, void*);
 
         virtual void reportevent_result(error);
         virtual void loadbalancing_result(string*, error);
@@ -1340,6 +2550,7 @@ protected:
 #ifdef ENABLE_SYNC
         // sync status updates and events
         virtual void syncupdate_state(Sync*, syncstate_t);
+        virtual void syncupdate_stats(Sync*);
         virtual void syncupdate_scanning(bool scanning);
         virtual void syncupdate_local_folder_addition(Sync* sync, LocalNode *localNode, const char *path);
         virtual void syncupdate_local_folder_deletion(Sync* sync, LocalNode *localNode);
@@ -1371,17 +2582,57 @@ protected:
         // failed request retry notification
         virtual void notify_retry(dstime);
 
+        // periodic engine statistics report
+        virtual void enginestats_updated();
+
         void sendPendingRequests();
         void sendPendingTransfers();
+        void startUploadTransfer(MegaTransferPrivate *transfer, string *localPath);
+        void restoreQueuedDownloads();
+        void processFingerprintedUploads();
+        void processRemoveJobs();
+        void processPwKeyJobs();
+        void processSearchJobs();
+
+        // folder downloads (sdkMutex locked)
+        error startFolderDownload(MegaTransferPrivate *transfer, Node *node, int tag);
+        void processFolderDownloads();
+        void feedFolderDownload(MegaFolderDownload *folder);
+        void updateFolderDownload(MegaTransferPrivate *subtransfer);
+        MegaFolderDownload *finishFolderSubtransfer(MegaTransferPrivate *subtransfer, error e);
+        void finishFolderDownload(MegaFolderDownload *folder);
+
+        // resolution of MegaApi::getNodeByPath (sdkMutex locked)
+        Node *resolvePath(const char *path, Node *cwd, bool shared);
+        MegaPathCache pathCache;
         char *stringToArray(string &buffer);
 
         //Internal
+        // read-only queries share sdkMutex (returns true) - exclusive while
+        // node attributes are pending decryption, as reading resolves them
+        bool lockQuery();
+        void unlockQuery(bool shared);
+
+        // children of parent in this order, cached in the parent until they
+        // change (valid while sdkMutex is held)
+        const node_vector *getSortedChildren(Node *parent, NodeComparator comp, int order);
+
+        // children of parent in this order (unsorted: the children themselves)
+        const node_vector *getChildrenView(Node *parent, int order);
+
+        // position of node in a view of its parent's children (-1: not found)
+        static int getViewIndex(const node_vector *view, Node *node, int order);
+
+        static MegaNodeList *getChildrenRange(const node_vector *view, int offset, int limit);
+        MegaMutex sortMutex;
+
         Node* getNodeByFingerprintInternal(const char *fingerprint);
         Node *getNodeByFingerprintInternal(const char *fingerprint, Node *parent);
 
         bool processTree(Node* node, TreeProcessor* processor, bool recursive = 1);
+        static bool walkTree(Node* node, TreeProcessor* processor, bool recursive);
         MegaNodeList* search(Node* node, const char* searchString, bool recursive = 1);
-        void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
+        void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL, bool prefetch = false);
 		void cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener = NULL);
         void setNodeAttribute(MegaNode* node, int type, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void getUserAttr(MegaUser* user, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
@@ -0,0 +1,352 @@
+/**
+ * @file aesbatch.cpp
+ * @brief Batched AES-128 under independent keys
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+
+#include "mega/aesbatch.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define AESBATCH_AESNI 1
+#include <cpuid.h>
+#include <wmmintrin.h>
+#endif
+
+namespace mega {
+void AesBatch::add(const byte* key, byte* data, unsigned len, op_t op)
+{
+    jobs.resize(jobs.size() + 1);
+
+    Job* job = &jobs.back();
+
+    memcpy(job->key, key, sizeof job->key);
+    job->data = data;
+    job->len = len & -SymmCipher::BLOCKSIZE;
+    job->op = op;
+}
+
+// one job through the installed backend (whose context is rekeyed for every
+// job) or Crypto++
+void AesBatch::runsoftware(Job* job, void** ctx)
+{
+    byte chain[SymmCipher::BLOCKSIZE];
+
+    if (CryptoBackend::active && (*ctx = CryptoBackend::active->aeskey(*ctx, job->key)))
+    {
+        bool done;
+
+        switch (job->op)
+        {
+            case ECB_ENCRYPT:
+                done = CryptoBackend::active->ecb_encrypt(*ctx, job->data, job->data, job->len);
+                break;
+
+            case ECB_DECRYPT:
+                done = CryptoBackend::active->ecb_decrypt(*ctx, job->data, job->data, job->len);
+                break;
+
+            default:
+                done = CryptoBackend::active->cbc_decrypt(*ctx, SymmCipher::zeroiv, job->data, job->len);
+        }
+
+        if (done)
+        {
+            return;
+        }
+    }
+
+    if (job->op == ECB_ENCRYPT)
+    {
+        CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption aes;
+
+        aes.SetKey(job->key, sizeof job->key);
+        aes.ProcessData(job->data, job->data, job->len);
+        return;
+    }
+
+    CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption aes;
+    aes.SetKey(job->key, sizeof job->key);
+
+    if (job->op == ECB_DECRYPT)
+    {
+        aes.ProcessData(job->data, job->data, job->len);
+        return;
+    }
+
+    // CBC: undo the chaining block by block
+    memset(chain, 0, sizeof chain);
+
+    for (unsigned pos = 0; pos < job->len; pos += SymmCipher::BLOCKSIZE)
+    {
+        byte c[SymmCipher::BLOCKSIZE];
+        byte* block = job->data + pos;
+
+        memcpy(c, block, sizeof c);
+        aes.ProcessData(block, block, sizeof c);
+        SymmCipher::xorblock(chain, block);
+        memcpy(chain, c, sizeof chain);
+    }
+}
+
+#ifdef AESBATCH_AESNI
+// jobs per interleaved group
+static const unsigned LANES = 8;
+
+static bool detect()
+{
+    unsigned a, b, c, d;
+
+    // AES-NI and SSE2
+    return __get_cpuid(1, &a, &b, &c, &d) && (c & (1 << 25)) && (d & (1 << 26));
+}
+
+__attribute__((target("aes,sse2")))
+static __m128i expandround(__m128i k, __m128i t)
+{
+    t = _mm_shuffle_epi32(t, 0xff);
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+    k = _mm_xor_si128(k, _mm_slli_si128(k, 4));
+
+    return _mm_xor_si128(k, t);
+}
+
+#define AESBATCH_EXPAND(i, rcon) rk[i] = expandround(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+// the encryption key schedule, or the equivalent inverse cipher's
+__attribute__((target("aes,sse2")))
+static void expandkey(const byte* key, __m128i* rk, bool decrypt)
+{
+    rk[0] = _mm_loadu_si128((const __m128i*)key);
+
+    AESBATCH_EXPAND(1, 0x01);
+    AESBATCH_EXPAND(2, 0x02);
+    AESBATCH_EXPAND(3, 0x04);
+    AESBATCH_EXPAND(4, 0x08);
+    AESBATCH_EXPAND(5, 0x10);
+    AESBATCH_EXPAND(6, 0x20);
+    AESBATCH_EXPAND(7, 0x40);
+    AESBATCH_EXPAND(8, 0x80);
+    AESBATCH_EXPAND(9, 0x1b);
+    AESBATCH_EXPAND(10, 0x36);
+
+    if (decrypt)
+    {
+        __m128i t;
+
+        for (int i = 0; i < 5; i++)
+        {
+            t = rk[i];
+            rk[i] = rk[10 - i];
+            rk[10 - i] = t;
+        }
+
+        for (int i = 1; i < 10; i++)
+        {
+            rk[i] = _mm_aesimc_si128(rk[i]);
+        }
+    }
+}
+
+#undef AESBATCH_EXPAND
+
+// up to LANES jobs of the same direction, advanced one block per lane at a
+// time so that their rounds are interleaved
+__attribute__((target("aes,sse2")))
+static void runlanes(AesBatch::op_t* ops, byte** data, unsigned* lens, const byte* const* keys, unsigned n, bool decrypt)
+{
+    __m128i rk[LANES][11];
+    __m128i chain[LANES];
+    __m128i b[LANES];
+    __m128i c[LANES];
+    unsigned active[LANES];
+    unsigned m;
+
+    for (unsigned l = 0; l < n; l++)
+    {
+        expandkey(keys[l], rk[l], decrypt);
+        chain[l] = _mm_setzero_si128();
+    }
+
+    for (unsigned pos = 0; ; pos += 16)
+    {
+        m = 0;
+
+        for (unsigned l = 0; l < n; l++)
+        {
+            if (pos < lens[l])
+            {
+                c[m] = _mm_loadu_si128((const __m128i*)(data[l] + pos));
+                b[m] = _mm_xor_si128(c[m], rk[l][0]);
+                active[m++] = l;
+            }
+        }
+
+        if (!m)
+        {
+            break;
+        }
+
+        if (decrypt)
+        {
+            for (int r = 1; r < 10; r++)
+            {
+                for (unsigned i = 0; i < m; i++)
+                {
+                    b[i] = _mm_aesdec_si128(b[i], rk[active[i]][r]);
+                }
+            }
+
+            for (unsigned i = 0; i < m; i++)
+            {
+                unsigned l = active[i];
+
+                b[i] = _mm_aesdeclast_si128(b[i], rk[l][10]);
+
+                if (ops[l] == AesBatch::CBC_DECRYPT)
+                {
+                    b[i] = _mm_xor_si128(b[i], chain[l]);
+                    chain[l] = c[i];
+                }
+            }
+        }
+        else
+        {
+            for (int r = 1; r < 10; r++)
+            {
+                for (unsigned i = 0; i < m; i++)
+                {
+                    b[i] = _mm_aesenc_si128(b[i], rk[active[i]][r]);
+                }
+            }
+
+            for (unsigned i = 0; i < m; i++)
+            {
+                b[i] = _mm_aesenclast_si128(b[i], rk[active[i]][10]);
+            }
+        }
+
+        for (unsigned i = 0; i < m; i++)
+        {
+            _mm_storeu_si128((__m128i*)(data[active[i]] + pos), b[i]);
+        }
+    }
+}
+
+// the lanes must reproduce the FIPS-197 example vector
+static bool selfcheck()
+{
+    byte key[16];
+    byte pt[16];
+    static const byte ct[16] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30,
+                                 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+
+    for (int i = 0; i < 16; i++)
+    {
+        key[i] = (byte)i;
+        pt[i] = (byte)(i * 0x11);
+    }
+
+    byte buf[16];
+    byte* data = buf;
+    unsigned len = sizeof buf;
+    const byte* k = key;
+    AesBatch::op_t op = AesBatch::ECB_ENCRYPT;
+
+    memcpy(buf, pt, sizeof buf);
+    runlanes(&op, &data, &len, &k, 1, false);
+
+    if (memcmp(buf, ct, sizeof buf))
+    {
+        return false;
+    }
+
+    op = AesBatch::ECB_DECRYPT;
+    runlanes(&op, &data, &len, &k, 1, true);
+
+    return !memcmp(buf, pt, sizeof buf);
+}
+
+static bool aesni = detect() && selfcheck();
+#else
+static bool aesni = false;
+#endif
+
+bool AesBatch::accelerated()
+{
+    return aesni;
+}
+
+void AesBatch::run()
+{
+#ifdef AESBATCH_AESNI
+    if (aesni)
+    {
+        // encryption and decryption jobs go to separate groups
+        for (int decrypt = 0; decrypt < 2; decrypt++)
+        {
+            op_t ops[LANES];
+            byte* data[LANES];
+            unsigned lens[LANES];
+            const byte* keys[LANES];
+            unsigned n = 0;
+
+            for (unsigned i = 0; i < jobs.size(); i++)
+            {
+                if ((jobs[i].op != ECB_ENCRYPT) == (decrypt != 0))
+                {
+                    ops[n] = jobs[i].op;
+                    data[n] = jobs[i].data;
+                    lens[n] = jobs[i].len;
+                    keys[n] = jobs[i].key;
+
+                    if (++n == LANES)
+                    {
+                        runlanes(ops, data, lens, keys, n, decrypt != 0);
+                        n = 0;
+                    }
+                }
+            }
+
+            if (n)
+            {
+                runlanes(ops, data, lens, keys, n, decrypt != 0);
+            }
+        }
+
+        jobs.clear();
+        return;
+    }
+#endif
+
+    void* ctx = NULL;
+
+    for (unsigned i = 0; i < jobs.size(); i++)
+    {
+        runsoftware(&jobs[i], &ctx);
+    }
+
+    if (ctx)
+    {
+        CryptoBackend::active->aesfree(ctx);
+    }
+
+    jobs.clear();
+}
+} // namespace
@@ -22,6 +22,152 @@
 #include "mega/attrmap.h"
 
 namespace mega {
+attr_map::attr_map(const attr_map& other) : entries(NULL), count(0), capacity(0)
+{
+    *this = other;
+}
+
+attr_map::~attr_map()
+{
+    delete[] entries;
+}
+
+attr_map& attr_map::operator=(const attr_map& other)
+{
+    if (this != &other)
+    {
+        if (capacity < other.count || !other.count)
+        {
+            delete[] entries;
+            entries = other.count ? new value_type[other.count] : NULL;
+            capacity = other.count;
+        }
+
+        for (unsigned i = 0; i < other.count; i++)
+        {
+            entries[i] = other.entries[i];
+        }
+
+        for (unsigned i = other.count; i < count; i++)
+        {
+            entries[i].second.clear();
+        }
+
+        count = other.count;
+    }
+
+    return *this;
+}
+
+// grow the array to hold at least n entries (values are swapped, not copied)
+void attr_map::reserve(unsigned n)
+{
+    if (n > capacity)
+    {
+        unsigned newcapacity = capacity ? capacity * 2 : 2;
+
+        if (newcapacity < n)
+        {
+            newcapacity = n;
+        }
+
+        value_type* newentries = new value_type[newcapacity];
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            newentries[i].first = entries[i].first;
+            newentries[i].second.swap(entries[i].second);
+        }
+
+        delete[] entries;
+        entries = newentries;
+        capacity = newcapacity;
+    }
+}
+
+attr_map::iterator attr_map::find(nameid id)
+{
+    for (unsigned i = 0; i < count && entries[i].first <= id; i++)
+    {
+        if (entries[i].first == id)
+        {
+            return entries + i;
+        }
+    }
+
+    return end();
+}
+
+attr_map::const_iterator attr_map::find(nameid id) const
+{
+    return const_cast<attr_map*>(this)->find(id);
+}
+
+string& attr_map::operator[](nameid id)
+{
+    unsigned i;
+
+    for (i = 0; i < count && entries[i].first < id; i++);
+
+    if (i < count && entries[i].first == id)
+    {
+        return entries[i].second;
+    }
+
+    reserve(count + 1);
+
+    // open a gap at i
+    for (unsigned j = count; j > i; j--)
+    {
+        entries[j].first = entries[j - 1].first;
+        entries[j].second.swap(entries[j - 1].second);
+    }
+
+    count++;
+
+    entries[i].first = id;
+    entries[i].second.clear();
+
+    return entries[i].second;
+}
+
+void attr_map::erase(iterator it)
+{
+    for (iterator next = it + 1; next != end(); it++, next++)
+    {
+        it->first = next->first;
+        it->second.swap(next->second);
+    }
+
+    count--;
+
+    // release the value's storage
+    string().swap(entries[count].second);
+}
+
+size_t attr_map::erase(nameid id)
+{
+    iterator it = find(id);
+
+    if (it == end())
+    {
+        return 0;
+    }
+
+    erase(it);
+
+    return 1;
+}
+
+void attr_map::clear()
+{
+    delete[] entries;
+
+    entries = NULL;
+    count = 0;
+    capacity = 0;
+}
+
 // approximate raw storage size of serialized AttrMap, not taking JSON escaping
 // or name length into account
 unsigned AttrMap::storagesize(int perrecord) const
@@ -74,11 +220,45 @@ void AttrMap::serialize(string* d) const
 }
 
 // read binary serialize, return final offset
-const char* AttrMap::unserialize( const char* ptr )
+const char* AttrMap::unserialize(const char* ptr, const char* end)
 {
     unsigned char l;
     unsigned short ll;
     nameid id;
+    unsigned n = 0;
+    const char* p;
+
+    // validate and count first, so that the entries are allocated once
+    for (p = ptr; ; n++)
+    {
+        if (end && p >= end)
+        {
+            return NULL;
+        }
+
+        if (!(l = *p++))
+        {
+            break;
+        }
+
+        if (end && p + l + sizeof ll > end)
+        {
+            return NULL;
+        }
+
+        p += l;
+        ll = MemAccess::get<short>(p);
+        p += sizeof ll;
+
+        if (end && p + ll > end)
+        {
+            return NULL;
+        }
+
+        p += ll;
+    }
+
+    map.reserve(map.size() + n);
 
     while ((l = *ptr++))
     {
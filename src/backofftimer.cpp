@@ -57,6 +57,16 @@ void BackoffTimer::backoff(dstime newdelta)
     base = newdelta;
 }
 
+void BackoffTimer::backoff(dstime newdelta, dstime jitter)
+{
+    if (jitter > 0)
+    {
+        newdelta += (dstime)(PrnGen::genuint32(RAND_MAX) % (jitter + 1));
+    }
+
+    backoff(newdelta);
+}
+
 bool BackoffTimer::armed() const
 {
     return !next || Waiter::ds >= next;
@@ -0,0 +1,252 @@
+/**
+ * @file bandwidth.cpp
+ * @brief Client-side transfer bandwidth shaping
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/bandwidth.h"
+#include "mega/waiter.h"
+
+namespace mega {
+TokenBucket::TokenBucket()
+{
+    rate = 0;
+    capacity = 0;
+    tokens = 0;
+    lastrefill = 0;
+}
+
+void TokenBucket::refill(dstime ds)
+{
+    if (ds > lastrefill)
+    {
+        tokens += rate * (ds - lastrefill) / 10;
+
+        if (tokens > capacity)
+        {
+            tokens = capacity;
+        }
+    }
+
+    lastrefill = ds;
+}
+
+void TokenBucket::set(m_off_t newrate, m_off_t newcapacity)
+{
+    refill(Waiter::ds);
+
+    rate = newrate;
+    capacity = newcapacity < 0 ? 0 : newcapacity;
+
+    if (tokens > capacity)
+    {
+        tokens = capacity;
+    }
+}
+
+bool BandwidthScheduleEntry::active(struct tm* now) const
+{
+    int minute = now->tm_hour * 60 + now->tm_min;
+
+    if (start <= end)
+    {
+        return (weekdays & (1 << now->tm_wday)) && minute >= start && minute < end;
+    }
+
+    // wraps past midnight: the part after midnight belongs to the previous day
+    if (minute >= start)
+    {
+        return (weekdays & (1 << now->tm_wday));
+    }
+
+    return minute < end && (weekdays & (1 << ((now->tm_wday + 6) % 7)));
+}
+
+BandwidthShaper::BandwidthShaper()
+{
+    for (int d = 2; d--; )
+    {
+        rate[d] = 0;
+        transferrate[d] = 0;
+        scheduledrate[d] = 0;
+    }
+
+    schedulecheck = -1;
+
+    streamingrate = 0;
+    starvedstreams = 0;
+    bulkcap = 0;
+    laststream = 0;
+}
+
+void BandwidthShaper::streamwindow(bool starved, m_off_t bulkrate)
+{
+    laststream = Waiter::ds;
+
+    if (starved)
+    {
+        bulkcap = bulkcap ? bulkcap / 2 : bulkrate / 2;
+    }
+    else if (bulkcap)
+    {
+        bulkcap += bulkcap / 4;
+    }
+    else
+    {
+        return;
+    }
+
+    if (bulkcap < MINBULKRATE)
+    {
+        bulkcap = MINBULKRATE;
+    }
+}
+
+void BandwidthShaper::setlimit(direction_t d, m_off_t newrate, m_off_t burst)
+{
+    rate[d] = newrate < 0 ? 0 : newrate;
+    buckets[d].set(rate[d], burst);
+    schedulecheck = -1;
+}
+
+void BandwidthShaper::addschedule(direction_t d, BandwidthScheduleEntry* entry)
+{
+    schedule[d].push_back(*entry);
+    schedulecheck = -1;
+}
+
+void BandwidthShaper::clearschedule(direction_t d)
+{
+    schedule[d].clear();
+    buckets[d].set(rate[d], buckets[d].capacity);
+    schedulecheck = -1;
+}
+
+m_off_t BandwidthShaper::currentrate(direction_t d)
+{
+    if (!schedule[GET].size() && !schedule[PUT].size())
+    {
+        return rate[d];
+    }
+
+    time_t t = time(NULL);
+    struct tm now;
+
+#ifdef _WIN32
+    localtime_s(&now, &t);
+#else
+    localtime_r(&t, &now);
+#endif
+
+    // re-evaluate the schedules once per minute
+    int check = now.tm_wday * 1440 + now.tm_hour * 60 + now.tm_min;
+
+    if (check != schedulecheck)
+    {
+        schedulecheck = check;
+
+        for (int dir = 2; dir--; )
+        {
+            scheduledrate[dir] = rate[dir];
+
+            for (unsigned i = 0; i < schedule[dir].size(); i++)
+            {
+                if (schedule[dir][i].active(&now))
+                {
+                    scheduledrate[dir] = schedule[dir][i].rate;
+                    break;
+                }
+            }
+
+            if (buckets[dir].rate != scheduledrate[dir])
+            {
+                buckets[dir].set(scheduledrate[dir], buckets[dir].capacity);
+            }
+        }
+    }
+
+    return scheduledrate[d];
+}
+
+m_off_t BandwidthShaper::requestspeed(direction_t d, m_off_t size, int inflight, int transferinflight)
+{
+    m_off_t r = currentrate(d);
+    m_off_t speed = 0;
+
+    if (r)
+    {
+        TokenBucket* bucket = buckets + d;
+
+        bucket->refill(Waiter::ds);
+
+        // covered by the burst allowance: full speed
+        if (bucket->tokens < size)
+        {
+            speed = r / (inflight + 1);
+
+            if (!speed)
+            {
+                speed = 1;
+            }
+        }
+
+        // capped requests are drawn at the refill rate, so the resulting debt
+        // is paid back while they run
+        bucket->tokens -= size;
+    }
+
+    if (transferrate[d])
+    {
+        m_off_t tspeed = transferrate[d] / (transferinflight + 1);
+
+        if (!tspeed)
+        {
+            tspeed = 1;
+        }
+
+        if (!speed || tspeed < speed)
+        {
+            speed = tspeed;
+        }
+    }
+
+    if (d == GET && bulkcap)
+    {
+        if (Waiter::ds - laststream > STREAMIDLE)
+        {
+            bulkcap = 0;
+        }
+        else
+        {
+            m_off_t bspeed = bulkcap / (inflight + 1);
+
+            if (!bspeed)
+            {
+                bspeed = 1;
+            }
+
+            if (!speed || bspeed < speed)
+            {
+                speed = bspeed;
+            }
+        }
+    }
+
+    return speed;
+}
+} // namespace
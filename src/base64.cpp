@@ -21,63 +21,112 @@
 
 #include "mega/base64.h"
 
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
 namespace mega {
-// modified base64 conversion (no trailing '=' and '-_' instead of '+/')
-unsigned char Base64::to64(byte c)
+#ifdef __SSSE3__
+// encode 12 bytes (16 are read) to 16 characters
+static inline __m128i encode12(const byte* b)
 {
-    c &= 63;
- 
-    if (c < 26)
-    {
-        return c + 'A';
-    }
- 
-    if (c < 52)
-    {
-        return c - 26 + 'a';
-    }
+    __m128i in = _mm_loadu_si128((const __m128i*)b);
 
-    if (c < 62)
-    {
-        return c - 52 + '0';
-    }
+    // spread each 3-byte group over a 32-bit lane, then extract the four
+    // 6-bit indexes (W. Mula's multiply-shift method)
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
 
-    if (c == 62)
-    {
-        return '-';
-    }
+    __m128i t0 = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+    __m128i t1 = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+    __m128i indexes = _mm_or_si128(t0, t1);
+
+    // map the indexes to the URL-safe alphabet by adding a per-range offset
+    __m128i range = _mm_subs_epu8(indexes, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), indexes), _mm_set1_epi8(13)));
+
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '-' - 62, '_' - 63, 'A', 0, 0);
 
-    return '_';
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indexes);
 }
 
-unsigned char Base64::from64(byte c)
+// decode 16 characters to 12 bytes (16 are written) - false if not all of
+// them are base64 characters
+static inline bool decode16(const char* a, byte* b)
 {
-    if ((c >= 'A') && (c <= 'Z'))
-    {
-        return c - 'A';
-    }
+    __m128i in = _mm_loadu_si128((const __m128i*)a);
 
-    if ((c >= 'a') && (c <= 'z'))
-    {
-        return c - 'a' + 26;
-    }
+    // (signed comparisons: bytes >= 0x80 fall outside all ranges)
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8('Z' + 1)));
+    __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(in, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(in, _mm_set1_epi8('9' + 1)));
+    __m128i dash = _mm_cmpeq_epi8(in, _mm_set1_epi8('-'));
+    __m128i underscore = _mm_cmpeq_epi8(in, _mm_set1_epi8('_'));
 
-    if ((c >= '0') && (c <= '9'))
-    {
-        return c - '0' + 52;
-    }
+    __m128i valid = _mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, dash)), underscore);
 
-    if (c == '-')
+    if (_mm_movemask_epi8(valid) != 0xffff)
     {
-        return 62;
+        return false;
     }
 
-    if (c == '_')
-    {
-        return 63;
-    }
+    __m128i shift = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                                              _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                                 _mm_or_si128(_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                                           _mm_and_si128(dash, _mm_set1_epi8(62 - '-'))),
+                                              _mm_and_si128(underscore, _mm_set1_epi8(63 - '_'))));
 
-    return 255;
+    __m128i values = _mm_add_epi8(in, shift);
+
+    // pack four 6-bit values into three bytes per 32-bit lane
+    __m128i merged = _mm_madd_epi16(_mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140)), _mm_set1_epi32(0x00011000));
+
+    _mm_storeu_si128((__m128i*)b, _mm_shuffle_epi8(merged, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)));
+
+    return true;
+}
+
+// can 16 bytes be read at p without crossing into the next page?
+static inline bool inpage16(const void* p)
+{
+    return ((size_t)p & 4095) <= 4096 - 16;
+}
+#endif
+
+// modified base64 conversion (no trailing '=' and '-_' instead of '+/')
+static const char alphabet64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// reverse lookup (255: not a base64 character)
+static const byte values64[256] = {
+#define X 255
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, 62, X, X,
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, X, X, X, X, X, X,
+    X, 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14,
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, X, X, X, X, 63,
+    X, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40,
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X,
+    X, X, X, X, X, X, X, X, X, X, X, X, X, X, X, X
+#undef X
+};
+
+byte Base64::to64(byte c)
+{
+    return alphabet64[c & 63];
+}
+
+byte Base64::from64(byte c)
+{
+    return values64[c];
 }
 
 int Base64::atob(const char* a, byte* b, int blen)
@@ -86,6 +135,33 @@ int Base64::atob(const char* a, byte* b, int blen)
     int i;
     int p = 0;
 
+#ifdef __SSSE3__
+    // 16 characters at a time while the output has room for 16 bytes
+    while (p + 16 <= blen && inpage16(a) && decode16(a, b + p))
+    {
+        a += 16;
+        p += 12;
+    }
+#endif
+
+    // complete groups of four characters
+    while (p + 3 <= blen)
+    {
+        // (never read past the terminating character)
+        if ((c[0] = values64[(byte)a[0]]) == 255
+         || (c[1] = values64[(byte)a[1]]) == 255
+         || (c[2] = values64[(byte)a[2]]) == 255
+         || (c[3] = values64[(byte)a[3]]) == 255)
+        {
+            break;
+        }
+
+        b[p++] = (c[0] << 2) | (c[1] >> 4);
+        b[p++] = (c[1] << 4) | (c[2] >> 2);
+        b[p++] = (c[2] << 6) | c[3];
+        a += 4;
+    }
+
     c[3] = 0;
 
     for (;;)
@@ -127,37 +203,59 @@ int Base64::btoa(const byte* b, int blen, char* a)
 {
     int p = 0;
 
-    for (;;)
+#ifdef __SSSE3__
+    // 12 bytes at a time (16 are read)
+    while (blen >= 16)
     {
-        if (blen <= 0)
-        {
-            break;
-        }
+        _mm_storeu_si128((__m128i*)(a + p), encode12(b));
+        p += 16;
+        b += 12;
+        blen -= 12;
+    }
+#endif
+
+    // complete groups of three bytes
+    while (blen >= 3)
+    {
+        a[p++] = alphabet64[b[0] >> 2];
+        a[p++] = alphabet64[((b[0] << 4) | (b[1] >> 4)) & 63];
+        a[p++] = alphabet64[((b[1] << 2) | (b[2] >> 6)) & 63];
+        a[p++] = alphabet64[b[2] & 63];
+
+        blen -= 3;
+        b += 3;
+    }
 
+    if (blen > 0)
+    {
         a[p++] = to64(*b >> 2);
         a[p++] = to64((*b << 4) | (((blen > 1) ? b[1] : 0) >> 4));
 
-        if (blen < 2)
+        if (blen > 1)
         {
-            break;
+            a[p++] = to64(b[1] << 2);
         }
+    }
 
-        a[p++] = to64(b[1] << 2 | (((blen > 2) ? b[2] : 0) >> 6));
+    a[p] = 0;
 
-        if (blen < 3)
-        {
-            break;
-        }
+    return p;
+}
 
-        a[p++] = to64(b[2]);
+int Base64::btoa(const string& in, string* out)
+{
+    out->resize(in.size() * 4 / 3 + 4);
+    out->resize(btoa((const byte*)in.data(), in.size(), (char*)out->data()));
 
-        blen -= 3;
-        b += 3;
-    }
+    return out->size();
+}
 
-    a[p] = 0;
+int Base64::atob(const string& in, string* out)
+{
+    out->resize(in.size() * 3 / 4 + 3);
+    out->resize(atob(in.c_str(), (byte*)out->data(), out->size()));
 
-    return p;
+    return out->size();
 }
 
 byte Base32::to32(byte c)
@@ -0,0 +1,336 @@
+/**
+ * @file bufferpool.cpp
+ * @brief Pool of aligned transfer chunk buffers
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/bufferpool.h"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <stdlib.h>
+#endif
+
+namespace mega {
+ChunkBufferPool::ChunkBufferPool()
+{
+    idle = 0;
+    inuse = 0;
+    limit = DEFAULTLIMIT;
+}
+
+ChunkBufferPool::~ChunkBufferPool()
+{
+    clear();
+}
+
+byte* ChunkBufferPool::allocaligned(unsigned len)
+{
+    void* p;
+
+#ifdef _WIN32
+    p = _aligned_malloc(len, ALIGNMENT);
+#else
+    if (posix_memalign(&p, ALIGNMENT, len))
+    {
+        p = NULL;
+    }
+#endif
+
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+
+    return (byte*)p;
+}
+
+void ChunkBufferPool::freealigned(byte* p)
+{
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+byte* ChunkBufferPool::get(unsigned len, unsigned* size)
+{
+    *size = (len + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+
+    if (!*size)
+    {
+        *size = GRANULARITY;
+    }
+
+    sizeclass_map::iterator it = freebuffers.find(*size);
+
+    if (it != freebuffers.end())
+    {
+        byte* buf = it->second.back();
+
+        it->second.pop_back();
+
+        if (!it->second.size())
+        {
+            freebuffers.erase(it);
+        }
+
+        idle -= *size;
+        inuse += *size;
+
+        return buf;
+    }
+
+    byte* buf = allocaligned(*size);
+
+    inuse += *size;
+
+    return buf;
+}
+
+void ChunkBufferPool::release(byte* buf, unsigned size)
+{
+    if (!buf)
+    {
+        return;
+    }
+
+    inuse -= size;
+
+    if (idle + size > limit)
+    {
+        freealigned(buf);
+        return;
+    }
+
+    freebuffers[size].push_back(buf);
+    idle += size;
+}
+
+void ChunkBufferPool::setlimit(m_off_t newlimit)
+{
+    limit = newlimit < 0 ? 0 : newlimit;
+    trim();
+}
+
+void ChunkBufferPool::trim()
+{
+    while (idle > limit && freebuffers.size())
+    {
+        sizeclass_map::iterator it = --freebuffers.end();
+
+        freealigned(it->second.back());
+        idle -= it->first;
+
+        it->second.pop_back();
+
+        if (!it->second.size())
+        {
+            freebuffers.erase(it);
+        }
+    }
+}
+
+void ChunkBufferPool::clear()
+{
+    for (sizeclass_map::iterator it = freebuffers.begin(); it != freebuffers.end(); it++)
+    {
+        for (unsigned i = 0; i < it->second.size(); i++)
+        {
+            freealigned(it->second[i]);
+        }
+    }
+
+    freebuffers.clear();
+    idle = 0;
+}
+
+MemoryBudget::MemoryBudget()
+{
+    limit = 0;
+    used = 0;
+    denied = 0;
+}
+
+bool MemoryBudget::reserve(m_off_t bytes)
+{
+    if (limit && used && used + bytes > limit)
+    {
+        denied++;
+        return false;
+    }
+
+    used += bytes;
+    return true;
+}
+
+void MemoryBudget::release(m_off_t bytes)
+{
+    used -= bytes;
+}
+
+MemoryReservation::MemoryReservation()
+{
+    budget = NULL;
+    bytes = 0;
+}
+
+MemoryReservation::~MemoryReservation()
+{
+    release();
+}
+
+bool MemoryReservation::reserve(MemoryBudget* b, m_off_t n)
+{
+    release();
+
+    if (!b->reserve(n))
+    {
+        return false;
+    }
+
+    budget = b;
+    bytes = n;
+    return true;
+}
+
+void MemoryReservation::take(MemoryReservation* other)
+{
+    release();
+
+    budget = other->budget;
+    bytes = other->bytes;
+
+    other->budget = NULL;
+    other->bytes = 0;
+}
+
+void MemoryReservation::release()
+{
+    if (budget)
+    {
+        budget->release(bytes);
+        budget = NULL;
+        bytes = 0;
+    }
+}
+
+ObjectSlab::ObjectSlab(size_t size)
+{
+    objsize = size;
+    blocksize = (sizeof(Header) + size + sizeof(Header) - 1) / sizeof(Header) * sizeof(Header);
+    live = 0;
+    next = NULL;
+    end = NULL;
+    freelist = NULL;
+}
+
+// slabs with live objects are leaked rather than freed under them
+ObjectSlab::~ObjectSlab()
+{
+    trim();
+}
+
+void* ObjectSlab::alloc(size_t size)
+{
+    Header* h;
+
+    if (size > objsize)
+    {
+        h = (Header*)::operator new(sizeof(Header) + size);
+        h->slab = NULL;
+        return h + 1;
+    }
+
+    if (freelist)
+    {
+        h = (Header*)freelist;
+        freelist = *(void**)(h + 1);
+    }
+    else
+    {
+        if (next == end)
+        {
+            size_t count = SLABSIZE / blocksize;
+
+            if (!count)
+            {
+                count = 1;
+            }
+
+            next = new byte[count * blocksize];
+            end = next + count * blocksize;
+            slabs.push_back(next);
+        }
+
+        h = (Header*)next;
+        next += blocksize;
+    }
+
+    h->slab = this;
+    live++;
+
+    return h + 1;
+}
+
+void ObjectSlab::release(void* p)
+{
+    if (!p)
+    {
+        return;
+    }
+
+    Header* h = (Header*)p - 1;
+    ObjectSlab* slab = h->slab;
+
+    if (!slab)
+    {
+        ::operator delete(h);
+        return;
+    }
+
+    *(void**)p = slab->freelist;
+    slab->freelist = h;
+    slab->live--;
+}
+
+void ObjectSlab::trim()
+{
+    if (live)
+    {
+        return;
+    }
+
+    for (unsigned i = 0; i < slabs.size(); i++)
+    {
+        delete[] slabs[i];
+    }
+
+    slabs.clear();
+    next = NULL;
+    end = NULL;
+    freelist = NULL;
+}
+
+size_t ObjectSlab::footprint() const
+{
+    return slabs.size() * (SLABSIZE / blocksize ? SLABSIZE / blocksize : 1) * blocksize;
+}
+} // namespace
@@ -39,9 +39,18 @@ void Command::cancel()
 }
 
 // returns completed command JSON string
-const char* Command::getstring() const
+const string& Command::getstring() const
 {
-    return json.c_str();
+    return json;
+}
+
+// base64-encode binary data straight into the command string
+void Command::appendbase64(const byte* data, int len)
+{
+    size_t size = json.size();
+
+    json.resize(size + len * 4 / 3 + 4);
+    json.resize(size + Base64::btoa(data, len, (char*)json.data() + size));
 }
 
 // add opcode
@@ -85,13 +94,12 @@ void Command::arg(const char* name, const char* value, int quotes)
 // binary data
 void Command::arg(const char* name, const byte* value, int len)
 {
-    char* buf = new char[len * 4 / 3 + 4];
-
-    Base64::btoa(value, len, buf);
-
-    arg(name, buf);
-
-    delete[] buf;
+    addcomma();
+    json.append("\"");
+    json.append(name);
+    json.append("\":\"");
+    appendbase64(value, len);
+    json.append("\"");
 }
 
 // 64-bit signed integer
@@ -183,15 +191,8 @@ void Command::element(handle h, int len)
 // add binary data
 void Command::element(const byte* data, int len)
 {
-    char* buf = new char[len * 4 / 3 + 4];
-
-    len = Base64::btoa(data, len, buf);
-
     json.append(elements() ? ",\"" : "\"");
-    json.append(buf, len);
-
-    delete[] buf;
-
+    appendbase64(data, len);
     json.append("\"");
 }
 
@@ -209,21 +209,86 @@ void CommandAttachFA::procresult()
 CommandPutFile::CommandPutFile(TransferSlot* ctslot, int ms)
 {
     tslot = ctslot;
+    transfer = NULL;
 
     cmd("u");
     arg("s", tslot->fa->size);
     arg("ms", ms);
 }
 
+// prefetch the upload URL of a queued transfer (for the size of its
+// fingerprint)
+CommandPutFile::CommandPutFile(Transfer* ctransfer, int ms)
+{
+    tslot = NULL;
+    transfer = ctransfer;
+    transfer->tempurlsize = transfer->size;
+
+    cmd("u");
+    arg("s", transfer->size);
+    arg("ms", ms);
+}
+
 void CommandPutFile::cancel()
 {
     Command::cancel();
     tslot = NULL;
+    transfer = NULL;
+}
+
+void CommandPutFile::attach(TransferSlot* ctslot)
+{
+    transfer->tempurlcmd = NULL;
+    transfer = NULL;
+
+    tslot = ctslot;
+    tslot->pendingcmd = this;
 }
 
 // set up file transfer with returned target URL
 void CommandPutFile::procresult()
 {
+    if (transfer)
+    {
+        // prefetch for a queued transfer: failures are left to the request
+        // of its slot
+        Transfer* t = transfer;
+
+        t->tempurlcmd = NULL;
+        t->tempurl.clear();
+
+        if (client->json.isnumeric())
+        {
+            client->json.getint();
+            return;
+        }
+
+        for (;;)
+        {
+            switch (client->json.getnameid())
+            {
+                case 'p':
+                    client->json.storeobject(&t->tempurl);
+                    break;
+
+                case EOO:
+                    if (t->tempurl.size())
+                    {
+                        t->tempurlds = Waiter::ds;
+                        client->httpio->prefetchdns(&t->tempurl);
+                    }
+                    return;
+
+                default:
+                    if (!client->json.storeobject())
+                    {
+                        t->tempurl.clear();
+                        return;
+                    }
+            }
+        }
+    }
+
     if (tslot)
     {
         tslot->pendingcmd = NULL;
@@ -248,7 +313,11 @@ void CommandPutFile::procresult()
         switch (client->json.getnameid())
         {
             case 'p':
-                client->json.storeobject(canceled ? NULL : &tslot->tempurl);
+                if (client->json.storeobject(canceled ? NULL : &tslot->tempurl) && !canceled)
+                {
+                    // resolve the storage host while the upload is set up
+                    client->httpio->prefetchdns(&tslot->tempurl);
+                }
                 break;
 
             case EOO:
@@ -317,7 +386,10 @@ void CommandDirectRead::procresult()
             switch (client->json.getnameid())
             {
                 case 'g':
-                    client->json.storeobject(drn ? &drn->tempurl : NULL);
+                    if (client->json.storeobject(drn ? &drn->tempurl : NULL) && drn)
+                    {
+                        client->httpio->prefetchdns(&drn->tempurl);
+                    }
                     e = API_OK;
                     break;
 
@@ -361,6 +433,32 @@ void CommandDirectRead::procresult()
 
 // request temporary source URL for full-file access (p == private node)
 CommandGetFile::CommandGetFile(TransferSlot* ctslot, byte* key, handle h, bool p, const char *auth)
+{
+    args(h, p, auth);
+
+    tslot = ctslot;
+    ph = h;
+    transfer = NULL;
+    prefetch = false;
+
+    if (!tslot)
+    {
+        memcpy(filekey, key, FILENODEKEYLENGTH);
+    }
+}
+
+// prefetch the source URL of a queued transfer
+CommandGetFile::CommandGetFile(Transfer* ctransfer, handle h, bool p, const char *auth)
+{
+    args(h, p, auth);
+
+    tslot = NULL;
+    ph = h;
+    transfer = ctransfer;
+    prefetch = true;
+}
+
+void CommandGetFile::args(handle h, bool p, const char *auth)
 {
     cmd("g");
     arg(p || auth ? "n" : "p", (byte*)&h, MegaClient::NODEHANDLE);
@@ -377,25 +475,98 @@ CommandGetFile::CommandGetFile(TransferSlot* ctslot, byte* key, handle h, bool p
             arg("esid", auth);
         }
     }
-
-    tslot = ctslot;
-    ph = h;
-
-    if (!tslot)
-    {
-        memcpy(filekey, key, FILENODEKEYLENGTH);
-    }
 }
 
 void CommandGetFile::cancel()
 {
     Command::cancel();
     tslot = NULL;
+    transfer = NULL;
+}
+
+void CommandGetFile::attach(TransferSlot* ctslot)
+{
+    transfer->tempurlcmd = NULL;
+    transfer = NULL;
+
+    tslot = ctslot;
+    tslot->pendingcmd = this;
+}
+
+// store the URL prefetched for a queued transfer - failures are left to the
+// request of its slot
+void CommandGetFile::procprefetch()
+{
+    Transfer* t = transfer;
+    string url, fileattrstring;
+    int fileattrsmutable = 0;
+    error e = API_OK;
+    int d = 0;
+
+    if (t)
+    {
+        t->tempurlcmd = NULL;
+    }
+
+    if (client->json.isnumeric())
+    {
+        client->json.getint();
+        return;
+    }
+
+    for (;;)
+    {
+        switch (client->json.getnameid())
+        {
+            case 'g':
+                client->json.storeobject(&url);
+                break;
+
+            case 'd':
+                d = 1;
+                break;
+
+            case 'e':
+                e = (error)client->json.getint();
+                break;
+
+            case MAKENAMEID2('f', 'a'):
+                client->json.storeobject(&fileattrstring);
+                break;
+
+            case MAKENAMEID3('p', 'f', 'a'):
+                fileattrsmutable = (int)client->json.getint();
+                break;
+
+            case EOO:
+                if (t && !d && e == API_OK && url.size())
+                {
+                    t->tempurl.swap(url);
+                    t->fileattrstring.swap(fileattrstring);
+                    t->fileattrsmutable = fileattrsmutable;
+                    t->tempurlds = Waiter::ds;
+
+                    client->httpio->prefetchdns(&t->tempurl);
+                }
+                return;
+
+            default:
+                if (!client->json.storeobject())
+                {
+                    return;
+                }
+        }
+    }
 }
 
 // process file credentials
 void CommandGetFile::procresult()
 {
+    if (prefetch && !tslot)
+    {
+        return procprefetch();
+    }
+
     if (tslot)
     {
         tslot->pendingcmd = NULL;
@@ -435,7 +606,11 @@ void CommandGetFile::procresult()
         switch (client->json.getnameid())
         {
             case 'g':
-                client->json.storeobject(tslot ? &tslot->tempurl : NULL);
+                if (client->json.storeobject(tslot ? &tslot->tempurl : NULL) && tslot)
+                {
+                    // resolve the storage host while the attributes are processed
+                    client->httpio->prefetchdns(&tslot->tempurl);
+                }
                 e = API_OK;
                 break;
 
@@ -689,6 +864,19 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, handle th,
     nnsize = numnodes;
     type = userhandle ? USER_HANDLE : NODE_HANDLE;
     source = csource;
+    tree = NULL;
+    treebatch = 0;
+
+    // size estimate: base64 versions of the attributes and keys plus the
+    // fixed fields of each node
+    size_t estimate = 128;
+
+    for (i = 0; i < numnodes; i++)
+    {
+        estimate += 128 + (nn[i].attrstring->size() + nn[i].nodekey.size()) * 4 / 3;
+    }
+
+    json.reserve(estimate);
 
     cmd("p");
     notself(client);
@@ -827,6 +1015,16 @@ void CommandPutNodes::procresult()
 #endif
         if (source == PUTNODES_APP)
         {
+            if (batchtags.size())
+            {
+                return client->putnodes_batch_result(e, type, nn, nnsize, &batchtags);
+            }
+
+            if (tree)
+            {
+                return client->putnodes_tree_result(e, tree, treebatch, nn, nnsize);
+            }
+
             return client->app->putnodes_result(e, type, nn);
         }
 #ifdef ENABLE_SYNC
@@ -877,7 +1075,18 @@ void CommandPutNodes::procresult()
 #endif
                 if (source == PUTNODES_APP)
                 {
-                    client->app->putnodes_result(e, type, nn);
+                    if (batchtags.size())
+                    {
+                        client->putnodes_batch_result(e, type, nn, nnsize, &batchtags);
+                    }
+                    else if (tree)
+                    {
+                        client->putnodes_tree_result(e, tree, treebatch, nn, nnsize);
+                    }
+                    else
+                    {
+                        client->app->putnodes_result(e, type, nn);
+                    }
                 }
 #ifdef ENABLE_SYNC
                 else
@@ -896,6 +1105,10 @@ CommandMoveNode::CommandMoveNode(MegaClient* client, Node* n, Node* t, syncdel_t
     syncdel = csyncdel;
     pp = prevparent;
     syncop = pp != UNDEF;
+#ifdef ENABLE_SYNC
+    batch = NULL;
+    batchindex = 0;
+#endif
 
     cmd("m");
     notself(client);
@@ -911,94 +1124,34 @@ CommandMoveNode::CommandMoveNode(MegaClient* client, Node* n, Node* t, syncdel_t
 
 void CommandMoveNode::procresult()
 {
+    error e;
+
     if (client->json.isnumeric())
     {
-        error e = (error)client->json.getint();
-#ifdef ENABLE_SYNC
-        if (syncdel != SYNCDEL_NONE)
-        {
-            Node* syncn = client->nodebyhandle(h);
-
-            if (syncn)
-            {
-                if (e == API_OK)
-                {
-                    Node* n;
-
-                    // update all todebris records in the subtree
-                    for (node_set::iterator it = client->todebris.begin(); it != client->todebris.end(); it++)
-                    {
-                        n = *it;
-
-                        do {
-                            if (n == syncn)
-                            {
-                                if(syncop)
-                                {
-                                    Sync* sync = NULL;
-                                    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
-                                    {
-                                        if((*it)->tag == tag)
-                                        {
-                                            sync = (*it);
-                                            break;
-                                        }
-                                    }
-
-                                    if(sync)
-                                    {
-                                        if (n->type == FOLDERNODE)
-                                        {
-                                            sync->client->app->syncupdate_remote_folder_deletion(sync, n);
-                                        }
-                                        else
-                                        {
-                                            sync->client->app->syncupdate_remote_file_deletion(sync, n);
-                                        }
-                                    }
-                                }
-
-                                (*it)->syncdeleted = syncdel;
-                                break;
-                            }
-                        } while ((n = n->parent));
-                    }
-                }
-                else
-                {
-                    syncn->syncdeleted = SYNCDEL_NONE;
-                }
-            }
-        }
-        else if(syncop)
-        {
-            Node *n = client->nodebyhandle(h);
-            if(n)
-            {
-                Sync *sync = NULL;
-                for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
-                {
-                    if((*it)->tag == tag)
-                    {
-                        sync = (*it);
-                        break;
-                    }
-                }
-
-                if(sync)
-                {
-                    client->app->syncupdate_remote_move(sync, n, client->nodebyhandle(pp));
-                }
-            }
-        }
-#endif
-        client->app->rename_result(h, e);
+        e = (error)client->json.getint();
     }
     else
     {
         client->json.storeobject();
-        client->app->rename_result(h, API_EINTERNAL);
+        e = API_EINTERNAL;
     }
+
+#ifdef ENABLE_SYNC
+    // sync-originated moves are processed with the rest of their batch
+    if (batch)
+    {
+        batch->moves[batchindex].e = e;
+
+        if (!--batch->pending)
+        {
+            client->movebatch_result(batch);
+        }
+
+        return;
+    }
+#endif
+
+    client->app->rename_result(h, e);
 }
 
 CommandDelNode::CommandDelNode(MegaClient* client, handle th)
@@ -1100,11 +1253,18 @@ void CommandLogout::procresult()
     MegaApp *app = client->app;
     if(!e)
     {
+        client->waitsc();
+
         if (client->sctable)
         {
             client->sctable->remove();
         }
 
+        if (client->tlstable)
+        {
+            client->tlstable->remove();
+        }
+
 #ifdef ENABLE_SYNC
         for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
         {
@@ -1150,6 +1310,8 @@ CommandLogin::CommandLogin(MegaClient* client, const char* email, uint64_t email
 // process login result
 void CommandLogin::procresult()
 {
+    client->startup.end(STARTUP_LOGIN);
+
     if (client->json.isnumeric())
     {
         return client->app->login_result((error)client->json.getint());
@@ -1346,6 +1508,7 @@ CommandSetShare::CommandSetShare(MegaClient* client, Node* n, User* u, accesslev
     sh = n->nodehandle;
     user = u;
     access = a;
+    sharekeys = NULL;
 
     cmd("s2");
     arg("n", (byte*)&sh, MegaClient::NODEHANDLE);
@@ -1406,13 +1569,27 @@ CommandSetShare::CommandSetShare(MegaClient* client, Node* n, User* u, accesslev
     // the share key
     if (newshare)
     {
-        // the new share's nodekeys for this user: generate node list
-        TreeProcShareKeys tpsk(n);
-        client->proctree(n, &tpsk);
-        tpsk.get(this);
+        // the new share's nodekeys for this user: generate node list (large
+        // trees: the first batch goes with the share, the others follow
+        // through CommandShareKeyBatch)
+        sharekeys = new TreeProcShareKeys(n);
+        client->proctree(n, sharekeys);
+        sharekeys->encrypt(client->workerpool);
+        sharekeys->get(this, 0, CommandShareKeyBatch::BATCHSIZE);
+
+        if (sharekeys->size() <= CommandShareKeyBatch::BATCHSIZE)
+        {
+            delete sharekeys;
+            sharekeys = NULL;
+        }
     }
 }
 
+CommandSetShare::~CommandSetShare()
+{
+    delete sharekeys;
+}
+
 // process user element (email/handle pairs)
 bool CommandSetShare::procuserresult(MegaClient* client)
 {
@@ -1522,6 +1699,12 @@ void CommandSetShare::procresult()
                 break;
 
             case EOO:
+                if (sharekeys)
+                {
+                    client->reqs[client->r].add(new CommandShareKeyBatch(sharekeys, CommandShareKeyBatch::BATCHSIZE));
+                    sharekeys = NULL;
+                }
+
                 client->app->share_result(API_OK);
                 return;
 
@@ -1956,6 +2139,11 @@ void CommandGetUA::procresult()
         }
 #endif
 
+        if (e == API_ENOENT && user && user->cacheua(&attributename, NULL, 0))
+        {
+            client->notifyuser(user);
+        }
+
         return(client->app->getua_result(e));
     }
     else
@@ -2005,10 +2193,18 @@ void CommandGetUA::procresult()
                     return;
                 }
             }
+            if (user && user->cacheua(&attributename, (byte*)d.data(), d.size()))
+            {
+                client->notifyuser(user);
+            }
             client->app->getua_result((byte*)d.data(), d.size());
         }
         else if (!priv || priv == 2)
         {
+            if (user && user->cacheua(&attributename, data, l))
+            {
+                client->notifyuser(user);
+            }
             client->app->getua_result(data, l);
         }
         else
@@ -2096,6 +2292,31 @@ CommandKeyCR::CommandKeyCR(MegaClient* client, node_vector* rshares, node_vector
     endarray();
 }
 
+CommandShareKeyBatch::CommandShareKeyBatch(TreeProcShareKeys* tpsk, unsigned first)
+{
+    sharekeys = tpsk;
+    next = first + BATCHSIZE;
+
+    cmd("k");
+    sharekeys->get(this, first, BATCHSIZE);
+}
+
+CommandShareKeyBatch::~CommandShareKeyBatch()
+{
+    delete sharekeys;
+}
+
+void CommandShareKeyBatch::procresult()
+{
+    Command::procresult();
+
+    if (next < sharekeys->size())
+    {
+        client->reqs[client->r].add(new CommandShareKeyBatch(sharekeys, next));
+        sharekeys = NULL;
+    }
+}
+
 // a == ACCESS_UNKNOWN: request public key for user handle and respond with
 // share key for sn
 // otherwise: request public key for user handle and continue share creation
@@ -2923,19 +3144,82 @@ void CommandSetKeyPair::procresult()
 }
 
 // fetch full node tree
-CommandFetchNodes::CommandFetchNodes(MegaClient* client)
+// !recursive: the root and its children only (partial tree fetch)
+CommandFetchNodes::CommandFetchNodes(MegaClient* client, bool recursive)
+{
+    cmd("f");
+    arg("c", "1", 0);
+
+    if (recursive)
+    {
+        arg("r", "1", 0);
+    }
+
+    tag = client->reqtag;
+}
+
+CommandFetchChildren::CommandFetchChildren(MegaClient* client, handle ch, bool crecursive)
 {
+    h = ch;
+    recursive = crecursive;
+
     cmd("f");
     arg("c", "1", 0);
-    arg("r", "1", 0);
+    arg("n", (byte*)&h, MegaClient::NODEHANDLE);
+
+    if (recursive)
+    {
+        arg("r", "1", 0);
+    }
 
     tag = client->reqtag;
 }
 
+// merge the fetched level(s) into the tree
+void CommandFetchChildren::procresult()
+{
+    client->childfetches.erase(h);
+
+    if (client->json.isnumeric())
+    {
+        return client->app->fetchchildren_result(h, (error)client->json.getint());
+    }
+
+    for (;;)
+    {
+        switch (client->json.getnameid())
+        {
+            case 'f':
+                if (!client->readnodes(&client->json, 1))
+                {
+                    return client->app->fetchchildren_result(h, API_EINTERNAL);
+                }
+                break;
+
+            case EOO:
+                client->childrenfetched(h, recursive);
+                return client->app->fetchchildren_result(h, API_OK);
+
+            default:
+                if (!client->json.storeobject())
+                {
+                    return client->app->fetchchildren_result(h, API_EINTERNAL);
+                }
+        }
+    }
+}
+
 // purge and rebuild node/user tree
 void CommandFetchNodes::procresult()
 {
-    client->purgenodesusersabortsc();
+    client->tracefetchnodes();
+
+    // a streamed response has already replaced the state
+    if (client->fnstream == MegaClient::FNSTREAM_OFF)
+    {
+        client->purgenodesusersabortsc();
+    }
+
     client->fetchingnodes = false;
 
     if (client->json.isnumeric())
@@ -2949,10 +3233,14 @@ void CommandFetchNodes::procresult()
         {
             case 'f':
                 // nodes
+                client->startup.begin(STARTUP_READNODES);
                 if (!client->readnodes(&client->json, 0))
                 {
                     return client->app->fetchnodes_result(API_EINTERNAL);
                 }
+                client->startup.end(STARTUP_READNODES, 0, client->nodes.size());
+
+                client->endfetchnodesstream();
                 break;
 
             case MAKENAMEID2('o', 'k'):
@@ -3009,12 +3297,25 @@ void CommandFetchNodes::procresult()
                     return client->app->fetchnodes_result(API_EINTERNAL);
                 }
 
+                client->startup.begin(STARTUP_SHARES);
                 client->mergenewshares(0);
+                client->startup.end(STARTUP_SHARES);
+
+                client->startup.begin(STARTUP_KEYS);
                 client->applykeys();
+                client->startup.end(STARTUP_KEYS);
+
+                if (client->partialfetching)
+                {
+                    client->markpartial();
+                }
+
+                client->reportnodememory();
 #ifdef ENABLE_SYNC
                 client->syncsup = false;
 #endif
                 client->app->fetchnodes_result(API_OK);
+                client->startup.begin(STARTUP_CURRENT);
                 client->initsc();
 
                 // NULL vector: "notify all nodes"
@@ -0,0 +1,284 @@
+/**
+ * @file crc32.cpp
+ * @brief CRC-32 (IEEE) with runtime CPU dispatch
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/crc32.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_PCLMUL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && defined(__aarch64__) && defined(__linux__)
+#define CRC32_ARMV8 1
+#include <sys/auxv.h>
+#include <arm_acle.h>
+#endif
+
+namespace mega {
+// reflected polynomial 0xedb88320, four tables for slicing-by-4
+static uint32_t crctables[4][256];
+
+static int initcrctables()
+{
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+
+        for (int k = 8; k--; )
+        {
+            c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+
+        crctables[0][i] = c;
+    }
+
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        for (int t = 1; t < 4; t++)
+        {
+            crctables[t][i] = (crctables[t - 1][i] >> 8) ^ crctables[0][crctables[t - 1][i] & 0xff];
+        }
+    }
+
+    return 0;
+}
+
+static int crctablesinit = initcrctables();
+
+// on the inverted CRC
+static uint32_t table(uint32_t c, const byte* data, unsigned len)
+{
+    while (len >= 4)
+    {
+        c ^= data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+        c = crctables[3][c & 0xff] ^ crctables[2][(c >> 8) & 0xff]
+          ^ crctables[1][(c >> 16) & 0xff] ^ crctables[0][c >> 24];
+
+        data += 4;
+        len -= 4;
+    }
+
+    while (len--)
+    {
+        c = crctables[0][(c ^ *data++) & 0xff] ^ (c >> 8);
+    }
+
+    return c;
+}
+
+#ifdef CRC32_PCLMUL
+static bool detect()
+{
+    unsigned a, b, c, d;
+
+    // PCLMULQDQ and SSE4.1
+    return __get_cpuid(1, &a, &b, &c, &d) && (c & (1 << 1)) && (c & (1 << 19));
+}
+
+// folding by four 128-bit lanes with the constants of Intel's "Fast CRC
+// Computation for Generic Polynomials Using PCLMULQDQ Instruction" for the
+// reflected IEEE polynomial - len >= 64, a multiple of 16, on the inverted CRC
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t foldpclmul(uint32_t crc, const byte* buf, unsigned len)
+{
+    static const uint64_t k1k2[2] __attribute__((aligned(16))) = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const uint64_t k3k4[2] __attribute__((aligned(16))) = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const uint64_t k5k0[2] __attribute__((aligned(16))) = { 0x0163cd6124ULL, 0x0000000000ULL };
+    static const uint64_t poly[2] __attribute__((aligned(16))) = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i*)(buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i*)(buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i*)(buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i*)(buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    // fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+#ifdef CRC32_ARMV8
+static bool detect()
+{
+    return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+// on the inverted CRC
+__attribute__((target("+crc")))
+static uint32_t armv8crc(uint32_t crc, const byte* buf, unsigned len)
+{
+    while (len >= 8)
+    {
+        uint64_t v;
+
+        memcpy(&v, buf, sizeof v);
+        crc = __crc32d(crc, v);
+
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len--)
+    {
+        crc = __crc32b(crc, *buf++);
+    }
+
+    return crc;
+}
+#endif
+
+#if defined(CRC32_PCLMUL) || defined(CRC32_ARMV8)
+// the hardware path must agree with the tables
+static bool selfcheck()
+{
+    byte buf[203];
+
+    for (unsigned i = 0; i < sizeof buf; i++)
+    {
+        buf[i] = (byte)(i * 167 + 5);
+    }
+
+#ifdef CRC32_PCLMUL
+    uint32_t c = foldpclmul(~0U, buf, 192);
+    c = table(c, buf + 192, sizeof buf - 192);
+#else
+    uint32_t c = armv8crc(~0U, buf, sizeof buf);
+#endif
+
+    return c == table(~0U, buf, sizeof buf);
+}
+
+static bool hardware = detect() && selfcheck();
+#else
+static bool hardware = false;
+#endif
+
+bool FastCRC32::accelerated()
+{
+    return hardware;
+}
+
+uint32_t FastCRC32::update(uint32_t crc, const byte* data, unsigned len)
+{
+    crc = ~crc;
+
+#ifdef CRC32_PCLMUL
+    if (hardware && len >= 64)
+    {
+        unsigned folded = len & ~15U;
+
+        crc = foldpclmul(crc, data, folded);
+
+        data += folded;
+        len -= folded;
+    }
+#endif
+
+#ifdef CRC32_ARMV8
+    if (hardware)
+    {
+        return ~armv8crc(crc, data, len);
+    }
+#endif
+
+    return ~table(crc, data, len);
+}
+} // namespace
@@ -46,11 +46,183 @@ uint32_t PrnGen::genuint32(uint64_t max)
     return (uint32_t)(((uint64_t)t) / ((((uint64_t)(~(uint32_t)0)) + 1) / max));
 }
 
+CryptoBackend* CryptoBackend::active = NULL;
+
+// deterministic test pattern
+static void selftestpattern(byte* buf, unsigned len, unsigned seed)
+{
+    for (unsigned i = 0; i < len; i++)
+    {
+        buf[i] = (byte)(i * 167 + seed * 13 + 5);
+    }
+}
+
+static bool selftestcheck(CryptoBackend* b, const char* primitive, const byte* expected, const byte* actual, unsigned len)
+{
+    if (memcmp(expected, actual, len))
+    {
+        LOG_err << "Crypto backend " << b->name() << ": " << primitive << " mismatch";
+        return false;
+    }
+
+    return true;
+}
+
+bool CryptoBackend::selftest(CryptoBackend* b)
+{
+    const unsigned len = 5 * AES::BLOCKSIZE;
+    byte key[AES::BLOCKSIZE], iv[AES::BLOCKSIZE], plain[len], expected[len], actual[len];
+    bool ok = true;
+
+    selftestpattern(key, sizeof key, 1);
+    selftestpattern(iv, sizeof iv, 2);
+    selftestpattern(plain, sizeof plain, 3);
+
+    void* ctx = b->aeskey(NULL, key);
+
+    if (ctx)
+    {
+        ECB_Mode<AES>::Encryption ecbe;
+        ECB_Mode<AES>::Decryption ecbd;
+
+        ecbe.SetKey(key, sizeof key);
+        ecbd.SetKey(key, sizeof key);
+
+        ecbe.ProcessData(expected, plain, len);
+        ok = b->ecb_encrypt(ctx, plain, actual, len) && selftestcheck(b, "AES-ECB encryption", expected, actual, len) && ok;
+
+        ecbd.ProcessData(expected, plain, len);
+        ok = b->ecb_decrypt(ctx, plain, actual, len) && selftestcheck(b, "AES-ECB decryption", expected, actual, len) && ok;
+
+        CBC_Mode<AES>::Encryption cbce;
+        CBC_Mode<AES>::Decryption cbcd;
+
+        cbce.SetKeyWithIV(key, sizeof key, iv);
+        cbcd.SetKeyWithIV(key, sizeof key, iv);
+
+        cbce.ProcessData(expected, plain, len);
+        memcpy(actual, plain, len);
+        ok = b->cbc_encrypt(ctx, iv, actual, len) && selftestcheck(b, "AES-CBC encryption", expected, actual, len) && ok;
+
+        cbcd.ProcessData(expected, plain, len);
+        memcpy(actual, plain, len);
+        ok = b->cbc_decrypt(ctx, iv, actual, len) && selftestcheck(b, "AES-CBC decryption", expected, actual, len) && ok;
+
+        // the counter carries into the upper 64 bits
+        byte ctr[AES::BLOCKSIZE];
+        memset(ctr, 0xff, sizeof ctr);
+        ctr[0] = 0x12;
+        ctr[7] = 0x34;
+        ctr[15] = 0xfd;
+
+        CTR_Mode<AES>::Encryption ctre;
+
+        ctre.SetKeyWithIV(key, sizeof key, ctr);
+
+        ctre.ProcessData(expected, plain, len);
+        memcpy(actual, plain, len);
+        ok = b->ctr_crypt(ctx, ctr, actual, len) && selftestcheck(b, "AES-CTR", expected, actual, len) && ok;
+
+        // rekeying an existing context
+        selftestpattern(key, sizeof key, 4);
+        ecbe.SetKey(key, sizeof key);
+        ecbe.ProcessData(expected, plain, len);
+
+        if ((ctx = b->aeskey(ctx, key)))
+        {
+            ok = b->ecb_encrypt(ctx, plain, actual, len) && selftestcheck(b, "AES rekeying", expected, actual, len) && ok;
+            b->aesfree(ctx);
+        }
+        else
+        {
+            LOG_err << "Crypto backend " << b->name() << ": AES rekeying failed";
+            ok = false;
+        }
+    }
+
+    uint32_t crc = 0;
+
+    if (b->crc32(&crc, plain, len - 3))
+    {
+        CRC32 ref;
+        byte out[4];
+
+        ref.Update(plain, len - 3);
+        ref.Final(expected);
+
+        for (int i = 0; i < 4; i++)
+        {
+            out[i] = (byte)(crc >> (8 * i));
+        }
+        ok = selftestcheck(b, "CRC32", expected, out, sizeof out) && ok;
+    }
+
+    // a small key suffices for checking the arithmetic
+    AsymmCipher rsa;
+    Integer pubk[AsymmCipher::PUBKEY];
+
+    rsa.genkeypair(rsa.key, pubk, 512);
+
+    unsigned moduluslen = pubk[AsymmCipher::PUB_PQ].ByteCount();
+    string components[AsymmCipher::PRIVKEY];
+    const byte* keydata[AsymmCipher::PRIVKEY];
+    unsigned keylen[AsymmCipher::PRIVKEY];
+
+    for (int i = AsymmCipher::PRIVKEY; i--; )
+    {
+        components[i].resize(rsa.key[i].ByteCount());
+        rsa.key[i].Encode((byte*)components[i].data(), components[i].size());
+        keydata[i] = (const byte*)components[i].data();
+        keylen[i] = components[i].size();
+    }
+
+    Integer m(plain, moduluslen - 1);
+    Integer c = a_exp_b_mod_c(m, pubk[AsymmCipher::PUB_E], pubk[AsymmCipher::PUB_PQ]);
+    string cipher(moduluslen, 0), result(moduluslen, 0), reference(moduluslen, 0);
+
+    c.Encode((byte*)cipher.data(), moduluslen);
+    m.Encode((byte*)reference.data(), moduluslen);
+
+    if (b->rsa_decrypt(keydata, keylen, (const byte*)cipher.data(), moduluslen, (byte*)result.data(), moduluslen))
+    {
+        ok = selftestcheck(b, "RSA decryption", (const byte*)reference.data(), (const byte*)result.data(), moduluslen) && ok;
+    }
+
+    return ok;
+}
+
+bool CryptoBackend::install(CryptoBackend* b)
+{
+    if (b && !selftest(b))
+    {
+        LOG_err << "Crypto backend " << b->name() << " failed the self-test";
+        return false;
+    }
+
+    if (b)
+    {
+        LOG_info << "Using crypto backend " << b->name();
+    }
+
+    active = b;
+    return true;
+}
+
 SymmCipher::SymmCipher(const byte* key)
 {
+    backend = NULL;
+    accel = NULL;
     setkey(key);
 }
 
+SymmCipher::~SymmCipher()
+{
+    if (accel)
+    {
+        backend->aesfree(accel);
+    }
+}
+
 byte SymmCipher::zeroiv[BLOCKSIZE];
 
 void SymmCipher::setkey(const byte* newkey, int type)
@@ -70,6 +242,24 @@ void SymmCipher::setkey(const byte* newkey, int type)
 
     aesccm_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
     aesccm_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+
+    aesctr_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+
+    if (backend != CryptoBackend::active)
+    {
+        if (accel)
+        {
+            backend->aesfree(accel);
+            accel = NULL;
+        }
+
+        backend = CryptoBackend::active;
+    }
+
+    if (backend)
+    {
+        accel = backend->aeskey(accel, key);
+    }
 }
 
 bool SymmCipher::setkey(const string* key)
@@ -96,6 +286,11 @@ bool SymmCipher::setkey(const string* key)
  */
 void SymmCipher::cbc_encrypt(byte* data, unsigned len, const byte* iv)
 {
+    if (accel && backend->cbc_encrypt(accel, iv ? iv : zeroiv, data, len))
+    {
+        return;
+    }
+
     aescbc_e.Resynchronize(iv ? iv : zeroiv);
     aescbc_e.ProcessData(data, data, len);
 }
@@ -112,6 +307,11 @@ void SymmCipher::cbc_encrypt(byte* data, unsigned len, const byte* iv)
  */
 void SymmCipher::cbc_decrypt(byte* data, unsigned len, const byte* iv)
 {
+    if (accel && backend->cbc_decrypt(accel, iv ? iv : zeroiv, data, len))
+    {
+        return;
+    }
+
     aescbc_d.Resynchronize(iv ? iv : zeroiv);
     aescbc_d.ProcessData(data, data, len);
 }
@@ -163,6 +363,11 @@ void SymmCipher::cbc_decrypt_pkcs_padding(const std::string *data, const byte *i
  */
 void SymmCipher::ecb_encrypt(byte* data, byte* dst, unsigned len)
 {
+    if (accel && backend->ecb_encrypt(accel, data, dst ? dst : data, len))
+    {
+        return;
+    }
+
     aesecb_e.ProcessData(dst ? dst : data, data, len);
 }
 
@@ -176,6 +381,11 @@ void SymmCipher::ecb_encrypt(byte* data, byte* dst, unsigned len)
  */
 void SymmCipher::ecb_decrypt(byte* data, unsigned len)
 {
+    if (accel && backend->ecb_decrypt(accel, data, data, len))
+    {
+        return;
+    }
+
     aesecb_d.ProcessData(data, data, len);
 }
 
@@ -344,6 +554,8 @@ void SymmCipher::incblock(byte* dst, unsigned len)
 
 SymmCipher::SymmCipher(const SymmCipher &ref)
 {
+    backend = NULL;
+    accel = NULL;
     setkey(ref.key);
 }
 
@@ -360,7 +572,7 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
-    byte ctr[BLOCKSIZE], tmp[BLOCKSIZE];
+    byte ctr[BLOCKSIZE];
 
     MemAccess::set<int64_t>(ctr,ctriv);
     setint64(pos / BLOCKSIZE, ctr + sizeof ctriv);
@@ -369,45 +581,72 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
     {
         memcpy(mac, ctr, sizeof ctriv);
         memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
-    }
 
-    while ((int)len > 0)
-    {
         if (encrypt)
         {
-            if(mac)
-            {
-                xorblock(data, mac);
-                ecb_encrypt(mac);
-            }
-
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+            cbc_macs(&data, &len, mac, 1);
         }
-        else
+    }
+
+    // the padding is processed as well, as callers expect whole blocks
+    if (!accel || !backend->ctr_crypt(accel, ctr, data, (len + BLOCKSIZE - 1) & -BLOCKSIZE))
+    {
+        aesctr_e.Resynchronize(ctr);
+        aesctr_e.ProcessData(data, data, (len + BLOCKSIZE - 1) & -BLOCKSIZE);
+    }
+
+    if (mac && !encrypt)
+    {
+        cbc_macs(&data, &len, mac, 1);
+    }
+}
+
+void SymmCipher::cbc_macs(const byte* const* data, const unsigned* len, byte* macs, unsigned n)
+{
+    byte buf[MACSTREAMS * BLOCKSIZE];
+    unsigned chain[MACSTREAMS];
+
+    for (unsigned first = 0; first < n; first += MACSTREAMS)
+    {
+        unsigned last = (n - first < MACSTREAMS) ? n : first + MACSTREAMS;
+
+        for (unsigned offset = 0; ; offset += BLOCKSIZE)
         {
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+            unsigned k = 0;
 
-            if (mac)
+            // gather the next block of every chain that is not yet exhausted
+            for (unsigned j = first; j < last; j++)
             {
-                if (len >= (unsigned)BLOCKSIZE)
-                {
-                    xorblock(data, mac);
-                }
-                else
+                if (offset < len[j])
                 {
-                    xorblock(data, mac, len);
+                    byte* mac = macs + j * BLOCKSIZE;
+
+                    if (len[j] - offset >= (unsigned)BLOCKSIZE)
+                    {
+                        xorblock(data[j] + offset, mac);
+                    }
+                    else
+                    {
+                        xorblock(data[j] + offset, mac, len[j] - offset);
+                    }
+
+                    memcpy(buf + k * BLOCKSIZE, mac, BLOCKSIZE);
+                    chain[k++] = j;
                 }
+            }
 
-                ecb_encrypt(mac);
+            if (!k)
+            {
+                break;
             }
-        }
 
-        len -= BLOCKSIZE;
-        data += BLOCKSIZE;
+            ecb_encrypt(buf, NULL, k * BLOCKSIZE);
 
-        incblock(ctr);
+            while (k--)
+            {
+                memcpy(macs + chain[k] * BLOCKSIZE, buf + k * BLOCKSIZE, BLOCKSIZE);
+            }
+        }
     }
 }
 
@@ -473,8 +712,48 @@ int AsymmCipher::encrypt(const byte* plain, int plainlen, byte* buf, int buflen)
     return ptr - buf;
 }
 
+// private key operation by the CryptoBackend, if provided
+static bool backendrsadecrypt(Integer* key, Integer* m)
+{
+    string components[AsymmCipher::PRIVKEY];
+    const byte* keydata[AsymmCipher::PRIVKEY];
+    unsigned keylen[AsymmCipher::PRIVKEY];
+
+    for (int i = AsymmCipher::PRIVKEY; i--; )
+    {
+        components[i].resize(key[i].ByteCount());
+        key[i].Encode((byte*)components[i].data(), components[i].size());
+        keydata[i] = (const byte*)components[i].data();
+        keylen[i] = components[i].size();
+    }
+
+    unsigned len = key[AsymmCipher::PRIV_P].ByteCount() + key[AsymmCipher::PRIV_Q].ByteCount();
+
+    if (m->ByteCount() > len)
+    {
+        return false;
+    }
+
+    string in(len, 0), out(len, 0);
+
+    m->Encode((byte*)in.data(), len);
+
+    if (!CryptoBackend::active->rsa_decrypt(keydata, keylen, (const byte*)in.data(), len, (byte*)out.data(), len))
+    {
+        return false;
+    }
+
+    m->Decode((const byte*)out.data(), len);
+    return true;
+}
+
 static void rsadecrypt(Integer* key, Integer* m)
 {
+    if (CryptoBackend::active && backendrsadecrypt(key, m))
+    {
+        return;
+    }
+
     Integer xp = a_exp_b_mod_c(*m % key[AsymmCipher::PRIV_P],
                                key[AsymmCipher::PRIV_D] % (key[AsymmCipher::PRIV_P] - Integer::One()),
                                key[AsymmCipher::PRIV_P]);
@@ -669,14 +948,33 @@ void HashSHA256::get(std::string *retStr)
     hash.Final((byte*)retStr->data());
 }
 
+HashCRC32::HashCRC32()
+{
+    crc = 0;
+    backend = CryptoBackend::active && CryptoBackend::active->crc32(&crc, NULL, 0);
+}
+
 void HashCRC32::add(const byte* data, unsigned len)
 {
-    hash.Update(data, len);
+    if (backend)
+    {
+        CryptoBackend::active->crc32(&crc, data, len);
+    }
+    else
+    {
+        crc = FastCRC32::update(crc, data, len);
+    }
 }
 
+// little-endian, as Crypto++'s CRC32
 void HashCRC32::get(byte* out)
 {
-    hash.Final(out);
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = (byte)(crc >> (8 * i));
+    }
+
+    crc = 0;
 }
 
 HMACSHA256::HMACSHA256(const byte *key, size_t length)
@@ -0,0 +1,159 @@
+/**
+ * @file openssl.cpp
+ * @brief AES through OpenSSL as an alternate crypto backend.
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#if defined(USE_CRYPTOPP) && defined(USE_OPENSSL) && USE_OPENSSL
+#include <openssl/evp.h>
+
+namespace mega {
+// one EVP context per mode and direction, created on first use
+struct OpenSSLAesContext
+{
+    enum { ECB_E, ECB_D, CBC_E, CBC_D, CTR, NUMMODES };
+
+    byte key[SymmCipher::KEYLENGTH];
+    EVP_CIPHER_CTX* ctx[NUMMODES];
+
+    EVP_CIPHER_CTX* get(int);
+};
+
+EVP_CIPHER_CTX* OpenSSLAesContext::get(int mode)
+{
+    if (!ctx[mode])
+    {
+        const EVP_CIPHER* cipher;
+
+        switch (mode)
+        {
+            case ECB_E:
+            case ECB_D:
+                cipher = EVP_aes_128_ecb();
+                break;
+            case CBC_E:
+            case CBC_D:
+                cipher = EVP_aes_128_cbc();
+                break;
+            default:
+                cipher = EVP_aes_128_ctr();
+        }
+
+        if (!(ctx[mode] = EVP_CIPHER_CTX_new()))
+        {
+            return NULL;
+        }
+
+        if (!EVP_CipherInit_ex(ctx[mode], cipher, NULL, key, NULL, mode != ECB_D && mode != CBC_D))
+        {
+            EVP_CIPHER_CTX_free(ctx[mode]);
+            ctx[mode] = NULL;
+            return NULL;
+        }
+
+        EVP_CIPHER_CTX_set_padding(ctx[mode], 0);
+    }
+
+    return ctx[mode];
+}
+
+// run len bytes through the context, restarting at iv if given
+static bool evpprocess(EVP_CIPHER_CTX* ctx, const byte* iv, const byte* in, byte* out, unsigned len)
+{
+    int outlen;
+
+    if (!ctx || (iv && !EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, -1)))
+    {
+        return false;
+    }
+
+    return EVP_CipherUpdate(ctx, out, &outlen, in, len) && (unsigned)outlen == len;
+}
+
+const char* OpenSSLCryptoBackend::name()
+{
+    return "OpenSSL";
+}
+
+void* OpenSSLCryptoBackend::aeskey(void* c, const byte* key)
+{
+    OpenSSLAesContext* a = (OpenSSLAesContext*)c;
+
+    if (!a)
+    {
+        a = new OpenSSLAesContext;
+        memset(a->ctx, 0, sizeof a->ctx);
+    }
+
+    memcpy(a->key, key, sizeof a->key);
+
+    for (int i = OpenSSLAesContext::NUMMODES; i--; )
+    {
+        if (a->ctx[i] && !EVP_CipherInit_ex(a->ctx[i], NULL, NULL, key, NULL, -1))
+        {
+            EVP_CIPHER_CTX_free(a->ctx[i]);
+            a->ctx[i] = NULL;
+        }
+    }
+
+    return a;
+}
+
+void OpenSSLCryptoBackend::aesfree(void* c)
+{
+    OpenSSLAesContext* a = (OpenSSLAesContext*)c;
+
+    for (int i = OpenSSLAesContext::NUMMODES; i--; )
+    {
+        if (a->ctx[i])
+        {
+            EVP_CIPHER_CTX_free(a->ctx[i]);
+        }
+    }
+
+    delete a;
+}
+
+bool OpenSSLCryptoBackend::ecb_encrypt(void* c, const byte* in, byte* out, unsigned len)
+{
+    return evpprocess(((OpenSSLAesContext*)c)->get(OpenSSLAesContext::ECB_E), NULL, in, out, len);
+}
+
+bool OpenSSLCryptoBackend::ecb_decrypt(void* c, const byte* in, byte* out, unsigned len)
+{
+    return evpprocess(((OpenSSLAesContext*)c)->get(OpenSSLAesContext::ECB_D), NULL, in, out, len);
+}
+
+bool OpenSSLCryptoBackend::cbc_encrypt(void* c, const byte* iv, byte* data, unsigned len)
+{
+    return evpprocess(((OpenSSLAesContext*)c)->get(OpenSSLAesContext::CBC_E), iv, data, data, len);
+}
+
+bool OpenSSLCryptoBackend::cbc_decrypt(void* c, const byte* iv, byte* data, unsigned len)
+{
+    return evpprocess(((OpenSSLAesContext*)c)->get(OpenSSLAesContext::CBC_D), iv, data, data, len);
+}
+
+bool OpenSSLCryptoBackend::ctr_crypt(void* c, const byte* ctr, byte* data, unsigned len)
+{
+    return evpprocess(((OpenSSLAesContext*)c)->get(OpenSSLAesContext::CTR), ctr, data, data, len);
+}
+} // namespace
+#endif
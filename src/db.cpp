@@ -21,11 +21,19 @@
 
 #include "mega/db.h"
 #include "mega/utils.h"
+#include "mega/aesbatch.h"
+#include "mega/waiter.h"
+
+#if defined(HAVE_ZLIB_H) || defined(_WIN32)
+#include <zlib.h>
+#define HAVE_RECORD_DEFLATE 1
+#endif
 
 namespace mega {
 DbTable::DbTable()
 {
     nextid = 0;
+    indexnodes = false;
 }
 
 // add or update record from string
@@ -34,26 +42,242 @@ bool DbTable::put(uint32_t index, string* data)
     return put(index, (char*)data->data(), data->size());
 }
 
+// add or update records one by one
+bool DbTable::putmany(const uint32_t* index, string* data, unsigned count)
+{
+    bool result = true;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(index[i], data + i))
+        {
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+// delete records one by one
+bool DbTable::delmany(const uint32_t* index, unsigned count)
+{
+    bool result = true;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!del(index[i]))
+        {
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+bool DbTable::unindexnodes(const handle* h, unsigned count)
+{
+    bool result = true;
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!unindexnode(h[i]))
+        {
+            result = false;
+        }
+    }
+
+    return result;
+}
+
+// envelope: 4 zero bytes, version, uncompressed size, zlib stream
+void DbTable::compress(string* data)
+{
+#ifdef HAVE_RECORD_DEFLATE
+    uLongf len = compressBound(data->size());
+    string t;
+
+    t.resize(9 + len);
+
+    if (::compress2((Bytef*)t.data() + 9, &len, (const Bytef*)data->data(), data->size(), Z_BEST_SPEED) != Z_OK)
+    {
+        return;
+    }
+
+    // only worth it if at least a tenth is saved
+    if (9 + len > data->size() - data->size() / 10)
+    {
+        return;
+    }
+
+    uint32_t size = data->size();
+
+    memset((char*)t.data(), 0, 4);
+    t[4] = RECORDDEFLATE;
+    memcpy((char*)t.data() + 5, &size, sizeof size);
+
+    t.resize(9 + len);
+    data->swap(t);
+#endif
+}
+
+bool DbTable::decompress(string* data)
+{
+    if (data->size() < 5 || memcmp(data->data(), "\0\0\0\0", 4))
+    {
+        return true;
+    }
+
+#ifdef HAVE_RECORD_DEFLATE
+    if ((byte)(*data)[4] == RECORDDEFLATE && data->size() >= 9)
+    {
+        uint32_t size = MemAccess::get<uint32_t>(data->data() + 5);
+        uLongf len = size;
+        string t;
+
+        t.resize(size);
+
+        if (::uncompress((Bytef*)t.data(), &len, (const Bytef*)data->data() + 9, data->size() - 9) != Z_OK || len != size)
+        {
+            return false;
+        }
+
+        data->swap(t);
+        return true;
+    }
+#endif
+
+    return false;
+}
+
 // add or update record with padding and encryption
 bool DbTable::put(uint32_t type, Cachable* record, SymmCipher* key)
 {
     string data;
+    DbNodeKeys keys;
 
-    if (!record->serialize(&data))
+    if (!encode(type, record, key, &data))
     {
         //Don't return false if there are errors in the serialization
         //to let the SDK continue and save the rest of records
         return true;
     }
 
-    PaddedCBC::encrypt(&data, key);
+    if (!put(record->dbid, &data))
+    {
+        return false;
+    }
+
+    return !indexnodes || !record->dbkeys(&keys) || indexnode(&keys, record->dbid);
+}
+
+bool DbTable::encode(uint32_t type, Cachable* record, SymmCipher* key, string* data)
+{
+    if (!record->serialize(data))
+    {
+        return false;
+    }
+
+    PaddedCBC::encrypt(data, key);
 
     if (!record->dbid)
     {
-        record->dbid = (nextid += IDSPACING) | type;
+        record->dbid = newid(type);
     }
 
-    return put(record->dbid, &data);
+    return true;
+}
+
+DbWriteJob::DbWriteJob(DbTable* ctable, uint32_t clastid)
+{
+    table = ctable;
+    lastid = clastid;
+    complete = false;
+    finished = false;
+    duration = 0;
+}
+
+// the record data is taken over
+void DbWriteJob::add(uint32_t id, string* record)
+{
+    ids.push_back(id);
+    data.push_back(string());
+    data.back().swap(*record);
+}
+
+void DbWriteJob::del(uint32_t id)
+{
+    dels.push_back(id);
+}
+
+void DbWriteJob::index(const DbNodeKeys* k, uint32_t record)
+{
+    keys.push_back(*k);
+    keyrecords.push_back(record);
+}
+
+void DbWriteJob::unindex(handle h)
+{
+    keys.push_back(DbNodeKeys());
+    keys.back().h = h;
+    keyrecords.push_back(0);
+}
+
+void DbWriteJob::run()
+{
+    int64_t start = Waiter::us();
+
+    table->begin();
+
+    complete = true;
+
+    for (unsigned i = 0; i < ids.size() && complete; i++)
+    {
+        complete = table->put(ids[i], &data[i]);
+    }
+
+    if (complete && dels.size())
+    {
+        complete = table->delmany(&dels[0], dels.size());
+    }
+
+    handle_vector unindexed;
+
+    for (unsigned i = 0; i <= keys.size() && complete; i++)
+    {
+        if (i < keys.size() && !keyrecords[i])
+        {
+            unindexed.push_back(keys[i].h);
+            continue;
+        }
+
+        if (unindexed.size())
+        {
+            complete = table->unindexnodes(&unindexed[0], unindexed.size());
+            unindexed.clear();
+        }
+
+        if (complete && i < keys.size())
+        {
+            complete = table->indexnode(&keys[i], keyrecords[i]);
+        }
+    }
+
+    if (complete)
+    {
+        complete = table->put(lastid, &last);
+    }
+
+    if (complete)
+    {
+        table->commit();
+    }
+    else
+    {
+        table->abort();
+    }
+
+    duration = Waiter::us() - start;
+    finished = true;
 }
 
 // get next record, decrypt and unpad
@@ -66,14 +290,68 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
             return true;
         }
 
-        if (*type > nextid)
-        {
-            nextid = *type & - IDSPACING;
-        }
+        trackid(*type);
 
         return PaddedCBC::decrypt(data, key);
     }
 
     return false;
 }
+
+void DbTable::trackid(uint32_t id)
+{
+    if (id > nextid)
+    {
+        nextid = id & - IDSPACING;
+    }
+}
+
+DbReadJob::DbReadJob(SymmCipher* ckey)
+{
+    memcpy(key, ckey->key, sizeof key);
+    bytes = 0;
+    compressedtype = -1;
+    finished = false;
+}
+
+void DbReadJob::add(uint32_t id, string* record)
+{
+    ids.push_back(id);
+    bytes += record->size();
+    data.push_back(string());
+    data.back().swap(*record);
+}
+
+void DbReadJob::run()
+{
+    // the records are decrypted in one AesBatch (interleaved with AES-NI)
+    AesBatch batch;
+
+    ok.resize(ids.size());
+
+    for (unsigned i = 0; i < ids.size(); i++)
+    {
+        ok[i] = !ids[i] || !(data[i].size() & (SymmCipher::BLOCKSIZE - 1));
+
+        if (ids[i] && ok[i] && data[i].size())
+        {
+            batch.add(key, (byte*)data[i].data(), data[i].size(), AesBatch::CBC_DECRYPT);
+        }
+    }
+
+    batch.run();
+
+    for (unsigned i = 0; i < ids.size(); i++)
+    {
+        ok[i] = ok[i] && (!ids[i] || PaddedCBC::unpad(&data[i]));
+
+        // a corrupt payload is left for the engine to reject
+        if (ok[i] && compressedtype >= 0 && (int)(ids[i] & 15) == compressedtype)
+        {
+            DbTable::decompress(&data[i]);
+        }
+    }
+
+    finished = true;
+}
 } // namespace
@@ -84,17 +84,12 @@ BdbTable::BdbTable(DbEnv* env)
     dbenv = env;
     dbtxn = NULL;
     dbcursor = NULL;
-
-    nextid = 0;
+    cursorfirst = false;
 }
 
 BdbTable::~BdbTable()
 {
-    if (dbcursor)
-    {
-        dbcursor->close();
-    }
-
+    closecursor();
     abort();
 
     if (db)
@@ -104,15 +99,24 @@ BdbTable::~BdbTable()
     }
 }
 
-// set cursor to first record
-void BdbTable::rewind()
+void BdbTable::closecursor()
 {
     if (dbcursor)
     {
         dbcursor->close();
+        dbcursor = NULL;
     }
+}
 
-    db->cursor(dbtxn, &dbcursor, DB_DIRTY_READ);
+// set cursor to first record
+void BdbTable::rewind()
+{
+    if (!dbcursor && db->cursor(dbtxn, &dbcursor, DB_DIRTY_READ))
+    {
+        dbcursor = NULL;
+    }
+
+    cursorfirst = true;
 }
 
 // retrieve next record through cursor
@@ -125,11 +129,13 @@ bool BdbTable::next(uint32_t* index, string* data)
 
     Dbt key, value;
 
-    if (dbcursor->get(&key, &value, DB_NEXT | DB_DIRTY_READ))
+    if (dbcursor->get(&key, &value, (cursorfirst ? DB_FIRST : DB_NEXT) | DB_DIRTY_READ))
     {
         return false;
     }
 
+    cursorfirst = false;
+
     if (sizeof(*index) != key.get_size())
     {
         return false;
@@ -160,11 +166,7 @@ bool BdbTable::get(uint32_t index, string* data)
 // add/update record by index
 bool BdbTable::put(uint32_t index, char* data, unsigned len)
 {
-    if (dbcursor)
-    {
-        dbcursor->close();
-        dbcursor = NULL;
-    }
+    closecursor();
 
     Dbt key((char*)&index, sizeof index), value(data, len);
 
@@ -176,14 +178,43 @@ bool BdbTable::put(uint32_t index, char* data, unsigned len)
     return true;
 }
 
-// delete record by index
+// add/update several records in one transaction (unless one is active)
+bool BdbTable::putmany(const uint32_t* index, string* data, unsigned count)
+{
+    bool transaction = !dbtxn;
+    bool result = true;
+
+    if (transaction)
+    {
+        begin();
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(index[i], (char*)data[i].data(), data[i].size()))
+        {
+            result = false;
+        }
+    }
+
+    if (transaction)
+    {
+        commit();
+    }
+
+    return result;
+}
+
+// delete record by index (deleting a missing record is not an error)
 bool BdbTable::del(uint32_t index)
 {
+    closecursor();
+
     Dbt key((char*)&index, sizeof index);
 
-    db->del(dbtxn, &key, 0);
+    int rc = db->del(dbtxn, &key, 0);
 
-    return true;
+    return !rc || rc == DB_NOTFOUND;
 }
 
 // truncate table
@@ -191,11 +222,7 @@ void BdbTable::truncate()
 {
     u_int32_t count;
 
-    if (dbcursor)
-    {
-        dbcursor->close();
-        dbcursor = NULL;
-    }
+    closecursor();
 
     db->truncate(dbtxn, &count, 0);
 }
@@ -203,12 +230,17 @@ void BdbTable::truncate()
 // begin transaction
 void BdbTable::begin()
 {
+    // cursors must not span transactions
+    closecursor();
+
     dbenv->txn_begin(NULL, &dbtxn, DB_TXN_SYNC | DB_READ_UNCOMMITTED);
 }
 
 // commit transaction
 void BdbTable::commit()
 {
+    closecursor();
+
     if (dbtxn)
     {
         dbtxn->commit(DB_TXN_SYNC);
@@ -219,6 +251,8 @@ void BdbTable::commit()
 // abort transaction
 void BdbTable::abort()
 {
+    closecursor();
+
     if (dbtxn)
     {
         dbtxn->abort();
@@ -229,7 +263,7 @@ void BdbTable::abort()
 void BdbTable::remove()
 {
     abort();
-    begin()
+    begin();
     truncate();
     commit();
 }
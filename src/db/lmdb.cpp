@@ -0,0 +1,496 @@
+/**
+ * @file lmdb.cpp
+ * @brief LMDB access layer
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef USE_LMDB
+namespace mega {
+LmdbDbAccess::LmdbDbAccess(string* path)
+{
+    if (path)
+    {
+        dbpath = *path;
+    }
+}
+
+LmdbDbAccess::~LmdbDbAccess()
+{
+}
+
+DbTable* LmdbDbAccess::open(FileSystemAccess* fsaccess, string* name)
+{
+    MDB_env* env;
+    MDB_txn* txn;
+    MDB_dbi dbi;
+
+    string dbfile = dbpath + "megaclient_statecache7_" + *name + ".lmdb";
+
+    if (mdb_env_create(&env))
+    {
+        return NULL;
+    }
+
+    // a single file, the lock table is not bound to threads (a sequential
+    // read may be open while writing), the data is synced at each commit
+    // but the meta page only with the next one
+    if (mdb_env_set_mapsize(env, LmdbDbTable::mapsize())
+     || mdb_env_open(env, dbfile.c_str(), MDB_NOSUBDIR | MDB_NOTLS | MDB_NOMETASYNC, 0600))
+    {
+        mdb_env_close(env);
+        return NULL;
+    }
+
+    if (mdb_txn_begin(env, NULL, 0, &txn))
+    {
+        mdb_env_close(env);
+        return NULL;
+    }
+
+    // ids are kept in numeric order
+    if (mdb_dbi_open(txn, NULL, MDB_INTEGERKEY | MDB_CREATE, &dbi))
+    {
+        mdb_txn_abort(txn);
+        mdb_env_close(env);
+        return NULL;
+    }
+
+    if (mdb_txn_commit(txn))
+    {
+        mdb_env_close(env);
+        return NULL;
+    }
+
+    return new LmdbDbTable(env, dbi, fsaccess, &dbfile);
+}
+
+LmdbDbTable::LmdbDbTable(MDB_env* cenv, MDB_dbi cdbi, FileSystemAccess* fs, string* filepath)
+{
+    env = cenv;
+    dbi = cdbi;
+    fsaccess = fs;
+    dbfile = *filepath;
+    txn = NULL;
+    rtxn = NULL;
+    reading = false;
+    cursor = NULL;
+    cursorfirst = false;
+}
+
+LmdbDbTable::~LmdbDbTable()
+{
+    close();
+}
+
+void LmdbDbTable::close()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    abort();
+
+    if (rtxn)
+    {
+        mdb_txn_abort(rtxn);
+        rtxn = NULL;
+        reading = false;
+    }
+
+    mdb_env_close(env);
+    env = NULL;
+    LOG_debug << "Database closed";
+}
+
+size_t LmdbDbTable::mapsize()
+{
+    return sizeof(size_t) > 4 ? (size_t)MAPSIZE64 : MAPSIZE32;
+}
+
+// the map can only be resized while no transaction is active
+void LmdbDbTable::growmap()
+{
+    MDB_envinfo info;
+    MDB_stat stat;
+
+    if (txn || reading || mdb_env_info(env, &info) || mdb_env_stat(env, &stat))
+    {
+        return;
+    }
+
+    if ((info.me_last_pgno + 1) * stat.ms_psize > info.me_mapsize / 2)
+    {
+        LOG_debug << "Growing the database map to " << info.me_mapsize * 2 << " bytes";
+        mdb_env_set_mapsize(env, info.me_mapsize * 2);
+    }
+}
+
+// reads within a write transaction see its changes
+MDB_txn* LmdbDbTable::readtxn()
+{
+    if (txn)
+    {
+        return txn;
+    }
+
+    if (!reading)
+    {
+        if (rtxn ? mdb_txn_renew(rtxn) : mdb_txn_begin(env, NULL, MDB_RDONLY, &rtxn))
+        {
+            if (rtxn)
+            {
+                mdb_txn_abort(rtxn);
+                rtxn = NULL;
+            }
+
+            return NULL;
+        }
+
+        reading = true;
+    }
+
+    return rtxn;
+}
+
+// release the read snapshot unless a sequential read uses it
+void LmdbDbTable::endread()
+{
+    if (reading && !cursor)
+    {
+        mdb_txn_reset(rtxn);
+        reading = false;
+    }
+}
+
+void LmdbDbTable::closecursor()
+{
+    if (cursor)
+    {
+        mdb_cursor_close(cursor);
+        cursor = NULL;
+    }
+}
+
+MDB_txn* LmdbDbTable::writetxn()
+{
+    MDB_txn* t;
+
+    if (txn)
+    {
+        return txn;
+    }
+
+    growmap();
+
+    if (mdb_txn_begin(env, NULL, 0, &t))
+    {
+        return NULL;
+    }
+
+    return t;
+}
+
+// commit a single write (a failed write dooms an active transaction, its
+// commit() fails)
+bool LmdbDbTable::endwrite(MDB_txn* t, int rc)
+{
+    if (t == txn)
+    {
+        return !rc;
+    }
+
+    if (rc)
+    {
+        mdb_txn_abort(t);
+        return false;
+    }
+
+    return !mdb_txn_commit(t);
+}
+
+// set cursor to first record
+void LmdbDbTable::rewind()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    closecursor();
+
+    MDB_txn* t = readtxn();
+
+    if (t && mdb_cursor_open(t, dbi, &cursor))
+    {
+        cursor = NULL;
+    }
+
+    if (!cursor)
+    {
+        endread();
+    }
+
+    cursorfirst = true;
+}
+
+// retrieve next record through cursor
+bool LmdbDbTable::next(uint32_t* index, string* data)
+{
+    MDB_val key, value;
+
+    if (!cursor)
+    {
+        return false;
+    }
+
+    if (mdb_cursor_get(cursor, &key, &value, cursorfirst ? MDB_FIRST : MDB_NEXT)
+     || key.mv_size != sizeof *index)
+    {
+        closecursor();
+        endread();
+        return false;
+    }
+
+    cursorfirst = false;
+
+    memcpy(index, key.mv_data, sizeof *index);
+
+    // the one copy of the record, straight from the map (which is read-only,
+    // the record is decrypted in place)
+    data->assign((char*)value.mv_data, value.mv_size);
+
+    return true;
+}
+
+// retrieve record by index
+bool LmdbDbTable::get(uint32_t index, string* data)
+{
+    MDB_val key, value;
+
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = readtxn();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    key.mv_size = sizeof index;
+    key.mv_data = &index;
+
+    bool result = !mdb_get(t, dbi, &key, &value);
+
+    if (result)
+    {
+        data->assign((char*)value.mv_data, value.mv_size);
+    }
+
+    endread();
+
+    return result;
+}
+
+// add/update record by index
+bool LmdbDbTable::put(uint32_t index, char* data, unsigned len)
+{
+    MDB_val key, value;
+
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = writetxn();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    key.mv_size = sizeof index;
+    key.mv_data = &index;
+    value.mv_size = len;
+    value.mv_data = data;
+
+    return endwrite(t, mdb_put(t, dbi, &key, &value, 0));
+}
+
+// add/update several records in one transaction (unless one is active)
+bool LmdbDbTable::putmany(const uint32_t* index, string* data, unsigned count)
+{
+    MDB_val key, value;
+    int rc = 0;
+
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = writetxn();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < count && !rc; i++)
+    {
+        key.mv_size = sizeof *index;
+        key.mv_data = (void*)(index + i);
+        value.mv_size = data[i].size();
+        value.mv_data = (void*)data[i].data();
+
+        rc = mdb_put(t, dbi, &key, &value, 0);
+    }
+
+    return endwrite(t, rc);
+}
+
+// delete record by index (deleting a missing record is not an error)
+bool LmdbDbTable::del(uint32_t index)
+{
+    return delmany(&index, 1);
+}
+
+// delete several records in one transaction (unless one is active)
+bool LmdbDbTable::delmany(const uint32_t* index, unsigned count)
+{
+    MDB_val key;
+    int rc = 0;
+
+    if (!env)
+    {
+        return false;
+    }
+
+    MDB_txn* t = writetxn();
+
+    if (!t)
+    {
+        return false;
+    }
+
+    for (unsigned i = 0; i < count && !rc; i++)
+    {
+        key.mv_size = sizeof *index;
+        key.mv_data = (void*)(index + i);
+
+        if ((rc = mdb_del(t, dbi, &key, NULL)) == MDB_NOTFOUND)
+        {
+            rc = 0;
+        }
+    }
+
+    return endwrite(t, rc);
+}
+
+// truncate table
+void LmdbDbTable::truncate()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    closecursor();
+
+    MDB_txn* t = writetxn();
+
+    if (t)
+    {
+        endwrite(t, mdb_drop(t, dbi, 0));
+    }
+}
+
+// begin transaction
+void LmdbDbTable::begin()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    // cursors must not span transactions
+    closecursor();
+    endread();
+    growmap();
+
+    if (mdb_txn_begin(env, NULL, 0, &txn))
+    {
+        txn = NULL;
+    }
+}
+
+// commit transaction
+void LmdbDbTable::commit()
+{
+    closecursor();
+    endread();
+
+    if (txn)
+    {
+        if (mdb_txn_commit(txn))
+        {
+            LOG_err << "Database commit failed";
+        }
+
+        txn = NULL;
+    }
+}
+
+// abort transaction
+void LmdbDbTable::abort()
+{
+    closecursor();
+    endread();
+
+    if (txn)
+    {
+        mdb_txn_abort(txn);
+        txn = NULL;
+    }
+}
+
+void LmdbDbTable::remove()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    close();
+
+    string localpath;
+    string lockfile = dbfile + "-lock";
+
+    fsaccess->path2local(&dbfile, &localpath);
+    fsaccess->unlinklocal(&localpath);
+
+    fsaccess->path2local(&lockfile, &localpath);
+    fsaccess->unlinklocal(&localpath);
+}
+} // namespace
+
+#endif
@@ -35,6 +35,11 @@ SqliteDbAccess::~SqliteDbAccess()
 {
 }
 
+size_t SqliteDbAccess::memoryused()
+{
+    return (size_t)sqlite3_memory_used();
+}
+
 DbTable* SqliteDbAccess::open(FileSystemAccess* fsaccess, string* name)
 {
     //Each table will use its own database object and its own file
@@ -73,21 +78,64 @@ SqliteDbTable::SqliteDbTable(sqlite3* cdb, FileSystemAccess *fs, string *filepat
 {
     db = cdb;
     pStmt = NULL;
+    getStmt = NULL;
+    putStmt = NULL;
+    delStmt = NULL;
+    indexPutStmt = NULL;
+    indexDelStmt = NULL;
+    indexready = false;
     fsaccess = fs;
     dbfile = *filepath;
 }
 
-SqliteDbTable::~SqliteDbTable()
+// prepare the statement on first use, otherwise reset it for reuse
+bool SqliteDbTable::prepare(sqlite3_stmt** stmt, const char* sql)
 {
-    if (!db)
+    if (*stmt)
     {
-        return;
+        sqlite3_reset(*stmt);
+        return true;
     }
 
+    if (sqlite3_prepare_v2(db, sql, -1, stmt, NULL) != SQLITE_OK)
+    {
+        sqlite3_finalize(*stmt);
+        *stmt = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void SqliteDbTable::finalize()
+{
     if (pStmt)
     {
         sqlite3_finalize(pStmt);
+        pStmt = NULL;
+    }
+
+    sqlite3_finalize(getStmt);
+    sqlite3_finalize(putStmt);
+    sqlite3_finalize(delStmt);
+    sqlite3_finalize(indexPutStmt);
+    sqlite3_finalize(indexDelStmt);
+
+    getStmt = NULL;
+    putStmt = NULL;
+    delStmt = NULL;
+    indexPutStmt = NULL;
+    indexDelStmt = NULL;
+}
+
+SqliteDbTable::~SqliteDbTable()
+{
+    if (!db)
+    {
+        return;
     }
+
+    finalize();
     abort();
     sqlite3_close(db);
     LOG_debug << "Database closed";
@@ -148,23 +196,23 @@ bool SqliteDbTable::get(uint32_t index, string* data)
         return false;
     }
 
-    sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "SELECT content FROM statecache WHERE id = ?", -1, &stmt, NULL) == SQLITE_OK)
+    if (prepare(&getStmt, "SELECT content FROM statecache WHERE id = ?"))
     {
-        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        if (sqlite3_bind_int(getStmt, 1, index) == SQLITE_OK)
         {
-            if (sqlite3_step(stmt) == SQLITE_ROW)
+            if (sqlite3_step(getStmt) == SQLITE_ROW)
             {
-                data->assign((char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+                data->assign((char*)sqlite3_column_blob(getStmt, 0), sqlite3_column_bytes(getStmt, 0));
 
                 result = true;
             }
         }
+
+        sqlite3_reset(getStmt);
     }
 
-    sqlite3_finalize(stmt);
     return result;
 }
 
@@ -176,24 +224,58 @@ bool SqliteDbTable::put(uint32_t index, char* data, unsigned len)
         return false;
     }
 
-    sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)", -1, &stmt, NULL) == SQLITE_OK)
+    if (prepare(&putStmt, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)"))
     {
-        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        if (sqlite3_bind_int(putStmt, 1, index) == SQLITE_OK)
         {
-            if (sqlite3_bind_blob(stmt, 2, data, len, SQLITE_STATIC) == SQLITE_OK)
+            if (sqlite3_bind_blob(putStmt, 2, data, len, SQLITE_STATIC) == SQLITE_OK)
             {
-                if (sqlite3_step(stmt) == SQLITE_DONE)
+                if (sqlite3_step(putStmt) == SQLITE_DONE)
                 {
                     result = true;
                 }
             }
         }
+
+        // release the (static) blob binding
+        sqlite3_reset(putStmt);
+        sqlite3_clear_bindings(putStmt);
+    }
+
+    return result;
+}
+
+// add/update several records in one transaction (unless one is active)
+bool SqliteDbTable::putmany(const uint32_t* index, string* data, unsigned count)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    bool transaction = sqlite3_get_autocommit(db) != 0;
+    bool result = true;
+
+    if (transaction)
+    {
+        begin();
+    }
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(index[i], (char*)data[i].data(), data[i].size()))
+        {
+            result = false;
+        }
+    }
+
+    if (transaction)
+    {
+        commit();
     }
 
-    sqlite3_finalize(stmt);
     return result;
 }
 
@@ -205,11 +287,78 @@ bool SqliteDbTable::del(uint32_t index)
         return false;
     }
 
-    char buf[64];
+    bool result = false;
+
+    if (prepare(&delStmt, "DELETE FROM statecache WHERE id = ?"))
+    {
+        if (sqlite3_bind_int(delStmt, 1, index) == SQLITE_OK)
+        {
+            result = sqlite3_step(delStmt) == SQLITE_DONE;
+        }
+
+        sqlite3_reset(delStmt);
+    }
+
+    return result;
+}
+
+bool SqliteDbTable::delwhere(const char* table, const char* column, const sqlite3_int64* values, unsigned count)
+{
+    for (unsigned pos = 0; pos < count; pos += DELBATCH)
+    {
+        unsigned n = count - pos < DELBATCH ? count - pos : DELBATCH;
+        string sql = "DELETE FROM ";
+        sqlite3_stmt* stmt = NULL;
+
+        sql.append(table);
+        sql.append(" WHERE ");
+        sql.append(column);
+        sql.append(" IN (?");
+
+        for (unsigned i = 1; i < n; i++)
+        {
+            sql.append(",?");
+        }
+
+        sql.append(")");
+
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, NULL) != SQLITE_OK)
+        {
+            sqlite3_finalize(stmt);
+            return false;
+        }
+
+        bool result = true;
+
+        for (unsigned i = 0; i < n && result; i++)
+        {
+            result = sqlite3_bind_int64(stmt, i + 1, values[pos + i]) == SQLITE_OK;
+        }
+
+        result = result && sqlite3_step(stmt) == SQLITE_DONE;
+
+        sqlite3_finalize(stmt);
+
+        if (!result)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// delete records in batches
+bool SqliteDbTable::delmany(const uint32_t* index, unsigned count)
+{
+    if (!db)
+    {
+        return false;
+    }
 
-    sprintf(buf, "DELETE FROM statecache WHERE id = %" PRIu32, index);
+    vector<sqlite3_int64> values(index, index + count);
 
-    return !sqlite3_exec(db, buf, 0, 0, NULL);
+    return !count || delwhere("statecache", "id", &values[0], count);
 }
 
 // truncate table
@@ -221,6 +370,9 @@ void SqliteDbTable::truncate()
     }
 
     sqlite3_exec(db, "DELETE FROM statecache", 0, 0, NULL);
+
+    // fails harmlessly if there is no node index
+    sqlite3_exec(db, "DELETE FROM nodeindex", 0, 0, NULL);
 }
 
 // begin transaction
@@ -256,6 +408,134 @@ void SqliteDbTable::abort()
     sqlite3_exec(db, "ROLLBACK", 0, 0, NULL);
 }
 
+// create the node index table and its indexes
+bool SqliteDbTable::createindex()
+{
+    if (!indexready)
+    {
+        if (sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS nodeindex (nodehandle INTEGER PRIMARY KEY NOT NULL, record INTEGER NOT NULL, "
+                             "parent INTEGER, type INTEGER, fingerprint INTEGER, name INTEGER)", NULL, NULL, NULL)
+         || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodeindex_parent ON nodeindex (parent)", NULL, NULL, NULL)
+         || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodeindex_type ON nodeindex (type)", NULL, NULL, NULL)
+         || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodeindex_fingerprint ON nodeindex (fingerprint)", NULL, NULL, NULL)
+         || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS nodeindex_name ON nodeindex (name)", NULL, NULL, NULL))
+        {
+            return false;
+        }
+
+        indexready = true;
+    }
+
+    return true;
+}
+
+// add/update a node's index entry
+bool SqliteDbTable::indexnode(const DbNodeKeys* k, uint32_t record)
+{
+    if (!db || !createindex())
+    {
+        return false;
+    }
+
+    bool result = false;
+
+    if (prepare(&indexPutStmt, "INSERT OR REPLACE INTO nodeindex (nodehandle, record, parent, type, fingerprint, name) VALUES (?, ?, ?, ?, ?, ?)"))
+    {
+        if (sqlite3_bind_int64(indexPutStmt, 1, (sqlite3_int64)k->h) == SQLITE_OK
+         && sqlite3_bind_int(indexPutStmt, 2, record) == SQLITE_OK
+         && sqlite3_bind_int64(indexPutStmt, 3, (sqlite3_int64)k->parent) == SQLITE_OK
+         && sqlite3_bind_int(indexPutStmt, 4, k->type) == SQLITE_OK
+         && sqlite3_bind_int64(indexPutStmt, 5, k->fingerprint) == SQLITE_OK
+         && sqlite3_bind_int64(indexPutStmt, 6, k->name) == SQLITE_OK)
+        {
+            result = sqlite3_step(indexPutStmt) == SQLITE_DONE;
+        }
+
+        sqlite3_reset(indexPutStmt);
+    }
+
+    return result;
+}
+
+// remove a node's index entry
+bool SqliteDbTable::unindexnode(handle h)
+{
+    if (!db || !createindex())
+    {
+        return false;
+    }
+
+    bool result = false;
+
+    if (prepare(&indexDelStmt, "DELETE FROM nodeindex WHERE nodehandle = ?"))
+    {
+        if (sqlite3_bind_int64(indexDelStmt, 1, (sqlite3_int64)h) == SQLITE_OK)
+        {
+            result = sqlite3_step(indexDelStmt) == SQLITE_DONE;
+        }
+
+        sqlite3_reset(indexDelStmt);
+    }
+
+    return result;
+}
+
+bool SqliteDbTable::unindexnodes(const handle* h, unsigned count)
+{
+    if (!db || !createindex())
+    {
+        return false;
+    }
+
+    vector<sqlite3_int64> values(h, h + count);
+
+    return !count || delwhere("nodeindex", "nodehandle", &values[0], count);
+}
+
+// look up nodes by parent handle, type, fingerprint or name hash
+bool SqliteDbTable::findnodes(dbindex_t column, int64_t value, handle_vector* nodes, vector<uint32_t>* records)
+{
+    static const char* queries[] = {
+        "SELECT nodehandle, record FROM nodeindex WHERE parent = ?",
+        "SELECT nodehandle, record FROM nodeindex WHERE type = ?",
+        "SELECT nodehandle, record FROM nodeindex WHERE fingerprint = ?",
+        "SELECT nodehandle, record FROM nodeindex WHERE name = ?"
+    };
+
+    if (!db || column < DBINDEX_PARENT || column > DBINDEX_NAME)
+    {
+        return false;
+    }
+
+    sqlite3_stmt* stmt;
+
+    // queries are rare - prepared per call
+    if (sqlite3_prepare_v2(db, queries[column], -1, &stmt, NULL) != SQLITE_OK)
+    {
+        sqlite3_finalize(stmt);
+        return false;
+    }
+
+    bool result = sqlite3_bind_int64(stmt, 1, value) == SQLITE_OK;
+
+    if (result)
+    {
+        int rc;
+
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            nodes->push_back((handle)sqlite3_column_int64(stmt, 0));
+            records->push_back(sqlite3_column_int(stmt, 1));
+        }
+
+        result = rc == SQLITE_DONE;
+    }
+
+    sqlite3_finalize(stmt);
+
+    return result;
+}
+
 void SqliteDbTable::remove()
 {
     if (!db)
@@ -263,10 +543,7 @@ void SqliteDbTable::remove()
         return;
     }
 
-    if (pStmt)
-    {
-        sqlite3_finalize(pStmt);
-    }
+    finalize();
     abort();
     sqlite3_close(db);
 
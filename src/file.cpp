@@ -33,6 +33,10 @@ File::File()
     hprivate = true;
     syncxfer = false;
     h = UNDEF;
+    priority = 0;
+    owner = 0;
+    queuedbid = 0;
+    stream = NULL;
 }
 
 File::~File()
@@ -88,8 +92,9 @@ void File::completed(Transfer* t, LocalNode* l)
         // store filename
         attrs.map['n'] = name;
 
-        // store fingerprint
-        t->serializefingerprint(&attrs.map['c']);
+        // store fingerprint (of streamed data: only known at the end, set
+        // in the file)
+        (t->stream ? (FileFingerprint*)this : (FileFingerprint*)t)->serializefingerprint(&attrs.map['c']);
 
         string tattrstring;
 
@@ -115,6 +120,12 @@ void File::completed(Transfer* t, LocalNode* l)
             {
                 th = t->client->rootnodes[0];
             }
+
+            // small-file lane: committed together with other small uploads
+            if (!l && MegaClient::smallupload(t))
+            {
+                return t->client->queueputnodes(th, newnode, t->tag);
+            }
 #ifdef ENABLE_SYNC
             if (l)
             {
@@ -167,6 +178,68 @@ void File::displayname(string* dname)
     }
 }
 
+QueuedFile::QueuedFile(File* f)
+{
+    if (f)
+    {
+        h = f->h;
+        localname = f->localname;
+        priority = f->priority;
+        dbid = f->queuedbid;
+    }
+    else
+    {
+        h = UNDEF;
+        priority = 0;
+    }
+}
+
+bool QueuedFile::serialize(string* d)
+{
+    unsigned short ll = (unsigned short)localname.size();
+
+    d->append((char*)&h, MegaClient::NODEHANDLE);
+    d->append((char*)&priority, sizeof priority);
+    d->append((char*)&ll, sizeof ll);
+    d->append(localname.data(), ll);
+
+    return true;
+}
+
+QueuedFile* QueuedFile::unserialize(string* d)
+{
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+    unsigned short ll;
+
+    if (ptr + MegaClient::NODEHANDLE + sizeof(int) + sizeof ll > end)
+    {
+        return NULL;
+    }
+
+    QueuedFile* qf = new QueuedFile;
+
+    qf->h = 0;
+    memcpy(&qf->h, ptr, MegaClient::NODEHANDLE);
+    ptr += MegaClient::NODEHANDLE;
+
+    qf->priority = MemAccess::get<int>(ptr);
+    ptr += sizeof qf->priority;
+
+    ll = MemAccess::get<unsigned short>(ptr);
+    ptr += sizeof ll;
+
+    if (ptr + ll != end)
+    {
+        delete qf;
+        return NULL;
+    }
+
+    qf->localname.assign(ptr, ll);
+
+    return qf;
+}
+
 #ifdef ENABLE_SYNC
 SyncFileGet::SyncFileGet(Sync* csync, Node* cn, string* clocalname)
 {
@@ -178,12 +251,19 @@ SyncFileGet::SyncFileGet(Sync* csync, Node* cn, string* clocalname)
     localname = *clocalname;
 
     syncxfer = true;
+    owner = sync->tag;
     n->syncget = this;
 }
 
 SyncFileGet::~SyncFileGet()
 {
     n->syncget = NULL;
+
+    // a failed download is restarted by the next syncdown() pass
+    if (n->parent && n->parent->localnode)
+    {
+        n->parent->localnode->setdirty();
+    }
 }
 
 // create sync-specific temp download directory and set unique filename
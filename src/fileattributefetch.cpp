@@ -34,37 +34,70 @@ FileAttributeFetchChannel::FileAttributeFetchChannel()
     e = API_EINTERNAL;
 }
 
-FileAttributeFetch::FileAttributeFetch(handle h, fatype t, int ctag)
+FileAttributeFetch::FileAttributeFetch(handle h, fatype t, int ctag, int cpriority)
 {
     nodehandle = h;
     type = t;
     retries = 0;
     tag = ctag;
+    priority = cpriority;
 }
 
 void FileAttributeFetchChannel::dispatch(MegaClient* client)
 {
     faf_map::iterator it;
+    unsigned prefetches = 0;
  
     // reserve space
     req.outbuf.clear();
     req.outbuf.reserve((fafs[0].size() + fafs[1].size()) * sizeof(handle));
 
-    for (int i = 2; i--; )
+    for (int p = FileAttributeFetch::VISIBLE; p <= FileAttributeFetch::PREFETCH; p++)
     {
-        for (it = fafs[i].begin(); it != fafs[i].end(); )
+        for (int i = 2; i--; )
         {
-            req.outbuf.append((char*)&it->first, sizeof(handle));
-
-            if (!i)
-            {
-                // move from fresh to pending
-                fafs[1][it->first] = it->second;
-                fafs[0].erase(it++);
-            }
-            else
+            for (it = fafs[i].begin(); it != fafs[i].end(); )
             {
-                it++;
+                if (it->second->priority != p)
+                {
+                    it++;
+                    continue;
+                }
+
+                if (p == FileAttributeFetch::PREFETCH && prefetches >= PREFETCHBATCH)
+                {
+                    if (i)
+                    {
+                        // not sent: back to fresh, so that failed() does not
+                        // report it
+                        fafs[0][it->first] = it->second;
+                        fafs[1].erase(it++);
+                    }
+                    else
+                    {
+                        it++;
+                    }
+
+                    continue;
+                }
+
+                if (p == FileAttributeFetch::PREFETCH)
+                {
+                    prefetches++;
+                }
+
+                req.outbuf.append((char*)&it->first, sizeof(handle));
+
+                if (!i)
+                {
+                    // move from fresh to pending
+                    fafs[1][it->first] = it->second;
+                    fafs[0].erase(it++);
+                }
+                else
+                {
+                    it++;
+                }
             }
         }
     }
@@ -140,6 +173,7 @@ void FileAttributeFetchChannel::parse(MegaClient* client, int fac, bool final)
                     if ((cipher = n->nodecipher()))
                     {
                         cipher->cbc_decrypt((byte*)ptr, falen);
+                        client->gfxcache.put(n, it->second->type, ptr, falen);
                         client->app->fa_complete(n, it->second->type, ptr, falen);
                     }
 
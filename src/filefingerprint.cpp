@@ -22,6 +22,7 @@
 #include "mega/filefingerprint.h"
 #include "mega/serialize64.h"
 #include "mega/base64.h"
+#include "mega/logging.h"
 
 namespace mega {
 bool operator==(FileFingerprint& lhs, FileFingerprint& rhs)
@@ -130,27 +131,29 @@ bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
     }
     else
     {
-        // large file: sparse coverage, four sparse CRC32s
+        // large file: sparse coverage, four sparse CRC32s (the blocks are
+        // read in one batch)
         HashCRC32 crc32;
-        byte block[4 * sizeof crc];
-        const unsigned blocks = MAXFULL / (sizeof block * sizeof crc / sizeof *crc);
+        const unsigned blocksize = 4 * sizeof crc;
+        const unsigned blocks = MAXFULL / (blocksize * sizeof crc / sizeof *crc);
+        const unsigned total = sizeof crc / sizeof *crc * blocks;
+        byte buf[MAXFULL];
+        m_off_t offsets[total];
 
-        for (unsigned i = 0; i < sizeof crc / sizeof *crc; i++)
+        for (unsigned k = 0; k < total; k++)
         {
-            for (unsigned j = 0; j < blocks; j++)
-            {
-                if (!fa->frawread(block, sizeof block,
-                                  (size - sizeof block)
-                                  * (i * blocks + j)
-                                  / (sizeof crc / sizeof *crc * blocks - 1)))
-                {
-                    size = -1;
-                    return true;
-                }
+            offsets[k] = (size - blocksize) * k / (total - 1);
+        }
 
-                crc32.add(block, sizeof block);
-            }
+        if (!fa->frawreadv(buf, blocksize, offsets, total))
+        {
+            size = -1;
+            return true;
+        }
 
+        for (unsigned i = 0; i < sizeof crc / sizeof *crc; i++)
+        {
+            crc32.add(buf + i * blocks * blocksize, blocks * blocksize);
             crc32.get((byte*)&crcval);
             newcrc[i] = htonl(crcval);
         }
@@ -285,6 +288,171 @@ bool FileFingerprint::genfingerprint(InputStreamAccess *is, m_time_t cmtime, boo
     return changed;
 }
 
+StreamFingerprint::StreamFingerprint()
+{
+    init(-1, 0);
+}
+
+void StreamFingerprint::init(m_off_t csize, m_time_t cmtime)
+{
+    size = csize;
+    mtime = cmtime;
+    added = 0;
+}
+
+m_off_t StreamFingerprint::blockoffset(unsigned k) const
+{
+    return (size - BLOCKSIZE) * k / (BLOCKS - 1);
+}
+
+void StreamFingerprint::add(const byte* data, unsigned len, m_off_t pos)
+{
+    if (size < 0 || pos < 0 || pos + len > size)
+    {
+        return;
+    }
+
+    added += len;
+
+    if (size <= FileFingerprint::MAXFULL)
+    {
+        memcpy(buf + pos, data, len);
+        return;
+    }
+
+    // the sampled blocks overlapping the data (they may overlap each other)
+    for (unsigned k = 0; k < BLOCKS; k++)
+    {
+        m_off_t start = blockoffset(k);
+
+        if (start >= pos + len)
+        {
+            break;
+        }
+
+        if (start + BLOCKSIZE <= pos)
+        {
+            continue;
+        }
+
+        m_off_t from = start > pos ? start : pos;
+        m_off_t to = start + BLOCKSIZE < pos + len ? start + BLOCKSIZE : pos + len;
+
+        memcpy(buf + k * BLOCKSIZE + (from - start), data + (from - pos), (size_t)(to - from));
+    }
+}
+
+bool StreamFingerprint::get(FileFingerprint* fp)
+{
+    const unsigned numcrc = sizeof fp->crc / sizeof *fp->crc;
+    int32_t crcval;
+    HashCRC32 crc32;
+
+    if (size < 0 || added != size)
+    {
+        return false;
+    }
+
+    if (size <= (m_off_t)sizeof fp->crc)
+    {
+        // tiny file: verbatim, NUL padded
+        memset(fp->crc, 0, sizeof fp->crc);
+        memcpy(fp->crc, buf, (size_t)size);
+    }
+    else if (size <= FileFingerprint::MAXFULL)
+    {
+        // small file: four full CRC32s
+        for (unsigned i = 0; i < numcrc; i++)
+        {
+            int begin = i * size / numcrc;
+            int end = (i + 1) * size / numcrc;
+
+            crc32.add(buf + begin, end - begin);
+            crc32.get((byte*)&crcval);
+            fp->crc[i] = htonl(crcval);
+        }
+    }
+    else
+    {
+        // large file: four sparse CRC32s
+        for (unsigned i = 0; i < numcrc; i++)
+        {
+            crc32.add(buf + i * (BLOCKS / numcrc) * BLOCKSIZE, (BLOCKS / numcrc) * BLOCKSIZE);
+            crc32.get((byte*)&crcval);
+            fp->crc[i] = htonl(crcval);
+        }
+    }
+
+    fp->size = size;
+    fp->mtime = mtime;
+    fp->isvalid = true;
+
+    return true;
+}
+
+StreamFileAccess::StreamFileAccess(InputStreamAccess* cis, m_time_t cmtime)
+{
+    is = cis;
+    consumed = 0;
+    size = -1;
+    mtime = cmtime;
+    ctime = 0;
+    fsidvalid = false;
+    type = FILENODE;
+    retry = false;
+}
+
+bool StreamFileAccess::fopen(string* name, bool read, bool write)
+{
+    retry = false;
+
+    if (write || !read)
+    {
+        return false;
+    }
+
+    // the size must be known upfront: upload targets are requested for it
+    size = is->size();
+
+    if (size < 0)
+    {
+        return false;
+    }
+
+    fingerprint.init(size, mtime);
+
+    return true;
+}
+
+bool StreamFileAccess::sysstat(m_time_t* cmtime, m_off_t* csize)
+{
+    *cmtime = mtime;
+    *csize = size;
+
+    return size >= 0;
+}
+
+bool StreamFileAccess::sysread(byte* dst, unsigned len, m_off_t pos)
+{
+    retry = false;
+
+    if (pos != consumed || pos + len > size)
+    {
+        LOG_warn << "Non-sequential read of a stream: " << pos << " (" << consumed << ")";
+        return false;
+    }
+
+    if (!is->read(dst, len))
+    {
+        return false;
+    }
+
+    fingerprint.add(dst, len, pos);
+    consumed += len;
+
+    return true;
+}
+
 // convert this FileFingerprint to string
 void FileFingerprint::serializefingerprint(string* d) const
 {
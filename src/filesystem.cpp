@@ -25,6 +25,12 @@
 #include "mega/megaclient.h"
 
 namespace mega {
+LocalRemoval::LocalRemoval()
+{
+    removed = 0;
+    cancelled = false;
+}
+
 void FileSystemAccess::captimestamp(m_time_t* t)
 {
     // FIXME: remove upper bound before the year 2100 and upgrade server-side timestamps to BIGINT
@@ -84,15 +90,79 @@ void FileSystemAccess::name2local(string* filename) const
 {
     escapefsincompatible(filename);
 
-    string t = *filename;
+    string t;
 
+    t.swap(*filename);
     path2local(&t, filename);
 }
 
+// conservative NFC quick check: true if every character is a starter that
+// can neither compose with its predecessor nor changes under NFC (such as
+// any character below U+0300) - false for invalid UTF-8
+static bool isnfc(const string* s)
+{
+    const uint8_t* p = (const uint8_t*)s->data();
+    ssize_t len = (ssize_t)s->size();
+    int32_t uc;
+
+    for (ssize_t i = 0; i < len; )
+    {
+        if (p[i] < 0x80)
+        {
+            i++;
+            continue;
+        }
+
+        ssize_t n = utf8proc_iterate(p + i, len - i, &uc);
+
+        if (n <= 0)
+        {
+            return false;
+        }
+
+        i += n;
+
+        if (uc < 0x300)
+        {
+            continue;
+        }
+
+        // conjoining jamo compose algorithmically
+        if (uc >= 0x1100 && uc < 0x1200)
+        {
+            return false;
+        }
+
+        const utf8proc_property_t* property = utf8proc_get_property(uc);
+
+        if (property->combining_class || property->comb2nd_index >= 0 || property->comp_exclusion)
+        {
+            return false;
+        }
+
+        // canonical decompositions are only kept by primary composites
+        // (a starter followed by at least one more character)
+        if (property->decomp_mapping && !property->decomp_type
+         && (property->decomp_mapping[0] < 0 || property->decomp_mapping[1] < 0
+          || utf8proc_get_property(property->decomp_mapping[0])->combining_class))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 void FileSystemAccess::normalize(string* filename) const
 {
     if (!filename) return;
 
+    // most names are ASCII or already composed: no conversion needed
+    if (isnfc(filename))
+    {
+        return;
+    }
+
     const char* cfilename = filename->c_str();
     size_t fnsize = filename->size();
     string result;
@@ -122,7 +192,7 @@ void FileSystemAccess::normalize(string* filename) const
         i += strlen(substring);
     }
 
-    *filename = result;
+    filename->swap(result);
 }
 
 // convert from local encoding, then unescape escaped forbidden characters
@@ -143,15 +213,299 @@ DirNotify::DirNotify(string* clocalbasepath, string* cignore)
 
     failed = true;
     error = false;
+    replaying = false;
+
+    notifyseq = 0;
+    settleds = MINSETTLEDS;
+    burstwindow = 0;
+    burstcount = 0;
+
+    notified = 0;
+    superseded = 0;
 }
 
 // notify base LocalNode + relative path/filename
 void DirNotify::notify(notifyqueue q, LocalNode* l, const char* localpath, size_t len, bool immediate)
 {
     notifyq[q].resize(notifyq[q].size() + 1);
-    notifyq[q].back().timestamp = immediate ? 0 : Waiter::ds;
-    notifyq[q].back().localnode = l;
-    notifyq[q].back().path.assign(localpath, len);
+
+    Notification* n = &notifyq[q].back();
+
+    n->timestamp = immediate ? 0 : Waiter::ds;
+    n->localnode = l;
+    n->path.assign(localpath, len);
+    n->seq = 0;
+    n->rescan = false;
+    n->stat.type = TYPE_UNKNOWN;
+
+    // internally generated entries (scan results, retries) are not coalesced
+    if (q != DIREVENTS || immediate)
+    {
+        return;
+    }
+
+    notified++;
+
+    // event rate, measured in one-second windows
+    if (Waiter::ds - burstwindow >= 10)
+    {
+        if (burstcount >= BURSTEVENTS && Waiter::ds - burstwindow < 20)
+        {
+            settleds = settleds * 2 > MAXSETTLEDS ? MAXSETTLEDS : settleds * 2;
+        }
+        else
+        {
+            settleds = MINSETTLEDS;
+        }
+
+        burstwindow = Waiter::ds;
+        burstcount = 0;
+    }
+
+    burstcount++;
+
+    string key, folder;
+    size_t dirlen = parentlen(&n->path);
+
+    notifykey(l, &n->path, &key);
+
+    if (dirlen != string::npos)
+    {
+        folder.assign((char*)&l, sizeof l);
+        folder.append(n->path, 0, dirlen);
+
+        if (collapsed.count(folder))
+        {
+            // covered by the folder's pending recheck, which is postponed
+            // (at most one entry per tick)
+            string path(n->path, 0, dirlen);
+
+            notifyq[q].pop_back();
+
+            key = "r";
+            key.append(folder);
+
+            notifykey_map::iterator it = latest.find(key);
+
+            if (it == latest.end() || it->second.second != Waiter::ds)
+            {
+                pushrescan(l, &path, &key);
+            }
+
+            return;
+        }
+    }
+
+    notifykey_map::iterator it = latest.find(key);
+
+    if (it == latest.end())
+    {
+        it = latest.insert(pair<string, pair<uint32_t, dstime> >(key, pair<uint32_t, dstime>(0, 0))).first;
+
+        if (dirlen != string::npos && ++burstfolders[folder] >= BURSTCHILDREN)
+        {
+            string path(n->path, 0, dirlen);
+
+            // the folder's pending entries (including this one) are
+            // superseded by a recheck
+            notifyq[q].pop_back();
+            collapse(l, &path);
+
+            key = "r";
+            key.append(folder);
+
+            collapsed.insert(folder);
+            pushrescan(l, &path, &key);
+
+            return;
+        }
+    }
+
+    if (!++notifyseq)
+    {
+        notifyseq++;
+    }
+
+    n->seq = notifyseq;
+    it->second.first = notifyseq;
+    it->second.second = Waiter::ds;
+}
+
+void DirNotify::notifykey(LocalNode* l, const string* path, string* key)
+{
+    key->assign("n");
+    key->append((char*)&l, sizeof l);
+    key->append(*path);
+}
+
+// length of the path's folder part (0: top level, npos: unknown separator)
+size_t DirNotify::parentlen(const string* path)
+{
+    if (!localseparator.size())
+    {
+        return string::npos;
+    }
+
+    size_t pos = path->size();
+
+    while (pos && (pos = path->rfind(localseparator, pos - 1)) != string::npos)
+    {
+        if (!(pos % localseparator.size()))
+        {
+            return pos;
+        }
+    }
+
+    return 0;
+}
+
+// mark the pending entries of the folder's direct children as superseded
+void DirNotify::collapse(LocalNode* l, const string* path)
+{
+    string prefix;
+
+    notifykey(l, path, &prefix);
+
+    if (path->size())
+    {
+        prefix.append(localseparator);
+    }
+
+    for (notifykey_map::iterator it = latest.lower_bound(prefix);
+         it != latest.end() && !it->first.compare(0, prefix.size(), prefix);
+         it++)
+    {
+        string name(it->first, prefix.size());
+
+        if (parentlen(&name) == 0)
+        {
+            it->second.first = 0;
+        }
+    }
+}
+
+void DirNotify::pushrescan(LocalNode* l, const string* path, const string* key)
+{
+    notifyq[DIREVENTS].resize(notifyq[DIREVENTS].size() + 1);
+
+    Notification* n = &notifyq[DIREVENTS].back();
+
+    if (!++notifyseq)
+    {
+        notifyseq++;
+    }
+
+    n->timestamp = Waiter::ds;
+    n->localnode = l;
+    n->path = *path;
+    n->seq = notifyseq;
+    n->rescan = true;
+
+    latest[*key] = pair<uint32_t, dstime>(notifyseq, Waiter::ds);
+}
+
+// the front entry is processed unless a more recent entry supersedes it
+bool DirNotify::current(notifyqueue q)
+{
+    Notification* n = &notifyq[q].front();
+
+    if (!n->seq)
+    {
+        return true;
+    }
+
+    string key;
+
+    if (n->rescan)
+    {
+        key = "r";
+        key.append((char*)&n->localnode, sizeof n->localnode);
+        key.append(n->path);
+    }
+    else
+    {
+        notifykey(n->localnode, &n->path, &key);
+    }
+
+    notifykey_map::iterator it = latest.find(key);
+
+    // (no record after a reset)
+    return it == latest.end() || it->second.first == n->seq;
+}
+
+// the front entry has been handled: release its coalescing state
+void DirNotify::processed(notifyqueue q)
+{
+    Notification* n = &notifyq[q].front();
+
+    if (q != DIREVENTS)
+    {
+        return;
+    }
+
+    if (notifyq[q].size() == 1)
+    {
+        resetcoalescing();
+        return;
+    }
+
+    if (!n->seq || n->localnode == (LocalNode*)~0 || !current(q))
+    {
+        return;
+    }
+
+    string key, folder;
+
+    folder.assign((char*)&n->localnode, sizeof n->localnode);
+
+    if (n->rescan)
+    {
+        folder.append(n->path);
+
+        key = "r";
+        key.append(folder);
+
+        collapsed.erase(folder);
+        burstfolders.erase(folder);
+    }
+    else
+    {
+        size_t dirlen = parentlen(&n->path);
+
+        notifykey(n->localnode, &n->path, &key);
+
+        if (dirlen != string::npos)
+        {
+            folder.append(n->path, 0, dirlen);
+
+            map<string, size_t>::iterator it = burstfolders.find(folder);
+
+            if (it != burstfolders.end() && !--it->second)
+            {
+                burstfolders.erase(it);
+            }
+        }
+    }
+
+    latest.erase(key);
+}
+
+void DirNotify::resetcoalescing()
+{
+    latest.clear();
+    burstfolders.clear();
+    collapsed.clear();
+}
+
+dstime DirNotify::settledelay()
+{
+    // back to the minimum after a quiet second
+    if (Waiter::ds - burstwindow >= 20)
+    {
+        settleds = MINSETTLEDS;
+    }
+
+    return settleds;
 }
 
 // default: no fingerprint
@@ -174,6 +528,22 @@ bool FileAccess::fopen(string* name)
     return sysstat(&mtime, &size);
 }
 
+bool FileAccess::fopen(string* name, const DirEntryStat* st)
+{
+    localname.resize(1);
+    updatelocalname(name);
+
+    type = st->type;
+    size = st->size;
+    mtime = st->mtime;
+    ctime = 0;
+    fsid = st->fsid;
+    fsidvalid = true;
+    retry = false;
+
+    return true;
+}
+
 // check if size and mtime are unchanged, then open for reading
 bool FileAccess::openf()
 {
@@ -182,6 +552,12 @@ bool FileAccess::openf()
         return true;
     }
 
+    if (opencount)
+    {
+        opencount++;
+        return true;
+    }
+
     m_time_t curr_mtime;
     m_off_t curr_size;
 
@@ -190,12 +566,18 @@ bool FileAccess::openf()
         return false;
     }
 
-    return sysopen();
+    if (!sysopen())
+    {
+        return false;
+    }
+
+    opencount = 1;
+    return true;
 }
 
 void FileAccess::closef()
 {
-    if (localname.size())
+    if (localname.size() && opencount && !--opencount)
     {
         sysclose();
     }
@@ -203,6 +585,14 @@ void FileAccess::closef()
 
 bool FileAccess::fread(string* dst, unsigned len, unsigned pad, m_off_t pos)
 {
+    dst->resize(len + pad);
+
+    if (readingested((byte*)dst->data(), len, pos))
+    {
+        memset((char*)dst->data() + len, 0, pad);
+        return true;
+    }
+
     if (!openf())
     {
         return false;
@@ -210,8 +600,6 @@ bool FileAccess::fread(string* dst, unsigned len, unsigned pad, m_off_t pos)
 
     bool r;
 
-    dst->resize(len + pad);
-
     if ((r = sysread((byte*)dst->data(), len, pos)))
     {
         memset((char*)dst->data() + len, 0, pad);
@@ -222,8 +610,73 @@ bool FileAccess::fread(string* dst, unsigned len, unsigned pad, m_off_t pos)
     return r;
 }
 
+AsyncIOContext* FileAccess::asyncfread(byte* dst, unsigned len, m_off_t pos)
+{
+    AsyncIOContext* context = new AsyncIOContext;
+
+    context->op = AsyncIOContext::READ;
+    context->buffer = dst;
+    context->len = len;
+    context->pos = pos;
+    context->failed = !sysread(dst, len, pos);
+    context->finished = true;
+
+    return context;
+}
+
+AsyncIOContext* FileAccess::asyncfwrite(const byte* data, unsigned len, m_off_t pos)
+{
+    AsyncIOContext* context = new AsyncIOContext;
+
+    context->op = AsyncIOContext::WRITE;
+    context->buffer = (byte*)data;
+    context->len = len;
+    context->pos = pos;
+    context->failed = !fwrite(data, len, pos);
+    context->finished = true;
+
+    return context;
+}
+
+bool FileAccess::ingest()
+{
+    if (size <= 0 || size > INGESTMAX || !openf())
+    {
+        return false;
+    }
+
+    ingested.resize((size_t)size);
+
+    bool r = sysread((byte*)ingested.data(), (unsigned)size, 0);
+
+    closef();
+
+    if (!r)
+    {
+        ingested.clear();
+    }
+
+    return r;
+}
+
+bool FileAccess::readingested(byte* dst, unsigned len, m_off_t pos)
+{
+    if (!ingested.size() || pos < 0 || pos + len > (m_off_t)ingested.size())
+    {
+        return false;
+    }
+
+    memcpy(dst, ingested.data() + pos, len);
+    return true;
+}
+
 bool FileAccess::frawread(byte* dst, unsigned len, m_off_t pos)
 {
+    if (readingested(dst, len, pos))
+    {
+        return true;
+    }
+
     if (!openf())
     {
         return false;
@@ -235,4 +688,62 @@ bool FileAccess::frawread(byte* dst, unsigned len, m_off_t pos)
 
     return r;
 }
+
+bool FileAccess::frawreadv(byte* dst, unsigned len, const m_off_t* pos, unsigned count)
+{
+    if (ingested.size())
+    {
+        unsigned i;
+
+        for (i = 0; i < count && readingested(dst + i * len, len, pos[i]); i++);
+
+        if (i == count)
+        {
+            return true;
+        }
+    }
+
+    if (!openf())
+    {
+        return false;
+    }
+
+    bool r = true;
+    string span;
+
+    for (unsigned i = 0; r && i < count; )
+    {
+        unsigned j = i + 1;
+
+        while (j < count && pos[j] >= pos[j - 1] && pos[j] - pos[j - 1] - len <= COALESCEGAP)
+        {
+            j++;
+        }
+
+        if (j == i + 1)
+        {
+            r = sysread(dst + i * len, len, pos[i]);
+        }
+        else
+        {
+            unsigned spanlen = (unsigned)(pos[j - 1] + len - pos[i]);
+
+            span.resize(spanlen);
+
+            if ((r = sysread((byte*)span.data(), spanlen, pos[i])))
+            {
+                for (unsigned k = i; k < j; k++)
+                {
+                    memcpy(dst + k * len, span.data() + (pos[k] - pos[i]), len);
+                }
+            }
+        }
+
+        i = j;
+    }
+
+    closef();
+
+    return r;
+}
 } // namespace
@@ -57,6 +57,347 @@ const char* GfxProc::supportedformats()
     return NULL;
 }
 
+bool GfxProc::readbitmapdata(const string*, int)
+{
+    return false;
+}
+
+// next marker segment of a JPEG stream at p (fill bytes and standalone
+// markers are skipped) - false at the start of the scan data or if invalid
+static bool jpegsegment(const byte* data, size_t len, size_t* p, byte* marker, size_t* seglen)
+{
+    while (*p + 4 <= len && data[*p] == 0xff)
+    {
+        byte m = data[*p + 1];
+
+        if (m == 0xff)
+        {
+            (*p)++;
+            continue;
+        }
+
+        if (m == 0x01 || m == 0xd8 || (m >= 0xd0 && m <= 0xd7))
+        {
+            *p += 2;
+            continue;
+        }
+
+        if (m == 0xd9 || m == 0xda)
+        {
+            return false;
+        }
+
+        *marker = m;
+        *seglen = (data[*p + 2] << 8) | data[*p + 3];
+
+        return *seglen >= 2;
+    }
+
+    return false;
+}
+
+// image size from the JPEG's frame header (SOFn)
+static bool jpegsize(const byte* data, size_t len, int* w, int* h)
+{
+    size_t p, seglen;
+    byte m;
+
+    if (len < 2 || data[0] != 0xff || data[1] != 0xd8)
+    {
+        return false;
+    }
+
+    for (p = 0; jpegsegment(data, len, &p, &m, &seglen); p += 2 + seglen)
+    {
+        if (m >= 0xc0 && m <= 0xcf && m != 0xc4 && m != 0xc8 && m != 0xcc)
+        {
+            if (p + 9 > len)
+            {
+                return false;
+            }
+
+            *h = (data[p + 5] << 8) | data[p + 6];
+            *w = (data[p + 7] << 8) | data[p + 8];
+
+            return *w && *h;
+        }
+    }
+
+    return false;
+}
+
+static unsigned exif16(const byte* p, bool motorola)
+{
+    return motorola ? (p[0] << 8) | p[1] : (p[1] << 8) | p[0];
+}
+
+static uint32_t exif32(const byte* p, bool motorola)
+{
+    return motorola ? ((uint32_t)exif16(p, true) << 16) | exif16(p + 2, true)
+                    : ((uint32_t)exif16(p + 2, false) << 16) | exif16(p, false);
+}
+
+// the thumbnail is located through IFD1 (JPEGInterchangeFormat/Length) of
+// the APP1 segment's TIFF structure, the orientation is tag 0x112 of IFD0
+bool GfxProc::exifthumbnail(string* localfilename, int size, string* thumb, int* orientation)
+{
+    // the EXIF segment (at most 64 KB) and the main image's frame header
+    // are expected near the start of the file
+    string head;
+
+    readhead(localfilename, 131072, &head);
+
+    const byte* data = (const byte*)head.data();
+    size_t len = head.size();
+    const byte* tiff = NULL;
+    size_t tifflen = 0;
+    size_t p, seglen;
+    byte m;
+
+    if (len < 4 || data[0] != 0xff || data[1] != 0xd8)
+    {
+        return false;
+    }
+
+    for (p = 0; jpegsegment(data, len, &p, &m, &seglen); p += 2 + seglen)
+    {
+        if (m == 0xe1 && seglen >= 16 && p + 2 + seglen <= len && !memcmp(data + p + 4, "Exif\0\0", 6))
+        {
+            tiff = data + p + 10;
+            tifflen = seglen - 8;
+            break;
+        }
+    }
+
+    if (!tiff)
+    {
+        return false;
+    }
+
+    bool motorola;
+
+    if (tiff[0] == 'M' && tiff[1] == 'M')
+    {
+        motorola = true;
+    }
+    else if (tiff[0] == 'I' && tiff[1] == 'I')
+    {
+        motorola = false;
+    }
+    else
+    {
+        return false;
+    }
+
+    if (exif16(tiff + 2, motorola) != 42)
+    {
+        return false;
+    }
+
+    uint32_t ifd = exif32(tiff + 4, motorola);
+    uint32_t thumboffset = 0, thumblen = 0;
+
+    *orientation = 1;
+
+    // IFD0 (main image), then IFD1 (thumbnail)
+    for (int n = 0; n < 2; n++)
+    {
+        if (ifd < 8 || ifd + 2 > tifflen)
+        {
+            return false;
+        }
+
+        unsigned count = exif16(tiff + ifd, motorola);
+
+        if (ifd + 2 + count * 12 + 4 > tifflen)
+        {
+            return false;
+        }
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            const byte* e = tiff + ifd + 2 + i * 12;
+            unsigned tag = exif16(e, motorola);
+
+            if (!n && tag == 0x112)
+            {
+                *orientation = exif16(e + 8, motorola);
+            }
+            else if (n && tag == 0x201)
+            {
+                thumboffset = exif32(e + 8, motorola);
+            }
+            else if (n && tag == 0x202)
+            {
+                thumblen = exif32(e + 8, motorola);
+            }
+        }
+
+        ifd = exif32(tiff + ifd + 2 + count * 12, motorola);
+    }
+
+    if (!thumblen || thumboffset > tifflen || thumblen > tifflen - thumboffset)
+    {
+        return false;
+    }
+
+    // mirrored images are left to the full decode
+    if (*orientation != 1 && *orientation != 3 && *orientation != 6 && *orientation != 8)
+    {
+        return false;
+    }
+
+    int mw, mh, tw, th;
+
+    if (!jpegsize(data, len, &mw, &mh) || !jpegsize(tiff + thumboffset, thumblen, &tw, &th))
+    {
+        return false;
+    }
+
+    // too small, or letterboxed to a different aspect ratio (2% tolerance)
+    if ((tw < th ? tw : th) < size)
+    {
+        return false;
+    }
+
+    m_off_t a = (m_off_t)tw * mh;
+    m_off_t b = (m_off_t)th * mw;
+
+    if ((a > b ? a - b : b - a) * 50 > a)
+    {
+        return false;
+    }
+
+    thumb->assign((const char*)tiff + thumboffset, thumblen);
+
+    return true;
+}
+
+m_off_t GfxProc::readhead(string* localfilename, unsigned maxlen, string* head)
+{
+    if (source)
+    {
+        head->assign(source->ingested, 0, maxlen);
+        return source->size;
+    }
+
+    FileAccess* f = client->fsaccess->newfileaccess();
+    m_off_t size = -1;
+
+    head->clear();
+
+    if (f->fopen(localfilename, true, false))
+    {
+        size = f->size;
+
+        unsigned len = size < maxlen ? (unsigned)size : maxlen;
+
+        head->resize(len);
+
+        if (!f->frawread((byte*)head->data(), len, 0))
+        {
+            head->clear();
+        }
+    }
+
+    delete f;
+
+    return size;
+}
+
+// the estimates assume 32 bits per pixel (24 for JPEG) - JPEGs are decoded
+// at the power-of-two DCT scale that still covers the requested size
+m_off_t GfxProc::decodesize(string* localfilename, int size)
+{
+    string head;
+    m_off_t filesize = readhead(localfilename, 131072, &head);
+    const byte* data = (const byte*)head.data();
+    size_t len = head.size();
+    int w = 0, h = 0;
+
+    if (filesize < 0)
+    {
+        return 0;
+    }
+
+    if (jpegsize(data, len, &w, &h))
+    {
+        int scale = 8;
+
+        while (scale > 1 && (w / scale < size || h / scale < size))
+        {
+            scale /= 2;
+        }
+
+        return (m_off_t)(w / scale + 1) * (h / scale + 1) * 3;
+    }
+
+    if (len >= 24 && !memcmp(data, "\x89PNG\r\n\x1a\n", 8))
+    {
+        w = (int)exif32(data + 16, true);
+        h = (int)exif32(data + 20, true);
+    }
+    else if (len >= 10 && !memcmp(data, "GIF8", 4))
+    {
+        w = exif16(data + 6, false);
+        h = exif16(data + 8, false);
+    }
+    else if (len >= 26 && data[0] == 'B' && data[1] == 'M')
+    {
+        w = (int)exif32(data + 18, false);
+        h = (int)exif32(data + 22, false);
+    }
+    else if (len >= 8 && (!memcmp(data, "II*\0", 4) || !memcmp(data, "MM\0*", 4)))
+    {
+        bool motorola = data[0] == 'M';
+        uint32_t ifd = exif32(data + 4, motorola);
+
+        if (ifd >= 8 && ifd + 2 <= len)
+        {
+            unsigned count = exif16(data + ifd, motorola);
+
+            for (unsigned i = 0; i < count && ifd + 2 + i * 12 + 12 <= len; i++)
+            {
+                const byte* e = data + ifd + 2 + i * 12;
+                unsigned tag = exif16(e, motorola);
+
+                if (tag == 0x100 || tag == 0x101)
+                {
+                    // SHORT or LONG
+                    int v = exif16(e + 2, motorola) == 3 ? (int)exif16(e + 8, motorola) : (int)exif32(e + 8, motorola);
+
+                    if (tag == 0x100)
+                    {
+                        w = v;
+                    }
+                    else
+                    {
+                        h = v;
+                    }
+                }
+            }
+        }
+    }
+
+    if (w < 0)
+    {
+        w = -w;
+    }
+
+    if (h < 0)
+    {
+        h = -h;
+    }
+
+    if (w && h)
+    {
+        return (m_off_t)w * h * 4;
+    }
+
+    // unknown format: the decoded image is at least as large as the file
+    return filesize;
+}
+
 void GfxProc::transform(int& w, int& h, int& rw, int& rh, int& px, int& py)
 {
     if (rh)
@@ -100,21 +441,74 @@ void GfxProc::transform(int& w, int& h, int& rw, int& rh, int& px, int& py)
     }
 }
 
-// load bitmap image, generate all designated sizes, attach to specified upload/node handle
-// FIXME: move to a worker thread to keep the engine nonblocking
-int GfxProc::gendimensionsputfa(FileAccess* fa, string* localfilename, handle th, SymmCipher* key, int missing)
+// load bitmap image and generate the designated sizes
+int GfxProc::genimages(FileAccess* fa, string* localfilename, int missing, string** images)
 {
-    int numputs = 0;
+    int numimages = 0;
 
-    if (SimpleLogger::logCurrentLevel >= logDebug)
+    for (int i = NUMDIMENSIONS; i--; )
     {
-        string utf8path;
-        client->fsaccess->local2path(localfilename, &utf8path);
-        LOG_debug << "Creating thumb/preview for " << utf8path;
+        images[i] = NULL;
+    }
+
+    if (mutex)
+    {
+        mutex->lock();
+    }
+
+    source = fa && fa->ingested.size() ? fa : NULL;
+
+    // camera JPEGs usually embed a thumbnail large enough for ours
+    if (missing & (1 << THUMBNAIL120X120))
+    {
+        string thumb;
+        int orientation;
+
+        if (exifthumbnail(localfilename, dimensions[THUMBNAIL120X120][0], &thumb, &orientation)
+         && readbitmapdata(&thumb, orientation))
+        {
+            string* jpeg = new string;
+
+            if (resizebitmap(dimensions[THUMBNAIL120X120][0], dimensions[THUMBNAIL120X120][1], jpeg))
+            {
+                images[THUMBNAIL120X120] = jpeg;
+                numimages++;
+
+                missing &= ~(1 << THUMBNAIL120X120);
+            }
+            else
+            {
+                delete jpeg;
+            }
+
+            freebitmap();
+        }
+    }
+
+    // decode at the scale of the largest missing dimension (this assumes
+    // that its width is max)
+    int size = 0;
+
+    for (int i = NUMDIMENSIONS; i--; )
+    {
+        if (missing & (1 << i) && dimensions[i][0] > size)
+        {
+            size = dimensions[i][0];
+        }
+    }
+
+    if (size && decodelimit)
+    {
+        m_off_t needed = decodesize(localfilename, size);
+
+        if (needed > decodelimit)
+        {
+            LOG_warn << "Image too large to process (" << needed << " bytes to decode, limit " << decodelimit << ")";
+            size = 0;
+        }
     }
 
-    // (this assumes that the width of the largest dimension is max)
-    if (readbitmap(fa, localfilename, dimensions[sizeof dimensions/sizeof dimensions[0]-1][0]))
+    if (size && readbitmap(fa, localfilename, size))
     {
         string* jpeg = NULL;
 
@@ -128,14 +522,8 @@ int GfxProc::gendimensionsputfa(FileAccess* fa, string* localfilename, handle th
 
             if (missing & (1 << i) && resizebitmap(dimensions[i][0], dimensions[i][1], jpeg))
             {
-                // store the file attribute data - it will be attached to the file
-                // immediately if the upload has already completed; otherwise, once
-                // the upload completes
-                int creqtag = client->reqtag;
-                client->reqtag = 0;
-                client->putfa(th, (meta_t)i, key, jpeg);
-                client->reqtag = creqtag;
-                numputs++;
+                images[i] = jpeg;
+                numimages++;
 
                 jpeg = NULL;
             }
@@ -149,27 +537,118 @@ int GfxProc::gendimensionsputfa(FileAccess* fa, string* localfilename, handle th
         freebitmap();
     }
 
-    return numputs;
+    source = NULL;
+
+    if (mutex)
+    {
+        mutex->unlock();
+    }
+
+    return numimages;
 }
 
-bool GfxProc::savefa(string *localfilepath, GfxProc::meta_t type, string *localdstpath)
+// load bitmap image, generate all designated sizes, attach to specified
+// upload/node handle - on the gfx worker pool if the client has one
+int GfxProc::gendimensionsputfa(FileAccess* fa, string* localfilename, handle th, SymmCipher* key, int missing, FileFingerprint* fp)
 {
-    if (!isgfx(localfilepath)
-            // (this assumes that the width of the largest dimension is max)
-            || !readbitmap(NULL, localfilepath, dimensions[sizeof dimensions/sizeof dimensions[0]-1][0]))
+    int numputs = 0;
+
+    // reuse the images of identical content
+    for (int i = NUMDIMENSIONS; fp && i--; )
     {
-        return false;
+        if (!(missing & (1 << i)))
+        {
+            continue;
+        }
+
+        string* data = new string;
+
+        if (client->gfxcache.get(fp, (fatype)i, data))
+        {
+            int creqtag = client->reqtag;
+            client->reqtag = 0;
+            client->putfa(th, (meta_t)i, key, data);
+            client->reqtag = creqtag;
+            numputs++;
+
+            missing &= ~(1 << i);
+        }
+        else
+        {
+            delete data;
+        }
     }
 
-    string jpeg;
-    bool success = resizebitmap(dimensions[type][0], dimensions[type][1], &jpeg);
-    freebitmap();
+    if (!(missing & ((1 << NUMDIMENSIONS) - 1)))
+    {
+        return numputs;
+    }
+
+    if (SimpleLogger::logCurrentLevel >= logDebug)
+    {
+        string utf8path;
+        client->fsaccess->local2path(localfilename, &utf8path);
+        LOG_debug << "Creating thumb/preview for " << utf8path;
+    }
 
-    if (!success)
+    if (client->gfxpool)
+    {
+        // the job reopens the file by name, unless its content is in memory
+        FileAccess* jobfa = NULL;
+
+        if (fa && fa->ingested.size())
+        {
+            jobfa = client->fsaccess->newfileaccess();
+            jobfa->ingested = fa->ingested;
+            jobfa->size = fa->size;
+            jobfa->mtime = fa->mtime;
+        }
+
+        GfxJob* job = new GfxJob(this, localfilename, th, key, missing, fp, jobfa);
+
+        numputs += job->requested();
+        client->queuegfx(job);
+
+        return numputs;
+    }
+
+    string* images[NUMDIMENSIONS];
+
+    genimages(fa, localfilename, missing, images);
+
+    for (int i = NUMDIMENSIONS; i--; )
+    {
+        if (images[i])
+        {
+            client->gfxcache.put(fp, (fatype)i, images[i]->data(), images[i]->size());
+
+            // store the file attribute data - it will be attached to the file
+            // immediately if the upload has already completed; otherwise, once
+            // the upload completes
+            int creqtag = client->reqtag;
+            client->reqtag = 0;
+            client->putfa(th, (meta_t)i, key, images[i]);
+            client->reqtag = creqtag;
+            numputs++;
+        }
+    }
+
+    return numputs;
+}
+
+bool GfxProc::savefa(string *localfilepath, GfxProc::meta_t type, string *localdstpath)
+{
+    string* images[NUMDIMENSIONS];
+
+    if (!isgfx(localfilepath) || !genimages(NULL, localfilepath, 1 << type, images))
     {
         return false;
     }
 
+    string jpeg;
+    jpeg.swap(*images[type]);
+    delete images[type];
+
     FileAccess *f = client->fsaccess->newfileaccess();
     client->fsaccess->unlinklocal(localdstpath);
     if (!f->fopen(localdstpath, false, true))
@@ -191,5 +670,64 @@ bool GfxProc::savefa(string *localfilepath, GfxProc::meta_t type, string *locald
 GfxProc::GfxProc()
 {
     client = NULL;
+    mutex = NULL;
+    source = NULL;
+    decodelimit = DEFAULTDECODELIMIT;
+}
+
+GfxProc::~GfxProc()
+{
+    delete mutex;
+}
+
+GfxJob::GfxJob(GfxProc* cgfx, string* clocalname, handle cth, SymmCipher* ckey, int cmissing, FileFingerprint* fp, FileAccess* cfa)
+{
+    fa = cfa;
+
+    if (fp)
+    {
+        fingerprint = *fp;
+    }
+
+    gfx = cgfx;
+    localname = *clocalname;
+    th = cth;
+    key = *ckey;
+    missing = cmissing;
+
+    for (int i = GfxProc::NUMDIMENSIONS; i--; )
+    {
+        images[i] = NULL;
+    }
+}
+
+GfxJob::~GfxJob()
+{
+    delete fa;
+
+    for (int i = GfxProc::NUMDIMENSIONS; i--; )
+    {
+        delete images[i];
+    }
+}
+
+int GfxJob::requested() const
+{
+    int count = 0;
+
+    for (int i = GfxProc::NUMDIMENSIONS; i--; )
+    {
+        if (missing & (1 << i))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void GfxJob::run()
+{
+    gfx->genimages(fa, &localname, missing, images);
 }
 } // namespace
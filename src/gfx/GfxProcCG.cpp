@@ -76,6 +76,11 @@ bool GfxProcCG::readbitmap(FileAccess* fa, string* name, int size) {
     return (int)w && (int)h;
 }
 
+// ImageIO decodes thumbnails subsampled, bounded by the requested size
+m_off_t GfxProcCG::decodesize(string*, int size) {
+    return (m_off_t)size * size * 4;
+}
+
 CGImageRef GfxProcCG::createThumbnailWithMaxSize(int size) {
     const double maxSizeDouble = size;
     CFNumberRef maxSize = CFNumberCreate(kCFAllocatorDefault, kCFNumberDoubleType, &maxSizeDouble);
@@ -22,6 +22,14 @@
 #include "mega.h"
 #include "mega/gfx/freeimage.h"
 
+#ifdef USE_FFMPEG
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+#endif
+
 #ifdef _WIN32
 #define FreeImage_GetFileTypeX FreeImage_GetFileTypeU
 #define FreeImage_LoadX FreeImage_LoadU
@@ -48,6 +56,10 @@ GfxProcFreeImage::GfxProcFreeImage()
 #ifdef FREEIMAGE_LIB
 	FreeImage_Initialise(TRUE);
 #endif
+
+#if defined(USE_FFMPEG) && LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+    av_register_all();
+#endif
 }
 
 const char* GfxProcFreeImage::supportedformats()
@@ -56,17 +68,238 @@ const char* GfxProcFreeImage::supportedformats()
            ".jbig.jng.jif.koala.pcd.mng.pcx.pbm.pgm.ppm.pfm.pict.pic.pct.pds.raw.3fr.ari"
            ".arw.bay.crw.cr2.cap.dcs.dcr.dng.drf.eip.erf.fff.iiq.k25.kdc.mdc.mef.mos.mrw"
            ".nef.nrw.obm.orf.pef.ptx.pxn.r3d.raf.raw.rwl.rw2.rwz.sr2.srf.srw.x3f.ras.tga"
-           ".xbm.xpm.jp2.j2k.jpf.jpx.";
+           ".xbm.xpm.jp2.j2k.jpf.jpx."
+#ifdef USE_FFMPEG
+           "mp4.m4v.mov.3gp.3g2.mkv.webm.avi.wmv.asf.flv.mpg.mpeg.mts.m2ts.ts.ogv."
+#endif
+           ;
+}
+
+#ifdef USE_FFMPEG
+const char* GfxProcFreeImage::videoformats()
+{
+    return ".mp4.m4v.mov.3gp.3g2.mkv.webm.avi.wmv.asf.flv.mpg.mpeg.mts.m2ts.ts.ogv.";
+}
+
+bool GfxProcFreeImage::isvideo(string* localname)
+{
+    char ext[8];
+    const char* ptr;
+
+    return client->fsaccess->getextension(localname, ext, sizeof ext)
+        && (ptr = strstr(videoformats(), ext)) && ptr[strlen(ext)] == '.';
+}
+
+// a decoded frame (up to 4K) - the stream is never decoded as a whole
+m_off_t GfxProcFreeImage::decodesize(string* localname, int size)
+{
+    if (isvideo(localname))
+    {
+        return (m_off_t)3840 * 2160 * 4;
+    }
+
+    return GfxProc::decodesize(localname, size);
 }
 
+// seek to a keyframe at 10% of the duration (the first frames are often
+// black), decode only keyframes and convert the first one straight to a
+// bitmap whose short side covers the requested size
+bool GfxProcFreeImage::readbitmapffmpeg(string* localname, int size)
+{
+    string path;
+    AVFormatContext* format = NULL;
+    AVCodecContext* codec = NULL;
+    AVFrame* frame = NULL;
+    AVPacket* packet = NULL;
+    struct SwsContext* sws = NULL;
+    const AVCodec* decoder;
+    AVStream* st;
+    AVDictionaryEntry* rotate;
+    int stream;
+    bool got = false;
+
+    client->fsaccess->local2path(localname, &path);
+
+    if (avformat_open_input(&format, path.c_str(), NULL, NULL))
+    {
+        return false;
+    }
+
+    if (avformat_find_stream_info(format, NULL) < 0
+     || (stream = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0)) < 0)
+    {
+        avformat_close_input(&format);
+        return false;
+    }
+
+    st = format->streams[stream];
+
+    if (!(decoder = avcodec_find_decoder(st->codecpar->codec_id))
+     || !(codec = avcodec_alloc_context3(decoder))
+     || avcodec_parameters_to_context(codec, st->codecpar) < 0)
+    {
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+        return false;
+    }
+
+    codec->skip_frame = AVDISCARD_NONKEY;
+    codec->skip_loop_filter = AVDISCARD_ALL;
+
+    if (avcodec_open2(codec, decoder, NULL) < 0
+     || !(frame = av_frame_alloc())
+     || !(packet = av_packet_alloc()))
+    {
+        av_frame_free(&frame);
+        avcodec_free_context(&codec);
+        avformat_close_input(&format);
+        return false;
+    }
+
+    if (format->duration > 0)
+    {
+        av_seek_frame(format, -1, format->duration / 10, AVSEEK_FLAG_BACKWARD);
+    }
+
+    for (int i = 0; !got && i < 1024 && av_read_frame(format, packet) >= 0; i++)
+    {
+        if (packet->stream_index == stream && !avcodec_send_packet(codec, packet))
+        {
+            got = !avcodec_receive_frame(codec, frame);
+        }
+
+        av_packet_unref(packet);
+    }
+
+    if (!got && !avcodec_send_packet(codec, NULL))
+    {
+        got = !avcodec_receive_frame(codec, frame);
+    }
+
+    if (got && frame->width > 0 && frame->height > 0)
+    {
+        int fw = frame->width;
+        int fh = frame->height;
+
+        // display size of anamorphic video
+        if (frame->sample_aspect_ratio.num > 0 && frame->sample_aspect_ratio.den > 0)
+        {
+            fw = (int)((m_off_t)fw * frame->sample_aspect_ratio.num / frame->sample_aspect_ratio.den);
+        }
+
+        int dw = fw;
+        int dh = fh;
+        int shortside = fw < fh ? fw : fh;
+
+        if (shortside > size)
+        {
+            dw = (int)((m_off_t)fw * size / shortside);
+            dh = (int)((m_off_t)fh * size / shortside);
+        }
+
+        if (dw > 0 && dh > 0 && (dib = FreeImage_Allocate(dw, dh, 24)))
+        {
+            sws = sws_getContext(frame->width, frame->height, (AVPixelFormat)frame->format, dw, dh,
+#if FREEIMAGE_COLORORDER == FREEIMAGE_COLORORDER_RGB
+                                 AV_PIX_FMT_RGB24,
+#else
+                                 AV_PIX_FMT_BGR24,
+#endif
+                                 SWS_FAST_BILINEAR, NULL, NULL, NULL);
+
+            if (sws)
+            {
+                // FreeImage bitmaps are stored bottom-up
+                uint8_t* dst[4] = { FreeImage_GetScanLine(dib, dh - 1), NULL, NULL, NULL };
+                int dststride[4] = { -(int)FreeImage_GetPitch(dib), 0, 0, 0 };
+
+                sws_scale(sws, frame->data, frame->linesize, 0, frame->height, dst, dststride);
+                sws_freeContext(sws);
+
+                w = dw;
+                h = dh;
+
+                // recorded rotation of phone videos (clockwise)
+                if ((rotate = av_dict_get(st->metadata, "rotate", NULL, 0)))
+                {
+                    int angle = atoi(rotate->value);
+
+                    if (angle == 90 || angle == 180 || angle == 270)
+                    {
+                        FIBITMAP* tdib;
+
+                        if ((tdib = FreeImage_Rotate(dib, 360 - angle)))
+                        {
+                            FreeImage_Unload(dib);
+                            dib = tdib;
+
+                            w = FreeImage_GetWidth(dib);
+                            h = FreeImage_GetHeight(dib);
+                        }
+                    }
+                }
+            }
+            else
+            {
+                FreeImage_Unload(dib);
+                dib = NULL;
+            }
+        }
+    }
+
+    av_packet_free(&packet);
+    av_frame_free(&frame);
+    avcodec_free_context(&codec);
+    avformat_close_input(&format);
+
+    return dib != NULL;
+}
+#endif
+
 bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
 {
+#ifdef USE_FFMPEG
+    if (isvideo(localname))
+    {
+        dib = NULL;
+        return readbitmapffmpeg(localname, size);
+    }
+#endif
+
+    FIMEMORY* hmem = NULL;
+
+    // content already read by FileAccess::ingest() is decoded from memory
+    if (fa && fa->ingested.size())
+    {
+        hmem = FreeImage_OpenMemory((BYTE*)fa->ingested.data(), (DWORD)fa->ingested.size());
+    }
+
+    bool r = decodebitmap(hmem, localname, size);
+
+    if (hmem)
+    {
+        FreeImage_CloseMemory(hmem);
+    }
+
+    return r;
+}
+
+// decode from memory if hmem is set, from the file otherwise
+FIBITMAP* GfxProcFreeImage::loadbitmap(FREE_IMAGE_FORMAT fif, FIMEMORY* hmem, string* localname, int flags)
+{
+    return hmem ? FreeImage_LoadFromMemory(fif, hmem, flags)
+                : FreeImage_LoadX(fif, (freeimage_filename_char_t*)localname->data(), flags);
+}
+
+bool GfxProcFreeImage::decodebitmap(FIMEMORY* hmem, string* localname, int size)
+{
 #ifdef _WIN32
     localname->append("", 1);
 #endif
 
     // FIXME: race condition, need to use open file instead of filename
-    FREE_IMAGE_FORMAT fif = FreeImage_GetFileTypeX((freeimage_filename_char_t*)localname->data());
+    FREE_IMAGE_FORMAT fif = hmem ? FreeImage_GetFileTypeFromMemory(hmem, 0)
+                                 : FreeImage_GetFileTypeX((freeimage_filename_char_t*)localname->data());
 
     if (fif == FIF_UNKNOWN)
     {
@@ -82,8 +315,7 @@ bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
         // load JPEG (scale & EXIF-rotate)
         FITAG *tag;
 
-        if (!(dib = FreeImage_LoadX(fif, (freeimage_filename_char_t*) localname->data(),
-                                    JPEG_EXIFROTATE | JPEG_FAST | (size << 16))))
+        if (!(dib = loadbitmap(fif, hmem, localname, JPEG_EXIFROTATE | JPEG_FAST | (size << 16))))
         {
 #ifdef _WIN32
             localname->resize(localname->size()-1);
@@ -113,7 +345,7 @@ bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
 #endif
     {
         // load all other image types - for RAW formats, rely on embedded preview
-        if (!(dib = FreeImage_LoadX(fif, (freeimage_filename_char_t*)localname->data(),
+        if (!(dib = loadbitmap(fif, hmem, localname,
                 #ifndef OLD_FREEIMAGE
                                     (fif == FIF_RAW) ? RAW_PREVIEW : 0)))
                 #else
@@ -133,6 +365,62 @@ bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
     return true;
 }
 
+bool GfxProcFreeImage::readbitmapdata(const string* jpeg, int orientation)
+{
+#ifndef OLD_FREEIMAGE
+    FIMEMORY* hmem;
+    FIBITMAP* tdib = NULL;
+
+    if (!(hmem = FreeImage_OpenMemory((BYTE*)jpeg->data(), (DWORD)jpeg->size())))
+    {
+        return false;
+    }
+
+    dib = FreeImage_LoadFromMemory(FIF_JPEG, hmem, 0);
+    FreeImage_CloseMemory(hmem);
+
+    if (!dib)
+    {
+        return false;
+    }
+
+    // apply the main image's EXIF orientation (counterclockwise angles)
+    switch (orientation)
+    {
+        case 3:
+            tdib = FreeImage_Rotate(dib, 180);
+            break;
+
+        case 6:
+            tdib = FreeImage_Rotate(dib, 270);
+            break;
+
+        case 8:
+            tdib = FreeImage_Rotate(dib, 90);
+            break;
+    }
+
+    if (tdib)
+    {
+        FreeImage_Unload(dib);
+        dib = tdib;
+    }
+    else if (orientation != 1)
+    {
+        FreeImage_Unload(dib);
+        dib = NULL;
+        return false;
+    }
+
+    w = FreeImage_GetWidth(dib);
+    h = FreeImage_GetHeight(dib);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool GfxProcFreeImage::resizebitmap(int rw, int rh, string* jpegout)
 {
     FIBITMAP* tdib;
@@ -364,6 +364,34 @@ bool GfxProcQT::readbitmap(FileAccess*, string* localname, int)
     return (image!=NULL);
 }
 
+bool GfxProcQT::readbitmapdata(const string* jpeg, int corientation)
+{
+    imagedata.setData(jpeg->data(), jpeg->size());
+    imagedata.open(QIODevice::ReadOnly);
+
+    image = new QImageReader(&imagedata, "JPG");
+    QSize s = image->size();
+    if(!s.isValid() || !s.width() || !s.height())
+    {
+        freebitmap();
+        return false;
+    }
+
+    orientation = corientation;
+    if(orientation < ROTATION_LEFT_MIRRORED)
+    {
+        w = s.width();
+        h = s.height();
+    }
+    else
+    {
+        w = s.height();
+        h = s.width();
+    }
+
+    return true;
+}
+
 bool GfxProcQT::resizebitmap(int rw, int rh, string* jpegout)
 {
     QImage result = resizebitmapQT(image, orientation, w, h, rw, rh);
@@ -381,6 +409,13 @@ bool GfxProcQT::resizebitmap(int rw, int rh, string* jpegout)
 void GfxProcQT::freebitmap()
 {
     delete image;
+    image = NULL;
+
+    if(imagedata.isOpen())
+    {
+        imagedata.close();
+        imagedata.setData(QByteArray());
+    }
 }
 
 QImage GfxProcQT::createThumbnail(QString imagePath)
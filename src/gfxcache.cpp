@@ -0,0 +1,339 @@
+/**
+ * @file gfxcache.cpp
+ * @brief Local cache of thumbnails and previews by file fingerprint
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+
+#include "mega/gfxcache.h"
+#include "mega/utils.h"
+#include "mega/logging.h"
+
+namespace mega {
+GfxCache::GfxCache()
+{
+    table = NULL;
+    key = NULL;
+    limit = DEFAULTLIMIT;
+    bytes = 0;
+    memlimit = DEFAULTMEMLIMIT;
+    membytes = 0;
+    usecounter = 0;
+    dirty = false;
+}
+
+GfxCache::~GfxCache()
+{
+    close();
+}
+
+bool GfxCache::cachekey(const FileFingerprint* fp, fatype type, string* k)
+{
+    if (!fp || !fp->isvalid)
+    {
+        return false;
+    }
+
+    int64_t t;
+
+    k->clear();
+
+    t = fp->size;
+    k->append((const char*)&t, sizeof t);
+
+    t = fp->mtime;
+    k->append((const char*)&t, sizeof t);
+
+    k->append((const char*)fp->crc, sizeof fp->crc);
+    k->append((const char*)&type, sizeof type);
+
+    return true;
+}
+
+void GfxCache::open(DbTable* ctable, SymmCipher* ckey)
+{
+    close();
+
+    table = ctable;
+    key = ckey;
+
+    if (table)
+    {
+        readindex();
+    }
+}
+
+void GfxCache::close()
+{
+    if (table && dirty)
+    {
+        writeindex();
+    }
+
+    delete table;
+    table = NULL;
+    key = NULL;
+
+    entries.clear();
+    bytes = 0;
+    dirty = false;
+
+    blobs.clear();
+    membytes = 0;
+}
+
+// index record: per entry, its key, record id, size and recency, ordered
+// from least to most recently used
+void GfxCache::readindex()
+{
+    string data;
+
+    const unsigned keylen = 2 * sizeof(int64_t) + 4 * sizeof(int32_t) + sizeof(fatype);
+    const unsigned entrylen = keylen + 2 * sizeof(uint32_t);
+
+    if (!table->get(INDEXRECORD, &data) || !PaddedCBC::decrypt(&data, key))
+    {
+        table->truncate();
+        return;
+    }
+
+    for (size_t pos = 0; pos + entrylen <= data.size(); pos += entrylen)
+    {
+        Entry* e = &entries[data.substr(pos, keylen)];
+
+        e->id = MemAccess::get<uint32_t>(data.data() + pos + keylen);
+        e->size = MemAccess::get<uint32_t>(data.data() + pos + keylen + sizeof(uint32_t));
+        e->lastuse = ++usecounter;
+
+        table->trackid(e->id);
+        bytes += e->size;
+    }
+
+    LOG_debug << "Thumbnail cache: " << entries.size() << " entries, " << bytes << " bytes";
+
+    if (bytes > limit)
+    {
+        evict(0);
+    }
+}
+
+void GfxCache::writeindex()
+{
+    vector<entry_map::iterator> order;
+    string data;
+
+    for (entry_map::iterator it = entries.begin(); it != entries.end(); it++)
+    {
+        order.push_back(it);
+    }
+
+    // least recently used first (insertion sort is enough for the entries
+    // that a size-bounded cache can hold)
+    for (size_t i = 1; i < order.size(); i++)
+    {
+        entry_map::iterator it = order[i];
+        size_t j = i;
+
+        while (j && order[j - 1]->second.lastuse > it->second.lastuse)
+        {
+            order[j] = order[j - 1];
+            j--;
+        }
+
+        order[j] = it;
+    }
+
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        data.append(order[i]->first);
+        data.append((const char*)&order[i]->second.id, sizeof order[i]->second.id);
+        data.append((const char*)&order[i]->second.size, sizeof order[i]->second.size);
+    }
+
+    PaddedCBC::encrypt(&data, key);
+    table->put(INDEXRECORD, &data);
+
+    dirty = false;
+}
+
+bool GfxCache::get(const FileFingerprint* fp, fatype type, string* data)
+{
+    string k;
+    entry_map::iterator it;
+    blob_map::iterator bit;
+
+    if (!cachekey(fp, type, &k))
+    {
+        return false;
+    }
+
+    if ((bit = blobs.find(k)) != blobs.end())
+    {
+        *data = bit->second.data;
+        bit->second.lastuse = ++usecounter;
+
+        if ((it = entries.find(k)) != entries.end())
+        {
+            it->second.lastuse = usecounter;
+            dirty = true;
+        }
+
+        return true;
+    }
+
+    if (!table || (it = entries.find(k)) == entries.end())
+    {
+        return false;
+    }
+
+    if (!table->get(it->second.id, data) || !PaddedCBC::decrypt(data, key) || data->size() != it->second.size)
+    {
+        LOG_warn << "Dropping corrupt thumbnail cache record";
+        remove(it);
+        writeindex();
+        return false;
+    }
+
+    it->second.lastuse = ++usecounter;
+    dirty = true;
+
+    memput(&k, data);
+
+    return true;
+}
+
+bool GfxCache::has(const FileFingerprint* fp, fatype type) const
+{
+    string k;
+
+    return cachekey(fp, type, &k) && (blobs.count(k) || (table && entries.count(k)));
+}
+
+void GfxCache::put(const FileFingerprint* fp, fatype type, const char* attr, unsigned len)
+{
+    string k;
+
+    if (!len || !cachekey(fp, type, &k))
+    {
+        return;
+    }
+
+    string data(attr, len);
+
+    if (!blobs.count(k))
+    {
+        memput(&k, &data);
+    }
+
+    if (!table || len > limit || entries.count(k))
+    {
+        return;
+    }
+
+    evict(len);
+    Entry* e = &entries[k];
+
+    e->id = table->newid(DATARECORD);
+    e->size = len;
+    e->lastuse = ++usecounter;
+
+    PaddedCBC::encrypt(&data, key);
+
+    if (!table->put(e->id, &data))
+    {
+        entries.erase(k);
+        return;
+    }
+
+    bytes += len;
+    writeindex();
+}
+
+void GfxCache::setlimit(m_off_t climit)
+{
+    limit = climit < 0 ? 0 : climit;
+
+    if (table && bytes > limit)
+    {
+        evict(0);
+        writeindex();
+    }
+}
+
+void GfxCache::setmemlimit(m_off_t climit)
+{
+    string none;
+
+    memlimit = climit < 0 ? 0 : climit;
+    memput(NULL, &none);
+}
+
+void GfxCache::memput(const string* k, const string* data)
+{
+    while (blobs.size() && membytes + (m_off_t)data->size() > memlimit)
+    {
+        blob_map::iterator lru = blobs.begin();
+
+        for (blob_map::iterator it = blobs.begin(); it != blobs.end(); it++)
+        {
+            if (it->second.lastuse < lru->second.lastuse)
+            {
+                lru = it;
+            }
+        }
+
+        membytes -= lru->second.data.size();
+        blobs.erase(lru);
+    }
+
+    if (k && (m_off_t)data->size() <= memlimit)
+    {
+        Blob* b = &blobs[*k];
+
+        b->data = *data;
+        b->lastuse = ++usecounter;
+        membytes += data->size();
+    }
+}
+
+void GfxCache::evict(m_off_t needed)
+{
+    while (entries.size() && bytes + needed > limit)
+    {
+        entry_map::iterator lru = entries.begin();
+
+        for (entry_map::iterator it = entries.begin(); it != entries.end(); it++)
+        {
+            if (it->second.lastuse < lru->second.lastuse)
+            {
+                lru = it;
+            }
+        }
+
+        remove(lru);
+    }
+}
+
+void GfxCache::remove(entry_map::iterator it)
+{
+    table->del(it->second.id);
+    bytes -= it->second.size;
+    entries.erase(it);
+    dirty = true;
+}
+} // namespace
@@ -22,6 +22,11 @@
 #include "mega/http.h"
 #include "mega/megaclient.h"
 
+#if defined(HAVE_ZLIB_H) || defined(_WIN32)
+#include <zlib.h>
+#define HAVE_REQUEST_DEFLATE 1
+#endif
+
 namespace mega {
 HttpIO::HttpIO()
 {
@@ -30,6 +35,8 @@ HttpIO::HttpIO()
     inetback = false;
     lastdata = NEVER;
     chunkedok = true;
+    compressthreshold = 0;
+    reportsactivity = false;
 }
 
 // signal Internet status - if the Internet was down for more than one minute,
@@ -70,9 +77,61 @@ void HttpReq::post(MegaClient* client, const char* data, unsigned len)
     inpurge = 0;
     contentlength = -1;
 
+    timeline.reset();
+    timeline.posted = Waiter::us();
+
+    // large API command batches compress well
+    deflated = false;
+
+    if (!data && type == REQ_JSON && !chunked && httpio->compressthreshold
+     && out->size() >= httpio->compressthreshold && deflateout())
+    {
+        deflated = true;
+        data = deflatedout.data();
+        len = deflatedout.size();
+    }
+
     httpio->post(this, data, len);
 }
 
+bool HttpReq::deflateout()
+{
+#ifdef HAVE_REQUEST_DEFLATE
+    z_stream z;
+
+    memset(&z, 0, sizeof z);
+
+    // windowBits 15 + 16: gzip wrapper
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+
+    deflatedout.resize(deflateBound(&z, out->size()));
+
+    z.next_in = (Bytef*)out->data();
+    z.avail_in = out->size();
+    z.next_out = (Bytef*)deflatedout.data();
+    z.avail_out = deflatedout.size();
+
+    int result = deflate(&z, Z_FINISH);
+
+    deflatedout.resize(z.total_out);
+    deflateEnd(&z);
+
+    // only worth it if at least a tenth is saved
+    if (result != Z_STREAM_END || deflatedout.size() > out->size() - out->size() / 10)
+    {
+        deflatedout.clear();
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 // attempt to send chunked data, remove from out
 void HttpReq::postchunked(MegaClient* client)
 {
@@ -110,6 +169,7 @@ HttpReq::HttpReq(bool b)
     out = &outbuf;
 
     inpurge = 0;
+    deflated = false;
     
     chunked = false;
     sslcheckfailed = false;
@@ -118,7 +178,11 @@ HttpReq::HttpReq(bool b)
     buflen = 0;
     bufpos = 0;
     contentlength = 0;
+    maxspeed = 0;
+    maxbuffered = 0;
+    recvpaused = false;
     lastdata = 0;
+    activity = NULL;
 }
 
 HttpReq::~HttpReq()
@@ -144,6 +208,11 @@ void HttpReq::setreq(const char* u, contenttype_t t)
 // add data to fixed or variable buffer
 void HttpReq::put(void* data, unsigned len, bool purge)
 {
+    if (!timeline.firstbyte)
+    {
+        timeline.firstbyte = Waiter::us();
+    }
+
     if (buf)
     {
         if (bufpos + len > buflen)
@@ -157,14 +226,18 @@ void HttpReq::put(void* data, unsigned len, bool purge)
     {
         if (inpurge && purge)
         {
-            in.erase(0, inpurge);
-            inpurge = 0;
+            compactin(len);
         }
 
         in.append((char*)data, len);
     }
     
     bufpos += len;
+
+    if (activity)
+    {
+        *activity = true;
+    }
 }
 
 char* HttpReq::data()
@@ -183,6 +256,34 @@ void HttpReq::purge(size_t numbytes)
     inpurge += numbytes;
 }
 
+// drop the purged head of the response buffer once it accounts for at least
+// half of the buffered data, or if appending len bytes would reallocate
+// anyway - every byte is moved a bounded number of times, so streamed
+// responses are accumulated in linear time; returns the bytes dropped
+size_t HttpReq::compactin(size_t len)
+{
+    size_t valid = in.size() - inpurge;
+
+    if (inpurge < valid && in.size() + len <= in.capacity())
+    {
+        return 0;
+    }
+
+    size_t dropped = inpurge;
+
+    // single move of the unconsumed tail, followed by a truncation that
+    // cannot reallocate
+    if (valid)
+    {
+        memmove((char*)in.data(), in.data() + inpurge, valid);
+    }
+
+    in.resize(valid);
+    inpurge = 0;
+
+    return dropped;
+}
+
 // set total response size
 void HttpReq::setcontentlength(m_off_t len)
 {
@@ -210,10 +311,7 @@ byte* HttpReq::reserveput(unsigned* len)
     {
         if (inpurge)
         {
-            // FIXME: optimize erase()/resize() -> single copy/resize()
-            in.erase(0, inpurge);
-            bufpos -= inpurge;
-            inpurge = 0;
+            bufpos -= compactin(*len);
         }
 
         if (bufpos + *len > in.size())
@@ -228,53 +326,143 @@ byte* HttpReq::reserveput(unsigned* len)
 }
 
 // number of bytes transferred in this request
-m_off_t HttpReq::transferred(MegaClient*)
+m_off_t HttpReq::transferred(MegaClient* client)
 {
-    if (buf)
-    {
-        return bufpos;
-    }
-    else
-    {
-        return in.size();
-    }
+    m_off_t t;
+
+    // (received by the network thread)
+    client->httpio->lock();
+    t = buf ? bufpos : in.size();
+    client->httpio->unlock();
+
+    return t;
 }
 
-// prepare file chunk download
-bool HttpReqDL::prepare(FileAccess* fa, const char* tempurl, SymmCipher* key,
-                        chunkmac_map* macs, uint64_t ctriv, m_off_t pos,
-                        m_off_t npos)
+void HttpReqDL::seturl(const char* tempurl)
 {
     char urlbuf[256];
 
-    snprintf(urlbuf, sizeof urlbuf, "%s/%" PRIu64 "-%" PRIu64, tempurl, pos, npos - 1);
+    snprintf(urlbuf, sizeof urlbuf, "%s/%" PRIu64 "-%" PRIu64, tempurl, dlpos, dlpos + size - 1);
     setreq(urlbuf, REQ_BINARY);
+}
 
+// prepare file chunk download
+bool HttpReqDL::prepare(FileAccess* fa, const char* tempurl, SymmCipher* key,
+                        chunkmac_map* macs, uint64_t ctriv, m_off_t pos,
+                        m_off_t npos)
+{
     dlpos = pos;
     size = (unsigned)(npos - pos);
 
-    if (!buf || buflen != size)
+    seturl(tempurl);
+
+    // receive straight into the pooled buffer
+    buf = getchunkbuf((size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE);
+    buflen = size;
+
+    return true;
+}
+
+HttpReqXfer::~HttpReqXfer()
+{
+    // the transport may still reference the buffer
+    disconnect();
+
+    if (buf == chunkbuf)
     {
-        // (re)allocate buffer
-        if (buf)
-        {
-            delete[] buf;
-        }
+        buf = NULL;
+    }
+
+    releasechunkbuf();
+}
 
-        buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
-        buflen = size;
+byte* HttpReqXfer::getchunkbuf(unsigned len)
+{
+    if (!chunkbuf || chunkbufsize < len)
+    {
+        releasechunkbuf();
+        chunkbuf = bufferpool->get(len, &chunkbufsize);
     }
 
-    return true;
+    return chunkbuf;
+}
+
+void HttpReqXfer::releasechunkbuf()
+{
+    if (chunkbuf)
+    {
+        bufferpool->release(chunkbuf, chunkbufsize);
+        chunkbuf = NULL;
+        chunkbufsize = 0;
+    }
+}
+
+// en/decrypt a buffer spanning one or more contiguous chunks and record the
+// MAC of each chunk at its start offset
+void HttpReqXfer::cryptchunks(SymmCipher* key, byte* data, unsigned len, m_off_t pos,
+                              uint64_t ctriv, chunkmac_map* macs, bool encrypt)
+{
+    vector<const byte*> starts;
+    vector<unsigned> lens;
+    vector<m_off_t> offsets;
+
+    for (unsigned done = 0; done < len; )
+    {
+        m_off_t npos = ChunkedHash::chunkceil(pos + done);
+        unsigned n = (npos - pos - done < len - done) ? (unsigned)(npos - pos - done) : len - done;
+
+        starts.push_back(data + done);
+        lens.push_back(n);
+        offsets.push_back(pos + done);
+
+        done += n;
+    }
+
+    if (!starts.size())
+    {
+        return;
+    }
+
+    // the chunk MACs are independent CBC-MAC chains over the plaintext, all
+    // starting from the same IV - compute them interleaved, and en/decrypt
+    // the whole contiguous buffer in one CTR pass
+    unsigned n = starts.size();
+    byte* chunkmacs = new byte[n * SymmCipher::BLOCKSIZE];
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        MemAccess::set<int64_t>(chunkmacs + i * SymmCipher::BLOCKSIZE, ctriv);
+        MemAccess::set<int64_t>(chunkmacs + i * SymmCipher::BLOCKSIZE + sizeof ctriv, ctriv);
+    }
+
+    if (encrypt)
+    {
+        key->cbc_macs(&starts[0], &lens[0], chunkmacs, n);
+        key->ctr_crypt(data, len, pos, ctriv, NULL, true);
+    }
+    else
+    {
+        key->ctr_crypt(data, len, pos, ctriv, NULL, false);
+        key->cbc_macs(&starts[0], &lens[0], chunkmacs, n);
+    }
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        memcpy((*macs)[offsets[i]].mac, chunkmacs + i * SymmCipher::BLOCKSIZE, SymmCipher::BLOCKSIZE);
+    }
+
+    delete[] chunkmacs;
 }
 
-// decrypt, mac and write downloaded chunk
+// decrypt, mac and write downloaded chunk(s)
 void HttpReqDL::finalize(FileAccess* fa, SymmCipher* key, chunkmac_map* macs,
                          uint64_t ctriv, m_off_t startpos, m_off_t endpos)
 {
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    int64_t t = Waiter::us();
 
-    key->ctr_crypt(buf, bufpos, dlpos, ctriv, mac, 0);
+    cryptchunks(key, buf, bufpos, dlpos, ctriv, macs, false);
+
+    cryptous = Waiter::us() - t;
 
     unsigned skip;
     unsigned prune;
@@ -305,37 +493,181 @@ void HttpReqDL::finalize(FileAccess* fa, SymmCipher* key, chunkmac_map* macs,
         }
     }
 
+    t = Waiter::us();
     fa->fwrite(buf + skip, bufpos - skip - prune, dlpos + skip);
+    diskus = Waiter::us() - t;
+}
 
-    memcpy((*macs)[dlpos].mac, mac, sizeof mac);
+HttpReqDLJob::HttpReqDLJob(HttpReqDL* creq, FileAccess* cfa, Mutex* cfamutex,
+                           SymmCipher* ckey, uint64_t cctriv)
+{
+    req = creq;
+    fa = cfa;
+    famutex = cfamutex;
+    key.setkey(ckey->key);
+    ctriv = cctriv;
+    cryptous = 0;
+    diskus = 0;
 }
 
-// prepare chunk for uploading: mac and encrypt
+void HttpReqDLJob::run()
+{
+    int64_t t = Waiter::us();
+
+    HttpReqXfer::cryptchunks(&key, req->buf, req->bufpos, req->dlpos, ctriv, &macs, false);
+
+    cryptous = Waiter::us() - t;
+
+    bool serial = !fa->concurrentio();
+
+    if (serial)
+    {
+        famutex->lock();
+    }
+
+    t = Waiter::us();
+    fa->fwrite(req->buf, req->bufpos, req->dlpos);
+    diskus = Waiter::us() - t;
+
+    if (serial)
+    {
+        famutex->unlock();
+    }
+}
+
+// prepare chunk(s) for uploading: mac and encrypt
 bool HttpReqUL::prepare(FileAccess* fa, const char* tempurl, SymmCipher* key,
                         chunkmac_map* macs, uint64_t ctriv, m_off_t pos,
                         m_off_t npos)
 {
     size = (unsigned)(npos - pos);
 
-    if (!fa->fread(out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), pos))
+    unsigned padded = (size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE;
+    byte* data = getchunkbuf(padded);
+    int64_t t = Waiter::us();
+
+    if (!fa->frawread(data, size, pos))
     {
         return false;
     }
 
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    diskus = Waiter::us() - t;
+
+    memset(data + size, 0, padded - size);
+
     char buf[256];
 
     snprintf(buf, sizeof buf, "%s/%" PRIu64, tempurl, pos);
     setreq(buf, REQ_BINARY);
 
-    key->ctr_crypt((byte*)out->data(), size, pos, ctriv, mac, 1);
+    t = Waiter::us();
+    cryptchunks(key, data, size, pos, ctriv, macs, true);
+    cryptous = Waiter::us() - t;
 
-    memcpy((*macs)[pos].mac, mac, sizeof mac);
+    return true;
+}
 
-    // unpad for POSTing
-    out->resize(size);
+void HttpReqUL::prepare(const char* tempurl, HttpReqULJob* job, chunkmac_map* macs)
+{
+    char buf[256];
 
-    return true;
+    size = (unsigned)(job->npos - job->pos);
+
+    snprintf(buf, sizeof buf, "%s/%" PRIu64, tempurl, job->pos);
+    setreq(buf, REQ_BINARY);
+
+    // take over the job's buffer
+    releasechunkbuf();
+    chunkbuf = job->data;
+    chunkbufsize = job->datasize;
+    job->data = NULL;
+    reservation.take(&job->reservation);
+
+    cryptous = job->cryptous;
+    diskus = job->diskus;
+
+    for (chunkmac_map::iterator it = job->macs.begin(); it != job->macs.end(); it++)
+    {
+        (*macs)[it->first] = it->second;
+    }
+}
+
+HttpReqULJob::HttpReqULJob(FileAccess* cfa, Mutex* cfamutex, SymmCipher* ckey,
+                           uint64_t cctriv, m_off_t cpos, m_off_t cnpos,
+                           ChunkBufferPool* pool)
+{
+    fa = cfa;
+    famutex = cfamutex;
+    key.setkey(ckey->key);
+    ctriv = cctriv;
+    pos = cpos;
+    npos = cnpos;
+    ok = false;
+    retry = false;
+    cryptous = 0;
+    diskus = 0;
+
+    bufferpool = pool;
+    data = bufferpool->get((unsigned)((npos - pos + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE), &datasize);
+}
+
+HttpReqULJob::~HttpReqULJob()
+{
+    bufferpool->release(data, datasize);
+}
+
+void HttpReqULJob::run()
+{
+    unsigned size = (unsigned)(npos - pos);
+    int64_t t = Waiter::us();
+
+    if (fa->readingested(data, size, pos))
+    {
+        ok = true;
+        diskus = Waiter::us() - t;
+    }
+    else if (fa->concurrentio())
+    {
+        // only opening and closing the file are serialised
+        famutex->lock();
+        ok = fa->openf();
+        retry = fa->retry;
+        famutex->unlock();
+
+        if (ok)
+        {
+            t = Waiter::us();
+            ok = fa->sysread(data, size, pos);
+            diskus = Waiter::us() - t;
+
+            famutex->lock();
+            fa->closef();
+            famutex->unlock();
+        }
+    }
+    else
+    {
+        famutex->lock();
+        t = Waiter::us();
+        ok = fa->frawread(data, size, pos);
+        diskus = Waiter::us() - t;
+        retry = fa->retry;
+        famutex->unlock();
+    }
+
+    if (ok)
+    {
+        memset(data + size, 0, ((size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE) - size);
+
+        t = Waiter::us();
+        HttpReqXfer::cryptchunks(&key, data, size, pos, ctriv, &macs, true);
+        cryptous = Waiter::us() - t;
+    }
+}
+
+void HttpReqUL::postchunk(MegaClient* client)
+{
+    post(client, (const char*)chunkbuf, size);
 }
 
 // number of bytes sent in this request
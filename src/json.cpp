@@ -24,14 +24,106 @@
 #include "mega/megaclient.h"
 #include "mega/logging.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_SCAN_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define JSON_SCAN_NEON 1
+#endif
+
+#if defined(_MSC_VER) && defined(JSON_SCAN_SSE2)
+#include <intrin.h>
+#endif
+
 namespace mega {
+#ifdef JSON_SCAN_SSE2
+static inline unsigned lowestbit(unsigned mask)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, mask);
+    return i;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+// first '"', '\\' or NUL at or after ptr - string contents are skipped 16
+// bytes at a time where SIMD is available. blocks are loaded aligned, so no
+// load extends into a page that the terminating NUL is not in
+static const char* stringspecial(const char* ptr)
+{
+#ifdef JSON_SCAN_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+
+    unsigned misalign = (unsigned)((size_t)ptr & 15);
+    const char* block = ptr - misalign;
+    __m128i v = _mm_load_si128((const __m128i*)block);
+    unsigned mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                                _mm_cmpeq_epi8(v, backslash)),
+                                                   _mm_cmpeq_epi8(v, zero)));
+
+    // ignore the bytes preceding ptr
+    mask &= 0xffffu << misalign;
+
+    while (!mask)
+    {
+        block += 16;
+        v = _mm_load_si128((const __m128i*)block);
+        mask = _mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                                           _mm_cmpeq_epi8(v, backslash)),
+                                              _mm_cmpeq_epi8(v, zero)));
+    }
+
+    return block + lowestbit(mask);
+#else
+#ifdef JSON_SCAN_NEON
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+    const uint8x16_t zero = vdupq_n_u8(0);
+
+    // scalar up to the first aligned block
+    while ((size_t)ptr & 15)
+    {
+        if (*ptr == '"' || *ptr == '\\' || !*ptr)
+        {
+            return ptr;
+        }
+
+        ptr++;
+    }
+
+    for (;;)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t*)ptr);
+
+        if (vmaxvq_u8(vorrq_u8(vorrq_u8(vceqq_u8(v, quote), vceqq_u8(v, backslash)), vceqq_u8(v, zero))))
+        {
+            break;
+        }
+
+        ptr += 16;
+    }
+#endif
+    while (*ptr != '"' && *ptr != '\\' && *ptr)
+    {
+        ptr++;
+    }
+
+    return ptr;
+#endif
+}
+
 // store array or object in string s
 // reposition after object
 bool JSON::storeobject(string* s)
 {
     int openobject[2] = { 0 };
     const char* ptr;
-    bool escaped = false;
 
     while (*pos > 0 && *pos <= ' ')
     {
@@ -68,9 +160,16 @@ bool JSON::storeobject(string* s)
         {
             ptr++;
 
-            while (*ptr && (escaped || *ptr != '"'))
+            // skip to the closing quote, stepping over escaped characters
+            for (;;)
             {
-                escaped = *ptr == '\\' && !escaped;
+                ptr = stringspecial(ptr);
+
+                if (*ptr != '\\' || !*++ptr)
+                {
+                    break;
+                }
+
                 ptr++;
             }
 
@@ -119,6 +218,46 @@ bool JSON::storeobject(string* s)
     }
 }
 
+const char* JSON::objectend(const char* ptr, const char* end)
+{
+    int depth = 0;
+    bool escaped = false;
+    bool instring = false;
+
+    for (; ptr < end && *ptr; ptr++)
+    {
+        if (instring)
+        {
+            if (escaped)
+            {
+                escaped = false;
+            }
+            else if (*ptr == '\\')
+            {
+                escaped = true;
+            }
+            else if (*ptr == '"')
+            {
+                instring = false;
+            }
+        }
+        else if (*ptr == '"')
+        {
+            instring = true;
+        }
+        else if (*ptr == '{' || *ptr == '[')
+        {
+            depth++;
+        }
+        else if ((*ptr == '}' || *ptr == ']') && !--depth)
+        {
+            return ptr + 1;
+        }
+    }
+
+    return NULL;
+}
+
 bool JSON::isnumeric()
 {
     if (*pos == ',')
@@ -455,17 +594,27 @@ bool JSON::leaveobject()
     return false;
 }
 
-// unescape JSON string (non-strict)
+// unescape JSON string (non-strict) - in place, in a single pass
 void JSON::unescape(string* s)
 {
+    size_t i = s->find('\\');
+
+    if (i == string::npos)
+    {
+        return;
+    }
+
+    char* p = (char*)s->data();
+    size_t len = s->size();
+    size_t w = i;
     char c;
-    int l;
+    size_t l;
 
-    for (unsigned i = 0; i + 1 < s->size(); i++)
+    while (i < len)
     {
-        if ((*s)[i] == '\\')
+        if (p[i] == '\\' && i + 1 < len)
         {
-            switch ((*s)[i + 1])
+            switch (p[i + 1])
             {
                 case 'n':
                     c = '\n';
@@ -498,18 +647,26 @@ void JSON::unescape(string* s)
                     break;
 
                 case 'u':
-                    c = (MegaClient::hexval((*s)[i + 4]) << 4) | MegaClient::hexval((*s)[i + 5]);
+                    c = (MegaClient::hexval(i + 4 < len ? p[i + 4] : 0) << 4)
+                       | MegaClient::hexval(i + 5 < len ? p[i + 5] : 0);
                     l = 6;
                     break;
 
                 default:
-                    c = (*s)[i + 1];
+                    c = p[i + 1];
                     l = 2;
             }
 
-            s->replace(i, l, &c, 1);
+            p[w++] = c;
+            i += l;
+        }
+        else
+        {
+            p[w++] = p[i++];
         }
     }
+
+    s->resize(w);
 }
 
 bool JSON::extractstringvalue(const string &json, const string &name, string *value)
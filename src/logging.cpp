@@ -30,56 +30,78 @@ Logger *SimpleLogger::logger = NULL;
 // by the default, display logs with level equal or less than logInfo
 enum LogLevel SimpleLogger::logCurrentLevel = logInfo;
 
+// the time and the source of the external logger are only formatted when
+// the message is delivered (by the logger itself if it is deferring)
 SimpleLogger::SimpleLogger(enum LogLevel ll, char const* filename, int line, bool lBreak)
 {
-    struct OutputSettings settings = outputSettings[ll];
+    const struct OutputSettings& settings = outputSettings[ll];
     level = ll;
     lineBreak = lBreak;
+    this->filename = filename;
+    this->line = line;
 
     if (settings.enableTime)
-        ostr << "[" << getTime() << "] ";
+        ostr << "[" << getTime(time(NULL)) << "] ";
     if (settings.enableLevel)
         ostr << "[" << toStr(ll) << "] ";
     if (settings.enableSource)
         ostr << filename << ":" << line << " ";
-
-    if (logger) {
-        t = getTime();
-        std::ostringstream oss;
-        oss << filename;
-        if(line >= 0)
-        {
-            oss << ":" << line;
-        }
-        fname = oss.str();
-    }
 }
 
 SimpleLogger::~SimpleLogger()
 {
-    OutputStreams::iterator iter;
-    OutputStreams vec;
-
     if (logger)
-        logger->log(t.c_str(), level, fname.c_str(), ostr.str().c_str());
+    {
+        string msg = ostr.str();
+
+        if (logger->deferring())
+        {
+            logger->logdeferred(time(NULL), level, filename, line, &msg);
+        }
+        else
+        {
+            string source = filename;
 
-    if (lineBreak)
-        ostr << std::endl;
+            if (line >= 0)
+            {
+                char buf[16];
 
-    vec = getOutput(level);
+                sprintf(buf, ":%d", line);
+                source.append(buf);
+            }
 
-    for (iter = vec.begin(); iter != vec.end(); iter++)
+            logger->log(getTime(time(NULL)).c_str(), level, source.c_str(), msg.c_str());
+        }
+    }
+
+    OutputStreams& vec = outputs[level];
+
+    if (vec.size())
     {
-        **iter << ostr.str();
+        if (lineBreak)
+            ostr << std::endl;
+
+        string s = ostr.str();
+
+        for (OutputStreams::iterator iter = vec.begin(); iter != vec.end(); iter++)
+        {
+            **iter << s;
+        }
     }
 }
 
-std::string SimpleLogger::getTime()
+std::string SimpleLogger::getTime(time_t t)
 {
     char ts[50];
-    time_t t = time(NULL);
+    struct tm tm;
 
-    if (!strftime(ts, sizeof(ts), "%H:%M:%S", gmtime(&t))) {
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+
+    if (!strftime(ts, sizeof(ts), "%H:%M:%S", &tm)) {
         ts[0] = '\0';
     }
     return ts;
@@ -90,9 +112,7 @@ void SimpleLogger::flush()
     for (int i = logFatal; i < logMax; i++)
     {
         OutputStreams::iterator iter;
-        OutputStreams vec;
-
-        vec = outputs[static_cast<LogLevel>(i)];;
+        OutputStreams& vec = outputs[static_cast<LogLevel>(i)];
 
         for (iter = vec.begin(); iter != vec.end(); iter++)
         {
@@ -90,6 +90,90 @@ const char *MegaProxy::getPassword()
     return password;
 }
 
+MegaSearchFilter::MegaSearchFilter()
+{
+    nodeType = -1;
+    minSize = -1;
+    maxSize = -1;
+    minTime = -1;
+    maxTime = -1;
+    extension = NULL;
+}
+
+MegaSearchFilter::~MegaSearchFilter()
+{
+    delete [] extension;
+}
+
+MegaSearchFilter *MegaSearchFilter::copy()
+{
+    MegaSearchFilter *filter = new MegaSearchFilter();
+    filter->setNodeType(nodeType);
+    filter->setSizeRange(minSize, maxSize);
+    filter->setModificationTimeRange(minTime, maxTime);
+    filter->setExtension(extension);
+    return filter;
+}
+
+void MegaSearchFilter::setNodeType(int type)
+{
+    this->nodeType = type;
+}
+
+void MegaSearchFilter::setSizeRange(int64_t minSize, int64_t maxSize)
+{
+    this->minSize = minSize;
+    this->maxSize = maxSize;
+}
+
+void MegaSearchFilter::setModificationTimeRange(int64_t minTime, int64_t maxTime)
+{
+    this->minTime = minTime;
+    this->maxTime = maxTime;
+}
+
+void MegaSearchFilter::setExtension(const char *extension)
+{
+    delete [] this->extension;
+
+    if(extension && extension[0] == '.')
+    {
+        extension++;
+    }
+
+    this->extension = (extension && extension[0]) ? MegaApi::strdup(extension) : NULL;
+}
+
+int MegaSearchFilter::getNodeType()
+{
+    return nodeType;
+}
+
+int64_t MegaSearchFilter::getMinSize()
+{
+    return minSize;
+}
+
+int64_t MegaSearchFilter::getMaxSize()
+{
+    return maxSize;
+}
+
+int64_t MegaSearchFilter::getMinModificationTime()
+{
+    return minTime;
+}
+
+int64_t MegaSearchFilter::getMaxModificationTime()
+{
+    return maxTime;
+}
+
+const char *MegaSearchFilter::getExtension()
+{
+    return extension;
+}
+
 MegaNodeList::~MegaNodeList() { }
 
 MegaNodeList *MegaNodeList::copy()
@@ -107,6 +191,65 @@ int MegaNodeList::size()
     return 0;
 }
 
+MegaChildrenCursor::~MegaChildrenCursor() { }
+
+MegaChildrenCursor *MegaChildrenCursor::copy()
+{
+    return NULL;
+}
+
+MegaHandle MegaChildrenCursor::getParentHandle()
+{
+    return INVALID_HANDLE;
+}
+
+int MegaChildrenCursor::getOrder()
+{
+    return 0;
+}
+
+int MegaChildrenCursor::getPosition()
+{
+    return 0;
+}
+
+bool MegaChildrenCursor::hasMore()
+{
+    return false;
+}
+
+MegaNodeDeltaList::~MegaNodeDeltaList() { }
+
+MegaNodeDeltaList *MegaNodeDeltaList::copy()
+{
+    return NULL;
+}
+
+MegaHandle MegaNodeDeltaList::getHandle(int)
+{
+    return INVALID_HANDLE;
+}
+
+int MegaNodeDeltaList::getChanges(int)
+{
+    return 0;
+}
+
+int MegaNodeDeltaList::size()
+{
+    return 0;
+}
+
+bool MegaNodeDeltaList::isReloadNeeded()
+{
+    return false;
+}
+
+long long MegaNodeDeltaList::getSequence()
+{
+    return 0;
+}
+
 MegaTransferList::~MegaTransferList() { }
 
 MegaTransfer *MegaTransferList::get(int i)
@@ -119,6 +262,92 @@ int MegaTransferList::size()
     return 0;
 }
 
+MegaTransferStats::~MegaTransferStats() { }
+
+MegaTransferStats *MegaTransferStats::copy()
+{
+    return NULL;
+}
+
+int MegaTransferStats::getNumPending(int)
+{
+    return 0;
+}
+
+int MegaTransferStats::getNumActive(int)
+{
+    return 0;
+}
+
+int MegaTransferStats::getNumCompleted(int)
+{
+    return 0;
+}
+
+int MegaTransferStats::getNumFailed(int)
+{
+    return 0;
+}
+
+long long MegaTransferStats::getPendingBytes(int)
+{
+    return 0;
+}
+
+long long MegaTransferStats::getTransferredBytes(int)
+{
+    return 0;
+}
+
+long long MegaTransferStats::getCompletedBytes(int)
+{
+    return 0;
+}
+
+long long MegaTransferStats::getSpeed(int)
+{
+    return 0;
+}
+
+long long MegaTransferStats::getEta(int)
+{
+    return -1;
+}
+
+MegaMemoryUsage::~MegaMemoryUsage() { }
+
+MegaMemoryUsage *MegaMemoryUsage::copy()
+{
+    return NULL;
+}
+
+long long MegaMemoryUsage::getBytes(int)
+{
+    return 0;
+}
+
+long long MegaMemoryUsage::getTotalBytes()
+{
+    return 0;
+}
+
+MegaTransferBatch::~MegaTransferBatch() { }
+
+void MegaTransferBatch::addUpload(const char *, MegaNode *, const char *, int64_t)
+{
+
+}
+
+void MegaTransferBatch::addDownload(MegaNode *, const char *)
+{
+
+}
+
+int MegaTransferBatch::size()
+{
+    return 0;
+}
+
 MegaContactRequestList::~MegaContactRequestList() { }
 
 MegaContactRequestList *MegaContactRequestList::copy()
@@ -484,6 +713,21 @@ MegaPricing *MegaRequest::getPricing() const
 	return NULL;
 }
 
+MegaNodeList *MegaRequest::getMegaNodeList() const
+{
+    return NULL;
+}
+
+int MegaRequest::getNodeErrorCode(int index) const
+{
+    return 0;
+}
+
+const char *MegaRequest::getNodeLink(int index) const
+{
+    return NULL;
+}
+
 int MegaRequest::getTransferTag() const
 {
 	return 0;
@@ -632,6 +876,181 @@ char *MegaTransfer::getLastBytes() const
 	return NULL;
 }
 
+MegaTransferTimings *MegaTransfer::getTimings() const
+{
+    return NULL;
+}
+
+int MegaTransfer::getFolderTransferTag() const
+{
+    return 0;
+}
+
+MegaTransferTimings::~MegaTransferTimings()
+{
+
+}
+
+MegaTransferTimings *MegaTransferTimings::copy() const
+{
+    return NULL;
+}
+
+long long MegaTransferTimings::getNumChunks() const
+{
+    return 0;
+}
+
+long long MegaTransferTimings::getBytes() const
+{
+    return 0;
+}
+
+long long MegaTransferTimings::getPhaseCount(int phase, int bucket) const
+{
+    return 0;
+}
+
+long long MegaTransferTimings::getPhaseSamples(int phase) const
+{
+    return 0;
+}
+
+long long MegaTransferTimings::getPhaseTotalTime(int phase) const
+{
+    return 0;
+}
+
+long long MegaTransferTimings::getPhaseMaxTime(int phase) const
+{
+    return 0;
+}
+
+long long MegaTransferTimings::getThroughputCount(int bucket) const
+{
+    return 0;
+}
+
+MegaEngineMetrics::~MegaEngineMetrics()
+{
+
+}
+
+MegaEngineMetrics *MegaEngineMetrics::copy() const
+{
+    return NULL;
+}
+
+long long MegaEngineMetrics::getCounter(int) const
+{
+    return 0;
+}
+
+long long MegaEngineMetrics::getDurationCount(int) const
+{
+    return 0;
+}
+
+long long MegaEngineMetrics::getDurationTotal(int) const
+{
+    return 0;
+}
+
+long long MegaEngineMetrics::getDurationMax(int) const
+{
+    return 0;
+}
+
+int MegaEngineMetrics::getNumHosts() const
+{
+    return 0;
+}
+
+const char *MegaEngineMetrics::getHostName(int) const
+{
+    return NULL;
+}
+
+long long MegaEngineMetrics::getHostRequests(int) const
+{
+    return 0;
+}
+
+long long MegaEngineMetrics::getHostFailures(int) const
+{
+    return 0;
+}
+
+long long MegaEngineMetrics::getHostBytesSent(int) const
+{
+    return 0;
+}
+
+long long MegaEngineMetrics::getHostBytesReceived(int) const
+{
+    return 0;
+}
+
+MegaStartupTimeline::~MegaStartupTimeline()
+{
+
+}
+
+MegaStartupTimeline *MegaStartupTimeline::copy() const
+{
+    return NULL;
+}
+
+bool MegaStartupTimeline::isComplete() const
+{
+    return false;
+}
+
+long long MegaStartupTimeline::getPhaseStart(int) const
+{
+    return -1;
+}
+
+long long MegaStartupTimeline::getPhaseEnd(int) const
+{
+    return -1;
+}
+
+long long MegaStartupTimeline::getPhaseBytes(int) const
+{
+    return 0;
+}
+
+long long MegaStartupTimeline::getPhaseItems(int) const
+{
+    return 0;
+}
+
+MegaTransferBuffer::~MegaTransferBuffer()
+{
+
+}
+
+const char *MegaTransferBuffer::getData() const
+{
+    return NULL;
+}
+
+size_t MegaTransferBuffer::getSize() const
+{
+    return 0;
+}
+
+long long MegaTransferBuffer::getOffset() const
+{
+    return 0;
+}
+
+void MegaTransferBuffer::release()
+{
+    delete this;
+}
+
 
 MegaError::MegaError(int errorCode)
 {
@@ -820,6 +1239,12 @@ void MegaTransferListener::onTransferUpdate(MegaApi *, MegaTransfer *)
 { }
 bool MegaTransferListener::onTransferData(MegaApi *, MegaTransfer *, char *, size_t)
 { return true; }
+bool MegaTransferListener::onTransferBuffer(MegaApi *api, MegaTransfer *transfer, MegaTransferBuffer *buffer)
+{
+    bool result = onTransferData(api, transfer, (char *)buffer->getData(), buffer->getSize());
+    buffer->release();
+    return result;
+}
 void MegaTransferListener::onTransferTemporaryError(MegaApi *, MegaTransfer *, MegaError*)
 { }
 MegaTransferListener::~MegaTransferListener()
@@ -830,8 +1255,12 @@ void MegaGlobalListener::onUsersUpdate(MegaApi *, MegaUserList *)
 { }
 void MegaGlobalListener::onNodesUpdate(MegaApi *, MegaNodeList *)
 { }
+void MegaGlobalListener::onNodeDeltasAvailable(MegaApi *)
+{ }
 void MegaGlobalListener::onAccountUpdate(MegaApi *)
 { }
+void MegaGlobalListener::onEngineMetrics(MegaApi *, MegaEngineMetrics *)
+{ }
 void MegaGlobalListener::onContactRequestsUpdate(MegaApi *, MegaContactRequestList *)
 { }
 void MegaGlobalListener::onReloadNeeded(MegaApi *)
@@ -860,8 +1289,12 @@ void MegaListener::onUsersUpdate(MegaApi *, MegaUserList *)
 { }
 void MegaListener::onNodesUpdate(MegaApi *, MegaNodeList *)
 { }
+void MegaListener::onNodeDeltasAvailable(MegaApi *)
+{ }
 void MegaListener::onAccountUpdate(MegaApi *)
 { }
+void MegaListener::onEngineMetrics(MegaApi *, MegaEngineMetrics *)
+{ }
 void MegaListener::onContactRequestsUpdate(MegaApi *, MegaContactRequestList *)
 { }
 void MegaListener::onReloadNeeded(MegaApi *)
@@ -876,6 +1309,8 @@ void MegaListener::onSyncEvent(MegaApi *api, MegaSync *sync, MegaSyncEvent *even
 { }
 void MegaListener::onSyncStateChanged(MegaApi *api, MegaSync *sync)
 { }
+void MegaListener::onSyncStatsUpdated(MegaApi *api, MegaSync *sync)
+{ }
 void MegaListener::onGlobalSyncStateChanged(MegaApi *api)
 { }
 #endif
@@ -884,6 +1319,8 @@ MegaListener::~MegaListener() {}
 
 bool MegaTreeProcessor::processMegaNode(MegaNode*)
 { return false; /* Stops the processing */ }
+bool MegaTreeProcessor::isThreadSafe()
+{ return false; }
 MegaTreeProcessor::~MegaTreeProcessor()
 { }
 
@@ -924,6 +1361,16 @@ char *MegaApi::getMyUserHandle()
     return pImpl->getMyUserHandle();
 }
 
+void MegaApi::setSharedRuntime(bool enable)
+{
+    MegaApiImpl::setSharedRuntime(enable);
+}
+
+void MegaApi::enableNameInterning(bool enable)
+{
+    MegaApiImpl::enableNameInterning(enable);
+}
+
 void MegaApi::setLogLevel(int logLevel)
 {
     MegaApiImpl::setLogLevel(logLevel);
@@ -934,6 +1381,11 @@ void MegaApi::setLoggerObject(MegaLogger *megaLogger)
     MegaApiImpl::setLoggerClass(megaLogger);
 }
 
+void MegaApi::setAsyncLogging(bool enable)
+{
+    MegaApiImpl::setAsyncLogging(enable);
+}
+
 void MegaApi::log(int logLevel, const char *message, const char *filename, int line)
 {
     MegaApiImpl::log(logLevel, message, filename, line);
@@ -944,6 +1396,11 @@ char *MegaApi::getBase64PwKey(const char *password)
     return pImpl->getBase64PwKey(password);
 }
 
+void MegaApi::getBase64PwKey(const char *password, MegaRequestListener *listener)
+{
+    pImpl->getBase64PwKey(password, listener);
+}
+
 char *MegaApi::getStringHash(const char* base64pwkey, const char* inBuf)
 {
     return pImpl->getStringHash(base64pwkey, inBuf);
@@ -1014,54 +1471,101 @@ void MegaApi::getUserData(const char *user, MegaRequestListener *listener)
     pImpl->getUserData(user, listener);
 }
 
-void MegaApi::login(const char *login, const char *password, MegaRequestListener *listener)
+void MegaApi::login(const char *login, const char *password, MegaRequestListener *listener)
+{
+    pImpl->login(login, password, listener);
+}
+
+char *MegaApi::dumpSession()
+{
+    return pImpl->dumpSession();
+}
+
+char *MegaApi::dumpXMPPSession()
+{
+    return pImpl->dumpXMPPSession();
+}
+
+void MegaApi::createAccount(const char* email, const char* password, const char* name, MegaRequestListener *listener)
+{
+    pImpl->createAccount(email, password, name, listener);
+}
+
+void MegaApi::fastCreateAccount(const char* email, const char *base64pwkey, const char* name, MegaRequestListener *listener)
+{
+    pImpl->fastCreateAccount(email, base64pwkey, name, listener);
+}
+
+void MegaApi::querySignupLink(const char* link, MegaRequestListener *listener)
+{
+    pImpl->querySignupLink(link, listener);
+}
+
+void MegaApi::confirmAccount(const char* link, const char *password, MegaRequestListener *listener)
+{
+    pImpl->confirmAccount(link, password, listener);
+}
+
+void MegaApi::fastConfirmAccount(const char* link, const char *base64pwkey, MegaRequestListener *listener)
+{
+    pImpl->fastConfirmAccount(link, base64pwkey, listener);
+}
+
+void MegaApi::setProxySettings(MegaProxy *proxySettings)
+{
+    pImpl->setProxySettings(proxySettings);
+}
+
+MegaProxy *MegaApi::getAutoProxySettings()
 {
-    pImpl->login(login, password, listener);
+    return pImpl->getAutoProxySettings();
 }
 
-char *MegaApi::dumpSession()
+bool MegaApi::setHttpMultiplexing(bool enable)
 {
-    return pImpl->dumpSession();
+    return pImpl->setHttpMultiplexing(enable);
 }
 
-char *MegaApi::dumpXMPPSession()
+void MegaApi::setNetworkThread(bool enable)
 {
-    return pImpl->dumpXMPPSession();
+    pImpl->setNetworkThread(enable);
 }
 
-void MegaApi::createAccount(const char* email, const char* password, const char* name, MegaRequestListener *listener)
+void MegaApi::enableTlsSessionCache(bool enable)
 {
-    pImpl->createAccount(email, password, name, listener);
+    pImpl->enableTlsSessionCache(enable);
 }
 
-void MegaApi::fastCreateAccount(const char* email, const char *base64pwkey, const char* name, MegaRequestListener *listener)
+void MegaApi::enablePersistentTransferQueue(bool enable)
 {
-    pImpl->fastCreateAccount(email, base64pwkey, name, listener);
+    pImpl->enablePersistentTransferQueue(enable);
 }
 
-void MegaApi::querySignupLink(const char* link, MegaRequestListener *listener)
+void MegaApi::enableLazyNodeAttributes(bool enable)
 {
-    pImpl->querySignupLink(link, listener);
+    pImpl->enableLazyNodeAttributes(enable);
 }
 
-void MegaApi::confirmAccount(const char* link, const char *password, MegaRequestListener *listener)
+#ifdef ENABLE_SYNC
+void MegaApi::setSyncScanParallelism(unsigned int folders)
 {
-    pImpl->confirmAccount(link, password, listener);
+    pImpl->setSyncScanParallelism(folders);
 }
 
-void MegaApi::fastConfirmAccount(const char* link, const char *base64pwkey, MegaRequestListener *listener)
+void MegaApi::setSyncVerificationInterval(unsigned int seconds)
 {
-    pImpl->fastConfirmAccount(link, base64pwkey, listener);
+    pImpl->setSyncVerificationInterval(seconds);
 }
 
-void MegaApi::setProxySettings(MegaProxy *proxySettings)
+void MegaApi::setSyncSkipUnchangedFolders(bool enable)
 {
-    pImpl->setProxySettings(proxySettings);
+    pImpl->setSyncSkipUnchangedFolders(enable);
 }
+#endif
 
-MegaProxy *MegaApi::getAutoProxySettings()
+void MegaApi::setApiRequestCompression(unsigned int threshold)
 {
-    return pImpl->getAutoProxySettings();
+    pImpl->setApiRequestCompression(threshold);
 }
 
 void MegaApi::createFolder(const char *name, MegaNode *parent, MegaRequestListener *listener)
@@ -1119,6 +1623,11 @@ void MegaApi::loginToFolder(const char* megaFolderLink, MegaRequestListener *lis
     pImpl->loginToFolder(megaFolderLink, listener);
 }
 
+void MegaApi::setPartialFolderFetch(bool enable)
+{
+    pImpl->setPartialFolderFetch(enable);
+}
+
 void MegaApi::importFileLink(const char* megaFileLink, MegaNode *parent, MegaRequestListener *listener)
 {
     pImpl->importFileLink(megaFileLink, parent, listener);
@@ -1134,6 +1643,11 @@ void MegaApi::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestL
     pImpl->getThumbnail(node, dstFilePath, listener);
 }
 
+void MegaApi::prefetchThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
+{
+    pImpl->prefetchThumbnail(node, dstFilePath, listener);
+}
+
 void MegaApi::cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener)
 {
 	pImpl->cancelGetThumbnail(node, listener);
@@ -1149,6 +1663,11 @@ void MegaApi::getPreview(MegaNode* node, const char *dstFilePath, MegaRequestLis
     pImpl->getPreview(node, dstFilePath, listener);
 }
 
+void MegaApi::prefetchPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
+{
+    pImpl->prefetchPreview(node, dstFilePath, listener);
+}
+
 void MegaApi::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
 {
 	pImpl->cancelGetPreview(node, listener);
@@ -1199,11 +1718,26 @@ void MegaApi::disableExport(MegaNode *node, MegaRequestListener *listener)
     pImpl->disableExport(node, listener);
 }
 
+void MegaApi::exportNodes(MegaNodeList *nodes, MegaRequestListener *listener)
+{
+    pImpl->exportNodes(nodes, listener);
+}
+
+void MegaApi::setNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    pImpl->setNodesAttribute(nodes, attrName, value, listener);
+}
+
 void MegaApi::fetchNodes(MegaRequestListener *listener)
 {
     pImpl->fetchNodes(listener);
 }
 
+void MegaApi::fetchFolder(MegaNode *node, bool recursive, MegaRequestListener *listener)
+{
+    pImpl->fetchFolder(node, recursive, listener);
+}
+
 void MegaApi::getAccountDetails(MegaRequestListener *listener)
 {
     pImpl->getAccountDetails(true, true, true, false, false, false, listener);
@@ -1360,6 +1894,186 @@ int MegaApi::getUploadMethod()
     return pImpl->getUploadMethod();
 }
 
+void MegaApi::setConnectionLimits(int direction, int minConnections, int maxConnections)
+{
+    pImpl->setConnectionLimits(direction, minConnections, maxConnections);
+}
+
+void MegaApi::setMaxRequestSize(int direction, long long maxSize)
+{
+    pImpl->setMaxRequestSize(direction, maxSize);
+}
+
+void MegaApi::setTransferBufferPoolLimit(long long limit)
+{
+    pImpl->setTransferBufferPoolLimit(limit);
+}
+
+void MegaApi::setInflightMemoryBudget(long long bytes)
+{
+    pImpl->setInflightMemoryBudget(bytes);
+}
+
+void MegaApi::setNetworkInterfaces(const char *interfaces)
+{
+    pImpl->setNetworkInterfaces(interfaces);
+}
+
+void MegaApi::setThumbnailCacheLimit(long long limit)
+{
+    pImpl->setThumbnailCacheLimit(limit);
+}
+
+void MegaApi::setThumbnailMemoryCacheLimit(long long limit)
+{
+    pImpl->setThumbnailMemoryCacheLimit(limit);
+}
+
+void MegaApi::setThumbnailPrefetch(int budget)
+{
+    pImpl->setThumbnailPrefetch(budget);
+}
+
+void MegaApi::setImageDecodeLimit(long long limit)
+{
+    pImpl->setImageDecodeLimit(limit);
+}
+
+void MegaApi::setDownloadWriteMode(bool preallocate, bool directIO)
+{
+    pImpl->setDownloadWriteMode(preallocate, directIO);
+}
+
+void MegaApi::enableUploadCopies(bool enable)
+{
+    pImpl->enableUploadCopies(enable);
+}
+
+void MegaApi::setBandwidthLimit(int direction, long long bytesPerSecond, long long burstBytes)
+{
+    pImpl->setBandwidthLimit(direction, bytesPerSecond, burstBytes);
+}
+
+void MegaApi::setTransferBandwidthLimit(int direction, long long bytesPerSecond)
+{
+    pImpl->setTransferBandwidthLimit(direction, bytesPerSecond);
+}
+
+void MegaApi::addBandwidthSchedule(int direction, int weekdays, int startMinute, int endMinute, long long bytesPerSecond)
+{
+    pImpl->addBandwidthSchedule(direction, weekdays, startMinute, endMinute, bytesPerSecond);
+}
+
+void MegaApi::clearBandwidthSchedule(int direction)
+{
+    pImpl->clearBandwidthSchedule(direction);
+}
+
+void MegaApi::setStreamingBandwidth(long long bytesPerSecond)
+{
+    pImpl->setStreamingBandwidth(bytesPerSecond);
+}
+
+void MegaApi::setStreamingCache(long long cacheSize, long long readAhead)
+{
+    pImpl->setStreamingCache(cacheSize, readAhead);
+}
+
+bool MegaApi::pauseStreaming(MegaTransfer *transfer, bool pause)
+{
+    return pImpl->pauseStreaming(transfer, pause);
+}
+
+bool MegaApi::httpServerStart(bool localOnly, int port)
+{
+    return pImpl->httpServerStart(localOnly, port);
+}
+
+void MegaApi::httpServerStop()
+{
+    pImpl->httpServerStop();
+}
+
+int MegaApi::httpServerIsRunning()
+{
+    return pImpl->httpServerIsRunning();
+}
+
+char *MegaApi::httpServerGetLocalLink(MegaNode *node)
+{
+    return pImpl->httpServerGetLocalLink(node);
+}
+
+bool MegaApi::peerCacheStart(int port)
+{
+    return pImpl->peerCacheStart(port);
+}
+
+void MegaApi::peerCacheStop()
+{
+    pImpl->peerCacheStop();
+}
+
+int MegaApi::peerCacheIsRunning()
+{
+    return pImpl->peerCacheIsRunning();
+}
+
+void MegaApi::setTransferPolicy(int policy)
+{
+    pImpl->setTransferPolicy(policy);
+}
+
+bool MegaApi::setTransferPriority(int transferTag, int priority)
+{
+    return pImpl->setTransferPriority(transferTag, priority);
+}
+
+void MegaApi::setLargeTransferSlots(int direction, int slots, long long minSize)
+{
+    pImpl->setLargeTransferSlots(direction, slots, minSize);
+}
+
+int MegaApi::getTransferQueueDepth(int direction)
+{
+    return pImpl->getTransferQueueDepth(direction);
+}
+
+int MegaApi::getTransferSlotUtilization()
+{
+    return pImpl->getTransferSlotUtilization();
+}
+
+MegaTransferTimings *MegaApi::getTransferTimings(int direction)
+{
+    return pImpl->getTransferTimings(direction);
+}
+
+void MegaApi::resetTransferTimings(int direction)
+{
+    pImpl->resetTransferTimings(direction);
+}
+
+MegaEngineMetrics *MegaApi::getEngineMetrics()
+{
+    return pImpl->getEngineMetrics();
+}
+
+void MegaApi::resetEngineMetrics()
+{
+    pImpl->resetEngineMetrics();
+}
+
+void MegaApi::setEngineMetricsInterval(int seconds)
+{
+    pImpl->setEngineMetricsInterval(seconds);
+}
+
+MegaStartupTimeline *MegaApi::getStartupTimeline()
+{
+    return pImpl->getStartupTimeline();
+}
+
 MegaTransferList *MegaApi::getTransfers()
 {
     return pImpl->getTransfers();
@@ -1375,6 +2089,21 @@ MegaTransferList *MegaApi::getTransfers(int type)
     return pImpl->getTransfers(type);
 }
 
+MegaTransferList *MegaApi::getTransfers(int type, int fromTag, int limit)
+{
+    return pImpl->getTransfers(type, fromTag, limit);
+}
+
+MegaTransferStats *MegaApi::getTransferStats()
+{
+    return pImpl->getTransferStats();
+}
+
+MegaMemoryUsage *MegaApi::getMemoryUsage()
+{
+    return pImpl->getMemoryUsage();
+}
+
 void MegaApi::startUpload(const char* localPath, MegaNode* parent, MegaTransferListener *listener)
 {
     pImpl->startUpload(localPath, parent, listener);
@@ -1395,6 +2124,11 @@ void MegaApi::startUpload(const char *localPath, MegaNode *parent, const char *f
     pImpl->startUpload(localPath, parent, fileName, mtime, listener);
 }
 
+void MegaApi::startStreamUpload(MegaInputStream *inputStream, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener)
+{
+    pImpl->startStreamUpload(inputStream, parent, fileName, mtime, listener);
+}
+
 void MegaApi::startDownload(MegaNode *node, const char* localFolder, MegaTransferListener *listener)
 {
     pImpl->startDownload(node, localFolder, listener);
@@ -1415,6 +2149,11 @@ void MegaApi::cancelTransfers(int direction, MegaRequestListener *listener)
     pImpl->cancelTransfers(direction, listener);
 }
 
+void MegaApi::startTransfers(MegaTransferBatch *batch, MegaTransferListener *listener)
+{
+    pImpl->startTransfers(batch, listener);
+}
+
 void MegaApi::startStreaming(MegaNode* node, int64_t startPos, int64_t size, MegaTransferListener *listener)
 {
     pImpl->startStreaming(node, startPos, size, listener);
@@ -1478,6 +2217,11 @@ int MegaApi::getNumActiveSyncs()
     return pImpl->getNumActiveSyncs();
 }
 
+long long MegaApi::getSyncMemoryUsage()
+{
+    return pImpl->getSyncMemoryUsage();
+}
+
 string MegaApi::getLocalPath(MegaNode *n)
 {
     return pImpl->getLocalPath(n);
@@ -1640,6 +2384,21 @@ bool MegaApi::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool re
     return pImpl->processMegaTree(n, processor, recursive);
 }
 
+void MegaApi::searchAsync(MegaNode *node, const char *searchString, MegaSearchFilter *filter, int limit, MegaRequestListener *listener)
+{
+    pImpl->searchAsync(node, searchString, filter, limit, listener);
+}
+
+void MegaApi::cancelSearch(int searchTag)
+{
+    pImpl->cancelSearch(searchTag);
+}
+
+bool MegaApi::processMegaTreeSnapshot(MegaNode* n, MegaTreeProcessor* processor, bool recursive, int numThreads)
+{
+    return pImpl->processMegaTreeSnapshot(n, processor, recursive, numThreads);
+}
+
 MegaNode *MegaApi::createPublicFileNode(MegaHandle handle, const char *key,
                                     const char *name, int64_t size, int64_t mtime,
                                         MegaHandle parentHandle, const char *auth)
@@ -1815,6 +2574,11 @@ void MegaApi::removeGlobalListener(MegaGlobalListener* listener)
     pImpl->removeGlobalListener(listener);
 }
 
+void MegaApi::setCallbackThreads(int numThreads)
+{
+    pImpl->setCallbackThreads(numThreads);
+}
+
 MegaRequest *MegaApi::getCurrentRequest()
 {
     return pImpl->getCurrentRequest();
@@ -1875,6 +2639,41 @@ int MegaApi::getIndex(MegaNode *node, int order)
     return pImpl->getIndex(node, order);
 }
 
+MegaNodeList *MegaApi::getChildren(MegaNode *parent, int order, int offset, int limit)
+{
+    return pImpl->getChildren(parent, order, offset, limit);
+}
+
+MegaChildrenCursor *MegaApi::getChildrenCursor(MegaNode *parent, int order)
+{
+    return pImpl->getChildrenCursor(parent, order);
+}
+
+MegaNodeList *MegaApi::getNextChildren(MegaChildrenCursor *cursor, int limit)
+{
+    return pImpl->getNextChildren(cursor, limit);
+}
+
+void MegaApi::enableNodeDeltas(bool enable, int coalesceMs, int maxPending)
+{
+    pImpl->enableNodeDeltas(enable, coalesceMs, maxPending);
+}
+
+MegaNodeDeltaList *MegaApi::getNodeDeltas(int max)
+{
+    return pImpl->getNodeDeltas(max);
+}
+
+long long MegaApi::getNodeChangeSequence()
+{
+    return pImpl->getNodeChangeSequence();
+}
+
+MegaNodeDeltaList *MegaApi::getNodeChanges(long long sequence, int max)
+{
+    return pImpl->getNodeChanges(sequence, max);
+}
+
 MegaNode *MegaApi::getChildNode(MegaNode *parent, const char* name)
 {
     return pImpl->getChildNode(parent, name);
@@ -1890,6 +2689,11 @@ char *MegaApi::getNodePath(MegaNode *node)
     return pImpl->getNodePath(node);
 }
 
+void MegaApi::getNodeHandlesByPath(const char **paths, int numPaths, MegaHandle *handles, MegaNode *n)
+{
+    pImpl->getNodeHandlesByPath(paths, numPaths, handles, n);
+}
+
 MegaNode* MegaApi::getNodeByPath(const char *path, MegaNode* node)
 {
     return pImpl->getNodeByPath(path, node);
@@ -1935,6 +2739,16 @@ void MegaApi::removeRecursively(const char *path)
     MegaApiImpl::removeRecursively(path);
 }
 
+void MegaApi::removeRecursivelyAsync(const char *path, MegaRequestListener *listener)
+{
+    pImpl->removeRecursivelyAsync(path, listener);
+}
+
+void MegaApi::cancelRemoveRecursively(const char *path)
+{
+    pImpl->cancelRemoveRecursively(path);
+}
+
 bool MegaApi::isOnline()
 {
     return pImpl->isOnline();
@@ -2283,6 +3097,61 @@ int MegaSync::getState() const
     return MegaSync::SYNC_FAILED;
 }
 
+int MegaSync::getNotificationQueueDepth() const
+{
+    return 0;
+}
+
+int MegaSync::getRetryQueueDepth() const
+{
+    return 0;
+}
+
+long long MegaSync::getNumFingerprinted() const
+{
+    return 0;
+}
+
+long long MegaSync::getFingerprintRate() const
+{
+    return 0;
+}
+
+long long MegaSync::getPendingUploadBytes() const
+{
+    return 0;
+}
+
+long long MegaSync::getPendingDownloadBytes() const
+{
+    return 0;
+}
+
+long long MegaSync::getSyncDownTime() const
+{
+    return 0;
+}
+
+long long MegaSync::getSyncUpTime() const
+{
+    return 0;
+}
+
+long long MegaSync::getCacheFlushTime() const
+{
+    return 0;
+}
+
+long long MegaSync::getNumNotifications() const
+{
+    return 0;
+}
+
+long long MegaSync::getNumSupersededNotifications() const
+{
+    return 0;
+}
+
 
 void MegaSyncListener::onSyncFileStateChanged(MegaApi *, MegaSync *, const char *, int )
 { }
@@ -2293,6 +3162,9 @@ void MegaSyncListener::onSyncStateChanged(MegaApi *, MegaSync *)
 void MegaSyncListener::onSyncEvent(MegaApi *api, MegaSync *sync, MegaSyncEvent *event)
 { }
 
+void MegaSyncListener::onSyncStatsUpdated(MegaApi *, MegaSync *)
+{ }
+
 MegaSyncEvent::~MegaSyncEvent()
 { }
 
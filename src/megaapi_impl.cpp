@@ -43,6 +43,12 @@
     #define _LARGEFILE64_SOURCE
 #endif
 #include <signal.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
 #endif
 
 
@@ -75,7 +81,7 @@ using namespace mega;
 MegaNodePrivate::MegaNodePrivate(const char *name, int type, int64_t size, int64_t ctime, int64_t mtime, uint64_t nodehandle, string *nodekey, string *attrstring, MegaHandle parentHandle, const char*auth)
 : MegaNode()
 {
-    this->name = MegaApi::strdup(name);
+    this->name = MegaNodeNames::copy(name, &internedName);
     this->type = type;
     this->size = size;
     this->ctime = ctime;
@@ -103,7 +109,7 @@ MegaNodePrivate::MegaNodePrivate(const char *name, int type, int64_t size, int64
 MegaNodePrivate::MegaNodePrivate(MegaNode *node)
 : MegaNode()
 {
-    this->name = MegaApi::strdup(node->getName());
+    this->name = MegaNodeNames::copy(node->getName(), &internedName);
     this->type = node->getType();
     this->size = node->getSize();
     this->ctime = node->getCreationTime();
@@ -127,77 +133,139 @@ MegaNodePrivate::MegaNodePrivate(MegaNode *node)
 #endif
 }
 
-MegaNodePrivate::MegaNodePrivate(Node *node)
-: MegaNode()
+void MegaNodeRecord::fill(Node *node, string *pool)
 {
-    this->name = MegaApi::strdup(node->displayname());
-    this->type = node->type;
-    this->size = node->size;
-    this->ctime = node->ctime;
-    this->mtime = node->mtime;
-    this->nodehandle = node->nodehandle;
-    this->parenthandle = node->parent ? node->parent->nodehandle : INVALID_HANDLE;
+    type = node->type;
+    size = node->size;
+    ctime = node->ctime;
+    mtime = node->mtime;
+    nodehandle = node->nodehandle;
+    parenthandle = node->parent ? node->parent->nodehandle : INVALID_HANDLE;
+
+    offsets[NAME] = pool->size();
+    pool->append(node->displayname());
+    pool->append("", 1);
 
+    offsets[NODEKEY] = pool->size();
+    pool->append(node->nodekey);
+
+    offsets[ATTRSTRING] = pool->size();
     if(node->attrstring)
     {
-        this->attrstring.assign(node->attrstring->data(), node->attrstring->size());
+        pool->append(*node->attrstring);
     }
-    this->nodekey.assign(node->nodekey.data(),node->nodekey.size());
 
-    this->changed = 0;
+    offsets[LOCALPATH] = pool->size();
+#ifdef ENABLE_SYNC
+    syncdeleted = (node->syncdeleted != SYNCDEL_NONE);
+    if(node->localnode)
+    {
+        string localPath;
+        node->localnode->getlocalpath(&localPath, true);
+        pool->append(localPath);
+        pool->append("", 1);
+    }
+#endif
+    offsets[NUMFIELDS] = pool->size();
+
+    changed = changesof(node);
+    thumbnailAvailable = (node->hasfileattribute(0) != 0);
+    previewAvailable = (node->hasfileattribute(1) != 0);
+    tag = node->tag;
+}
+
+int MegaNodeRecord::changesof(Node *node)
+{
+    int changed = 0;
     if(node->changed.attrs)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_ATTRIBUTES;
+        changed |= MegaNode::CHANGE_TYPE_ATTRIBUTES;
     }
     if(node->changed.ctime)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_TIMESTAMP;
+        changed |= MegaNode::CHANGE_TYPE_TIMESTAMP;
     }
     if(node->changed.fileattrstring)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_FILE_ATTRIBUTES;
+        changed |= MegaNode::CHANGE_TYPE_FILE_ATTRIBUTES;
     }
     if(node->changed.inshare)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_INSHARE;
+        changed |= MegaNode::CHANGE_TYPE_INSHARE;
     }
     if(node->changed.outshares)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_OUTSHARE;
+        changed |= MegaNode::CHANGE_TYPE_OUTSHARE;
     }
     if(node->changed.pendingshares)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_PENDINGSHARE;
+        changed |= MegaNode::CHANGE_TYPE_PENDINGSHARE;
     }
     if(node->changed.owner)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_OWNER;
+        changed |= MegaNode::CHANGE_TYPE_OWNER;
     }
     if(node->changed.parent)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_PARENT;
+        changed |= MegaNode::CHANGE_TYPE_PARENT;
     }
     if(node->changed.removed)
     {
-        this->changed |= MegaNode::CHANGE_TYPE_REMOVED;
+        changed |= MegaNode::CHANGE_TYPE_REMOVED;
     }
 
+    return changed;
+}
+
+MegaNodePrivate::MegaNodePrivate(Node *node)
+: MegaNode()
+{
+    MegaNodeRecord record;
+    string pool;
+
+    record.fill(node, &pool);
+    init(&record, &pool);
+}
+
+MegaNodePrivate::MegaNodePrivate(const MegaNodeRecord *record, const string *pool)
+: MegaNode()
+{
+    init(record, pool);
+}
+
+void MegaNodePrivate::init(const MegaNodeRecord *record, const string *pool)
+{
+    const char *p = pool->data();
+    const size_t *o = record->offsets;
+
+    this->name = MegaNodeNames::copy(p + o[MegaNodeRecord::NAME], &internedName);
+    this->type = record->type;
+    this->size = record->size;
+    this->ctime = record->ctime;
+    this->mtime = record->mtime;
+    this->nodehandle = record->nodehandle;
+    this->parenthandle = record->parenthandle;
+    this->nodekey.assign(p + o[MegaNodeRecord::NODEKEY], o[MegaNodeRecord::NODEKEY + 1] - o[MegaNodeRecord::NODEKEY]);
+    this->attrstring.assign(p + o[MegaNodeRecord::ATTRSTRING], o[MegaNodeRecord::ATTRSTRING + 1] - o[MegaNodeRecord::ATTRSTRING]);
+    this->changed = record->changed;
 
 #ifdef ENABLE_SYNC
-	this->syncdeleted = (node->syncdeleted != SYNCDEL_NONE);
-    if(node->localnode)
-    {
-        node->localnode->getlocalpath(&localPath, true);
-        localPath.append("", 1);
-    }
+    this->syncdeleted = record->syncdeleted;
+    this->localPath.assign(p + o[MegaNodeRecord::LOCALPATH], o[MegaNodeRecord::LOCALPATH + 1] - o[MegaNodeRecord::LOCALPATH]);
 #endif
 
-    this->thumbnailAvailable = (node->hasfileattribute(0) != 0);
-    this->previewAvailable = (node->hasfileattribute(1) != 0);
-    this->tag = node->tag;
+    this->thumbnailAvailable = record->thumbnailAvailable;
+    this->previewAvailable = record->previewAvailable;
+    this->tag = record->tag;
     this->isPublicNode = false;
 }
 
+void MegaNodePrivate::reset(const MegaNodeRecord *record, const string *pool)
+{
+    MegaNodeNames::free(name, internedName);
+    init(record, pool);
+}
+
 MegaNode *MegaNodePrivate::copy()
 {
 	return new MegaNodePrivate(this);
@@ -373,17 +441,135 @@ bool WildcardMatch(const char *pszString, const char *pszMatch)
     return !*pszMatch;
 }
 
-bool MegaApiImpl::is_syncable(const char *name)
+static bool isPathSeparator(char c)
 {
-    for(unsigned int i=0; i< excludedNames.size(); i++)
+#ifdef _WIN32
+    return c == '/' || c == '\\';
+#else
+    return c == '/';
+#endif
+}
+
+void ExclusionRules::set(vector<string> *patterns)
+{
+    clear();
+
+    for (unsigned int i = 0; i < patterns->size(); i++)
     {
-        if(WildcardMatch(name, excludedNames[i].c_str()))
+        string pattern = patterns->at(i);
+        size_t wildcard = pattern.find_first_of("*?");
+        bool path = false;
+
+        for (unsigned int j = 0; j < pattern.size(); j++)
         {
-            return false;
+            if (isPathSeparator(pattern[j]))
+            {
+                pattern[j] = '/';
+                path = true;
+            }
+        }
+
+        if (path)
+        {
+            paths.push_back(pattern);
+        }
+        else if (wildcard == string::npos)
+        {
+            names.insert(pattern);
+        }
+        else if (wildcard == pattern.size() - 1 && pattern[wildcard] == '*')
+        {
+            prefixes[wildcard].insert(pattern.substr(0, wildcard));
+        }
+        else if (!wildcard && pattern[0] == '*' && pattern.find_first_of("*?", 1) == string::npos)
+        {
+            suffixes[pattern.size() - 1].insert(pattern.substr(1));
+        }
+        else
+        {
+            wildcards.push_back(pattern);
+        }
+    }
+}
+
+void ExclusionRules::clear()
+{
+    names.clear();
+    prefixes.clear();
+    suffixes.clear();
+    wildcards.clear();
+    paths.clear();
+}
+
+bool ExclusionRules::lookup(const map<size_t, std::set<string> > *buckets, const char *name, size_t len, bool suffix)
+{
+    for (map<size_t, std::set<string> >::const_iterator it = buckets->begin(); it != buckets->end() && it->first <= len; it++)
+    {
+        if (it->second.count(string(suffix ? name + len - it->first : name, it->first)))
+        {
+            return true;
         }
     }
 
-    return true;
+    return false;
+}
+
+bool ExclusionRules::excludesName(const char *name) const
+{
+    size_t len = strlen(name);
+
+    if (names.count(name) || lookup(&prefixes, name, len, false) || lookup(&suffixes, name, len, true))
+    {
+        return true;
+    }
+
+    for (unsigned int i = 0; i < wildcards.size(); i++)
+    {
+        if (WildcardMatch(name, wildcards[i].c_str()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ExclusionRules::excludesPath(const char *path) const
+{
+    if (!paths.size())
+    {
+        return false;
+    }
+
+    string p = path;
+
+    for (unsigned int i = 0; i < p.size(); i++)
+    {
+        if (isPathSeparator(p[i]))
+        {
+            p[i] = '/';
+        }
+    }
+
+    for (unsigned int i = 0; i < paths.size(); i++)
+    {
+        if (WildcardMatch(p.c_str(), paths[i].c_str()))
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool ExclusionRules::hasPathRules() const
+{
+    return paths.size() != 0;
+}
+
+bool MegaApiImpl::is_syncable(const char *name)
+{
+    return !excludedNames.excludesName(name);
 }
 
 bool MegaApiImpl::is_syncable(long long size)
@@ -484,7 +670,7 @@ string *MegaNodePrivate::getAuth()
 
 MegaNodePrivate::~MegaNodePrivate()
 {
- 	delete[] name;
+    MegaNodeNames::free(name, internedName);
 }
 
 MegaUserPrivate::MegaUserPrivate(User *user) : MegaUser()
@@ -620,15 +806,23 @@ MegaTransferPrivate::MegaTransferPrivate(int type, MegaTransferListener *listene
     this->lastBytes = NULL;
     this->syncTransfer = false;
     this->lastError = API_OK;
+    this->timings = NULL;
+    this->statsTotal = -1;
+    this->statsTransferred = 0;
+    this->inputStream = NULL;
+    this->folderTransferTag = 0;
 }
 
 MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
 {
+    this->statsTotal = -1;
+    this->statsTransferred = 0;
     path = NULL;
     parentPath = NULL;
     fileName = NULL;
     publicNode = NULL;
 	lastBytes = NULL;
+    timings = NULL;
 
     this->listener = transfer->getListener();
     this->transfer = transfer->getTransfer();
@@ -654,6 +848,29 @@ MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
     this->setTransfer(transfer->getTransfer());
     this->setSyncTransfer(transfer->isSyncTransfer());
     this->setLastErrorCode(transfer->getLastErrorCode());
+    this->setTimings(transfer->timings);
+    this->inputStream = transfer->getInputStream();
+    this->folderTransferTag = transfer->getFolderTransferTag();
+}
+
+void MegaTransferPrivate::setInputStream(MegaInputStream *inputStream)
+{
+    this->inputStream = inputStream;
+}
+
+MegaInputStream *MegaTransferPrivate::getInputStream() const
+{
+    return inputStream;
+}
+
+void MegaTransferPrivate::setFolderTransferTag(int tag)
+{
+    this->folderTransferTag = tag;
+}
+
+int MegaTransferPrivate::getFolderTransferTag() const
+{
+    return folderTransferTag;
 }
 
 MegaTransfer* MegaTransferPrivate::copy()
@@ -796,6 +1013,12 @@ error MegaTransferPrivate::getLastErrorCode() const
     return this->lastError;
 }
 
+MegaTransferTimings *MegaTransferPrivate::getTimings() const
+{
+    ChunkTimingStats empty;
+    return new MegaTransferTimingsPrivate(timings ? timings : &empty);
+}
+
 void MegaTransferPrivate::setTag(int tag)
 {
 	this->tag = tag;
@@ -856,6 +1079,21 @@ void MegaTransferPrivate::setLastErrorCode(error errorCode)
     this->lastError = errorCode;
 }
 
+void MegaTransferPrivate::setTimings(const ChunkTimingStats *timings)
+{
+    if(!timings)
+    {
+        return;
+    }
+
+    if(!this->timings)
+    {
+        this->timings = new ChunkTimingStats();
+    }
+
+    *this->timings = *timings;
+}
+
 void MegaTransferPrivate::setPath(const char* path)
 {
 	if(this->path) delete [] this->path;
@@ -899,6 +1137,11 @@ void MegaTransferPrivate::setParentHandle(uint64_t parentHandle)
 	this->parentHandle = parentHandle;
 }
 
+void MegaTransferPrivate::setListener(MegaTransferListener *listener)
+{
+    this->listener = listener;
+}
+
 void MegaTransferPrivate::setStartPos(long long startPos)
 {
 	this->startPos = startPos;
@@ -948,155 +1191,394 @@ MegaTransferPrivate::~MegaTransferPrivate()
 	delete[] parentPath;
 	delete [] fileName;
     delete publicNode;
+    delete timings;
 }
 
-const char * MegaTransferPrivate::toString() const
+MegaTransferBufferPrivate::MegaTransferBufferPrivate(MegaApiImpl *api, string *buffer, size_t size, long long offset)
 {
-	return getTransferString();
+    this->api = api;
+    this->buffer = buffer;
+    this->size = size;
+    this->offset = offset;
 }
 
-const char * MegaTransferPrivate::__str__() const
+MegaTransferBufferPrivate::~MegaTransferBufferPrivate()
 {
-	return getTransferString();
+
 }
 
-const char *MegaTransferPrivate::__toString() const
+const char *MegaTransferBufferPrivate::getData() const
 {
-	return getTransferString();
+    return buffer->data();
 }
 
-MegaContactRequestPrivate::MegaContactRequestPrivate(PendingContactRequest *request)
+size_t MegaTransferBufferPrivate::getSize() const
 {
-    handle = request->id;
-    sourceEmail = request->originatoremail.size() ? MegaApi::strdup(request->originatoremail.c_str()) : NULL;
-    sourceMessage = request->msg.size() ? MegaApi::strdup(request->msg.c_str()) : NULL;
-    targetEmail = request->targetemail.size() ? MegaApi::strdup(request->targetemail.c_str()) : NULL;
-    creationTime = request->ts;
-    modificationTime = request->uts;
+    return size;
+}
 
-    if(request->changed.accepted)
-    {
-        status = MegaContactRequest::STATUS_ACCEPTED;
-    }
-    else if(request->changed.deleted)
-    {
-        status = MegaContactRequest::STATUS_DELETED;
-    }
-    else if(request->changed.denied)
-    {
-        status = MegaContactRequest::STATUS_DENIED;
-    }
-    else if(request->changed.ignored)
+long long MegaTransferBufferPrivate::getOffset() const
+{
+    return offset;
+}
+
+void MegaTransferBufferPrivate::release()
+{
+    api->releaseTransferBuffer(buffer);
+    delete this;
+}
+
+MegaEngineMetricsPrivate::MegaEngineMetricsPrivate(const EngineStats *stats, const std::map<string, HttpHostStats> *hoststats, int inflight)
+{
+    this->stats = *stats;
+    this->inflight = inflight;
+
+    for (std::map<string, HttpHostStats>::const_iterator it = hoststats->begin(); it != hoststats->end(); it++)
     {
-        status = MegaContactRequest::STATUS_IGNORED;
+        hostnames.push_back(it->first);
+        hosts.push_back(it->second);
     }
-    else if(request->changed.reminded)
+}
+
+MegaEngineMetrics *MegaEngineMetricsPrivate::copy() const
+{
+    return new MegaEngineMetricsPrivate(*this);
+}
+
+long long MegaEngineMetricsPrivate::getCounter(int counter) const
+{
+    switch (counter)
     {
-        status = MegaContactRequest::STATUS_REMINDED;
+        case COUNTER_API_BATCHES: return stats.csbatches;
+        case COUNTER_API_RETRIES: return stats.csretries;
+        case COUNTER_API_IN_FLIGHT: return inflight;
+        case COUNTER_SC_RESPONSES: return stats.scresponses;
+        case COUNTER_ACTION_PACKETS: return stats.actionpackets;
+        case COUNTER_SC_RETRIES: return stats.scretries;
+        case COUNTER_CHUNK_FAILURES: return stats.chunkfailures;
     }
-    else
+
+    return 0;
+}
+
+const DurationStats *MegaEngineMetricsPrivate::duration(int duration) const
+{
+    switch (duration)
     {
-        status = MegaContactRequest::STATUS_UNRESOLVED;
+        case DURATION_API_LATENCY: return &stats.cslatency;
+        case DURATION_DB_COMMIT: return &stats.dbcommits;
+        case DURATION_EXEC: return &stats.execs;
+        case DURATION_WAIT: return &stats.waits;
     }
 
-    outgoing = request->isoutgoing;
+    return NULL;
 }
 
-MegaContactRequestPrivate::MegaContactRequestPrivate(const MegaContactRequest *request)
+long long MegaEngineMetricsPrivate::getDurationCount(int duration) const
 {
-    handle = request->getHandle();
-    sourceEmail = MegaApi::strdup(request->getSourceEmail());
-    sourceMessage = MegaApi::strdup(request->getSourceMessage());
-    targetEmail = MegaApi::strdup(request->getTargetEmail());
-    creationTime = request->getCreationTime();
-    modificationTime = request->getModificationTime();
-    status = request->getStatus();
-    outgoing = request->isOutgoing();
+    const DurationStats *d = this->duration(duration);
+    return d ? d->count : 0;
 }
 
-MegaContactRequestPrivate::~MegaContactRequestPrivate()
+long long MegaEngineMetricsPrivate::getDurationTotal(int duration) const
 {
-    delete [] sourceEmail;
-    delete [] sourceMessage;
-    delete [] targetEmail;
+    const DurationStats *d = this->duration(duration);
+    return d ? d->total : 0;
 }
 
-MegaContactRequest *MegaContactRequestPrivate::fromContactRequest(PendingContactRequest *request)
+long long MegaEngineMetricsPrivate::getDurationMax(int duration) const
 {
-    return new MegaContactRequestPrivate(request);
+    const DurationStats *d = this->duration(duration);
+    return d ? d->max : 0;
 }
 
-MegaContactRequest *MegaContactRequestPrivate::copy() const
+int MegaEngineMetricsPrivate::getNumHosts() const
 {
-    return new MegaContactRequestPrivate(this);
+    return hosts.size();
 }
 
-MegaHandle MegaContactRequestPrivate::getHandle() const
+const char *MegaEngineMetricsPrivate::getHostName(int i) const
 {
-    return handle;
+    return (i >= 0 && i < (int)hosts.size()) ? hostnames[i].c_str() : NULL;
 }
 
-char *MegaContactRequestPrivate::getSourceEmail() const
+long long MegaEngineMetricsPrivate::getHostRequests(int i) const
 {
-    return sourceEmail;
+    return (i >= 0 && i < (int)hosts.size()) ? hosts[i].requests : 0;
 }
 
-char *MegaContactRequestPrivate::getSourceMessage() const
+long long MegaEngineMetricsPrivate::getHostFailures(int i) const
 {
-    return sourceMessage;
+    return (i >= 0 && i < (int)hosts.size()) ? hosts[i].failures : 0;
 }
 
-char *MegaContactRequestPrivate::getTargetEmail() const
+long long MegaEngineMetricsPrivate::getHostBytesSent(int i) const
 {
-    return targetEmail;
+    return (i >= 0 && i < (int)hosts.size()) ? hosts[i].bytesout : 0;
 }
 
-int64_t MegaContactRequestPrivate::getCreationTime() const
+long long MegaEngineMetricsPrivate::getHostBytesReceived(int i) const
 {
-    return creationTime;
+    return (i >= 0 && i < (int)hosts.size()) ? hosts[i].bytesin : 0;
 }
 
-int64_t MegaContactRequestPrivate::getModificationTime() const
+MegaStartupTimelinePrivate::MegaStartupTimelinePrivate(const StartupTrace *trace)
 {
-    return modificationTime;
+    this->trace = *trace;
 }
 
-int MegaContactRequestPrivate::getStatus() const
+MegaStartupTimeline *MegaStartupTimelinePrivate::copy() const
 {
-    return status;
+    return new MegaStartupTimelinePrivate(*this);
 }
 
-bool MegaContactRequestPrivate::isOutgoing() const
+bool MegaStartupTimelinePrivate::isComplete() const
 {
-    return outgoing;
+    return trace.finished[STARTUP_CURRENT] >= 0;
 }
 
+long long MegaStartupTimelinePrivate::getPhaseStart(int phase) const
+{
+    return (phase >= 0 && phase < STARTUP_NUMPHASES) ? trace.started[phase] : -1;
+}
 
-MegaAccountDetails *MegaAccountDetailsPrivate::fromAccountDetails(AccountDetails *details)
+long long MegaStartupTimelinePrivate::getPhaseEnd(int phase) const
 {
-    return new MegaAccountDetailsPrivate(details);
+    return (phase >= 0 && phase < STARTUP_NUMPHASES) ? trace.finished[phase] : -1;
 }
 
-MegaAccountDetailsPrivate::MegaAccountDetailsPrivate(AccountDetails *details)
+long long MegaStartupTimelinePrivate::getPhaseBytes(int phase) const
 {
-    this->details = (*details);
+    return (phase >= 0 && phase < STARTUP_NUMPHASES) ? trace.bytes[phase] : 0;
 }
 
-MegaAccountDetailsPrivate::~MegaAccountDetailsPrivate()
-{ }
+long long MegaStartupTimelinePrivate::getPhaseItems(int phase) const
+{
+    return (phase >= 0 && phase < STARTUP_NUMPHASES) ? trace.items[phase] : 0;
+}
 
-MegaRequest *MegaRequestPrivate::copy()
+MegaTransferTimingsPrivate::MegaTransferTimingsPrivate(const ChunkTimingStats *stats)
 {
-    return new MegaRequestPrivate(this);
+    this->stats = *stats;
 }
 
-MegaRequestPrivate::MegaRequestPrivate(int type, MegaRequestListener *listener)
+MegaTransferTimingsPrivate::~MegaTransferTimingsPrivate()
 {
-	this->type = type;
-    this->tag = 0;
-	this->transfer = 0;
-	this->listener = listener;
-#ifdef ENABLE_SYNC
+
+}
+
+MegaTransferTimings *MegaTransferTimingsPrivate::copy() const
+{
+    return new MegaTransferTimingsPrivate(&stats);
+}
+
+long long MegaTransferTimingsPrivate::getNumChunks() const
+{
+    return stats.chunks;
+}
+
+long long MegaTransferTimingsPrivate::getBytes() const
+{
+    return stats.bytes;
+}
+
+long long MegaTransferTimingsPrivate::getPhaseCount(int phase, int bucket) const
+{
+    if(phase < 0 || phase >= ChunkTimingStats::NUMPHASES || bucket < 0 || bucket >= ChunkTimingStats::NUMBUCKETS)
+    {
+        return 0;
+    }
+
+    return stats.histogram[phase][bucket];
+}
+
+long long MegaTransferTimingsPrivate::getPhaseSamples(int phase) const
+{
+    if(phase < 0 || phase >= ChunkTimingStats::NUMPHASES)
+    {
+        return 0;
+    }
+
+    return stats.samples[phase];
+}
+
+long long MegaTransferTimingsPrivate::getPhaseTotalTime(int phase) const
+{
+    if(phase < 0 || phase >= ChunkTimingStats::NUMPHASES)
+    {
+        return 0;
+    }
+
+    return stats.total[phase];
+}
+
+long long MegaTransferTimingsPrivate::getPhaseMaxTime(int phase) const
+{
+    if(phase < 0 || phase >= ChunkTimingStats::NUMPHASES)
+    {
+        return 0;
+    }
+
+    return stats.max[phase];
+}
+
+long long MegaTransferTimingsPrivate::getThroughputCount(int bucket) const
+{
+    if(bucket < 0 || bucket >= ChunkTimingStats::NUMBUCKETS)
+    {
+        return 0;
+    }
+
+    return stats.throughput[bucket];
+}
+
+const char * MegaTransferPrivate::toString() const
+{
+	return getTransferString();
+}
+
+const char * MegaTransferPrivate::__str__() const
+{
+	return getTransferString();
+}
+
+const char *MegaTransferPrivate::__toString() const
+{
+	return getTransferString();
+}
+
+MegaContactRequestPrivate::MegaContactRequestPrivate(PendingContactRequest *request)
+{
+    handle = request->id;
+    sourceEmail = request->originatoremail.size() ? MegaApi::strdup(request->originatoremail.c_str()) : NULL;
+    sourceMessage = request->msg.size() ? MegaApi::strdup(request->msg.c_str()) : NULL;
+    targetEmail = request->targetemail.size() ? MegaApi::strdup(request->targetemail.c_str()) : NULL;
+    creationTime = request->ts;
+    modificationTime = request->uts;
+
+    if(request->changed.accepted)
+    {
+        status = MegaContactRequest::STATUS_ACCEPTED;
+    }
+    else if(request->changed.deleted)
+    {
+        status = MegaContactRequest::STATUS_DELETED;
+    }
+    else if(request->changed.denied)
+    {
+        status = MegaContactRequest::STATUS_DENIED;
+    }
+    else if(request->changed.ignored)
+    {
+        status = MegaContactRequest::STATUS_IGNORED;
+    }
+    else if(request->changed.reminded)
+    {
+        status = MegaContactRequest::STATUS_REMINDED;
+    }
+    else
+    {
+        status = MegaContactRequest::STATUS_UNRESOLVED;
+    }
+
+    outgoing = request->isoutgoing;
+}
+
+MegaContactRequestPrivate::MegaContactRequestPrivate(const MegaContactRequest *request)
+{
+    handle = request->getHandle();
+    sourceEmail = MegaApi::strdup(request->getSourceEmail());
+    sourceMessage = MegaApi::strdup(request->getSourceMessage());
+    targetEmail = MegaApi::strdup(request->getTargetEmail());
+    creationTime = request->getCreationTime();
+    modificationTime = request->getModificationTime();
+    status = request->getStatus();
+    outgoing = request->isOutgoing();
+}
+
+MegaContactRequestPrivate::~MegaContactRequestPrivate()
+{
+    delete [] sourceEmail;
+    delete [] sourceMessage;
+    delete [] targetEmail;
+}
+
+MegaContactRequest *MegaContactRequestPrivate::fromContactRequest(PendingContactRequest *request)
+{
+    return new MegaContactRequestPrivate(request);
+}
+
+MegaContactRequest *MegaContactRequestPrivate::copy() const
+{
+    return new MegaContactRequestPrivate(this);
+}
+
+MegaHandle MegaContactRequestPrivate::getHandle() const
+{
+    return handle;
+}
+
+char *MegaContactRequestPrivate::getSourceEmail() const
+{
+    return sourceEmail;
+}
+
+char *MegaContactRequestPrivate::getSourceMessage() const
+{
+    return sourceMessage;
+}
+
+char *MegaContactRequestPrivate::getTargetEmail() const
+{
+    return targetEmail;
+}
+
+int64_t MegaContactRequestPrivate::getCreationTime() const
+{
+    return creationTime;
+}
+
+int64_t MegaContactRequestPrivate::getModificationTime() const
+{
+    return modificationTime;
+}
+
+int MegaContactRequestPrivate::getStatus() const
+{
+    return status;
+}
+
+bool MegaContactRequestPrivate::isOutgoing() const
+{
+    return outgoing;
+}
+
+
+MegaAccountDetails *MegaAccountDetailsPrivate::fromAccountDetails(AccountDetails *details)
+{
+    return new MegaAccountDetailsPrivate(details);
+}
+
+MegaAccountDetailsPrivate::MegaAccountDetailsPrivate(AccountDetails *details)
+{
+    this->details = (*details);
+}
+
+MegaAccountDetailsPrivate::~MegaAccountDetailsPrivate()
+{ }
+
+MegaRequest *MegaRequestPrivate::copy()
+{
+    return new MegaRequestPrivate(this);
+}
+
+MegaRequestPrivate::MegaRequestPrivate(int type, MegaRequestListener *listener)
+{
+	this->type = type;
+    this->tag = 0;
+	this->transfer = 0;
+	this->listener = listener;
+#ifdef ENABLE_SYNC
     this->syncListener = NULL;
 #endif
 	this->nodeHandle = UNDEF;
@@ -1119,6 +1601,8 @@ MegaRequestPrivate::MegaRequestPrivate(int type, MegaRequestListener *listener)
     this->totalBytes = -1;
     this->transferredBytes = 0;
     this->number = 0;
+    this->nodeList = NULL;
+    this->searchFilter = NULL;
 
     if(type == MegaRequest::TYPE_ACCOUNT_DETAILS)
     {
@@ -1153,6 +1637,10 @@ MegaRequestPrivate::MegaRequestPrivate(MegaRequestPrivate *request)
     this->publicNode = NULL;
     this->file = NULL;
     this->publicNode = NULL;
+    this->nodeList = request->getMegaNodeList() ? request->getMegaNodeList()->copy() : NULL;
+    this->searchFilter = request->getSearchFilter() ? request->getSearchFilter()->copy() : NULL;
+    this->nodeErrors = request->nodeErrors;
+    this->nodeLinks = request->nodeLinks;
 
     this->type = request->getType();
     this->setTag(request->getTag());
@@ -1208,6 +1696,82 @@ MegaSyncListener *MegaRequestPrivate::getSyncListener() const
 }
 #endif
 
+void MegaRequestPrivate::setMegaNodeList(MegaNodeList *nodeList)
+{
+    delete this->nodeList;
+    this->nodeList = nodeList;
+}
+
+MegaNodeList *MegaRequestPrivate::getMegaNodeList() const
+{
+    return nodeList;
+}
+
+void MegaRequestPrivate::setSearchFilter(MegaSearchFilter *searchFilter)
+{
+    delete this->searchFilter;
+    this->searchFilter = searchFilter;
+}
+
+MegaSearchFilter *MegaRequestPrivate::getSearchFilter() const
+{
+    return searchFilter;
+}
+
+void MegaRequestPrivate::setNodeResult(int index, int errorCode, const char *link)
+{
+    if (index < 0)
+    {
+        return;
+    }
+
+    if ((int)nodeErrors.size() <= index)
+    {
+        nodeErrors.resize(index + 1);
+        nodeLinks.resize(index + 1);
+    }
+
+    nodeErrors[index] = errorCode;
+    nodeLinks[index] = link ? link : "";
+}
+
+int MegaRequestPrivate::getNodeErrorCode(int index) const
+{
+    return (index >= 0 && index < (int)nodeErrors.size()) ? nodeErrors[index] : 0;
+}
+
+const char *MegaRequestPrivate::getNodeLink(int index) const
+{
+    if (index < 0 || index >= (int)nodeLinks.size() || !nodeLinks[index].size())
+    {
+        return NULL;
+    }
+
+    return nodeLinks[index].c_str();
+}
+
+void MegaRequestPrivate::addPendingNode(int index)
+{
+    pendingNodes.push_back(index);
+}
+
+int MegaRequestPrivate::nextPendingNode()
+{
+    if (!pendingNodes.size())
+    {
+        return -1;
+    }
+
+    int index = pendingNodes.front();
+    pendingNodes.pop_front();
+    return index;
+}
+
+int MegaRequestPrivate::getNumPendingNodes() const
+{
+    return (int)pendingNodes.size();
+}
+
 MegaAccountDetails *MegaRequestPrivate::getMegaAccountDetails() const
 {
     if(accountDetails)
@@ -1231,6 +1795,8 @@ MegaRequestPrivate::~MegaRequestPrivate()
 	delete accountDetails;
     delete megaPricing;
     delete [] text;
+    delete nodeList;
+    delete searchFilter;
 }
 
 int MegaRequestPrivate::getType() const
@@ -1559,6 +2125,12 @@ const char *MegaRequestPrivate::getRequestString() const
         case TYPE_SUBMIT_FEEDBACK: return "SUBMIT_FEEDBACK";
         case TYPE_SEND_EVENT: return "SEND_EVENT";
         case TYPE_CLEAN_RUBBISH_BIN: return "CLEAN_RUBBISH_BIN";
+        case TYPE_REMOVE_LOCAL_FOLDER: return "REMOVE_LOCAL_FOLDER";
+        case TYPE_GET_PW_KEY: return "GET_PW_KEY";
+        case TYPE_SEARCH: return "SEARCH";
+        case TYPE_FETCH_FOLDER: return "FETCH_FOLDER";
+        case TYPE_SET_NODES_ATTRIBUTE: return "SET_NODES_ATTRIBUTE";
+        case TYPE_EXPORT_NODES: return "EXPORT_NODES";
 	}
     return "UNKNOWN";
 }
@@ -1588,34 +2160,118 @@ const char *MegaRequestPrivate::__toString() const
 	return getRequestString();
 }
 
-MegaNodeListPrivate::MegaNodeListPrivate()
+MegaChildrenCursorPrivate::MegaChildrenCursorPrivate(MegaHandle parenthandle, int order)
 {
-	list = NULL;
-	s = 0;
+    this->parenthandle = parenthandle;
+    this->order = order;
+    this->position = 0;
+    this->last = UNDEF;
+    this->more = true;
 }
 
-MegaNodeListPrivate::MegaNodeListPrivate(Node** newlist, int size)
+MegaChildrenCursor *MegaChildrenCursorPrivate::copy()
 {
-	list = NULL; s = size;
-	if(!size) return;
+    return new MegaChildrenCursorPrivate(*this);
+}
 
-	list = new MegaNode*[size];
-	for(int i=0; i<size; i++)
-		list[i] = MegaNodePrivate::fromNode(newlist[i]);
+MegaHandle MegaChildrenCursorPrivate::getParentHandle()
+{
+    return parenthandle;
 }
 
-MegaNodeListPrivate::MegaNodeListPrivate(MegaNodeListPrivate *nodeList)
+int MegaChildrenCursorPrivate::getOrder()
 {
-    s = nodeList->size();
-	if (!s)
-	{
-		list = NULL;
+    return order;
+}
+
+int MegaChildrenCursorPrivate::getPosition()
+{
+    return position;
+}
+
+bool MegaChildrenCursorPrivate::hasMore()
+{
+    return more;
+}
+
+MegaNodeDeltaListPrivate::MegaNodeDeltaListPrivate(bool reload)
+{
+    this->reload = reload;
+    this->sequence = 0;
+}
+
+MegaNodeDeltaList *MegaNodeDeltaListPrivate::copy()
+{
+    return new MegaNodeDeltaListPrivate(*this);
+}
+
+MegaHandle MegaNodeDeltaListPrivate::getHandle(int i)
+{
+    if(i < 0 || i >= (int)deltas.size())
+        return INVALID_HANDLE;
+
+    return deltas[i].first;
+}
+
+int MegaNodeDeltaListPrivate::getChanges(int i)
+{
+    if(i < 0 || i >= (int)deltas.size())
+        return 0;
+
+    return deltas[i].second;
+}
+
+int MegaNodeDeltaListPrivate::size()
+{
+    return deltas.size();
+}
+
+bool MegaNodeDeltaListPrivate::isReloadNeeded()
+{
+    return reload;
+}
+
+long long MegaNodeDeltaListPrivate::getSequence()
+{
+    return sequence;
+}
+
+MegaNodeListPrivate::MegaNodeListPrivate()
+{
+	list = NULL;
+	s = 0;
+}
+
+MegaNodeListPrivate::MegaNodeListPrivate(Node** newlist, int size)
+{
+	list = NULL; s = size;
+	if(!size) return;
+
+	// O(n) plain copies under the SDK lock instead of n MegaNode objects
+	records.resize(size);
+	pool.reserve(size * 48);
+	for(int i=0; i<size; i++)
+	{
+		records[i].fill(newlist[i], &pool);
+	}
+
+	list = new MegaNode*[size]();
+}
+
+MegaNodeListPrivate::MegaNodeListPrivate(MegaNodeListPrivate *nodeList)
+{
+    s = nodeList->size();
+	if (!s)
+	{
+		list = NULL;
 		return;
 	}
 
-	list = new MegaNode*[s];
-	for (int i = 0; i<s; i++)
-        list[i] = new MegaNodePrivate(nodeList->get(i));
+	list = new MegaNode*[s]();
+
+    // (nodes are immutable: they can be built again from the records)
+    records = nodeList->records;
+    pool = nodeList->pool;
 }
 
 MegaNodeListPrivate::~MegaNodeListPrivate()
@@ -1638,6 +2294,11 @@ MegaNode *MegaNodeListPrivate::get(int i)
 	if(!list || (i < 0) || (i >= s))
 		return NULL;
 
+    if(!list[i])
+    {
+        list[i] = new MegaNodePrivate(&records[i], &pool);
+    }
+
 	return list[i];
 }
 
@@ -1791,6 +2452,144 @@ int MegaTransferListPrivate::size()
 	return s;
 }
 
+MegaTransferStatsPrivate::MegaTransferStatsPrivate()
+{
+    for (int d = 0; d < 2; d++)
+    {
+        pending[d] = 0;
+        active[d] = 0;
+        completed[d] = 0;
+        failed[d] = 0;
+        pendingBytes[d] = 0;
+        transferredBytes[d] = 0;
+        completedBytes[d] = 0;
+        speed[d] = 0;
+    }
+}
+
+MegaTransferStats *MegaTransferStatsPrivate::copy()
+{
+    return new MegaTransferStatsPrivate(*this);
+}
+
+MegaMemoryUsagePrivate::MegaMemoryUsagePrivate(MemoryUsage *usage)
+{
+    for (int i = 0; i < MemoryUsage::NUMSUBSYSTEMS; i++)
+    {
+        bytes[i] = usage->bytes[i];
+    }
+}
+
+MegaMemoryUsage *MegaMemoryUsagePrivate::copy()
+{
+    return new MegaMemoryUsagePrivate(*this);
+}
+
+long long MegaMemoryUsagePrivate::getBytes(int subsystem)
+{
+    return (subsystem >= 0 && subsystem < MemoryUsage::NUMSUBSYSTEMS) ? bytes[subsystem] : 0;
+}
+
+long long MegaMemoryUsagePrivate::getTotalBytes()
+{
+    long long total = 0;
+
+    for (int i = 0; i < MemoryUsage::NUMSUBSYSTEMS; i++)
+    {
+        total += bytes[i];
+    }
+
+    return total;
+}
+
+bool MegaTransferStatsPrivate::valid(int direction)
+{
+    return direction == MegaTransfer::TYPE_DOWNLOAD || direction == MegaTransfer::TYPE_UPLOAD;
+}
+
+int MegaTransferStatsPrivate::getNumPending(int direction)
+{
+    return valid(direction) ? pending[direction] : 0;
+}
+
+int MegaTransferStatsPrivate::getNumActive(int direction)
+{
+    return valid(direction) ? active[direction] : 0;
+}
+
+int MegaTransferStatsPrivate::getNumCompleted(int direction)
+{
+    return valid(direction) ? completed[direction] : 0;
+}
+
+int MegaTransferStatsPrivate::getNumFailed(int direction)
+{
+    return valid(direction) ? failed[direction] : 0;
+}
+
+long long MegaTransferStatsPrivate::getPendingBytes(int direction)
+{
+    return valid(direction) ? pendingBytes[direction] : 0;
+}
+
+long long MegaTransferStatsPrivate::getTransferredBytes(int direction)
+{
+    return valid(direction) ? transferredBytes[direction] : 0;
+}
+
+long long MegaTransferStatsPrivate::getCompletedBytes(int direction)
+{
+    return valid(direction) ? completedBytes[direction] : 0;
+}
+
+long long MegaTransferStatsPrivate::getSpeed(int direction)
+{
+    return valid(direction) ? speed[direction] : 0;
+}
+
+long long MegaTransferStatsPrivate::getEta(int direction)
+{
+    if (!valid(direction) || speed[direction] <= 0)
+    {
+        return -1;
+    }
+
+    long long remaining = pendingBytes[direction] - transferredBytes[direction];
+    return remaining > 0 ? (remaining + speed[direction] - 1) / speed[direction] : 0;
+}
+
+MegaTransferBatch *MegaTransferBatch::createInstance()
+{
+    return new MegaTransferBatchPrivate();
+}
+
+MegaTransferBatchPrivate::MegaTransferBatchPrivate()
+{
+}
+
+MegaTransferBatchPrivate::~MegaTransferBatchPrivate()
+{
+    for (unsigned i = 0; i < transfers.size(); i++)
+    {
+        delete transfers[i];
+    }
+}
+
+void MegaTransferBatchPrivate::addUpload(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime)
+{
+    transfers.push_back(MegaApiImpl::newUploadTransfer(localPath, parent, fileName, mtime, NULL));
+}
+
+void MegaTransferBatchPrivate::addDownload(MegaNode *node, const char *localPath)
+{
+    transfers.push_back(MegaApiImpl::newDownloadTransfer(node, localPath, 0, 0, NULL));
+}
+
+int MegaTransferBatchPrivate::size()
+{
+    return transfers.size();
+}
+
 MegaContactRequestListPrivate::MegaContactRequestListPrivate()
 {
     list = NULL;
@@ -1866,7 +2665,9 @@ MegaFile::MegaFile() : File()
 
 MegaFileGet::MegaFileGet(MegaClient *client, Node *n, string dstPath) : MegaFile()
 {
+    this->client = client;
     h = n->nodehandle;
+    n->resolveattrs();
     *(FileFingerprint*)this = *n;
 
     string securename = n->displayname();
@@ -1894,6 +2695,7 @@ MegaFileGet::MegaFileGet(MegaClient *client, Node *n, string dstPath) : MegaFile
 
 MegaFileGet::MegaFileGet(MegaClient *client, MegaNode *n, string dstPath) : MegaFile()
 {
+    this->client = client;
     h = n->getHandle();
     name = n->getName();
 	string finalPath;
@@ -1920,6 +2722,12 @@ MegaFileGet::MegaFileGet(MegaClient *client, MegaNode *n, string dstPath) : Mega
     }
 }
 
+// finished or cancelled: leave the persistent queue
+MegaFileGet::~MegaFileGet()
+{
+    client->unqueuefile(this);
+}
+
 void MegaFileGet::prepare()
 {
     if (!transfer->localfilename.size())
@@ -2023,89 +2831,472 @@ TreeProcessor::~TreeProcessor()
 { }
 
 
-//Entry point for the blocking thread
-void *MegaApiImpl::threadEntryPoint(void *param)
+MegaUploadFingerprintJob::MegaUploadFingerprintJob(MegaTransferPrivate *transfer, FileAccess *fa, string *localname)
+{
+    this->transfer = transfer;
+    this->fa = fa;
+    this->localname = *localname;
+}
+
+MegaRemoveRecursivelyJob::MegaRemoveRecursivelyJob(MegaRequestPrivate *request)
 {
+    this->request = request;
+    reported = 0;
+
 #ifndef _WIN32
-    struct sigaction noaction;
-    memset(&noaction, 0, sizeof(noaction));
-    noaction.sa_handler = SIG_IGN;
-    ::sigaction(SIGPIPE, &noaction, 0);
+    localPath = request->getFile();
+#else
+    MegaApi::utf8ToUtf16(request->getFile(), &localPath);
+    if(localPath.size())
+    {
+        localPath.resize(localPath.size()-2);
+    }
 #endif
-
-    MegaApiImpl *megaApiImpl = (MegaApiImpl *)param;
-    megaApiImpl->loop();
-	return 0;
 }
 
-ExternalLogger *MegaApiImpl::externalLogger = NULL;
+void MegaRemoveRecursivelyJob::run()
+{
+#ifndef _WIN32
+    PosixFileSystemAccess::emptydirlocal(&localPath, 0, &progress);
+#else
+    if(localPath.size())
+    {
+        WinFileSystemAccess::emptydirlocal(&localPath, 0, &progress);
+    }
+#endif
+}
 
-MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent)
+MegaFolderDownload::MegaFolderDownload(MegaTransferPrivate *transfer)
 {
-	init(api, appKey, processor, basePath, userAgent);
+    this->transfer = transfer;
+    nextfile = 0;
+    totalbytes = 0;
+    activebytes = 0;
+    donebytes = 0;
+    lasterror = API_OK;
+    e = API_OK;
+    started = false;
+    cancelled = false;
 }
 
-MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent)
+bool MegaFolderDownload::snapshot(MegaClient *client, Node *node, string *path)
 {
-	init(api, appKey, NULL, basePath, userAgent);
+    if(node->partial)
+    {
+        return false;
+    }
+
+    string localpath;
+    string separator;
+    client->fsaccess->path2local(path, &localpath);
+    client->fsaccess->local2path(&client->fsaccess->localseparator, &separator);
+
+    unsigned folder = paths.size();
+    folders.push_back(localpath);
+    paths.push_back(*path + separator);
+
+    for(node_vector::iterator it = node->children.begin(); it != node->children.end(); it++)
+    {
+        Node *child = *it;
+        if(child->type == FILENODE)
+        {
+            FolderFile f;
+            f.h = child->nodehandle;
+            f.size = child->size;
+            f.folder = folder;
+            files.push_back(f);
+            totalbytes += child->size;
+        }
+        else if(child->type == FOLDERNODE)
+        {
+            string name = child->displayname();
+            string securename;
+            client->fsaccess->name2local(&name);
+            client->fsaccess->local2path(&name, &securename);
+
+            string childpath = paths[folder] + securename;
+            if(!snapshot(client, child, &childpath))
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
 }
 
-MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent, int fseventsfd)
+void MegaFolderDownload::run()
 {
-	init(api, appKey, NULL, basePath, userAgent, fseventsfd);
+    for(unsigned i = 0; i < folders.size(); i++)
+    {
+#ifndef _WIN32
+        if(mkdir(folders[i].c_str(), 0700) && errno != EEXIST)
+#else
+        string name = folders[i];
+        name.append("", 1);
+        if(!CreateDirectoryW((LPCWSTR)name.data(), NULL) && GetLastError() != ERROR_ALREADY_EXISTS)
+#endif
+        {
+            e = API_EWRITE;
+            return;
+        }
+    }
+
+    // the largest files first: they are the longest transfers, the small
+    // ones fill the remaining slots as they become available
+    std::stable_sort(files.begin(), files.end(), FolderFile::larger);
 }
 
-void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent, int fseventsfd)
+void MegaFolderDownload::feed(int maxRetries, vector<MegaTransferPrivate *> *transfers)
 {
-    this->api = api;
+    while(!cancelled && nextfile < files.size() && active.size() < MAXACTIVE)
+    {
+        FolderFile *f = &files[nextfile++];
 
-    sdkMutex.init(true);
-    maxRetries = 10;
-	currentTransfer = NULL;
-    pendingUploads = 0;
-    pendingDownloads = 0;
-    totalUploads = 0;
-    totalDownloads = 0;
-    client = NULL;
-    waiting = false;
-    waitingRequest = false;
-    totalDownloadedBytes = 0;
-    totalUploadedBytes = 0;
-    activeRequest = NULL;
-    activeTransfer = NULL;
-    activeError = NULL;
-    activeNodes = NULL;
-    activeUsers = NULL;
-    syncLowerSizeLimit = 0;
-    syncUpperSizeLimit = 0;
-    downloadSpeed = 0;
-    uploadSpeed = 0;
-    uploadPartialBytes = 0;
-    downloadPartialBytes = 0;
+        MegaTransferPrivate *t = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD);
+        t->setNodeHandle(f->h);
+        t->setParentPath(paths[f->folder].c_str());
+        t->setMaxRetries(maxRetries);
+        t->setFolderTransferTag(transfer->getTag());
 
-    httpio = new MegaHttpIO();
-    waiter = new MegaWaiter();
+        Active *a = &active[t];
+        a->bytes = 0;
+        a->size = f->size;
 
-#ifndef __APPLE__
-    (void)fseventsfd;
-    fsAccess = new MegaFileSystemAccess();
-#else
-    fsAccess = new MegaFileSystemAccess(fseventsfd);
-#endif
+        transfers->push_back(t);
+    }
+}
 
-	if (basePath)
-	{
-		string sBasePath = basePath;
-		int lastIndex = sBasePath.size() - 1;
-		if (sBasePath[lastIndex] != '/' && sBasePath[lastIndex] != '\\')
-		{
-			string utf8Separator;
-			fsAccess->local2path(&fsAccess->localseparator, &utf8Separator);
-			sBasePath.append(utf8Separator);
-		}
-		dbAccess = new MegaDbAccess(&sBasePath);
-	}
-	else dbAccess = NULL;
+void MegaFolderDownload::update(MegaTransferPrivate *subtransfer)
+{
+    map<MegaTransferPrivate *, Active>::iterator it = active.find(subtransfer);
+    if(it == active.end())
+    {
+        return;
+    }
+
+    long long delta = subtransfer->getTransferredBytes() - it->second.bytes;
+    activebytes += delta;
+    it->second.bytes = subtransfer->getTransferredBytes();
+
+    // the speed of the downloads is measured for all of them
+    transfer->setTransferredBytes(donebytes + activebytes);
+    transfer->setDeltaSize(delta);
+    transfer->setSpeed(subtransfer->getSpeed());
+    transfer->setUpdateTime(Waiter::ds);
+}
+
+bool MegaFolderDownload::finish(MegaTransferPrivate *subtransfer, error e)
+{
+    map<MegaTransferPrivate *, Active>::iterator it = active.find(subtransfer);
+    if(it != active.end())
+    {
+        long long bytes = it->second.bytes;
+        if(!e || e == API_EEXIST)
+        {
+            bytes = it->second.size;
+        }
+        else
+        {
+            // what wasn't downloaded won't be
+            transfer->setTotalBytes(transfer->getTotalBytes() - (it->second.size - bytes));
+        }
+
+        activebytes -= it->second.bytes;
+        donebytes += bytes;
+        transfer->setDeltaSize(bytes - it->second.bytes);
+        active.erase(it);
+
+        transfer->setTransferredBytes(donebytes + activebytes);
+        transfer->setUpdateTime(Waiter::ds);
+    }
+
+    // a file already being downloaded to the same path isn't a failure
+    if(e && e != API_EEXIST && !lasterror)
+    {
+        lasterror = e;
+    }
+
+    return active.empty() && (cancelled || nextfile == files.size());
+}
+
+MegaPwKeyJob::MegaPwKeyJob(int tag, const char *password, const char *newPassword)
+{
+    this->tag = tag;
+    this->password[0] = password;
+    count = 1;
+    e = API_OK;
+
+    if(newPassword)
+    {
+        this->password[1] = newPassword;
+        count = 2;
+    }
+}
+
+void MegaPwKeyJob::run()
+{
+    for(unsigned i = 0; i < count && !e; i++)
+    {
+        e = MegaClient::pw_key(password[i].c_str(), pwkey[i]);
+    }
+}
+
+MegaPathCache::MegaPathCache()
+{
+    mutex.init(false);
+}
+
+handle MegaPathCache::get(const string *key)
+{
+    handle h = UNDEF;
+
+    mutex.lock();
+    map<string, entry_list::iterator>::iterator it = index.find(*key);
+    if (it != index.end())
+    {
+        // most recently used first
+        entries.splice(entries.begin(), entries, it->second);
+        h = it->second->second;
+    }
+    mutex.unlock();
+
+    return h;
+}
+
+void MegaPathCache::put(const string *key, handle h)
+{
+    mutex.lock();
+    map<string, entry_list::iterator>::iterator it = index.find(*key);
+    if (it != index.end())
+    {
+        it->second->second = h;
+        entries.splice(entries.begin(), entries, it->second);
+    }
+    else
+    {
+        entries.push_front(pair<string, handle>(*key, h));
+        index[*key] = entries.begin();
+
+        if (index.size() > MAXENTRIES)
+        {
+            index.erase(entries.back().first);
+            entries.pop_back();
+        }
+    }
+    mutex.unlock();
+}
+
+void MegaPathCache::clear()
+{
+    mutex.lock();
+    index.clear();
+    entries.clear();
+    mutex.unlock();
+}
+
+MegaSearchJob::MegaSearchJob(MegaRequestPrivate *request)
+{
+    this->request = request;
+    filter = request->getSearchFilter();
+    limit = request->getNumber() > 0 ? request->getNumber() : 0;
+    next = 0;
+    found = 0;
+    cancelled = false;
+}
+
+bool MegaSearchJob::processNode(Node *node)
+{
+    if (matches(node))
+    {
+        candidates.push_back(node->nodehandle);
+    }
+
+    return true;
+}
+
+bool MegaSearchJob::matches(Node *node) const
+{
+    if (!filter)
+    {
+        return true;
+    }
+
+    if (filter->getNodeType() >= 0 && node->type != filter->getNodeType())
+    {
+        return false;
+    }
+
+    if ((filter->getMinSize() >= 0 || filter->getMaxSize() >= 0
+         || filter->getMinModificationTime() >= 0 || filter->getMaxModificationTime() >= 0)
+            && node->type != FILENODE)
+    {
+        return false;
+    }
+
+    if ((filter->getMinSize() >= 0 && node->size < filter->getMinSize())
+            || (filter->getMaxSize() >= 0 && node->size > filter->getMaxSize())
+            || (filter->getMinModificationTime() >= 0 && node->mtime < filter->getMinModificationTime())
+            || (filter->getMaxModificationTime() >= 0 && node->mtime > filter->getMaxModificationTime()))
+    {
+        return false;
+    }
+
+    const char *extension = filter->getExtension();
+    if (extension)
+    {
+        const char *name = node->displayname();
+        size_t namelen = strlen(name);
+        size_t extlen = strlen(extension);
+
+        if (namelen <= extlen || name[namelen - extlen - 1] != '.'
+                || strcasecmp(name + namelen - extlen, extension))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+MegaUploadFingerprintJob::~MegaUploadFingerprintJob()
+{
+    delete fa;
+}
+
+void MegaUploadFingerprintJob::run()
+{
+    if (fa->fopen(&localname, true, false) && fa->type == FILENODE)
+    {
+        fingerprint.genfingerprint(fa);
+
+        // the node will carry the custom mtime
+        if (transfer->getTime() >= 0)
+        {
+            fingerprint.mtime = transfer->getTime();
+        }
+    }
+
+    delete fa;
+    fa = NULL;
+}
+
+//Entry point for the blocking thread
+void *MegaApiImpl::threadEntryPoint(void *param)
+{
+#ifndef _WIN32
+    struct sigaction noaction;
+    memset(&noaction, 0, sizeof(noaction));
+    noaction.sa_handler = SIG_IGN;
+    ::sigaction(SIGPIPE, &noaction, 0);
+#endif
+
+    MegaApiImpl *megaApiImpl = (MegaApiImpl *)param;
+    megaApiImpl->loop();
+	return 0;
+}
+
+ExternalLogger *MegaApiImpl::externalLogger = NULL;
+
+MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent)
+{
+	init(api, appKey, processor, basePath, userAgent);
+}
+
+MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent)
+{
+	init(api, appKey, NULL, basePath, userAgent);
+}
+
+MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent, int fseventsfd)
+{
+	init(api, appKey, NULL, basePath, userAgent, fseventsfd);
+}
+
+void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent, int fseventsfd)
+{
+    this->api = api;
+    sortMutex.init(false);
+
+    networkMutex.init(true);
+    networkThreadRequest = -1;
+    networkThreadRunning = false;
+
+    prefetchMutex.init(false);
+    thumbnailPrefetchBudget = 0;
+
+#ifndef WINDOWS_PHONE
+    httpServerMutex.init(false);
+    httpServer = NULL;
+    peerCache = NULL;
+#endif
+
+    deltaMutex.init(false);
+    deltasEnabled = false;
+#ifdef ENABLE_SYNC
+    pathStateMutex.init(false);
+#endif
+    callbackDispatcher = NULL;
+    deltaWindow = 2;
+    deltaLimit = 100000;
+    deltaReload = false;
+    deltaSince = NEVER;
+    deltaAnnounced = false;
+
+    maxRetries = 10;
+	currentTransfer = NULL;
+    pendingUploads = 0;
+    pendingDownloads = 0;
+    totalUploads = 0;
+    totalDownloads = 0;
+    client = NULL;
+    waiting = false;
+    waitingRequest = false;
+    totalDownloadedBytes = 0;
+    totalUploadedBytes = 0;
+    activeRequest = NULL;
+    activeTransfer = NULL;
+    activeError = NULL;
+    activeNodes = NULL;
+    activeUsers = NULL;
+    syncLowerSizeLimit = 0;
+    syncUpperSizeLimit = 0;
+    downloadSpeed = 0;
+    uploadSpeed = 0;
+    uploadPartialBytes = 0;
+    downloadPartialBytes = 0;
+
+    httpio = new MegaHttpIO();
+    waiter = new MegaWaiter();
+
+    sharedRuntime = MegaSharedRuntime::acquire();
+#ifdef MEGA_CURL_HTTPIO
+    if (sharedRuntime)
+    {
+        httpio->setshare(sharedRuntime->curlsh);
+    }
+#endif
+
+#ifndef __APPLE__
+    (void)fseventsfd;
+    fsAccess = new MegaFileSystemAccess();
+#else
+    fsAccess = new MegaFileSystemAccess(fseventsfd);
+#endif
+
+	if (basePath)
+	{
+		string sBasePath = basePath;
+		int lastIndex = sBasePath.size() - 1;
+		if (sBasePath[lastIndex] != '/' && sBasePath[lastIndex] != '\\')
+		{
+			string utf8Separator;
+			fsAccess->local2path(&fsAccess->localseparator, &utf8Separator);
+			sBasePath.append(utf8Separator);
+		}
+		dbAccess = new MegaDbAccess(&sBasePath);
+	}
+	else dbAccess = NULL;
 
 	gfxAccess = NULL;
 	if(processor)
@@ -2126,6 +3317,22 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
 
     client = new MegaClient(this, waiter, httpio, fsAccess, dbAccess, gfxAccess, appKey, userAgent);
 
+    if (sharedRuntime)
+    {
+        workerPool = new MegaWorkerPool(waiter, sharedRuntime->workers);
+        gfxWorkerPool = new MegaWorkerPool(waiter, sharedRuntime->gfxWorkers);
+    }
+    else
+    {
+        workerPool = new MegaWorkerPool(waiter);
+        gfxWorkerPool = new MegaWorkerPool(waiter, MegaWorkerPool::GFXTHREADS);
+    }
+    client->workerpool = workerPool;
+
+    gfxAccess->mutex = gfxWorkerPool->newmutex();
+    client->gfxpool = gfxWorkerPool;
+    uploadCopies = false;
+
 #if defined(_WIN32) && !defined(WINDOWS_PHONE)
     httpio->unlock();
 #endif
@@ -2137,52 +3344,96 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
 
 MegaApiImpl::~MegaApiImpl()
 {
+    // (its transfers end while the SDK thread still runs)
+    httpServerStop();
+    peerCacheStop();
+
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_DELETE);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
     thread.join();
+
+    // (delivers the callbacks still queued)
+    delete callbackDispatcher;
 }
 
-int MegaApiImpl::isLoggedIn()
+bool MegaApiImpl::lockQuery()
 {
+    sdkMutex.lockShared();
+
+    // (the count only grows under the exclusive lock)
+    if (!client->pendingattrnodes)
+    {
+        return true;
+    }
+
+    sdkMutex.unlockShared();
     sdkMutex.lock();
+
+    return false;
+}
+
+void MegaApiImpl::unlockQuery(bool shared)
+{
+    if (shared)
+    {
+        sdkMutex.unlockShared();
+    }
+    else
+    {
+        sdkMutex.unlock();
+    }
+}
+
+int MegaApiImpl::isLoggedIn()
+{
+    bool shared = lockQuery();
     int result = client->loggedin();
-    sdkMutex.unlock();
+    unlockQuery(shared);
 	return result;
 }
 
 char* MegaApiImpl::getMyEmail()
 {
 	User* u;
-    sdkMutex.lock();
+    bool shared = lockQuery();
 	if (!client->loggedin() || !(u = client->finduser(client->me)))
 	{
-		sdkMutex.unlock();
+		unlockQuery(shared);
 		return NULL;
 	}
 
     char *result = MegaApi::strdup(u->email.c_str());
-    sdkMutex.unlock();
+    unlockQuery(shared);
     return result;
 }
 
 char *MegaApiImpl::getMyUserHandle()
 {
     User* u;
-    sdkMutex.lock();
+    bool shared = lockQuery();
     if (!client->loggedin() || !(u = client->finduser(client->me)))
     {
-        sdkMutex.unlock();
+        unlockQuery(shared);
         return NULL;
     }
 
     char buf[12];
     Base64::btoa((const byte*)&client->me, MegaClient::USERHANDLE, buf);
     char *result = MegaApi::strdup(buf);
-    sdkMutex.unlock();
+    unlockQuery(shared);
     return result;
 }
 
+void MegaApiImpl::setSharedRuntime(bool enable)
+{
+    MegaSharedRuntime::setEnabled(enable);
+}
+
+void MegaApiImpl::enableNameInterning(bool enable)
+{
+    MegaNodeNames::setEnabled(enable);
+}
+
 void MegaApiImpl::setLogLevel(int logLevel)
 {
     if(!externalLogger)
@@ -2201,7 +3452,16 @@ void MegaApiImpl::setLoggerClass(MegaLogger *megaLogger)
     externalLogger->setMegaLogger(megaLogger);
 }
 
-void MegaApiImpl::log(int logLevel, const char *message, const char *filename, int line)
+void MegaApiImpl::setAsyncLogging(bool enable)
+{
+    if(!externalLogger)
+    {
+        externalLogger = new ExternalLogger();
+    }
+    externalLogger->setAsync(enable);
+}
+
+void MegaApiImpl::log(int logLevel, const char *message, const char *filename, int line)
 {
     if(!externalLogger)
     {
@@ -2225,6 +3485,13 @@ char* MegaApiImpl::getBase64PwKey(const char *password)
 	return buf;
 }
 
+void MegaApiImpl::getBase64PwKey(const char *password, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PW_KEY, listener);
+    request->setPassword(password);
+    if(requestQueue.push(request)) waiter->notify();
+}
+
 char* MegaApiImpl::getStringHash(const char* base64pwkey, const char* inBuf)
 {
 	if(!base64pwkey || !inBuf) return NULL;
@@ -2250,8 +3517,7 @@ void MegaApiImpl::getSessionTransferURL(const char *path, MegaRequestListener *l
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_SESSION_TRANSFER_URL);
     request->setText(path);
     request->setListener(listener);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 MegaHandle MegaApiImpl::base32ToHandle(const char *base32Handle)
@@ -2311,8 +3577,7 @@ void MegaApiImpl::retryPendingConnections(bool disconnect, bool includexfers, Me
 	request->setFlag(disconnect);
 	request->setNumber(includexfers);
 	request->setListener(listener);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::addEntropy(char *data, unsigned int size)
@@ -2336,31 +3601,27 @@ void MegaApiImpl::fastLogin(const char* email, const char *stringHash, const cha
 	request->setEmail(email);
 	request->setPassword(stringHash);
 	request->setPrivateKey(base64pwkey);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::fastLogin(const char *session, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
     request->setSessionKey(session);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::killSession(MegaHandle sessionHandle, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_KILL_SESSION, listener);
     request->setNodeHandle(sessionHandle);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getUserData(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getUserData(MegaUser *user, MegaRequestListener *listener)
@@ -2372,8 +3633,7 @@ void MegaApiImpl::getUserData(MegaUser *user, MegaRequestListener *listener)
         request->setEmail(user->getEmail());
     }
 
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getUserData(const char *user, MegaRequestListener *listener)
@@ -2381,8 +3641,7 @@ void MegaApiImpl::getUserData(const char *user, MegaRequestListener *listener)
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
     request->setFlag(true);
     request->setEmail(user);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::login(const char *login, const char *password, MegaRequestListener *listener)
@@ -2390,8 +3649,7 @@ void MegaApiImpl::login(const char *login, const char *password, MegaRequestList
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
 	request->setEmail(login);
 	request->setPassword(password);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 char *MegaApiImpl::dumpSession()
@@ -2432,8 +3690,7 @@ void MegaApiImpl::createAccount(const char* email, const char* password, const c
 	request->setEmail(email);
 	request->setPassword(password);
 	request->setName(name);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::fastCreateAccount(const char* email, const char *base64pwkey, const char* name, MegaRequestListener *listener)
@@ -2442,16 +3699,14 @@ void MegaApiImpl::fastCreateAccount(const char* email, const char *base64pwkey,
 	request->setEmail(email);
 	request->setPrivateKey(base64pwkey);
 	request->setName(name);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::querySignupLink(const char* link, MegaRequestListener *listener)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_QUERY_SIGNUP_LINK, listener);
 	request->setLink(link);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::confirmAccount(const char* link, const char *password, MegaRequestListener *listener)
@@ -2459,8 +3714,7 @@ void MegaApiImpl::confirmAccount(const char* link, const char *password, MegaReq
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CONFIRM_ACCOUNT, listener);
 	request->setLink(link);
 	request->setPassword(password);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::fastConfirmAccount(const char* link, const char *base64pwkey, MegaRequestListener *listener)
@@ -2468,8 +3722,7 @@ void MegaApiImpl::fastConfirmAccount(const char* link, const char *base64pwkey,
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CONFIRM_ACCOUNT, listener);
 	request->setLink(link);
 	request->setPrivateKey(base64pwkey);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::setProxySettings(MegaProxy *proxySettings)
@@ -2529,6 +3782,108 @@ MegaProxy *MegaApiImpl::getAutoProxySettings()
     return proxySettings;
 }
 
+bool MegaApiImpl::setHttpMultiplexing(bool enable)
+{
+    sdkMutex.lock();
+    bool result = httpio->setmultiplexing(enable);
+    sdkMutex.unlock();
+    return result;
+}
+
+void MegaApiImpl::setNetworkThread(bool enable)
+{
+    sdkMutex.lock();
+    networkThreadRequest = enable;
+    sdkMutex.unlock();
+
+    waiter->notify();
+}
+
+// runs on the SDK thread outside of client->wait(), which must not race
+// with the handover of the sockets
+void MegaApiImpl::applyNetworkThread()
+{
+    bool enable = networkThreadRequest > 0;
+
+    networkThreadRequest = -1;
+
+    if (enable == networkThreadRunning)
+    {
+        return;
+    }
+
+    if (enable)
+    {
+        networkThreadRunning = httpio->startiothread(&networkThread, &networkMutex);
+
+        if (!networkThreadRunning)
+        {
+            LOG_warn << "The network layer does not support a dedicated thread";
+        }
+    }
+    else
+    {
+        httpio->stopiothread();
+        networkThreadRunning = false;
+    }
+}
+
+void MegaApiImpl::enableTlsSessionCache(bool enable)
+{
+    sdkMutex.lock();
+    client->persisttls = enable;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::enablePersistentTransferQueue(bool enable)
+{
+    sdkMutex.lock();
+    client->persistqueue = enable;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::enableLazyNodeAttributes(bool enable)
+{
+    sdkMutex.lock();
+    client->lazyattrs = enable;
+
+    if (!enable)
+    {
+        client->resolveattrs();
+    }
+    sdkMutex.unlock();
+}
+
+#ifdef ENABLE_SYNC
+void MegaApiImpl::setSyncScanParallelism(unsigned int folders)
+{
+    sdkMutex.lock();
+    client->syncscanahead = folders;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setSyncVerificationInterval(unsigned int seconds)
+{
+    sdkMutex.lock();
+    client->syncverifyinterval = seconds * 10;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setSyncSkipUnchangedFolders(bool enable)
+{
+    sdkMutex.lock();
+    client->syncskipunchanged = enable;
+    sdkMutex.unlock();
+}
+#endif
+
+void MegaApiImpl::setApiRequestCompression(unsigned int threshold)
+{
+    sdkMutex.lock();
+    httpio->compressthreshold = threshold;
+    sdkMutex.unlock();
+}
+
 void MegaApiImpl::loop()
 {
 #if (WINDOWS_PHONE || TARGET_OS_IPHONE)
@@ -2580,18 +3935,106 @@ void MegaApiImpl::loop()
         if(r & Waiter::NEEDEXEC)
         {
             sendPendingTransfers();
+            if(fingerprintJobs.size())
+            {
+                processFingerprintedUploads();
+            }
+            if(removeJobs.size())
+            {
+                processRemoveJobs();
+            }
+            if(pwKeyJobs.size())
+            {
+                processPwKeyJobs();
+            }
+            if(searchJobs.size())
+            {
+                processSearchJobs();
+            }
+            if(folderDownloads.size())
+            {
+                processFolderDownloads();
+            }
             sendPendingRequests();
             if(threadExit)
                 break;
 
             sdkMutex.lock();
+            if (networkThreadRequest >= 0)
+            {
+                applyNetworkThread();
+            }
+
+            handle_vector prefetches;
+            prefetchMutex.lock();
+            prefetches.swap(thumbnailPrefetches);
+            prefetchMutex.unlock();
+            if (prefetches.size())
+            {
+                client->prefetchthumbnails(&prefetches);
+            }
+
             client->exec();
+            announceNodeDeltas();
             sdkMutex.unlock();
         }
 	}
 
     sdkMutex.lock();
+
+    if (networkThreadRunning)
+    {
+        httpio->stopiothread();
+        networkThreadRunning = false;
+    }
+
+    while(fingerprintJobs.size())
+    {
+        workerPool->waitfor(fingerprintJobs.front());
+        delete fingerprintJobs.front()->transfer;
+        delete fingerprintJobs.front();
+        fingerprintJobs.pop_front();
+    }
+
+    while(removeJobs.size())
+    {
+        removeJobs.front()->progress.cancelled = true;
+        workerPool->waitfor(removeJobs.front());
+        delete removeJobs.front();
+        removeJobs.pop_front();
+    }
+
+    while(pwKeyJobs.size())
+    {
+        workerPool->waitfor(pwKeyJobs.front());
+        delete pwKeyJobs.front();
+        pwKeyJobs.pop_front();
+    }
+
+    while(searchJobs.size())
+    {
+        delete searchJobs.front();
+        searchJobs.pop_front();
+    }
+
+    for(map<int, MegaFolderDownload *>::iterator it = folderDownloads.begin(); it != folderDownloads.end(); it++)
+    {
+        if(!it->second->started)
+        {
+            workerPool->waitfor(it->second);
+        }
+        delete it->second;
+    }
+    folderDownloads.clear();
+
     delete client;
+    delete workerPool;
+    delete gfxWorkerPool;
+
+    if (sharedRuntime)
+    {
+        sharedRuntime->release();
+    }
 
 	//It doesn't seem fully safe to delete those objects :-/
     // delete httpio;
@@ -2606,8 +4049,7 @@ void MegaApiImpl::createFolder(const char *name, MegaNode *parent, MegaRequestLi
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_FOLDER, listener);
     if(parent) request->setParentHandle(parent->getHandle());
 	request->setName(name);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::moveNode(MegaNode *node, MegaNode *newParent, MegaRequestListener *listener)
@@ -2615,8 +4057,7 @@ void MegaApiImpl::moveNode(MegaNode *node, MegaNode *newParent, MegaRequestListe
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE, listener);
     if(node) request->setNodeHandle(node->getHandle());
     if(newParent) request->setParentHandle(newParent->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener *listener)
@@ -2634,8 +4075,7 @@ void MegaApiImpl::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener
         }
     }
     if(target) request->setParentHandle(target->getHandle());
-	requestQueue.push(request);
-	waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::copyNode(MegaNode *node, MegaNode *target, const char *newName, MegaRequestListener *listener)
@@ -2654,8 +4094,7 @@ void MegaApiImpl::copyNode(MegaNode *node, MegaNode *target, const char *newName
     }
     if(target) request->setParentHandle(target->getHandle());
     request->setName(newName);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::renameNode(MegaNode *node, const char *newName, MegaRequestListener *listener)
@@ -2663,23 +4102,20 @@ void MegaApiImpl::renameNode(MegaNode *node, const char *newName, MegaRequestLis
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_RENAME, listener);
     if(node) request->setNodeHandle(node->getHandle());
 	request->setName(newName);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::remove(MegaNode *node, MegaRequestListener *listener)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE, listener);
     if(node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::cleanRubbishBin(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CLEAN_RUBBISH_BIN, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::sendFileToUser(MegaNode *node, MegaUser *user, MegaRequestListener *listener)
@@ -2692,8 +4128,7 @@ void MegaApiImpl::sendFileToUser(MegaNode *node, const char* email, MegaRequestL
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
     if(node) request->setNodeHandle(node->getHandle());
     request->setEmail(email);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::share(MegaNode* node, MegaUser *user, int access, MegaRequestListener *listener)
@@ -2707,8 +4142,7 @@ void MegaApiImpl::share(MegaNode *node, const char* email, int access, MegaReque
     if(node) request->setNodeHandle(node->getHandle());
 	request->setEmail(email);
 	request->setAccess(access);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::loginToFolder(const char* megaFolderLink, MegaRequestListener *listener)
@@ -2716,8 +4150,7 @@ void MegaApiImpl::loginToFolder(const char* megaFolderLink, MegaRequestListener
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
 	request->setLink(megaFolderLink);
     request->setEmail("FOLDER");
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::importFileLink(const char* megaFileLink, MegaNode *parent, MegaRequestListener *listener)
@@ -2725,16 +4158,14 @@ void MegaApiImpl::importFileLink(const char* megaFileLink, MegaNode *parent, Meg
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_IMPORT_LINK, listener);
 	if(parent) request->setParentHandle(parent->getHandle());
 	request->setLink(megaFileLink);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getPublicNode(const char* megaFileLink, MegaRequestListener *listener)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PUBLIC_NODE, listener);
 	request->setLink(megaFileLink);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
@@ -2742,6 +4173,11 @@ void MegaApiImpl::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequ
 	getNodeAttribute(node, 0, dstFilePath, listener);
 }
 
+void MegaApiImpl::prefetchThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
+{
+    getNodeAttribute(node, 0, dstFilePath, listener, true);
+}
+
 void MegaApiImpl::cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener)
 {
 	cancelGetNodeAttribute(node, 0, listener);
@@ -2757,6 +4193,11 @@ void MegaApiImpl::getPreview(MegaNode* node, const char *dstFilePath, MegaReques
 	getNodeAttribute(node, 1, dstFilePath, listener);
 }
 
+void MegaApiImpl::prefetchPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
+{
+    getNodeAttribute(node, 1, dstFilePath, listener, true);
+}
+
 void MegaApiImpl::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
 {
 	cancelGetNodeAttribute(node, 1, listener);
@@ -2792,8 +4233,7 @@ void MegaApiImpl::exportNode(MegaNode *node, MegaRequestListener *listener)
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT, listener);
     if(node) request->setNodeHandle(node->getHandle());
     request->setAccess(1);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::disableExport(MegaNode *node, MegaRequestListener *listener)
@@ -2801,30 +4241,58 @@ void MegaApiImpl::disableExport(MegaNode *node, MegaRequestListener *listener)
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT, listener);
     if(node) request->setNodeHandle(node->getHandle());
     request->setAccess(0);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
+}
+
+void MegaApiImpl::exportNodes(MegaNodeList *nodes, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT_NODES, listener);
+    if(nodes) request->setMegaNodeList(nodes->copy());
+    request->setAccess(1);
+    if(requestQueue.push(request)) waiter->notify();
+}
+
+void MegaApiImpl::setNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_NODES_ATTRIBUTE, listener);
+    if(nodes) request->setMegaNodeList(nodes->copy());
+    request->setName(attrName);
+    request->setText(value);
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::fetchNodes(MegaRequestListener *listener)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES, listener);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
+}
+
+void MegaApiImpl::fetchFolder(MegaNode *node, bool recursive, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_FOLDER, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    request->setFlag(recursive);
+    if(requestQueue.push(request)) waiter->notify();
+}
+
+void MegaApiImpl::setPartialFolderFetch(bool enable)
+{
+    sdkMutex.lock();
+    client->partialfetch = enable;
+    sdkMutex.unlock();
 }
 
 void MegaApiImpl::getPricing(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PRICING, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getPaymentId(handle productHandle, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PAYMENT_ID, listener);
     request->setNodeHandle(productHandle);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::upgradeAccount(MegaHandle productHandle, int paymentMethod, MegaRequestListener *listener)
@@ -2832,8 +4300,7 @@ void MegaApiImpl::upgradeAccount(MegaHandle productHandle, int paymentMethod, Me
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_UPGRADE_ACCOUNT, listener);
     request->setNodeHandle(productHandle);
     request->setNumber(paymentMethod);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::submitPurchaseReceipt(int gateway, const char *receipt, MegaRequestListener *listener)
@@ -2841,8 +4308,7 @@ void MegaApiImpl::submitPurchaseReceipt(int gateway, const char *receipt, MegaRe
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT, listener);
     request->setNumber(gateway);
     request->setText(receipt);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::creditCardStore(const char* address1, const char* address2, const char* city,
@@ -2949,30 +4415,26 @@ void MegaApiImpl::creditCardStore(const char* address1, const char* address2, co
         delete ccplain;
     }
 
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::creditCardQuerySubscriptions(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::creditCardCancelSubscriptions(const char* reason, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS, listener);
     request->setText(reason);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getPaymentMethods(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PAYMENT_METHODS, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 char *MegaApiImpl::exportMasterKey()
@@ -3002,8 +4464,7 @@ void MegaApiImpl::getAccountDetails(bool storage, bool transfer, bool pro, bool
 	if(sessions) numDetails |= 0x20;
 	request->setNumDetails(numDetails);
 
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::changePassword(const char *oldPassword, const char *newPassword, MegaRequestListener *listener)
@@ -3011,24 +4472,21 @@ void MegaApiImpl::changePassword(const char *oldPassword, const char *newPasswor
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CHANGE_PW, listener);
 	request->setPassword(oldPassword);
 	request->setNewPassword(newPassword);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::logout(MegaRequestListener *listener)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT, listener);
     request->setFlag(true);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::localLogout(MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT, listener);
     request->setFlag(false);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::submitFeedback(int rating, const char *comment, MegaRequestListener *listener)
@@ -3036,16 +4494,14 @@ void MegaApiImpl::submitFeedback(int rating, const char *comment, MegaRequestLis
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SUBMIT_FEEDBACK, listener);
     request->setText(comment);
     request->setNumber(rating);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::reportEvent(const char *details, MegaRequestListener *listener)
 {
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REPORT_EVENT, listener);
     request->setText(details);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::sendEvent(int eventType, const char *message, MegaRequestListener *listener)
@@ -3053,11 +4509,10 @@ void MegaApiImpl::sendEvent(int eventType, const char *message, MegaRequestListe
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SEND_EVENT, listener);
     request->setNumber(eventType);
     request->setText(message);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
-void MegaApiImpl::getNodeAttribute(MegaNode *node, int type, const char *dstFilePath, MegaRequestListener *listener)
+void MegaApiImpl::getNodeAttribute(MegaNode *node, int type, const char *dstFilePath, MegaRequestListener *listener, bool prefetch)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_ATTR_FILE, listener);
     if(dstFilePath)
@@ -3082,9 +4537,9 @@ void MegaApiImpl::getNodeAttribute(MegaNode *node, int type, const char *dstFile
     }
 
     request->setParamType(type);
+    request->setFlag(prefetch);
     if(node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener)
@@ -3092,8 +4547,7 @@ void MegaApiImpl::cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestLi
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_ATTR_FILE, listener);
 	request->setParamType(type);
 	if (node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-	waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::setNodeAttribute(MegaNode *node, int type, const char *srcFilePath, MegaRequestListener *listener)
@@ -3102,8 +4556,7 @@ void MegaApiImpl::setNodeAttribute(MegaNode *node, int type, const char *srcFile
 	request->setFile(srcFilePath);
     request->setParamType(type);
     if(node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::getUserAttr(MegaUser *user, int type, const char *dstFilePath, MegaRequestListener *listener)
@@ -3135,8 +4588,7 @@ void MegaApiImpl::getUserAttr(MegaUser *user, int type, const char *dstFilePath,
     {
         request->setEmail(user->getEmail());
     }
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::setUserAttr(int type, const char *srcFilePath, MegaRequestListener *listener)
@@ -3152,16 +4604,14 @@ void MegaApiImpl::setUserAttr(int type, const char *srcFilePath, MegaRequestList
     }
 
     request->setParamType(type);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::addContact(const char* email, MegaRequestListener* listener)
 {
 	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_CONTACT, listener);
 	request->setEmail(email);
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::inviteContact(const char *email, const char *message,int action, MegaRequestListener *listener)
@@ -3170,8 +4620,7 @@ void MegaApiImpl::inviteContact(const char *email, const char *message,int actio
     request->setNumber(action);
     request->setEmail(email);
     request->setText(message);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::replyContactRequest(MegaContactRequest *r, int action, MegaRequestListener *listener)
@@ -3183,8 +4632,7 @@ void MegaApiImpl::replyContactRequest(MegaContactRequest *r, int action, MegaReq
     }
 
     request->setNumber(action);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::removeContact(MegaUser *user, MegaRequestListener* listener)
@@ -3195,8 +4643,7 @@ void MegaApiImpl::removeContact(MegaUser *user, MegaRequestListener* listener)
         request->setEmail(user->getEmail());
     }
 
-	requestQueue.push(request);
-    waiter->notify();
+	if(requestQueue.push(request)) waiter->notify();
 }
 
 void MegaApiImpl::pauseTransfers(bool pause, int direction, MegaRequestListener* listener)
@@ -3204,8 +4651,7 @@ void MegaApiImpl::pauseTransfers(bool pause, int direction, MegaRequestListener*
     MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_PAUSE_TRANSFERS, listener);
     request->setFlag(pause);
     request->setNumber(direction);
-    requestQueue.push(request);
-    waiter->notify();
+    if(requestQueue.push(request)) waiter->notify();
 }
 
 bool MegaApiImpl::areTransfersPaused(int direction)
@@ -3303,6683 +4749,11223 @@ int MegaApiImpl::getUploadMethod()
     return MegaApi::TRANSFER_METHOD_NORMAL;
 }
 
-MegaTransferList *MegaApiImpl::getTransfers()
+void MegaApiImpl::setConnectionLimits(int direction, int minConnections, int maxConnections)
 {
-    sdkMutex.lock();
-
-    vector<MegaTransfer *> transfers;
-    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
     {
-        for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
-        {
-            Transfer *t = it->second;
-            if(transferMap.find(t->tag) == transferMap.end())
-            {
-                continue;
-            }
-            MegaTransferPrivate* transfer = transferMap.at(t->tag);
-            transfers.push_back(transfer);
-        }
+        return;
     }
 
-    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
-
+    sdkMutex.lock();
+    client->setconnectionlimits((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT,
+                                minConnections, maxConnections);
     sdkMutex.unlock();
-    return result;
 }
 
-MegaTransfer *MegaApiImpl::getTransferByTag(int transferTag)
+void MegaApiImpl::setMaxRequestSize(int direction, long long maxSize)
 {
-    MegaTransfer* value = NULL;
-    sdkMutex.lock();
-
-    if(transferMap.find(transferTag) == transferMap.end())
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
     {
-        sdkMutex.unlock();
-        return NULL;
+        return;
     }
 
-    value = transferMap.at(transferTag)->copy();
-    sdkMutex.unlock();
-    return value;
-}
-
-MegaTransferList *MegaApiImpl::getTransfers(int type)
-{
-    if(type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD)
+    if(maxSize < 0)
     {
-        return new MegaTransferListPrivate();
+        maxSize = 0;
     }
-
-    sdkMutex.lock();
-
-    vector<MegaTransfer *> transfers;
-    for (transfer_map::iterator it = client->transfers[type].begin(); it != client->transfers[type].end(); it++)
+    else if(maxSize > MegaClient::MAXREQUESTSIZE)
     {
-        Transfer *t = it->second;
-        if(transferMap.find(t->tag) == transferMap.end())
-        {
-            continue;
-        }
-        MegaTransferPrivate* transfer = transferMap.at(t->tag);
-        transfers.push_back(transfer);
+        maxSize = MegaClient::MAXREQUESTSIZE;
     }
 
-    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+    sdkMutex.lock();
+    client->maxrequestsize[(direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT] = maxSize;
+    sdkMutex.unlock();
+}
 
+void MegaApiImpl::setTransferBufferPoolLimit(long long limit)
+{
+    sdkMutex.lock();
+    client->bufferpool.setlimit(limit);
     sdkMutex.unlock();
-    return result;
 }
 
-void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener)
+void MegaApiImpl::setInflightMemoryBudget(long long bytes)
 {
-    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, listener);
-    if(localPath)
-    {
-        string path(localPath);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-        transfer->setPath(path.data());
-    }
-    if(parent) transfer->setParentHandle(parent->getHandle());
-	transfer->setMaxRetries(maxRetries);
-	if(fileName) transfer->setFileName(fileName);
-    transfer->setTime(mtime);
+    sdkMutex.lock();
+    client->inflight.limit = bytes > 0 ? bytes : 0;
+    sdkMutex.unlock();
 
-	transferQueue.push(transfer);
+    // held back requests may start now
     waiter->notify();
 }
 
-void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, MegaTransferListener *listener)
-{ return startUpload(localPath, parent, (const char *)NULL, -1, listener); }
+void MegaApiImpl::setNetworkInterfaces(const char *interfaces)
+{
+    sdkMutex.lock();
+    client->setnetifs(interfaces);
+    sdkMutex.unlock();
+}
 
-void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, int64_t mtime, MegaTransferListener *listener)
-{ return startUpload(localPath, parent, (const char *)NULL, mtime, listener); }
+void MegaApiImpl::setThumbnailCacheLimit(long long limit)
+{
+    sdkMutex.lock();
+    client->gfxcache.setlimit(limit);
+    sdkMutex.unlock();
+}
 
-void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener)
-{ return startUpload(localPath, parent, fileName, -1, listener); }
+void MegaApiImpl::setThumbnailMemoryCacheLimit(long long limit)
+{
+    sdkMutex.lock();
+    client->gfxcache.setmemlimit(limit);
+    sdkMutex.unlock();
+}
 
-void MegaApiImpl::startDownload(MegaNode *node, const char* localPath, long startPos, long endPos, MegaTransferListener *listener)
+void MegaApiImpl::setThumbnailPrefetch(int budget)
 {
-	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
+    prefetchMutex.lock();
+    thumbnailPrefetchBudget = budget < 0 ? 0 : budget;
+    prefetchMutex.unlock();
+}
 
-    if(localPath)
-    {
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        string path(localPath);
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-        localPath = path.data();
-#endif
+void MegaApiImpl::queueThumbnailPrefetch(MegaNodeList *children)
+{
+    prefetchMutex.lock();
 
-        int c = localPath[strlen(localPath)-1];
-        if((c=='/') || (c == '\\')) transfer->setParentPath(localPath);
-        else transfer->setPath(localPath);
+    int queued = 0;
+    for (int i = 0; i < children->size() && queued < thumbnailPrefetchBudget; i++)
+    {
+        MegaNode *node = children->get(i);
+        if (node->hasThumbnail())
+        {
+            thumbnailPrefetches.push_back(node->getHandle());
+            queued++;
+        }
     }
 
-    if(node)
+    prefetchMutex.unlock();
+
+    if (queued)
     {
-        transfer->setNodeHandle(node->getHandle());
-        if(node->isPublic())
-            transfer->setPublicNode(node);
+        waiter->notify();
     }
-	transfer->setStartPos(startPos);
-	transfer->setEndPos(endPos);
-	transfer->setMaxRetries(maxRetries);
-
-	transferQueue.push(transfer);
-	waiter->notify();
 }
 
-void MegaApiImpl::startDownload(MegaNode *node, const char* localFolder, MegaTransferListener *listener)
-{ startDownload(node, localFolder, 0, 0, listener); }
-
-void MegaApiImpl::cancelTransfer(MegaTransfer *t, MegaRequestListener *listener)
+void MegaApiImpl::setImageDecodeLimit(long long limit)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
-    if(t)
+    if (!gfxAccess)
     {
-        request->setTransferTag(t->getTag());
+        return;
     }
-    requestQueue.push(request);
-    waiter->notify();
+
+    // read by the gfx worker under the same mutex
+    gfxAccess->mutex->lock();
+    gfxAccess->decodelimit = limit < 0 ? 0 : limit;
+    gfxAccess->mutex->unlock();
 }
 
-void MegaApiImpl::cancelTransferByTag(int transferTag, MegaRequestListener *listener)
+void MegaApiImpl::setDownloadWriteMode(bool preallocate, bool directIO)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
-    request->setTransferTag(transferTag);
-    requestQueue.push(request);
-    waiter->notify();
+    sdkMutex.lock();
+    client->dlpreallocate = preallocate;
+    client->dldirectio = directIO;
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::cancelTransfers(int direction, MegaRequestListener *listener)
+void MegaApiImpl::enableUploadCopies(bool enable)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFERS, listener);
-    request->setParamType(direction);
-    requestQueue.push(request);
-    waiter->notify();
+    sdkMutex.lock();
+    uploadCopies = enable;
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener)
+void MegaApiImpl::setBandwidthLimit(int direction, long long bytesPerSecond, long long burstBytes)
 {
-	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
-	if(node && !node->isPublic())
-	{
-		transfer->setNodeHandle(node->getHandle());
-	}
-	else
-	{
-		transfer->setPublicNode(node);
-	}
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+    {
+        return;
+    }
 
-	transfer->setStartPos(startPos);
-	transfer->setEndPos(startPos + size - 1);
-	transfer->setMaxRetries(maxRetries);
-	transferQueue.push(transfer);
-	waiter->notify();
+    sdkMutex.lock();
+    client->bandwidth.setlimit((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT,
+                               bytesPerSecond, burstBytes);
+    sdkMutex.unlock();
 }
 
-#ifdef ENABLE_SYNC
-
-//Move local files inside synced folders to the "Rubbish" folder.
-bool MegaApiImpl::moveToLocalDebris(const char *path)
+void MegaApiImpl::setTransferBandwidthLimit(int direction, long long bytesPerSecond)
 {
-    sdkMutex.lock();
-
-    string utf8path = path;
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(utf8path.c_str()) && ((utf8path.size()<2) || utf8path.compare(0, 2, "\\\\")))
-            utf8path.insert(0, "\\\\?\\");
-#endif
-
-    string localpath;
-    fsAccess->path2local(&utf8path, &localpath);
-
-    Sync *sync = NULL;
-    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
     {
-        string *localroot = &((*it)->localroot.localname);
-        if(((localroot->size()+fsAccess->localseparator.size())<localpath.size()) &&
-            !memcmp(localroot->data(), localpath.data(), localroot->size()) &&
-            !memcmp(fsAccess->localseparator.data(), localpath.data()+localroot->size(), fsAccess->localseparator.size()))
-        {
-            sync = (*it);
-            break;
-        }
+        return;
     }
 
-    if(!sync)
+    sdkMutex.lock();
+    client->bandwidth.transferrate[(direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT] =
+            bytesPerSecond < 0 ? 0 : bytesPerSecond;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::addBandwidthSchedule(int direction, int weekdays, int startMinute, int endMinute, long long bytesPerSecond)
+{
+    if((direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+            || startMinute < 0 || startMinute >= 1440 || endMinute < 0 || endMinute > 1440)
     {
-        sdkMutex.unlock();
-        return false;
+        return;
     }
 
-    bool result = sync->movetolocaldebris(&localpath);
-    sdkMutex.unlock();
+    BandwidthScheduleEntry entry;
 
-    return result;
+    entry.weekdays = weekdays & 0x7f;
+    entry.start = startMinute;
+    entry.end = endMinute;
+    entry.rate = bytesPerSecond < 0 ? 0 : bytesPerSecond;
+
+    sdkMutex.lock();
+    client->bandwidth.addschedule((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT, &entry);
+    sdkMutex.unlock();
 }
 
-int MegaApiImpl::syncPathState(string* path)
+void MegaApiImpl::clearBandwidthSchedule(int direction)
 {
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-    string prefix("\\\\?\\");
-    string localPrefix;
-    fsAccess->path2local(&prefix, &localPrefix);
-    path->append("", 1);
-    if(!PathIsRelativeW((LPCWSTR)path->data()) && (path->size()<4 || memcmp(path->data(), localPrefix.data(), 4)))
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
     {
-        path->insert(0, localPrefix);
+        return;
     }
-    path->resize(path->size() - 1);
-#endif
 
-    int state = MegaApi::STATE_NONE;
     sdkMutex.lock();
-    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
-    {
-        Sync *sync = (*it);
-        unsigned int ssize = sync->localroot.localname.size();
-        if(path->size() < ssize || memcmp(path->data(), sync->localroot.localname.data(), ssize))
-            continue;
-
-        if(path->size() == ssize)
-        {
-            state = sync->localroot.ts;
-            break;
-        }
-        else if(!memcmp(path->data()+ssize, client->fsaccess->localseparator.data(), client->fsaccess->localseparator.size()))
-        {
-            LocalNode* l = sync->localnodebypath(NULL, path);
-            if(l)
-                state = l->ts;
-            else
-                state = MegaApi::STATE_IGNORED;
-            break;
-        }
-    }
+    client->bandwidth.clearschedule((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT);
     sdkMutex.unlock();
-    return state;
 }
 
+void MegaApiImpl::setStreamingBandwidth(long long bytesPerSecond)
+{
+    sdkMutex.lock();
+    client->bandwidth.streamingrate = bytesPerSecond < 0 ? 0 : bytesPerSecond;
+    sdkMutex.unlock();
+}
 
-MegaNode *MegaApiImpl::getSyncedNode(string *path)
+void MegaApiImpl::setStreamingCache(long long cacheSize, long long readAhead)
 {
     sdkMutex.lock();
-    MegaNode *node = NULL;
-    for (sync_list::iterator it = client->syncs.begin(); (it != client->syncs.end()) && (node == NULL); it++)
+    client->setdirectreadcache(cacheSize, readAhead);
+    sdkMutex.unlock();
+}
+
+bool MegaApiImpl::pauseStreaming(MegaTransfer *transfer, bool pause)
+{
+    if (!transfer)
     {
-        Sync *sync = (*it);
-        if(path->size() == sync->localroot.localname.size() &&
-                !memcmp(path->data(), sync->localroot.localname.data(), path->size()))
-        {
-            node = MegaNodePrivate::fromNode(sync->localroot.node);
-            break;
-        }
+        return false;
+    }
 
-        LocalNode * localNode = sync->localnodebypath(NULL, path);
-        if(localNode) node = MegaNodePrivate::fromNode(localNode->node);
+    bool result = false;
+
+    sdkMutex.lock();
+    map<int, MegaTransferPrivate *>::iterator it = transferMap.find(transfer->getTag());
+    if (it != transferMap.end() && it->second->isStreamingTransfer())
+    {
+        result = client->preadpause(it->second, pause);
     }
     sdkMutex.unlock();
-    return node;
+
+    if (result && !pause)
+    {
+        waiter->notify();
+    }
+
+    return result;
 }
 
-void MegaApiImpl::syncFolder(const char *localFolder, MegaNode *megaFolder, MegaRequestListener *listener)
+bool MegaApiImpl::httpServerStart(bool localOnly, int port)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
-    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
-    if(localFolder)
+#ifndef WINDOWS_PHONE
+    httpServerStop();
+
+    MegaHTTPServer *server = new MegaHTTPServer(this);
+
+    if (!server->start(port, localOnly))
     {
-        string path(localFolder);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-        request->setFile(path.data());
+        delete server;
+        return false;
     }
 
-    request->setListener(listener);
-    requestQueue.push(request);
-    waiter->notify();
+    httpServerMutex.lock();
+    httpServer = server;
+    httpServerMutex.unlock();
+
+    return true;
+#else
+    return false;
+#endif
 }
 
-void MegaApiImpl::resumeSync(const char *localFolder, long long localfp, MegaNode *megaFolder, MegaRequestListener* listener)
+void MegaApiImpl::httpServerStop()
 {
-    sdkMutex.lock();
+#ifndef WINDOWS_PHONE
+    httpServerMutex.lock();
+    MegaHTTPServer *server = httpServer;
+    httpServer = NULL;
+    httpServerMutex.unlock();
 
-#ifdef __APPLE__
-    localfp = 0;
+    // (the connections still need the SDK thread to end their transfers)
+    delete server;
 #endif
+}
 
-    LOG_debug << "Resume sync";
+int MegaApiImpl::httpServerIsRunning()
+{
+    int port = 0;
 
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
-    request->setListener(listener);
-    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
-    if(localFolder)
+#ifndef WINDOWS_PHONE
+    httpServerMutex.lock();
+    if (httpServer)
     {
-        string path(localFolder);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-        request->setFile(path.data());
+        port = httpServer->getPort();
     }
-    request->setNumber(localfp);
+    httpServerMutex.unlock();
+#endif
 
-    int nextTag = client->nextreqtag();
-    request->setTag(nextTag);
-    requestMap[nextTag]=request;
-    error e = API_OK;
-    fireOnRequestStart(request);
+    return port;
+}
 
-    const char *localPath = request->getFile();
-    Node *node = client->nodebyhandle(request->getNodeHandle());
-    if(!node || (node->type==FILENODE) || !localPath)
+char *MegaApiImpl::httpServerGetLocalLink(MegaNode *node)
+{
+    char *link = NULL;
+
+#ifndef WINDOWS_PHONE
+    httpServerMutex.lock();
+    if (httpServer && node && node->isFile())
     {
-        e = API_EARGS;
+        link = httpServer->getLink(node);
     }
-    else
-    {
-        string utf8name(localPath);
-        string localname;
-        client->fsaccess->path2local(&utf8name, &localname);
-        e = client->addsync(&localname, DEBRISFOLDER, NULL, node, localfp, -nextTag);
-        if(!e)
-        {
-            MegaSyncPrivate *sync = new MegaSyncPrivate(client->syncs.back());
-            sync->setListener(request->getSyncListener());
-            syncMap[-nextTag] = sync;
+    httpServerMutex.unlock();
+#endif
 
-            request->setNumber(client->syncs.back()->fsfp);
-        }
+    return link;
+}
+
+bool MegaApiImpl::peerCacheStart(int port)
+{
+#ifndef WINDOWS_PHONE
+    peerCacheStop();
+
+    MegaHTTPServer *server = new MegaHTTPServer(this, true);
+
+    if (!server->start(port, false))
+    {
+        delete server;
+        return false;
     }
 
-    fireOnRequestFinish(request, MegaError(e));
-    sdkMutex.unlock();
+    httpServerMutex.lock();
+    peerCache = server;
+    httpServerMutex.unlock();
+
+    return true;
+#else
+    return false;
+#endif
 }
 
-void MegaApiImpl::removeSync(handle nodehandle, MegaRequestListener* listener)
+void MegaApiImpl::peerCacheStop()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
-    request->setNodeHandle(nodehandle);
-    request->setFlag(true);
-    requestQueue.push(request);
-    waiter->notify();
+#ifndef WINDOWS_PHONE
+    httpServerMutex.lock();
+    MegaHTTPServer *server = peerCache;
+    peerCache = NULL;
+    httpServerMutex.unlock();
+
+    // (its threads may be waiting for the SDK lock)
+    delete server;
+
+    sdkMutex.lock();
+    client->peerurls.clear();
+    sdkMutex.unlock();
+#endif
 }
 
-void MegaApiImpl::disableSync(handle nodehandle, MegaRequestListener *listener)
+int MegaApiImpl::peerCacheIsRunning()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
-    request->setNodeHandle(nodehandle);
-    request->setFlag(false);
-    requestQueue.push(request);
-    waiter->notify();
+    int port = 0;
+
+#ifndef WINDOWS_PHONE
+    httpServerMutex.lock();
+    if (peerCache)
+    {
+        port = peerCache->getPort();
+    }
+    httpServerMutex.unlock();
+#endif
+
+    return port;
 }
 
-int MegaApiImpl::getNumActiveSyncs()
+FileAccess *MegaApiImpl::openPeerSource(MegaHandle h, string *nodekey)
 {
+    FileAccess *fa = NULL;
+
+#ifdef ENABLE_SYNC
     sdkMutex.lock();
-    int num = client->syncs.size();
+
+    Node *n = client->nodebyhandle(h);
+
+    // only synced copies are known to hold the node's current content
+    if (n && n->type == FILENODE && n->localnode && n->nodekey.size() == FILENODEKEYLENGTH
+            && *(FileFingerprint *)n->localnode == *(FileFingerprint *)n)
+    {
+        string localpath;
+
+        n->localnode->getlocalpath(&localpath);
+        fa = client->fsaccess->newfileaccess();
+
+        if (fa->fopen(&localpath, true, false) && fa->size == n->size && fa->mtime == n->mtime)
+        {
+            *nodekey = n->nodekey;
+        }
+        else
+        {
+            delete fa;
+            fa = NULL;
+        }
+    }
+
     sdkMutex.unlock();
-    return num;
+#endif
+
+    return fa;
 }
 
-void MegaApiImpl::stopSyncs(MegaRequestListener *listener)
+void MegaApiImpl::setPeerUrl(MegaHandle h, const char *url)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNCS, listener);
-    requestQueue.push(request);
+    sdkMutex.lock();
+    client->setpeerurl(h, url);
+    sdkMutex.unlock();
+
     waiter->notify();
 }
 
-bool MegaApiImpl::isSynced(MegaNode *n)
+void MegaApiImpl::setTransferPolicy(int policy)
 {
-    if(!n) return false;
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node)
+    TransferScheduler::policy_t p;
+
+    switch(policy)
     {
-        sdkMutex.unlock();
-        return false;
+        case MegaApi::TRANSFER_POLICY_SHORTEST_FIRST:
+            p = TransferScheduler::POLICY_SHORTESTFIRST;
+            break;
+        case MegaApi::TRANSFER_POLICY_PRIORITY:
+            p = TransferScheduler::POLICY_PRIORITY;
+            break;
+        case MegaApi::TRANSFER_POLICY_FAIR_SHARE:
+            p = TransferScheduler::POLICY_FAIRSHARE;
+            break;
+        case MegaApi::TRANSFER_POLICY_RECENT_FIRST:
+            p = TransferScheduler::POLICY_RECENTFIRST;
+            break;
+        case MegaApi::TRANSFER_POLICY_AGING:
+            p = TransferScheduler::POLICY_AGING;
+            break;
+        default:
+            p = TransferScheduler::POLICY_DEFAULT;
+            break;
     }
 
-    bool result = (node->localnode!=NULL);
+    sdkMutex.lock();
+    client->scheduler.setpolicy(p);
     sdkMutex.unlock();
-    return result;
 }
 
-void MegaApiImpl::setExcludedNames(vector<string> *excludedNames)
+bool MegaApiImpl::setTransferPriority(int transferTag, int priority)
 {
     sdkMutex.lock();
-    if(!excludedNames)
-    {
-        this->excludedNames.clear();
-        sdkMutex.unlock();
-        return;
-    }
 
-    for(unsigned int i=0; i<excludedNames->size(); i++)
+    map<int, MegaTransferPrivate *>::iterator it = transferMap.find(transferTag);
+    Transfer *transfer = it != transferMap.end() ? it->second->getTransfer() : NULL;
+
+    if (transfer)
     {
-        LOG_debug << "Excluded name: " << excludedNames->at(i);
+        for (file_list::iterator fit = transfer->files.begin(); fit != transfer->files.end(); fit++)
+        {
+            File *f = *fit;
+
+            f->priority = priority;
+
+            // rewrite the persistent download queue record
+            if (f->queuedbid)
+            {
+                client->unqueuefile(f);
+                client->queuefile(f);
+            }
+        }
     }
 
-    this->excludedNames = *excludedNames;
     sdkMutex.unlock();
-}
 
-void MegaApiImpl::setExclusionLowerSizeLimit(long long limit)
-{
-    syncLowerSizeLimit = limit;
+    return transfer != NULL;
 }
 
-void MegaApiImpl::setExclusionUpperSizeLimit(long long limit)
+void MegaApiImpl::setLargeTransferSlots(int direction, int slots, long long minSize)
 {
-    syncUpperSizeLimit = limit;
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+    {
+        return;
+    }
+
+    sdkMutex.lock();
+    client->scheduler.setlargeslots((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT,
+                                    slots < 0 ? 0 : slots, minSize);
+    sdkMutex.unlock();
 }
 
-string MegaApiImpl::getLocalPath(MegaNode *n)
+int MegaApiImpl::getTransferQueueDepth(int direction)
 {
-    if(!n) return string();
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node || !node->localnode)
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
     {
-        sdkMutex.unlock();
-        return string();
+        return 0;
     }
 
-    string result;
-    node->localnode->getlocalpath(&result, true);
-    result.append("", 1);
+    sdkMutex.lock();
+    int result = client->scheduler.queued((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT);
     sdkMutex.unlock();
     return result;
 }
 
-#endif
-
-int MegaApiImpl::getNumPendingUploads()
+MegaTransferTimings *MegaApiImpl::getTransferTimings(int direction)
 {
-    return pendingUploads;
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+    {
+        return NULL;
+    }
+
+    sdkMutex.lock();
+    MegaTransferTimings *result = new MegaTransferTimingsPrivate(
+                &client->chunktimings[(direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT]);
+    sdkMutex.unlock();
+    return result;
 }
 
-int MegaApiImpl::getNumPendingDownloads()
+MegaEngineMetrics *MegaApiImpl::getEngineMetrics()
 {
-    return pendingDownloads;
+    sdkMutex.lock();
+    MegaEngineMetrics *result = new MegaEngineMetricsPrivate(&client->enginestats, &httpio->hoststats, client->csinflight());
+    sdkMutex.unlock();
+    return result;
 }
 
-int MegaApiImpl::getTotalUploads()
+void MegaApiImpl::resetEngineMetrics()
 {
-    return totalUploads;
+    sdkMutex.lock();
+    client->enginestats.reset();
+    httpio->hoststats.clear();
+    sdkMutex.unlock();
 }
 
-int MegaApiImpl::getTotalDownloads()
+MegaStartupTimeline *MegaApiImpl::getStartupTimeline()
 {
-    return totalDownloads;
+    sdkMutex.lock();
+    MegaStartupTimeline *result = new MegaStartupTimelinePrivate(&client->startup);
+    sdkMutex.unlock();
+    return result;
 }
 
-void MegaApiImpl::resetTotalDownloads()
+void MegaApiImpl::setEngineMetricsInterval(int seconds)
 {
-    totalDownloads = 0;
+    sdkMutex.lock();
+    client->enginestatsds = seconds > 0 ? seconds * 10 : 0;
+    client->enginestatslastds = Waiter::ds;
+    sdkMutex.unlock();
+
+    waiter->notify();
 }
 
-void MegaApiImpl::resetTotalUploads()
+void MegaApiImpl::enginestats_updated()
 {
-    totalUploads = 0;
+    MegaEngineMetrics *metrics = getEngineMetrics();
+    fireOnEngineMetrics(metrics);
+    delete metrics;
 }
 
-MegaNode *MegaApiImpl::getRootNode()
+void MegaApiImpl::releaseTransferBuffer(string *buffer)
 {
     sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[0]));
+    client->releasereadbuffer(buffer);
     sdkMutex.unlock();
-	return result;
 }
 
-MegaNode* MegaApiImpl::getInboxNode()
+void MegaApiImpl::resetTransferTimings(int direction)
 {
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+    {
+        return;
+    }
+
     sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[1]));
+    client->chunktimings[(direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT].reset();
     sdkMutex.unlock();
-	return result;
 }
 
-MegaNode* MegaApiImpl::getRubbishNode()
+int MegaApiImpl::getTransferSlotUtilization()
 {
     sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[2]));
+    int result = client->scheduler.slotutilisation();
     sdkMutex.unlock();
-	return result;
+    return result;
 }
 
-bool MegaApiImpl::userComparatorDefaultASC (User *i, User *j)
+MegaTransferList *MegaApiImpl::getTransfers()
 {
-	if(strcasecmp(i->email.c_str(), j->email.c_str())<=0) return 1;
-    return 0;
-}
+    sdkMutex.lock();
 
-char *MegaApiImpl::escapeFsIncompatible(const char *filename)
-{
-    if(!filename)
+    vector<MegaTransfer *> transfers;
+    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
     {
-        return NULL;
+        for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
+        {
+            Transfer *t = it->second;
+            if(transferMap.find(t->tag) == transferMap.end())
+            {
+                continue;
+            }
+            MegaTransferPrivate* transfer = transferMap.at(t->tag);
+            transfers.push_back(transfer);
+        }
     }
-    string name = filename;
-    client->fsaccess->escapefsincompatible(&name);
-    return MegaApi::strdup(name.c_str());
+
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+
+    sdkMutex.unlock();
+    return result;
 }
 
-char *MegaApiImpl::unescapeFsIncompatible(const char *name)
+MegaTransfer *MegaApiImpl::getTransferByTag(int transferTag)
 {
-    if(!name)
+    MegaTransfer* value = NULL;
+    sdkMutex.lock();
+
+    if(transferMap.find(transferTag) == transferMap.end())
     {
+        sdkMutex.unlock();
         return NULL;
     }
-    string filename = name;
-    client->fsaccess->unescapefsincompatible(&filename);
-    return MegaApi::strdup(filename.c_str());
+
+    value = transferMap.at(transferTag)->copy();
+    sdkMutex.unlock();
+    return value;
 }
 
-bool MegaApiImpl::createThumbnail(const char *imagePath, const char *dstPath)
+MegaTransferList *MegaApiImpl::getTransfers(int type)
 {
-    if (!gfxAccess)
+    if(type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD)
     {
-        return false;
+        return new MegaTransferListPrivate();
     }
 
-    string utf8ImagePath = imagePath;
-    string localImagePath;
-    fsAccess->path2local(&utf8ImagePath, &localImagePath);
-
-    string utf8DstPath = dstPath;
-    string localDstPath;
-    fsAccess->path2local(&utf8DstPath, &localDstPath);
-
     sdkMutex.lock();
-    bool result = gfxAccess->savefa(&localImagePath, GfxProc::THUMBNAIL120X120, &localDstPath);
-    sdkMutex.unlock();
 
-    return result;
-}
-
-bool MegaApiImpl::createPreview(const char *imagePath, const char *dstPath)
-{
-    if (!gfxAccess)
+    vector<MegaTransfer *> transfers;
+    for (transfer_map::iterator it = client->transfers[type].begin(); it != client->transfers[type].end(); it++)
     {
-        return false;
+        Transfer *t = it->second;
+        if(transferMap.find(t->tag) == transferMap.end())
+        {
+            continue;
+        }
+        MegaTransferPrivate* transfer = transferMap.at(t->tag);
+        transfers.push_back(transfer);
     }
 
-    string utf8ImagePath = imagePath;
-    string localImagePath;
-    fsAccess->path2local(&utf8ImagePath, &localImagePath);
-
-    string utf8DstPath = dstPath;
-    string localDstPath;
-    fsAccess->path2local(&utf8DstPath, &localDstPath);
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
 
-    sdkMutex.lock();
-    bool result = gfxAccess->savefa(&localImagePath, GfxProc::PREVIEW1000x1000, &localDstPath);
     sdkMutex.unlock();
-
     return result;
 }
 
-bool MegaApiImpl::isOnline()
+MegaTransferPrivate *MegaApiImpl::newUploadTransfer(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener)
 {
-    return !client->httpio->noinetds;
+    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, listener);
+    if(localPath)
+    {
+        string path(localPath);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
+        transfer->setPath(path.data());
+    }
+    if(parent) transfer->setParentHandle(parent->getHandle());
+	if(fileName) transfer->setFileName(fileName);
+    transfer->setTime(mtime);
+    return transfer;
 }
 
-MegaUserList* MegaApiImpl::getContacts()
+void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener)
 {
-    sdkMutex.lock();
-
-	vector<User*> vUsers;
-	for (user_map::iterator it = client->users.begin() ; it != client->users.end() ; it++ )
-	{
-		User *u = &(it->second);
-        vector<User *>::iterator i = std::lower_bound(vUsers.begin(), vUsers.end(), u, MegaApiImpl::userComparatorDefaultASC);
-		vUsers.insert(i, u);
-	}
-    MegaUserList *userList = new MegaUserListPrivate(vUsers.data(), vUsers.size());
-
-    sdkMutex.unlock();
+    MegaTransferPrivate* transfer = newUploadTransfer(localPath, parent, fileName, mtime, listener);
+	transfer->setMaxRetries(maxRetries);
 
-	return userList;
+	if(transferQueue.push(transfer)) waiter->notify();
 }
 
-
-MegaUser* MegaApiImpl::getContact(const char* email)
+void MegaApiImpl::startStreamUpload(MegaInputStream *inputStream, MegaNode *parent, const char *fileName, int64_t mtime, MegaTransferListener *listener)
 {
-    sdkMutex.lock();
-	MegaUser *user = MegaUserPrivate::fromUser(client->finduser(email, 0));
-    sdkMutex.unlock();
-	return user;
-}
+    MegaTransferPrivate* transfer = newUploadTransfer(NULL, parent, fileName, mtime, listener);
+    transfer->setInputStream(inputStream);
+    transfer->setMaxRetries(maxRetries);
 
+    if(transferQueue.push(transfer)) waiter->notify();
+}
 
-MegaNodeList* MegaApiImpl::getInShares(MegaUser *megaUser)
+MegaTransferList *MegaApiImpl::getTransfers(int type, int fromTag, int limit)
 {
-    if(!megaUser) return new MegaNodeListPrivate();
+    vector<MegaTransfer *> transfers;
 
-    sdkMutex.lock();
-    vector<Node*> vNodes;
-    User *user = client->finduser(megaUser->getEmail(), 0);
-    if(!user)
+    bool shared = lockQuery();
+    for (std::map<int, MegaTransferPrivate *>::iterator it = transferMap.upper_bound(fromTag);
+         it != transferMap.end() && (int)transfers.size() < limit; it++)
     {
-        sdkMutex.unlock();
-        return new MegaNodeListPrivate();
+        if(type < 0 || it->second->getType() == type)
+        {
+            transfers.push_back(it->second);
+        }
     }
 
-	for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
-	{
-        Node *n;
-        if ((n = client->nodebyhandle(*sit)) && !n->parent)
-            vNodes.push_back(n);
-	}
-    MegaNodeList *nodeList;
-    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    else nodeList = new MegaNodeListPrivate();
-
-    sdkMutex.unlock();
-	return nodeList;
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+    unlockQuery(shared);
+    return result;
 }
 
-MegaNodeList* MegaApiImpl::getInShares()
+MegaTransferStats *MegaApiImpl::getTransferStats()
 {
-    sdkMutex.lock();
+    bool shared = lockQuery();
+    MegaTransferStatsPrivate *stats = new MegaTransferStatsPrivate(transferStats);
 
-    vector<Node*> vNodes;
-	for(user_map::iterator it = client->users.begin(); it != client->users.end(); it++)
-	{
-		User *user = &(it->second);
-		Node *n;
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+    {
+        stats->active[(*it)->transfer->type == PUT ? MegaTransfer::TYPE_UPLOAD : MegaTransfer::TYPE_DOWNLOAD]++;
+    }
 
-		for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
-		{
-            if ((n = client->nodebyhandle(*sit)) && !n->parent)
-				vNodes.push_back(n);
-		}
-	}
+    stats->speed[MegaTransfer::TYPE_DOWNLOAD] = downloadSpeed;
+    stats->speed[MegaTransfer::TYPE_UPLOAD] = uploadSpeed;
+    unlockQuery(shared);
 
-    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    sdkMutex.unlock();
-	return nodeList;
+    return stats;
 }
 
-bool MegaApiImpl::isShared(MegaNode *megaNode)
+MegaMemoryUsage *MegaApiImpl::getMemoryUsage()
 {
-	if(!megaNode) return false;
-
-	sdkMutex.lock();
-	Node *node = client->nodebyhandle(megaNode->getHandle());
-	if(!node)
-	{
-		sdkMutex.unlock();
-		return false;
-	}
+    MemoryUsage usage;
 
-    bool result = (node->outshares != NULL) || ((node->inshare != NULL) && !node->parent);
-	sdkMutex.unlock();
+    bool shared = lockQuery();
+    client->memoryusage(&usage);
+    unlockQuery(shared);
 
-	return result;
+    return new MegaMemoryUsagePrivate(&usage);
 }
 
-bool MegaApiImpl::isOutShare(MegaNode *megaNode)
+// keep the aggregates of getTransferStats() up to date - finish is 1 once the
+// transfer completes and -1 if it fails
+void MegaApiImpl::updateTransferStats(MegaTransferPrivate *transfer, int finish)
 {
-    if(!megaNode) return false;
+    int d = transfer->getType() == MegaTransfer::TYPE_UPLOAD ? MegaTransfer::TYPE_UPLOAD : MegaTransfer::TYPE_DOWNLOAD;
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node)
+    if (transfer->statsTotal < 0)
     {
-        sdkMutex.unlock();
-        return false;
-    }
+        if (finish)
+        {
+            // failed before it started
+            if (finish < 0)
+            {
+                transferStats.failed[d]++;
+            }
+            return;
+        }
 
-    bool result = (node->outshares != NULL);
-    sdkMutex.unlock();
+        transferStats.pending[d]++;
+        transfer->statsTotal = 0;
+        transfer->statsTransferred = 0;
+    }
 
-    return result;
-}
+    long long total = transfer->getTotalBytes() > 0 ? transfer->getTotalBytes() : 0;
+    long long transferred = transfer->getTransferredBytes();
 
-bool MegaApiImpl::isInShare(MegaNode *megaNode)
-{
-    if(!megaNode) return false;
+    transferStats.pendingBytes[d] += total - transfer->statsTotal;
+    transferStats.transferredBytes[d] += transferred - transfer->statsTransferred;
+    transfer->statsTotal = total;
+    transfer->statsTransferred = transferred;
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node)
+    if (finish)
     {
-        sdkMutex.unlock();
-        return false;
+        transferStats.pending[d]--;
+        transferStats.pendingBytes[d] -= total;
+        transferStats.transferredBytes[d] -= transferred;
+        transfer->statsTotal = -1;
+
+        if (finish > 0)
+        {
+            transferStats.completed[d]++;
+            transferStats.completedBytes[d] += transferred;
+        }
+        else
+        {
+            transferStats.failed[d]++;
+        }
     }
+}
 
-    bool result = (node->inshare != NULL) && !node->parent;
-    sdkMutex.unlock();
+void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, MegaTransferListener *listener)
+{ return startUpload(localPath, parent, (const char *)NULL, -1, listener); }
 
-    return result;
-}
+void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, int64_t mtime, MegaTransferListener *listener)
+{ return startUpload(localPath, parent, (const char *)NULL, mtime, listener); }
 
-bool MegaApiImpl::isPendingShare(MegaNode *megaNode)
+void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener)
+{ return startUpload(localPath, parent, fileName, -1, listener); }
+
+MegaTransferPrivate *MegaApiImpl::newDownloadTransfer(MegaNode *node, const char* localPath, long startPos, long endPos, MegaTransferListener *listener)
 {
-    if(!megaNode) return false;
+	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node)
+    if(localPath)
     {
-        sdkMutex.unlock();
-        return false;
-    }
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        string path(localPath);
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+        localPath = path.data();
+#endif
 
-    bool result = (node->pendingshares != NULL);
-    sdkMutex.unlock();
+        int c = localPath[strlen(localPath)-1];
+        if((c=='/') || (c == '\\')) transfer->setParentPath(localPath);
+        else transfer->setPath(localPath);
+    }
 
-    return result;
+    if(node)
+    {
+        transfer->setNodeHandle(node->getHandle());
+        if(node->isPublic())
+            transfer->setPublicNode(node);
+    }
+	transfer->setStartPos(startPos);
+	transfer->setEndPos(endPos);
+    return transfer;
 }
 
-MegaShareList *MegaApiImpl::getOutShares()
+void MegaApiImpl::startDownload(MegaNode *node, const char* localPath, long startPos, long endPos, MegaTransferListener *listener)
 {
-    sdkMutex.lock();
-
-    OutShareProcessor shareProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
-    MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
+	MegaTransferPrivate* transfer = newDownloadTransfer(node, localPath, startPos, endPos, listener);
+	transfer->setMaxRetries(maxRetries);
 
-	sdkMutex.unlock();
-	return shareList;
+	if(transferQueue.push(transfer)) waiter->notify();
 }
 
-MegaShareList* MegaApiImpl::getOutShares(MegaNode *megaNode)
+void MegaApiImpl::startDownload(MegaNode *node, const char* localFolder, MegaTransferListener *listener)
+{ startDownload(node, localFolder, 0, 0, listener); }
+
+void MegaApiImpl::startTransfers(MegaTransferBatch *batch, MegaTransferListener *listener)
 {
-    if(!megaNode) return new MegaShareListPrivate();
+    if(!batch) return;
 
-    sdkMutex.lock();
-	Node *node = client->nodebyhandle(megaNode->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return new MegaShareListPrivate();
-	}
+    vector<MegaTransferPrivate *> *transfers = &((MegaTransferBatchPrivate *)batch)->transfers;
+    if(transfers->empty()) return;
 
-    if(!node->outshares)
+    for (unsigned i = 0; i < transfers->size(); i++)
     {
-        sdkMutex.unlock();
-        return new MegaShareListPrivate();
+        (*transfers)[i]->setListener(listener);
+        (*transfers)[i]->setMaxRetries(maxRetries);
     }
 
-	vector<Share*> vShares;
-	vector<handle> vHandles;
-
-    for (share_map::iterator it = node->outshares->begin(); it != node->outshares->end(); it++)
-	{
-		vShares.push_back(it->second);
-		vHandles.push_back(node->nodehandle);
-	}
-
-    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
-    sdkMutex.unlock();
-    return shareList;
+	if(transferQueue.push(transfers)) waiter->notify();
+    transfers->clear();
 }
 
-MegaShareList *MegaApiImpl::getPendingOutShares()
+void MegaApiImpl::cancelTransfer(MegaTransfer *t, MegaRequestListener *listener)
 {
-    sdkMutex.lock();
-
-    PendingOutShareProcessor shareProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
-    MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
+    if(t)
+    {
+        request->setTransferTag(t->getTag());
+    }
+    if(requestQueue.push(request)) waiter->notify();
+}
 
-    sdkMutex.unlock();
-    return shareList;
+void MegaApiImpl::cancelTransferByTag(int transferTag, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
+    request->setTransferTag(transferTag);
+    if(requestQueue.push(request)) waiter->notify();
 }
 
-MegaShareList *MegaApiImpl::getPendingOutShares(MegaNode *megaNode)
+void MegaApiImpl::cancelTransfers(int direction, MegaRequestListener *listener)
 {
-    if(!megaNode)
-    {
-        return new MegaShareListPrivate();
-    }
-
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node || !node->pendingshares)
-    {
-        sdkMutex.unlock();
-        return new MegaShareListPrivate();
-    }
-
-    vector<Share*> vShares;
-    vector<handle> vHandles;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFERS, listener);
+    request->setParamType(direction);
+    if(requestQueue.push(request)) waiter->notify();
+}
 
-    for (share_map::iterator it = node->pendingshares->begin(); it != node->pendingshares->end(); it++)
-    {
-        vShares.push_back(it->second);
-        vHandles.push_back(node->nodehandle);
-    }
+void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener)
+{
+	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
+	if(node && !node->isPublic())
+	{
+		transfer->setNodeHandle(node->getHandle());
+	}
+	else
+	{
+		transfer->setPublicNode(node);
+	}
 
-    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
-    sdkMutex.unlock();
-    return shareList;
+	transfer->setStartPos(startPos);
+	transfer->setEndPos(startPos + size - 1);
+	transfer->setMaxRetries(maxRetries);
+	if(transferQueue.push(transfer)) waiter->notify();
 }
 
-MegaContactRequestList *MegaApiImpl::getIncomingContactRequests()
+#ifdef ENABLE_SYNC
+
+//Move local files inside synced folders to the "Rubbish" folder.
+bool MegaApiImpl::moveToLocalDebris(const char *path)
 {
     sdkMutex.lock();
-    vector<PendingContactRequest*> vContactRequests;
-    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
-    {
-        if(!it->second->isoutgoing)
-        {
-            vContactRequests.push_back(it->second);
-        }
-    }
 
-    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
-    sdkMutex.unlock();
+    string utf8path = path;
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(utf8path.c_str()) && ((utf8path.size()<2) || utf8path.compare(0, 2, "\\\\")))
+            utf8path.insert(0, "\\\\?\\");
+#endif
 
-    return requestList;
-}
+    string localpath;
+    fsAccess->path2local(&utf8path, &localpath);
 
-MegaContactRequestList *MegaApiImpl::getOutgoingContactRequests()
-{
-    sdkMutex.lock();
-    vector<PendingContactRequest*> vContactRequests;
-    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
+    Sync *sync = NULL;
+    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
     {
-        if(it->second->isoutgoing)
+        string *localroot = &((*it)->localroot.localname);
+        if(((localroot->size()+fsAccess->localseparator.size())<localpath.size()) &&
+            !memcmp(localroot->data(), localpath.data(), localroot->size()) &&
+            !memcmp(fsAccess->localseparator.data(), localpath.data()+localroot->size(), fsAccess->localseparator.size()))
         {
-            vContactRequests.push_back(it->second);
+            sync = (*it);
+            break;
         }
     }
 
-    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
+    if(!sync)
+    {
+        sdkMutex.unlock();
+        return false;
+    }
+
+    bool result = sync->movetolocaldebris(&localpath);
     sdkMutex.unlock();
 
-    return requestList;
+    return result;
 }
 
-int MegaApiImpl::getAccess(MegaNode* megaNode)
+int MegaApiImpl::syncPathState(string* path)
 {
-    if(!megaNode) return MegaShare::ACCESS_UNKNOWN;
-
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node)
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+    string prefix("\\\\?\\");
+    string localPrefix;
+    fsAccess->path2local(&prefix, &localPrefix);
+    path->append("", 1);
+    if(!PathIsRelativeW((LPCWSTR)path->data()) && (path->size()<4 || memcmp(path->data(), localPrefix.data(), 4)))
     {
-        sdkMutex.unlock();
-        return MegaShare::ACCESS_UNKNOWN;
+        path->insert(0, localPrefix);
     }
+    path->resize(path->size() - 1);
+#endif
 
-    if (!client->loggedin())
+    int state = MegaApi::STATE_NONE;
+
+    pathStateMutex.lock();
+    map<string, int>::iterator sit = pathStates.find(*path);
+    if (sit != pathStates.end())
     {
-        sdkMutex.unlock();
-        return MegaShare::ACCESS_READ;
+        state = sit->second;
+        pathStateMutex.unlock();
+        return state;
     }
+    pathStateMutex.unlock();
 
-    if(node->type > FOLDERNODE)
+    sdkMutex.lock();
+    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
     {
-        sdkMutex.unlock();
-        return MegaShare::ACCESS_OWNER;
+        Sync *sync = (*it);
+        unsigned int ssize = sync->localroot.localname.size();
+        if(path->size() < ssize || memcmp(path->data(), sync->localroot.localname.data(), ssize))
+            continue;
+
+        if(path->size() == ssize)
+        {
+            state = sync->localroot.ts;
+            break;
+        }
+        else if(!memcmp(path->data()+ssize, client->fsaccess->localseparator.data(), client->fsaccess->localseparator.size()))
+        {
+            LocalNode* l = sync->localnodebypath(NULL, path);
+            if(l)
+                state = l->ts;
+            else
+                state = MegaApi::STATE_IGNORED;
+            break;
+        }
     }
 
-    Node *n = node;
-    accesslevel_t a = OWNER;
-    while (n)
+    pathStateMutex.lock();
+    if (pathStates.size() >= MAXPATHSTATES)
     {
-        if (n->inshare) { a = n->inshare->access; break; }
-        n = n->parent;
+        pathStates.clear();
     }
+    pathStates[*path] = state;
+    pathStateMutex.unlock();
 
     sdkMutex.unlock();
+    return state;
+}
 
-    switch(a)
+void MegaApiImpl::dropPathStates(string *localpath, bool folder)
+{
+    pathStateMutex.lock();
+    map<string, int>::iterator it = pathStates.lower_bound(*localpath);
+    while (it != pathStates.end() && !it->first.compare(0, localpath->size(), *localpath))
     {
-        case RDONLY: return MegaShare::ACCESS_READ;
-        case RDWR: return MegaShare::ACCESS_READWRITE;
-        case FULL: return MegaShare::ACCESS_FULL;
-        default: return MegaShare::ACCESS_OWNER;
+        // the path itself or, for folders, one below it
+        if (it->first.size() == localpath->size()
+         || (folder && !it->first.compare(localpath->size(), fsAccess->localseparator.size(), fsAccess->localseparator)))
+        {
+            pathStates.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
     }
+    pathStateMutex.unlock();
 }
 
-bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool recursive)
-{
-	if(!n) return true;
-	if(!processor) return false;
 
+MegaNode *MegaApiImpl::getSyncedNode(string *path)
+{
     sdkMutex.lock();
-	Node *node = client->nodebyhandle(n->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-		return true;
-	}
-
-	if (node->type != FILENODE)
-	{
-		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
-		{
-			MegaNode *megaNode = MegaNodePrivate::fromNode(*it++);
-			if(recursive)
-			{
-				if(!processMegaTree(megaNode,processor))
-				{
-					delete megaNode;
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-			else
-			{
-				if(!processor->processMegaNode(megaNode))
-				{
-					delete megaNode;
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-			delete megaNode;
-		}
-	}
-	bool result = processor->processMegaNode(n);
+    MegaNode *node = NULL;
+    for (sync_list::iterator it = client->syncs.begin(); (it != client->syncs.end()) && (node == NULL); it++)
+    {
+        Sync *sync = (*it);
+        if(path->size() == sync->localroot.localname.size() &&
+                !memcmp(path->data(), sync->localroot.localname.data(), path->size()))
+        {
+            node = MegaNodePrivate::fromNode(sync->localroot.node);
+            break;
+        }
 
+        LocalNode * localNode = sync->localnodebypath(NULL, path);
+        if(localNode) node = MegaNodePrivate::fromNode(localNode->node);
+    }
     sdkMutex.unlock();
-    return result;
+    return node;
 }
 
-MegaNode *MegaApiImpl::createPublicFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime, MegaHandle parentHandle, const char* auth)
+void MegaApiImpl::syncFolder(const char *localFolder, MegaNode *megaFolder, MegaRequestListener *listener)
 {
-    string nodekey;
-    string attrstring;
-    nodekey.resize(strlen(key) * 3 / 4 + 3);
-    nodekey.resize(Base64::atob(key, (byte *)nodekey.data(), nodekey.size()));
-    return new MegaNodePrivate(name, FILENODE, size, mtime, mtime, handle, &nodekey, &attrstring, parentHandle, auth);
-}
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
+    if(localFolder)
+    {
+        string path(localFolder);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
+        request->setFile(path.data());
+    }
 
-MegaNode *MegaApiImpl::createPublicFolderNode(MegaHandle handle, const char *name, MegaHandle parentHandle, const char *auth)
-{
-    string nodekey;
-    string attrstring;
-    return new MegaNodePrivate(name, FOLDERNODE, 0, 0, 0, handle, &nodekey, &attrstring, parentHandle, auth);
+    request->setListener(listener);
+    if(requestQueue.push(request)) waiter->notify();
 }
 
-void MegaApiImpl::loadBalancing(const char* service, MegaRequestListener *listener)
+void MegaApiImpl::resumeSync(const char *localFolder, long long localfp, MegaNode *megaFolder, MegaRequestListener* listener)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOAD_BALANCING, listener);
-    request->setName(service);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    sdkMutex.lock();
 
-const char *MegaApiImpl::getVersion()
-{
-    return client->version();
-}
+#ifdef __APPLE__
+    localfp = 0;
+#endif
 
-const char *MegaApiImpl::getUserAgent()
-{
-    return client->useragent.c_str();
-}
+    LOG_debug << "Resume sync";
 
-void MegaApiImpl::changeApiUrl(const char *apiURL, bool disablepkp)
-{
-    sdkMutex.lock();
-    MegaClient::APIURL = apiURL;
-    if(disablepkp)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+    request->setListener(listener);
+    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
+    if(localFolder)
     {
-        MegaClient::disablepkp = true;
-    }
-    client->abortbackoff();
-    client->disconnect();
-    sdkMutex.unlock();
-}
+        string path(localFolder);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
+        request->setFile(path.data());
+    }
+    request->setNumber(localfp);
 
-bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursive)
-{
-	if(!node) return 1;
-	if(!processor) return 0;
+    int nextTag = client->nextreqtag();
+    request->setTag(nextTag);
+    requestMap[nextTag]=request;
+    error e = API_OK;
+    fireOnRequestStart(request);
 
-    sdkMutex.lock();
-	node = client->nodebyhandle(node->nodehandle);
-	if(!node)
-	{
-        sdkMutex.unlock();
-		return 1;
-	}
+    const char *localPath = request->getFile();
+    Node *node = client->nodebyhandle(request->getNodeHandle());
+    if(!node || (node->type==FILENODE) || !localPath)
+    {
+        e = API_EARGS;
+    }
+    else
+    {
+        string utf8name(localPath);
+        string localname;
+        client->fsaccess->path2local(&utf8name, &localname);
+        e = client->addsync(&localname, DEBRISFOLDER, NULL, node, localfp, -nextTag);
+        if(!e)
+        {
+            MegaSyncPrivate *sync = new MegaSyncPrivate(client->syncs.back());
+            sync->setListener(request->getSyncListener());
+            syncMap[-nextTag] = sync;
 
-	if (node->type != FILENODE)
-	{
-		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
-		{
-			if(recursive)
-			{
-				if(!processTree(*it++,processor))
-				{
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-			else
-			{
-				if(!processor->processNode(*it++))
-				{
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-		}
-	}
-	bool result = processor->processNode(node);
+            request->setNumber(client->syncs.back()->fsfp);
+        }
+    }
 
+    fireOnRequestFinish(request, MegaError(e));
     sdkMutex.unlock();
-	return result;
 }
 
-MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, bool recursive)
+void MegaApiImpl::removeSync(handle nodehandle, MegaRequestListener* listener)
 {
-    if(!n || !searchString) return new MegaNodeListPrivate();
-    sdkMutex.lock();
-	Node *node = client->nodebyhandle(n->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return new MegaNodeListPrivate();
-	}
-
-	SearchTreeProcessor searchProcessor(searchString);
-	processTree(node, &searchProcessor, recursive);
-    vector<Node *>& vNodes = searchProcessor.getResults();
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
+    request->setNodeHandle(nodehandle);
+    request->setFlag(true);
+    if(requestQueue.push(request)) waiter->notify();
+}
 
-    MegaNodeList *nodeList;
-    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    else nodeList = new MegaNodeListPrivate();
+void MegaApiImpl::disableSync(handle nodehandle, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
+    request->setNodeHandle(nodehandle);
+    request->setFlag(false);
+    if(requestQueue.push(request)) waiter->notify();
+}
 
+int MegaApiImpl::getNumActiveSyncs()
+{
+    sdkMutex.lock();
+    int num = client->syncs.size();
     sdkMutex.unlock();
+    return num;
+}
 
-    return nodeList;
+long long MegaApiImpl::getSyncMemoryUsage()
+{
+    sdkMutex.lock();
+    long long bytes = client->syncmemory();
+    sdkMutex.unlock();
+    return bytes;
 }
 
-long long MegaApiImpl::getSize(MegaNode *n)
+void MegaApiImpl::stopSyncs(MegaRequestListener *listener)
 {
-    if(!n) return 0;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNCS, listener);
+    if(requestQueue.push(request)) waiter->notify();
+}
 
+bool MegaApiImpl::isSynced(MegaNode *n)
+{
+    if(!n) return false;
     sdkMutex.lock();
     Node *node = client->nodebyhandle(n->getHandle());
     if(!node)
     {
         sdkMutex.unlock();
-        return 0;
+        return false;
     }
-    SizeProcessor sizeProcessor;
-    processTree(node, &sizeProcessor);
-    long long result = sizeProcessor.getTotalBytes();
-    sdkMutex.unlock();
 
+    bool result = (node->localnode!=NULL);
+    sdkMutex.unlock();
     return result;
 }
 
-char *MegaApiImpl::getFingerprint(const char *filePath)
+void MegaApiImpl::setExcludedNames(vector<string> *excludedNames)
 {
-    if(!filePath) return NULL;
-
-    string path = filePath;
-    string localpath;
-    fsAccess->path2local(&path, &localpath);
-
-    FileAccess *fa = fsAccess->newfileaccess();
-    if(!fa->fopen(&localpath, true, false))
-        return NULL;
-
-    FileFingerprint fp;
-    fp.genfingerprint(fa);
-    m_off_t size = fa->size;
-    delete fa;
-    if(fp.size < 0)
-        return NULL;
-
-    string fingerprint;
-    fp.serializefingerprint(&fingerprint);
+    sdkMutex.lock();
+    if(!excludedNames)
+    {
+        this->excludedNames.clear();
+        sdkMutex.unlock();
+        return;
+    }
 
-    char bsize[sizeof(size)+1];
-    int l = Serialize64::serialize((byte *)bsize, size);
-    char *buf = new char[l * 4 / 3 + 4];
-    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+    for(unsigned int i=0; i<excludedNames->size(); i++)
+    {
+        LOG_debug << "Excluded name: " << excludedNames->at(i);
+    }
 
-    string result(1, ssize);
-    result.append(buf);
-    result.append(fingerprint);
-    delete [] buf;
+    this->excludedNames.set(excludedNames);
+    sdkMutex.unlock();
+}
 
-    return MegaApi::strdup(result.c_str());
+void MegaApiImpl::setExclusionLowerSizeLimit(long long limit)
+{
+    syncLowerSizeLimit = limit;
 }
 
-char *MegaApiImpl::getFingerprint(MegaNode *n)
+void MegaApiImpl::setExclusionUpperSizeLimit(long long limit)
 {
-    if(!n) return NULL;
+    syncUpperSizeLimit = limit;
+}
 
+string MegaApiImpl::getLocalPath(MegaNode *n)
+{
+    if(!n) return string();
     sdkMutex.lock();
     Node *node = client->nodebyhandle(n->getHandle());
-    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
+    if(!node || !node->localnode)
     {
         sdkMutex.unlock();
-        return NULL;
+        return string();
     }
 
-    string fingerprint;
-    node->serializefingerprint(&fingerprint);
-    m_off_t size = node->size;
+    string result;
+    node->localnode->getlocalpath(&result, true);
+    result.append("", 1);
     sdkMutex.unlock();
+    return result;
+}
 
-    char bsize[sizeof(size)+1];
-    int l = Serialize64::serialize((byte *)bsize, size);
-    char *buf = new char[l * 4 / 3 + 4];
-    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
-    string result(1, ssize);
-    result.append(buf);
-    result.append(fingerprint);
-    delete [] buf;
+#endif
 
-    return MegaApi::strdup(result.c_str());
+int MegaApiImpl::getNumPendingUploads()
+{
+    return pendingUploads;
 }
 
-char *MegaApiImpl::getFingerprint(MegaInputStream *inputStream, int64_t mtime)
+int MegaApiImpl::getNumPendingDownloads()
 {
-    if(!inputStream) return NULL;
-
-    ExternalInputStream is(inputStream);
-    m_off_t size = is.size();
-    if(size < 0)
-        return NULL;
-
-    FileFingerprint fp;
-    fp.genfingerprint(&is, mtime);
-
-    if(fp.size < 0)
-        return NULL;
-
-    string fingerprint;
-    fp.serializefingerprint(&fingerprint);
-
-    char bsize[sizeof(size)+1];
-    int l = Serialize64::serialize((byte *)bsize, size);
-    char *buf = new char[l * 4 / 3 + 4];
-    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
-
-    string result(1, ssize);
-    result.append(buf);
-    result.append(fingerprint);
-    delete [] buf;
-
-    return MegaApi::strdup(result.c_str());
+    return pendingDownloads;
 }
 
-MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint)
+int MegaApiImpl::getTotalUploads()
 {
-    if(!fingerprint) return NULL;
-
-    MegaNode *result;
-    sdkMutex.lock();
-    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint));
-    sdkMutex.unlock();
-    return result;
+    return totalUploads;
 }
 
-MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint, MegaNode* parent)
+int MegaApiImpl::getTotalDownloads()
 {
-    if(!fingerprint) return NULL;
-
-    MegaNode *result;
-    sdkMutex.lock();
-    Node *p = NULL;
-    if(parent)
-    {
-        p = client->nodebyhandle(parent->getHandle());
-    }
-
-    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint, p));
-    sdkMutex.unlock();
-    return result;
+    return totalDownloads;
 }
 
-bool MegaApiImpl::hasFingerprint(const char *fingerprint)
+void MegaApiImpl::resetTotalDownloads()
 {
-    return (getNodeByFingerprintInternal(fingerprint) != NULL);
+    totalDownloads = 0;
 }
 
-char *MegaApiImpl::getCRC(const char *filePath)
+void MegaApiImpl::resetTotalUploads()
 {
-    if(!filePath) return NULL;
-
-    string path = filePath;
-    string localpath;
-    fsAccess->path2local(&path, &localpath);
+    totalUploads = 0;
+}
 
-    FileAccess *fa = fsAccess->newfileaccess();
-    if(!fa->fopen(&localpath, true, false))
-        return NULL;
+MegaNode *MegaApiImpl::getRootNode()
+{
+    bool shared = lockQuery();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[0]));
+    unlockQuery(shared);
+	return result;
+}
 
-    FileFingerprint fp;
-    fp.genfingerprint(fa);
-    delete fa;
-    if(fp.size < 0)
-        return NULL;
+MegaNode* MegaApiImpl::getInboxNode()
+{
+    bool shared = lockQuery();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[1]));
+    unlockQuery(shared);
+	return result;
+}
 
-    string result;
-    result.resize((sizeof fp.crc) * 4 / 3 + 4);
-    result.resize(Base64::btoa((const byte *)fp.crc, sizeof fp.crc, (char*)result.c_str()));
-    return MegaApi::strdup(result.c_str());
+MegaNode* MegaApiImpl::getRubbishNode()
+{
+    bool shared = lockQuery();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[2]));
+    unlockQuery(shared);
+	return result;
 }
 
-char *MegaApiImpl::getCRC(MegaNode *n)
+bool MegaApiImpl::userComparatorDefaultASC (User *i, User *j)
 {
-    if(!n) return NULL;
+	if(strcasecmp(i->email.c_str(), j->email.c_str())<=0) return 1;
+    return 0;
+}
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
+char *MegaApiImpl::escapeFsIncompatible(const char *filename)
+{
+    if(!filename)
     {
-        sdkMutex.unlock();
         return NULL;
     }
-
-    string result;
-    result.resize((sizeof node->crc) * 4 / 3 + 4);
-    result.resize(Base64::btoa((const byte *)node->crc, sizeof node->crc, (char*)result.c_str()));
-
-    sdkMutex.unlock();
-    return MegaApi::strdup(result.c_str());
+    string name = filename;
+    client->fsaccess->escapefsincompatible(&name);
+    return MegaApi::strdup(name.c_str());
 }
 
-MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
+char *MegaApiImpl::unescapeFsIncompatible(const char *name)
 {
-    if(!parent) return NULL;
-
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(parent->getHandle());
-    if(!node || node->type == FILENODE)
+    if(!name)
     {
-        sdkMutex.unlock();
         return NULL;
     }
+    string filename = name;
+    client->fsaccess->unescapefsincompatible(&filename);
+    return MegaApi::strdup(filename.c_str());
+}
 
-    byte binarycrc[sizeof(node->crc)];
-    Base64::atob(crc, binarycrc, sizeof(binarycrc));
-
-    for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
+bool MegaApiImpl::createThumbnail(const char *imagePath, const char *dstPath)
+{
+    if (!gfxAccess)
     {
-        Node *child = (*it);
-        if(!memcmp(child->crc, binarycrc, sizeof(node->crc)))
-        {
-            MegaNode *result = MegaNodePrivate::fromNode(child);
-            sdkMutex.unlock();
-            return result;
-        }
+        return false;
     }
 
+    string utf8ImagePath = imagePath;
+    string localImagePath;
+    fsAccess->path2local(&utf8ImagePath, &localImagePath);
+
+    string utf8DstPath = dstPath;
+    string localDstPath;
+    fsAccess->path2local(&utf8DstPath, &localDstPath);
+
+    sdkMutex.lock();
+    bool result = gfxAccess->savefa(&localImagePath, GfxProc::THUMBNAIL120X120, &localDstPath);
     sdkMutex.unlock();
-    return NULL;
+
+    return result;
 }
 
-SearchTreeProcessor::SearchTreeProcessor(const char *search) { this->search = search; }
+bool MegaApiImpl::createPreview(const char *imagePath, const char *dstPath)
+{
+    if (!gfxAccess)
+    {
+        return false;
+    }
 
-#if defined(_WIN32) || defined(__APPLE__)
+    string utf8ImagePath = imagePath;
+    string localImagePath;
+    fsAccess->path2local(&utf8ImagePath, &localImagePath);
 
-char *strcasestr(const char *string, const char *substring)
-{
-	int i, j;
-	for (i = 0; string[i]; i++)
-	{
-		for (j = 0; substring[j]; j++)
-		{
-			unsigned char c1 = string[i + j];
-			if (!c1)
-				return NULL;
+    string utf8DstPath = dstPath;
+    string localDstPath;
+    fsAccess->path2local(&utf8DstPath, &localDstPath);
 
-			unsigned char c2 = substring[j];
-			if (toupper(c1) != toupper(c2))
-				break;
-		}
+    sdkMutex.lock();
+    bool result = gfxAccess->savefa(&localImagePath, GfxProc::PREVIEW1000x1000, &localDstPath);
+    sdkMutex.unlock();
 
-		if (!substring[j])
-			return (char *)string + i;
-	}
-	return NULL;
+    return result;
 }
 
-#endif
+bool MegaApiImpl::isOnline()
+{
+    return !client->httpio->noinetds;
+}
 
-bool SearchTreeProcessor::processNode(Node* node)
+MegaUserList* MegaApiImpl::getContacts()
 {
-	if(!node) return true;
-	if(!search) return false;
+    bool shared = lockQuery();
 
-	if(strcasestr(node->displayname(), search)!=NULL)
-		results.push_back(node);
+	vector<User*> vUsers;
+	for (user_map::iterator it = client->users.begin() ; it != client->users.end() ; it++ )
+	{
+		User *u = &(it->second);
+        vector<User *>::iterator i = std::lower_bound(vUsers.begin(), vUsers.end(), u, MegaApiImpl::userComparatorDefaultASC);
+		vUsers.insert(i, u);
+	}
+    MegaUserList *userList = new MegaUserListPrivate(vUsers.data(), vUsers.size());
 
-	return true;
-}
+    unlockQuery(shared);
 
-vector<Node *> &SearchTreeProcessor::getResults()
-{
-	return results;
+	return userList;
 }
 
-SizeProcessor::SizeProcessor()
-{
-    totalBytes=0;
-}
 
-bool SizeProcessor::processNode(Node *node)
+MegaUser* MegaApiImpl::getContact(const char* email)
 {
-    if(node->type == FILENODE)
-        totalBytes += node->size;
-    return true;
+    bool shared = lockQuery();
+	MegaUser *user = MegaUserPrivate::fromUser(client->finduser(email, 0));
+    unlockQuery(shared);
+	return user;
 }
 
-long long SizeProcessor::getTotalBytes()
-{
-    return totalBytes;
-}
 
-void MegaApiImpl::transfer_added(Transfer *t)
+MegaNodeList* MegaApiImpl::getInShares(MegaUser *megaUser)
 {
-	MegaTransferPrivate *transfer = currentTransfer;
-    if(!transfer)
-    {
-        transfer = new MegaTransferPrivate(t->type);
-        transfer->setSyncTransfer(true);
-    }
-
-	currentTransfer = NULL;
-    transfer->setTransfer(t);
-    transfer->setTotalBytes(t->size);
-    transfer->setTag(t->tag);
-	transferMap[t->tag]=transfer;
+    if(!megaUser) return new MegaNodeListPrivate();
 
-    if (t->type == GET)
-    {
-        totalDownloads++;
-        pendingDownloads++;
-    }
-    else
+    bool shared = lockQuery();
+    vector<Node*> vNodes;
+    User *user = client->finduser(megaUser->getEmail(), 0);
+    if(!user)
     {
-        totalUploads++;
-        pendingUploads++;
+        unlockQuery(shared);
+        return new MegaNodeListPrivate();
     }
 
-    fireOnTransferStart(transfer);
+	for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
+	{
+        Node *n;
+        if ((n = client->nodebyhandle(*sit)) && !n->parent)
+            vNodes.push_back(n);
+	}
+    MegaNodeList *nodeList;
+    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    else nodeList = new MegaNodeListPrivate();
+
+    unlockQuery(shared);
+	return nodeList;
 }
 
-void MegaApiImpl::transfer_removed(Transfer *t)
+MegaNodeList* MegaApiImpl::getInShares()
 {
-    if(transferMap.find(t->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(t->tag);
-    if(!transfer)
-    {
-        return;
-    }
-
-    if (t->type == GET)
-    {
-        if(pendingDownloads > 0)
-            pendingDownloads--;
+    bool shared = lockQuery();
 
-        if(totalDownloads > 0)
-            totalDownloads--;
-    }
-    else
-    {
-        if(pendingUploads > 0)
-            pendingUploads--;
+    vector<Node*> vNodes;
+	for(user_map::iterator it = client->users.begin(); it != client->users.end(); it++)
+	{
+		User *user = &(it->second);
+		Node *n;
 
-        if(totalUploads > 0)
-            totalUploads--;
-    }
+		for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
+		{
+            if ((n = client->nodebyhandle(*sit)) && !n->parent)
+				vNodes.push_back(n);
+		}
+	}
 
-    fireOnTransferFinish(transfer, MegaError(transfer->getLastErrorCode()));
+    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    unlockQuery(shared);
+	return nodeList;
 }
 
-void MegaApiImpl::transfer_prepare(Transfer *t)
+bool MegaApiImpl::isShared(MegaNode *megaNode)
 {
-    if(transferMap.find(t->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+	if(!megaNode) return false;
 
-	if (t->type == GET)
-		transfer->setNodeHandle(t->files.back()->h);
+	bool shared = lockQuery();
+	Node *node = client->nodebyhandle(megaNode->getHandle());
+	if(!node)
+	{
+		unlockQuery(shared);
+		return false;
+	}
 
-    string path;
-    fsAccess->local2path(&(t->files.back()->localname), &path);
-    transfer->setPath(path.c_str());
-    transfer->setTotalBytes(t->size);
+    bool result = (node->outshares != NULL) || ((node->inshare != NULL) && !node->parent);
+	unlockQuery(shared);
 
-    LOG_info << "Transfer (" << transfer->getTransferString() << ") starting. File: " << transfer->getFileName();
+	return result;
 }
 
-void MegaApiImpl::transfer_update(Transfer *tr)
+bool MegaApiImpl::isOutShare(MegaNode *megaNode)
 {
-    if(transferMap.find(tr->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
-    if(!transfer)
+    if(!megaNode) return false;
+
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node)
     {
-        return;
+        unlockQuery(shared);
+        return false;
     }
 
-    if(tr->slot)
+    bool result = (node->outshares != NULL);
+    unlockQuery(shared);
+
+    return result;
+}
+
+bool MegaApiImpl::isInShare(MegaNode *megaNode)
+{
+    if(!megaNode) return false;
+
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node)
     {
-        if((transfer->getUpdateTime() != Waiter::ds) || !tr->slot->progressreported || (tr->slot->progressreported == tr->size))
-        {
-            if(!transfer->getStartTime())
-            {
-                transfer->setStartTime(Waiter::ds);
-            }
+        unlockQuery(shared);
+        return false;
+    }
 
-            m_off_t deltaSize = tr->slot->progressreported - transfer->getTransferredBytes();
-            transfer->setDeltaSize(deltaSize);
+    bool result = (node->inshare != NULL) && !node->parent;
+    unlockQuery(shared);
 
-            dstime currentTime = Waiter::ds;
-            long long speed = 0;
-            if(tr->type == GET)
-            {
-                totalDownloadedBytes += deltaSize;
+    return result;
+}
 
-                while(downloadBytes.size())
-                {
-                    dstime deltaTime = currentTime - downloadTimes[0];
-                    if(deltaTime <= 50)
-                    {
-                        break;
-                    }
+bool MegaApiImpl::isPendingShare(MegaNode *megaNode)
+{
+    if(!megaNode) return false;
 
-                    downloadPartialBytes -= downloadBytes[0];
-                    downloadBytes.erase(downloadBytes.begin());
-                    downloadTimes.erase(downloadTimes.begin());
-                }
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node)
+    {
+        unlockQuery(shared);
+        return false;
+    }
 
-                downloadBytes.push_back(deltaSize);
-                downloadTimes.push_back(currentTime);
-                downloadPartialBytes += deltaSize;
+    bool result = (node->pendingshares != NULL);
+    unlockQuery(shared);
 
-                downloadSpeed = (downloadPartialBytes * 10) / 50;
-                speed = downloadSpeed;
-            }
-            else
-            {
-                totalUploadedBytes += deltaSize;
+    return result;
+}
 
-                while(uploadBytes.size())
-                {
-                    dstime deltaTime = currentTime - uploadTimes[0];
-                    if(deltaTime <= 50)
-                    {
-                        break;
-                    }
+MegaShareList *MegaApiImpl::getOutShares()
+{
+    sdkMutex.lock();
 
-                    uploadPartialBytes -= uploadBytes[0];
-                    uploadBytes.erase(uploadBytes.begin());
-                    uploadTimes.erase(uploadTimes.begin());
-                }
+    OutShareProcessor shareProcessor;
+    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
+    MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
 
-                uploadBytes.push_back(deltaSize);
-                uploadTimes.push_back(currentTime);
-                uploadPartialBytes += deltaSize;
+	sdkMutex.unlock();
+	return shareList;
+}
 
-                uploadSpeed = (uploadPartialBytes * 10) / 50;
-                speed = uploadSpeed;
-            }
+MegaShareList* MegaApiImpl::getOutShares(MegaNode *megaNode)
+{
+    if(!megaNode) return new MegaShareListPrivate();
 
-            transfer->setTransferredBytes(tr->slot->progressreported);
+    bool shared = lockQuery();
+	Node *node = client->nodebyhandle(megaNode->getHandle());
+	if(!node)
+	{
+        unlockQuery(shared);
+        return new MegaShareListPrivate();
+	}
 
-            if(currentTime < transfer->getStartTime())
-                transfer->setStartTime(currentTime);
+    if(!node->outshares)
+    {
+        unlockQuery(shared);
+        return new MegaShareListPrivate();
+    }
 
-            transfer->setSpeed(speed);
-            transfer->setUpdateTime(currentTime);
+	vector<Share*> vShares;
+	vector<handle> vHandles;
 
-            fireOnTransferUpdate(transfer);
-        }
+    for (share_map::iterator it = node->outshares->begin(); it != node->outshares->end(); it++)
+	{
+		vShares.push_back(it->second);
+		vHandles.push_back(node->nodehandle);
 	}
-}
 
-void MegaApiImpl::transfer_failed(Transfer* tr, error e)
-{
-    if(transferMap.find(tr->tag) == transferMap.end()) return;
-    MegaError megaError(e);
-    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
-    transfer->setUpdateTime(Waiter::ds);
-    transfer->setDeltaSize(0);
-    transfer->setSpeed(0);
-    transfer->setLastErrorCode(e);
-    fireOnTransferTemporaryError(transfer, megaError);
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
+    unlockQuery(shared);
+    return shareList;
 }
 
-void MegaApiImpl::transfer_limit(Transfer* t)
+MegaShareList *MegaApiImpl::getPendingOutShares()
 {
-    if(transferMap.find(t->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(t->tag);
-    transfer->setUpdateTime(Waiter::ds);
-    transfer->setDeltaSize(0);
-    transfer->setSpeed(0);
-    fireOnTransferTemporaryError(transfer, MegaError(API_EOVERQUOTA));
+    sdkMutex.lock();
+
+    PendingOutShareProcessor shareProcessor;
+    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
+    MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
+
+    sdkMutex.unlock();
+    return shareList;
 }
 
-void MegaApiImpl::transfer_complete(Transfer* tr)
+MegaShareList *MegaApiImpl::getPendingOutShares(MegaNode *megaNode)
 {
-    if(transferMap.find(tr->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
+    if(!megaNode)
+    {
+        return new MegaShareListPrivate();
+    }
 
-    dstime currentTime = Waiter::ds;
-    if(!transfer->getStartTime())
-        transfer->setStartTime(currentTime);
-    if(currentTime<transfer->getStartTime())
-        transfer->setStartTime(currentTime);
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node || !node->pendingshares)
+    {
+        unlockQuery(shared);
+        return new MegaShareListPrivate();
+    }
 
-    transfer->setUpdateTime(currentTime);
+    vector<Share*> vShares;
+    vector<handle> vHandles;
 
-    if(tr->size != transfer->getTransferredBytes())
+    for (share_map::iterator it = node->pendingshares->begin(); it != node->pendingshares->end(); it++)
     {
-        long long speed = 0;
-        long long deltaTime = currentTime-transfer->getStartTime();
-        if(deltaTime<=0)
-            deltaTime = 1;
-        if(transfer->getTotalBytes()>0)
-            speed = (10*transfer->getTotalBytes())/deltaTime;
+        vShares.push_back(it->second);
+        vHandles.push_back(node->nodehandle);
+    }
 
-        transfer->setSpeed(speed);
-        transfer->setDeltaSize(tr->size - transfer->getTransferredBytes());
-        if(tr->type == GET)
-            totalDownloadedBytes += transfer->getDeltaSize();
-        else
-            totalUploadedBytes += transfer->getDeltaSize();
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
+    unlockQuery(shared);
+    return shareList;
+}
 
-        transfer->setTransferredBytes(tr->size);
+MegaContactRequestList *MegaApiImpl::getIncomingContactRequests()
+{
+    bool shared = lockQuery();
+    vector<PendingContactRequest*> vContactRequests;
+    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
+    {
+        if(!it->second->isoutgoing)
+        {
+            vContactRequests.push_back(it->second);
+        }
     }
 
-    if (tr->type == GET)
-    {
-        if(pendingDownloads > 0)
-            pendingDownloads--;
+    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
+    unlockQuery(shared);
 
-        string path;
-        fsAccess->local2path(&tr->localfilename, &path);
-        transfer->setPath(path.c_str());
+    return requestList;
+}
 
-        fireOnTransferFinish(transfer, MegaError(API_OK));
-    }
-    else
+MegaContactRequestList *MegaApiImpl::getOutgoingContactRequests()
+{
+    bool shared = lockQuery();
+    vector<PendingContactRequest*> vContactRequests;
+    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
     {
-        if(tr->size != transfer->getTransferredBytes())
+        if(it->second->isoutgoing)
         {
-            fireOnTransferUpdate(transfer);
+            vContactRequests.push_back(it->second);
         }
     }
+
+    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
+    unlockQuery(shared);
+
+    return requestList;
 }
 
-dstime MegaApiImpl::pread_failure(error e, int retry, void* param)
+int MegaApiImpl::getAccess(MegaNode* megaNode)
 {
-	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
-	transfer->setUpdateTime(Waiter::ds);
-	transfer->setDeltaSize(0);
-	transfer->setSpeed(0);
-	transfer->setLastBytes(NULL);
-	if (retry < transfer->getMaxRetries())
-	{
-        fireOnTransferTemporaryError(transfer, MegaError(e));
-		return (dstime)(retry*10);
-	}
-	else
-	{
-        fireOnTransferFinish(transfer, MegaError(e));
-		return ~(dstime)0;
-	}
-}
+    if(!megaNode) return MegaShare::ACCESS_UNKNOWN;
 
-bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t, void* param)
-{
-	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
-	transfer->setUpdateTime(Waiter::ds);
-    transfer->setLastBytes((char *)buffer);
-    transfer->setDeltaSize(len);
-    totalDownloadedBytes += len;
-	transfer->setTransferredBytes(transfer->getTransferredBytes()+len);
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node)
+    {
+        unlockQuery(shared);
+        return MegaShare::ACCESS_UNKNOWN;
+    }
 
-	bool end = (transfer->getTransferredBytes() == transfer->getTotalBytes());
-    fireOnTransferUpdate(transfer);
-    if(!fireOnTransferData(transfer) || end)
-	{
-        fireOnTransferFinish(transfer, end ? MegaError(API_OK) : MegaError(API_EINCOMPLETE));
-		return end;
-	}
-    return true;
-}
+    if (!client->loggedin())
+    {
+        unlockQuery(shared);
+        return MegaShare::ACCESS_READ;
+    }
 
-void MegaApiImpl::reportevent_result(error e)
-{
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_REPORT_EVENT)) return;
+    if(node->type > FOLDERNODE)
+    {
+        unlockQuery(shared);
+        return MegaShare::ACCESS_OWNER;
+    }
 
-    fireOnRequestFinish(request, megaError);
-}
+    Node *n = node;
+    accesslevel_t a = OWNER;
+    while (n)
+    {
+        if (n->inshare) { a = n->inshare->access; break; }
+        n = n->parent;
+    }
 
-void MegaApiImpl::loadbalancing_result(string *servers, error e)
-{
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_LOAD_BALANCING)) return;
+    unlockQuery(shared);
 
-    if(!e)
+    switch(a)
     {
-        request->setText(servers->c_str());
+        case RDONLY: return MegaShare::ACCESS_READ;
+        case RDWR: return MegaShare::ACCESS_READWRITE;
+        case FULL: return MegaShare::ACCESS_FULL;
+        default: return MegaShare::ACCESS_OWNER;
     }
-    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::sessions_killed(handle, error e)
+bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool recursive)
 {
-    MegaError megaError(e);
+	if(!n) return true;
+	if(!processor) return false;
 
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_KILL_SESSION)) return;
+    sdkMutex.lock();
+	Node *node = client->nodebyhandle(n->getHandle());
+	if(!node)
+	{
+        sdkMutex.unlock();
+		return true;
+	}
 
-    fireOnRequestFinish(request, megaError);
+    MegaTreeViewProcessor viewProcessor(processor);
+    bool result = walkTree(node, &viewProcessor, recursive) && processor->processMegaNode(n);
+
+    sdkMutex.unlock();
+    return result;
 }
 
-void MegaApiImpl::cleanrubbishbin_result(error e)
+void MegaApiImpl::searchAsync(MegaNode *node, const char *searchString, MegaSearchFilter *filter, int limit, MegaRequestListener *listener)
 {
-    MegaError megaError(e);
-
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CLEAN_RUBBISH_BIN)) return;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SEARCH, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    request->setText(searchString);
+    request->setNumber(limit);
+    if(filter) request->setSearchFilter(filter->copy());
+    if(requestQueue.push(request)) waiter->notify();
+}
 
-    fireOnRequestFinish(request, megaError);
+void MegaApiImpl::cancelSearch(int searchTag)
+{
+    sdkMutex.lock();
+    for (std::list<MegaSearchJob *>::iterator it = searchJobs.begin(); it != searchJobs.end(); it++)
+    {
+        if((*it)->request->getTag() == searchTag)
+        {
+            (*it)->cancelled = true;
+            waiter->notify();
+        }
+    }
+    sdkMutex.unlock();
 }
 
-#ifdef ENABLE_SYNC
-void MegaApiImpl::syncupdate_state(Sync *sync, syncstate_t newstate)
+// report the next batch of each search, finish the completed ones
+void MegaApiImpl::processSearchJobs()
 {
-    LOG_debug << "Sync state change: " << newstate << " Path: " << sync->localroot.name;
-    client->abortbackoff(false);
+    sdkMutex.lock();
 
-    if(newstate == SYNC_FAILED)
+    for (std::list<MegaSearchJob *>::iterator it = searchJobs.begin(); it != searchJobs.end(); )
     {
-        MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+        MegaSearchJob *job = *it;
+        node_vector results;
 
-        if(sync->localroot.node)
+        for (size_t checked = 0; !job->cancelled && checked < MegaSearchJob::BATCH
+             && job->next < job->candidates.size() && (!job->limit || job->found < job->limit); checked++)
         {
-            request->setNodeHandle(sync->localroot.node->nodehandle);
+            Node *n = client->nodebyhandle(job->candidates[job->next++]);
+            if (n && job->matches(n))
+            {
+                results.push_back(n);
+                job->found++;
+            }
         }
 
-        int nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-        requestMap[nextTag]=request;
-        fireOnRequestFinish(request, MegaError(sync->errorcode));
-    }
+        MegaRequestPrivate *request = job->request;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-    megaSync->setState(newstate);
+        if (results.size())
+        {
+            request->setMegaNodeList(new MegaNodeListPrivate(results.data(), results.size()));
+            request->setTransferredBytes(job->found);
+            fireOnRequestUpdate(request);
+            request->setMegaNodeList(NULL);
+        }
 
-    fireOnSyncStateChanged(megaSync);
-}
+        if (job->cancelled || job->next >= job->candidates.size() || (job->limit && job->found >= job->limit))
+        {
+            searchJobs.erase(it++);
 
-void MegaApiImpl::syncupdate_scanning(bool scanning)
-{
-    if(client)
-    {
-        client->abortbackoff(false);
-        client->syncscanstate = scanning;
-    }
-    fireOnGlobalSyncStateChanged();
-}
+            error e = job->cancelled ? API_EINCOMPLETE : API_OK;
+            delete job;
 
-void MegaApiImpl::syncupdate_local_folder_addition(Sync *sync, LocalNode *localNode, const char* path)
-{
-    LOG_debug << "Sync - local folder addition detected: " << path;
-    client->abortbackoff(false);
+            fireOnRequestFinish(request, MegaError(e));
+            continue;
+        }
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+        it++;
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_ADITION);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+    // more batches to check
+    if (searchJobs.size())
+    {
+        waiter->notify();
+    }
+
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::syncupdate_local_folder_deletion(Sync *sync, LocalNode *localNode)
+bool MegaApiImpl::processMegaTreeSnapshot(MegaNode *n, MegaTreeProcessor *processor, bool recursive, int numThreads)
 {
-    client->abortbackoff(false);
+    if(!n) return true;
+    if(!processor) return false;
 
-    string local;
-    string path;
-    localNode->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-    LOG_debug << "Sync - local folder deletion detected: " << path.c_str();
+    MegaTreeSnapshot snapshot(processor);
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(node)
+    {
+        walkTree(node, &snapshot, recursive);
+    }
+    unlockQuery(shared);
+
+    if(!node)
+    {
+        return true;
+    }
 
+    if(numThreads > MAX_TREE_THREADS) numThreads = MAX_TREE_THREADS;
+    if(!processor->isThreadSafe()) numThreads = 1;
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_DELETION);
-    event->setPath(path.c_str());
-    fireOnSyncEvent(megaSync, event);
+    return snapshot.process(numThreads) && processor->processMegaNode(n);
 }
 
-void MegaApiImpl::syncupdate_local_file_addition(Sync *sync, LocalNode *localNode, const char* path)
+// post-order: the children of a folder before the folder (but not the node
+// itself), without recursion
+bool MegaApiImpl::walkTree(Node *node, TreeProcessor *processor, bool recursive)
 {
-    LOG_debug << "Sync - local file addition detected: " << path;
-    client->abortbackoff(false);
+    if (node->type == FILENODE)
+    {
+        return true;
+    }
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    vector<pair<Node *, size_t> > stack;
+    stack.push_back(pair<Node *, size_t>(node, 0));
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_ADDITION);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
-}
+    while (stack.size())
+    {
+        Node *folder = stack.back().first;
+        size_t i = stack.back().second;
 
-void MegaApiImpl::syncupdate_local_file_deletion(Sync *sync, LocalNode *localNode)
-{
-    client->abortbackoff(false);
+        if (i < folder->children.size())
+        {
+            Node *child = folder->children[i];
+            stack.back().second++;
 
-    string local;
-    string path;
-    localNode->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-    LOG_debug << "Sync - local file deletion detected: " << path.c_str();
+            if (recursive && child->type != FILENODE)
+            {
+                stack.push_back(pair<Node *, size_t>(child, 0));
+            }
+            else if (!processor->processNode(child))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            stack.pop_back();
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+            if (stack.size() && !processor->processNode(folder))
+            {
+                return false;
+            }
+        }
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_DELETION);
-    event->setPath(path.c_str());
-    fireOnSyncEvent(megaSync, event);
+    return true;
 }
 
-void MegaApiImpl::syncupdate_local_file_change(Sync *sync, LocalNode *localNode, const char* path)
+MegaNode *MegaApiImpl::createPublicFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime, MegaHandle parentHandle, const char* auth)
 {
-    LOG_debug << "Sync - local file change detected: " << path;
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_CHANGED);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+    string nodekey;
+    string attrstring;
+    nodekey.resize(strlen(key) * 3 / 4 + 3);
+    nodekey.resize(Base64::atob(key, (byte *)nodekey.data(), nodekey.size()));
+    return new MegaNodePrivate(name, FILENODE, size, mtime, mtime, handle, &nodekey, &attrstring, parentHandle, auth);
 }
 
-void MegaApiImpl::syncupdate_local_move(Sync *sync, LocalNode *localNode, const char *to)
+MegaNode *MegaApiImpl::createPublicFolderNode(MegaHandle handle, const char *name, MegaHandle parentHandle, const char *auth)
 {
-    client->abortbackoff(false);
-
-    string local;
-    string path;
-    localNode->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-    LOG_debug << "Sync - local rename/move " << path.c_str() << " -> " << to;
+    string nodekey;
+    string attrstring;
+    return new MegaNodePrivate(name, FOLDERNODE, 0, 0, 0, handle, &nodekey, &attrstring, parentHandle, auth);
+}
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+void MegaApiImpl::loadBalancing(const char* service, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOAD_BALANCING, listener);
+    request->setName(service);
+    if(requestQueue.push(request)) waiter->notify();
+}
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_MOVE);
-    event->setPath(path.c_str());
-    event->setNewPath(to);
-    fireOnSyncEvent(megaSync, event);
+const char *MegaApiImpl::getVersion()
+{
+    return client->version();
 }
 
-void MegaApiImpl::syncupdate_get(Sync *sync, Node* node, const char *path)
+const char *MegaApiImpl::getUserAgent()
 {
-    LOG_debug << "Sync - requesting file " << path;
+    return client->useragent.c_str();
+}
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_GET);
-    event->setNodeHandle(node->nodehandle);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+void MegaApiImpl::changeApiUrl(const char *apiURL, bool disablepkp)
+{
+    sdkMutex.lock();
+    MegaClient::APIURL = apiURL;
+    if(disablepkp)
+    {
+        MegaClient::disablepkp = true;
+    }
+    client->abortbackoff();
+    client->disconnect();
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::syncupdate_put(Sync *sync, LocalNode *localNode, const char *path)
+bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursive)
 {
-    LOG_debug << "Sync - sending file " << path;
+	if(!node) return 1;
+	if(!processor) return 0;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    sdkMutex.lock();
+	node = client->nodebyhandle(node->nodehandle);
+	if(!node)
+	{
+        sdkMutex.unlock();
+		return 1;
+	}
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_PUT);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+	if (node->type != FILENODE)
+	{
+		for (node_vector::iterator it = node->children.begin(); it != node->children.end(); )
+		{
+			if(recursive)
+			{
+				if(!processTree(*it++,processor))
+				{
+                    sdkMutex.unlock();
+					return 0;
+				}
+			}
+			else
+			{
+				if(!processor->processNode(*it++))
+				{
+                    sdkMutex.unlock();
+					return 0;
+				}
+			}
+		}
+	}
+	bool result = processor->processNode(node);
+
+    sdkMutex.unlock();
+	return result;
 }
 
-void MegaApiImpl::syncupdate_remote_file_addition(Sync *sync, Node *n)
+MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, bool recursive)
 {
-    LOG_debug << "Sync - remote file addition detected " << n->displayname();
-    client->abortbackoff(false);
+    if(!n || !searchString) return new MegaNodeListPrivate();
+    sdkMutex.lock();
+	Node *node = client->nodebyhandle(n->getHandle());
+	if(!node)
+	{
+        sdkMutex.unlock();
+        return new MegaNodeListPrivate();
+	}
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    node_vector vNodes;
+    client->searchnodes(node, searchString, recursive, &vNodes);
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_ADDITION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
+    MegaNodeList *nodeList;
+    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    else nodeList = new MegaNodeListPrivate();
+
+    sdkMutex.unlock();
+
+    return nodeList;
 }
 
-void MegaApiImpl::syncupdate_remote_file_deletion(Sync *sync, Node *n)
+long long MegaApiImpl::getSize(MegaNode *n)
 {
-    LOG_debug << "Sync - remote file deletion detected " << n->displayname();
-    client->abortbackoff(false);
+    if(!n) return 0;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node)
+    {
+        unlockQuery(shared);
+        return 0;
+    }
+    long long result = node->treebytes;
+    unlockQuery(shared);
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_DELETION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
+    return result;
 }
 
-void MegaApiImpl::syncupdate_remote_folder_addition(Sync *sync, Node *n)
+char *MegaApiImpl::getFingerprint(const char *filePath)
 {
-    LOG_debug << "Sync - remote folder addition detected " << n->displayname();
-    client->abortbackoff(false);
+    if(!filePath) return NULL;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    string path = filePath;
+    string localpath;
+    fsAccess->path2local(&path, &localpath);
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_ADDITION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
-}
+    FileAccess *fa = fsAccess->newfileaccess();
+    if(!fa->fopen(&localpath, true, false))
+        return NULL;
 
-void MegaApiImpl::syncupdate_remote_folder_deletion(Sync *sync, Node *n)
-{
-    LOG_debug << "Sync - remote folder deletion detected " << n->displayname();
-    client->abortbackoff(false);
+    FileFingerprint fp;
+    fp.genfingerprint(fa);
+    m_off_t size = fa->size;
+    delete fa;
+    if(fp.size < 0)
+        return NULL;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    string fingerprint;
+    fp.serializefingerprint(&fingerprint);
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_DELETION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
-}
+    char bsize[sizeof(size)+1];
+    int l = Serialize64::serialize((byte *)bsize, size);
+    char *buf = new char[l * 4 / 3 + 4];
+    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
 
-void MegaApiImpl::syncupdate_remote_copy(Sync *, const char *name)
-{
-    LOG_debug << "Sync - creating remote file " << name << " by copying existing remote file";
-    client->abortbackoff(false);
+    string result(1, ssize);
+    result.append(buf);
+    result.append(fingerprint);
+    delete [] buf;
+
+    return MegaApi::strdup(result.c_str());
 }
 
-void MegaApiImpl::syncupdate_remote_move(Sync *sync, Node *n, Node *prevparent)
+char *MegaApiImpl::getFingerprint(MegaNode *n)
 {
-    LOG_debug << "Sync - remote move " << n->displayname() <<
-                 " from " << (prevparent ? prevparent->displayname() : "?") <<
-                 " to " << (n->parent ? n->parent->displayname() : "?");
-    client->abortbackoff(false);
+    if(!n) return NULL;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if (node)
+    {
+        node->resolveattrs();
+    }
+    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
+    {
+        unlockQuery(shared);
+        return NULL;
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_MOVE);
-    event->setNodeHandle(n->nodehandle);
-    event->setPrevParent(prevparent ? prevparent->nodehandle : UNDEF);
-    fireOnSyncEvent(megaSync, event);
+    string fingerprint;
+    node->serializefingerprint(&fingerprint);
+    m_off_t size = node->size;
+    unlockQuery(shared);
+
+    char bsize[sizeof(size)+1];
+    int l = Serialize64::serialize((byte *)bsize, size);
+    char *buf = new char[l * 4 / 3 + 4];
+    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+    string result(1, ssize);
+    result.append(buf);
+    result.append(fingerprint);
+    delete [] buf;
+
+    return MegaApi::strdup(result.c_str());
 }
 
-void MegaApiImpl::syncupdate_remote_rename(Sync *sync, Node *n, const char *prevname)
+char *MegaApiImpl::getFingerprint(MegaInputStream *inputStream, int64_t mtime)
 {
-    LOG_debug << "Sync - remote rename from " << prevname << " to " << n->displayname();
-    client->abortbackoff(false);
+    if(!inputStream) return NULL;
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    ExternalInputStream is(inputStream);
+    m_off_t size = is.size();
+    if(size < 0)
+        return NULL;
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_RENAME);
-    event->setNodeHandle(n->nodehandle);
-    event->setPrevName(prevname);
-    fireOnSyncEvent(megaSync, event);
-}
+    FileFingerprint fp;
+    fp.genfingerprint(&is, mtime);
 
-void MegaApiImpl::syncupdate_treestate(LocalNode *l)
-{
-    string local;
-    string path;
-    l->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
+    if(fp.size < 0)
+        return NULL;
 
-    if(syncMap.find(l->sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(l->sync->tag);
+    string fingerprint;
+    fp.serializefingerprint(&fingerprint);
 
-    fireOnFileSyncStateChanged(megaSync, path.data(), (int)l->ts);
+    char bsize[sizeof(size)+1];
+    int l = Serialize64::serialize((byte *)bsize, size);
+    char *buf = new char[l * 4 / 3 + 4];
+    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+
+    string result(1, ssize);
+    result.append(buf);
+    result.append(fingerprint);
+    delete [] buf;
+
+    return MegaApi::strdup(result.c_str());
 }
 
-bool MegaApiImpl::sync_syncable(Node *node)
+MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint)
 {
-    if(node->type == FILENODE && !is_syncable(node->size))
-    {
-        return false;
-    }
+    if(!fingerprint) return NULL;
 
-    const char *name = node->displayname();
-    sdkMutex.unlock();
-    bool result = is_syncable(name);
-    sdkMutex.lock();
+    MegaNode *result;
+    bool shared = lockQuery();
+    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint));
+    unlockQuery(shared);
     return result;
 }
 
-bool MegaApiImpl::sync_syncable(const char *name, string *localpath, string *)
+MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint, MegaNode* parent)
 {
-    static FileAccess* f = fsAccess->newfileaccess();
-    if(f->fopen(localpath) && !is_syncable(f->size))
+    if(!fingerprint) return NULL;
+
+    MegaNode *result;
+    bool shared = lockQuery();
+    Node *p = NULL;
+    if(parent)
     {
-        return false;
+        p = client->nodebyhandle(parent->getHandle());
     }
 
-    sdkMutex.unlock();
-    bool result =  is_syncable(name);
-    sdkMutex.lock();
+    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint, p));
+    unlockQuery(shared);
     return result;
 }
 
-void MegaApiImpl::syncupdate_local_lockretry(bool waiting)
+bool MegaApiImpl::hasFingerprint(const char *fingerprint)
 {
-    if (waiting)
-    {
-        LOG_debug << "Sync - waiting for local filesystem lock";
-    }
-    else
-    {
-        LOG_debug << "Sync - local filesystem lock issue resolved, continuing...";
-        client->abortbackoff(false);
-    }
-
-    this->waiting = waiting;
-    this->fireOnGlobalSyncStateChanged();
+    return (getNodeByFingerprintInternal(fingerprint) != NULL);
 }
-#endif
 
+char *MegaApiImpl::getCRC(const char *filePath)
+{
+    if(!filePath) return NULL;
 
-// user addition/update (users never get deleted)
-void MegaApiImpl::users_updated(User** u, int count)
+    string path = filePath;
+    string localpath;
+    fsAccess->path2local(&path, &localpath);
+
+    FileAccess *fa = fsAccess->newfileaccess();
+    if(!fa->fopen(&localpath, true, false))
+        return NULL;
+
+    FileFingerprint fp;
+    fp.genfingerprint(fa);
+    delete fa;
+    if(fp.size < 0)
+        return NULL;
+
+    string result;
+    result.resize((sizeof fp.crc) * 4 / 3 + 4);
+    result.resize(Base64::btoa((const byte *)fp.crc, sizeof fp.crc, (char*)result.c_str()));
+    return MegaApi::strdup(result.c_str());
+}
+
+char *MegaApiImpl::getCRC(MegaNode *n)
 {
-    if(!count)
-    {
-        return;
-    }
+    if(!n) return NULL;
 
-    MegaUserList *userList = NULL;
-    if(u != NULL)
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if (node)
     {
-        userList = new MegaUserListPrivate(u, count);
-        fireOnUsersUpdate(userList);
+        node->resolveattrs();
     }
-    else
+    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
     {
-        fireOnUsersUpdate(NULL);
+        unlockQuery(shared);
+        return NULL;
     }
-    delete userList;
-}
 
-void MegaApiImpl::account_updated()
-{
-    fireOnAccountUpdate();
+    string result;
+    result.resize((sizeof node->crc) * 4 / 3 + 4);
+    result.resize(Base64::btoa((const byte *)node->crc, sizeof node->crc, (char*)result.c_str()));
+
+    unlockQuery(shared);
+    return MegaApi::strdup(result.c_str());
 }
 
-void MegaApiImpl::pcrs_updated(PendingContactRequest **r, int count)
+MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
 {
-    if(!count)
-    {
-        return;
-    }
+    if(!parent) return NULL;
 
-    MegaContactRequestList *requestList = NULL;
-    if(r != NULL)
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(parent->getHandle());
+    if(!node || node->type == FILENODE)
     {
-        requestList = new MegaContactRequestListPrivate(r, count);
-        fireOnContactRequestsUpdate(requestList);
+        unlockQuery(shared);
+        return NULL;
     }
-    else
+
+    byte binarycrc[sizeof(node->crc)];
+    Base64::atob(crc, binarycrc, sizeof(binarycrc));
+
+    for (node_vector::iterator it = node->children.begin(); it != node->children.end(); it++)
     {
-        fireOnContactRequestsUpdate(NULL);
+        Node *child = (*it);
+        if(!memcmp(child->crc, binarycrc, sizeof(node->crc)))
+        {
+            MegaNode *result = MegaNodePrivate::fromNode(child);
+            unlockQuery(shared);
+            return result;
+        }
     }
-    delete requestList;
+
+    unlockQuery(shared);
+    return NULL;
 }
 
-void MegaApiImpl::setattr_result(handle h, error e)
+SearchTreeProcessor::SearchTreeProcessor(const char *search) { this->search = search; }
+
+#if defined(_WIN32) || defined(__APPLE__)
+
+char *strcasestr(const char *string, const char *substring)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_RENAME)) return;
+	int i, j;
+	for (i = 0; string[i]; i++)
+	{
+		for (j = 0; substring[j]; j++)
+		{
+			unsigned char c1 = string[i + j];
+			if (!c1)
+				return NULL;
 
-	request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
+			unsigned char c2 = substring[j];
+			if (toupper(c1) != toupper(c2))
+				break;
+		}
+
+		if (!substring[j])
+			return (char *)string + i;
+	}
+	return NULL;
 }
 
-void MegaApiImpl::rename_result(handle h, error e)
+#endif
+
+bool SearchTreeProcessor::processNode(Node* node)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_MOVE)) return;
+	if(!node) return true;
+	if(!search) return false;
 
-    request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
+	if(strcasestr(node->displayname(), search)!=NULL)
+		results.push_back(node);
+
+	return true;
 }
 
-void MegaApiImpl::unlink_result(handle h, error e)
+vector<Node *> &SearchTreeProcessor::getResults()
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_REMOVE)) return;
+	return results;
+}
 
-    request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
+SizeProcessor::SizeProcessor()
+{
+    totalBytes=0;
 }
 
-void MegaApiImpl::fetchnodes_result(error e)
+bool SizeProcessor::processNode(Node *node)
 {
-    MegaError megaError(e);
-    MegaRequestPrivate* request;
-    if (!client->restag)
+    if(node->type == FILENODE)
+        totalBytes += node->size;
+    return true;
+}
+
+long long SizeProcessor::getTotalBytes()
+{
+    return totalBytes;
+}
+
+void MegaApiImpl::transfer_added(Transfer *t)
+{
+	MegaTransferPrivate *transfer = currentTransfer;
+    if(!transfer)
     {
-        request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES);
-        fireOnRequestFinish(request, megaError);
-        return;
+        transfer = new MegaTransferPrivate(t->type);
+        transfer->setSyncTransfer(true);
     }
 
-    if (requestMap.find(client->restag) == requestMap.end())
+	currentTransfer = NULL;
+    transfer->setTransfer(t);
+    transfer->setTotalBytes(t->size);
+    transfer->setTag(t->tag);
+	transferMap[t->tag]=transfer;
+
+    if (t->type == GET)
     {
-        return;
+        totalDownloads++;
+        pendingDownloads++;
     }
-    request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_FETCH_NODES))
+    else
     {
-        return;
+        totalUploads++;
+        pendingUploads++;
     }
 
-    fireOnRequestFinish(request, megaError);
+    fireOnTransferStart(transfer);
 }
 
-void MegaApiImpl::putnodes_result(error e, targettype_t t, NewNode* nn)
+void MegaApiImpl::transfer_removed(Transfer *t)
 {
-    handle h = UNDEF;
-    Node *n = NULL;
-
-    if(!e && t != USER_HANDLE)
+    if(transferMap.find(t->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+    if(!transfer)
     {
-        if(client->nodenotify.size())
-        {
-            n = client->nodenotify.back();
-        }
-
-        if(n)
-        {
-            n->applykey();
-            n->setattr();
-            h = n->nodehandle;
-        }
+        return;
     }
 
-	MegaError megaError(e);
-    if(transferMap.find(client->restag) != transferMap.end())
+    if (t->type == GET)
     {
-        MegaTransferPrivate* transfer = transferMap.at(client->restag);
-        if(transfer->getType() == MegaTransfer::TYPE_DOWNLOAD)
-        {
-            return;
-        }
+        if(pendingDownloads > 0)
+            pendingDownloads--;
 
+        if(totalDownloads > 0)
+            totalDownloads--;
+    }
+    else
+    {
         if(pendingUploads > 0)
-        {
             pendingUploads--;
-        }
 
-        transfer->setNodeHandle(h);
-        fireOnTransferFinish(transfer, megaError);
-        delete [] nn;
-        return;
+        if(totalUploads > 0)
+            totalUploads--;
     }
 
-	if(requestMap.find(client->restag) == requestMap.end()) return;
-	MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_CREATE_FOLDER) &&
-                    (request->getType() != MegaRequest::TYPE_COPY))) return;
-
-	request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
-	delete [] nn;
+    fireOnTransferFinish(transfer, MegaError(transfer->getLastErrorCode()));
 }
 
-void MegaApiImpl::share_result(error e)
+void MegaApiImpl::transfer_prepare(Transfer *t)
 {
-	MegaError megaError(e);
+    if(transferMap.find(t->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(t->tag);
 
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_EXPORT) &&
-                    (request->getType() != MegaRequest::TYPE_SHARE))) return;
+	if (t->type == GET)
+		transfer->setNodeHandle(t->files.back()->h);
 
-    //exportnode_result will be called to end the request.
-	if(request->getType() == MegaRequest::TYPE_EXPORT)
-		return;
-
-    fireOnRequestFinish(request, megaError);
-}
+    string path;
+    fsAccess->local2path(&(t->files.back()->localname), &path);
+    transfer->setPath(path.c_str());
+    transfer->setTotalBytes(t->size);
 
-void MegaApiImpl::share_result(int, error)
-{
-    //The other callback will be called at the end of the request
+    LOG_info << "Transfer (" << transfer->getTransferString() << ") starting. File: " << transfer->getFileName();
 }
 
-void MegaApiImpl::setpcr_result(handle h, error e, opcactions_t action)
+void MegaApiImpl::transfer_update(Transfer *tr)
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_INVITE_CONTACT) return;
-
-    if (e)
+    if(transferMap.find(tr->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
+    if(!transfer)
     {
-        LOG_debug << "Outgoing pending contact request failed (" << megaError.getErrorString() << ")";
+        return;
     }
-    else
+
+    if(tr->slot)
     {
-        if (h == UNDEF)
-        {
-            // must have been deleted
-            LOG_debug << "Outgoing pending contact request " << (action == OPCA_DELETE ? "deleted" : "reminded") << " successfully";
-        }
-        else
+        if((transfer->getUpdateTime() != Waiter::ds) || !tr->slot->progressreported || (tr->slot->progressreported == tr->size))
         {
-            char buffer[12];
-            Base64::btoa((byte*)&h, sizeof(h), buffer);
-            LOG_debug << "Outgoing pending contact request succeeded, id: " << buffer;
-        }
-    }
+            if(!transfer->getStartTime())
+            {
+                transfer->setStartTime(Waiter::ds);
+            }
 
-    request->setNodeHandle(h);
-    request->setNumber(action);
-    fireOnRequestFinish(request, megaError);
-}
+            m_off_t deltaSize = tr->slot->progressreported - transfer->getTransferredBytes();
+            transfer->setDeltaSize(deltaSize);
 
-void MegaApiImpl::updatepcr_result(error e, ipcactions_t action)
-{
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_REPLY_CONTACT_REQUEST) return;
+            dstime currentTime = Waiter::ds;
+            long long speed = 0;
+            if(tr->type == GET)
+            {
+                totalDownloadedBytes += deltaSize;
 
-    if (e)
-    {
-        LOG_debug << "Incoming pending contact request update failed (" << megaError.getErrorString() << ")";
-    }
-    else
-    {
-        string labels[3] = {"accepted", "denied", "ignored"};
-        LOG_debug << "Incoming pending contact request successfully " << labels[(int)action];
-    }
+                while(downloadBytes.size())
+                {
+                    dstime deltaTime = currentTime - downloadTimes[0];
+                    if(deltaTime <= 50)
+                    {
+                        break;
+                    }
 
-    request->setNumber(action);
-    fireOnRequestFinish(request, megaError);
-}
+                    downloadPartialBytes -= downloadBytes[0];
+                    downloadBytes.erase(downloadBytes.begin());
+                    downloadTimes.erase(downloadTimes.begin());
+                }
 
-void MegaApiImpl::fa_complete(Node* n, fatype type, const char* data, uint32_t len)
-{
-    int tag = client->restag;
-    while(tag)
-    {
-        if(requestMap.find(tag) == requestMap.end()) return;
-        MegaRequestPrivate* request = requestMap.at(tag);
-        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE)) return;
+                downloadBytes.push_back(deltaSize);
+                downloadTimes.push_back(currentTime);
+                downloadPartialBytes += deltaSize;
 
-        tag = request->getNumber();
+                downloadSpeed = (downloadPartialBytes * 10) / 50;
+                speed = downloadSpeed;
+            }
+            else
+            {
+                totalUploadedBytes += deltaSize;
 
-        FileAccess *f = client->fsaccess->newfileaccess();
-        string filePath(request->getFile());
-        string localPath;
-        fsAccess->path2local(&filePath, &localPath);
+                while(uploadBytes.size())
+                {
+                    dstime deltaTime = currentTime - uploadTimes[0];
+                    if(deltaTime <= 50)
+                    {
+                        break;
+                    }
 
-        totalDownloadedBytes += len;
+                    uploadPartialBytes -= uploadBytes[0];
+                    uploadBytes.erase(uploadBytes.begin());
+                    uploadTimes.erase(uploadTimes.begin());
+                }
 
-        fsAccess->unlinklocal(&localPath);
-        if(!f->fopen(&localPath, false, true))
-        {
-            delete f;
-            fireOnRequestFinish(request, MegaError(API_EWRITE));
-            continue;
-        }
+                uploadBytes.push_back(deltaSize);
+                uploadTimes.push_back(currentTime);
+                uploadPartialBytes += deltaSize;
 
-        if(!f->fwrite((const byte*)data, len, 0))
-        {
-            delete f;
-            fireOnRequestFinish(request, MegaError(API_EWRITE));
-            continue;
-        }
+                uploadSpeed = (uploadPartialBytes * 10) / 50;
+                speed = uploadSpeed;
+            }
 
-        delete f;
-        fireOnRequestFinish(request, MegaError(API_OK));
-    }
-}
+            transfer->setTransferredBytes(tr->slot->progressreported);
 
-int MegaApiImpl::fa_failed(handle, fatype, int retries, error e)
-{
-    int tag = client->restag;
-    while(tag)
-    {
-        if(requestMap.find(tag) == requestMap.end()) return 1;
-        MegaRequestPrivate* request = requestMap.at(tag);
-        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE))
-            return 1;
+            if(currentTime < transfer->getStartTime())
+                transfer->setStartTime(currentTime);
 
-        tag = request->getNumber();
-        if(retries >= 2)
-        {
-            fireOnRequestFinish(request, MegaError(e));
-        }
-        else
-        {
-            fireOnRequestTemporaryError(request, MegaError(e));
-        }
-    }
+            transfer->setSpeed(speed);
+            transfer->setUpdateTime(currentTime);
+            transfer->setTimings(&tr->timings);
 
-    return (retries >= 2);
+            fireOnTransferUpdate(transfer);
+        }
+	}
 }
 
-void MegaApiImpl::putfa_result(handle, fatype, error e)
+void MegaApiImpl::transfer_failed(Transfer* tr, error e)
 {
+    if(transferMap.find(tr->tag) == transferMap.end()) return;
     MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
-        return;
-
-    fireOnRequestFinish(request, megaError);
+    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
+    transfer->setUpdateTime(Waiter::ds);
+    transfer->setDeltaSize(0);
+    transfer->setSpeed(0);
+    transfer->setLastErrorCode(e);
+    transfer->setTimings(&tr->timings);
+    fireOnTransferTemporaryError(transfer, megaError);
 }
 
-void MegaApiImpl::putfa_result(handle, fatype, const char *)
+void MegaApiImpl::transfer_limit(Transfer* t)
 {
-    MegaError megaError(API_OK);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
-        return;
-
-    fireOnRequestFinish(request, megaError);
+    if(transferMap.find(t->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+    transfer->setUpdateTime(Waiter::ds);
+    transfer->setDeltaSize(0);
+    transfer->setSpeed(0);
+    fireOnTransferTemporaryError(transfer, MegaError(API_EOVERQUOTA));
 }
 
-void MegaApiImpl::enumeratequotaitems_result(handle product, unsigned prolevel, unsigned gbstorage, unsigned gbtransfer, unsigned months, unsigned amount, const char* currency, const char* description, const char* iosid, const char* androidid)
+void MegaApiImpl::peer_lookup(handle h)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
-                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
+#ifndef WINDOWS_PHONE
+    httpServerMutex.lock();
+    if (peerCache)
     {
-        return;
+        peerCache->query(h);
     }
-
-    request->addProduct(product, prolevel, gbstorage, gbtransfer, months, amount, currency, description, iosid, androidid);
+    httpServerMutex.unlock();
+#endif
 }
 
-void MegaApiImpl::enumeratequotaitems_result(error e)
+void MegaApiImpl::transfer_complete(Transfer* tr)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
-                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
-    {
-        return;
-    }
+    if(transferMap.find(tr->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
 
-    if(request->getType() == MegaRequest::TYPE_GET_PRICING)
+    dstime currentTime = Waiter::ds;
+    if(!transfer->getStartTime())
+        transfer->setStartTime(currentTime);
+    if(currentTime<transfer->getStartTime())
+        transfer->setStartTime(currentTime);
+
+    transfer->setUpdateTime(currentTime);
+    transfer->setTimings(&tr->timings);
+
+    if(tr->size != transfer->getTransferredBytes())
     {
-        fireOnRequestFinish(request, MegaError(e));
+        long long speed = 0;
+        long long deltaTime = currentTime-transfer->getStartTime();
+        if(deltaTime<=0)
+            deltaTime = 1;
+        if(transfer->getTotalBytes()>0)
+            speed = (10*transfer->getTotalBytes())/deltaTime;
+
+        transfer->setSpeed(speed);
+        transfer->setDeltaSize(tr->size - transfer->getTransferredBytes());
+        if(tr->type == GET)
+            totalDownloadedBytes += transfer->getDeltaSize();
+        else
+            totalUploadedBytes += transfer->getDeltaSize();
+
+        transfer->setTransferredBytes(tr->size);
     }
-    else
+
+    if (tr->type == GET)
     {
-        MegaPricing *pricing = request->getPricing();
-        int i;
-        for(i = 0; i < pricing->getNumProducts(); i++)
-        {
-            if(pricing->getHandle(i) == request->getNodeHandle())
-            {
-                requestMap.erase(request->getTag());
-                int nextTag = client->nextreqtag();
-                request->setTag(nextTag);
-                requestMap[nextTag]=request;
-                client->purchase_additem(0, request->getNodeHandle(), pricing->getAmount(i),
-                                         pricing->getCurrency(i), 0, NULL, NULL);
-                break;
-            }
-        }
+        if(pendingDownloads > 0)
+            pendingDownloads--;
 
-        if(i == pricing->getNumProducts())
+        string path;
+        fsAccess->local2path(&tr->localfilename, &path);
+        transfer->setPath(path.c_str());
+
+        fireOnTransferFinish(transfer, MegaError(API_OK));
+    }
+    else
+    {
+        if(tr->size != transfer->getTransferredBytes())
         {
-            fireOnRequestFinish(request, MegaError(API_ENOENT));
+            fireOnTransferUpdate(transfer);
         }
-        delete pricing;
     }
 }
 
-void MegaApiImpl::additem_result(error e)
+dstime MegaApiImpl::pread_failure(error e, int retry, void* param)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
-                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT))) return;
-
-    if(e != API_OK)
-    {
-        client->purchase_begin();
-        fireOnRequestFinish(request, MegaError(e));
-        return;
-    }
-
-    if(request->getType() == MegaRequest::TYPE_GET_PAYMENT_ID)
-    {
-        char saleid[16];
-        Base64::btoa((byte *)&client->purchase_basket.back(), 8, saleid);
-        request->setLink(saleid);
-        client->purchase_begin();
-        fireOnRequestFinish(request, MegaError(API_OK));
-        return;
-    }
-
-    //MegaRequest::TYPE_UPGRADE_ACCOUNT
-    int method = request->getNumber();
-    client->purchase_checkout(method);
+	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
+	transfer->setUpdateTime(Waiter::ds);
+	transfer->setDeltaSize(0);
+	transfer->setSpeed(0);
+	transfer->setLastBytes(NULL);
+	if (retry < transfer->getMaxRetries())
+	{
+        fireOnTransferTemporaryError(transfer, MegaError(e));
+		return (dstime)(retry*10);
+	}
+	else
+	{
+        fireOnTransferFinish(transfer, MegaError(e));
+		return ~(dstime)0;
+	}
 }
 
-void MegaApiImpl::checkout_result(const char *errortype, error e)
+// data not owned by the engine (cached): hand over a copy
+bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t pos, void* param)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)) return;
+    string *copy = client->getreadbuffer();
+    copy->assign((const char *)buffer, len);
 
-    if(!errortype)
-    {
-        fireOnRequestFinish(request, MegaError(e));
-        return;
-    }
+    bool result = pread_buffer(&copy, len, pos, param);
 
-    if(!strcmp(errortype, "FP"))
+    if(copy)
     {
-        fireOnRequestFinish(request, MegaError(e - 100));
-        return;
+        client->releasereadbuffer(copy);
     }
 
-    fireOnRequestFinish(request, MegaError(MegaError::PAYMENT_EGENERIC));
-    return;
+    return result;
 }
 
-void MegaApiImpl::submitpurchasereceipt_result(error e)
+bool MegaApiImpl::pread_buffer(string **buffer, m_off_t len, m_off_t pos, void* param)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT)) return;
+	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
+	transfer->setUpdateTime(Waiter::ds);
+    transfer->setLastBytes((char *)(*buffer)->data());
+    transfer->setDeltaSize(len);
+    totalDownloadedBytes += len;
+	transfer->setTransferredBytes(transfer->getTransferredBytes()+len);
 
-    fireOnRequestFinish(request, MegaError(e));
-}
+	bool end = (transfer->getTransferredBytes() == transfer->getTotalBytes());
+    fireOnTransferUpdate(transfer);
 
-void MegaApiImpl::creditcardquerysubscriptions_result(int number, error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS)) return;
+    // the listener takes over the buffer
+    MegaTransferBuffer *data = new MegaTransferBufferPrivate(this, *buffer, len, pos);
+    *buffer = NULL;
 
-    request->setNumber(number);
-    fireOnRequestFinish(request, MegaError(e));
+    if(!fireOnTransferData(transfer, data) || end)
+	{
+        fireOnTransferFinish(transfer, end ? MegaError(API_OK) : MegaError(API_EINCOMPLETE));
+		return end;
+	}
+    return true;
 }
 
-void MegaApiImpl::creditcardcancelsubscriptions_result(error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS)) return;
-
-    fireOnRequestFinish(request, MegaError(e));
-}
-void MegaApiImpl::getpaymentmethods_result(int methods, error e)
+void MegaApiImpl::reportevent_result(error e)
 {
+    MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_PAYMENT_METHODS)) return;
+    if(!request || (request->getType() != MegaRequest::TYPE_REPORT_EVENT)) return;
 
-    request->setNumber(methods);
-    fireOnRequestFinish(request, MegaError(e));
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::userfeedbackstore_result(error e)
+void MegaApiImpl::loadbalancing_result(string *servers, error e)
 {
+    MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_FEEDBACK)) return;
+    if(!request || (request->getType() != MegaRequest::TYPE_LOAD_BALANCING)) return;
 
-    fireOnRequestFinish(request, MegaError(e));
+    if(!e)
+    {
+        request->setText(servers->c_str());
+    }
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::sendevent_result(error e)
+void MegaApiImpl::sessions_killed(handle, error e)
 {
+    MegaError megaError(e);
+
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SEND_EVENT)) return;
+    if(!request || (request->getType() != MegaRequest::TYPE_KILL_SESSION)) return;
 
-    fireOnRequestFinish(request, MegaError(e));
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::creditcardstore_result(error e)
+void MegaApiImpl::cleanrubbishbin_result(error e)
 {
+    MegaError megaError(e);
+
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_STORE)) return;
+    if(!request || (request->getType() != MegaRequest::TYPE_CLEAN_RUBBISH_BIN)) return;
 
-    fireOnRequestFinish(request, MegaError(e));
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::copysession_result(string *session, error e)
+#ifdef ENABLE_SYNC
+void MegaApiImpl::syncupdate_state(Sync *sync, syncstate_t newstate)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_SESSION_TRANSFER_URL)) return;
+    LOG_debug << "Sync state change: " << newstate << " Path: " << sync->localroot.name;
+    client->abortbackoff(false);
 
-    const char *path = request->getText();
-    string *data = NULL;
-    if(e == API_OK)
-    {
-        data = client->sessiontransferdata(path, session);
-    }
+    // paths of syncs being added or removed change their state
+    pathStateMutex.lock();
+    pathStates.clear();
+    pathStateMutex.unlock();
 
-    if(data)
-    {
-        data->insert(0, "https://mega.nz/#sitetransfer!");
-    }
-    else
+    if(newstate == SYNC_FAILED)
     {
-        data = new string("https://mega.nz/#");
-        if(path)
+        MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+
+        if(sync->localroot.node)
         {
-            data->append(path);
+            request->setNodeHandle(sync->localroot.node->nodehandle);
         }
+
+        int nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+        requestMap[nextTag]=request;
+        fireOnRequestFinish(request, MegaError(sync->errorcode));
     }
 
-    request->setLink(data->c_str());
-    delete data;
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    megaSync->setState(newstate);
 
-    fireOnRequestFinish(request, MegaError(e));
+    fireOnSyncStateChanged(megaSync);
 }
 
-void MegaApiImpl::clearing()
+void MegaApiImpl::syncupdate_stats(Sync *sync)
 {
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    megaSync->setStats(&sync->stats);
 
+    fireOnSyncStatsUpdated(megaSync);
 }
 
-void MegaApiImpl::notify_retry(dstime dsdelta)
+void MegaApiImpl::syncupdate_scanning(bool scanning)
 {
-#ifdef ENABLE_SYNC
-    bool previousFlag = waitingRequest;
-#endif
+    if(client)
+    {
+        client->abortbackoff(false);
+        client->syncscanstate = scanning;
+    }
+    fireOnGlobalSyncStateChanged();
+}
 
-    if(!dsdelta)
-        waitingRequest = false;
-    else if(dsdelta > 10)
-        waitingRequest = true;
+void MegaApiImpl::syncupdate_local_folder_addition(Sync *sync, LocalNode *localNode, const char* path)
+{
+    LOG_debug << "Sync - local folder addition detected: " << path;
+    client->abortbackoff(false);
 
-#ifdef ENABLE_SYNC
-    if(previousFlag != waitingRequest)
-        fireOnGlobalSyncStateChanged();
-#endif
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_ADITION);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
 }
 
-// callback for non-EAGAIN request-level errors
-// retrying is futile
-// this can occur e.g. with syntactically malformed requests (due to a bug) or due to an invalid application key
-void MegaApiImpl::request_error(error e)
+void MegaApiImpl::syncupdate_local_folder_deletion(Sync *sync, LocalNode *localNode)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT);
-    request->setFlag(false);
-    request->setParamType(e);
-    requestQueue.push(request);
-    waiter->notify();
+    client->abortbackoff(false);
+
+    string local;
+    string path;
+    localNode->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+    LOG_debug << "Sync - local folder deletion detected: " << path.c_str();
+    dropPathStates(&local, true);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_DELETION);
+    event->setPath(path.c_str());
+    fireOnSyncEvent(megaSync, event);
 }
 
-void MegaApiImpl::request_response_progress(m_off_t currentProgress, m_off_t totalProgress)
+void MegaApiImpl::syncupdate_local_file_addition(Sync *sync, LocalNode *localNode, const char* path)
 {
-    if(requestMap.size() == 1)
-    {
-        MegaRequestPrivate *request = requestMap.begin()->second;
-        if(request && request->getType() == MegaRequest::TYPE_FETCH_NODES)
-        {
-            if(request->getTransferredBytes() != currentProgress)
-            {
-                request->setTransferredBytes(currentProgress);
-                if(totalProgress != -1)
-                {
-                    request->setTotalBytes(totalProgress);
-                }
-                fireOnRequestUpdate(request);
-            }
-        }
-    }
-}
+    LOG_debug << "Sync - local file addition detected: " << path;
+    client->abortbackoff(false);
 
-// login result
-void MegaApiImpl::login_result(error result)
-{
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_LOGIN)) return;
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-    fireOnRequestFinish(request, megaError);
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_ADDITION);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
 }
 
-void MegaApiImpl::logout_result(error e)
+void MegaApiImpl::syncupdate_local_file_deletion(Sync *sync, LocalNode *localNode)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_LOGOUT)) return;
-
-    if(!e)
-    {
-        requestMap.erase(request->getTag());
-
-        error preverror = (error)request->getParamType();
-        while(!requestMap.empty())
-        {
-            std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-            if(it->second) fireOnRequestFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
-        }
+    client->abortbackoff(false);
 
-        while(!transferMap.empty())
-        {
-            std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
-            if(it->second) fireOnTransferFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
-        }
+    string local;
+    string path;
+    localNode->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+    LOG_debug << "Sync - local file deletion detected: " << path.c_str();
+    dropPathStates(&local, false);
 
-        pendingUploads = 0;
-        pendingDownloads = 0;
-        totalUploads = 0;
-        totalDownloads = 0;
-        waiting = false;
-        waitingRequest = false;
-        excludedNames.clear();
-        syncLowerSizeLimit = 0;
-        syncUpperSizeLimit = 0;
-        uploadSpeed = 0;
-        downloadSpeed = 0;
-        downloadTimes.clear();
-        downloadBytes.clear();
-        uploadTimes.clear();
-        uploadBytes.clear();
-        uploadPartialBytes = 0;
-        downloadPartialBytes = 0;
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-        fireOnRequestFinish(request, MegaError(preverror));
-        return;
-    }
-    fireOnRequestFinish(request,MegaError(e));
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_DELETION);
+    event->setPath(path.c_str());
+    fireOnSyncEvent(megaSync, event);
 }
 
-void MegaApiImpl::userdata_result(string *name, string* pubk, string* privk, handle bjid, error result)
+void MegaApiImpl::syncupdate_local_file_change(Sync *sync, LocalNode *localNode, const char* path)
 {
-    MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
+    LOG_debug << "Sync - local file change detected: " << path;
+    client->abortbackoff(false);
 
-    if(result == API_OK)
-    {
-        char jid[16];
-        Base32::btoa((byte *)&bjid, MegaClient::USERHANDLE, jid);
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-        request->setPassword(pubk->c_str());
-        request->setPrivateKey(privk->c_str());
-        request->setName(name->c_str());
-        request->setText(jid);
-    }
-    fireOnRequestFinish(request, megaError);
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_CHANGED);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
 }
 
-void MegaApiImpl::pubkey_result(User *u)
+void MegaApiImpl::syncupdate_local_move(Sync *sync, LocalNode *localNode, const char *to)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
+    client->abortbackoff(false);
 
-    if(!u)
-    {
-        fireOnRequestFinish(request, MegaError(API_ENOENT));
-        return;
-    }
+    string local;
+    string path;
+    localNode->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+    LOG_debug << "Sync - local rename/move " << path.c_str() << " -> " << to;
 
-    if(!u->pubk.isvalid())
-    {
-        fireOnRequestFinish(request, MegaError(API_EACCESS));
-        return;
-    }
+    // the paths of everything below a folder change too
+    pathStateMutex.lock();
+    pathStates.clear();
+    pathStateMutex.unlock();
 
-    string key;
-    u->pubk.serializekey(&key, AsymmCipher::PUBKEY);
-    char pubkbuf[AsymmCipher::MAXKEYLENGTH * 4 / 3 + 4];
-    Base64::btoa((byte *)key.data(), key.size(), pubkbuf);
-    request->setPassword(pubkbuf);
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-    char jid[16];
-    Base32::btoa((byte *)&u->userhandle, MegaClient::USERHANDLE, jid);
-    request->setText(jid);
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_MOVE);
+    event->setPath(path.c_str());
+    event->setNewPath(to);
+    fireOnSyncEvent(megaSync, event);
+}
 
-    if(u->email.size())
-    {
-        request->setEmail(u->email.c_str());
-    }
+void MegaApiImpl::syncupdate_get(Sync *sync, Node* node, const char *path)
+{
+    LOG_debug << "Sync - requesting file " << path;
 
-    fireOnRequestFinish(request, MegaError(API_OK));
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_GET);
+    event->setNodeHandle(node->nodehandle);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
 }
 
-// password change result
-void MegaApiImpl::changepw_result(error result)
+void MegaApiImpl::syncupdate_put(Sync *sync, LocalNode *localNode, const char *path)
 {
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_CHANGE_PW) return;
+    LOG_debug << "Sync - sending file " << path;
 
-    fireOnRequestFinish(request, megaError);
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_PUT);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
 }
 
-// node export failed
-void MegaApiImpl::exportnode_result(error result)
+void MegaApiImpl::syncupdate_remote_file_addition(Sync *sync, Node *n)
 {
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+    LOG_debug << "Sync - remote file addition detected " << n->displayname();
+    client->abortbackoff(false);
 
-    fireOnRequestFinish(request, megaError);
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_ADDITION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
 }
 
-void MegaApiImpl::exportnode_result(handle h, handle ph)
+void MegaApiImpl::syncupdate_remote_file_deletion(Sync *sync, Node *n)
 {
-    Node* n;
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+    LOG_debug << "Sync - remote file deletion detected " << n->displayname();
+    client->abortbackoff(false);
 
-    if ((n = client->nodebyhandle(h)))
-    {
-        char node[9];
-        char key[FILENODEKEYLENGTH*4/3+3];
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-        Base64::btoa((byte*)&ph,MegaClient::NODEHANDLE,node);
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_DELETION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
+}
 
-        // the key
-        if (n->type == FILENODE)
-        {
-            if(n->nodekey.size()>=FILENODEKEYLENGTH)
-                Base64::btoa((const byte*)n->nodekey.data(),FILENODEKEYLENGTH,key);
-            else
-                key[0]=0;
-        }
-        else if (n->sharekey) Base64::btoa(n->sharekey->key,FOLDERNODEKEYLENGTH,key);
-        else
-        {
-            fireOnRequestFinish(request, MegaError(MegaError::API_EKEY));
-            return;
-        }
+void MegaApiImpl::syncupdate_remote_folder_addition(Sync *sync, Node *n)
+{
+    LOG_debug << "Sync - remote folder addition detected " << n->displayname();
+    client->abortbackoff(false);
 
-        string link = "https://mega.nz/#";
-        link += (n->type ? "F" : "");
-        link += "!";
-        link += node;
-        link += "!";
-        link += key;
-        request->setLink(link.c_str());
-        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
-    }
-    else
-    {
-        request->setNodeHandle(UNDEF);
-        fireOnRequestFinish(request, MegaError(MegaError::API_ENOENT));
-    }
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_ADDITION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
 }
 
-// the requested link could not be opened
-void MegaApiImpl::openfilelink_result(error result)
+void MegaApiImpl::syncupdate_remote_folder_deletion(Sync *sync, Node *n)
 {
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
+    LOG_debug << "Sync - remote folder deletion detected " << n->displayname();
+    client->abortbackoff(false);
 
-    fireOnRequestFinish(request, megaError);
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_DELETION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
 }
 
-// the requested link was opened successfully
-// (it is the application's responsibility to delete n!)
-void MegaApiImpl::openfilelink_result(handle ph, const byte* key, m_off_t size, string* a, string*, int)
+void MegaApiImpl::syncupdate_remote_copy(Sync *, const char *name)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
+    LOG_debug << "Sync - creating remote file " << name << " by copying existing remote file";
+    client->abortbackoff(false);
+}
 
-	if (!client->loggedin() && (request->getType() == MegaRequest::TYPE_IMPORT_LINK))
-	{
-        fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
-		return;
-	}
+void MegaApiImpl::syncupdate_remote_move(Sync *sync, Node *n, Node *prevparent)
+{
+    LOG_debug << "Sync - remote move " << n->displayname() <<
+                 " from " << (prevparent ? prevparent->displayname() : "?") <<
+                 " to " << (n->parent ? n->parent->displayname() : "?");
+    client->abortbackoff(false);
 
-    string attrstring;
-    string fileName;
-    string keystring;
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-    attrstring.resize(a->length()*4/3+4);
-    attrstring.resize(Base64::btoa((const byte *)a->data(),a->length(), (char *)attrstring.data()));
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_MOVE);
+    event->setNodeHandle(n->nodehandle);
+    event->setPrevParent(prevparent ? prevparent->nodehandle : UNDEF);
+    fireOnSyncEvent(megaSync, event);
+}
 
-    m_time_t mtime = 0;
+void MegaApiImpl::syncupdate_remote_rename(Sync *sync, Node *n, const char *prevname)
+{
+    LOG_debug << "Sync - remote rename from " << prevname << " to " << n->displayname();
+    client->abortbackoff(false);
 
-    SymmCipher nodeKey;
-    keystring.assign((char*)key,FILENODEKEYLENGTH);
-    nodeKey.setkey(key, FILENODE);
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
 
-    byte *buf = Node::decryptattr(&nodeKey,attrstring.c_str(),attrstring.size());
-    if(buf)
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_RENAME);
+    event->setNodeHandle(n->nodehandle);
+    event->setPrevName(prevname);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_treestate(LocalNode *l)
+{
+    string local;
+    string path;
+    l->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+
+    pathStateMutex.lock();
+    map<string, int>::iterator it = pathStates.find(local);
+    if (it != pathStates.end())
     {
-        JSON json;
-        nameid name;
-        string* t;
-        AttrMap attrs;
+        it->second = l->ts;
+    }
+    pathStateMutex.unlock();
 
-        json.begin((char*)buf+5);
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
-            JSON::unescape(t);
+    if(syncMap.find(l->sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(l->sync->tag);
 
-        delete[] buf;
+    fireOnFileSyncStateChanged(megaSync, path.data(), (int)l->ts);
+}
 
-        attr_map::iterator it;
-        it = attrs.map.find('n');
-        if (it == attrs.map.end()) fileName = "CRYPTO_ERROR";
-        else if (!it->second.size()) fileName = "BLANK";
-        else fileName = it->second.c_str();
+bool MegaApiImpl::sync_syncable(Node *node)
+{
+    if(node->type == FILENODE && !is_syncable(node->size))
+    {
+        return false;
+    }
 
-        it = attrs.map.find('c');
-        if(it != attrs.map.end())
+    const char *name = node->displayname();
+
+    // path rules: the local path the folder would be synced to
+    if(node->type == FOLDERNODE && excludedNames.hasPathRules() && node->parent && node->parent->localnode)
+    {
+        string localpath, localname, path;
+
+        node->parent->localnode->getlocalpath(&localpath);
+        localname = name;
+        client->fsaccess->name2local(&localname);
+        localpath.append(client->fsaccess->localseparator);
+        localpath.append(localname);
+        client->fsaccess->local2path(&localpath, &path);
+
+        if(excludedNames.excludesPath(path.c_str()))
         {
-            FileFingerprint ffp;
-            if(ffp.unserializefingerprint(&it->second))
+            return false;
+        }
+    }
+
+    sdkMutex.unlock();
+    bool result = is_syncable(name);
+    sdkMutex.lock();
+    return result;
+}
+
+bool MegaApiImpl::sync_syncable(const char *name, string *localpath, string *)
+{
+    static FileAccess* f = fsAccess->newfileaccess();
+    if(f->fopen(localpath))
+    {
+        if(!is_syncable(f->size))
+        {
+            return false;
+        }
+
+        // path rules are checked once per folder (excluded folders are not scanned)
+        if(f->type == FOLDERNODE && excludedNames.hasPathRules())
+        {
+            string path;
+            fsAccess->local2path(localpath, &path);
+
+            if(excludedNames.excludesPath(path.c_str()))
             {
-                mtime = ffp.mtime;
+                return false;
             }
         }
     }
-    else fileName = "CRYPTO_ERROR";
 
-	if(request->getType() == MegaRequest::TYPE_IMPORT_LINK)
-	{
-		NewNode* newnode = new NewNode[1];
+    sdkMutex.unlock();
+    bool result =  is_syncable(name);
+    sdkMutex.lock();
+    return result;
+}
 
-		// set up new node as folder node
-		newnode->source = NEW_PUBLIC;
-		newnode->type = FILENODE;
-		newnode->nodehandle = ph;
-        newnode->parenthandle = UNDEF;
-		newnode->nodekey.assign((char*)key,FILENODEKEYLENGTH);
-        newnode->attrstring = new string(*a);
+void MegaApiImpl::syncupdate_local_lockretry(bool waiting)
+{
+    if (waiting)
+    {
+        LOG_debug << "Sync - waiting for local filesystem lock";
+    }
+    else
+    {
+        LOG_debug << "Sync - local filesystem lock issue resolved, continuing...";
+        client->abortbackoff(false);
+    }
 
-		// add node
-        requestMap.erase(request->getTag());
-        int nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-        requestMap[nextTag]=request;
-        client->putnodes(request->getParentHandle(), newnode, 1);
-	}
-	else
-	{
-        request->setPublicNode(new MegaNodePrivate(fileName.c_str(), FILENODE, size, 0, mtime, ph, &keystring, a));
-        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
-	}
+    this->waiting = waiting;
+    this->fireOnGlobalSyncStateChanged();
 }
+#endif
 
-// reload needed
-void MegaApiImpl::reload(const char*)
+
+// user addition/update (users never get deleted)
+void MegaApiImpl::users_updated(User** u, int count)
 {
-    fireOnReloadNeeded();
+    if(!count)
+    {
+        return;
+    }
+
+    MegaUserList *userList = NULL;
+    if(u != NULL)
+    {
+        userList = new MegaUserListPrivate(u, count);
+        fireOnUsersUpdate(userList);
+    }
+    else
+    {
+        fireOnUsersUpdate(NULL);
+    }
+    delete userList;
 }
 
-// nodes have been modified
-// (nodes with their removed flag set will be deleted immediately after returning from this call,
-// at which point their pointers will become invalid at that point.)
-void MegaApiImpl::nodes_updated(Node** n, int count)
+void MegaApiImpl::account_updated()
+{
+    fireOnAccountUpdate();
+}
+
+void MegaApiImpl::pcrs_updated(PendingContactRequest **r, int count)
 {
     if(!count)
     {
         return;
     }
 
-    MegaNodeList *nodeList = NULL;
-    if(n != NULL)
+    MegaContactRequestList *requestList = NULL;
+    if(r != NULL)
     {
-        nodeList = new MegaNodeListPrivate(n, count);
-        fireOnNodesUpdate(nodeList);
+        requestList = new MegaContactRequestListPrivate(r, count);
+        fireOnContactRequestsUpdate(requestList);
     }
     else
     {
-        fireOnNodesUpdate(NULL);
+        fireOnContactRequestsUpdate(NULL);
     }
-    delete nodeList;
+    delete requestList;
 }
 
-void MegaApiImpl::account_details(AccountDetails*, bool, bool, bool, bool, bool, bool)
+void MegaApiImpl::setattr_result(handle h, error e)
 {
+	MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
-
-	int numDetails = request->getNumDetails();
-	numDetails--;
-	request->setNumDetails(numDetails);
-	if(!numDetails)
+    if(request && request->getType() == MegaRequest::TYPE_SET_NODES_ATTRIBUTE)
     {
-        if(!request->getAccountDetails()->storage_max)
-            fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
-        else
-            fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+        return bulknode_result(request, e);
     }
+
+    if(!request || (request->getType() != MegaRequest::TYPE_RENAME)) return;
+
+	request->setNodeHandle(h);
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::account_details(AccountDetails*, error e)
+void MegaApiImpl::rename_result(handle h, error e)
 {
 	MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
+    if(!request || (request->getType() != MegaRequest::TYPE_MOVE)) return;
 
+    request->setNodeHandle(h);
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::invite_result(error e)
+void MegaApiImpl::unlink_result(handle h, error e)
 {
 	MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_ADD_CONTACT) &&
-                    (request->getType() != MegaRequest::TYPE_REMOVE_CONTACT))) return;
+    if(!request || (request->getType() != MegaRequest::TYPE_REMOVE)) return;
 
+    request->setNodeHandle(h);
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::putua_result(error e)
+void MegaApiImpl::fetchnodes_result(error e)
 {
     MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SET_ATTR_USER)) return;
+    MegaRequestPrivate* request;
+    if (!client->restag)
+    {
+        if (!e)
+        {
+            restoreQueuedDownloads();
+        }
+
+        request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES);
+        fireOnRequestFinish(request, megaError);
+        return;
+    }
+
+    if (requestMap.find(client->restag) == requestMap.end())
+    {
+        return;
+    }
+    request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_FETCH_NODES))
+    {
+        return;
+    }
+
+    if (!e)
+    {
+        restoreQueuedDownloads();
+    }
 
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::getua_result(error e)
+void MegaApiImpl::fetchchildren_result(handle, error e)
 {
-	MegaError megaError(e);
-	if(requestMap.find(client->restag) == requestMap.end()) return;
-	MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
+    MegaError megaError(e);
+
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_FETCH_FOLDER)) return;
 
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::getua_result(byte* data, unsigned len)
+void MegaApiImpl::putnodes_result(error e, targettype_t t, NewNode* nn)
 {
-	if(requestMap.find(client->restag) == requestMap.end()) return;
-	MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
+    handle h = UNDEF;
+    Node *n = NULL;
 
-    if(request->getParamType() == 0)
+    if(!e && t != USER_HANDLE)
     {
-        FileAccess *f = client->fsaccess->newfileaccess();
-        string filePath(request->getFile());
-        string localPath;
-        fsAccess->path2local(&filePath, &localPath);
-
-        totalDownloadedBytes += len;
+        if(nn && nn->added)
+        {
+            // the first record is the new node or the root of the new tree
+            // (possibly created in several batches, or a single upload
+            // record of a batched putnodes)
+            n = client->nodebyhandle(nn->addedhandle);
+        }
+        else if(client->nodenotify.size())
+        {
+            n = client->nodenotify.back();
+        }
 
-        fsAccess->unlinklocal(&localPath);
-        if(!f->fopen(&localPath, false, true))
+        if(n)
         {
-            delete f;
-            fireOnRequestFinish(request, MegaError(API_EWRITE));
-            return;
+            n->applykey();
+            n->setattr();
+            h = n->nodehandle;
         }
+    }
 
-        if(!f->fwrite((const byte*)data, len, 0))
+	MegaError megaError(e);
+
+    map<int, vector<MegaTransferPrivate *> >::iterator bit = uploadCopyBatches.find(client->restag);
+    if(bit != uploadCopyBatches.end())
+    {
+        // batch of uploads completed by server-side copy
+        vector<MegaTransferPrivate *> transfers = bit->second;
+        uploadCopyBatches.erase(bit);
+
+        for(unsigned i = 0; i < transfers.size(); i++)
         {
-            delete f;
-            fireOnRequestFinish(request, MegaError(API_EWRITE));
-            return;
+            if(pendingUploads > 0)
+            {
+                pendingUploads--;
+            }
+
+            bool added = !e && nn && nn[i].added;
+
+            if(added)
+            {
+                Node *copy = client->nodebyhandle(nn[i].addedhandle);
+
+                if(copy)
+                {
+                    copy->applykey();
+                    copy->setattr();
+                }
+
+                transfers[i]->setTransferredBytes(transfers[i]->getTotalBytes());
+            }
+
+            transfers[i]->setNodeHandle(added ? nn[i].addedhandle : UNDEF);
+            fireOnTransferFinish(transfers[i], added ? megaError : MegaError(e ? e : API_EINTERNAL));
         }
 
-        delete f;
+        delete [] nn;
+        return;
     }
-    else
+
+    if(transferMap.find(client->restag) != transferMap.end())
     {
-        string str((const char*)data,len);
-        request->setText(str.c_str());
+        MegaTransferPrivate* transfer = transferMap.at(client->restag);
+        if(transfer->getType() == MegaTransfer::TYPE_DOWNLOAD)
+        {
+            return;
+        }
+
+        if(pendingUploads > 0)
+        {
+            pendingUploads--;
+        }
+
+        transfer->setNodeHandle(h);
+        fireOnTransferFinish(transfer, megaError);
+        delete [] nn;
+        return;
     }
-    fireOnRequestFinish(request, MegaError(API_OK));
-}
 
-// user attribute update notification
-void MegaApiImpl::userattr_update(User*, int, const char*)
-{
+	if(requestMap.find(client->restag) == requestMap.end()) return;
+	MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_CREATE_FOLDER) &&
+                    (request->getType() != MegaRequest::TYPE_COPY))) return;
 
+	request->setNodeHandle(h);
+    fireOnRequestFinish(request, megaError);
+	delete [] nn;
 }
 
-void MegaApiImpl::ephemeral_result(error e)
+void MegaApiImpl::share_result(error e)
 {
 	MegaError megaError(e);
+
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+    if(!request || ((request->getType() != MegaRequest::TYPE_EXPORT) &&
+                    (request->getType() != MegaRequest::TYPE_SHARE))) return;
+
+    //exportnode_result will be called to end the request.
+	if(request->getType() == MegaRequest::TYPE_EXPORT)
+		return;
 
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::ephemeral_result(handle, const byte*)
+void MegaApiImpl::share_result(int, error)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
-
-    requestMap.erase(request->getTag());
-    int nextTag = client->nextreqtag();
-    request->setTag(nextTag);
-    requestMap[nextTag] = request;
-
-	byte pwkey[SymmCipher::KEYLENGTH];
-    if(!request->getPrivateKey())
-		client->pw_key(request->getPassword(),pwkey);
-	else
-		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
-
-    client->sendsignuplink(request->getEmail(),request->getName(),pwkey);
+    //The other callback will be called at the end of the request
 }
 
-void MegaApiImpl::sendsignuplink_result(error e)
+void MegaApiImpl::setpcr_result(handle h, error e, opcactions_t action)
 {
-	MegaError megaError(e);
+    MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+    if(!request || request->getType() != MegaRequest::TYPE_INVITE_CONTACT) return;
 
-    requestMap.erase(request->getTag());
-    while(!requestMap.empty())
+    if (e)
     {
-        std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-        if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
+        LOG_debug << "Outgoing pending contact request failed (" << megaError.getErrorString() << ")";
     }
-
-    while(!transferMap.empty())
+    else
     {
-        std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
-        if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
+        if (h == UNDEF)
+        {
+            // must have been deleted
+            LOG_debug << "Outgoing pending contact request " << (action == OPCA_DELETE ? "deleted" : "reminded") << " successfully";
+        }
+        else
+        {
+            char buffer[12];
+            Base64::btoa((byte*)&h, sizeof(h), buffer);
+            LOG_debug << "Outgoing pending contact request succeeded, id: " << buffer;
+        }
     }
 
-    client->locallogout();
+    request->setNodeHandle(h);
+    request->setNumber(action);
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::querysignuplink_result(error e)
+void MegaApiImpl::updatepcr_result(error e, ipcactions_t action)
 {
-	MegaError megaError(e);
+    MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
+    if(!request || request->getType() != MegaRequest::TYPE_REPLY_CONTACT_REQUEST) return;
+
+    if (e)
+    {
+        LOG_debug << "Incoming pending contact request update failed (" << megaError.getErrorString() << ")";
+    }
+    else
+    {
+        string labels[3] = {"accepted", "denied", "ignored"};
+        LOG_debug << "Incoming pending contact request successfully " << labels[(int)action];
+    }
 
+    request->setNumber(action);
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::querysignuplink_result(handle, const char* email, const char* name, const byte* pwc, const byte*, const byte* c, size_t len)
+void MegaApiImpl::fa_complete(Node* n, fatype type, const char* data, uint32_t len)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
-
-	request->setEmail(email);
-	request->setName(name);
+    int tag = client->restag;
+    while(tag)
+    {
+        if(requestMap.find(tag) == requestMap.end()) return;
+        MegaRequestPrivate* request = requestMap.at(tag);
+        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE)) return;
 
-	if(request->getType() == MegaRequest::TYPE_QUERY_SIGNUP_LINK)
-	{
-        fireOnRequestFinish(request, MegaError(API_OK));
-		return;
-	}
+        tag = request->getNumber();
 
-	string signupemail = email;
-	string signupcode;
-	signupcode.assign((char*)c,len);
+        FileAccess *f = client->fsaccess->newfileaccess();
+        string filePath(request->getFile());
+        string localPath;
+        fsAccess->path2local(&filePath, &localPath);
 
-	byte signuppwchallenge[SymmCipher::KEYLENGTH];
-	byte signupencryptedmasterkey[SymmCipher::KEYLENGTH];
+        totalDownloadedBytes += len;
 
-	memcpy(signuppwchallenge,pwc,sizeof signuppwchallenge);
-	memcpy(signupencryptedmasterkey,pwc,sizeof signupencryptedmasterkey);
+        fsAccess->unlinklocal(&localPath);
+        if(!f->fopen(&localPath, false, true))
+        {
+            delete f;
+            fireOnRequestFinish(request, MegaError(API_EWRITE));
+            continue;
+        }
 
-	byte pwkey[SymmCipher::KEYLENGTH];
-    if(!request->getPrivateKey())
-		client->pw_key(request->getPassword(),pwkey);
-	else
-		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
+        if(!f->fwrite((const byte*)data, len, 0))
+        {
+            delete f;
+            fireOnRequestFinish(request, MegaError(API_EWRITE));
+            continue;
+        }
 
-	// verify correctness of supplied signup password
-	SymmCipher pwcipher(pwkey);
-	pwcipher.ecb_decrypt(signuppwchallenge);
+        delete f;
+        fireOnRequestFinish(request, MegaError(API_OK));
+    }
+}
 
-	if (*(uint64_t*)(signuppwchallenge+4))
-	{
-        fireOnRequestFinish(request, MegaError(API_ENOENT));
-	}
-	else
-	{
-		// decrypt and set master key, then proceed with the confirmation
-		pwcipher.ecb_decrypt(signupencryptedmasterkey);
-		client->key.setkey(signupencryptedmasterkey);
+int MegaApiImpl::fa_failed(handle, fatype, int retries, error e)
+{
+    int tag = client->restag;
+    while(tag)
+    {
+        if(requestMap.find(tag) == requestMap.end()) return 1;
+        MegaRequestPrivate* request = requestMap.at(tag);
+        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE))
+            return 1;
 
-        requestMap.erase(request->getTag());
-        int nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-        requestMap[nextTag] = request;
+        tag = request->getNumber();
+        if(retries >= 2)
+        {
+            fireOnRequestFinish(request, MegaError(e));
+        }
+        else
+        {
+            fireOnRequestTemporaryError(request, MegaError(e));
+        }
+    }
 
-		client->confirmsignuplink((const byte*)signupcode.data(),signupcode.size(),MegaClient::stringhash64(&signupemail,&pwcipher));
-	}
+    return (retries >= 2);
 }
 
-void MegaApiImpl::confirmsignuplink_result(error e)
+void MegaApiImpl::putfa_result(handle, fatype, error e)
 {
-	MegaError megaError(e);
+    MegaError megaError(e);
     if(requestMap.find(client->restag) == requestMap.end()) return;
     MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request) return;
+    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
+        return;
 
     fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::setkeypair_result(error e)
+void MegaApiImpl::putfa_result(handle, fatype, const char *)
 {
+    MegaError megaError(API_OK);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
+        return;
 
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::checkfile_result(handle h, error e)
+void MegaApiImpl::enumeratequotaitems_result(handle product, unsigned prolevel, unsigned gbstorage, unsigned gbtransfer, unsigned months, unsigned amount, const char* currency, const char* description, const char* iosid, const char* androidid)
 {
-    if(e)
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
+                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
     {
-        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
-        {
-            MegaTransferPrivate *transfer = iter->second;
-            if(transfer->getNodeHandle() == h)
-                fireOnTransferTemporaryError(transfer, MegaError(e));
-        }
+        return;
     }
+
+    request->addProduct(product, prolevel, gbstorage, gbtransfer, months, amount, currency, description, iosid, androidid);
 }
 
-void MegaApiImpl::checkfile_result(handle h, error e, byte*, m_off_t, m_time_t, m_time_t, string*, string*, string*)
+void MegaApiImpl::enumeratequotaitems_result(error e)
 {
-    if(e)
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
+                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
     {
-        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
+        return;
+    }
+
+    if(request->getType() == MegaRequest::TYPE_GET_PRICING)
+    {
+        fireOnRequestFinish(request, MegaError(e));
+    }
+    else
+    {
+        MegaPricing *pricing = request->getPricing();
+        int i;
+        for(i = 0; i < pricing->getNumProducts(); i++)
         {
-            MegaTransferPrivate *transfer = iter->second;
-            if(transfer->getNodeHandle() == h)
-                fireOnTransferTemporaryError(transfer, MegaError(e));
+            if(pricing->getHandle(i) == request->getNodeHandle())
+            {
+                requestMap.erase(request->getTag());
+                int nextTag = client->nextreqtag();
+                request->setTag(nextTag);
+                requestMap[nextTag]=request;
+                client->purchase_additem(0, request->getNodeHandle(), pricing->getAmount(i),
+                                         pricing->getCurrency(i), 0, NULL, NULL);
+                break;
+            }
+        }
+
+        if(i == pricing->getNumProducts())
+        {
+            fireOnRequestFinish(request, MegaError(API_ENOENT));
         }
+        delete pricing;
     }
 }
 
-void MegaApiImpl::addListener(MegaListener* listener)
+void MegaApiImpl::additem_result(error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
+                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT))) return;
 
-    sdkMutex.lock();
-    listeners.insert(listener);
-    sdkMutex.unlock();
-}
+    if(e != API_OK)
+    {
+        client->purchase_begin();
+        fireOnRequestFinish(request, MegaError(e));
+        return;
+    }
 
-void MegaApiImpl::addRequestListener(MegaRequestListener* listener)
-{
-    if(!listener) return;
+    if(request->getType() == MegaRequest::TYPE_GET_PAYMENT_ID)
+    {
+        char saleid[16];
+        Base64::btoa((byte *)&client->purchase_basket.back(), 8, saleid);
+        request->setLink(saleid);
+        client->purchase_begin();
+        fireOnRequestFinish(request, MegaError(API_OK));
+        return;
+    }
 
-    sdkMutex.lock();
-    requestListeners.insert(listener);
-    sdkMutex.unlock();
+    //MegaRequest::TYPE_UPGRADE_ACCOUNT
+    int method = request->getNumber();
+    client->purchase_checkout(method);
 }
 
-void MegaApiImpl::addTransferListener(MegaTransferListener* listener)
+void MegaApiImpl::checkout_result(const char *errortype, error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)) return;
 
-    sdkMutex.lock();
-    transferListeners.insert(listener);
-    sdkMutex.unlock();
+    if(!errortype)
+    {
+        fireOnRequestFinish(request, MegaError(e));
+        return;
+    }
+
+    if(!strcmp(errortype, "FP"))
+    {
+        fireOnRequestFinish(request, MegaError(e - 100));
+        return;
+    }
+
+    fireOnRequestFinish(request, MegaError(MegaError::PAYMENT_EGENERIC));
+    return;
 }
 
-void MegaApiImpl::addGlobalListener(MegaGlobalListener* listener)
+void MegaApiImpl::submitpurchasereceipt_result(error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT)) return;
 
-    sdkMutex.lock();
-    globalListeners.insert(listener);
-    sdkMutex.unlock();
+    fireOnRequestFinish(request, MegaError(e));
 }
 
-#ifdef ENABLE_SYNC
-void MegaApiImpl::addSyncListener(MegaSyncListener *listener)
+void MegaApiImpl::creditcardquerysubscriptions_result(int number, error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS)) return;
 
-    sdkMutex.lock();
-    syncListeners.insert(listener);
-    sdkMutex.unlock();
+    request->setNumber(number);
+    fireOnRequestFinish(request, MegaError(e));
 }
 
-void MegaApiImpl::removeSyncListener(MegaSyncListener *listener)
+void MegaApiImpl::creditcardcancelsubscriptions_result(error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS)) return;
 
-    sdkMutex.lock();
-    syncListeners.erase(listener);
+    fireOnRequestFinish(request, MegaError(e));
+}
+void MegaApiImpl::getpaymentmethods_result(int methods, error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_PAYMENT_METHODS)) return;
 
-    std::map<int, MegaSyncPrivate*>::iterator it = syncMap.begin();
-    while(it != syncMap.end())
-    {
-        MegaSyncPrivate* sync = it->second;
-        if(sync->getListener() == listener)
-            sync->setListener(NULL);
+    request->setNumber(methods);
+    fireOnRequestFinish(request, MegaError(e));
+}
 
-        it++;
-    }
-    requestQueue.removeListener(listener);
+void MegaApiImpl::userfeedbackstore_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_FEEDBACK)) return;
 
-    sdkMutex.unlock();
+    fireOnRequestFinish(request, MegaError(e));
 }
-#endif
 
-void MegaApiImpl::removeListener(MegaListener* listener)
+void MegaApiImpl::sendevent_result(error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SEND_EVENT)) return;
 
-    sdkMutex.lock();
-    listeners.erase(listener);
-    sdkMutex.unlock();
+    fireOnRequestFinish(request, MegaError(e));
 }
 
-void MegaApiImpl::removeRequestListener(MegaRequestListener* listener)
+void MegaApiImpl::creditcardstore_result(error e)
 {
-    if(!listener) return;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_STORE)) return;
 
-    sdkMutex.lock();
-    requestListeners.erase(listener);
+    fireOnRequestFinish(request, MegaError(e));
+}
 
-    std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-    while(it != requestMap.end())
-    {
-        MegaRequestPrivate* request = it->second;
-        if(request->getListener() == listener)
-            request->setListener(NULL);
+void MegaApiImpl::copysession_result(string *session, error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_SESSION_TRANSFER_URL)) return;
 
-        it++;
+    const char *path = request->getText();
+    string *data = NULL;
+    if(e == API_OK)
+    {
+        data = client->sessiontransferdata(path, session);
     }
 
-    requestQueue.removeListener(listener);
-    sdkMutex.unlock();
-}
+    if(data)
+    {
+        data->insert(0, "https://mega.nz/#sitetransfer!");
+    }
+    else
+    {
+        data = new string("https://mega.nz/#");
+        if(path)
+        {
+            data->append(path);
+        }
+    }
 
-void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
-{
-    if(!listener) return;
+    request->setLink(data->c_str());
+    delete data;
 
-    sdkMutex.lock();
-    transferListeners.erase(listener);
-    sdkMutex.unlock();
+    fireOnRequestFinish(request, MegaError(e));
 }
 
-void MegaApiImpl::removeGlobalListener(MegaGlobalListener* listener)
+void MegaApiImpl::clearing()
 {
-    if(!listener) return;
 
-    sdkMutex.lock();
-    globalListeners.erase(listener);
-    sdkMutex.unlock();
 }
 
-MegaRequest *MegaApiImpl::getCurrentRequest()
+void MegaApiImpl::notify_retry(dstime dsdelta)
 {
-    return activeRequest;
-}
-
-MegaTransfer *MegaApiImpl::getCurrentTransfer()
-{
-    return activeTransfer;
-}
+#ifdef ENABLE_SYNC
+    bool previousFlag = waitingRequest;
+#endif
 
-MegaError *MegaApiImpl::getCurrentError()
-{
-    return activeError;
+    if(!dsdelta)
+        waitingRequest = false;
+    else if(dsdelta > 10)
+        waitingRequest = true;
+
+#ifdef ENABLE_SYNC
+    if(previousFlag != waitingRequest)
+        fireOnGlobalSyncStateChanged();
+#endif
 }
 
-MegaNodeList *MegaApiImpl::getCurrentNodes()
+// callback for non-EAGAIN request-level errors
+// retrying is futile
+// this can occur e.g. with syntactically malformed requests (due to a bug) or due to an invalid application key
+void MegaApiImpl::request_error(error e)
 {
-    return activeNodes;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT);
+    request->setFlag(false);
+    request->setParamType(e);
+    if(requestQueue.push(request)) waiter->notify();
 }
 
-MegaUserList *MegaApiImpl::getCurrentUsers()
+void MegaApiImpl::request_response_progress(m_off_t currentProgress, m_off_t totalProgress)
 {
-    return activeUsers;
+    if(requestMap.size() == 1)
+    {
+        MegaRequestPrivate *request = requestMap.begin()->second;
+        if(request && request->getType() == MegaRequest::TYPE_FETCH_NODES)
+        {
+            if(request->getTransferredBytes() != currentProgress)
+            {
+                request->setTransferredBytes(currentProgress);
+                if(totalProgress != -1)
+                {
+                    request->setTotalBytes(totalProgress);
+                }
+                fireOnRequestUpdate(request);
+            }
+        }
+    }
 }
 
-void MegaApiImpl::fireOnRequestStart(MegaRequestPrivate *request)
+// login result
+void MegaApiImpl::login_result(error result)
 {
-    activeRequest = request;
-    LOG_info << "Request (" << request->getRequestString() << ") starting";
-	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-		(*it)->onRequestStart(api, request);
-
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onRequestStart(api, request);
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_LOGIN)) return;
 
-	MegaRequestListener* listener = request->getListener();
-	if(listener) listener->onRequestStart(api, request);
-	activeRequest = NULL;
+    fireOnRequestFinish(request, megaError);
 }
 
-
-void MegaApiImpl::fireOnRequestFinish(MegaRequestPrivate *request, MegaError e)
+void MegaApiImpl::logout_result(error e)
 {
-	MegaError *megaError = new MegaError(e);
-	activeRequest = request;
-	activeError = megaError;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_LOGOUT)) return;
 
-    if(e.getErrorCode())
-    {
-        LOG_warn << "Request (" << request->getRequestString() << ") finished with error: " << e.getErrorString();
-    }
-    else
+    if(!e)
     {
-        LOG_info << "Request (" << request->getRequestString() << ") finished";
-    }
-
-	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-		(*it)->onRequestFinish(api, request, megaError);
+        requestMap.erase(request->getTag());
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onRequestFinish(api, request, megaError);
+        error preverror = (error)request->getParamType();
+        while(!requestMap.empty())
+        {
+            std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+            if(it->second) fireOnRequestFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
+        }
 
-	MegaRequestListener* listener = request->getListener();
-	if(listener) listener->onRequestFinish(api, request, megaError);
+        while(!transferMap.empty())
+        {
+            std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
+            if(it->second) fireOnTransferFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
+        }
 
-    requestMap.erase(request->getTag());
+        pendingUploads = 0;
+        pendingDownloads = 0;
+        totalUploads = 0;
+        totalDownloads = 0;
+        transferStats = MegaTransferStatsPrivate();
+        waiting = false;
+        waitingRequest = false;
+#ifdef ENABLE_SYNC
+        excludedNames.clear();
+#endif
+        syncLowerSizeLimit = 0;
+        syncUpperSizeLimit = 0;
+        uploadSpeed = 0;
+        downloadSpeed = 0;
+        downloadTimes.clear();
+        downloadBytes.clear();
+        uploadTimes.clear();
+        uploadBytes.clear();
+        uploadPartialBytes = 0;
+        downloadPartialBytes = 0;
 
-	activeRequest = NULL;
-	activeError = NULL;
-	delete request;
-    delete megaError;
+        fireOnRequestFinish(request, MegaError(preverror));
+        return;
+    }
+    fireOnRequestFinish(request,MegaError(e));
 }
 
-void MegaApiImpl::fireOnRequestUpdate(MegaRequestPrivate *request)
+void MegaApiImpl::userdata_result(string *name, string* pubk, string* privk, handle bjid, error result)
 {
-    activeRequest = request;
-
-    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-        (*it)->onRequestUpdate(api, request);
-
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onRequestUpdate(api, request);
+    MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
 
-    MegaRequestListener* listener = request->getListener();
-    if(listener) listener->onRequestUpdate(api, request);
+    if(result == API_OK)
+    {
+        char jid[16];
+        Base32::btoa((byte *)&bjid, MegaClient::USERHANDLE, jid);
 
-    activeRequest = NULL;
+        request->setPassword(pubk->c_str());
+        request->setPrivateKey(privk->c_str());
+        request->setName(name->c_str());
+        request->setText(jid);
+    }
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::fireOnRequestTemporaryError(MegaRequestPrivate *request, MegaError e)
+void MegaApiImpl::pubkey_result(User *u)
 {
-	MegaError *megaError = new MegaError(e);
-	activeRequest = request;
-	activeError = megaError;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
 
-    request->setNumRetry(request->getNumRetry() + 1);
+    if(!u)
+    {
+        fireOnRequestFinish(request, MegaError(API_ENOENT));
+        return;
+    }
 
-	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-		(*it)->onRequestTemporaryError(api, request, megaError);
+    if(!u->pubk.isvalid())
+    {
+        fireOnRequestFinish(request, MegaError(API_EACCESS));
+        return;
+    }
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onRequestTemporaryError(api, request, megaError);
+    string key;
+    u->pubk.serializekey(&key, AsymmCipher::PUBKEY);
+    char pubkbuf[AsymmCipher::MAXKEYLENGTH * 4 / 3 + 4];
+    Base64::btoa((byte *)key.data(), key.size(), pubkbuf);
+    request->setPassword(pubkbuf);
 
-	MegaRequestListener* listener = request->getListener();
-	if(listener) listener->onRequestTemporaryError(api, request, megaError);
+    char jid[16];
+    Base32::btoa((byte *)&u->userhandle, MegaClient::USERHANDLE, jid);
+    request->setText(jid);
 
-	activeRequest = NULL;
-	activeError = NULL;
-	delete megaError;
+    if(u->email.size())
+    {
+        request->setEmail(u->email.c_str());
+    }
+
+    fireOnRequestFinish(request, MegaError(API_OK));
 }
 
-void MegaApiImpl::fireOnTransferStart(MegaTransferPrivate *transfer)
+// password change result
+void MegaApiImpl::changepw_result(error result)
 {
-	activeTransfer = transfer;
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_CHANGE_PW) return;
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferStart(api, transfer);
+    fireOnRequestFinish(request, megaError);
+}
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferStart(api, transfer);
+// node export failed
+void MegaApiImpl::exportnode_result(error result)
+{
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(request && request->getType() == MegaRequest::TYPE_EXPORT_NODES)
+    {
+        return bulknode_result(request, result);
+    }
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferStart(api, transfer);
+    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
 
-	activeTransfer = NULL;
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::fireOnTransferFinish(MegaTransferPrivate *transfer, MegaError e)
+bool MegaApiImpl::exportlink(Node* n, handle ph, string* link)
 {
-	MegaError *megaError = new MegaError(e);
-	activeTransfer = transfer;
-	activeError = megaError;
+    char node[9];
+    char key[FILENODEKEYLENGTH*4/3+3];
 
-    if(e.getErrorCode())
+    Base64::btoa((byte*)&ph,MegaClient::NODEHANDLE,node);
+
+    // the key
+    if (n->type == FILENODE)
     {
-        LOG_warn << "Transfer (" << transfer->getTransferString() << ") finished with error: " << e.getErrorString()
-                    << " File: " << transfer->getFileName();
+        if(n->nodekey.size()>=FILENODEKEYLENGTH)
+            Base64::btoa((const byte*)n->nodekey.data(),FILENODEKEYLENGTH,key);
+        else
+            key[0]=0;
     }
+    else if (n->sharekey) Base64::btoa(n->sharekey->key,FOLDERNODEKEYLENGTH,key);
     else
     {
-        LOG_info << "Transfer (" << transfer->getTransferString() << ") finished. File: " << transfer->getFileName();
+        return false;
     }
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferFinish(api, transfer, megaError);
+    *link = "https://mega.nz/#";
+    *link += (n->type ? "F" : "");
+    *link += "!";
+    *link += node;
+    *link += "!";
+    *link += key;
+    return true;
+}
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferFinish(api, transfer, megaError);
+void MegaApiImpl::exportnode_result(handle h, handle ph)
+{
+    Node* n;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(request && request->getType() == MegaRequest::TYPE_EXPORT_NODES)
+    {
+        string link;
+        if (!(n = client->nodebyhandle(h)))
+        {
+            return bulknode_result(request, API_ENOENT);
+        }
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferFinish(api, transfer, megaError);
+        if (!exportlink(n, ph, &link))
+        {
+            return bulknode_result(request, API_EKEY);
+        }
 
-    transferMap.erase(transfer->getTag());
+        return bulknode_result(request, API_OK, link.c_str());
+    }
 
-	activeTransfer = NULL;
-	activeError = NULL;
-	delete transfer;
-	delete megaError;
+    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+
+    if ((n = client->nodebyhandle(h)))
+    {
+        string link;
+        if (!exportlink(n, ph, &link))
+        {
+            fireOnRequestFinish(request, MegaError(MegaError::API_EKEY));
+            return;
+        }
+
+        request->setLink(link.c_str());
+        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+    }
+    else
+    {
+        request->setNodeHandle(UNDEF);
+        fireOnRequestFinish(request, MegaError(MegaError::API_ENOENT));
+    }
 }
 
-void MegaApiImpl::fireOnTransferTemporaryError(MegaTransferPrivate *transfer, MegaError e)
+void MegaApiImpl::bulknode_result(MegaRequestPrivate *request, error e, const char *link)
 {
-	MegaError *megaError = new MegaError(e);
-	activeTransfer = transfer;
-	activeError = megaError;
-
-    transfer->setNumRetry(transfer->getNumRetry() + 1);
+    request->setNodeResult(request->nextPendingNode(), e, link);
+    if (request->getNumPendingNodes())
+    {
+        return;
+    }
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferTemporaryError(api, transfer, megaError);
+    // the request fails with the error of the first node that failed
+    MegaNodeList *nodes = request->getMegaNodeList();
+    error result = API_OK;
+    for (int i = 0; nodes && i < nodes->size(); i++)
+    {
+        if (request->getNodeErrorCode(i))
+        {
+            result = (error)request->getNodeErrorCode(i);
+            break;
+        }
+    }
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferTemporaryError(api, transfer, megaError);
+    fireOnRequestFinish(request, MegaError(result));
+}
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferTemporaryError(api, transfer, megaError);
+// the requested link could not be opened
+void MegaApiImpl::openfilelink_result(error result)
+{
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
 
-	activeTransfer = NULL;
-	activeError = NULL;
-	delete megaError;
+    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::fireOnTransferUpdate(MegaTransferPrivate *transfer)
+// the requested link was opened successfully
+// (it is the application's responsibility to delete n!)
+void MegaApiImpl::openfilelink_result(handle ph, const byte* key, m_off_t size, string* a, string*, int)
 {
-	activeTransfer = transfer;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferUpdate(api, transfer);
+	if (!client->loggedin() && (request->getType() == MegaRequest::TYPE_IMPORT_LINK))
+	{
+        fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
+		return;
+	}
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferUpdate(api, transfer);
+    string attrstring;
+    string fileName;
+    string keystring;
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferUpdate(api, transfer);
+    attrstring.resize(a->length()*4/3+4);
+    attrstring.resize(Base64::btoa((const byte *)a->data(),a->length(), (char *)attrstring.data()));
 
-	activeTransfer = NULL;
-}
+    m_time_t mtime = 0;
 
-bool MegaApiImpl::fireOnTransferData(MegaTransferPrivate *transfer)
-{
-	activeTransfer = transfer;
-	bool result = false;
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener)
-		result = listener->onTransferData(api, transfer, transfer->getLastBytes(), transfer->getDeltaSize());
+    SymmCipher nodeKey;
+    keystring.assign((char*)key,FILENODEKEYLENGTH);
+    nodeKey.setkey(key, FILENODE);
 
-	activeTransfer = NULL;
-	return result;
-}
+    byte *buf = Node::decryptattr(&nodeKey,attrstring.c_str(),attrstring.size());
+    if(buf)
+    {
+        JSON json;
+        nameid name;
+        string* t;
+        AttrMap attrs;
 
-void MegaApiImpl::fireOnUsersUpdate(MegaUserList *users)
-{
-	activeUsers = users;
+        json.begin((char*)buf+5);
+        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+            JSON::unescape(t);
 
-	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-    {
-        (*it)->onUsersUpdate(api, users);
-    }
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-    {
-        (*it)->onUsersUpdate(api, users);
+        delete[] buf;
+
+        attr_map::iterator it;
+        it = attrs.map.find('n');
+        if (it == attrs.map.end()) fileName = "CRYPTO_ERROR";
+        else if (!it->second.size()) fileName = "BLANK";
+        else fileName = it->second.c_str();
+
+        it = attrs.map.find('c');
+        if(it != attrs.map.end())
+        {
+            FileFingerprint ffp;
+            if(ffp.unserializefingerprint(&it->second))
+            {
+                mtime = ffp.mtime;
+            }
+        }
     }
+    else fileName = "CRYPTO_ERROR";
 
-    activeUsers = NULL;
+	if(request->getType() == MegaRequest::TYPE_IMPORT_LINK)
+	{
+		NewNode* newnode = new NewNode[1];
+
+		// set up new node as folder node
+		newnode->source = NEW_PUBLIC;
+		newnode->type = FILENODE;
+		newnode->nodehandle = ph;
+        newnode->parenthandle = UNDEF;
+		newnode->nodekey.assign((char*)key,FILENODEKEYLENGTH);
+        newnode->attrstring = new string(*a);
+
+		// add node
+        requestMap.erase(request->getTag());
+        int nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+        requestMap[nextTag]=request;
+        client->putnodes(request->getParentHandle(), newnode, 1);
+	}
+	else
+	{
+        request->setPublicNode(new MegaNodePrivate(fileName.c_str(), FILENODE, size, 0, mtime, ph, &keystring, a));
+        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+	}
 }
 
-void MegaApiImpl::fireOnContactRequestsUpdate(MegaContactRequestList *requests)
+// reload needed
+void MegaApiImpl::reload(const char*)
 {
-    activeContactRequests = requests;
+    fireOnReloadNeeded();
+}
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+// nodes have been modified
+// (nodes with their removed flag set will be deleted immediately after returning from this call,
+// at which point their pointers will become invalid at that point.)
+void MegaApiImpl::nodes_updated(Node** n, int count)
+{
+    if(!count)
     {
-        (*it)->onContactRequestsUpdate(api, requests);
+        return;
     }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+
+    // renamed, moved or removed nodes invalidate the resolved paths
+    bool pathsChanged = !n;
+    for(int i = 0; n && i < count && !pathsChanged; i++)
     {
-        (*it)->onContactRequestsUpdate(api, requests);
+        pathsChanged = n[i]->changed.removed || n[i]->changed.attrs || n[i]->changed.parent;
     }
 
-    activeContactRequests = NULL;
-}
-
-void MegaApiImpl::fireOnNodesUpdate(MegaNodeList *nodes)
-{
-	activeNodes = nodes;
-
-	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    if(pathsChanged)
     {
-        (*it)->onNodesUpdate(api, nodes);
+        pathCache.clear();
     }
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+
+    if(deltasEnabled)
     {
-        (*it)->onNodesUpdate(api, nodes);
-    }
+        deltaMutex.lock();
 
-    activeNodes = NULL;
-}
+        if(!n)
+        {
+            deltaOrder.clear();
+            deltaChanges.clear();
+            deltaReload = true;
+        }
+        else if(!deltaReload)
+        {
+            for(int i = 0; i < count; i++)
+            {
+                map<handle, int>::iterator it = deltaChanges.find(n[i]->nodehandle);
 
-void MegaApiImpl::fireOnAccountUpdate()
-{
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+                if(it != deltaChanges.end())
+                {
+                    it->second |= MegaNodeRecord::changesof(n[i]);
+                }
+                else if(deltaChanges.size() >= deltaLimit)
+                {
+                    // the application falls behind: drop it all, it reloads
+                    LOG_warn << "Too many pending node changes, requesting a reload";
+                    deltaOrder.clear();
+                    deltaChanges.clear();
+                    deltaReload = true;
+                    break;
+                }
+                else
+                {
+                    deltaChanges[n[i]->nodehandle] = MegaNodeRecord::changesof(n[i]);
+                    deltaOrder.push_back(n[i]->nodehandle);
+                }
+            }
+        }
+
+        if(!deltaAnnounced && deltaSince == NEVER)
+        {
+            deltaSince = Waiter::ds;
+            client->appwakeupds = deltaSince + deltaWindow;
+        }
+
+        deltaMutex.unlock();
+        return;
+    }
+
+    MegaNodeList *nodeList = NULL;
+    if(n != NULL)
     {
-        (*it)->onAccountUpdate(api);
+        nodeList = new MegaNodeListPrivate(n, count);
+        fireOnNodesUpdate(nodeList);
     }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    else
     {
-        (*it)->onAccountUpdate(api);
+        fireOnNodesUpdate(NULL);
     }
+    delete nodeList;
 }
 
-void MegaApiImpl::fireOnReloadNeeded()
+void MegaApiImpl::announceNodeDeltas()
 {
-	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-		(*it)->onReloadNeeded(api);
+    if(deltaSince == NEVER || Waiter::ds < deltaSince + deltaWindow)
+    {
+        return;
+    }
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onReloadNeeded(api);
+    deltaMutex.lock();
+    deltaSince = NEVER;
+    deltaAnnounced = true;
+    client->appwakeupds = NEVER;
+    deltaMutex.unlock();
+
+    fireOnNodeDeltasAvailable();
 }
 
-#ifdef ENABLE_SYNC
-void MegaApiImpl::fireOnSyncStateChanged(MegaSyncPrivate *sync)
+void MegaApiImpl::enableNodeDeltas(bool enable, int coalesceMs, int maxPending)
 {
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onSyncStateChanged(api, sync);
+    sdkMutex.lock();
+    deltaMutex.lock();
 
-    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
-        (*it)->onSyncStateChanged(api, sync);
+    deltasEnabled = enable;
+    deltaWindow = coalesceMs > 0 ? (coalesceMs + 99) / 100 : 0;
+    deltaLimit = maxPending > 0 ? maxPending : 1;
 
-    MegaSyncListener* listener = sync->getListener();
-    if(listener)
+    if(!enable)
     {
-        listener->onSyncStateChanged(api, sync);
+        deltaOrder.clear();
+        deltaChanges.clear();
+        deltaReload = false;
+        deltaSince = NEVER;
+        deltaAnnounced = false;
+        client->appwakeupds = NEVER;
     }
+
+    deltaMutex.unlock();
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::fireOnSyncEvent(MegaSyncPrivate *sync, MegaSyncEvent *event)
+void MegaApiImpl::setCallbackThreads(int numThreads)
 {
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onSyncEvent(api, sync, event);
-
-    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
-        (*it)->onSyncEvent(api, sync, event);
+    if(numThreads <= 0) return;
+    if(numThreads > MegaCallbackDispatcher::MAXTHREADS) numThreads = MegaCallbackDispatcher::MAXTHREADS;
 
-    MegaSyncListener* listener = sync->getListener();
-    if(listener)
+    sdkMutex.lock();
+    if(!callbackDispatcher)
     {
-        listener->onSyncEvent(api, sync, event);
+        callbackDispatcher = new MegaCallbackDispatcher(api, numThreads);
     }
+    sdkMutex.unlock();
+}
 
-    delete event;
-}
-
-void MegaApiImpl::fireOnGlobalSyncStateChanged()
-{
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onGlobalSyncStateChanged(api);
-
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-        (*it)->onGlobalSyncStateChanged(api);
-}
-
-void MegaApiImpl::fireOnFileSyncStateChanged(MegaSyncPrivate *sync, const char *filePath, int newState)
+MegaNodeDeltaList *MegaApiImpl::getNodeDeltas(int max)
 {
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+    deltaMutex.lock();
 
-    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
-        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+    MegaNodeDeltaListPrivate *list = new MegaNodeDeltaListPrivate(deltaReload);
+    deltaReload = false;
 
-    MegaSyncListener* listener = sync->getListener();
-    if(listener)
+    size_t num = deltaOrder.size();
+    if(max > 0 && (size_t)max < num)
     {
-        listener->onSyncFileStateChanged(api, sync, filePath, newState);
+        num = max;
     }
-}
-
-#endif
 
-MegaError MegaApiImpl::checkAccess(MegaNode* megaNode, int level)
-{
-    if(!megaNode || level < MegaShare::ACCESS_UNKNOWN || level > MegaShare::ACCESS_OWNER)
+    list->deltas.reserve(num);
+    while(num--)
     {
-        return MegaError(API_EARGS);
-    }
+        handle h = deltaOrder.front();
+        map<handle, int>::iterator it = deltaChanges.find(h);
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return MegaError(API_ENOENT);
-	}
+        list->deltas.push_back(pair<MegaHandle, int>(h, it->second));
+        deltaChanges.erase(it);
+        deltaOrder.pop_front();
+    }
 
-    accesslevel_t a = OWNER;
-    switch(level)
+    // drained: the next change starts a new window
+    if(!deltaOrder.size())
     {
-    	case MegaShare::ACCESS_UNKNOWN:
-    	case MegaShare::ACCESS_READ:
-    		a = RDONLY;
-    		break;
-    	case MegaShare::ACCESS_READWRITE:
-    		a = RDWR;
-    		break;
-    	case MegaShare::ACCESS_FULL:
-    		a = FULL;
-    		break;
-    	case MegaShare::ACCESS_OWNER:
-    		a = OWNER;
-    		break;
+        deltaAnnounced = false;
     }
 
-	MegaError e(client->checkaccess(node, a) ? API_OK : API_EACCESS);
-    sdkMutex.unlock();
+    deltaMutex.unlock();
 
-	return e;
+    return list;
 }
 
-MegaError MegaApiImpl::checkMove(MegaNode* megaNode, MegaNode* targetNode)
+long long MegaApiImpl::getNodeChangeSequence()
 {
-	if(!megaNode || !targetNode) return MegaError(API_EARGS);
-
     sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-	Node *target = client->nodebyhandle(targetNode->getHandle());
-	if(!node || !target)
-	{
-        sdkMutex.unlock();
-        return MegaError(API_ENOENT);
-	}
-
-	MegaError e(client->checkmove(node,target));
+    long long sequence = client->journalnext();
     sdkMutex.unlock();
 
-	return e;
-}
-
-bool MegaApiImpl::nodeComparatorDefaultASC (Node *i, Node *j)
-{
-    if(i->type < j->type) return 0;
-    if(i->type > j->type) return 1;
-    if(strcasecmp(i->displayname(), j->displayname())<=0) return 1;
-	return 0;
+    return sequence;
 }
 
-bool MegaApiImpl::nodeComparatorDefaultDESC (Node *i, Node *j)
+MegaNodeDeltaList *MegaApiImpl::getNodeChanges(long long sequence, int max)
 {
-    if(i->type < j->type) return 1;
-    if(i->type > j->type) return 0;
-    if(strcasecmp(i->displayname(), j->displayname())<=0) return 0;
-	return 1;
-}
+    sdkMutex.lock();
 
-bool MegaApiImpl::nodeComparatorSizeASC (Node *i, Node *j)
-{ if(i->size < j->size) return 1; return 0;}
-bool MegaApiImpl::nodeComparatorSizeDESC (Node *i, Node *j)
-{ if(i->size < j->size) return 0; return 1;}
+    uint64_t next = client->journalnext();
+    uint64_t oldest = client->journal.size() ? client->journal.front().seq : next;
+    uint64_t seq = (uint64_t)sequence;
 
-bool MegaApiImpl::nodeComparatorCreationASC  (Node *i, Node *j)
-{ if(i->ctime < j->ctime) return 1; return 0;}
-bool MegaApiImpl::nodeComparatorCreationDESC  (Node *i, Node *j)
-{ if(i->ctime < j->ctime) return 0; return 1;}
+    if(sequence <= 0 || seq < oldest || seq > next)
+    {
+        MegaNodeDeltaListPrivate *list = new MegaNodeDeltaListPrivate(true);
+        list->sequence = next;
+        sdkMutex.unlock();
+        return list;
+    }
 
-bool MegaApiImpl::nodeComparatorModificationASC  (Node *i, Node *j)
-{ if(i->mtime < j->mtime) return 1; return 0;}
-bool MegaApiImpl::nodeComparatorModificationDESC  (Node *i, Node *j)
-{ if(i->mtime < j->mtime) return 0; return 1;}
+    uint64_t end = next;
+    if(max > 0 && seq + max < end)
+    {
+        end = seq + max;
+    }
 
-bool MegaApiImpl::nodeComparatorAlphabeticalASC  (Node *i, Node *j)
-{ if(strcasecmp(i->displayname(), j->displayname())<=0) return 1; return 0; }
-bool MegaApiImpl::nodeComparatorAlphabeticalDESC  (Node *i, Node *j)
-{ if(strcasecmp(i->displayname(), j->displayname())<=0) return 0; return 1; }
+    MegaNodeDeltaListPrivate *list = new MegaNodeDeltaListPrivate(false);
+    list->sequence = end;
 
-int MegaApiImpl::getNumChildren(MegaNode* p)
-{
-	if (!p) return 0;
+    // merged by handle, in order of first change
+    map<handle, size_t> positions;
+    for(uint64_t i = seq - oldest; i < end - oldest; i++)
+    {
+        const MegaClient::NodeChange &c = client->journal[i];
+        map<handle, size_t>::iterator it = positions.find(c.h);
 
-	sdkMutex.lock();
-	Node *parent = client->nodebyhandle(p->getHandle());
-	if (!parent)
-	{
-		sdkMutex.unlock();
-		return 0;
-	}
+        if(it != positions.end())
+        {
+            list->deltas[it->second].second |= c.changes;
+        }
+        else
+        {
+            positions[c.h] = list->deltas.size();
+            list->deltas.push_back(pair<MegaHandle, int>(c.h, c.changes));
+        }
+    }
 
-	int numChildren = parent->children.size();
-	sdkMutex.unlock();
+    sdkMutex.unlock();
 
-	return numChildren;
+    return list;
 }
 
-int MegaApiImpl::getNumChildFiles(MegaNode* p)
+void MegaApiImpl::account_details(AccountDetails*, bool, bool, bool, bool, bool, bool)
 {
-	if (!p) return 0;
-
-	sdkMutex.lock();
-	Node *parent = client->nodebyhandle(p->getHandle());
-	if (!parent)
-	{
-		sdkMutex.unlock();
-		return 0;
-	}
-
-	int numFiles = 0;
-	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-	{
-		if ((*it)->type == FILENODE)
-			numFiles++;
-	}
-	sdkMutex.unlock();
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
 
-	return numFiles;
+	int numDetails = request->getNumDetails();
+	numDetails--;
+	request->setNumDetails(numDetails);
+	if(!numDetails)
+    {
+        if(!request->getAccountDetails()->storage_max)
+            fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
+        else
+            fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+    }
 }
 
-int MegaApiImpl::getNumChildFolders(MegaNode* p)
+void MegaApiImpl::account_details(AccountDetails*, error e)
 {
-	if (!p) return 0;
-
-	sdkMutex.lock();
-	Node *parent = client->nodebyhandle(p->getHandle());
-	if (!parent)
-	{
-		sdkMutex.unlock();
-		return 0;
-	}
-
-	int numFolders = 0;
-	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-	{
-		if ((*it)->type != FILENODE)
-			numFolders++;
-	}
-	sdkMutex.unlock();
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
 
-	return numFolders;
+    fireOnRequestFinish(request, megaError);
 }
 
-
-MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
+void MegaApiImpl::invite_result(error e)
 {
-    if(!p) return new MegaNodeListPrivate();
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_ADD_CONTACT) &&
+                    (request->getType() != MegaRequest::TYPE_REMOVE_CONTACT))) return;
 
-    sdkMutex.lock();
-    Node *parent = client->nodebyhandle(p->getHandle());
-	if(!parent)
-	{
-        sdkMutex.unlock();
-        return new MegaNodeListPrivate();
-	}
+    fireOnRequestFinish(request, megaError);
+}
 
-    vector<Node *> childrenNodes;
+void MegaApiImpl::putua_result(error e)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SET_ATTR_USER)) return;
 
-    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
-	{
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-            childrenNodes.push_back(*it++);
-	}
-	else
-	{
-        bool (*comp)(Node*, Node*);
-		switch(order)
-		{
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-		}
+    fireOnRequestFinish(request, megaError);
+}
 
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-		{
-            Node *n = *it++;
-            vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-					childrenNodes.end(), n, comp);
-            childrenNodes.insert(i, n);
-		}
-	}
-    sdkMutex.unlock();
+void MegaApiImpl::getua_result(error e)
+{
+	MegaError megaError(e);
+	if(requestMap.find(client->restag) == requestMap.end()) return;
+	MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
 
-    if(childrenNodes.size()) return new MegaNodeListPrivate(childrenNodes.data(), childrenNodes.size());
-    else return new MegaNodeListPrivate();
+    fireOnRequestFinish(request, megaError);
 }
 
-int MegaApiImpl::getIndex(MegaNode *n, int order)
+void MegaApiImpl::getua_result(byte* data, unsigned len)
 {
-    if(!n)
-    {
-        return -1;
-    }
+	if(requestMap.find(client->restag) == requestMap.end()) return;
+	MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node)
+    if(request->getParamType() == 0)
     {
-        sdkMutex.unlock();
-        return -1;
-    }
+        FileAccess *f = client->fsaccess->newfileaccess();
+        string filePath(request->getFile());
+        string localPath;
+        fsAccess->path2local(&filePath, &localPath);
 
-    Node *parent = node->parent;
-    if(!parent)
-    {
-        sdkMutex.unlock();
-        return -1;
-    }
+        totalDownloadedBytes += len;
 
+        fsAccess->unlinklocal(&localPath);
+        if(!f->fopen(&localPath, false, true))
+        {
+            delete f;
+            fireOnRequestFinish(request, MegaError(API_EWRITE));
+            return;
+        }
 
-    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
-    {
-        sdkMutex.unlock();
-        return 0;
-    }
+        if(!f->fwrite((const byte*)data, len, 0))
+        {
+            delete f;
+            fireOnRequestFinish(request, MegaError(API_EWRITE));
+            return;
+        }
 
-    bool (*comp)(Node*, Node*);
-    switch(order)
-    {
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
+        delete f;
     }
-
-    vector<Node *> childrenNodes;
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+    else
     {
-        Node *temp = *it++;
-        vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-                childrenNodes.end(), temp, comp);
-        childrenNodes.insert(i, temp);
+        string str((const char*)data,len);
+        request->setText(str.c_str());
     }
-
-    vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-            childrenNodes.end(), node, comp);
-
-    sdkMutex.unlock();
-    return i - childrenNodes.begin();
+    fireOnRequestFinish(request, MegaError(API_OK));
 }
 
-MegaNode *MegaApiImpl::getChildNode(MegaNode *parent, const char* name)
+// user attribute update notification
+void MegaApiImpl::userattr_update(User*, int, const char*)
 {
-    if(!parent || !name)
-    {
-        return NULL;
-    }
-
-    sdkMutex.lock();
-    Node *parentNode = client->nodebyhandle(parent->getHandle());
-	if(!parentNode)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
 
-    MegaNode *node = MegaNodePrivate::fromNode(client->childnodebyname(parentNode, name));
-    sdkMutex.unlock();
-    return node;
 }
 
-Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint)
+void MegaApiImpl::ephemeral_result(error e)
 {
-    if(!fingerprint || !fingerprint[0]) return NULL;
-
-    m_off_t size = 0;
-    unsigned int fsize = strlen(fingerprint);
-    unsigned int ssize = fingerprint[0] - 'A';
-    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
-        return NULL;
-
-    int len =  sizeof(size) + 1;
-    byte *buf = new byte[len];
-    Base64::atob(fingerprint + 1, buf, len);
-    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
-    delete [] buf;
-    if(l <= 0)
-        return NULL;
-
-    string sfingerprint = fingerprint + ssize + 1;
-
-    FileFingerprint fp;
-    if(!fp.unserializefingerprint(&sfingerprint))
-        return NULL;
-
-    fp.size = size;
-
-    sdkMutex.lock();
-    Node *n  = client->nodebyfingerprint(&fp);
-    sdkMutex.unlock();
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
 
-    return n;
+    fireOnRequestFinish(request, megaError);
 }
 
-Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint, Node *parent)
+void MegaApiImpl::ephemeral_result(handle, const byte*)
 {
-    if(!fingerprint || !fingerprint[0]) return NULL;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
 
-    m_off_t size = 0;
-    unsigned int fsize = strlen(fingerprint);
-    unsigned int ssize = fingerprint[0] - 'A';
-    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
-        return NULL;
+    requestMap.erase(request->getTag());
+    int nextTag = client->nextreqtag();
+    request->setTag(nextTag);
+    requestMap[nextTag] = request;
 
-    int len =  sizeof(size) + 1;
-    byte *buf = new byte[len];
-    Base64::atob(fingerprint + 1, buf, len);
-    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
-    delete [] buf;
-    if(l <= 0)
-        return NULL;
+	byte pwkey[SymmCipher::KEYLENGTH];
+    if(!request->getPrivateKey())
+		client->pw_key(request->getPassword(),pwkey);
+	else
+		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
 
-    string sfingerprint = fingerprint + ssize + 1;
+    client->sendsignuplink(request->getEmail(),request->getName(),pwkey);
+}
 
-    FileFingerprint fp;
-    if(!fp.unserializefingerprint(&sfingerprint))
-        return NULL;
+void MegaApiImpl::sendsignuplink_result(error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
 
-    fp.size = size;
+    requestMap.erase(request->getTag());
+    while(!requestMap.empty())
+    {
+        std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+        if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
+    }
 
-    sdkMutex.lock();
-    Node *n  = client->nodebyfingerprint(&fp);
-    if(n && parent && n->parent != parent)
+    while(!transferMap.empty())
     {
-        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-        {
-            Node* node = (*it);
-            if(*((FileFingerprint *)node) == *((FileFingerprint *)n))
-            {
-                n = node;
-                break;
-            }
-        }
+        std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
+        if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
     }
-    sdkMutex.unlock();
 
-    return n;
+    client->locallogout();
+    fireOnRequestFinish(request, megaError);
 }
 
-MegaNode* MegaApiImpl::getParentNode(MegaNode* n)
+void MegaApiImpl::querysignuplink_result(error e)
 {
-    if(!n) return NULL;
-
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
-
-    MegaNode *result = MegaNodePrivate::fromNode(node->parent);
-    sdkMutex.unlock();
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
 
-	return result;
+    fireOnRequestFinish(request, megaError);
 }
 
-char* MegaApiImpl::getNodePath(MegaNode *node)
+void MegaApiImpl::querysignuplink_result(handle, const char* email, const char* name, const byte* pwc, const byte*, const byte* c, size_t len)
 {
-    if(!node) return NULL;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
 
-    sdkMutex.lock();
-    Node *n = client->nodebyhandle(node->getHandle());
-    if(!n)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
+	request->setEmail(email);
+	request->setName(name);
 
-	string path;
-	if (n->nodehandle == client->rootnodes[0])
+	if(request->getType() == MegaRequest::TYPE_QUERY_SIGNUP_LINK)
 	{
-		path = "/";
-        sdkMutex.unlock();
-        return stringToArray(path);
+        fireOnRequestFinish(request, MegaError(API_OK));
+		return;
 	}
 
-	while (n)
-	{
-		switch (n->type)
-		{
-		case FOLDERNODE:
-			path.insert(0,n->displayname());
+	string signupemail = email;
+	string signupcode;
+	signupcode.assign((char*)c,len);
 
-			if (n->inshare)
-			{
-				path.insert(0,":");
-				if (n->inshare->user) path.insert(0,n->inshare->user->email);
-				else path.insert(0,"UNKNOWN");
-                sdkMutex.unlock();
-                return stringToArray(path);
-			}
-			break;
+	byte signuppwchallenge[SymmCipher::KEYLENGTH];
+	byte signupencryptedmasterkey[SymmCipher::KEYLENGTH];
 
-		case INCOMINGNODE:
-			path.insert(0,"//in");
-            sdkMutex.unlock();
-            return stringToArray(path);
+	memcpy(signuppwchallenge,pwc,sizeof signuppwchallenge);
+	memcpy(signupencryptedmasterkey,pwc,sizeof signupencryptedmasterkey);
 
-		case ROOTNODE:
-            sdkMutex.unlock();
-            return stringToArray(path);
+	byte pwkey[SymmCipher::KEYLENGTH];
+    if(!request->getPrivateKey())
+		client->pw_key(request->getPassword(),pwkey);
+	else
+		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
 
-		case RUBBISHNODE:
-			path.insert(0,"//bin");
-            sdkMutex.unlock();
-            return stringToArray(path);
+	// verify correctness of supplied signup password
+	SymmCipher pwcipher(pwkey);
+	pwcipher.ecb_decrypt(signuppwchallenge);
 
-		case TYPE_UNKNOWN:
-		case FILENODE:
-			path.insert(0,n->displayname());
-		}
+	if (*(uint64_t*)(signuppwchallenge+4))
+	{
+        fireOnRequestFinish(request, MegaError(API_ENOENT));
+	}
+	else
+	{
+		// decrypt and set master key, then proceed with the confirmation
+		pwcipher.ecb_decrypt(signupencryptedmasterkey);
+		client->key.setkey(signupencryptedmasterkey);
 
-		path.insert(0,"/");
+        requestMap.erase(request->getTag());
+        int nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+        requestMap[nextTag] = request;
 
-        n = n->parent;
+		client->confirmsignuplink((const byte*)signupcode.data(),signupcode.size(),MegaClient::stringhash64(&signupemail,&pwcipher));
 	}
-    sdkMutex.unlock();
-    return stringToArray(path);
 }
 
-MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
+void MegaApiImpl::confirmsignuplink_result(error e)
 {
-    if(!path) return NULL;
-
-    sdkMutex.lock();
-    Node *cwd = NULL;
-    if(node) cwd = client->nodebyhandle(node->getHandle());
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request) return;
 
-	vector<string> c;
-	string s;
-	int l = 0;
-	const char* bptr = path;
-	int remote = 0;
-	Node* n;
-	Node* nn;
+    fireOnRequestFinish(request, megaError);
+}
 
-	// split path by / or :
-	do {
-		if (!l)
-		{
-			if (*path >= 0)
-			{
-				if (*path == '\\')
-				{
-                    if (path > bptr)
-                    {
-                        s.append(bptr, path - bptr);
-                    }
+void MegaApiImpl::setkeypair_result(error e)
+{
 
-					bptr = ++path;
+}
 
-					if (*bptr == 0)
-					{
-						c.push_back(s);
-						break;
-					}
-
-					path++;
-					continue;
-				}
-
-				if (*path == '/' || *path == ':' || !*path)
-				{
-					if (*path == ':')
-					{
-						if (c.size())
-						{
-                            sdkMutex.unlock();
-                            return NULL;
-						}
-						remote = 1;
-					}
-
-                    if (path > bptr)
-                    {
-                        s.append(bptr, path - bptr);
-                    }
-
-                    bptr = path + 1;
-
-					c.push_back(s);
-
-					s.erase();
-				}
-			}
-            else if ((*path & 0xf0) == 0xe0)
-            {
-                l = 1;
-            }
-            else if ((*path & 0xf8) == 0xf0)
-            {
-                l = 2;
-            }
-            else if ((*path & 0xfc) == 0xf8)
-            {
-                l = 3;
-            }
-            else if ((*path & 0xfe) == 0xfc)
-            {
-                l = 4;
-            }
-		}
-        else
+void MegaApiImpl::checkfile_result(handle h, error e)
+{
+    if(e)
+    {
+        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
         {
-            l--;
+            MegaTransferPrivate *transfer = iter->second;
+            if(transfer->getNodeHandle() == h)
+                fireOnTransferTemporaryError(transfer, MegaError(e));
         }
-	} while (*path++);
-
-	if (l)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
-
-	if (remote)
-	{
-        // target: user inbox - it's not a node - return NULL
-		if (c.size() == 2 && !c[1].size())
-		{
-            sdkMutex.unlock();
-            return NULL;
-		}
-
-		User* u;
+    }
+}
 
-        if ((u = client->finduser(c[0].c_str())))
+void MegaApiImpl::checkfile_result(handle h, error e, byte*, m_off_t, m_time_t, m_time_t, string*, string*, string*)
+{
+    if(e)
+    {
+        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
         {
-            // locate matching share from this user
-            handle_set::iterator sit;
-            string name;
-            for (sit = u->sharing.begin(); sit != u->sharing.end(); sit++)
-            {
-                if ((n = client->nodebyhandle(*sit)))
-                {
-                    if(!name.size())
-                    {
-                        name =  c[1];
-                        n->client->fsaccess->normalize(&name);
-                    }
-
-                    if (!strcmp(name.c_str(), n->displayname()))
-                    {
-                        l = 2;
-                        break;
-                    }
-                }
-            }
+            MegaTransferPrivate *transfer = iter->second;
+            if(transfer->getNodeHandle() == h)
+                fireOnTransferTemporaryError(transfer, MegaError(e));
         }
+    }
+}
 
-		if (!l)
-		{
-            sdkMutex.unlock();
-            return NULL;
-		}
-	}
-	else
-	{
-		// path starting with /
-		if (c.size() > 1 && !c[0].size())
-		{
-			// path starting with //
-			if (c.size() > 2 && !c[1].size())
-			{
-                if (c[2] == "in")
-                {
-                    n = client->nodebyhandle(client->rootnodes[1]);
-                }
-                else if (c[2] == "bin")
-                {
-                    n = client->nodebyhandle(client->rootnodes[2]);
-                }
-				else
-				{
-                    sdkMutex.unlock();
-                    return NULL;
-				}
+void MegaApiImpl::addListener(MegaListener* listener)
+{
+    if(!listener) return;
 
-				l = 3;
-			}
-			else
-			{
-				n = client->nodebyhandle(client->rootnodes[0]);
-				l = 1;
-			}
-		}
-        else
-        {
-            n = cwd;
-        }
-	}
+    sdkMutex.lock();
+    listeners.insert(listener);
+    sdkMutex.unlock();
+}
 
-	// parse relative path
-	while (n && l < (int)c.size())
-	{
-		if (c[l] != ".")
-		{
-			if (c[l] == "..")
-			{
-                if (n->parent)
-                {
-                    n = n->parent;
-                }
-			}
-			else
-			{
-				// locate child node (explicit ambiguity resolution: not implemented)
-				if (c[l].size())
-				{
-                    nn = client->childnodebyname(n, c[l].c_str());
+void MegaApiImpl::addRequestListener(MegaRequestListener* listener)
+{
+    if(!listener) return;
 
-					if (!nn)
-					{
-                        sdkMutex.unlock();
-                        return NULL;
-					}
+    sdkMutex.lock();
+    requestListeners.insert(listener);
+    sdkMutex.unlock();
+}
 
-					n = nn;
-				}
-			}
-		}
+void MegaApiImpl::addTransferListener(MegaTransferListener* listener)
+{
+    if(!listener) return;
 
-		l++;
-	}
+    sdkMutex.lock();
+    transferListeners.insert(listener);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::addGlobalListener(MegaGlobalListener* listener)
+{
+    if(!listener) return;
 
-    MegaNode *result = MegaNodePrivate::fromNode(n);
+    sdkMutex.lock();
+    globalListeners.insert(listener);
     sdkMutex.unlock();
-    return result;
 }
 
-MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
+#ifdef ENABLE_SYNC
+void MegaApiImpl::addSyncListener(MegaSyncListener *listener)
 {
-	if(handle == UNDEF) return NULL;
+    if(!listener) return;
+
     sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+    syncListeners.insert(listener);
     sdkMutex.unlock();
-    return result;
 }
 
-MegaContactRequest *MegaApiImpl::getContactRequestByHandle(MegaHandle handle)
+void MegaApiImpl::removeSyncListener(MegaSyncListener *listener)
 {
+    if(!listener) return;
+
     sdkMutex.lock();
-    if(client->pcrindex.find(handle) == client->pcrindex.end())
+    syncListeners.erase(listener);
+
+    std::map<int, MegaSyncPrivate*>::iterator it = syncMap.begin();
+    while(it != syncMap.end())
     {
-        sdkMutex.unlock();
-        return NULL;
+        MegaSyncPrivate* sync = it->second;
+        if(sync->getListener() == listener)
+            sync->setListener(NULL);
+
+        it++;
     }
-    MegaContactRequest* request = MegaContactRequestPrivate::fromContactRequest(client->pcrindex.at(handle));
+    requestQueue.removeListener(listener);
+
     sdkMutex.unlock();
-    return request;
+
+    if(callbackDispatcher) callbackDispatcher->removeListener(listener);
 }
+#endif
 
-void MegaApiImpl::sendPendingTransfers()
+void MegaApiImpl::removeListener(MegaListener* listener)
 {
-	MegaTransferPrivate *transfer;
-	error e;
-	int nextTag;
+    if(!listener) return;
 
-	while((transfer = transferQueue.pop()))
-	{
-		sdkMutex.lock();
-		e = API_OK;
-        nextTag = client->nextreqtag();
+    sdkMutex.lock();
+    listeners.erase(listener);
+    sdkMutex.unlock();
 
-		switch(transfer->getType())
-		{
-			case MegaTransfer::TYPE_UPLOAD:
-			{
-                const char* localPath = transfer->getPath();
-                const char* fileName = transfer->getFileName();
-                int64_t mtime = transfer->getTime();
-                Node *parent = client->nodebyhandle(transfer->getParentHandle());
-
-                if(!localPath || !parent || !fileName || !(*fileName))
-                {
-                    e = API_EARGS;
-                    break;
-                }
+    if(callbackDispatcher) callbackDispatcher->removeListener(listener);
+}
 
-                currentTransfer = transfer;
-				string tmpString = localPath;
-				string wLocalPath;
-				client->fsaccess->path2local(&tmpString, &wLocalPath);
+void MegaApiImpl::removeRequestListener(MegaRequestListener* listener)
+{
+    if(!listener) return;
 
-                string wFileName = fileName;
-                MegaFilePut *f = new MegaFilePut(client, &wLocalPath, &wFileName, transfer->getParentHandle(), "", mtime);
+    sdkMutex.lock();
+    requestListeners.erase(listener);
 
-                bool started = client->startxfer(PUT,f);
-                if(!started)
-                {
-                    //Unable to read the file
-                    transfer->setSyncTransfer(false);
-                    transferMap[nextTag]=transfer;
-                    transfer->setTag(nextTag);
-                    fireOnTransferStart(transfer);
-                    fireOnTransferFinish(transfer, MegaError(API_EREAD));
-                }
-                else if(transfer->getTag() == -1)
-                {
-                    //Already existing transfer
-                    //Delete the new one and set the transfer as regular
-                    transfer_map::iterator it = client->transfers[PUT].find(f);
-                    if(it != client->transfers[PUT].end())
-                    {
-                        int previousTag = it->second->tag;
-                        if(transferMap.find(previousTag) != transferMap.end())
-                        {
-                            MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
-                            previousTransfer->setSyncTransfer(false);
-                            delete transfer;
-                        }
-                    }
-                }
-                currentTransfer=NULL;
-				break;
-			}
-			case MegaTransfer::TYPE_DOWNLOAD:
-			{
-                handle nodehandle = transfer->getNodeHandle();
-				Node *node = client->nodebyhandle(nodehandle);
-                MegaNode *publicNode = transfer->getPublicNode();
-                const char *parentPath = transfer->getParentPath();
-                const char *fileName = transfer->getFileName();
-                if(!node && !publicNode) { e = API_EARGS; break; }
+    std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+    while(it != requestMap.end())
+    {
+        MegaRequestPrivate* request = it->second;
+        if(request->getListener() == listener)
+            request->setListener(NULL);
 
-                currentTransfer=transfer;
-                if(parentPath || fileName)
-                {
-                    string name;
-                    string securename;
-                    string path;
+        it++;
+    }
 
-					if(parentPath)
-					{
-						path = parentPath;
-					}
-					else
-					{
-						string separator;
-						client->fsaccess->local2path(&client->fsaccess->localseparator, &separator);
-						path = ".";
-						path.append(separator);
-					}
+    requestQueue.removeListener(listener);
+    sdkMutex.unlock();
 
-					MegaFileGet *f;
+    if(callbackDispatcher) callbackDispatcher->removeListener(listener);
+}
 
-					if(node)
-					{
-						if(!fileName)
-                        {
-                            attr_map::iterator ait = node->attrs.map.find('n');
-                            if(ait == node->attrs.map.end())
-                            {
-                                name = "CRYPTO_ERROR";
-                            }
-                            else if(!ait->second.size())
-                            {
-                                name = "BLANK";
-                            }
-                            else
-                            {
-                                name = ait->second;
-                            }
-                        }
-                        else
-                        {
-                            name = fileName;
-                        }
+void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
+{
+    if(!listener) return;
 
-                        client->fsaccess->name2local(&name);
-                        client->fsaccess->local2path(&name, &securename);
-                        path += securename;
-						f = new MegaFileGet(client, node, path);
-					}
-					else
-					{
-						if(!transfer->getFileName())
-                            name = publicNode->getName();
-                        else
-                            name = transfer->getFileName();
+    sdkMutex.lock();
+    transferListeners.erase(listener);
+    sdkMutex.unlock();
 
-                        client->fsaccess->name2local(&name);
-                        client->fsaccess->local2path(&name, &securename);
-                        path += securename;
-						f = new MegaFileGet(client, publicNode, path);
-					}
+    if(callbackDispatcher) callbackDispatcher->removeListener(listener);
+}
 
-					transfer->setPath(path.c_str());
-					client->startxfer(GET,f);
-                    if(transfer->getTag() == -1)
-                    {
-                        //Already existing transfer
-                        //Delete the new one and set the transfer as regular
-                        transfer_map::iterator it = client->transfers[GET].find(f);
-                        if(it != client->transfers[GET].end())
-                        {
-                            int previousTag = it->second->tag;
-                            if(transferMap.find(previousTag) != transferMap.end())
-                            {
-                                MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
-                                previousTransfer->setSyncTransfer(false);
-                                delete transfer;
-                            }
-                        }
-                    }
-                }
-                else
-                {
-                	m_off_t startPos = transfer->getStartPos();
-                	m_off_t endPos = transfer->getEndPos();
-                	if(startPos < 0 || endPos < 0 || startPos > endPos) { e = API_EARGS; break; }
-                	if(node)
-                	{
-                        transfer->setFileName(node->displayname());
-                		if(startPos >= node->size || endPos >= node->size)
-                		{ e = API_EARGS; break; }
+void MegaApiImpl::removeGlobalListener(MegaGlobalListener* listener)
+{
+    if(!listener) return;
 
-                		m_off_t totalBytes = endPos - startPos + 1;
-                	    transferMap[nextTag]=transfer;
-						transfer->setTotalBytes(totalBytes);
-						transfer->setTag(nextTag);
-                        fireOnTransferStart(transfer);
-                	    client->pread(node, startPos, totalBytes, transfer);
-                	    waiter->notify();
-                	}
-                	else
-                	{
-                        transfer->setFileName(publicNode->getName());
-                        if(startPos >= publicNode->getSize() || endPos >= publicNode->getSize())
-                        { e = API_EARGS; break; }
+    sdkMutex.lock();
+    globalListeners.erase(listener);
+    sdkMutex.unlock();
 
-                        m_off_t totalBytes = endPos - startPos + 1;
-                        transferMap[nextTag]=transfer;
-                        transfer->setTotalBytes(totalBytes);
-                        transfer->setTag(nextTag);
-                        fireOnTransferStart(transfer);
-                        SymmCipher cipher;
-                        cipher.setkey(publicNode->getNodeKey());
-                        client->pread(publicNode->getHandle(), &cipher,
-                            MemAccess::get<int64_t>((const char*)publicNode->getNodeKey()->data() + SymmCipher::KEYLENGTH),
-                                      startPos, totalBytes, transfer);
-                        waiter->notify();
-                	}
-                }
+    if(callbackDispatcher) callbackDispatcher->removeListener(listener);
+}
 
-                currentTransfer=NULL;
-				break;
-			}
-		}
+MegaRequest *MegaApiImpl::getCurrentRequest()
+{
+    return activeRequest;
+}
 
-		if(e)
-            fireOnTransferFinish(transfer, MegaError(e));
+MegaTransfer *MegaApiImpl::getCurrentTransfer()
+{
+    return activeTransfer;
+}
 
-        sdkMutex.unlock();
-    }
+MegaError *MegaApiImpl::getCurrentError()
+{
+    return activeError;
 }
 
-void MegaApiImpl::removeRecursively(const char *path)
+MegaNodeList *MegaApiImpl::getCurrentNodes()
 {
-#ifndef _WIN32
-    string spath = path;
-    PosixFileSystemAccess::emptydirlocal(&spath);
-#else
-    string utf16path;
-    MegaApi::utf8ToUtf16(path, &utf16path);
-    if(utf16path.size())
-    {
-        utf16path.resize(utf16path.size()-2);
-        WinFileSystemAccess::emptydirlocal(&utf16path);
-    }
-#endif
+    return activeNodes;
 }
 
+MegaUserList *MegaApiImpl::getCurrentUsers()
+{
+    return activeUsers;
+}
 
-void MegaApiImpl::sendPendingRequests()
+void MegaApiImpl::postRequestEvent(int type, MegaRequestPrivate *request, MegaError *e)
 {
-	MegaRequestPrivate *request;
-	error e;
-    int nextTag = 0;
+    MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+    payload->request = request->copy();
+    payload->error = e ? new MegaError(*e) : NULL;
 
-	while((request = requestQueue.pop()))
-	{
-        if(!nextTag)
-        {
-            client->abortbackoff(false);
-        }
+    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::REQUEST_LISTENER, *it, payload);
 
-		sdkMutex.lock();
-		nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-		requestMap[nextTag]=request;
-		e = API_OK;
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::LISTENER, *it, payload);
 
-        fireOnRequestStart(request);
-		switch(request->getType())
-		{
-		case MegaRequest::TYPE_LOGIN:
-		{
-			const char *login = request->getEmail();
-			const char *password = request->getPassword();
-            const char* megaFolderLink = request->getLink();
-            const char* base64pwkey = request->getPrivateKey();
-            const char* sessionKey = request->getSessionKey();
+    MegaRequestListener* listener = request->getListener();
+    if(listener) callbackDispatcher->post(type, MegaCallbackDispatcher::REQUEST_LISTENER, listener, payload);
 
-            if(!megaFolderLink && (!(login && password)) && !sessionKey && (!(login && base64pwkey)))
-            {
-                e = API_EARGS;
-                break;
-            }
+    callbackDispatcher->release(payload);
+}
 
-            string slogin;
-            if(login)
-            {
-                slogin = login;
-                slogin.erase(slogin.begin(), std::find_if(slogin.begin(), slogin.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
-                slogin.erase(std::find_if(slogin.rbegin(), slogin.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), slogin.end());
-            }
+void MegaApiImpl::postTransferEvent(int type, MegaTransferPrivate *transfer, MegaError *e)
+{
+    MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+    payload->transfer = transfer->copy();
+    payload->error = e ? new MegaError(*e) : NULL;
 
-            requestMap.erase(request->getTag());
-            while(!requestMap.empty())
-            {
-                std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-                if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
-            }
+    for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::TRANSFER_LISTENER, *it, payload);
 
-            while(!transferMap.empty())
-            {
-                std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
-                if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
-            }
-            requestMap[request->getTag()]=request;
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::LISTENER, *it, payload);
 
-            if(sessionKey)
-            {
-                byte session[MAX_SESSION_LENGTH];
-                int size = Base64::atob(sessionKey, (byte *)session, sizeof session);
-                client->login(session, size);
-            }
-            else if(login && base64pwkey)
-            {
-                byte pwkey[SymmCipher::KEYLENGTH];
-                Base64::atob(base64pwkey, (byte *)pwkey, sizeof pwkey);
+    MegaTransferListener* listener = transfer->getListener();
+    if(listener) callbackDispatcher->post(type, MegaCallbackDispatcher::TRANSFER_LISTENER, listener, payload);
 
-                if(password)
-                {
-                    uint64_t emailhash;
-                    Base64::atob(password, (byte *)&emailhash, sizeof emailhash);
-                    client->fastlogin(slogin.c_str(), pwkey, emailhash);
-                }
-                else
-                {
-                    client->login(slogin.c_str(), pwkey);
-                }
-            }
-            else if(login && password)
-            {
-                byte pwkey[SymmCipher::KEYLENGTH];
-                if((e = client->pw_key(password,pwkey))) break;
-                client->login(slogin.c_str(), pwkey);
-            }
-            else
-            {
-                const char* ptr;
-                if (!((ptr = strstr(megaFolderLink,"#F!")) && (strlen(ptr)>12) && ptr[11] == '!'))
-                {
-                    e = API_EARGS;
-                    break;
-                }
-                e = client->folderaccess(ptr+3,ptr+12);
-                if(e == API_OK)
-                {
-                    fireOnRequestFinish(request, MegaError(e));
-                }
-            }
+    callbackDispatcher->release(payload);
+}
 
-            break;
-		}
-        case MegaRequest::TYPE_CREATE_FOLDER:
-		{
-			Node *parent = client->nodebyhandle(request->getParentHandle());
-			const char *name = request->getName();
-			if(!name || !parent) { e = API_EARGS; break; }
+void MegaApiImpl::postGlobalEvent(int type, MegaCallbackDispatcher::Payload *payload)
+{
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::GLOBAL_LISTENER, *it, payload);
 
-			NewNode *newnode = new NewNode[1];
-			SymmCipher key;
-			string attrstring;
-			byte buf[FOLDERNODEKEYLENGTH];
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::LISTENER, *it, payload);
 
-			// set up new node as folder node
-			newnode->source = NEW_NODE;
-			newnode->type = FOLDERNODE;
-			newnode->nodehandle = 0;
-			newnode->parenthandle = UNDEF;
+    callbackDispatcher->release(payload);
+}
 
-			// generate fresh random key for this folder node
-			PrnGen::genblock(buf,FOLDERNODEKEYLENGTH);
-			newnode->nodekey.assign((char*)buf,FOLDERNODEKEYLENGTH);
-			key.setkey(buf);
+#ifdef ENABLE_SYNC
+void MegaApiImpl::postSyncEvent(int type, MegaSyncPrivate *sync, MegaCallbackDispatcher::Payload *payload)
+{
+    payload->sync = sync->copy();
 
-			// generate fresh attribute object with the folder name
-			AttrMap attrs;
-            string sname = name;
-            fsAccess->normalize(&sname);
-            attrs.map['n'] = sname;
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::LISTENER, *it, payload);
 
-			// JSON-encode object and encrypt attribute string
-			attrs.getjson(&attrstring);
-            newnode->attrstring = new string;
-            client->makeattr(&key,newnode->attrstring,attrstring.c_str());
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        callbackDispatcher->post(type, MegaCallbackDispatcher::SYNC_LISTENER, *it, payload);
 
-			// add the newly generated folder node
-			client->putnodes(parent->nodehandle,newnode,1);
-			break;
-		}
-		case MegaRequest::TYPE_MOVE:
-		{
-			Node *node = client->nodebyhandle(request->getNodeHandle());
-			Node *newParent = client->nodebyhandle(request->getParentHandle());
-			if(!node || !newParent) { e = API_EARGS; break; }
+    MegaSyncListener* listener = sync->getListener();
+    if(listener) callbackDispatcher->post(type, MegaCallbackDispatcher::SYNC_LISTENER, listener, payload);
 
-            if(node->parent == newParent)
-            {
-                fireOnRequestFinish(request, MegaError(API_OK));
-                break;
-            }
-			if((e = client->checkmove(node,newParent))) break;
+    callbackDispatcher->release(payload);
+}
+#endif
 
-			e = client->rename(node, newParent);
-			break;
-		}
-		case MegaRequest::TYPE_COPY:
-		{
-			Node *node = client->nodebyhandle(request->getNodeHandle());
-			Node *target = client->nodebyhandle(request->getParentHandle());
-			const char* email = request->getEmail();
-            MegaNode *publicNode = request->getPublicNode();
-            const char *newName = request->getName();
+void MegaApiImpl::fireOnRequestStart(MegaRequestPrivate *request)
+{
+    LOG_info << "Request (" << request->getRequestString() << ") starting";
+    if(callbackDispatcher)
+    {
+        postRequestEvent(MegaCallbackDispatcher::REQUEST_START, request, NULL);
+        return;
+    }
 
-            if((!node && !publicNode) || (!target && !email) || (newName && !(*newName))) { e = API_EARGS; break; }
+    activeRequest = request;
+	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+		(*it)->onRequestStart(api, request);
 
-            if(publicNode)
-            {
-                if(publicNode->getAuth()->size())
-                {
-                    e = API_EACCESS;
-                    break;
-                }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onRequestStart(api, request);
 
-                NewNode *newnode = new NewNode[1];
-                newnode->nodekey.assign(publicNode->getNodeKey()->data(), publicNode->getNodeKey()->size());
-                newnode->attrstring = new string;
-                newnode->attrstring->assign(publicNode->getAttrString()->data(), publicNode->getAttrString()->size());
-                newnode->nodehandle = publicNode->getHandle();
-                newnode->source = NEW_PUBLIC;
-                newnode->type = FILENODE;
-                newnode->parenthandle = UNDEF;
+	MegaRequestListener* listener = request->getListener();
+	if(listener) listener->onRequestStart(api, request);
+	activeRequest = NULL;
+}
 
-                if(target)
-                {
-                    client->putnodes(target->nodehandle, newnode, 1);
-                }
-                else
-                {
-                    client->putnodes(email, newnode, 1);
-                }
-            }
-            else
-            {
-                unsigned nc;
-                TreeProcCopy tc;
 
-                // determine number of nodes to be copied
-                client->proctree(node,&tc);
-                tc.allocnodes();
-                nc = tc.nc;
+void MegaApiImpl::fireOnRequestFinish(MegaRequestPrivate *request, MegaError e)
+{
+    if(e.getErrorCode())
+    {
+        LOG_warn << "Request (" << request->getRequestString() << ") finished with error: " << e.getErrorString();
+    }
+    else
+    {
+        LOG_info << "Request (" << request->getRequestString() << ") finished";
+    }
 
-                // build new nodes array
-                client->proctree(node,&tc);
-                if (!nc)
-                {
-                    e = API_EARGS;
-                    break;
-                }
+    if(callbackDispatcher)
+    {
+        postRequestEvent(MegaCallbackDispatcher::REQUEST_FINISH, request, &e);
+        requestMap.erase(request->getTag());
+        delete request;
+        return;
+    }
 
-                tc.nn->parenthandle = UNDEF;
+	MegaError *megaError = new MegaError(e);
+	activeRequest = request;
+	activeError = megaError;
 
-                if(nc == 1 && newName && tc.nn[0].nodekey.size())
-                {
-                    SymmCipher key;
-                    AttrMap attrs;
-                    string attrstring;
+	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+		(*it)->onRequestFinish(api, request, megaError);
 
-                    key.setkey((const byte*)tc.nn[0].nodekey.data(), node->type);
-                    attrs = node->attrs;
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onRequestFinish(api, request, megaError);
 
-                    string sname = newName;
-                    fsAccess->normalize(&sname);
-                    attrs.map['n'] = sname;
+	MegaRequestListener* listener = request->getListener();
+	if(listener) listener->onRequestFinish(api, request, megaError);
 
-                    attrs.getjson(&attrstring);
-                    client->makeattr(&key,tc.nn[0].attrstring, attrstring.c_str());
-                }
+    requestMap.erase(request->getTag());
 
-                if (target)
-                {
-                    client->putnodes(target->nodehandle,tc.nn,nc);
-                }
-                else
-                {
-                    client->putnodes(email, tc.nn, nc);
-                }
-            }
-			break;
-		}
-        case MegaRequest::TYPE_RENAME:
-        {
-            Node* node = client->nodebyhandle(request->getNodeHandle());
-            const char* newName = request->getName();
-            if(!node || !newName || !(*newName)) { e = API_EARGS; break; }
+	activeRequest = NULL;
+	activeError = NULL;
+	delete request;
+    delete megaError;
+}
 
-            if (!client->checkaccess(node,FULL)) { e = API_EACCESS; break; }
+void MegaApiImpl::fireOnRequestUpdate(MegaRequestPrivate *request)
+{
+    if(callbackDispatcher)
+    {
+        postRequestEvent(MegaCallbackDispatcher::REQUEST_UPDATE, request, NULL);
+        return;
+    }
 
-            string sname = newName;
-            fsAccess->normalize(&sname);
-            node->attrs.map['n'] = sname;
-            e = client->setattr(node);
-            break;
-        }
-		case MegaRequest::TYPE_REMOVE:
-		{
-			Node* node = client->nodebyhandle(request->getNodeHandle());
-			if(!node) { e = API_EARGS; break; }
+    activeRequest = request;
 
-			e = client->unlink(node);
-			break;
-		}
-		case MegaRequest::TYPE_SHARE:
-		{
-			Node *node = client->nodebyhandle(request->getNodeHandle());
-			const char* email = request->getEmail();
-			int access = request->getAccess();
-            if(!node || !email || !strchr(email, '@'))
-            {
-                e = API_EARGS;
-                break;
-            }
+    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+        (*it)->onRequestUpdate(api, request);
 
-            accesslevel_t a;
-			switch(access)
-			{
-				case MegaShare::ACCESS_UNKNOWN:
-                    a = ACCESS_UNKNOWN;
-                    break;
-				case MegaShare::ACCESS_READ:
-					a = RDONLY;
-					break;
-				case MegaShare::ACCESS_READWRITE:
-					a = RDWR;
-					break;
-				case MegaShare::ACCESS_FULL:
-					a = FULL;
-					break;
-				case MegaShare::ACCESS_OWNER:
-					a = OWNER;
-					break;
-                default:
-                    e = API_EARGS;
-			}
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onRequestUpdate(api, request);
 
-            if(e == API_OK)
-                client->setshare(node, email, a);
-			break;
-		}
-		case MegaRequest::TYPE_IMPORT_LINK:
-		case MegaRequest::TYPE_GET_PUBLIC_NODE:
-		{
-			Node *node = client->nodebyhandle(request->getParentHandle());
-			const char* megaFileLink = request->getLink();
-			if(!megaFileLink) { e = API_EARGS; break; }
-			if((request->getType()==MegaRequest::TYPE_IMPORT_LINK) && (!node)) { e = API_EARGS; break; }
+    MegaRequestListener* listener = request->getListener();
+    if(listener) listener->onRequestUpdate(api, request);
 
-			e = client->openfilelink(megaFileLink, 1);
-			break;
-		}
-		case MegaRequest::TYPE_EXPORT:
-		{
-			Node* node = client->nodebyhandle(request->getNodeHandle());
-			if(!node) { e = API_EARGS; break; }
+    activeRequest = NULL;
+}
 
-            e = client->exportnode(node, !request->getAccess());
-			break;
-		}
-		case MegaRequest::TYPE_FETCH_NODES:
-		{
-			client->fetchnodes();
-			break;
-		}
-		case MegaRequest::TYPE_ACCOUNT_DETAILS:
-		{
-            if(client->loggedin() != FULLACCOUNT)
-            {
-                e = API_EACCESS;
-                break;
-            }
+void MegaApiImpl::fireOnRequestTemporaryError(MegaRequestPrivate *request, MegaError e)
+{
+    request->setNumRetry(request->getNumRetry() + 1);
 
-			int numDetails = request->getNumDetails();
-			bool storage = (numDetails & 0x01) != 0;
-			bool transfer = (numDetails & 0x02) != 0;
-			bool pro = (numDetails & 0x04) != 0;
-			bool transactions = (numDetails & 0x08) != 0;
-			bool purchases = (numDetails & 0x10) != 0;
-			bool sessions = (numDetails & 0x20) != 0;
+    if(callbackDispatcher)
+    {
+        postRequestEvent(MegaCallbackDispatcher::REQUEST_TEMPORARY_ERROR, request, &e);
+        return;
+    }
 
-			numDetails = 1;
-			if(transactions) numDetails++;
-			if(purchases) numDetails++;
-			if(sessions) numDetails++;
+	MegaError *megaError = new MegaError(e);
+	activeRequest = request;
+	activeError = megaError;
 
-			request->setNumDetails(numDetails);
+	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+		(*it)->onRequestTemporaryError(api, request, megaError);
 
-			client->getaccountdetails(request->getAccountDetails(), storage, transfer, pro, transactions, purchases, sessions);
-			break;
-		}
-		case MegaRequest::TYPE_CHANGE_PW:
-		{
-			const char* oldPassword = request->getPassword();
-			const char* newPassword = request->getNewPassword();
-			if(!oldPassword || !newPassword) { e = API_EARGS; break; }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onRequestTemporaryError(api, request, megaError);
 
-			byte pwkey[SymmCipher::KEYLENGTH];
-			byte newpwkey[SymmCipher::KEYLENGTH];
-			if((e = client->pw_key(oldPassword, pwkey))) { e = API_EARGS; break; }
-			if((e = client->pw_key(newPassword, newpwkey))) { e = API_EARGS; break; }
-			e = client->changepw(pwkey, newpwkey);
-			break;
-		}
-		case MegaRequest::TYPE_LOGOUT:
-		{
-            if(request->getFlag())
-            {
-                client->logout();
-            }
-            else
-            {
-                client->locallogout();
-                client->restag = nextTag;
-                logout_result(API_OK);
-            }
-			break;
-		}
-		case MegaRequest::TYPE_GET_ATTR_FILE:
-		{
-			const char* dstFilePath = request->getFile();
-            int type = request->getParamType();
-			Node *node = client->nodebyhandle(request->getNodeHandle());
+	MegaRequestListener* listener = request->getListener();
+	if(listener) listener->onRequestTemporaryError(api, request, megaError);
 
-			if(!dstFilePath || !node) { e = API_EARGS; break; }
+	activeRequest = NULL;
+	activeError = NULL;
+	delete megaError;
+}
 
-			e = client->getfa(node, type);
-            if(e == API_EEXIST)
-            {
-                e = API_OK;
-                int prevtag = client->restag;
-                MegaRequestPrivate* req = NULL;
-                while(prevtag)
-                {
-                    if(requestMap.find(prevtag) == requestMap.end())
-                    {
-                        LOG_err << "Invalid duplicate getattr request";
-                        req = NULL;
-                        e = API_EINTERNAL;
-                        break;
-                    }
+void MegaApiImpl::fireOnTransferStart(MegaTransferPrivate *transfer)
+{
+    updateTransferStats(transfer);
 
-                    req = requestMap.at(prevtag);
-                    if(!req || (req->getType() != MegaRequest::TYPE_GET_ATTR_FILE))
-                    {
-                        LOG_err << "Invalid duplicate getattr type";
-                        req = NULL;
-                        e = API_EINTERNAL;
-                        break;
-                    }
+    if(callbackDispatcher)
+    {
+        postTransferEvent(MegaCallbackDispatcher::TRANSFER_START, transfer, NULL);
+        return;
+    }
 
-                    prevtag = req->getNumber();
-                }
+	activeTransfer = transfer;
 
-                if(req)
-                {
-                    LOG_debug << "Duplicate getattr detected";
-                    req->setNumber(request->getTag());
-                }
-            }
-			break;
-		}
-		case MegaRequest::TYPE_GET_ATTR_USER:
-		{
-            const char* value = request->getFile();
-            int type = request->getParamType();
-            const char *email = request->getEmail();
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferStart(api, transfer);
 
-            User *user;
-            if(email)
-            {
-                user = client->finduser(email, 0);
-            }
-            else
-            {
-                user = client->finduser(client->me, 0);
-            }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferStart(api, transfer);
 
-            if((!type && !value) || !user || (type < 0)) { e = API_EARGS; break; }
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferStart(api, transfer);
 
-            if(!type)
-            {
-                client->getua(user, "a", 0);
-            }
-            else
-            {
-                string attrname;
-                switch(type)
-                {
-                    case MegaApi::USER_ATTR_FIRSTNAME:
-                    {
-                        attrname = "firstname";
-                        break;
-                    }
+	activeTransfer = NULL;
+}
 
-                    case MegaApi::USER_ATTR_LASTNAME:
-                    {
-                        attrname = "lastname";
-                        break;
-                    }
+void MegaApiImpl::fireOnTransferFinish(MegaTransferPrivate *transfer, MegaError e)
+{
+    updateTransferStats(transfer, e.getErrorCode() ? -1 : 1);
 
-                    default:
-                    {
-                        e = API_EARGS;
-                        break;
-                    }
-                }
+    // finished once the callbacks of its last file have been called
+    MegaFolderDownload *folder = NULL;
+    if(transfer->getFolderTransferTag())
+    {
+        folder = finishFolderSubtransfer(transfer, (error)e.getErrorCode());
+    }
 
-                if(!e)
-                {
-                    client->getua(user, attrname.c_str(), 2);
-                }
-            }
-            break;
-		}
-		case MegaRequest::TYPE_SET_ATTR_USER:
-		{
-            const char* file = request->getFile();
-            const char* value = request->getText();
-            int type = request->getParamType();
+    if(e.getErrorCode())
+    {
+        LOG_warn << "Transfer (" << transfer->getTransferString() << ") finished with error: " << e.getErrorString()
+                    << " File: " << transfer->getFileName();
+    }
+    else
+    {
+        LOG_info << "Transfer (" << transfer->getTransferString() << ") finished. File: " << transfer->getFileName();
+    }
 
-            if ((!type && !file) || (type < 0) || (type && !value))
-            {
-                e = API_EARGS;
-                break;
-            }
+    if(callbackDispatcher)
+    {
+        postTransferEvent(MegaCallbackDispatcher::TRANSFER_FINISH, transfer, &e);
+        transferMap.erase(transfer->getTag());
+        delete transfer;
+        if(folder) finishFolderDownload(folder);
+        return;
+    }
 
-            if(!type)
-            {
-                string path = file;
-                string localpath;
-                fsAccess->path2local(&path, &localpath);
+	MegaError *megaError = new MegaError(e);
+	activeTransfer = transfer;
+	activeError = megaError;
 
-                string attributedata;
-                FileAccess *f = fsAccess->newfileaccess();
-                if (!f->fopen(&localpath, 1, 0))
-                {
-                    delete f;
-                    e = API_EREAD;
-                    break;
-                }
-
-                if (!f->fread(&attributedata, f->size, 0, 0))
-                {
-                    delete f;
-                    e = API_EREAD;
-                    break;
-                }
-                delete f;
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferFinish(api, transfer, megaError);
 
-                client->putua("a", (byte *)attributedata.data(), attributedata.size(), 0);
-            }
-            else
-            {
-                string attrname;
-                string attrvalue = value;
-                switch(type)
-                {
-                    case MegaApi::USER_ATTR_FIRSTNAME:
-                    {
-                        attrname = "firstname";
-                        break;
-                    }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferFinish(api, transfer, megaError);
 
-                    case MegaApi::USER_ATTR_LASTNAME:
-                    {
-                        attrname = "lastname";
-                        break;
-                    }
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferFinish(api, transfer, megaError);
 
-                    default:
-                    {
-                        e = API_EARGS;
-                        break;
-                    }
-                }
-                if(!e)
-                {
-                    client->putua(attrname.c_str(), (byte *)attrvalue.data(), attrvalue.size(), 2);
-                }
-            }
-            break;
-		}
-        case MegaRequest::TYPE_SET_ATTR_FILE:
-        {
-            const char* srcFilePath = request->getFile();
-            int type = request->getParamType();
-            Node *node = client->nodebyhandle(request->getNodeHandle());
+    transferMap.erase(transfer->getTag());
 
-            if(!srcFilePath || !node) { e = API_EARGS; break; }
+	activeTransfer = NULL;
+	activeError = NULL;
+	delete transfer;
+	delete megaError;
 
-            string path = srcFilePath;
-            string localpath;
-            fsAccess->path2local(&path, &localpath);
+    if(folder) finishFolderDownload(folder);
+}
 
-            string *attributedata = new string;
-            FileAccess *f = fsAccess->newfileaccess();
-            if (!f->fopen(&localpath, 1, 0))
-            {
-                delete f;
-                delete attributedata;
-                e = API_EREAD;
-                break;
-            }
+void MegaApiImpl::fireOnTransferTemporaryError(MegaTransferPrivate *transfer, MegaError e)
+{
+    transfer->setNumRetry(transfer->getNumRetry() + 1);
 
-            if(!f->fread(attributedata, f->size, 0, 0))
-            {
-                delete f;
-                delete attributedata;
-                e = API_EREAD;
-                break;
-            }
-            delete f;
+    if(callbackDispatcher)
+    {
+        postTransferEvent(MegaCallbackDispatcher::TRANSFER_TEMPORARY_ERROR, transfer, &e);
+        return;
+    }
 
-            client->putfa(node->nodehandle, type, node->nodecipher(), attributedata);
-            //attributedata is not deleted because putfa takes its ownership
-            break;
-        }
-		case MegaRequest::TYPE_CANCEL_ATTR_FILE:
-		{
-			int type = request->getParamType();
-			Node *node = client->nodebyhandle(request->getNodeHandle());
+	MegaError *megaError = new MegaError(e);
+	activeTransfer = transfer;
+	activeError = megaError;
 
-			if (!node) { e = API_EARGS; break; }
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferTemporaryError(api, transfer, megaError);
 
-			e = client->getfa(node, type, 1);
-			if (!e)
-			{
-				std::map<int, MegaRequestPrivate*>::iterator it = requestMap.begin();
-				while(it != requestMap.end())
-				{
-					MegaRequestPrivate *r = it->second;
-					it++;
-					if (r->getType() == MegaRequest::TYPE_GET_ATTR_FILE &&
-						r->getParamType() == request->getParamType() &&
-						r->getNodeHandle() == request->getNodeHandle())
-					{
-						fireOnRequestFinish(r, MegaError(API_EINCOMPLETE));
-					}
-				}
-				fireOnRequestFinish(request, MegaError(e));
-			}
-			break;
-		}
-		case MegaRequest::TYPE_RETRY_PENDING_CONNECTIONS:
-		{
-			bool disconnect = request->getFlag();
-			bool includexfers = request->getNumber();
-			client->abortbackoff(includexfers);
-			if(disconnect)
-            {
-                client->disconnect();
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferTemporaryError(api, transfer, megaError);
 
-#if (WINDOWS_PHONE || TARGET_OS_IPHONE)
-                // Workaround to get the IP of valid DNS servers on Windows Phone/iOS
-                string servers;
-                struct hostent *hp;
-                struct in_addr **addr_list;
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferTemporaryError(api, transfer, megaError);
 
-                while (true)
-                {
-                    hp = gethostbyname("ns.mega.co.nz");
-                    if (hp != NULL && hp->h_addr != NULL)
-                    {
-                        addr_list = (struct in_addr **)hp->h_addr_list;
-                        for (int i = 0; addr_list[i] != NULL; i++)
-                        {
-                            char str[INET_ADDRSTRLEN];
-                            const char *ip = inet_ntop(AF_INET, addr_list[i], str, INET_ADDRSTRLEN);
-                            if(ip == str)
-                            {
-                                if (servers.size())
-                                {
-                                    servers.append(",");
-                                }
-                                servers.append(ip);
-                            }
-                        }
+	activeTransfer = NULL;
+	activeError = NULL;
+	delete megaError;
+}
 
-                        if (servers.size())
-                            break;
-                    }
-                    #ifdef WINDOWS_PHONE
-                        std::this_thread::sleep_for(std::chrono::seconds(1));
-                    #else
-                        sleep(1);
-                    #endif
-                }
+void MegaApiImpl::fireOnTransferUpdate(MegaTransferPrivate *transfer)
+{
+    updateTransferStats(transfer);
 
-                LOG_debug << "Using MEGA DNS servers";
-                httpio->setdnsservers(servers.c_str());
-#endif
-            }
+    if(transfer->getFolderTransferTag())
+    {
+        updateFolderDownload(transfer);
+    }
 
-			fireOnRequestFinish(request, MegaError(API_OK));
-			break;
-		}
-		case MegaRequest::TYPE_ADD_CONTACT:
-		{
-			const char *email = request->getEmail();
-			if(!email) { e = API_EARGS; break; }
-			e = client->invite(email, VISIBLE);
-			break;
-		}
-        case MegaRequest::TYPE_INVITE_CONTACT:
-        {
-            const char *email = request->getEmail();
-            const char *message = request->getText();
-            int action = request->getNumber();
-            if(!email)
-            {
-                e = API_EARGS;
-                break;
-            }
+    if(callbackDispatcher)
+    {
+        postTransferEvent(MegaCallbackDispatcher::TRANSFER_UPDATE, transfer, NULL);
+        return;
+    }
 
-            client->setpcr(email, (opcactions_t)action, message);
-            break;
-        }
-        case MegaRequest::TYPE_REPLY_CONTACT_REQUEST:
-        {
-            handle h = request->getNodeHandle();
-            int action = request->getNumber();
+	activeTransfer = transfer;
 
-            if(h == INVALID_HANDLE || action < 0 || action > MegaContactRequest::REPLY_ACTION_IGNORE)
-            {
-                e = API_EARGS;
-                break;
-            }
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferUpdate(api, transfer);
 
-            client->updatepcr(h, (ipcactions_t)action);
-            break;
-        }
-		case MegaRequest::TYPE_REMOVE_CONTACT:
-		{
-			const char *email = request->getEmail();
-			if(!email) { e = API_EARGS; break; }
-			e = client->invite(email, HIDDEN);
-			break;
-		}
-		case MegaRequest::TYPE_CREATE_ACCOUNT:
-		{
-			const char *email = request->getEmail();
-			const char *password = request->getPassword();
-			const char *name = request->getName();
-			const char *pwkey = request->getPrivateKey();
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferUpdate(api, transfer);
 
-            if(!email || !name || (!password && !pwkey))
-			{
-				e = API_EARGS; break;
-			}
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferUpdate(api, transfer);
 
-            requestMap.erase(request->getTag());
-            while(!requestMap.empty())
-            {
-                std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-                if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
-            }
+	activeTransfer = NULL;
+}
 
-            while(!transferMap.empty())
-            {
-                std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
-                if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
-            }
-            requestMap[request->getTag()]=request;
+bool MegaApiImpl::fireOnTransferData(MegaTransferPrivate *transfer, MegaTransferBuffer *buffer)
+{
+	activeTransfer = transfer;
+	bool result = false;
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener)
+		result = listener->onTransferBuffer(api, transfer, buffer);
+	else
+		buffer->release();
 
-			client->createephemeral();
+	activeTransfer = NULL;
+	return result;
+}
+
+void MegaApiImpl::fireOnUsersUpdate(MegaUserList *users)
+{
+    if(callbackDispatcher)
+    {
+        MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+        payload->users = users ? users->copy() : NULL;
+        postGlobalEvent(MegaCallbackDispatcher::USERS_UPDATE, payload);
+        return;
+    }
+
+	activeUsers = users;
+
+	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onUsersUpdate(api, users);
+    }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onUsersUpdate(api, users);
+    }
+
+    activeUsers = NULL;
+}
+
+void MegaApiImpl::fireOnContactRequestsUpdate(MegaContactRequestList *requests)
+{
+    if(callbackDispatcher)
+    {
+        MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+        payload->contactRequests = requests ? requests->copy() : NULL;
+        postGlobalEvent(MegaCallbackDispatcher::CONTACT_REQUESTS_UPDATE, payload);
+        return;
+    }
+
+    activeContactRequests = requests;
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onContactRequestsUpdate(api, requests);
+    }
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onContactRequestsUpdate(api, requests);
+    }
+
+    activeContactRequests = NULL;
+}
+
+void MegaApiImpl::fireOnNodesUpdate(MegaNodeList *nodes)
+{
+    if(callbackDispatcher)
+    {
+        MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+        payload->nodes = nodes ? nodes->copy() : NULL;
+        postGlobalEvent(MegaCallbackDispatcher::NODES_UPDATE, payload);
+        return;
+    }
+
+	activeNodes = nodes;
+
+	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onNodesUpdate(api, nodes);
+    }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onNodesUpdate(api, nodes);
+    }
+
+    activeNodes = NULL;
+}
+
+void MegaApiImpl::fireOnNodeDeltasAvailable()
+{
+    if(callbackDispatcher)
+    {
+        postGlobalEvent(MegaCallbackDispatcher::NODE_DELTAS_AVAILABLE, new MegaCallbackDispatcher::Payload);
+        return;
+    }
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onNodeDeltasAvailable(api);
+    }
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onNodeDeltasAvailable(api);
+    }
+}
+
+void MegaApiImpl::fireOnAccountUpdate()
+{
+    if(callbackDispatcher)
+    {
+        postGlobalEvent(MegaCallbackDispatcher::ACCOUNT_UPDATE, new MegaCallbackDispatcher::Payload);
+        return;
+    }
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onAccountUpdate(api);
+    }
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onAccountUpdate(api);
+    }
+}
+
+void MegaApiImpl::fireOnEngineMetrics(MegaEngineMetrics *metrics)
+{
+    if(callbackDispatcher)
+    {
+        MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+        payload->metrics = metrics->copy();
+        postGlobalEvent(MegaCallbackDispatcher::ENGINE_METRICS, payload);
+        return;
+    }
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onEngineMetrics(api, metrics);
+    }
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onEngineMetrics(api, metrics);
+    }
+}
+
+void MegaApiImpl::fireOnReloadNeeded()
+{
+    if(callbackDispatcher)
+    {
+        postGlobalEvent(MegaCallbackDispatcher::RELOAD_NEEDED, new MegaCallbackDispatcher::Payload);
+        return;
+    }
+
+	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+		(*it)->onReloadNeeded(api);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onReloadNeeded(api);
+}
+
+#ifdef ENABLE_SYNC
+void MegaApiImpl::fireOnSyncStateChanged(MegaSyncPrivate *sync)
+{
+    if(callbackDispatcher)
+    {
+        postSyncEvent(MegaCallbackDispatcher::SYNC_STATE_CHANGED, sync, new MegaCallbackDispatcher::Payload);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncStateChanged(api, sync);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncStateChanged(api, sync);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncStateChanged(api, sync);
+    }
+}
+
+void MegaApiImpl::fireOnSyncStatsUpdated(MegaSyncPrivate *sync)
+{
+    if(callbackDispatcher)
+    {
+        postSyncEvent(MegaCallbackDispatcher::SYNC_STATS_UPDATED, sync, new MegaCallbackDispatcher::Payload);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncStatsUpdated(api, sync);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncStatsUpdated(api, sync);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncStatsUpdated(api, sync);
+    }
+}
+
+void MegaApiImpl::fireOnSyncEvent(MegaSyncPrivate *sync, MegaSyncEvent *event)
+{
+    if(callbackDispatcher)
+    {
+        MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+        payload->syncEvent = event;
+        postSyncEvent(MegaCallbackDispatcher::SYNC_EVENT, sync, payload);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncEvent(api, sync, event);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncEvent(api, sync, event);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncEvent(api, sync, event);
+    }
+
+    delete event;
+}
+
+void MegaApiImpl::fireOnGlobalSyncStateChanged()
+{
+    if(callbackDispatcher)
+    {
+        postGlobalEvent(MegaCallbackDispatcher::GLOBAL_SYNC_STATE_CHANGED, new MegaCallbackDispatcher::Payload);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onGlobalSyncStateChanged(api);
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+        (*it)->onGlobalSyncStateChanged(api);
+}
+
+void MegaApiImpl::fireOnFileSyncStateChanged(MegaSyncPrivate *sync, const char *filePath, int newState)
+{
+    if(callbackDispatcher)
+    {
+        MegaCallbackDispatcher::Payload *payload = new MegaCallbackDispatcher::Payload;
+        payload->path = filePath;
+        payload->state = newState;
+        postSyncEvent(MegaCallbackDispatcher::SYNC_FILE_STATE_CHANGED, sync, payload);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncFileStateChanged(api, sync, filePath, newState);
+    }
+}
+
+#endif
+
+MegaError MegaApiImpl::checkAccess(MegaNode* megaNode, int level)
+{
+    if(!megaNode || level < MegaShare::ACCESS_UNKNOWN || level > MegaShare::ACCESS_OWNER)
+    {
+        return MegaError(API_EARGS);
+    }
+
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+	if(!node)
+	{
+        unlockQuery(shared);
+        return MegaError(API_ENOENT);
+	}
+
+    accesslevel_t a = OWNER;
+    switch(level)
+    {
+    	case MegaShare::ACCESS_UNKNOWN:
+    	case MegaShare::ACCESS_READ:
+    		a = RDONLY;
+    		break;
+    	case MegaShare::ACCESS_READWRITE:
+    		a = RDWR;
+    		break;
+    	case MegaShare::ACCESS_FULL:
+    		a = FULL;
+    		break;
+    	case MegaShare::ACCESS_OWNER:
+    		a = OWNER;
+    		break;
+    }
+
+	MegaError e(client->checkaccess(node, a) ? API_OK : API_EACCESS);
+    unlockQuery(shared);
+
+	return e;
+}
+
+MegaError MegaApiImpl::checkMove(MegaNode* megaNode, MegaNode* targetNode)
+{
+	if(!megaNode || !targetNode) return MegaError(API_EARGS);
+
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+	Node *target = client->nodebyhandle(targetNode->getHandle());
+	if(!node || !target)
+	{
+        unlockQuery(shared);
+        return MegaError(API_ENOENT);
+	}
+
+	MegaError e(client->checkmove(node,target));
+    unlockQuery(shared);
+
+	return e;
+}
+
+// (strict orderings: true if i sorts before j)
+bool MegaApiImpl::nodeComparatorDefaultASC (Node *i, Node *j)
+{
+    if(i->type != j->type) return i->type > j->type;
+    return strcasecmp(i->displayname(), j->displayname()) < 0;
+}
+
+bool MegaApiImpl::nodeComparatorDefaultDESC (Node *i, Node *j)
+{
+    if(i->type != j->type) return i->type < j->type;
+    return strcasecmp(i->displayname(), j->displayname()) > 0;
+}
+
+bool MegaApiImpl::nodeComparatorSizeASC (Node *i, Node *j)
+{ return i->size < j->size; }
+bool MegaApiImpl::nodeComparatorSizeDESC (Node *i, Node *j)
+{ return i->size > j->size; }
+
+bool MegaApiImpl::nodeComparatorCreationASC  (Node *i, Node *j)
+{ return i->ctime < j->ctime; }
+bool MegaApiImpl::nodeComparatorCreationDESC  (Node *i, Node *j)
+{ return i->ctime > j->ctime; }
+
+bool MegaApiImpl::nodeComparatorModificationASC  (Node *i, Node *j)
+{ i->resolveattrs(); j->resolveattrs(); return i->mtime < j->mtime; }
+bool MegaApiImpl::nodeComparatorModificationDESC  (Node *i, Node *j)
+{ i->resolveattrs(); j->resolveattrs(); return i->mtime > j->mtime; }
+
+bool MegaApiImpl::nodeComparatorAlphabeticalASC  (Node *i, Node *j)
+{ return strcasecmp(i->displayname(), j->displayname()) < 0; }
+bool MegaApiImpl::nodeComparatorAlphabeticalDESC  (Node *i, Node *j)
+{ return strcasecmp(i->displayname(), j->displayname()) > 0; }
+
+MegaApiImpl::NodeComparator MegaApiImpl::getNodeComparator(int order)
+{
+    switch(order)
+    {
+        case MegaApi::ORDER_DEFAULT_ASC: return MegaApiImpl::nodeComparatorDefaultASC;
+        case MegaApi::ORDER_DEFAULT_DESC: return MegaApiImpl::nodeComparatorDefaultDESC;
+        case MegaApi::ORDER_SIZE_ASC: return MegaApiImpl::nodeComparatorSizeASC;
+        case MegaApi::ORDER_SIZE_DESC: return MegaApiImpl::nodeComparatorSizeDESC;
+        case MegaApi::ORDER_CREATION_ASC: return MegaApiImpl::nodeComparatorCreationASC;
+        case MegaApi::ORDER_CREATION_DESC: return MegaApiImpl::nodeComparatorCreationDESC;
+        case MegaApi::ORDER_MODIFICATION_ASC: return MegaApiImpl::nodeComparatorModificationASC;
+        case MegaApi::ORDER_MODIFICATION_DESC: return MegaApiImpl::nodeComparatorModificationDESC;
+        case MegaApi::ORDER_ALPHABETICAL_ASC: return MegaApiImpl::nodeComparatorAlphabeticalASC;
+        case MegaApi::ORDER_ALPHABETICAL_DESC: return MegaApiImpl::nodeComparatorAlphabeticalDESC;
+        default: return NULL;
+    }
+}
+
+const node_vector *MegaApiImpl::getSortedChildren(Node *parent, NodeComparator comp, int order)
+{
+    // concurrent queries share sdkMutex, while invalidation happens under
+    // the exclusive lock only - the cached vectors stay put until then
+    sortMutex.lock();
+
+    if (!parent->sortedchildren)
+    {
+        parent->sortedchildren = new sortedchildren_map;
+    }
+
+    sortedchildren_map::iterator it = parent->sortedchildren->find(order);
+
+    if (it == parent->sortedchildren->end())
+    {
+        node_vector sorted(parent->children);
+
+        // (stable, so that equal nodes keep a consistent order)
+        std::stable_sort(sorted.begin(), sorted.end(), comp);
+
+        // (resolving deferred attributes while sorting may have dropped the cache)
+        if (!parent->sortedchildren)
+        {
+            parent->sortedchildren = new sortedchildren_map;
+        }
+
+        it = parent->sortedchildren->insert(pair<int, node_vector>(order, node_vector())).first;
+        it->second.swap(sorted);
+    }
+
+    sortMutex.unlock();
+
+    return &it->second;
+}
+
+int MegaApiImpl::getNumChildren(MegaNode* p)
+{
+	if (!p) return 0;
+
+	bool shared = lockQuery();
+	Node *parent = client->nodebyhandle(p->getHandle());
+	if (!parent)
+	{
+		unlockQuery(shared);
+		return 0;
+	}
+
+	int numChildren = parent->children.size();
+	unlockQuery(shared);
+
+	return numChildren;
+}
+
+int MegaApiImpl::getNumChildFiles(MegaNode* p)
+{
+	if (!p) return 0;
+
+	bool shared = lockQuery();
+	Node *parent = client->nodebyhandle(p->getHandle());
+	if (!parent)
+	{
+		unlockQuery(shared);
+		return 0;
+	}
+
+	int numFiles = 0;
+	for (node_vector::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+	{
+		if ((*it)->type == FILENODE)
+			numFiles++;
+	}
+	unlockQuery(shared);
+
+	return numFiles;
+}
+
+int MegaApiImpl::getNumChildFolders(MegaNode* p)
+{
+	if (!p) return 0;
+
+	bool shared = lockQuery();
+	Node *parent = client->nodebyhandle(p->getHandle());
+	if (!parent)
+	{
+		unlockQuery(shared);
+		return 0;
+	}
+
+	int numFolders = 0;
+	for (node_vector::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+	{
+		if ((*it)->type != FILENODE)
+			numFolders++;
+	}
+	unlockQuery(shared);
+
+	return numFolders;
+}
+
+
+MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
+{
+    if(!p) return new MegaNodeListPrivate();
+
+    bool shared = lockQuery();
+    Node *parent = client->nodebyhandle(p->getHandle());
+	if(!parent)
+	{
+        unlockQuery(shared);
+        return new MegaNodeListPrivate();
+	}
+
+    // contents not fetched yet: listing it triggers the fetch
+    if (parent->partial)
+    {
+        MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_FOLDER);
+        request->setNodeHandle(parent->nodehandle);
+        request->setParamType(1);
+        if(requestQueue.push(request)) waiter->notify();
+    }
+
+    MegaNodeList *result = getChildrenRange(getChildrenView(parent, order), 0, 0);
+    unlockQuery(shared);
+
+    queueThumbnailPrefetch(result);
+
+    return result;
+}
+
+int MegaApiImpl::getIndex(MegaNode *n, int order)
+{
+    if(!n)
+    {
+        return -1;
+    }
+
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node)
+    {
+        unlockQuery(shared);
+        return -1;
+    }
+
+    Node *parent = node->parent;
+    if(!parent)
+    {
+        unlockQuery(shared);
+        return -1;
+    }
+
+    if(!getNodeComparator(order))
+    {
+        unlockQuery(shared);
+        return 0;
+    }
+
+    // (comparing may resolve deferred attributes, which drops the cache)
+    node->resolveattrs();
+    int index = getViewIndex(getChildrenView(parent, order), node, order);
+    unlockQuery(shared);
+    return index;
+}
+
+const node_vector *MegaApiImpl::getChildrenView(Node *parent, int order)
+{
+    NodeComparator comp = getNodeComparator(order);
+
+    return comp ? getSortedChildren(parent, comp, order) : &parent->children;
+}
+
+int MegaApiImpl::getViewIndex(const node_vector *view, Node *node, int order)
+{
+    NodeComparator comp = getNodeComparator(order);
+
+    if(!comp)
+    {
+        return node->childindex < view->size() && (*view)[node->childindex] == node ? (int)node->childindex : -1;
+    }
+
+    // the node is among those that sort equal to it
+    node_vector::const_iterator i = std::lower_bound(view->begin(), view->end(), node, comp);
+    while (i != view->end() && *i != node)
+    {
+        i++;
+    }
+
+    return i == view->end() ? -1 : (int)(i - view->begin());
+}
+
+MegaNodeList *MegaApiImpl::getChildrenRange(const node_vector *view, int offset, int limit)
+{
+    int total = view->size();
+
+    if(offset < 0)
+    {
+        offset = 0;
+    }
+
+    if(offset >= total)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    if(limit <= 0 || limit > total - offset)
+    {
+        limit = total - offset;
+    }
+
+    return new MegaNodeListPrivate((Node**)&(*view)[offset], limit);
+}
+
+MegaNodeList *MegaApiImpl::getChildren(MegaNode *p, int order, int offset, int limit)
+{
+    if(!p) return new MegaNodeListPrivate();
+
+    bool shared = lockQuery();
+    Node *parent = client->nodebyhandle(p->getHandle());
+    if(!parent)
+    {
+        unlockQuery(shared);
+        return new MegaNodeListPrivate();
+    }
+
+    // contents not fetched yet: listing it triggers the fetch
+    if (parent->partial)
+    {
+        MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_FOLDER);
+        request->setNodeHandle(parent->nodehandle);
+        request->setParamType(1);
+        if(requestQueue.push(request)) waiter->notify();
+    }
+
+    MegaNodeList *result = getChildrenRange(getChildrenView(parent, order), offset, limit);
+    unlockQuery(shared);
+
+    queueThumbnailPrefetch(result);
+
+    return result;
+}
+
+MegaChildrenCursor *MegaApiImpl::getChildrenCursor(MegaNode *parent, int order)
+{
+    if(!parent) return NULL;
+
+    return new MegaChildrenCursorPrivate(parent->getHandle(), order);
+}
+
+MegaNodeList *MegaApiImpl::getNextChildren(MegaChildrenCursor *c, int limit)
+{
+    MegaChildrenCursorPrivate *cursor = (MegaChildrenCursorPrivate *)c;
+    if(!cursor || !cursor->more) return new MegaNodeListPrivate();
+
+    bool shared = lockQuery();
+    Node *parent = client->nodebyhandle(cursor->parenthandle);
+    if(!parent)
+    {
+        cursor->more = false;
+        unlockQuery(shared);
+        return new MegaNodeListPrivate();
+    }
+
+    const node_vector *view = getChildrenView(parent, cursor->order);
+    int start = cursor->position;
+
+    // resume after the last node returned if it's still there
+    Node *last = ISUNDEF(cursor->last) ? NULL : client->nodebyhandle(cursor->last);
+    if(last && last->parent == parent)
+    {
+        int index = getViewIndex(view, last, cursor->order);
+        if(index >= 0)
+        {
+            start = index + 1;
+        }
+    }
+
+    MegaNodeList *result = getChildrenRange(view, start, limit);
+    int count = result->size();
+
+    cursor->position += count;
+    if(count)
+    {
+        cursor->last = (*view)[start + count - 1]->nodehandle;
+    }
+    cursor->more = start + count < (int)view->size();
+    unlockQuery(shared);
+
+    return result;
+}
+
+MegaNode *MegaApiImpl::getChildNode(MegaNode *parent, const char* name)
+{
+    if(!parent || !name)
+    {
+        return NULL;
+    }
+
+    bool shared = lockQuery();
+    Node *parentNode = client->nodebyhandle(parent->getHandle());
+	if(!parentNode)
+	{
+        unlockQuery(shared);
+        return NULL;
+	}
+
+    MegaNode *node = MegaNodePrivate::fromNode(client->childnodebyname(parentNode, name, !shared));
+    unlockQuery(shared);
+    return node;
+}
+
+Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint)
+{
+    if(!fingerprint || !fingerprint[0]) return NULL;
+
+    m_off_t size = 0;
+    unsigned int fsize = strlen(fingerprint);
+    unsigned int ssize = fingerprint[0] - 'A';
+    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
+        return NULL;
+
+    byte buf[sizeof(size) + 1];
+    Base64::atob(fingerprint + 1, buf, sizeof buf);
+    int l = Serialize64::unserialize(buf, sizeof buf, (uint64_t *)&size);
+    if(l <= 0)
+        return NULL;
+
+    string sfingerprint = fingerprint + ssize + 1;
+
+    FileFingerprint fp;
+    if(!fp.unserializefingerprint(&sfingerprint))
+        return NULL;
+
+    fp.size = size;
+
+    bool shared = lockQuery();
+    Node *n  = client->nodebyfingerprint(&fp);
+    unlockQuery(shared);
+
+    return n;
+}
+
+Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint, Node *parent)
+{
+    if(!fingerprint || !fingerprint[0]) return NULL;
+
+    m_off_t size = 0;
+    unsigned int fsize = strlen(fingerprint);
+    unsigned int ssize = fingerprint[0] - 'A';
+    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
+        return NULL;
+
+    byte buf[sizeof(size) + 1];
+    Base64::atob(fingerprint + 1, buf, sizeof buf);
+    int l = Serialize64::unserialize(buf, sizeof buf, (uint64_t *)&size);
+    if(l <= 0)
+        return NULL;
+
+    string sfingerprint = fingerprint + ssize + 1;
+
+    FileFingerprint fp;
+    if(!fp.unserializefingerprint(&sfingerprint))
+        return NULL;
+
+    fp.size = size;
+
+    bool shared = lockQuery();
+    Node *n  = client->nodebyfingerprint(&fp);
+    if(n && parent && n->parent != parent)
+    {
+        for (node_vector::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+        {
+            Node* node = (*it);
+            if(*((FileFingerprint *)node) == *((FileFingerprint *)n))
+            {
+                n = node;
+                break;
+            }
+        }
+    }
+    unlockQuery(shared);
+
+    return n;
+}
+
+MegaNode* MegaApiImpl::getParentNode(MegaNode* n)
+{
+    if(!n) return NULL;
+
+    bool shared = lockQuery();
+    Node *node = client->nodebyhandle(n->getHandle());
+	if(!node)
+	{
+        unlockQuery(shared);
+        return NULL;
+	}
+
+    MegaNode *result = MegaNodePrivate::fromNode(node->parent);
+    unlockQuery(shared);
+
+	return result;
+}
+
+char* MegaApiImpl::getNodePath(MegaNode *node)
+{
+    if(!node) return NULL;
+
+    bool shared = lockQuery();
+    Node *n = client->nodebyhandle(node->getHandle());
+    if(!n)
+	{
+        unlockQuery(shared);
+        return NULL;
+	}
+
+	string path;
+	if (n->nodehandle == client->rootnodes[0])
+	{
+		path = "/";
+        unlockQuery(shared);
+        return stringToArray(path);
+	}
+
+	while (n)
+	{
+		switch (n->type)
+		{
+		case FOLDERNODE:
+			path.insert(0,n->displayname());
+
+			if (n->inshare)
+			{
+				path.insert(0,":");
+				if (n->inshare->user) path.insert(0,n->inshare->user->email);
+				else path.insert(0,"UNKNOWN");
+                unlockQuery(shared);
+                return stringToArray(path);
+			}
+			break;
+
+		case INCOMINGNODE:
+			path.insert(0,"//in");
+            unlockQuery(shared);
+            return stringToArray(path);
+
+		case ROOTNODE:
+            unlockQuery(shared);
+            return stringToArray(path);
+
+		case RUBBISHNODE:
+			path.insert(0,"//bin");
+            unlockQuery(shared);
+            return stringToArray(path);
+
+		case TYPE_UNKNOWN:
+		case FILENODE:
+			path.insert(0,n->displayname());
+		}
+
+		path.insert(0,"/");
+
+        n = n->parent;
+	}
+    unlockQuery(shared);
+    return stringToArray(path);
+}
+
+MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
+{
+    if(!path) return NULL;
+
+    bool shared = lockQuery();
+    Node *cwd = NULL;
+    if(node) cwd = client->nodebyhandle(node->getHandle());
+
+    MegaNode *result = MegaNodePrivate::fromNode(resolvePath(path, cwd, shared));
+    unlockQuery(shared);
+    return result;
+}
+
+void MegaApiImpl::getNodeHandlesByPath(const char **paths, int numPaths, MegaHandle *handles, MegaNode *node)
+{
+    if(!paths || !handles) return;
+
+    bool shared = lockQuery();
+    Node *cwd = NULL;
+    if(node) cwd = client->nodebyhandle(node->getHandle());
+
+    for(int i = 0; i < numPaths; i++)
+    {
+        Node *n = paths[i] ? resolvePath(paths[i], cwd, shared) : NULL;
+        handles[i] = n ? n->nodehandle : INVALID_HANDLE;
+    }
+    unlockQuery(shared);
+}
+
+Node *MegaApiImpl::resolvePath(const char *path, Node *cwd, bool shared)
+{
+	vector<string> c;
+	string s;
+	int l = 0;
+	const char* bptr = path;
+	int remote = 0;
+	Node* n;
+	Node* nn;
+
+	// split path by / or :
+	do {
+		if (!l)
+		{
+			if (*path >= 0)
+			{
+				if (*path == '\\')
+				{
+                    if (path > bptr)
+                    {
+                        s.append(bptr, path - bptr);
+                    }
+
+					bptr = ++path;
+
+					if (*bptr == 0)
+					{
+						c.push_back(s);
+						break;
+					}
+
+					path++;
+					continue;
+				}
+
+				if (*path == '/' || *path == ':' || !*path)
+				{
+					if (*path == ':')
+					{
+						if (c.size())
+						{
+                            return NULL;
+						}
+						remote = 1;
+					}
+
+                    if (path > bptr)
+                    {
+                        s.append(bptr, path - bptr);
+                    }
+
+                    bptr = path + 1;
+
+					c.push_back(s);
+
+					s.erase();
+				}
+			}
+            else if ((*path & 0xf0) == 0xe0)
+            {
+                l = 1;
+            }
+            else if ((*path & 0xf8) == 0xf0)
+            {
+                l = 2;
+            }
+            else if ((*path & 0xfc) == 0xf8)
+            {
+                l = 3;
+            }
+            else if ((*path & 0xfe) == 0xfc)
+            {
+                l = 4;
+            }
+		}
+        else
+        {
+            l--;
+        }
+	} while (*path++);
+
+	if (l)
+	{
+        return NULL;
+	}
+
+	if (remote)
+	{
+        // target: user inbox - it's not a node - return NULL
+		if (c.size() == 2 && !c[1].size())
+		{
+            return NULL;
+		}
+
+		User* u;
+
+        if ((u = client->finduser(c[0].c_str())))
+        {
+            // locate matching share from this user
+            handle_set::iterator sit;
+            string name;
+            for (sit = u->sharing.begin(); sit != u->sharing.end(); sit++)
+            {
+                if ((n = client->nodebyhandle(*sit)))
+                {
+                    if(!name.size())
+                    {
+                        name =  c[1];
+                        n->client->fsaccess->normalize(&name);
+                    }
+
+                    if (!strcmp(name.c_str(), n->displayname()))
+                    {
+                        l = 2;
+                        break;
+                    }
+                }
+            }
+        }
+
+		if (!l)
+		{
+            return NULL;
+		}
+	}
+	else
+	{
+		// path starting with /
+		if (c.size() > 1 && !c[0].size())
+		{
+			// path starting with //
+			if (c.size() > 2 && !c[1].size())
+			{
+                if (c[2] == "in")
+                {
+                    n = client->nodebyhandle(client->rootnodes[1]);
+                }
+                else if (c[2] == "bin")
+                {
+                    n = client->nodebyhandle(client->rootnodes[2]);
+                }
+				else
+				{
+                    return NULL;
+				}
+
+				l = 3;
+			}
+			else
+			{
+				n = client->nodebyhandle(client->rootnodes[0]);
+				l = 1;
+			}
+		}
+        else
+        {
+            n = cwd;
+        }
+	}
+
+    // start from the deepest cached prefix (paths without . or ..)
+    string key;
+    vector<size_t> prefixes;
+    bool cacheable = n != NULL;
+
+    for (size_t i = l; cacheable && i < c.size(); i++)
+    {
+        cacheable = c[i] != "." && c[i] != "..";
+    }
+
+    if (cacheable)
+    {
+        key.assign((const char *)&n->nodehandle, sizeof n->nodehandle);
+
+        for (size_t i = l; i < c.size(); i++)
+        {
+            key.append(c[i]);
+            key.append("", 1);
+            prefixes.push_back(key.size());
+        }
+
+        for (size_t i = prefixes.size(); i--; )
+        {
+            string prefix(key, 0, prefixes[i]);
+            handle h = pathCache.get(&prefix);
+            Node *cached = (h != UNDEF) ? client->nodebyhandle(h) : NULL;
+
+            if (cached)
+            {
+                n = cached;
+                l += i + 1;
+                break;
+            }
+        }
+    }
+
+	// parse relative path
+	while (n && l < (int)c.size())
+	{
+		if (c[l] != ".")
+		{
+			if (c[l] == "..")
+			{
+                if (n->parent)
+                {
+                    n = n->parent;
+                }
+			}
+			else
+			{
+				// locate child node (explicit ambiguity resolution: not implemented)
+				if (c[l].size())
+				{
+                    nn = client->childnodebyname(n, c[l].c_str(), !shared);
+
+					if (!nn)
+					{
+                        return NULL;
+					}
+
+					n = nn;
+				}
+			}
+		}
+
+        if (cacheable)
+        {
+            // (prefixes start at the first component after the base node)
+            string prefix(key, 0, prefixes[l - (c.size() - prefixes.size())]);
+            pathCache.put(&prefix, n->nodehandle);
+        }
+
+		l++;
+	}
+
+    return n;
+}
+
+MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
+{
+	if(handle == UNDEF) return NULL;
+    bool shared = lockQuery();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+    unlockQuery(shared);
+    return result;
+}
+
+MegaContactRequest *MegaApiImpl::getContactRequestByHandle(MegaHandle handle)
+{
+    bool shared = lockQuery();
+    if(client->pcrindex.find(handle) == client->pcrindex.end())
+    {
+        unlockQuery(shared);
+        return NULL;
+    }
+    MegaContactRequest* request = MegaContactRequestPrivate::fromContactRequest(client->pcrindex.at(handle));
+    unlockQuery(shared);
+    return request;
+}
+
+void MegaApiImpl::startUploadTransfer(MegaTransferPrivate *transfer, string *localPath)
+{
+    int nextTag = client->reqtag;
+    string wFileName = transfer->getFileName();
+
+    currentTransfer = transfer;
+    MegaFilePut *f = new MegaFilePut(client, localPath, &wFileName, transfer->getParentHandle(), "", transfer->getTime());
+
+    if(transfer->getInputStream())
+    {
+        f->stream = new ExternalInputStream(transfer->getInputStream());
+        f->mtime = transfer->getTime() >= 0 ? transfer->getTime() : time(NULL);
+    }
+
+    bool started = client->startxfer(PUT,f);
+    if(!started)
+    {
+        //Unable to read the file
+        transfer->setSyncTransfer(false);
+        transferMap[nextTag]=transfer;
+        transfer->setTag(nextTag);
+        fireOnTransferStart(transfer);
+        fireOnTransferFinish(transfer, MegaError(API_EREAD));
+    }
+    else if(transfer->getTag() == -1)
+    {
+        //Already existing transfer
+        //Delete the new one and set the transfer as regular
+        transfer_map::iterator it = client->transfers[PUT].find(f);
+        if(it != client->transfers[PUT].end())
+        {
+            int previousTag = it->second->tag;
+            if(transferMap.find(previousTag) != transferMap.end())
+            {
+                MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
+                previousTransfer->setSyncTransfer(false);
+                delete transfer;
+            }
+        }
+    }
+    currentTransfer=NULL;
+}
+
+// start the downloads of the persistent queue left over from the previous
+// session - their records are taken over by the new MegaFileGets
+void MegaApiImpl::restoreQueuedDownloads()
+{
+    if (!client->queuedfiles.size())
+    {
+        return;
+    }
+
+    int restored = 0;
+
+    for (unsigned i = 0; i < client->queuedfiles.size(); i++)
+    {
+        QueuedFile *qf = client->queuedfiles[i];
+        Node *node = client->nodebyhandle(qf->h);
+
+        if (!node || node->type != FILENODE)
+        {
+            client->queuedfiledels.push_back(qf->dbid);
+            delete qf;
+            continue;
+        }
+
+        string path;
+        client->fsaccess->local2path(&qf->localname, &path);
+
+        MegaTransferPrivate *transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD);
+        transfer->setNodeHandle(qf->h);
+        transfer->setPath(path.c_str());
+
+        MegaFileGet *f = new MegaFileGet(client, node, path);
+        f->priority = qf->priority;
+        f->queuedbid = qf->dbid;
+        delete qf;
+
+        client->nextreqtag();
+        currentTransfer = transfer;
+
+        if (!client->startxfer(GET, f))
+        {
+            // already requested again by the app
+            delete f;
+            delete transfer;
+        }
+        else
+        {
+            if (transfer->getTag() == -1)
+            {
+                // added to an existing transfer
+                delete transfer;
+            }
+
+            restored++;
+        }
+
+        currentTransfer = NULL;
+    }
+
+    client->queuedfiles.clear();
+
+    LOG_debug << "Restored downloads: " << restored;
+}
+
+// resolve the fingerprinted uploads: files whose content is already in the
+// account become server-side copies of the existing node, sent as batched
+// putnodes per target folder - the rest enter the transfer queue
+void MegaApiImpl::processFingerprintedUploads()
+{
+    map<handle, vector<pair<MegaTransferPrivate *, Node *> > > copies;
+
+    sdkMutex.lock();
+
+    for (std::list<MegaUploadFingerprintJob *>::iterator it = fingerprintJobs.begin(); it != fingerprintJobs.end(); )
+    {
+        MegaUploadFingerprintJob *job = *it;
+
+        if (!workerPool->isdone(job))
+        {
+            it++;
+            continue;
+        }
+
+        fingerprintJobs.erase(it++);
+
+        MegaTransferPrivate *transfer = job->transfer;
+        Node *n = job->fingerprint.isvalid ? client->nodebyfingerprint(&job->fingerprint) : NULL;
+
+        if (n && n->type == FILENODE && !n->attrstring && n->nodekey.size()
+                && client->nodebyhandle(transfer->getParentHandle()))
+        {
+            copies[transfer->getParentHandle()].push_back(pair<MegaTransferPrivate *, Node *>(transfer, n));
+        }
+        else
+        {
+            client->nextreqtag();
+            startUploadTransfer(transfer, &job->localname);
+        }
+
+        delete job;
+    }
+
+    for (map<handle, vector<pair<MegaTransferPrivate *, Node *> > >::iterator it = copies.begin(); it != copies.end(); it++)
+    {
+        vector<pair<MegaTransferPrivate *, Node *> > *batch = &it->second;
+
+        for (unsigned start = 0; start < batch->size(); start += MAXCOPYBATCH)
+        {
+            unsigned count = (unsigned)batch->size() - start;
+
+            if (count > MAXCOPYBATCH)
+            {
+                count = MAXCOPYBATCH;
+            }
+
+            NewNode *newnodes = new NewNode[count];
+            vector<MegaTransferPrivate *> transfers;
+
+            for (unsigned i = 0; i < count; i++)
+            {
+                MegaTransferPrivate *transfer = (*batch)[start + i].first;
+                Node *n = (*batch)[start + i].second;
+                NewNode *nn = newnodes + i;
+                SymmCipher key;
+                AttrMap attrs;
+                string attrstring;
+
+                nn->source = NEW_NODE;
+                nn->type = FILENODE;
+                nn->nodehandle = n->nodehandle;
+                nn->parenthandle = UNDEF;
+                nn->nodekey = n->nodekey;
+
+                // same content under the new name
+                key.setkey((const byte *)nn->nodekey.data(), FILENODE);
+                n->resolveattrs();
+                attrs = n->attrs;
+
+                string sname = transfer->getFileName();
+                fsAccess->normalize(&sname);
+                attrs.map['n'] = sname;
+
+                attrs.getjson(&attrstring);
+                nn->attrstring = new string;
+                client->makeattr(&key, nn->attrstring, attrstring.c_str());
+
+                int tag = client->nextreqtag();
+                transfer->setTag(tag);
+                transfer->setTotalBytes(n->size);
+                transferMap[tag] = transfer;
+                transfers.push_back(transfer);
+
+                totalUploads++;
+                pendingUploads++;
+                fireOnTransferStart(transfer);
+            }
+
+            LOG_debug << "Completing " << count << " uploads by server-side copy";
+
+            uploadCopyBatches[client->nextreqtag()] = transfers;
+            client->putnodes(it->first, newnodes, count);
+        }
+    }
+
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::sendPendingTransfers()
+{
+	MegaTransferPrivate *transfer;
+	error e;
+	int nextTag;
+
+	while((transfer = transferQueue.pop()))
+	{
+		sdkMutex.lock();
+		e = API_OK;
+        nextTag = client->nextreqtag();
+
+		switch(transfer->getType())
+		{
+			case MegaTransfer::TYPE_UPLOAD:
+			{
+                const char* localPath = transfer->getPath();
+                const char* fileName = transfer->getFileName();
+                int64_t mtime = transfer->getTime();
+                Node *parent = client->nodebyhandle(transfer->getParentHandle());
+
+                if((!localPath && !transfer->getInputStream()) || !parent || !fileName || !(*fileName))
+                {
+                    e = API_EARGS;
+                    break;
+                }
+
+                if(transfer->getInputStream())
+                {
+                    // no local file: the name only identifies the upload
+                    string tmpString = fileName;
+                    string wLocalPath;
+                    client->fsaccess->path2local(&tmpString, &wLocalPath);
+
+                    startUploadTransfer(transfer, &wLocalPath);
+                    break;
+                }
+
+				string tmpString = localPath;
+				string wLocalPath;
+				client->fsaccess->path2local(&tmpString, &wLocalPath);
+
+                if(uploadCopies)
+                {
+                    // fingerprint in the background, then either copy an
+                    // existing node or upload (processFingerprintedUploads)
+                    MegaUploadFingerprintJob *job = new MegaUploadFingerprintJob(transfer, fsAccess->newfileaccess(), &wLocalPath);
+                    fingerprintJobs.push_back(job);
+                    workerPool->push(job);
+                    break;
+                }
+
+                startUploadTransfer(transfer, &wLocalPath);
+				break;
+			}
+			case MegaTransfer::TYPE_DOWNLOAD:
+			{
+                handle nodehandle = transfer->getNodeHandle();
+				Node *node = client->nodebyhandle(nodehandle);
+                MegaNode *publicNode = transfer->getPublicNode();
+                const char *parentPath = transfer->getParentPath();
+                const char *fileName = transfer->getFileName();
+                if(!node && !publicNode) { e = API_EARGS; break; }
+
+                if(transfer->getFolderTransferTag())
+                {
+                    map<int, MegaFolderDownload *>::iterator it = folderDownloads.find(transfer->getFolderTransferTag());
+                    if(it == folderDownloads.end() || it->second->cancelled) { e = API_EINCOMPLETE; break; }
+                }
+
+                if(node && node->type == FOLDERNODE)
+                {
+                    e = startFolderDownload(transfer, node, nextTag);
+                    break;
+                }
+
+                currentTransfer=transfer;
+                if(parentPath || fileName)
+                {
+                    string name;
+                    string securename;
+                    string path;
+
+					if(parentPath)
+					{
+						path = parentPath;
+					}
+					else
+					{
+						string separator;
+						client->fsaccess->local2path(&client->fsaccess->localseparator, &separator);
+						path = ".";
+						path.append(separator);
+					}
+
+					MegaFileGet *f;
+
+					if(node)
+					{
+						if(!fileName)
+                        {
+                            node->resolveattrs();
+                            attr_map::iterator ait = node->attrs.map.find('n');
+                            if(ait == node->attrs.map.end())
+                            {
+                                name = "CRYPTO_ERROR";
+                            }
+                            else if(!ait->second.size())
+                            {
+                                name = "BLANK";
+                            }
+                            else
+                            {
+                                name = ait->second;
+                            }
+                        }
+                        else
+                        {
+                            name = fileName;
+                        }
+
+                        client->fsaccess->name2local(&name);
+                        client->fsaccess->local2path(&name, &securename);
+                        path += securename;
+						f = new MegaFileGet(client, node, path);
+					}
+					else
+					{
+						if(!transfer->getFileName())
+                            name = publicNode->getName();
+                        else
+                            name = transfer->getFileName();
+
+                        client->fsaccess->name2local(&name);
+                        client->fsaccess->local2path(&name, &securename);
+                        path += securename;
+						f = new MegaFileGet(client, publicNode, path);
+					}
+
+					transfer->setPath(path.c_str());
+					if (client->startxfer(GET,f) && node)
+                    {
+                        client->queuefile(f);
+                    }
+                    if(transfer->getTag() == -1)
+                    {
+                        //Already existing transfer
+                        //Delete the new one and set the transfer as regular
+                        transfer_map::iterator it = client->transfers[GET].find(f);
+                        if(it != client->transfers[GET].end())
+                        {
+                            int previousTag = it->second->tag;
+                            if(transferMap.find(previousTag) != transferMap.end())
+                            {
+                                MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
+                                previousTransfer->setSyncTransfer(false);
+                                if(transfer->getFolderTransferTag())
+                                {
+                                    // the file of a folder download is accounted as done
+                                    fireOnTransferFinish(transfer, MegaError(API_EEXIST));
+                                }
+                                else
+                                {
+                                    delete transfer;
+                                }
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                	m_off_t startPos = transfer->getStartPos();
+                	m_off_t endPos = transfer->getEndPos();
+                	if(startPos < 0 || endPos < 0 || startPos > endPos) { e = API_EARGS; break; }
+                	if(node)
+                	{
+                        transfer->setFileName(node->displayname());
+                		if(startPos >= node->size || endPos >= node->size)
+                		{ e = API_EARGS; break; }
+
+                		m_off_t totalBytes = endPos - startPos + 1;
+                	    transferMap[nextTag]=transfer;
+						transfer->setTotalBytes(totalBytes);
+						transfer->setTag(nextTag);
+                        fireOnTransferStart(transfer);
+                	    client->pread(node, startPos, totalBytes, transfer);
+                	    waiter->notify();
+                	}
+                	else
+                	{
+                        transfer->setFileName(publicNode->getName());
+                        if(startPos >= publicNode->getSize() || endPos >= publicNode->getSize())
+                        { e = API_EARGS; break; }
+
+                        m_off_t totalBytes = endPos - startPos + 1;
+                        transferMap[nextTag]=transfer;
+                        transfer->setTotalBytes(totalBytes);
+                        transfer->setTag(nextTag);
+                        fireOnTransferStart(transfer);
+                        SymmCipher cipher;
+                        cipher.setkey(publicNode->getNodeKey());
+                        client->pread(publicNode->getHandle(), &cipher,
+                            MemAccess::get<int64_t>((const char*)publicNode->getNodeKey()->data() + SymmCipher::KEYLENGTH),
+                                      startPos, totalBytes, transfer);
+                        waiter->notify();
+                	}
+                }
+
+                currentTransfer=NULL;
+				break;
+			}
+		}
+
+		if(e)
+            fireOnTransferFinish(transfer, MegaError(e));
+
+        sdkMutex.unlock();
+    }
+}
+
+void MegaApiImpl::removeRecursively(const char *path)
+{
+#ifndef _WIN32
+    string spath = path;
+    PosixFileSystemAccess::emptydirlocal(&spath);
+#else
+    string utf16path;
+    MegaApi::utf8ToUtf16(path, &utf16path);
+    if(utf16path.size())
+    {
+        utf16path.resize(utf16path.size()-2);
+        WinFileSystemAccess::emptydirlocal(&utf16path);
+    }
+#endif
+}
+
+void MegaApiImpl::removeRecursivelyAsync(const char *path, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_LOCAL_FOLDER, listener);
+    request->setFile(path);
+    if(requestQueue.push(request)) waiter->notify();
+}
+
+void MegaApiImpl::cancelRemoveRecursively(const char *path)
+{
+    if(!path)
+    {
+        return;
+    }
+
+    sdkMutex.lock();
+    for (std::list<MegaRemoveRecursivelyJob *>::iterator it = removeJobs.begin(); it != removeJobs.end(); it++)
+    {
+        if(!strcmp((*it)->request->getFile(), path))
+        {
+            (*it)->progress.cancelled = true;
+        }
+    }
+    sdkMutex.unlock();
+}
+
+// report the progress of the background deletions, finish the completed ones
+void MegaApiImpl::processRemoveJobs()
+{
+    sdkMutex.lock();
+
+    for (std::list<MegaRemoveRecursivelyJob *>::iterator it = removeJobs.begin(); it != removeJobs.end(); )
+    {
+        MegaRemoveRecursivelyJob *job = *it;
+
+        if (workerPool->isdone(job))
+        {
+            removeJobs.erase(it++);
+
+            MegaRequestPrivate *request = job->request;
+            request->setTransferredBytes(job->progress.removed);
+            error e = job->progress.cancelled ? API_EINCOMPLETE : API_OK;
+            delete job;
+
+            fireOnRequestFinish(request, MegaError(e));
+            continue;
+        }
+
+        if (job->progress.removed != job->reported)
+        {
+            job->reported = job->progress.removed;
+            job->request->setTransferredBytes(job->reported);
+            fireOnRequestUpdate(job->request);
+        }
+
+        it++;
+    }
+
+    sdkMutex.unlock();
+}
+
+error MegaApiImpl::startFolderDownload(MegaTransferPrivate *transfer, Node *node, int tag)
+{
+    string name = transfer->getFileName() ? transfer->getFileName() : node->displayname();
+    string path;
+
+    if(transfer->getParentPath() || !transfer->getPath())
+    {
+        string securename;
+        string localname = name;
+        client->fsaccess->name2local(&localname);
+        client->fsaccess->local2path(&localname, &securename);
+
+        if(transfer->getParentPath())
+        {
+            path = transfer->getParentPath();
+        }
+        else
+        {
+            client->fsaccess->local2path(&client->fsaccess->localseparator, &path);
+            path.insert(0, ".");
+        }
+        path.append(securename);
+    }
+    else
+    {
+        path = transfer->getPath();
+    }
+
+    MegaFolderDownload *folder = new MegaFolderDownload(transfer);
+    if(!folder->snapshot(client, node, &path))
+    {
+        delete folder;
+        return API_EINCOMPLETE;
+    }
+
+    transfer->setPath(path.c_str());
+    transfer->setFileName(name.c_str());
+    transfer->setTag(tag);
+    transfer->setTotalBytes(folder->totalbytes);
+    transfer->setStartTime(Waiter::ds);
+    transferMap[tag] = transfer;
+    folderDownloads[tag] = folder;
+
+    fireOnTransferStart(transfer);
+
+    LOG_debug << "Folder download: " << folder->folders.size() << " folders, " << folder->files.size() << " files";
+    workerPool->push(folder);
+    return API_OK;
+}
+
+// start the files of the folder downloads whose local folders have been created
+void MegaApiImpl::processFolderDownloads()
+{
+    sdkMutex.lock();
+
+    for (map<int, MegaFolderDownload *>::iterator it = folderDownloads.begin(); it != folderDownloads.end(); )
+    {
+        MegaFolderDownload *folder = it->second;
+
+        if (folder->started || !workerPool->isdone(folder))
+        {
+            it++;
+            continue;
+        }
+
+        folder->started = true;
+        if (folder->e || folder->cancelled || !folder->files.size())
+        {
+            folder->lasterror = folder->e ? folder->e : (folder->cancelled ? API_EINCOMPLETE : API_OK);
+            folderDownloads.erase(it++);
+            finishFolderDownload(folder);
+            continue;
+        }
+
+        feedFolderDownload(folder);
+        it++;
+    }
+
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::feedFolderDownload(MegaFolderDownload *folder)
+{
+    vector<MegaTransferPrivate *> transfers;
+    folder->feed(maxRetries, &transfers);
+
+    if (transfers.size() && transferQueue.push(&transfers))
+    {
+        waiter->notify();
+    }
+}
+
+void MegaApiImpl::updateFolderDownload(MegaTransferPrivate *subtransfer)
+{
+    map<int, MegaFolderDownload *>::iterator it = folderDownloads.find(subtransfer->getFolderTransferTag());
+    if (it != folderDownloads.end())
+    {
+        it->second->update(subtransfer);
+        fireOnTransferUpdate(it->second->transfer);
+    }
+}
+
+// returns the folder download if this was its last file
+MegaFolderDownload *MegaApiImpl::finishFolderSubtransfer(MegaTransferPrivate *subtransfer, error e)
+{
+    map<int, MegaFolderDownload *>::iterator it = folderDownloads.find(subtransfer->getFolderTransferTag());
+    if (it == folderDownloads.end())
+    {
+        return NULL;
+    }
+
+    MegaFolderDownload *folder = it->second;
+    if (folder->finish(subtransfer, e))
+    {
+        folderDownloads.erase(it);
+        return folder;
+    }
+
+    feedFolderDownload(folder);
+    fireOnTransferUpdate(folder->transfer);
+    return NULL;
+}
+
+void MegaApiImpl::finishFolderDownload(MegaFolderDownload *folder)
+{
+    MegaTransferPrivate *transfer = folder->transfer;
+    error e = folder->cancelled ? API_EINCOMPLETE : folder->lasterror;
+    delete folder;
+
+    if (e)
+    {
+        transfer->setLastErrorCode(e);
+    }
+    fireOnTransferFinish(transfer, MegaError(e));
+}
+
+
+// continue the requests whose password keys have been derived
+void MegaApiImpl::processPwKeyJobs()
+{
+    sdkMutex.lock();
+
+    for (std::list<MegaPwKeyJob *>::iterator it = pwKeyJobs.begin(); it != pwKeyJobs.end(); )
+    {
+        MegaPwKeyJob *job = *it;
+
+        if (!workerPool->isdone(job))
+        {
+            it++;
+            continue;
+        }
+
+        pwKeyJobs.erase(it++);
+
+        std::map<int, MegaRequestPrivate *>::iterator rit = requestMap.find(job->tag);
+        MegaRequestPrivate *request = (rit != requestMap.end()) ? rit->second : NULL;
+
+        if (!request)
+        {
+            delete job;
+            continue;
+        }
+
+        error e = job->e;
+
+        if (!e)
+        {
+            client->reqtag = job->tag;
+
+            switch (request->getType())
+            {
+                case MegaRequest::TYPE_LOGIN:
+                    client->login(job->email.c_str(), job->pwkey[0]);
+                    break;
+
+                case MegaRequest::TYPE_CHANGE_PW:
+                    e = client->changepw(job->pwkey[0], job->pwkey[1]);
+                    break;
+
+                case MegaRequest::TYPE_GET_PW_KEY:
+                {
+                    char buf[SymmCipher::KEYLENGTH * 4 / 3 + 4];
+                    Base64::btoa(job->pwkey[0], SymmCipher::KEYLENGTH, buf);
+                    request->setPrivateKey(buf);
+                    fireOnRequestFinish(request, MegaError(API_OK));
+                    break;
+                }
+            }
+        }
+        else
+        {
+            e = API_EARGS;
+        }
+
+        if (e)
+        {
+            fireOnRequestFinish(request, MegaError(e));
+        }
+
+        delete job;
+    }
+
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::sendPendingRequests()
+{
+	MegaRequestPrivate *request;
+	error e;
+    int nextTag = 0;
+
+	while((request = requestQueue.pop()))
+	{
+        if(!nextTag)
+        {
+            client->abortbackoff(false);
+        }
+
+		sdkMutex.lock();
+		nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+		requestMap[nextTag]=request;
+		e = API_OK;
+
+        fireOnRequestStart(request);
+		switch(request->getType())
+		{
+		case MegaRequest::TYPE_LOGIN:
+		{
+			const char *login = request->getEmail();
+			const char *password = request->getPassword();
+            const char* megaFolderLink = request->getLink();
+            const char* base64pwkey = request->getPrivateKey();
+            const char* sessionKey = request->getSessionKey();
+
+            if(!megaFolderLink && (!(login && password)) && !sessionKey && (!(login && base64pwkey)))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            string slogin;
+            if(login)
+            {
+                slogin = login;
+                slogin.erase(slogin.begin(), std::find_if(slogin.begin(), slogin.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
+                slogin.erase(std::find_if(slogin.rbegin(), slogin.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), slogin.end());
+            }
+
+            requestMap.erase(request->getTag());
+            while(!requestMap.empty())
+            {
+                std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+                if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
+            }
+
+            while(!transferMap.empty())
+            {
+                std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
+                if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
+            }
+            requestMap[request->getTag()]=request;
+
+            if(sessionKey)
+            {
+                byte session[MAX_SESSION_LENGTH];
+                int size = Base64::atob(sessionKey, (byte *)session, sizeof session);
+                client->login(session, size);
+            }
+            else if(login && base64pwkey)
+            {
+                byte pwkey[SymmCipher::KEYLENGTH];
+                Base64::atob(base64pwkey, (byte *)pwkey, sizeof pwkey);
+
+                if(password)
+                {
+                    uint64_t emailhash;
+                    Base64::atob(password, (byte *)&emailhash, sizeof emailhash);
+                    client->fastlogin(slogin.c_str(), pwkey, emailhash);
+                }
+                else
+                {
+                    client->login(slogin.c_str(), pwkey);
+                }
+            }
+            else if(login && password)
+            {
+                // the key derivation takes long on slow devices
+                MegaPwKeyJob *job = new MegaPwKeyJob(request->getTag(), password);
+                job->email = slogin;
+                pwKeyJobs.push_back(job);
+                workerPool->push(job);
+            }
+            else
+            {
+                const char* ptr;
+                if (!((ptr = strstr(megaFolderLink,"#F!")) && (strlen(ptr)>12) && ptr[11] == '!'))
+                {
+                    e = API_EARGS;
+                    break;
+                }
+                e = client->folderaccess(ptr+3,ptr+12);
+                if(e == API_OK)
+                {
+                    fireOnRequestFinish(request, MegaError(e));
+                }
+            }
+
+            break;
+		}
+        case MegaRequest::TYPE_CREATE_FOLDER:
+		{
+			Node *parent = client->nodebyhandle(request->getParentHandle());
+			const char *name = request->getName();
+			if(!name || !parent) { e = API_EARGS; break; }
+
+			NewNode *newnode = new NewNode[1];
+			SymmCipher key;
+			string attrstring;
+			byte buf[FOLDERNODEKEYLENGTH];
+
+			// set up new node as folder node
+			newnode->source = NEW_NODE;
+			newnode->type = FOLDERNODE;
+			newnode->nodehandle = 0;
+			newnode->parenthandle = UNDEF;
+
+			// generate fresh random key for this folder node
+			PrnGen::genblock(buf,FOLDERNODEKEYLENGTH);
+			newnode->nodekey.assign((char*)buf,FOLDERNODEKEYLENGTH);
+			key.setkey(buf);
+
+			// generate fresh attribute object with the folder name
+			AttrMap attrs;
+            string sname = name;
+            fsAccess->normalize(&sname);
+            attrs.map['n'] = sname;
+
+			// JSON-encode object and encrypt attribute string
+			attrs.getjson(&attrstring);
+            newnode->attrstring = new string;
+            client->makeattr(&key,newnode->attrstring,attrstring.c_str());
+
+			// add the newly generated folder node
+			client->putnodes(parent->nodehandle,newnode,1);
+			break;
+		}
+		case MegaRequest::TYPE_MOVE:
+		{
+			Node *node = client->nodebyhandle(request->getNodeHandle());
+			Node *newParent = client->nodebyhandle(request->getParentHandle());
+			if(!node || !newParent) { e = API_EARGS; break; }
+
+            if(node->parent == newParent)
+            {
+                fireOnRequestFinish(request, MegaError(API_OK));
+                break;
+            }
+			if((e = client->checkmove(node,newParent))) break;
+
+			e = client->rename(node, newParent);
+			break;
+		}
+		case MegaRequest::TYPE_COPY:
+		{
+			Node *node = client->nodebyhandle(request->getNodeHandle());
+			Node *target = client->nodebyhandle(request->getParentHandle());
+			const char* email = request->getEmail();
+            MegaNode *publicNode = request->getPublicNode();
+            const char *newName = request->getName();
+
+            if((!node && !publicNode) || (!target && !email) || (newName && !(*newName))) { e = API_EARGS; break; }
+
+            if(publicNode)
+            {
+                if(publicNode->getAuth()->size())
+                {
+                    e = API_EACCESS;
+                    break;
+                }
+
+                NewNode *newnode = new NewNode[1];
+                newnode->nodekey.assign(publicNode->getNodeKey()->data(), publicNode->getNodeKey()->size());
+                newnode->attrstring = new string;
+                newnode->attrstring->assign(publicNode->getAttrString()->data(), publicNode->getAttrString()->size());
+                newnode->nodehandle = publicNode->getHandle();
+                newnode->source = NEW_PUBLIC;
+                newnode->type = FILENODE;
+                newnode->parenthandle = UNDEF;
+
+                if(target)
+                {
+                    client->putnodes(target->nodehandle, newnode, 1);
+                }
+                else
+                {
+                    client->putnodes(email, newnode, 1);
+                }
+            }
+            else
+            {
+                unsigned nc;
+                TreeProcCopy tc;
+
+                // determine number of nodes to be copied
+                client->proctree(node,&tc);
+                tc.allocnodes();
+                nc = tc.nc;
+
+                // build new nodes array
+                client->proctree(node,&tc);
+                if (!nc)
+                {
+                    e = API_EARGS;
+                    break;
+                }
+
+                tc.nn->parenthandle = UNDEF;
+
+                if(nc == 1 && newName && tc.nn[0].nodekey.size())
+                {
+                    SymmCipher key;
+                    AttrMap attrs;
+                    string attrstring;
+
+                    key.setkey((const byte*)tc.nn[0].nodekey.data(), node->type);
+                    node->resolveattrs();
+                    attrs = node->attrs;
+
+                    string sname = newName;
+                    fsAccess->normalize(&sname);
+                    attrs.map['n'] = sname;
+
+                    attrs.getjson(&attrstring);
+                    client->makeattr(&key,tc.nn[0].attrstring, attrstring.c_str());
+                }
+
+                if (target && nc > MegaClient::PUTNODESTREEBATCH)
+                {
+                    // large trees are created in pipelined batches
+                    client->putnodestree(target->nodehandle, tc.nn, nc);
+                }
+                else if (target)
+                {
+                    client->putnodes(target->nodehandle,tc.nn,nc);
+                }
+                else
+                {
+                    client->putnodes(email, tc.nn, nc);
+                }
+            }
+			break;
+		}
+        case MegaRequest::TYPE_RENAME:
+        {
+            Node* node = client->nodebyhandle(request->getNodeHandle());
+            const char* newName = request->getName();
+            if(!node || !newName || !(*newName)) { e = API_EARGS; break; }
+
+            if (!client->checkaccess(node,FULL)) { e = API_EACCESS; break; }
+
+            string sname = newName;
+            fsAccess->normalize(&sname);
+            node->resolveattrs();
+            node->attrs.map['n'] = sname;
+            e = client->setattr(node);
+            break;
+        }
+		case MegaRequest::TYPE_REMOVE:
+		{
+			Node* node = client->nodebyhandle(request->getNodeHandle());
+			if(!node) { e = API_EARGS; break; }
+
+			e = client->unlink(node);
+			break;
+		}
+		case MegaRequest::TYPE_SHARE:
+		{
+			Node *node = client->nodebyhandle(request->getNodeHandle());
+			const char* email = request->getEmail();
+			int access = request->getAccess();
+            if(!node || !email || !strchr(email, '@'))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            accesslevel_t a;
+			switch(access)
+			{
+				case MegaShare::ACCESS_UNKNOWN:
+                    a = ACCESS_UNKNOWN;
+                    break;
+				case MegaShare::ACCESS_READ:
+					a = RDONLY;
+					break;
+				case MegaShare::ACCESS_READWRITE:
+					a = RDWR;
+					break;
+				case MegaShare::ACCESS_FULL:
+					a = FULL;
+					break;
+				case MegaShare::ACCESS_OWNER:
+					a = OWNER;
+					break;
+                default:
+                    e = API_EARGS;
+			}
+
+            if(e == API_OK)
+                client->setshare(node, email, a);
+			break;
+		}
+		case MegaRequest::TYPE_IMPORT_LINK:
+		case MegaRequest::TYPE_GET_PUBLIC_NODE:
+		{
+			Node *node = client->nodebyhandle(request->getParentHandle());
+			const char* megaFileLink = request->getLink();
+			if(!megaFileLink) { e = API_EARGS; break; }
+			if((request->getType()==MegaRequest::TYPE_IMPORT_LINK) && (!node)) { e = API_EARGS; break; }
+
+			e = client->openfilelink(megaFileLink, 1);
+			break;
+		}
+		case MegaRequest::TYPE_EXPORT:
+		{
+			Node* node = client->nodebyhandle(request->getNodeHandle());
+			if(!node) { e = API_EARGS; break; }
+
+            e = client->exportnode(node, !request->getAccess());
+			break;
+		}
+        case MegaRequest::TYPE_EXPORT_NODES:
+        case MegaRequest::TYPE_SET_NODES_ATTRIBUTE:
+        {
+            MegaNodeList *nodes = request->getMegaNodeList();
+            const char *attrName = request->getName();
+            bool exporting = request->getType() == MegaRequest::TYPE_EXPORT_NODES;
+            if (!nodes || (!exporting && (!attrName || !*attrName || strlen(attrName) > 7)))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            string name;
+            if (!exporting)
+            {
+                name = "_";
+                name += attrName;
+            }
+
+            // all the commands are queued at once, so that they are sent in
+            // large batches - the results arrive in the same order
+            for (int i = 0; i < nodes->size(); i++)
+            {
+                Node *node = client->nodebyhandle(nodes->get(i)->getHandle());
+                error ne;
+
+                if (!node)
+                {
+                    ne = API_ENOENT;
+                }
+                else if (exporting)
+                {
+                    ne = client->exportnode(node, 0);
+                }
+                else
+                {
+                    nameid id = client->json.getnameid(name.c_str());
+                    node->resolveattrs();
+                    if (request->getText())
+                    {
+                        node->attrs.map[id] = request->getText();
+                    }
+                    else
+                    {
+                        node->attrs.map.erase(id);
+                    }
+                    ne = client->setattr(node);
+                }
+
+                if (ne)
+                {
+                    request->setNodeResult(i, ne);
+                }
+                else
+                {
+                    request->setNodeResult(i, API_OK);
+                    request->addPendingNode(i);
+                }
+            }
+
+            if (!request->getNumPendingNodes())
+            {
+                // nothing sent: the request finishes with the first error
+                error result = API_OK;
+                for (int i = 0; i < nodes->size() && !result; i++)
+                {
+                    result = (error)request->getNodeErrorCode(i);
+                }
+                fireOnRequestFinish(request, MegaError(result));
+            }
+            break;
+        }
+		case MegaRequest::TYPE_FETCH_NODES:
+		{
+			client->fetchnodes();
+			break;
+		}
+        case MegaRequest::TYPE_FETCH_FOLDER:
+        {
+            handle h = request->getNodeHandle();
+
+            // (fetches triggered by browsing are only issued once)
+            if(request->getParamType() && client->childfetches.count(h))
+            {
+                fireOnRequestFinish(request, MegaError(API_OK));
+                break;
+            }
+
+            e = client->fetchchildren(h, request->getFlag());
+            break;
+        }
+		case MegaRequest::TYPE_ACCOUNT_DETAILS:
+		{
+            if(client->loggedin() != FULLACCOUNT)
+            {
+                e = API_EACCESS;
+                break;
+            }
+
+			int numDetails = request->getNumDetails();
+			bool storage = (numDetails & 0x01) != 0;
+			bool transfer = (numDetails & 0x02) != 0;
+			bool pro = (numDetails & 0x04) != 0;
+			bool transactions = (numDetails & 0x08) != 0;
+			bool purchases = (numDetails & 0x10) != 0;
+			bool sessions = (numDetails & 0x20) != 0;
+
+			numDetails = 1;
+			if(transactions) numDetails++;
+			if(purchases) numDetails++;
+			if(sessions) numDetails++;
+
+			request->setNumDetails(numDetails);
+
+			client->getaccountdetails(request->getAccountDetails(), storage, transfer, pro, transactions, purchases, sessions);
+			break;
+		}
+		case MegaRequest::TYPE_CHANGE_PW:
+		{
+			const char* oldPassword = request->getPassword();
+			const char* newPassword = request->getNewPassword();
+			if(!oldPassword || !newPassword) { e = API_EARGS; break; }
+
+			MegaPwKeyJob *job = new MegaPwKeyJob(nextTag, oldPassword, newPassword);
+			pwKeyJobs.push_back(job);
+			workerPool->push(job);
+			break;
+		}
+		case MegaRequest::TYPE_LOGOUT:
+		{
+            if(request->getFlag())
+            {
+                client->logout();
+            }
+            else
+            {
+                client->locallogout();
+                client->restag = nextTag;
+                logout_result(API_OK);
+            }
+			break;
+		}
+		case MegaRequest::TYPE_GET_ATTR_FILE:
+		{
+			const char* dstFilePath = request->getFile();
+            int type = request->getParamType();
+			Node *node = client->nodebyhandle(request->getNodeHandle());
+
+			if(!dstFilePath || !node) { e = API_EARGS; break; }
+
+			e = client->getfa(node, type, 0, request->getFlag());
+            if(e == API_EEXIST)
+            {
+                e = API_OK;
+                int prevtag = client->restag;
+                MegaRequestPrivate* req = NULL;
+                while(prevtag)
+                {
+                    if(requestMap.find(prevtag) == requestMap.end())
+                    {
+                        LOG_err << "Invalid duplicate getattr request";
+                        req = NULL;
+                        e = API_EINTERNAL;
+                        break;
+                    }
+
+                    req = requestMap.at(prevtag);
+                    if(!req || (req->getType() != MegaRequest::TYPE_GET_ATTR_FILE))
+                    {
+                        LOG_err << "Invalid duplicate getattr type";
+                        req = NULL;
+                        e = API_EINTERNAL;
+                        break;
+                    }
+
+                    prevtag = req->getNumber();
+                }
+
+                if(req)
+                {
+                    LOG_debug << "Duplicate getattr detected";
+                    req->setNumber(request->getTag());
+                }
+            }
+			break;
+		}
+		case MegaRequest::TYPE_GET_ATTR_USER:
+		{
+            const char* value = request->getFile();
+            int type = request->getParamType();
+            const char *email = request->getEmail();
+
+            User *user;
+            if(email)
+            {
+                user = client->finduser(email, 0);
+            }
+            else
+            {
+                user = client->finduser(client->me, 0);
+            }
+
+            if((!type && !value) || !user || (type < 0)) { e = API_EARGS; break; }
+
+            if(!type)
+            {
+                client->getua(user, "a", 0);
+            }
+            else
+            {
+                string attrname;
+                switch(type)
+                {
+                    case MegaApi::USER_ATTR_FIRSTNAME:
+                    {
+                        attrname = "firstname";
+                        break;
+                    }
+
+                    case MegaApi::USER_ATTR_LASTNAME:
+                    {
+                        attrname = "lastname";
+                        break;
+                    }
+
+                    default:
+                    {
+                        e = API_EARGS;
+                        break;
+                    }
+                }
+
+                if(!e)
+                {
+                    client->getua(user, attrname.c_str(), 2);
+                }
+            }
+            break;
+		}
+		case MegaRequest::TYPE_SET_ATTR_USER:
+		{
+            const char* file = request->getFile();
+            const char* value = request->getText();
+            int type = request->getParamType();
+
+            if ((!type && !file) || (type < 0) || (type && !value))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if(!type)
+            {
+                string path = file;
+                string localpath;
+                fsAccess->path2local(&path, &localpath);
+
+                string attributedata;
+                FileAccess *f = fsAccess->newfileaccess();
+                if (!f->fopen(&localpath, 1, 0))
+                {
+                    delete f;
+                    e = API_EREAD;
+                    break;
+                }
+
+                if (!f->fread(&attributedata, f->size, 0, 0))
+                {
+                    delete f;
+                    e = API_EREAD;
+                    break;
+                }
+                delete f;
+
+                client->putua("a", (byte *)attributedata.data(), attributedata.size(), 0);
+            }
+            else
+            {
+                string attrname;
+                string attrvalue = value;
+                switch(type)
+                {
+                    case MegaApi::USER_ATTR_FIRSTNAME:
+                    {
+                        attrname = "firstname";
+                        break;
+                    }
+
+                    case MegaApi::USER_ATTR_LASTNAME:
+                    {
+                        attrname = "lastname";
+                        break;
+                    }
+
+                    default:
+                    {
+                        e = API_EARGS;
+                        break;
+                    }
+                }
+                if(!e)
+                {
+                    client->putua(attrname.c_str(), (byte *)attrvalue.data(), attrvalue.size(), 2);
+                }
+            }
+            break;
+		}
+        case MegaRequest::TYPE_SET_ATTR_FILE:
+        {
+            const char* srcFilePath = request->getFile();
+            int type = request->getParamType();
+            Node *node = client->nodebyhandle(request->getNodeHandle());
+
+            if(!srcFilePath || !node) { e = API_EARGS; break; }
+
+            string path = srcFilePath;
+            string localpath;
+            fsAccess->path2local(&path, &localpath);
+
+            string *attributedata = new string;
+            FileAccess *f = fsAccess->newfileaccess();
+            if (!f->fopen(&localpath, 1, 0))
+            {
+                delete f;
+                delete attributedata;
+                e = API_EREAD;
+                break;
+            }
+
+            if(!f->fread(attributedata, f->size, 0, 0))
+            {
+                delete f;
+                delete attributedata;
+                e = API_EREAD;
+                break;
+            }
+            delete f;
+
+            client->putfa(node->nodehandle, type, node->nodecipher(), attributedata);
+            //attributedata is not deleted because putfa takes its ownership
+            break;
+        }
+		case MegaRequest::TYPE_CANCEL_ATTR_FILE:
+		{
+			int type = request->getParamType();
+			Node *node = client->nodebyhandle(request->getNodeHandle());
+
+			if (!node) { e = API_EARGS; break; }
+
+			e = client->getfa(node, type, 1);
+			if (!e)
+			{
+				std::map<int, MegaRequestPrivate*>::iterator it = requestMap.begin();
+				while(it != requestMap.end())
+				{
+					MegaRequestPrivate *r = it->second;
+					it++;
+					if (r->getType() == MegaRequest::TYPE_GET_ATTR_FILE &&
+						r->getParamType() == request->getParamType() &&
+						r->getNodeHandle() == request->getNodeHandle())
+					{
+						fireOnRequestFinish(r, MegaError(API_EINCOMPLETE));
+					}
+				}
+				fireOnRequestFinish(request, MegaError(e));
+			}
+			break;
+		}
+		case MegaRequest::TYPE_RETRY_PENDING_CONNECTIONS:
+		{
+			bool disconnect = request->getFlag();
+			bool includexfers = request->getNumber();
+			client->abortbackoff(includexfers);
+			if(disconnect)
+            {
+                client->disconnect();
+
+#if (WINDOWS_PHONE || TARGET_OS_IPHONE)
+                // Workaround to get the IP of valid DNS servers on Windows Phone/iOS
+                string servers;
+                struct hostent *hp;
+                struct in_addr **addr_list;
+
+                while (true)
+                {
+                    hp = gethostbyname("ns.mega.co.nz");
+                    if (hp != NULL && hp->h_addr != NULL)
+                    {
+                        addr_list = (struct in_addr **)hp->h_addr_list;
+                        for (int i = 0; addr_list[i] != NULL; i++)
+                        {
+                            char str[INET_ADDRSTRLEN];
+                            const char *ip = inet_ntop(AF_INET, addr_list[i], str, INET_ADDRSTRLEN);
+                            if(ip == str)
+                            {
+                                if (servers.size())
+                                {
+                                    servers.append(",");
+                                }
+                                servers.append(ip);
+                            }
+                        }
+
+                        if (servers.size())
+                            break;
+                    }
+                    #ifdef WINDOWS_PHONE
+                        std::this_thread::sleep_for(std::chrono::seconds(1));
+                    #else
+                        sleep(1);
+                    #endif
+                }
+
+                LOG_debug << "Using MEGA DNS servers";
+                httpio->setdnsservers(servers.c_str());
+#endif
+            }
+
+			fireOnRequestFinish(request, MegaError(API_OK));
+			break;
+		}
+		case MegaRequest::TYPE_ADD_CONTACT:
+		{
+			const char *email = request->getEmail();
+			if(!email) { e = API_EARGS; break; }
+			e = client->invite(email, VISIBLE);
+			break;
+		}
+        case MegaRequest::TYPE_INVITE_CONTACT:
+        {
+            const char *email = request->getEmail();
+            const char *message = request->getText();
+            int action = request->getNumber();
+            if(!email)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            client->setpcr(email, (opcactions_t)action, message);
+            break;
+        }
+        case MegaRequest::TYPE_REPLY_CONTACT_REQUEST:
+        {
+            handle h = request->getNodeHandle();
+            int action = request->getNumber();
+
+            if(h == INVALID_HANDLE || action < 0 || action > MegaContactRequest::REPLY_ACTION_IGNORE)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            client->updatepcr(h, (ipcactions_t)action);
+            break;
+        }
+		case MegaRequest::TYPE_REMOVE_CONTACT:
+		{
+			const char *email = request->getEmail();
+			if(!email) { e = API_EARGS; break; }
+			e = client->invite(email, HIDDEN);
+			break;
+		}
+		case MegaRequest::TYPE_CREATE_ACCOUNT:
+		{
+			const char *email = request->getEmail();
+			const char *password = request->getPassword();
+			const char *name = request->getName();
+			const char *pwkey = request->getPrivateKey();
+
+            if(!email || !name || (!password && !pwkey))
+			{
+				e = API_EARGS; break;
+			}
+
+            requestMap.erase(request->getTag());
+            while(!requestMap.empty())
+            {
+                std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+                if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
+            }
+
+            while(!transferMap.empty())
+            {
+                std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
+                if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
+            }
+            requestMap[request->getTag()]=request;
+
+			client->createephemeral();
+			break;
+		}
+		case MegaRequest::TYPE_QUERY_SIGNUP_LINK:
+		case MegaRequest::TYPE_CONFIRM_ACCOUNT:
+		{
+			const char *link = request->getLink();
+			const char *password = request->getPassword();
+			const char *pwkey = request->getPrivateKey();
+
+            if(!link || (request->getType() == MegaRequest::TYPE_CONFIRM_ACCOUNT && !password && !pwkey))
+			{
+				e = API_EARGS;
+				break;
+			}
+
+			const char* ptr = link;
+			const char* tptr;
+
+			if ((tptr = strstr(ptr,"#confirm"))) ptr = tptr+8;
+
+			unsigned len = (strlen(link)-(ptr-link))*3/4+4;
+			byte *c = new byte[len];
+            len = Base64::atob(ptr,c,len);
+			client->querysignuplink(c,len);
+			delete[] c;
 			break;
 		}
-		case MegaRequest::TYPE_QUERY_SIGNUP_LINK:
-		case MegaRequest::TYPE_CONFIRM_ACCOUNT:
+        case MegaRequest::TYPE_PAUSE_TRANSFERS:
+        {
+            bool pause = request->getFlag();
+            int direction = request->getNumber();
+            if(direction != -1
+                    && direction != MegaTransfer::TYPE_DOWNLOAD
+                    && direction != MegaTransfer::TYPE_UPLOAD)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if(direction == -1)
+            {
+                client->pausexfers(PUT, pause);
+                client->pausexfers(GET, pause);
+            }
+            else if(direction == MegaTransfer::TYPE_DOWNLOAD)
+            {
+                client->pausexfers(GET, pause);
+            }
+            else
+            {
+                client->pausexfers(PUT, pause);
+            }
+
+            fireOnRequestFinish(request, MegaError(API_OK));
+            break;
+        }
+        case MegaRequest::TYPE_CANCEL_TRANSFER:
+        {
+            int transferTag = request->getTransferTag();
+            if(transferMap.find(transferTag) == transferMap.end()) { e = API_ENOENT; break; };
+
+            MegaTransferPrivate* megaTransfer = transferMap.at(transferTag);
+            Transfer *transfer = megaTransfer->getTransfer();
+
+            map<int, MegaFolderDownload *>::iterator fit = folderDownloads.find(transferTag);
+            if(fit != folderDownloads.end())
+            {
+                // the files still queued are dropped when they are dispatched,
+                // the folder finishes with the last one
+                MegaFolderDownload *folder = fit->second;
+                folder->cancelled = true;
+
+                set<Transfer *> transfers;
+                for(map<MegaTransferPrivate *, MegaFolderDownload::Active>::iterator it = folder->active.begin(); it != folder->active.end(); it++)
+                {
+                    if(it->first->getTransfer())
+                    {
+                        transfers.insert(it->first->getTransfer());
+                    }
+                }
+
+                vector<File *> files;
+                for(set<Transfer *>::iterator it = transfers.begin(); it != transfers.end(); it++)
+                {
+                    for(file_list::iterator fi = (*it)->files.begin(); fi != (*it)->files.end(); fi++)
+                    {
+                        if(!(*fi)->syncxfer) files.push_back(*fi);
+                    }
+                }
+
+                for(unsigned i = 0; i < files.size(); i++)
+                {
+                    client->stopxfer(files[i]);
+                }
+
+                fireOnRequestFinish(request, MegaError(API_OK));
+                break;
+            }
+
+            #ifdef _WIN32
+                if(transfer->type==GET)
+                {
+                    transfer->localfilename.append("", 1);
+                    WIN32_FILE_ATTRIBUTE_DATA fad;
+                    if (GetFileAttributesExW((LPCWSTR)transfer->localfilename.data(), GetFileExInfoStandard, &fad))
+                        SetFileAttributesW((LPCWSTR)transfer->localfilename.data(), fad.dwFileAttributes & ~FILE_ATTRIBUTE_HIDDEN);
+                    transfer->localfilename.resize(transfer->localfilename.size()-1);
+                }
+            #endif
+
+            megaTransfer->setSyncTransfer(true);
+            megaTransfer->setLastErrorCode(API_EINCOMPLETE);
+
+            file_list files = transfer->files;
+            file_list::iterator iterator = files.begin();
+            while (iterator != files.end())
+            {
+                File *file = *iterator;
+                iterator++;
+                if(!file->syncxfer) client->stopxfer(file);
+            }
+            fireOnRequestFinish(request, MegaError(API_OK));
+            break;
+        }
+        case MegaRequest::TYPE_CANCEL_TRANSFERS:
+        {
+            int direction = request->getParamType();
+            if((direction != MegaTransfer::TYPE_DOWNLOAD) && (direction != MegaTransfer::TYPE_UPLOAD))
+                { e = API_EARGS; break; }
+
+            if(direction == MegaTransfer::TYPE_DOWNLOAD)
+            {
+                // no more files of the folder downloads
+                for (map<int, MegaFolderDownload *>::iterator it = folderDownloads.begin(); it != folderDownloads.end(); it++)
+                {
+                    it->second->cancelled = true;
+                }
+            }
+
+            for (transfer_map::iterator it = client->transfers[direction].begin() ; it != client->transfers[direction].end() ; )
+            {
+                Transfer *transfer = it->second;
+                if(transferMap.find(transfer->tag) != transferMap.end())
+                {
+                    MegaTransferPrivate* megaTransfer = transferMap.at(transfer->tag);
+                    megaTransfer->setSyncTransfer(true);
+                    megaTransfer->setLastErrorCode(API_EINCOMPLETE);
+                }
+
+                it++;
+
+                file_list files = transfer->files;
+				file_list::iterator iterator = files.begin();
+				while (iterator != files.end())
+				{
+					File *file = *iterator;
+					iterator++;
+					if(!file->syncxfer) client->stopxfer(file);
+				}
+            }
+            fireOnRequestFinish(request, MegaError(API_OK));
+            break;
+        }
+#ifdef ENABLE_SYNC
+        case MegaRequest::TYPE_ADD_SYNC:
+        {
+            const char *localPath = request->getFile();
+            Node *node = client->nodebyhandle(request->getNodeHandle());
+            if(!node || (node->type==FILENODE) || !localPath)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            string utf8name(localPath);
+            string localname;
+            client->fsaccess->path2local(&utf8name, &localname);
+            e = client->addsync(&localname, DEBRISFOLDER, NULL, node, 0, -nextTag);
+            if(!e)
+            {
+                MegaSyncPrivate *sync = new MegaSyncPrivate(client->syncs.back());
+                sync->setListener(request->getSyncListener());
+                syncMap[-nextTag] = sync;
+
+                request->setNumber(client->syncs.back()->fsfp);
+                fireOnRequestFinish(request, MegaError(API_OK));
+            }
+            break;
+        }
+        case MegaRequest::TYPE_REMOVE_SYNCS:
+        {
+            sync_list::iterator it = client->syncs.begin();
+            while(it != client->syncs.end())
+            {
+                Sync *sync = (*it);
+                int tag = sync->tag;
+                it++;
+
+                client->delsync(sync);
+
+                if(syncMap.find(tag) == syncMap.end())
+                {
+                    MegaSyncPrivate *megaSync = syncMap.at(tag);
+                    syncMap.erase(tag);
+                    delete megaSync;
+                }
+            }
+            fireOnRequestFinish(request, MegaError(API_OK));
+            break;
+        }
+        case MegaRequest::TYPE_REMOVE_SYNC:
+        {
+            handle nodehandle = request->getNodeHandle();
+            sync_list::iterator it = client->syncs.begin();
+            bool found = false;
+            while(it != client->syncs.end())
+            {
+                Sync *sync = (*it);
+                int tag = sync->tag;
+                if(!sync->localroot.node || sync->localroot.node->nodehandle == nodehandle)
+                {
+                    string path;
+                    fsAccess->local2path(&sync->localroot.localname, &path);
+                    request->setFile(path.c_str());
+                    client->delsync(sync, request->getFlag());
+
+                    if(syncMap.find(tag) == syncMap.end())
+                    {
+                        MegaSyncPrivate *megaSync = syncMap.at(tag);
+                        syncMap.erase(tag);
+                        delete megaSync;
+                    }
+
+                    fireOnRequestFinish(request, MegaError(API_OK));
+                    found = true;
+                    break;
+                }
+                it++;
+            }
+
+            if(!found) e = API_ENOENT;
+            break;
+        }
+#endif
+        case MegaRequest::TYPE_REPORT_EVENT:
+        {
+            const char *details = request->getText();
+            if(!details)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            string event = "A"; //Application event
+            int size = strlen(details);
+            char *base64details = new char[size * 4 / 3 + 4];
+            Base64::btoa((byte *)details, size, base64details);
+            client->reportevent(event.c_str(), base64details);
+            delete base64details;
+            break;
+        }
+        case MegaRequest::TYPE_DELETE:
+        {
+            threadExit = 1;
+            break;
+        }
+        case MegaRequest::TYPE_GET_PRICING:
+        case MegaRequest::TYPE_GET_PAYMENT_ID:
+        case MegaRequest::TYPE_UPGRADE_ACCOUNT:
+        {
+            int method = request->getNumber();
+            if(method != MegaApi::PAYMENT_METHOD_BALANCE && method != MegaApi::PAYMENT_METHOD_CREDIT_CARD)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            client->purchase_enumeratequotaitems();
+            break;
+        }
+        case MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT:
+        {
+            const char* receipt = request->getText();
+            int type = request->getNumber();
+
+            if(!receipt || (type != MegaApi::PAYMENT_METHOD_GOOGLE_WALLET
+                            && type != MegaApi::PAYMENT_METHOD_ITUNES))
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if(type == MegaApi::PAYMENT_METHOD_ITUNES && client->loggedin() != FULLACCOUNT)
+            {
+                e = API_EACCESS;
+                break;
+            }
+
+            string base64receipt;
+            if(type == MegaApi::PAYMENT_METHOD_GOOGLE_WALLET)
+            {
+                int len = strlen(receipt);
+                base64receipt.resize(len * 4 / 3 + 4);
+                base64receipt.resize(Base64::btoa((byte *)receipt, len, (char *)base64receipt.data()));
+            }
+            else //MegaApi::PAYMENT_METHOD_ITUNES
+            {
+                base64receipt = receipt;
+            }
+
+            client->submitpurchasereceipt(type, base64receipt.c_str());
+            break;
+        }
+        case MegaRequest::TYPE_CREDIT_CARD_STORE:
+        {
+            const char *ccplain = request->getText();
+            e = client->creditcardstore(ccplain);
+            break;
+        }
+        case MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS:
+        {
+            client->creditcardquerysubscriptions();
+            break;
+        }
+        case MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS:
+        {
+            const char* reason = request->getText();
+            client->creditcardcancelsubscriptions(reason);
+            break;
+        }
+        case MegaRequest::TYPE_GET_PAYMENT_METHODS:
+        {
+            client->getpaymentmethods();
+            break;
+        }
+        case MegaRequest::TYPE_SUBMIT_FEEDBACK:
+        {
+            int rating = request->getNumber();
+            const char *message = request->getText();
+
+            if(rating < 1 || rating > 5)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if(!message)
+            {
+                message = "";
+            }
+
+            int size = strlen(message);
+            char *base64message = new char[size * 4 / 3 + 4];
+            Base64::btoa((byte *)message, size, base64message);
+
+            char base64uhandle[12];
+            Base64::btoa((const byte*)&client->me, MegaClient::USERHANDLE, base64uhandle);
+
+            string feedback;
+            feedback.resize(128 + strlen(base64message));
+
+            snprintf((char *)feedback.data(), feedback.size(), "{\\\"r\\\":\\\"%d\\\",\\\"m\\\":\\\"%s\\\",\\\"u\\\":\\\"%s\\\"}", rating, base64message, base64uhandle);
+            client->userfeedbackstore(feedback.c_str());
+            delete [] base64message;
+            break;
+        }
+        case MegaRequest::TYPE_SEND_EVENT:
+        {
+            int number = request->getNumber();
+            const char *text = request->getText();
+
+            if(number < 99500 || number >= 99600 || !text)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            client->sendevent(number, text);
+            break;
+        }
+        case MegaRequest::TYPE_GET_USER_DATA:
+        {
+            const char *email = request->getEmail();
+            if(request->getFlag() && !email)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if(!request->getFlag())
+            {
+                client->getuserdata();
+            }
+            else
+            {
+                client->getpubkey(email);
+            }
+
+            break;
+        }
+        case MegaRequest::TYPE_LOAD_BALANCING:
+        {
+            const char* service = request->getName();
+            if(!service)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            client->loadbalancing(service);
+            break;
+        }
+        case MegaRequest::TYPE_KILL_SESSION:
+        {
+            MegaHandle handle = request->getNodeHandle();
+            if (handle == INVALID_HANDLE)
+            {
+                client->killallsessions();
+            }
+            else
+            {
+                client->killsession(handle);
+            }
+            break;
+        }
+        case MegaRequest::TYPE_GET_SESSION_TRANSFER_URL:
+        {
+            client->copysession();
+            break;
+        }
+        case MegaRequest::TYPE_CLEAN_RUBBISH_BIN:
+        {
+            client->cleanrubbishbin();
+            break;
+        }
+        case MegaRequest::TYPE_REMOVE_LOCAL_FOLDER:
+        {
+            if(!request->getFile())
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            MegaRemoveRecursivelyJob *job = new MegaRemoveRecursivelyJob(request);
+            removeJobs.push_back(job);
+            workerPool->push(job);
+            break;
+        }
+        case MegaRequest::TYPE_GET_PW_KEY:
+        {
+            if(!request->getPassword())
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            MegaPwKeyJob *job = new MegaPwKeyJob(nextTag, request->getPassword());
+            pwKeyJobs.push_back(job);
+            workerPool->push(job);
+            break;
+        }
+        case MegaRequest::TYPE_SEARCH:
+        {
+            Node *node = client->nodebyhandle(request->getNodeHandle());
+            if(!node)
+            {
+                e = API_ENOENT;
+                break;
+            }
+
+            MegaSearchJob *job = new MegaSearchJob(request);
+            const char *searchString = request->getText();
+
+            if(searchString && searchString[0])
+            {
+                // candidates from the name index
+                node_vector matches;
+                client->searchnodes(node, searchString, true, &matches);
+
+                job->candidates.reserve(matches.size());
+                for (node_vector::iterator it = matches.begin(); it != matches.end(); it++)
+                {
+                    job->candidates.push_back((*it)->nodehandle);
+                }
+            }
+            else
+            {
+                walkTree(node, job, true);
+            }
+
+            searchJobs.push_back(job);
+            waiter->notify();
+            break;
+        }
+        default:
+        {
+            e = API_EINTERNAL;
+        }
+        }
+
+		if(e)
+        {
+            LOG_err << "Error starting request: " << e;
+            fireOnRequestFinish(request, MegaError(e));
+        }
+
+		sdkMutex.unlock();
+	}
+}
+
+char* MegaApiImpl::stringToArray(string &buffer)
+{
+	char *newbuffer = new char[buffer.size()+1];
+	memcpy(newbuffer, buffer.data(), buffer.size());
+	newbuffer[buffer.size()]='\0';
+    return newbuffer;
+}
+
+void MegaApiImpl::updateStats()
+{
+    transfer_map::iterator it;
+    transfer_map::iterator end;
+    int downloadCount = 0;
+    int uploadCount = 0;
+
+    sdkMutex.lock();
+    it = client->transfers[0].begin();
+    end = client->transfers[0].end();
+    while(it != end)
+    {
+        Transfer *transfer = it->second;
+        if((transfer->failcount<2) || (transfer->slot && (Waiter::ds - transfer->slot->lastdata) < TransferSlot::XFERTIMEOUT))
+            downloadCount++;
+        it++;
+    }
+
+    it = client->transfers[1].begin();
+    end = client->transfers[1].end();
+    while(it != end)
+    {
+        Transfer *transfer = it->second;
+        if((transfer->failcount<2) || (transfer->slot && (Waiter::ds - transfer->slot->lastdata) < TransferSlot::XFERTIMEOUT))
+            uploadCount++;
+        it++;
+    }
+
+    pendingDownloads = downloadCount;
+    pendingUploads = uploadCount;
+    sdkMutex.unlock();
+}
+
+long long MegaApiImpl::getTotalDownloadedBytes()
+{
+    return totalDownloadedBytes;
+}
+
+long long MegaApiImpl::getTotalUploadedBytes()
+{
+    return totalUploadedBytes;
+}
+
+void MegaApiImpl::update()
+{
+    waiter->notify();
+}
+
+bool MegaApiImpl::isWaiting()
+{
+    return waiting || waitingRequest;
+}
+
+TreeProcCopy::TreeProcCopy()
+{
+	nn = NULL;
+	nc = 0;
+}
+
+void TreeProcCopy::allocnodes()
+{
+	if(nc) nn = new NewNode[nc];
+}
+
+TreeProcCopy::~TreeProcCopy()
+{
+	//Will be deleted in putnodes_result
+	//delete[] nn;
+}
+
+// determine node tree size (nn = NULL) or write node tree to new nodes array
+void TreeProcCopy::proc(MegaClient* client, Node* n)
+{
+	if (nn)
+	{
+		string attrstring;
+		SymmCipher key;
+		NewNode* t = nn+--nc;
+
+		// copy node
+		t->source = NEW_NODE;
+		t->type = n->type;
+		t->nodehandle = n->nodehandle;
+        t->parenthandle = n->parent ? n->parent->nodehandle : UNDEF;
+
+		// copy key (if file) or generate new key (if folder)
+		if (n->type == FILENODE) t->nodekey = n->nodekey;
+		else
+		{
+			byte buf[FOLDERNODEKEYLENGTH];
+			PrnGen::genblock(buf,sizeof buf);
+			t->nodekey.assign((char*)buf,FOLDERNODEKEYLENGTH);
+		}
+
+		t->attrstring = new string;
+		if(t->nodekey.size())
 		{
-			const char *link = request->getLink();
-			const char *password = request->getPassword();
-			const char *pwkey = request->getPrivateKey();
+			key.setkey((const byte*)t->nodekey.data(),n->type);
+
+			n->resolveattrs();
+			n->attrs.getjson(&attrstring);
+			client->makeattr(&key,t->attrstring,attrstring.c_str());
+		}
+	}
+	else nc++;
+}
+
+TransferQueue::TransferQueue()
+{
+    mutex.init(false);
+    batchmutex.init(false);
+}
+
+bool TransferQueue::push(MegaTransferPrivate *transfer)
+{
+    mutex.lock();
+    bool wasempty = transfers.empty();
+    transfers.push_back(transfer);
+    mutex.unlock();
+    return wasempty;
+}
+
+bool TransferQueue::push(vector<MegaTransferPrivate *> *newtransfers)
+{
+    mutex.lock();
+    bool wasempty = transfers.empty();
+    transfers.insert(transfers.end(), newtransfers->begin(), newtransfers->end());
+    mutex.unlock();
+    return wasempty;
+}
+
+void TransferQueue::push_front(MegaTransferPrivate *transfer)
+{
+    batchmutex.lock();
+    batch.push_front(transfer);
+    batchmutex.unlock();
+}
+
+MegaTransferPrivate *TransferQueue::pop()
+{
+    batchmutex.lock();
+    if(batch.empty())
+    {
+        mutex.lock();
+        batch.swap(transfers);
+        mutex.unlock();
+
+        if(batch.empty())
+        {
+            batchmutex.unlock();
+            return NULL;
+        }
+    }
+    MegaTransferPrivate *transfer = batch.front();
+    batch.pop_front();
+    batchmutex.unlock();
+    return transfer;
+}
+
+MegaSharedMutex::MegaSharedMutex()
+{
+    guard.init(false);
+
+    writer = 0;
+    writerdepth = 0;
+    activereaders = 0;
+    waitingreaders = 0;
+    waitingwriters = 0;
+}
+
+int MegaSharedMutex::sharedby(unsigned long long tid)
+{
+    for (unsigned i = readers.size(); i--; )
+    {
+        if (readers[i].first == tid)
+        {
+            return readers[i].second;
+        }
+    }
+
+    return 0;
+}
+
+void MegaSharedMutex::lock()
+{
+    unsigned long long tid = MegaThread::currentid();
+
+    guard.lock();
+
+    if (writer == tid)
+    {
+        writerdepth++;
+        guard.unlock();
+        return;
+    }
+
+    // (our own shared locks don't count)
+    int mine = sharedby(tid);
+
+    while (writer || activereaders > mine)
+    {
+        waitingwriters++;
+        guard.unlock();
+        writegate.wait();
+        guard.lock();
+        waitingwriters--;
+    }
+
+    writer = tid;
+    writerdepth = 1;
+
+    guard.unlock();
+}
+
+void MegaSharedMutex::unlock()
+{
+    guard.lock();
+
+    if (!--writerdepth)
+    {
+        writer = 0;
+
+        if (waitingwriters)
+        {
+            writegate.release();
+        }
+        else
+        {
+            for (int i = waitingreaders; i--; )
+            {
+                readgate.release();
+            }
+        }
+    }
+
+    guard.unlock();
+}
+
+void MegaSharedMutex::lockShared()
+{
+    unsigned long long tid = MegaThread::currentid();
+
+    guard.lock();
+
+    // the exclusive owner reads under its own lock
+    if (writer == tid)
+    {
+        writerdepth++;
+        guard.unlock();
+        return;
+    }
+
+    for (unsigned i = readers.size(); i--; )
+    {
+        // nested: never waits, or it would deadlock against a waiting writer
+        if (readers[i].first == tid)
+        {
+            readers[i].second++;
+            activereaders++;
+            guard.unlock();
+            return;
+        }
+    }
+
+    while (writer || waitingwriters)
+    {
+        waitingreaders++;
+        guard.unlock();
+        readgate.wait();
+        guard.lock();
+        waitingreaders--;
+    }
+
+    readers.push_back(pair<unsigned long long, int>(tid, 1));
+    activereaders++;
+
+    guard.unlock();
+}
+
+void MegaSharedMutex::unlockShared()
+{
+    unsigned long long tid = MegaThread::currentid();
+
+    guard.lock();
+
+    if (writer == tid)
+    {
+        guard.unlock();
+        return unlock();
+    }
+
+    for (unsigned i = readers.size(); i--; )
+    {
+        if (readers[i].first == tid)
+        {
+            if (!--readers[i].second)
+            {
+                readers[i] = readers.back();
+                readers.pop_back();
+            }
+
+            break;
+        }
+    }
+
+    activereaders--;
+
+    // a waiting writer re-checks (this may also be an upgrader waiting for
+    // the other readers)
+    if (waitingwriters)
+    {
+        writegate.release();
+    }
+
+    guard.unlock();
+}
+
+MegaCallbackDispatcher::Payload::Payload()
+{
+    refs = 1;
+    request = NULL;
+    transfer = NULL;
+    error = NULL;
+    users = NULL;
+    nodes = NULL;
+    contactRequests = NULL;
+    metrics = NULL;
+#ifdef ENABLE_SYNC
+    sync = NULL;
+    syncEvent = NULL;
+#endif
+    state = 0;
+}
+
+MegaCallbackDispatcher::Payload::~Payload()
+{
+    delete request;
+    delete transfer;
+    delete error;
+    delete users;
+    delete nodes;
+    delete contactRequests;
+    delete metrics;
+#ifdef ENABLE_SYNC
+    delete sync;
+    delete syncEvent;
+#endif
+}
+
+MegaCallbackDispatcher::MegaCallbackDispatcher(MegaApi *api, int numthreads)
+{
+    this->api = api;
+    numqueues = numthreads;
+    queues = new Queue[numqueues];
+    idlewaiters = 0;
+    exiting = false;
+    mutex.init(false);
+
+    for (int i = 0; i < numqueues; i++)
+    {
+        queues[i].dispatcher = this;
+        queues[i].threadid = 0;
+        queues[i].current = NULL;
+        queues[i].thread.start(threadEntryPoint, queues + i);
+    }
+}
+
+MegaCallbackDispatcher::~MegaCallbackDispatcher()
+{
+    mutex.lock();
+    exiting = true;
+    mutex.unlock();
+
+    for (int i = 0; i < numqueues; i++)
+    {
+        queues[i].queued.release();
+    }
+
+    for (int i = 0; i < numqueues; i++)
+    {
+        queues[i].thread.join();
+    }
+
+    delete[] queues;
+}
+
+void *MegaCallbackDispatcher::threadEntryPoint(void *param)
+{
+    Queue *queue = (Queue *)param;
+
+    queue->dispatcher->loop(queue);
+    return 0;
+}
+
+void MegaCallbackDispatcher::loop(Queue *queue)
+{
+    mutex.lock();
+    queue->threadid = MegaThread::currentid();
+    mutex.unlock();
+
+    while (true)
+    {
+        queue->queued.wait();
+
+        mutex.lock();
+        if (queue->events.empty())
+        {
+            // events withdrawn by removeListener() or shutdown
+            bool exit = exiting;
+            mutex.unlock();
+            if (exit)
+            {
+                break;
+            }
+            continue;
+        }
+
+        Event event = queue->events.front();
+        queue->events.pop_front();
+        queue->current = event.listener;
+        mutex.unlock();
+
+        deliver(&event);
+
+        mutex.lock();
+        queue->current = NULL;
+        for (int i = idlewaiters; i--; )
+        {
+            idle.release();
+        }
+        mutex.unlock();
+
+        release(event.payload);
+    }
+}
+
+void MegaCallbackDispatcher::post(int type, int kind, void *listener, Payload *payload)
+{
+    Event event;
+
+    event.type = type;
+    event.kind = kind;
+    event.listener = listener;
+    event.payload = payload;
+
+    // (all events of a listener go to the same thread)
+    Queue *queue = queues + (size_t)((uintptr_t)listener / sizeof(void *) % numqueues);
+
+    mutex.lock();
+    if (payload)
+    {
+        payload->refs++;
+    }
+    queue->events.push_back(event);
+    mutex.unlock();
+
+    queue->queued.release();
+}
+
+void MegaCallbackDispatcher::release(Payload *payload)
+{
+    if (!payload)
+    {
+        return;
+    }
+
+    mutex.lock();
+    bool last = !--payload->refs;
+    mutex.unlock();
+
+    if (last)
+    {
+        delete payload;
+    }
+}
+
+void MegaCallbackDispatcher::removeListener(void *listener)
+{
+    Queue *queue = queues + (size_t)((uintptr_t)listener / sizeof(void *) % numqueues);
+    vector<Payload *> dropped;
+
+    mutex.lock();
+
+    for (std::deque<Event>::iterator it = queue->events.begin(); it != queue->events.end(); )
+    {
+        if (it->listener == listener)
+        {
+            dropped.push_back(it->payload);
+            it = queue->events.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    // (a listener that removes itself from its callback returns to us)
+    if (queue->threadid != MegaThread::currentid())
+    {
+        while (queue->current == listener)
+        {
+            idlewaiters++;
+            mutex.unlock();
+            idle.wait();
+            mutex.lock();
+            idlewaiters--;
+        }
+    }
+
+    mutex.unlock();
+
+    for (unsigned i = 0; i < dropped.size(); i++)
+    {
+        release(dropped[i]);
+    }
+}
+
+void MegaCallbackDispatcher::deliver(Event *event)
+{
+    Payload *p = event->payload;
+
+    if (event->kind == LISTENER)
+    {
+        MegaListener *listener = (MegaListener *)event->listener;
+
+        switch (event->type)
+        {
+            case REQUEST_START: listener->onRequestStart(api, p->request); break;
+            case REQUEST_FINISH: listener->onRequestFinish(api, p->request, p->error); break;
+            case REQUEST_UPDATE: listener->onRequestUpdate(api, p->request); break;
+            case REQUEST_TEMPORARY_ERROR: listener->onRequestTemporaryError(api, p->request, p->error); break;
+            case TRANSFER_START: listener->onTransferStart(api, p->transfer); break;
+            case TRANSFER_FINISH: listener->onTransferFinish(api, p->transfer, p->error); break;
+            case TRANSFER_UPDATE: listener->onTransferUpdate(api, p->transfer); break;
+            case TRANSFER_TEMPORARY_ERROR: listener->onTransferTemporaryError(api, p->transfer, p->error); break;
+            case USERS_UPDATE: listener->onUsersUpdate(api, p->users); break;
+            case NODES_UPDATE: listener->onNodesUpdate(api, p->nodes); break;
+            case NODE_DELTAS_AVAILABLE: listener->onNodeDeltasAvailable(api); break;
+            case ACCOUNT_UPDATE: listener->onAccountUpdate(api); break;
+            case ENGINE_METRICS: listener->onEngineMetrics(api, p->metrics); break;
+            case CONTACT_REQUESTS_UPDATE: listener->onContactRequestsUpdate(api, p->contactRequests); break;
+            case RELOAD_NEEDED: listener->onReloadNeeded(api); break;
+#ifdef ENABLE_SYNC
+            case SYNC_STATE_CHANGED: listener->onSyncStateChanged(api, p->sync); break;
+            case SYNC_STATS_UPDATED: listener->onSyncStatsUpdated(api, p->sync); break;
+            case SYNC_EVENT: listener->onSyncEvent(api, p->sync, p->syncEvent); break;
+            case GLOBAL_SYNC_STATE_CHANGED: listener->onGlobalSyncStateChanged(api); break;
+            case SYNC_FILE_STATE_CHANGED: listener->onSyncFileStateChanged(api, p->sync, p->path.c_str(), p->state); break;
+#endif
+        }
+    }
+    else if (event->kind == REQUEST_LISTENER)
+    {
+        MegaRequestListener *listener = (MegaRequestListener *)event->listener;
+
+        switch (event->type)
+        {
+            case REQUEST_START: listener->onRequestStart(api, p->request); break;
+            case REQUEST_FINISH: listener->onRequestFinish(api, p->request, p->error); break;
+            case REQUEST_UPDATE: listener->onRequestUpdate(api, p->request); break;
+            case REQUEST_TEMPORARY_ERROR: listener->onRequestTemporaryError(api, p->request, p->error); break;
+        }
+    }
+    else if (event->kind == TRANSFER_LISTENER)
+    {
+        MegaTransferListener *listener = (MegaTransferListener *)event->listener;
+
+        switch (event->type)
+        {
+            case TRANSFER_START: listener->onTransferStart(api, p->transfer); break;
+            case TRANSFER_FINISH: listener->onTransferFinish(api, p->transfer, p->error); break;
+            case TRANSFER_UPDATE: listener->onTransferUpdate(api, p->transfer); break;
+            case TRANSFER_TEMPORARY_ERROR: listener->onTransferTemporaryError(api, p->transfer, p->error); break;
+        }
+    }
+    else if (event->kind == GLOBAL_LISTENER)
+    {
+        MegaGlobalListener *listener = (MegaGlobalListener *)event->listener;
+
+        switch (event->type)
+        {
+            case USERS_UPDATE: listener->onUsersUpdate(api, p->users); break;
+            case NODES_UPDATE: listener->onNodesUpdate(api, p->nodes); break;
+            case NODE_DELTAS_AVAILABLE: listener->onNodeDeltasAvailable(api); break;
+            case ACCOUNT_UPDATE: listener->onAccountUpdate(api); break;
+            case ENGINE_METRICS: listener->onEngineMetrics(api, p->metrics); break;
+            case CONTACT_REQUESTS_UPDATE: listener->onContactRequestsUpdate(api, p->contactRequests); break;
+            case RELOAD_NEEDED: listener->onReloadNeeded(api); break;
+#ifdef ENABLE_SYNC
+            case GLOBAL_SYNC_STATE_CHANGED: listener->onGlobalSyncStateChanged(api); break;
+#endif
+        }
+    }
+#ifdef ENABLE_SYNC
+    else if (event->kind == SYNC_LISTENER)
+    {
+        MegaSyncListener *listener = (MegaSyncListener *)event->listener;
+
+        switch (event->type)
+        {
+            case SYNC_STATE_CHANGED: listener->onSyncStateChanged(api, p->sync); break;
+            case SYNC_STATS_UPDATED: listener->onSyncStatsUpdated(api, p->sync); break;
+            case SYNC_EVENT: listener->onSyncEvent(api, p->sync, p->syncEvent); break;
+            case SYNC_FILE_STATE_CHANGED: listener->onSyncFileStateChanged(api, p->sync, p->path.c_str(), p->state); break;
+        }
+    }
+#endif
+}
+
+MegaWorkerQueue::MegaWorkerQueue(int numthreads)
+{
+    this->numthreads = numthreads;
+    threads = new MegaThread[numthreads];
+    exiting = false;
+    mutex.init(false);
+
+    for (int i = 0; i < numthreads; i++)
+    {
+        threads[i].start(threadEntryPoint, this);
+    }
+}
+
+MegaWorkerQueue::~MegaWorkerQueue()
+{
+    mutex.lock();
+    exiting = true;
+    mutex.unlock();
+
+    for (int i = 0; i < numthreads; i++)
+    {
+        queued.release();
+    }
+
+    for (int i = 0; i < numthreads; i++)
+    {
+        threads[i].join();
+    }
+
+    delete[] threads;
+}
+
+void *MegaWorkerQueue::threadEntryPoint(void *param)
+{
+    ((MegaWorkerQueue *)param)->loop();
+    return 0;
+}
+
+void MegaWorkerQueue::loop()
+{
+    while (true)
+    {
+        queued.wait();
+
+        mutex.lock();
+        if (jobs.empty())
+        {
+            // job withdrawn or shutdown
+            bool exit = exiting;
+            mutex.unlock();
+            if (exit)
+            {
+                break;
+            }
+            continue;
+        }
+        std::pair<WorkerJob *, MegaWorkerPool *> job = jobs.front();
+        jobs.pop_front();
+        mutex.unlock();
+
+        job.first->run();
+        job.second->finish(job.first);
+    }
+}
+
+void MegaWorkerQueue::push(WorkerJob *job, MegaWorkerPool *pool)
+{
+    mutex.lock();
+    jobs.push_back(std::pair<WorkerJob *, MegaWorkerPool *>(job, pool));
+    mutex.unlock();
+
+    queued.release();
+}
+
+bool MegaWorkerQueue::withdraw(WorkerJob *job)
+{
+    mutex.lock();
+    for (std::deque<std::pair<WorkerJob *, MegaWorkerPool *> >::iterator it = jobs.begin(); it != jobs.end(); it++)
+    {
+        if (it->first == job)
+        {
+            jobs.erase(it);
+            mutex.unlock();
+            return true;
+        }
+    }
+    mutex.unlock();
+    return false;
+}
+
+MegaWorkerPool::MegaWorkerPool(MegaWaiter *waiter, int numthreads)
+{
+    this->waiter = waiter;
+    queue = new MegaWorkerQueue(numthreads);
+    ownqueue = true;
+    mutex.init(false);
+}
+
+MegaWorkerPool::MegaWorkerPool(MegaWaiter *waiter, MegaWorkerQueue *queue)
+{
+    this->waiter = waiter;
+    this->queue = queue;
+    ownqueue = false;
+    mutex.init(false);
+}
+
+MegaWorkerPool::~MegaWorkerPool()
+{
+    if (ownqueue)
+    {
+        delete queue;
+    }
+}
+
+void MegaWorkerPool::push(WorkerJob *job)
+{
+    queue->push(job, this);
+}
+
+void MegaWorkerPool::finish(WorkerJob *job)
+{
+    mutex.lock();
+    done.insert(job);
+    mutex.unlock();
+
+    finished.release();
+    waiter->notify();
+}
+
+bool MegaWorkerPool::isdone(WorkerJob *job)
+{
+    mutex.lock();
+    bool result = done.erase(job) > 0;
+    mutex.unlock();
+    return result;
+}
+
+void MegaWorkerPool::waitfor(WorkerJob *job)
+{
+    while (true)
+    {
+        if (queue->withdraw(job))
+        {
+            return;
+        }
+
+        mutex.lock();
+        if (done.erase(job))
+        {
+            mutex.unlock();
+            return;
+        }
+        mutex.unlock();
+
+        // only the SDK thread waits - stale signals just cause a recheck
+        finished.wait();
+    }
+}
+
+Mutex *MegaWorkerPool::newmutex()
+{
+    MegaMutex *m = new MegaMutex();
+    m->init(false);
+    return m;
+}
+
+// guards MegaSharedRuntime::instance (initialised before main(), so before
+// any MegaApi can be created)
+static struct MegaSharedRuntimeLock
+{
+    MegaMutex mutex;
+
+    MegaSharedRuntimeLock()
+    {
+        mutex.init(false);
+    }
+} sharedRuntimeLock;
+
+bool MegaSharedRuntime::enabled = false;
+MegaSharedRuntime *MegaSharedRuntime::instance = NULL;
+
+static struct MegaNodeNamePool
+{
+    NamePool pool;
+    MegaMutex mutex;
+
+    MegaNodeNamePool()
+    {
+        mutex.init(false);
+    }
+} nodeNamePool;
+
+bool MegaNodeNames::enabled = false;
+
+void MegaNodeNames::setEnabled(bool enable)
+{
+    nodeNamePool.mutex.lock();
+    enabled = enable;
+    nodeNamePool.mutex.unlock();
+}
+
+const char *MegaNodeNames::copy(const char *name, bool *interned)
+{
+    *interned = false;
+
+    if (!name)
+    {
+        return NULL;
+    }
+
+    nodeNamePool.mutex.lock();
+
+    if (enabled)
+    {
+        name = nodeNamePool.pool.acquire(name);
+        *interned = true;
+    }
+
+    nodeNamePool.mutex.unlock();
+
+    return *interned ? name : MegaApi::strdup(name);
+}
+
+void MegaNodeNames::free(const char *name, bool interned)
+{
+    if (!interned)
+    {
+        delete [] name;
+        return;
+    }
+
+    nodeNamePool.mutex.lock();
+    nodeNamePool.pool.release(name);
+    nodeNamePool.mutex.unlock();
+}
+
+MegaSharedRuntime::MegaSharedRuntime()
+{
+    users = 0;
+    workers = new MegaWorkerQueue(NUMTHREADS);
+    gfxWorkers = new MegaWorkerQueue(GFXTHREADS);
+
+#ifdef MEGA_CURL_HTTPIO
+    for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    {
+        curllocks[i].init(false);
+        curllockptrs[i] = &curllocks[i];
+    }
+
+    curlsh = CurlHttpIO::newshare(curllockptrs);
+#endif
+}
+
+MegaSharedRuntime::~MegaSharedRuntime()
+{
+#ifdef MEGA_CURL_HTTPIO
+    CurlHttpIO::deleteshare(curlsh);
+#endif
+
+    delete workers;
+    delete gfxWorkers;
+}
+
+void MegaSharedRuntime::setEnabled(bool enable)
+{
+    sharedRuntimeLock.mutex.lock();
+    enabled = enable;
+    sharedRuntimeLock.mutex.unlock();
+}
+
+MegaSharedRuntime *MegaSharedRuntime::acquire()
+{
+    MegaSharedRuntime *runtime = NULL;
+
+    sharedRuntimeLock.mutex.lock();
+    if (enabled)
+    {
+        if (!instance)
+        {
+            instance = new MegaSharedRuntime();
+        }
+
+        instance->users++;
+        runtime = instance;
+    }
+    sharedRuntimeLock.mutex.unlock();
+
+    return runtime;
+}
+
+void MegaSharedRuntime::release()
+{
+    sharedRuntimeLock.mutex.lock();
+    if (!--users)
+    {
+        if (instance == this)
+        {
+            instance = NULL;
+        }
+
+        delete this;
+    }
+    sharedRuntimeLock.mutex.unlock();
+}
+
+RequestQueue::RequestQueue()
+{
+    mutex.init(false);
+    batchmutex.init(false);
+}
+
+bool RequestQueue::push(MegaRequestPrivate *request)
+{
+    mutex.lock();
+    bool wasempty = requests.empty();
+    requests.push_back(request);
+    mutex.unlock();
+    return wasempty;
+}
+
+void RequestQueue::push_front(MegaRequestPrivate *request)
+{
+    batchmutex.lock();
+    batch.push_front(request);
+    batchmutex.unlock();
+}
+
+MegaRequestPrivate *RequestQueue::pop()
+{
+    batchmutex.lock();
+    if(batch.empty())
+    {
+        mutex.lock();
+        batch.swap(requests);
+        mutex.unlock();
+
+        if(batch.empty())
+        {
+            batchmutex.unlock();
+            return NULL;
+        }
+    }
+    MegaRequestPrivate *request = batch.front();
+    batch.pop_front();
+    batchmutex.unlock();
+    return request;
+}
+
+void RequestQueue::removeListener(MegaRequestListener *listener)
+{
+    batchmutex.lock();
+    mutex.lock();
+
+    std::deque<MegaRequestPrivate *> *queues[] = { &batch, &requests };
+    for(int i = 0; i < 2; i++)
+    {
+        std::deque<MegaRequestPrivate *>::iterator it = queues[i]->begin();
+        while(it != queues[i]->end())
+        {
+            MegaRequestPrivate *request = (*it);
+            if(request->getListener()==listener)
+                request->setListener(NULL);
+            it++;
+        }
+    }
+
+    mutex.unlock();
+    batchmutex.unlock();
+}
+
+#ifdef ENABLE_SYNC
+void RequestQueue::removeListener(MegaSyncListener *listener)
+{
+    batchmutex.lock();
+    mutex.lock();
+
+    std::deque<MegaRequestPrivate *> *queues[] = { &batch, &requests };
+    for(int i = 0; i < 2; i++)
+    {
+        std::deque<MegaRequestPrivate *>::iterator it = queues[i]->begin();
+        while(it != queues[i]->end())
+        {
+            MegaRequestPrivate *request = (*it);
+            if(request->getSyncListener()==listener)
+                request->setSyncListener(NULL);
+            it++;
+        }
+    }
+
+    mutex.unlock();
+    batchmutex.unlock();
+}
+#endif
+
+MegaHashSignatureImpl::MegaHashSignatureImpl(const char *base64Key)
+{
+    hashSignature = new HashSignature(new Hash());
+    asymmCypher = new AsymmCipher();
+
+    string pubks;
+    int len = strlen(base64Key)/4*3+3;
+    pubks.resize(len);
+    pubks.resize(Base64::atob(base64Key, (byte *)pubks.data(), len));
+    asymmCypher->setkey(AsymmCipher::PUBKEY,(byte*)pubks.data(), pubks.size());
+}
+
+MegaHashSignatureImpl::~MegaHashSignatureImpl()
+{
+    delete hashSignature;
+    delete asymmCypher;
+}
+
+void MegaHashSignatureImpl::init()
+{
+    hashSignature->get(asymmCypher, NULL, 0);
+}
+
+void MegaHashSignatureImpl::add(const char *data, unsigned size)
+{
+    hashSignature->add((const byte *)data, size);
+}
+
+bool MegaHashSignatureImpl::checkSignature(const char *base64Signature)
+{
+    char signature[512];
+    int l = Base64::atob(base64Signature, (byte *)signature, sizeof(signature));
+    if(l != sizeof(signature))
+        return false;
+
+    return hashSignature->check(asymmCypher, (const byte *)signature, sizeof(signature));
+}
+
+int MegaAccountDetailsPrivate::getProLevel()
+{
+    return details.pro_level;
+}
+
+int64_t MegaAccountDetailsPrivate::getProExpiration()
+{
+    return details.pro_until;
+}
+
+int MegaAccountDetailsPrivate::getSubscriptionStatus()
+{
+    if(details.subscription_type == 'S')
+    {
+        return MegaAccountDetails::SUBSCRIPTION_STATUS_VALID;
+    }
+
+    if(details.subscription_type == 'R')
+    {
+        return MegaAccountDetails::SUBSCRIPTION_STATUS_INVALID;
+    }
+
+    return MegaAccountDetails::SUBSCRIPTION_STATUS_NONE;
+}
+
+int64_t MegaAccountDetailsPrivate::getSubscriptionRenewTime()
+{
+    return details.subscription_renew;
+}
+
+char *MegaAccountDetailsPrivate::getSubscriptionMethod()
+{
+    return MegaApi::strdup(details.subscription_method.c_str());
+}
+
+char *MegaAccountDetailsPrivate::getSubscriptionCycle()
+{
+    return MegaApi::strdup(details.subscription_cycle);
+}
+
+long long MegaAccountDetailsPrivate::getStorageMax()
+{
+    return details.storage_max;
+}
+
+long long MegaAccountDetailsPrivate::getStorageUsed()
+{
+    return details.storage_used;
+}
+
+long long MegaAccountDetailsPrivate::getTransferMax()
+{
+    return details.transfer_max;
+}
+
+long long MegaAccountDetailsPrivate::getTransferOwnUsed()
+{
+    return details.transfer_own_used;
+}
+
+int MegaAccountDetailsPrivate::getNumUsageItems()
+{
+    return details.storage.size();
+}
+
+long long MegaAccountDetailsPrivate::getStorageUsed(MegaHandle handle)
+{
+    return details.storage[handle].bytes;
+}
+
+long long MegaAccountDetailsPrivate::getNumFiles(MegaHandle handle)
+{
+    return details.storage[handle].files;
+}
+
+long long MegaAccountDetailsPrivate::getNumFolders(MegaHandle handle)
+{
+    return details.storage[handle].folders;
+}
+
+MegaAccountDetails* MegaAccountDetailsPrivate::copy()
+{
+    return new MegaAccountDetailsPrivate(&details);
+}
+
+int MegaAccountDetailsPrivate::getNumBalances() const
+{
+    return details.balances.size();
+}
+
+MegaAccountBalance *MegaAccountDetailsPrivate::getBalance(int i) const
+{
+    if(i < details.balances.size())
+    {
+        return MegaAccountBalancePrivate::fromAccountBalance(&(details.balances[i]));
+    }
+    return NULL;
+}
+
+int MegaAccountDetailsPrivate::getNumSessions() const
+{
+    return details.sessions.size();
+}
+
+MegaAccountSession *MegaAccountDetailsPrivate::getSession(int i) const
+{
+    if(i < details.sessions.size())
+    {
+        return MegaAccountSessionPrivate::fromAccountSession(&(details.sessions[i]));
+    }
+    return NULL;
+}
+
+int MegaAccountDetailsPrivate::getNumPurchases() const
+{
+    return details.purchases.size();
+}
+
+MegaAccountPurchase *MegaAccountDetailsPrivate::getPurchase(int i) const
+{
+    if(i < details.purchases.size())
+    {
+        return MegaAccountPurchasePrivate::fromAccountPurchase(&(details.purchases[i]));
+    }
+    return NULL;
+}
+
+int MegaAccountDetailsPrivate::getNumTransactions() const
+{
+    return details.transactions.size();
+}
+
+MegaAccountTransaction *MegaAccountDetailsPrivate::getTransaction(int i) const
+{
+    if(i < details.transactions.size())
+    {
+        return MegaAccountTransactionPrivate::fromAccountTransaction(&(details.transactions[i]));
+    }
+    return NULL;
+}
+
+ExternalLogger::ExternalLogger()
+{
+	mutex.init(true);
+	this->megaLogger = NULL;
+	queue = NULL;
+	async = false;
+	SimpleLogger::setOutputClass(this);
+
+    //Initialize outputSettings map
+    SimpleLogger::outputSettings[(LogLevel)logFatal];
+    SimpleLogger::outputSettings[(LogLevel)logError];
+    SimpleLogger::outputSettings[(LogLevel)logWarning];
+    SimpleLogger::outputSettings[(LogLevel)logInfo];
+    SimpleLogger::outputSettings[(LogLevel)logDebug];
+    SimpleLogger::outputSettings[(LogLevel)logMax];
+}
+
+void ExternalLogger::setMegaLogger(MegaLogger *logger)
+{
+	this->megaLogger = logger;
+}
+
+void ExternalLogger::setLogLevel(int logLevel)
+{
+	SimpleLogger::setLogLevel((LogLevel)logLevel);
+}
+
+void ExternalLogger::setAsync(bool enable)
+{
+    mutex.lock();
+    if (enable && !queue)
+    {
+        queue = new MegaLogQueue(this);
+    }
+    async = enable;
+    mutex.unlock();
+
+    if (!enable && queue)
+    {
+        queue->flush();
+    }
+}
+
+bool ExternalLogger::deferring()
+{
+    return async;
+}
+
+void ExternalLogger::logdeferred(time_t time, int loglevel, const char *filename, int line, string *message)
+{
+    queue->push(time, loglevel, filename, line, message);
+
+    // the application may not survive it
+    if (loglevel == logFatal)
+    {
+        queue->flush();
+    }
+}
+
+void ExternalLogger::postLog(int logLevel, const char *message, const char *filename, int line)
+{
+    if(SimpleLogger::logCurrentLevel < logLevel)
+        return;
+
+	if(!message)
+	{
+		message = "";
+	}
+
+	if(!filename)
+	{
+		filename = "";
+	}
+
+    // the queue serializes asynchronous logs (and a fatal one is delivered
+    // from this thread, which takes the mutex in log())
+    if (async)
+    {
+        SimpleLogger((LogLevel)logLevel, filename, line) << message;
+        return;
+    }
+
+    mutex.lock();
+	SimpleLogger((LogLevel)logLevel, filename, line) << message;
+    mutex.unlock();
+}
+
+void ExternalLogger::log(const char *time, int loglevel, const char *source, const char *message)
+{
+	if(!time)
+	{
+		time = "";
+	}
+
+	if(!source)
+	{
+		source = "";
+	}
+
+	if(!message)
+	{
+		message = "";
+	}
+
+	mutex.lock();
+	if(megaLogger)
+	{
+        megaLogger->log(time, loglevel, source, message);
+	}
+	else
+	{
+		cout << "[" << time << "][" << SimpleLogger::toStr((LogLevel)loglevel) << "] " << message << endl;
+	}
+	mutex.unlock();
+}
+
+MegaLogQueue::MegaLogQueue(ExternalLogger *output)
+{
+    this->output = output;
+    ring = new Entry[SIZE];
+    batch = new Entry[SIZE];
+    head = 0;
+    count = 0;
+    dropped = 0;
+    lasttime = 0;
+    mutex.init(false);
+    delivermutex.init(false);
+    thread.start(threadEntryPoint, this);
+}
+
+void MegaLogQueue::push(time_t time, int loglevel, const char *filename, int line, string *message)
+{
+    mutex.lock();
+    if (count == SIZE)
+    {
+        dropped++;
+        mutex.unlock();
+        return;
+    }
+
+    Entry *e = ring + (head + count) % SIZE;
+    e->time = time;
+    e->loglevel = loglevel;
+    e->line = line;
+    e->filename.assign(filename ? filename : "");
+    e->message.swap(*message);
+
+    // the thread empties the ring once woken up
+    bool wake = !count++;
+    mutex.unlock();
+
+    if (wake)
+    {
+        queued.release();
+    }
+}
+
+void MegaLogQueue::flush()
+{
+    delivermutex.lock();
+    deliver();
+    delivermutex.unlock();
+}
+
+void *MegaLogQueue::threadEntryPoint(void *param)
+{
+    ((MegaLogQueue *)param)->loop();
+    return 0;
+}
+
+void MegaLogQueue::loop()
+{
+    while (true)
+    {
+        queued.wait();
+        flush();
+    }
+}
+
+bool MegaLogQueue::deliver()
+{
+    unsigned n, lost;
+
+    mutex.lock();
+    n = count;
+    for (unsigned i = 0; i < n; i++)
+    {
+        Entry *e = ring + (head + i) % SIZE;
+        batch[i].time = e->time;
+        batch[i].loglevel = e->loglevel;
+        batch[i].line = e->line;
+        batch[i].filename.swap(e->filename);
+        batch[i].message.swap(e->message);
+    }
+    head = (head + n) % SIZE;
+    count = 0;
+    lost = dropped;
+    dropped = 0;
+    mutex.unlock();
+
+    if (lost)
+    {
+        ostringstream oss;
+        oss << lost << " log messages dropped (logging queue full)";
+        output->log(SimpleLogger::getTime(time(NULL)).c_str(), logWarning, "", oss.str().c_str());
+    }
+
+    string source;
+    for (unsigned i = 0; i < n; i++)
+    {
+        Entry *e = batch + i;
+
+        // consecutive messages mostly share the second
+        if (e->time != lasttime || lasttimestr.empty())
+        {
+            lasttime = e->time;
+            lasttimestr = SimpleLogger::getTime(e->time);
+        }
+
+        source = e->filename;
+        if (e->line >= 0)
+        {
+            char buf[16];
+            sprintf(buf, ":%d", e->line);
+            source.append(buf);
+        }
+
+        output->log(lasttimestr.c_str(), e->loglevel, source.c_str(), e->message.c_str());
+    }
+
+    return n || lost;
+}
+
+
+OutShareProcessor::OutShareProcessor()
+{
+
+}
+
+bool OutShareProcessor::processNode(Node *node)
+{
+    if(!node->outshares)
+    {
+        return true;
+    }
+
+    for (share_map::iterator it = node->outshares->begin(); it != node->outshares->end(); it++)
+	{
+		shares.push_back(it->second);
+		handles.push_back(node->nodehandle);
+	}
+
+	return true;
+}
+
+vector<Share *> &OutShareProcessor::getShares()
+{
+	return shares;
+}
+
+vector<handle> &OutShareProcessor::getHandles()
+{
+	return handles;
+}
+
+PendingOutShareProcessor::PendingOutShareProcessor()
+{
+
+}
+
+bool PendingOutShareProcessor::processNode(Node *node)
+{
+    if(!node->pendingshares)
+    {
+        return true;
+    }
+
+    for (share_map::iterator it = node->pendingshares->begin(); it != node->pendingshares->end(); it++)
+    {
+        shares.push_back(it->second);
+        handles.push_back(node->nodehandle);
+    }
+
+    return true;
+}
+
+vector<Share *> &PendingOutShareProcessor::getShares()
+{
+    return shares;
+}
+
+vector<handle> &PendingOutShareProcessor::getHandles()
+{
+    return handles;
+}
+
+MegaTreeViewProcessor::MegaTreeViewProcessor(MegaTreeProcessor *processor)
+{
+    this->processor = processor;
+    view = NULL;
+}
+
+bool MegaTreeViewProcessor::processNode(Node *node)
+{
+    pool.clear();
+    record.fill(node, &pool);
+
+    if (!view)
+    {
+        view = new MegaNodePrivate(&record, &pool);
+    }
+    else
+    {
+        view->reset(&record, &pool);
+    }
+
+    return processor->processMegaNode(view);
+}
+
+MegaTreeViewProcessor::~MegaTreeViewProcessor()
+{
+    delete view;
+}
+
+MegaTreeSnapshot::MegaTreeSnapshot(MegaTreeProcessor *processor)
+{
+    this->processor = processor;
+    next = 0;
+    stopped = false;
+    mutex.init(false);
+}
+
+bool MegaTreeSnapshot::processNode(Node *node)
+{
+    records.resize(records.size() + 1);
+    records.back().fill(node, &pool);
+    return true;
+}
+
+bool MegaTreeSnapshot::process(int numthreads)
+{
+    next = 0;
+    stopped = false;
+
+    // the calling thread takes part
+    int numchunks = (records.size() + CHUNK - 1) / CHUNK;
+    int helpers = (numthreads < numchunks ? numthreads : numchunks) - 1;
+
+    if (helpers <= 0)
+    {
+        run();
+        return !stopped;
+    }
+
+    MegaThread *threads = new MegaThread[helpers];
+    for (int i = 0; i < helpers; i++)
+    {
+        threads[i].start(threadEntryPoint, this);
+    }
+
+    run();
+
+    for (int i = 0; i < helpers; i++)
+    {
+        threads[i].join();
+    }
+    delete [] threads;
 
-            if(!link || (request->getType() == MegaRequest::TYPE_CONFIRM_ACCOUNT && !password && !pwkey))
-			{
-				e = API_EARGS;
-				break;
-			}
+    return !stopped;
+}
 
-			const char* ptr = link;
-			const char* tptr;
+void MegaTreeSnapshot::run()
+{
+    MegaNodePrivate *view = NULL;
 
-			if ((tptr = strstr(ptr,"#confirm"))) ptr = tptr+8;
+    for (;;)
+    {
+        mutex.lock();
+        size_t start = next;
+        bool stop = stopped || start >= records.size();
+        next = start + CHUNK;
+        mutex.unlock();
 
-			unsigned len = (strlen(link)-(ptr-link))*3/4+4;
-			byte *c = new byte[len];
-            len = Base64::atob(ptr,c,len);
-			client->querysignuplink(c,len);
-			delete[] c;
-			break;
-		}
-        case MegaRequest::TYPE_PAUSE_TRANSFERS:
+        if (stop)
         {
-            bool pause = request->getFlag();
-            int direction = request->getNumber();
-            if(direction != -1
-                    && direction != MegaTransfer::TYPE_DOWNLOAD
-                    && direction != MegaTransfer::TYPE_UPLOAD)
-            {
-                e = API_EARGS;
-                break;
-            }
+            break;
+        }
 
-            if(direction == -1)
-            {
-                client->pausexfers(PUT, pause);
-                client->pausexfers(GET, pause);
-            }
-            else if(direction == MegaTransfer::TYPE_DOWNLOAD)
+        size_t end = start + CHUNK < records.size() ? start + CHUNK : records.size();
+        for (size_t i = start; i < end; i++)
+        {
+            if (!view)
             {
-                client->pausexfers(GET, pause);
+                view = new MegaNodePrivate(&records[i], &pool);
             }
             else
             {
-                client->pausexfers(PUT, pause);
+                view->reset(&records[i], &pool);
             }
 
-            fireOnRequestFinish(request, MegaError(API_OK));
-            break;
+            if (!processor->processMegaNode(view))
+            {
+                mutex.lock();
+                stopped = true;
+                mutex.unlock();
+                break;
+            }
         }
-        case MegaRequest::TYPE_CANCEL_TRANSFER:
-        {
-            int transferTag = request->getTransferTag();
-            if(transferMap.find(transferTag) == transferMap.end()) { e = API_ENOENT; break; };
+    }
 
-            MegaTransferPrivate* megaTransfer = transferMap.at(transferTag);
-            Transfer *transfer = megaTransfer->getTransfer();
+    delete view;
+}
 
-            #ifdef _WIN32
-                if(transfer->type==GET)
-                {
-                    transfer->localfilename.append("", 1);
-                    WIN32_FILE_ATTRIBUTE_DATA fad;
-                    if (GetFileAttributesExW((LPCWSTR)transfer->localfilename.data(), GetFileExInfoStandard, &fad))
-                        SetFileAttributesW((LPCWSTR)transfer->localfilename.data(), fad.dwFileAttributes & ~FILE_ATTRIBUTE_HIDDEN);
-                    transfer->localfilename.resize(transfer->localfilename.size()-1);
-                }
-            #endif
+void *MegaTreeSnapshot::threadEntryPoint(void *param)
+{
+    ((MegaTreeSnapshot *)param)->run();
+    return NULL;
+}
 
-            megaTransfer->setSyncTransfer(true);
-            megaTransfer->setLastErrorCode(API_EINCOMPLETE);
+MegaPricingPrivate::~MegaPricingPrivate()
+{
+    for(unsigned i = 0; i < currency.size(); i++)
+    {
+        delete[] currency[i];
+    }
 
-            file_list files = transfer->files;
-            file_list::iterator iterator = files.begin();
-            while (iterator != files.end())
-            {
-                File *file = *iterator;
-                iterator++;
-                if(!file->syncxfer) client->stopxfer(file);
-            }
-            fireOnRequestFinish(request, MegaError(API_OK));
-            break;
-        }
-        case MegaRequest::TYPE_CANCEL_TRANSFERS:
-        {
-            int direction = request->getParamType();
-            if((direction != MegaTransfer::TYPE_DOWNLOAD) && (direction != MegaTransfer::TYPE_UPLOAD))
-                { e = API_EARGS; break; }
+    for(unsigned i = 0; i < description.size(); i++)
+    {
+        delete[] description[i];
+    }
+
+    for(unsigned i = 0; i < iosId.size(); i++)
+    {
+        delete[] iosId[i];
+    }
+
+    for(unsigned i = 0; i < androidId.size(); i++)
+    {
+        delete[] androidId[i];
+    }
+}
+
+int MegaPricingPrivate::getNumProducts()
+{
+    return handles.size();
+}
+
+handle MegaPricingPrivate::getHandle(int productIndex)
+{
+    if((unsigned)productIndex < handles.size())
+        return handles[productIndex];
+
+    return UNDEF;
+}
+
+int MegaPricingPrivate::getProLevel(int productIndex)
+{
+    if((unsigned)productIndex < proLevel.size())
+        return proLevel[productIndex];
+
+    return 0;
+}
+
+int MegaPricingPrivate::getGBStorage(int productIndex)
+{
+    if((unsigned)productIndex < gbStorage.size())
+        return gbStorage[productIndex];
+
+    return 0;
+}
+
+int MegaPricingPrivate::getGBTransfer(int productIndex)
+{
+    if((unsigned)productIndex < gbTransfer.size())
+        return gbTransfer[productIndex];
+
+    return 0;
+}
+
+int MegaPricingPrivate::getMonths(int productIndex)
+{
+    if((unsigned)productIndex < months.size())
+        return months[productIndex];
+
+    return 0;
+}
+
+int MegaPricingPrivate::getAmount(int productIndex)
+{
+    if((unsigned)productIndex < amount.size())
+        return amount[productIndex];
+
+    return 0;
+}
+
+const char *MegaPricingPrivate::getCurrency(int productIndex)
+{
+    if((unsigned)productIndex < currency.size())
+        return currency[productIndex];
+
+    return NULL;
+}
+
+const char *MegaPricingPrivate::getDescription(int productIndex)
+{
+    if((unsigned)productIndex < description.size())
+        return description[productIndex];
+
+    return NULL;
+}
+
+const char *MegaPricingPrivate::getIosID(int productIndex)
+{
+    if((unsigned)productIndex < iosId.size())
+        return iosId[productIndex];
+
+    return NULL;
+}
+
+const char *MegaPricingPrivate::getAndroidID(int productIndex)
+{
+    if((unsigned)productIndex < androidId.size())
+        return androidId[productIndex];
+
+    return NULL;
+}
+
+MegaPricing *MegaPricingPrivate::copy()
+{
+    MegaPricingPrivate *megaPricing = new MegaPricingPrivate();
+    for(unsigned i=0; i<handles.size(); i++)
+    {
+        megaPricing->addProduct(handles[i], proLevel[i], gbStorage[i], gbTransfer[i],
+                                months[i], amount[i], currency[i], description[i], iosId[i], androidId[i]);
+    }
+
+    return megaPricing;
+}
+
+void MegaPricingPrivate::addProduct(handle product, int proLevel, int gbStorage, int gbTransfer, int months, int amount, const char *currency,
+                                    const char* description, const char* iosid, const char* androidid)
+{
+    this->handles.push_back(product);
+    this->proLevel.push_back(proLevel);
+    this->gbStorage.push_back(gbStorage);
+    this->gbTransfer.push_back(gbTransfer);
+    this->months.push_back(months);
+    this->amount.push_back(amount);
+    this->currency.push_back(MegaApi::strdup(currency));
+    this->description.push_back(MegaApi::strdup(description));
+    this->iosId.push_back(MegaApi::strdup(iosid));
+    this->androidId.push_back(MegaApi::strdup(androidid));
+}
+
+#ifdef ENABLE_SYNC
+MegaSyncPrivate::MegaSyncPrivate(Sync *sync)
+{
+    this->tag = sync->tag;
+    sync->client->fsaccess->local2path(&sync->localroot.localname, &localFolder);
+    this->megaHandle = sync->localroot.node->nodehandle;
+    this->fingerprint = sync->fsfp;
+    this->state = sync->state;
+    this->listener = NULL;
+    this->stats = sync->stats;
+}
+
+MegaSyncPrivate::MegaSyncPrivate(MegaSyncPrivate *sync)
+{
+    this->setTag(sync->getTag());
+    this->setLocalFolder(sync->getLocalFolder());
+    this->setMegaHandle(sync->getMegaHandle());
+    this->setLocalFingerprint(sync->getLocalFingerprint());
+    this->setState(sync->getState());
+    this->setListener(sync->getListener());
+    this->setStats(&sync->stats);
+}
+
+MegaSyncPrivate::~MegaSyncPrivate()
+{
+}
+
+MegaSync *MegaSyncPrivate::copy()
+{
+    return new MegaSyncPrivate(this);
+}
+
+MegaHandle MegaSyncPrivate::getMegaHandle() const
+{
+    return megaHandle;
+}
+
+void MegaSyncPrivate::setMegaHandle(MegaHandle handle)
+{
+    this->megaHandle = handle;
+}
 
-            for (transfer_map::iterator it = client->transfers[direction].begin() ; it != client->transfers[direction].end() ; )
-            {
-                Transfer *transfer = it->second;
-                if(transferMap.find(transfer->tag) != transferMap.end())
-                {
-                    MegaTransferPrivate* megaTransfer = transferMap.at(transfer->tag);
-                    megaTransfer->setSyncTransfer(true);
-                    megaTransfer->setLastErrorCode(API_EINCOMPLETE);
-                }
+const char *MegaSyncPrivate::getLocalFolder() const
+{
+    if(!localFolder.size())
+        return NULL;
 
-                it++;
+    return localFolder.c_str();
+}
 
-                file_list files = transfer->files;
-				file_list::iterator iterator = files.begin();
-				while (iterator != files.end())
-				{
-					File *file = *iterator;
-					iterator++;
-					if(!file->syncxfer) client->stopxfer(file);
-				}
-            }
-            fireOnRequestFinish(request, MegaError(API_OK));
-            break;
-        }
-#ifdef ENABLE_SYNC
-        case MegaRequest::TYPE_ADD_SYNC:
-        {
-            const char *localPath = request->getFile();
-            Node *node = client->nodebyhandle(request->getNodeHandle());
-            if(!node || (node->type==FILENODE) || !localPath)
-            {
-                e = API_EARGS;
-                break;
-            }
+void MegaSyncPrivate::setLocalFolder(const char *path)
+{
+    this->localFolder = path;
+}
 
-            string utf8name(localPath);
-            string localname;
-            client->fsaccess->path2local(&utf8name, &localname);
-            e = client->addsync(&localname, DEBRISFOLDER, NULL, node, 0, -nextTag);
-            if(!e)
-            {
-                MegaSyncPrivate *sync = new MegaSyncPrivate(client->syncs.back());
-                sync->setListener(request->getSyncListener());
-                syncMap[-nextTag] = sync;
+long long MegaSyncPrivate::getLocalFingerprint() const
+{
+    return fingerprint;
+}
 
-                request->setNumber(client->syncs.back()->fsfp);
-                fireOnRequestFinish(request, MegaError(API_OK));
-            }
-            break;
-        }
-        case MegaRequest::TYPE_REMOVE_SYNCS:
-        {
-            sync_list::iterator it = client->syncs.begin();
-            while(it != client->syncs.end())
-            {
-                Sync *sync = (*it);
-                int tag = sync->tag;
-                it++;
+void MegaSyncPrivate::setLocalFingerprint(long long fingerprint)
+{
+    this->fingerprint = fingerprint;
+}
 
-                client->delsync(sync);
+int MegaSyncPrivate::getTag() const
+{
+    return tag;
+}
 
-                if(syncMap.find(tag) == syncMap.end())
-                {
-                    MegaSyncPrivate *megaSync = syncMap.at(tag);
-                    syncMap.erase(tag);
-                    delete megaSync;
-                }
-            }
-            fireOnRequestFinish(request, MegaError(API_OK));
-            break;
-        }
-        case MegaRequest::TYPE_REMOVE_SYNC:
-        {
-            handle nodehandle = request->getNodeHandle();
-            sync_list::iterator it = client->syncs.begin();
-            bool found = false;
-            while(it != client->syncs.end())
-            {
-                Sync *sync = (*it);
-                int tag = sync->tag;
-                if(!sync->localroot.node || sync->localroot.node->nodehandle == nodehandle)
-                {
-                    string path;
-                    fsAccess->local2path(&sync->localroot.localname, &path);
-                    request->setFile(path.c_str());
-                    client->delsync(sync, request->getFlag());
+void MegaSyncPrivate::setTag(int tag)
+{
+    this->tag = tag;
+}
 
-                    if(syncMap.find(tag) == syncMap.end())
-                    {
-                        MegaSyncPrivate *megaSync = syncMap.at(tag);
-                        syncMap.erase(tag);
-                        delete megaSync;
-                    }
+void MegaSyncPrivate::setListener(MegaSyncListener *listener)
+{
+    this->listener = listener;
+}
 
-                    fireOnRequestFinish(request, MegaError(API_OK));
-                    found = true;
-                    break;
-                }
-                it++;
-            }
+MegaSyncListener *MegaSyncPrivate::getListener()
+{
+    return this->listener;
+}
 
-            if(!found) e = API_ENOENT;
-            break;
-        }
-#endif
-        case MegaRequest::TYPE_REPORT_EVENT:
-        {
-            const char *details = request->getText();
-            if(!details)
-            {
-                e = API_EARGS;
-                break;
-            }
+int MegaSyncPrivate::getState() const
+{
+    return state;
+}
 
-            string event = "A"; //Application event
-            int size = strlen(details);
-            char *base64details = new char[size * 4 / 3 + 4];
-            Base64::btoa((byte *)details, size, base64details);
-            client->reportevent(event.c_str(), base64details);
-            delete base64details;
-            break;
-        }
-        case MegaRequest::TYPE_DELETE:
-        {
-            threadExit = 1;
-            break;
-        }
-        case MegaRequest::TYPE_GET_PRICING:
-        case MegaRequest::TYPE_GET_PAYMENT_ID:
-        case MegaRequest::TYPE_UPGRADE_ACCOUNT:
-        {
-            int method = request->getNumber();
-            if(method != MegaApi::PAYMENT_METHOD_BALANCE && method != MegaApi::PAYMENT_METHOD_CREDIT_CARD)
-            {
-                e = API_EARGS;
-                break;
-            }
+void MegaSyncPrivate::setState(int state)
+{
+    this->state = state;
+}
 
-            client->purchase_enumeratequotaitems();
-            break;
-        }
-        case MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT:
-        {
-            const char* receipt = request->getText();
-            int type = request->getNumber();
+int MegaSyncPrivate::getNotificationQueueDepth() const
+{
+    return stats.direvents;
+}
 
-            if(!receipt || (type != MegaApi::PAYMENT_METHOD_GOOGLE_WALLET
-                            && type != MegaApi::PAYMENT_METHOD_ITUNES))
-            {
-                e = API_EARGS;
-                break;
-            }
+int MegaSyncPrivate::getRetryQueueDepth() const
+{
+    return stats.retries;
+}
 
-            if(type == MegaApi::PAYMENT_METHOD_ITUNES && client->loggedin() != FULLACCOUNT)
-            {
-                e = API_EACCESS;
-                break;
-            }
+long long MegaSyncPrivate::getNumFingerprinted() const
+{
+    return stats.fingerprinted;
+}
 
-            string base64receipt;
-            if(type == MegaApi::PAYMENT_METHOD_GOOGLE_WALLET)
-            {
-                int len = strlen(receipt);
-                base64receipt.resize(len * 4 / 3 + 4);
-                base64receipt.resize(Base64::btoa((byte *)receipt, len, (char *)base64receipt.data()));
-            }
-            else //MegaApi::PAYMENT_METHOD_ITUNES
-            {
-                base64receipt = receipt;
-            }
+long long MegaSyncPrivate::getFingerprintRate() const
+{
+    return stats.fingerprintrate;
+}
 
-            client->submitpurchasereceipt(type, base64receipt.c_str());
-            break;
-        }
-        case MegaRequest::TYPE_CREDIT_CARD_STORE:
-        {
-            const char *ccplain = request->getText();
-            e = client->creditcardstore(ccplain);
-            break;
-        }
-        case MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS:
-        {
-            client->creditcardquerysubscriptions();
-            break;
-        }
-        case MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS:
-        {
-            const char* reason = request->getText();
-            client->creditcardcancelsubscriptions(reason);
-            break;
-        }
-        case MegaRequest::TYPE_GET_PAYMENT_METHODS:
-        {
-            client->getpaymentmethods();
-            break;
-        }
-        case MegaRequest::TYPE_SUBMIT_FEEDBACK:
-        {
-            int rating = request->getNumber();
-            const char *message = request->getText();
+long long MegaSyncPrivate::getPendingUploadBytes() const
+{
+    return stats.pendingup;
+}
 
-            if(rating < 1 || rating > 5)
-            {
-                e = API_EARGS;
-                break;
-            }
+long long MegaSyncPrivate::getPendingDownloadBytes() const
+{
+    return stats.pendingdown;
+}
 
-            if(!message)
-            {
-                message = "";
-            }
+long long MegaSyncPrivate::getSyncDownTime() const
+{
+    return stats.syncdownds * 100;
+}
+
+long long MegaSyncPrivate::getSyncUpTime() const
+{
+    return stats.syncupds * 100;
+}
+
+long long MegaSyncPrivate::getCacheFlushTime() const
+{
+    return stats.cacheflushds * 100;
+}
 
-            int size = strlen(message);
-            char *base64message = new char[size * 4 / 3 + 4];
-            Base64::btoa((byte *)message, size, base64message);
+long long MegaSyncPrivate::getNumNotifications() const
+{
+    return stats.notifications;
+}
 
-            char base64uhandle[12];
-            Base64::btoa((const byte*)&client->me, MegaClient::USERHANDLE, base64uhandle);
+long long MegaSyncPrivate::getNumSupersededNotifications() const
+{
+    return stats.superseded;
+}
 
-            string feedback;
-            feedback.resize(128 + strlen(base64message));
+void MegaSyncPrivate::setStats(const SyncStats *stats)
+{
+    this->stats = *stats;
+}
 
-            snprintf((char *)feedback.data(), feedback.size(), "{\\\"r\\\":\\\"%d\\\",\\\"m\\\":\\\"%s\\\",\\\"u\\\":\\\"%s\\\"}", rating, base64message, base64uhandle);
-            client->userfeedbackstore(feedback.c_str());
-            delete [] base64message;
-            break;
-        }
-        case MegaRequest::TYPE_SEND_EVENT:
-        {
-            int number = request->getNumber();
-            const char *text = request->getText();
+MegaSyncEventPrivate::MegaSyncEventPrivate(int type)
+{
+    this->type = type;
+    path = NULL;
+    newPath = NULL;
+    prevName = NULL;
+    nodeHandle = INVALID_HANDLE;
+    prevParent = INVALID_HANDLE;
+}
 
-            if(number < 99500 || number >= 99600 || !text)
-            {
-                e = API_EARGS;
-                break;
-            }
+MegaSyncEventPrivate::~MegaSyncEventPrivate()
+{
+    delete path;
+}
 
-            client->sendevent(number, text);
-            break;
-        }
-        case MegaRequest::TYPE_GET_USER_DATA:
-        {
-            const char *email = request->getEmail();
-            if(request->getFlag() && !email)
-            {
-                e = API_EARGS;
-                break;
-            }
+MegaSyncEvent *MegaSyncEventPrivate::copy()
+{
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(type);
+    event->setPath(this->path);
+    event->setNodeHandle(this->nodeHandle);
+    event->setNewPath(this->newPath);
+    event->setPrevName(this->prevName);
+    event->setPrevParent(this->prevParent);
+    return event;
+}
 
-            if(!request->getFlag())
-            {
-                client->getuserdata();
-            }
-            else
-            {
-                client->getpubkey(email);
-            }
+int MegaSyncEventPrivate::getType() const
+{
+    return type;
+}
 
-            break;
-        }
-        case MegaRequest::TYPE_LOAD_BALANCING:
-        {
-            const char* service = request->getName();
-            if(!service)
-            {
-                e = API_EARGS;
-                break;
-            }
+const char *MegaSyncEventPrivate::getPath() const
+{
+    return path;
+}
 
-            client->loadbalancing(service);
-            break;
-        }
-        case MegaRequest::TYPE_KILL_SESSION:
-        {
-            MegaHandle handle = request->getNodeHandle();
-            if (handle == INVALID_HANDLE)
-            {
-                client->killallsessions();
-            }
-            else
-            {
-                client->killsession(handle);
-            }
-            break;
-        }
-        case MegaRequest::TYPE_GET_SESSION_TRANSFER_URL:
-        {
-            client->copysession();
-            break;
-        }
-        case MegaRequest::TYPE_CLEAN_RUBBISH_BIN:
-        {
-            client->cleanrubbishbin();
-            break;
-        }
-        default:
-        {
-            e = API_EINTERNAL;
-        }
-        }
+MegaHandle MegaSyncEventPrivate::getNodeHandle() const
+{
+    return nodeHandle;
+}
 
-		if(e)
-        {
-            LOG_err << "Error starting request: " << e;
-            fireOnRequestFinish(request, MegaError(e));
-        }
+const char *MegaSyncEventPrivate::getNewPath() const
+{
+    return newPath;
+}
 
-		sdkMutex.unlock();
-	}
+const char *MegaSyncEventPrivate::getPrevName() const
+{
+    return prevName;
 }
 
-char* MegaApiImpl::stringToArray(string &buffer)
+MegaHandle MegaSyncEventPrivate::getPrevParent() const
 {
-	char *newbuffer = new char[buffer.size()+1];
-	memcpy(newbuffer, buffer.data(), buffer.size());
-	newbuffer[buffer.size()]='\0';
-    return newbuffer;
+    return prevParent;
 }
 
-void MegaApiImpl::updateStats()
+void MegaSyncEventPrivate::setPath(const char *path)
 {
-    transfer_map::iterator it;
-    transfer_map::iterator end;
-    int downloadCount = 0;
-    int uploadCount = 0;
+    if(this->path)
+    {
+        delete [] this->path;
+    }
+    this->path =  MegaApi::strdup(path);
+}
 
-    sdkMutex.lock();
-    it = client->transfers[0].begin();
-    end = client->transfers[0].end();
-    while(it != end)
+void MegaSyncEventPrivate::setNodeHandle(MegaHandle nodeHandle)
+{
+    this->nodeHandle = nodeHandle;
+}
+
+void MegaSyncEventPrivate::setNewPath(const char *newPath)
+{
+    if(this->newPath)
     {
-        Transfer *transfer = it->second;
-        if((transfer->failcount<2) || (transfer->slot && (Waiter::ds - transfer->slot->lastdata) < TransferSlot::XFERTIMEOUT))
-            downloadCount++;
-        it++;
+        delete [] this->newPath;
     }
+    this->newPath =  MegaApi::strdup(newPath);
+}
 
-    it = client->transfers[1].begin();
-    end = client->transfers[1].end();
-    while(it != end)
+void MegaSyncEventPrivate::setPrevName(const char *prevName)
+{
+    if(this->prevName)
     {
-        Transfer *transfer = it->second;
-        if((transfer->failcount<2) || (transfer->slot && (Waiter::ds - transfer->slot->lastdata) < TransferSlot::XFERTIMEOUT))
-            uploadCount++;
-        it++;
+        delete [] this->prevName;
     }
+    this->prevName =  MegaApi::strdup(prevName);
+}
 
-    pendingDownloads = downloadCount;
-    pendingUploads = uploadCount;
-    sdkMutex.unlock();
+void MegaSyncEventPrivate::setPrevParent(MegaHandle prevParent)
+{
+    this->prevParent = prevParent;
 }
 
-long long MegaApiImpl::getTotalDownloadedBytes()
+#endif
+
+
+MegaAccountBalance *MegaAccountBalancePrivate::fromAccountBalance(const AccountBalance *balance)
 {
-    return totalDownloadedBytes;
+    return new MegaAccountBalancePrivate(balance);
 }
 
-long long MegaApiImpl::getTotalUploadedBytes()
+MegaAccountBalancePrivate::~MegaAccountBalancePrivate()
 {
-    return totalUploadedBytes;
+
 }
 
-void MegaApiImpl::update()
+MegaAccountBalance *MegaAccountBalancePrivate::copy()
+{
+    return new MegaAccountBalancePrivate(&balance);
+}
+
+double MegaAccountBalancePrivate::getAmount() const
+{
+    return balance.amount;
+}
+
+char *MegaAccountBalancePrivate::getCurrency() const
+{
+    return MegaApi::strdup(balance.currency);
+}
+
+MegaAccountBalancePrivate::MegaAccountBalancePrivate(const AccountBalance *balance)
+{
+    this->balance = *balance;
+}
+
+MegaAccountSession *MegaAccountSessionPrivate::fromAccountSession(const AccountSession *session)
+{
+    return new MegaAccountSessionPrivate(session);
+}
+
+MegaAccountSessionPrivate::~MegaAccountSessionPrivate()
+{
+
+}
+
+MegaAccountSession *MegaAccountSessionPrivate::copy()
+{
+    return new MegaAccountSessionPrivate(&session);
+}
+
+int64_t MegaAccountSessionPrivate::getCreationTimestamp() const
+{
+    return session.timestamp;
+}
+
+int64_t MegaAccountSessionPrivate::getMostRecentUsage() const
+{
+    return session.mru;
+}
+
+char *MegaAccountSessionPrivate::getUserAgent() const
+{
+    return MegaApi::strdup(session.useragent.c_str());
+}
+
+char *MegaAccountSessionPrivate::getIP() const
 {
-    waiter->notify();
+    return MegaApi::strdup(session.ip.c_str());
 }
 
-bool MegaApiImpl::isWaiting()
+char *MegaAccountSessionPrivate::getCountry() const
 {
-    return waiting || waitingRequest;
+    return MegaApi::strdup(session.country);
 }
 
-TreeProcCopy::TreeProcCopy()
+bool MegaAccountSessionPrivate::isCurrent() const
 {
-	nn = NULL;
-	nc = 0;
+    return session.current;
 }
 
-void TreeProcCopy::allocnodes()
+bool MegaAccountSessionPrivate::isAlive() const
 {
-	if(nc) nn = new NewNode[nc];
+    return session.alive;
 }
 
-TreeProcCopy::~TreeProcCopy()
+MegaHandle MegaAccountSessionPrivate::getHandle() const
 {
-	//Will be deleted in putnodes_result
-	//delete[] nn;
+    return session.id;
 }
 
-// determine node tree size (nn = NULL) or write node tree to new nodes array
-void TreeProcCopy::proc(MegaClient* client, Node* n)
+MegaAccountSessionPrivate::MegaAccountSessionPrivate(const AccountSession *session)
 {
-	if (nn)
-	{
-		string attrstring;
-		SymmCipher key;
-		NewNode* t = nn+--nc;
+    this->session = *session;
+}
 
-		// copy node
-		t->source = NEW_NODE;
-		t->type = n->type;
-		t->nodehandle = n->nodehandle;
-        t->parenthandle = n->parent ? n->parent->nodehandle : UNDEF;
 
-		// copy key (if file) or generate new key (if folder)
-		if (n->type == FILENODE) t->nodekey = n->nodekey;
-		else
-		{
-			byte buf[FOLDERNODEKEYLENGTH];
-			PrnGen::genblock(buf,sizeof buf);
-			t->nodekey.assign((char*)buf,FOLDERNODEKEYLENGTH);
-		}
+MegaAccountPurchase *MegaAccountPurchasePrivate::fromAccountPurchase(const AccountPurchase *purchase)
+{
+    return new MegaAccountPurchasePrivate(purchase);
+}
 
-		t->attrstring = new string;
-		if(t->nodekey.size())
-		{
-			key.setkey((const byte*)t->nodekey.data(),n->type);
+MegaAccountPurchasePrivate::~MegaAccountPurchasePrivate()
+{
 
-			n->attrs.getjson(&attrstring);
-			client->makeattr(&key,t->attrstring,attrstring.c_str());
-		}
-	}
-	else nc++;
 }
 
-TransferQueue::TransferQueue()
+MegaAccountPurchase *MegaAccountPurchasePrivate::copy()
 {
-    mutex.init(false);
+    return new MegaAccountPurchasePrivate(&purchase);
 }
 
-void TransferQueue::push(MegaTransferPrivate *transfer)
+int64_t MegaAccountPurchasePrivate::getTimestamp() const
 {
-    mutex.lock();
-    transfers.push_back(transfer);
-    mutex.unlock();
+    return purchase.timestamp;
 }
 
-void TransferQueue::push_front(MegaTransferPrivate *transfer)
+char *MegaAccountPurchasePrivate::getHandle() const
 {
-    mutex.lock();
-    transfers.push_front(transfer);
-    mutex.unlock();
+    return MegaApi::strdup(purchase.handle);
 }
 
-MegaTransferPrivate *TransferQueue::pop()
+char *MegaAccountPurchasePrivate::getCurrency() const
 {
-    mutex.lock();
-    if(transfers.empty())
-    {
-        mutex.unlock();
-        return NULL;
-    }
-    MegaTransferPrivate *transfer = transfers.front();
-    transfers.pop_front();
-    mutex.unlock();
-    return transfer;
+    return MegaApi::strdup(purchase.currency);
 }
 
-RequestQueue::RequestQueue()
+double MegaAccountPurchasePrivate::getAmount() const
 {
-    mutex.init(false);
+    return purchase.amount;
 }
 
-void RequestQueue::push(MegaRequestPrivate *request)
+int MegaAccountPurchasePrivate::getMethod() const
 {
-    mutex.lock();
-    requests.push_back(request);
-    mutex.unlock();
+    return purchase.method;
 }
 
-void RequestQueue::push_front(MegaRequestPrivate *request)
+MegaAccountPurchasePrivate::MegaAccountPurchasePrivate(const AccountPurchase *purchase)
 {
-    mutex.lock();
-    requests.push_front(request);
-    mutex.unlock();
+    this->purchase = *purchase;
 }
 
-MegaRequestPrivate *RequestQueue::pop()
+
+MegaAccountTransaction *MegaAccountTransactionPrivate::fromAccountTransaction(const AccountTransaction *transaction)
 {
-    mutex.lock();
-    if(requests.empty())
-    {
-        mutex.unlock();
-        return NULL;
-    }
-    MegaRequestPrivate *request = requests.front();
-    requests.pop_front();
-    mutex.unlock();
-    return request;
+    return new MegaAccountTransactionPrivate(transaction);
 }
 
-void RequestQueue::removeListener(MegaRequestListener *listener)
+MegaAccountTransactionPrivate::~MegaAccountTransactionPrivate()
 {
-    mutex.lock();
-
-    std::deque<MegaRequestPrivate *>::iterator it = requests.begin();
-    while(it != requests.end())
-    {
-        MegaRequestPrivate *request = (*it);
-        if(request->getListener()==listener)
-            request->setListener(NULL);
-        it++;
-    }
 
-    mutex.unlock();
 }
 
-#ifdef ENABLE_SYNC
-void RequestQueue::removeListener(MegaSyncListener *listener)
+MegaAccountTransaction *MegaAccountTransactionPrivate::copy()
 {
-    mutex.lock();
-
-    std::deque<MegaRequestPrivate *>::iterator it = requests.begin();
-    while(it != requests.end())
-    {
-        MegaRequestPrivate *request = (*it);
-        if(request->getSyncListener()==listener)
-            request->setSyncListener(NULL);
-        it++;
-    }
+    return new MegaAccountTransactionPrivate(&transaction);
+}
 
-    mutex.unlock();
+int64_t MegaAccountTransactionPrivate::getTimestamp() const
+{
+    return transaction.timestamp;
 }
-#endif
 
-MegaHashSignatureImpl::MegaHashSignatureImpl(const char *base64Key)
+char *MegaAccountTransactionPrivate::getHandle() const
 {
-    hashSignature = new HashSignature(new Hash());
-    asymmCypher = new AsymmCipher();
+    return MegaApi::strdup(transaction.handle);
+}
 
-    string pubks;
-    int len = strlen(base64Key)/4*3+3;
-    pubks.resize(len);
-    pubks.resize(Base64::atob(base64Key, (byte *)pubks.data(), len));
-    asymmCypher->setkey(AsymmCipher::PUBKEY,(byte*)pubks.data(), pubks.size());
+char *MegaAccountTransactionPrivate::getCurrency() const
+{
+    return MegaApi::strdup(transaction.currency);
 }
 
-MegaHashSignatureImpl::~MegaHashSignatureImpl()
+double MegaAccountTransactionPrivate::getAmount() const
 {
-    delete hashSignature;
-    delete asymmCypher;
+    return transaction.delta;
 }
 
-void MegaHashSignatureImpl::init()
+MegaAccountTransactionPrivate::MegaAccountTransactionPrivate(const AccountTransaction *transaction)
 {
-    hashSignature->get(asymmCypher, NULL, 0);
+    this->transaction = *transaction;
 }
 
-void MegaHashSignatureImpl::add(const char *data, unsigned size)
+
+
+ExternalInputStream::ExternalInputStream(MegaInputStream *inputStream)
 {
-    hashSignature->add((const byte *)data, size);
+    this->inputStream = inputStream;
 }
 
-bool MegaHashSignatureImpl::checkSignature(const char *base64Signature)
+m_off_t ExternalInputStream::size()
 {
-    char signature[512];
-    int l = Base64::atob(base64Signature, (byte *)signature, sizeof(signature));
-    if(l != sizeof(signature))
-        return false;
+    return inputStream->getSize();
+}
 
-    return hashSignature->check(asymmCypher, (const byte *)signature, sizeof(signature));
+bool ExternalInputStream::read(byte *buffer, unsigned size)
+{
+    return inputStream->read((char *)buffer, size);
 }
 
-int MegaAccountDetailsPrivate::getProLevel()
+
+FileInputStream::FileInputStream(FileAccess *fileAccess)
 {
-    return details.pro_level;
+    this->fileAccess = fileAccess;
+    this->offset = 0;
 }
 
-int64_t MegaAccountDetailsPrivate::getProExpiration()
+m_off_t FileInputStream::size()
 {
-    return details.pro_until;
+    return fileAccess->size;
 }
 
-int MegaAccountDetailsPrivate::getSubscriptionStatus()
+bool FileInputStream::read(byte *buffer, unsigned size)
 {
-    if(details.subscription_type == 'S')
+    if (!buffer)
     {
-        return MegaAccountDetails::SUBSCRIPTION_STATUS_VALID;
+        if ((offset + size) <= fileAccess->size)
+        {
+            offset += size;
+            return true;
+        }
+
+        LOG_warn << "Invalid seek on FileInputStream";
+        return false;
     }
 
-    if(details.subscription_type == 'R')
+    if (fileAccess->sysread(buffer, size, offset))
     {
-        return MegaAccountDetails::SUBSCRIPTION_STATUS_INVALID;
+        offset += size;
+        return true;
     }
 
-    return MegaAccountDetails::SUBSCRIPTION_STATUS_NONE;
+    LOG_warn << "Invalid read on FileInputStream";
+    return false;
 }
 
-int64_t MegaAccountDetailsPrivate::getSubscriptionRenewTime()
+FileInputStream::~FileInputStream()
 {
-    return details.subscription_renew;
-}
 
-char *MegaAccountDetailsPrivate::getSubscriptionMethod()
-{
-    return MegaApi::strdup(details.subscription_method.c_str());
 }
 
-char *MegaAccountDetailsPrivate::getSubscriptionCycle()
-{
-    return MegaApi::strdup(details.subscription_cycle);
-}
+#ifndef WINDOWS_PHONE
+#ifdef _WIN32
+#define closesocket_ closesocket
+#define SHUT_RDWR SD_BOTH
+typedef int socklen_t;
+#else
+#define INVALID_SOCKET -1
+#define closesocket_ ::close
+#endif
 
-long long MegaAccountDetailsPrivate::getStorageMax()
-{
-    return details.storage_max;
-}
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 
-long long MegaAccountDetailsPrivate::getStorageUsed()
+static void httpsleep(int ms)
 {
-    return details.storage_used;
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
 }
 
-long long MegaAccountDetailsPrivate::getTransferMax()
+// case-insensitive value of a header field ("" if not present)
+static string httpheader(const string *header, const char *name)
 {
-    return details.transfer_max;
-}
+    size_t namelen = strlen(name);
+    size_t p = header->find("\r\n");
 
-long long MegaAccountDetailsPrivate::getTransferOwnUsed()
-{
-    return details.transfer_own_used;
-}
+    while (p != string::npos && p + 2 < header->size())
+    {
+        p += 2;
+        size_t e = header->find("\r\n", p);
 
-int MegaAccountDetailsPrivate::getNumUsageItems()
-{
-    return details.storage.size();
-}
+        if (e == string::npos)
+        {
+            break;
+        }
+
+        if (e - p > namelen && (*header)[p + namelen] == ':')
+        {
+            size_t i;
+
+            for (i = 0; i < namelen && tolower((unsigned char)(*header)[p + i]) == tolower((unsigned char)name[i]); i++);
+
+            if (i == namelen)
+            {
+                p += namelen + 1;
+
+                while (p < e && ((*header)[p] == ' ' || (*header)[p] == '\t'))
+                {
+                    p++;
+                }
+
+                return header->substr(p, e - p);
+            }
+        }
+
+        p = e;
+    }
 
-long long MegaAccountDetailsPrivate::getStorageUsed(MegaHandle handle)
-{
-    return details.storage[handle].bytes;
+    return string();
 }
 
-long long MegaAccountDetailsPrivate::getNumFiles(MegaHandle handle)
+// content type from the file name's extension
+static const char *httpcontenttype(const char *name)
 {
-    return details.storage[handle].files;
-}
+    static const char *types[][2] = {
+        { "mp4", "video/mp4" }, { "m4v", "video/mp4" }, { "mov", "video/quicktime" },
+        { "mkv", "video/x-matroska" }, { "webm", "video/webm" }, { "avi", "video/x-msvideo" },
+        { "wmv", "video/x-ms-wmv" }, { "flv", "video/x-flv" }, { "mpg", "video/mpeg" },
+        { "mpeg", "video/mpeg" }, { "ts", "video/mp2t" }, { "3gp", "video/3gpp" },
+        { "mp3", "audio/mpeg" }, { "m4a", "audio/mp4" }, { "aac", "audio/aac" },
+        { "ogg", "audio/ogg" }, { "oga", "audio/ogg" }, { "opus", "audio/ogg" },
+        { "flac", "audio/flac" }, { "wav", "audio/wav" }, { "wma", "audio/x-ms-wma" },
+        { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" }, { "png", "image/png" },
+        { "gif", "image/gif" }, { "pdf", "application/pdf" }, { "txt", "text/plain" },
+        { "srt", "text/plain" }, { "vtt", "text/vtt" }
+    };
 
-long long MegaAccountDetailsPrivate::getNumFolders(MegaHandle handle)
-{
-    return details.storage[handle].folders;
+    const char *ext = name ? strrchr(name, '.') : NULL;
+
+    if (ext)
+    {
+        ext++;
+
+        for (unsigned i = 0; i < sizeof types / sizeof *types; i++)
+        {
+            size_t j;
+
+            for (j = 0; types[i][0][j] && tolower((unsigned char)ext[j]) == types[i][0][j]; j++);
+
+            if (!types[i][0][j] && !ext[j])
+            {
+                return types[i][1];
+            }
+        }
+    }
+
+    return "application/octet-stream";
 }
 
-MegaAccountDetails* MegaAccountDetailsPrivate::copy()
+MegaHTTPServer::MegaHTTPServer(MegaApiImpl *api, bool peer)
 {
-    return new MegaAccountDetailsPrivate(&details);
+    this->api = api;
+    this->peer = peer;
+    stopping = false;
+    listenfd = INVALID_SOCKET;
+    udpfd = INVALID_SOCKET;
+    nonce = (unsigned)Waiter::us() ^ (unsigned)(size_t)this;
+    port = 0;
+    localOnly = true;
+    mutex.init(false);
 }
 
-int MegaAccountDetailsPrivate::getNumBalances() const
+MegaHTTPServer::~MegaHTTPServer()
 {
-    return details.balances.size();
+    stop();
 }
 
-MegaAccountBalance *MegaAccountDetailsPrivate::getBalance(int i) const
+bool MegaHTTPServer::start(int port, bool localOnly)
 {
-    if(i < details.balances.size())
+    struct sockaddr_in addr;
+    int on = 1;
+
+#ifdef _WIN32
+    WSADATA wsadata;
+    WSAStartup(MAKEWORD(2, 2), &wsadata);
+#endif
+
+    if (port <= 0 || port > 65535 || (listenfd = socket(AF_INET, SOCK_STREAM, 0)) == INVALID_SOCKET)
     {
-        return MegaAccountBalancePrivate::fromAccountBalance(&(details.balances[i]));
+        return false;
     }
-    return NULL;
-}
 
-int MegaAccountDetailsPrivate::getNumSessions() const
-{
-    return details.sessions.size();
-}
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof on);
 
-MegaAccountSession *MegaAccountDetailsPrivate::getSession(int i) const
-{
-    if(i < details.sessions.size())
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(localOnly ? INADDR_LOOPBACK : INADDR_ANY);
+
+    if (bind(listenfd, (struct sockaddr *)&addr, sizeof addr) || listen(listenfd, 16))
     {
-        return MegaAccountSessionPrivate::fromAccountSession(&(details.sessions[i]));
+        LOG_err << "Unable to start the HTTP server on port " << port;
+        closesocket_(listenfd);
+        listenfd = INVALID_SOCKET;
+        return false;
     }
-    return NULL;
-}
 
-int MegaAccountDetailsPrivate::getNumPurchases() const
-{
-    return details.purchases.size();
+    // peers are discovered by broadcasts to the same port
+    if (peer)
+    {
+        if ((udpfd = socket(AF_INET, SOCK_DGRAM, 0)) != INVALID_SOCKET)
+        {
+            setsockopt(udpfd, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof on);
+            setsockopt(udpfd, SOL_SOCKET, SO_BROADCAST, (const char *)&on, sizeof on);
+
+            if (bind(udpfd, (struct sockaddr *)&addr, sizeof addr))
+            {
+                closesocket_(udpfd);
+                udpfd = INVALID_SOCKET;
+            }
+        }
+
+        if (udpfd == INVALID_SOCKET)
+        {
+            LOG_err << "Unable to open the peer discovery socket on port " << port;
+            closesocket_(listenfd);
+            listenfd = INVALID_SOCKET;
+            return false;
+        }
+    }
+
+    this->port = port;
+    this->localOnly = localOnly;
+
+    LOG_info << "HTTP server listening on port " << port;
+    thread.start(threadEntryPoint, this);
+
+    return true;
 }
 
-MegaAccountPurchase *MegaAccountDetailsPrivate::getPurchase(int i) const
+void MegaHTTPServer::stop()
 {
-    if(i < details.purchases.size())
+    if (listenfd == INVALID_SOCKET)
     {
-        return MegaAccountPurchasePrivate::fromAccountPurchase(&(details.purchases[i]));
+        return;
     }
-    return NULL;
-}
 
-int MegaAccountDetailsPrivate::getNumTransactions() const
-{
-    return details.transactions.size();
-}
+    stopping = true;
+    thread.join();
 
-MegaAccountTransaction *MegaAccountDetailsPrivate::getTransaction(int i) const
-{
-    if(i < details.transactions.size())
+    closesocket_(listenfd);
+    listenfd = INVALID_SOCKET;
+
+    if (udpfd != INVALID_SOCKET)
     {
-        return MegaAccountTransactionPrivate::fromAccountTransaction(&(details.transactions[i]));
+        closesocket_(udpfd);
+        udpfd = INVALID_SOCKET;
     }
-    return NULL;
-}
 
-ExternalLogger::ExternalLogger()
-{
-	mutex.init(true);
-	this->megaLogger = NULL;
-	SimpleLogger::setOutputClass(this);
+    mutex.lock();
+    for (list<MegaHTTPConnection *>::iterator it = connections.begin(); it != connections.end(); it++)
+    {
+        (*it)->close();
+    }
+    mutex.unlock();
 
-    //Initialize outputSettings map
-    SimpleLogger::outputSettings[(LogLevel)logFatal];
-    SimpleLogger::outputSettings[(LogLevel)logError];
-    SimpleLogger::outputSettings[(LogLevel)logWarning];
-    SimpleLogger::outputSettings[(LogLevel)logInfo];
-    SimpleLogger::outputSettings[(LogLevel)logDebug];
-    SimpleLogger::outputSettings[(LogLevel)logMax];
+    while (connections.size())
+    {
+        MegaHTTPConnection *connection = connections.front();
+        connection->thread.join();
+        connections.pop_front();
+        delete connection;
+    }
+
+    LOG_info << "HTTP server stopped";
 }
 
-void ExternalLogger::setMegaLogger(MegaLogger *logger)
+int MegaHTTPServer::getPort()
 {
-	this->megaLogger = logger;
+    return port;
 }
 
-void ExternalLogger::setLogLevel(int logLevel)
+bool MegaHTTPServer::isLocalOnly()
 {
-	SimpleLogger::setLogLevel((LogLevel)logLevel);
+    return localOnly;
 }
 
-void ExternalLogger::postLog(int logLevel, const char *message, const char *filename, int line)
+char *MegaHTTPServer::getLink(MegaNode *node)
 {
-    if(SimpleLogger::logCurrentLevel < logLevel)
-        return;
+    char base64handle[12];
+    char buf[32];
+    MegaHandle h = node->getHandle();
+    const char *name = node->getName();
+    string link;
 
-	if(!message)
-	{
-		message = "";
-	}
+    Base64::btoa((byte *)&h, MegaClient::NODEHANDLE, base64handle);
+    snprintf(buf, sizeof buf, "http://127.0.0.1:%d/", port);
 
-	if(!filename)
-	{
-		filename = "";
-	}
+    link = buf;
+    link.append(base64handle);
+    link.append("/");
 
-    mutex.lock();
-	SimpleLogger((LogLevel)logLevel, filename, line) << message;
-    mutex.unlock();
+    // percent-encode everything but the unreserved characters
+    for (const char *p = name; p && *p; p++)
+    {
+        unsigned char c = (unsigned char)*p;
+
+        if (isalnum(c) || strchr("-._~", c))
+        {
+            link.append(1, (char)c);
+        }
+        else
+        {
+            snprintf(buf, sizeof buf, "%%%02X", c);
+            link.append(buf);
+        }
+    }
+
+    return MegaApi::strdup(link.c_str());
 }
 
-void ExternalLogger::log(const char *time, int loglevel, const char *source, const char *message)
+void *MegaHTTPServer::threadEntryPoint(void *param)
 {
-	if(!time)
-	{
-		time = "";
-	}
+    ((MegaHTTPServer *)param)->loop();
+    return NULL;
+}
 
-	if(!source)
-	{
-		source = "";
-	}
+void MegaHTTPServer::loop()
+{
+    while (!stopping)
+    {
+        fd_set rfds;
+        struct timeval tv;
 
-	if(!message)
-	{
-		message = "";
-	}
+        FD_ZERO(&rfds);
+        FD_SET(listenfd, &rfds);
 
-	mutex.lock();
-	if(megaLogger)
-	{
-        megaLogger->log(time, loglevel, source, message);
-	}
-	else
-	{
-		cout << "[" << time << "][" << SimpleLogger::toStr((LogLevel)loglevel) << "] " << message << endl;
-	}
-	mutex.unlock();
-}
+        if (udpfd != INVALID_SOCKET)
+        {
+            FD_SET(udpfd, &rfds);
+        }
 
+        // (wakes up regularly to notice stop() and to reap connections)
+        tv.tv_sec = 0;
+        tv.tv_usec = 200000;
 
-OutShareProcessor::OutShareProcessor()
-{
+        int maxfd = (int)(udpfd != INVALID_SOCKET && udpfd > listenfd ? udpfd : listenfd);
 
-}
+        if (select(maxfd + 1, &rfds, NULL, NULL, &tv) <= 0)
+        {
+            reap();
+            continue;
+        }
 
-bool OutShareProcessor::processNode(Node *node)
-{
-    if(!node->outshares)
-    {
-        return true;
-    }
+        if (udpfd != INVALID_SOCKET && FD_ISSET(udpfd, &rfds))
+        {
+            discovery();
+        }
 
-    for (share_map::iterator it = node->outshares->begin(); it != node->outshares->end(); it++)
-	{
-		shares.push_back(it->second);
-		handles.push_back(node->nodehandle);
-	}
+        if (FD_ISSET(listenfd, &rfds))
+        {
+            MegaSocket fd = accept(listenfd, NULL, NULL);
 
-	return true;
-}
+            if (fd != INVALID_SOCKET)
+            {
+                reap();
 
-vector<Share *> &OutShareProcessor::getShares()
-{
-	return shares;
-}
+                mutex.lock();
+                bool full = connections.size() >= MAXCONNECTIONS;
+                mutex.unlock();
 
-vector<handle> &OutShareProcessor::getHandles()
-{
-	return handles;
-}
+                if (full)
+                {
+                    static const char busy[] = "HTTP/1.1 503 Service Unavailable\r\n"
+                                               "Content-Length: 0\r\nConnection: close\r\n\r\n";
 
-PendingOutShareProcessor::PendingOutShareProcessor()
-{
+                    LOG_warn << "HTTP server: too many connections";
+                    send(fd, busy, sizeof busy - 1, MSG_NOSIGNAL);
+                    closesocket_(fd);
+                }
+                else
+                {
+                    MegaHTTPConnection *connection = new MegaHTTPConnection(this, fd);
 
-}
+                    mutex.lock();
+                    connections.push_back(connection);
+                    mutex.unlock();
 
-bool PendingOutShareProcessor::processNode(Node *node)
-{
-    if(!node->pendingshares)
-    {
-        return true;
-    }
+                    connection->start();
+                }
+            }
+        }
 
-    for (share_map::iterator it = node->pendingshares->begin(); it != node->pendingshares->end(); it++)
-    {
-        shares.push_back(it->second);
-        handles.push_back(node->nodehandle);
+        reap();
     }
-
-    return true;
 }
 
-vector<Share *> &PendingOutShareProcessor::getShares()
+// discovery datagrams: "MEGAPEER ? <base64 handle> <nonce>" asks the
+// network for a node, peers holding it answer "MEGAPEER ! <base64 handle>"
+// to the sender
+void MegaHTTPServer::query(MegaHandle h)
 {
-    return shares;
-}
+    char base64handle[12];
+    char buf[64];
+    struct sockaddr_in addr;
 
-vector<handle> &PendingOutShareProcessor::getHandles()
-{
-    return handles;
+    Base64::btoa((byte *)&h, MegaClient::NODEHANDLE, base64handle);
+    int len = snprintf(buf, sizeof buf, "MEGAPEER ? %s %u", base64handle, nonce);
+
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(INADDR_BROADCAST);
+
+    sendto(udpfd, buf, len, 0, (struct sockaddr *)&addr, sizeof addr);
 }
 
-MegaPricingPrivate::~MegaPricingPrivate()
+void MegaHTTPServer::discovery()
 {
-    for(unsigned i = 0; i < currency.size(); i++)
-    {
-        delete[] currency[i];
-    }
+    char buf[64];
+    char base64handle[12];
+    unsigned qnonce = 0;
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof from;
 
-    for(unsigned i = 0; i < description.size(); i++)
-    {
-        delete[] description[i];
-    }
+    int len = (int)recvfrom(udpfd, buf, sizeof buf - 1, 0, (struct sockaddr *)&from, &fromlen);
 
-    for(unsigned i = 0; i < iosId.size(); i++)
+    if (len <= 0)
     {
-        delete[] iosId[i];
+        return;
     }
 
-    for(unsigned i = 0; i < androidId.size(); i++)
+    buf[len] = 0;
+
+    if (sscanf(buf, "MEGAPEER ? %11s %u", base64handle, &qnonce) == 2)
     {
-        delete[] androidId[i];
-    }
-}
+        string nodekey;
+        FileAccess *fa;
 
-int MegaPricingPrivate::getNumProducts()
-{
-    return handles.size();
-}
+        // (our own broadcast comes back to us)
+        if (qnonce == nonce || strlen(base64handle) != 8
+                || !(fa = api->openPeerSource(MegaApi::base64ToHandle(base64handle), &nodekey)))
+        {
+            return;
+        }
 
-handle MegaPricingPrivate::getHandle(int productIndex)
-{
-    if((unsigned)productIndex < handles.size())
-        return handles[productIndex];
+        delete fa;
 
-    return UNDEF;
+        len = snprintf(buf, sizeof buf, "MEGAPEER ! %s", base64handle);
+        sendto(udpfd, buf, len, 0, (struct sockaddr *)&from, fromlen);
+    }
+    else if (sscanf(buf, "MEGAPEER ! %11s", base64handle) == 1 && strlen(base64handle) == 8)
+    {
+        char url[64];
+
+        // the peer serves the chunks on the TCP port of the same number
+        snprintf(url, sizeof url, "http://%s:%d/%s", inet_ntoa(from.sin_addr), port, base64handle);
+        api->setPeerUrl(MegaApi::base64ToHandle(base64handle), url);
+    }
 }
 
-int MegaPricingPrivate::getProLevel(int productIndex)
+void MegaHTTPServer::reap()
 {
-    if((unsigned)productIndex < proLevel.size())
-        return proLevel[productIndex];
-
-    return 0;
+    mutex.lock();
+    for (list<MegaHTTPConnection *>::iterator it = connections.begin(); it != connections.end(); )
+    {
+        if ((*it)->finished)
+        {
+            (*it)->thread.join();
+            delete *it;
+            connections.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
+    }
+    mutex.unlock();
 }
 
-int MegaPricingPrivate::getGBStorage(int productIndex)
+MegaHTTPConnection::MegaHTTPConnection(MegaHTTPServer *server, MegaSocket fd)
 {
-    if((unsigned)productIndex < gbStorage.size())
-        return gbStorage[productIndex];
+    this->server = server;
+    this->fd = fd;
+    finished = false;
+    closing = false;
+    transfertag = 0;
+    paused = NULL;
+    windowactive = false;
+    windowfailed = false;
+    cancelled = false;
+    mutex.init(false);
 
-    return 0;
+#ifdef __APPLE__
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof on);
+#endif
 }
 
-int MegaPricingPrivate::getGBTransfer(int productIndex)
+MegaHTTPConnection::~MegaHTTPConnection()
 {
-    if((unsigned)productIndex < gbTransfer.size())
-        return gbTransfer[productIndex];
-
-    return 0;
+    closesocket_(fd);
+    delete paused;
 }
 
-int MegaPricingPrivate::getMonths(int productIndex)
+void MegaHTTPConnection::start()
 {
-    if((unsigned)productIndex < months.size())
-        return months[productIndex];
-
-    return 0;
+    thread.start(threadEntryPoint, this);
 }
 
-int MegaPricingPrivate::getAmount(int productIndex)
+void MegaHTTPConnection::close()
 {
-    if((unsigned)productIndex < amount.size())
-        return amount[productIndex];
+    int tag;
 
-    return 0;
-}
+    closing = true;
+    shutdown(fd, SHUT_RDWR);
 
-const char *MegaPricingPrivate::getCurrency(int productIndex)
-{
-    if((unsigned)productIndex < currency.size())
-        return currency[productIndex];
+    mutex.lock();
+    cancelled = true;
+    tag = transfertag;
+    mutex.unlock();
 
-    return NULL;
+    if (tag)
+    {
+        server->api->cancelTransferByTag(tag);
+    }
 }
 
-const char *MegaPricingPrivate::getDescription(int productIndex)
+void *MegaHTTPConnection::threadEntryPoint(void *param)
 {
-    if((unsigned)productIndex < description.size())
-        return description[productIndex];
+    MegaHTTPConnection *connection = (MegaHTTPConnection *)param;
+
+    connection->loop();
+    connection->finished = true;
 
     return NULL;
 }
 
-const char *MegaPricingPrivate::getIosID(int productIndex)
+void MegaHTTPConnection::loop()
 {
-    if((unsigned)productIndex < iosId.size())
-        return iosId[productIndex];
+    string header;
 
-    return NULL;
+    while (!closing && !server->stopping && readrequest(&header) && serve(&header));
 }
 
-const char *MegaPricingPrivate::getAndroidID(int productIndex)
+bool MegaHTTPConnection::receive(int ms)
 {
-    if((unsigned)productIndex < androidId.size())
-        return androidId[productIndex];
+    fd_set rfds;
+    struct timeval tv;
+    char buf[4096];
 
-    return NULL;
-}
+    FD_ZERO(&rfds);
+    FD_SET(fd, &rfds);
 
-MegaPricing *MegaPricingPrivate::copy()
-{
-    MegaPricingPrivate *megaPricing = new MegaPricingPrivate();
-    for(unsigned i=0; i<handles.size(); i++)
+    tv.tv_sec = ms / 1000;
+    tv.tv_usec = (ms % 1000) * 1000;
+
+    int r = select((int)fd + 1, &rfds, NULL, NULL, &tv);
+
+    if (r < 0)
     {
-        megaPricing->addProduct(handles[i], proLevel[i], gbStorage[i], gbTransfer[i],
-                                months[i], amount[i], currency[i], description[i], iosId[i], androidId[i]);
+        return false;
     }
 
-    return megaPricing;
-}
-
-void MegaPricingPrivate::addProduct(handle product, int proLevel, int gbStorage, int gbTransfer, int months, int amount, const char *currency,
-                                    const char* description, const char* iosid, const char* androidid)
-{
-    this->handles.push_back(product);
-    this->proLevel.push_back(proLevel);
-    this->gbStorage.push_back(gbStorage);
-    this->gbTransfer.push_back(gbTransfer);
-    this->months.push_back(months);
-    this->amount.push_back(amount);
-    this->currency.push_back(MegaApi::strdup(currency));
-    this->description.push_back(MegaApi::strdup(description));
-    this->iosId.push_back(MegaApi::strdup(iosid));
-    this->androidId.push_back(MegaApi::strdup(androidid));
-}
+    if (!r)
+    {
+        return true;
+    }
 
-#ifdef ENABLE_SYNC
-MegaSyncPrivate::MegaSyncPrivate(Sync *sync)
-{
-    this->tag = sync->tag;
-    sync->client->fsaccess->local2path(&sync->localroot.localname, &localFolder);
-    this->megaHandle = sync->localroot.node->nodehandle;
-    this->fingerprint = sync->fsfp;
-    this->state = sync->state;
-    this->listener = NULL;
-}
+    int n = (int)recv(fd, buf, sizeof buf, 0);
 
-MegaSyncPrivate::MegaSyncPrivate(MegaSyncPrivate *sync)
-{
-    this->setTag(sync->getTag());
-    this->setLocalFolder(sync->getLocalFolder());
-    this->setMegaHandle(sync->getMegaHandle());
-    this->setLocalFingerprint(sync->getLocalFingerprint());
-    this->setState(sync->getState());
-    this->setListener(sync->getListener());
-}
+    // (pipelined requests are bounded like any request header)
+    if (n <= 0 || input.size() + n > 16384)
+    {
+        return false;
+    }
 
-MegaSyncPrivate::~MegaSyncPrivate()
-{
+    input.append(buf, n);
+    return true;
 }
 
-MegaSync *MegaSyncPrivate::copy()
+bool MegaHTTPConnection::readrequest(string *header)
 {
-    return new MegaSyncPrivate(this);
-}
+    int idle = 0;
 
-MegaHandle MegaSyncPrivate::getMegaHandle() const
-{
-    return megaHandle;
-}
+    for (;;)
+    {
+        size_t p = input.find("\r\n\r\n");
 
-void MegaSyncPrivate::setMegaHandle(MegaHandle handle)
-{
-    this->megaHandle = handle;
-}
+        if (p != string::npos)
+        {
+            header->assign(input, 0, p + 2);
+            input.erase(0, p + 4);
+            return true;
+        }
 
-const char *MegaSyncPrivate::getLocalFolder() const
-{
-    if(!localFolder.size())
-        return NULL;
+        if (closing || server->stopping || idle >= MegaHTTPServer::IDLETIMEOUT * 5)
+        {
+            return false;
+        }
 
-    return localFolder.c_str();
-}
+        size_t size = input.size();
 
-void MegaSyncPrivate::setLocalFolder(const char *path)
-{
-    this->localFolder = path;
-}
+        if (!receive(200))
+        {
+            return false;
+        }
 
-long long MegaSyncPrivate::getLocalFingerprint() const
-{
-    return fingerprint;
+        idle = input.size() == size ? idle + 1 : 0;
+    }
 }
 
-void MegaSyncPrivate::setLocalFingerprint(long long fingerprint)
+bool MegaHTTPConnection::sendall(const char *buf, size_t len)
 {
-    this->fingerprint = fingerprint;
-}
+    while (len)
+    {
+        int n = (int)send(fd, buf, (int)(len > 65536 ? 65536 : len), MSG_NOSIGNAL);
 
-int MegaSyncPrivate::getTag() const
-{
-    return tag;
-}
+        if (n <= 0 || closing)
+        {
+            return false;
+        }
 
-void MegaSyncPrivate::setTag(int tag)
-{
-    this->tag = tag;
-}
+        buf += n;
+        len -= n;
+    }
 
-void MegaSyncPrivate::setListener(MegaSyncListener *listener)
-{
-    this->listener = listener;
+    return true;
 }
 
-MegaSyncListener *MegaSyncPrivate::getListener()
+bool MegaHTTPConnection::respond(int status, const char *reason, const string *headers, bool keepalive)
 {
-    return this->listener;
-}
+    char buf[128];
+    string response;
 
-int MegaSyncPrivate::getState() const
-{
-    return state;
-}
+    snprintf(buf, sizeof buf, "HTTP/1.1 %d %s\r\n", status, reason);
+    response = buf;
 
-void MegaSyncPrivate::setState(int state)
-{
-    this->state = state;
-}
+    if (headers)
+    {
+        response.append(*headers);
+    }
+    else
+    {
+        response.append("Content-Length: 0\r\n");
+    }
 
-MegaSyncEventPrivate::MegaSyncEventPrivate(int type)
-{
-    this->type = type;
-    path = NULL;
-    newPath = NULL;
-    prevName = NULL;
-    nodeHandle = INVALID_HANDLE;
-    prevParent = INVALID_HANDLE;
-}
+    response.append(keepalive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n");
 
-MegaSyncEventPrivate::~MegaSyncEventPrivate()
-{
-    delete path;
+    return sendall(response.data(), response.size());
 }
 
-MegaSyncEvent *MegaSyncEventPrivate::copy()
+bool MegaHTTPConnection::serve(const string *header)
 {
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(type);
-    event->setPath(this->path);
-    event->setNodeHandle(this->nodeHandle);
-    event->setNewPath(this->newPath);
-    event->setPrevName(this->prevName);
-    event->setPrevParent(this->prevParent);
-    return event;
-}
+    size_t e = header->find("\r\n");
+    string line = header->substr(0, e);
+    size_t s1 = line.find(' ');
+    size_t s2 = line.rfind(' ');
 
-int MegaSyncEventPrivate::getType() const
-{
-    return type;
-}
+    if (s1 == string::npos || s2 == s1)
+    {
+        respond(400, "Bad Request", NULL, false);
+        return false;
+    }
 
-const char *MegaSyncEventPrivate::getPath() const
-{
-    return path;
-}
+    string method = line.substr(0, s1);
+    string target = line.substr(s1 + 1, s2 - s1 - 1);
+    string connection = httpheader(header, "Connection");
 
-MegaHandle MegaSyncEventPrivate::getNodeHandle() const
-{
-    return nodeHandle;
-}
+    for (size_t i = 0; i < connection.size(); i++)
+    {
+        connection[i] = (char)tolower((unsigned char)connection[i]);
+    }
 
-const char *MegaSyncEventPrivate::getNewPath() const
-{
-    return newPath;
-}
+    bool keepalive = line.compare(s2 + 1, string::npos, "HTTP/1.0")
+                   ? connection.find("close") == string::npos
+                   : connection.find("keep-alive") != string::npos;
 
-const char *MegaSyncEventPrivate::getPrevName() const
-{
-    return prevName;
-}
+    bool head = method == "HEAD";
 
-MegaHandle MegaSyncEventPrivate::getPrevParent() const
-{
-    return prevParent;
-}
+    if (!head && method != "GET")
+    {
+        return respond(405, "Method Not Allowed", NULL, keepalive) && keepalive;
+    }
 
-void MegaSyncEventPrivate::setPath(const char *path)
-{
-    if(this->path)
+    if (server->peer)
     {
-        delete [] this->path;
+        return head ? respond(405, "Method Not Allowed", NULL, keepalive) && keepalive : servechunk(&target, keepalive);
     }
-    this->path =  MegaApi::strdup(path);
-}
 
-void MegaSyncEventPrivate::setNodeHandle(MegaHandle nodeHandle)
-{
-    this->nodeHandle = nodeHandle;
-}
+    // /<base64 handle>[/<name>]
+    size_t he = target.find('/', 1);
+    string base64handle = target.substr(1, he == string::npos ? string::npos : he - 1);
+    MegaNode *node = NULL;
 
-void MegaSyncEventPrivate::setNewPath(const char *newPath)
-{
-    if(this->newPath)
+    if (target.size() > 1 && target[0] == '/' && base64handle.size() == 8)
     {
-        delete [] this->newPath;
+        node = server->api->getNodeByHandle(MegaApi::base64ToHandle(base64handle.c_str()));
     }
-    this->newPath =  MegaApi::strdup(newPath);
-}
 
-void MegaSyncEventPrivate::setPrevName(const char *prevName)
-{
-    if(this->prevName)
+    if (!node || !node->isFile())
     {
-        delete [] this->prevName;
+        delete node;
+        return respond(404, "Not Found", NULL, keepalive) && keepalive;
     }
-    this->prevName =  MegaApi::strdup(prevName);
-}
 
-void MegaSyncEventPrivate::setPrevParent(MegaHandle prevParent)
-{
-    this->prevParent = prevParent;
-}
+    m_off_t size = node->getSize();
+    m_off_t start = 0;
+    m_off_t end = size - 1;
+    string range = httpheader(header, "Range");
+    bool partial = false;
+    char buf[128];
 
-#endif
+    // first range of a "bytes=" specification (multiple ranges are not
+    // supported) - a malformed one is ignored and the whole file is sent
+    if (!range.compare(0, 6, "bytes="))
+    {
+        const char *p = range.c_str() + 6;
+        char *q = NULL;
 
+        if (*p == '-')
+        {
+            if (p[1] >= '0' && p[1] <= '9')
+            {
+                m_off_t suffix = strtoll(p + 1, &q, 10);
 
-MegaAccountBalance *MegaAccountBalancePrivate::fromAccountBalance(const AccountBalance *balance)
-{
-    return new MegaAccountBalancePrivate(balance);
-}
+                start = suffix < size ? size - suffix : 0;
+                partial = q != p + 1;
+            }
+        }
+        else if (*p >= '0' && *p <= '9')
+        {
+            start = strtoll(p, &q, 10);
 
-MegaAccountBalancePrivate::~MegaAccountBalancePrivate()
-{
+            if (q != p && *q == '-')
+            {
+                partial = true;
 
-}
+                if (q[1] >= '0' && q[1] <= '9')
+                {
+                    m_off_t last = strtoll(q + 1, NULL, 10);
 
-MegaAccountBalance *MegaAccountBalancePrivate::copy()
-{
-    return new MegaAccountBalancePrivate(&balance);
-}
+                    if (last < end)
+                    {
+                        end = last;
+                    }
+                }
+            }
+        }
 
-double MegaAccountBalancePrivate::getAmount() const
-{
-    return balance.amount;
-}
+        if (!partial)
+        {
+            start = 0;
+        }
+    }
 
-char *MegaAccountBalancePrivate::getCurrency() const
-{
-    return MegaApi::strdup(balance.currency);
-}
+    if (partial)
+    {
+        if (start >= size || start > end)
+        {
+            snprintf(buf, sizeof buf, "Content-Range: bytes */%" PRId64 "\r\nContent-Length: 0\r\n", size);
+            string headers = buf;
 
-MegaAccountBalancePrivate::MegaAccountBalancePrivate(const AccountBalance *balance)
-{
-    this->balance = *balance;
-}
+            delete node;
+            return respond(416, "Range Not Satisfiable", &headers, keepalive) && keepalive;
+        }
+    }
 
-MegaAccountSession *MegaAccountSessionPrivate::fromAccountSession(const AccountSession *session)
-{
-    return new MegaAccountSessionPrivate(session);
-}
+    string headers = "Accept-Ranges: bytes\r\nContent-Type: ";
+    headers.append(httpcontenttype(node->getName()));
 
-MegaAccountSessionPrivate::~MegaAccountSessionPrivate()
-{
+    snprintf(buf, sizeof buf, "\r\nContent-Length: %" PRId64 "\r\n", size ? end - start + 1 : 0);
+    headers.append(buf);
 
-}
+    if (partial)
+    {
+        snprintf(buf, sizeof buf, "Content-Range: bytes %" PRId64 "-%" PRId64 "/%" PRId64 "\r\n", start, end, size);
+        headers.append(buf);
+    }
 
-MegaAccountSession *MegaAccountSessionPrivate::copy()
-{
-    return new MegaAccountSessionPrivate(&session);
-}
+    bool r = respond(partial ? 206 : 200, partial ? "Partial Content" : "OK", &headers, keepalive)
+          && (head || !size || stream(node, start, end));
 
-int64_t MegaAccountSessionPrivate::getCreationTimestamp() const
-{
-    return session.timestamp;
-}
+    delete node;
 
-int64_t MegaAccountSessionPrivate::getMostRecentUsage() const
-{
-    return session.mru;
+    return r && keepalive;
 }
 
-char *MegaAccountSessionPrivate::getUserAgent() const
+bool MegaHTTPConnection::servechunk(const string *target, bool keepalive)
 {
-    return MegaApi::strdup(session.useragent.c_str());
-}
+    char base64handle[12];
+    long long start, end;
+    char c;
 
-char *MegaAccountSessionPrivate::getIP() const
-{
-    return MegaApi::strdup(session.ip.c_str());
-}
+    if (sscanf(target->c_str(), "/%11[^/]/%lld-%lld%c", base64handle, &start, &end, &c) != 3
+            || strlen(base64handle) != 8 || start < 0 || end < start
+            || end - start >= MegaHTTPServer::MAXPEERCHUNK || start % SymmCipher::BLOCKSIZE)
+    {
+        return respond(400, "Bad Request", NULL, keepalive) && keepalive;
+    }
 
-char *MegaAccountSessionPrivate::getCountry() const
-{
-    return MegaApi::strdup(session.country);
-}
+    string nodekey;
+    FileAccess *fa = server->api->openPeerSource(MegaApi::base64ToHandle(base64handle), &nodekey);
 
-bool MegaAccountSessionPrivate::isCurrent() const
-{
-    return session.current;
-}
+    if (!fa)
+    {
+        return respond(404, "Not Found", NULL, keepalive) && keepalive;
+    }
 
-bool MegaAccountSessionPrivate::isAlive() const
-{
-    return session.alive;
-}
+    if (end >= fa->size)
+    {
+        delete fa;
+        return respond(416, "Range Not Satisfiable", NULL, keepalive) && keepalive;
+    }
 
-MegaHandle MegaAccountSessionPrivate::getHandle() const
-{
-    return session.id;
-}
+    // re-encrypt the local copy: the ciphertext served by the storage
+    // servers (the CTR keystream only depends on the key and the position)
+    unsigned len = (unsigned)(end - start + 1);
+    byte *buf = new byte[(len + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE];
+    bool ok = fa->frawread(buf, len, start);
 
-MegaAccountSessionPrivate::MegaAccountSessionPrivate(const AccountSession *session)
-{
-    this->session = *session;
-}
+    delete fa;
 
+    if (!ok)
+    {
+        delete[] buf;
+        return respond(404, "Not Found", NULL, keepalive) && keepalive;
+    }
 
-MegaAccountPurchase *MegaAccountPurchasePrivate::fromAccountPurchase(const AccountPurchase *purchase)
-{
-    return new MegaAccountPurchasePrivate(purchase);
-}
+    SymmCipher key;
 
-MegaAccountPurchasePrivate::~MegaAccountPurchasePrivate()
-{
+    key.setkey((const byte *)nodekey.data(), FILENODE);
+    key.ctr_crypt(buf, len, start, MemAccess::get<int64_t>(nodekey.data() + SymmCipher::KEYLENGTH), NULL, true);
 
-}
+    char header[96];
 
-MegaAccountPurchase *MegaAccountPurchasePrivate::copy()
-{
-    return new MegaAccountPurchasePrivate(&purchase);
-}
+    snprintf(header, sizeof header, "Content-Type: application/octet-stream\r\nContent-Length: %u\r\n", len);
+    string headers = header;
 
-int64_t MegaAccountPurchasePrivate::getTimestamp() const
-{
-    return purchase.timestamp;
-}
+    ok = respond(200, "OK", &headers, keepalive) && sendall((const char *)buf, len);
 
-char *MegaAccountPurchasePrivate::getHandle() const
-{
-    return MegaApi::strdup(purchase.handle);
-}
+    delete[] buf;
 
-char *MegaAccountPurchasePrivate::getCurrency() const
-{
-    return MegaApi::strdup(purchase.currency);
+    return ok && keepalive;
 }
 
-double MegaAccountPurchasePrivate::getAmount() const
+bool MegaHTTPConnection::stream(MegaNode *node, m_off_t start, m_off_t end)
 {
-    return purchase.amount;
-}
+    for (m_off_t pos = start; pos <= end; )
+    {
+        m_off_t len = end - pos + 1;
+        m_off_t sent = 0;
 
-int MegaAccountPurchasePrivate::getMethod() const
-{
-    return purchase.method;
-}
+        if (len > MegaHTTPServer::WINDOWSIZE)
+        {
+            len = MegaHTTPServer::WINDOWSIZE;
+        }
 
-MegaAccountPurchasePrivate::MegaAccountPurchasePrivate(const AccountPurchase *purchase)
-{
-    this->purchase = *purchase;
-}
+        mutex.lock();
+        data.clear();
+        windowactive = true;
+        windowfailed = false;
+        cancelled = closing;
+        mutex.unlock();
 
+        server->api->startStreaming(node, pos, len, this);
 
-MegaAccountTransaction *MegaAccountTransactionPrivate::fromAccountTransaction(const AccountTransaction *transaction)
-{
-    return new MegaAccountTransactionPrivate(transaction);
-}
+        for (;;)
+        {
+            string chunk;
+            MegaTransfer *resume;
+            bool active, failed;
+
+            mutex.lock();
+            chunk.swap(data);
+            active = windowactive;
+            failed = windowfailed;
+            resume = paused;
+            paused = NULL;
+            mutex.unlock();
+
+            // the data is out of the buffer again
+            if (resume)
+            {
+                server->api->pauseStreaming(resume, false);
+                delete resume;
+            }
 
-MegaAccountTransactionPrivate::~MegaAccountTransactionPrivate()
-{
+            if (chunk.size())
+            {
+                if (!sendall(chunk.data(), chunk.size()))
+                {
+                    abortwindow();
+                    return false;
+                }
 
-}
+                sent += chunk.size();
+                continue;
+            }
 
-MegaAccountTransaction *MegaAccountTransactionPrivate::copy()
-{
-    return new MegaAccountTransactionPrivate(&transaction);
-}
+            if (!active)
+            {
+                if (failed || sent != len)
+                {
+                    LOG_warn << "HTTP server: streaming of " << node->getName() << " failed at " << pos + sent;
+                    return false;
+                }
 
-int64_t MegaAccountTransactionPrivate::getTimestamp() const
-{
-    return transaction.timestamp;
-}
+                break;
+            }
 
-char *MegaAccountTransactionPrivate::getHandle() const
-{
-    return MegaApi::strdup(transaction.handle);
-}
+            // a dropped connection (a seeking player) cancels the read at once
+            if (closing || server->stopping || !receive(20))
+            {
+                abortwindow();
+                return false;
+            }
+        }
 
-char *MegaAccountTransactionPrivate::getCurrency() const
-{
-    return MegaApi::strdup(transaction.currency);
-}
+        pos += len;
+    }
 
-double MegaAccountTransactionPrivate::getAmount() const
-{
-    return transaction.delta;
+    return true;
 }
 
-MegaAccountTransactionPrivate::MegaAccountTransactionPrivate(const AccountTransaction *transaction)
+void MegaHTTPConnection::abortwindow()
 {
-    this->transaction = *transaction;
-}
+    MegaTransfer *resume;
+    int tag;
+    bool active;
 
+    mutex.lock();
+    cancelled = true;
+    tag = transfertag;
+    resume = paused;
+    paused = NULL;
+    mutex.unlock();
 
+    if (resume)
+    {
+        server->api->pauseStreaming(resume, false);
+        delete resume;
+    }
 
-ExternalInputStream::ExternalInputStream(MegaInputStream *inputStream)
-{
-    this->inputStream = inputStream;
-}
+    if (tag)
+    {
+        server->api->cancelTransferByTag(tag);
+    }
 
-m_off_t ExternalInputStream::size()
-{
-    return inputStream->getSize();
+    // the listener must outlive the transfer
+    do
+    {
+        mutex.lock();
+        active = windowactive;
+        data.clear();
+        mutex.unlock();
+
+        if (active)
+        {
+            httpsleep(20);
+        }
+    } while (active);
 }
 
-bool ExternalInputStream::read(byte *buffer, unsigned size)
+void MegaHTTPConnection::onTransferStart(MegaApi *api, MegaTransfer *transfer)
 {
-    return inputStream->read((char *)buffer, size);
-}
+    bool cancel;
 
+    mutex.lock();
+    transfertag = transfer->getTag();
+    cancel = cancelled;
+    mutex.unlock();
 
-FileInputStream::FileInputStream(FileAccess *fileAccess)
-{
-    this->fileAccess = fileAccess;
-    this->offset = 0;
+    if (cancel)
+    {
+        api->cancelTransfer(transfer);
+    }
 }
 
-m_off_t FileInputStream::size()
+bool MegaHTTPConnection::onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size)
 {
-    return fileAccess->size;
-}
+    bool pause = false;
 
-bool FileInputStream::read(byte *buffer, unsigned size)
-{
-    if (!buffer)
-    {
-        if ((offset + size) <= fileAccess->size)
-        {
-            offset += size;
-            return true;
-        }
+    mutex.lock();
 
-        LOG_warn << "Invalid seek on FileInputStream";
+    if (cancelled)
+    {
+        mutex.unlock();
         return false;
     }
 
-    if (fileAccess->sysread(buffer, size, offset))
+    data.append(buffer, size);
+
+    // resumed by the connection's thread once it has taken the data
+    if (data.size() >= MegaHTTPServer::MAXBUFFERED && !paused)
     {
-        offset += size;
-        return true;
+        paused = transfer->copy();
+        pause = true;
     }
 
-    LOG_warn << "Invalid read on FileInputStream";
-    return false;
+    mutex.unlock();
+
+    if (pause)
+    {
+        api->pauseStreaming(transfer, true);
+    }
+
+    return true;
 }
 
-FileInputStream::~FileInputStream()
+void MegaHTTPConnection::onTransferFinish(MegaApi *, MegaTransfer *, MegaError *e)
 {
-
+    mutex.lock();
+    windowactive = false;
+    windowfailed = e->getErrorCode() != MegaError::API_OK;
+    transfertag = 0;
+    delete paused;
+    paused = NULL;
+    mutex.unlock();
 }
+#endif
@@ -54,43 +54,32 @@ const char MegaClient::PAYMENT_PUBKEY[] =
         "TpPvuz-oZABEBAAE";
 
 // decrypt key (symmetric or asymmetric), rewrite asymmetric to symmetric key
-bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, int type, handle node)
+// length of a base64-encoded key terminated by '"', '/' or NUL
+int MegaClient::encodedkeylength(const char* k)
 {
-    int sl;
-    const char* ptr = sk;
+    const char* ptr = k;
 
-    // measure key length
     while (*ptr && *ptr != '"' && *ptr != '/')
     {
         ptr++;
     }
 
-    sl = ptr - sk;
+    return ptr - k;
+}
+
+bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, int type, handle node)
+{
+    int sl;
 
-    if (sl > 4 * FILENODEKEYLENGTH / 3 + 1)
+    if ((sl = encodedkeylength(sk)) > 4 * FILENODEKEYLENGTH / 3 + 1)
     {
         // RSA-encrypted key - decrypt and update on the server to save space & client CPU time
-        sl = sl / 4 * 3 + 3;
-
-        if (sl > 4096)
+        if (!rsadecryptkey(&asymkey, sk, tk, tl))
         {
-            return false;
-        }
-
-        byte* buf = new byte[sl];
-
-        sl = Base64::atob(sk, buf, sl);
-
-        // decrypt and set session ID for subsequent API communication
-        if (!asymkey.decrypt(buf, sl, tk, tl))
-        {
-            delete[] buf;
             LOG_warn << "Corrupt or invalid RSA node key";
             return false;
         }
 
-        delete[] buf;
-
         if (!ISUNDEF(node))
         {
             if (type)
@@ -117,11 +106,113 @@ bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, in
     return true;
 }
 
+bool MegaClient::rsadecryptkey(AsymmCipher* asymkey, const char* sk, byte* tk, int tl)
+{
+    int sl = encodedkeylength(sk) / 4 * 3 + 3;
+
+    if (sl > 4096)
+    {
+        return false;
+    }
+
+    byte buf[4096];
+
+    sl = Base64::atob(sk, buf, sl);
+
+    return asymkey->decrypt(buf, sl, tk, tl) != 0;
+}
+
+void MegaClient::runrsakeyjobs(vector<RsaKeyJob*>* jobs)
+{
+    if (!workerpool)
+    {
+        for (unsigned i = 0; i < jobs->size(); i++)
+        {
+            (*jobs)[i]->run();
+        }
+
+        return;
+    }
+
+    for (unsigned i = 0; i + 1 < jobs->size(); i++)
+    {
+        workerpool->push((*jobs)[i]);
+    }
+
+    jobs->back()->run();
+
+    for (unsigned i = 0; i + 1 < jobs->size(); i++)
+    {
+        workerpool->waitfor((*jobs)[i]);
+
+        if (!(*jobs)[i]->finished)
+        {
+            (*jobs)[i]->run();
+        }
+    }
+}
+
+void MegaClient::decryptsharekeys()
+{
+    vector<RsaKeyJob*> jobs;
+    RsaKeyJob* job = NULL;
+
+    for (newshare_list::iterator it = newshares.begin(); it != newshares.end(); it++)
+    {
+        if ((*it)->rsakey.size())
+        {
+            if (!job || job->items.size() >= RsaKeyJob::BATCHSIZE)
+            {
+                jobs.push_back(job = new RsaKeyJob(&asymkey));
+            }
+
+            job->add(NULL, *it, (*it)->rsakey.c_str(), sizeof (*it)->key);
+        }
+    }
+
+    if (!jobs.size())
+    {
+        return;
+    }
+
+    runrsakeyjobs(&jobs);
+
+    for (unsigned i = 0; i < jobs.size(); i++)
+    {
+        for (unsigned j = 0; j < jobs[i]->items.size(); j++)
+        {
+            RsaKeyJob::Item* item = &jobs[i]->items[j];
+            NewShare* s = item->share;
+
+            if (item->ok)
+            {
+                memcpy(s->key, item->key, sizeof s->key);
+                s->have_key = true;
+
+                // rewrite on the server to save the next login the RSA operation
+                sharekeyrewrite.push_back(s->h);
+            }
+            else
+            {
+                LOG_warn << "Corrupt or invalid RSA share key";
+            }
+
+            s->rsakey.clear();
+        }
+
+        delete jobs[i];
+    }
+
+    LOG_debug << "Decrypted RSA share keys in " << jobs.size() << " batches";
+}
+
 // apply queued new shares
 void MegaClient::mergenewshares(bool notify)
 {
     newshare_list::iterator it;
 
+    decryptsharekeys();
+
     for (it = newshares.begin(); it != newshares.end(); )
     {
         NewShare* s = *it;
@@ -469,22 +560,34 @@ bool MegaClient::warnlevel()
     return warned ? (warned = false) | true : false;
 }
 
-// returns the first matching child node by UTF-8 name (does not resolve name clashes)
-Node* MegaClient::childnodebyname(Node* p, const char* name)
+// returns a matching child node by UTF-8 name (does not resolve name clashes)
+// - large folders get a name index on first lookup (unless index is false:
+// lookups that must not modify the tree)
+Node* MegaClient::childnodebyname(Node* p, const char* name, bool index)
 {
     string nname = name;
 
     fsaccess->normalize(&nname);
 
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    if (!p->childnames)
     {
-        if (!strcmp(nname.c_str(), (*it)->displayname()))
+        if (!index || p->children.size() < NodeNameIndex::MINCHILDREN)
         {
-            return *it;
+            for (node_vector::iterator it = p->children.begin(); it != p->children.end(); it++)
+            {
+                if (!strcmp(nname.c_str(), (*it)->displayname()))
+                {
+                    return *it;
+                }
+            }
+
+            return NULL;
         }
+
+        p->indexchildnames();
     }
 
-    return NULL;
+    return p->childnames->find(nname.c_str());
 }
 
 void MegaClient::init()
@@ -492,6 +595,9 @@ void MegaClient::init()
     warned = false;
     csretrying = false;
     fetchingnodes = false;
+    partialfetching = false;
+    childfetches.clear();
+    fnstream = FNSTREAM_OFF;
     chunkfailed = false;
 
 #ifdef ENABLE_SYNC
@@ -528,17 +634,44 @@ void MegaClient::init()
 
     jsonsc.pos = NULL;
     insca = false;
+    scsliced = false;
+    csresume = false;
     scnotifyurl.clear();
     *scsn = 0;
 }
 
 MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, DbAccess* d, GfxProc* g, const char* k, const char* u)
+    : nodeslab(sizeof(Node))
+#ifdef ENABLE_SYNC
+    , localnodeslab(sizeof(LocalNode))
+#endif
 {
     sctable = NULL;
+    scpending = NULL;
+    scwriting = NULL;
+    scpendingsince = 0;
+    scdelta = 0;
+    sctableindex = false;
+    journalseq = 0;
+    journalwritten = 0;
+    tctable = NULL;
+    tlstable = NULL;
+    persisttls = false;
+    persistqueue = false;
+    purgingnodes = false;
+
+    lazyattrs = false;
+    pendingattrnodes = 0;
+    nexttlssave = 0;
     me = UNDEF;
     followsymlinks = false;
     usealtdownport = false;
+    lastprefetch[GET] = lastprefetch[PUT] = 0;
     usealtupport = false;
+    dlpreallocate = false;
+    dldirectio = false;
+    drcachelimit = DirectReadCache::DEFAULTLIMIT;
+    drreadahead = DirectReadCache::DEFAULTREADAHEAD;
     autodownport = true;
     autoupport = true;
 
@@ -546,15 +679,40 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
     syncscanstate = false;
     syncdownrequired = false;
     syncadding = 0;
+    syncpassend = NEVER;
+    syncpassvisits = 0;
+    syncpasscut = false;
+    syncstatsds = 0;
+    syncsactive = 0;
+    fsfpcheckds = 0;
     currsyncid = 0;
+    syncscanahead = 16;
+    localpathgen = 1;
+    movebatch = NULL;
+    syncverifyinterval = 0;
+    syncskipunchanged = false;
 #endif
 
     pendingcs = NULL;
     pendingsc = NULL;
+    pipelinedcs = NULL;
+
+    csbatchstart = NEVER;
+    lastcssent = 0;
+    lastcsbatch = 0;
+
+    scburst = false;
+    scwaitseen = false;
+    scburststart = 0;
+
+    appwakeupds = NEVER;
+
+    enginestatsds = 0;
+    enginestatslastds = 0;
 
-    curfa = newfa.end();
     xferpaused[PUT] = false;
     xferpaused[GET] = false;
+    httpstatechange = true;
     putmbpscap = 0;
 
     init();
@@ -578,11 +736,28 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
 
     slotit = tslots.end();
 
+    smalluploads = 0;
+
+    scheduler.client = this;
+
+    workerpool = NULL;
+    gfxpool = NULL;
+
+    partialfetch = false;
+
     userid = 0;
 
     connections[PUT] = 3;
     connections[GET] = 4;
 
+    minconnections[PUT] = 1;
+    minconnections[GET] = 1;
+    maxconnections[PUT] = 6;
+    maxconnections[GET] = 8;
+
+    maxrequestsize[PUT] = 0;
+    maxrequestsize[GET] = 0;
+
     int i;
 
     // initialize random client application instance ID (for detecting own
@@ -598,6 +773,11 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
         reqid[i] = 'a' + PrnGen::genuint32(26);
     }
 
+    for (i = sizeof pipelinereqid; i--; )
+    {
+        pipelinereqid[i] = 'a' + PrnGen::genuint32(26);
+    }
+
     r = 0;
     nextuh = 0;  
     reqtag = 0;
@@ -625,6 +805,25 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
 
 MegaClient::~MegaClient()
 {
+    // keep the partial downloads and their state for the next session
+    if (tctable)
+    {
+        flushqueuedfiles();
+
+        for (transfer_map::iterator it = transfers[GET].begin(); it != transfers[GET].end(); it++)
+        {
+            if (it->second->macpos && it->second->localfilename.size())
+            {
+                cachetransfer(it->second);
+            }
+        }
+
+        delete tctable;
+        tctable = NULL;
+    }
+
+    savetlssessions();
+
     locallogout();
 
     delete pendingcs;
@@ -633,6 +832,11 @@ MegaClient::~MegaClient()
     delete loadbalancingcs;
     delete sctable;
     delete dbaccess;
+
+    for (unsigned i = 0; i < drbuffers.size(); i++)
+    {
+        delete drbuffers[i];
+    }
 }
 
 // nonblocking state machine executing all operations currently in progress
@@ -640,6 +844,8 @@ void MegaClient::exec()
 {
     WAIT_CLASS::bumpds();
 
+    int64_t execstart = Waiter::us();
+
     if (httpio->inetisback())
     {
         LOG_info << "Internet connectivity returned - resetting all backoff timers";
@@ -664,15 +870,20 @@ void MegaClient::exec()
                 (*it)->errorcount++;
                 (*it)->failure = false;
                 (*it)->lastdata = Waiter::ds;
+
+                // resume after an exponential, jittered pause rather than
+                // all at once
+                (*it)->retrying = true;
+                (*it)->retrybt.backoff(1 << (*it)->errorcount, 1 << (*it)->errorcount);
             }
         }
     }
 
     do {
-        // file attribute puts (handled sequentially as a FIFO)
-        if (curfa != newfa.end())
+        // file attribute puts (up to MAXPUTFA concurrently)
+        for (putfa_list::iterator fait = activefa.begin(); fait != activefa.end(); )
         {
-            HttpReqCommandPutFA* fa = *curfa;
+            HttpReqCommandPutFA* fa = *fait;
 
             switch (fa->status)
             {
@@ -711,30 +922,32 @@ void MegaClient::exec()
                         }
 
                         delete fa;
-                        newfa.erase(curfa);
+                    }
+                    else
+                    {
+                        // unexpected response: retry
+                        newfa.push_front(fa);
                     }
 
                     btpfa.reset();
-                    curfa = newfa.end();
+                    activefa.erase(fait++);
                     break;
 
                 case REQ_FAILURE:
                     // repeat request with exponential backoff
-                    curfa = newfa.end();
                     btpfa.backoff();
+                    newfa.push_front(fa);
+                    activefa.erase(fait++);
+                    break;
 
                 default:
-                    ;
+                    fait++;
             }
         }
 
-        if (newfa.size() && curfa == newfa.end() && btpfa.armed())
+        if (btpfa.armed())
         {
-            // dispatch most recent file attribute put
-            curfa = newfa.begin();
-
-            (*curfa)->status = REQ_INFLIGHT;
-            reqs[r].add(*curfa);
+            dispatchputfa();
         }
 
         if (fafcs.size())
@@ -761,17 +974,20 @@ void MegaClient::exec()
                         break;
 
                     case REQ_INFLIGHT:
+                        // (received by the network thread)
+                        httpio->lock();
+
                         if (fc->inbytes != fc->req.in.size())
                         {
-                            httpio->lock();
                             fc->parse(this, cit->first, false);
-                            httpio->unlock();
 
                             fc->timeout.backoff(100);
 
                             fc->inbytes = fc->req.in.size();
                         }
 
+                        httpio->unlock();
+
                         if (!fc->timeout.armed()) break;
 
                         // timeout! fall through...
@@ -815,44 +1031,86 @@ void MegaClient::exec()
                         break;
 
                     case REQ_INFLIGHT:
-                        if (pendingcs->contentlength > 0)
+                    {
+                        // (received by the network thread)
+                        httpio->lock();
+                        m_off_t received = pendingcs->bufpos;
+                        m_off_t total = pendingcs->contentlength;
+                        httpio->unlock();
+
+                        if (total > 0)
+                        {
+                            app->request_response_progress(received, total);
+                        }
+
+                        if (fnstream == FNSTREAM_PREFIX || fnstream == FNSTREAM_NODES)
                         {
-                            app->request_response_progress(pendingcs->bufpos, pendingcs->contentlength);
+                            streamfetchnodes();
                         }
                         break;
+                    }
 
                     case REQ_SUCCESS:
-                        app->request_response_progress(pendingcs->bufpos, -1);
+                        if (!csresume)
+                        {
+                            app->request_response_progress(pendingcs->bufpos, -1);
+                            csresume = true;
+                        }
+
+                        // the remaining node records and the result array
+                        // are processed in slices, the next pass continues
+                        // where this one stopped
+                        if ((fnstream == FNSTREAM_PREFIX || fnstream == FNSTREAM_NODES) && streamfetchnodes())
+                        {
+                            break;
+                        }
+
+                        if (!reqs[r ^ 1].started())
+                        {
+                            if (fnstream == FNSTREAM_NODES || fnstream == FNSTREAM_DONE)
+                            {
+                                // restore a well-formed response around the
+                                // unconsumed remainder
+                                pendingcs->in.replace(0, pendingcs->inpurge, FNSTREAMPREFIX);
+                                pendingcs->inpurge = 0;
+                            }
+                            else
+                            {
+                                fnstream = FNSTREAM_OFF;
+                            }
+                        }
 
                         if (pendingcs->in != "-3" && pendingcs->in != "-4")
                         {
                             if (*pendingcs->in.c_str() == '[')
                             {
-                                if (csretrying)
+                                if (!reqs[r ^ 1].started())
                                 {
-                                    app->notify_retry(0);
-                                    csretrying = false;
+                                    if (csretrying)
+                                    {
+                                        app->notify_retry(0);
+                                        csretrying = false;
+                                    }
+
+                                    enginestats.cslatency.add(Waiter::us() - pendingcs->timeline.posted);
+
+                                    // request succeeded, process result array
+                                    json.begin(pendingcs->in.c_str());
                                 }
 
-                                // request succeeded, process result array
-                                json.begin(pendingcs->in.c_str());
-                                reqs[r ^ 1].procresult(this);
+                                if (!reqs[r ^ 1].procresult(this, Waiter::us() + SLICEUS))
+                                {
+                                    break;
+                                }
+
+                                fnstream = FNSTREAM_OFF;
+                                fnstreamdp.clear();
 
                                 delete pendingcs;
                                 pendingcs = NULL;
 
                                 // increment unique request ID
-                                for (int i = sizeof reqid; i--; )
-                                {
-                                    if (reqid[i]++ < 'z')
-                                    {
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        reqid[i] = 'a';
-                                    }
-                                }
+                                nextreqid(reqid, sizeof reqid);
                             }
                             else
                             {
@@ -893,6 +1151,7 @@ void MegaClient::exec()
                         btcs.backoff();
                         app->notify_retry(btcs.retryin());
                         csretrying = true;
+                        enginestats.csretries++;
 
                     default:
                         ;
@@ -904,19 +1163,43 @@ void MegaClient::exec()
                 }
             }
 
-            if (btcs.armed())
+            // commit the small uploads completed since the last request
+            if (batchedputnodes.size())
+            {
+                execputnodes();
+            }
+
+            if (btcs.armed() && (btcs.nextset() || csbatchready()))
             {
                 if (btcs.nextset())
                 {
                     r ^= 1;
                 }
+                else
+                {
+                    // a retransmission must be identical, so only fresh
+                    // requests are trimmed
+                    reqs[r].limitbulk(&reqs[r ^ 1], MAXBULKPERBATCH);
+                }
 
                 if (reqs[r].cmdspending())
                 {
+#ifdef ENABLE_SYNC
+                    // later moves go to a new batch
+                    movebatch = NULL;
+#endif
+                    csbatchstart = NEVER;
+                    lastcssent = Waiter::ds;
+                    lastcsbatch = reqs[r].cmdspending();
+
                     pendingcs = new HttpReq();
 
                     reqs[r].get(pendingcs->out);
 
+                    fnstream = reqs[r].first()->incremental() ? FNSTREAM_PREFIX : FNSTREAM_OFF;
+                    fnstreamdp.clear();
+                    csresume = false;
+
                     pendingcs->posturl = APIURL;
 
                     pendingcs->posturl.append("cs?id=");
@@ -927,6 +1210,7 @@ void MegaClient::exec()
                     pendingcs->type = REQ_JSON;
 
                     pendingcs->post(this);
+                    enginestats.csbatches++;
 
                     r ^= 1;
                     continue;
@@ -939,6 +1223,8 @@ void MegaClient::exec()
             break;
         }
 
+        execpipelinedcs();
+
         // handle API server-client requests
         if (!jsonsc.pos && pendingsc)
         {
@@ -961,6 +1247,8 @@ void MegaClient::exec()
                     case REQ_SUCCESS:
                         if (*pendingsc->in.c_str() == '{')
                         {
+                            enginestats.scresponses++;
+
 #ifdef ENABLE_SYNC
                             if (syncsup)
 #endif
@@ -1001,6 +1289,7 @@ void MegaClient::exec()
                         pendingsc = NULL;
 
                         btsc.backoff();
+                        enginestats.scretries++;
 
                     default:
                         ;
@@ -1017,6 +1306,8 @@ void MegaClient::exec()
         if (jsonsc.pos)
 #endif
         {
+            scsliced = false;
+
             // FIXME: reload in case of bad JSON
             if (procsc())
             {
@@ -1027,7 +1318,7 @@ void MegaClient::exec()
                 btsc.reset();
             }
 #ifdef ENABLE_SYNC
-            else
+            else if (!scsliced)
             {
                 // a remote node move requires the immediate attention of syncdown()
                 syncdownrequired = true;
@@ -1114,16 +1405,26 @@ void MegaClient::exec()
         dispatchmore(PUT);
         dispatchmore(GET);
 
+        if (tlstable && Waiter::ds >= nexttlssave)
+        {
+            savetlssessions();
+            nexttlssave = Waiter::ds + TLSSAVEINTERVAL;
+        }
+
+        flushqueuedfiles();
+
         slotit = tslots.begin();
 
-        // handle active unpaused transfers
+        // handle active unpaused transfers that have pending I/O or an
+        // expired deadline
         while (slotit != tslots.end())
         {
             transferslot_list::iterator it = slotit;
 
             slotit++;
 
-            if (!xferpaused[(*it)->transfer->type] && (!(*it)->retrying || (*it)->retrybt.armed()))
+            if (!xferpaused[(*it)->transfer->type] && (!(*it)->retrying || (*it)->retrybt.armed())
+                    && (*it)->ready(this))
             {
                 (*it)->doio(this);
             }
@@ -1141,9 +1442,24 @@ void MegaClient::exec()
 
         // verify filesystem fingerprints, disable deviating syncs
         // (this covers mountovers, some device removals and some failures)
+        // - once per FSFPCHECKDS, as it costs a system call per sync
+        bool fsfpcheck = Waiter::ds >= fsfpcheckds + FSFPCHECKDS;
+
+        if (fsfpcheck)
+        {
+            fsfpcheckds = Waiter::ds;
+        }
+
+        syncsactive = 0;
+
         for (it = syncs.begin(); it != syncs.end(); it++)
         {
-            if ((*it)->fsfp)
+            if ((*it)->state == SYNC_ACTIVE || (*it)->state == SYNC_INITIALSCAN)
+            {
+                syncsactive++;
+            }
+
+            if (fsfpcheck && (*it)->fsfp)
             {
                 fsfp_t current = (*it)->dirnotify->fsfingerprint();
                 if ((*it)->fsfp != current)
@@ -1232,6 +1548,9 @@ void MegaClient::exec()
                             }
                             else if (sync->state == SYNC_ACTIVE || sync->state == SYNC_INITIALSCAN)
                             {
+                                // pick up fingerprints computed by the worker pool
+                                sync->procfingerprints();
+
                                 // process items from the notifyq until depleted
                                 if (sync->dirnotify->notifyq[q].size())
                                 {
@@ -1263,7 +1582,9 @@ void MegaClient::exec()
                                         LOG_debug << "Pending MEGA nodes: " << synccreate.size();
                                         if(!syncadding)
                                         {
+                                            startsyncpass();
                                             syncup(&sync->localroot, &nds);
+                                            endsyncpass();
                                             sync->cachenodes();
                                         }
 
@@ -1273,14 +1594,29 @@ void MegaClient::exec()
                                     }
                                 }
 
-                                if (sync->state == SYNC_INITIALSCAN && q == DirNotify::DIREVENTS && !sync->dirnotify->notifyq[q].size())
+                                if (sync->state == SYNC_INITIALSCAN && q == DirNotify::DIREVENTS && !sync->dirnotify->notifyq[q].size()
+                                 && !sync->fingerprintjobs.size() && !sync->dirnotify->replaying)
                                 {
+                                    // (reset by the state change)
+                                    bool fullscan = sync->fullscan;
+
                                     sync->changestate(SYNC_ACTIVE);
 
+                                    syncmemory(true);
+
                                     // scan for items that were deleted while the sync was stopped
+                                    // (replayed changes include the deletions)
                                     // FIXME: defer this until RETRY queue is processed
-                                    sync->scanseqno++;
-                                    sync->deletemissing(&sync->localroot);
+                                    if (fullscan)
+                                    {
+                                        sync->scanseqno++;
+                                        sync->deletemissing(&sync->localroot);
+
+                                        if (!sync->dirnotify->notifyq[DirNotify::RETRY].size())
+                                        {
+                                            sync->commitdirmtimes(&sync->localroot);
+                                        }
+                                    }
                                 }
 
                                 if (!syncfslockretry && sync->dirnotify->notifyq[DirNotify::RETRY].size())
@@ -1295,7 +1631,8 @@ void MegaClient::exec()
                                 }
                             }
 
-                            if (sync->state == SYNC_ACTIVE)
+                            if (sync->state == SYNC_ACTIVE
+                             || (sync->state == SYNC_INITIALSCAN && Waiter::ds >= sync->cachecheckpoint))
                             {
                                 sync->cachenodes();
                             }
@@ -1308,6 +1645,14 @@ void MegaClient::exec()
                     }
                 }
 
+                // round-robin: the next iteration starts with the following sync, so
+                // an interrupted pass over the notifyqs does not starve the later syncs
+                // (splicing keeps the Sync::sync_it iterators valid)
+                if (syncs.size() > 1)
+                {
+                    syncs.splice(syncs.end(), syncs, syncs.begin());
+                }
+
                 if(syncadding)
                 {
                     // do not continue processing syncs while adding nodes
@@ -1356,6 +1701,8 @@ void MegaClient::exec()
 
                 if (syncactivity || syncops)
                 {
+                    startsyncpass();
+
                     for (it = syncs.begin(); it != syncs.end(); it++)
                     {
                         // make sure that the remote synced folder still exists
@@ -1371,6 +1718,9 @@ void MegaClient::exec()
 
                             if ((*it)->state == SYNC_ACTIVE && (!syncscanstate || syncdownrequired))
                             {
+                                WAIT_CLASS::bumpds();
+                                dstime passds = Waiter::ds;
+
                                 if (!syncdown(&(*it)->localroot, &localpath, true))
                                 {
                                     // a local filesystem item was locked - schedule periodic retry
@@ -1380,15 +1730,33 @@ void MegaClient::exec()
                                     (*it)->dirnotify->error = true;
                                 }
 
+                                WAIT_CLASS::bumpds();
+                                (*it)->stats.syncdownds = Waiter::ds - passds;
+
                                 (*it)->cachenodes();                            
                             }
                         }
                     }
 
+                    // an unfinished syncdown() must complete before further
+                    // remote changes are processed (and before syncup())
+                    bool syncdowncut = syncpasscut;
+
+                    endsyncpass();
+
+                    if (syncdowncut)
+                    {
+                        syncdownrequired = true;
+                    }
+
                     // notify the app if a lock is being retried
                     if (success)
                     {
-                        syncdownrequired = false;
+                        if (!syncdowncut)
+                        {
+                            syncdownrequired = false;
+                        }
+
                         if (syncfsopsfailed)
                         {
                             syncfsopsfailed = false;
@@ -1420,6 +1788,12 @@ void MegaClient::exec()
 
                             break;
                         }
+
+                        // (the worker pool wakes us up when they are done)
+                        if ((*it)->fingerprintjobs.size())
+                        {
+                            break;
+                        }
                     }
 
                     if (it == syncs.end())
@@ -1428,7 +1802,7 @@ void MegaClient::exec()
                         // kept pending until all creations (that might reference them for the purpose of
                         // copying) have completed and all notification queues have run empty (to ensure
                         // that moves are not executed as deletions+additions.
-                        if (localsyncnotseen.size() && !synccreate.size())
+                        if (localsyncnotseen.size() && !synccreate.size() && !syncdowncut)
                         {
                             // ... execute all pending deletions
                             localnode_set::iterator it;
@@ -1443,20 +1817,30 @@ void MegaClient::exec()
                         // are retrying local fs writes
                         if (!syncfsopsfailed)
                         {
-                            // FIXME: only syncup for subtrees that were actually
-                            // updated to reduce CPU load
+                            // (only the subtrees flagged as dirty are visited)
+                            startsyncpass();
+
                             for (it = syncs.begin(); it != syncs.end(); it++)
                             {
                                 if (((*it)->state == SYNC_ACTIVE || (*it)->state == SYNC_INITIALSCAN)
                                  && !(*it)->dirnotify->notifyq[DirNotify::DIREVENTS].size()
                                  && !(*it)->dirnotify->notifyq[DirNotify::RETRY].size()
-                                 && !syncadding)
+                                 && !syncadding && !syncdowncut)
                                 {
+                                    WAIT_CLASS::bumpds();
+                                    dstime passds = Waiter::ds;
+
                                     syncup(&(*it)->localroot, &nds);
+
+                                    WAIT_CLASS::bumpds();
+                                    (*it)->stats.syncupds = Waiter::ds - passds;
+
                                     (*it)->cachenodes();
                                 }
                             }
 
+                            endsyncpass();
+
                             if (EVER(nds))
                             {
                                 syncnaglebt.backoff(nds - Waiter::ds);
@@ -1493,11 +1877,21 @@ void MegaClient::exec()
                                     }
                                     else
                                     {
+                                        // listings read ahead for folders that were never scanned
+                                        sync->dropscanjobs();
+
                                         if (sync->fullscan)
                                         {
                                             // recursively delete all LocalNodes that were deleted (not moved or renamed!)
                                             sync->deletemissing(&sync->localroot);
+                                            sync->commitdirmtimes(&sync->localroot);
                                             sync->cachenodes();
+
+                                            if (sync->verifyscan)
+                                            {
+                                                sync->verifyscan = false;
+                                                sync->lastverify = Waiter::ds;
+                                            }
                                         }
 
                                         // if the directory events notification subsystem is permanently unavailable or
@@ -1519,6 +1913,17 @@ void MegaClient::exec()
 
                                                 syncscanbt.backoff(10 + totalnodes / 128);
                                             }
+                                            else if (syncverifyinterval && Waiter::ds >= sync->lastverify + syncverifyinterval)
+                                            {
+                                                // periodic full rescan that fingerprints every file again
+                                                LOG_debug << "Verifying sync fingerprints";
+
+                                                sync->verifyscan = true;
+                                                sync->scan(&sync->localroot.localname, NULL);
+
+                                                sync->fullscan = true;
+                                                sync->scanseqno++;
+                                            }
                                         }
                                     }
                                 }
@@ -1543,10 +1948,39 @@ void MegaClient::exec()
                 }
             }
         }
+
+        // periodic per-sync performance counters
+        if (syncs.size() && Waiter::ds >= syncstatsds + SYNCSTATSDS)
+        {
+            syncstatsds = Waiter::ds;
+
+            for (it = syncs.begin(); it != syncs.end(); it++)
+            {
+                if ((*it)->state == SYNC_ACTIVE || (*it)->state == SYNC_INITIALSCAN)
+                {
+                    (*it)->updatestats();
+                }
+            }
+        }
 #endif
 
         notifypurge();
-    } while (httpio->doio() || execdirectreads() || (!pendingcs && reqs[r].cmdspending() && btcs.armed()));
+    } while ((httpstatechange = httpio->doio()) || execdirectreads() || (!pendingcs && ((reqs[r].cmdspending() && csbatchready()) || batchedputnodes.size()) && btcs.armed()));
+
+    if (scpending || scwriting)
+    {
+        execscwrites();
+    }
+
+    if (gfxrunning.size())
+    {
+        execgfx();
+    }
+
+    if (gfxcachehits.size())
+    {
+        deliverfacachehits();
+    }
 
     if (!badhostcs && badhosts.size())
     {
@@ -1559,6 +1993,14 @@ void MegaClient::exec()
         badhostcs->post(this);
         badhosts.clear();
     }
+
+    enginestats.execs.add(Waiter::us() - execstart);
+
+    if (enginestatsds && Waiter::ds >= enginestatslastds + enginestatsds)
+    {
+        enginestatslastds = Waiter::ds;
+        app->enginestats_updated();
+    }
 }
 
 // get next event time from all subsystems, then invoke the waiter if needed
@@ -1570,15 +2012,20 @@ int MegaClient::wait()
     // get current dstime and clear wait events
     WAIT_CLASS::bumpds();
 
+    // a response is being processed in slices? don't wait.
+    if ((pendingcs && csresume) || (jsonsc.pos && scsliced))
+    {
+        nds = Waiter::ds;
+    }
 #ifdef ENABLE_SYNC
     // sync directory scans in progress or still processing sc packet without having
     // encountered a locally locked item? don't wait.
-    if (syncactivity || (jsonsc.pos && !syncdownretry))
+    else if (syncactivity || (jsonsc.pos && !syncdownretry))
     {
         nds = Waiter::ds;
     }
-    else
 #endif
+    else
     {
         // next retry of a failed transfer
         nds = NEVER;
@@ -1599,16 +2046,57 @@ int MegaClient::wait()
         if (!pendingcs)
         {
             btcs.update(&nds);
-        }
 
-        // retry failed server-client requests
+            // end of the batching window
+            if (csbatchstart != NEVER && reqs[r].cmdspending()
+             && csbatchstart + CSBATCHWINDOW < nds)
+            {
+                nds = csbatchstart + CSBATCHWINDOW;
+            }
+        }
+
+        if (!pipelinedcs && pipelinereq.cmdspending())
+        {
+            btpipelinecs.update(&nds);
+        }
+
+        // end of the action packet burst window
+        if (scburst && scburststart + SCBURSTMAXDS < nds)
+        {
+            nds = scburststart + SCBURSTMAXDS;
+        }
+
+        // next write-behind state cache transaction
+        if (scpending && !scwriting && scpendingsince + SCFLUSHDS < nds)
+        {
+            nds = scpendingsince + SCFLUSHDS;
+        }
+
+        // next engine statistics report
+        if (enginestatsds && enginestatslastds + enginestatsds < nds)
+        {
+            nds = enginestatslastds + enginestatsds;
+
+            if (nds < Waiter::ds)
+            {
+                nds = Waiter::ds;
+            }
+        }
+
+        // app timer
+        if (appwakeupds < nds)
+        {
+            nds = appwakeupds > Waiter::ds ? appwakeupds : Waiter::ds;
+        }
+
+        // retry failed server-client requests
         if (!pendingsc && *scsn)
         {
             btsc.update(&nds);
         }
 
         // retry failed file attribute puts
-        if (curfa == newfa.end())
+        if (newfa.size() && activefa.size() < MAXPUTFA)
         {
             btpfa.update(&nds);
         }
@@ -1666,6 +2154,17 @@ int MegaClient::wait()
         {
             syncnaglebt.update(&nds);
         }
+
+        // next sync statistics report
+        if (syncs.size() && syncstatsds + SYNCSTATSDS < nds)
+        {
+            nds = syncstatsds + SYNCSTATSDS;
+
+            if (nds < Waiter::ds)
+            {
+                nds = Waiter::ds;
+            }
+        }
 #endif
 
         // detect stuck network
@@ -1698,8 +2197,11 @@ int MegaClient::wait()
     waiter->wakeupby(httpio, Waiter::NEEDEXEC);
     waiter->wakeupby(fsaccess, Waiter::NEEDEXEC);
 
+    int64_t waitstart = Waiter::us();
     int r = waiter->wait();
 
+    enginestats.waits.add(Waiter::us() - waitstart);
+
     // process results
     r |= httpio->checkevents(waiter);
     r |= fsaccess->checkevents(waiter);
@@ -1741,7 +2243,7 @@ bool MegaClient::abortbackoff(bool includexfers)
         r = true;
     }
 
-    if (curfa == newfa.end() && btpfa.arm())
+    if (newfa.size() && activefa.size() < MAXPUTFA && btpfa.arm())
     {
         r = true;
     }
@@ -1760,16 +2262,32 @@ bool MegaClient::abortbackoff(bool includexfers)
 // this will dispatch the next queued transfer unless one is already in
 // progress and force isn't set
 // returns true if dispatch occurred, false otherwise
-bool MegaClient::dispatch(direction_t d)
+bool MegaClient::dispatch(direction_t d, int lanes)
 {
     // do we have any transfer slots available?
     if (!slotavail())
+    {
+        lanes &= ~TransferScheduler::LANE_REGULAR;
+    }
+
+    if (d != PUT || !smallslotavail())
+    {
+        lanes &= ~TransferScheduler::LANE_SMALL;
+    }
+
+    // streaming reads below their guaranteed rate go first
+    if (d == GET && bandwidth.bulkbackoff())
+    {
+        lanes = 0;
+    }
+
+    if (!lanes)
     {
         return false;
     }
 
     // file attribute jam? halt uploads.
-    if (d == PUT && newfa.size() > 32)
+    if (d == PUT && newfa.size() + activefa.size() > 32)
     {
         return false;
     }
@@ -1779,24 +2297,16 @@ bool MegaClient::dispatch(direction_t d)
 
     for (;;)
     {
-        nextit = transfers[d].end();
-
-        for (transfer_map::iterator it = transfers[d].begin(); it != transfers[d].end(); it++)
-        {
-            if (!it->second->slot && it->second->bt.armed()
-             && (nextit == transfers[d].end()
-              || it->second->bt.retryin() < nextit->second->bt.retryin()))
-            {
-                nextit = it;
-            }
-        }
+        Transfer* nt = scheduler.next(d, lanes);
 
         // no inactive transfers ready?
-        if (nextit == transfers[d].end())
+        if (!nt)
         {
             return false;
         }
 
+        nextit = nt->transfers_it;
+
         if (!nextit->second->localfilename.size())
         {
             // this is a fresh transfer rather than the resumption of a partly
@@ -1821,7 +2331,7 @@ bool MegaClient::dispatch(direction_t d)
                     if ((*it)->hprivate)
                     {
                         // the size field must be valid right away for
-                        // MegaClient::moretransfers()
+                        // TransferScheduler::more()
                         if ((n = nodebyhandle((*it)->h)) && n->type == FILENODE)
                         {
                             k = (const byte*)n->nodekey.data();
@@ -1871,10 +2381,64 @@ bool MegaClient::dispatch(direction_t d)
             // allocate transfer slot
             ts = new TransferSlot(nextit->second);
 
+            // identical content already on disk: complete without transferring
+            if (d == GET && !nextit->second->macpos && localcopy(nextit->second))
+            {
+                for (file_list::iterator it = nextit->second->files.begin();
+                     it != nextit->second->files.end(); it++)
+                {
+                    (*it)->start();
+                }
+
+                // (pending completions are retried through the slot)
+                ts->slots_it = tslots.insert(tslots.begin(), ts);
+                ts->progresscompleted = nextit->second->size;
+                nextit->second->complete();
+
+                return true;
+            }
+
+            bool opened;
+
             // try to open file (PUT transfers: open in nonblocking mode)
-            if ((d == PUT)
-              ? ts->fa->fopen(&nextit->second->localfilename)
-              : ts->fa->fopen(&nextit->second->localfilename, false, true))
+            if (d == PUT && nextit->second->stream)
+            {
+                // data that isn't in a local file is read from its stream
+                delete ts->fa;
+                ts->fa = new StreamFileAccess(nextit->second->stream, nextit->second->mtime);
+                opened = ts->fa->fopen(&nextit->second->localfilename, true, false);
+            }
+            else if (d == PUT)
+            {
+                opened = ts->fa->fopen(&nextit->second->localfilename);
+            }
+            else
+            {
+                // partly completed downloads keep the data written so far,
+                // provided that the file still holds it
+                opened = nextit->second->macpos
+                      && ts->fa->fopen(&nextit->second->localfilename, true, true)
+                      && ts->fa->size >= nextit->second->macpos;
+
+                if (!opened)
+                {
+                    if (nextit->second->macpos)
+                    {
+                        LOG_debug << "Partial download data not available, restarting";
+
+                        nextit->second->chunkmacs.clear();
+                        nextit->second->macpos = 0;
+                        memset(nextit->second->filemac, 0, sizeof nextit->second->filemac);
+
+                        delete ts->fa;
+                        ts->fa = fsaccess->newfileaccess();
+                    }
+
+                    opened = ts->fa->fopen(&nextit->second->localfilename, false, true);
+                }
+            }
+
+            if (opened)
             {
                 handle h = UNDEF;
                 bool hprivate = true;
@@ -1887,22 +2451,32 @@ bool MegaClient::dispatch(direction_t d)
                 {
                     nextit->second->size = ts->fa->size;
                     nextit->second->chunkmacs.clear();
+                    nextit->second->macpos = 0;
+                    memset(nextit->second->filemac, 0, sizeof nextit->second->filemac);
 
                     // create thumbnail/preview imagery, if applicable (FIXME: do not re-create upon restart)
-                    if (gfx && nextit->second->localfilename.size() && !nextit->second->uploadhandle)
+                    if (gfx && nextit->second->localfilename.size() && !nextit->second->uploadhandle
+                            && !nextit->second->stream)
                     {
                         nextit->second->uploadhandle = getuploadhandle();
 
                         if (gfx->isgfx(&nextit->second->localfilename))
                         {
+                            // one sequential read of the image feeds the
+                            // decoder, the upload chunks and the final
+                            // fingerprint check
+                            ts->fa->ingest();
+
                             // we want all imagery to be safely tucked away before completing the upload, so we bump minfa
-                            nextit->second->minfa += gfx->gendimensionsputfa(ts->fa, &nextit->second->localfilename, nextit->second->uploadhandle, &nextit->second->key);
+                            nextit->second->minfa += gfx->gendimensionsputfa(ts->fa, &nextit->second->localfilename, nextit->second->uploadhandle, &nextit->second->key, -1, nextit->second);
                         }
                     }
                 }
                 else
                 {
                     // downloads resume at the end of the last contiguous completed block
+                    nextit->second->pos = nextit->second->macpos;
+
                     for (chunkmac_map::iterator it = nextit->second->chunkmacs.begin();
                          it != nextit->second->chunkmacs.end(); it++)
                     {
@@ -1917,26 +2491,75 @@ bool MegaClient::dispatch(direction_t d)
                         }
                     }
 
-                    for (file_list::iterator it = nextit->second->files.begin();
-                         it != nextit->second->files.end(); it++)
+                    if (dlpreallocate && nextit->second->size
+                            && !ts->fa->fpreallocate(nextit->second->size))
                     {
-                        if (!(*it)->hprivate || nodebyhandle((*it)->h))
-                        {
-                            h = (*it)->h;
-                            hprivate = (*it)->hprivate;
-                            auth = (*it)->auth.size() ? (*it)->auth.c_str() : NULL;
-                            break;
-                        }
+                        LOG_debug << "Unable to preallocate download target";
+                    }
+
+                    if (dldirectio && !ts->fa->setdirectio())
+                    {
+                        LOG_debug << "Unbuffered writes not available for download target";
+                    }
+
+                    downloadsource(nextit->second, &h, &hprivate, &auth);
+                }
+
+                // LAN peers holding the file can serve its chunks (the
+                // storage server remains the fallback)
+                if (d == GET && hprivate && !ISUNDEF(h) && !nextit->second->nopeers)
+                {
+                    ts->peerhandle = h;
+
+                    if (peerurls.find(h) == peerurls.end())
+                    {
+                        app->peer_lookup(h);
+                    }
+                }
+
+                Transfer* t = nextit->second;
+
+                // (an upload URL is bound to the size it was requested for)
+                if (t->tempurlcmd && d == PUT && t->tempurlsize != t->size)
+                {
+                    t->tempurlcmd->cancel();
+                    t->tempurlcmd = NULL;
+                }
+
+                if (t->tempurlcmd)
+                {
+                    // the prefetch is on its way: its result goes to the slot
+                    if (d == PUT)
+                    {
+                        ((CommandPutFile*)t->tempurlcmd)->attach(ts);
+                    }
+                    else
+                    {
+                        ((CommandGetFile*)t->tempurlcmd)->attach(ts);
                     }
                 }
+                else if (t->tempurlvalid())
+                {
+                    // prefetched: the slot can start transferring right away
+                    ts->tempurl.swap(t->tempurl);
+                    ts->fileattrstring.swap(t->fileattrstring);
+                    ts->fileattrsmutable = t->fileattrsmutable;
+                    ts->starttime = ts->lastdata = Waiter::ds;
+                }
+                else
+                {
+                    t->tempurl.clear();
 
-                // dispatch request for temporary source/target URL
-                reqs[r].add((ts->pendingcmd = (d == PUT)
-                          ? (Command*)new CommandPutFile(ts, putmbpscap)
-                          : (Command*)new CommandGetFile(ts, NULL, h, hprivate, auth)));
+                    // dispatch request for temporary source/target URL
+                    reqs[r].add((ts->pendingcmd = (d == PUT)
+                              ? (Command*)new CommandPutFile(ts, putmbpscap)
+                              : (Command*)new CommandGetFile(ts, NULL, h, hprivate, auth)));
+                }
 
                 ts->slots_it = tslots.insert(tslots.begin(), ts);
 
+                cachetransfer(nextit->second);
+
                 // notify the app about the starting transfer
                 for (file_list::iterator it = nextit->second->files.begin();
                      it != nextit->second->files.end(); it++)
@@ -1953,6 +2576,134 @@ bool MegaClient::dispatch(direction_t d)
     }
 }
 
+void MegaClient::queuegfx(GfxJob* job)
+{
+    gfxwaiting.push_back(job);
+    execgfx();
+}
+
+void MegaClient::execgfx()
+{
+    for (deque<GfxJob*>::iterator it = gfxrunning.begin(); it != gfxrunning.end(); )
+    {
+        GfxJob* job = *it;
+
+        if (!gfxpool->isdone(job))
+        {
+            it++;
+            continue;
+        }
+
+        int failed = 0;
+
+        for (int i = GfxProc::NUMDIMENSIONS; i--; )
+        {
+            if (job->images[i])
+            {
+                gfxcache.put(&job->fingerprint, (fatype)i, job->images[i]->data(), job->images[i]->size());
+
+                // putfa() takes ownership
+                int creqtag = reqtag;
+                reqtag = 0;
+                putfa(job->th, (GfxProc::meta_t)i, &job->key, job->images[i]);
+                reqtag = creqtag;
+
+                job->images[i] = NULL;
+            }
+            else if (job->missing & (1 << i))
+            {
+                failed++;
+            }
+        }
+
+        if (failed)
+        {
+            gfxfailed(job->th, failed);
+        }
+
+        delete job;
+        it = gfxrunning.erase(it);
+    }
+
+    while (gfxwaiting.size() && gfxrunning.size() < MAXGFXQUEUE)
+    {
+        gfxrunning.push_back(gfxwaiting.front());
+        gfxwaiting.pop_front();
+        gfxpool->push(gfxrunning.back());
+    }
+}
+
+void MegaClient::deliverfacachehits()
+{
+    while (gfxcachehits.size())
+    {
+        GfxCacheHit* hit = &gfxcachehits.front();
+        Node* n;
+
+        if ((n = nodebyhandle(hit->nodehandle)))
+        {
+            restag = hit->tag;
+            app->fa_complete(n, hit->type, hit->data.data(), hit->data.size());
+        }
+
+        gfxcachehits.pop_front();
+    }
+}
+
+void MegaClient::abortgfx()
+{
+    while (gfxrunning.size())
+    {
+        gfxpool->waitfor(gfxrunning.front());
+        delete gfxrunning.front();
+        gfxrunning.pop_front();
+    }
+
+    while (gfxwaiting.size())
+    {
+        delete gfxwaiting.front();
+        gfxwaiting.pop_front();
+    }
+}
+
+void MegaClient::gfxfailed(handle th, int count)
+{
+    handletransfer_map::iterator htit = faputcompletion.find(th);
+    Transfer* t = NULL;
+
+    if (htit != faputcompletion.end())
+    {
+        t = htit->second;
+    }
+    else
+    {
+        for (transfer_map::iterator it = transfers[PUT].begin(); it != transfers[PUT].end(); it++)
+        {
+            if (it->second->uploadhandle == th)
+            {
+                t = it->second;
+                break;
+            }
+        }
+    }
+
+    if (t)
+    {
+        t->minfa -= count;
+
+        if (t->minfa < 0)
+        {
+            t->minfa = 0;
+        }
+
+        // an upload on hold may now be complete
+        if (htit != faputcompletion.end())
+        {
+            checkfacompletion(th);
+        }
+    }
+}
+
 // generate upload handle for this upload
 // (after 65536 uploads, a node handle clash is possible, but far too unlikely
 // to be of real-world concern)
@@ -2051,6 +2802,11 @@ void MegaClient::disconnect()
         pendingcs->disconnect();
     }
 
+    if (pipelinedcs)
+    {
+        pipelinedcs->disconnect();
+    }
+
     if (pendingsc)
     {
         pendingsc->disconnect();
@@ -2061,7 +2817,7 @@ void MegaClient::disconnect()
         (*it)->disconnect();
     }
 
-    for (putfa_list::iterator it = newfa.begin(); it != newfa.end(); it++)
+    for (putfa_list::iterator it = activefa.begin(); it != activefa.end(); it++)
     {
         (*it)->disconnect();
     }
@@ -2079,11 +2835,18 @@ void MegaClient::logout()
 {
     if(loggedin() != FULLACCOUNT)
     {
+        waitsc();
+
         if (sctable)
         {
             sctable->remove();
         }
 
+        if (tlstable)
+        {
+            tlstable->remove();
+        }
+
 #ifdef ENABLE_SYNC
         for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
         {
@@ -2109,16 +2872,30 @@ void MegaClient::locallogout()
 
     disconnect();
 
+    waitsc();
+
     delete sctable;
     sctable = NULL;
 
+    delete tlstable;
+    tlstable = NULL;
+
     me = UNDEF;
 
     cachedscsn = UNDEF;
+    scdelta = 0;
+    clearjournal();
+
+    abortgfx();
+    gfxcachehits.clear();
+    gfxcache.close();
 
     freeq(GET);
     freeq(PUT);
 
+    closetctable();
+    clearlocalcopies();
+
     purgenodesusersabortsc();
 
     for (i = sizeof(reqs)/sizeof(*reqs); i--; )
@@ -2126,18 +2903,64 @@ void MegaClient::locallogout()
         reqs[i].clear();
     }
 
+    for (map<handle, vector<pair<int, NewNode*> > >::iterator it = batchedputnodes.begin();
+         it != batchedputnodes.end(); it++)
+    {
+        for (unsigned j = 0; j < it->second.size(); j++)
+        {
+            delete[] it->second[j].second;
+        }
+    }
+
+    batchedputnodes.clear();
+
+    for (set<PutNodesTree*>::iterator it = putnodestrees.begin(); it != putnodestrees.end(); it++)
+    {
+        delete[] (*it)->nn;
+        delete *it;
+    }
+
+    putnodestrees.clear();
+
+#ifdef ENABLE_SYNC
+    for (set<MoveBatch*>::iterator it = movebatches.begin(); it != movebatches.end(); it++)
+    {
+        delete *it;
+    }
+
+    movebatches.clear();
+    movebatch = NULL;
+#endif
+
     delete pendingcs;
     pendingcs = NULL;
 
+    fnstream = FNSTREAM_OFF;
+    fnstreamdp.clear();
+
+    pipelinereq.clear();
+    delete pipelinedcs;
+    pipelinedcs = NULL;
+    btpipelinecs.reset();
+    csbatchstart = NEVER;
+    scburst = false;
+    scwaitseen = false;
+
     for (putfa_list::iterator it = newfa.begin(); it != newfa.end(); it++)
     {
         delete *it;
     }
 
+    for (putfa_list::iterator it = activefa.begin(); it != activefa.end(); it++)
+    {
+        delete *it;
+    }
+
     newfa.clear();
-    curfa = newfa.end();
+    activefa.clear();
     xferpaused[PUT] = false;
     xferpaused[GET] = false;
+    httpstatechange = true;
     putmbpscap = 0;
 
     for (fafc_map::iterator cit = fafcs.begin(); cit != fafcs.end(); cit++)
@@ -2181,6 +3004,7 @@ const char *MegaClient::version()
 bool MegaClient::procsc()
 {
     nameid name;
+    int64_t deadline = Waiter::us() + SLICEUS;
 
 #ifdef ENABLE_SYNC
     char test[] = "},{\"a\":\"t\",\"i\":\"";
@@ -2198,12 +3022,15 @@ bool MegaClient::procsc()
                 case 'w':
                     if (!statecurrent)
                     {
+                        startup.end(STARTUP_CURRENT, 0, nodes.size());
+
                         // NULL vector: "notify all nodes"
                         app->nodes_current();
                         statecurrent = true;
                     }
                 
                     jsonsc.storeobject(&scnotifyurl);
+                    scwaitseen = true;
                     break;
 
                 case MAKENAMEID2('s', 'n'):
@@ -2214,6 +3041,19 @@ bool MegaClient::procsc()
                 case EOO:
                     mergenewshares(1);
                     applykeys();
+
+                    // no wait URL: the server has more packets queued
+                    if (scwaitseen)
+                    {
+                        scburst = false;
+                    }
+                    else if (!scburst)
+                    {
+                        scburst = true;
+                        scburststart = Waiter::ds;
+                    }
+
+                    scwaitseen = false;
                     return true;
 
                 case 'a':
@@ -2240,6 +3080,7 @@ bool MegaClient::procsc()
                 if (jsonsc.getnameid() == 'a')
                 {
                     name = jsonsc.getnameid();
+                    enginestats.actionpackets++;
 
                     // only process server-client request if not marked as
                     // self-originating ("i" marker element guaranteed to be following
@@ -2379,6 +3220,14 @@ bool MegaClient::procsc()
                 }
 
                 jsonsc.leaveobject();
+
+                if (Waiter::us() > deadline && jsonsc.pos[0] != ']')
+                {
+                    // continue with the next packet in the next pass
+                    applykeys();
+                    scsliced = true;
+                    return false;
+                }
             }
             else
             {
@@ -2398,6 +3247,8 @@ bool MegaClient::procsc()
 // are tolerant towards incomplete/faulty nodes.
 void MegaClient::initsc()
 {
+    waitsc();
+
     if (sctable)
     {
         bool complete;
@@ -2424,36 +3275,94 @@ void MegaClient::initsc()
 
         if (complete)
         {
-            // 3. write new or modified nodes, purge deleted nodes
-            for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
-            {
-                if (!(complete = sctable->put(CACHEDNODE, it->second, &key)))
-                {
-                    break;
-                }
-            }
+            // (the truncation dropped the stored blocks)
+            journalblocks.clear();
+            complete = putjournal(true);
         }
 
         if (complete)
         {
-            // 4. write new or modified pcrs, purge deleted pcrs
-            for (handlepcr_map::iterator it = pcrindex.begin(); it != pcrindex.end(); it++)
+            // 3. write the snapshot of all nodes
+            string pack, t;
+            unsigned packed = 0;
+            uint32_t packid = 0;
+            DbNodeKeys keys;
+
+            for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDPCR, it->second, &key)))
+                Node* n = it->second;
+
+                n->dbid = 0;
+                n->inpack = false;
+
+                t.clear();
+
+                if (!n->serialize(&t))
                 {
-                    break;
+                    continue;
                 }
-            }
-        }
 
-        LOG_debug << "Saving SCSN " << scsn << " with " << nodes.size() << " nodes and " << users.size() << " users to local cache (" << complete << ")";
-        finalizesc(complete);
-    }
-}
+                if (!packed)
+                {
+                    packid = sctable->newid(CACHEDNODEPACK);
+                }
+
+                uint32_t len = t.size();
+
+                pack.append((char*)&len, sizeof len);
+                pack.append(t);
+                n->inpack = true;
+
+                if (sctable->indexnodes && n->dbkeys(&keys)
+                 && !(complete = sctable->indexnode(&keys, packid)))
+                {
+                    break;
+                }
+
+                if (++packed == SNAPSHOTPACKNODES)
+                {
+                    if (!(complete = putnodepack(&pack, packid)))
+                    {
+                        break;
+                    }
+
+                    packed = 0;
+                }
+            }
+
+            if (complete && packed)
+            {
+                complete = putnodepack(&pack, packid);
+            }
+        }
+
+        scdelta = 0;
+
+        if (complete)
+        {
+            // 4. write new or modified pcrs, purge deleted pcrs
+            for (handlepcr_map::iterator it = pcrindex.begin(); it != pcrindex.end(); it++)
+            {
+                if (!(complete = sctable->put(CACHEDPCR, it->second, &key)))
+                {
+                    break;
+                }
+            }
+        }
+
+        LOG_debug << "Saving SCSN " << scsn << " with " << nodes.size() << " nodes and " << users.size() << " users to local cache (" << complete << ")";
+        finalizesc(complete);
+    }
+}
 
 // erase and and fill user's local state cache
 void MegaClient::updatesc()
 {
+    if (sctable && workerpool)
+    {
+        return queuesc();
+    }
+
     if (sctable)
     {
         string t;
@@ -2469,6 +3378,8 @@ void MegaClient::updatesc()
             return;
         }
 
+        int64_t start = Waiter::us();
+
         sctable->begin();
 
         bool complete;
@@ -2490,23 +3401,53 @@ void MegaClient::updatesc()
             }
         }
 
+        if (complete)
+        {
+            complete = putjournal(false);
+        }
+
+        // deleted node records and index entries, removed in bulk
+        vector<uint32_t> dels;
+        handle_vector unindexed;
+
         if (complete)
         {
             // 3. write new or modified nodes, purge deleted nodes
             for (node_vector::iterator it = nodenotify.begin(); it != nodenotify.end(); it++)
             {
                 char base64[12];
-                if ((*it)->changed.removed && (*it)->dbid)
+                if ((*it)->changed.removed)
                 {
                     LOG_verbose << "Removing node from database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->del((*it)->dbid)))
+                    if ((*it)->dbid)
                     {
-                        break;
+                        dels.push_back((*it)->dbid);
+                    }
+
+                    if (sctable->indexnodes)
+                    {
+                        unindexed.push_back((*it)->nodehandle);
+                    }
+
+                    // the snapshot still holds it
+                    if ((*it)->inpack)
+                    {
+                        string data;
+
+                        encodetombstone(*it, &data);
+                        scdelta++;
+
+                        if (!(complete = sctable->put(sctable->newid(CACHEDNODEGONE), &data)))
+                        {
+                            break;
+                        }
                     }
                 }
                 else
                 {
                     LOG_verbose << "Adding node to database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
+                    scdelta++;
+
                     if (!(complete = sctable->put(CACHEDNODE, *it, &key)))
                     {
                         break;
@@ -2515,6 +3456,16 @@ void MegaClient::updatesc()
             }
         }
 
+        if (complete && dels.size())
+        {
+            complete = sctable->delmany(&dels[0], dels.size());
+        }
+
+        if (complete && unindexed.size())
+        {
+            complete = sctable->unindexnodes(&unindexed[0], unindexed.size());
+        }
+
         if (complete)
         {
             // 4. write new or modified pcrs, purge deleted pcrs
@@ -2542,244 +3493,1167 @@ void MegaClient::updatesc()
 
         LOG_debug << "Saving SCSN " << scsn << " with " << nodenotify.size() << " modified nodes and " << usernotify.size() << " users to local cache (" << complete << ")";
         finalizesc(complete);
+
+        enginestats.dbcommits.add(Waiter::us() - start);
     }
 
 }
 
-// commit or purge local state cache
-void MegaClient::finalizesc(bool complete)
+// serialize the changes for the next write-behind transaction
+void MegaClient::queuesc()
 {
-    if (complete)
+    // the table does not record an scsn yet (see initsc())
+    if (ISUNDEF(cachedscsn))
     {
-        sctable->commit();
-        Base64::atob(scsn, (byte*)&cachedscsn, sizeof cachedscsn);
+        return;
     }
-    else
-    {
-        sctable->abort();
-        sctable->truncate();
 
-        LOG_err << "Cache update DB write error - disabling caching";
-
-        delete sctable;
-        sctable = NULL;
+    if (!scpending)
+    {
+        scpending = new DbWriteJob(sctable, CACHEDSCSN);
+        scpendingsince = Waiter::ds;
     }
 
-}
-
-// queue node file attribute for retrieval or cancel retrieval
-error MegaClient::getfa(Node* n, fatype t, int cancel)
-{
-    // locate this file attribute type in the nodes's attribute string
-    handle fah;
-    int p, pp;
+    string data;
+    DbNodeKeys keys;
 
-    if (!(p = n->hasfileattribute(t)))
+    for (user_vector::iterator it = usernotify.begin(); it != usernotify.end(); it++)
     {
-        return API_ENOENT;
+        if (sctable->encode(CACHEDUSER, *it, &key, &data))
+        {
+            scpending->add((*it)->dbid, &data);
+        }
     }
 
-    pp = p - 1;
+    vector<uint32_t> jids, jdels;
+    vector<string> jdata;
 
-    while (pp && n->fileattrstring[pp - 1] >= '0' && n->fileattrstring[pp - 1] <= '9')
-    {
-        pp--;
-    }
+    journalrecords(false, &jids, &jdata, &jdels);
 
-    if (p == pp)
+    for (unsigned i = 0; i < jids.size(); i++)
     {
-        return API_ENOENT;
+        scpending->add(jids[i], &jdata[i]);
     }
 
-    if (Base64::atob(strchr(n->fileattrstring.c_str() + p, '*') + 1, (byte*)&fah, sizeof(fah)) != sizeof(fah))
+    for (unsigned i = 0; i < jdels.size(); i++)
     {
-        return API_ENOENT;
+        scpending->del(jdels[i]);
     }
 
-    int c = atoi(n->fileattrstring.c_str() + pp);
-
-    if (cancel)
+    for (node_vector::iterator it = nodenotify.begin(); it != nodenotify.end(); it++)
     {
-        // cancel pending request
-        fafc_map::iterator cit;
-
-        if ((cit = fafcs.find(c)) != fafcs.end())
+        if ((*it)->changed.removed)
         {
-            faf_map::iterator it;
-
-            for (int i = 2; i--; )
+            if ((*it)->dbid)
             {
-                if ((it = cit->second->fafs[i].find(fah)) != cit->second->fafs[i].end())
-                {
-                    delete it->second;
-                    cit->second->fafs[i].erase(it);
-
-                    // none left: tear down connection
-                    if (!cit->second->fafs[1].size() && cit->second->req.status == REQ_INFLIGHT)
-                    {
-                        cit->second->req.disconnect();
-                    }
-
-                    return API_OK;
-                }
+                scpending->del((*it)->dbid);
             }
-        }
 
-        return API_ENOENT;
-    }
-    else
-    {
-        // add file attribute cluster channel and set cluster reference node handle
-        FileAttributeFetchChannel** fafcp = &fafcs[c];
+            if (sctable->indexnodes)
+            {
+                scpending->unindex((*it)->nodehandle);
+            }
 
-        if (!*fafcp)
-        {
-            *fafcp = new FileAttributeFetchChannel();
+            // the snapshot still holds it
+            if ((*it)->inpack)
+            {
+                encodetombstone(*it, &data);
+                scpending->add(sctable->newid(CACHEDNODEGONE), &data);
+                scdelta++;
+            }
         }
-
-        if (!(*fafcp)->fafs[1].count(fah))
+        else if (sctable->encode(CACHEDNODE, *it, &key, &data))
         {
-            (*fafcp)->fahref = fah;
-
-            // map returned handle to type/node upon retrieval response
-            FileAttributeFetch** fafp = &(*fafcp)->fafs[0][fah];
+            scpending->add((*it)->dbid, &data);
+            scdelta++;
 
-            if (!*fafp)
+            if (sctable->indexnodes && (*it)->dbkeys(&keys))
             {
-                *fafp = new FileAttributeFetch(n->nodehandle, t, reqtag);
+                scpending->index(&keys, (*it)->dbid);
             }
-            else
+        }
+    }
+
+    for (pcr_vector::iterator it = pcrnotify.begin(); it != pcrnotify.end(); it++)
+    {
+        if ((*it)->removed())
+        {
+            if ((*it)->dbid)
             {
-                restag = (*fafp)->tag;
-                return API_EEXIST;
+                scpending->del((*it)->dbid);
             }
         }
-        else
+        else if (sctable->encode(CACHEDPCR, *it, &key, &data))
         {
-            FileAttributeFetch** fafp = &(*fafcp)->fafs[1][fah];
-            restag = (*fafp)->tag;
-            return API_EEXIST;
+            scpending->add((*it)->dbid, &data);
         }
+    }
 
-        return API_OK;
+    handle tscsn;
+    Base64::atob(scsn, (byte*)&tscsn, sizeof tscsn);
+    scpending->last.assign((char*)&tscsn, sizeof tscsn);
+
+    cachedscsn = tscsn;
+
+    LOG_debug << "Queued SCSN " << scsn << " with " << nodenotify.size() << " modified nodes and " << usernotify.size() << " users for the local cache";
+
+    if (scpending->ids.size() + scpending->dels.size() >= SCFLUSHRECORDS)
+    {
+        execscwrites();
     }
 }
 
-// build pending attribute string for this handle and remove
-void MegaClient::pendingattrstring(handle h, string* fa)
+// collect the finished transaction and start the next one when due
+void MegaClient::execscwrites()
 {
-    char buf[128];
+    if (scwriting && workerpool->isdone(scwriting))
+    {
+        scwritten();
+    }
 
-    for (fa_map::iterator it = pendingfa.lower_bound(pair<handle, fatype>(h, 0));
-         it != pendingfa.end() && it->first.first == h; )
+    if (scpending && !scwriting
+     && (Waiter::ds >= scpendingsince + SCFLUSHDS
+      || scpending->ids.size() + scpending->dels.size() >= SCFLUSHRECORDS))
     {
-        sprintf(buf, "/%u*", (unsigned)it->first.second);
-        Base64::btoa((byte*)&it->second.first, sizeof(it->second.first), strchr(buf + 3, 0));
-        pendingfa.erase(it++);
-        fa->append(buf + !fa->size());
+        scwriting = scpending;
+        scpending = NULL;
+        workerpool->push(scwriting);
     }
 }
 
-// attach file attribute to a file (th can be upload or node handle)
-// FIXME: to avoid unnecessary roundtrips to the attribute servers, also cache locally
-void MegaClient::putfa(handle th, fatype t, SymmCipher* key, string* data)
+void MegaClient::scwritten()
 {
-    // CBC-encrypt attribute data (padded to next multiple of BLOCKSIZE)
-    data->resize((data->size() + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE);
-    key->cbc_encrypt((byte*)data->data(), data->size());
+    bool complete = scwriting->complete;
 
-    newfa.push_back(new HttpReqCommandPutFA(this, th, t, data));
+    enginestats.dbcommits.add(scwriting->duration);
+
+    LOG_debug << "Committed " << scwriting->ids.size() + scwriting->dels.size() << " records to the local cache (" << complete << ")";
+
+    delete scwriting;
+    scwriting = NULL;
 
-    // no other file attribute storage request currently in progress? POST this one.
-    if (curfa == newfa.end())
+    if (!complete)
     {
-        curfa = newfa.begin();
-        reqs[r].add(*curfa);
+        // later changes build on the failed ones
+        delete scpending;
+        scpending = NULL;
+
+        sctable->truncate();
+
+        LOG_err << "Cache update DB write error - disabling caching";
+
+        delete sctable;
+        sctable = NULL;
     }
 }
 
-// has the limit of concurrent transfer tslots been reached?
-bool MegaClient::slotavail() const
+void MegaClient::waitsc()
 {
-    return tslots.size() < MAXTRANSFERS;
+    if (scwriting)
+    {
+        workerpool->waitfor(scwriting);
+
+        // withdrawn before it started
+        if (!scwriting->finished)
+        {
+            scwriting->run();
+        }
+
+        scwritten();
+    }
+
+    if (scpending)
+    {
+        scwriting = scpending;
+        scpending = NULL;
+        scwriting->run();
+        scwritten();
+    }
 }
 
-// returns 1 if more transfers of the requested type can be dispatched
-// (back-to-back overlap pipelining)
-// FIXME: support overlapped partial reads (and support partial reads in the
-// first place)
-bool MegaClient::moretransfers(direction_t d)
+// encrypt and write a snapshot pack
+bool MegaClient::putnodepack(string* pack, uint32_t id)
 {
-    m_off_t c = 0, r = 0;
-    dstime t = 0;
-    int total = 0;
+    bool complete;
 
-    // don't dispatch if all tslots busy
-    if (!slotavail())
+    DbTable::compress(pack);
+    PaddedCBC::encrypt(pack, &key);
+    complete = sctable->put(id, pack);
+    pack->clear();
+
+    return complete;
+}
+
+// record the removal of a node stored in the snapshot
+void MegaClient::encodetombstone(Node* n, string* data)
+{
+    data->assign((char*)&n->nodehandle, NODEHANDLE);
+    PaddedCBC::encrypt(data, &key);
+}
+
+uint64_t MegaClient::journalnext()
+{
+    if (!journalseq)
     {
-        return false;
+        journalseq = journalwritten = (uint64_t)time(NULL) << 24;
     }
 
-    // determine average speed and total amount of data remaining for the given
-    // direction
-    for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+    return journalseq;
+}
+
+void MegaClient::journalnodes()
+{
+    if (!nodenotify.size())
     {
-        if ((*it)->transfer->type == d)
-        {
-            if ((*it)->starttime)
-            {
-                t += Waiter::ds - (*it)->starttime;
-            }
+        return;
+    }
 
-            c += (*it)->progressreported;
-            r += (*it)->transfer->size - (*it)->progressreported;
-            total++;
-        }
+    journalnext();
+
+    for (node_vector::iterator it = nodenotify.begin(); it != nodenotify.end(); it++)
+    {
+        Node* n = *it;
+        NodeChange c;
+
+        c.seq = journalseq++;
+        c.h = n->nodehandle;
+        c.changes = (int)n->changed.removed
+                  | n->changed.attrs << 1
+                  | n->changed.owner << 2
+                  | n->changed.ctime << 3
+                  | n->changed.fileattrstring << 4
+                  | n->changed.inshare << 5
+                  | n->changed.outshares << 6
+                  | n->changed.parent << 7
+                  | n->changed.pendingshares << 8;
+
+        journal.push_back(c);
     }
 
-    // always blindly dispatch transfers up to MINPIPELINE
-    if (r < MINPIPELINE)
+    while (journal.size() > MAXJOURNAL)
     {
-        return true;
+        journal.pop_front();
     }
+}
 
-    // otherwise, don't allow more than two concurrent transfers
-    if (total >= 2)
+// block record: number of the first entry, number of entries, then the
+// handle and changes of each
+void MegaClient::journalrecords(bool all, vector<uint32_t>* ids, vector<string>* data, vector<uint32_t>* dels)
+{
+    if (!journalseq || (!all && journalwritten == journalseq))
     {
-        return false;
+        return;
+    }
+
+    uint64_t oldest = journal.size() ? journal.front().seq : journalseq;
+
+    while (journalblocks.size() && journalblocks.begin()->first < oldest / JOURNALBLOCK)
+    {
+        dels->push_back(journalblocks.begin()->second);
+        journalblocks.erase(journalblocks.begin());
     }
 
-    // dispatch more if less than two seconds of transfers left (at least
-    // 5 seconds must have elapsed for precise speed indication)
-    if (t > 50)
+    // (the block of journalseq records the number of the next entry)
+    for (uint64_t b = (all ? oldest : max(journalwritten, oldest)) / JOURNALBLOCK; b <= journalseq / JOURNALBLOCK; b++)
     {
-        int bpds = (int)(c / t);
+        uint64_t first = max(b * JOURNALBLOCK, oldest);
+        uint32_t count = (uint32_t)(min((b + 1) * JOURNALBLOCK, journalseq) - first);
+        string d;
 
-        if (bpds > 100 && r / bpds < 20)
+        d.reserve(sizeof first + sizeof count + count * (NODEHANDLE + sizeof(uint16_t)));
+        d.append((char*)&first, sizeof first);
+        d.append((char*)&count, sizeof count);
+
+        for (uint64_t i = first - oldest; i < first - oldest + count; i++)
         {
-            return true;
+            uint16_t changes = (uint16_t)journal[i].changes;
+
+            d.append((char*)&journal[i].h, NODEHANDLE);
+            d.append((char*)&changes, sizeof changes);
+        }
+
+        PaddedCBC::encrypt(&d, &key);
+
+        map<uint64_t, uint32_t>::iterator it = journalblocks.find(b);
+
+        if (it == journalblocks.end())
+        {
+            it = journalblocks.insert(pair<uint64_t, uint32_t>(b, sctable->newid(CACHEDJOURNAL))).first;
         }
+
+        ids->push_back(it->second);
+        data->push_back(string());
+        data->back().swap(d);
     }
 
-    return false;
+    journalwritten = journalseq;
 }
 
-void MegaClient::dispatchmore(direction_t d)
+bool MegaClient::putjournal(bool all)
 {
-    // keep pipeline full by dispatching additional queued transfers, if
-    // appropriate and available
-    while (moretransfers(d) && dispatch(d));
+    vector<uint32_t> ids, dels;
+    vector<string> data;
+
+    journalrecords(all, &ids, &data, &dels);
+
+    return (!ids.size() || sctable->putmany(&ids[0], &data[0], ids.size()))
+        && (!dels.size() || sctable->delmany(&dels[0], dels.size()));
 }
 
-// server-client node update processing
-void MegaClient::sc_updatenode()
+// the entries are sorted and checked once all blocks are read
+void MegaClient::fetchjournal(uint32_t id, string* data)
 {
-    handle h = UNDEF;
-    handle u = 0;
-    const char* a = NULL;
-    m_time_t ts = -1;
+    uint64_t first;
+    uint32_t count;
+    const char* ptr = data->data();
+    const char* end = ptr + data->size();
 
-    for (;;)
+    if (data->size() < sizeof first + sizeof count)
+    {
+        LOG_warn << "Ignoring malformed journal record";
+        return;
+    }
+
+    first = MemAccess::get<uint64_t>(ptr);
+    ptr += sizeof first;
+    count = MemAccess::get<uint32_t>(ptr);
+    ptr += sizeof count;
+
+    if (count > JOURNALBLOCK || (size_t)(end - ptr) < count * (NODEHANDLE + sizeof(uint16_t)))
+    {
+        LOG_warn << "Ignoring malformed journal record";
+        return;
+    }
+
+    journalblocks[first / JOURNALBLOCK] = id;
+    journalseq = max(journalseq, first + count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        NodeChange c;
+
+        c.seq = first + i;
+        c.h = 0;
+        memcpy((char*)&c.h, ptr, NODEHANDLE);
+        ptr += NODEHANDLE;
+        c.changes = MemAccess::get<uint16_t>(ptr);
+        ptr += sizeof(uint16_t);
+
+        journal.push_back(c);
+    }
+}
+
+static bool journalorder(const MegaClient::NodeChange& a, const MegaClient::NodeChange& b)
+{
+    return a.seq < b.seq;
+}
+
+// only the consecutive entries up to the last one are kept
+void MegaClient::restorejournal()
+{
+    sort(journal.begin(), journal.end(), journalorder);
+
+    size_t i = journal.size();
+
+    if (i && journal[i - 1].seq + 1 == journalseq)
+    {
+        while (--i && journal[i - 1].seq + 1 == journal[i].seq);
+    }
+
+    if (i)
+    {
+        LOG_warn << "Incomplete node journal, dropping " << i << " entries";
+        journal.erase(journal.begin(), journal.begin() + i);
+    }
+
+    journalwritten = journalseq;
+}
+
+void MegaClient::clearjournal()
+{
+    journal.clear();
+    journalblocks.clear();
+    journalseq = 0;
+    journalwritten = 0;
+}
+
+// commit or purge local state cache
+void MegaClient::finalizesc(bool complete)
+{
+    if (complete)
+    {
+        sctable->commit();
+        Base64::atob(scsn, (byte*)&cachedscsn, sizeof cachedscsn);
+    }
+    else
+    {
+        sctable->abort();
+        sctable->truncate();
+
+        LOG_err << "Cache update DB write error - disabling caching";
+
+        delete sctable;
+        sctable = NULL;
+    }
+
+}
+
+// queue node file attribute for retrieval or cancel retrieval
+error MegaClient::getfa(Node* n, fatype t, int cancel, bool prefetch)
+{
+    // locate this file attribute type in the nodes's attribute string
+    handle fah;
+    int p, pp;
+
+    if (!(p = n->hasfileattribute(t)))
+    {
+        return API_ENOENT;
+    }
+
+    pp = p - 1;
+
+    while (pp && n->fileattrstring[pp - 1] >= '0' && n->fileattrstring[pp - 1] <= '9')
+    {
+        pp--;
+    }
+
+    if (p == pp)
+    {
+        return API_ENOENT;
+    }
+
+    if (Base64::atob(strchr(n->fileattrstring.c_str() + p, '*') + 1, (byte*)&fah, sizeof(fah)) != sizeof(fah))
+    {
+        return API_ENOENT;
+    }
+
+    int c = atoi(n->fileattrstring.c_str() + pp);
+
+    if (cancel)
+    {
+        // cancel a cache hit not delivered yet
+        for (deque<GfxCacheHit>::iterator it = gfxcachehits.begin(); it != gfxcachehits.end(); it++)
+        {
+            if (it->nodehandle == n->nodehandle && it->type == t)
+            {
+                gfxcachehits.erase(it);
+                return API_OK;
+            }
+        }
+
+        // cancel pending request
+        fafc_map::iterator cit;
+
+        if ((cit = fafcs.find(c)) != fafcs.end())
+        {
+            faf_map::iterator it;
+
+            for (int i = 2; i--; )
+            {
+                if ((it = cit->second->fafs[i].find(fah)) != cit->second->fafs[i].end())
+                {
+                    delete it->second;
+                    cit->second->fafs[i].erase(it);
+
+                    // none left: tear down connection
+                    if (!cit->second->fafs[1].size() && cit->second->req.status == REQ_INFLIGHT)
+                    {
+                        cit->second->req.disconnect();
+                    }
+
+                    return API_OK;
+                }
+            }
+        }
+
+        return API_ENOENT;
+    }
+    else
+    {
+        string data;
+
+        // served locally
+        if (gfxcache.get(n, t, &data))
+        {
+            gfxcachehits.resize(gfxcachehits.size() + 1);
+
+            GfxCacheHit* hit = &gfxcachehits.back();
+
+            hit->nodehandle = n->nodehandle;
+            hit->type = t;
+            hit->tag = reqtag;
+            hit->data.swap(data);
+
+            return API_OK;
+        }
+
+        // add file attribute cluster channel and set cluster reference node handle
+        FileAttributeFetchChannel** fafcp = &fafcs[c];
+
+        if (!*fafcp)
+        {
+            *fafcp = new FileAttributeFetchChannel();
+        }
+
+        if (!(*fafcp)->fafs[1].count(fah))
+        {
+            (*fafcp)->fahref = fah;
+
+            // map returned handle to type/node upon retrieval response
+            FileAttributeFetch** fafp = &(*fafcp)->fafs[0][fah];
+
+            if (!*fafp)
+            {
+                *fafp = new FileAttributeFetch(n->nodehandle, t, reqtag,
+                                               prefetch ? FileAttributeFetch::PREFETCH : FileAttributeFetch::VISIBLE);
+            }
+            else
+            {
+                if (!prefetch)
+                {
+                    (*fafp)->priority = FileAttributeFetch::VISIBLE;
+                }
+
+                // a request takes over a prefetch without one
+                if (!(*fafp)->tag)
+                {
+                    (*fafp)->tag = reqtag;
+                    return API_OK;
+                }
+
+                restag = (*fafp)->tag;
+                return API_EEXIST;
+            }
+        }
+        else
+        {
+            FileAttributeFetch** fafp = &(*fafcp)->fafs[1][fah];
+
+            if (!prefetch)
+            {
+                (*fafp)->priority = FileAttributeFetch::VISIBLE;
+            }
+
+            if (!(*fafp)->tag)
+            {
+                (*fafp)->tag = reqtag;
+                return API_OK;
+            }
+
+            restag = (*fafp)->tag;
+            return API_EEXIST;
+        }
+
+        return API_OK;
+    }
+}
+
+void MegaClient::prefetchthumbnails(const handle_vector* handles)
+{
+    if (!gfxcache.enabled())
+    {
+        return;
+    }
+
+    int creqtag = reqtag;
+    unsigned queued = 0;
+    Node* n;
+
+    reqtag = 0;
+
+    for (unsigned i = 0; i < handles->size(); i++)
+    {
+        if ((n = nodebyhandle((*handles)[i])) && n->type == FILENODE && n->isvalid
+         && n->hasfileattribute(GfxProc::THUMBNAIL120X120)
+         && !gfxcache.has(n, GfxProc::THUMBNAIL120X120)
+         && getfa(n, GfxProc::THUMBNAIL120X120, 0, true) == API_OK)
+        {
+            queued++;
+        }
+    }
+
+    reqtag = creqtag;
+
+    if (queued)
+    {
+        LOG_debug << "Prefetching " << queued << " thumbnails";
+    }
+}
+
+// build pending attribute string for this handle and remove
+void MegaClient::pendingattrstring(handle h, string* fa)
+{
+    char buf[128];
+
+    for (fa_map::iterator it = pendingfa.lower_bound(pair<handle, fatype>(h, 0));
+         it != pendingfa.end() && it->first.first == h; )
+    {
+        sprintf(buf, "/%u*", (unsigned)it->first.second);
+        Base64::btoa((byte*)&it->second.first, sizeof(it->second.first), strchr(buf + 3, 0));
+        pendingfa.erase(it++);
+        fa->append(buf + !fa->size());
+    }
+}
+
+// attach file attribute to a file (th can be upload or node handle)
+// FIXME: to avoid unnecessary roundtrips to the attribute servers, also cache locally
+void MegaClient::putfa(handle th, fatype t, SymmCipher* key, string* data)
+{
+    // CBC-encrypt attribute data (padded to next multiple of BLOCKSIZE)
+    data->resize((data->size() + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE);
+    key->cbc_encrypt((byte*)data->data(), data->size());
+
+    newfa.push_back(new HttpReqCommandPutFA(this, th, t, data));
+
+    // not backing off? request its upload URL with the current API batch
+    if (btpfa.armed())
+    {
+        dispatchputfa();
+    }
+}
+
+// the upload URL requests of all dispatched attributes go out in the same
+// API request, and each POST starts as soon as its URL arrives
+void MegaClient::dispatchputfa()
+{
+    while (newfa.size() && activefa.size() < MAXPUTFA)
+    {
+        HttpReqCommandPutFA* fa = newfa.front();
+
+        // the request and response buffers hold about twice the data
+        if (!fa->reservation.reserve(&inflight, 2 * (m_off_t)fa->data->size()))
+        {
+            break;
+        }
+
+        newfa.pop_front();
+        activefa.push_back(fa);
+
+        fa->status = REQ_INFLIGHT;
+        reqs[r].add(fa);
+    }
+}
+
+// has the limit of concurrent transfer tslots been reached? (the small-file
+// lane has its own limit)
+bool MegaClient::slotavail() const
+{
+    return tslots.size() < MAXTRANSFERS + smalluploads;
+}
+
+bool MegaClient::smallslotavail() const
+{
+    return smalluploads < MAXSMALLUPLOADS;
+}
+
+void MegaClient::setnetifs(const char* list)
+{
+    netifs.clear();
+
+    while (list && *list)
+    {
+        const char* end = strchr(list, ',');
+        string item(list, end ? end - list : strlen(list));
+        size_t eq = item.find('=');
+        NetInterface ni;
+
+        ni.name = item.substr(0, eq);
+        ni.weight = eq == string::npos ? 0 : atoi(item.c_str() + eq + 1);
+        ni.throughput = 0;
+        ni.failures = 0;
+        ni.retryds = 0;
+
+        size_t first = ni.name.find_first_not_of(" ");
+        ni.name.erase(0, first);
+        ni.name.erase(ni.name.find_last_not_of(" ") + 1);
+
+        if (ni.name.size())
+        {
+            LOG_debug << "Chunk interface: " << ni.name << " (weight " << ni.weight << ")";
+            netifs.push_back(ni);
+        }
+
+        list = end ? end + 1 : NULL;
+    }
+}
+
+int MegaClient::picknetif()
+{
+    if (!netifs.size())
+    {
+        return -1;
+    }
+
+    // chunk requests in flight per interface
+    vector<int> inflight(netifs.size(), 0);
+
+    for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+    {
+        for (int i = (*it)->connections; i--; )
+        {
+            HttpReqXfer* req = (*it)->reqs[i];
+
+            if (req && req->status == REQ_INFLIGHT && req->netifindex >= 0 && req->netifindex < (int)netifs.size())
+            {
+                inflight[req->netifindex]++;
+            }
+        }
+    }
+
+    // weights apply if any is set, otherwise the measured throughput (an
+    // interface not measured yet counts as average)
+    bool weighted = false;
+    m_off_t total = 0;
+    int measured = 0;
+
+    for (unsigned i = 0; i < netifs.size(); i++)
+    {
+        weighted |= netifs[i].weight > 0;
+
+        if (netifs[i].throughput)
+        {
+            total += netifs[i].throughput;
+            measured++;
+        }
+    }
+
+    m_off_t average = measured ? total / measured : 1;
+    int best = -1;
+    double bestload = 0;
+
+    for (unsigned i = 0; i < netifs.size(); i++)
+    {
+        NetInterface* ni = &netifs[i];
+
+        if (ni->retryds > Waiter::ds)
+        {
+            continue;
+        }
+
+        double share = weighted ? (ni->weight > 0 ? ni->weight : 1)
+                                : (double)(ni->throughput ? ni->throughput : average);
+        double load = (inflight[i] + 1) / share;
+
+        if (best < 0 || load < bestload)
+        {
+            best = i;
+            bestload = load;
+        }
+    }
+
+    // all failing: the one to be retried first
+    if (best < 0)
+    {
+        best = 0;
+
+        for (unsigned i = 1; i < netifs.size(); i++)
+        {
+            if (netifs[i].retryds < netifs[best].retryds)
+            {
+                best = i;
+            }
+        }
+    }
+
+    return best;
+}
+
+void MegaClient::netifdone(int i, m_off_t bytes, dstime elapsed, bool ok)
+{
+    if (i < 0 || i >= (int)netifs.size())
+    {
+        return;
+    }
+
+    NetInterface* ni = &netifs[i];
+
+    if (ok)
+    {
+        m_off_t rate = bytes * 10 / (elapsed ? elapsed : 1);
+
+        ni->throughput = ni->throughput ? (ni->throughput * 3 + rate) / 4 : rate;
+        ni->failures = 0;
+        ni->retryds = 0;
+    }
+    else
+    {
+        // 2 s, doubling with each failure, then a minute
+        ni->failures++;
+        ni->retryds = Waiter::ds + (ni->failures < 5 ? 10 << ni->failures : 600);
+        LOG_warn << "Chunk request through " << ni->name << " failed, avoiding it for a while";
+    }
+}
+
+bool MegaClient::smallupload(const Transfer* t)
+{
+    return t->type == PUT && t->size <= SMALLFILESIZE;
+}
+
+// completed small uploads are committed together: the queue is flushed
+// whenever no API request is in flight, so all uploads that complete while
+// one is pending share a single putnodes per target folder
+void MegaClient::queueputnodes(handle th, NewNode* newnode, int tag)
+{
+    batchedputnodes[th].push_back(pair<int, NewNode*>(tag, newnode));
+}
+
+void MegaClient::execputnodes()
+{
+    for (map<handle, vector<pair<int, NewNode*> > >::iterator it = batchedputnodes.begin();
+         it != batchedputnodes.end(); it++)
+    {
+        vector<pair<int, NewNode*> >* batch = &it->second;
+        handle th = it->first;
+
+        // target folder vanished in the meantime - use / instead
+        if (!nodebyhandle(th))
+        {
+            th = rootnodes[0];
+        }
+
+        for (unsigned start = 0; start < batch->size(); start += MAXPUTNODESBATCH)
+        {
+            unsigned count = (unsigned)batch->size() - start;
+
+            if (count > MAXPUTNODESBATCH)
+            {
+                count = MAXPUTNODESBATCH;
+            }
+
+            NewNode* newnodes = new NewNode[count];
+            vector<int> tags;
+
+            for (unsigned i = 0; i < count; i++)
+            {
+                NewNode* queued = (*batch)[start + i].second;
+                NewNode* nn = newnodes + i;
+
+                nn->source = queued->source;
+                nn->type = queued->type;
+                nn->nodehandle = queued->nodehandle;
+                nn->parenthandle = queued->parenthandle;
+                nn->uploadhandle = queued->uploadhandle;
+                memcpy(nn->uploadtoken, queued->uploadtoken, sizeof nn->uploadtoken);
+                nn->nodekey.swap(queued->nodekey);
+
+                // take over the encrypted attributes
+                nn->attrstring = queued->attrstring;
+                queued->attrstring = NULL;
+
+                tags.push_back((*batch)[start + i].first);
+                delete[] queued;
+            }
+
+            LOG_debug << "Committing " << count << " small uploads";
+
+            CommandPutNodes* cmd = new CommandPutNodes(this, th, NULL, newnodes, count, nextreqtag());
+            cmd->batchtags.swap(tags);
+            reqs[r].add(cmd);
+        }
+    }
+
+    batchedputnodes.clear();
+}
+
+// fan a batched putnodes result out to the uploads it commits - each gets
+// its own single-record result under its transfer's tag
+void MegaClient::putnodes_batch_result(error e, targettype_t t, NewNode* nn, int nnsize, vector<int>* tags)
+{
+    int creqtag = restag;
+
+    for (int i = 0; i < nnsize && i < (int)tags->size(); i++)
+    {
+        NewNode* result = new NewNode[1];
+
+        result->source = nn[i].source;
+        result->type = nn[i].type;
+        result->uploadhandle = nn[i].uploadhandle;
+        result->added = !e && nn[i].added;
+        result->addedhandle = nn[i].addedhandle;
+
+        restag = (*tags)[i];
+        app->putnodes_result(e ? e : (result->added ? API_OK : API_EINTERNAL), t, result);
+    }
+
+    restag = creqtag;
+
+    delete[] nn;
+}
+
+// a record joins its parent's batch while that has room, otherwise it goes
+// to a batch created in its parent's node
+void MegaClient::putnodestree(handle th, NewNode* newnodes, int numnodes)
+{
+    PutNodesTree* tree = new PutNodesTree;
+    map<handle, int> records;
+    map<int, int> openbatch;
+
+    tree->nn = newnodes;
+    tree->nnsize = numnodes;
+    tree->target = th;
+    tree->tag = reqtag;
+    tree->e = API_OK;
+    tree->parents.resize(numnodes);
+    tree->batchof.resize(numnodes);
+
+    for (int i = 0; i < numnodes; i++)
+    {
+        map<handle, int>::iterator it = records.find(newnodes[i].parenthandle);
+        int p = (ISUNDEF(newnodes[i].parenthandle) || it == records.end()) ? -1 : it->second;
+        int b;
+
+        tree->parents[i] = p;
+
+        if (p >= 0 && tree->batches[tree->batchof[p]].records.size() < PUTNODESTREEBATCH)
+        {
+            b = tree->batchof[p];
+        }
+        else
+        {
+            map<int, int>::iterator bit = openbatch.find(p);
+
+            if (bit != openbatch.end() && tree->batches[bit->second].records.size() < PUTNODESTREEBATCH)
+            {
+                b = bit->second;
+            }
+            else
+            {
+                b = tree->batches.size();
+                tree->batches.push_back(PutNodesTree::Batch());
+                tree->batches[b].parent = p;
+                openbatch[p] = b;
+            }
+        }
+
+        tree->batches[b].records.push_back(i);
+        tree->batchof[i] = b;
+
+        if (!ISUNDEF(newnodes[i].nodehandle))
+        {
+            records[newnodes[i].nodehandle] = i;
+        }
+    }
+
+    if (!tree->batches.size())
+    {
+        delete tree;
+        restag = reqtag;
+        return app->putnodes_result(API_EARGS, NODE_HANDLE, newnodes);
+    }
+
+    LOG_debug << "Creating " << numnodes << " nodes in " << tree->batches.size() << " batches";
+
+    tree->pending = tree->batches.size();
+    putnodestrees.insert(tree);
+
+    for (unsigned i = 0; i < tree->batches.size(); i++)
+    {
+        if (tree->batches[i].parent < 0)
+        {
+            sendputnodesbatch(tree, i);
+        }
+    }
+}
+
+void MegaClient::sendputnodesbatch(PutNodesTree* tree, int b)
+{
+    PutNodesTree::Batch* batch = &tree->batches[b];
+    handle th = tree->target;
+
+    if (batch->parent >= 0)
+    {
+        if (!tree->nn[batch->parent].added)
+        {
+            // the parent could not be created
+            return putnodes_tree_result(API_EINCOMPLETE, tree, b, NULL, 0);
+        }
+
+        th = tree->nn[batch->parent].addedhandle;
+    }
+
+    NewNode* newnodes = new NewNode[batch->records.size()];
+
+    for (unsigned i = 0; i < batch->records.size(); i++)
+    {
+        int record = batch->records[i];
+        NewNode* queued = tree->nn + record;
+        NewNode* nn = newnodes + i;
+        int p = tree->parents[record];
+
+        nn->source = queued->source;
+        nn->type = queued->type;
+        nn->nodehandle = queued->nodehandle;
+        nn->parenthandle = (p >= 0 && tree->batchof[p] == b) ? queued->parenthandle : UNDEF;
+        nn->uploadhandle = queued->uploadhandle;
+        memcpy(nn->uploadtoken, queued->uploadtoken, sizeof nn->uploadtoken);
+        nn->nodekey = queued->nodekey;
+
+        // take over the encrypted attributes
+        nn->attrstring = queued->attrstring;
+        queued->attrstring = NULL;
+    }
+
+    CommandPutNodes* cmd = new CommandPutNodes(this, th, NULL, newnodes, batch->records.size(), tree->tag);
+    cmd->tree = tree;
+    cmd->treebatch = b;
+    reqs[r].add(cmd);
+}
+
+// record the result of a batch, release the batches created in its nodes
+// and report the tree once all batches have completed
+void MegaClient::putnodes_tree_result(error e, PutNodesTree* tree, int b, NewNode* nn, int nnsize)
+{
+    PutNodesTree::Batch* batch = &tree->batches[b];
+
+    for (int i = 0; i < nnsize && i < (int)batch->records.size(); i++)
+    {
+        NewNode* record = tree->nn + batch->records[i];
+
+        record->added = !e && nn[i].added;
+        record->addedhandle = nn[i].addedhandle;
+    }
+
+    delete[] nn;
+
+    if (e && !tree->e)
+    {
+        tree->e = e;
+    }
+
+    for (unsigned i = 0; i < tree->batches.size(); i++)
+    {
+        if (tree->batches[i].parent >= 0 && tree->batchof[tree->batches[i].parent] == b)
+        {
+            sendputnodesbatch(tree, i);
+        }
+    }
+
+    if (!--tree->pending)
+    {
+        int creqtag = restag;
+
+        putnodestrees.erase(tree);
+
+        restag = tree->tag;
+        app->putnodes_result(tree->e, NODE_HANDLE, tree->nn);
+        restag = creqtag;
+
+        delete tree;
+    }
+}
+
+// set the bounds for the adaptive per-transfer connection count - the
+// initial connection count is clamped into the new range
+void MegaClient::setconnectionlimits(direction_t d, int minc, int maxc)
+{
+    if (minc < 1)
+    {
+        minc = 1;
+    }
+
+    if (maxc > MAXCONNECTIONS)
+    {
+        maxc = MAXCONNECTIONS;
+    }
+
+    if (maxc < minc)
+    {
+        maxc = minc;
+    }
+
+    minconnections[d] = minc;
+    maxconnections[d] = maxc;
+
+    if (connections[d] < minc)
+    {
+        connections[d] = minc;
+    }
+    else if (connections[d] > maxc)
+    {
+        connections[d] = maxc;
+    }
+}
+
+void MegaClient::dispatchmore(direction_t d)
+{
+    // keep pipeline full by dispatching additional queued transfers, if
+    // appropriate and available
+    while (scheduler.more(d) && dispatch(d, TransferScheduler::LANE_REGULAR));
+
+    // the small-file lane is not subject to the active transfer limit
+    if (d == PUT)
+    {
+        while (dispatch(d, TransferScheduler::LANE_SMALL));
+    }
+
+    prefetchurls(d);
+}
+
+void MegaClient::prefetchurls(direction_t d)
+{
+    if (lastprefetch[d] == Waiter::ds || !scheduler.queued(d))
+    {
+        return;
+    }
+
+    lastprefetch[d] = Waiter::ds;
+
+    transfer_vector upcoming;
+
+    scheduler.upcoming(d, TEMPURLPREFETCH, &upcoming);
+
+    // the requests go out together in the next API batch
+    for (transfer_vector::iterator it = upcoming.begin(); it != upcoming.end(); it++)
+    {
+        Transfer* t = *it;
+        handle h;
+        bool hprivate;
+        const char* auth;
+
+        if (t->tempurlcmd || t->tempurlvalid())
+        {
+            continue;
+        }
+
+        if (d == PUT)
+        {
+            if (t->size >= 0)
+            {
+                reqs[r].add(t->tempurlcmd = new CommandPutFile(t, putmbpscap));
+            }
+        }
+        else if (downloadsource(t, &h, &hprivate, &auth))
+        {
+            reqs[r].add(t->tempurlcmd = new CommandGetFile(t, h, hprivate, auth));
+        }
+    }
+}
+
+bool MegaClient::downloadsource(Transfer* t, handle* h, bool* hprivate, const char** auth)
+{
+    for (file_list::iterator it = t->files.begin(); it != t->files.end(); it++)
+    {
+        if (!(*it)->hprivate || nodebyhandle((*it)->h))
+        {
+            *h = (*it)->h;
+            *hprivate = (*it)->hprivate;
+            *auth = (*it)->auth.size() ? (*it)->auth.c_str() : NULL;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// server-client node update processing
+void MegaClient::sc_updatenode()
+{
+    handle h = UNDEF;
+    handle u = 0;
+    const char* a = NULL;
+    m_time_t ts = -1;
+
+    for (;;)
     {
         switch (jsonsc.getnameid())
         {
@@ -3223,6 +5097,11 @@ void MegaClient::sc_userattr()
                         {
                             while (jsonsc.storeobject(&ua))
                             {
+                                if (u->uacache.erase(ua))
+                                {
+                                    notifyuser(u);
+                                }
+
                                 if (ua[0] == '+')
                                 {
                                     app->userattr_update(u, 0, ua.c_str() + 1);
@@ -3576,6 +5455,12 @@ void MegaClient::sc_upc()
 void MegaClient::notifypurge(void)
 {
     int i, t;
+    bool snapshot = false;
+
+    if (scburstdeferred())
+    {
+        return;
+    }
 
     handle tscsn = cachedscsn;
 
@@ -3583,8 +5468,13 @@ void MegaClient::notifypurge(void)
 
     if (nodenotify.size() || usernotify.size() || pcrnotify.size() || cachedscsn != tscsn)
     {
+        journalnodes();
         updatesc();
 
+        // the changes outgrew the snapshot: rewrite it once the removed
+        // nodes are gone
+        snapshot = sctable && scdelta > SNAPSHOTMINDELTA && scdelta > nodes.size() / 2;
+
 #ifdef ENABLE_SYNC
         // update LocalNode <-> Node associations
         for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
@@ -3613,8 +5503,11 @@ void MegaClient::notifypurge(void)
 
         app->nodes_updated(&nodenotify[0], t);
 
-        // check all notified nodes for removed status and purge
-        for (i = 0; i < t; i++)
+        // check all notified nodes for removed status and purge - in reverse,
+        // as deleted subtrees are notified bottom-up: a deleted folder is
+        // detached from its parent once, and its children then only have to
+        // be freed rather than unlinked one by one
+        for (i = t; i--; )
         {
             Node* n = nodenotify[i];
             if (n->attrstring)
@@ -3680,6 +5573,12 @@ void MegaClient::notifypurge(void)
         app->users_updated(&usernotify[0], t);
         usernotify.clear();
     }
+
+    if (snapshot)
+    {
+        LOG_debug << "Rewriting the local cache snapshot after " << scdelta << " changes";
+        initsc();
+    }
 }
 
 // return node pointer derived from node handle
@@ -3776,6 +5675,8 @@ error MegaClient::setattr(Node* n, const char** newattr, const char *prevattr)
         return API_EKEY;
     }
 
+    n->resolveattrs();
+
     if (newattr)
     {
         while (*newattr)
@@ -3785,6 +5686,8 @@ error MegaClient::setattr(Node* n, const char** newattr, const char *prevattr)
         }
     }
 
+    n->nameupdated();
+
     n->changed.attrs = true;
     notifynode(n);
 
@@ -3928,12 +5831,142 @@ error MegaClient::rename(Node* n, Node* p, syncdel_t syncdel, handle prevparent)
         // rewrite keys of foreign nodes that are moved out of an outbound share
         rewriteforeignkeys(n);
 
-        reqs[r].add(new CommandMoveNode(this, n, p, syncdel, prevparent));
+        CommandMoveNode* cmd = new CommandMoveNode(this, n, p, syncdel, prevparent);
+
+#ifdef ENABLE_SYNC
+        if (syncdel != SYNCDEL_NONE || prevparent != UNDEF)
+        {
+            if (!movebatch || movebatch->moves.size() >= MAXMOVEBATCH)
+            {
+                movebatch = new MoveBatch;
+                movebatch->pending = 0;
+                movebatches.insert(movebatch);
+            }
+
+            MoveBatch::Move move;
+
+            move.h = n->nodehandle;
+            move.pp = prevparent;
+            move.syncdel = syncdel;
+            move.tag = reqtag;
+            move.e = API_OK;
+
+            cmd->batch = movebatch;
+            cmd->batchindex = movebatch->moves.size();
+
+            movebatch->moves.push_back(move);
+            movebatch->pending++;
+        }
+#endif
+
+        reqs[r].add(cmd);
     }
 
     return API_OK;
 }
 
+#ifdef ENABLE_SYNC
+// update the todebris records below the nodes moved successfully (the
+// nearest moved ancestor applies), report the moves and their results
+void MegaClient::movebatch_result(MoveBatch* batch)
+{
+    map<handle, MoveBatch::Move*> moved;
+    int creqtag = restag;
+
+    if (movebatch == batch)
+    {
+        movebatch = NULL;
+    }
+
+    movebatches.erase(batch);
+
+    for (unsigned i = 0; i < batch->moves.size(); i++)
+    {
+        MoveBatch::Move* move = &batch->moves[i];
+        Node* n;
+
+        if (move->syncdel != SYNCDEL_NONE && (n = nodebyhandle(move->h)))
+        {
+            if (move->e == API_OK)
+            {
+                moved[move->h] = move;
+            }
+            else
+            {
+                n->syncdeleted = SYNCDEL_NONE;
+            }
+        }
+    }
+
+    if (moved.size())
+    {
+        for (node_set::iterator it = todebris.begin(); it != todebris.end(); it++)
+        {
+            for (Node* n = *it; n; n = n->parent)
+            {
+                map<handle, MoveBatch::Move*>::iterator mit = moved.find(n->nodehandle);
+
+                if (mit != moved.end())
+                {
+                    Sync* sync;
+
+                    if (mit->second->pp != UNDEF && (sync = syncbytag(mit->second->tag)))
+                    {
+                        if (n->type == FOLDERNODE)
+                        {
+                            app->syncupdate_remote_folder_deletion(sync, n);
+                        }
+                        else
+                        {
+                            app->syncupdate_remote_file_deletion(sync, n);
+                        }
+                    }
+
+                    (*it)->syncdeleted = mit->second->syncdel;
+                    break;
+                }
+            }
+        }
+    }
+
+    for (unsigned i = 0; i < batch->moves.size(); i++)
+    {
+        MoveBatch::Move* move = &batch->moves[i];
+
+        if (move->syncdel == SYNCDEL_NONE)
+        {
+            Node* n;
+            Sync* sync;
+
+            if ((n = nodebyhandle(move->h)) && (sync = syncbytag(move->tag)))
+            {
+                app->syncupdate_remote_move(sync, n, nodebyhandle(move->pp));
+            }
+        }
+
+        restag = move->tag;
+        app->rename_result(move->h, move->e);
+    }
+
+    restag = creqtag;
+
+    delete batch;
+}
+
+Sync* MegaClient::syncbytag(int tag)
+{
+    for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
+    {
+        if ((*it)->tag == tag)
+        {
+            return *it;
+        }
+    }
+
+    return NULL;
+}
+#endif
+
 // delete node tree
 error MegaClient::unlink(Node* n)
 {
@@ -4032,364 +6065,630 @@ char* MegaClient::str_to_a32(const char* str, int* len)
             delete[] result;
             return NULL;
         }
-
-        a32[j >> 2] |= htonl(unicode << (24 - (j & 3) * 8));
-        j++;
+
+        a32[j >> 2] |= htonl(unicode << (24 - (j & 3) * 8));
+        j++;
+    }
+
+    *len = j;
+    return result;
+}
+
+// compute UTF-8 password hash
+error MegaClient::pw_key(const char* utf8pw, byte* key)
+{
+    int t;
+    char* pw;
+
+    if (!(pw = str_to_a32(utf8pw, &t)))
+    {
+        return API_EARGS;
+    }
+
+    int n = (t + 15) / 16;
+    SymmCipher* keys = new SymmCipher[n];
+
+    for (int i = 0; i < n; i++)
+    {
+        int valid = (i != (n - 1)) ? SymmCipher::BLOCKSIZE : (t - SymmCipher::BLOCKSIZE * i);
+        memcpy(key, pw + i * SymmCipher::BLOCKSIZE, valid);
+        memset(key + valid, 0, SymmCipher::BLOCKSIZE - valid);
+        keys[i].setkey(key);
+    }
+
+    memcpy(key, "\x93\xC4\x67\xE3\x7D\xB0\xC7\xA4\xD1\xBE\x3F\x81\x01\x52\xCB\x56", SymmCipher::BLOCKSIZE);
+
+    for (int r = 65536; r--; )
+    {
+        for (int i = 0; i < n; i++)
+        {
+            keys[i].ecb_encrypt(key);
+        }
+    }
+
+    delete[] keys;
+    delete[] pw;
+
+    return API_OK;
+}
+
+void MegaClient::loadbalancing(const char* service)
+{
+    loadbalancingreqs.push(new CommandLoadBalancing(this, service));
+}
+
+// compute generic string hash
+void MegaClient::stringhash(const char* s, byte* hash, SymmCipher* cipher)
+{
+    int t;
+
+    t = strlen(s) & - SymmCipher::BLOCKSIZE;
+
+    strncpy((char*)hash, s + t, SymmCipher::BLOCKSIZE);
+
+    while (t)
+    {
+        t -= SymmCipher::BLOCKSIZE;
+        SymmCipher::xorblock((byte*)s + t, hash);
+    }
+
+    for (t = 16384; t--; )
+    {
+        cipher->ecb_encrypt(hash);
+    }
+
+    memcpy(hash + 4, hash + 8, 4);
+}
+
+// (transforms s to lowercase)
+uint64_t MegaClient::stringhash64(string* s, SymmCipher* c)
+{
+    byte hash[SymmCipher::KEYLENGTH];
+
+    transform(s->begin(), s->end(), s->begin(), ::tolower);
+    stringhash(s->c_str(), hash, c);
+
+    return MemAccess::get<uint64_t>((const char*)hash);
+}
+
+// increment a request ID
+void MegaClient::nextreqid(char* id, int len)
+{
+    for (int i = len; i--; )
+    {
+        if (id[i]++ < 'z')
+        {
+            break;
+        }
+        else
+        {
+            id[i] = 'a';
+        }
+    }
+}
+
+// should the queued commands be sent now?
+bool MegaClient::csbatchready()
+{
+    int pending = reqs[r].cmdspending();
+
+    if (!pending)
+    {
+        csbatchstart = NEVER;
+        return false;
+    }
+
+    if (pending >= MAXCSBATCH)
+    {
+        return true;
+    }
+
+    // not part of a burst: no point in waiting
+    if (lastcsbatch < 2 || Waiter::ds - lastcssent > CSBURSTINTERVAL)
+    {
+        return true;
+    }
+
+    if (csbatchstart == NEVER)
+    {
+        csbatchstart = Waiter::ds;
+    }
+
+    return Waiter::ds >= csbatchstart + CSBATCHWINDOW;
+}
+
+void MegaClient::execpipelinedcs()
+{
+    // (the results share json with a result array processed in slices)
+    if (pipelinedcs && !(pendingcs && reqs[r ^ 1].started()))
+    {
+        switch (pipelinedcs->status)
+        {
+            case REQ_SUCCESS:
+                if (*pipelinedcs->in.c_str() == '[')
+                {
+                    json.begin(pipelinedcs->in.c_str());
+                    pipelinereq.procresult(this);
+
+                    delete pipelinedcs;
+                    pipelinedcs = NULL;
+
+                    nextreqid(pipelinereqid, sizeof pipelinereqid);
+                    btpipelinecs.reset();
+                    break;
+                }
+
+                if (pipelinedcs->in != "-3" && pipelinedcs->in != "-4")
+                {
+                    error e = (error)atoi(pipelinedcs->in.c_str());
+
+                    app->request_error(e ? e : API_EINTERNAL);
+
+                    delete pipelinedcs;
+                    pipelinedcs = NULL;
+                    break;
+                }
+
+                // fall through
+            case REQ_FAILURE:
+                // repeat with capped exponential backoff
+                delete pipelinedcs;
+                pipelinedcs = NULL;
+
+                btpipelinecs.backoff();
+
+            default:
+                ;
+        }
+
+        if (pipelinedcs)
+        {
+            return;
+        }
+    }
+
+    if (!btpipelinecs.armed())
+    {
+        return;
+    }
+
+    if (!pipelinereq.cmdspending())
+    {
+        // without a request in flight, independent commands simply go with
+        // the next regular batch
+        if (!pendingcs)
+        {
+            return;
+        }
+
+        reqs[r].extractindependent(&pipelinereq);
+
+        if (!pipelinereq.cmdspending())
+        {
+            return;
+        }
     }
 
-    *len = j;
-    return result;
+    pipelinedcs = new HttpReq();
+
+    pipelinereq.get(pipelinedcs->out);
+
+    pipelinedcs->posturl = APIURL;
+    pipelinedcs->posturl.append("cs?id=");
+    pipelinedcs->posturl.append(pipelinereqid, sizeof pipelinereqid);
+    pipelinedcs->posturl.append(auth);
+    pipelinedcs->posturl.append(appkey);
+
+    pipelinedcs->type = REQ_JSON;
+    pipelinedcs->post(this);
 }
 
-// compute UTF-8 password hash
-error MegaClient::pw_key(const char* utf8pw, byte* key) const
+const char MegaClient::FNSTREAMPREFIX[] = "[{\"f\":[";
+
+bool MegaClient::streamfetchnodes()
 {
-    int t;
-    char* pw;
+    int64_t deadline = Waiter::us() + SLICEUS;
+    bool sliced = false;
 
-    if (!(pw = str_to_a32(utf8pw, &t)))
-    {
-        return API_EARGS;
-    }
+    httpio->lock();
 
-    int n = (t + 15) / 16;
-    SymmCipher* keys = new SymmCipher[n];
+    const char* start = pendingcs->data();
+    const char* end = start + pendingcs->size();
+    const char* ptr = start;
 
-    for (int i = 0; i < n; i++)
+    if (fnstream == FNSTREAM_PREFIX)
     {
-        int valid = (i != (n - 1)) ? SymmCipher::BLOCKSIZE : (t - SymmCipher::BLOCKSIZE * i);
-        memcpy(key, pw + i * SymmCipher::BLOCKSIZE, valid);
-        memset(key + valid, 0, SymmCipher::BLOCKSIZE - valid);
-        keys[i].setkey(key);
-    }
+        size_t len = sizeof FNSTREAMPREFIX - 1;
+        size_t avail = end - ptr;
 
-    memcpy(key, "\x93\xC4\x67\xE3\x7D\xB0\xC7\xA4\xD1\xBE\x3F\x81\x01\x52\xCB\x56", SymmCipher::BLOCKSIZE);
+        if (memcmp(ptr, FNSTREAMPREFIX, avail < len ? avail : len))
+        {
+            // not led by the node array (e.g. an error code)
+            fnstream = FNSTREAM_OFF;
+        }
 
-    for (int r = 65536; r--; )
-    {
-        for (int i = 0; i < n; i++)
+        if (fnstream == FNSTREAM_OFF || avail < len)
         {
-            keys[i].ecb_encrypt(key);
+            httpio->unlock();
+            return false;
         }
+
+        pendingcs->purge(len);
+        httpio->unlock();
+
+        // the response replaces the current state
+        purgenodesusersabortsc();
+        fnstream = FNSTREAM_NODES;
+
+        httpio->lock();
+
+        start = pendingcs->data();
+        end = start + pendingcs->size();
+        ptr = start;
     }
 
-    delete[] keys;
-    delete[] pw;
+    JSON j;
+    string record;
 
-    return API_OK;
-}
+    // the response may be incomplete: only complete records, followed by
+    // their separator, are parsed (from a NUL-terminated copy)
+    while (ptr < end && *ptr == '{')
+    {
+        const char* recordend = JSON::objectend(ptr, end);
 
-void MegaClient::loadbalancing(const char* service)
-{
-    loadbalancingreqs.push(new CommandLoadBalancing(this, service));
-}
+        if (!recordend || recordend == end)
+        {
+            break;
+        }
 
-// compute generic string hash
-void MegaClient::stringhash(const char* s, byte* hash, SymmCipher* cipher)
-{
-    int t;
+        record.assign(ptr, recordend - ptr);
+        j.begin(record.c_str());
+        j.enterobject();
 
-    t = strlen(s) & - SymmCipher::BLOCKSIZE;
+        if (!readnode(&j, 0, PUTNODES_APP, NULL, 0, 0, &fnstreamdp))
+        {
+            // leave the remainder to the regular parser, which will fail
+            fnstream = FNSTREAM_DONE;
+            break;
+        }
 
-    strncpy((char*)hash, s + t, SymmCipher::BLOCKSIZE);
+        ptr = recordend;
 
-    while (t)
-    {
-        t -= SymmCipher::BLOCKSIZE;
-        SymmCipher::xorblock((byte*)s + t, hash);
+        if (*ptr == ',')
+        {
+            ptr++;
+        }
+
+        if (Waiter::us() > deadline)
+        {
+            sliced = ptr < end && *ptr == '{';
+            break;
+        }
     }
 
-    for (t = 16384; t--; )
+    if (ptr < end && *ptr == ']')
     {
-        cipher->ecb_encrypt(hash);
+        fnstream = FNSTREAM_DONE;
     }
 
-    memcpy(hash + 4, hash + 8, 4);
+    pendingcs->purge(ptr - start);
+    httpio->unlock();
+
+    return sliced;
 }
 
-// (transforms s to lowercase)
-uint64_t MegaClient::stringhash64(string* s, SymmCipher* c)
+void MegaClient::endfetchnodesstream()
 {
-    byte hash[SymmCipher::KEYLENGTH];
+    Node* n;
 
-    transform(s->begin(), s->end(), s->begin(), ::tolower);
-    stringhash(s->c_str(), hash, c);
+    for (int i = fnstreamdp.size(); i--; )
+    {
+        if ((n = nodebyhandle(fnstreamdp[i]->parenthandle)))
+        {
+            fnstreamdp[i]->setparent(n);
+        }
+    }
 
-    return MemAccess::get<uint64_t>((const char*)hash);
+    fnstreamdp.clear();
 }
 
-// read and add/verify node array
-int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn, int nnsize, int tag)
+// read and add/verify a single node object (the opening brace has been
+// consumed) - nodes whose parent is not known yet are added to dp
+int MegaClient::readnode(JSON* j, int notify, putsource_t source, NewNode* nn, int nnsize, int tag, node_vector* dp)
 {
-    if (!j->enterarray())
-    {
-        return 0;
-    }
-
-    node_vector dp;
     Node* n;
 
-    while (j->enterobject())
-    {
-        handle h = UNDEF, ph = UNDEF;
-        handle u = 0, su = UNDEF;
-        nodetype_t t = TYPE_UNKNOWN;
-        const char* a = NULL;
-        const char* k = NULL;
-        const char* fa = NULL;
-        const char *sk = NULL;
-        accesslevel_t rl = ACCESS_UNKNOWN;
-        m_off_t s = NEVER;
-        m_time_t ts = -1, sts = -1;
-        nameid name;
-        int nni = -1;
+    handle h = UNDEF, ph = UNDEF;
+    handle u = 0, su = UNDEF;
+    nodetype_t t = TYPE_UNKNOWN;
+    const char* a = NULL;
+    const char* k = NULL;
+    const char* fa = NULL;
+    const char *sk = NULL;
+    accesslevel_t rl = ACCESS_UNKNOWN;
+    m_off_t s = NEVER;
+    m_time_t ts = -1, sts = -1;
+    nameid name;
+    int nni = -1;
 
-        while ((name = j->getnameid()) != EOO)
+    while ((name = j->getnameid()) != EOO)
+    {
+        switch (name)
         {
-            switch (name)
-            {
-                case 'h':   // new node: handle
-                    h = j->gethandle();
-                    break;
+            case 'h':   // new node: handle
+                h = j->gethandle();
+                break;
 
-                case 'p':   // parent node
-                    ph = j->gethandle();
-                    break;
+            case 'p':   // parent node
+                ph = j->gethandle();
+                break;
 
-                case 'u':   // owner user
-                    u = j->gethandle(USERHANDLE);
-                    break;
+            case 'u':   // owner user
+                u = j->gethandle(USERHANDLE);
+                break;
 
-                case 't':   // type
-                    t = (nodetype_t)j->getint();
-                    break;
+            case 't':   // type
+                t = (nodetype_t)j->getint();
+                break;
 
-                case 'a':   // attributes
-                    a = j->getvalue();
-                    break;
+            case 'a':   // attributes
+                a = j->getvalue();
+                break;
 
-                case 'k':   // key(s)
-                    k = j->getvalue();
-                    break;
+            case 'k':   // key(s)
+                k = j->getvalue();
+                break;
 
-                case 's':   // file size
-                    s = j->getint();
-                    break;
+            case 's':   // file size
+                s = j->getint();
+                break;
 
-                case 'i':   // related source NewNode index
-                    nni = j->getint();
-                    break;
+            case 'i':   // related source NewNode index
+                nni = j->getint();
+                break;
 
-                case MAKENAMEID2('t', 's'):  // actual creation timestamp
-                    ts = j->getint();
-                    break;
+            case MAKENAMEID2('t', 's'):  // actual creation timestamp
+                ts = j->getint();
+                break;
 
-                case MAKENAMEID2('f', 'a'):  // file attributes
-                    fa = j->getvalue();
-                    break;
+            case MAKENAMEID2('f', 'a'):  // file attributes
+                fa = j->getvalue();
+                break;
 
-                    // inbound share attributes
-                case 'r':   // share access level
-                    rl = (accesslevel_t)j->getint();
-                    break;
+                // inbound share attributes
+            case 'r':   // share access level
+                rl = (accesslevel_t)j->getint();
+                break;
 
-                case MAKENAMEID2('s', 'k'):  // share key
-                    sk = j->getvalue();
-                    break;
+            case MAKENAMEID2('s', 'k'):  // share key
+                sk = j->getvalue();
+                break;
 
-                case MAKENAMEID2('s', 'u'):  // sharing user
-                    su = j->gethandle(USERHANDLE);
-                    break;
+            case MAKENAMEID2('s', 'u'):  // sharing user
+                su = j->gethandle(USERHANDLE);
+                break;
 
-                case MAKENAMEID3('s', 't', 's'):  // share timestamp
-                    sts = j->getint();
-                    break;
+            case MAKENAMEID3('s', 't', 's'):  // share timestamp
+                sts = j->getint();
+                break;
 
-                default:
-                    if (!j->storeobject())
-                    {
-                        return 0;
-                    }
-            }
+            default:
+                if (!j->storeobject())
+                {
+                    return 0;
+                }
         }
+    }
 
-        if (ISUNDEF(h))
+    if (ISUNDEF(h))
+    {
+        warn("Missing node handle");
+    }
+    else
+    {
+        if (t == TYPE_UNKNOWN)
         {
-            warn("Missing node handle");
+            warn("Unknown node type");
         }
-        else
+        else if (t == FILENODE || t == FOLDERNODE)
         {
-            if (t == TYPE_UNKNOWN)
+            if (ISUNDEF(ph))
             {
-                warn("Unknown node type");
+                warn("Missing parent");
             }
-            else if (t == FILENODE || t == FOLDERNODE)
+            else if (!a)
             {
-                if (ISUNDEF(ph))
-                {
-                    warn("Missing parent");
-                }
-                else if (!a)
+                warn("Missing node attributes");
+            }
+            else if (!k)
+            {
+                warn("Missing node key");
+            }
+
+            if (t == FILENODE && ISUNDEF(s))
+            {
+                warn("File node without file size");
+            }
+        }
+    }
+
+    if (fa && t != FILENODE)
+    {
+        warn("Spurious file attributes");
+    }
+
+    if (!warnlevel())
+    {
+        if ((n = nodebyhandle(h)))
+        {
+            if (n->changed.removed)
+            {
+                // node marked for deletion is being resurrected, possibly
+                // with a new parent (server-client move operation)
+                n->changed.removed = false;
+            }
+            else
+            {
+                // node already present - check for race condition
+                if ((n->parent && ph != n->parent->nodehandle) || n->type != t)
                 {
-                    warn("Missing node attributes");
+                    app->reload("Node inconsistency (parent linkage)");
                 }
-                else if (!k)
+            }
+
+            if (!ISUNDEF(ph))
+            {
+                Node* p;
+
+                if ((p = nodebyhandle(ph)))
                 {
-                    warn("Missing node key");
+                    n->setparent(p);
+                    n->changed.parent = true;
                 }
-
-                if (t == FILENODE && ISUNDEF(s))
+                else
                 {
-                    warn("File node without file size");
+                    n->setparent(NULL);
+                    n->parenthandle = ph;
+                    dp->push_back(n);
                 }
             }
         }
-
-        if (fa && t != FILENODE)
+        else
         {
-            warn("Spurious file attributes");
-        }
+            byte buf[SymmCipher::KEYLENGTH];
 
-        if (!warnlevel())
-        {
-            if ((n = nodebyhandle(h)))
+            if (!ISUNDEF(su))
             {
-                if (n->changed.removed)
+                if (t != FOLDERNODE)
                 {
-                    // node marked for deletion is being resurrected, possibly
-                    // with a new parent (server-client move operation)
-                    n->changed.removed = false;
+                    warn("Invalid share node type");
                 }
-                else
+
+                if (rl == ACCESS_UNKNOWN)
                 {
-                    // node already present - check for race condition
-                    if ((n->parent && ph != n->parent->nodehandle) || n->type != t)
-                    {
-                        app->reload("Node inconsistency (parent linkage)");
-                    }
+                    warn("Missing access level");
                 }
 
-                if (!ISUNDEF(ph))
+                if (!sk)
                 {
-                    Node* p;
-
-                    if ((p = nodebyhandle(ph)))
-                    {
-                        n->setparent(p);
-                        n->changed.parent = true;
-                    }
-                    else
-                    {
-                        n->setparent(NULL);
-                        n->parenthandle = ph;
-                        dp.push_back(n);
-                    }
+                    LOG_warn << "Missing share key for inbound share";
                 }
-            }
-            else
-            {
-                byte buf[SymmCipher::KEYLENGTH];
 
-                if (!ISUNDEF(su))
+                if (warnlevel())
                 {
-                    if (t != FOLDERNODE)
-                    {
-                        warn("Invalid share node type");
-                    }
-
-                    if (rl == ACCESS_UNKNOWN)
-                    {
-                        warn("Missing access level");
-                    }
-
-                    if (!sk)
-                    {
-                        LOG_warn << "Missing share key for inbound share";
-                    }
-
-                    if (warnlevel())
-                    {
-                        su = UNDEF;
-                    }
-                    else
+                    su = UNDEF;
+                }
+                else
+                {
+                    // RSA-encrypted keys are decrypted in batches when the
+                    // new shares are merged
+                    if (sk && encodedkeylength(sk) <= 4 * FILENODEKEYLENGTH / 3 + 1)
                     {
-                        if (sk)
-                        {
-                            decryptkey(sk, buf, sizeof buf, &key, 1, h);
-                        }
+                        decryptkey(sk, buf, sizeof buf, &key, 1, h);
                     }
                 }
+            }
 
-                string fas;
+            string fas;
 
-                Node::copystring(&fas, fa);
+            Node::copystring(&fas, fa);
 
-                // fallback timestamps
-                if (!(ts + 1))
-                {
-                    ts = time(NULL);
-                }
+            // fallback timestamps
+            if (!(ts + 1))
+            {
+                ts = time(NULL);
+            }
 
-                if (!(sts + 1))
-                {
-                    sts = ts;
-                }
+            if (!(sts + 1))
+            {
+                sts = ts;
+            }
 
-                n = new Node(this, &dp, h, ph, t, s, u, fas.c_str(), ts);
+            n = new (this) Node(this, dp, h, ph, t, s, u, fas.c_str(), ts);
 
-                n->tag = tag;
+            n->tag = tag;
 
-                n->attrstring = new string;
-                Node::copystring(n->attrstring, a);
-                Node::copystring(&n->nodekey, k);
+            n->attrstring = new string;
+            Node::copystring(n->attrstring, a);
+            Node::copystring(&n->nodekey, k);
+
+            if (!ISUNDEF(su))
+            {
+                bool rsa = sk && encodedkeylength(sk) > 4 * FILENODEKEYLENGTH / 3 + 1;
+                NewShare* s = new NewShare(h, 0, su, rl, sts, (sk && !rsa) ? buf : NULL);
 
-                if (!ISUNDEF(su))
+                if (rsa)
                 {
-                    newshares.push_back(new NewShare(h, 0, su, rl, sts, sk ? buf : NULL));
+                    s->rsakey.assign(sk, encodedkeylength(sk));
                 }
 
-                if (nn && nni >= 0 && nni < nnsize)
-                {
-                    nn[nni].added = true;
+                newshares.push_back(s);
+            }
+
+            if (nn && nni >= 0 && nni < nnsize)
+            {
+                nn[nni].added = true;
+                nn[nni].addedhandle = h;
 
 #ifdef ENABLE_SYNC
-                    if (source == PUTNODES_SYNC)
+                if (source == PUTNODES_SYNC)
+                {
+                    if (nn[nni].localnode)
                     {
-                        if (nn[nni].localnode)
-                        {
-                            // overwrites/updates: associate LocalNode with newly created Node
-                            nn[nni].localnode->setnode(n);
-                            nn[nni].localnode->newnode = NULL;
-                            nn[nni].localnode->treestate(TREESTATE_SYNCED);
+                        // overwrites/updates: associate LocalNode with newly created Node
+                        nn[nni].localnode->setnode(n);
+                        nn[nni].localnode->newnode = NULL;
+                        nn[nni].localnode->treestate(TREESTATE_SYNCED);
 
-                            // updates cache with the new node associated
-                            nn[nni].localnode->sync->statecacheadd(nn[nni].localnode);
-                        }
+                        // updates cache with the new node associated
+                        nn[nni].localnode->sync->statecacheadd(nn[nni].localnode);
                     }
+                }
 #endif
 
-                    if (nn[nni].source == NEW_UPLOAD)
-                    {
-                        handle uh = nn[nni].uploadhandle;
-
-                        // do we have pending file attributes for this upload? set them.
-                        for (fa_map::iterator it = pendingfa.lower_bound(pair<handle, fatype>(uh, 0));
-                             it != pendingfa.end() && it->first.first == uh; )
-                        {
-                            reqs[r].add(new CommandAttachFA(h, it->first.second, it->second.first, it->second.second));
-                            pendingfa.erase(it++);
-                        }
+                if (nn[nni].source == NEW_UPLOAD)
+                {
+                    handle uh = nn[nni].uploadhandle;
 
-                        // FIXME: only do this for in-flight FA writes
-                        uhnh.insert(pair<handle, handle>(uh, h));
+                    // do we have pending file attributes for this upload? set them.
+                    for (fa_map::iterator it = pendingfa.lower_bound(pair<handle, fatype>(uh, 0));
+                         it != pendingfa.end() && it->first.first == uh; )
+                    {
+                        reqs[r].add(new CommandAttachFA(h, it->first.second, it->second.first, it->second.second));
+                        pendingfa.erase(it++);
                     }
+
+                    // FIXME: only do this for in-flight FA writes
+                    uhnh.insert(pair<handle, handle>(uh, h));
                 }
             }
+        }
+
+        if (notify)
+        {
+            notifynode(n);
+        }
+    }
+
+    return 1;
+}
+
+// read and add/verify node array
+int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn, int nnsize, int tag)
+{
+    if (!j->enterarray())
+    {
+        return 0;
+    }
+
+    node_vector dp;
+    Node* n;
 
-            if (notify)
-            {
-                notifynode(n);
-            }
+    while (j->enterobject())
+    {
+        if (!readnode(j, notify, source, nn, nnsize, tag, &dp))
+        {
+            return 0;
         }
     }
 
@@ -4737,21 +7036,473 @@ void MegaClient::readopc(JSON *j)
             }
         }
 
-        j->leavearray();
+        j->leavearray();
+    }
+}
+
+bool MegaClient::deferattrs()
+{
+#ifdef ENABLE_SYNC
+    if (syncs.size())
+    {
+        return false;
+    }
+#endif
+
+    // the search index needs the current names
+    if (namesearch.active())
+    {
+        return false;
+    }
+
+    return lazyattrs;
+}
+
+// the node itself and the nodes below it (children only if not recursive)
+void MegaClient::searchnodes(Node* root, const char* search, bool recursive, node_vector* results)
+{
+    node_vector matches;
+
+    if (!namesearch.active())
+    {
+        LOG_debug << "Indexing " << nodes.size() << " node names";
+        namesearch.build(&nodes);
+    }
+
+    namesearch.find(search, &matches);
+
+    for (node_vector::iterator it = matches.begin(); it != matches.end(); it++)
+    {
+        Node* p = *it;
+
+        if (p != root)
+        {
+            p = p->parent;
+
+            while (recursive && p && p != root)
+            {
+                p = p->parent;
+            }
+        }
+
+        if (p == root)
+        {
+            results->push_back(*it);
+        }
+    }
+}
+
+void MegaClient::resolveattrs()
+{
+    if (pendingattrnodes)
+    {
+        LOG_debug << "Decrypting " << pendingattrnodes << " deferred node attributes";
+
+        for (node_map::iterator it = nodes.begin(); it != nodes.end() && pendingattrnodes; it++)
+        {
+            it->second->resolveattrs();
+        }
+    }
+}
+
+// heap memory held by a string (short strings are stored inline by most
+// implementations)
+static size_t stringheap(const string* s)
+{
+    return s->capacity() < sizeof(string) ? 0 : s->capacity() + 1;
+}
+
+// the estimates count allocations at their requested size (allocator
+// overhead is not included) and use typical sizes for the nodes of the
+// standard containers
+void MegaClient::reportnodememory()
+{
+    size_t nodebytes, indexbytes;
+
+    nodememory(&nodebytes, &indexbytes, true);
+}
+
+void MegaClient::nodememory(size_t* nodebytes, size_t* indexbytes, bool log)
+{
+    size_t structs = 0, keys = 0, attrs = 0, fileattrs = 0, shares = 0, children = 0;
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+
+        structs += sizeof(Node);
+
+        keys += stringheap(&n->nodekey);
+
+        if (n->sharekey)
+        {
+            keys += sizeof(SymmCipher);
+        }
+
+        if (n->attrstring)
+        {
+            attrs += sizeof(string) + stringheap(n->attrstring);
+        }
+
+        if (n->pendingattrs)
+        {
+            attrs += sizeof(string) + stringheap(n->pendingattrs);
+        }
+
+        attrs += n->attrs.map.allocated() * sizeof(attr_map::value_type);
+
+        for (attr_map::iterator ait = n->attrs.map.begin(); ait != n->attrs.map.end(); ait++)
+        {
+            attrs += stringheap(&ait->second);
+        }
+
+        fileattrs += stringheap(&n->fileattrstring);
+
+        if (n->inshare)
+        {
+            shares += sizeof(Share);
+        }
+
+        if (n->outshares)
+        {
+            shares += sizeof(share_map) + n->outshares->size() * (sizeof(Share) + 6 * sizeof(void*));
+        }
+
+        if (n->pendingshares)
+        {
+            shares += sizeof(share_map) + n->pendingshares->size() * (sizeof(Share) + 6 * sizeof(void*));
+        }
+
+        children += n->children.capacity() * sizeof(Node*);
+
+        if (n->childnames)
+        {
+            children += sizeof(NodeNameIndex) + n->childnames->allocated() * 2 * sizeof(Node*);
+        }
+
+        if (n->sortedchildren)
+        {
+            children += sizeof(sortedchildren_map);
+
+            for (sortedchildren_map::iterator sit = n->sortedchildren->begin(); sit != n->sortedchildren->end(); sit++)
+            {
+                children += 4 * sizeof(void*) + sizeof(sortedchildren_map::value_type) + sit->second.capacity() * sizeof(Node*);
+            }
+        }
+    }
+
+    size_t index = nodes.allocated() * sizeof(node_map::Slot);
+
+    size_t fingerprintindex = fingerprints.allocated() * 2 * sizeof(void*);
+
+    size_t total = structs + keys + attrs + fileattrs + shares + children + index + fingerprintindex;
+
+    *nodebytes = structs + keys + attrs + fileattrs + shares + children;
+    *indexbytes = index + fingerprintindex;
+
+    if (!log)
+    {
+        return;
+    }
+
+    LOG_info << "Node memory: " << nodes.size() << " nodes, " << total << " bytes ("
+             << (nodes.size() ? total / nodes.size() : 0) << " per node)";
+    LOG_info << "Node memory: structures " << structs << " (" << sizeof(Node) << " per node)"
+             << ", keys " << keys
+             << ", attributes " << attrs
+             << ", file attributes " << fileattrs
+             << ", shares " << shares;
+    LOG_info << "Node memory: children " << children
+             << ", handle index " << index
+             << ", fingerprint index " << fingerprintindex;
+}
+
+// buffers of a request (chunk buffers belong to the buffer pool)
+static size_t httpreqheap(const HttpReq* req)
+{
+    return stringheap(&req->in) + stringheap(&req->outbuf) + stringheap(&req->chunkedout)
+         + stringheap(&req->deflatedout) + stringheap(&req->posturl);
+}
+
+void MegaClient::memoryusage(MemoryUsage* mu)
+{
+    memset(mu->bytes, 0, sizeof mu->bytes);
+
+    nodememory(mu->bytes + MemoryUsage::NODES, mu->bytes + MemoryUsage::NODEINDEXES);
+    mu->bytes[MemoryUsage::NODEINDEXES] += namesearch.footprint();
+
+#ifdef ENABLE_SYNC
+    mu->bytes[MemoryUsage::SYNCS] = syncmemory();
+#endif
+
+    size_t* bytes = mu->bytes + MemoryUsage::TRANSFERS;
+
+    for (int d = 2; d--; )
+    {
+        for (transfer_map::iterator it = transfers[d].begin(); it != transfers[d].end(); it++)
+        {
+            Transfer* t = it->second;
+
+            *bytes += sizeof(Transfer) + 4 * sizeof(void*) + sizeof(transfer_map::value_type)
+                    + stringheap(&t->localfilename)
+                    + t->chunkmacs.allocated() * sizeof(chunkmac_map::value_type);
+
+            for (file_list::iterator fit = t->files.begin(); fit != t->files.end(); fit++)
+            {
+                *bytes += sizeof(File) + 3 * sizeof(void*) + stringheap(&(*fit)->name) + stringheap(&(*fit)->localname);
+            }
+        }
+    }
+
+    mu->bytes[MemoryUsage::TRANSFERBUFFERS] = bufferpool.idle + bufferpool.inuse;
+
+    bytes = mu->bytes + MemoryUsage::NETWORK;
+
+    if (pendingcs)
+    {
+        *bytes += sizeof(HttpReq) + httpreqheap(pendingcs);
+    }
+
+    if (pipelinedcs)
+    {
+        *bytes += sizeof(HttpReq) + httpreqheap(pipelinedcs);
+    }
+
+    if (pendingsc)
+    {
+        *bytes += sizeof(HttpReq) + httpreqheap(pendingsc);
+    }
+
+    for (fafc_map::iterator it = fafcs.begin(); it != fafcs.end(); it++)
+    {
+        *bytes += sizeof(FileAttributeFetchChannel) + httpreqheap(&it->second->req);
+    }
+
+    for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+    {
+        for (int i = (*it)->connections; i--; )
+        {
+            if ((*it)->reqs[i])
+            {
+                *bytes += sizeof(HttpReqXfer) + httpreqheap((*it)->reqs[i]);
+            }
+        }
+    }
+
+    bytes = mu->bytes + MemoryUsage::THUMBNAILS;
+    *bytes = gfxcache.memsize();
+
+    for (deque<GfxCacheHit>::iterator it = gfxcachehits.begin(); it != gfxcachehits.end(); it++)
+    {
+        *bytes += sizeof(GfxCacheHit) + stringheap(&it->data);
+    }
+
+    if (dbaccess)
+    {
+        mu->bytes[MemoryUsage::DATABASE] = dbaccess->memoryused();
+    }
+}
+
+#ifdef ENABLE_SYNC
+// size of a node of the standard associative containers, holding v
+#define TREENODE(v) (4 * sizeof(void*) + sizeof(v))
+
+size_t MegaClient::syncmemory(bool log)
+{
+    size_t nodes = 0, structs = 0, names = 0, children = 0, paths = 0, indexes = 0;
+    vector<LocalNode*> stack;
+
+    for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
+    {
+        stack.push_back(&(*it)->localroot);
+
+        // the root is part of the Sync
+        structs -= sizeof(LocalNode);
+    }
+
+    while (stack.size())
+    {
+        LocalNode* l = stack.back();
+        stack.pop_back();
+
+        nodes++;
+        structs += sizeof(LocalNode);
+
+        names += stringheap(&l->name) + stringheap(&l->localname) + stringheap(&l->slocalname);
+
+        if (l->children.allocated())
+        {
+            children += sizeof(localnode_map) + l->children.size() * TREENODE(localnode_map::value_type);
+        }
+
+        if (l->schildren.allocated())
+        {
+            children += sizeof(localnode_map) + l->schildren.size() * TREENODE(localnode_map::value_type);
+        }
+
+        if (l->cachedpath)
+        {
+            paths += sizeof(string) + stringheap(l->cachedpath);
+        }
+
+        if (l->fsid_it != fsidnode.end())
+        {
+            indexes += TREENODE(handlelocalnode_map::value_type);
+        }
+
+        if (l->notseen)
+        {
+            indexes += TREENODE(LocalNode*);
+        }
+
+        for (localnode_map::iterator it = l->children.begin(); it != l->children.end(); it++)
+        {
+            stack.push_back(it->second);
+        }
+    }
+
+    size_t total = structs + names + children + paths + indexes;
+
+    if (log)
+    {
+        LOG_info << "LocalNode memory: " << nodes << " nodes, " << total << " bytes ("
+                 << (nodes ? total / nodes : 0) << " per node)";
+        LOG_info << "LocalNode memory: structures " << structs << " (" << sizeof(LocalNode) << " per node)"
+                 << ", names " << names
+                 << ", children " << children
+                 << ", cached paths " << paths
+                 << ", fsid/notseen indexes " << indexes;
+    }
+
+    return total;
+}
+
+#undef TREENODE
+#endif
+
+// fan node key and attribute decryption out to the worker pool (RSA-encrypted
+// keys, which get rewritten on the server, in separate smaller batches) - the
+// engine processes the last batch itself and runs batches that no worker has
+// picked up yet
+int MegaClient::applykeysparallel()
+{
+    vector<NodeKeyJob*> jobs;
+    NodeKeyJob* job = NULL;
+    vector<RsaKeyJob*> rsajobs;
+    RsaKeyJob* rsajob = NULL;
+    int t = 0;
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+        SymmCipher* sc;
+        const char* k;
+
+        if (!(k = n->locatekey(&sc)))
+        {
+            continue;
+        }
+
+        t++;
+
+        if (encodedkeylength(k) > 4 * FILENODEKEYLENGTH / 3 + 1)
+        {
+            if (!rsajob || rsajob->items.size() >= RsaKeyJob::BATCHSIZE)
+            {
+                rsajobs.push_back(rsajob = new RsaKeyJob(&asymkey));
+            }
+
+            rsajob->add(n, NULL, k, n->keylength());
+            continue;
+        }
+
+        if (!job || job->items.size() >= NodeKeyJob::BATCHSIZE)
+        {
+            jobs.push_back(job = new NodeKeyJob(deferattrs()));
+        }
+
+        job->add(n, k, sc);
+    }
+
+    if (rsajobs.size())
+    {
+        runrsakeyjobs(&rsajobs);
+
+        for (unsigned i = 0; i < rsajobs.size(); i++)
+        {
+            for (unsigned j = 0; j < rsajobs[i]->items.size(); j++)
+            {
+                RsaKeyJob::Item* item = &rsajobs[i]->items[j];
+
+                if (item->ok)
+                {
+                    item->node->nodekey.assign((const char*)item->key, item->keylength);
+                    item->node->setattr();
+                    nodekeyrewrite.push_back(item->node->nodehandle);
+                }
+                else
+                {
+                    LOG_warn << "Corrupt or invalid RSA node key";
+                }
+            }
+
+            delete rsajobs[i];
+        }
+
+        LOG_debug << "Decrypted RSA node keys in " << rsajobs.size() << " batches";
+    }
+
+    if (!jobs.size())
+    {
+        return t;
+    }
+
+    for (unsigned i = 0; i + 1 < jobs.size(); i++)
+    {
+        workerpool->push(jobs[i]);
+    }
+
+    jobs.back()->run();
+
+    for (unsigned i = 0; i < jobs.size(); i++)
+    {
+        if (i + 1 < jobs.size())
+        {
+            workerpool->waitfor(jobs[i]);
+
+            if (!jobs[i]->finished)
+            {
+                jobs[i]->run();
+            }
+        }
+
+        jobs[i]->merge();
+        delete jobs[i];
     }
+
+    LOG_debug << "Decrypted " << t << " node keys in " << jobs.size() << " batches";
+
+    return t;
 }
 
 int MegaClient::applykeys()
 {
     int t = 0;
 
-    // FIXME: rather than iterating through the whole node set, maintain subset
-    // with missing keys
-    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    if (workerpool && nodes.size() >= PARALLELKEYSMIN)
+    {
+        t = applykeysparallel();
+    }
+    else
     {
-        if (it->second->applykey())
+        // FIXME: rather than iterating through the whole node set, maintain subset
+        // with missing keys
+        for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
         {
-            t++;
+            if (it->second->applykey())
+            {
+                t++;
+            }
         }
     }
 
@@ -4878,6 +7629,9 @@ void MegaClient::login(const char* email, const byte* pwkey)
 {
     locallogout();
 
+    startup.reset();
+    startup.begin(STARTUP_LOGIN);
+
     string lcemail(email);
 
     key.setkey((byte*)pwkey);
@@ -4894,6 +7648,9 @@ void MegaClient::fastlogin(const char* email, const byte* pwkey, uint64_t emailh
 {
     locallogout();
 
+    startup.reset();
+    startup.begin(STARTUP_LOGIN);
+
     key.setkey((byte*)pwkey);
 
     byte sek[SymmCipher::KEYLENGTH];
@@ -4916,6 +7673,9 @@ void MegaClient::getpubkey(const char *user)
 void MegaClient::login(const byte* session, int size)
 {
     locallogout();
+
+    startup.reset();
+    startup.begin(STARTUP_LOGIN);
    
     int sessionversion = 0;
     if (size == sizeof key.key + SIDLEN + 1)
@@ -4940,6 +7700,7 @@ void MegaClient::login(const byte* session, int size)
         key.setkey(session);
         setsid(session + sizeof key.key, size - sizeof key.key);
 
+        waitsc();
         opensctable();
 
         if (sctable && sctable->get(CACHEDSCSN, &t) && t.size() == sizeof cachedscsn)
@@ -5070,11 +7831,329 @@ void MegaClient::opensctable()
     {
         string dbname;
 
+        startup.begin(STARTUP_DBOPEN);
+
         dbname.resize((SIDLEN - sizeof key.key) * 4 / 3 + 3);
         dbname.resize(Base64::btoa((const byte*)sid.data() + sizeof key.key, SIDLEN - sizeof key.key, (char*)dbname.c_str()));
 
         sctable = dbaccess->open(fsaccess, &dbname);
+
+        if (sctable)
+        {
+            sctable->indexnodes = sctableindex;
+        }
+
+        if (persisttls && !tlstable)
+        {
+            string tlsname = dbname;
+            string data;
+
+            tlsname.append("_tls");
+
+            if ((tlstable = dbaccess->open(fsaccess, &tlsname))
+             && tlstable->get(TLSSESSIONSRECORD, &data) && PaddedCBC::decrypt(&data, &key))
+            {
+                httpio->importtlssessions(&data);
+            }
+
+            nexttlssave = Waiter::ds + TLSSAVEINTERVAL;
+        }
+
+        if (!gfxcache.isopen())
+        {
+            string gfxname = dbname;
+
+            gfxname.append("_gfx");
+            gfxcache.open(dbaccess->open(fsaccess, &gfxname), &key);
+        }
+
+        if (!tctable)
+        {
+            dbname.append("_transfers");
+            tctable = dbaccess->open(fsaccess, &dbname);
+
+            readtransfercache();
+        }
+
+        startup.end(STARTUP_DBOPEN);
+    }
+}
+
+// store the TLS sessions established since the last save
+void MegaClient::savetlssessions()
+{
+    string data;
+
+    if (tlstable && httpio->exporttlssessions(&data))
+    {
+        PaddedCBC::encrypt(&data, &key);
+        tlstable->put(TLSSESSIONSRECORD, &data);
+    }
+}
+
+void MegaClient::readtransfercache()
+{
+    if (tctable)
+    {
+        string data;
+        uint32_t id;
+        Transfer* t;
+        QueuedFile* qf;
+
+        tctable->rewind();
+
+        while (tctable->next(&id, &data, &key))
+        {
+            if ((id & 15) == CACHEDTRANSFER && (t = Transfer::unserialize(this, &data)))
+            {
+                t->dbid = id;
+
+                if (!cachedtransfers[t->type].insert(pair<FileFingerprint*, Transfer*>((FileFingerprint*)t, t)).second)
+                {
+                    delete t;
+                }
+            }
+            else if ((id & 15) == CACHEDQUEUEDFILE && persistqueue && (qf = QueuedFile::unserialize(&data)))
+            {
+                qf->dbid = id;
+                queuedfiles.push_back(qf);
+            }
+            else
+            {
+                tctable->del(id);
+            }
+        }
+
+        LOG_debug << "Resumable downloads: " << cachedtransfers[GET].size() << " Queued downloads: " << queuedfiles.size();
+    }
+}
+
+// discard restored transfers that were not requested again (and their
+// partial data) and close the table
+void MegaClient::closetctable()
+{
+    for (int d = GET; d <= PUT; d++)
+    {
+        for (transfer_map::iterator it = cachedtransfers[d].begin(); it != cachedtransfers[d].end(); )
+        {
+            delete it++->second;
+        }
+
+        cachedtransfers[d].clear();
+    }
+
+    clearqueuedfiles();
+    flushqueuedfiles();
+
+    delete tctable;
+    tctable = NULL;
+}
+
+void MegaClient::cachetransfer(Transfer* t)
+{
+    if (tctable && t->type == GET)
+    {
+        tctable->put(CACHEDTRANSFER, t, &key);
+        t->cachedpos = t->macpos;
+    }
+}
+
+void MegaClient::queuefile(File* f)
+{
+    if (persistqueue && tctable && !f->queuedbid)
+    {
+        QueuedFile qf(f);
+        string data;
+
+        if (tctable->encode(CACHEDQUEUEDFILE, &qf, &key, &data))
+        {
+            f->queuedbid = qf.dbid;
+            queuedfileputids.push_back(qf.dbid);
+            queuedfileputs.push_back(string());
+            queuedfileputs.back().swap(data);
+        }
+    }
+}
+
+// a record removed while the table is closed is retained for the next session
+void MegaClient::unqueuefile(File* f)
+{
+    if (f->queuedbid && tctable)
+    {
+        queuedfiledels.push_back(f->queuedbid);
+    }
+
+    f->queuedbid = 0;
+}
+
+// write the queue changes of this exec() round in one go (puts first: a
+// record removed in the same round has been put before)
+void MegaClient::flushqueuedfiles()
+{
+    if (!tctable)
+    {
+        queuedfileputids.clear();
+        queuedfileputs.clear();
+        queuedfiledels.clear();
+        return;
+    }
+
+    if (queuedfileputids.size())
+    {
+        tctable->putmany(&queuedfileputids[0], &queuedfileputs[0], queuedfileputids.size());
+        queuedfileputids.clear();
+        queuedfileputs.clear();
+    }
+
+    if (queuedfiledels.size())
+    {
+        tctable->delmany(&queuedfiledels[0], queuedfiledels.size());
+        queuedfiledels.clear();
+    }
+}
+
+void MegaClient::clearqueuedfiles()
+{
+    for (unsigned i = 0; i < queuedfiles.size(); i++)
+    {
+        if (tctable)
+        {
+            queuedfiledels.push_back(queuedfiles[i]->dbid);
+        }
+
+        delete queuedfiles[i];
+    }
+
+    queuedfiles.clear();
+}
+
+// remember where a completed download was placed
+void MegaClient::addlocalcopy(FileFingerprint* fp, string* localpath)
+{
+    if (!fp->isvalid)
+    {
+        return;
+    }
+
+    fingerprint_localpath_map::iterator it = localcopies.find(fp);
+
+    if (it != localcopies.end())
+    {
+        it->second = *localpath;
+        return;
+    }
+
+    if (localcopies.size() >= MAXLOCALCOPIES)
+    {
+        delete localcopies.begin()->first;
+        localcopies.erase(localcopies.begin());
     }
+
+    FileFingerprint* key = new FileFingerprint;
+    *key = *fp;
+
+    localcopies[key] = *localpath;
+}
+
+int MegaClient::inflightrequests(direction_t d)
+{
+    int count = 0;
+
+    for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+    {
+        if ((*it)->transfer->type == d)
+        {
+            count += (*it)->inflightrequests();
+        }
+    }
+
+    return count;
+}
+
+void MegaClient::clearlocalcopies()
+{
+    for (fingerprint_localpath_map::iterator it = localcopies.begin(); it != localcopies.end(); it++)
+    {
+        delete it->first;
+    }
+
+    localcopies.clear();
+}
+
+// look for a local file with the download's fingerprint - synced files of
+// nodes with that fingerprint and previously completed downloads - and,
+// after verifying its size, mtime and sparse CRC, copy it to the download's
+// temporary file
+bool MegaClient::localcopy(Transfer* t)
+{
+    if (!t->isvalid || !t->size)
+    {
+        return false;
+    }
+
+    vector<string> candidates;
+
+#ifdef ENABLE_SYNC
+    resolveattrs();
+
+    vector<FileFingerprint*> matching;
+
+    fingerprints.findall(t, &matching);
+
+    for (vector<FileFingerprint*>::iterator it = matching.begin(); it != matching.end(); it++)
+    {
+        LocalNode* l = ((Node*)*it)->localnode;
+
+        if (l && l->type == FILENODE)
+        {
+            candidates.push_back(string());
+            l->getlocalpath(&candidates.back());
+        }
+    }
+#endif
+
+    fingerprint_localpath_map::iterator lit = localcopies.find(t);
+
+    if (lit != localcopies.end())
+    {
+        candidates.push_back(lit->second);
+    }
+
+    for (unsigned i = 0; i < candidates.size(); i++)
+    {
+        FileAccess* fa = fsaccess->newfileaccess();
+        FileFingerprint fp;
+        bool match = false;
+
+        if (fa->fopen(&candidates[i], true, false)
+         && fa->type == FILENODE
+         && fa->size == t->size
+         && fa->mtime == t->mtime)
+        {
+            fp.genfingerprint(fa);
+            match = fp == *(FileFingerprint*)t;
+        }
+
+        delete fa;
+
+        if (match)
+        {
+            if (fsaccess->copylocal(&candidates[i], &t->localfilename, t->mtime))
+            {
+                LOG_debug << "Download satisfied by a local copy";
+                return true;
+            }
+        }
+        else if (lit != localcopies.end() && candidates[i] == lit->second)
+        {
+            // the file has changed or is gone
+            delete lit->first;
+            localcopies.erase(lit);
+            lit = localcopies.end();
+        }
+    }
+
+    return false;
 }
 
 // verify a static symmetric password challenge
@@ -5278,32 +8357,156 @@ void MegaClient::procsr(JSON* j)
                 }
             }
         }
-        else
-        {
-            // unknown node: skip
-            while (j->ishandle(USERHANDLE) && (uh = j->gethandle(USERHANDLE)));
-        }
+        else
+        {
+            // unknown node: skip
+            while (j->ishandle(USERHANDLE) && (uh = j->gethandle(USERHANDLE)));
+        }
+    }
+
+    j->leavearray();
+}
+
+// process node tree (bottom up)
+void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares)
+{
+    if (!proctreeparallel(n, tp, skipinshares))
+    {
+        walktree(this, n, tp, skipinshares);
+    }
+}
+
+void MegaClient::walktree(MegaClient* client, Node* n, TreeProc* tp, bool skipinshares)
+{
+    if (n->type == FILENODE)
+    {
+        return tp->proc(client, n);
+    }
+
+    // folders being processed and the index of their next child
+    vector<pair<Node*, size_t> > stack;
+
+    stack.push_back(pair<Node*, size_t>(n, 0));
+
+    while (stack.size())
+    {
+        Node* folder = stack.back().first;
+        size_t i = stack.back().second;
+
+        if (i < folder->children.size())
+        {
+            Node* child = folder->children[i];
+
+            stack.back().second++;
+
+            if (!(skipinshares && child->inshare))
+            {
+                if (child->type == FILENODE)
+                {
+                    tp->proc(client, child);
+                }
+                else
+                {
+                    stack.push_back(pair<Node*, size_t>(child, 0));
+                }
+            }
+        }
+        else
+        {
+            stack.pop_back();
+            tp->proc(client, folder);
+        }
+    }
+}
+
+// split the tree into batches of subtrees for the worker pool - folders too
+// large for a batch are opened up and processed by the engine, the last
+// batch as well
+bool MegaClient::proctreeparallel(Node* n, TreeProc* tp, bool skipinshares)
+{
+    if (!workerpool || n->type == FILENODE || n->treefiles + n->treefolders < PARALLELTREEMIN)
+    {
+        return false;
+    }
+
+    TreeProc* forked = tp->fork();
+
+    if (!forked)
+    {
+        return false;
+    }
+
+    unsigned batchsize = (n->treefiles + n->treefolders) / PARALLELTREEJOBS + 1;
+    vector<TreeProcJob*> jobs;
+    TreeProcJob* job = new TreeProcJob(forked, skipinshares);
+    node_vector opened, pending;
+
+    pending.push_back(n);
+
+    while (pending.size())
+    {
+        Node* folder = pending.back();
+
+        pending.pop_back();
+        opened.push_back(folder);
+
+        for (node_vector::iterator it = folder->children.begin(); it != folder->children.end(); it++)
+        {
+            Node* child = *it;
+
+            if (skipinshares && child->inshare)
+            {
+                continue;
+            }
+
+            unsigned size = child->treefiles + child->treefolders;
+
+            if (size > batchsize)
+            {
+                pending.push_back(child);
+                continue;
+            }
+
+            job->roots.push_back(child);
+            job->size += size;
+
+            if (job->size >= batchsize)
+            {
+                jobs.push_back(job);
+                workerpool->push(job);
+
+                job = new TreeProcJob(tp->fork(), skipinshares);
+            }
+        }
     }
 
-    j->leavearray();
-}
+    job->run();
 
-// process node tree (bottom up)
-void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares)
-{
-    if (n->type != FILENODE)
+    // (opened in pre-order)
+    for (unsigned i = opened.size(); i--; )
+    {
+        tp->proc(this, opened[i]);
+    }
+
+    for (unsigned i = 0; i < jobs.size(); i++)
     {
-        for (node_list::iterator it = n->children.begin(); it != n->children.end(); )
+        workerpool->waitfor(jobs[i]);
+
+        if (!jobs[i]->finished)
         {
-            Node *child = *it++;
-            if (!(skipinshares && child->inshare))
-            {
-                proctree(child, tp, skipinshares);
-            }
+            jobs[i]->run();
         }
+
+        tp->merge(jobs[i]->tp);
+        delete jobs[i];
     }
 
-    tp->proc(this, n);
+    tp->merge(job->tp);
+    delete job;
+
+    LOG_debug << "Processed tree of " << (n->treefiles + n->treefolders) << " nodes in " << (jobs.size() + 1) << " batches";
+
+    return true;
 }
 
 // queue PubKeyAction request to be triggered upon availability of the user's
@@ -5557,6 +8760,12 @@ void MegaClient::putua(const char* an, const byte* av, unsigned avl, int priv)
 
     name.append(an);
 
+    User* u = finduser(me);
+    if (u && u->uacache.erase(name))
+    {
+        notifyuser(u);
+    }
+
     if (priv == 1)
     {
         if (av)
@@ -5598,10 +8807,53 @@ void MegaClient::getua(User* u, const char* an, int p)
 
         name.append(an);
 
+        map<string, string>::iterator it = u->uacache.find(name);
+        if (it != u->uacache.end())
+        {
+            restag = reqtag;
+
+            if (it->second[0] == User::UAFOUND)
+            {
+                string value(it->second, 1);
+                app->getua_result((byte*)value.data(), value.size());
+            }
+            else
+            {
+                app->getua_result(API_ENOENT);
+            }
+            return;
+        }
+
         reqs[r].add(new CommandGetUA(this, u->uid.c_str(), name.c_str(), p));
     }
 }
 
+// hold back notifications while an action packet burst is being received
+bool MegaClient::scburstdeferred()
+{
+    if (!scburst)
+    {
+        return false;
+    }
+
+#ifdef ENABLE_SYNC
+    if (syncs.size())
+    {
+        scburst = false;
+        return false;
+    }
+#endif
+
+    if (Waiter::ds >= scburststart + SCBURSTMAXDS)
+    {
+        // cap reached: flush and start over
+        scburststart = Waiter::ds;
+        return false;
+    }
+
+    return true;
+}
+
 // queue node for notification
 void MegaClient::notifynode(Node* n)
 {
@@ -5643,6 +8895,17 @@ void MegaClient::notifynode(Node* n)
     }
 
 #ifdef ENABLE_SYNC
+    // the previous and the new location need another sync pass
+    if (n->localnode)
+    {
+        n->localnode->setdirty();
+    }
+
+    if (n->parent && n->parent->localnode)
+    {
+        n->parent->localnode->setdirty();
+    }
+
     // is this a synced node that was moved to a non-synced location? queue for
     // deletion from LocalNodes.
     if (n->localnode && n->localnode->parent && n->parent && !n->parent->localnode)
@@ -6197,152 +9460,411 @@ void MegaClient::sendsignuplink(const char* email, const char* name, const byte*
     SymmCipher pwcipher(pwhash);
     byte c[2 * SymmCipher::KEYLENGTH];
 
-    memcpy(c, key.key, sizeof key.key);
-    PrnGen::genblock(c + SymmCipher::KEYLENGTH, SymmCipher::KEYLENGTH / 4);
-    memset(c + SymmCipher::KEYLENGTH + SymmCipher::KEYLENGTH / 4, 0, SymmCipher::KEYLENGTH / 2);
-    PrnGen::genblock(c + 2 * SymmCipher::KEYLENGTH - SymmCipher::KEYLENGTH / 4, SymmCipher::KEYLENGTH / 4);
+    memcpy(c, key.key, sizeof key.key);
+    PrnGen::genblock(c + SymmCipher::KEYLENGTH, SymmCipher::KEYLENGTH / 4);
+    memset(c + SymmCipher::KEYLENGTH + SymmCipher::KEYLENGTH / 4, 0, SymmCipher::KEYLENGTH / 2);
+    PrnGen::genblock(c + 2 * SymmCipher::KEYLENGTH - SymmCipher::KEYLENGTH / 4, SymmCipher::KEYLENGTH / 4);
+
+    pwcipher.ecb_encrypt(c, c, sizeof c);
+
+    reqs[r].add(new CommandSendSignupLink(this, email, name, c));
+}
+
+// if query is 0, actually confirm account; just decode/query signup link
+// details otherwise
+void MegaClient::querysignuplink(const byte* code, unsigned len)
+{
+    reqs[r].add(new CommandQuerySignupLink(this, code, len));
+}
+
+void MegaClient::confirmsignuplink(const byte* code, unsigned len, uint64_t emailhash)
+{
+    reqs[r].add(new CommandConfirmSignupLink(this, code, len, emailhash));
+}
+
+// generate and configure encrypted private key, plaintext public key
+void MegaClient::setkeypair()
+{
+    CryptoPP::Integer pubk[AsymmCipher::PUBKEY];
+
+    string privks, pubks;
+
+    asymkey.genkeypair(asymkey.key, pubk, 2048);
+
+    AsymmCipher::serializeintarray(pubk, AsymmCipher::PUBKEY, &pubks);
+    AsymmCipher::serializeintarray(asymkey.key, AsymmCipher::PRIVKEY, &privks);
+
+    // add random padding and ECB-encrypt with master key
+    unsigned t = privks.size();
+
+    privks.resize((t + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE);
+    PrnGen::genblock((byte*)(privks.data() + t), privks.size() - t);
+
+    key.ecb_encrypt((byte*)privks.data(), (byte*)privks.data(), (unsigned)privks.size());
+
+    reqs[r].add(new CommandSetKeyPair(this,
+                                      (const byte*)privks.data(),
+                                      privks.size(),
+                                      (const byte*)pubks.data(),
+                                      pubks.size()));
+}
+
+#ifdef USE_SODIUM
+/**
+ * @brief Initialises the Ed25519 EdDSA key user properties.
+ *
+ * A key pair will be added, if not present, yet.
+ *
+ * @return Error code (default: 1 on success).
+ */
+int MegaClient::inited25519()
+{
+    signkey.init();
+
+    // Make the new key pair and their storage arrays.
+    if (!signkey.genKeySeed())
+    {
+        LOG_err << "Error generating an Ed25519 key seed.";
+        return(0);
+    }
+
+    unsigned char* pubKey = (unsigned char*)malloc(crypto_sign_PUBLICKEYBYTES);
+
+    if (!signkey.publicKey(pubKey))
+    {
+        free(pubKey);
+        LOG_err << "Error deriving the Ed25519 public key.";
+        return(0);
+    }
+
+    // Store the key pair to user attributes.
+    putua("prEd255", (const byte*)signkey.keySeed, crypto_sign_SEEDBYTES, 1);
+    putua("puEd255", (const byte*)pubKey, crypto_sign_PUBLICKEYBYTES, 0);
+    free(pubKey);
+    return(1);
+}
+#endif
+
+// node handle of a serialized node
+static handle cachednodehandle(const char* ptr)
+{
+    handle h = 0;
+
+    memcpy((char*)&h, ptr + sizeof(m_off_t), MegaClient::NODEHANDLE);
+
+    return h;
+}
+
+// restore one decrypted state cache record (node records are collected
+// for fetchscnodes())
+bool MegaClient::fetchscrecord(uint32_t id, string* data, CachedNodes* cn)
+{
+    User* u;
+    PendingContactRequest* pcr;
+
+    switch (id & 15)
+    {
+        case CACHEDSCSN:
+            if (data->size() != sizeof cachedscsn)
+            {
+                return false;
+            }
+            break;
+
+        case CACHEDNODE:
+            if (data->size() < sizeof(m_off_t) + NODEHANDLE)
+            {
+                LOG_err << "Failed - node record read error";
+                return false;
+            }
+
+            cn->superseded.insert(cachednodehandle(data->data()));
+            cn->ids.push_back(id);
+            cn->records.push_back(string());
+            cn->records.back().swap(*data);
+            break;
+
+        case CACHEDNODEPACK:
+            cn->packs.push_back(string());
+            cn->packs.back().swap(*data);
+            break;
+
+        case CACHEDNODEGONE:
+            if (data->size() < NODEHANDLE)
+            {
+                LOG_err << "Failed - tombstone record read error";
+                return false;
+            }
+
+            handle h;
+            h = 0;
+            memcpy((char*)&h, data->data(), NODEHANDLE);
+            cn->superseded.insert(h);
+            cn->tombstones++;
+            break;
+
+        case CACHEDJOURNAL:
+            fetchjournal(id, data);
+            break;
+
+        case CACHEDPCR:
+            if ((pcr = PendingContactRequest::unserialize(this, data)))
+            {
+                pcr->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - pcr record read error";
+                return false;
+            }
+            break;
+
+        case CACHEDUSER:
+            if ((u = User::unserialize(this, data)))
+            {
+                u->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - user record read error";
+                return false;
+            }
+    }
+
+    return true;
+}
+
+// restore the snapshot nodes that were not superseded, then the nodes
+// written since
+bool MegaClient::fetchscnodes(CachedNodes* cn, node_vector* dp)
+{
+    handle_set packed;
+    Node* n;
+    size_t count = cn->ids.size();
+
+    // size the node index once
+    for (unsigned i = 0; i < cn->packs.size(); i++)
+    {
+        // (already done by the workers when loading in parallel)
+        if (!DbTable::decompress(&cn->packs[i]))
+        {
+            LOG_err << "Failed - node pack format error";
+            return false;
+        }
+
+        const char* ptr = cn->packs[i].data();
+        const char* end = ptr + cn->packs[i].size();
+        uint32_t len;
+
+        while (ptr + sizeof len <= end)
+        {
+            len = MemAccess::get<uint32_t>(ptr);
+            ptr += sizeof len;
+
+            if (len > (size_t)(end - ptr))
+            {
+                break;
+            }
+
+            ptr += len;
+            count++;
+        }
+    }
+
+    nodes.reserve(nodes.size() + count);
+
+    for (unsigned i = 0; i < cn->packs.size(); i++)
+    {
+        const char* ptr = cn->packs[i].data();
+        const char* end = ptr + cn->packs[i].size();
+
+        while (ptr < end)
+        {
+            uint32_t len;
+
+            if (ptr + sizeof len > end)
+            {
+                LOG_err << "Failed - node pack read error";
+                return false;
+            }
+
+            len = MemAccess::get<uint32_t>(ptr);
+            ptr += sizeof len;
+
+            if (len < sizeof(m_off_t) + NODEHANDLE || len > (size_t)(end - ptr))
+            {
+                LOG_err << "Failed - node pack read error";
+                return false;
+            }
+
+            handle h = cachednodehandle(ptr);
+
+            if (cn->superseded.count(h))
+            {
+                packed.insert(h);
+            }
+            else
+            {
+                // (parsed in place, the pack stays alive until its end)
+                if (!(n = Node::unserialize(this, ptr, len, dp)))
+                {
+                    LOG_err << "Failed - node record read error";
+                    return false;
+                }
+
+                n->inpack = true;
+            }
+
+            ptr += len;
+        }
+
+        string().swap(cn->packs[i]);
+    }
+
+    for (unsigned i = 0; i < cn->ids.size(); i++)
+    {
+        handle h = cachednodehandle(cn->records[i].data());
+
+        if (!(n = Node::unserialize(this, &cn->records[i], dp)))
+        {
+            LOG_err << "Failed - node record read error";
+            return false;
+        }
+
+        n->dbid = cn->ids[i];
+        n->inpack = packed.count(h) > 0;
+    }
 
-    pwcipher.ecb_encrypt(c, c, sizeof c);
+    scdelta = cn->ids.size() + cn->tombstones;
 
-    reqs[r].add(new CommandSendSignupLink(this, email, name, c));
+    return true;
 }
 
-// if query is 0, actually confirm account; just decode/query signup link
-// details otherwise
-void MegaClient::querysignuplink(const byte* code, unsigned len)
+// with a worker pool, the records are decrypted in batches on the workers
+// while the engine reads ahead and restores the batches in order
+bool MegaClient::fetchscparallel(DbTable* sctable, CachedNodes* cn)
 {
-    reqs[r].add(new CommandQuerySignupLink(this, code, len));
-}
+    deque<DbReadJob*> jobs;
+    bool more = true;
+    bool result = true;
+    uint32_t id;
+    string data;
 
-void MegaClient::confirmsignuplink(const byte* code, unsigned len, uint64_t emailhash)
-{
-    reqs[r].add(new CommandConfirmSignupLink(this, code, len, emailhash));
-}
+    while (result)
+    {
+        while (more && jobs.size() < FETCHSCJOBS)
+        {
+            DbReadJob* job = new DbReadJob(&key);
 
-// generate and configure encrypted private key, plaintext public key
-void MegaClient::setkeypair()
-{
-    CryptoPP::Integer pubk[AsymmCipher::PUBKEY];
+            job->compressedtype = CACHEDNODEPACK;
 
-    string privks, pubks;
+            while (job->ids.size() < DbReadJob::BATCHSIZE && job->bytes < DbReadJob::BATCHBYTES
+                && (more = sctable->next(&id, &data)))
+            {
+                sctable->trackid(id);
+                job->add(id, &data);
+            }
 
-    asymkey.genkeypair(asymkey.key, pubk, 2048);
+            if (!job->ids.size())
+            {
+                delete job;
+                break;
+            }
 
-    AsymmCipher::serializeintarray(pubk, AsymmCipher::PUBKEY, &pubks);
-    AsymmCipher::serializeintarray(asymkey.key, AsymmCipher::PRIVKEY, &privks);
+            workerpool->push(job);
+            jobs.push_back(job);
+        }
 
-    // add random padding and ECB-encrypt with master key
-    unsigned t = privks.size();
+        if (!jobs.size())
+        {
+            break;
+        }
 
-    privks.resize((t + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE);
-    PrnGen::genblock((byte*)(privks.data() + t), privks.size() - t);
+        DbReadJob* job = jobs.front();
+        jobs.pop_front();
 
-    key.ecb_encrypt((byte*)privks.data(), (byte*)privks.data(), (unsigned)privks.size());
+        workerpool->waitfor(job);
 
-    reqs[r].add(new CommandSetKeyPair(this,
-                                      (const byte*)privks.data(),
-                                      privks.size(),
-                                      (const byte*)pubks.data(),
-                                      pubks.size()));
-}
+        if (!job->finished)
+        {
+            job->run();
+        }
 
-#ifdef USE_SODIUM
-/**
- * @brief Initialises the Ed25519 EdDSA key user properties.
- *
- * A key pair will be added, if not present, yet.
- *
- * @return Error code (default: 1 on success).
- */
-int MegaClient::inited25519()
-{
-    signkey.init();
+        for (unsigned i = 0; i < job->ids.size() && result; i++)
+        {
+            // undecryptable record: ends the cache like a sequential read
+            if (!job->ok[i])
+            {
+                more = false;
 
-    // Make the new key pair and their storage arrays.
-    if (!signkey.genKeySeed())
-    {
-        LOG_err << "Error generating an Ed25519 key seed.";
-        return(0);
-    }
+                while (jobs.size())
+                {
+                    workerpool->waitfor(jobs.front());
+                    delete jobs.front();
+                    jobs.pop_front();
+                }
 
-    unsigned char* pubKey = (unsigned char*)malloc(crypto_sign_PUBLICKEYBYTES);
+                break;
+            }
 
-    if (!signkey.publicKey(pubKey))
+            result = fetchscrecord(job->ids[i], &job->data[i], cn);
+        }
+
+        delete job;
+    }
+
+    while (jobs.size())
     {
-        free(pubKey);
-        LOG_err << "Error deriving the Ed25519 public key.";
-        return(0);
+        workerpool->waitfor(jobs.front());
+        delete jobs.front();
+        jobs.pop_front();
     }
 
-    // Store the key pair to user attributes.
-    putua("prEd255", (const byte*)signkey.keySeed, crypto_sign_SEEDBYTES, 1);
-    putua("puEd255", (const byte*)pubKey, crypto_sign_PUBLICKEYBYTES, 0);
-    free(pubKey);
-    return(1);
+    return result;
 }
-#endif
 
 bool MegaClient::fetchsc(DbTable* sctable)
 {
     uint32_t id;
     string data;
     Node* n;
-    User* u;
-    PendingContactRequest* pcr;
     node_vector dp;
+    CachedNodes cn;
 
     LOG_info << "Loading session from local cache";
 
+    // rebuilt by the next search
+    namesearch.clear();
+
+    clearjournal();
+
     sctable->rewind();
 
-    while (sctable->next(&id, &data, &key))
+    if (workerpool)
     {
-        switch (id & 15)
+        if (!fetchscparallel(sctable, &cn))
         {
-            case CACHEDSCSN:
-                if (data.size() != sizeof cachedscsn)
-                {
-                    return false;
-                }
-                break;
-
-            case CACHEDNODE:
-                if ((n = Node::unserialize(this, &data, &dp)))
-                {
-                    n->dbid = id;
-                }
-                else
-                {
-                    LOG_err << "Failed - node record read error";
-                    return false;
-                }
-                break;
-
-            case CACHEDPCR:
-                if ((pcr = PendingContactRequest::unserialize(this, &data)))
-                {
-                    pcr->dbid = id;
-                }
-                else
-                {
-                    LOG_err << "Failed - pcr record read error";
-                    return false;
-                }
-                break;
-
-            case CACHEDUSER:
-                if ((u = User::unserialize(this, &data)))
-                {
-                    u->dbid = id;
-                }
-                else
-                {
-                    LOG_err << "Failed - user record read error";
-                    return false;
-                }
+            return false;
+        }
+    }
+    else
+    {
+        while (sctable->next(&id, &data, &key))
+        {
+            if (!fetchscrecord(id, &data, &cn))
+            {
+                return false;
+            }
         }
     }
 
+    if (!fetchscnodes(&cn, &dp))
+    {
+        return false;
+    }
+
+    restorejournal();
+
     // any child nodes arrived before their parents?
     for (int i = dp.size(); i--; )
     {
@@ -6352,7 +9874,9 @@ bool MegaClient::fetchsc(DbTable* sctable)
         }
     }
 
+    startup.begin(STARTUP_SHARES);
     mergenewshares(0);
+    startup.end(STARTUP_SHARES);
 
     return true;
 }
@@ -6360,7 +9884,14 @@ bool MegaClient::fetchsc(DbTable* sctable)
 void MegaClient::fetchnodes()
 {
     statecurrent = false;
+    scburst = false;
 
+    if (!startup.active)
+    {
+        startup.reset();
+    }
+
+    waitsc();
     opensctable();
 
     if (sctable && cachedscsn == UNDEF)
@@ -6369,13 +9900,23 @@ void MegaClient::fetchnodes()
     }
 
     // only initial load from local cache
-    if (loggedin() == FULLACCOUNT && !nodes.size() && sctable && !ISUNDEF(cachedscsn) && fetchsc(sctable))
+    bool cached = loggedin() == FULLACCOUNT && !nodes.size() && sctable && !ISUNDEF(cachedscsn);
+
+    if (cached)
+    {
+        startup.begin(STARTUP_CACHELOAD);
+        cached = fetchsc(sctable);
+        startup.end(STARTUP_CACHELOAD, 0, nodes.size());
+    }
+
+    if (cached)
     {
         restag = reqtag;
 #ifdef ENABLE_SYNC
         syncsup = false;
 #endif
         app->fetchnodes_result(API_OK);
+        startup.begin(STARTUP_CURRENT);
         app->nodes_updated(NULL, nodes.size());
         for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
         {
@@ -6389,6 +9930,9 @@ void MegaClient::fetchnodes()
     {
         fetchingnodes = true;
 
+        // changes may be missed until the tree is current again
+        clearjournal();
+
 #ifdef ENABLE_SYNC
         for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
         {
@@ -6396,8 +9940,141 @@ void MegaClient::fetchnodes()
         }
 #endif
 
-        reqs[r].add(new CommandFetchNodes(this));
+        // (only folder links can be browsed without the full tree)
+        partialfetching = partialfetch && !auth.compare(0, 3, "&n=");
+
+        startup.begin(STARTUP_FETCHNODES);
+        reqs[r].add(new CommandFetchNodes(this, !partialfetching));
+    }
+}
+
+void MegaClient::markpartial()
+{
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+
+        n->partial = n->type != FILENODE && !n->children.size();
+    }
+}
+
+error MegaClient::fetchchildren(handle h, bool recursive)
+{
+    Node* n = nodebyhandle(h);
+
+    if (!n)
+    {
+        return API_ENOENT;
+    }
+
+    if (n->type == FILENODE)
+    {
+        return API_EARGS;
+    }
+
+    bool missing = n->partial;
+
+    // a recursive fetch is needed if any folder of the subtree is partial
+    if (!missing && recursive)
+    {
+        node_vector pending(1, n);
+
+        while (!missing && pending.size())
+        {
+            Node* folder = pending.back();
+
+            pending.pop_back();
+
+            for (node_vector::iterator it = folder->children.begin(); it != folder->children.end(); it++)
+            {
+                if ((*it)->partial)
+                {
+                    missing = true;
+                    break;
+                }
+
+                if ((*it)->type != FILENODE)
+                {
+                    pending.push_back(*it);
+                }
+            }
+        }
+    }
+
+    if (!missing)
+    {
+        restag = reqtag;
+        app->fetchchildren_result(h, API_OK);
+        return API_OK;
+    }
+
+    childfetches.insert(h);
+    reqs[r].add(new CommandFetchChildren(this, h, recursive));
+
+    return API_OK;
+}
+
+void MegaClient::childrenfetched(handle h, bool recursive)
+{
+    Node* n = nodebyhandle(h);
+
+    if (!n)
+    {
+        return;
+    }
+
+    // the subfolders of a single level are still partial, unless they were
+    // loaded before
+    node_vector pending(1, n);
+
+    n->partial = false;
+
+    while (pending.size())
+    {
+        Node* folder = pending.back();
+
+        pending.pop_back();
+
+        for (node_vector::iterator it = folder->children.begin(); it != folder->children.end(); it++)
+        {
+            Node* child = *it;
+
+            if (child->type != FILENODE)
+            {
+                if (recursive)
+                {
+                    child->partial = false;
+                    pending.push_back(child);
+                }
+                else if (!child->children.size())
+                {
+                    child->partial = true;
+                }
+            }
+        }
+    }
+
+    TreeProcApplyKey td;
+    proctree(n, &td);
+
+    LOG_debug << "Fetched " << (recursive ? "subtree" : "children") << " of folder: " << (n->treefiles + n->treefolders) << " nodes";
+}
+
+void MegaClient::tracefetchnodes()
+{
+    if (!pendingcs)
+    {
+        return;
     }
+
+    HttpReqTimeline* t = &pendingcs->timeline;
+
+    startup.end(STARTUP_FETCHNODES, pendingcs->bufpos);
+
+    // connect and TLS handshake (empty on a reused connection), then the
+    // transfer of the response
+    startup.record(STARTUP_CONNECT, t->posted, t->connected);
+    startup.record(STARTUP_RESPONSE, t->firstbyte, t->completed ? t->completed : Waiter::us(), pendingcs->bufpos);
 }
 
 void MegaClient::purgenodesusersabortsc()
@@ -6417,21 +10094,32 @@ void MegaClient::purgenodesusersabortsc()
     }
 
     syncs.clear();
+    localnodeslab.trim();
 #endif
 
+    // the indexes and the parent/child links are discarded as a whole, so
+    // the nodes skip their individual removal from them
+    purgingnodes = true;
+
     for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
         delete it->second;
     }
 
+    purgingnodes = false;
+
     nodes.clear();
+    namesearch.clear();
+    fingerprints.clear();
+    nodeciphers.clear();
 
 #ifdef ENABLE_SYNC
     todebris.clear();
     tounlink.clear();
-    fingerprints.clear();
 #endif
 
+    nodeslab.trim();
+
     for (fafc_map::iterator cit = fafcs.begin(); cit != fafcs.end(); cit++)
     {
         for (int i = 2; i--; )
@@ -6531,6 +10219,25 @@ void MegaClient::preadabort(handle ph, m_off_t offset, m_off_t count)
     abortreads(ph, false, offset, count);
 }
 
+bool MegaClient::preadpause(void* appdata, bool pause)
+{
+    bool found = false;
+
+    for (handledrn_map::iterator it = hdrns.begin(); it != hdrns.end(); it++)
+    {
+        for (dr_list::iterator rit = it->second->reads.begin(); rit != it->second->reads.end(); rit++)
+        {
+            if ((*rit)->appdata == appdata)
+            {
+                (*rit)->pause(pause);
+                found = true;
+            }
+        }
+    }
+
+    return found;
+}
+
 void MegaClient::abortreads(handle h, bool p, m_off_t offset, m_off_t count)
 {
     handledrn_map::iterator it;
@@ -6546,7 +10253,10 @@ void MegaClient::abortreads(handle h, bool p, m_off_t offset, m_off_t count)
         {
             if ((offset < 0 || offset == (*it)->offset) && (count < 0 || count == (*it)->count))
             {
-                app->pread_failure(API_EINCOMPLETE, (*it)->drn->retries, (*it)->appdata);
+                if (*it != drn->prefetch)
+                {
+                    app->pread_failure(API_EINCOMPLETE, (*it)->drn->retries, (*it)->appdata);
+                }
 
                 delete *(it++);
             }
@@ -6564,12 +10274,35 @@ bool MegaClient::execdirectreads()
     if (drq.size() < MAXDRSLOTS)
     {
         // fill slots
-        for (dr_list::iterator it = drq.begin(); it != drq.end(); it++)
+        for (dr_list::iterator it = drq.begin(); it != drq.end(); )
         {
-            if (!(*it)->drs)
+            DirectRead* dr = *(it++);
+
+            if (!dr->drs)
             {
-                drs = new DirectReadSlot(*it);
-                (*it)->drs = drs;
+                dr->drn->readahead(dr);
+
+                // serve what we can from the node's cache
+                if (!dr->drn->servecached(dr))
+                {
+                    r = true;
+                    continue;
+                }
+
+                // the data is on its way
+                if (dr->drn->awaitprefetch(dr))
+                {
+                    continue;
+                }
+
+                // reads start in order as the in-flight budget allows
+                if (!inflight.reserve(DirectReadSlot::PAUSEBUFFER))
+                {
+                    break;
+                }
+
+                drs = new DirectReadSlot(dr);
+                dr->drs = drs;
                 r = true;
 
                 if (drq.size() >= MAXDRSLOTS) break;
@@ -6591,6 +10324,43 @@ bool MegaClient::execdirectreads()
     return r;
 }
 
+void MegaClient::setdirectreadcache(m_off_t limit, m_off_t readahead)
+{
+    drcachelimit = limit < 0 ? 0 : limit;
+    drreadahead = readahead < 0 ? 0 : readahead;
+
+    for (handledrn_map::iterator it = hdrns.begin(); it != hdrns.end(); it++)
+    {
+        it->second->cache.setlimit(drcachelimit);
+    }
+}
+
+string* MegaClient::getreadbuffer()
+{
+    if (drbuffers.size())
+    {
+        string* buffer = drbuffers.back();
+
+        drbuffers.pop_back();
+        return buffer;
+    }
+
+    return new string;
+}
+
+void MegaClient::releasereadbuffer(string* buffer)
+{
+    if (drbuffers.size() >= MAXDRBUFFERS)
+    {
+        delete buffer;
+        return;
+    }
+
+    // keep the capacity
+    buffer->clear();
+    drbuffers.push_back(buffer);
+}
+
 // recreate filenames of active PUT transfers
 void MegaClient::updateputs()
 {
@@ -6616,6 +10386,9 @@ error MegaClient::addsync(string* rootpath, const char* debris, string* localdeb
         return API_EACCESS;
     }
 
+    // syncs compare the attributes of all nodes
+    resolveattrs();
+
     Node* n;
     bool inshare;
 
@@ -6712,7 +10485,8 @@ error MegaClient::addsync(string* rootpath, const char* debris, string* localdeb
 
             Sync* sync = new Sync(this, rootpath, debris, localdebris, remotenode, fsfp, inshare, tag);
 
-            if (sync->scan(rootpath, fa))
+            // (not scanned if the changes since the last run are replayed)
+            if (!sync->fullscan || sync->scan(rootpath, fa))
             {
                 e = API_OK;
             }
@@ -6802,6 +10576,57 @@ void MegaClient::addchild(remotenode_map* nchildren, string* name, Node* n, list
     }
 }
 
+// fair share of a client-wide worker job allowance for one of the active syncs
+unsigned MegaClient::syncjobshare(unsigned total)
+{
+    if (!total || syncsactive < 2)
+    {
+        return total;
+    }
+
+    return total / syncsactive ? total / syncsactive : 1;
+}
+
+// time-budget the syncdown()/syncup() calls until endsyncpass()
+void MegaClient::startsyncpass()
+{
+    WAIT_CLASS::bumpds();
+
+    syncpassend = Waiter::ds + SYNCPASSDS;
+    syncpassvisits = 0;
+    syncpasscut = false;
+}
+
+void MegaClient::endsyncpass()
+{
+    syncpassend = NEVER;
+
+    // resume the interrupted pass in the next iteration
+    if (syncpasscut)
+    {
+        LOG_debug << "Sync pass interrupted after " << syncpassvisits << " items";
+        syncactivity = true;
+    }
+}
+
+// (the clock is read every 64 items)
+bool MegaClient::syncpassexpired()
+{
+    if (!EVER(syncpassend))
+    {
+        return false;
+    }
+
+    if (!syncpasscut && !(++syncpassvisits & 63))
+    {
+        WAIT_CLASS::bumpds();
+
+        syncpasscut = Waiter::ds >= syncpassend;
+    }
+
+    return syncpasscut;
+}
+
 // downward sync - recursively scan for tree differences and execute them locally
 // this is first called after the local node tree is complete
 // actions taken:
@@ -6815,16 +10640,29 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 {
     // only use for LocalNodes with a corresponding and properly linked Node
     if (l->type != FOLDERNODE || !l->node || (l->parent && l->node->parent->localnode != l->parent))
+    {
+        l->syncdowndirty = false;
+        return true;
+    }
+
+    // nothing changed in this subtree since the last pass
+    if (!l->syncdowndirty)
     {
         return true;
     }
 
+    l->syncdowndirty = false;
+
     list<string> strings;
     remotenode_map nchildren;
     remotenode_map::iterator rit;
 
     bool success = true;
 
+    // subfolders left dirty / pass interrupted
+    bool pending = false;
+    bool cut = false;
+
     // build array of sync-relevant (in case of clashes, the newest alias wins)
     // remote children by name
     attr_map::iterator ait;
@@ -6832,7 +10670,7 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
     string localname;
 
     // build child hash - nameclash resolution: use newest/largest version
-    for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
+    for (node_vector::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
     {
         // node must be syncable, alive, decrypted and have its name defined to
         // be considered - also, prevent clashes with the local debris folder
@@ -6854,6 +10692,14 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
     // remove remote items that exist locally from hash, recurse into existing folders
     for (localnode_map::iterator lit = l->children.begin(); lit != l->children.end(); )
     {
+        // out of time: resume with this folder in the next pass (the
+        // remaining remote children must not be fetched in the meantime)
+        if (syncpassexpired())
+        {
+            cut = true;
+            break;
+        }
+
         LocalNode* ll = lit->second;
 
         rit = nchildren.find(&ll->name);
@@ -6887,7 +10733,8 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
                 ll->setnode(rit->second);
 
                 // file exists on both sides - do not overwrite if local version newer or same
-                if (ll->mtime > rit->second->mtime)
+                // (or not fingerprinted yet)
+                if (ll->fingerprintjob || ll->mtime > rit->second->mtime)
                 {
                     // local version is newer
                     nchildren.erase(rit);
@@ -6916,6 +10763,11 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
                     success = false;
                 }
 
+                if (ll->syncdowndirty)
+                {
+                    pending = true;
+                }
+
                 nchildren.erase(rit);
             }
 
@@ -6940,6 +10792,7 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
                     if (!(fp == *(FileFingerprint*)ll))
                     {
                         ll->deleted = false;
+                        ll->setdirty();
                     }
                 }
 
@@ -6973,8 +10826,14 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 
     // create/move missing local folders / FolderNodes, initiate downloads of
     // missing local files
-    for (rit = nchildren.begin(); rit != nchildren.end(); rit++)
+    for (rit = nchildren.begin(); !cut && rit != nchildren.end(); rit++)
     {
+        if (syncpassexpired())
+        {
+            cut = true;
+            break;
+        }
+
         if (app->sync_syncable(rit->second))
         {
             if ((ait = rit->second->attrs.map.find('n')) != rit->second->attrs.map.end())
@@ -7077,6 +10936,11 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
                                     LOG_debug << "Syncdown not finished";
                                     success = false;
                                 }
+
+                                if (ll->syncdowndirty)
+                                {
+                                    pending = true;
+                                }
                             }
                             else
                             {
@@ -7096,6 +10960,12 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
         }
     }
 
+    // failed operations are retried with this folder
+    if (!success || pending || cut)
+    {
+        l->syncdowndirty = true;
+    }
+
     return success;
 }
 
@@ -7109,8 +10979,19 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 // for creation
 void MegaClient::syncup(LocalNode* l, dstime* nds)
 {
+    // nothing changed in this subtree since the last pass
+    if (!l->syncupdirty)
+    {
+        return;
+    }
+
+    l->syncupdirty = false;
+
     bool insync = true;
 
+    // items still in progress / pass interrupted: visit again
+    bool pending = false;
+
     list<string> strings;
     remotenode_map nchildren;
     remotenode_map::iterator rit;
@@ -7125,7 +11006,7 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
     {
         // corresponding remote node present: build child hash - nameclash
         // resolution: use newest version
-        for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
+        for (node_vector::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
         {
             // node must be alive
             if ((*it)->syncdeleted == SYNCDEL_NONE)
@@ -7188,11 +11069,27 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
     // remote side
     for (localnode_map::iterator lit = l->children.begin(); lit != l->children.end(); lit++)
     {
+        if (syncpassexpired())
+        {
+            insync = false;
+            pending = true;
+            break;
+        }
+
         LocalNode* ll = lit->second;
 
         if (ll->deleted)
         {
             LOG_debug << "LocalNode deleted " << ll->name;
+            pending = true;
+            continue;
+        }
+
+        if (ll->fingerprintjob)
+        {
+            LOG_debug << "LocalNode being fingerprinted " << ll->name;
+            insync = false;
+            pending = true;
             continue;
         }
 
@@ -7229,6 +11126,7 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
             if (ll->type != rit->second->type)
             {
                 insync = false;
+                pending = true;
                 LOG_warn << "Type changed: " << localname;
                 movetosyncdebris(rit->second, l->sync->inshare);
             }
@@ -7241,6 +11139,7 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
                     if (rit->second->syncget)
                     {
                         LOG_debug << "LocalNode being fetched: " << ll->name;
+                        pending = true;
                         continue;
                     }
 
@@ -7290,7 +11189,7 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
                                         string localpath;
                                         ll->getlocalpath(&localpath);
                                         SymmCipher*symmcipher = ll->node->nodecipher();
-                                        gfx->gendimensionsputfa(NULL, &localpath, ll->node->nodehandle, symmcipher, missingattr);
+                                        gfx->gendimensionsputfa(NULL, &localpath, ll->node->nodehandle, symmcipher, missingattr, ll);
                                     }
                                 }
 
@@ -7317,6 +11216,12 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
 
                     // recurse into directories of equal name
                     syncup(ll, nds);
+
+                    if (ll->syncupdirty)
+                    {
+                        pending = true;
+                    }
+
                     continue;
                 }
             }
@@ -7324,6 +11229,9 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
 
         LOG_verbose << "Unsynced LocalNode: " << ll->name << " " << ll->type;
 
+        // (until the remote node is linked)
+        pending = true;
+
         if (ll->type == FILENODE)
         {
             // do not begin transfer until the file size / mtime has stabilized
@@ -7361,6 +11269,7 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
                     {
                         ll->sync->localbytes -= ll->size;
                         ll->genfingerprint(fa);
+                        ll->ctime = fa->ctime;
                         ll->sync->localbytes += ll->size;                        
 
                         ll->sync->statecacheadd(ll);
@@ -7462,6 +11371,77 @@ void MegaClient::syncup(LocalNode* l, dstime* nds)
     {
         l->treestate(TREESTATE_SYNCED);
     }
+
+    if (pending)
+    {
+        l->syncupdirty = true;
+    }
+}
+
+bool MegaClient::syncmove(LocalNode* l)
+{
+    vector<FileFingerprint*> matches;
+
+    if (!l->isvalid)
+    {
+        return false;
+    }
+
+    resolveattrs();
+    fingerprints.findall(l, &matches);
+
+    for (unsigned i = 0; i < matches.size(); i++)
+    {
+        Node* n = (Node*)matches[i];
+        LocalNode* old = n->localnode;
+
+        // (pending deletions are only executed once synccreate is empty)
+        if (n->type != FILENODE || !old || old == l || !old->notseen || n == l->node)
+        {
+            continue;
+        }
+
+        handle prevparent = n->parent ? n->parent->nodehandle : UNDEF;
+        int creqtag = reqtag;
+
+        reqtag = l->sync->tag;
+
+        if (rename(n, l->parent->node, SYNCDEL_NONE, prevparent) != API_OK)
+        {
+            reqtag = creqtag;
+            continue;
+        }
+
+        if (n->attrs.map['n'] != l->name)
+        {
+            string prevname = n->attrs.map['n'];
+
+            n->attrs.map['n'] = l->name;
+            setattr(n, NULL, prevname.c_str());
+        }
+
+        reqtag = creqtag;
+
+        LOG_debug << "Move " << (old->sync == l->sync ? "within a sync" : "between syncs")
+                  << " detected by fingerprint: " << l->name;
+
+        // overwriting an existing remote node? send it to SyncDebris.
+        if (l->node)
+        {
+            movetosyncdebris(l->node, l->sync->inshare);
+        }
+
+        // the deletion of the old LocalNode no longer concerns the node
+        old->setnode(NULL);
+        l->setnode(n);
+
+        l->treestate(TREESTATE_SYNCING);
+        l->sync->statecacheadd(l);
+
+        return true;
+    }
+
+    return false;
 }
 
 // execute updates stored in synccreate[]
@@ -7501,6 +11481,15 @@ void MegaClient::syncupdate()
 
             l->treestate(TREESTATE_PENDING);
 
+            // a file moved here from another sync, or across filesystems
+            // (no fsid match), still has its node at the old location:
+            // move it rather than copying it and sending the original to
+            // SyncDebris
+            if (l->type == FILENODE && l->parent->node && syncmove(l))
+            {
+                continue;
+            }
+
             if (l->type == FOLDERNODE || (n = nodebyfingerprint(l)))
             {
                 // create remote folder or copy file if it already exists
@@ -7596,11 +11585,7 @@ void MegaClient::putnodes_sync_result(error e, NewNode* nn, int nni)
         {
             if ((n = nodebyhandle(nn[nni].nodehandle)))
             {
-                if (n->fingerprint_it != fingerprints.end())
-                {
-                    fingerprints.erase(n->fingerprint_it);
-                    n->fingerprint_it = fingerprints.end();
-                }
+                fingerprints.remove(n);
             }
         }
         else if (nn[nni].localnode && (n = nn[nni].localnode->node))
@@ -7647,11 +11632,13 @@ void MegaClient::movetosyncdebris(Node* dn, bool unlink)
     {
         if (unlink)
         {
-            dn->tounlink_it = tounlink.insert(dn).first;
+            tounlink.insert(dn);
+            dn->intounlink = true;
         }
         else
         {
-            dn->todebris_it = todebris.insert(dn).first;        
+            todebris.insert(dn);
+            dn->intodebris = true;
         }
     }
 }
@@ -7704,7 +11691,7 @@ void MegaClient::execsyncunlink()
             reqtag = creqtag;
         }
 
-        tn->tounlink_it = tounlink.end();
+        tn->intounlink = false;
         tounlink.erase(tounlink.begin());
     } while (tounlink.size());
 }
@@ -7787,7 +11774,7 @@ void MegaClient::execmovetosyncdebris()
                 else
                 {
                     n->syncdeleted = SYNCDEL_NONE;
-                    n->todebris_it = todebris.end();
+                    n->intodebris = false;
                     todebris.erase(it++);
                 }
             }
@@ -7799,7 +11786,7 @@ void MegaClient::execmovetosyncdebris()
         else if (n->syncdeleted == SYNCDEL_DEBRISDAY)
         {
             n->syncdeleted = SYNCDEL_NONE;
-            n->todebris_it = todebris.end();
+            n->intodebris = false;
             todebris.erase(it++);
         }
         else
@@ -7876,7 +11863,20 @@ bool MegaClient::startxfer(direction_t d, File* f)
 {
     if (!f->transfer)
     {
-        if (d == PUT)
+        if (d == PUT && f->stream)
+        {
+            // the fingerprint of streamed data is only known once it has
+            // been read: a random placeholder keeps the file from being
+            // merged with another transfer
+            if ((f->size = f->stream->size()) < 0)
+            {
+                return false;
+            }
+
+            PrnGen::genblock((byte*)f->crc, sizeof f->crc);
+            f->isvalid = true;
+        }
+        else if (d == PUT)
         {
             if (!f->isvalid)    // (sync LocalNodes always have this set)
             {
@@ -7907,6 +11907,7 @@ bool MegaClient::startxfer(direction_t d, File* f)
         }
 
         Transfer* t;
+        bool restored = false;
         transfer_map::iterator it = transfers[d].find(f);
 
         if (it != transfers[d].end())
@@ -7923,9 +11924,25 @@ bool MegaClient::startxfer(direction_t d, File* f)
         }
         else
         {
-            t = new Transfer(this, d);
+            it = cachedtransfers[d].find(f);
+            restored = it != cachedtransfers[d].end();
+
+            if (restored)
+            {
+                // download state left over from a previous session
+                t = it->second;
+                cachedtransfers[d].erase(it);
+
+                LOG_debug << "Resuming download at " << t->macpos;
+            }
+            else
+            {
+                t = new Transfer(this, d);
+            }
+
             *(FileFingerprint*)t = *(FileFingerprint*)f;
             t->size = f->size;
+            t->stream = f->stream;
             t->tag = reqtag;
             t->transfers_it = transfers[d].insert(pair<FileFingerprint*, Transfer*>((FileFingerprint*)t, t)).first;
             app->transfer_added(t);
@@ -7933,6 +11950,13 @@ bool MegaClient::startxfer(direction_t d, File* f)
 
         f->file_it = t->files.insert(t->files.begin(), f);
         f->transfer = t;
+
+        // a restored download keeps its partial file, so dispatch() treats
+        // it as a resumption and skips the preparation of fresh transfers
+        if (restored)
+        {
+            app->transfer_prepare(t);
+        }
     }
 
     return true;
@@ -7993,19 +12017,18 @@ void MegaClient::pausexfers(direction_t d, bool pause, bool hard)
 
 Node* MegaClient::nodebyfingerprint(FileFingerprint* fingerprint)
 {
-    fingerprint_set::iterator it;
-
-    if ((it = fingerprints.find(fingerprint)) != fingerprints.end())
-    {
-        return (Node*)*it;
-    }
+    // the fingerprint index only holds nodes with decrypted attributes
+    resolveattrs();
 
-    return NULL;
+    return (Node*)fingerprints.find(fingerprint);
 }
 
 // a chunk transfer request failed: record failed protocol & host
 void MegaClient::setchunkfailed(string* url)
 {
+    enginestats.chunkfailures++;
+    storagehostfailed(url);
+
     if (!chunkfailed && url->size() > 19)
     {
         chunkfailed = true;
@@ -8029,6 +12052,152 @@ void MegaClient::setchunkfailed(string* url)
     }
 }
 
+// host part of a storage URL
+static bool storagehost(const string* url, string* host)
+{
+    size_t start = url->find("://");
+
+    if (start == string::npos)
+    {
+        return false;
+    }
+
+    start += 3;
+
+    size_t end = url->find_first_of(":/", start);
+
+    host->assign(*url, start, end == string::npos ? string::npos : end - start);
+
+    return host->size() > 0;
+}
+
+int MegaClient::altportpreference(const string* url)
+{
+    string host;
+
+    if (storagehost(url, &host))
+    {
+        map<string, bool>::iterator it = altports.find(host);
+
+        if (it != altports.end())
+        {
+            return it->second;
+        }
+    }
+
+    return -1;
+}
+
+void MegaClient::setaltportpreference(const string* url, int alt)
+{
+    string host;
+
+    if (storagehost(url, &host))
+    {
+        if (alt < 0)
+        {
+            altports.erase(host);
+        }
+        else
+        {
+            altports[host] = alt != 0;
+        }
+    }
+}
+
+void MegaClient::storagehostfailed(const string* url)
+{
+    string host;
+
+    if (storagehost(url, &host))
+    {
+        StorageHostHealth& health = storagehosts[host];
+
+        if (++health.failures >= CIRCUITFAILURES)
+        {
+            health.bt.backoff();
+
+            if (!health.open)
+            {
+                health.open = true;
+                LOG_warn << "Storage server " << host << " failing - pausing requests to it";
+            }
+        }
+    }
+}
+
+void MegaClient::storagehostok(const string* url)
+{
+    if (storagehosts.size())
+    {
+        string host;
+
+        if (storagehost(url, &host))
+        {
+            map<string, StorageHostHealth>::iterator it = storagehosts.find(host);
+
+            if (it != storagehosts.end())
+            {
+                if (it->second.open)
+                {
+                    LOG_info << "Storage server " << host << " recovered";
+                }
+
+                storagehosts.erase(it);
+            }
+        }
+    }
+}
+
+void MegaClient::setpeerurl(handle h, const char* url)
+{
+    LOG_debug << "LAN peer for node " << h << ": " << url;
+
+    peerurls[h] = url;
+
+    // downloads of the file switch to the peer with their next chunk
+    for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+    {
+        if ((*it)->peerhandle == h)
+        {
+            (*it)->dirty = true;
+        }
+    }
+}
+
+void MegaClient::droppeer(handle h)
+{
+    if (peerurls.erase(h))
+    {
+        LOG_debug << "LAN peer for node " << h << " dropped";
+    }
+}
+
+bool MegaClient::storagehostavailable(const string* url, dstime* retry)
+{
+    if (storagehosts.size())
+    {
+        string host;
+
+        if (storagehost(url, &host))
+        {
+            map<string, StorageHostHealth>::iterator it = storagehosts.find(host);
+
+            if (it != storagehosts.end() && it->second.open && !it->second.bt.armed())
+            {
+                if (retry)
+                {
+                    *retry = it->second.bt.retryin();
+                }
+
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
 bool MegaClient::toggledebug()
 {
      SimpleLogger::setLogLevel((SimpleLogger::logCurrentLevel >= logDebug) ? logWarning : logDebug);
@@ -29,6 +29,7 @@
 #include "mega/transfer.h"
 #include "mega/transferslot.h"
 #include "mega/logging.h"
+#include "mega/aesbatch.h"
 
 namespace mega {
 Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
@@ -37,6 +38,7 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     client = cclient;
     outshares = NULL;
     pendingshares = NULL;
+    pendingattrs = NULL;
     tag = 0;
     appdata = NULL;
 
@@ -44,14 +46,19 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     parenthandle = ph;
 
     parent = NULL;
+    childnames = NULL;
+    sortedchildren = NULL;
+    childindex = 0;
+    namehash = 0;
+    searchslot = 0;
 
 #ifdef ENABLE_SYNC
     localnode = NULL;
     syncget = NULL;
 
     syncdeleted = SYNCDEL_NONE;
-    todebris_it = client->todebris.end();
-    tounlink_it = client->tounlink.end();
+    intodebris = false;
+    intounlink = false;
 #endif
 
     type = t;
@@ -59,6 +66,10 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     size = s;
     owner = u;
 
+    treebytes = (t == FILENODE) ? s : 0;
+    treefiles = (t == FILENODE);
+    treefolders = (t != FILENODE);
+
     copystring(&fileattrstring, fa);
 
     ctime = ts;
@@ -66,6 +77,8 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     inshare = NULL;
     sharekey = NULL;
     foreignkey = false;
+    inpack = false;
+    partial = false;
 
     memset(&changed,-1,sizeof changed);
     changed.removed = false;
@@ -98,11 +111,6 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
         {
             dp->push_back(this);
         }
-
-        if (type == FILENODE)
-        {
-            fingerprint_it = client->fingerprints.end();
-        }
     }
 }
 
@@ -111,23 +119,37 @@ Node::~Node()
     // abort pending direct reads
     client->preadabort(this);
 
+    if (pendingattrs)
+    {
+        delete pendingattrs;
+        client->pendingattrnodes--;
+    }
+
+    // (a purge of all nodes discards the indexes and links as a whole)
+    bool purging = client->purgingnodes;
+
     // remove node's fingerprint from hash
-    if (type == FILENODE && fingerprint_it != client->fingerprints.end())
+    if (type == FILENODE && !purging)
+    {
+        client->fingerprints.remove(this);
+    }
+
+    if (!purging)
     {
-        client->fingerprints.erase(fingerprint_it);
+        client->namesearch.remove(this);
     }
 
 #ifdef ENABLE_SYNC
     // remove from todebris node_set
-    if (todebris_it != client->todebris.end())
+    if (intodebris && !purging)
     {
-        client->todebris.erase(todebris_it);
+        client->todebris.erase(this);
     }
 
     // remove from tounlink node_set
-    if (tounlink_it != client->tounlink.end())
+    if (intounlink && !purging)
     {
-        client->tounlink.erase(tounlink_it);
+        client->tounlink.erase(this);
     }
 #endif
 
@@ -153,18 +175,21 @@ Node::~Node()
 
 
     // remove from parent's children
-    if (parent)
+    if (parent && !purging)
     {
-        parent->children.erase(child_it);
+        unlinkparent();
     }
 
     // delete child-parent associations (normally not used, as nodes are
     // deleted bottom-up)
-    for (node_list::iterator it = children.begin(); it != children.end(); it++)
+    for (node_vector::iterator it = children.begin(); it != children.end() && !purging; it++)
     {
         (*it)->parent = NULL;
     }
 
+    delete childnames;
+    delete sortedchildren;
+
     delete inshare;
     delete sharekey;
 
@@ -174,6 +199,12 @@ Node::~Node()
     {
         localnode->deleted = true;
         localnode->node = NULL;
+        localnode->setdirty();
+    }
+
+    if (parent && !purging && parent->localnode)
+    {
+        parent->localnode->setdirty();
     }
 
     // in case this node is currently being transferred for syncing: abort transfer
@@ -181,6 +212,22 @@ Node::~Node()
 #endif
 }
 
+void* Node::operator new(size_t size, MegaClient* client)
+{
+    return client->nodeslab.alloc(size);
+}
+
+// (only called if the constructor throws)
+void Node::operator delete(void* p, MegaClient*)
+{
+    ObjectSlab::release(p);
+}
+
+void Node::operator delete(void* p)
+{
+    ObjectSlab::release(p);
+}
+
 // update node key and decrypt attributes
 void Node::setkey(const byte* newkey)
 {
@@ -195,6 +242,11 @@ void Node::setkey(const byte* newkey)
 // parse serialized node and return Node object - updates nodes hash and parent
 // mismatch vector
 Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
+{
+    return unserialize(client, d->data(), d->size(), dp);
+}
+
+Node* Node::unserialize(MegaClient* client, const char* data, size_t len, node_vector* dp)
 {
     handle h, ph;
     nodetype_t t;
@@ -204,8 +256,8 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
     const char* fa;
     m_time_t ts;
     const byte* skey;
-    const char* ptr = d->data();
-    const char* end = ptr + d->size();
+    const char* ptr = data;
+    const char* end = ptr + len;
     unsigned short ll;
     Node* n;
     int i;
@@ -306,7 +358,7 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
         skey = NULL;
     }
 
-    n = new Node(client, dp, h, ph, t, s, u, fa, ts);
+    n = new (client) Node(client, dp, h, ph, t, s, u, fa, ts);
 
     if (k)
     {
@@ -323,7 +375,7 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
                && --numshares);
     }
 
-    ptr = n->attrs.unserialize(ptr);
+    ptr = n->attrs.unserialize(ptr, end);
 
     n->setfingerprint();
 
@@ -338,8 +390,22 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
 }
 
 // serialize node - nodes with pending or RSA keys are unsupported
+// parent, type, fingerprint and name for the local cache's node index
+bool Node::dbkeys(DbNodeKeys* k)
+{
+    k->h = nodehandle;
+    k->parent = parent ? parent->nodehandle : UNDEF;
+    k->type = type;
+    k->fingerprint = (type == FILENODE && isvalid) ? FingerprintIndex::hash(this) : 0;
+    k->name = NodeNameIndex::hash(displayname());
+
+    return true;
+}
+
 bool Node::serialize(string* d)
 {
+    resolveattrs();
+
     // do not serialize encrypted nodes
     if (attrstring)
     {
@@ -348,6 +414,7 @@ bool Node::serialize(string* d)
         //Last attempt to decrypt the node
         applykey();
         setattr();
+        resolveattrs();
 
         if (attrstring)
         {
@@ -521,44 +588,150 @@ byte* Node::decryptattr(SymmCipher* key, const char* attrstring, int attrstrlen)
 // return temporary SymmCipher for this nodekey
 SymmCipher* Node::nodecipher()
 {
-    if (client->tmpcipher.setkey(&nodekey))
+    return client->nodeciphers.get(this);
+}
+
+NodeCipherCache::NodeCipherCache()
+{
+    for (unsigned i = SLOTS; i--; )
     {
-        return &client->tmpcipher;
+        slots[i].h = UNDEF;
+        slots[i].keylength = 0;
+        slots[i].cipher = NULL;
     }
+}
 
-    return NULL;
+NodeCipherCache::~NodeCipherCache()
+{
+    clear();
+}
+
+SymmCipher* NodeCipherCache::get(Node* n)
+{
+    unsigned l = n->nodekey.size();
+
+    if (l != FILENODEKEYLENGTH && l != FOLDERNODEKEYLENGTH)
+    {
+        return NULL;
+    }
+
+    Slot* s = slots + (unsigned)((n->nodehandle * 0x9e3779b97f4a7c15ULL) >> (64 - SLOTBITS));
+
+    if (!s->cipher)
+    {
+        s->cipher = new SymmCipher;
+    }
+    else if (s->h == n->nodehandle && s->keylength == l && !memcmp(s->key, n->nodekey.data(), l))
+    {
+        return s->cipher;
+    }
+
+    s->cipher->setkey(&n->nodekey);
+    s->h = n->nodehandle;
+    s->keylength = l;
+    memcpy(s->key, n->nodekey.data(), l);
+
+    return s->cipher;
+}
+
+void NodeCipherCache::clear()
+{
+    for (unsigned i = SLOTS; i--; )
+    {
+        delete slots[i].cipher;
+
+        slots[i].h = UNDEF;
+        slots[i].keylength = 0;
+        slots[i].cipher = NULL;
+    }
 }
 
-// decrypt attributes and build attribute hash
+// decrypt attributes and build attribute hash (deferred until first access
+// if the client decrypts attributes lazily)
 void Node::setattr()
+{
+    // (the names of children of indexed folders are needed right away)
+    if (attrstring && nodekey.size() == (size_t)keylength() && client->deferattrs()
+     && !(parent && parent->childnames))
+    {
+        if (pendingattrs)
+        {
+            delete pendingattrs;
+        }
+        else
+        {
+            client->pendingattrnodes++;
+        }
+
+        pendingattrs = attrstring;
+        attrstring = NULL;
+        return;
+    }
+
+    decryptattrs();
+}
+
+void Node::decryptpendingattrs()
+{
+    delete attrstring;
+    attrstring = pendingattrs;
+    pendingattrs = NULL;
+    client->pendingattrnodes--;
+
+    decryptattrs();
+}
+
+void Node::decryptattrs()
 {
     byte* buf;
     SymmCipher* cipher;
 
     if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
     {
-        JSON json;
-        nameid name;
-        string* t;
+        loadattrs(buf);
 
-        json.begin((char*)buf + 5);
+        delete[] buf;
 
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
-        {
-            JSON::unescape(t);
+        finishattrs();
+    }
+}
 
-            if (name == 'n')
-            {
-                client->fsaccess->normalize(t);
-            }
-        }
+// parse decrypted attribute JSON (does not touch any client state)
+void Node::loadattrs(byte* buf)
+{
+    JSON json;
+    nameid name;
+    string* t;
 
-        setfingerprint();
+    json.begin((char*)buf + 5);
 
-        delete[] buf;
+    while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+    {
+        JSON::unescape(t);
+    }
+}
 
-        delete attrstring;
-        attrstring = NULL;
+// normalize the name, set up the fingerprint and discard the encrypted
+// attribute string
+void Node::finishattrs()
+{
+    attr_map::iterator it = attrs.map.find('n');
+
+    if (it != attrs.map.end())
+    {
+        client->fsaccess->normalize(&it->second);
+    }
+
+    setfingerprint();
+
+    delete attrstring;
+    attrstring = NULL;
+
+    nameupdated();
+
+    if (parent)
+    {
+        parent->childrenchanged();
     }
 }
 
@@ -568,10 +741,7 @@ void Node::setfingerprint()
 {
     if (type == FILENODE && nodekey.size() >= sizeof crc)
     {
-        if (fingerprint_it != client->fingerprints.end())
-        {
-            client->fingerprints.erase(fingerprint_it);
-        }
+        client->fingerprints.remove(this);
 
         attr_map::iterator it = attrs.map.find('c');
 
@@ -591,13 +761,15 @@ void Node::setfingerprint()
             mtime = ctime;
         }
 
-        fingerprint_it = client->fingerprints.insert((FileFingerprint*)this);
+        client->fingerprints.add(this);
     }
 }
 
 // return file/folder name or special status strings
 const char* Node::displayname() const
 {
+    const_cast<Node*>(this)->resolveattrs();
+
     // not yet decrypted
     if (attrstring)
     {
@@ -657,10 +829,34 @@ int Node::hasfileattribute(fatype t) const
 // attempt to apply node key - sets nodekey to a raw key if successful
 bool Node::applykey()
 {
-    int keylength = (type == FILENODE)
-                   ? FILENODEKEYLENGTH + 0
-                   : FOLDERNODEKEYLENGTH + 0;
+    SymmCipher* sc;
+    const char* k;
+
+    if (!(k = locatekey(&sc)))
+    {
+        return false;
+    }
+
+    byte key[FILENODEKEYLENGTH];
+
+    if (client->decryptkey(k, key, keylength(), sc, 0, nodehandle))
+    {
+        nodekey.assign((const char*)key, keylength());
+        setattr();
+    }
 
+    return true;
+}
+
+int Node::keylength() const
+{
+    return (type == FILENODE) ? FILENODEKEYLENGTH + 0 : FOLDERNODEKEYLENGTH + 0;
+}
+
+// locate the encrypted key to use and its cipher (NULL: no decryption
+// needed, or no suitable key available yet)
+const char* Node::locatekey(SymmCipher** sc)
+{
     if (type > FOLDERNODE)
     {
         //Root nodes contain an empty attrstring
@@ -668,18 +864,19 @@ bool Node::applykey()
         attrstring = NULL;
     }
 
-    if (nodekey.size() == keylength || !nodekey.size())
+    if (nodekey.size() == (size_t)keylength() || !nodekey.size())
     {
-        return false;
+        return NULL;
     }
 
     int l = -1;
     size_t t = 0;
     handle h;
     const char* k = NULL;
-    SymmCipher* sc = &client->key;
     handle me = client->loggedin() ? client->me : *client->rootnodes;
 
+    *sc = &client->key;
+
     while ((t = nodekey.find_first_of(':', t)) != string::npos)
     {
         // compound key: locate suitable subkey (always symmetric)
@@ -710,7 +907,7 @@ bool Node::applykey()
                     continue;
                 }
 
-                sc = n->sharekey;
+                *sc = n->sharekey;
 
                 // this key will be rewritten when the node leaves the outbound share
                 foreignkey = true;
@@ -723,27 +920,227 @@ bool Node::applykey()
 
     // no: found => personal key, use directly
     // otherwise, no suitable key available yet - bail (it might arrive soon)
-    if (!k)
+    if (!k && l < 0)
+    {
+        k = nodekey.c_str();
+    }
+
+    return k;
+}
+
+NodeKeyJob::NodeKeyJob(bool ckeysonly)
+{
+    keysonly = ckeysonly;
+    finished = false;
+}
+
+void NodeKeyJob::add(Node* n, const char* k, SymmCipher* sc)
+{
+    items.resize(items.size() + 1);
+
+    Item* item = &items.back();
+
+    item->node = n;
+    item->k = k;
+    item->sc = sc;
+    item->ok = false;
+    item->attrs = false;
+}
+
+void NodeKeyJob::run()
+{
+    // all keys of the batch are unwrapped, then all attributes decrypted, in
+    // one AesBatch each (which does not touch the shared SymmCipher
+    // instances, only their raw keys)
+    AesBatch batch;
+    vector<byte> keys(items.size() * FILENODEKEYLENGTH);
+    vector<byte*> attrs(items.size());
+
+    for (unsigned i = 0; i < items.size(); i++)
     {
-        if (l < 0)
+        Item* item = &items[i];
+        int keylength = item->node->keylength();
+        byte* key = &keys[i * FILENODEKEYLENGTH];
+
+        if (Base64::atob(item->k, key, keylength) == keylength)
         {
-            k = nodekey.c_str();
+            batch.add(item->sc->key, key, keylength, AesBatch::ECB_DECRYPT);
+            item->ok = true;
         }
-        else
+    }
+
+    batch.run();
+
+    for (unsigned i = 0; i < items.size(); i++)
+    {
+        Item* item = &items[i];
+        Node* n = item->node;
+
+        if (!item->ok)
         {
-            return false;
+            continue;
+        }
+
+        n->nodekey.assign((const char*)&keys[i * FILENODEKEYLENGTH], n->keylength());
+
+        if (!keysonly && n->attrstring && n->attrstring->size())
+        {
+            // the attribute key: folded file key or folder key
+            byte attrkey[SymmCipher::KEYLENGTH];
+            int l = n->attrstring->size() * 3 / 4 + 3;
+
+            memcpy(attrkey, n->nodekey.data(), sizeof attrkey);
+
+            if (n->nodekey.size() == FILENODEKEYLENGTH)
+            {
+                SymmCipher::xorblock((const byte*)n->nodekey.data() + SymmCipher::KEYLENGTH, attrkey);
+            }
+
+            attrs[i] = new byte[l];
+            l = Base64::atob(n->attrstring->c_str(), attrs[i], l);
+
+            if (l & (SymmCipher::BLOCKSIZE - 1))
+            {
+                delete[] attrs[i];
+                attrs[i] = NULL;
+            }
+            else
+            {
+                batch.add(attrkey, attrs[i], l, AesBatch::CBC_DECRYPT);
+            }
         }
     }
 
-    byte key[FILENODEKEYLENGTH];
+    batch.run();
 
-    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    for (unsigned i = 0; i < items.size(); i++)
     {
-        nodekey.assign((const char*)key, keylength);
-        setattr();
+        if (attrs[i])
+        {
+            if (!memcmp(attrs[i], "MEGA{\"", 6))
+            {
+                items[i].node->loadattrs(attrs[i]);
+                items[i].attrs = true;
+            }
+
+            delete[] attrs[i];
+        }
     }
 
-    return true;
+    finished = true;
+}
+
+// apply the results on the engine thread
+RsaKeyJob::RsaKeyJob(const AsymmCipher* casymkey)
+{
+    asymkey = *casymkey;
+    finished = false;
+}
+
+void RsaKeyJob::add(Node* n, NewShare* s, const char* k, int keylength)
+{
+    items.resize(items.size() + 1);
+
+    Item* item = &items.back();
+
+    item->node = n;
+    item->share = s;
+    item->k = k;
+    item->keylength = keylength;
+    item->ok = false;
+}
+
+void RsaKeyJob::run()
+{
+    for (unsigned i = 0; i < items.size(); i++)
+    {
+        items[i].ok = MegaClient::rsadecryptkey(&asymkey, items[i].k, items[i].key, items[i].keylength);
+    }
+
+    finished = true;
+}
+
+void NodeKeyJob::merge()
+{
+    for (unsigned i = 0; i < items.size(); i++)
+    {
+        if (!items[i].ok)
+        {
+            LOG_warn << "Corrupt or invalid symmetric node key";
+        }
+        else if (items[i].attrs)
+        {
+            items[i].node->finishattrs();
+        }
+        else if (keysonly)
+        {
+            items[i].node->setattr();
+        }
+    }
+}
+
+// remove from parent's children (the last child takes this node's position)
+void Node::unlinkparent()
+{
+    propagatetotals(-1);
+
+    if (parent->childnames)
+    {
+        parent->childnames->remove(this);
+    }
+
+    parent->childrenchanged();
+
+    Node* last = parent->children.back();
+
+    parent->children[childindex] = last;
+    last->childindex = childindex;
+    parent->children.pop_back();
+}
+
+void Node::propagatetotals(int sign)
+{
+    for (Node* p = parent; p; p = p->parent)
+    {
+        p->treebytes += sign * treebytes;
+        p->treefiles += sign * (int)treefiles;
+        p->treefolders += sign * (int)treefolders;
+    }
+}
+
+void Node::indexchildnames()
+{
+    NodeNameIndex* index = new NodeNameIndex;
+
+    index->reserve(children.size());
+
+    for (node_vector::iterator it = children.begin(); it != children.end(); it++)
+    {
+        (*it)->namehash = NodeNameIndex::hash((*it)->displayname());
+        index->add(*it);
+    }
+
+    childnames = index;
+}
+
+void Node::nameupdated()
+{
+    if (parent && parent->childnames && parent->childnames->remove(this))
+    {
+        namehash = NodeNameIndex::hash(displayname());
+        parent->childnames->add(this);
+    }
+
+    client->namesearch.update(this);
+}
+
+void Node::childrenchanged()
+{
+    if (sortedchildren)
+    {
+        delete sortedchildren;
+        sortedchildren = NULL;
+    }
 }
 
 // returns whether node was moved
@@ -756,14 +1153,26 @@ bool Node::setparent(Node* p)
 
     if (parent)
     {
-        parent->children.erase(child_it);
+        unlinkparent();
     }
 
     parent = p;
 
     if (parent)
     {
-        child_it = parent->children.insert(parent->children.end(), this);
+        childindex = parent->children.size();
+        parent->children.push_back(this);
+
+        propagatetotals(1);
+
+        if (parent->childnames)
+        {
+            // (displayname() may resolve deferred attributes)
+            namehash = NodeNameIndex::hash(displayname());
+            parent->childnames->add(this);
+        }
+
+        parent->childrenchanged();
     }
 
 #ifdef ENABLE_SYNC
@@ -827,6 +1236,8 @@ NodeCore::~NodeCore()
 }
 
 #ifdef ENABLE_SYNC
+localnode_map LocalNodeChildren::none;
+
 // set, change or remove LocalNode's parent and name/localname/slocalname.
 // newlocalpath must be a full path and must not point to an empty string.
 // no shortname allowed as the last path component.
@@ -837,11 +1248,23 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
     int nc = 0;
     Sync* oldsync = NULL;
 
+    // (again once the new linkage is complete, as paths can be looked up
+    // in between)
+    sync->client->localpathgen++;
+
     if (parent)
     {
+        parent->setdirty();
+
         // remove existing child linkage
         parent->children.erase(&localname);
 
+        if (tscounted)
+        {
+            counttreestate(-1);
+            tscounted = false;
+        }
+
         if (slocalname.size())
         {
             parent->schildren.erase(&slocalname);
@@ -938,11 +1361,19 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
         // (we don't construct a UTF-8 or sname for the root path)
         parent->children[&localname] = this;
 
+        cts = ts;
+        counttreestate(1);
+        tscounted = true;
+
         if (sync->client->fsaccess->getsname(newlocalpath, &slocalname))
         {
             parent->schildren[&slocalname] = this;
         }
 
+        sync->client->localpathgen++;
+
+        setdirty();
+
         parent->treestate();
 
         if (todelete)
@@ -976,6 +1407,16 @@ void LocalNode::bumpnagleds()
     nagleds = sync->client->waiter->ds + 11;
 }
 
+void LocalNode::setdirty()
+{
+    // (a flagged folder's ancestors are flagged as well)
+    for (LocalNode* l = type == FOLDERNODE ? this : parent; l && !(l->syncupdirty && l->syncdowndirty); l = l->parent)
+    {
+        l->syncupdirty = true;
+        l->syncdowndirty = true;
+    }
+}
+
 // initialize fresh LocalNode object - must be called exactly once
 void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string* cfullpath)
 {
@@ -987,12 +1428,25 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
     created = false;
     reported = false;
     checked = false;
+    syncupdirty = false;
+    syncdowndirty = false;
+    ctime = 0;
+    dirmtime = 0;
+    listedmtime = 0;
+    cachedpath = NULL;
+    cachedpathgen = 0;
+    fingerprintjob = NULL;
     syncxfer = true;
+    owner = sync->tag;
     newnode = NULL;
     parent_dbid = 0;
 
     ts = TREESTATE_NONE;
     dts = TREESTATE_NONE;
+    cts = TREESTATE_NONE;
+    tscounted = false;
+    pendingchildren = 0;
+    syncingchildren = 0;
 
     type = ctype;
     syncid = sync->client->nextsyncid();
@@ -1019,6 +1473,8 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
         sync->dirnotify->addnotify(this, cfullpath);
     }
 
+    setdirty();
+
     sync->client->syncactivity = true;
 
     sync->localnodes[type]++;
@@ -1032,6 +1488,13 @@ void LocalNode::treestate(treestate_t newts)
         ts = newts;
     }
 
+    if (tscounted && cts != ts)
+    {
+        counttreestate(-1);
+        cts = ts;
+        counttreestate(1);
+    }
+
     if (ts != dts)
     {
         sync->client->app->syncupdate_treestate(this);
@@ -1045,20 +1508,17 @@ void LocalNode::treestate(treestate_t newts)
         }
         else if (newts != dts && (ts != TREESTATE_SYNCED || parent->ts != TREESTATE_SYNCED))
         {
-            parent->ts = TREESTATE_SYNCED;
-
-            for (localnode_map::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+            if (parent->syncingchildren)
             {
-                if (it->second->ts == TREESTATE_SYNCING)
-                {
-                    parent->ts = TREESTATE_SYNCING;
-                    break;
-                }
-
-                if (it->second->ts == TREESTATE_PENDING && parent->ts == TREESTATE_SYNCED)
-                {
-                    parent->ts = TREESTATE_PENDING;
-                }
+                parent->ts = TREESTATE_SYNCING;
+            }
+            else if (parent->pendingchildren)
+            {
+                parent->ts = TREESTATE_PENDING;
+            }
+            else
+            {
+                parent->ts = TREESTATE_SYNCED;
             }
         }
 
@@ -1068,6 +1528,18 @@ void LocalNode::treestate(treestate_t newts)
     dts = ts;
 }
 
+void LocalNode::counttreestate(int delta)
+{
+    if (cts == TREESTATE_PENDING)
+    {
+        parent->pendingchildren += delta;
+    }
+    else if (cts == TREESTATE_SYNCING)
+    {
+        parent->syncingchildren += delta;
+    }
+}
+
 void LocalNode::setnode(Node* cnode)
 {
     if (node && (node != cnode) && node->localnode)
@@ -1076,6 +1548,11 @@ void LocalNode::setnode(Node* cnode)
         node->localnode = NULL;
     }
 
+    if (deleted || node != cnode)
+    {
+        setdirty();
+    }
+
     deleted = false;
 
     node = cnode;
@@ -1136,6 +1613,21 @@ void LocalNode::setfsid(handle newfsid)
     }
 }
 
+void* LocalNode::operator new(size_t size, MegaClient* client)
+{
+    return client->localnodeslab.alloc(size);
+}
+
+void LocalNode::operator delete(void* p, MegaClient*)
+{
+    ObjectSlab::release(p);
+}
+
+void LocalNode::operator delete(void* p)
+{
+    ObjectSlab::release(p);
+}
+
 LocalNode::~LocalNode()
 {
     if (sync->state == SYNC_ACTIVE || sync->state == SYNC_INITIALSCAN)
@@ -1159,9 +1651,16 @@ LocalNode::~LocalNode()
         newnode->localnode = NULL;
     }
 
+    if (fingerprintjob)
+    {
+        fingerprintjob->localnode = NULL;
+    }
+
 #ifdef USE_INOTIFY
     if (sync->dirnotify)
     {
+        bool deactivated = false;
+
         // deactivate corresponding notifyq records
         for (int q = DirNotify::RETRY; q >= DirNotify::DIREVENTS; q--)
         {
@@ -1170,9 +1669,16 @@ LocalNode::~LocalNode()
                 if ((*it).localnode == this)
                 {
                     (*it).localnode = (LocalNode*)~0;
+                    deactivated = true;
                 }
             }
         }
+
+        // the coalescing state refers to the deactivated entries
+        if (deactivated)
+        {
+            sync->dirnotify->resetcoalescing();
+        }
     }
 #endif
     
@@ -1208,6 +1714,8 @@ LocalNode::~LocalNode()
         delete it++->second;
     }
 
+    delete cachedpath;
+
     if (node)
     {
         // move associated node to SyncDebris unless the sync is currently
@@ -1225,33 +1733,45 @@ LocalNode::~LocalNode()
 
 void LocalNode::getlocalpath(string* path, bool sdisable) const
 {
-    const LocalNode* l = this;
+    if (parent)
+    {
+        *path = *parent->folderpath();
+        path->append(sync->client->fsaccess->localseparator);
+    }
+    else
+    {
+        path->erase();
+    }
 
-    path->erase();
+    // use short name, if available (less likely to overflow MAXPATH,
+    // perhaps faster?) and sdisable not set
+    path->append((!sdisable && slocalname.size()) ? slocalname : localname);
+}
 
-    while (l)
+const string* LocalNode::folderpath() const
+{
+    if (!cachedpath || cachedpathgen != sync->client->localpathgen)
     {
-        // use short name, if available (less likely to overflow MAXPATH,
-        // perhaps faster?) and sdisable not set
-        if (!sdisable && l->slocalname.size())
+        if (!cachedpath)
         {
-            path->insert(0, l->slocalname);
-        }
-        else
-        {
-            path->insert(0, l->localname);
+            cachedpath = new string;
         }
 
-        if ((l = l->parent))
+        if (parent)
         {
-            path->insert(0, sync->client->fsaccess->localseparator);
+            *cachedpath = *parent->folderpath();
+            cachedpath->append(sync->client->fsaccess->localseparator);
         }
-
-        if (sdisable)
+        else
         {
-            sdisable = false;
+            cachedpath->erase();
         }
+
+        cachedpath->append(slocalname.size() ? slocalname : localname);
+        cachedpathgen = sync->client->localpathgen;
     }
+
+    return cachedpath;
 }
 
 void LocalNode::getlocalsubpath(string* path) const
@@ -1360,6 +1880,19 @@ bool LocalNode::serialize(string* d)
         byte buf[sizeof mtime+1];
 
         d->append((const char*)buf, Serialize64::serialize(buf, mtime));
+
+        // optional: older versions stop after the mtime
+        if (ctime)
+        {
+            d->append((const char*)buf, Serialize64::serialize(buf, ctime));
+        }
+    }
+    else if (dirmtime)
+    {
+        byte buf[sizeof dirmtime+1];
+
+        // optional: older versions stop after the name
+        d->append((const char*)buf, Serialize64::serialize(buf, dirmtime));
     }
 
     return true;
@@ -1417,6 +1950,8 @@ LocalNode* LocalNode::unserialize(Sync* sync, string* d)
     const char* localname = ptr;
     ptr += localnamelen;
     uint64_t mtime = 0;
+    uint64_t ctime = 0;
+    uint64_t dirmtime = 0;
 
     if (type == FILENODE)
     {
@@ -1426,14 +1961,29 @@ LocalNode* LocalNode::unserialize(Sync* sync, string* d)
             return NULL;
         }
 
-        if (!Serialize64::unserialize((byte*)ptr + 4 * sizeof(int32_t), end - ptr - 4 * sizeof(int32_t), &mtime))
+        int len;
+
+        if (!(len = Serialize64::unserialize((byte*)ptr + 4 * sizeof(int32_t), end - ptr - 4 * sizeof(int32_t), &mtime)))
         {
             LOG_err << "LocalNode unserialization failed - malformed fingerprint mtime";
             return NULL;
         }
+
+        // optional ctime
+        const char* cptr = ptr + 4 * sizeof(int32_t) + len;
+
+        if (len > 0 && cptr < end && Serialize64::unserialize((byte*)cptr, end - cptr, &ctime) < 0)
+        {
+            ctime = 0;
+        }
+    }
+    else if (ptr < end && Serialize64::unserialize((byte*)ptr, end - ptr, &dirmtime) < 0)
+    {
+        // optional folder mtime
+        dirmtime = 0;
     }
 
-    LocalNode* l = new LocalNode();
+    LocalNode* l = new (sync->client) LocalNode();
 
     l->type = type;
     l->size = size;
@@ -1448,6 +1998,11 @@ LocalNode* LocalNode::unserialize(Sync* sync, string* d)
 
     memcpy(l->crc, ptr, sizeof l->crc);
     l->mtime = mtime;
+    l->ctime = ctime;
+    l->dirmtime = dirmtime;
+    l->listedmtime = 0;
+    l->cachedpath = NULL;
+    l->cachedpathgen = 0;
     l->isvalid = 1;
 
     l->node = sync->client->nodebyhandle(h);
@@ -1457,6 +2012,7 @@ LocalNode* LocalNode::unserialize(Sync* sync, string* d)
     // FIXME: serialize/unserialize
     l->created = false;
     l->reported = false;
+    l->fingerprintjob = NULL;
 
     return l;
 }
@@ -0,0 +1,636 @@
+/**
+ * @file nodemap.cpp
+ * @brief Indexes of nodes by node handle and by name
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/nodemap.h"
+#include "mega/node.h"
+#include "mega/filefingerprint.h"
+#include "mega/logging.h"
+
+namespace mega {
+NodeMap::NodeMap()
+{
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    bits = 0;
+    undefentry = NULL;
+}
+
+NodeMap::~NodeMap()
+{
+    delete[] slots;
+}
+
+// move all entries to a table of newcapacity slots (a power of two)
+void NodeMap::rehash(size_t newcapacity)
+{
+    Slot* oldslots = slots;
+    size_t oldcapacity = capacity;
+
+    slots = new Slot[newcapacity];
+    capacity = newcapacity;
+
+    for (bits = 0; ((size_t)1 << bits) < capacity; bits++);
+
+    for (size_t i = capacity; i--; )
+    {
+        slots[i].first = UNDEF;
+        slots[i].second = NULL;
+    }
+
+    for (size_t i = oldcapacity; i--; )
+    {
+        if (oldslots[i].first != UNDEF)
+        {
+            size_t j = slot(oldslots[i].first);
+
+            while (slots[j].first != UNDEF)
+            {
+                j = (j + 1) & (capacity - 1);
+            }
+
+            slots[j] = oldslots[i];
+        }
+    }
+
+    delete[] oldslots;
+}
+
+void NodeMap::reserve(size_t n)
+{
+    size_t newcapacity = MINCAPACITY;
+
+    while (newcapacity / 4 * 3 < n)
+    {
+        newcapacity *= 2;
+    }
+
+    if (newcapacity > capacity)
+    {
+        rehash(newcapacity);
+    }
+}
+
+Node*& NodeMap::operator[](handle h)
+{
+    if (h == UNDEF)
+    {
+        LOG_err << "Invalid node handle";
+        undefentry = NULL;
+        return undefentry;
+    }
+
+    if (count + 1 > capacity / 4 * 3)
+    {
+        rehash(capacity ? capacity * 2 : MINCAPACITY);
+    }
+
+    size_t i = slot(h);
+
+    while (slots[i].first != h)
+    {
+        if (slots[i].first == UNDEF)
+        {
+            slots[i].first = h;
+            count++;
+            break;
+        }
+
+        i = (i + 1) & (capacity - 1);
+    }
+
+    return slots[i].second;
+}
+
+size_t NodeMap::erase(handle h)
+{
+    if (h == UNDEF)
+    {
+        return 0;
+    }
+
+    iterator it = find(h);
+
+    if (it == end())
+    {
+        return 0;
+    }
+
+    // backward-shift deletion: close the gap by moving up subsequent entries
+    // of the probe sequence that would otherwise become unreachable
+    size_t i = &*it - slots;
+    size_t j = i;
+
+    for (;;)
+    {
+        j = (j + 1) & (capacity - 1);
+
+        if (slots[j].first == UNDEF)
+        {
+            break;
+        }
+
+        // distance of entry j from its home slot vs. distance from the gap
+        size_t home = slot(slots[j].first);
+
+        if (((j - home) & (capacity - 1)) >= ((j - i) & (capacity - 1)))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i].first = UNDEF;
+    slots[i].second = NULL;
+    count--;
+
+    if (capacity > MINCAPACITY && count < capacity / 8)
+    {
+        rehash(capacity / 2);
+    }
+
+    return 1;
+}
+
+void NodeMap::clear()
+{
+    delete[] slots;
+
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    bits = 0;
+}
+
+HashedPointerSet::HashedPointerSet()
+{
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    bits = 0;
+}
+
+HashedPointerSet::~HashedPointerSet()
+{
+    delete[] slots;
+}
+
+void HashedPointerSet::rehash(size_t newcapacity)
+{
+    Slot* oldslots = slots;
+    size_t oldcapacity = capacity;
+
+    slots = new Slot[newcapacity];
+    capacity = newcapacity;
+
+    for (bits = 0; ((size_t)1 << bits) < capacity; bits++);
+
+    for (size_t i = capacity; i--; )
+    {
+        slots[i].hash = 0;
+        slots[i].item = NULL;
+    }
+
+    for (size_t i = oldcapacity; i--; )
+    {
+        if (oldslots[i].item)
+        {
+            size_t j = slot(oldslots[i].hash);
+
+            while (slots[j].item)
+            {
+                j = next(j);
+            }
+
+            slots[j] = oldslots[i];
+        }
+    }
+
+    delete[] oldslots;
+}
+
+void HashedPointerSet::reserve(size_t n)
+{
+    size_t newcapacity = MINCAPACITY;
+
+    while (newcapacity / 4 * 3 < n)
+    {
+        newcapacity *= 2;
+    }
+
+    if (newcapacity > capacity)
+    {
+        rehash(newcapacity);
+    }
+}
+
+void HashedPointerSet::insert(uint32_t h, void* item)
+{
+    if (count + 1 > capacity / 4 * 3)
+    {
+        rehash(capacity ? capacity * 2 : MINCAPACITY);
+    }
+
+    size_t i = slot(h);
+
+    while (slots[i].item)
+    {
+        i = next(i);
+    }
+
+    slots[i].hash = h;
+    slots[i].item = item;
+    count++;
+}
+
+bool HashedPointerSet::erase(uint32_t h, void* item)
+{
+    if (!count)
+    {
+        return false;
+    }
+
+    size_t i = slot(h);
+
+    while (slots[i].item != item)
+    {
+        if (!slots[i].item)
+        {
+            return false;
+        }
+
+        i = next(i);
+    }
+
+    // backward-shift deletion (see NodeMap::erase())
+    size_t j = i;
+
+    for (;;)
+    {
+        j = next(j);
+
+        if (!slots[j].item)
+        {
+            break;
+        }
+
+        size_t home = slot(slots[j].hash);
+
+        if (((j - home) & (capacity - 1)) >= ((j - i) & (capacity - 1)))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i].hash = 0;
+    slots[i].item = NULL;
+    count--;
+
+    if (capacity > MINCAPACITY && count < capacity / 8)
+    {
+        rehash(capacity / 2);
+    }
+
+    return true;
+}
+
+void HashedPointerSet::clear()
+{
+    delete[] slots;
+
+    slots = NULL;
+    capacity = 0;
+    count = 0;
+    bits = 0;
+}
+
+// 32-bit FNV-1a
+uint32_t NodeNameIndex::hash(const char* name)
+{
+    uint32_t h = 2166136261U;
+
+    while (*name)
+    {
+        h = (h ^ (unsigned char)*name++) * 16777619U;
+    }
+
+    return h;
+}
+
+void NodeNameIndex::add(Node* n)
+{
+    insert(n->namehash, n);
+}
+
+bool NodeNameIndex::remove(Node* n)
+{
+    return erase(n->namehash, n);
+}
+
+Node* NodeNameIndex::find(const char* name) const
+{
+    if (count)
+    {
+        uint32_t h = hash(name);
+
+        for (size_t i = slot(h); slots[i].item; i = next(i))
+        {
+            if (slots[i].hash == h && !strcmp(((Node*)slots[i].item)->displayname(), name))
+            {
+                return (Node*)slots[i].item;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+NamePool::NamePool()
+{
+    bytes = 0;
+}
+
+const char* NamePool::acquire(const char* name)
+{
+    uint32_t h = NodeNameIndex::hash(name);
+    Entry* e;
+
+    if (count)
+    {
+        for (size_t i = slot(h); slots[i].item; i = next(i))
+        {
+            e = (Entry*)slots[i].item;
+
+            if (slots[i].hash == h && !strcmp((const char*)(e + 1), name))
+            {
+                e->refs++;
+                return (const char*)(e + 1);
+            }
+        }
+    }
+
+    size_t len = strlen(name) + 1;
+
+    e = (Entry*)new char[sizeof(Entry) + len];
+    e->refs = 1;
+    e->hash = h;
+    memcpy(e + 1, name, len);
+
+    insert(h, e);
+    bytes += sizeof(Entry) + len;
+
+    return (const char*)(e + 1);
+}
+
+void NamePool::release(const char* name)
+{
+    if (!name)
+    {
+        return;
+    }
+
+    Entry* e = entry(name);
+
+    if (!--e->refs)
+    {
+        erase(e->hash, e);
+        bytes -= sizeof(Entry) + strlen(name) + 1;
+        delete[] (char*)e;
+    }
+}
+
+// the CRC is the strongest discriminator: it is either sampled file content
+// or key material
+uint32_t FingerprintIndex::hash(const FileFingerprint* f)
+{
+    uint64_t h = (uint64_t)f->size * 0x9e3779b97f4a7c15ULL ^ (uint64_t)f->mtime;
+
+    h ^= (uint32_t)f->crc[0] ^ ((uint64_t)(uint32_t)f->crc[1] << 32);
+    h ^= h >> 29;
+
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+bool FingerprintIndex::matches(const FileFingerprint* a, const FileFingerprint* b)
+{
+    return a->size == b->size && a->mtime == b->mtime && !memcmp(a->crc, b->crc, sizeof a->crc);
+}
+
+FileFingerprint* FingerprintIndex::find(const FileFingerprint* f) const
+{
+    if (count)
+    {
+        uint32_t h = hash(f);
+
+        for (size_t i = slot(h); slots[i].item; i = next(i))
+        {
+            if (slots[i].hash == h && matches((FileFingerprint*)slots[i].item, f))
+            {
+                return (FileFingerprint*)slots[i].item;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void FingerprintIndex::findall(const FileFingerprint* f, vector<FileFingerprint*>* matching) const
+{
+    if (count)
+    {
+        uint32_t h = hash(f);
+
+        for (size_t i = slot(h); slots[i].item; i = next(i))
+        {
+            if (slots[i].hash == h && matches((FileFingerprint*)slots[i].item, f))
+            {
+                matching->push_back((FileFingerprint*)slots[i].item);
+            }
+        }
+    }
+}
+
+NameSearchIndex::NameSearchIndex()
+{
+    built = false;
+    garbage = 0;
+}
+
+void NameSearchIndex::fold(const char* name, string* folded)
+{
+    while (*name)
+    {
+        char c = *name++;
+
+        folded->push_back((c >= 'A' && c <= 'Z') ? c + 'a' - 'A' : c);
+    }
+}
+
+void NameSearchIndex::build(node_map* nodes)
+{
+    clear();
+
+    offsets.reserve(nodes->size());
+    slots.reserve(nodes->size());
+
+    built = true;
+
+    for (node_map::iterator it = nodes->begin(); it != nodes->end(); it++)
+    {
+        update(it->second);
+    }
+}
+
+void NameSearchIndex::clear()
+{
+    for (unsigned i = 0; i < slots.size(); i++)
+    {
+        if (slots[i])
+        {
+            slots[i]->searchslot = 0;
+        }
+    }
+
+    string().swap(pool);
+    vector<uint32_t>().swap(offsets);
+    vector<Node*>().swap(slots);
+
+    garbage = 0;
+    built = false;
+}
+
+// a renamed node gets a new slot at the end of the pool
+void NameSearchIndex::update(Node* n)
+{
+    if (!built)
+    {
+        return;
+    }
+
+    // (may decrypt deferred attributes, which updates the node reentrantly)
+    const char* name = n->displayname();
+
+    remove(n);
+
+    offsets.push_back(pool.size());
+    slots.push_back(n);
+    n->searchslot = slots.size();
+
+    fold(name, &pool);
+    pool.push_back(0);
+}
+
+void NameSearchIndex::remove(Node* n)
+{
+    if (n->searchslot)
+    {
+        size_t i = n->searchslot - 1;
+        size_t end = (i + 1 < offsets.size()) ? offsets[i + 1] : pool.size();
+
+        garbage += end - offsets[i];
+        slots[i] = NULL;
+        n->searchslot = 0;
+
+        compact();
+    }
+}
+
+void NameSearchIndex::compact()
+{
+    if (garbage < 65536 || garbage < pool.size() / 2)
+    {
+        return;
+    }
+
+    string cpool;
+    size_t j = 0;
+
+    cpool.reserve(pool.size() - garbage);
+
+    for (size_t i = 0; i < slots.size(); i++)
+    {
+        if (slots[i])
+        {
+            size_t start = offsets[i];
+            size_t end = (i + 1 < offsets.size()) ? offsets[i + 1] : pool.size();
+
+            offsets[j] = cpool.size();
+            cpool.append(pool, start, end - start);
+
+            slots[j] = slots[i];
+            slots[j]->searchslot = j + 1;
+            j++;
+        }
+    }
+
+    slots.resize(j);
+    offsets.resize(j);
+    pool.swap(cpool);
+    garbage = 0;
+}
+
+void NameSearchIndex::find(const char* search, node_vector* results) const
+{
+    string s;
+
+    fold(search, &s);
+
+    const char* base = pool.data();
+    const char* ptr = base;
+    const char* end = base + pool.size();
+
+    while (ptr < end)
+    {
+        const char* match;
+
+        if (!s.size())
+        {
+            match = ptr;
+        }
+        else if (!(match = (const char*)memchr(ptr, s[0], end - ptr)))
+        {
+            break;
+        }
+        else if ((size_t)(end - match) < s.size() || memcmp(match, s.data(), s.size()))
+        {
+            ptr = match + 1;
+            continue;
+        }
+
+        // matches cannot span names (the search string contains no NUL)
+        size_t i = upper_bound(offsets.begin(), offsets.end(), (uint32_t)(match - base)) - offsets.begin() - 1;
+
+        if (slots[i])
+        {
+            results->push_back(slots[i]);
+        }
+
+        // continue with the next name
+        ptr = (i + 1 < offsets.size()) ? base + offsets[i + 1] : end;
+    }
+}
+
+size_t NameSearchIndex::footprint() const
+{
+    return pool.capacity() + offsets.capacity() * sizeof(uint32_t) + slots.capacity() * sizeof(Node*);
+}
+} // namespace
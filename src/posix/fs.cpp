@@ -27,16 +27,31 @@
 #include <sys/utsname.h>
 #include <sys/ioctl.h>
 
+#ifdef USE_IOURING
+#include <sys/eventfd.h>
+#endif
+
+#ifdef USE_FSEVENTSTREAM
+#include <CoreServices/CoreServices.h>
+#endif
+
+#if defined(__linux__) && !defined(FICLONE)
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
 namespace mega {
 PosixFileAccess::PosixFileAccess()
 {
     fd = -1;
+    directio = false;
+    fsaccess = NULL;
 
 #ifndef HAVE_FDOPENDIR
     dp = NULL;
 #endif
 
     fsidvalid = false;
+    ctime = 0;
 }
 
 PosixFileAccess::~PosixFileAccess()
@@ -101,26 +116,150 @@ void PosixFileAccess::updatelocalname(string* name)
     }
 }
 
+#if defined(__ANDROID__) && !defined(__LP64__)
+// 32-bit bionic only has a 64-bit offset pread()/pwrite() under these names
+#define pread pread64
+#define pwrite pwrite64
+#endif
+
 bool PosixFileAccess::sysread(byte* dst, unsigned len, m_off_t pos)
 {
-#ifndef __ANDROID__
     return pread(fd, (char*)dst, len, pos) == len;
+}
+
+bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
+{
+    // O_DIRECT requires aligned transfers - write anything else buffered
+    bool buffered = directio && (((uintptr_t)data | len | pos) & (DIRECTIOALIGN - 1));
+
+    if (buffered)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+    }
+
+    bool r = pwrite(fd, data, len, pos) == len;
+
+    if (buffered)
+    {
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT);
+    }
+
+    return r;
+}
+
+// positional reads/writes leave no state in the descriptor - except for the
+// O_DIRECT toggling of unaligned writes
+bool PosixFileAccess::concurrentio()
+{
+    return !directio;
+}
+
+bool PosixFileAccess::fpreallocate(m_off_t len)
+{
+#if defined(__linux__) && !defined(__ANDROID__)
+    // allocate the extents up front, so that chunks completing out of order
+    // do not fragment the file
+    return !fallocate(fd, 0, 0, len);
+#elif defined(__APPLE__)
+    fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, len, 0 };
+
+    if (fcntl(fd, F_PREALLOCATE, &store) < 0)
+    {
+        store.fst_flags = F_ALLOCATEALL;
+
+        if (fcntl(fd, F_PREALLOCATE, &store) < 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
 #else
-    lseek(fd, pos, SEEK_SET);
-    return read(fd, (char*)dst, len) == len;
+    return false;
 #endif
 }
 
-bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
+bool PosixFileAccess::setdirectio()
 {
-#ifndef __ANDROID__
-    return pwrite(fd, data, len, pos) == len;
+#ifdef __APPLE__
+    // no alignment constraints
+    return fcntl(fd, F_NOCACHE, 1) >= 0;
 #else
-    lseek(fd, pos, SEEK_SET);
-    return write(fd, data, len) == len;
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_DIRECT) < 0)
+    {
+        return false;
+    }
+
+    directio = true;
+    return true;
 #endif
 }
 
+#ifdef USE_IOURING
+// asynchronous I/O requires an open descriptor (not in by-name mode)
+bool PosixFileAccess::asyncavailable()
+{
+    return fsaccess && fsaccess->ringfd >= 0 && fd >= 0 && !localname.size();
+}
+
+AsyncIOContext* PosixFileAccess::asyncfread(byte* dst, unsigned len, m_off_t pos)
+{
+    if (!asyncavailable())
+    {
+        return FileAccess::asyncfread(dst, len, pos);
+    }
+
+    AsyncIOContext* context = new AsyncIOContext;
+
+    context->op = AsyncIOContext::READ;
+    context->buffer = dst;
+    context->len = len;
+    context->pos = pos;
+
+    if (!fsaccess->asyncsubmit(fd, context))
+    {
+        // submission queue full
+        context->failed = !sysread(dst, len, pos);
+        context->finished = true;
+    }
+
+    return context;
+}
+
+AsyncIOContext* PosixFileAccess::asyncfwrite(const byte* data, unsigned len, m_off_t pos)
+{
+    // unaligned O_DIRECT writes need the synchronous fallback
+    if (!asyncavailable()
+     || (directio && (((uintptr_t)data | len | pos) & (DIRECTIOALIGN - 1))))
+    {
+        return FileAccess::asyncfwrite(data, len, pos);
+    }
+
+    AsyncIOContext* context = new AsyncIOContext;
+
+    context->op = AsyncIOContext::WRITE;
+    context->buffer = (byte*)data;
+    context->len = len;
+    context->pos = pos;
+
+    if (!fsaccess->asyncsubmit(fd, context))
+    {
+        context->failed = !fwrite(data, len, pos);
+        context->finished = true;
+    }
+
+    return context;
+}
+
+void PosixFileAccess::asyncwait(AsyncIOContext* context)
+{
+    if (fsaccess)
+    {
+        fsaccess->asyncwait(context);
+    }
+}
+#endif
+
 bool PosixFileAccess::fopen(string* f, bool read, bool write)
 {
     struct stat statbuf;
@@ -168,6 +307,7 @@ bool PosixFileAccess::fopen(string* f, bool read, bool write)
 
             size = statbuf.st_size;
             mtime = statbuf.st_mtime;
+            ctime = statbuf.st_ctime;
             type = S_ISDIR(statbuf.st_mode) ? FOLDERNODE : FILENODE;
             fsid = (handle)statbuf.st_ino;
             fsidvalid = true;
@@ -202,7 +342,61 @@ PosixFileSystemAccess::PosixFileSystemAccess(int fseventsfd)
     }
 #endif
 
-#ifdef __MACH__
+#ifdef USE_FANOTIFY
+    // requires CAP_SYS_ADMIN (filesystem marks)
+    if ((fanotifyfd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY)) >= 0)
+    {
+        LOG_debug << "Using fanotify for filesystem notifications";
+        notifyfailed = false;
+    }
+#endif
+
+    notifybuf.resize(NOTIFYBUFSIZE);
+
+#ifdef USE_FSEVENTSTREAM
+    // per-sync streams, started by PosixDirNotify::start()
+    fseventsqueue = dispatch_queue_create("nz.mega.fsevents", DISPATCH_QUEUE_SERIAL);
+    pthread_mutex_init(&fseventsmutex, NULL);
+
+    if (!pipe(fseventspipe))
+    {
+        fcntl(fseventspipe[0], F_SETFL, O_NONBLOCK);
+        fcntl(fseventspipe[1], F_SETFL, O_NONBLOCK);
+
+        notifyfailed = false;
+    }
+    else
+    {
+        fseventspipe[0] = fseventspipe[1] = -1;
+    }
+#endif
+
+#ifdef USE_IOURING
+    ringpending = 0;
+    ringfd = -1;
+
+    if (io_uring_queue_init(RINGENTRIES, &ring, 0) >= 0)
+    {
+        if ((ringfd = eventfd(0, EFD_NONBLOCK)) < 0 || io_uring_register_eventfd(&ring, ringfd) < 0)
+        {
+            LOG_warn << "io_uring completion notification not available";
+
+            if (ringfd >= 0)
+            {
+                close(ringfd);
+                ringfd = -1;
+            }
+
+            io_uring_queue_exit(&ring);
+        }
+    }
+    else
+    {
+        LOG_debug << "io_uring not available, using synchronous file I/O";
+    }
+#endif
+
+#if defined(__MACH__) && !defined(USE_FSEVENTSTREAM)
 #if __LP64__
     typedef struct fsevent_clone_args {
        int8_t *event_list;
@@ -278,11 +472,113 @@ PosixFileSystemAccess::~PosixFileSystemAccess()
     {
         close(notifyfd);
     }
+
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0)
+    {
+        close(fanotifyfd);
+    }
+#endif
+
+#ifdef USE_FSEVENTSTREAM
+    if (fseventspipe[0] >= 0)
+    {
+        close(fseventspipe[0]);
+        close(fseventspipe[1]);
+    }
+
+    dispatch_release((dispatch_queue_t)fseventsqueue);
+    pthread_mutex_destroy(&fseventsmutex);
+#endif
+
+#ifdef USE_IOURING
+    if (ringfd >= 0)
+    {
+        io_uring_queue_exit(&ring);
+        close(ringfd);
+    }
+#endif
 }
 
-// wake up from filesystem updates
+#ifdef USE_IOURING
+// queue an asynchronous read/write - false if the submission queue is full
+bool PosixFileSystemAccess::asyncsubmit(int fd, AsyncIOContext* context)
+{
+    struct io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+
+    if (!sqe)
+    {
+        return false;
+    }
+
+    if (context->op == AsyncIOContext::READ)
+    {
+        io_uring_prep_read(sqe, fd, context->buffer, context->len, context->pos);
+    }
+    else
+    {
+        io_uring_prep_write(sqe, fd, context->buffer, context->len, context->pos);
+    }
+
+    io_uring_sqe_set_data(sqe, context);
+    ringpending++;
+
+    // entries that could not be submitted go out with the next submission
+    if (io_uring_submit(&ring) < 0)
+    {
+        LOG_warn << "io_uring submission deferred";
+    }
+
+    return true;
+}
+
+void PosixFileSystemAccess::asynccomplete(struct io_uring_cqe* cqe)
+{
+    AsyncIOContext* context = (AsyncIOContext*)io_uring_cqe_get_data(cqe);
+
+    context->failed = cqe->res != (int)context->len;
+    context->finished = true;
+    ringpending--;
+
+    io_uring_cqe_seen(&ring, cqe);
+}
+
+// reap completions until the given context has finished
+void PosixFileSystemAccess::asyncwait(AsyncIOContext* context)
+{
+    struct io_uring_cqe* cqe;
+
+    while (!context->finished)
+    {
+        int e = io_uring_submit_and_wait(&ring, 1);
+
+        if (e < 0 && e != -EINTR)
+        {
+            LOG_err << "io_uring wait failed: " << e;
+            break;
+        }
+
+        while (!io_uring_peek_cqe(&ring, &cqe))
+        {
+            asynccomplete(cqe);
+        }
+    }
+}
+#endif
+
+// wake up from filesystem updates and asynchronous I/O completions
 void PosixFileSystemAccess::addevents(Waiter* w, int flags)
 {
+#ifdef USE_IOURING
+    if (ringfd >= 0 && ringpending)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        FD_SET(ringfd, &pw->rfds);
+        pw->bumpmaxfd(ringfd);
+    }
+#endif
+
     if (notifyfd >= 0)
     {
         PosixWaiter* pw = (PosixWaiter*)w;
@@ -292,26 +588,67 @@ void PosixFileSystemAccess::addevents(Waiter* w, int flags)
 
         pw->bumpmaxfd(notifyfd);
     }
+
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        FD_SET(fanotifyfd, &pw->rfds);
+        FD_SET(fanotifyfd, &pw->ignorefds);
+
+        pw->bumpmaxfd(fanotifyfd);
+    }
+#endif
+
+#ifdef USE_FSEVENTSTREAM
+    if (fseventspipe[0] >= 0)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        FD_SET(fseventspipe[0], &pw->rfds);
+        FD_SET(fseventspipe[0], &pw->ignorefds);
+
+        pw->bumpmaxfd(fseventspipe[0]);
+    }
+#endif
 }
 
-// read all pending inotify events and queue them for processing
+// read all pending inotify/fanotify events and queue them for processing
 int PosixFileSystemAccess::checkevents(Waiter* w)
 {
     int r = 0;
+
+#ifdef USE_IOURING
+    if (ringfd >= 0 && FD_ISSET(ringfd, &((PosixWaiter*)w)->rfds))
+    {
+        struct io_uring_cqe* cqe;
+        eventfd_t n;
+
+        eventfd_read(ringfd, &n);
+
+        while (!io_uring_peek_cqe(&ring, &cqe))
+        {
+            asynccomplete(cqe);
+        }
+
+        r |= Waiter::NEEDEXEC;
+    }
+#endif
 #ifdef ENABLE_SYNC
 #ifdef USE_INOTIFY
     PosixWaiter* pw = (PosixWaiter*)w;
     string *ignore;
 
-    if (FD_ISSET(notifyfd, &pw->rfds))
+    if (notifyfd >= 0 && FD_ISSET(notifyfd, &pw->rfds))
     {
-        char buf[sizeof(struct inotify_event) + NAME_MAX + 1];
+        char* buf = &notifybuf[0];
         int p, l;
         inotify_event* in;
         wdlocalnode_map::iterator it;
         string localpath;
 
-        while ((l = read(notifyfd, buf, sizeof buf)) > 0)
+        while ((l = read(notifyfd, buf, notifybuf.size())) > 0)
         {
             for (p = 0; p < l; p += offsetof(inotify_event, name) + in->len)
             {
@@ -410,7 +747,143 @@ int PosixFileSystemAccess::checkevents(Waiter* w)
     }
 #endif
 
-#ifdef __MACH__
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0 && FD_ISSET(fanotifyfd, &((PosixWaiter*)w)->rfds))
+    {
+        char* buf = &notifybuf[0];
+        ssize_t len;
+        fanotify_event_metadata* md;
+        fanotify_event_info_fid* fid;
+        file_handle* fh;
+        fhlocalnode_map::iterator it;
+        string key;
+        string* fignore;
+
+        // batches of events
+        while ((len = read(fanotifyfd, buf, notifybuf.size())) > 0)
+        {
+            for (md = (fanotify_event_metadata*)buf; FAN_EVENT_OK(md, len); md = FAN_EVENT_NEXT(md, len))
+            {
+                if (md->vers != FANOTIFY_METADATA_VERSION || (md->mask & FAN_Q_OVERFLOW))
+                {
+                    notifyerr = true;
+                    continue;
+                }
+
+                fid = (fanotify_event_info_fid*)(md + 1);
+
+                if ((char*)fid + sizeof *fid > (char*)md + md->event_len
+                 || fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+                {
+                    continue;
+                }
+
+                // the directory's handle is followed by the name
+                fh = (file_handle*)fid->handle;
+
+                key.assign((char*)&fid->fsid, sizeof fid->fsid);
+                key.append((char*)&fh->handle_type, sizeof fh->handle_type);
+                key.append((char*)fh->f_handle, fh->handle_bytes);
+
+                if ((it = fhnodes.find(key)) == fhnodes.end())
+                {
+                    // not in a synced folder
+                    continue;
+                }
+
+                const char* name = (const char*)fh->f_handle + fh->handle_bytes;
+                unsigned int namesize = strlen(name);
+
+                fignore = &it->second->sync->dirnotify->ignore;
+
+                if (namesize < fignore->size()
+                 || memcmp(name, fignore->data(), fignore->size())
+                 || (namesize > fignore->size()
+                  && memcmp(name + fignore->size(), localseparator.c_str(), localseparator.size())))
+                {
+                    // moves are reported as a separate deletion and creation
+                    it->second->sync->dirnotify->notify(DirNotify::DIREVENTS, it->second, name, namesize);
+
+                    r |= Waiter::NEEDEXEC;
+                }
+            }
+        }
+    }
+#endif
+
+#ifdef USE_FSEVENTSTREAM
+    if (fseventspipe[0] >= 0 && FD_ISSET(fseventspipe[0], &((PosixWaiter*)w)->rfds))
+    {
+        char drain[64];
+        vector<FSEventRecord> events;
+        sync_list::iterator it;
+
+        while (read(fseventspipe[0], drain, sizeof drain) > 0);
+
+        pthread_mutex_lock(&fseventsmutex);
+        events.swap(fseventsq);
+        pthread_mutex_unlock(&fseventsmutex);
+
+        for (unsigned i = 0; i < events.size(); i++)
+        {
+            FSEventRecord* e = &events[i];
+            PosixDirNotify* dn = e->dirnotify;
+
+            if (e->flags & kFSEventStreamEventFlagHistoryDone)
+            {
+                LOG_debug << "FSEvents history replayed";
+                dn->replaying = false;
+                r |= Waiter::NEEDEXEC;
+                continue;
+            }
+
+            if (e->id > dn->lastid)
+            {
+                dn->lastid = e->id;
+            }
+
+            // coalesced or dropped events: rescan
+            if (e->flags & (kFSEventStreamEventFlagMustScanSubDirs
+                          | kFSEventStreamEventFlagUserDropped
+                          | kFSEventStreamEventFlagKernelDropped
+                          | kFSEventStreamEventFlagRootChanged))
+            {
+                LOG_warn << "FSEvents requires a rescan: " << e->flags;
+                notifyerr = true;
+                r |= Waiter::NEEDEXEC;
+                continue;
+            }
+
+            size_t rsize = dn->streamroot.size();
+            size_t isize = dn->ignore.size();
+            const char* path = e->path.c_str();
+            size_t psize = e->path.size();
+
+            // below the sync root and not in the sync-local rubbish folder
+            if (psize <= rsize + 1
+             || memcmp(path, dn->streamroot.data(), rsize)
+             || path[rsize] != '/'
+             || (psize >= rsize + 1 + isize
+              && !memcmp(path + rsize + 1, dn->ignore.data(), isize)
+              && (psize == rsize + 1 + isize || path[rsize + 1 + isize] == '/')))
+            {
+                continue;
+            }
+
+            for (it = client->syncs.begin(); it != client->syncs.end(); it++)
+            {
+                if ((*it)->dirnotify == dn)
+                {
+                    dn->notify(DirNotify::DIREVENTS, &(*it)->localroot, path + rsize + 1, psize - rsize - 1);
+                    r |= Waiter::NEEDEXEC;
+                    break;
+                }
+            }
+        }
+    }
+#endif
+
+#if defined(__MACH__) && !defined(USE_FSEVENTSTREAM)
 #define FSE_MAX_ARGS 12
 #define FSE_MAX_EVENTS 11
 #define FSE_ARG_DONE 0xb33f
@@ -626,7 +1099,16 @@ bool PosixFileSystemAccess::copylocal(string* oldname, string* newname, m_time_t
         LOG_verbose << "Copying via sendfile";
         if ((tfd = open(newname->c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0600)) >= 0)
         {
-            while ((t = sendfile(tfd, sfd, NULL, 1024 * 1024 * 1024)) > 0);
+            // share the extents where the filesystem supports it (btrfs, XFS)
+            if (!ioctl(tfd, FICLONE, sfd))
+            {
+                LOG_verbose << "Cloned file extents";
+                t = 0;
+            }
+            else
+            {
+                while ((t = sendfile(tfd, sfd, NULL, 1024 * 1024 * 1024)) > 0);
+            }
 #else
     char buf[16384];
 
@@ -681,7 +1163,7 @@ bool PosixFileSystemAccess::unlinklocal(string* name)
 
 // delete all files, folders and symlinks contained in the specified folder
 // (does not recurse into mounted devices)
-void PosixFileSystemAccess::emptydirlocal(string* name, dev_t basedev)
+void PosixFileSystemAccess::emptydirlocal(string* name, dev_t basedev, LocalRemoval* progress)
 {
     DIR* dp;
     dirent* d;
@@ -703,6 +1185,12 @@ void PosixFileSystemAccess::emptydirlocal(string* name, dev_t basedev)
 
             while ((d = readdir(dp)))
             {
+                if (progress && progress->cancelled)
+                {
+                    closedir(dp);
+                    return;
+                }
+
                 if (d->d_type != DT_DIR
                  || *d->d_name != '.'
                  || (d->d_name[1] && (d->d_name[1] != '.' || d->d_name[2])))
@@ -713,15 +1201,24 @@ void PosixFileSystemAccess::emptydirlocal(string* name, dev_t basedev)
 
                     if (!lstat(name->c_str(), &statbuf))
                     {
+                        bool r;
+
                         if (!S_ISLNK(statbuf.st_mode) && S_ISDIR(statbuf.st_mode) && statbuf.st_dev == basedev)
                         {
-                            emptydirlocal(name, basedev);
-                            removed |= !rmdir(name->c_str());
+                            emptydirlocal(name, basedev, progress);
+                            r = !rmdir(name->c_str());
                         }
                         else
                         {
-                            removed |= !unlink(name->c_str());
+                            r = !unlink(name->c_str());
+                        }
+
+                        if (r && progress)
+                        {
+                            progress->removed++;
                         }
+
+                        removed |= r;
                     }
 
                     name->resize(t);
@@ -847,16 +1344,245 @@ PosixDirNotify::PosixDirNotify(string* localbasepath, string* ignore) : DirNotif
     failed = false;
 #endif
 
-#ifdef __MACH__
+#if defined(__MACH__) && !defined(USE_FSEVENTSTREAM)
     failed = false;
 #endif
 
+#ifdef USE_FSEVENTSTREAM
+    stream = NULL;
+    lastid = 0;
+#endif
+
     fsaccess = NULL;
 }
 
+#if defined(ENABLE_SYNC) && defined(USE_FSEVENTSTREAM)
+// coalescing latency of the streams in seconds
+static const double FSEVENTSLATENCY = 0.3;
+
+// runs on the dispatch queue
+static void fseventscallback(ConstFSEventStreamRef, void* info, size_t numevents, void* paths,
+                             const FSEventStreamEventFlags flags[], const FSEventStreamEventId ids[])
+{
+    PosixDirNotify* dn = (PosixDirNotify*)info;
+    PosixFileSystemAccess* fsaccess = dn->fsaccess;
+
+    pthread_mutex_lock(&fsaccess->fseventsmutex);
+
+    for (size_t i = 0; i < numevents; i++)
+    {
+        fsaccess->fseventsq.resize(fsaccess->fseventsq.size() + 1);
+        fsaccess->fseventsq.back().dirnotify = dn;
+        fsaccess->fseventsq.back().path = ((char**)paths)[i];
+        fsaccess->fseventsq.back().flags = flags[i];
+        fsaccess->fseventsq.back().id = ids[i];
+    }
+
+    pthread_mutex_unlock(&fsaccess->fseventsmutex);
+
+    write(fsaccess->fseventspipe[1], "", 1);
+}
+
+static void fseventsflush(void*)
+{
+}
+
+bool PosixDirNotify::start(const string* journal)
+{
+    char rpath[PATH_MAX];
+    struct stat statbuf;
+    FSEventStreamEventId since = kFSEventStreamEventIdSinceNow;
+    bool replay = false;
+
+    if (fsaccess->fseventspipe[0] < 0
+     || !realpath(localbasepath.c_str(), rpath)
+     || stat(rpath, &statbuf))
+    {
+        return false;
+    }
+
+    streamroot = rpath;
+
+    // event IDs are only meaningful for the same volume event database
+    CFUUIDRef uuid = FSEventsCopyUUIDForDevice(statbuf.st_dev);
+
+    if (uuid)
+    {
+        CFUUIDBytes b = CFUUIDGetUUIDBytes(uuid);
+        volumeuuid.assign((char*)&b, sizeof b);
+        CFRelease(uuid);
+    }
+
+    if (journal && volumeuuid.size() && journal->size() == sizeof(uint64_t) + volumeuuid.size()
+     && !memcmp(journal->data() + sizeof(uint64_t), volumeuuid.data(), volumeuuid.size()))
+    {
+        since = MemAccess::get<uint64_t>(journal->data());
+        replay = true;
+    }
+
+    lastid = replay ? since : FSEventsGetCurrentEventId();
+
+    CFStringRef cfpath = CFStringCreateWithFileSystemRepresentation(NULL, rpath);
+    CFArrayRef cfpaths = CFArrayCreate(NULL, (const void**)&cfpath, 1, &kCFTypeArrayCallBacks);
+    FSEventStreamContext context = { 0, this, NULL, NULL, NULL };
+
+    stream = FSEventStreamCreate(NULL, fseventscallback, &context, cfpaths, since, FSEVENTSLATENCY,
+                                 kFSEventStreamCreateFlagFileEvents | kFSEventStreamCreateFlagWatchRoot);
+
+    CFRelease(cfpaths);
+    CFRelease(cfpath);
+
+    if (!stream)
+    {
+        return false;
+    }
+
+    FSEventStreamSetDispatchQueue((FSEventStreamRef)stream, (dispatch_queue_t)fsaccess->fseventsqueue);
+
+    if (!FSEventStreamStart((FSEventStreamRef)stream))
+    {
+        FSEventStreamInvalidate((FSEventStreamRef)stream);
+        FSEventStreamRelease((FSEventStreamRef)stream);
+        stream = NULL;
+
+        return false;
+    }
+
+    failed = false;
+
+    if (replay)
+    {
+        LOG_debug << "Replaying FSEvents since " << since;
+    }
+
+    return replaying = replay;
+}
+
+void PosixDirNotify::stop()
+{
+    if (!stream)
+    {
+        return;
+    }
+
+    FSEventStreamStop((FSEventStreamRef)stream);
+    FSEventStreamInvalidate((FSEventStreamRef)stream);
+    FSEventStreamRelease((FSEventStreamRef)stream);
+    stream = NULL;
+
+    // wait for a callback in progress, then drop the queued events
+    dispatch_sync_f((dispatch_queue_t)fsaccess->fseventsqueue, NULL, fseventsflush);
+
+    pthread_mutex_lock(&fsaccess->fseventsmutex);
+
+    for (unsigned i = fsaccess->fseventsq.size(); i--; )
+    {
+        if (fsaccess->fseventsq[i].dirnotify == this)
+        {
+            fsaccess->fseventsq.erase(fsaccess->fseventsq.begin() + i);
+        }
+    }
+
+    pthread_mutex_unlock(&fsaccess->fseventsmutex);
+
+    failed = true;
+    replaying = false;
+}
+
+bool PosixDirNotify::journalpos(string* journal)
+{
+    if (!stream || !volumeuuid.size())
+    {
+        return false;
+    }
+
+    journal->assign((char*)&lastid, sizeof lastid);
+    journal->append(volumeuuid);
+
+    return true;
+}
+#endif
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+// watch the folder through its filesystem's fanotify mark
+bool PosixFileSystemAccess::fanotifyadd(LocalNode* l, string* path)
+{
+    struct statfs statfsbuf;
+    union
+    {
+        file_handle fh;
+        char buf[sizeof(file_handle) + MAX_HANDLE_SZ];
+    } h;
+    int mountid;
+    string fsid, key;
+
+    h.fh.handle_bytes = MAX_HANDLE_SZ;
+
+    if (statfs(path->c_str(), &statfsbuf)
+     || name_to_handle_at(AT_FDCWD, path->c_str(), &h.fh, &mountid, 0))
+    {
+        return false;
+    }
+
+    fsid.assign((char*)&statfsbuf.f_fsid, sizeof statfsbuf.f_fsid);
+
+    if (fanotifyfs.find(fsid) == fanotifyfs.end())
+    {
+        if (fanotify_mark(fanotifyfd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                          FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO
+                          | FAN_CLOSE_WRITE | FAN_ONDIR,
+                          AT_FDCWD, path->c_str()))
+        {
+            LOG_warn << "Unable to mark filesystem for fanotify: " << errno;
+            return false;
+        }
+
+        fanotifyfs.insert(fsid);
+    }
+
+    key = fsid;
+    key.append((char*)&h.fh.handle_type, sizeof h.fh.handle_type);
+    key.append((char*)h.fh.f_handle, h.fh.handle_bytes);
+
+    fanotifydel(l);
+
+    fhnodes[key] = l;
+    nodefhs[l] = key;
+
+    return true;
+}
+
+bool PosixFileSystemAccess::fanotifydel(LocalNode* l)
+{
+    map<LocalNode*, string>::iterator it = nodefhs.find(l);
+
+    if (it == nodefhs.end())
+    {
+        return false;
+    }
+
+    fhlocalnode_map::iterator fit = fhnodes.find(it->second);
+
+    if (fit != fhnodes.end() && fit->second == l)
+    {
+        fhnodes.erase(fit);
+    }
+
+    nodefhs.erase(it);
+
+    return true;
+}
+#endif
+
 void PosixDirNotify::addnotify(LocalNode* l, string* path)
 {
 #ifdef ENABLE_SYNC
+#ifdef USE_FANOTIFY
+    if (fsaccess->fanotifyfd >= 0 && fsaccess->fanotifyadd(l, path))
+    {
+        return;
+    }
+#endif
 #ifdef USE_INOTIFY
     int wd;
 
@@ -876,6 +1602,12 @@ void PosixDirNotify::addnotify(LocalNode* l, string* path)
 void PosixDirNotify::delnotify(LocalNode* l)
 {
 #ifdef ENABLE_SYNC
+#ifdef USE_FANOTIFY
+    if (fsaccess->fanotifydel(l))
+    {
+        return;
+    }
+#endif
 #ifdef USE_INOTIFY
     if (fsaccess->wdnodes.erase((int)(long)l->dirnotifytag))
     {
@@ -897,7 +1629,11 @@ fsfp_t PosixDirNotify::fsfingerprint()
 
 FileAccess* PosixFileSystemAccess::newfileaccess()
 {
-    return new PosixFileAccess();
+    PosixFileAccess* fa = new PosixFileAccess();
+
+    fa->fsaccess = this;
+
+    return fa;
 }
 
 DirAccess* PosixFileSystemAccess::newdiraccess()
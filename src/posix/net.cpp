@@ -23,6 +23,12 @@
 
 #define IPV6_RETRY_INTERVAL_DS 72000
 #define DNS_CACHE_TIMEOUT_DS 18000
+#define DNS_MIN_TTL_DS 600
+
+// DNS query class/types for prefetch lookups
+#define DNS_CLASS_IN 1
+#define DNS_TYPE_A 1
+#define DNS_TYPE_AAAA 28
 
 #ifdef WINDOWS_PHONE
 const char* inet_ntop(int af, const void* src, char* dst, int cnt)
@@ -87,6 +93,16 @@ CurlHttpIO::CurlHttpIO()
     curlipv6 = data->features & CURL_VERSION_IPV6;
     reset = false;
     statechange = false;
+    reportsactivity = true;
+
+    runninghandles = 0;
+    iothread = NULL;
+    iomutex = NULL;
+    iowaiter = NULL;
+    iostop = false;
+    enginewaiter = NULL;
+    iorunning = 0;
+    iolastdata = NEVER;
 
     WAIT_CLASS::bumpds();
     lastdnspurge = Waiter::ds + DNS_CACHE_TIMEOUT_DS / 2;
@@ -100,12 +116,7 @@ CurlHttpIO::CurlHttpIO()
     curlsh = curl_share_init();
     curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
     curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
-
-    contenttypejson = curl_slist_append(NULL, "Content-Type: application/json");
-    contenttypejson = curl_slist_append(contenttypejson, "Expect:");
-
-    contenttypebinary = curl_slist_append(NULL, "Content-Type: application/octet-stream");
-    contenttypebinary = curl_slist_append(contenttypebinary, "Expect:");
+    ownshare = true;
 
     proxyinflight = 0;
     ipv6requestsenabled = ipv6available();
@@ -113,6 +124,13 @@ CurlHttpIO::CurlHttpIO()
     ipv6deactivationtime = 0;
     waiter = NULL;
     proxyport = 0;
+    multiplex = false;
+
+#ifdef HAVE_CURL_SSLS
+    tlssessionschanged = false;
+#endif
+
+    setupmulti();
 }
 
 bool CurlHttpIO::ipv6available()
@@ -145,20 +163,82 @@ bool CurlHttpIO::ipv6available()
 
 CurlHttpIO::~CurlHttpIO()
 {
+    stopiothread();
+    clearcurlpool();
+
+    for (std::map<string, curl_slist*>::iterator it = headerlists.begin(); it != headerlists.end(); it++)
+    {
+        curl_slist_free_all(it->second);
+    }
+
     curl_multi_cleanup(curlm);
     ares_destroy(ares);
 
+    if (ownshare)
+    {
+        curl_share_cleanup(curlsh);
+    }
+
     curl_global_cleanup();
     ares_library_cleanup();
 }
 
+CURLSH* CurlHttpIO::newshare(Mutex** locks)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+
+    CURLSH* share = curl_share_init();
+
+    curl_share_setopt(share, CURLSHOPT_LOCKFUNC, share_lock);
+    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, share_unlock);
+    curl_share_setopt(share, CURLSHOPT_USERDATA, (void*)locks);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+    return share;
+}
+
+void CurlHttpIO::deleteshare(CURLSH* share)
+{
+    curl_share_cleanup(share);
+    curl_global_cleanup();
+}
+
+void CurlHttpIO::share_lock(CURL*, curl_lock_data data, curl_lock_access, void* userptr)
+{
+    ((Mutex**)userptr)[data]->lock();
+}
+
+void CurlHttpIO::share_unlock(CURL*, curl_lock_data data, void* userptr)
+{
+    ((Mutex**)userptr)[data]->unlock();
+}
+
+void CurlHttpIO::setshare(CURLSH* share)
+{
+    // pooled handles refer to the previous one
+    clearcurlpool();
+
+    if (ownshare)
+    {
+        curl_share_cleanup(curlsh);
+        ownshare = false;
+    }
+
+    curlsh = share;
+}
+
 void CurlHttpIO::setuseragent(string* u)
 {
     useragent = *u;
+
+    // pooled handles carry the previous one
+    clearcurlpool();
 }
 
 void CurlHttpIO::setdnsservers(const char* servers)
 {
+    IOLock iolock(iomutex, iowaiter);
     if (servers)
     {
         lastdnspurge = Waiter::ds + DNS_CACHE_TIMEOUT_DS / 2;
@@ -171,15 +251,18 @@ void CurlHttpIO::setdnsservers(const char* servers)
 
 void CurlHttpIO::disconnect()
 {
+    IOLock iolock(iomutex, iowaiter);
     LOG_debug << "Reinitializing the network layer";
 
     ares_destroy(ares);
     curl_multi_cleanup(curlm);
+    clearcurlpool();
 
     lastdnspurge = Waiter::ds + DNS_CACHE_TIMEOUT_DS / 2;
     dnscache.clear();
 
     curlm = curl_multi_init();
+    setupmulti();
     ares_init(&ares);
 
     if (dnsservers.size())
@@ -189,24 +272,366 @@ void CurlHttpIO::disconnect()
     }
 }
 
+// HTTP/2 multiplexing: concurrent requests to the same host (the API server
+// or a storage server) become streams of a single connection
+bool CurlHttpIO::setmultiplexing(bool enable)
+{
+    IOLock iolock(iomutex, iowaiter);
+#ifdef CURLPIPE_MULTIPLEX
+    if (enable && !(curl_version_info(CURLVERSION_NOW)->features & CURL_VERSION_HTTP2))
+    {
+        LOG_warn << "cURL built without HTTP/2 support";
+        return false;
+    }
+
+    LOG_debug << "HTTP/2 multiplexing " << (enable ? "enabled" : "disabled");
+
+    multiplex = enable;
+    setupmulti();
+
+    return true;
+#else
+    return !enable;
+#endif
+}
+
+void CurlHttpIO::setupmulti()
+{
+    // keep idle connections to the API and storage servers open for reuse
+    curl_multi_setopt(curlm, CURLMOPT_MAXCONNECTS, (long)CONNECTIONCACHESIZE);
+
+#ifdef CURLPIPE_MULTIPLEX
+    curl_multi_setopt(curlm, CURLMOPT_PIPELINING, multiplex ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+#endif
+
+#ifdef USE_EVENTPOLL
+    // (a new multi handle starts without sockets)
+    curlsockets.clear();
+    curltimeoutms = -1;
+
+    curl_multi_setopt(curlm, CURLMOPT_SOCKETFUNCTION, socket_callback);
+    curl_multi_setopt(curlm, CURLMOPT_SOCKETDATA, (void*)this);
+    curl_multi_setopt(curlm, CURLMOPT_TIMERFUNCTION, timer_callback);
+    curl_multi_setopt(curlm, CURLMOPT_TIMERDATA, (void*)this);
+#endif
+}
+
+#ifdef USE_EVENTPOLL
+// curl reports the events it wants for one of its sockets
+int CurlHttpIO::socket_callback(CURL*, curl_socket_t s, int what, void* userp, void*)
+{
+    CurlHttpIO* httpio = (CurlHttpIO*)userp;
+    int events = 0;
+
+    if (what == CURL_POLL_REMOVE)
+    {
+        httpio->curlsockets.erase(s);
+    }
+    else
+    {
+        events = ((what & CURL_POLL_IN) ? PosixWaiter::WATCH_READ : 0)
+               | ((what & CURL_POLL_OUT) ? PosixWaiter::WATCH_WRITE : 0);
+
+        httpio->curlsockets[s] = events;
+    }
+
+    if (httpio->waiter)
+    {
+        httpio->waiter->watch(s, events);
+    }
+
+    return 0;
+}
+
+// curl's next timeout (-1: none)
+int CurlHttpIO::timer_callback(CURLM*, long ms, void* userp)
+{
+    CurlHttpIO* httpio = (CurlHttpIO*)userp;
+
+    httpio->curltimeoutms = ms < 0 ? -1 : Waiter::dsms + ms;
+
+    return 0;
+}
+#endif
+
+// easy handle with the request-independent options already set - handles
+// are recycled rather than created and destroyed for each request
+CURL* CurlHttpIO::getcurl()
+{
+    CURL* curl;
+
+    if (curlpool.size())
+    {
+        curl = curlpool.back();
+        curlpool.pop_back();
+        return curl;
+    }
+
+    if ((curl = curl_easy_init()))
+    {
+        setupcurl(curl);
+    }
+
+    return curl;
+}
+
+// return a handle removed from the multi handle to the pool
+void CurlHttpIO::releasecurl(CURL* curl)
+{
+    if (curlpool.size() >= MAXCURLPOOL)
+    {
+        curl_easy_cleanup(curl);
+        return;
+    }
+
+    // drop the previous request's options (the DNS and TLS session caches
+    // are kept)
+    curl_easy_reset(curl);
+    setupcurl(curl);
+
+    curlpool.push_back(curl);
+}
+
+void CurlHttpIO::clearcurlpool()
+{
+    for (unsigned i = 0; i < curlpool.size(); i++)
+    {
+        curl_easy_cleanup(curlpool[i]);
+    }
+
+    curlpool.clear();
+}
+
+void CurlHttpIO::setupcurl(CURL* curl)
+{
+    curl_easy_setopt(curl, CURLOPT_POST, 1);
+    curl_easy_setopt(curl, CURLOPT_USERAGENT, useragent.c_str());
+    curl_easy_setopt(curl, CURLOPT_ENCODING, "");
+    curl_easy_setopt(curl, CURLOPT_SHARE, curlsh);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
+    curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, check_header);
+    curl_easy_setopt(curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+
+#if !defined(USE_CURL_PUBLIC_KEY_PINNING) || defined(WINDOWS_PHONE)
+    curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, ssl_ctx_function);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1);
+#else
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
+#endif
+
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0);
+    curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
+    curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
+
+    curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_callback);
+    curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+
+    // keep idle connections alive through NAT gateways
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, (long)KEEPALIVEIDLE);
+    curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, (long)KEEPALIVEIDLE);
+}
+
+// header list shared by all requests with the same content type, transfer
+// encoding and Host header (built on first use, kept until destruction)
+curl_slist* CurlHttpIO::getheaders(HttpReq* req, const string* hostheader)
+{
+    string key(req->type == REQ_JSON ? "j" : "b");
+
+    key.append(req->chunked ? "c" : "-");
+    key.append(req->deflated ? "z" : "-");
+
+    if (hostheader)
+    {
+        key.append(*hostheader);
+    }
+
+    curl_slist*& headers = headerlists[key];
+
+    if (!headers)
+    {
+        headers = curl_slist_append(NULL, req->type == REQ_JSON
+                                          ? "Content-Type: application/json"
+                                          : "Content-Type: application/octet-stream");
+        headers = curl_slist_append(headers, "Expect:");
+
+        if (hostheader)
+        {
+            headers = curl_slist_append(headers, hostheader->c_str());
+        }
+
+        if (req->chunked)
+        {
+            headers = curl_slist_append(headers, "Transfer-Encoding: chunked");
+        }
+
+        if (req->deflated)
+        {
+            headers = curl_slist_append(headers, "Content-Encoding: gzip");
+        }
+    }
+
+    return headers;
+}
+
+// TLS sessions from the shared session cache, as a sequence of
+// length-prefixed (session key, salted hash, session data) triples
+bool CurlHttpIO::exporttlssessions(string* data)
+{
+    IOLock iolock(iomutex, iowaiter);
+#ifdef HAVE_CURL_SSLS
+    CURL* curl;
+
+    if (!tlssessionschanged || !(curl = getcurl()))
+    {
+        return false;
+    }
+
+    data->clear();
+
+    bool result = curl_easy_ssls_export(curl, ssls_export_callback, (void*)data) == CURLE_OK;
+
+    releasecurl(curl);
+
+    if (result)
+    {
+        tlssessionschanged = false;
+    }
+
+    return result;
+#else
+    return false;
+#endif
+}
+
+#ifdef HAVE_CURL_SSLS
+static void appendtlsfield(string* data, const void* field, size_t len)
+{
+    uint32_t l = (uint32_t)len;
+
+    data->append((char*)&l, sizeof l);
+    data->append((const char*)field, len);
+}
+
+static bool readtlsfield(const char** ptr, const char* end, string* field)
+{
+    uint32_t l;
+
+    if (*ptr + sizeof l > end)
+    {
+        return false;
+    }
+
+    memcpy(&l, *ptr, sizeof l);
+    *ptr += sizeof l;
+
+    if (l > (size_t)(end - *ptr))
+    {
+        return false;
+    }
+
+    field->assign(*ptr, l);
+    *ptr += l;
+
+    return true;
+}
+
+CURLcode CurlHttpIO::ssls_export_callback(CURL*, void* userptr, const char* sessionkey,
+                                          const unsigned char* shmac, size_t shmaclen,
+                                          const unsigned char* sdata, size_t sdatalen,
+                                          curl_off_t, int, const char*, size_t)
+{
+    string* data = (string*)userptr;
+
+    appendtlsfield(data, sessionkey ? sessionkey : "", sessionkey ? strlen(sessionkey) : 0);
+    appendtlsfield(data, shmac, shmaclen);
+    appendtlsfield(data, sdata, sdatalen);
+
+    return CURLE_OK;
+}
+#endif
+
+void CurlHttpIO::importtlssessions(string* data)
+{
+    IOLock iolock(iomutex, iowaiter);
+#ifdef HAVE_CURL_SSLS
+    CURL* curl;
+
+    if (!(curl = getcurl()))
+    {
+        return;
+    }
+
+    const char* ptr = data->data();
+    const char* end = ptr + data->size();
+    string sessionkey, shmac, sdata;
+    int imported = 0;
+
+    while (readtlsfield(&ptr, end, &sessionkey)
+        && readtlsfield(&ptr, end, &shmac)
+        && readtlsfield(&ptr, end, &sdata))
+    {
+        if (curl_easy_ssls_import(curl, sessionkey.size() ? sessionkey.c_str() : NULL,
+                                  (const unsigned char*)shmac.data(), shmac.size(),
+                                  (const unsigned char*)sdata.data(), sdata.size()) == CURLE_OK)
+        {
+            imported++;
+        }
+    }
+
+    releasecurl(curl);
+
+    LOG_debug << "Restored TLS sessions: " << imported;
+#endif
+}
+
 // wake up from cURL I/O
 void CurlHttpIO::addevents(Waiter* w, int)
 {
     int t;
 
-    waiter = (WAIT_CLASS*)w;
-    curl_multi_fdset(curlm, &waiter->rfds, &waiter->wfds, &waiter->efds, &t);
-    waiter->bumpmaxfd(t);
+    if (iothread && (WAIT_CLASS*)w != iowaiter)
+    {
+        // the engine is woken up by the I/O thread instead (see ioloop())
+        enginewaiter = (WAIT_CLASS*)w;
+        return;
+    }
 
-    long curltimeout;
-    
-    curl_multi_timeout(curlm, &curltimeout);
+#ifdef USE_EVENTPOLL
+    if ((WAIT_CLASS*)w != waiter && ((WAIT_CLASS*)w)->canwatch())
+    {
+        // register the sockets curl reported before the waiter was known
+        for (std::map<curl_socket_t, int>::iterator it = curlsockets.begin(); it != curlsockets.end(); it++)
+        {
+            ((WAIT_CLASS*)w)->watch(it->first, it->second);
+        }
+    }
+#endif
+
+    waiter = (WAIT_CLASS*)w;
 
-    if (curltimeout >= 0)
+#ifdef USE_EVENTPOLL
+    if (waiter->canwatch())
+    {
+        if (curltimeoutms >= 0)
+        {
+            waiter->wakeupms(curltimeoutms - Waiter::dsms);
+        }
+    }
+    else
+#endif
     {
-        curltimeout /= 100;
-        if ((unsigned long)curltimeout < waiter->maxds)
-        waiter->maxds = curltimeout;
+        curl_multi_fdset(curlm, &waiter->rfds, &waiter->wfds, &waiter->efds, &t);
+        waiter->bumpmaxfd(t);
+
+        long curltimeout;
+
+        curl_multi_timeout(curlm, &curltimeout);
+
+        if (curltimeout >= 0)
+        {
+            waiter->wakeupms(curltimeout);
+        }
     }
 
     t = ares_fds(ares, &waiter->rfds, &waiter->wfds);
@@ -216,12 +641,7 @@ void CurlHttpIO::addevents(Waiter* w, int)
 
     if (ares_timeout(ares, NULL, &tv))
     {
-        dstime arestimeout = tv.tv_sec * 10 + tv.tv_usec / 100000;
-
-        if (arestimeout < waiter->maxds)
-        {
-            waiter->maxds = arestimeout;
-        }
+        waiter->wakeupms((int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000);
     }
 }
 
@@ -353,11 +773,13 @@ void CurlHttpIO::ares_completed_callback(void* arg, int status, int, struct host
         {
             dnsEntry.ipv6 = ip;
             dnsEntry.ipv6timestamp = Waiter::ds;
+            dnsEntry.ipv6ttl = DNS_CACHE_TIMEOUT_DS;
         }
         else
         {
             dnsEntry.ipv4 = ip;
             dnsEntry.ipv4timestamp = Waiter::ds;
+            dnsEntry.ipv4ttl = DNS_CACHE_TIMEOUT_DS;
         }
 
         // IPv6 takes precedence over IPv4
@@ -479,28 +901,6 @@ void CurlHttpIO::ares_completed_callback(void* arg, int status, int, struct host
     }
 }
 
-struct curl_slist* CurlHttpIO::clone_curl_slist(struct curl_slist* inlist)
-{
-    struct curl_slist* outlist = NULL;
-    struct curl_slist* tmp;
-
-    while (inlist)
-    {
-        tmp = curl_slist_append(outlist, inlist->data);
-
-        if (!tmp)
-        {
-            curl_slist_free_all(outlist);
-            return NULL;
-        }
-
-        outlist = tmp;
-        inlist = inlist->next;
-    }
-
-    return outlist;
-}
-
 void CurlHttpIO::send_request(CurlHttpContext* httpctx)
 {
     CurlHttpIO* httpio = httpctx->httpio;
@@ -508,6 +908,9 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
     int len = httpctx->len;
     const char* data = httpctx->data;
 
+    // name resolution (or the wait for the proxy IP) is over
+    req->timeline.resolved = Waiter::us();
+
     LOG_debug << "POST target URL: " << req->posturl;
 
     if (req->binary)
@@ -519,26 +922,25 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         LOG_debug << "Sending: " << *req->out;
     }
 
-    httpctx->headers = clone_curl_slist(req->type == REQ_JSON ? httpio->contenttypejson : httpio->contenttypebinary);
     httpctx->posturl = req->posturl;
 
 
     if(httpio->proxyip.size())
     {
         LOG_debug << "Using the hostname instead of the IP";
+        httpctx->headers = httpio->getheaders(req, NULL);
     }
     else if(httpctx->hostip.size())
     {
         LOG_debug << "Using the IP of the hostname";
         httpctx->posturl.replace(httpctx->posturl.find(httpctx->hostname), httpctx->hostname.size(), httpctx->hostip);
-        httpctx->headers = curl_slist_append(httpctx->headers, httpctx->hostheader.c_str());
+        httpctx->headers = httpio->getheaders(req, &httpctx->hostheader);
     }
     else
     {
         LOG_err << "No IP nor proxy available";
         req->status = REQ_FAILURE;
         req->httpiohandle = NULL;
-        curl_slist_free_all(httpctx->headers);
 
         httpctx->req = NULL;
         if(!httpctx->ares_pending)
@@ -552,16 +954,14 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
 
     CURL* curl;
 
-    if ((curl = curl_easy_init()))
+    if ((curl = httpio->getcurl()))
     {
-        curl_easy_setopt(curl, CURLOPT_POST, 1);
         curl_easy_setopt(curl, CURLOPT_URL, httpctx->posturl.c_str());
         
         if (req->chunked)
         {
             curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_data);
             curl_easy_setopt(curl, CURLOPT_READDATA, (void*)req);                     
-            curl_slist_append(httpctx->headers, "Transfer-Encoding: chunked");
         }
         else
         {
@@ -569,23 +969,37 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
             curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data ? len : req->out->size());
         }
 
-        curl_easy_setopt(curl, CURLOPT_USERAGENT, httpio->useragent.c_str());
+        if (req->maxspeed)
+        {
+            curl_easy_setopt(curl, CURLOPT_MAX_SEND_SPEED_LARGE, (curl_off_t)req->maxspeed);
+            curl_easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE, (curl_off_t)req->maxspeed);
+        }
+
+        // (the options of pooled handles are reset on release)
+        if (req->netif.size())
+        {
+            curl_easy_setopt(curl, CURLOPT_INTERFACE, req->netif.c_str());
+        }
+
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, httpctx->headers);
-        curl_easy_setopt(curl, CURLOPT_ENCODING, "");
-        curl_easy_setopt(curl, CURLOPT_SHARE, httpio->curlsh);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)req);
-        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, check_header);
         curl_easy_setopt(curl, CURLOPT_HEADERDATA, (void*)req);
         curl_easy_setopt(curl, CURLOPT_PRIVATE, (void*)req);
-        curl_easy_setopt(curl, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+        curl_easy_setopt(curl, CURLOPT_DEBUGDATA, (void*)req);
+
+#ifdef CURLPIPE_MULTIPLEX
+        if (httpio->multiplex)
+        {
+            // negotiate HTTP/2 (HTTPS only) and wait for a connection to the
+            // same host that is still being set up rather than opening another
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
+#endif
 
 #if !defined(USE_CURL_PUBLIC_KEY_PINNING) || defined(WINDOWS_PHONE)
-        curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, ssl_ctx_function);
         curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, (void*)req);
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1);
 #else
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
         if(!MegaClient::disablepkp)
         {
             if(!req->posturl.compare(0, MegaClient::APIURL.size(), MegaClient::APIURL))
@@ -603,14 +1017,6 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         }
 #endif
 
-        curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0);
-        curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
-        curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
-
-        curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_callback);
-        curl_easy_setopt(curl, CURLOPT_DEBUGDATA, (void*)req);
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
-
         if (httpio->proxyip.size())
         {
             if(!httpio->proxyscheme.size() || !httpio->proxyscheme.compare(0, 4, "http"))
@@ -645,7 +1051,6 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
     {
         req->status = REQ_FAILURE;
         req->httpiohandle = NULL;
-        curl_slist_free_all(httpctx->headers);
 
         httpctx->req = NULL;
         if(!httpctx->ares_pending)
@@ -832,6 +1237,7 @@ int CurlHttpIO::debug_callback(CURL*, curl_infotype type, char* data, size_t siz
 // POST request to URL
 void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
 {
+    IOLock iolock(iomutex, iowaiter);
     CurlHttpContext* httpctx = new CurlHttpContext;
     httpctx->curl = NULL;
     httpctx->httpio = this;
@@ -926,13 +1332,13 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
         {
             CurlDNSEntry& entry = it->second;
 
-            if (entry.ipv6.size() && Waiter::ds - entry.ipv6timestamp >= DNS_CACHE_TIMEOUT_DS)
+            if (entry.ipv6.size() && !entry.ipv6valid())
             {
                 entry.ipv6timestamp = 0;
                 entry.ipv6.clear();
             }
 
-            if (entry.ipv4.size() && Waiter::ds - entry.ipv4timestamp >= DNS_CACHE_TIMEOUT_DS)
+            if (entry.ipv4.size() && !entry.ipv4valid())
             {
                 entry.ipv4timestamp = 0;
                 entry.ipv4.clear();
@@ -964,13 +1370,19 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
 
     httpctx->hostheader = "Host: ";
     httpctx->hostheader.append(httpctx->hostname);
-    httpctx->ares_pending = 1;
 
-    CurlDNSEntry& dnsEntry = dnscache[httpctx->hostname];
+    resolve(httpctx);
+}
+
+void CurlHttpIO::resolve(CurlHttpContext* httpctx)
+{
+    httpctx->ares_pending = 1;
+
+    CurlDNSEntry& dnsEntry = dnscache[httpctx->hostname];
 
     if (ipv6requestsenabled)
     {
-        if (dnsEntry.ipv6.size() && Waiter::ds - dnsEntry.ipv6timestamp < DNS_CACHE_TIMEOUT_DS)
+        if (dnsEntry.ipv6valid())
         {
             std::ostringstream oss;
             httpctx->isIPv6 = true;
@@ -980,14 +1392,10 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
             send_request(httpctx);
             return;
         }
-
-        httpctx->ares_pending++;
-        LOG_debug << "Resolving IPv6 address for " << httpctx->hostname;
-        ares_gethostbyname(ares, httpctx->hostname.c_str(), PF_INET6, ares_completed_callback, httpctx);
     }
     else
     {
-        if (dnsEntry.ipv4.size() && Waiter::ds - dnsEntry.ipv4timestamp < DNS_CACHE_TIMEOUT_DS)
+        if (dnsEntry.ipv4valid())
         {
             httpctx->isIPv6 = false;
             httpctx->hostip = dnsEntry.ipv4;
@@ -997,12 +1405,185 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
         }
     }
 
+    // a lookup of this host is already under way - wait for it
+    std::map<string, CurlDNSPrefetch*>::iterator it = dnsprefetches.find(httpctx->hostname);
+
+    if (it != dnsprefetches.end())
+    {
+        LOG_debug << "Waiting for the DNS prefetch of " << httpctx->hostname;
+        it->second->waiting.push_back(httpctx);
+        return;
+    }
+
+    if (ipv6requestsenabled)
+    {
+        httpctx->ares_pending++;
+        LOG_debug << "Resolving IPv6 address for " << httpctx->hostname;
+        ares_gethostbyname(ares, httpctx->hostname.c_str(), PF_INET6, ares_completed_callback, httpctx);
+    }
+
     LOG_debug << "Resolving IPv4 address for " << httpctx->hostname;
     ares_gethostbyname(ares, httpctx->hostname.c_str(), PF_INET, ares_completed_callback, httpctx);
 }
 
+// resolve the host of a freshly received storage URL so that the lookup
+// overlaps with the setup of the transfer - the addresses are cached with
+// the TTL of the DNS records
+void CurlHttpIO::prefetchdns(const string* url)
+{
+    IOLock iolock(iomutex, iowaiter);
+    string scheme, hostname;
+    int port;
+
+    if (proxyurl.size() || !crackurl((string*)url, &scheme, &hostname, &port))
+    {
+        return;
+    }
+
+    std::map<string, CurlDNSEntry>::iterator cit = dnscache.find(hostname);
+
+    if (cit != dnscache.end() && (ipv6requestsenabled ? cit->second.ipv6valid() : cit->second.ipv4valid()))
+    {
+        return;
+    }
+
+    if (dnsprefetches.find(hostname) != dnsprefetches.end())
+    {
+        return;
+    }
+
+    LOG_debug << "Prefetching DNS for " << hostname;
+
+    CurlDNSPrefetch* prefetch = new CurlDNSPrefetch;
+    prefetch->httpio = this;
+    prefetch->hostname = hostname;
+    prefetch->pending = ipv6requestsenabled ? 2 : 1;
+
+    dnsprefetches[hostname] = prefetch;
+
+    if (ipv6requestsenabled)
+    {
+        ares_search(ares, hostname.c_str(), DNS_CLASS_IN, DNS_TYPE_AAAA, dnsprefetch_aaaa_callback, prefetch);
+    }
+
+    ares_search(ares, hostname.c_str(), DNS_CLASS_IN, DNS_TYPE_A, dnsprefetch_a_callback, prefetch);
+}
+
+void CurlHttpIO::dnsprefetch_a_callback(void* arg, int status, int, unsigned char* abuf, int alen)
+{
+    dnsprefetch_result((CurlDNSPrefetch*)arg, status, abuf, alen, false);
+}
+
+void CurlHttpIO::dnsprefetch_aaaa_callback(void* arg, int status, int, unsigned char* abuf, int alen)
+{
+    dnsprefetch_result((CurlDNSPrefetch*)arg, status, abuf, alen, true);
+}
+
+void CurlHttpIO::dnsprefetch_result(CurlDNSPrefetch* prefetch, int status, unsigned char* abuf, int alen, bool ipv6)
+{
+    CurlHttpIO* httpio = prefetch->httpio;
+    char ip[INET6_ADDRSTRLEN];
+    int ttl = -1;
+
+    if (status == ARES_SUCCESS)
+    {
+        if (ipv6)
+        {
+            struct ares_addr6ttl addrttls[8];
+            int naddrttls = sizeof addrttls / sizeof *addrttls;
+
+            if (ares_parse_aaaa_reply(abuf, alen, NULL, addrttls, &naddrttls) == ARES_SUCCESS && naddrttls > 0
+             && inet_ntop(PF_INET6, &addrttls[0].ip6addr, ip, sizeof ip))
+            {
+                ttl = addrttls[0].ttl;
+            }
+        }
+        else
+        {
+            struct ares_addrttl addrttls[8];
+            int naddrttls = sizeof addrttls / sizeof *addrttls;
+
+            if (ares_parse_a_reply(abuf, alen, NULL, addrttls, &naddrttls) == ARES_SUCCESS && naddrttls > 0
+             && inet_ntop(PF_INET, &addrttls[0].ipaddr, ip, sizeof ip))
+            {
+                ttl = addrttls[0].ttl;
+            }
+        }
+    }
+
+    if (ttl >= 0)
+    {
+        // honour the record's TTL within sane bounds
+        dstime ttlds = (dstime)ttl * 10;
+
+        if (ttlds < DNS_MIN_TTL_DS)
+        {
+            ttlds = DNS_MIN_TTL_DS;
+        }
+        else if (ttlds > DNS_CACHE_TIMEOUT_DS)
+        {
+            ttlds = DNS_CACHE_TIMEOUT_DS;
+        }
+
+        LOG_verbose << "Prefetched " << (ipv6 ? "IPv6" : "IPv4") << " address for " << prefetch->hostname
+                    << ": " << ip << " (TTL " << ttl << " s)";
+
+        CurlDNSEntry& dnsEntry = httpio->dnscache[prefetch->hostname];
+
+        if (ipv6)
+        {
+            dnsEntry.ipv6 = ip;
+            dnsEntry.ipv6timestamp = Waiter::ds;
+            dnsEntry.ipv6ttl = ttlds;
+        }
+        else
+        {
+            dnsEntry.ipv4 = ip;
+            dnsEntry.ipv4timestamp = Waiter::ds;
+            dnsEntry.ipv4ttl = ttlds;
+        }
+    }
+    else
+    {
+        LOG_verbose << "DNS prefetch failed for " << prefetch->hostname << ". code: " << status;
+    }
+
+    if (--prefetch->pending)
+    {
+        return;
+    }
+
+    httpio->dnsprefetches.erase(prefetch->hostname);
+
+    // the requests that waited for the lookup continue from the cache or
+    // fall back to a regular lookup (not while the channel is torn down)
+    for (unsigned i = 0; i < prefetch->waiting.size(); i++)
+    {
+        CurlHttpContext* httpctx = prefetch->waiting[i];
+
+        if (!httpctx->req)
+        {
+            delete httpctx;
+        }
+        else if (status == ARES_EDESTRUCTION)
+        {
+            httpctx->req->status = REQ_FAILURE;
+            httpctx->req->httpiohandle = NULL;
+            httpio->statechange = true;
+            delete httpctx;
+        }
+        else
+        {
+            httpio->resolve(httpctx);
+        }
+    }
+
+    delete prefetch;
+}
+
 void CurlHttpIO::setproxy(Proxy* proxy)
 {
+    IOLock iolock(iomutex, iowaiter);
     // clear the previous proxy IP
     proxyip.clear();
 
@@ -1054,6 +1635,7 @@ Proxy* CurlHttpIO::getautoproxy()
 // cancel pending HTTP request
 void CurlHttpIO::cancel(HttpReq* req)
 {
+    IOLock iolock(iomutex, iowaiter);
     if (req->httpiohandle)
     {
         CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
@@ -1061,8 +1643,7 @@ void CurlHttpIO::cancel(HttpReq* req)
         if (httpctx->curl)
         {
             curl_multi_remove_handle(curlm, httpctx->curl);
-            curl_easy_cleanup(httpctx->curl);
-            curl_slist_free_all(httpctx->headers);
+            releasecurl(httpctx->curl);
         }
 
         httpctx->req = NULL;
@@ -1087,6 +1668,7 @@ void CurlHttpIO::cancel(HttpReq* req)
 // real-time progress information on POST data
 m_off_t CurlHttpIO::postpos(void* handle)
 {
+    IOLock iolock(iomutex, iowaiter);
     double bytes = 0;
 
     CurlHttpContext* httpctx = (CurlHttpContext*)handle;
@@ -1102,15 +1684,72 @@ m_off_t CurlHttpIO::postpos(void* handle)
 // process events
 bool CurlHttpIO::doio()
 {
-    bool result;
-    CURLMsg* msg;
-    int dummy;
+    if (iothread)
+    {
+        iomutex->lock();
+        bool result = harvest();
+        iomutex->unlock();
+
+        if (result)
+        {
+            // (completed handles were removed from the multi handle)
+            iowaiter->notify();
+        }
+
+        return result;
+    }
 
+    pump();
+
+    return harvest();
+}
+
+void CurlHttpIO::pump()
+{
     if(waiter)
     {
         ares_process(ares, &waiter->rfds, &waiter->wfds);
     }
-    curl_multi_perform(curlm, &dummy);
+
+#ifdef USE_EVENTPOLL
+    if (waiter && waiter->canwatch())
+    {
+        // only the sockets with pending events are processed
+        for (unsigned i = 0; i < waiter->readyfds.size(); i++)
+        {
+            int fd = waiter->readyfds[i].first;
+            int events = waiter->readyfds[i].second;
+
+            if (curlsockets.find(fd) != curlsockets.end())
+            {
+                curl_multi_socket_action(curlm, fd,
+                                         ((events & PosixWaiter::WATCH_READ) ? CURL_CSELECT_IN : 0)
+                                       | ((events & PosixWaiter::WATCH_WRITE) ? CURL_CSELECT_OUT : 0)
+                                       | ((events & PosixWaiter::WATCH_ERROR) ? CURL_CSELECT_ERR : 0),
+                                         &runninghandles);
+            }
+        }
+
+        waiter->readyfds.clear();
+
+        if (curltimeoutms >= 0 && curltimeoutms <= Waiter::dsms)
+        {
+            curltimeoutms = -1;
+            curl_multi_socket_action(curlm, CURL_SOCKET_TIMEOUT, 0, &runninghandles);
+        }
+    }
+    else
+#endif
+    {
+        curl_multi_perform(curlm, &runninghandles);
+    }
+}
+
+bool CurlHttpIO::harvest()
+{
+    bool result;
+    CURLMsg* msg;
+    int dummy;
 
     while ((msg = curl_multi_info_read(curlm, &dummy)))
     {
@@ -1122,8 +1761,27 @@ bool CurlHttpIO::doio()
 
             if (msg->msg == CURLMSG_DONE)
             {
+                double connecttime = 0;
+                double appconnecttime = 0;
+
                 curl_easy_getinfo(msg->easy_handle, CURLINFO_RESPONSE_CODE, &req->httpstatus);
 
+                // both are 0 on a reused connection
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_CONNECT_TIME, &connecttime);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_APPCONNECT_TIME, &appconnecttime);
+
+#ifdef HAVE_CURL_SSLS
+                // a TLS handshake took place: its session is worth saving
+                if (appconnecttime > 0)
+                {
+                    tlssessionschanged = true;
+                }
+#endif
+
+                req->timeline.completed = Waiter::us();
+                req->timeline.connected = req->timeline.resolved
+                        + (int64_t)(((appconnecttime > connecttime) ? appconnecttime : connecttime) * 1000000);
+
                 LOG_debug << "CURLMSG_DONE with HTTP status: " << req->httpstatus;
                 if (req->httpstatus)
                 {
@@ -1164,6 +1822,33 @@ bool CurlHttpIO::doio()
 
             statechange = true;
 
+            if (req->httpiohandle)
+            {
+                HttpHostStats& hoststat = hoststats[((CurlHttpContext*)req->httpiohandle)->hostname];
+#if LIBCURL_VERSION_NUM >= 0x073700
+                curl_off_t sent = 0;
+                curl_off_t received = 0;
+
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_UPLOAD_T, &sent);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_DOWNLOAD_T, &received);
+#else
+                double sent = 0;
+                double received = 0;
+
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_UPLOAD, &sent);
+                curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_DOWNLOAD, &received);
+#endif
+
+                hoststat.requests++;
+                hoststat.bytesout += (m_off_t)sent;
+                hoststat.bytesin += (m_off_t)received;
+
+                if (req->status == REQ_FAILURE)
+                {
+                    hoststat.failures++;
+                }
+            }
+
             if (req->status == REQ_FAILURE && !req->httpstatus)
             {                
                 CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
@@ -1196,18 +1881,17 @@ bool CurlHttpIO::doio()
                     ipv6deactivationtime = Waiter::ds;
 
                     // for IPv6 errors, try IPv4 before sending an error to the engine
-                    if((dnsEntry.ipv4.size() && Waiter::ds - dnsEntry.ipv4timestamp < DNS_CACHE_TIMEOUT_DS) || httpctx->ares_pending)
+                    if(dnsEntry.ipv4valid() || httpctx->ares_pending)
                     {
                         curl_multi_remove_handle(curlm, msg->easy_handle);
-                        curl_easy_cleanup(msg->easy_handle);
-                        curl_slist_free_all(httpctx->headers);
+                        releasecurl(msg->easy_handle);
                         httpctx->headers = NULL;
                         httpctx->curl = NULL;
                         req->httpio = this;
                         req->in.clear();
                         req->status = REQ_INFLIGHT;
 
-                        if(dnsEntry.ipv4.size() && Waiter::ds - dnsEntry.ipv4timestamp < DNS_CACHE_TIMEOUT_DS)
+                        if(dnsEntry.ipv4valid())
                         {
                             LOG_debug << "Retrying using IPv4 from cache";
                             httpctx->isIPv6 = false;
@@ -1230,7 +1914,7 @@ bool CurlHttpIO::doio()
         }
 
         curl_multi_remove_handle(curlm, msg->easy_handle);
-        curl_easy_cleanup(msg->easy_handle);
+        releasecurl(msg->easy_handle);
 
         if (req)
         {
@@ -1239,7 +1923,6 @@ bool CurlHttpIO::doio()
             CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
             if(httpctx)
             {
-                curl_slist_free_all(httpctx->headers);
                 req->httpiohandle = NULL;
 
                 httpctx->req = NULL;
@@ -1256,6 +1939,149 @@ bool CurlHttpIO::doio()
     return result;
 }
 
+void CurlHttpIO::lock()
+{
+    if (iomutex)
+    {
+        iomutex->lock();
+    }
+}
+
+void CurlHttpIO::unlock()
+{
+    if (iomutex)
+    {
+        iomutex->unlock();
+    }
+}
+
+CurlHttpIO::IOLock::IOLock(Mutex* m, WAIT_CLASS* w)
+{
+    mutex = m;
+    waiter = w;
+
+    if (mutex)
+    {
+        mutex->lock();
+    }
+}
+
+CurlHttpIO::IOLock::~IOLock()
+{
+    if (mutex)
+    {
+        mutex->unlock();
+
+        // the request set, its sockets or timeouts may have changed
+        waiter->notify();
+    }
+}
+
+bool CurlHttpIO::startiothread(Thread* thread, Mutex* mutex)
+{
+    if (iothread)
+    {
+        return false;
+    }
+
+#ifdef USE_EVENTPOLL
+    // the engine's waiter stops watching curl's sockets, the I/O thread's
+    // waiter takes them over on its first cycle
+    if (waiter && waiter->canwatch())
+    {
+        for (std::map<curl_socket_t, int>::iterator it = curlsockets.begin(); it != curlsockets.end(); it++)
+        {
+            waiter->watch(it->first, 0);
+        }
+    }
+#endif
+
+    LOG_debug << "Starting the network I/O thread";
+
+    waiter = NULL;
+    iowaiter = new WAIT_CLASS;
+    iomutex = mutex;
+    iostop = false;
+    iorunning = runninghandles;
+    iolastdata = lastdata;
+    iothread = thread;
+
+    iothread->start(iothreadentry, this);
+
+    return true;
+}
+
+void CurlHttpIO::stopiothread()
+{
+    if (!iothread)
+    {
+        return;
+    }
+
+    iomutex->lock();
+    iostop = true;
+    iomutex->unlock();
+
+    iowaiter->notify();
+    iothread->join();
+
+    LOG_debug << "Network I/O thread stopped";
+
+    // the engine's waiter takes over the sockets in the next addevents()
+    waiter = NULL;
+    enginewaiter = NULL;
+
+    delete iowaiter;
+    iowaiter = NULL;
+    iomutex = NULL;
+    iothread = NULL;
+}
+
+void* CurlHttpIO::iothreadentry(void* param)
+{
+    ((CurlHttpIO*)param)->ioloop();
+
+    return NULL;
+}
+
+// wait for socket events and timeouts, pump, and wake up the engine if a
+// request completed or changed state (and once per decisecond as data
+// arrives, for progress reporting)
+void CurlHttpIO::ioloop()
+{
+    iomutex->lock();
+
+    while (!iostop)
+    {
+        Waiter::bumpds();
+
+        iowaiter->init(NEVER);
+        addevents(iowaiter, Waiter::NEEDEXEC);
+
+        iomutex->unlock();
+        iowaiter->wait();
+        iomutex->lock();
+
+        if (iostop)
+        {
+            break;
+        }
+
+        Waiter::bumpds();
+        pump();
+
+        if (enginewaiter && (statechange || runninghandles != iorunning || lastdata != iolastdata))
+        {
+            iorunning = runninghandles;
+            iolastdata = lastdata;
+
+            enginewaiter->notify();
+        }
+    }
+
+    iomutex->unlock();
+}
+
 // callback for incoming HTTP payload
 void CurlHttpIO::send_pending_requests()
 {
@@ -1301,6 +2127,7 @@ void CurlHttpIO::drop_pending_requests()
 // unpause potentially paused connection after more data was added to req->chunkedout, calling read_data() again
 void CurlHttpIO::sendchunked(HttpReq* req)
 {
+    IOLock iolock(iomutex, iowaiter);
     if (req->httpiohandle)
     {
         CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
@@ -1315,6 +2142,24 @@ void CurlHttpIO::sendchunked(HttpReq* req)
     }
 }
 
+// the data refused by write_data() is delivered again by curl_easy_pause()
+void CurlHttpIO::resumereceive(HttpReq* req)
+{
+    IOLock iolock(iomutex, iowaiter);
+    if (req->recvpaused && req->httpiohandle)
+    {
+        CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
+
+        if (httpctx->curl)
+        {
+            req->recvpaused = false;
+            statechange = true;
+
+            curl_easy_pause(httpctx->curl, CURLPAUSE_RECV_CONT);
+        }
+    }
+}
+
 size_t CurlHttpIO::read_data(void* ptr, size_t size, size_t nmemb, void* source)
 {
     if (!((HttpReq*)source)->out)
@@ -1347,6 +2192,14 @@ size_t CurlHttpIO::write_data(void* ptr, size_t, size_t nmemb, void* target)
         ((CurlHttpIO*)((HttpReq*)target)->httpio)->statechange = true;
     }
 
+    // flow control: stop reading from the connection until resumereceive()
+    if (((HttpReq*)target)->maxbuffered && ((HttpReq*)target)->httpio
+     && (m_off_t)((HttpReq*)target)->in.size() >= ((HttpReq*)target)->maxbuffered)
+    {
+        ((HttpReq*)target)->recvpaused = true;
+        return CURL_WRITEFUNC_PAUSE;
+    }
+
     if(((HttpReq*)target)->httpio)
     {
         ((HttpReq*)target)->put(ptr, nmemb, true);
@@ -1445,7 +2298,19 @@ int CurlHttpIO::cert_verify_callback(X509_STORE_CTX* ctx, void* req)
 CurlDNSEntry::CurlDNSEntry()
 {
     ipv4timestamp = 0;
+    ipv4ttl = DNS_CACHE_TIMEOUT_DS;
     ipv6timestamp = 0;
+    ipv6ttl = DNS_CACHE_TIMEOUT_DS;
+}
+
+bool CurlDNSEntry::ipv4valid() const
+{
+    return ipv4.size() && Waiter::ds - ipv4timestamp < ipv4ttl;
+}
+
+bool CurlDNSEntry::ipv6valid() const
+{
+    return ipv6.size() && Waiter::ds - ipv6timestamp < ipv6ttl;
 }
 
 } // namespace
@@ -21,6 +21,12 @@
 
 #include "mega.h"
 
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#elif defined(USE_KQUEUE)
+#include <sys/event.h>
+#endif
+
 #ifdef __APPLE__
 #define CLOCK_MONOTONIC 0
 int clock_gettime(int, struct timespec* t)
@@ -39,6 +45,7 @@ int clock_gettime(int, struct timespec* t)
 
 namespace mega {
 dstime Waiter::ds;
+int64_t Waiter::dsms;
 
 PosixWaiter::PosixWaiter()
 {
@@ -55,6 +62,35 @@ PosixWaiter::PosixWaiter()
     }
 
     maxfd = -1;
+    pollfd = -1;
+
+#ifdef USE_EPOLL
+    pollfd = epoll_create1(EPOLL_CLOEXEC);
+#elif defined(USE_KQUEUE)
+    pollfd = kqueue();
+#endif
+
+    // the poll descriptor must itself be usable with select()
+    if (pollfd >= FD_SETSIZE)
+    {
+        close(pollfd);
+        pollfd = -1;
+    }
+
+#ifdef USE_EVENTPOLL
+    if (pollfd < 0)
+    {
+        LOG_warn << "Event poller not available, using select()";
+    }
+#endif
+}
+
+PosixWaiter::~PosixWaiter()
+{
+    if (pollfd >= 0)
+    {
+        close(pollfd);
+    }
 }
 
 void PosixWaiter::init(dstime ds)
@@ -67,6 +103,8 @@ void PosixWaiter::init(dstime ds)
     FD_ZERO(&wfds);
     FD_ZERO(&efds);
     FD_ZERO(&ignorefds);
+
+    readyfds.clear();
 }
 
 // update monotonously increasing timestamp in deciseconds
@@ -76,7 +114,17 @@ void Waiter::bumpds()
 
     clock_gettime(CLOCK_MONOTONIC, &ts);
 
-    ds = ts.tv_sec * 10 + ts.tv_nsec / 100000000;
+    dsms = (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+    ds = (dstime)(dsms / 100);
+}
+
+int64_t Waiter::us()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
 }
 
 // update maxfd for select()
@@ -101,7 +149,7 @@ bool PosixWaiter::fd_filter(int nfds, fd_set* fds, fd_set* ignorefds) const
 }
 
 // wait for supplied events (sockets, filesystem changes), plus timeout + application events
-// maxds specifies the maximum amount of time to wait in deciseconds (or ~0 if no timeout scheduled)
+// maxms specifies the maximum amount of time to wait in milliseconds (or -1 if no timeout scheduled)
 // returns application-specific bitmask. bit 0 set indicates that exec() needs to be called.
 int PosixWaiter::wait()
 {
@@ -112,15 +160,20 @@ int PosixWaiter::wait()
     FD_SET(m_pipe[0], &rfds);
     bumpmaxfd(m_pipe[0]);
 
-    if (maxds + 1)
+    // the poll descriptor becomes readable when a watched descriptor is ready
+    if (pollfd >= 0)
     {
-        dstime us = 1000000 / 10 * maxds;
+        FD_SET(pollfd, &rfds);
+        bumpmaxfd(pollfd);
+    }
 
-        tv.tv_sec = us / 1000000;
-        tv.tv_usec = us - tv.tv_sec * 1000000;
+    if (maxms >= 0)
+    {
+        tv.tv_sec = (time_t)(maxms / 1000);
+        tv.tv_usec = (suseconds_t)(maxms % 1000 * 1000);
     }
 
-    numfd = select(maxfd + 1, &rfds, &wfds, &efds, maxds + 1 ? &tv : NULL);
+    numfd = select(maxfd + 1, &rfds, &wfds, &efds, maxms >= 0 ? &tv : NULL);
 
     // empty pipe
     uint8_t buf;
@@ -132,6 +185,11 @@ int PosixWaiter::wait()
         return NEEDEXEC;
     }
 
+    if (pollfd >= 0 && FD_ISSET(pollfd, &rfds))
+    {
+        collectready();
+    }
+
     // request exec() to be run only if a non-ignored fd was triggered
     return (fd_filter(maxfd + 1, &rfds, &ignorefds)
          || fd_filter(maxfd + 1, &wfds, &ignorefds)
@@ -142,4 +200,99 @@ void PosixWaiter::notify()
 {
     write(m_pipe[1], "0", 1);
 }
+
+bool PosixWaiter::canwatch() const
+{
+    return pollfd >= 0;
+}
+
+bool PosixWaiter::watch(int fd, int events)
+{
+    if (pollfd < 0)
+    {
+        return false;
+    }
+
+#ifdef USE_EPOLL
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof ev);
+    ev.events = ((events & WATCH_READ) ? EPOLLIN : 0) | ((events & WATCH_WRITE) ? EPOLLOUT : 0);
+    ev.data.fd = fd;
+
+    if (!events)
+    {
+        return !epoll_ctl(pollfd, EPOLL_CTL_DEL, fd, &ev) || errno == ENOENT || errno == EBADF;
+    }
+
+    if (!epoll_ctl(pollfd, EPOLL_CTL_MOD, fd, &ev))
+    {
+        return true;
+    }
+
+    return errno == ENOENT && !epoll_ctl(pollfd, EPOLL_CTL_ADD, fd, &ev);
+#elif defined(USE_KQUEUE)
+    struct kevent change;
+
+    // deleting an unregistered filter fails harmlessly
+    EV_SET(&change, fd, EVFILT_READ, (events & WATCH_READ) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    kevent(pollfd, &change, 1, NULL, 0, NULL);
+
+    EV_SET(&change, fd, EVFILT_WRITE, (events & WATCH_WRITE) ? EV_ADD : EV_DELETE, 0, 0, NULL);
+    kevent(pollfd, &change, 1, NULL, 0, NULL);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+// fetch the ready descriptors without blocking
+void PosixWaiter::collectready()
+{
+#if defined(USE_EPOLL) || defined(USE_KQUEUE)
+    static const int MAXEVENTS = 64;
+    int n;
+#endif
+
+#ifdef USE_EPOLL
+    struct epoll_event evs[MAXEVENTS];
+
+    while ((n = epoll_wait(pollfd, evs, MAXEVENTS, 0)) > 0)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            int events = ((evs[i].events & EPOLLIN) ? WATCH_READ : 0)
+                       | ((evs[i].events & EPOLLOUT) ? WATCH_WRITE : 0)
+                       | ((evs[i].events & (EPOLLERR | EPOLLHUP)) ? WATCH_ERROR : 0);
+
+            readyfds.push_back(pair<int, int>(evs[i].data.fd, events));
+        }
+
+        if (n < MAXEVENTS)
+        {
+            break;
+        }
+    }
+#elif defined(USE_KQUEUE)
+    struct kevent evs[MAXEVENTS];
+    struct timespec nowait = { 0, 0 };
+
+    while ((n = kevent(pollfd, NULL, 0, evs, MAXEVENTS, &nowait)) > 0)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            int events = (evs[i].filter == EVFILT_READ ? WATCH_READ : WATCH_WRITE)
+                       | ((evs[i].flags & (EV_EOF | EV_ERROR)) ? WATCH_ERROR : 0);
+
+            readyfds.push_back(pair<int, int>((int)evs[i].ident, events));
+        }
+
+        if (n < MAXEVENTS)
+        {
+            break;
+        }
+    }
+#endif
+}
 } // namespace
@@ -24,6 +24,11 @@
 #include "mega/logging.h"
 
 namespace mega {
+Request::Request()
+{
+    next = 0;
+}
+
 void Request::add(Command* c)
 {
     cmds.push_back(c);
@@ -34,10 +39,70 @@ int Request::cmdspending() const
     return cmds.size();
 }
 
+Command* Request::first() const
+{
+    return cmds.size() ? cmds[0] : NULL;
+}
+
+void Request::limitbulk(Request* overflow, int maxbulk)
+{
+    vector<Command*> deferred;
+    unsigned kept = 0;
+    int bulk = 0;
+
+    for (unsigned i = 0; i < cmds.size(); i++)
+    {
+        if (!cmds[i]->independent()
+         && (deferred.size() || (cmds[i]->priority() == Command::PRIORITY_BULK && bulk++ >= maxbulk)))
+        {
+            deferred.push_back(cmds[i]);
+        }
+        else
+        {
+            cmds[kept++] = cmds[i];
+        }
+    }
+
+    if (deferred.size())
+    {
+        cmds.resize(kept);
+        overflow->cmds.insert(overflow->cmds.begin(), deferred.begin(), deferred.end());
+    }
+}
+
+void Request::extractindependent(Request* dst)
+{
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < cmds.size(); i++)
+    {
+        if (cmds[i]->independent())
+        {
+            dst->add(cmds[i]);
+        }
+        else
+        {
+            cmds[kept++] = cmds[i];
+        }
+    }
+
+    cmds.resize(kept);
+}
+
 void Request::get(string* req) const
 {
-    // concatenate all command objects, resulting in an API request
-    *req = "[";
+    // concatenate all command objects, resulting in an API request - sized
+    // up front, so that large batches are assembled with a single allocation
+    size_t size = 2;
+
+    for (int i = 0; i < (int)cmds.size(); i++)
+    {
+        size += cmds[i]->getstring().size() + 3;
+    }
+
+    req->clear();
+    req->reserve(size);
+    req->append("[");
 
     for (int i = 0; i < (int)cmds.size(); i++)
     {
@@ -49,15 +114,17 @@ void Request::get(string* req) const
     req->append("]");
 }
 
-void Request::procresult(MegaClient* client)
+bool Request::procresult(MegaClient* client, int64_t deadline)
 {
-    if (!client->json.enterarray())
+    if (!next && !client->json.enterarray())
     {
         LOG_err << "Invalid response from server";
     }
 
-    for (int i = 0; i < (int)cmds.size(); i++)
+    while (next < (int)cmds.size())
     {
+        int i = next++;
+
         client->restag = cmds[i]->tag;
 
         cmds[i]->client = client;
@@ -87,15 +154,28 @@ void Request::procresult(MegaClient* client)
 
         if(!cmds.size())
         {
-            return;
+            return true;
+        }
+
+        if (deadline && next < (int)cmds.size() && Waiter::us() > deadline)
+        {
+            return false;
         }
     }
 
     clear();
+    return true;
+}
+
+bool Request::started() const
+{
+    return next > 0;
 }
 
 void Request::clear()
 {
+    next = 0;
+
     for (int i = (int)cmds.size(); i--; )
     {
         if (!cmds[i]->persistent)
@@ -24,8 +24,33 @@
 #include "mega/base64.h"
 #include "mega/megaclient.h"
 #include "mega/command.h"
+#include "mega/aesbatch.h"
+#include "mega/workerpool.h"
 
 namespace mega {
+// encrypts a batch of node keys on a worker thread
+struct ShareKeyJob : public WorkerJob
+{
+    AesBatch batch;
+    bool finished;
+
+    void run()
+    {
+        batch.run();
+        finished = true;
+    }
+
+    ShareKeyJob()
+    {
+        finished = false;
+    }
+};
+
+ShareNodeKeys::ShareNodeKeys()
+{
+    encrypted = 0;
+}
+
 // add share node and return its index
 int ShareNodeKeys::addshare(Node* sn)
 {
@@ -38,6 +63,7 @@ int ShareNodeKeys::addshare(Node* sn)
     }
 
     shares.push_back(sn);
+    sharehandles.push_back(sn->nodehandle);
 
     return shares.size() - 1;
 }
@@ -55,25 +81,26 @@ void ShareNodeKeys::add(Node* n, Node* sn, int specific)
 // add a nodecore (!sn: all relevant shares, otherwise starting from sn, fixed: only sn)
 void ShareNodeKeys::add(NodeCore* n, Node* sn, int specific, const byte* item, int itemlen)
 {
-    char buf[96];
-    char* ptr;
-    byte key[FILENODEKEYLENGTH];
-
     int addnode = 0;
 
-    // emit all share nodekeys for known shares
+    if (n->nodekey.size() > FILENODEKEYLENGTH)
+    {
+        return;
+    }
+
+    // queue all share nodekeys for known shares
     do {
         if (sn->sharekey)
         {
-            sprintf(buf, ",%d,%d,\"", addshare(sn), (int)items.size());
+            pending.resize(pending.size() + 1);
 
-            sn->sharekey->ecb_encrypt((byte*)n->nodekey.data(), key, n->nodekey.size());
+            PendingKey* p = &pending.back();
 
-            ptr = strchr(buf + 5, 0);
-            ptr += Base64::btoa(key, n->nodekey.size(), ptr);
-            *ptr++ = '"';
+            p->share = addshare(sn);
+            p->item = items.size();
+            p->keylength = n->nodekey.size();
+            memcpy(p->key, n->nodekey.data(), p->keylength);
 
-            keys.append(buf, ptr - buf);
             addnode = 1;
         }
     } while (!specific && (sn = sn->parent));
@@ -93,17 +120,127 @@ void ShareNodeKeys::add(NodeCore* n, Node* sn, int specific, const byte* item, i
     }
 }
 
-void ShareNodeKeys::get(Command* c)
+void ShareNodeKeys::merge(ShareNodeKeys* snk)
+{
+    int base = items.size();
+
+    for (unsigned i = 0; i < snk->pending.size(); i++)
+    {
+        pending.push_back(snk->pending[i]);
+
+        PendingKey* p = &pending.back();
+
+        p->share = addshare(snk->shares[p->share]);
+        p->item += base;
+    }
+
+    items.insert(items.end(), snk->items.begin(), snk->items.end());
+}
+
+void ShareNodeKeys::encrypt(WorkerPool* pool)
 {
+    vector<ShareKeyJob*> jobs;
+
+    while (encrypted < pending.size())
+    {
+        ShareKeyJob* job = new ShareKeyJob;
+
+        for (; encrypted < pending.size() && job->batch.size() < ENCRYPTBATCH; encrypted++)
+        {
+            PendingKey* p = &pending[encrypted];
+
+            job->batch.add(shares[p->share]->sharekey->key, p->key, p->keylength, AesBatch::ECB_ENCRYPT);
+        }
+
+        jobs.push_back(job);
+    }
+
+    if (!jobs.size())
+    {
+        return;
+    }
+
+    // the last batch is run by the engine
+    for (unsigned i = 0; pool && i + 1 < jobs.size(); i++)
+    {
+        pool->push(jobs[i]);
+    }
+
+    jobs.back()->run();
+
+    for (unsigned i = 0; i < jobs.size(); i++)
+    {
+        if (pool && i + 1 < jobs.size())
+        {
+            pool->waitfor(jobs[i]);
+        }
+
+        if (!jobs[i]->finished)
+        {
+            jobs[i]->run();
+        }
+
+        delete jobs[i];
+    }
+}
+
+void ShareNodeKeys::get(Command* c, unsigned first, unsigned count)
+{
+    unsigned end = items.size();
+
+    if (first >= end)
+    {
+        return;
+    }
+
+    if (count < end - first)
+    {
+        end = first + count;
+    }
+
+    encrypt();
+
+    // locate the first key of the range (the keys are queued in item order)
+    unsigned lo = 0, hi = pending.size();
+
+    while (lo < hi)
+    {
+        unsigned mid = (lo + hi) / 2;
+
+        if (pending[mid].item < (int)first)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+
+    string keys;
+    char buf[96];
+    char* ptr;
+
+    for (unsigned i = lo; i < pending.size() && pending[i].item < (int)end; i++)
+    {
+        sprintf(buf, ",%d,%d,\"", pending[i].share, pending[i].item - (int)first);
+
+        ptr = strchr(buf + 5, 0);
+        ptr += Base64::btoa(pending[i].key, pending[i].keylength, ptr);
+        *ptr++ = '"';
+
+        keys.append(buf, ptr - buf);
+    }
+
     if (keys.size())
     {
         c->beginarray("cr");
 
         // emit share node handles
         c->beginarray();
-        for (unsigned i = 0; i < shares.size(); i++)
+        for (unsigned i = 0; i < sharehandles.size(); i++)
         {
-            c->element((const byte*)&shares[i]->nodehandle, MegaClient::NODEHANDLE);
+            c->element(sharehandles[i], MegaClient::NODEHANDLE);
         }
 
         c->endarray();
@@ -111,7 +248,7 @@ void ShareNodeKeys::get(Command* c)
         // emit item handles (can be node handles or upload tokens)
         c->beginarray();
 
-        for (unsigned i = 0; i < items.size(); i++)
+        for (unsigned i = first; i < end; i++)
         {
             c->element((const byte*)items[i].c_str(), items[i].size());
         }
@@ -25,10 +25,26 @@
 #include "mega/sync.h"
 #include "mega/megaapp.h"
 #include "mega/transfer.h"
+#include "mega/transferslot.h"
 #include "mega/megaclient.h"
 #include "mega/base64.h"
 
 namespace mega {
+SyncStats::SyncStats()
+{
+    direvents = 0;
+    retries = 0;
+    fingerprinted = 0;
+    fingerprintrate = 0;
+    pendingup = 0;
+    pendingdown = 0;
+    syncdownds = 0;
+    syncupds = 0;
+    cacheflushds = 0;
+    notifications = 0;
+    superseded = 0;
+}
+
 // new Syncs are automatically inserted into the session's syncs list
 // and a full read of the subtree is initiated
 Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
@@ -44,12 +60,22 @@ Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
     localnodes[FILENODE] = 0;
     localnodes[FOLDERNODE] = 0;
 
+    cachecheckpoint = Waiter::ds + CACHECHECKPOINTDS;
+    scanrecord = false;
+    resumescan = false;
+
+    statsfingerprinted = 0;
+    statsds = Waiter::ds;
+
     state = SYNC_INITIALSCAN;
     statecachetable = NULL;
 
     fullscan = true;
     scanseqno = 0;
 
+    verifyscan = false;
+    lastverify = Waiter::ds;
+
     if (cdebris)
     {
         debris = cdebris;
@@ -68,6 +94,9 @@ Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
         dirnotify = client->fsaccess->newdirnotify(crootpath, &localdebris);
     }
 
+    // enables the collapsing of notification bursts
+    dirnotify->localseparator = client->fsaccess->localseparator;
+
     // set specified fsfp or get from fs if none
     if (cfsfp)
     {
@@ -107,6 +136,14 @@ Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
 
         delete fas;
     }
+
+    // with a change journal, the changes since the cached state was saved
+    // are replayed instead of rescanning the tree
+    if (dirnotify->start(journal.size() ? &journal : NULL))
+    {
+        LOG_debug << "Replaying filesystem changes";
+        fullscan = false;
+    }
 }
 
 Sync::~Sync()
@@ -124,19 +161,40 @@ Sync::~Sync()
         client->proctree(localroot.node, &tdsg);
     }
 
+    dirnotify->stop();
+
+    dropscanjobs();
+
+    for (syncfingerprintjob_list::iterator it = fingerprintjobs.begin(); it != fingerprintjobs.end(); it++)
+    {
+        client->workerpool->waitfor(*it);
+
+        if ((*it)->localnode)
+        {
+            (*it)->localnode->fingerprintjob = NULL;
+        }
+
+        delete *it;
+    }
+
     delete statecachetable;
 
     client->syncs.erase(sync_it);
     client->syncactivity = true;
 }
 
-void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_map* tmap, string* path, LocalNode *p, int maxdepth)
+static bool parentdbidless(const pair<int32_t, LocalNode*>& a, const pair<int32_t, LocalNode*>& b)
+{
+    return a.first < b.first;
+}
+
+void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_vector* tmap, string* path, LocalNode *p, int maxdepth)
 {
-    pair<idlocalnode_map::iterator,idlocalnode_map::iterator> range;
-    idlocalnode_map::iterator it;
+    pair<idlocalnode_vector::iterator,idlocalnode_vector::iterator> range;
+    idlocalnode_vector::iterator it;
     size_t pathlen;
 
-    range = tmap->equal_range(parent_dbid);
+    range = equal_range(tmap->begin(), tmap->end(), pair<int32_t, LocalNode*>(parent_dbid, NULL), parentdbidless);
 
     pathlen = path->size();
 
@@ -149,6 +207,9 @@ void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_map* tmap, st
 
         LocalNode* l = it->second;
         Node* node = l->node;
+
+        // consumed
+        it->second = NULL;
         handle fsid = l->fsid;
         m_off_t size = l->size;
 
@@ -176,7 +237,7 @@ bool Sync::readstatecache()
     if (statecachetable && state == SYNC_INITIALSCAN)
     {
         string cachedata;
-        idlocalnode_map tmap;
+        idlocalnode_vector tmap;
         uint32_t cid;
         LocalNode* l;
 
@@ -185,16 +246,50 @@ bool Sync::readstatecache()
         // bulk-load cached nodes into tmap
         while (statecachetable->next(&cid, &cachedata, &client->key))
         {
+            // change journal position (unencrypted)
+            if (!cid)
+            {
+                journal = cachedata;
+                continue;
+            }
+
+            // the initial scan was interrupted
+            if (cid == SCANRECORD)
+            {
+                scanrecord = true;
+                resumescan = true;
+                continue;
+            }
+
             if ((l = LocalNode::unserialize(this, &cachedata)))
             {
                 l->dbid = cid;
-                tmap.insert(pair<int32_t,LocalNode*>(l->parent_dbid,l));
+                tmap.push_back(pair<int32_t,LocalNode*>(l->parent_dbid,l));
             }
         }
 
+        // group by parent (siblings remain in record order)
+        stable_sort(tmap.begin(), tmap.end(), parentdbidless);
+
         // recursively build LocalNode tree, set scanseqnos to sync's current scanseqno
         addstatecachechildren(0, &tmap, &localroot.localname, &localroot, 100);
 
+        // records not reachable from the root are dropped from the cache
+        for (idlocalnode_vector::iterator it = tmap.begin(); it != tmap.end(); it++)
+        {
+            if (it->second)
+            {
+                deleteq.insert(it->second->dbid);
+            }
+        }
+
+        // unless unchanged folders are skipped anyway, only the checkpoints
+        // of an interrupted initial scan may be resumed from
+        if (!resumescan && !client->syncskipunchanged)
+        {
+            cleardirmtimes(&localroot);
+        }
+
         // trigger a single-pass full scan to identify deleted nodes
         fullscan = true;
         scanseqno++;
@@ -235,13 +330,126 @@ void Sync::statecacheadd(LocalNode* l)
     }
 
     insertq.insert(l);
+
+    // changed LocalNodes are reconciled in the next sync pass
+    l->setdirty();
+}
+
+void Sync::cleardirmtimes(LocalNode* l)
+{
+    for (localnode_map::iterator it = l->children.begin(); it != l->children.end(); it++)
+    {
+        if (it->second->type == FOLDERNODE)
+        {
+            if (it->second->dirmtime)
+            {
+                it->second->dirmtime = 0;
+                statecacheadd(it->second);
+            }
+
+            cleardirmtimes(it->second);
+        }
+    }
+}
+
+bool Sync::checkpointscan(LocalNode* l, const localnode_set* pending)
+{
+    bool complete = l->scanseqno == scanseqno && !pending->count(l);
+
+    for (localnode_map::iterator it = l->children.begin(); it != l->children.end(); it++)
+    {
+        // entries not seen yet may have been deleted
+        if (it->second->scanseqno != scanseqno)
+        {
+            complete = false;
+        }
+        else if (it->second->type == FOLDERNODE && !checkpointscan(it->second, pending))
+        {
+            complete = false;
+        }
+    }
+
+    if (complete && l != &localroot && l->listedmtime && l->listedmtime != l->dirmtime)
+    {
+        l->dirmtime = l->listedmtime;
+        statecacheadd(l);
+    }
+
+    return complete;
+}
+
+void Sync::checkpointscan()
+{
+    localnode_set pending;
+    LocalNode* l;
+    LocalNode* parent;
+
+    for (int q = DirNotify::NUMQUEUES; q--; )
+    {
+        for (notify_deque::iterator it = dirnotify->notifyq[q].begin(); it != dirnotify->notifyq[q].end(); it++)
+        {
+            parent = NULL;
+
+            if ((l = localnodebypath(it->localnode, &it->path, &parent)))
+            {
+                pending.insert(l);
+                parent = l->parent;
+            }
+
+            // the deepest known folder on the path
+            if (parent)
+            {
+                pending.insert(parent);
+            }
+        }
+    }
+
+    for (syncfingerprintjob_list::iterator it = fingerprintjobs.begin(); it != fingerprintjobs.end(); it++)
+    {
+        if ((*it)->localnode && (*it)->localnode->parent)
+        {
+            pending.insert((*it)->localnode->parent);
+        }
+    }
+
+    checkpointscan(&localroot, &pending);
 }
 
 void Sync::cachenodes()
 {
-    if (statecachetable && (state == SYNC_ACTIVE || (state == SYNC_INITIALSCAN && insertq.size() > 100)) && (deleteq.size() || insertq.size()))
+    // during the initial scan, the folders completed so far are checkpointed
+    // along with the records
+    bool checkpoint = statecachetable
+                   && state == SYNC_INITIALSCAN
+                   && Waiter::ds >= cachecheckpoint;
+
+    if (checkpoint)
+    {
+        checkpointscan();
+    }
+
+    // the scan record is removed once the initial scan has completed
+    bool dropscanrecord = statecachetable && state == SYNC_ACTIVE && scanrecord;
+
+    // the journal position advances once all changes notified up to it have
+    // been processed
+    string pos;
+    bool savepos = statecachetable
+                && state == SYNC_ACTIVE
+                && !dirnotify->notifyq[DirNotify::DIREVENTS].size()
+                && !dirnotify->notifyq[DirNotify::RETRY].size()
+                && !fingerprintjobs.size()
+                && dirnotify->journalpos(&pos)
+                && pos.size() < JOURNALMAXSIZE
+                && pos != journal;
+
+    if (statecachetable && (state == SYNC_ACTIVE || (state == SYNC_INITIALSCAN && insertq.size() > 100)) && (deleteq.size() || insertq.size() || savepos || dropscanrecord))
     {
         LOG_debug << "Saving LocalNode database with " << insertq.size() << " additions and " << deleteq.size() << " deletions";
+
+        WAIT_CLASS::bumpds();
+        dstime flushstart = Waiter::ds;
+
         statecachetable->begin();
 
         // deletions
@@ -252,31 +460,135 @@ void Sync::cachenodes()
 
         deleteq.clear();
 
-        // additions - we iterate until completion or until we get stuck
-        bool added;
+        if (dropscanrecord)
+        {
+            statecachetable->del(SCANRECORD);
+            scanrecord = false;
+            resumescan = false;
+        }
+
+        // additions - a record references its parent's dbid, so queued
+        // ancestors without one are written first (nodes whose ancestors
+        // are neither cached nor queued remain queued)
+        vector<LocalNode*> chain;
+
+        for (set<LocalNode*>::iterator it = insertq.begin(); it != insertq.end(); )
+        {
+            LocalNode* l = *it;
+            bool stuck = false;
 
-        do {
-            added = false;
+            chain.clear();
 
-            for (set<LocalNode*>::iterator it = insertq.begin(); it != insertq.end(); )
+            for (LocalNode* p = l->parent; p != &localroot && !p->dbid; p = p->parent)
             {
-                if ((*it)->parent->dbid || (*it)->parent == &localroot)
+                if (!insertq.count(p))
                 {
-                    statecachetable->put(MegaClient::CACHEDLOCALNODE, *it, &client->key);
-                    insertq.erase(it++);
-                    added = true;
+                    stuck = true;
+                    break;
                 }
-                else it++;
+
+                chain.push_back(p);
+            }
+
+            if (stuck)
+            {
+                it++;
+                continue;
             }
-        } while (added);
+
+            while (chain.size())
+            {
+                statecachetable->put(MegaClient::CACHEDLOCALNODE, chain.back(), &client->key);
+                insertq.erase(chain.back());
+                chain.pop_back();
+            }
+
+            statecachetable->put(MegaClient::CACHEDLOCALNODE, l, &client->key);
+            insertq.erase(it++);
+        }
+
+        if (savepos && !insertq.size())
+        {
+            statecachetable->put(MegaClient::CACHEDSCSN, (char*)pos.data(), pos.size());
+            journal = pos;
+        }
+
+        if (state == SYNC_INITIALSCAN && !scanrecord)
+        {
+            string record("scan");
+
+            PaddedCBC::encrypt(&record, &client->key);
+            statecachetable->put(SCANRECORD, &record);
+            scanrecord = true;
+        }
 
         statecachetable->commit();
 
+        WAIT_CLASS::bumpds();
+        stats.cacheflushds = Waiter::ds - flushstart;
+
+        cachecheckpoint = Waiter::ds + CACHECHECKPOINTDS;
+
         if (insertq.size())
         {
             LOG_err << "LocalNode caching did not complete";
         }
     }
+    else if (checkpoint)
+    {
+        // too little to save yet
+        cachecheckpoint = Waiter::ds + CACHECHECKPOINTDS;
+    }
+}
+
+void Sync::updatestats()
+{
+    dstime elapsed = Waiter::ds - statsds;
+
+    stats.direvents = dirnotify->notifyq[DirNotify::DIREVENTS].size();
+    stats.retries = dirnotify->notifyq[DirNotify::RETRY].size();
+
+    if (elapsed)
+    {
+        stats.fingerprintrate = (stats.fingerprinted - statsfingerprinted) * 10 / elapsed;
+    }
+
+    statsfingerprinted = stats.fingerprinted;
+    statsds = Waiter::ds;
+
+    // remaining data of the transfers that contain files of this sync
+    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    {
+        m_off_t pending = 0;
+
+        for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
+        {
+            Transfer* t = it->second;
+
+            for (file_list::iterator fit = t->files.begin(); fit != t->files.end(); fit++)
+            {
+                if ((*fit)->syncxfer && (*fit)->owner == tag)
+                {
+                    pending += t->size - (t->slot ? t->slot->progressreported : t->pos);
+                    break;
+                }
+            }
+        }
+
+        if (d == GET)
+        {
+            stats.pendingdown = pending;
+        }
+        else
+        {
+            stats.pendingup = pending;
+        }
+    }
+
+    stats.notifications = dirnotify->notified;
+    stats.superseded = dirnotify->superseded;
+
+    client->app->syncupdate_stats(this);
 }
 
 void Sync::changestate(syncstate_t newstate)
@@ -390,9 +702,217 @@ LocalNode* Sync::localnodebypath(LocalNode* l, string* localpath, LocalNode** pa
     }
 }
 
+DirScanJob::DirScanJob(DirAccess* cda, string* clocalpath, bool cfollowsymlinks)
+{
+    da = cda;
+    localpath = *clocalpath;
+    followsymlinks = cfollowsymlinks;
+    success = false;
+    finished = false;
+}
+
+DirScanJob::~DirScanJob()
+{
+    delete da;
+}
+
+// list the folder, taking over the open handle fa if set
+void DirScanJob::list(FileAccess* fa)
+{
+    string name;
+    nodetype_t type;
+    DirEntryStat st;
+
+    if ((success = da->dopen(&localpath, fa, false)))
+    {
+        while (da->dnext(&localpath, &name, followsymlinks, &type))
+        {
+            if (!da->dstat(&st))
+            {
+                st.type = TYPE_UNKNOWN;
+            }
+
+            names.push_back(name);
+            types.push_back(type);
+            stats.push_back(st);
+        }
+    }
+
+    finished = true;
+}
+
+void DirScanJob::run()
+{
+    list(NULL);
+}
+
+void Sync::prefetchscan(string* localpath)
+{
+    if (!client->workerpool
+     || scanjobs.size() >= client->syncjobshare(client->syncscanahead)
+     || scanjobs.find(*localpath) != scanjobs.end())
+    {
+        return;
+    }
+
+    DirScanJob* job = new DirScanJob(client->fsaccess->newdiraccess(), localpath, client->followsymlinks);
+
+    scanjobs[*localpath] = job;
+    client->workerpool->push(job);
+}
+
+void Sync::dropscanjobs()
+{
+    for (dirscanjob_map::iterator it = scanjobs.begin(); it != scanjobs.end(); it++)
+    {
+        client->workerpool->waitfor(it->second);
+        delete it->second;
+    }
+
+    scanjobs.clear();
+}
+
+SyncFingerprintJob::SyncFingerprintJob(LocalNode* l, FileAccess* cfa, bool cnewnode, bool creported)
+{
+    localnode = l;
+    fa = cfa;
+    fingerprint = *(FileFingerprint*)l;
+    changed = false;
+    newnode = cnewnode;
+    reported = creported;
+}
+
+SyncFingerprintJob::~SyncFingerprintJob()
+{
+    delete fa;
+}
+
+void SyncFingerprintJob::run()
+{
+    changed = fingerprint.genfingerprint(fa);
+}
+
+bool Sync::fingerprintcurrent(LocalNode* l, FileAccess* fa, bool trustmtime)
+{
+    if (verifyscan
+     || !l->isvalid
+     || l->size != fa->size
+     || l->mtime != fa->mtime
+     || (fa->fsidvalid && l->fsid != fa->fsid))
+    {
+        return false;
+    }
+
+    if (l->ctime && fa->ctime)
+    {
+        return l->ctime == fa->ctime;
+    }
+
+    return trustmtime;
+}
+
+bool Sync::queuefingerprint(LocalNode* l, FileAccess* fa, bool newnode, bool reported)
+{
+    unsigned share = client->syncjobshare(MegaClient::SYNCFINGERPRINTJOBS);
+
+    if (!client->workerpool || fingerprintjobs.size() >= (share < FINGERPRINTJOBS ? share : FINGERPRINTJOBS))
+    {
+        return false;
+    }
+
+    // a result still pending for an earlier version of the file is discarded
+    if (l->fingerprintjob)
+    {
+        l->fingerprintjob->localnode = NULL;
+    }
+
+    l->fingerprintjob = new SyncFingerprintJob(l, fa, newnode, reported);
+
+    fingerprintjobs.push_back(l->fingerprintjob);
+    client->workerpool->push(l->fingerprintjob);
+
+    return true;
+}
+
+void Sync::procfingerprints()
+{
+    for (syncfingerprintjob_list::iterator it = fingerprintjobs.begin(); it != fingerprintjobs.end(); )
+    {
+        SyncFingerprintJob* job = *it;
+
+        if (!client->workerpool->isdone(job))
+        {
+            it++;
+            continue;
+        }
+
+        fingerprintjobs.erase(it++);
+
+        LocalNode* l = job->localnode;
+
+        if (l)
+        {
+            l->fingerprintjob = NULL;
+            l->setdirty();
+
+            stats.fingerprinted++;
+
+            if (l->size > 0)
+            {
+                localbytes -= l->size;
+            }
+
+            *(FileFingerprint*)l = job->fingerprint;
+
+            bool newctime = l->ctime != job->fa->ctime;
+            l->ctime = job->fa->ctime;
+
+            if (l->size > 0)
+            {
+                localbytes += l->size;
+            }
+
+            if (job->changed)
+            {
+                l->bumpnagleds();
+                l->deleted = false;
+            }
+
+            if (!job->reported && (job->newnode || job->changed))
+            {
+                string localpath, path;
+
+                l->getlocalpath(&localpath);
+                client->fsaccess->local2path(&localpath, &path);
+
+                if (job->newnode)
+                {
+                    client->app->syncupdate_local_file_addition(this, l, path.c_str());
+                }
+                else
+                {
+                    client->app->syncupdate_local_file_change(this, l, path.c_str());
+                }
+            }
+
+            if (job->newnode || job->changed)
+            {
+                statecacheadd(l);
+                client->syncactivity = true;
+            }
+            else if (newctime)
+            {
+                statecacheadd(l);
+            }
+        }
+
+        delete job;
+    }
+}
+
 // scan localpath, add or update child nodes, call recursively for folder nodes
 // localpath must be prefixed with Sync
-bool Sync::scan(string* localpath, FileAccess* fa)
+bool Sync::scan(string* localpath, FileAccess* fa, LocalNode* l)
 {
     if (localpath->size() < localdebris.size()
      || memcmp(localpath->data(), localdebris.data(), localdebris.size())
@@ -401,19 +921,47 @@ bool Sync::scan(string* localpath, FileAccess* fa)
                 client->fsaccess->localseparator.data(),
                 client->fsaccess->localseparator.size())))
     {
-        DirAccess* da;
+        DirScanJob* job = NULL;
         string localname, name;
         bool success;
 
-        da = client->fsaccess->newdiraccess();
+        // use the read-ahead listing, if any
+        dirscanjob_map::iterator it = scanjobs.find(*localpath);
+
+        if (it != scanjobs.end())
+        {
+            job = it->second;
+            scanjobs.erase(it);
+
+            client->workerpool->waitfor(job);
+
+            if (!job->finished)
+            {
+                job->run();
+            }
+
+            // the folder may have been unavailable at the time: retry below
+            if (!job->success)
+            {
+                delete job;
+                job = NULL;
+            }
+        }
+
+        if (!job)
+        {
+            job = new DirScanJob(client->fsaccess->newdiraccess(), localpath, client->followsymlinks);
+            job->list(fa);
+        }
 
         // scan the dir, mark all items with a unique identifier
-        if ((success = da->dopen(localpath, fa, false)))
+        if ((success = job->success))
         {
             size_t t = localpath->size();
 
-            while (da->dnext(localpath, &localname, client->followsymlinks))
+            for (unsigned i = 0; i < job->names.size(); i++)
             {
+                localname = job->names[i];
                 name = localname;
                 client->fsaccess->local2name(&name);
 
@@ -437,6 +985,13 @@ bool Sync::scan(string* localpath, FileAccess* fa)
                     {
                         // new or existing record: place scan result in notification queue
                         dirnotify->notify(DirNotify::DIREVENTS, NULL, localpath->data(), localpath->size(), true);
+                        dirnotify->notifyq[DirNotify::DIREVENTS].back().stat = job->stats[i];
+
+                        // subfolders are listed ahead while their siblings are processed
+                        if (job->types[i] == FOLDERNODE)
+                        {
+                            prefetchscan(localpath);
+                        }
                     }
 
                     localpath->resize(t);
@@ -444,20 +999,66 @@ bool Sync::scan(string* localpath, FileAccess* fa)
             }
         }
 
-        delete da;
+        delete job;
+
+        // a folder modified in the same second as the listing could change
+        // again without a new mtime
+        if (success && l && fa && fa->mtime < (m_time_t)time(NULL) - 1)
+        {
+            l->listedmtime = fa->mtime;
+        }
 
         return success;
     }
     else return false;
 }
 
+void Sync::skipsubtree(LocalNode* l)
+{
+    for (localnode_map::iterator it = l->children.begin(); it != l->children.end(); it++)
+    {
+        it->second->scanseqno = scanseqno;
+
+        if (it->second->type == FOLDERNODE)
+        {
+            skipsubtree(it->second);
+        }
+        else if (it->second->size > 0)
+        {
+            localbytes += it->second->size;
+        }
+    }
+}
+
+void Sync::commitdirmtimes(LocalNode* l)
+{
+    if (l->listedmtime && l->listedmtime != l->dirmtime)
+    {
+        l->dirmtime = l->listedmtime;
+
+        if (l != &localroot)
+        {
+            statecacheadd(l);
+        }
+    }
+
+    for (localnode_map::iterator it = l->children.begin(); it != l->children.end(); it++)
+    {
+        if (it->second->type == FOLDERNODE)
+        {
+            commitdirmtimes(it->second);
+        }
+    }
+}
+
 // check local path - if !localname, localpath is relative to l, with l == NULL
 // being the root of the sync
 // if localname is set, localpath is absolute and localname its last component
+// st: the metadata of the entry from a folder listing, saves opening files
 // path references a new FOLDERNODE: returns created node
 // path references a existing FILENODE: returns node
 // otherwise, returns NULL
-LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
+LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, const DirEntryStat* st)
 {
     LocalNode* ll = l;
     FileAccess* fa;
@@ -547,10 +1148,13 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
         return (LocalNode*)~0;
     }
 
-    // attempt to open/type this file
+    // attempt to open/type this file - files listed with their metadata are
+    // opened by name only (folders are opened to be listed)
     fa = client->fsaccess->newfileaccess();
 
-    if (fa->fopen(localname ? localpath : &tmppath, true, false))
+    if ((st && st->type == FILENODE)
+      ? fa->fopen(localname ? localpath : &tmppath, st)
+      : fa->fopen(localname ? localpath : &tmppath, true, false))
     {
         // match cached LocalNode state during initial/rescan to prevent costly re-fingerprinting
         // (just compare the fsids, sizes and mtimes to detect changes)
@@ -572,14 +1176,31 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                 l->deleted = false;
                 l->setnotseen(0);
 
-                // if it's a file, size and mtime must match to qualify
-                if (l->type != FILENODE || (l->size == fa->size && l->mtime == fa->mtime))
+                // if it's a file, size and mtime (and ctime, if known) must
+                // match to qualify
+                if (l->type != FILENODE || fingerprintcurrent(l, fa, true))
                 {
                     l->scanseqno = scanseqno;
 
+                    // record the ctime of entries cached without one
+                    if (l->type == FILENODE && !l->ctime && fa->ctime)
+                    {
+                        l->ctime = fa->ctime;
+                        statecacheadd(l);
+                    }
+
                     if (l->type == FOLDERNODE)
                     {
-                        scan(localname ? localpath : &tmppath, fa);
+                        // no entries added, removed or renamed since the
+                        // last complete listing
+                        if ((client->syncskipunchanged || resumescan) && !verifyscan && l->dirmtime && l->dirmtime == fa->mtime)
+                        {
+                            skipsubtree(l);
+                        }
+                        else
+                        {
+                            scan(localname ? localpath : &tmppath, fa, l);
+                        }
                     }
                     else
                     {
@@ -671,13 +1292,6 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                                 l->setfsid(fa->fsid);
                             }
 
-                            m_off_t dsize = l->size > 0 ? l->size : 0;
-
-                            if (l->genfingerprint(fa) && l->size >= 0)
-                            {
-                                localbytes -= dsize - l->size;
-                            }
-
                             client->app->syncupdate_local_file_change(this, l, path.c_str());
 
                             client->stopxfer(l);
@@ -686,6 +1300,23 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
 
                             client->syncactivity = true;
 
+                            // the new fingerprint is applied once computed
+                            if (queuefingerprint(l, fa, false, true))
+                            {
+                                return l;
+                            }
+
+                            m_off_t dsize = l->size > 0 ? l->size : 0;
+
+                            stats.fingerprinted++;
+
+                            if (l->genfingerprint(fa) && l->size >= 0)
+                            {
+                                localbytes -= dsize - l->size;
+                            }
+
+                            l->ctime = fa->ctime;
+
                             statecacheadd(l);
 
                             delete fa;
@@ -745,14 +1376,14 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                     // immediately scan folder to detect deviations from cached state
                     if (fullscan)
                     {
-                        scan(localname ? localpath : &tmppath, fa);
+                        scan(localname ? localpath : &tmppath, fa, it->second);
                     }
                 }
                 else
                 {
                     // this is a new node: add
                     LOG_debug << "New localnode.  Parent: " << (parent ? parent->name : "NO");
-                    l = new LocalNode;
+                    l = new (client) LocalNode;
                     l->init(this, fa->type, parent, localname ? localpath : &tmppath);
 
                     if (fa->fsidvalid)
@@ -772,7 +1403,7 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
             {
                 if (newnode)
                 {
-                    scan(localname ? localpath : &tmppath, fa);
+                    scan(localname ? localpath : &tmppath, fa, l);
                     client->app->syncupdate_local_folder_addition(this, l, path.c_str());
 
                     if (!isroot)
@@ -794,6 +1425,16 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                     errorcode = API_EFAILED;
                     changestate(SYNC_FAILED);
                 }
+                else if (!newnode && fingerprintcurrent(l, fa, fullscan))
+                {
+                    // unchanged since it was last fingerprinted
+                }
+                else if (queuefingerprint(l, fa, newnode, false))
+                {
+                    // the file is reported once its fingerprint is known
+                    fa = NULL;
+                    newnode = false;
+                }
                 else
                 {
                     if (l->size > 0)
@@ -801,6 +1442,8 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                         localbytes -= l->size;
                     }
 
+                    stats.fingerprinted++;
+
                     if (l->genfingerprint(fa))
                     {
                         changed = true;
@@ -808,6 +1451,9 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                         l->deleted = false;
                     }
 
+                    bool newctime = l->ctime != fa->ctime;
+                    l->ctime = fa->ctime;
+
                     if (l->size > 0)
                     {
                         localbytes += l->size;
@@ -822,7 +1468,7 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                         client->app->syncupdate_local_file_change(this, l, path.c_str());
                     }
 
-                    if (newnode || changed)
+                    if (newnode || changed || newctime)
                     {
                         statecacheadd(l);
                     }
@@ -870,13 +1516,60 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
     return l;
 }
 
+// recheck a folder's entries: the ones present are queued by scan(), the
+// vanished ones through their LocalNodes (checkpath() registers them as
+// missing) - falls back to a regular check if the folder is not known
+LocalNode* Sync::rescanfolder(LocalNode* l, string* localpath)
+{
+    LocalNode* d = l;
+
+    if (localpath->size())
+    {
+        LocalNode* parent;
+        string rpath;
+
+        d = localnodebypath(l, localpath, &parent, &rpath);
+    }
+
+    if (!d || d->type != FOLDERNODE)
+    {
+        return checkpath(l, localpath);
+    }
+
+    string tmppath, childpath;
+    FileAccess* fa = client->fsaccess->newfileaccess();
+
+    d->getlocalpath(&tmppath);
+
+    if (!fa->fopen(&tmppath, true, false) || fa->type != FOLDERNODE)
+    {
+        delete fa;
+        return checkpath(l, localpath);
+    }
+
+    LOG_debug << "Rechecking folder after a burst of notifications: " << d->name;
+
+    for (localnode_map::iterator it = d->children.begin(); it != d->children.end(); it++)
+    {
+        it->second->getlocalpath(&childpath);
+        dirnotify->notify(DirNotify::DIREVENTS, NULL, childpath.data(), childpath.size(), true);
+    }
+
+    scan(&tmppath, fa, d);
+
+    delete fa;
+
+    return NULL;
+}
+
 // add or refresh local filesystem item from scan stack, add items to scan stack
 // returns 0 if a parent node is missing, ~0 if control should be yielded, or the time
 // until a retry should be made (300 ms minimum latency).
 dstime Sync::procscanq(int q)
 {
     size_t t = dirnotify->notifyq[q].size();
-    dstime dsmin = Waiter::ds - 3;
+    dstime dsmin = Waiter::ds - dirnotify->settledelay();
+    int64_t sliceend = Waiter::us() + SCANSLICEUS;
     LocalNode* l;
 
     while (t--)
@@ -891,7 +1584,24 @@ dstime Sync::procscanq(int q)
 
         if ((l = dirnotify->notifyq[q].front().localnode) != (LocalNode*)~0)
         {
-            l = checkpath(l, &dirnotify->notifyq[q].front().path);
+            // superseded by a more recent notification
+            if (!dirnotify->current((DirNotify::notifyqueue)q))
+            {
+                dirnotify->superseded++;
+                dirnotify->notifyq[q].pop_front();
+                continue;
+            }
+
+            if (dirnotify->notifyq[q].front().rescan)
+            {
+                l = rescanfolder(l, &dirnotify->notifyq[q].front().path);
+            }
+            else
+            {
+                const DirEntryStat* st = &dirnotify->notifyq[q].front().stat;
+
+                l = checkpath(l, &dirnotify->notifyq[q].front().path, NULL, st->type == TYPE_UNKNOWN ? NULL : st);
+            }
 
             // defer processing because of a missing parent node?
             if (l == (LocalNode*)~0)
@@ -907,13 +1617,16 @@ dstime Sync::procscanq(int q)
             LOG_debug << "Notification skipped: " << utf8path;
         }
 
+        dirnotify->processed((DirNotify::notifyqueue)q);
         dirnotify->notifyq[q].pop_front();
 
         // we return control to the application in case a filenode was added
         // (in order to avoid lengthy blocking episodes due to multiple
-        // consecutive fingerprint calculations)
+        // consecutive fingerprint calculations - unless the fingerprint is
+        // being computed by the worker pool)
         // or if new nodes are being added due to a copy/delete operation
-        if ((l && l != (LocalNode*)~0 && l->type == FILENODE) || client->syncadding)
+        if ((l && l != (LocalNode*)~0 && l->type == FILENODE && !l->fingerprintjob) || client->syncadding
+         || Waiter::us() >= sliceend)
         {
             break;
         }
@@ -22,6 +22,8 @@
 #include "mega.h"
 #include "mega/thread/cppthread.h"
 
+#include <functional>
+
 namespace mega {
 
 CppThread::CppThread()
@@ -39,6 +41,11 @@ void CppThread::join()
 	thread->join();
 }
 
+unsigned long long CppThread::currentid()
+{
+    return std::hash<std::thread::id>()(std::this_thread::get_id());
+}
+
 CppThread::~CppThread()
 {
 	delete thread;
@@ -77,4 +84,33 @@ CppMutex::~CppMutex()
 	delete rmutex;
 }
 
+
+CppSemaphore::CppSemaphore()
+{
+	count = 0;
+}
+
+void CppSemaphore::release()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+	count++;
+	cv.notify_one();
+}
+
+void CppSemaphore::wait()
+{
+	std::unique_lock<std::mutex> lock(mtx);
+
+	while (!count)
+	{
+		cv.wait(lock);
+	}
+
+	count--;
+}
+
+CppSemaphore::~CppSemaphore()
+{
+}
+
 } // namespace
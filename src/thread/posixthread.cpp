@@ -41,6 +41,11 @@ void PosixThread::join()
     pthread_join(*thread, NULL);
 }
 
+unsigned long long PosixThread::currentid()
+{
+    return (unsigned long long)(uintptr_t)pthread_self();
+}
+
 PosixThread::~PosixThread()
 {
     delete thread;
@@ -91,6 +96,41 @@ PosixMutex::~PosixMutex()
 }
 
 
+PosixSemaphore::PosixSemaphore()
+{
+    count = 0;
+    pthread_mutex_init(&mtx, NULL);
+    pthread_cond_init(&cv, NULL);
+}
+
+void PosixSemaphore::release()
+{
+    pthread_mutex_lock(&mtx);
+    count++;
+    pthread_cond_signal(&cv);
+    pthread_mutex_unlock(&mtx);
+}
+
+void PosixSemaphore::wait()
+{
+    pthread_mutex_lock(&mtx);
+
+    while (!count)
+    {
+        pthread_cond_wait(&cv, &mtx);
+    }
+
+    count--;
+    pthread_mutex_unlock(&mtx);
+}
+
+PosixSemaphore::~PosixSemaphore()
+{
+    pthread_cond_destroy(&cv);
+    pthread_mutex_destroy(&mtx);
+}
+
+
 } // namespace
 
 #endif
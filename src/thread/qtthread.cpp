@@ -47,6 +47,11 @@ void QtThread::join()
     this->wait();
 }
 
+unsigned long long QtThread::currentid()
+{
+    return (unsigned long long)(uintptr_t)QThread::currentThreadId();
+}
+
 QtThread::~QtThread()
 {
 
@@ -82,4 +87,25 @@ QtMutex::~QtMutex()
     delete mutex;
 }
 
+
+QtSemaphore::QtSemaphore()
+{
+    semaphore = new QSemaphore();
+}
+
+void QtSemaphore::release()
+{
+    semaphore->release();
+}
+
+void QtSemaphore::wait()
+{
+    semaphore->acquire();
+}
+
+QtSemaphore::~QtSemaphore()
+{
+    delete semaphore;
+}
+
 } // namespace
@@ -48,6 +48,11 @@ void Win32Thread::join()
 	WaitForSingleObject(hThread, INFINITE);
 }
 
+unsigned long long Win32Thread::currentid()
+{
+    return GetCurrentThreadId();
+}
+
 Win32Thread::~Win32Thread()
 {
 	CloseHandle(hThread);
@@ -79,4 +84,25 @@ Win32Mutex::~Win32Mutex()
 	DeleteCriticalSection(&mutex);
 }
 
+
+Win32Semaphore::Win32Semaphore()
+{
+    semaphore = CreateSemaphore(NULL, 0, 0x7fffffff, NULL);
+}
+
+void Win32Semaphore::release()
+{
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+void Win32Semaphore::wait()
+{
+    WaitForSingleObject(semaphore, INFINITE);
+}
+
+Win32Semaphore::~Win32Semaphore()
+{
+    CloseHandle(semaphore);
+}
+
 } // namespace
@@ -38,15 +38,35 @@ Transfer::Transfer(MegaClient* cclient, direction_t ctype)
     pos = 0;
     ctriv = 0;
     metamac = 0;
+    nopeers = false;
+    stream = NULL;
+    macpos = 0;
+    cachedpos = 0;
+    memset(filemac, 0, sizeof filemac);
     tag = 0;
     slot = NULL;
+    queuedds = Waiter::ds;
+    fileattrsmutable = 0;
+    tempurlsize = -1;
+    tempurlds = 0;
+    tempurlcmd = NULL;
     
     faputcompletion_it = client->faputcompletion.end();
 }
 
+bool Transfer::tempurlvalid() const
+{
+    return tempurl.size() && Waiter::ds - tempurlds < TEMPURLTTL && (type == GET || tempurlsize == size);
+}
+
 // delete transfer with underlying slot, notify files
 Transfer::~Transfer()
 {
+    if (tempurlcmd)
+    {
+        tempurlcmd->cancel();
+    }
+
     if (faputcompletion_it != client->faputcompletion.end())
     {
         client->faputcompletion.erase(faputcompletion_it);
@@ -67,6 +87,110 @@ Transfer::~Transfer()
     {
         delete slot;
     }
+
+    // a resumable download whose state has been retained by a closed cache
+    // table keeps its partial file for the next session
+    if (!dbid || client->tctable)
+    {
+        if (dbid)
+        {
+            client->tctable->del(dbid);
+        }
+
+        if (type == GET && macpos && localfilename.size())
+        {
+            client->fsaccess->unlinklocal(&localfilename);
+        }
+    }
+}
+
+bool Transfer::serialize(string* d)
+{
+    unsigned short ll;
+
+    d->append((char*)&type, sizeof type);
+    d->append((char*)&size, sizeof size);
+    d->append((char*)&mtime, sizeof mtime);
+    d->append((char*)crc, sizeof crc);
+
+    ll = (unsigned short)localfilename.size();
+    d->append((char*)&ll, sizeof ll);
+    d->append(localfilename.data(), ll);
+
+    d->append((char*)key.key, sizeof key.key);
+    d->append((char*)&ctriv, sizeof ctriv);
+    d->append((char*)&metamac, sizeof metamac);
+
+    d->append((char*)&macpos, sizeof macpos);
+    d->append((char*)filemac, sizeof filemac);
+
+    return true;
+}
+
+Transfer* Transfer::unserialize(MegaClient* client, string* d)
+{
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+    direction_t type;
+    unsigned short ll;
+
+    if (ptr + sizeof type + sizeof(m_off_t) + sizeof(m_time_t) + 4 * sizeof(int32_t) + sizeof ll > end)
+    {
+        return NULL;
+    }
+
+    type = MemAccess::get<direction_t>(ptr);
+    ptr += sizeof type;
+
+    if (type != GET)
+    {
+        return NULL;
+    }
+
+    Transfer* t = new Transfer(client, type);
+
+    t->size = MemAccess::get<m_off_t>(ptr);
+    ptr += sizeof t->size;
+
+    t->mtime = MemAccess::get<m_time_t>(ptr);
+    ptr += sizeof t->mtime;
+
+    memcpy(t->crc, ptr, sizeof t->crc);
+    ptr += sizeof t->crc;
+
+    t->isvalid = true;
+
+    ll = MemAccess::get<unsigned short>(ptr);
+    ptr += sizeof ll;
+
+    if (ptr + ll + SymmCipher::KEYLENGTH + sizeof t->ctriv + sizeof t->metamac
+            + sizeof t->macpos + sizeof t->filemac != end)
+    {
+        delete t;
+        return NULL;
+    }
+
+    t->localfilename.assign(ptr, ll);
+    ptr += ll;
+
+    t->key.setkey((const byte*)ptr);
+    ptr += SymmCipher::KEYLENGTH;
+
+    t->ctriv = MemAccess::get<int64_t>(ptr);
+    ptr += sizeof t->ctriv;
+
+    t->metamac = MemAccess::get<int64_t>(ptr);
+    ptr += sizeof t->metamac;
+
+    t->macpos = MemAccess::get<m_off_t>(ptr);
+    ptr += sizeof t->macpos;
+
+    memcpy(t->filemac, ptr, sizeof t->filemac);
+
+    t->cachedpos = t->macpos;
+    t->transfers_it = client->transfers[type].end();
+
+    return t;
 }
 
 // transfer attempt failed, notify all related files, collect request on
@@ -89,6 +213,13 @@ void Transfer::failed(error e)
         }
     }
 
+    // streamed data can't be read again
+    if (defer && stream && slot && slot->fa && ((StreamFileAccess*)slot->fa)->consumed)
+    {
+        LOG_debug << "Streamed upload can't be retried";
+        defer = false;
+    }
+
     if (defer)
     {
         failcount++;
@@ -168,6 +299,8 @@ void Transfer::complete()
                     symmcipher = n->nodecipher();
                 }
 
+                n->resolveattrs();
+
                 if (fingerprint.isvalid && (!n->isvalid || fixfingerprint))
                 {
                     *(FileFingerprint*)n = fingerprint;
@@ -186,7 +319,7 @@ void Transfer::complete()
         if (missingattr)
         {
             // FIXME: do this while file is still open
-            client->gfx->gendimensionsputfa(NULL, &localfilename, attachh, symmcipher, missingattr);
+            client->gfx->gendimensionsputfa(NULL, &localfilename, attachh, symmcipher, missingattr, this);
         }
 
         // ...and place it in all target locations. first, update the files'
@@ -377,6 +510,11 @@ void Transfer::complete()
             }
         }
 
+        if (tmplocalname.size())
+        {
+            client->addlocalcopy(&fingerprint, &tmplocalname);
+        }
+
         if (!tmplocalname.size() && !files.size())
         {
             client->fsaccess->unlinklocal(&localfilename);
@@ -403,8 +541,20 @@ void Transfer::complete()
     }
     else
     {
+        if (stream)
+        {
+            // the fingerprint of streamed data was computed while uploading
+            // it (the transfer keeps its placeholder, as it's a map key)
+            for (file_list::iterator it = files.begin(); it != files.end(); it++)
+            {
+                if (!((StreamFileAccess*)slot->fa)->fingerprint.get(*it))
+                {
+                    return failed(API_EREAD);
+                }
+            }
+        }
         // files must not change during a PUT transfer
-        if (genfingerprint(slot->fa, true))
+        else if (genfingerprint(slot->fa, true))
         {
             return failed(API_EREAD);
         }
@@ -441,6 +591,9 @@ DirectReadNode::DirectReadNode(MegaClient* cclient, handle ch, bool cp, SymmCiph
     size = 0;
     
     pendingcmd = NULL;
+    prefetch = NULL;
+
+    cache.setlimit(client->drcachelimit);
     
     dsdrn_it = client->dsdrns.end();
 }
@@ -498,11 +651,20 @@ void DirectReadNode::retry(error e)
     retries++;
 
     // signal failure to app , obtain minimum desired retry time
-    for (dr_list::iterator it = reads.begin(); it != reads.end(); it++)
+    for (dr_list::iterator it = reads.begin(); it != reads.end(); )
     {
-        (*it)->abort();
+        DirectRead* dr = *(it++);
 
-        retryds = client->app->pread_failure(e, retries, (*it)->appdata);
+        // the read-ahead is not retried
+        if (dr == prefetch)
+        {
+            delete dr;
+            continue;
+        }
+
+        dr->abort();
+
+        retryds = client->app->pread_failure(e, retries, dr->appdata);
 
         if (retryds < minretryds)
         {
@@ -572,80 +734,400 @@ void DirectReadNode::enqueue(m_off_t offset, m_off_t count, int reqtag, void* ap
     new DirectRead(this, count, offset, reqtag, appdata);
 }
 
-bool DirectReadSlot::doio()
+bool DirectReadNode::servecached(DirectRead* dr)
 {
-    if (req->status == REQ_INFLIGHT || req->status == REQ_SUCCESS)
+    const byte* data;
+    unsigned len;
+
+    if (dr == prefetch)
     {
-        if (req->in.size())
+        return true;
+    }
+
+    while ((data = cache.lookup(dr->offset, &len)))
+    {
+        if (dr->count && len > dr->count)
+        {
+            len = (unsigned)dr->count;
+        }
+
+        if (!client->app->pread_data((byte*)data, len, dr->offset, dr->appdata))
+        {
+            // app-requested abort
+            delete dr;
+            return false;
+        }
+
+        bool done;
+
+        dr->offset += len;
+
+        // a count of 0 reads up to the end of the node
+        if (dr->count)
+        {
+            dr->count -= len;
+            done = !dr->count;
+        }
+        else
+        {
+            done = dr->offset >= size;
+        }
+
+        if (done)
         {
-            int r, l, t;
-            byte buf[SymmCipher::BLOCKSIZE];
+            schedule(3000);
+
+            delete dr;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DirectReadNode::awaitprefetch(DirectRead* dr)
+{
+    if (!prefetch || dr == prefetch)
+    {
+        return false;
+    }
+
+    // anything before the block being assembled was cached or skipped
+    m_off_t start = prefetch->offset;
+
+    if (prefetch->drs)
+    {
+        start = prefetch->drs->blockpos < 0 ? prefetch->drs->pos : prefetch->drs->blockpos;
+    }
+
+    return dr->offset >= start && dr->offset < prefetch->offset + prefetch->count;
+}
+
+void DirectReadNode::readahead(DirectRead* dr)
+{
+    unsigned len;
+
+    if (prefetch || dr == prefetch || !cache.limit || !client->drreadahead || !dr->count)
+    {
+        return;
+    }
+
+    m_off_t end = dr->offset + dr->count;
+
+    if (end >= size || cache.lookup(end, &len))
+    {
+        return;
+    }
+
+    // start on a block boundary so that the first block can be cached
+    m_off_t start = end - end % DirectReadCache::BLOCKSIZE;
+    m_off_t count = client->drreadahead < cache.limit ? client->drreadahead : cache.limit;
+
+    if (start + count > size)
+    {
+        count = size - start;
+    }
+
+    prefetch = new DirectRead(this, count, start, dr->reqtag, NULL);
+}
+
+DirectReadCache::DirectReadCache()
+{
+    cached = 0;
+    limit = DEFAULTLIMIT;
+}
+
+void DirectReadCache::store(m_off_t pos, string* data)
+{
+    if (!limit || (m_off_t)data->size() > limit)
+    {
+        return;
+    }
+
+    block_map::iterator it = blocks.find(pos);
+
+    if (it != blocks.end())
+    {
+        cached -= it->second.data.size();
+        lru.erase(it->second.lru_it);
+    }
+    else
+    {
+        it = blocks.insert(pair<m_off_t, Block>(pos, Block())).first;
+    }
+
+    it->second.data.swap(*data);
+    it->second.lru_it = lru.insert(lru.begin(), pos);
+    cached += it->second.data.size();
+
+    evict();
+}
+
+const byte* DirectReadCache::lookup(m_off_t pos, unsigned* len)
+{
+    block_map::iterator it = blocks.find(pos - pos % BLOCKSIZE);
+
+    if (it == blocks.end() || pos - it->first >= (m_off_t)it->second.data.size())
+    {
+        return NULL;
+    }
+
+    lru.splice(lru.begin(), lru, it->second.lru_it);
+
+    *len = (unsigned)(it->second.data.size() - (pos - it->first));
+
+    return (const byte*)it->second.data.data() + (pos - it->first);
+}
+
+void DirectReadCache::setlimit(m_off_t newlimit)
+{
+    limit = newlimit < 0 ? 0 : newlimit;
+    evict();
+}
+
+void DirectReadCache::evict()
+{
+    while (cached > limit && lru.size())
+    {
+        block_map::iterator it = blocks.find(lru.back());
+
+        cached -= it->second.data.size();
+        blocks.erase(it);
+        lru.pop_back();
+    }
+}
+
+void DirectReadCache::clear()
+{
+    blocks.clear();
+    lru.clear();
+    cached = 0;
+}
+
+// collect the decrypted stream into cache blocks - the partial block at the
+// start of an unaligned range is skipped
+void DirectReadSlot::cachedata(const byte* data, unsigned len)
+{
+    DirectReadCache* cache = &dr->drn->cache;
+    m_off_t p = pos;
+
+    if (!cache->limit)
+    {
+        return;
+    }
+
+    while (len)
+    {
+        m_off_t blockstart = p - p % DirectReadCache::BLOCKSIZE;
+        unsigned n = (unsigned)(blockstart + DirectReadCache::BLOCKSIZE - p);
+
+        if (n > len)
+        {
+            n = len;
+        }
+
+        if (p == blockstart)
+        {
+            block.clear();
+            blockpos = blockstart;
+        }
+
+        if (blockpos == blockstart)
+        {
+            block.append((const char*)data, n);
+
+            if (block.size() == DirectReadCache::BLOCKSIZE
+             || blockstart + (m_off_t)block.size() == dr->drn->size)
+            {
+                cache->store(blockstart, &block);
+                block.clear();
+                blockpos = -1;
+            }
+        }
 
-            // decrypt, pass to app and erase
-            r = pos & (sizeof buf - 1);
-            t = req->in.size();
+        p += n;
+        data += n;
+        len -= n;
+    }
+}
 
+bool DirectReadSlot::doio()
+{
+    for (;;)
+    {
+        if (dr->paused)
+        {
+            // the data waits in the requests, which stop receiving once
+            // PAUSEBUFFER is buffered - the tempurl stays in use
             dr->drn->schedule(1800);
+            break;
+        }
+
+        MegaClient* client = dr->drn->client;
+        string* buffer = NULL;
+
+        // the network thread may still be receiving into the request: the
+        // received data is taken over (receiving continues into a recycled
+        // buffer) together with the status, under the I/O lock
+        client->httpio->lock();
 
-            if (r)
+        reqstatus_t status = req->status;
+
+        if ((status == REQ_INFLIGHT || status == REQ_SUCCESS) && req->in.size())
+        {
+            buffer = client->getreadbuffer();
+            buffer->swap(req->in);
+
+            req->contentlength -= buffer->size();
+            req->bufpos = 0;
+        }
+
+        client->httpio->unlock();
+
+        if (status == REQ_INFLIGHT || status == REQ_SUCCESS)
+        {
+            if (buffer)
             {
-                l = sizeof buf - r;
+                int r, l, t;
+                byte buf[SymmCipher::BLOCKSIZE];
+
+                // decrypt, pass to app and erase
+                r = pos & (sizeof buf - 1);
+                t = buffer->size();
+
+                dr->drn->schedule(1800);
 
-                if (l > t)
+                if (r)
                 {
-                    l = t;
+                    l = sizeof buf - r;
+
+                    if (l > t)
+                    {
+                        l = t;
+                    }
+
+                    memcpy(buf + r, buffer->data(), l);
+                    dr->drn->symmcipher.ctr_crypt(buf, sizeof buf, pos - r, dr->drn->ctriv, NULL, false);
+                    memcpy((char*)buffer->data(), buf + r, l);
+                }
+                else
+                {
+                    l = 0;
                 }
 
-                memcpy(buf + r, req->in.data(), l);
-                dr->drn->symmcipher.ctr_crypt(buf, sizeof buf, pos - r, dr->drn->ctriv, NULL, false);
-                memcpy((char*)req->in.data(), buf + r, l);
-            }
-            else
-            {
-                l = 0;
-            }
+                if (t > l)
+                {
+                    r = (l - t) & (sizeof buf - 1);
+                    buffer->resize(t + r);
+                    dr->drn->symmcipher.ctr_crypt((byte*)buffer->data() + l, buffer->size() - l, pos + l, dr->drn->ctriv, NULL, false);
+                }
 
-            if (t > l)
-            {
-                r = (l - t) & (sizeof buf - 1);
-                req->in.resize(t + r);
-                dr->drn->symmcipher.ctr_crypt((byte*)req->in.data() + l, req->in.size() - l, pos + l, dr->drn->ctriv, NULL, false);
-            }
+                cachedata((const byte*)buffer->data(), t);
 
-            if (dr->drn->client->app->pread_data((byte*)req->in.data(), t, pos, dr->appdata))
-            {
-                pos += t;
+                bool proceed = true;
+
+                // the read-ahead only feeds the cache
+                if (dr != dr->drn->prefetch)
+                {
+                    proceed = client->app->pread_buffer(&buffer, t, pos, dr->appdata);
+                }
 
-                req->in.clear();
-                req->contentlength -= t;
-                req->bufpos = 0;               
+                if (buffer)
+                {
+                    client->releasereadbuffer(buffer);
+                }
+
+                if (proceed)
+                {
+                    pos += t;
+                    windowbytes += t;
+                    qosbytes += t;
+                }
+                else
+                {
+                    // app-requested abort
+                    delete dr;
+                    return false;
+                }
             }
-            else
+
+            if (status == REQ_SUCCESS)
             {
-                // app-requested abort
-                delete dr;
-                return false;
+                if (!ahead.size() && (rangeend < 0 || reqend >= rangeend))
+                {
+                    dr->drn->schedule(3000);
+
+                    // remove and delete completed read request, then remove slot
+                    delete dr;
+                    return true;
+                }
+
+                // the next piece takes over, with the data it already received
+                delete req;
+
+                if (!ahead.size())
+                {
+                    topup();
+                }
+
+                req = ahead.front();
+                ahead.pop_front();
+
+                // delivered as it arrives from now on
+                dr->drn->client->inflight.release(PIECESIZE);
+                reserved -= PIECESIZE;
+                continue;
             }
         }
 
-        if (req->status == REQ_SUCCESS)
-        {
-            dr->drn->schedule(3000);
+        break;
+    }
 
-            // remove and delete completed read request, then remove slot
-            delete dr;
-            return true;
+    bool failed = req->status == REQ_FAILURE;
+
+    for (unsigned i = 0; i < ahead.size() && !failed; i++)
+    {
+        failed = ahead[i]->status == REQ_FAILURE;
+    }
+
+    if (!failed)
+    {
+        if (!dr->paused)
+        {
+            topup();
+            adaptfanout();
+            qoscheck();
         }
+
+        return false;
     }
-    else if (req->status == REQ_FAILURE)
+
+    if (dr == dr->drn->prefetch)
     {
-        // a failure triggers a complete abort and retry of all pending reads for this node
-        dr->drn->retry(API_EREAD);
+        // a failed read-ahead is just dropped
+        delete dr;
+        return true;
     }
 
+    // a failure triggers a complete abort and retry of all pending reads for this node
+    dr->drn->retry(API_EREAD);
+
     return false;
 }
 
+void DirectRead::pause(bool p)
+{
+    if (paused != p)
+    {
+        paused = p;
+
+        if (drs)
+        {
+            drs->setpaused();
+        }
+    }
+}
+
 // abort active read, remove from pending queue
 void DirectRead::abort()
 {
@@ -667,6 +1149,7 @@ DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, in
     offset = coffset;
     reqtag = creqtag;
     appdata = cappdata;
+    paused = false;
 
     drs = NULL;
 
@@ -688,6 +1171,11 @@ DirectRead::~DirectRead()
 {
     abort();
 
+    if (drn->prefetch == this)
+    {
+        drn->prefetch = NULL;
+    }
+
     if (reads_it != drn->reads.end())
     {
         drn->reads.erase(reads_it);
@@ -697,34 +1185,218 @@ DirectRead::~DirectRead()
 // request DirectRead's range via tempurl
 DirectReadSlot::DirectReadSlot(DirectRead* cdr)
 {
-    char buf[128];
-
     dr = cdr;
 
     pos = dr->offset;
+    blockpos = -1;
 
-    req = new HttpReq(true);
+    fanout = MINFANOUT;
+    windowstart = Waiter::ds;
+    windowbytes = 0;
+    lastthroughput = 0;
+    lastadjust = 0;
 
-    sprintf(buf,"/%" PRIu64 "-", dr->offset);
+    qosstart = Waiter::ds;
+    qosbytes = 0;
+    starved = false;
 
-    if (dr->count)
+    reserved = PAUSEBUFFER;
+
+    rangeend = dr->count ? dr->offset + dr->count : -1;
+
+    if (dr->count > SPLITSIZE)
+    {
+        // large read: fetch it in pieces over several connections
+        reqend = dr->offset + PIECESIZE;
+        req = request(dr->offset, reqend);
+        topup();
+    }
+    else
     {
-        sprintf(strchr(buf, 0), "%" PRIu64, dr->offset + dr->count - 1);
+        reqend = rangeend;
+        req = request(dr->offset, rangeend);
     }
 
-    req->posturl = dr->drn->tempurl;
-    req->posturl.append(buf);
-    req->type = REQ_BINARY;
+    drs_it = dr->drn->client->drss.insert(dr->drn->client->drss.end(), this);
+}
+
+HttpReq* DirectReadSlot::request(m_off_t start, m_off_t end)
+{
+    char buf[128];
+    HttpReq* r = new HttpReq(true);
 
-    req->post(dr->drn->client);
+    sprintf(buf,"/%" PRIu64 "-", start);
 
-    drs_it = dr->drn->client->drss.insert(dr->drn->client->drss.end(), this);
+    if (end >= 0)
+    {
+        sprintf(strchr(buf, 0), "%" PRIu64, end - 1);
+    }
+
+    r->posturl = dr->drn->tempurl;
+    r->posturl.append(buf);
+    r->type = REQ_BINARY;
+    r->maxbuffered = dr->paused ? PAUSEBUFFER : 0;
+
+    r->post(dr->drn->client);
+
+    return r;
+}
+
+void DirectReadSlot::setpaused()
+{
+    HttpIO* httpio = dr->drn->client->httpio;
+    m_off_t limit = dr->paused ? PAUSEBUFFER : 0;
+
+    // (the limit is checked by the network thread)
+    httpio->lock();
+
+    for (int i = -1; i < (int)ahead.size(); i++)
+    {
+        HttpReq* r = (i < 0) ? req : ahead[i];
+
+        r->maxbuffered = limit;
+
+        if (!limit)
+        {
+            httpio->resumereceive(r);
+        }
+    }
+
+    httpio->unlock();
+
+    // the pause doesn't count as slow throughput
+    windowbytes = 0;
+    windowstart = Waiter::ds;
+
+    // nor does it starve the read
+    qosbytes = 0;
+    qosstart = Waiter::ds;
+    setstarved(false);
+}
+
+void DirectReadSlot::qoscheck()
+{
+    BandwidthShaper* bandwidth = &dr->drn->client->bandwidth;
+
+    // the read-ahead is no streaming read
+    if (!bandwidth->streamingrate || dr == dr->drn->prefetch)
+    {
+        setstarved(false);
+        return;
+    }
+
+    dstime elapsed = Waiter::ds - qosstart;
+
+    if (elapsed < ADAPTWINDOW)
+    {
+        return;
+    }
+
+    setstarved(qosbytes * 10 / elapsed < bandwidth->streamingrate);
+    bandwidth->streamwindow(starved, dr->drn->client->scheduler.rate(GET));
+
+    qosbytes = 0;
+    qosstart = Waiter::ds;
+}
+
+void DirectReadSlot::setstarved(bool s)
+{
+    if (s != starved)
+    {
+        starved = s;
+        dr->drn->client->bandwidth.starvedstreams += s ? 1 : -1;
+
+        LOG_debug << "Streaming read " << (s ? "below" : "back at") << " its guaranteed rate, "
+                  << dr->drn->client->bandwidth.starvedstreams << " starved";
+    }
+}
+
+void DirectReadSlot::topup()
+{
+    MegaClient* client = dr->drn->client;
+
+    while (rangeend >= 0 && reqend < rangeend && (int)ahead.size() + 1 < fanout
+           && client->inflight.reserve(PIECESIZE))
+    {
+        m_off_t end = reqend + PIECESIZE;
+
+        reserved += PIECESIZE;
+
+        if (end > rangeend)
+        {
+            end = rangeend;
+        }
+
+        ahead.push_back(request(reqend, end));
+        reqend = end;
+    }
+}
+
+void DirectReadSlot::adaptfanout()
+{
+    dstime elapsed = Waiter::ds - windowstart;
+
+    if (rangeend < 0 || reqend >= rangeend || elapsed < ADAPTWINDOW)
+    {
+        return;
+    }
+
+    m_off_t throughput = windowbytes * 10 / elapsed;
+    int adjust;
+
+    if (!lastthroughput)
+    {
+        adjust = 1;
+    }
+    else if (throughput > lastthroughput + lastthroughput / 10)
+    {
+        adjust = lastadjust ? lastadjust : 1;
+    }
+    else if (throughput < lastthroughput - lastthroughput / 10)
+    {
+        adjust = lastadjust ? -lastadjust : -1;
+    }
+    else
+    {
+        adjust = 0;
+    }
+
+    int n = fanout + adjust;
+
+    if (n < MINFANOUT)
+    {
+        n = MINFANOUT;
+    }
+
+    if (n > MAXFANOUT)
+    {
+        n = MAXFANOUT;
+    }
+
+    if (n != fanout)
+    {
+        LOG_debug << "Direct read fan-out: " << fanout << " -> " << n << " (" << throughput << " B/s)";
+    }
+
+    lastadjust = n - fanout;
+    lastthroughput = throughput;
+    fanout = n;
+
+    windowbytes = 0;
+    windowstart = Waiter::ds;
 }
 
 DirectReadSlot::~DirectReadSlot()
 {
+    setstarved(false);
     dr->drn->client->drss.erase(drs_it);
+    dr->drn->client->inflight.release(reserved);
 
     delete req;
+
+    for (unsigned i = 0; i < ahead.size(); i++)
+    {
+        delete ahead[i];
+    }
 }
 } // namespace
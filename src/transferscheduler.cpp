@@ -0,0 +1,408 @@
+/**
+ * @file transferscheduler.cpp
+ * @brief Transfer queue dispatch policies and pipeline admission control
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/transferscheduler.h"
+#include "mega/megaclient.h"
+#include "mega/transfer.h"
+#include "mega/transferslot.h"
+#include "mega/file.h"
+#include "mega/logging.h"
+
+namespace mega {
+bool ShortestFirstTransferPolicy::precedes(Transfer* a, Transfer* b)
+{
+    return a->size - a->pos < b->size - b->pos;
+}
+
+bool PriorityTransferPolicy::precedes(Transfer* a, Transfer* b)
+{
+    return TransferScheduler::priority(a) > TransferScheduler::priority(b);
+}
+
+// count the active transfers of each fair share group
+void FairShareTransferPolicy::prepare(MegaClient* client, direction_t d)
+{
+    active.clear();
+
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+    {
+        if ((*it)->transfer->type == d)
+        {
+            active[TransferScheduler::owner((*it)->transfer)]++;
+        }
+    }
+}
+
+bool FairShareTransferPolicy::precedes(Transfer* a, Transfer* b)
+{
+    map<int, int>::iterator it;
+    int na = (it = active.find(TransferScheduler::owner(a))) == active.end() ? 0 : it->second;
+    int nb = (it = active.find(TransferScheduler::owner(b))) == active.end() ? 0 : it->second;
+
+    return na < nb;
+}
+
+bool RecentFirstTransferPolicy::precedes(Transfer* a, Transfer* b)
+{
+    return a->mtime > b->mtime;
+}
+
+void AgingTransferPolicy::prepare(MegaClient*, direction_t)
+{
+    now = Waiter::ds;
+}
+
+m_off_t AgingTransferPolicy::weight(Transfer* t) const
+{
+    return (t->size - t->pos) / ((now - t->queuedds) / AGINGDS + 1);
+}
+
+bool AgingTransferPolicy::precedes(Transfer* a, Transfer* b)
+{
+    return weight(a) < weight(b);
+}
+
+TransferScheduler::TransferScheduler()
+{
+    client = NULL;
+    policy = &defaultpolicy;
+
+    for (int d = 2; d--; )
+    {
+        maxactive[d] = MINACTIVE;
+        windowbytes[d] = 0;
+        windowstart[d] = Waiter::ds;
+        lastrate[d] = 0;
+        currentrate[d] = 0;
+        limited[d] = false;
+        lastadjust[d] = 0;
+        largeslots[d] = 0;
+        largesize[d] = 0;
+    }
+}
+
+void TransferScheduler::setpolicy(policy_t p)
+{
+    switch (p)
+    {
+        case POLICY_SHORTESTFIRST:
+            policy = &shortestfirstpolicy;
+            break;
+
+        case POLICY_PRIORITY:
+            policy = &prioritypolicy;
+            break;
+
+        case POLICY_FAIRSHARE:
+            policy = &fairsharepolicy;
+            break;
+
+        case POLICY_RECENTFIRST:
+            policy = &recentfirstpolicy;
+            break;
+
+        case POLICY_AGING:
+            policy = &agingpolicy;
+            break;
+
+        default:
+            policy = &defaultpolicy;
+    }
+}
+
+void TransferScheduler::setpolicy(TransferPolicy* p)
+{
+    policy = p ? p : &defaultpolicy;
+}
+
+void TransferScheduler::setlargeslots(direction_t d, unsigned slots, m_off_t size)
+{
+    largeslots[d] = slots;
+    largesize[d] = size < 0 ? 0 : size;
+}
+
+int TransferScheduler::priority(Transfer* t)
+{
+    int p = 0;
+
+    for (file_list::iterator it = t->files.begin(); it != t->files.end(); it++)
+    {
+        if (it == t->files.begin() || (*it)->priority > p)
+        {
+            p = (*it)->priority;
+        }
+    }
+
+    return p;
+}
+
+int TransferScheduler::owner(Transfer* t)
+{
+    return t->files.size() ? t->files.front()->owner : 0;
+}
+
+// select the queued, non-deferred transfer that precedes all others under the
+// current policy (ties are resolved in transfer queue order) - large
+// transfers are skipped while all large slots are taken
+Transfer* TransferScheduler::next(direction_t d, int lanes)
+{
+    Transfer* best = NULL;
+    bool largeavail = true;
+
+    if (largeslots[d])
+    {
+        unsigned large = 0;
+
+        for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+        {
+            if ((*it)->transfer->type == d && (*it)->transfer->size >= largesize[d])
+            {
+                large++;
+            }
+        }
+
+        largeavail = large < largeslots[d];
+    }
+
+    policy->prepare(client, d);
+
+    for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
+    {
+        if (!it->second->slot && it->second->bt.armed()
+         && (lanes & (MegaClient::smallupload(it->second) ? LANE_SMALL : LANE_REGULAR))
+         && (largeavail || it->second->size < largesize[d])
+         && (!best || policy->precedes(it->second, best)))
+        {
+            best = it->second;
+        }
+    }
+
+    return best;
+}
+
+void TransferScheduler::upcoming(direction_t d, unsigned n, transfer_vector* v)
+{
+    v->clear();
+
+    if (!n)
+    {
+        return;
+    }
+
+    policy->prepare(client, d);
+
+    // insertion into the n best so far
+    for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
+    {
+        if (!it->second->slot && it->second->bt.armed())
+        {
+            transfer_vector::iterator vit = v->begin();
+
+            while (vit != v->end() && !policy->precedes(it->second, *vit))
+            {
+                vit++;
+            }
+
+            if (vit != v->end() || v->size() < n)
+            {
+                v->insert(vit, it->second);
+
+                if (v->size() > n)
+                {
+                    v->pop_back();
+                }
+            }
+        }
+    }
+}
+
+void TransferScheduler::addbytes(direction_t d, m_off_t n)
+{
+    windowbytes[d] += n;
+}
+
+// close the current sampling window and adapt the active transfer limit:
+// while the limit was binding, keep raising it as long as the aggregate
+// throughput improves, and reverse once it degrades
+void TransferScheduler::sample(direction_t d)
+{
+    dstime elapsed = Waiter::ds - windowstart[d];
+
+    if (elapsed < SAMPLEWINDOW)
+    {
+        return;
+    }
+
+    m_off_t r = windowbytes[d] > 0 ? windowbytes[d] * 10 / elapsed : 0;
+
+    if (r && limited[d])
+    {
+        int adjust;
+
+        if (!lastrate[d] || r > lastrate[d] + lastrate[d] / 10)
+        {
+            adjust = lastadjust[d] >= 0 ? 1 : -1;
+        }
+        else if (r < lastrate[d] - lastrate[d] / 10)
+        {
+            adjust = lastadjust[d] > 0 ? -1 : 1;
+        }
+        else
+        {
+            adjust = 0;
+        }
+
+        unsigned n = maxactive[d] + adjust;
+
+        if (n < MINACTIVE)
+        {
+            n = MINACTIVE;
+        }
+        else if (n > MegaClient::MAXTRANSFERS)
+        {
+            n = MegaClient::MAXTRANSFERS;
+        }
+
+        if (n != maxactive[d])
+        {
+            LOG_debug << "Active " << (d == GET ? "download" : "upload") << " transfer limit: "
+                      << maxactive[d] << " -> " << n << " (" << r << " B/s)";
+        }
+
+        lastadjust[d] = (int)n - (int)maxactive[d];
+        maxactive[d] = n;
+    }
+
+    if (r)
+    {
+        lastrate[d] = r;
+    }
+
+    currentrate[d] = r;
+    windowbytes[d] = 0;
+    windowstart[d] = Waiter::ds;
+    limited[d] = false;
+}
+
+// returns true if more transfers of the requested type should be dispatched
+// (back-to-back overlap pipelining)
+bool TransferScheduler::more(direction_t d)
+{
+    m_off_t r = 0;
+    unsigned total = 0;
+
+    // don't dispatch if all tslots busy
+    if (!client->slotavail())
+    {
+        return false;
+    }
+
+    sample(d);
+
+    // determine total amount of data remaining for the given direction
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+    {
+        if ((*it)->transfer->type == d && !(*it)->smallfile)
+        {
+            r += (*it)->transfer->size - (*it)->progressreported;
+            total++;
+        }
+    }
+
+    // always blindly dispatch transfers up to MINPIPELINE
+    if (r < MegaClient::MINPIPELINE)
+    {
+        return true;
+    }
+
+    if (total < maxactive[d])
+    {
+        return true;
+    }
+
+    if (client->transfers[d].size() > total)
+    {
+        limited[d] = true;
+    }
+
+    // dispatch more if the active transfers are about to finish
+    if (currentrate[d] > 0 && r * 10 / currentrate[d] < LOOKAHEAD)
+    {
+        return true;
+    }
+
+    return false;
+}
+
+unsigned TransferScheduler::active(direction_t d) const
+{
+    unsigned n = 0;
+
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+    {
+        if ((*it)->transfer->type == d)
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+unsigned TransferScheduler::queued(direction_t d) const
+{
+    return client->transfers[d].size() - active(d);
+}
+
+int TransferScheduler::slotutilisation() const
+{
+    size_t regular = client->tslots.size() > client->smalluploads ? client->tslots.size() - client->smalluploads : 0;
+
+    return (int)(regular * 100 / MegaClient::MAXTRANSFERS);
+}
+
+int TransferScheduler::connectionutilisation() const
+{
+    int busy = 0, total = 0;
+
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+    {
+        for (int i = (*it)->connections; i--; )
+        {
+            HttpReqXfer* req = (*it)->reqs[i];
+
+            if (req && (req->status == REQ_INFLIGHT || req->status == REQ_PREPARED))
+            {
+                busy++;
+            }
+        }
+
+        total += (*it)->targetconnections;
+    }
+
+    return total ? busy * 100 / total : 0;
+}
+
+m_off_t TransferScheduler::rate(direction_t d) const
+{
+    return currentrate[d];
+}
+} // namespace
@@ -38,8 +38,18 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     lastdata = Waiter::ds;
     errorcount = 0;
 
+    raceconn[0] = -1;
+    raceconn[1] = -1;
+    racereqs = 0;
+    raceover = false;
+
+    peerhandle = UNDEF;
+    peerused = false;
+
     failure = false;
     retrying = false;
+    dirty = true;
+    lastio = 0;
     
     fileattrsmutable = 0;
 
@@ -49,12 +59,30 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     transfer = ctransfer;
     transfer->slot = this;
 
+    if ((smallfile = MegaClient::smallupload(transfer)))
+    {
+        transfer->client->smalluploads++;
+    }
+
     connections = transfer->size > 131072 ? transfer->client->connections[transfer->type] : 1;
+    targetconnections = connections;
 
     reqs = new HttpReqXfer*[connections]();
 
+    windowbytes = 0;
+    windowchunks = 0;
+    windowstart = Waiter::ds;
+    windowlatency = 0;
+    windowfailures = 0;
+    lastthroughput = 0;
+    lastlatency = 0;
+    lastadjust = 0;
+
     fa = transfer->client->fsaccess->newfileaccess();
 
+    famutex = NULL;
+    asyncjobs = 0;
+
     slots_it = transfer->client->tslots.end();
 }
 
@@ -64,6 +92,11 @@ TransferSlot::~TransferSlot()
 {
     transfer->slot = NULL;
 
+    if (smallfile)
+    {
+        transfer->client->smalluploads--;
+    }
+
     if (slots_it != transfer->client->tslots.end())
     {
         // advance main loop iterator if deleting next in line
@@ -80,11 +113,40 @@ TransferSlot::~TransferSlot()
         pendingcmd->cancel();
     }
 
+    // background jobs must not outlive the buffers and the file they use
+    for (int i = connections; i-- && asyncjobs; )
+    {
+        if (reqs[i] && reqs[i]->status == REQ_ASYNCIO)
+        {
+            HttpReqDL* dl = (HttpReqDL*)reqs[i];
+
+            if (dl->job)
+            {
+                transfer->client->workerpool->waitfor(dl->job);
+                delete dl->job;
+                dl->job = NULL;
+            }
+            else
+            {
+                fa->asyncwait(dl->asyncio);
+                delete dl->asyncio;
+                dl->asyncio = NULL;
+            }
+
+            asyncjobs--;
+        }
+    }
+
+    flushreadahead();
+
+    delete famutex;
+
     if (fa)
     {
         delete fa;
 
-        if ((transfer->type == GET) && transfer->localfilename.size())
+        // partial downloads are kept for resumption (see ~Transfer)
+        if ((transfer->type == GET) && transfer->localfilename.size() && !transfer->macpos)
         {
             transfer->client->fsaccess->unlinklocal(&transfer->localfilename);
         }
@@ -121,6 +183,41 @@ void TransferSlot::toggleport(HttpReqXfer *req)
     }
 }
 
+bool TransferSlot::racing(int i)
+{
+    return racereqs == 2 && !raceover && (i == raceconn[0] || i == raceconn[1]);
+}
+
+void TransferSlot::finishrace(MegaClient* client, int i, bool succeeded)
+{
+    int port = i == raceconn[1];
+    int winner = succeeded ? port : !port;
+
+    raceover = true;
+
+    if (succeeded)
+    {
+        // the competitor may have been slowed by a larger chunk - compare
+        // throughputs
+        HttpReqXfer* other = reqs[raceconn[!port]];
+
+        if (other && other->status == REQ_INFLIGHT)
+        {
+            int64_t now = Waiter::us();
+            int64_t t = now - reqs[i]->timeline.posted;
+            int64_t othert = now - other->timeline.posted;
+
+            if (t > 0 && othert > 0 && other->transferred(client) * t > reqs[i]->size * othert)
+            {
+                winner = !port;
+            }
+        }
+    }
+
+    LOG_debug << "Storage port race won by the " << (winner ? "alternative" : "default") << " port";
+    client->setaltportpreference(&tempurl, winner);
+}
+
 // abort all HTTP connections
 void TransferSlot::disconnect()
 {
@@ -131,20 +228,269 @@ void TransferSlot::disconnect()
             reqs[i]->disconnect();
         }
     }
+
+    dirty = true;
+}
+
+// change the number of parallel connections - new connections are allocated
+// immediately, surplus ones are released once their current chunk is done
+void TransferSlot::setconnections(int n)
+{
+    if (n > connections)
+    {
+        HttpReqXfer** newreqs = new HttpReqXfer*[n]();
+
+        memcpy(newreqs, reqs, connections * sizeof *reqs);
+        delete[] reqs;
+
+        reqs = newreqs;
+        connections = n;
+    }
+
+    targetconnections = n;
+    dirty = true;
+
+    trimconnections();
+}
+
+void TransferSlot::trimconnections()
+{
+    while (connections > targetconnections)
+    {
+        HttpReqXfer* req = reqs[connections - 1];
+
+        if (req && req->status != REQ_READY && req->status != REQ_DONE)
+        {
+            break;
+        }
+
+        delete req;
+        reqs[--connections] = NULL;
+    }
+}
+
+// hill-climbing adjustment of the number of connections: keep moving in the
+// same direction while the aggregate throughput improves, reverse when it
+// degrades, and back off on chunk failures or on rising per-chunk latency
+void TransferSlot::adaptconnections(MegaClient* client)
+{
+    trimconnections();
+
+    if (transfer->size <= 131072)
+    {
+        return;
+    }
+
+    int minc = client->minconnections[transfer->type];
+    int maxc = client->maxconnections[transfer->type];
+
+    // at least one connection per interface
+    if (minc < (int)client->netifs.size())
+    {
+        minc = (int)client->netifs.size() < maxc ? (int)client->netifs.size() : maxc;
+    }
+
+    dstime elapsed = Waiter::ds - windowstart;
+
+    if (elapsed < ADAPTWINDOW || (windowchunks < targetconnections && !windowfailures))
+    {
+        return;
+    }
+
+    m_off_t throughput = windowbytes * 10 / (elapsed ? elapsed : 1);
+    dstime latency = windowchunks ? windowlatency / windowchunks : 0;
+    int adjust;
+
+    if (windowfailures)
+    {
+        adjust = -1;
+    }
+    else if (!lastthroughput)
+    {
+        adjust = 1;
+    }
+    else if (throughput > lastthroughput + lastthroughput / 10)
+    {
+        adjust = lastadjust ? lastadjust : 1;
+    }
+    else if (throughput < lastthroughput - lastthroughput / 10)
+    {
+        adjust = lastadjust ? -lastadjust : -1;
+    }
+    else
+    {
+        // no gain: if the last added connection only increased latency,
+        // withdraw it
+        adjust = (lastadjust > 0 && latency > lastlatency + lastlatency / 2) ? -1 : 0;
+    }
+
+    int n = targetconnections + adjust;
+
+    if (n < minc)
+    {
+        n = minc;
+    }
+
+    if (n > maxc)
+    {
+        n = maxc;
+    }
+
+    if (n != targetconnections)
+    {
+        LOG_debug << "Transfer connections: " << targetconnections << " -> " << n
+                  << " (" << throughput << " B/s, " << throughput / targetconnections
+                  << " B/s per connection, " << latency << " ds per chunk, "
+                  << windowfailures << " failures)";
+    }
+
+    lastadjust = n - targetconnections;
+    lastthroughput = throughput;
+    lastlatency = latency;
+
+    windowbytes = 0;
+    windowchunks = 0;
+    windowlatency = 0;
+    windowfailures = 0;
+    windowstart = Waiter::ds;
+
+    if (n != targetconnections)
+    {
+        setconnections(n);
+    }
+}
+
+m_off_t TransferSlot::requestend(MegaClient* client, m_off_t pos)
+{
+    m_off_t npos = ChunkedHash::chunkceil(pos);
+    m_off_t maxsize = client->maxrequestsize[transfer->type];
+
+    // optionally coalesce contiguous chunks into a single request
+    while (npos < transfer->size)
+    {
+        m_off_t nnpos = ChunkedHash::chunkceil(npos);
+
+        if (nnpos - pos > maxsize)
+        {
+            break;
+        }
+
+        npos = nnpos;
+    }
+
+    if (npos > transfer->size)
+    {
+        npos = transfer->size;
+    }
+
+    return npos;
+}
+
+void TransferSlot::prefetch(MegaClient* client)
+{
+    if (!famutex)
+    {
+        famutex = client->workerpool->newmutex();
+    }
+
+    while ((int)readahead.size() < targetconnections && transfer->pos < transfer->size)
+    {
+        m_off_t npos = requestend(client, transfer->pos);
+        MemoryReservation reservation;
+
+        // read ahead only as far as the in-flight budget allows
+        if (!reservation.reserve(&client->inflight, npos - transfer->pos))
+        {
+            break;
+        }
+
+        HttpReqULJob* job = new HttpReqULJob(fa, famutex, &transfer->key, transfer->ctriv,
+                                             transfer->pos, npos, &client->bufferpool);
+        job->reservation.take(&reservation);
+
+        readahead.push_back(job);
+        client->workerpool->push(job);
+
+        transfer->pos = npos;
+    }
+}
+
+// drop all read-ahead requests and rewind to the first of them
+void TransferSlot::flushreadahead()
+{
+    if (readahead.size())
+    {
+        transfer->pos = readahead.front()->pos;
+    }
+
+    while (readahead.size())
+    {
+        transfer->client->workerpool->waitfor(readahead.front());
+        delete readahead.front();
+        readahead.pop_front();
+    }
+}
+
+int TransferSlot::inflightrequests()
+{
+    int count = 0;
+
+    for (int i = connections; i--; )
+    {
+        if (reqs[i] && reqs[i]->status == REQ_INFLIGHT)
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+void TransferSlot::recordtimings(MegaClient* client, HttpReqXfer* req)
+{
+    int64_t done = Waiter::us();
+
+    transfer->timings.record(transfer->type, req->size, &req->timeline, req->cryptous, req->diskus, done);
+    client->chunktimings[transfer->type].record(transfer->type, req->size, &req->timeline,
+                                                req->cryptous, req->diskus, done);
+}
+
+// fold in-order chunk MACs into the file MAC as soon as they are available,
+// so that only the out-of-order tail needs to be kept
+void TransferSlot::foldmacs()
+{
+    chunkmac_map::iterator it;
+
+    while (transfer->macpos < transfer->size
+           && (it = transfer->chunkmacs.find(transfer->macpos)) != transfer->chunkmacs.end())
+    {
+        SymmCipher::xorblock(it->second.mac, transfer->filemac);
+        transfer->key.ecb_encrypt(transfer->filemac);
+
+        transfer->chunkmacs.erase(it);
+        transfer->macpos = ChunkedHash::chunkceil(transfer->macpos);
+    }
 }
 
 // coalesce block macs into file mac
-int64_t TransferSlot::macsmac(chunkmac_map* macs)
+int64_t TransferSlot::macsmac()
 {
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    byte mac[SymmCipher::BLOCKSIZE];
+
+    foldmacs();
+
+    memcpy(mac, transfer->filemac, sizeof mac);
 
-    for (chunkmac_map::iterator it = macs->begin(); it != macs->end(); it++)
+    // not normally any left over (gaps would fail the meta MAC check anyway)
+    for (chunkmac_map::iterator it = transfer->chunkmacs.begin(); it != transfer->chunkmacs.end(); it++)
     {
         SymmCipher::xorblock(it->second.mac, mac);
         transfer->key.ecb_encrypt(mac);
     }
 
-    macs->clear();
+    transfer->chunkmacs.clear();
+    transfer->macpos = 0;
+    memset(transfer->filemac, 0, sizeof transfer->filemac);
 
     uint32_t* m = (uint32_t*)mac;
 
@@ -154,6 +500,21 @@ int64_t TransferSlot::macsmac(chunkmac_map* macs)
     return MemAccess::get<int64_t>((const char*)mac);
 }
 
+error TransferSlot::badmac(MegaClient* client)
+{
+    if (!peerused)
+    {
+        return API_EKEY;
+    }
+
+    LOG_warn << "MAC mismatch of a download with chunks from a LAN peer, retrying without peers";
+
+    client->droppeer(peerhandle);
+    transfer->nopeers = true;
+
+    return API_EAGAIN;
+}
+
 // file transfer state machine
 void TransferSlot::doio(MegaClient* client)
 {
@@ -173,6 +534,9 @@ void TransferSlot::doio(MegaClient* client)
         return;
     }
 
+    dirty = false;
+    lastio = Waiter::ds;
+
     time_t backoff = 0;
     m_off_t p = 0;
 
@@ -181,6 +545,23 @@ void TransferSlot::doio(MegaClient* client)
         return transfer->failed(API_EFAILED);
     }
 
+    // uploads are read and encrypted ahead by the worker pool, if available
+    // (streams are read in order, by the engine thread)
+    bool pipelined = transfer->type == PUT && client->workerpool && transfer->size && !transfer->stream;
+
+    // no new chunk requests to a storage server with an open circuit
+    dstime hostretry = 0;
+    bool hostdown = !client->storagehostavailable(&tempurl, &hostretry);
+
+    if (pipelined)
+    {
+        prefetch(client);
+    }
+
+    // downloads yield to starved streaming reads with a single connection
+    bool yielding = transfer->type == GET && client->bandwidth.bulkbackoff();
+    int maxreqs = yielding ? 1 : targetconnections;
+
     for (int i = connections; i--; )
     {
         if (reqs[i])
@@ -194,11 +575,30 @@ void TransferSlot::doio(MegaClient* client)
                 case REQ_SUCCESS:
                     lastdata = Waiter::ds;
 
+                    if (!reqs[i]->timeline.completed)
+                    {
+                        reqs[i]->timeline.completed = Waiter::us();
+                    }
+
                     progresscompleted += reqs[i]->size;
 
+                    if (racing(i))
+                    {
+                        finishrace(client, i, true);
+                    }
+
+                    windowbytes += reqs[i]->size;
+                    windowchunks++;
+                    windowlatency += Waiter::ds - reqs[i]->postds;
+
+                    client->storagehostok(&reqs[i]->posturl);
+                    client->netifdone(reqs[i]->netifindex, reqs[i]->size, Waiter::ds - reqs[i]->postds, true);
+                    reqs[i]->netifindex = -1;
+
                     if (transfer->type == PUT)
                     {
                         errorcount = 0;
+                        recordtimings(client, reqs[i]);
 
                         // completed put transfers are signalled through the
                         // return of the upload token
@@ -211,7 +611,7 @@ void TransferSlot::doio(MegaClient* client)
                                 {
                                     memcpy(transfer->filekey, transfer->key.key, sizeof transfer->key.key);
                                     ((int64_t*)transfer->filekey)[2] = transfer->ctriv;
-                                    ((int64_t*)transfer->filekey)[3] = macsmac(&transfer->chunkmacs);
+                                    ((int64_t*)transfer->filekey)[3] = macsmac();
                                     SymmCipher::xorblock(transfer->filekey + SymmCipher::KEYLENGTH, transfer->filekey);
 
                                     return transfer->complete();
@@ -230,19 +630,57 @@ void TransferSlot::doio(MegaClient* client)
                         {
                             errorcount = 0;
 
+                            if (client->workerpool)
+                            {
+                                // hand decryption, MAC computation and write
+                                // over to a worker thread
+                                HttpReqDL* dl = (HttpReqDL*)reqs[i];
+
+                                if (!famutex)
+                                {
+                                    famutex = client->workerpool->newmutex();
+                                }
+
+                                dl->job = new HttpReqDLJob(dl, fa, famutex, &transfer->key, transfer->ctriv);
+                                dl->status = REQ_ASYNCIO;
+                                asyncjobs++;
+
+                                client->workerpool->push(dl->job);
+                                break;
+                            }
+
+                            if (fa->asyncavailable())
+                            {
+                                // decrypt and MAC inline, write in the background
+                                HttpReqDL* dl = (HttpReqDL*)reqs[i];
+                                int64_t t = Waiter::us();
+
+                                HttpReqXfer::cryptchunks(&transfer->key, dl->buf, dl->bufpos, dl->dlpos,
+                                                         transfer->ctriv, &dl->asyncmacs, false);
+
+                                // diskus holds the submission time until the write completes
+                                dl->diskus = Waiter::us();
+                                dl->cryptous = dl->diskus - t;
+                                dl->asyncio = fa->asyncfwrite(dl->buf, dl->bufpos, dl->dlpos);
+                                dl->status = REQ_ASYNCIO;
+                                asyncjobs++;
+                                break;
+                            }
+
                             reqs[i]->finalize(fa, &transfer->key, &transfer->chunkmacs, transfer->ctriv, 0, -1);
+                            recordtimings(client, reqs[i]);
 
                             if (progresscompleted == transfer->size)
                             {
                                 // verify meta MAC
-                                if (!progresscompleted || (macsmac(&transfer->chunkmacs) == transfer->metamac))
+                                if (!progresscompleted || (macsmac() == transfer->metamac))
                                 {
                                     return transfer->complete();
                                 }
                                 else
                                 {
                                     progresscompleted -= reqs[i]->size;
-                                    return transfer->failed(API_EKEY);
+                                    return transfer->failed(badmac(client));
                                 }
                             }
                         }
@@ -258,8 +696,107 @@ void TransferSlot::doio(MegaClient* client)
                     reqs[i]->status = REQ_READY;
                     break;
 
+                case REQ_ASYNCIO:
+                {
+                    HttpReqDL* dl = (HttpReqDL*)reqs[i];
+                    chunkmac_map* macs;
+
+                    if (dl->job)
+                    {
+                        if (!client->workerpool->isdone(dl->job))
+                        {
+                            break;
+                        }
+
+                        macs = &dl->job->macs;
+                    }
+                    else
+                    {
+                        if (!dl->asyncio->finished)
+                        {
+                            break;
+                        }
+
+                        if (dl->asyncio->failed)
+                        {
+                            LOG_err << "Asynchronous write failed";
+
+                            delete dl->asyncio;
+                            dl->asyncio = NULL;
+                            dl->asyncmacs.clear();
+                            asyncjobs--;
+
+                            progresscompleted -= reqs[i]->size;
+                            return transfer->failed(API_EWRITE);
+                        }
+
+                        macs = &dl->asyncmacs;
+                    }
+
+                    for (chunkmac_map::iterator it = macs->begin(); it != macs->end(); it++)
+                    {
+                        transfer->chunkmacs[it->first] = it->second;
+                    }
+
+                    if (dl->job)
+                    {
+                        dl->cryptous = dl->job->cryptous;
+                        dl->diskus = dl->job->diskus;
+
+                        delete dl->job;
+                        dl->job = NULL;
+                    }
+                    else
+                    {
+                        dl->diskus = Waiter::us() - dl->diskus;
+
+                        delete dl->asyncio;
+                        dl->asyncio = NULL;
+                        dl->asyncmacs.clear();
+                    }
+
+                    asyncjobs--;
+                    recordtimings(client, reqs[i]);
+
+                    if (progresscompleted == transfer->size && !asyncjobs)
+                    {
+                        // verify meta MAC
+                        if (!progresscompleted || (macsmac() == transfer->metamac))
+                        {
+                            return transfer->complete();
+                        }
+                        else
+                        {
+                            progresscompleted -= reqs[i]->size;
+                            return transfer->failed(badmac(client));
+                        }
+                    }
+
+                    reqs[i]->status = REQ_READY;
+                    break;
+                }
+
                 case REQ_FAILURE:
-                    if (reqs[i]->httpstatus == 509)
+                    // (a response of the server says nothing about the interface)
+                    if (!reqs[i]->httpstatus)
+                    {
+                        client->netifdone(reqs[i]->netifindex, 0, 0, false);
+                    }
+
+                    reqs[i]->netifindex = -1;
+
+                    if (reqs[i]->frompeer)
+                    {
+                        // the peer is gone or no longer has the file:
+                        // continue from the storage server
+                        LOG_debug << "LAN peer chunk request failed (" << reqs[i]->httpstatus << ")";
+
+                        client->droppeer(peerhandle);
+                        reqs[i]->frompeer = false;
+                        ((HttpReqDL*)reqs[i])->seturl(tempurl.c_str());
+                        reqs[i]->status = REQ_PREPARED;
+                    }
+                    else if (reqs[i]->httpstatus == 509)
                     {
                         client->app->transfer_limit(transfer);
 
@@ -268,12 +805,21 @@ void TransferSlot::doio(MegaClient* client)
                     }
                     else
                     {
+                        windowfailures++;
+
                         if (!failure)
                         {
                             failure = true;
                             bool changeport = false;
+                            bool raced = false;
 
-                            if (transfer->type == GET && client->autodownport)
+                            if ((raced = racing(i)))
+                            {
+                                // retry on the port that won
+                                finishrace(client, i, false);
+                                changeport = true;
+                            }
+                            else if (transfer->type == GET && client->autodownport)
                             {
                                 LOG_debug << "Automatically changing download port";
                                 client->usealtdownport = !client->usealtdownport;
@@ -286,6 +832,12 @@ void TransferSlot::doio(MegaClient* client)
                                 changeport = true;
                             }
 
+                            if (changeport && !raced)
+                            {
+                                // the learned preference no longer holds
+                                client->setaltportpreference(&tempurl, -1);
+                            }
+
                             client->setchunkfailed(&reqs[i]->posturl);
 
                             if (changeport)
@@ -302,37 +854,42 @@ void TransferSlot::doio(MegaClient* client)
             }
         }
 
-        if (!failure)
+        if (!failure && !hostdown)
         {
-            if (!reqs[i] || (reqs[i]->status == REQ_READY))
+            if ((!reqs[i] || (reqs[i]->status == REQ_READY)) && i < maxreqs)
             {
-                m_off_t npos = ChunkedHash::chunkceil(transfer->pos);
-
-                if (npos > transfer->size)
-                {
-                    npos = transfer->size;
-                }
+                m_off_t npos = requestend(client, transfer->pos);
 
-                if ((npos > transfer->pos) || !transfer->size)
+                if (pipelined ? readahead.size() : ((npos > transfer->pos) || !transfer->size))
                 {
                     if (!reqs[i])
                     {
-                        reqs[i] = transfer->type == PUT ? (HttpReqXfer*)new HttpReqUL() : (HttpReqXfer*)new HttpReqDL();
+                        reqs[i] = transfer->type == PUT ? (HttpReqXfer*)new HttpReqUL(&client->bufferpool)
+                                                          : (HttpReqXfer*)new HttpReqDL(&client->bufferpool);
+                        reqs[i]->activity = &dirty;
                     }
 
                     string finaltempurl = tempurl;
-                    if (transfer->type == GET && client->usealtdownport
+                    bool altport = transfer->type == GET ? client->usealtdownport : client->usealtupport;
+                    bool race = false;
+
+                    if ((transfer->type == GET ? client->autodownport : client->autoupport)
                             && !memcmp(tempurl.c_str(), "http:", 5))
                     {
-                        size_t index = tempurl.find("/", 8);
-                        if(index != string::npos && tempurl.find(":", 8) == string::npos)
+                        int preference = client->altportpreference(&tempurl);
+
+                        if (preference >= 0)
                         {
-                            finaltempurl.insert(index, ":8080");
+                            altport = preference != 0;
+                        }
+                        else if (!raceover && racereqs < 2 && connections > 1)
+                        {
+                            race = true;
+                            altport = racereqs != 0;
                         }
                     }
 
-                    if (transfer->type == PUT && client->usealtupport
-                            && !memcmp(tempurl.c_str(), "http:", 5))
+                    if (altport && !memcmp(tempurl.c_str(), "http:", 5))
                     {
                         size_t index = tempurl.find("/", 8);
                         if(index != string::npos && tempurl.find(":", 8) == string::npos)
@@ -341,11 +898,69 @@ void TransferSlot::doio(MegaClient* client)
                         }
                     }
 
-                    if (reqs[i]->prepare(fa, finaltempurl.c_str(), &transfer->key,
+                    // chunks of files held by a LAN peer are fetched from there
+                    const string* peerurl = NULL;
+
+                    if (!ISUNDEF(peerhandle))
+                    {
+                        map<handle, string>::iterator it = client->peerurls.find(peerhandle);
+
+                        if (it != client->peerurls.end())
+                        {
+                            peerurl = &it->second;
+                            finaltempurl = *peerurl;
+                            race = false;
+                        }
+                    }
+
+                    if (pipelined)
+                    {
+                        HttpReqULJob* job = readahead.front();
+
+                        // otherwise, wait for the worker to finish
+                        if (client->workerpool->isdone(job))
+                        {
+                            readahead.pop_front();
+
+                            if (job->ok)
+                            {
+                                ((HttpReqUL*)reqs[i])->prepare(finaltempurl.c_str(), job, &transfer->chunkmacs);
+                                reqs[i]->status = REQ_PREPARED;
+
+                                delete job;
+                                prefetch(client);
+                            }
+                            else
+                            {
+                                bool retry = job->retry;
+
+                                // re-read from the failed position
+                                flushreadahead();
+                                transfer->pos = job->pos;
+                                delete job;
+
+                                if (!retry)
+                                {
+                                    return transfer->failed(API_EREAD);
+                                }
+
+                                // retry the read shortly
+                                backoff = 2;
+                            }
+                        }
+                    }
+                    else if (!reqs[i]->reservation.reserve(&client->inflight, npos - transfer->pos))
+                    {
+                        // held back until data in flight elsewhere completes
+                        continue;
+                    }
+                    else if (reqs[i]->prepare(fa, finaltempurl.c_str(), &transfer->key,
                                          &transfer->chunkmacs, transfer->ctriv,
                                          transfer->pos, npos))
                     {
                         reqs[i]->status = REQ_PREPARED;
+                        reqs[i]->frompeer = peerurl != NULL;
+                        peerused |= reqs[i]->frompeer;
                         transfer->pos = npos;
                     }
                     else
@@ -358,24 +973,59 @@ void TransferSlot::doio(MegaClient* client)
                         // retry the read shortly
                         backoff = 2;
                     }
+
+                    if (race && reqs[i]->status == REQ_PREPARED)
+                    {
+                        raceconn[racereqs++] = i;
+                    }
                 }
                 else if (reqs[i])
                 {
-                    reqs[i]->status = REQ_DONE;
+                    reqs[i]->reservation.release();
+
+                    // (a read-ahead held back by the in-flight budget
+                    // resumes with the next doio())
+                    if (!pipelined || transfer->pos >= transfer->size)
+                    {
+                        reqs[i]->status = REQ_DONE;
+                    }
                 }
             }
 
             if (reqs[i] && (reqs[i]->status == REQ_PREPARED))
             {
-                reqs[i]->post(client);
+                // spread over the configured interfaces (LAN peers are
+                // reached through the default route)
+                reqs[i]->netifindex = reqs[i]->frompeer ? -1 : client->picknetif();
+                reqs[i]->netif = reqs[i]->netifindex >= 0 ? client->netifs[reqs[i]->netifindex].name : string();
+
+                reqs[i]->postds = Waiter::ds;
+                reqs[i]->maxspeed = client->bandwidth.requestspeed(transfer->type, reqs[i]->size,
+                                                                   client->inflightrequests(transfer->type),
+                                                                   inflightrequests());
+                reqs[i]->postchunk(client);
             }
         }
     }
 
+    foldmacs();
+
+    if (transfer->macpos - transfer->cachedpos >= CACHEINTERVAL)
+    {
+        client->cachetransfer(transfer);
+    }
+
+    // (the throughput of a backing off download says nothing about the link)
+    if (!failure && !yielding)
+    {
+        adaptconnections(client);
+    }
+
     p += progresscompleted;
 
     if (p != progressreported)
     {
+        client->scheduler.addbytes(transfer->type, p - progressreported);
         progressreported = p;
         lastdata = Waiter::ds;
 
@@ -400,6 +1050,11 @@ void TransferSlot::doio(MegaClient* client)
             changeport = true;
         }
 
+        if (changeport)
+        {
+            client->setaltportpreference(&tempurl, -1);
+        }
+
         client->app->transfer_failed(transfer, API_EFAILED);
 
         for (int i = connections; i--; )
@@ -419,6 +1074,28 @@ void TransferSlot::doio(MegaClient* client)
         }
     }
 
+    if (hostdown && !failure)
+    {
+        // a download that failed on it gets a new URL (usually on another
+        // server) - uploads are bound to theirs and wait for the probe
+        if (transfer->type == GET && errorcount && !inflightrequests())
+        {
+            LOG_debug << "Requesting a new download URL";
+            return transfer->failed(API_EAGAIN);
+        }
+
+        // (idle on purpose: the stalled transfer timeout does not apply)
+        if (!inflightrequests())
+        {
+            lastdata = Waiter::ds;
+        }
+
+        if (!backoff || hostretry < backoff)
+        {
+            backoff = hostretry ? hostretry : 1;
+        }
+    }
+
     if (!failure)
     {
         if (!backoff && (Waiter::ds - lastdata) < XFERTIMEOUT)
@@ -431,6 +1108,30 @@ void TransferSlot::doio(MegaClient* client)
     }
 }
 
+bool TransferSlot::ready(MegaClient* client)
+{
+    // a state change in the HTTP layer could concern any slot
+    if (dirty || client->httpstatechange || !client->httpio->reportsactivity)
+    {
+        return true;
+    }
+
+    // pending completion or URL, expired retry/stall deadline
+    if (!fa || !tempurl.size() || retrybt.armed())
+    {
+        return true;
+    }
+
+    // worker and asynchronous I/O completions are not signalled to the slot
+    if (asyncjobs || readahead.size())
+    {
+        return true;
+    }
+
+    // upload progress is not reported either: poll it once per decisecond
+    return transfer->type == PUT && lastio != Waiter::ds && inflightrequests();
+}
+
 // transfer progress notification to app and related files
 void TransferSlot::progress()
 {
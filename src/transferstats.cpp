@@ -0,0 +1,239 @@
+/**
+ * @file transferstats.cpp
+ * @brief Transfer chunk timing instrumentation
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/transferstats.h"
+#include "mega/waiter.h"
+
+namespace mega {
+HttpReqTimeline::HttpReqTimeline()
+{
+    reset();
+}
+
+void HttpReqTimeline::reset()
+{
+    posted = 0;
+    resolved = 0;
+    connected = 0;
+    firstbyte = 0;
+    completed = 0;
+}
+
+ChunkTimingStats::ChunkTimingStats()
+{
+    reset();
+}
+
+void ChunkTimingStats::reset()
+{
+    chunks = 0;
+    bytes = 0;
+
+    memset(histogram, 0, sizeof histogram);
+    memset(samples, 0, sizeof samples);
+    memset(total, 0, sizeof total);
+    memset(max, 0, sizeof max);
+    memset(throughput, 0, sizeof throughput);
+}
+
+// log2 bucket of v / 1000 (microseconds -> ms, bytes/s -> KB/s)
+int ChunkTimingStats::bucket(int64_t v)
+{
+    int b = 0;
+
+    for (v /= 1000; v && b < NUMBUCKETS - 1; v >>= 1)
+    {
+        b++;
+    }
+
+    return b;
+}
+
+void ChunkTimingStats::add(timingphase_t phase, int64_t us)
+{
+    if (us < 0)
+    {
+        us = 0;
+    }
+
+    histogram[phase][bucket(us)]++;
+    samples[phase]++;
+    total[phase] += us;
+
+    if (us > max[phase])
+    {
+        max[phase] = us;
+    }
+}
+
+void ChunkTimingStats::record(direction_t type, unsigned size, const HttpReqTimeline* t,
+                              int64_t cryptous, int64_t diskus, int64_t done)
+{
+    if (!t->posted || !t->completed)
+    {
+        return;
+    }
+
+    chunks++;
+    bytes += size;
+
+    int64_t start = t->posted;
+
+    if (t->resolved)
+    {
+        add(TIMING_RESOLVE, t->resolved - start);
+        start = t->resolved;
+    }
+
+    if (t->connected)
+    {
+        add(TIMING_CONNECT, t->connected - start);
+        start = t->connected;
+    }
+
+    // the response to an upload only starts once the chunk has been sent
+    if (type == GET && t->firstbyte)
+    {
+        add(TIMING_FIRSTBYTE, t->firstbyte - start);
+        start = t->firstbyte;
+    }
+
+    add(TIMING_TRANSFER, t->completed - start);
+    add(TIMING_CRYPTO, cryptous);
+    add(TIMING_DISK, diskus);
+    add(TIMING_TOTAL, done - t->posted);
+
+    if (t->completed > t->posted)
+    {
+        // bytes per second
+        throughput[bucket((int64_t)size * 1000000 / (t->completed - t->posted))]++;
+    }
+}
+
+DurationStats::DurationStats()
+{
+    reset();
+}
+
+void DurationStats::reset()
+{
+    count = 0;
+    total = 0;
+    max = 0;
+}
+
+void DurationStats::add(int64_t us)
+{
+    if (us < 0)
+    {
+        us = 0;
+    }
+
+    count++;
+    total += us;
+
+    if (us > max)
+    {
+        max = us;
+    }
+}
+
+HttpHostStats::HttpHostStats()
+{
+    requests = 0;
+    failures = 0;
+    bytesout = 0;
+    bytesin = 0;
+}
+
+EngineStats::EngineStats()
+{
+    reset();
+}
+
+void EngineStats::reset()
+{
+    csbatches = 0;
+    csretries = 0;
+    cslatency.reset();
+    scresponses = 0;
+    actionpackets = 0;
+    scretries = 0;
+    chunkfailures = 0;
+    dbcommits.reset();
+    execs.reset();
+    waits.reset();
+}
+
+StartupTrace::StartupTrace()
+{
+    reset();
+    active = false;
+}
+
+void StartupTrace::reset()
+{
+    origin = Waiter::us();
+    active = true;
+
+    for (int i = STARTUP_NUMPHASES; i--; )
+    {
+        started[i] = -1;
+        finished[i] = -1;
+        bytes[i] = 0;
+        items[i] = 0;
+    }
+}
+
+void StartupTrace::begin(startupphase_t phase)
+{
+    if (active)
+    {
+        started[phase] = Waiter::us() - origin;
+        finished[phase] = -1;
+    }
+}
+
+void StartupTrace::end(startupphase_t phase, m_off_t b, m_off_t n)
+{
+    if (active && started[phase] >= 0)
+    {
+        finished[phase] = Waiter::us() - origin;
+        bytes[phase] = b;
+        items[phase] = n;
+
+        if (phase == STARTUP_CURRENT)
+        {
+            active = false;
+        }
+    }
+}
+
+void StartupTrace::record(startupphase_t phase, int64_t start, int64_t end, m_off_t b)
+{
+    if (active && start >= origin && end >= start)
+    {
+        started[phase] = start - origin;
+        finished[phase] = end - origin;
+        bytes[phase] = b;
+    }
+}
+} // namespace
@@ -23,6 +23,29 @@
 #include "mega/megaclient.h"
 
 namespace mega {
+TreeProcJob::TreeProcJob(TreeProc* ctp, bool cskipinshares)
+{
+    tp = ctp;
+    skipinshares = cskipinshares;
+    size = 0;
+    finished = false;
+}
+
+TreeProcJob::~TreeProcJob()
+{
+    delete tp;
+}
+
+void TreeProcJob::run()
+{
+    for (unsigned i = 0; i < roots.size(); i++)
+    {
+        MegaClient::walktree(NULL, roots[i], tp, skipinshares);
+    }
+
+    finished = true;
+}
+
 // create share keys
 TreeProcShareKeys::TreeProcShareKeys(Node* n)
 {
@@ -34,9 +57,24 @@ void TreeProcShareKeys::proc(MegaClient*, Node* n)
     snk.add(n, sn, sn != NULL);
 }
 
-void TreeProcShareKeys::get(Command* c)
+TreeProc* TreeProcShareKeys::fork()
+{
+    return new TreeProcShareKeys(sn);
+}
+
+void TreeProcShareKeys::merge(TreeProc* tp)
+{
+    snk.merge(&((TreeProcShareKeys*)tp)->snk);
+}
+
+void TreeProcShareKeys::encrypt(WorkerPool* pool)
+{
+    snk.encrypt(pool);
+}
+
+void TreeProcShareKeys::get(Command* c, unsigned first, unsigned count)
 {
-    snk.get(c);
+    snk.get(c, first, count);
 }
 
 void TreeProcForeignKeys::proc(MegaClient* client, Node* n)
@@ -70,6 +108,20 @@ void TreeProcDU::proc(MegaClient*, Node* n)
     }
 }
 
+TreeProc* TreeProcDU::fork()
+{
+    return new TreeProcDU;
+}
+
+void TreeProcDU::merge(TreeProc* tp)
+{
+    TreeProcDU* du = (TreeProcDU*)tp;
+
+    numbytes += du->numbytes;
+    numfiles += du->numfiles;
+    numfolders += du->numfolders;
+}
+
 // mark node as removed and notify
 void TreeProcDel::proc(MegaClient* client, Node* n)
 {
@@ -121,6 +173,7 @@ void LocalTreeProcMove::proc(MegaClient*, LocalNode* localnode)
     {
         localnode->created = false;
         localnode->node = NULL;
+        localnode->setdirty();
     }
 
     nc++;
@@ -55,13 +55,56 @@ bool User::serialize(string* d)
     d->append((char*)&l, sizeof l);
     d->append(email.c_str(), l);
 
-    d->append("\0\0\0\0\0\0\0", 8);
+    // first expansion slot: length-prefixed public key followed by the
+    // cached user attributes
+    d->append("\1\1\0\0\0\0\0\0", 9);
 
     attrs.serialize(d);
 
+    string k;
     if (pubk.isvalid())
     {
-        pubk.serializekey(d, AsymmCipher::PUBKEY);
+        pubk.serializekey(&k, AsymmCipher::PUBKEY);
+    }
+
+    unsigned short ll = k.size();
+    d->append((char*)&ll, sizeof ll);
+    d->append(k);
+
+    uint32_t n = uacache.size();
+    d->append((char*)&n, sizeof n);
+
+    for (map<string, string>::iterator it = uacache.begin(); it != uacache.end(); it++)
+    {
+        l = it->first.size();
+        d->append((char*)&l, sizeof l);
+        d->append(it->first);
+
+        uint32_t vl = it->second.size();
+        d->append((char*)&vl, sizeof vl);
+        d->append(it->second);
+    }
+
+    return true;
+}
+
+bool User::cacheua(const string* name, const byte* value, unsigned len)
+{
+    if (name->size() > 255 || len > MAXCACHEDUA)
+    {
+        return false;
+    }
+
+    string* v = &uacache[*name];
+
+    if (value)
+    {
+        v->assign(1, UAFOUND);
+        v->append((const char*)value, len);
+    }
+    else
+    {
+        v->assign(1, UANOTFOUND);
     }
 
     return true;
@@ -101,6 +144,8 @@ User* User::unserialize(MegaClient* client, string* d)
     }
     ptr += l;
 
+    bool uarecords = ptr + 1 < end && ptr[0] == 1 && ptr[1] == 1;
+
     for (i = 8; i--;)
     {
         if (ptr + MemAccess::get<unsigned char>(ptr) < end)
@@ -122,16 +167,63 @@ User* User::unserialize(MegaClient* client, string* d)
     client->mapuser(uh, m.c_str());
     u->set(v, ts);
 
-    if ((ptr < end) && !(ptr = u->attrs.unserialize(ptr)))
+    if ((ptr < end) && !(ptr = u->attrs.unserialize(ptr, end)))
     {
         return NULL;
     }
 
-    if ((ptr < end) && !u->pubk.setkey(AsymmCipher::PUBKEY, (byte*)ptr, end - ptr))
+    if (!uarecords)
+    {
+        if ((ptr < end) && !u->pubk.setkey(AsymmCipher::PUBKEY, (byte*)ptr, end - ptr))
+        {
+            return NULL;
+        }
+
+        return u;
+    }
+
+    if (ptr + sizeof(unsigned short) > end)
     {
         return NULL;
     }
 
+    unsigned short ll = MemAccess::get<unsigned short>(ptr);
+    ptr += sizeof ll;
+
+    if (ptr + ll + sizeof(uint32_t) > end
+     || (ll && !u->pubk.setkey(AsymmCipher::PUBKEY, (byte*)ptr, ll)))
+    {
+        return NULL;
+    }
+    ptr += ll;
+
+    uint32_t n = MemAccess::get<uint32_t>(ptr);
+    ptr += sizeof n;
+
+    string name;
+    while (n--)
+    {
+        if (ptr + 1 > end || ptr + 1 + (unsigned char)*ptr + sizeof(uint32_t) > end)
+        {
+            return NULL;
+        }
+
+        l = *ptr++;
+        name.assign(ptr, l);
+        ptr += l;
+
+        uint32_t vl = MemAccess::get<uint32_t>(ptr);
+        ptr += sizeof vl;
+
+        if ((size_t)(end - ptr) < vl)
+        {
+            return NULL;
+        }
+
+        u->uacache[name].assign(ptr, vl);
+        ptr += vl;
+    }
+
     return u;
 }
 
@@ -126,6 +126,11 @@ bool PaddedCBC::decrypt(string* data, SymmCipher* key, string* iv)
         key->cbc_decrypt((byte*)data->data(), data->size());
     }
 
+    return unpad(data);
+}
+
+bool PaddedCBC::unpad(string* data)
+{
     size_t p = data->find_last_of('E');
 
     if (p == string::npos)
@@ -182,6 +187,149 @@ m_off_t ChunkedHash::chunkceil(m_off_t p)
     return ((p - cp) & - (8 * SEGSIZE)) + cp + 8 * SEGSIZE;
 }
 
+m_off_t ChunkedHash::chunkindex(m_off_t p)
+{
+    m_off_t cp, np;
+
+    cp = 0;
+
+    for (unsigned i = 1; i <= 8; i++)
+    {
+        np = cp + i * SEGSIZE;
+
+        if (p < np)
+        {
+            return i - 1;
+        }
+
+        cp = np;
+    }
+
+    return (p - cp) / (8 * SEGSIZE) + 8;
+}
+
+m_off_t ChunkedHash::chunkstart(m_off_t i)
+{
+    if (i < 8)
+    {
+        return i * (i + 1) / 2 * SEGSIZE;
+    }
+
+    return (36 + (i - 8) * 8) * (m_off_t)SEGSIZE;
+}
+
+ChunkMACMap::iterator& ChunkMACMap::iterator::operator++()
+{
+    while (++i < entries->size() && (*entries)[i].first < 0);
+
+    return *this;
+}
+
+ChunkMACMap::iterator ChunkMACMap::iterator::operator++(int)
+{
+    iterator it = *this;
+    ++*this;
+    return it;
+}
+
+ChunkMACMap::iterator ChunkMACMap::begin()
+{
+    iterator it(&entries, 0);
+
+    if (entries.size() && entries[0].first < 0)
+    {
+        ++it;
+    }
+
+    return it;
+}
+
+ChunkMACMap::iterator ChunkMACMap::end()
+{
+    return iterator(&entries, entries.size());
+}
+
+ChunkMACMap::iterator ChunkMACMap::find(m_off_t pos)
+{
+    m_off_t i = ChunkedHash::chunkindex(pos) - base;
+
+    if (i >= 0 && i < (m_off_t)entries.size() && entries[i].first == pos)
+    {
+        return iterator(&entries, i);
+    }
+
+    return end();
+}
+
+void ChunkMACMap::erase(iterator it)
+{
+    entries[it.i].first = -1;
+    count--;
+
+    // release unused leading/trailing slots
+    if (!count)
+    {
+        entries.clear();
+    }
+    else
+    {
+        size_t n = 0;
+
+        while (entries[n].first < 0)
+        {
+            n++;
+        }
+
+        entries.erase(entries.begin(), entries.begin() + n);
+        base += n;
+
+        while (entries.back().first < 0)
+        {
+            entries.pop_back();
+        }
+    }
+}
+
+void ChunkMACMap::clear()
+{
+    entries.clear();
+    count = 0;
+}
+
+ChunkMAC& ChunkMACMap::operator[](m_off_t pos)
+{
+    m_off_t index = ChunkedHash::chunkindex(pos);
+    value_type unused;
+
+    unused.first = -1;
+
+    if (!entries.size())
+    {
+        base = index;
+    }
+    else if (index < base)
+    {
+        entries.insert(entries.begin(), (size_t)(base - index), unused);
+        base = index;
+    }
+
+    if (index - base >= (m_off_t)entries.size())
+    {
+        entries.resize((size_t)(index - base + 1), unused);
+    }
+
+    value_type* e = &entries[(size_t)(index - base)];
+
+    if (e->first < 0)
+    {
+        e->first = pos;
+        memset(e->second.mac, 0, sizeof e->second.mac);
+        count++;
+    }
+
+    return e->second;
+}
+
 
 // cryptographic signature generation/verification
 HashSignature::HashSignature(Hash* h)
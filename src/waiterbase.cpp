@@ -25,6 +25,42 @@ namespace mega {
 void Waiter::init(dstime ds)
 {
     maxds = ds;
+
+    if (EVER(ds))
+    {
+        // ds is relative to the start of the current decisecond
+        maxms = ((int64_t)Waiter::ds + ds) * 100 - dsms;
+
+        if (maxms < 0)
+        {
+            maxms = 0;
+        }
+    }
+    else
+    {
+        maxms = -1;
+    }
+}
+
+void Waiter::wakeupms(int64_t ms)
+{
+    if (ms < 0)
+    {
+        ms = 0;
+    }
+
+    if (maxms < 0 || ms < maxms)
+    {
+        maxms = ms;
+
+        // (rounded up: waiters that only honour maxds must not spin)
+        dstime d = (dstime)((dsms + ms + 99) / 100 - Waiter::ds);
+
+        if (d < maxds)
+        {
+            maxds = d;
+        }
+    }
 }
 
 // add events to wakeup criteria
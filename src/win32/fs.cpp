@@ -26,12 +26,33 @@ WinFileAccess::WinFileAccess()
 {
     hFile = INVALID_HANDLE_VALUE;
     hFind = INVALID_HANDLE_VALUE;
+    hDirect = INVALID_HANDLE_VALUE;
+    access = 0;
+
+#ifndef WINDOWS_PHONE
+    hAsync = INVALID_HANDLE_VALUE;
+    asyncdirect = false;
+    asyncfailed = false;
+#endif
 
     fsidvalid = false;
+    ctime = 0;
 }
 
 WinFileAccess::~WinFileAccess()
 {
+#ifndef WINDOWS_PHONE
+    if (hAsync != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hAsync);
+    }
+#endif
+
+    if (hDirect != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hDirect);
+    }
+
     if (hFile != INVALID_HANDLE_VALUE)
     {
         CloseHandle(hFile);
@@ -42,29 +63,199 @@ WinFileAccess::~WinFileAccess()
     }
 }
 
+// the offset of a synchronous ReadFile()/WriteFile() can be passed in the
+// OVERLAPPED structure, saving the SetFilePointerEx() call
+static void setoffset(OVERLAPPED* overlapped, m_off_t pos)
+{
+    memset(overlapped, 0, sizeof *overlapped);
+    overlapped->Offset = (DWORD)pos;
+    overlapped->OffsetHigh = (DWORD)(pos >> 32);
+}
+
 bool WinFileAccess::sysread(byte* dst, unsigned len, m_off_t pos)
 {
     DWORD dwRead;
+    OVERLAPPED overlapped;
+
+    setoffset(&overlapped, pos);
+
+    return ReadFile(hFile, (LPVOID)dst, (DWORD)len, &dwRead, &overlapped) && dwRead == len;
+}
+
+bool WinFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
+{
+    DWORD dwWritten;
+
+    // unbuffered writes require aligned transfers - write anything else buffered
+    HANDLE h = (hDirect != INVALID_HANDLE_VALUE
+                && !(((uintptr_t)data | len | pos) & (DIRECTIOALIGN - 1))) ? hDirect : hFile;
+    OVERLAPPED overlapped;
+
+    setoffset(&overlapped, pos);
 
-    if (!SetFilePointerEx(hFile, *(LARGE_INTEGER*)&pos, NULL, FILE_BEGIN))
+    return WriteFile(h, (LPCVOID)data, (DWORD)len, &dwWritten, &overlapped) && dwWritten == len;
+}
+
+bool WinFileAccess::fpreallocate(m_off_t len)
+{
+    LARGE_INTEGER size;
+
+    size.QuadPart = len;
+
+    if (!SetFilePointerEx(hFile, size, NULL, FILE_BEGIN) || !SetEndOfFile(hFile))
     {
         return false;
     }
 
-    return ReadFile(hFile, (LPVOID)dst, (DWORD)len, &dwRead, NULL) && dwRead == len;
+#ifndef WINDOWS_PHONE
+    // skip the zero-filling of the new extents (requires the
+    // SE_MANAGE_VOLUME_NAME privilege - the allocation stands without it)
+    SetFileValidData(hFile, len);
+#endif
+
+    return true;
 }
 
-bool WinFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
+bool WinFileAccess::setdirectio()
 {
-    DWORD dwWritten;
+#ifdef WINDOWS_PHONE
+    return false;
+#else
+    if (hDirect == INVALID_HANDLE_VALUE)
+    {
+        hDirect = ReOpenFile(hFile, GENERIC_WRITE, FILE_SHARE_WRITE | FILE_SHARE_READ,
+                             FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH);
+    }
 
-    if (!SetFilePointerEx(hFile, *(LARGE_INTEGER*)&pos, NULL, FILE_BEGIN))
+    return hDirect != INVALID_HANDLE_VALUE;
+#endif
+}
+
+#ifndef WINDOWS_PHONE
+// asynchronous I/O requires an open handle (not in by-name mode) that can be
+// reopened for overlapped access
+bool WinFileAccess::asyncavailable()
+{
+    if (hFile == INVALID_HANDLE_VALUE || localname.size() || asyncfailed)
+    {
+        return false;
+    }
+
+    if (hAsync == INVALID_HANDLE_VALUE)
+    {
+        asyncdirect = hDirect != INVALID_HANDLE_VALUE;
+        hAsync = ReOpenFile(hFile, access, FILE_SHARE_WRITE | FILE_SHARE_READ,
+                            FILE_FLAG_OVERLAPPED | (asyncdirect ? FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : 0));
+
+        if (hAsync == INVALID_HANDLE_VALUE)
+        {
+            LOG_debug << "Unable to reopen file for overlapped I/O. Error code: " << GetLastError();
+            asyncfailed = true;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+AsyncIOContext* WinFileAccess::asyncfread(byte* dst, unsigned len, m_off_t pos)
+{
+    if (!asyncavailable()
+     || (asyncdirect && (((uintptr_t)dst | len | pos) & (DIRECTIOALIGN - 1))))
+    {
+        return FileAccess::asyncfread(dst, len, pos);
+    }
+
+    WinAsyncIOContext* context = new WinAsyncIOContext;
+
+    context->op = AsyncIOContext::READ;
+    context->buffer = dst;
+    context->len = len;
+    context->pos = pos;
+
+    if (!asyncsubmit(context))
+    {
+        context->failed = !sysread(dst, len, pos);
+        context->finished = true;
+    }
+
+    return context;
+}
+
+AsyncIOContext* WinFileAccess::asyncfwrite(const byte* data, unsigned len, m_off_t pos)
+{
+    // unaligned unbuffered writes need the synchronous fallback
+    if (!asyncavailable()
+     || (asyncdirect && (((uintptr_t)data | len | pos) & (DIRECTIOALIGN - 1))))
+    {
+        return FileAccess::asyncfwrite(data, len, pos);
+    }
+
+    WinAsyncIOContext* context = new WinAsyncIOContext;
+
+    context->op = AsyncIOContext::WRITE;
+    context->buffer = (byte*)data;
+    context->len = len;
+    context->pos = pos;
+
+    if (!asyncsubmit(context))
+    {
+        context->failed = !fwrite(data, len, pos);
+        context->finished = true;
+    }
+
+    return context;
+}
+
+// queue an overlapped read/write - its completion routine runs in the
+// alertable WaitForMultipleObjectsEx() of WinWaiter::wait(), which then
+// returns WAIT_IO_COMPLETION and triggers an engine pass
+bool WinFileAccess::asyncsubmit(WinAsyncIOContext* context)
+{
+    BOOL r;
+
+    setoffset(&context->overlapped, context->pos);
+
+    // hEvent is not used by ReadFileEx()/WriteFileEx()
+    context->overlapped.hEvent = (HANDLE)context;
+
+    if (context->op == AsyncIOContext::READ)
+    {
+        r = ReadFileEx(hAsync, (LPVOID)context->buffer, (DWORD)context->len,
+                       &context->overlapped, asynccompletion);
+    }
+    else
+    {
+        r = WriteFileEx(hAsync, (LPCVOID)context->buffer, (DWORD)context->len,
+                        &context->overlapped, asynccompletion);
+    }
+
+    if (!r)
     {
+        LOG_debug << "Overlapped I/O not queued. Error code: " << GetLastError();
         return false;
     }
 
-    return WriteFile(hFile, (LPCVOID)data, (DWORD)len, &dwWritten, NULL) && dwWritten == len;
+    return true;
+}
+
+VOID CALLBACK WinFileAccess::asynccompletion(DWORD dwErrorCode, DWORD dwBytes, LPOVERLAPPED lpOverlapped)
+{
+    WinAsyncIOContext* context = (WinAsyncIOContext*)lpOverlapped->hEvent;
+
+    context->failed = dwErrorCode != ERROR_SUCCESS || dwBytes != context->len;
+    context->finished = true;
+}
+
+// completion routines are queued to the submitting (engine) thread
+void WinFileAccess::asyncwait(AsyncIOContext* context)
+{
+    while (!context->finished)
+    {
+        SleepEx(INFINITE, TRUE);
+    }
 }
+#endif
 
 m_time_t FileTime_to_POSIX(FILETIME* ft)
 {
@@ -86,6 +277,63 @@ m_time_t FileTime_to_POSIX(FILETIME* ft)
     return t;
 }
 
+#ifndef WINDOWS_PHONE
+#ifndef FIND_FIRST_EX_LARGE_FETCH
+#define FIND_FIRST_EX_LARGE_FETCH 2
+#endif
+
+// FindFirstFile() fetching larger batches of entries per system call and
+// skipping the short names (Windows 7 or later, FindFirstFile() otherwise)
+static HANDLE findfirst(LPCWSTR name, WIN32_FIND_DATAW* ffd)
+{
+    static bool largefetch = true;
+
+    if (largefetch)
+    {
+        HANDLE h = FindFirstFileExW(name, (FINDEX_INFO_LEVELS)1, ffd, FindExSearchNameMatch, NULL, FIND_FIRST_EX_LARGE_FETCH);
+
+        if (h != INVALID_HANDLE_VALUE || GetLastError() != ERROR_INVALID_PARAMETER)
+        {
+            return h;
+        }
+
+        largefetch = false;
+    }
+
+    return FindFirstFileW(name, ffd);
+}
+
+// FILE_ID_BOTH_DIR_INFO (only declared by the headers for Vista targets)
+struct WinDirEntry
+{
+    DWORD NextEntryOffset;
+    DWORD FileIndex;
+    LARGE_INTEGER CreationTime;
+    LARGE_INTEGER LastAccessTime;
+    LARGE_INTEGER LastWriteTime;
+    LARGE_INTEGER ChangeTime;
+    LARGE_INTEGER EndOfFile;
+    LARGE_INTEGER AllocationSize;
+    DWORD FileAttributes;
+    DWORD FileNameLength;
+    DWORD EaSize;
+    CCHAR ShortNameLength;
+    WCHAR ShortName[12];
+    LARGE_INTEGER FileId;
+    WCHAR FileName[1];
+};
+
+// FileIdBothDirectoryInfo class of GetFileInformationByHandleEx()
+#define FILEIDBOTHDIRECTORYINFO 10
+
+// size of a batch of directory entries
+#define LISTINGSIZE 65536
+
+// GetFileInformationByHandleEx(), resolved at runtime (Vista or later)
+typedef BOOL (WINAPI * PGFIBHE)(HANDLE, int, LPVOID, DWORD);
+static PGFIBHE pGFIBHE;
+#endif
+
 bool WinFileAccess::sysstat(m_time_t* mtime, m_off_t* size)
 {
     WIN32_FILE_ATTRIBUTE_DATA fad;
@@ -181,6 +429,8 @@ bool WinFileAccess::fopen(string* name, bool read, bool write)
     
     name->append("", 1);
 
+    access = (read ? GENERIC_READ : 0) | (write ? GENERIC_WRITE : 0);
+
     if (write)
     {
         type = FILENODE;
@@ -221,13 +471,13 @@ bool WinFileAccess::fopen(string* name, bool read, bool write)
     }
 
     hFile = CreateFile2((LPCWSTR)name->data(),
-                        read ? GENERIC_READ : GENERIC_WRITE,
+                        access,
                         FILE_SHARE_WRITE | FILE_SHARE_READ,
                         read ? OPEN_EXISTING : OPEN_ALWAYS,
                         &ex);
 #else
     hFile = CreateFileW((LPCWSTR)name->data(),
-                        read ? GENERIC_READ : GENERIC_WRITE,
+                        access,
                         FILE_SHARE_WRITE | FILE_SHARE_READ,
                         NULL,
                         read ? OPEN_EXISTING : OPEN_ALWAYS,
@@ -269,7 +519,7 @@ bool WinFileAccess::fopen(string* name, bool read, bool write)
 #ifdef WINDOWS_PHONE
         hFind = FindFirstFileExW((LPCWSTR)name->data(), FindExInfoBasic, &ffd, FindExSearchNameMatch, NULL, 0);
 #else
-        hFind = FindFirstFileW((LPCWSTR)name->data(), &ffd);
+        hFind = findfirst((LPCWSTR)name->data(), &ffd);
 #endif
 
         name->resize(name->size() - 5);
@@ -309,6 +559,13 @@ WinFileSystemAccess::WinFileSystemAccess()
     pendingevents = 0;
 
     localseparator.assign((char*)L"\\", sizeof(wchar_t));
+
+#ifndef WINDOWS_PHONE
+    if (!pGFIBHE)
+    {
+        pGFIBHE = (PGFIBHE)GetProcAddress(GetModuleHandle(TEXT("kernel32.dll")), "GetFileInformationByHandleEx");
+    }
+#endif
 }
 
 // append \ to bare Windows drive letter paths
@@ -509,7 +766,7 @@ bool WinFileSystemAccess::unlinklocal(string* name)
 
 // delete all files and folders contained in the specified folder
 // (does not recurse into mounted devices)
-void WinFileSystemAccess::emptydirlocal(string* name, dev_t basedev)
+void WinFileSystemAccess::emptydirlocal(string* name, dev_t basedev, LocalRemoval* progress)
 {
     HANDLE hDirectory, hFind;
     dev_t currentdev;
@@ -590,6 +847,12 @@ void WinFileSystemAccess::emptydirlocal(string* name, dev_t basedev)
         bool morefiles = true;
         while (morefiles)
         {
+            if (progress && progress->cancelled)
+            {
+                FindClose(hFind);
+                return;
+            }
+
             if (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)
                 && (!(ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
                     || *ffd.cFileName != '.'
@@ -599,17 +862,24 @@ void WinFileSystemAccess::emptydirlocal(string* name, dev_t basedev)
                 string childname = *name;
                 childname.append((char*)L"\\", 2);
                 childname.append((char*)ffd.cFileName, sizeof(wchar_t) * wcslen(ffd.cFileName));
+                bool r;
                 if (ffd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
                 {
-                    emptydirlocal(&childname , currentdev);
+                    emptydirlocal(&childname , currentdev, progress);
                     childname.append("", 1);
-                    removed |= !!RemoveDirectoryW((LPCWSTR)childname.data());
+                    r = !!RemoveDirectoryW((LPCWSTR)childname.data());
                 }
                 else
                 {
                     childname.append("", 1);
-                    removed |= !!DeleteFileW((LPCWSTR)childname.data());
+                    r = !!DeleteFileW((LPCWSTR)childname.data());
+                }
+
+                if (r && progress)
+                {
+                    progress->removed++;
                 }
+                removed |= r;
             }
             morefiles = FindNextFileW(hFind, &ffd);
         }
@@ -893,11 +1163,318 @@ void WinDirNotify::readchanges()
 #endif
 }
 
+#ifndef WINDOWS_PHONE
+// normalized path of an open handle (UTF-16, not terminated)
+static bool finalpathbyhandle(HANDLE h, string* path)
+{
+    DWORD len = MAX_PATH;
+
+    for (;;)
+    {
+        path->resize((len + 1) * sizeof(wchar_t));
+
+        DWORD r = GetFinalPathNameByHandleW(h, (LPWSTR)path->data(), len + 1, FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+
+        if (!r)
+        {
+            return false;
+        }
+
+        if (r <= len)
+        {
+            path->resize(r * sizeof(wchar_t));
+            return true;
+        }
+
+        len = r;
+    }
+}
+
+bool WinDirNotify::queryjournal(USN_JOURNAL_DATA_V0* jd)
+{
+    DWORD bytes;
+
+    if (!DeviceIoControl(hVolume, FSCTL_QUERY_USN_JOURNAL, NULL, 0, jd, sizeof *jd, &bytes, NULL))
+    {
+        LOG_debug << "Change journal not available. Error code: " << GetLastError();
+        return false;
+    }
+
+    return true;
+}
+
+// locate a directory by file reference number: 1 inside the sync (path
+// relative to the root), 0 outside, -1 not found
+int WinDirNotify::journalparent(DWORDLONG frn, map<DWORDLONG, pair<int, string> >* parents, string* relpath)
+{
+    map<DWORDLONG, pair<int, string> >::iterator it = parents->find(frn);
+
+    if (it == parents->end())
+    {
+        FILE_ID_DESCRIPTOR fid;
+        HANDLE h;
+        string path;
+
+        it = parents->insert(pair<DWORDLONG, pair<int, string> >(frn, pair<int, string>(-1, string()))).first;
+
+        fid.dwSize = sizeof fid;
+        fid.Type = FileIdType;
+        fid.FileId.QuadPart = frn;
+
+        if ((h = OpenFileById(hVolume, &fid, 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                              NULL, FILE_FLAG_BACKUP_SEMANTICS)) != INVALID_HANDLE_VALUE)
+        {
+            it->second.first = 0;
+
+            if (finalpathbyhandle(h, &path)
+             && path.size() >= journalroot.size()
+             && !memcmp(path.data(), journalroot.data(), journalroot.size()))
+            {
+                if (path.size() == journalroot.size())
+                {
+                    it->second.first = 1;
+                }
+                else if (!memcmp(path.data() + journalroot.size(), (char*)L"\\", sizeof(wchar_t)))
+                {
+                    it->second.first = 1;
+                    it->second.second = path.substr(journalroot.size() + sizeof(wchar_t));
+                }
+            }
+
+            CloseHandle(h);
+        }
+    }
+
+    *relpath = it->second.second;
+
+    return it->second.first;
+}
+
+// collect the paths (relative to the root) changed in [since, until) -
+// fails if a change cannot be attributed
+bool WinDirNotify::replayjournal(USN since, USN until, set<string>* changes)
+{
+    READ_USN_JOURNAL_DATA_V0 rd;
+    map<DWORDLONG, pair<int, string> > parents;
+    set<DWORDLONG> deleted, missing;
+    string buf, relpath;
+    DWORD bytes;
+
+    memset(&rd, 0, sizeof rd);
+    rd.StartUsn = since;
+    rd.ReasonMask = 0xFFFFFFFF;
+    rd.UsnJournalID = usnjournalid;
+
+    buf.resize(65536);
+
+    while (rd.StartUsn < until)
+    {
+        if (!DeviceIoControl(hVolume, FSCTL_READ_USN_JOURNAL, &rd, sizeof rd,
+                             (LPVOID)buf.data(), buf.size(), &bytes, NULL))
+        {
+            LOG_warn << "Unable to read the change journal. Error code: " << GetLastError();
+            return false;
+        }
+
+        if (bytes <= sizeof(USN))
+        {
+            break;
+        }
+
+        rd.StartUsn = MemAccess::get<USN>(buf.data());
+
+        for (DWORD offset = sizeof(USN); offset < bytes; )
+        {
+            USN_RECORD* r = (USN_RECORD*)(buf.data() + offset);
+
+            if (!r->RecordLength)
+            {
+                break;
+            }
+
+            offset += r->RecordLength;
+
+            if (r->MajorVersion != 2 || r->Usn >= until)
+            {
+                continue;
+            }
+
+            if (r->Reason & USN_REASON_FILE_DELETE)
+            {
+                deleted.insert(r->FileReferenceNumber);
+            }
+
+            switch (journalparent(r->ParentFileReferenceNumber, &parents, &relpath))
+            {
+                case 1:
+                    if (relpath.size())
+                    {
+                        relpath.append((char*)L"\\", sizeof(wchar_t));
+                    }
+
+                    relpath.append((char*)r + r->FileNameOffset, r->FileNameLength);
+
+                    // skip the local debris folder
+                    if (relpath.size() < ignore.size()
+                     || memcmp(relpath.data(), ignore.data(), ignore.size())
+                     || (relpath.size() > ignore.size()
+                      && memcmp(relpath.data() + ignore.size(), (char*)L"\\", sizeof(wchar_t))))
+                    {
+                        changes->insert(relpath);
+                    }
+                    break;
+
+                case -1:
+                    missing.insert(r->ParentFileReferenceNumber);
+                    break;
+            }
+        }
+    }
+
+    // changes in directories that no longer exist are covered by the
+    // deletion of an ancestor
+    for (set<DWORDLONG>::iterator it = missing.begin(); it != missing.end(); it++)
+    {
+        if (!deleted.count(*it))
+        {
+            LOG_debug << "Unattributable change journal entry";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// the journal position is the journal ID and the USN up to which all
+// changes have been processed
+bool WinDirNotify::start(const string* journal)
+{
+    USN_JOURNAL_DATA_V0 jd;
+    wchar_t mountpoint[MAX_PATH + 1];
+    wchar_t volume[MAX_PATH + 1];
+    string path = localbasepath;
+    set<string> changes;
+    size_t len;
+
+    if (hDirectory == INVALID_HANDLE_VALUE || !finalpathbyhandle(hDirectory, &journalroot))
+    {
+        return false;
+    }
+
+    if (journalroot.size() >= sizeof(wchar_t)
+     && !memcmp(journalroot.data() + journalroot.size() - sizeof(wchar_t), (char*)L"\\", sizeof(wchar_t)))
+    {
+        journalroot.resize(journalroot.size() - sizeof(wchar_t));
+    }
+
+    WinFileSystemAccess::sanitizedriveletter(&path);
+    path.append("", 1);
+
+    // the volume is opened by its GUID name, without the trailing backslash
+    // (reading the journal usually requires administrative rights)
+    if (!GetVolumePathNameW((LPCWSTR)path.data(), mountpoint, MAX_PATH + 1)
+     || !GetVolumeNameForVolumeMountPointW(mountpoint, volume, MAX_PATH + 1)
+     || !(len = wcslen(volume)))
+    {
+        return false;
+    }
+
+    if (volume[len - 1] == L'\\')
+    {
+        volume[len - 1] = 0;
+    }
+
+    if ((hVolume = CreateFileW(volume, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                               NULL, OPEN_EXISTING, 0, NULL)) == INVALID_HANDLE_VALUE)
+    {
+        LOG_debug << "Unable to open the volume. Error code: " << GetLastError();
+        return false;
+    }
+
+    if (!queryjournal(&jd))
+    {
+        stop();
+        return false;
+    }
+
+    usnjournalid = jd.UsnJournalID;
+    usncommitted = jd.NextUsn;
+    usnsampled = jd.NextUsn;
+    usnsampletime = Waiter::ds;
+
+    // a recreated journal or purged entries require a full scan
+    if (!journal || journal->size() != sizeof(DWORDLONG) + sizeof(USN)
+     || MemAccess::get<DWORDLONG>(journal->data()) != jd.UsnJournalID)
+    {
+        return false;
+    }
+
+    USN since = MemAccess::get<USN>(journal->data() + sizeof(DWORDLONG));
+
+    if (since < jd.FirstUsn || since > jd.NextUsn || !replayjournal(since, jd.NextUsn, &changes))
+    {
+        return false;
+    }
+
+    LOG_debug << "Replaying " << changes.size() << " changes since USN " << since;
+
+    // (changes after NextUsn are reported by ReadDirectoryChangesW)
+    for (set<string>::iterator it = changes.begin(); it != changes.end(); it++)
+    {
+        notify(DIREVENTS, localrootnode, it->data(), it->size());
+    }
+
+    return true;
+}
+
+void WinDirNotify::stop()
+{
+    if (hVolume != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hVolume);
+        hVolume = INVALID_HANDLE_VALUE;
+    }
+}
+
+bool WinDirNotify::journalpos(string* pos)
+{
+    if (hVolume == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    if (Waiter::ds - usnsampletime >= USNSAMPLEDS)
+    {
+        USN_JOURNAL_DATA_V0 jd;
+
+        if (queryjournal(&jd) && jd.UsnJournalID == usnjournalid)
+        {
+            usncommitted = usnsampled;
+            usnsampled = jd.NextUsn;
+        }
+
+        usnsampletime = Waiter::ds;
+    }
+
+    pos->assign((char*)&usnjournalid, sizeof usnjournalid);
+    pos->append((char*)&usncommitted, sizeof usncommitted);
+
+    return true;
+}
+
+#endif
+
 WinDirNotify::WinDirNotify(string* localbasepath, string* ignore) : DirNotify(localbasepath, ignore)
 {
 #ifndef WINDOWS_PHONE
     ZeroMemory(&overlapped, sizeof(overlapped));
 
+    hVolume = INVALID_HANDLE_VALUE;
+    usnjournalid = 0;
+    usncommitted = 0;
+    usnsampled = 0;
+    usnsampletime = 0;
+
     overlapped.hEvent = this;
 
     active = 0;
@@ -933,6 +1510,8 @@ WinDirNotify::WinDirNotify(string* localbasepath, string* ignore) : DirNotify(lo
 WinDirNotify::~WinDirNotify()
 {
 #ifndef WINDOWS_PHONE
+    stop();
+
     if (hDirectory != INVALID_HANDLE_VALUE)
     {
         CloseHandle(hDirectory);
@@ -986,6 +1565,45 @@ bool WinFileSystemAccess::issyncsupported(string *localpath)
 
 bool WinDirAccess::dopen(string* name, FileAccess* f, bool glob)
 {
+#ifndef WINDOWS_PHONE
+    if (!glob && pGFIBHE)
+    {
+        int added = WinFileSystemAccess::sanitizedriveletter(name);
+
+        name->append("", 1);
+        hDir = CreateFileW((LPCWSTR)name->data(), FILE_LIST_DIRECTORY,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                           NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        name->resize(name->size() - added - 1);
+
+        if (hDir != INVALID_HANDLE_VALUE)
+        {
+            if (!listing)
+            {
+                listing = new int64_t[LISTINGSIZE / sizeof(int64_t)];
+            }
+
+            listingdone = false;
+
+            if (nextbatch() || GetLastError() == ERROR_NO_MORE_FILES)
+            {
+                // the FindFirstFile() listing of fopen() isn't needed
+                if (f && ((WinFileAccess*)f)->hFind != INVALID_HANDLE_VALUE)
+                {
+                    FindClose(((WinFileAccess*)f)->hFind);
+                    ((WinFileAccess*)f)->hFind = INVALID_HANDLE_VALUE;
+                }
+
+                return true;
+            }
+
+            LOG_debug << "Unable to list folder by handle. Error code: " << GetLastError();
+            CloseHandle(hDir);
+            hDir = INVALID_HANDLE_VALUE;
+        }
+    }
+#endif
+
     if (f)
     {
         if ((hFind = ((WinFileAccess*)f)->hFind) != INVALID_HANDLE_VALUE)
@@ -1008,7 +1626,7 @@ bool WinDirAccess::dopen(string* name, FileAccess* f, bool glob)
 #ifdef WINDOWS_PHONE
         hFind = FindFirstFileExW((LPCWSTR)name->data(), FindExInfoBasic, &ffd, FindExSearchNameMatch, NULL, 0);
 #else
-        hFind = FindFirstFileW((LPCWSTR)name->data(), &ffd);
+        hFind = findfirst((LPCWSTR)name->data(), &ffd);
 #endif
 
         if (glob)
@@ -1047,9 +1665,73 @@ bool WinDirAccess::dopen(string* name, FileAccess* f, bool glob)
     return true;
 }
 
+#ifndef WINDOWS_PHONE
+// fetch the next batch of entries, false at the end of the listing or on error
+bool WinDirAccess::nextbatch()
+{
+    if (listingdone || !pGFIBHE(hDir, FILEIDBOTHDIRECTORYINFO, listing, LISTINGSIZE))
+    {
+        listingdone = true;
+        entry = NULL;
+        return false;
+    }
+
+    entry = (char*)listing;
+    return true;
+}
+#endif
+
 // FIXME: implement followsymlinks
 bool WinDirAccess::dnext(string* path, string* name, bool followsymlinks, nodetype_t* type)
 {
+    entrystatvalid = false;
+
+#ifndef WINDOWS_PHONE
+    if (hDir != INVALID_HANDLE_VALUE)
+    {
+        for (;;)
+        {
+            if (!entry && !nextbatch())
+            {
+                return false;
+            }
+
+            WinDirEntry* e = (WinDirEntry*)entry;
+            entry = e->NextEntryOffset ? entry + e->NextEntryOffset : NULL;
+
+            if (WinFileAccess::skipattributes(e->FileAttributes)
+             || ((e->FileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+              && *e->FileName == '.'
+              && (e->FileNameLength == sizeof(wchar_t)
+               || (e->FileNameLength == 2 * sizeof(wchar_t) && e->FileName[1] == '.'))))
+            {
+                continue;
+            }
+
+            name->assign((char*)e->FileName, e->FileNameLength);
+
+            FILETIME ft;
+            ft.dwLowDateTime = e->LastWriteTime.LowPart;
+            ft.dwHighDateTime = e->LastWriteTime.HighPart;
+
+            entrystat.type = (e->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? FOLDERNODE : FILENODE;
+            entrystat.size = entrystat.type == FILENODE ? (m_off_t)e->EndOfFile.QuadPart : 0;
+            entrystat.mtime = FileTime_to_POSIX(&ft);
+            entrystat.fsid = (handle)e->FileId.QuadPart;
+
+            // some filesystems don't provide file IDs
+            entrystatvalid = entrystat.fsid != 0;
+
+            if (type)
+            {
+                *type = entrystat.type;
+            }
+
+            return true;
+        }
+    }
+#endif
+
     for (;;)
     {
         if (ffdvalid
@@ -1077,10 +1759,29 @@ bool WinDirAccess::dnext(string* path, string* name, bool followsymlinks, nodety
     }
 }
 
+bool WinDirAccess::dstat(DirEntryStat* st)
+{
+    if (!entrystatvalid)
+    {
+        return false;
+    }
+
+    *st = entrystat;
+    return true;
+}
+
 WinDirAccess::WinDirAccess()
 {
     ffdvalid = false;
     hFind = INVALID_HANDLE_VALUE;
+    entrystatvalid = false;
+
+#ifndef WINDOWS_PHONE
+    hDir = INVALID_HANDLE_VALUE;
+    listing = NULL;
+    entry = NULL;
+    listingdone = true;
+#endif
 }
 
 WinDirAccess::~WinDirAccess()
@@ -1089,5 +1790,14 @@ WinDirAccess::~WinDirAccess()
     {
         FindClose(hFind);
     }
+
+#ifndef WINDOWS_PHONE
+    if (hDir != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hDir);
+    }
+
+    delete[] listing;
+#endif
 }
 } // namespace
@@ -255,6 +255,38 @@ void WinHttpIO::addevents(Waiter* cwaiter, int flags)
     waiter->pcsHTTP = &csHTTP;
 }
 
+// chunk transfers: instead of one notification and one read per network
+// buffer, issue large reads that WinHTTP completes straight into the pooled
+// chunk buffer - returns false if the caller should fall back to querying
+// data availability
+bool WinHttpIO::readdirect(WinHttpContext* httpctx)
+{
+    HttpReq* req = httpctx->req;
+
+    if (!req->buf || httpctx->gzip || req->bufpos >= req->buflen)
+    {
+        return false;
+    }
+
+    m_off_t size = req->buflen - req->bufpos;
+
+    if (size > DIRECT_READ_SIZE)
+    {
+        size = DIRECT_READ_SIZE;
+    }
+
+    httpctx->directread = true;
+
+    if (!WinHttpReadData(httpctx->hRequest, req->buf + req->bufpos, (DWORD)size, NULL))
+    {
+        LOG_err << "Unable to read data. Code: " << GetLastError();
+        httpctx->directread = false;
+        return false;
+    }
+
+    return true;
+}
+
 // handle WinHTTP callbacks (which can be in a worker thread context)
 VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                                        DWORD dwInternetStatus,
@@ -315,6 +347,7 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                 }
 
                 LOG_debug << "Request finished with HTTP status: " << req->httpstatus;
+                req->timeline.completed = Waiter::us();
                 req->status = (req->httpstatus == 200
                             && (req->contentlength < 0
                              || req->contentlength == (req->buf ? req->bufpos : (int)req->in.size())))
@@ -358,7 +391,32 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
         case WINHTTP_CALLBACK_STATUS_READ_COMPLETE:
             LOG_verbose << "Read complete";
 
-            if (dwStatusInformationLength)
+            if (httpctx->directread)
+            {
+                httpctx->directread = false;
+
+                if (dwStatusInformationLength)
+                {
+                    req->bufpos += dwStatusInformationLength;
+                    httpio->lastdata = Waiter::ds;
+                    httpio->httpevent();
+                }
+
+                if (dwStatusInformationLength && readdirect(httpctx))
+                {
+                    break;
+                }
+
+                // buffer full or end of response: completion is signalled by
+                // a zero-length data availability notification
+                if (!WinHttpQueryDataAvailable(httpctx->hRequest, NULL))
+                {
+                    LOG_err << "Error on WinHttpQueryDataAvailable. Code: " << GetLastError();
+                    httpio->cancel(req);
+                    httpio->httpevent();
+                }
+            }
+            else if (dwStatusInformationLength)
             {
                 LOG_verbose << dwStatusInformationLength << " bytes received";
                 if (req->httpio)
@@ -479,7 +537,14 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                     }
                 }
 
-                if (!WinHttpQueryDataAvailable(httpctx->hRequest, NULL))
+                if (readdirect(httpctx))
+                {
+                    if (httpio->waiter && httpio->noinetds)
+                    {
+                        httpio->inetstatus(true);
+                    }
+                }
+                else if (!WinHttpQueryDataAvailable(httpctx->hRequest, NULL))
                 {
                     LOG_err << "Unable to query data. Code: " << GetLastError();
 
@@ -519,6 +584,9 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
 
         case WINHTTP_CALLBACK_STATUS_SENDING_REQUEST:
         {
+            // the connection (and TLS session) is established
+            req->timeline.connected = Waiter::us();
+
             if(MegaClient::disablepkp)
             {
                 break;
@@ -623,6 +691,7 @@ void WinHttpIO::post(HttpReq* req, const char* data, unsigned len)
     httpctx->httpio = this;
     httpctx->req = req;
     httpctx->gzip = false;
+    httpctx->directread = false;
 
     req->httpiohandle = (void*)httpctx;
 
@@ -665,9 +734,11 @@ void WinHttpIO::post(HttpReq* req, const char* data, unsigned len)
                                        | WINHTTP_CALLBACK_FLAG_HANDLES,
                                          0);
 
-                LPCWSTR pwszHeaders = req->type == REQ_JSON || !req->buf
-                                    ? L"Content-Type: application/json\r\nAccept-Encoding: gzip"
-                                    : L"Content-Type: application/octet-stream";
+                LPCWSTR pwszHeaders = req->deflated
+                                    ? L"Content-Type: application/json\r\nAccept-Encoding: gzip\r\nContent-Encoding: gzip"
+                                    : (req->type == REQ_JSON || !req->buf
+                                      ? L"Content-Type: application/json\r\nAccept-Encoding: gzip"
+                                      : L"Content-Type: application/octet-stream");
 
                 // data is sent in HTTP_POST_CHUNK_SIZE instalments to ensure
                 // semi-smooth UI progress info
@@ -24,6 +24,7 @@
 
 namespace mega {
 dstime Waiter::ds;
+int64_t Waiter::dsms;
 
 PGTC pGTC;
 static ULONGLONG tickhigh;
@@ -48,7 +49,7 @@ void Waiter::bumpds()
 {
     if (pGTC)
     {
-        ds = pGTC() / 100;
+        dsms = pGTC();
     }
     else
     {
@@ -62,13 +63,31 @@ void Waiter::bumpds()
 
         prevt = t;
 
-        ds = (t + tickhigh) / 100;
+        dsms = t + tickhigh;
     }
+
+    ds = (dstime)(dsms / 100);
+}
+
+int64_t Waiter::us()
+{
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (!freq.QuadPart)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+
+    QueryPerformanceCounter(&count);
+
+    return count.QuadPart / freq.QuadPart * 1000000
+         + count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart;
 }
 
 // wait for events (socket, I/O completion, timeout + application events)
-// ds specifies the maximum amount of time to wait in deciseconds (or ~0 if no
-// timeout scheduled)
+// maxms specifies the maximum amount of time to wait in milliseconds (or -1 if
+// no timeout scheduled)
 // (this assumes that the second call to addhandle() was coming from the
 // network layer)
 int WinWaiter::wait()
@@ -83,7 +102,8 @@ int WinWaiter::wait()
     }
 
     addhandle(externalEvent, NEEDEXEC);
-    DWORD dwWaitResult = WaitForMultipleObjectsEx((DWORD)handles.size(), &handles.front(), FALSE, maxds * 100, TRUE);
+    DWORD dwWaitResult = WaitForMultipleObjectsEx((DWORD)handles.size(), &handles.front(), FALSE,
+                                                   maxms >= 0 ? (DWORD)maxms : INFINITE, TRUE);
 
     if (pcsHTTP)
     {
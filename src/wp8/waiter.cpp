@@ -24,6 +24,7 @@
 
 namespace mega {
 dstime Waiter::ds;
+int64_t Waiter::dsms;
 
 int CALLBACK RejectFunc(LPWSABUF, LPWSABUF, LPQOS, LPQOS, LPWSABUF, LPWSABUF, GROUP FAR *, DWORD_PTR)
 { return CF_REJECT; }
@@ -57,7 +58,24 @@ void WinPhoneWaiter::init(dstime ds)
 // FIXME: restore thread safety for applications using multiple MegaClient objects
 void WinPhoneWaiter::bumpds()
 {
-	ds = GetTickCount64() / 100;
+	dsms = GetTickCount64();
+	ds = (dstime)(dsms / 100);
+}
+
+int64_t Waiter::us()
+{
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER count;
+
+    if (!freq.QuadPart)
+    {
+        QueryPerformanceFrequency(&freq);
+    }
+
+    QueryPerformanceCounter(&count);
+
+    return count.QuadPart / freq.QuadPart * 1000000
+         + count.QuadPart % freq.QuadPart * 1000000 / freq.QuadPart;
 }
 
 // update maxfd for select()
@@ -70,22 +88,20 @@ void WinPhoneWaiter::bumpmaxfd(int fd)
 }
 
 // wait for events (socket, I/O completion, timeout + application events)
-// ds specifies the maximum amount of time to wait in deciseconds (or ~0 if no
-// timeout scheduled)
+// maxms specifies the maximum amount of time to wait in milliseconds (or -1 if
+// no timeout scheduled)
 int WinPhoneWaiter::wait()
 {
 	timeval tv;
 
-	if (EVER(maxds))
+	if (maxms >= 0)
 	{
-		dstime us = 1000000 / 10 * maxds;
-
-		tv.tv_sec = us / 1000000;
-		tv.tv_usec = us - tv.tv_sec * 1000000;
+		tv.tv_sec = (long)(maxms / 1000);
+		tv.tv_usec = (long)(maxms % 1000 * 1000);
 	}
 
 	FD_SET(wakupSocket, &rfds);
-	select(maxfd + 1, &rfds, &wfds, &efds, EVER(maxds) ? &tv : NULL);
+	select(maxfd + 1, &rfds, &wfds, &efds, maxms >= 0 ? &tv : NULL);
 	
 	if (FD_ISSET(wakupSocket, &rfds))
 		WSAAccept(wakupSocket, NULL, NULL, RejectFunc, NULL);
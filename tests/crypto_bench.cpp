@@ -0,0 +1,463 @@
+/**
+ * @file tests/crypto_bench.cpp
+ * @brief Throughput of the cryptographic primitives
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// runs each primitive for a fixed time on one thread, then on several threads
+// at once (each with private instances) and reports MB/s or operations per
+// second, along with the implementations selected at runtime:
+// - SymmCipher: ctr_crypt with/without MAC, ecb_encrypt, cbc_encrypt
+// - PaddedCBC encryption/decryption of cache-record-sized strings
+// - AesBatch with attribute-sized jobs under independent keys
+// - AsymmCipher RSA-2048 decryption
+// - MegaClient::pw_key
+// - HashCRC32
+// - EdDSA signing, verification and public key derivation (with USE_SODIUM)
+//
+// usage: crypto_bench [-b buffer size] [-s seconds per case] [-t threads]
+
+#include "mega.h"
+#include "megaapi_impl.h"
+
+#include <iomanip>
+
+using namespace mega;
+
+static unsigned bufsize = 1 << 20;
+
+// one operation of a benchmark case
+struct CryptoCase
+{
+    const char* name;
+
+    // bytes per operation (0: report operations per second)
+    unsigned opbytes;
+
+    virtual void op() = 0;
+
+    CryptoCase(const char* cname, unsigned copbytes) : name(cname), opbytes(copbytes) { }
+    virtual ~CryptoCase() { }
+};
+
+static void randomkey(SymmCipher* key)
+{
+    byte k[SymmCipher::KEYLENGTH];
+
+    PrnGen::genblock(k, sizeof k);
+    key->setkey(k);
+}
+
+struct CtrCase : public CryptoCase
+{
+    SymmCipher key;
+    string buf;
+    byte mac[SymmCipher::BLOCKSIZE];
+    bool withmac;
+
+    void op()
+    {
+        key.ctr_crypt((byte*)buf.data(), buf.size(), 0, 0x0123456789abcdefULL, withmac ? mac : NULL, true);
+    }
+
+    CtrCase(bool cwithmac) : CryptoCase(cwithmac ? "ctr_crypt+mac" : "ctr_crypt", bufsize)
+    {
+        withmac = cwithmac;
+        randomkey(&key);
+        buf.resize(bufsize);
+    }
+};
+
+struct EcbCase : public CryptoCase
+{
+    SymmCipher key;
+    string buf;
+
+    void op()
+    {
+        key.ecb_encrypt((byte*)buf.data(), NULL, buf.size());
+    }
+
+    EcbCase() : CryptoCase("ecb_encrypt", bufsize)
+    {
+        randomkey(&key);
+        buf.resize(bufsize);
+    }
+};
+
+struct CbcCase : public CryptoCase
+{
+    SymmCipher key;
+    string buf;
+
+    void op()
+    {
+        key.cbc_encrypt((byte*)buf.data(), buf.size());
+    }
+
+    CbcCase() : CryptoCase("cbc_encrypt", bufsize)
+    {
+        randomkey(&key);
+        buf.resize(bufsize);
+    }
+};
+
+// a typical node record
+struct PaddedCbcCase : public CryptoCase
+{
+    static const unsigned RECORDSIZE = 256;
+
+    SymmCipher key;
+    string record;
+
+    void op()
+    {
+        string data = record;
+
+        PaddedCBC::encrypt(&data, &key);
+        PaddedCBC::decrypt(&data, &key);
+    }
+
+    PaddedCbcCase() : CryptoCase("PaddedCBC enc+dec", RECORDSIZE)
+    {
+        randomkey(&key);
+        record.assign(RECORDSIZE, 'r');
+    }
+};
+
+// a batch of node attribute decryptions
+struct AesBatchCase : public CryptoCase
+{
+    static const unsigned JOBS = 256;
+    static const unsigned JOBSIZE = 64;
+
+    byte keys[JOBS][SymmCipher::KEYLENGTH];
+    byte data[JOBS][JOBSIZE];
+
+    void op()
+    {
+        AesBatch batch;
+
+        for (unsigned i = 0; i < JOBS; i++)
+        {
+            batch.add(keys[i], data[i], JOBSIZE, AesBatch::CBC_DECRYPT);
+        }
+
+        batch.run();
+    }
+
+    AesBatchCase() : CryptoCase("AesBatch cbc_decrypt", JOBS * JOBSIZE)
+    {
+        PrnGen::genblock(keys[0], sizeof keys);
+        PrnGen::genblock(data[0], sizeof data);
+    }
+};
+
+// generated once and copied into every instance
+static AsymmCipher rsapriv, rsapub;
+
+struct RsaCase : public CryptoCase
+{
+    AsymmCipher priv;
+    byte ct[AsymmCipher::MAXKEYLENGTH];
+    int ctlen;
+
+    void op()
+    {
+        byte pt[AsymmCipher::MAXKEYLENGTH];
+
+        priv.decrypt(ct, ctlen, pt, SymmCipher::KEYLENGTH);
+    }
+
+    RsaCase() : CryptoCase("RSA-2048 decrypt", 0)
+    {
+        AsymmCipher pub = rsapub;
+        byte pt[SymmCipher::KEYLENGTH];
+
+        priv = rsapriv;
+        PrnGen::genblock(pt, sizeof pt);
+        ctlen = pub.encrypt(pt, sizeof pt, ct, sizeof ct);
+    }
+};
+
+struct PwKeyCase : public CryptoCase
+{
+    void op()
+    {
+        byte pwkey[SymmCipher::KEYLENGTH];
+
+        MegaClient::pw_key("correct horse battery staple", pwkey);
+    }
+
+    PwKeyCase() : CryptoCase("pw_key", 0) { }
+};
+
+struct Crc32Case : public CryptoCase
+{
+    string buf;
+
+    void op()
+    {
+        HashCRC32 crc;
+        byte c[4];
+
+        crc.add((const byte*)buf.data(), buf.size());
+        crc.get(c);
+    }
+
+    Crc32Case() : CryptoCase("HashCRC32", bufsize)
+    {
+        buf.resize(bufsize);
+        PrnGen::genblock((byte*)buf.data(), buf.size());
+    }
+};
+
+#ifdef USE_SODIUM
+struct EdDSACase : public CryptoCase
+{
+    enum { SIGN, VERIFY, PUBKEY } what;
+
+    EdDSA signkey;
+    unsigned char msg[64];
+    unsigned char sig[crypto_sign_BYTES];
+    unsigned char pubkey[crypto_sign_PUBLICKEYBYTES];
+
+    void op()
+    {
+        switch (what)
+        {
+            case SIGN:
+                signkey.sign(msg, sizeof msg, (char*)sig);
+                break;
+
+            case VERIFY:
+                EdDSA::verify(msg, sizeof msg, sig, pubkey);
+                break;
+
+            default:
+                signkey.publicKey(pubkey);
+        }
+    }
+
+    EdDSACase(int cwhat) : CryptoCase(cwhat == SIGN ? "Ed25519 sign"
+                                    : (cwhat == VERIFY ? "Ed25519 verify" : "Ed25519 public key"), 0)
+    {
+        unsigned char sk[crypto_sign_SECRETKEYBYTES];
+
+        what = (cwhat == SIGN) ? SIGN : (cwhat == VERIFY ? VERIFY : PUBKEY);
+
+        signkey.genKeySeed();
+        crypto_sign_seed_keypair(pubkey, sk, signkey.keySeed);
+
+        PrnGen::genblock(msg, sizeof msg);
+        crypto_sign_detached(sig, NULL, msg, sizeof msg, sk);
+    }
+};
+#endif
+
+// NULL past the last case
+static CryptoCase* newcase(int i)
+{
+    switch (i)
+    {
+        case 0: return new CtrCase(false);
+        case 1: return new CtrCase(true);
+        case 2: return new EcbCase;
+        case 3: return new CbcCase;
+        case 4: return new PaddedCbcCase;
+        case 5: return new AesBatchCase;
+        case 6: return new RsaCase;
+        case 7: return new PwKeyCase;
+        case 8: return new Crc32Case;
+#ifdef USE_SODIUM
+        case 9: return new EdDSACase(EdDSACase::SIGN);
+        case 10: return new EdDSACase(EdDSACase::VERIFY);
+        case 11: return new EdDSACase(EdDSACase::PUBKEY);
+#endif
+    }
+
+    return NULL;
+}
+
+struct BenchThread
+{
+    CryptoCase* c;
+    int64_t deadline;
+    uint64_t ops;
+    MegaThread thread;
+};
+
+static void* runcase(void* p)
+{
+    BenchThread* t = (BenchThread*)p;
+
+    do {
+        t->c->op();
+        t->ops++;
+    } while (Waiter::us() < t->deadline);
+
+    return NULL;
+}
+
+// operations per second of the case index on n threads at once
+static double measure(int i, int n, double seconds)
+{
+    // (threads are not copyable)
+    BenchThread* threads = new BenchThread[n];
+
+    for (int t = 0; t < n; t++)
+    {
+        threads[t].c = newcase(i);
+        threads[t].ops = 0;
+    }
+
+    int64_t start = Waiter::us();
+
+    for (int t = 0; t < n; t++)
+    {
+        threads[t].deadline = start + (int64_t)(seconds * 1000000);
+    }
+
+    if (n == 1)
+    {
+        runcase(&threads[0]);
+    }
+    else
+    {
+        for (int t = 0; t < n; t++)
+        {
+            threads[t].thread.start(runcase, &threads[t]);
+        }
+
+        for (int t = 0; t < n; t++)
+        {
+            threads[t].thread.join();
+        }
+    }
+
+    int64_t elapsed = Waiter::us() - start;
+    uint64_t ops = 0;
+
+    for (int t = 0; t < n; t++)
+    {
+        ops += threads[t].ops;
+        delete threads[t].c;
+    }
+
+    delete[] threads;
+
+    return elapsed > 0 ? ops * 1000000.0 / elapsed : 0;
+}
+
+static void report(CryptoCase* c, double rate)
+{
+    if (c->opbytes)
+    {
+        cout << setw(10) << rate * c->opbytes / 1048576 << " MB/s";
+    }
+    else
+    {
+        cout << setw(10) << rate << " op/s";
+    }
+}
+
+static int cores()
+{
+#ifdef _WIN32
+    SYSTEM_INFO si;
+
+    GetSystemInfo(&si);
+    return si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (int)n : 1;
+#endif
+}
+
+static int usage()
+{
+    cerr << "usage: crypto_bench [-b buffer size] [-s seconds per case] [-t threads]" << endl;
+
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    double seconds = 1;
+    int threads = cores();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || !argv[i][1] || argv[i][2] || i + 1 >= argc)
+        {
+            return usage();
+        }
+
+        const char* v = argv[++i];
+
+        switch (argv[i - 1][1])
+        {
+            case 'b': bufsize = atoi(v); break;
+            case 's': seconds = atof(v); break;
+            case 't': threads = atoi(v); break;
+            default: return usage();
+        }
+    }
+
+    // whole AES blocks
+    bufsize &= -SymmCipher::BLOCKSIZE;
+
+    if (!bufsize || seconds <= 0 || threads < 1)
+    {
+        return usage();
+    }
+
+#ifdef USE_SODIUM
+    EdDSA::init();
+#endif
+
+    rsapriv.genkeypair(rsapriv.key, rsapub.key, 2048);
+
+    cout << "Crypto backend: " << (CryptoBackend::active ? CryptoBackend::active->name() : "Crypto++") << endl
+         << "CRC32: " << (FastCRC32::accelerated() ? "hardware" : "tables") << endl
+         << "AesBatch: " << (AesBatch::accelerated() ? "AES-NI lanes" : "sequential") << endl
+         << "Buffer: " << bufsize << " bytes, " << threads << " threads" << endl;
+
+    cout << fixed << setprecision(1);
+
+    CryptoCase* c;
+
+    for (int i = 0; (c = newcase(i)); i++)
+    {
+        cout << setw(22) << left << c->name << right;
+        report(c, measure(i, 1, seconds));
+
+        if (threads > 1)
+        {
+            cout << "  x" << threads << ":";
+            report(c, measure(i, threads, seconds));
+        }
+
+        cout << endl;
+
+        delete c;
+    }
+
+    return 0;
+}
@@ -0,0 +1,763 @@
+/**
+ * @file tests/fetchnodes_bench.cpp
+ * @brief Offline replay of fetchnodes responses and action packet streams
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// replays a "f" response and a server-client action packet stream through
+// the unmodified engine (CommandFetchNodes, readnodes(), applykeys(),
+// initsc(), procsc(), updatesc()) over SimHttpIO and reports:
+// - the raw JSON parse time of the response
+// - the startup phases: node parsing, share merging, key and attribute
+//   decryption
+// - the time to write the state cache snapshot and the commit durations
+// - the time to apply the action packets (including the cache update)
+// - the peak memory, the node tree footprint and the cost per node
+//
+// the response and the stream are either synthesized (a random tree of
+// -n nodes, -a action packets: new files, renames and deletions) or read
+// from recorded files: -f holds the result object of the "f" command and
+// -c a server-client response, -k and -u give the master key and user
+// handle (base64) they were recorded with
+//
+// usage: fetchnodes_bench [-n nodes] [-a action packets] [-d dir] [-b API bytes/s]
+//                         [-l] [-r seed] [-t timeout]
+//                         [-f response -k master key -u user handle [-c stream]]
+
+#include "mega.h"
+#include "simhttpio.h"
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace mega;
+
+static const char* const phasenames[STARTUP_NUMPHASES] = {
+    "login", "dbopen", "cacheload", "fetchnodes", "connect", "response",
+    "readnodes", "shares", "keys", "current"
+};
+
+struct BenchApp : public MegaApp
+{
+    // completion times (Waiter::us(), 0: not yet)
+    int64_t fetched;
+    int64_t snapshotted;
+    int64_t current;
+
+    error e;
+
+    void fetchnodes_result(error ce)
+    {
+        e = ce;
+        fetched = Waiter::us();
+    }
+
+    void nodes_updated(Node**, int)
+    {
+        // the first notification follows the snapshot of initsc()
+        if (fetched && !snapshotted)
+        {
+            snapshotted = Waiter::us();
+        }
+    }
+
+    void nodes_current()
+    {
+        current = Waiter::us();
+    }
+
+    BenchApp()
+    {
+        fetched = 0;
+        snapshotted = 0;
+        current = 0;
+        e = API_OK;
+    }
+};
+
+// serves the "f" command and the action packets once, then current state
+struct ReplayHttpIO : public SimHttpIO
+{
+    string response;
+    string stream;
+
+    // time the action packets were served
+    int64_t streamed;
+
+    bool waitsent;
+
+    bool command(const string* a, const string*, string* out)
+    {
+        if (*a != "f" || !response.size())
+        {
+            return false;
+        }
+
+        out->append(response);
+        string().swap(response);
+
+        return true;
+    }
+
+    bool serverclient(const string*, string* out)
+    {
+        if (stream.size())
+        {
+            out->swap(stream);
+            string().swap(stream);
+            streamed = Waiter::us();
+
+            return true;
+        }
+
+        if (!waitsent)
+        {
+            *out = "{\"w\":\"" + MegaClient::APIURL + "wsc\"}";
+            waitsent = true;
+
+            return true;
+        }
+
+        return false;
+    }
+
+    ReplayHttpIO(uint32_t seed) : SimHttpIO(seed)
+    {
+        streamed = 0;
+        waitsent = false;
+    }
+};
+
+// synthetic account: a random tree and action packets on it
+struct Generator
+{
+    MegaClient* client;
+    uint32_t seed;
+    handle nexthandle;
+
+    vector<handle> folders;
+    vector<handle> files;
+
+    uint32_t random()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    }
+
+    // the node keys are derived from the handles, so they need not be kept
+    static void nodekey(handle h, byte* key, int len)
+    {
+        uint32_t s = (uint32_t)(h ^ (h >> 32)) | 1;
+
+        for (int i = 0; i < len; i++)
+        {
+            s ^= s << 13;
+            s ^= s >> 17;
+            s ^= s << 5;
+            key[i] = (byte)s;
+        }
+    }
+
+    static void appendbase64(string* s, const byte* data, int len)
+    {
+        char buf[64];
+
+        s->append(buf, Base64::btoa(data, len, buf));
+    }
+
+    void appendattr(string* s, handle h, nodetype_t type, const char* name)
+    {
+        byte key[FILENODEKEYLENGTH];
+        SymmCipher cipher;
+        string json, attr;
+
+        nodekey(h, key, type == FILENODE ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+        cipher.setkey(key, type);
+
+        json = string("\"n\":\"") + name + "\"";
+        client->makeattr(&cipher, &attr, json.c_str());
+
+        char* buf = new char[attr.size() * 4 / 3 + 4];
+
+        s->append(buf, Base64::btoa((const byte*)attr.data(), attr.size(), buf));
+        delete[] buf;
+    }
+
+    void appendnode(string* s, handle h, handle p, nodetype_t type, const char* name, m_off_t size)
+    {
+        char buf[32];
+
+        s->append("{\"h\":\"");
+        appendbase64(s, (byte*)&h, MegaClient::NODEHANDLE);
+
+        if (type == FILENODE || type == FOLDERNODE)
+        {
+            int len = type == FILENODE ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+            byte key[FILENODEKEYLENGTH];
+
+            nodekey(h, key, len);
+
+            for (int i = 0; i < len; i += SymmCipher::BLOCKSIZE)
+            {
+                client->key.ecb_encrypt(key + i);
+            }
+
+            s->append("\",\"p\":\"");
+            appendbase64(s, (byte*)&p, MegaClient::NODEHANDLE);
+            s->append("\",\"u\":\"");
+            appendbase64(s, (byte*)&client->me, MegaClient::USERHANDLE);
+            sprintf(buf, "\",\"t\":%d,\"a\":\"", type);
+            s->append(buf);
+            appendattr(s, h, type, name);
+            s->append("\",\"k\":\"");
+            appendbase64(s, (byte*)&client->me, MegaClient::USERHANDLE);
+            s->append(":");
+            appendbase64(s, key, len);
+            s->append("\"");
+
+            if (type == FILENODE)
+            {
+                sprintf(buf, ",\"s\":%" PRId64, size);
+                s->append(buf);
+            }
+        }
+        else
+        {
+            sprintf(buf, "\",\"t\":%d,\"a\":\"\",\"k\":\"\"", type);
+            s->append(buf);
+        }
+
+        sprintf(buf, ",\"ts\":%u}", 1400000000 + (unsigned)(h % 100000000));
+        s->append(buf);
+    }
+
+    handle newnode(string* s, bool folder)
+    {
+        handle h = nexthandle++;
+        handle p = folders[random() % folders.size()];
+        char name[32];
+
+        if (folder)
+        {
+            sprintf(name, "folder%u", (unsigned)folders.size());
+            appendnode(s, h, p, FOLDERNODE, name, -1);
+            folders.push_back(h);
+        }
+        else
+        {
+            sprintf(name, "file%u.bin", (unsigned)files.size());
+            appendnode(s, h, p, FILENODE, name, random() % 10000000);
+            files.push_back(h);
+        }
+
+        return h;
+    }
+
+    // the result object of the "f" command: the root nodes and a tree of
+    // nodes (one folder per ten), parents before children
+    void fetchresponse(string* s, int nodes, handle sn)
+    {
+        s->append("{\"f\":[");
+
+        for (int t = ROOTNODE; t <= RUBBISHNODE; t++)
+        {
+            if (t != ROOTNODE)
+            {
+                s->append(",");
+            }
+
+            appendnode(s, nexthandle, UNDEF, (nodetype_t)t, NULL, -1);
+
+            if (t == ROOTNODE)
+            {
+                folders.push_back(nexthandle);
+            }
+
+            nexthandle++;
+        }
+
+        for (int i = 0; i < nodes; i++)
+        {
+            s->append(",");
+            newnode(s, !(random() % 10));
+        }
+
+        s->append("],\"ok\":[],\"s\":[],\"sn\":\"");
+        appendbase64(s, (byte*)&sn, sizeof sn);
+        s->append("\"}");
+    }
+
+    // new files, renames and deletions (4:4:2) of distinct existing files,
+    // returns the change of the node count
+    int packets(string* s, int count, handle sn)
+    {
+        int delta = 0;
+        size_t picked = 0;
+
+        s->append("{\"a\":[");
+
+        for (int i = 0; i < count; i++)
+        {
+            int kind = random() % 10;
+
+            if (i)
+            {
+                s->append(",");
+            }
+
+            if (kind < 4 || picked >= files.size())
+            {
+                s->append("{\"a\":\"t\",\"t\":{\"f\":[");
+                newnode(s, false);
+                s->append("]}}");
+                delta++;
+                continue;
+            }
+
+            // partial shuffle: the target is a file not picked before
+            size_t j = picked + random() % (files.size() - picked);
+            handle h = files[j];
+
+            files[j] = files[picked];
+            files[picked++] = h;
+
+            if (kind < 8)
+            {
+                char name[32];
+
+                sprintf(name, "renamed%d.bin", i);
+                s->append("{\"a\":\"u\",\"n\":\"");
+                appendbase64(s, (byte*)&h, MegaClient::NODEHANDLE);
+                s->append("\",\"u\":\"");
+                appendbase64(s, (byte*)&client->me, MegaClient::USERHANDLE);
+                s->append("\",\"at\":\"");
+                appendattr(s, h, FILENODE, name);
+                s->append("\",\"ts\":1500000000}");
+            }
+            else
+            {
+                s->append("{\"a\":\"d\",\"n\":\"");
+                appendbase64(s, (byte*)&h, MegaClient::NODEHANDLE);
+                s->append("\"}");
+                delta--;
+            }
+        }
+
+        s->append("],\"sn\":\"");
+        appendbase64(s, (byte*)&sn, sizeof sn);
+        s->append("\"}");
+
+        return delta;
+    }
+
+    Generator(MegaClient* cclient, uint32_t cseed)
+    {
+        client = cclient;
+        seed = cseed;
+        nexthandle = 0x100000000ULL;
+    }
+};
+
+static bool readfile(const char* path, string* data)
+{
+    FILE* fp = fopen(path, "rb");
+    char buf[65536];
+    size_t n;
+
+    if (!fp)
+    {
+        return false;
+    }
+
+    while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+    {
+        data->append(buf, n);
+    }
+
+    fclose(fp);
+
+    return true;
+}
+
+// peak resident memory in KB (0: unknown)
+static long peakkb()
+{
+#ifdef __linux__
+    FILE* fp = fopen("/proc/self/status", "r");
+    char line[128];
+    long kb = 0;
+
+    if (fp)
+    {
+        while (fgets(line, sizeof line, fp))
+        {
+            if (!strncmp(line, "VmHWM:", 6))
+            {
+                kb = atol(line + 6);
+                break;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    return kb;
+#elif !defined(_WIN32)
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru))
+    {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+static double ms(int64_t us)
+{
+    return us / 1000.0;
+}
+
+static int usage()
+{
+    cerr << "usage: fetchnodes_bench [-n nodes] [-a action packets] [-d dir] [-b API bytes/s]" << endl
+         << "                        [-l] [-r seed] [-t timeout]" << endl
+         << "                        [-f response -k master key -u user handle [-c stream]]" << endl;
+
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    int nodes = 100000, packets = 10000;
+    const char* dir = "fetchnodes_bench.tmp";
+    long long bandwidth = 0;
+    bool lazy = false;
+    uint32_t seed = 1;
+    int timeout = 3600;
+    const char* responsefile = NULL;
+    const char* streamfile = NULL;
+    const char* masterkey = NULL;
+    const char* userhandle = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || !argv[i][1] || argv[i][2])
+        {
+            return usage();
+        }
+
+        if (argv[i][1] == 'l')
+        {
+            lazy = true;
+            continue;
+        }
+
+        if (i + 1 >= argc)
+        {
+            return usage();
+        }
+
+        const char* v = argv[++i];
+
+        switch (argv[i - 1][1])
+        {
+            case 'n': nodes = atoi(v); break;
+            case 'a': packets = atoi(v); break;
+            case 'd': dir = v; break;
+            case 'b': bandwidth = atoll(v); break;
+            case 'r': seed = (uint32_t)atol(v); break;
+            case 't': timeout = atoi(v); break;
+            case 'f': responsefile = v; break;
+            case 'c': streamfile = v; break;
+            case 'k': masterkey = v; break;
+            case 'u': userhandle = v; break;
+            default: return usage();
+        }
+    }
+
+    if (responsefile && (!masterkey || !userhandle))
+    {
+        return usage();
+    }
+
+    SimpleLogger::setLogLevel(logError);
+    SimpleLogger::setAllOutputs(&std::cerr);
+
+    WAIT_CLASS::bumpds();
+
+    BenchApp app;
+    ReplayHttpIO* sim = new ReplayHttpIO(seed);
+    FileSystemAccess* fsaccess = new FSACCESS_CLASS;
+    string path = dir, localdir;
+
+    fsaccess->path2local(&path, &localdir);
+
+    if (!fsaccess->mkdirlocal(&localdir))
+    {
+        cerr << "Could not create " << dir << " (it must not exist)" << endl;
+        return 1;
+    }
+
+#ifdef DBACCESS_CLASS
+    string dbpath = path + "/";
+    DbAccess* dbaccess = new DBACCESS_CLASS(&dbpath);
+#else
+    DbAccess* dbaccess = NULL;
+#endif
+
+    MegaClient* client = new MegaClient(&app, new WAIT_CLASS, sim, fsaccess, dbaccess, NULL,
+                                        "fetchnodes_bench", "fetchnodes_bench");
+
+    sim->api.bandwidth = bandwidth;
+
+    // a session: master key, user handle and session ID (naming the state
+    // cache), without a login
+    byte key[SymmCipher::KEYLENGTH];
+    byte sid[MegaClient::SIDLEN];
+    Generator gen(client, seed);
+
+    for (unsigned i = 0; i < sizeof sid; i++)
+    {
+        sid[i] = (byte)gen.random();
+    }
+
+    client->sid.assign((char*)sid, sizeof sid);
+
+    size_t expected = 0;
+
+    if (responsefile)
+    {
+        if (Base64::atob(masterkey, key, sizeof key) != sizeof key
+         || Base64::atob(userhandle, (byte*)&client->me, MegaClient::USERHANDLE) != MegaClient::USERHANDLE)
+        {
+            return usage();
+        }
+
+        client->key.setkey(key);
+
+        if (!readfile(responsefile, &sim->response) || (streamfile && !readfile(streamfile, &sim->stream)))
+        {
+            cerr << "Could not read the recorded response" << endl;
+            return 1;
+        }
+    }
+    else
+    {
+        for (unsigned i = 0; i < sizeof key; i++)
+        {
+            key[i] = (byte)gen.random();
+        }
+
+        client->key.setkey(key);
+        client->me = 0x424242424242ULL;
+
+        handle sn = 1;
+
+        gen.fetchresponse(&sim->response, nodes, sn);
+        expected = 3 + nodes;
+
+        if (packets)
+        {
+            sn = 2;
+            expected += gen.packets(&sim->stream, packets, sn);
+        }
+    }
+
+    size_t responsebytes = sim->response.size();
+    size_t streambytes = sim->stream.size();
+
+    // the tokenizer alone, as a reference for the node parsing
+    JSON json;
+    int64_t t = Waiter::us();
+
+    json.begin(sim->response.c_str());
+    json.storeobject();
+
+    int64_t parsed = Waiter::us() - t;
+
+    long basekb = peakkb();
+
+    cout << "Response: " << responsebytes << " bytes, action packets: " << streambytes << " bytes" << endl;
+    cout << "JSON parse: " << ms(parsed) << " ms" << endl;
+
+    client->lazyattrs = lazy;
+
+    int64_t start = Waiter::us();
+    int64_t deadline = start + (int64_t)timeout * 1000000;
+    int64_t done = 0;
+
+    client->fetchnodes();
+
+    while (Waiter::us() < deadline)
+    {
+        client->exec();
+
+        if (app.fetched && app.e != API_OK)
+        {
+            cerr << "fetchnodes failed: " << app.e << endl;
+            return 1;
+        }
+
+        // (notifypurge() and updatesc() have run in this exec())
+        if (app.current)
+        {
+            done = Waiter::us();
+            break;
+        }
+
+        client->wait();
+    }
+
+    if (!done)
+    {
+        cerr << "The state did not become current before the deadline" << endl;
+        return 1;
+    }
+
+    size_t count = client->nodes.size();
+    StartupTrace* trace = &client->startup;
+
+    cout << "Nodes: " << count;
+
+    if (expected)
+    {
+        cout << " (expected " << expected << ")";
+    }
+
+    cout << endl << "Startup phases (ms):";
+
+    for (int i = 0; i < STARTUP_NUMPHASES; i++)
+    {
+        if (trace->started[i] >= 0 && trace->finished[i] >= trace->started[i])
+        {
+            cout << " " << phasenames[i] << " " << ms(trace->finished[i] - trace->started[i]);
+        }
+    }
+
+    cout << endl;
+
+    if (app.fetched && app.snapshotted)
+    {
+        cout << "State cache snapshot: " << ms(app.snapshotted - app.fetched) << " ms";
+
+        if (client->enginestats.dbcommits.count)
+        {
+            cout << " (" << client->enginestats.dbcommits.count << " commits, "
+                 << ms(client->enginestats.dbcommits.total) << " ms)";
+        }
+
+        cout << endl;
+    }
+
+    if (sim->streamed)
+    {
+        cout << "Action packets: " << client->enginestats.actionpackets << " in " << ms(done - sim->streamed) << " ms";
+
+        if (client->enginestats.actionpackets)
+        {
+            cout << " (" << (done - sim->streamed) / client->enginestats.actionpackets << " us per packet)";
+        }
+
+        cout << endl;
+    }
+
+    if (lazy)
+    {
+        t = Waiter::us();
+        client->resolveattrs();
+
+        cout << "Deferred attributes: " << ms(Waiter::us() - t) << " ms" << endl;
+    }
+
+    // nodes whose key or attributes could not be decrypted
+    size_t undecrypted = 0;
+
+    for (node_map::iterator it = client->nodes.begin(); it != client->nodes.end(); it++)
+    {
+        if (it->second->attrstring)
+        {
+            undecrypted++;
+        }
+    }
+
+    if (undecrypted)
+    {
+        cout << "Undecrypted nodes: " << undecrypted << endl;
+    }
+
+    size_t nodebytes, indexbytes;
+    long kb = peakkb();
+
+    client->nodememory(&nodebytes, &indexbytes);
+
+    cout << "Memory: " << nodebytes << " bytes of nodes, " << indexbytes << " bytes of indexes";
+
+    if (kb)
+    {
+        cout << ", peak RSS " << kb << " KB (" << (kb - basekb) << " KB over the generated input)";
+    }
+
+    cout << endl;
+
+    if (count)
+    {
+        cout << "Per node: " << (double)(app.fetched - start) / count << " us to load, "
+             << (nodebytes + indexbytes) / count << " bytes" << endl;
+    }
+
+    // close the state cache, then remove its files
+    string dbname;
+
+    dbname.resize((MegaClient::SIDLEN - sizeof key) * 4 / 3 + 3);
+    dbname.resize(Base64::btoa((const byte*)client->sid.data() + sizeof key, MegaClient::SIDLEN - sizeof key,
+                               (char*)dbname.c_str()));
+
+    delete client;
+    delete sim;
+
+    static const char* const tables[] = { "", "_gfx", "_transfers" };
+    static const char* const suffixes[] = { ".db", ".db-wal", ".db-shm" };
+
+    for (unsigned i = 0; i < sizeof tables / sizeof *tables; i++)
+    {
+        for (unsigned j = 0; j < sizeof suffixes / sizeof *suffixes; j++)
+        {
+            string name = path + "/megaclient_statecache7_" + dbname + tables[i] + suffixes[j];
+            string localname;
+
+            fsaccess->path2local(&name, &localname);
+            fsaccess->unlinklocal(&localname);
+        }
+    }
+
+    if (!fsaccess->rmdirlocal(&localdir))
+    {
+        cerr << "Could not remove " << dir << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+/**
+ * @file tests/gfx_bench.cpp
+ * @brief Thumbnail and preview generation throughput of the graphics backend
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// runs the graphics backend this SDK was built with (FreeImage, Qt,
+// CoreGraphics) over a corpus of images, exactly as the gfx worker pool
+// does (GfxJob::run()), and reports for each image:
+// - the latency of a thumbnail-only, a preview-only and a combined pass
+//   (the latter is what uploads use)
+// - the size of the generated thumbnail and preview
+// - the peak memory of the combined pass (Linux: per image, elsewhere the
+//   peak of the process so far)
+// followed by the throughput over the whole corpus
+//
+// usage: gfx_bench [-r repetitions] [-l decode limit] file...
+
+#include "mega.h"
+#include "megaapi_impl.h"
+
+#include <iomanip>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+using namespace mega;
+
+struct BenchApp : public MegaApp
+{
+};
+
+static const char* backendname()
+{
+#ifdef USE_QT
+    return "Qt";
+#elif USE_FREEIMAGE
+#ifdef USE_FFMPEG
+    return "FreeImage + FFmpeg";
+#else
+    return "FreeImage";
+#endif
+#elif TARGET_OS_IPHONE
+    return "CoreGraphics";
+#else
+    return NULL;
+#endif
+}
+
+// restart the peak memory measurement, false if not supported
+static bool resetpeak()
+{
+#ifdef __linux__
+    FILE* fp = fopen("/proc/self/clear_refs", "w");
+
+    if (fp)
+    {
+        bool ok = fputs("5", fp) >= 0;
+
+        fclose(fp);
+        return ok;
+    }
+#endif
+
+    return false;
+}
+
+// peak resident memory in KB (0: unknown)
+static long peakkb()
+{
+#ifdef __linux__
+    FILE* fp = fopen("/proc/self/status", "r");
+    char line[128];
+    long kb = 0;
+
+    if (fp)
+    {
+        while (fgets(line, sizeof line, fp))
+        {
+            if (!strncmp(line, "VmHWM:", 6))
+            {
+                kb = atol(line + 6);
+                break;
+            }
+        }
+
+        fclose(fp);
+    }
+
+    return kb;
+#elif !defined(_WIN32)
+    struct rusage ru;
+
+    if (getrusage(RUSAGE_SELF, &ru))
+    {
+        return 0;
+    }
+
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#else
+    return 0;
+#endif
+}
+
+struct PassResult
+{
+    // mean latency in milliseconds
+    double ms;
+
+    // output bytes per dimension (0: not generated)
+    size_t bytes[GfxProc::NUMDIMENSIONS];
+};
+
+// generate the dimensions in missing reps times
+static void runpass(GfxProc* gfx, string* localname, int missing, int reps, PassResult* result)
+{
+    SymmCipher key;
+    int64_t start = Waiter::us();
+
+    for (int i = GfxProc::NUMDIMENSIONS; i--; )
+    {
+        result->bytes[i] = 0;
+    }
+
+    for (int r = 0; r < reps; r++)
+    {
+        GfxJob job(gfx, localname, UNDEF, &key, missing, NULL);
+
+        job.run();
+
+        for (int i = GfxProc::NUMDIMENSIONS; i--; )
+        {
+            result->bytes[i] = job.images[i] ? job.images[i]->size() : 0;
+        }
+    }
+
+    result->ms = (Waiter::us() - start) / 1000.0 / reps;
+}
+
+static int usage()
+{
+    cerr << "usage: gfx_bench [-r repetitions] [-l decode limit] file..." << endl;
+
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    int reps = 3;
+    m_off_t limit = -1;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (!argv[i][1] || argv[i][2] || i + 1 >= argc)
+        {
+            return usage();
+        }
+
+        const char* v = argv[++i];
+
+        switch (argv[i - 1][1])
+        {
+            case 'r': reps = atoi(v); break;
+            case 'l': limit = atoll(v); break;
+            default: return usage();
+        }
+    }
+
+    if (i == argc || reps < 1)
+    {
+        return usage();
+    }
+
+    if (!backendname())
+    {
+        cerr << "No built-in graphics backend (the external processor needs an application)" << endl;
+        return 1;
+    }
+
+    SimpleLogger::setLogLevel(logError);
+    SimpleLogger::setAllOutputs(&std::cerr);
+
+    BenchApp app;
+    MegaGfxProc* gfx = new MegaGfxProc;
+    MegaClient* client = new MegaClient(&app, new WAIT_CLASS, new HTTPIO_CLASS, new FSACCESS_CLASS,
+                                        NULL, gfx, "gfx_bench", "gfx_bench");
+
+    if (limit >= 0)
+    {
+        gfx->decodelimit = limit;
+    }
+
+    bool perimagepeak = resetpeak();
+
+    cout << "Backend: " << backendname() << endl
+         << "Repetitions: " << reps << ", peak memory " << (perimagepeak ? "per image" : "of the process") << endl;
+
+    cout << fixed << setprecision(1);
+    cout << setw(40) << left << "image" << right
+         << setw(10) << "KB"
+         << setw(10) << "thumb ms"
+         << setw(10) << "prev ms"
+         << setw(10) << "both ms"
+         << setw(10) << "thumb B"
+         << setw(10) << "prev B"
+         << setw(10) << "peak MB" << endl;
+
+    int images = 0, failed = 0;
+    double totalms = 0;
+    m_off_t totalbytes = 0;
+
+    for (; i < argc; i++)
+    {
+        string path = argv[i];
+        string localname;
+        FileAccess* fa = client->fsaccess->newfileaccess();
+        m_off_t size = -1;
+
+        client->fsaccess->path2local(&path, &localname);
+
+        if (fa->fopen(&localname, true, false))
+        {
+            size = fa->size;
+        }
+
+        delete fa;
+
+        if (size < 0 || !gfx->isgfx(&localname))
+        {
+            cout << setw(40) << left << path << right << "  (not readable or not supported)" << endl;
+            continue;
+        }
+
+        PassResult thumb, preview, both;
+
+        runpass(gfx, &localname, 1 << GfxProc::THUMBNAIL120X120, reps, &thumb);
+        runpass(gfx, &localname, 1 << GfxProc::PREVIEW1000x1000, reps, &preview);
+
+        resetpeak();
+        runpass(gfx, &localname, (1 << GfxProc::NUMDIMENSIONS) - 1, reps, &both);
+
+        long peak = peakkb();
+
+        // (long names are truncated at the front, keeping the file name)
+        string shown = path.size() > 38 ? path.substr(path.size() - 38) : path;
+
+        cout << setw(40) << left << shown << right
+             << setw(10) << size / 1024.0
+             << setw(10) << thumb.ms
+             << setw(10) << preview.ms
+             << setw(10) << both.ms
+             << setw(10) << both.bytes[GfxProc::THUMBNAIL120X120]
+             << setw(10) << both.bytes[GfxProc::PREVIEW1000x1000]
+             << setw(10) << peak / 1024.0 << endl;
+
+        if (!both.bytes[GfxProc::THUMBNAIL120X120] && !both.bytes[GfxProc::PREVIEW1000x1000])
+        {
+            failed++;
+        }
+        else
+        {
+            images++;
+            totalms += both.ms;
+            totalbytes += size;
+        }
+    }
+
+    if (images)
+    {
+        cout << endl << images << " images (" << failed << " without output): "
+             << images * 1000.0 / totalms << " images/s, "
+             << totalbytes / 1048576.0 * 1000.0 / totalms << " MB/s of input, "
+             << totalms / images << " ms per image" << endl;
+    }
+
+    delete client;
+
+    return 0;
+}
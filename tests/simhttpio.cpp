@@ -0,0 +1,562 @@
+/**
+ * @file tests/simhttpio.cpp
+ * @brief Simulated network for offline transfer engine benchmarks
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "simhttpio.h"
+
+namespace mega {
+SimHost::SimHost()
+{
+    bandwidth = 0;
+    latency = 0;
+    loss = 0;
+    failures = 0;
+    overquota = 0;
+    down = false;
+
+    requests = 0;
+    failed = 0;
+    bytesout = 0;
+    bytesin = 0;
+}
+
+SimHttpIO::SimHttpIO(uint32_t seed)
+{
+    rng = seed ? seed : 1;
+    nextupload = 0;
+    nexthost = 0;
+    peakinflight = 0;
+    lastio = now();
+
+    chunkedok = true;
+}
+
+SimHttpIO::~SimHttpIO()
+{
+    for (list<Request*>::iterator it = requests.begin(); it != requests.end(); it++)
+    {
+        (*it)->req->httpiohandle = NULL;
+        delete *it;
+    }
+}
+
+int64_t SimHttpIO::now()
+{
+    return Waiter::us() / 1000;
+}
+
+double SimHttpIO::random()
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+
+    return rng / 4294967296.0;
+}
+
+SimHost* SimHttpIO::host(const char* name)
+{
+    map<string, SimHost>::iterator it = hosts.find(name);
+
+    if (it == hosts.end())
+    {
+        it = hosts.insert(pair<string, SimHost>(name, defaults)).first;
+    }
+
+    return &it->second;
+}
+
+void SimHttpIO::addfile(handle h, const char* hostname, const string* data, const string* at)
+{
+    Object* o = &files[h];
+    char buf[32];
+
+    Base64::btoa((byte*)&h, MegaClient::NODEHANDLE, buf);
+
+    o->data = data;
+    o->size = data->size();
+    o->received = 0;
+    o->url = string("http://") + hostname + "/dl/" + buf;
+    o->at = *at;
+}
+
+string SimHttpIO::hostname(const string* url)
+{
+    size_t start = url->find("//");
+    size_t end;
+
+    if (start == string::npos)
+    {
+        return "";
+    }
+
+    start += 2;
+    end = url->find_first_of(":/", start);
+
+    return url->substr(start, end == string::npos ? string::npos : end - start);
+}
+
+void SimHttpIO::splitbatch(const string* batch, vector<string>* objects)
+{
+    int depth = 0;
+    bool quoted = false;
+    size_t start = 0;
+
+    for (size_t i = 0; i < batch->size(); i++)
+    {
+        char c = (*batch)[i];
+
+        if (quoted)
+        {
+            if (c == '\\')
+            {
+                i++;
+            }
+            else if (c == '"')
+            {
+                quoted = false;
+            }
+        }
+        else if (c == '"')
+        {
+            quoted = true;
+        }
+        else if (c == '{' && !depth++)
+        {
+            start = i;
+        }
+        else if (c == '}' && !--depth)
+        {
+            objects->push_back(batch->substr(start, i - start + 1));
+        }
+    }
+}
+
+bool SimHttpIO::field(const string* object, const char* name, string* value)
+{
+    string key = string("\"") + name + "\":";
+    size_t pos = object->find(key);
+
+    if (pos == string::npos)
+    {
+        return false;
+    }
+
+    pos += key.size();
+
+    if (pos < object->size() && (*object)[pos] == '"')
+    {
+        size_t end = object->find('"', ++pos);
+
+        value->assign(*object, pos, end == string::npos ? string::npos : end - pos);
+    }
+    else
+    {
+        size_t end = object->find_first_of(",}", pos);
+
+        value->assign(*object, pos, end == string::npos ? string::npos : end - pos);
+    }
+
+    return true;
+}
+
+// answer the commands of a batch
+void SimHttpIO::apirequest(Request* r)
+{
+    if (r->req->posturl.find("/sc?") != string::npos || r->req->posturl.find("/wsc") != string::npos)
+    {
+        r->hold = !serverclient(&r->req->posturl, &r->response);
+        return;
+    }
+
+    if (r->req->posturl.find("/cs?") == string::npos)
+    {
+        r->response = "0";
+        return;
+    }
+
+    vector<string> commands;
+    string a, value;
+
+    splitbatch(&r->body, &commands);
+
+    r->response = "[";
+
+    for (unsigned i = 0; i < commands.size(); i++)
+    {
+        ostringstream oss;
+
+        if (i)
+        {
+            r->response.append(",");
+        }
+
+        a.clear();
+        field(&commands[i], "a", &a);
+
+        if (command(&a, &commands[i], &r->response))
+        {
+            continue;
+        }
+
+        if (a == "g" && (field(&commands[i], "p", &value) || field(&commands[i], "n", &value)))
+        {
+            handle h = 0;
+            map<handle, Object>::iterator it;
+
+            Base64::atob(value.c_str(), (byte*)&h, MegaClient::NODEHANDLE);
+
+            if ((it = files.find(h)) == files.end())
+            {
+                r->response.append("-9");
+                continue;
+            }
+
+            oss << "{\"s\":" << it->second.size << ",\"at\":\"" << it->second.at
+                << "\",\"g\":\"" << it->second.url << "\"}";
+        }
+        else if (a == "u" && uploadhosts.size() && field(&commands[i], "s", &value))
+        {
+            Object* o = &uploads[nextupload];
+
+            o->data = NULL;
+            o->size = atoll(value.c_str());
+            o->received = 0;
+
+            oss << "{\"p\":\"http://" << uploadhosts[nexthost++ % uploadhosts.size()]
+                << "/ul/" << nextupload++ << "\"}";
+        }
+        else
+        {
+            oss << "0";
+        }
+
+        r->response.append(oss.str());
+    }
+
+    r->response.append("]");
+}
+
+// serve a chunk request: .../dl/<handle>/<from>-<to> or .../ul/<id>/<pos>
+void SimHttpIO::storagerequest(Request* r)
+{
+    const string* url = &r->req->posturl;
+    size_t pos;
+
+    if ((pos = url->find("/dl/")) != string::npos)
+    {
+        handle h = 0;
+        size_t slash = url->find('/', pos + 4);
+        long long from = 0, to = -1;
+        map<handle, Object>::iterator it;
+
+        if (slash != string::npos)
+        {
+            Base64::atob(url->substr(pos + 4, slash - pos - 4).c_str(), (byte*)&h, MegaClient::NODEHANDLE);
+            sscanf(url->c_str() + slash + 1, "%lld-%lld", &from, &to);
+        }
+
+        if ((it = files.find(h)) == files.end() || from < 0 || to < from || to >= it->second.size)
+        {
+            r->failstatus = 404;
+            return;
+        }
+
+        r->response.assign(*it->second.data, from, to - from + 1);
+        return;
+    }
+
+    if ((pos = url->find("/ul/")) != string::npos)
+    {
+        map<int, Object>::iterator it = uploads.find(atoi(url->c_str() + pos + 4));
+
+        if (it == uploads.end())
+        {
+            r->failstatus = 404;
+            return;
+        }
+
+        r->upload = &it->second;
+        return;
+    }
+
+    r->failstatus = 404;
+}
+
+void SimHttpIO::post(HttpReq* req, const char* data, unsigned len)
+{
+    Request* r = new Request;
+    bool isapi = !req->posturl.compare(0, MegaClient::APIURL.size(), MegaClient::APIURL);
+
+    r->req = req;
+    r->host = isapi ? &api : host(hostname(&req->posturl).c_str());
+    r->failstatus = -1;
+    r->failat = -1;
+    r->payload = data ? len : req->out->size();
+    r->done = 0;
+    r->credit = 0;
+    r->upload = NULL;
+    r->hold = false;
+
+    if (isapi)
+    {
+        r->body = data ? string(data, len) : *req->out;
+        apirequest(r);
+    }
+    else
+    {
+        storagerequest(r);
+    }
+
+    // (payload: what is sent by the client for uploads, received otherwise)
+    if (!r->upload)
+    {
+        r->payload = r->response.size();
+    }
+
+    r->host->requests++;
+
+    if (r->failstatus < 0)
+    {
+        double p = random();
+
+        if (r->host->down)
+        {
+            r->failstatus = 503;
+        }
+        else if (p < r->host->overquota)
+        {
+            r->failstatus = 509;
+        }
+        else if (p < r->host->overquota + r->host->failures)
+        {
+            r->failstatus = 500;
+        }
+        else if (random() < r->host->loss)
+        {
+            // connection lost partway
+            r->failstatus = 0;
+            r->failat = (m_off_t)(r->payload * random());
+        }
+    }
+
+    r->start = now() + r->host->latency;
+
+    req->status = REQ_INFLIGHT;
+    req->httpstatus = 0;
+    req->httpiohandle = r;
+
+    requests.push_back(r);
+
+    int inflight = 0;
+
+    for (list<Request*>::iterator it = requests.begin(); it != requests.end(); it++)
+    {
+        if ((*it)->host != &api)
+        {
+            inflight++;
+        }
+    }
+
+    if (inflight > peakinflight)
+    {
+        peakinflight = inflight;
+    }
+}
+
+void SimHttpIO::cancel(HttpReq* req)
+{
+    Request* r = (Request*)req->httpiohandle;
+
+    if (r)
+    {
+        requests.remove(r);
+        delete r;
+
+        req->httpiohandle = NULL;
+        req->httpstatus = 0;
+        req->status = REQ_FAILURE;
+    }
+}
+
+m_off_t SimHttpIO::postpos(void* handle)
+{
+    return ((Request*)handle)->upload ? ((Request*)handle)->done : 0;
+}
+
+void SimHttpIO::finish(Request* r, bool ok)
+{
+    HttpReq* req = r->req;
+
+    if (ok)
+    {
+        req->httpstatus = 200;
+
+        if (r->upload && (r->upload->received += r->payload) >= r->upload->size)
+        {
+            // the last chunk of an upload returns the upload token
+            byte token[NewNode::UPLOADTOKENLEN];
+            char buf[NewNode::UPLOADTOKENLEN * 4 / 3 + 4];
+
+            for (unsigned i = 0; i < sizeof token; i++)
+            {
+                token[i] = (byte)(random() * 256);
+            }
+
+            Base64::btoa(token, sizeof token, buf);
+            req->in.assign(buf);
+        }
+
+        req->status = REQ_SUCCESS;
+        success = true;
+    }
+    else
+    {
+        req->httpstatus = r->failstatus;
+        req->status = REQ_FAILURE;
+        r->host->failed++;
+    }
+
+    req->timeline.completed = Waiter::us();
+    req->httpiohandle = NULL;
+
+    requests.remove(r);
+    delete r;
+}
+
+bool SimHttpIO::doio()
+{
+    int64_t t = now();
+    int64_t elapsed = t - lastio;
+    bool changed = false;
+
+    lastio = t;
+
+    // requests sharing each host's bandwidth
+    map<SimHost*, int> active;
+
+    for (list<Request*>::iterator it = requests.begin(); it != requests.end(); it++)
+    {
+        if (!(*it)->hold && t >= (*it)->start)
+        {
+            active[(*it)->host]++;
+        }
+    }
+
+    for (list<Request*>::iterator it = requests.begin(); it != requests.end(); )
+    {
+        Request* r = *it++;
+
+        if (r->hold || t < r->start)
+        {
+            continue;
+        }
+
+        changed = true;
+
+        if (r->failstatus > 0)
+        {
+            finish(r, false);
+            continue;
+        }
+
+        m_off_t n = r->payload - r->done;
+
+        if (r->host->bandwidth)
+        {
+            // (a request entering the response phase gets the time since
+            // its start)
+            int64_t ms = t - r->start < elapsed ? t - r->start : elapsed;
+
+            r->credit += (double)r->host->bandwidth * ms / 1000 / active[r->host];
+
+            if (r->credit < n)
+            {
+                n = (m_off_t)r->credit;
+            }
+
+            r->credit -= n;
+        }
+
+        if (r->failat >= 0 && r->done + n >= r->failat)
+        {
+            n = r->failat - r->done;
+        }
+
+        if (n)
+        {
+            if (r->upload)
+            {
+                r->host->bytesin += n;
+            }
+            else
+            {
+                if (!r->done)
+                {
+                    r->req->setcontentlength(r->payload);
+                }
+
+                r->req->put((void*)(r->response.data() + r->done), (unsigned)n);
+                r->host->bytesout += n;
+            }
+
+            r->done += n;
+            r->req->lastdata = Waiter::ds;
+            lastdata = Waiter::ds;
+        }
+
+        if (r->failat >= 0 && r->done >= r->failat)
+        {
+            finish(r, false);
+        }
+        else if (r->done == r->payload)
+        {
+            finish(r, true);
+        }
+    }
+
+    return changed;
+}
+
+void SimHttpIO::addevents(Waiter* w, int)
+{
+    int64_t t = now();
+    int64_t next = -1;
+
+    for (list<Request*>::iterator it = requests.begin(); it != requests.end(); it++)
+    {
+        if (!(*it)->hold)
+        {
+            // transferring requests progress in 5 ms steps
+            int64_t at = (*it)->start > t ? (*it)->start : t + 5;
+
+            if (next < 0 || at < next)
+            {
+                next = at;
+            }
+        }
+    }
+
+    if (next >= 0)
+    {
+        w->wakeupms(next > Waiter::dsms ? next - Waiter::dsms : 0);
+    }
+}
+} // namespace
@@ -0,0 +1,180 @@
+/**
+ * @file tests/simhttpio.h
+ * @brief Simulated network for offline transfer engine benchmarks
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_TESTS_SIMHTTPIO_H
+#define MEGA_TESTS_SIMHTTPIO_H 1
+
+#include "mega.h"
+
+namespace mega {
+// behaviour of a simulated host
+struct SimHost
+{
+    // bytes per second shared by the host's requests (0: unlimited)
+    m_off_t bandwidth;
+
+    // milliseconds until the response starts (connection and server time)
+    int latency;
+
+    // probability of a request failing midway (connection lost), of an HTTP
+    // 500 and of an HTTP 509 (transfer quota exceeded) response
+    double loss;
+    double failures;
+    double overquota;
+
+    // all requests fail (HTTP 503) while set
+    bool down;
+
+    // requests received and failed, payload bytes sent and received
+    m_off_t requests;
+    m_off_t failed;
+    m_off_t bytesout;
+    m_off_t bytesin;
+
+    SimHost();
+};
+
+// HttpIO serving the API and storage requests of transfers from memory:
+// "g" and "u" commands of the API host (MegaClient::APIURL) and the chunk
+// requests to the storage hosts - any other command is answered with 0 and
+// the server-client channel is held open, unless a subclass answers them
+//
+// time is the wall clock (responses take as long as the host model says),
+// the random decisions (loss, failures, 509s) come from a seeded generator,
+// so a given seed always fails the same requests
+class SimHttpIO : public HttpIO
+{
+public:
+    // the model of these hosts (by name), created with the defaults on
+    // first use
+    SimHost* host(const char*);
+
+    // the model of the API host
+    SimHost api;
+
+    // model of storage hosts not configured explicitly
+    SimHost defaults;
+
+    // serve a file under a public handle: the storage object holds the
+    // encrypted content (not copied, must outlive the simulator) and at is
+    // the base64 of the encrypted attributes
+    void addfile(handle, const char* host, const string* data, const string* at);
+
+    // upload targets are assigned round robin over these hosts
+    vector<string> uploadhosts;
+
+    // highest number of concurrent storage requests observed
+    int peakinflight;
+
+    void post(HttpReq*, const char* = NULL, unsigned = 0);
+    void cancel(HttpReq*);
+    void sendchunked(HttpReq*) { }
+    m_off_t postpos(void*);
+    bool doio(void);
+    void addevents(Waiter*, int);
+    void setuseragent(string*) { }
+
+    SimHttpIO(uint32_t seed);
+    virtual ~SimHttpIO();
+
+protected:
+    // append the result of a command of a batch to response, false to
+    // leave it to the simulator
+    virtual bool command(const string* a, const string* object, string* response) { return false; }
+
+    // set the response to a server-client request, false to hold it open
+    virtual bool serverclient(const string* url, string* response) { return false; }
+
+    struct Object
+    {
+        // download: content, upload: expected and received size
+        const string* data;
+        m_off_t size;
+        m_off_t received;
+
+        string url;
+        string at;
+    };
+
+    struct Request
+    {
+        HttpReq* req;
+        SimHost* host;
+
+        // response phase begins at this time (ms), connection is lost
+        // after this many payload bytes (-1: never)
+        int64_t start;
+        m_off_t failat;
+
+        // HTTP status of a failure (0: connection lost)
+        int failstatus;
+
+        // request and response bodies, bytes of the payload sent so far
+        string body;
+        string response;
+        m_off_t payload;
+        m_off_t done;
+
+        // bandwidth share not used yet (bytes)
+        double credit;
+
+        // upload object or NULL
+        Object* upload;
+
+        // never completes (server-client channel)
+        bool hold;
+    };
+
+    map<handle, Object> files;
+    map<int, Object> uploads;
+    map<string, SimHost> hosts;
+    list<Request*> requests;
+
+    int nextupload;
+    unsigned nexthost;
+
+    // last doio() pass (ms)
+    int64_t lastio;
+
+    // xorshift32 state
+    uint32_t rng;
+
+    double random();
+
+    static int64_t now();
+
+    // host name of the URL ("http://host[:port]/...")
+    static string hostname(const string*);
+
+    // split the JSON array of a command batch into its objects
+    static void splitbatch(const string*, vector<string>*);
+
+    // value of a string or numeric field of a flat JSON object
+    static bool field(const string*, const char*, string*);
+
+    void apirequest(Request*);
+    void storagerequest(Request*);
+
+    void finish(Request*, bool);
+};
+} // namespace
+
+#endif
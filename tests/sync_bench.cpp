@@ -0,0 +1,529 @@
+/**
+ * @file tests/sync_bench.cpp
+ * @brief Sync engine benchmark on synthetic trees
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// generates a local tree with a matching (synthetic) remote tree, runs a sync
+// over it offline and reports:
+// - the duration of the initial scan and the fingerprint throughput
+// - the time until the first reconciliation has settled
+// - the estimated memory footprint per LocalNode
+// - the time to absorb a storm of local renames and deletions
+//
+// usage: sync_bench [-d dir] [-f fanout] [-l depth] [-n files per folder]
+//                   [-s max file size] [-r renames] [-x deletions] [-t timeout]
+
+#include "mega.h"
+
+using namespace mega;
+
+#ifdef ENABLE_SYNC
+// API requests are accepted, but never answered - the remote tree is
+// synthesized locally, so the benchmark runs without network access
+struct BenchHttpIO : public HttpIO
+{
+    void post(HttpReq* req, const char* = NULL, unsigned = 0)
+    {
+        req->status = REQ_INFLIGHT;
+    }
+
+    void cancel(HttpReq* req)
+    {
+        req->httpio = NULL;
+        req->httpiohandle = NULL;
+        req->status = REQ_FAILURE;
+    }
+
+    void sendchunked(HttpReq*) { }
+
+    m_off_t postpos(void*)
+    {
+        return 0;
+    }
+
+    bool doio()
+    {
+        return false;
+    }
+
+    void setuseragent(string*) { }
+
+    // poll the engine at least every decisecond
+    void addevents(Waiter* waiter, int)
+    {
+        if (waiter->maxds > 1)
+        {
+            waiter->maxds = 1;
+        }
+    }
+};
+
+struct BenchApp : public MegaApp
+{
+};
+
+struct BenchTree
+{
+    MegaClient* client;
+
+    int fanout;
+    int depth;
+    int files;
+    m_off_t maxsize;
+
+    handle nexthandle;
+    uint32_t seed;
+
+    // local paths of the generated items
+    vector<string> filepaths;
+    vector<string> folderpaths;
+
+    m_off_t totalbytes;
+
+    node_vector dp;
+
+    uint32_t random()
+    {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 8;
+    }
+
+    Node* newnode(Node* parent, nodetype_t type, const char* name, m_off_t size)
+    {
+        Node* n = new (client) Node(client, &dp, nexthandle++, parent ? parent->nodehandle : UNDEF, type, size, UNDEF, NULL, time(NULL));
+
+        byte key[FILENODEKEYLENGTH];
+
+        for (unsigned i = 0; i < sizeof key; i++)
+        {
+            key[i] = (byte)random();
+        }
+
+        n->nodekey.assign((char*)key, type == FILENODE ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+
+        if (name)
+        {
+            n->attrs.map['n'] = name;
+        }
+
+        return n;
+    }
+
+    bool writefile(string* localpath, m_off_t size)
+    {
+        FileAccess* fa = client->fsaccess->newfileaccess();
+        byte buf[65536];
+        bool ok = fa->fopen(localpath, false, true);
+
+        for (m_off_t pos = 0; ok && pos < size; pos += sizeof buf)
+        {
+            unsigned len = (size - pos < (m_off_t)sizeof buf) ? (unsigned)(size - pos) : sizeof buf;
+
+            for (unsigned i = 0; i < len; i++)
+            {
+                buf[i] = (byte)random();
+            }
+
+            ok = fa->fwrite(buf, len, pos);
+        }
+
+        delete fa;
+
+        return ok;
+    }
+
+    // create the files and subfolders of a folder, mirrored below parent
+    bool generate(string* localpath, Node* parent, int level)
+    {
+        size_t t = localpath->size();
+        char name[32];
+        string localname;
+
+        for (int i = 0; i < files; i++)
+        {
+            m_off_t size = maxsize ? random() % (maxsize + 1) : 0;
+
+            sprintf(name, "file%d.bin", i);
+            localname = name;
+            client->fsaccess->name2local(&localname);
+            localpath->append(client->fsaccess->localseparator);
+            localpath->append(localname);
+
+            if (!writefile(localpath, size))
+            {
+                return false;
+            }
+
+            // the remote file carries the fingerprint of the local one
+            FileAccess* fa = client->fsaccess->newfileaccess();
+            FileFingerprint fp;
+
+            if (!fa->fopen(localpath, true, false) || !fp.genfingerprint(fa))
+            {
+                delete fa;
+                return false;
+            }
+
+            delete fa;
+
+            Node* n = newnode(parent, FILENODE, name, size);
+            fp.serializefingerprint(&n->attrs.map['c']);
+            n->finishattrs();
+
+            filepaths.push_back(*localpath);
+            totalbytes += size;
+            localpath->resize(t);
+        }
+
+        if (level < depth)
+        {
+            for (int i = 0; i < fanout; i++)
+            {
+                sprintf(name, "folder%d", i);
+                localname = name;
+                client->fsaccess->name2local(&localname);
+                localpath->append(client->fsaccess->localseparator);
+                localpath->append(localname);
+
+                if (!client->fsaccess->mkdirlocal(localpath))
+                {
+                    return false;
+                }
+
+                folderpaths.push_back(*localpath);
+
+                Node* n = newnode(parent, FOLDERNODE, name, -1);
+                n->finishattrs();
+
+                if (!generate(localpath, n, level + 1))
+                {
+                    return false;
+                }
+
+                localpath->resize(t);
+            }
+        }
+
+        return true;
+    }
+
+    BenchTree(MegaClient* cclient)
+    {
+        client = cclient;
+        fanout = 4;
+        depth = 4;
+        files = 16;
+        maxsize = 4096;
+        nexthandle = 1;
+        seed = 1;
+        totalbytes = 0;
+    }
+};
+
+// quiet period required to consider the sync settled
+static const int64_t QUIETUS = 500000;
+
+static bool settled(MegaClient* client, Sync* sync)
+{
+    return sync->state == SYNC_ACTIVE
+        && !sync->dirnotify->notifyq[DirNotify::DIREVENTS].size()
+        && !sync->dirnotify->notifyq[DirNotify::RETRY].size()
+        && !sync->fingerprintjobs.size()
+        && !sync->localroot.syncupdirty
+        && !sync->localroot.syncdowndirty
+        && !client->syncactivity
+        && !client->syncadding;
+}
+
+// run the engine until the sync has settled for QUIETUS, returns the time at
+// which it settled or -1 if it failed or did not settle before the deadline
+static int64_t runtosettled(MegaClient* client, Sync* sync, int64_t deadline)
+{
+    int64_t since = -1;
+
+    for (;;)
+    {
+        client->exec();
+
+        if (sync->state != SYNC_ACTIVE && sync->state != SYNC_INITIALSCAN)
+        {
+            return -1;
+        }
+
+        int64_t now = Waiter::us();
+
+        if (settled(client, sync))
+        {
+            if (since < 0)
+            {
+                since = now;
+            }
+            else if (now - since >= QUIETUS)
+            {
+                return since;
+            }
+        }
+        else
+        {
+            since = -1;
+        }
+
+        if (now > deadline)
+        {
+            return -1;
+        }
+
+        client->wait();
+    }
+}
+
+static double seconds(int64_t us)
+{
+    return us / 1000000.0;
+}
+
+static int usage()
+{
+    cerr << "usage: sync_bench [-d dir] [-f fanout] [-l depth] [-n files per folder]" << endl
+         << "                  [-s max file size] [-r renames] [-x deletions] [-t timeout]" << endl;
+
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* dir = "sync_bench.tmp";
+    int fanout = 4, depth = 4, files = 16;
+    long long maxsize = 4096;
+    int renames = 1000, deletions = 1000;
+    int timeout = 600;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (argv[i][0] != '-' || !argv[i][1] || argv[i][2] || i + 1 >= argc)
+        {
+            return usage();
+        }
+
+        const char* v = argv[++i];
+
+        switch (argv[i - 1][1])
+        {
+            case 'd': dir = v; break;
+            case 'f': fanout = atoi(v); break;
+            case 'l': depth = atoi(v); break;
+            case 'n': files = atoi(v); break;
+            case 's': maxsize = atoll(v); break;
+            case 'r': renames = atoi(v); break;
+            case 'x': deletions = atoi(v); break;
+            case 't': timeout = atoi(v); break;
+            default: return usage();
+        }
+    }
+
+    SimpleLogger::setLogLevel(logError);
+    SimpleLogger::setAllOutputs(&std::cerr);
+
+    WAIT_CLASS::bumpds();
+
+    BenchApp app;
+    MegaClient* client = new MegaClient(&app, new WAIT_CLASS, new BenchHttpIO, new FSACCESS_CLASS,
+                                        NULL, NULL, "sync_bench", "sync_bench");
+
+    BenchTree tree(client);
+
+    tree.fanout = fanout;
+    tree.depth = depth;
+    tree.files = files;
+    tree.maxsize = maxsize;
+
+    // synthetic remote account: root, inbox, rubbish and the synced folder
+    Node* root = tree.newnode(NULL, ROOTNODE, NULL, -1);
+    tree.newnode(NULL, INCOMINGNODE, NULL, -1);
+    tree.newnode(NULL, RUBBISHNODE, NULL, -1);
+
+    Node* remote = tree.newnode(root, FOLDERNODE, "sync_bench", -1);
+    remote->finishattrs();
+
+    string path = dir;
+    string localpath;
+
+    client->fsaccess->path2local(&path, &localpath);
+
+    if (!client->fsaccess->mkdirlocal(&localpath))
+    {
+        cerr << "Could not create " << dir << " (it must not exist)" << endl;
+        return 1;
+    }
+
+    int64_t start = Waiter::us();
+
+    if (!tree.generate(&localpath, remote, 0))
+    {
+        cerr << "Could not generate the local tree" << endl;
+        return 1;
+    }
+
+    cout << "Tree: " << tree.folderpaths.size() << " folders, " << tree.filepaths.size() << " files, "
+         << tree.totalbytes << " bytes (generated in " << seconds(Waiter::us() - start) << " s)" << endl;
+
+    int64_t deadline = Waiter::us() + (int64_t)timeout * 1000000;
+
+    start = Waiter::us();
+
+    if (client->addsync(&localpath, DEBRISFOLDER, NULL, remote) != API_OK)
+    {
+        cerr << "Could not add the sync" << endl;
+        return 1;
+    }
+
+    Sync* sync = client->syncs.back();
+
+    while (sync->state == SYNC_INITIALSCAN && Waiter::us() < deadline)
+    {
+        client->exec();
+        client->wait();
+    }
+
+    if (sync->state != SYNC_ACTIVE)
+    {
+        cerr << "The initial scan did not complete" << endl;
+        return 1;
+    }
+
+    int64_t scanned = Waiter::us();
+    int64_t reconciled = runtosettled(client, sync, deadline);
+
+    if (reconciled < 0)
+    {
+        cerr << "The initial reconciliation did not settle" << endl;
+        return 1;
+    }
+
+    unsigned localnodes = sync->localnodes[FILENODE] + sync->localnodes[FOLDERNODE];
+    size_t memory = client->syncmemory();
+
+    cout << "Initial scan: " << seconds(scanned - start) << " s, "
+         << sync->stats.fingerprinted << " fingerprints ("
+         << (scanned > start ? sync->stats.fingerprinted * 1000000 / (scanned - start) : 0) << " files/s, "
+         << (scanned > start ? tree.totalbytes * 1000000 / (scanned - start) : 0) << " bytes/s)" << endl;
+
+    cout << "Reconciliation: " << seconds(reconciled - scanned) << " s" << endl;
+
+    cout << "Memory: " << memory << " bytes for " << localnodes << " LocalNodes ("
+         << (localnodes ? memory / localnodes : 0) << " bytes per node)" << endl;
+
+    // rename storm: spread over the tree
+    if (renames > (int)tree.filepaths.size())
+    {
+        renames = tree.filepaths.size();
+    }
+
+    if (renames)
+    {
+        size_t stride = tree.filepaths.size() / renames;
+        string suffix = ".renamed";
+        client->fsaccess->name2local(&suffix);
+
+        start = Waiter::us();
+
+        for (int i = 0; i < renames; i++)
+        {
+            string newpath = tree.filepaths[i * stride];
+            newpath.append(suffix);
+
+            if (client->fsaccess->renamelocal(&tree.filepaths[i * stride], &newpath))
+            {
+                tree.filepaths[i * stride] = newpath;
+            }
+        }
+
+        int64_t done = runtosettled(client, sync, deadline);
+
+        if (done < 0)
+        {
+            cerr << "The rename storm did not settle" << endl;
+            return 1;
+        }
+
+        cout << "Rename storm: " << renames << " files in " << seconds(done - start) << " s" << endl;
+    }
+
+    // deletion storm: from the end of the tree
+    if (deletions > (int)tree.filepaths.size())
+    {
+        deletions = tree.filepaths.size();
+    }
+
+    if (deletions)
+    {
+        start = Waiter::us();
+
+        for (int i = 0; i < deletions; i++)
+        {
+            client->fsaccess->unlinklocal(&tree.filepaths.back());
+            tree.filepaths.pop_back();
+        }
+
+        int64_t done = runtosettled(client, sync, deadline);
+
+        if (done < 0)
+        {
+            cerr << "The deletion storm did not settle" << endl;
+            return 1;
+        }
+
+        cout << "Deletion storm: " << deletions << " files in " << seconds(done - start) << " s" << endl;
+    }
+
+    cout << "Notifications: " << sync->dirnotify->notified << " queued, "
+         << sync->dirnotify->superseded << " superseded" << endl;
+
+    // remove the tree (and the local debris folder if the sync created one)
+    string localdebris = sync->localdebris;
+
+    client->delsync(sync);
+    client->exec();
+
+    for (size_t i = tree.filepaths.size(); i--; )
+    {
+        client->fsaccess->unlinklocal(&tree.filepaths[i]);
+    }
+
+    for (size_t i = tree.folderpaths.size(); i--; )
+    {
+        client->fsaccess->rmdirlocal(&tree.folderpaths[i]);
+    }
+
+    client->fsaccess->rmdirlocal(&localdebris);
+
+    if (!client->fsaccess->rmdirlocal(&localpath))
+    {
+        cerr << "Could not remove " << dir << endl;
+    }
+
+    return 0;
+}
+#else
+int main()
+{
+    cerr << "Synchronization features are disabled" << endl;
+    return 1;
+}
+#endif
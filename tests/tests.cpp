@@ -38,6 +38,72 @@ TEST(JSON, storeobject) {
     j.storeobject(&in_str);
 }
 
+// escapes at and across the 16-byte blocks of the string scan, at every
+// alignment
+TEST(JSON, escapes) {
+    for (int prefix = 0; prefix <= 40; prefix++)
+    {
+        for (int offset = 0; offset < 16; offset++)
+        {
+            string raw = string(prefix, 'a') + "\\\"b\\\\" + string(prefix % 7, 'c') + "\\u0041\\u002f\\n\\t";
+            string expected = string(prefix, 'a') + "\"b\\" + string(prefix % 7, 'c') + "A/\n\t";
+
+            // (leading whitespace is skipped)
+            string json = string(offset, ' ') + "\"" + raw + "\",1";
+
+            JSON j;
+            string s;
+            j.begin(json.c_str());
+
+            ASSERT_TRUE(j.storeobject(&s));
+            ASSERT_EQ(raw, s);
+            ASSERT_EQ(',', *j.pos);
+
+            JSON::unescape(&s);
+            ASSERT_EQ(expected, s);
+
+            // an escaped backslash right before the closing quote
+            json = string(offset, ' ') + "\"" + string(prefix, 'a') + "\\\\\"]";
+            j.begin(json.c_str());
+
+            ASSERT_TRUE(j.storeobject(&s));
+            ASSERT_EQ(string(prefix, 'a') + "\\\\", s);
+            ASSERT_EQ(']', *j.pos);
+        }
+    }
+}
+
+// strings without specials, complete and unterminated
+TEST(JSON, plainstrings) {
+    for (int len = 0; len <= 100; len++)
+    {
+        for (int offset = 0; offset < 16; offset += 5)
+        {
+            string json = string(offset, ' ') + "\"" + string(len, 'x') + "\"]";
+
+            JSON j;
+            string s;
+            j.begin(json.c_str());
+
+            ASSERT_TRUE(j.storeobject(&s));
+            ASSERT_EQ(string(len, 'x'), s);
+            ASSERT_EQ(']', *j.pos);
+
+            JSON::unescape(&s);
+            ASSERT_EQ(string(len, 'x'), s);
+
+            json = string(offset, ' ') + "\"" + string(len, 'x');
+            j.begin(json.c_str());
+            ASSERT_FALSE(j.storeobject(&s));
+
+            // a trailing backslash doesn't step over the terminator
+            json += "\\";
+            j.begin(json.c_str());
+            ASSERT_FALSE(j.storeobject(&s));
+        }
+    }
+}
+
 // Test 64-bit int serialization/unserialization
 TEST(Serialize64, serialize) {
     uint64_t in = 0xDEADBEEF;
@@ -49,6 +115,396 @@ TEST(Serialize64, serialize) {
     ASSERT_EQ(in, out);
 }
 
+// A request spanning several chunks must yield the same per-chunk MACs and
+// ciphertext as one request per chunk
+TEST(HttpReqXfer, cryptchunks) {
+    byte keybuf[SymmCipher::KEYLENGTH] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    SymmCipher key(keybuf);
+    uint64_t ctriv = 0x0123456789ABCDEFULL;
+    m_off_t pos = 3 * ChunkedHash::SEGSIZE;
+    unsigned len = 9 * ChunkedHash::SEGSIZE + 1000;
+
+    string data(len + SymmCipher::BLOCKSIZE, 0);
+    for (unsigned i = 0; i < len; i++)
+    {
+        data[i] = (char)(i * 7);
+    }
+    string single = data;
+
+    chunkmac_map coalesced, separate;
+    HttpReqXfer::cryptchunks(&key, (byte*)data.data(), len, pos, ctriv, &coalesced, true);
+
+    for (m_off_t p = pos; p < pos + len; p = ChunkedHash::chunkceil(p))
+    {
+        m_off_t n = ChunkedHash::chunkceil(p) - p;
+        if (p + n > pos + len)
+        {
+            n = pos + len - p;
+        }
+        byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+        key.ctr_crypt((byte*)single.data() + (p - pos), (unsigned)n, p, ctriv, mac, true);
+        memcpy(separate[p].mac, mac, sizeof mac);
+    }
+
+    ASSERT_EQ(separate.size(), coalesced.size());
+    for (chunkmac_map::iterator it = separate.begin(); it != separate.end(); it++)
+    {
+        ASSERT_EQ(0, memcmp(it->second.mac, coalesced[it->first].mac, SymmCipher::BLOCKSIZE));
+    }
+    ASSERT_EQ(0, memcmp(data.data(), single.data(), len));
+}
+
+// The multi-block CTR path must match a block-at-a-time reference, including
+// the MAC over a trailing partial block
+TEST(SymmCipher, ctr_crypt) {
+    byte keybuf[SymmCipher::KEYLENGTH] = { 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1 };
+    SymmCipher key(keybuf);
+    uint64_t ctriv = 0xFEDCBA9876543210ULL;
+    m_off_t pos = 0xFFFFFF0;
+    unsigned len = 1000;
+
+    string data(len + SymmCipher::BLOCKSIZE, 0);
+    for (unsigned i = 0; i < len; i++)
+    {
+        data[i] = (char)(i * 13);
+    }
+
+    byte ctr[SymmCipher::BLOCKSIZE], ks[SymmCipher::BLOCKSIZE], refmac[SymmCipher::BLOCKSIZE];
+    MemAccess::set<int64_t>(ctr, ctriv);
+    SymmCipher::setint64(pos / SymmCipher::BLOCKSIZE, ctr + sizeof ctriv);
+    memcpy(refmac, ctr, sizeof ctriv);
+    memcpy(refmac + sizeof ctriv, ctr, sizeof ctriv);
+
+    string ref = data;
+    for (unsigned i = 0; i < len; i += SymmCipher::BLOCKSIZE)
+    {
+        SymmCipher::xorblock((byte*)ref.data() + i, refmac);
+        key.ecb_encrypt(refmac);
+        key.ecb_encrypt(ctr, ks);
+        SymmCipher::xorblock(ks, (byte*)ref.data() + i);
+        SymmCipher::incblock(ctr);
+    }
+
+    byte mac[SymmCipher::BLOCKSIZE];
+    string enc = data;
+    key.ctr_crypt((byte*)enc.data(), len, pos, ctriv, mac, true);
+    ASSERT_EQ(0, memcmp(enc.data(), ref.data(), len));
+    ASSERT_EQ(0, memcmp(mac, refmac, sizeof mac));
+
+    key.ctr_crypt((byte*)enc.data(), len, pos, ctriv, mac, false);
+    ASSERT_EQ(0, memcmp(enc.data(), data.data(), len));
+    ASSERT_EQ(0, memcmp(mac, refmac, sizeof mac));
+}
+
+// chunk-indexed MAC storage must behave like an offset-ordered map
+TEST(ChunkMACMap, ordering) {
+    chunkmac_map macs;
+    m_off_t p[] = { ChunkedHash::chunkstart(12), ChunkedHash::chunkstart(3), ChunkedHash::chunkstart(9) };
+
+    for (int i = 0; i < 3; i++)
+    {
+        ASSERT_EQ(p[i], ChunkedHash::chunkfloor(p[i]));
+        ASSERT_EQ(ChunkedHash::chunkceil(p[i]), ChunkedHash::chunkstart(ChunkedHash::chunkindex(p[i]) + 1));
+        macs[p[i]].mac[0] = (byte)i;
+    }
+
+    ASSERT_EQ(3u, macs.size());
+
+    chunkmac_map::iterator it = macs.begin();
+    ASSERT_EQ(p[1], it->first);
+    ASSERT_EQ(p[2], (++it)->first);
+    ASSERT_EQ(p[0], (++it)->first);
+    ASSERT_EQ(0, it->second.mac[0]);
+    ASSERT_TRUE(++it == macs.end());
+
+    macs.erase(macs.find(p[1]));
+    ASSERT_TRUE(macs.find(p[1]) == macs.end());
+    ASSERT_EQ(p[2], macs.begin()->first);
+    ASSERT_EQ(2u, macs.size());
+}
+
+// exposes the home slot of a handle and the slot it is stored in
+class ProbedNodeMap : public NodeMap
+{
+public:
+    size_t home(handle h) const { return slot(h); }
+    size_t index(handle h) { return &*find(h) - slots; }
+};
+
+static Node* fakenode(size_t i)
+{
+    return (Node*)(8 * (i + 1));
+}
+
+TEST(NodeMap, insertfinderase) {
+    NodeMap map;
+
+    ASSERT_TRUE(map.find(1) == map.end());
+    ASSERT_TRUE(map.begin() == map.end());
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        map[i * 0x10001 + 1] = fakenode(i);
+    }
+
+    ASSERT_EQ(100u, map.size());
+
+    // a second lookup doesn't add an entry
+    ASSERT_EQ(fakenode(7), map[7 * 0x10001 + 1]);
+    ASSERT_EQ(100u, map.size());
+
+    size_t n = 0;
+    for (NodeMap::iterator it = map.begin(); it != map.end(); it++)
+    {
+        ASSERT_EQ(fakenode((it->first - 1) / 0x10001), it->second);
+        n++;
+    }
+    ASSERT_EQ(100u, n);
+
+    for (size_t i = 0; i < 100; i += 2)
+    {
+        ASSERT_EQ(1u, map.erase(i * 0x10001 + 1));
+        ASSERT_EQ(0u, map.erase(i * 0x10001 + 1));
+    }
+
+    ASSERT_EQ(50u, map.size());
+
+    for (size_t i = 0; i < 100; i++)
+    {
+        NodeMap::iterator it = map.find(i * 0x10001 + 1);
+
+        if (i & 1)
+        {
+            ASSERT_TRUE(it != map.end());
+            ASSERT_EQ(fakenode(i), it->second);
+        }
+        else
+        {
+            ASSERT_TRUE(it == map.end());
+        }
+    }
+
+    map.clear();
+    ASSERT_EQ(0u, map.size());
+    ASSERT_TRUE(map.find(3 * 0x10001 + 1) == map.end());
+}
+
+// erasing an entry inside a collision chain must keep the entries displaced
+// behind it reachable
+TEST(NodeMap, backshift) {
+    ProbedNodeMap map;
+    vector<handle> chain;
+    handle other = UNDEF;
+
+    // the first insertion allocates the minimum table
+    map[1] = fakenode(0);
+    size_t capacity = map.allocated();
+    size_t target = map.home(1);
+
+    // three more handles with the same home slot, one with the next
+    for (handle h = 2; chain.size() < 3 || other == UNDEF; h++)
+    {
+        if (map.home(h) == target && chain.size() < 3)
+        {
+            chain.push_back(h);
+        }
+        else if (map.home(h) == ((target + 1) & (capacity - 1)) && other == UNDEF)
+        {
+            other = h;
+        }
+    }
+
+    for (size_t i = 0; i < chain.size(); i++)
+    {
+        map[chain[i]] = fakenode(i + 1);
+    }
+    map[other] = fakenode(4);
+
+    ASSERT_EQ(capacity, map.allocated());
+    ASSERT_EQ(5u, map.size());
+
+    // head, then the middle of the chain
+    ASSERT_EQ(1u, map.erase(1));
+    ASSERT_EQ(1u, map.erase(chain[1]));
+
+    ASSERT_EQ(3u, map.size());
+    ASSERT_TRUE(map.find(1) == map.end());
+    ASSERT_TRUE(map.find(chain[1]) == map.end());
+    ASSERT_EQ(fakenode(1), map.find(chain[0])->second);
+    ASSERT_EQ(fakenode(3), map.find(chain[2])->second);
+    ASSERT_EQ(fakenode(4), map.find(other)->second);
+
+    // the remaining entries moved up into the gaps
+    ASSERT_EQ(target, map.index(chain[0]));
+    ASSERT_EQ((target + 1) & (capacity - 1), map.index(chain[2]));
+    ASSERT_EQ((target + 2) & (capacity - 1), map.index(other));
+}
+
+// the table grows at 3/4 load and shrinks below 1/8
+TEST(NodeMap, rehash) {
+    NodeMap map;
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        map[i + 1] = fakenode(i);
+    }
+
+    size_t capacity = map.allocated();
+    ASSERT_EQ(0u, capacity & (capacity - 1));
+    ASSERT_GE(capacity / 4 * 3, 1000u);
+    ASSERT_LT(capacity / 8 * 3, 1000u);
+
+    for (size_t i = 0; i < 1000; i++)
+    {
+        ASSERT_EQ(fakenode(i), map.find(i + 1)->second);
+    }
+
+    for (size_t i = 0; i < 990; i++)
+    {
+        ASSERT_EQ(1u, map.erase(i + 1));
+    }
+
+    ASSERT_LT(map.allocated(), capacity);
+    ASSERT_EQ(10u, map.size());
+
+    for (size_t i = 990; i < 1000; i++)
+    {
+        ASSERT_EQ(fakenode(i), map.find(i + 1)->second);
+    }
+
+    map.reserve(5000);
+    ASSERT_GE(map.allocated() / 4 * 3, 5000u);
+    ASSERT_EQ(fakenode(995), map.find(996)->second);
+}
+
+// UNDEF marks empty slots: it is never found, erased or stored
+TEST(NodeMap, undef) {
+    NodeMap map;
+
+    ASSERT_TRUE(map.find(UNDEF) == map.end());
+    ASSERT_EQ(0u, map.erase(UNDEF));
+
+    map[1] = fakenode(0);
+    map[2] = fakenode(1);
+
+    ASSERT_TRUE(map.find(UNDEF) == map.end());
+    ASSERT_EQ(0u, map.erase(UNDEF));
+    ASSERT_EQ(2u, map.size());
+
+    ASSERT_TRUE(map[UNDEF] == NULL);
+    map[UNDEF] = fakenode(2);
+    ASSERT_TRUE(map[UNDEF] == NULL);
+    ASSERT_EQ(2u, map.size());
+
+    ASSERT_EQ(fakenode(0), map.find(1)->second);
+    ASSERT_EQ(fakenode(1), map.find(2)->second);
+}
+
+// bit-by-bit reference encoding
+static string base64ref(const string& in)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    string out;
+    unsigned bits = 0;
+    int nbits = 0;
+
+    for (size_t i = 0; i < in.size(); i++)
+    {
+        bits = (bits << 8) | (byte)in[i];
+        nbits += 8;
+
+        while (nbits >= 6)
+        {
+            nbits -= 6;
+            out += alphabet[(bits >> nbits) & 63];
+        }
+    }
+
+    if (nbits)
+    {
+        out += alphabet[(bits << (6 - nbits)) & 63];
+    }
+
+    return out;
+}
+
+// every tail length on both sides of the 12-byte (encoding) and 16-character
+// (decoding) blocks, at several alignments
+TEST(Base64, roundtrip) {
+    for (int len = 0; len <= 40; len++)
+    {
+        for (int offset = 0; offset < 4; offset++)
+        {
+            string data(offset + len, 0);
+            for (int i = 0; i < len; i++)
+            {
+                data[offset + i] = (char)(i * 37 + len * 11 + 5);
+            }
+
+            string plain = data.substr(offset);
+            string ref = base64ref(plain);
+
+            char encoded[64];
+            ASSERT_EQ((int)ref.size(), Base64::btoa((const byte*)data.data() + offset, len, encoded));
+            ASSERT_EQ(ref, string(encoded));
+
+            string text = string(offset, 'A') + ref;
+
+            byte decoded[64];
+            ASSERT_EQ(len, Base64::atob(text.c_str() + offset, decoded, len));
+            ASSERT_EQ(0, memcmp(decoded, plain.data(), len));
+
+            // the output size limits the decoded length
+            if (len)
+            {
+                ASSERT_EQ(len - 1, Base64::atob(text.c_str() + offset, decoded, len - 1));
+                ASSERT_EQ(0, memcmp(decoded, plain.data(), len - 1));
+            }
+
+            string s, t;
+            ASSERT_EQ((int)ref.size(), Base64::btoa(plain, &s));
+            ASSERT_EQ(ref, s);
+            ASSERT_EQ(len, Base64::atob(s, &t));
+            ASSERT_EQ(plain, t);
+        }
+    }
+}
+
+// decoding stops at the first character outside the alphabet, wherever it
+// is (the result is that of the valid prefix alone)
+TEST(Base64, invalid) {
+    string plain;
+    for (int i = 0; i < 30; i++)
+    {
+        plain += (char)(i * 53 + 1);
+    }
+
+    string text = base64ref(plain);
+    const char* invalid[] = { "*", "=", "+", "/", " ", "\xff" };
+
+    for (size_t k = 0; k < text.size(); k++)
+    {
+        for (size_t c = 0; c < sizeof invalid / sizeof *invalid; c++)
+        {
+            string bad = text;
+            bad[k] = *invalid[c];
+
+            byte expected[32], decoded[32];
+            int n = Base64::atob(text.substr(0, k).c_str(), expected, sizeof expected);
+
+            ASSERT_EQ(n, Base64::atob(bad.c_str(), decoded, sizeof decoded));
+            ASSERT_EQ(0, memcmp(decoded, expected, n));
+
+            // complete groups decode to the original bytes
+            if (k % 4 != 1)
+            {
+                ASSERT_EQ((int)(k * 3 / 4), n);
+                ASSERT_EQ(0, memcmp(decoded, plain.data(), n));
+            }
+        }
+    }
+}
+
 int main (int argc, char *argv[])
 {
     InitGoogleTest(&argc, argv);
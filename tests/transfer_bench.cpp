@@ -0,0 +1,545 @@
+/**
+ * @file tests/transfer_bench.cpp
+ * @brief Transfer engine benchmark over a simulated network
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// runs downloads and uploads through the unmodified transfer engine
+// (moretransfers(), dispatch(), TransferSlot) against SimHttpIO, with one
+// fresh client per scenario:
+// - baseline: unlimited storage hosts
+// - throttled: limited bandwidth and 100 ms latency per host
+// - lossy: connections dropped midway and HTTP 500s
+// - outage: one storage host down for the first seconds
+// - overquota: 509 responses (the engine backs off, the run is cut short)
+// - upload: chunked uploads to two storage hosts
+// and reports for each the duration and throughput, the chunk latency
+// percentiles, the failed chunk requests and the peak concurrency
+//
+// downloads are public handle "g" fetches of synthetic encrypted files
+// (served from memory and verified against their MAC), uploads end with the
+// upload token - no nodes are created
+//
+// time runs on the wall clock, the random failures are drawn from the seed:
+// the same seed fails the same requests
+//
+// usage: transfer_bench [-d dir] [-n files] [-s file size] [-r seed]
+//                       [-t timeout] [scenario...]
+
+#include "mega.h"
+#include "simhttpio.h"
+
+using namespace mega;
+
+struct BenchApp : public MegaApp
+{
+    int limits;
+    int failures;
+
+    void transfer_failed(Transfer*, error)
+    {
+        failures++;
+    }
+
+    void transfer_limit(Transfer*)
+    {
+        limits++;
+    }
+
+    BenchApp()
+    {
+        limits = 0;
+        failures = 0;
+    }
+};
+
+// outcome of the transfers of a scenario
+struct BenchResult
+{
+    int pending;
+    int completed;
+    int terminated;
+    m_off_t bytes;
+};
+
+// self-destructing transfer file
+struct BenchFile : public File
+{
+    BenchResult* result;
+
+    void completed(Transfer* t, LocalNode*)
+    {
+        // (uploads: no putnodes)
+        result->pending--;
+        result->completed++;
+        result->bytes += t->size;
+
+        delete this;
+    }
+
+    void terminated()
+    {
+        result->pending--;
+        result->terminated++;
+
+        delete this;
+    }
+
+    BenchFile(BenchResult* cresult)
+    {
+        result = cresult;
+    }
+};
+
+// synthetic encrypted file
+struct BenchBlob
+{
+    handle h;
+    m_off_t size;
+    byte filekey[FILENODEKEYLENGTH];
+
+    // encrypted content and base64 of the encrypted attributes
+    string data;
+    string at;
+};
+
+static uint32_t seed = 1;
+
+static uint32_t random32()
+{
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+static void randomfill(byte* buf, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        buf[i] = (byte)random32();
+    }
+}
+
+// encrypt random content the way uploads do and derive the node key
+static void makeblob(MegaClient* client, BenchBlob* blob, handle h, m_off_t size, const char* name)
+{
+    byte key[SymmCipher::KEYLENGTH];
+    uint64_t ctriv;
+    SymmCipher cipher;
+    chunkmac_map macs;
+
+    randomfill(key, sizeof key);
+    randomfill((byte*)&ctriv, sizeof ctriv);
+    cipher.setkey(key);
+
+    blob->h = h;
+    blob->size = size;
+    blob->data.resize((size_t)size);
+    randomfill((byte*)blob->data.data(), blob->data.size());
+
+    if (size)
+    {
+        HttpReqXfer::cryptchunks(&cipher, (byte*)blob->data.data(), (unsigned)size, 0, ctriv, &macs, true);
+    }
+
+    // meta MAC as TransferSlot::macsmac()
+    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+
+    for (chunkmac_map::iterator it = macs.begin(); it != macs.end(); it++)
+    {
+        SymmCipher::xorblock(it->second.mac, mac);
+        cipher.ecb_encrypt(mac);
+    }
+
+    uint32_t* m = (uint32_t*)mac;
+
+    m[0] ^= m[1];
+    m[1] = m[2] ^ m[3];
+
+    memcpy(blob->filekey, key, sizeof key);
+    MemAccess::set<uint64_t>(blob->filekey + SymmCipher::KEYLENGTH, ctriv);
+    memcpy(blob->filekey + SymmCipher::KEYLENGTH + sizeof ctriv, mac, sizeof(int64_t));
+    SymmCipher::xorblock(blob->filekey + SymmCipher::KEYLENGTH, blob->filekey);
+
+    // attributes: just the name (makeattr() adds the braces)
+    string attrs, encrypted;
+    char* buf;
+
+    attrs = string("\"n\":\"") + name + "\"";
+    client->makeattr(&cipher, &encrypted, attrs.c_str());
+
+    buf = new char[encrypted.size() * 4 / 3 + 4];
+    Base64::btoa((const byte*)encrypted.data(), encrypted.size(), buf);
+    blob->at = buf;
+    delete[] buf;
+}
+
+struct Scenario
+{
+    const char* name;
+    bool upload;
+
+    // storage host model, loss/failure rates are applied to all hosts
+    m_off_t bandwidth;
+    int latency;
+    double loss;
+    double failures;
+    double overquota;
+
+    // the first storage host is down for this long (ms)
+    int outage;
+
+    // cut the run short after this many seconds (0: the global timeout)
+    int timeout;
+};
+
+static const Scenario scenarios[] = {
+    { "baseline",  false, 0,            0,   0,    0,    0, 0,    0 },
+    { "throttled", false, 4 << 20,      100, 0,    0,    0, 0,    0 },
+    { "lossy",     false, 16 << 20,     20,  0.05, 0.05, 0, 0,    0 },
+    { "outage",    false, 16 << 20,     20,  0,    0,    0, 3000, 0 },
+    { "overquota", false, 16 << 20,     20,  0,    0,    1, 0,    10 },
+    { "upload",    true,  16 << 20,     20,  0.02, 0,    0, 0,    0 },
+};
+
+// storage hosts the files are spread over
+static const char* const storagehosts[] = { "gfs1.sim", "gfs2.sim", "gfs3.sim" };
+static const int NUMHOSTS = sizeof storagehosts / sizeof *storagehosts;
+
+static m_off_t histpercentile(const m_off_t* histogram, m_off_t samples, double p)
+{
+    m_off_t seen = 0;
+
+    for (int i = 0; i < ChunkTimingStats::NUMBUCKETS; i++)
+    {
+        seen += histogram[i];
+
+        if (seen >= samples * p)
+        {
+            return i ? (m_off_t)1 << i : 0;
+        }
+    }
+
+    return (m_off_t)1 << ChunkTimingStats::NUMBUCKETS;
+}
+
+static double seconds(int64_t us)
+{
+    return us / 1000000.0;
+}
+
+static bool writefile(FileSystemAccess* fsaccess, string* localpath, m_off_t size)
+{
+    FileAccess* fa = fsaccess->newfileaccess();
+    byte buf[65536];
+    bool ok = fa->fopen(localpath, false, true);
+
+    for (m_off_t pos = 0; ok && pos < size; pos += sizeof buf)
+    {
+        unsigned len = (size - pos < (m_off_t)sizeof buf) ? (unsigned)(size - pos) : sizeof buf;
+
+        randomfill(buf, len);
+        ok = fa->fwrite(buf, len, pos);
+    }
+
+    delete fa;
+
+    return ok;
+}
+
+// run one scenario, false if the transfers could not be started
+static bool run(const Scenario* s, const char* dir, int files, m_off_t size, uint32_t rseed, int timeout)
+{
+    BenchApp app;
+    SimHttpIO* sim = new SimHttpIO(rseed);
+    FileSystemAccess* fsaccess = new FSACCESS_CLASS;
+    Waiter* waiter = new WAIT_CLASS;
+    MegaClient* client = new MegaClient(&app, waiter, sim, fsaccess, NULL, NULL, "transfer_bench", "transfer_bench");
+
+    sim->defaults.bandwidth = s->bandwidth;
+    sim->defaults.latency = s->latency;
+    sim->defaults.loss = s->loss;
+    sim->defaults.failures = s->failures;
+    sim->defaults.overquota = s->overquota;
+    sim->api.latency = s->latency;
+
+    for (int i = 0; i < NUMHOSTS; i++)
+    {
+        sim->host(storagehosts[i]);
+    }
+
+    if (s->outage)
+    {
+        sim->host(storagehosts[0])->down = true;
+    }
+
+    BenchResult result;
+    vector<BenchBlob> blobs(s->upload ? 0 : files);
+    vector<string> localpaths;
+    string path = dir, localdir, localname;
+    char name[32];
+
+    result.pending = 0;
+    result.completed = 0;
+    result.terminated = 0;
+    result.bytes = 0;
+
+    fsaccess->path2local(&path, &localdir);
+
+    if (!fsaccess->mkdirlocal(&localdir))
+    {
+        cerr << "Could not create " << dir << " (it must not exist)" << endl;
+        return false;
+    }
+
+    if (s->upload)
+    {
+        for (int i = 0; i < NUMHOSTS - 1; i++)
+        {
+            sim->uploadhosts.push_back(storagehosts[i + 1]);
+        }
+    }
+
+    for (int i = 0; i < files; i++)
+    {
+        sprintf(name, "file%d.bin", i);
+        localname = name;
+        fsaccess->name2local(&localname);
+        localpaths.push_back(localdir);
+        localpaths.back().append(fsaccess->localseparator);
+        localpaths.back().append(localname);
+
+        if (s->upload)
+        {
+            if (!writefile(fsaccess, &localpaths.back(), size))
+            {
+                cerr << "Could not write " << name << endl;
+                return false;
+            }
+        }
+        else
+        {
+            makeblob(client, &blobs[i], 1 + i, size, name);
+            sim->addfile(blobs[i].h, storagehosts[i % NUMHOSTS], &blobs[i].data, &blobs[i].at);
+        }
+    }
+
+    int64_t start = Waiter::us();
+
+    for (int i = 0; i < files; i++)
+    {
+        BenchFile* f = new BenchFile(&result);
+
+        f->localname = localpaths[i];
+        sprintf(name, "file%d.bin", i);
+        f->name = name;
+
+        if (!s->upload)
+        {
+            f->h = blobs[i].h;
+            f->hprivate = false;
+            f->size = size;
+            memcpy(f->filekey, blobs[i].filekey, sizeof f->filekey);
+        }
+
+        if (!client->startxfer(s->upload ? PUT : GET, f))
+        {
+            delete f;
+            cerr << "Could not start the transfer of " << name << endl;
+            return false;
+        }
+
+        result.pending++;
+    }
+
+    int64_t deadline = start + (int64_t)(s->timeout ? s->timeout : timeout) * 1000000;
+    int64_t now = start;
+
+    while (result.pending && now < deadline)
+    {
+        if (s->outage && sim->host(storagehosts[0])->down && now - start >= (int64_t)s->outage * 1000)
+        {
+            sim->host(storagehosts[0])->down = false;
+        }
+
+        client->exec();
+        client->wait();
+
+        now = Waiter::us();
+    }
+
+    int64_t elapsed = now - start;
+    ChunkTimingStats* timings = &client->chunktimings[s->upload ? PUT : GET];
+    m_off_t samples = timings->samples[TIMING_TOTAL];
+
+    cout << s->name << ": " << result.completed << "/" << files << " " << (s->upload ? "uploads" : "downloads")
+         << " in " << seconds(elapsed) << " s";
+
+    if (elapsed > 0)
+    {
+        cout << " (" << (double)result.bytes / elapsed << " MB/s)";
+    }
+
+    if (result.pending)
+    {
+        cout << ", " << result.pending << " pending at the deadline";
+    }
+
+    cout << endl;
+
+    if (samples)
+    {
+        cout << "  chunk latency (ms): p50 <= " << histpercentile(timings->histogram[TIMING_TOTAL], samples, 0.5)
+             << ", p90 <= " << histpercentile(timings->histogram[TIMING_TOTAL], samples, 0.9)
+             << ", p99 <= " << histpercentile(timings->histogram[TIMING_TOTAL], samples, 0.99)
+             << ", max " << timings->max[TIMING_TOTAL] / 1000 << " (" << samples << " chunks)" << endl;
+    }
+
+    cout << "  chunk failures: " << client->enginestats.chunkfailures
+         << ", transfer failures: " << app.failures
+         << ", 509s: " << app.limits
+         << ", peak concurrent requests: " << sim->peakinflight << endl;
+
+    for (int i = 0; i < NUMHOSTS; i++)
+    {
+        SimHost* h = sim->host(storagehosts[i]);
+
+        if (h->requests)
+        {
+            cout << "  " << storagehosts[i] << ": " << h->requests << " requests, " << h->failed << " failed, "
+                 << (s->upload ? h->bytesin : h->bytesout) << " bytes" << endl;
+        }
+    }
+
+    // pending transfers are cancelled (and their files deleted) with the
+    // client, before the requests' HttpIO goes
+    delete client;
+    delete sim;
+    delete waiter;
+
+    for (size_t i = 0; i < localpaths.size(); i++)
+    {
+        fsaccess->unlinklocal(&localpaths[i]);
+    }
+
+    if (!fsaccess->rmdirlocal(&localdir))
+    {
+        cerr << "Could not remove " << dir << endl;
+    }
+
+    delete fsaccess;
+
+    return true;
+}
+
+static int usage()
+{
+    cerr << "usage: transfer_bench [-d dir] [-n files] [-s file size] [-r seed]" << endl
+         << "                      [-t timeout] [scenario...]" << endl
+         << "scenarios:";
+
+    for (unsigned i = 0; i < sizeof scenarios / sizeof *scenarios; i++)
+    {
+        cerr << " " << scenarios[i].name;
+    }
+
+    cerr << endl;
+
+    return 2;
+}
+
+int main(int argc, char* argv[])
+{
+    const char* dir = "transfer_bench.tmp";
+    int files = 8;
+    long long size = 8 << 20;
+    uint32_t rseed = 1;
+    int timeout = 300;
+    vector<const Scenario*> selected;
+    int i;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (!argv[i][1] || argv[i][2] || i + 1 >= argc)
+        {
+            return usage();
+        }
+
+        const char* v = argv[++i];
+
+        switch (argv[i - 1][1])
+        {
+            case 'd': dir = v; break;
+            case 'n': files = atoi(v); break;
+            case 's': size = atoll(v); break;
+            case 'r': rseed = (uint32_t)atol(v); break;
+            case 't': timeout = atoi(v); break;
+            default: return usage();
+        }
+    }
+
+    for (; i < argc; i++)
+    {
+        unsigned j;
+
+        for (j = 0; j < sizeof scenarios / sizeof *scenarios; j++)
+        {
+            if (!strcmp(argv[i], scenarios[j].name))
+            {
+                selected.push_back(&scenarios[j]);
+                break;
+            }
+        }
+
+        if (j == sizeof scenarios / sizeof *scenarios)
+        {
+            return usage();
+        }
+    }
+
+    if (!selected.size())
+    {
+        for (unsigned j = 0; j < sizeof scenarios / sizeof *scenarios; j++)
+        {
+            selected.push_back(&scenarios[j]);
+        }
+    }
+
+    if (files <= 0 || size <= 0)
+    {
+        return usage();
+    }
+
+    SimpleLogger::setLogLevel(logError);
+    SimpleLogger::setAllOutputs(&std::cerr);
+
+    WAIT_CLASS::bumpds();
+
+    seed = rseed;
+
+    cout << files << " files of " << size << " bytes, seed " << rseed << endl;
+
+    for (size_t j = 0; j < selected.size(); j++)
+    {
+        if (!run(selected[j], dir, files, size, rseed, timeout))
+        {
+            return 1;
+        }
+    }
+
+    return 0;
+}